@@ -58,9 +58,11 @@ template <typename T> static void check(T *dst, int factor, int count) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init(src, dst, count);                                                                                         \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::aos_to_soa##N##_stdlib_##T_ISPC(src, dst, count);                                                    \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(dst, N, count);                                                                                          \
         aligned_free_helper(src);                                                                                      \
@@ -75,9 +77,11 @@ template <typename T> static void check(T *dst, int factor, int count) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init(src, dst, count);                                                                                         \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::aos_to_soa##N##_ispc_##T_ISPC(src, dst, count);                                                      \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(dst, N, count);                                                                                          \
         aligned_free_helper(src);                                                                                      \
@@ -60,9 +60,11 @@ template <typename T> static void check(T *dst, int count) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init(src, dst, N, count);                                                                                      \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::soa_to_aos##N##_stdlib_##T_ISPC(src, dst, count);                                                    \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(dst, count);                                                                                             \
         aligned_free_helper(src);                                                                                      \
@@ -77,9 +79,11 @@ template <typename T> static void check(T *dst, int count) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init(src, dst, count);                                                                                         \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::soa_to_aos##N##_ispc_##T_ISPC(src, dst, count);                                                      \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check##N(dst, count);                                                                                          \
         aligned_free_helper(src);                                                                                      \
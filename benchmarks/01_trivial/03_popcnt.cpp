@@ -64,9 +64,11 @@ template <typename T> static void check_even(T *src, T *dst, int count) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init(src, dst, count);                                                                                         \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::popcnt_##V##_##T_ISPC##_##ALL(src, dst, count);                                                      \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check_##ALL(src, dst, count);                                                                                  \
         aligned_free_helper(src);                                                                                      \
@@ -55,9 +55,11 @@ template <typename T> static void check(T *src, T *dst, int divisor, int count)
         init_src(src, count);                                                                                          \
         init_dst(dst, count);                                                                                          \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::fastdiv_##T_ISPC##_##DIV_VAL(src, dst, count);                                                       \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(src, dst, DIV_VAL, count);                                                                               \
         aligned_free_helper(src);                                                                                      \
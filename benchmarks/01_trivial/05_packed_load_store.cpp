@@ -126,9 +126,11 @@ static void check_packed_store_active2_neq(T *src, T *dst, const unsigned int in
         const unsigned int index = ACTIVE_RATIO;                                                                       \
         unsigned int num = 0;                                                                                          \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             num = ispc::FUNC##_##T_ISPC##_eq(src, dst, index, count);                                                  \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check_##FUNC##_eq(src, dst, index, num, count);                                                                \
         aligned_free_helper(src);                                                                                      \
@@ -145,9 +147,11 @@ static void check_packed_store_active2_neq(T *src, T *dst, const unsigned int in
         const unsigned int index = ACTIVE_RATIO;                                                                       \
         unsigned int num = 0;                                                                                          \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             num = ispc::FUNC##_##T_ISPC##_neq(src, dst, index, count);                                                 \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check_##FUNC##_neq(src, dst, index, num, count);                                                               \
         aligned_free_helper(src);                                                                                      \
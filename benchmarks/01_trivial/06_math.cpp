@@ -1,9 +1,11 @@
 // Copyright (c) 2021-2024, Intel Corporation
 // SPDX-License-Identifier: BSD-3-Clause
 
+#include <algorithm>
 #include <benchmark/benchmark.h>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <stdio.h>
 
 #include "../common.h"
@@ -11,7 +13,8 @@
 
 static Docs docs("Check perfomance of math functions.\n"
                  "Things to note:\n"
-                 " - benchmarks are focused on performance, not accuracy verification.\n"
+                 " - benchmarks are focused on performance, the maximum error in ulp over the inputs is reported as\n"
+                 "   the max_ulp counter, so that the accuracy of the math libraries can be compared.\n"
                  " - math functions are invoked in unmasked context.\n"
                  " - workload sizes are designed to hit different caches (L1/L2/L3).\n"
                  "Expectations:\n"
@@ -91,26 +94,55 @@ template <typename T> static void init_one(T *src, T *dst, int count) {
     }
 }
 
-template <typename T, typename F> static void check(T *src, T *dst, int count, F fp) {
+// Error of the value in units in the last place of the expected result,
+// which is computed in long double.
+template <typename T> static double ulp_error(T value, long double expected) {
+    T rounded = static_cast<T>(expected);
+    if (std::isnan(value) || std::isnan(rounded)) {
+        return std::isnan(value) && std::isnan(rounded) ? 0 : INFINITY;
+    }
+    if (std::isinf(rounded)) {
+        return value == rounded ? 0 : INFINITY;
+    }
+    T magnitude = std::abs(rounded);
+    T ulp = std::nextafter(magnitude, std::numeric_limits<T>::infinity()) - magnitude;
+    return static_cast<double>(std::abs(static_cast<long double>(value) - expected) / ulp);
+}
+
+// Report the throughput and the maximum error, and print the first result
+// that is off by more than eps.
+template <typename T, typename F>
+static void check(benchmark::State &state, T *src, T *dst, int count, F fp) {
     T eps = 0.001f;
+    double max_ulp = 0;
+    bool reported = false;
     for (int i = 0; i < count; i++) {
-        T expected = fp(src[i]);
-        if (std::abs(expected - dst[i]) > eps) {
-            printf("Error i=%d, expected %g, return %g\n", i, expected, dst[i]);
-            return;
+        long double expected = fp(src[i]);
+        max_ulp = std::max(max_ulp, ulp_error(dst[i], expected));
+        if (!reported && std::abs(static_cast<T>(expected) - dst[i]) > eps) {
+            printf("Error i=%d, expected %g, return %g\n", i, static_cast<double>(expected), dst[i]);
+            reported = true;
         }
     }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["max_ulp"] = max_ulp;
 }
 
-template <typename T, typename F> static void check2(T *src1, T *src2, T *dst, int count, F fp) {
+template <typename T, typename F>
+static void check2(benchmark::State &state, T *src1, T *src2, T *dst, int count, F fp) {
     T eps = 0.001f;
+    double max_ulp = 0;
+    bool reported = false;
     for (int i = 0; i < count; i++) {
-        T expected = fp(src1[i], src2[i]);
-        if (std::abs(expected - dst[i]) > eps) {
-            printf("Error i=%d, expected %g, return %g\n", i, expected, dst[i]);
-            return;
+        long double expected = fp(src1[i], src2[i]);
+        max_ulp = std::max(max_ulp, ulp_error(dst[i], expected));
+        if (!reported && std::abs(static_cast<T>(expected) - dst[i]) > eps) {
+            printf("Error i=%d, expected %g, return %g\n", i, static_cast<double>(expected), dst[i]);
+            reported = true;
         }
     }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["max_ulp"] = max_ulp;
 }
 
 template <typename T> static void check_ldexp(T *src1, int *src2, T *dst, int count) {
@@ -144,11 +176,13 @@ template <typename T> static void check_frexp(T *src, T *dst1, int *dst2, int co
         T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));                                            \
         INIT(src, dst, count);                                                                                         \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::NAME##_##T(src, dst, count);                                                                         \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
-        check(src, dst, count, [](T x) { return CHECK; });                                                             \
+        check(state, src, dst, count, [](long double x) { return CHECK; });                                            \
         aligned_free_helper(src);                                                                                      \
         aligned_free_helper(dst);                                                                                      \
     }                                                                                                                  \
@@ -163,11 +197,13 @@ template <typename T> static void check_frexp(T *src, T *dst1, int *dst2, int co
         T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));                                            \
         INIT(src1, src2, dst, count);                                                                                  \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::NAME##_##T(src1, src2, dst, count);                                                                  \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
-        check2(src1, src2, dst, count, [](T x, T y) { return CHECK; });                                                \
+        check2(state, src1, src2, dst, count, [](long double x, long double y) { return CHECK; });                     \
         aligned_free_helper(src1);                                                                                     \
         aligned_free_helper(src2);                                                                                     \
         aligned_free_helper(dst);                                                                                      \
@@ -183,9 +219,11 @@ template <typename T> static void check_frexp(T *src, T *dst1, int *dst2, int co
         T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));                                            \
         INIT(src1, src2, dst, count);                                                                                  \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::NAME##_##T(src1, src2, dst, count);                                                                  \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check_##NAME(src1, src2, dst, count);                                                                          \
         aligned_free_helper(src1);                                                                                     \
@@ -203,9 +241,11 @@ template <typename T> static void check_frexp(T *src, T *dst1, int *dst2, int co
         int *dst2 = static_cast<int *>(aligned_alloc_helper(sizeof(int) * count));                                     \
         INIT(src, dst1, dst2, count);                                                                                  \
                                                                                                                        \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::NAME##_##T(src, dst1, dst2, count);                                                                  \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check_##NAME(src, dst1, dst2, count);                                                                          \
         aligned_free_helper(src);                                                                                      \
@@ -251,4 +291,8 @@ TEST(log, double, init_linear, std::log(x))
 TEST2(pow, float, init_linear2, std::pow(x, y))
 TEST2(pow, double, init_linear2, std::pow(x, y))
 
+TEST(exp_fast, float, init_pi, std::exp(x))
+TEST(log_fast, float, init_linear, std::log(x))
+TEST2(pow_fast, float, init_linear2, std::pow(x, y))
+
 BENCHMARK_MAIN();
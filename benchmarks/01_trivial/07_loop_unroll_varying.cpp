@@ -70,9 +70,11 @@ template <typename T> void check(T *src, T *dst, size_t num_elems) {
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * num_elems));                                  \
         init_src(src, num_elems);                                                                                      \
         init_dst(dst, num_elems);                                                                                      \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::unroll_varying_##T_FOR##_##T_ISPC##_##UNROLL_FACTOR(src, dst, num_elems);                            \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
         check(src, dst, num_elems);                                                                                    \
         aligned_free_helper(src);                                                                                      \
         aligned_free_helper(dst);                                                                                      \
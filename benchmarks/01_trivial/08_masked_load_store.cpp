@@ -71,9 +71,11 @@ template <typename T> static void check(T *src_a, T *src_b, T *dst, bool *mask,
         bool *mask = static_cast<bool *>(aligned_alloc_helper(sizeof(bool) * count));                                  \
         init(src_a, src_b, dst, count);                                                                                \
         init_mask_all_on(mask, count);                                                                                 \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::masked_load_store_##T_ISPC(src_a, src_b, dst, count, mask);                                          \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(src_a, src_b, dst, mask, count);                                                                         \
         aligned_free_helper(src_a);                                                                                    \
@@ -93,9 +95,11 @@ template <typename T> static void check(T *src_a, T *src_b, T *dst, bool *mask,
         bool *mask = static_cast<bool *>(aligned_alloc_helper(sizeof(bool) * count));                                  \
         init(src_a, src_b, dst, count);                                                                                \
         init_mask_half_on(mask, count);                                                                                \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::masked_load_store_##T_ISPC(src_a, src_b, dst, count, mask);                                          \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
                                                                                                                        \
         check(src_a, src_b, dst, mask, count);                                                                         \
         aligned_free_helper(src_a);                                                                                    \
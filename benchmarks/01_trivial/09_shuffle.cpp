@@ -89,9 +89,11 @@ template <typename T> static void check2(T *src_a, T *src_b, T *dst, int count)
         T_C *src_a = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                    \
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init1(src_a, dst, count);                                                                                      \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::Shuffle1_##T_ISPC(src_a, dst, permutation, count);                                                   \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
         check1(src_a, dst, count);                                                                                     \
         aligned_free_helper(src_a);                                                                                    \
         aligned_free_helper(dst);                                                                                      \
@@ -114,9 +116,11 @@ SHUFFLE_1(int64_t, int64)
         T_C *src_b = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                    \
         T_C *dst = static_cast<T_C *>(aligned_alloc_helper(sizeof(T_C) * count));                                      \
         init2(src_a, src_b, dst, count);                                                                               \
+        PerfCounters perf(state);                                                                                      \
         for (auto _ : state) {                                                                                         \
             ispc::Shuffle2_##T_ISPC(src_a, src_b, dst, permutation, count);                                            \
         }                                                                                                              \
+        perf.Stop();                                                                                                   \
         check2(src_a, src_b, dst, count);                                                                              \
         aligned_free_helper(src_a);                                                                                    \
         aligned_free_helper(src_b);                                                                                    \
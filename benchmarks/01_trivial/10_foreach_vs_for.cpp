@@ -0,0 +1,78 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <stdio.h>
+
+#include "../common.h"
+#include "10_foreach_vs_for_ispc.h"
+
+static Docs docs("Check the performance of the loop forms: foreach vs for loop with varying induction variable vs for "
+                 "loop with uniform induction variable and a masked tail.\n"
+                 "The kernel is dst[i] = a[i] * 3 + 1.\n"
+                 "The element counts are divisible by any target width (8192) and not divisible (8191 and 8193).\n"
+                 "[int8, int16, int32, float, int64, double] x [foreach, varying_for, uniform_for] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - foreach is as fast as uniform_for\n"
+                 " - non-divisible counts are not noticeably slower than the divisible one\n");
+
+WARM_UP_RUN();
+
+// 8192 is a multiple of any target width, 8191 and 8193 leave the largest and the smallest tail.
+#define ARGS Arg(8192)->Arg(8191)->Arg(8193)
+
+// The buffers are allocated for a multiple of 64 elements, so their size is a multiple of the alignment.
+static int alloc_count(int count) { return (count + 63) & ~63; }
+
+template <typename T> static void init(T *a, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        a[i] = static_cast<T>(i % 32);
+        dst[i] = 0;
+    }
+}
+
+template <typename T> static void check(T *a, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        T expected = static_cast<T>(a[i] * static_cast<T>(3) + static_cast<T>(1));
+        if (dst[i] != expected) {
+            printf("Error at i=%d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T> static void loop_bench(benchmark::State &state, void (*func)(T *, T *, int)) {
+    const int count = static_cast<int>(state.range(0));
+    T *a = static_cast<T *>(aligned_alloc_helper(sizeof(T) * alloc_count(count)));
+    T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * alloc_count(count)));
+    init(a, dst, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(a, dst, count);
+    }
+    perf.Stop();
+    check(a, dst, count);
+    aligned_free_helper(a);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define LOOP_BENCH(LOOP, T_C, T_ISPC)                                                                                  \
+    static void LOOP##_##T_ISPC(benchmark::State &state) { loop_bench<T_C>(state, ispc::LOOP##_##T_ISPC); }           \
+    BENCHMARK(LOOP##_##T_ISPC)->ARGS;
+
+#define LOOP_BENCHES(T_C, T_ISPC)                                                                                      \
+    LOOP_BENCH(foreach, T_C, T_ISPC)                                                                                   \
+    LOOP_BENCH(varying_for, T_C, T_ISPC)                                                                               \
+    LOOP_BENCH(uniform_for, T_C, T_ISPC)
+
+LOOP_BENCHES(int8_t, int8)
+LOOP_BENCHES(int16_t, int16)
+LOOP_BENCHES(int32_t, int32)
+LOOP_BENCHES(float, float)
+LOOP_BENCHES(int64_t, int64)
+LOOP_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,84 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <stdio.h>
+
+#include "../common.h"
+#include "11_foreach_nd_ispc.h"
+
+static Docs docs("Check the performance of multi-dimensional foreach loops.\n"
+                 "The kernel is dst = a * 3 + 1 over a 2D array, iterated with:\n"
+                 " - foreach_2d: foreach (y, x), the lanes run along the rows\n"
+                 " - foreach_2d_transposed: foreach (x, y), the lanes run along the columns (strided accesses)\n"
+                 " - foreach_rows: uniform for loop over rows and foreach over x\n"
+                 " - foreach_flat: 1D foreach over the flattened array\n"
+                 "The widths are divisible by any target width (64, 512) and not divisible (61, 509).\n"
+                 "[int8, int16, int32, float, int64, double] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - foreach_2d is as fast as foreach_rows\n"
+                 " - foreach_2d is as fast as foreach_flat for the divisible widths\n");
+
+WARM_UP_RUN();
+
+// {width, height}
+#define ARGS Args({64, 64})->Args({61, 67})->Args({512, 512})->Args({509, 513})
+
+// The buffers are allocated for a multiple of 64 elements, so their size is a multiple of the alignment.
+static int alloc_count(int count) { return (count + 63) & ~63; }
+
+template <typename T> static void init(T *a, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        a[i] = static_cast<T>(i % 32);
+        dst[i] = 0;
+    }
+}
+
+template <typename T> static void check(T *a, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        T expected = static_cast<T>(a[i] * static_cast<T>(3) + static_cast<T>(1));
+        if (dst[i] != expected) {
+            printf("Error at i=%d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T> static void foreach_nd_bench(benchmark::State &state, void (*func)(T *, T *, int, int)) {
+    const int width = static_cast<int>(state.range(0));
+    const int height = static_cast<int>(state.range(1));
+    const int count = width * height;
+    T *a = static_cast<T *>(aligned_alloc_helper(sizeof(T) * alloc_count(count)));
+    T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * alloc_count(count)));
+    init(a, dst, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(a, dst, width, height);
+    }
+    perf.Stop();
+    check(a, dst, count);
+    aligned_free_helper(a);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define FOREACH_ND_BENCH(LOOP, T_C, T_ISPC)                                                                            \
+    static void LOOP##_##T_ISPC(benchmark::State &state) { foreach_nd_bench<T_C>(state, ispc::LOOP##_##T_ISPC); }     \
+    BENCHMARK(LOOP##_##T_ISPC)->ARGS;
+
+#define FOREACH_ND_BENCHES(T_C, T_ISPC)                                                                                \
+    FOREACH_ND_BENCH(foreach_2d, T_C, T_ISPC)                                                                          \
+    FOREACH_ND_BENCH(foreach_2d_transposed, T_C, T_ISPC)                                                               \
+    FOREACH_ND_BENCH(foreach_rows, T_C, T_ISPC)                                                                        \
+    FOREACH_ND_BENCH(foreach_flat, T_C, T_ISPC)
+
+FOREACH_ND_BENCHES(int8_t, int8)
+FOREACH_ND_BENCHES(int16_t, int16)
+FOREACH_ND_BENCHES(int32_t, int32)
+FOREACH_ND_BENCHES(float, float)
+FOREACH_ND_BENCHES(int64_t, int64)
+FOREACH_ND_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <stdio.h>
+
+#include "../common.h"
+#include "12_foreach_unique_ispc.h"
+
+static Docs docs("Check the performance of foreach_unique.\n"
+                 "The kernel is dst[i] = table[keys[i]] * 3, where the keys repeat with the given period, i.e. a gang "
+                 "has min(period, target width) unique keys.\n"
+                 "[int8, int16, int32, float, int64, double] x [foreach_unique, gather] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - foreach_unique is faster than gather for a few unique keys per gang\n");
+
+WARM_UP_RUN();
+
+#define TABLE_SIZE 64
+// {period of the keys, number of elements}
+#define ARGS ArgNames({"unique", "count"})->ArgsProduct({{1, 2, 4, 64}, {8192}})
+
+template <typename T> static void init(int *keys, T *table, T *dst, int period, int count) {
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        table[i] = static_cast<T>(i % 32);
+    }
+    for (int i = 0; i < count; i++) {
+        keys[i] = (i % period) * (TABLE_SIZE / period);
+        dst[i] = 0;
+    }
+}
+
+template <typename T> static void check(int *keys, T *table, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        T expected = static_cast<T>(table[keys[i]] * static_cast<T>(3));
+        if (dst[i] != expected) {
+            printf("Error at i=%d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T> static void foreach_unique_bench(benchmark::State &state, void (*func)(int *, T *, T *, int)) {
+    const int period = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(1));
+    int *keys = static_cast<int *>(aligned_alloc_helper(sizeof(int) * count));
+    T *table = static_cast<T *>(aligned_alloc_helper(sizeof(T) * TABLE_SIZE));
+    T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    init(keys, table, dst, period, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(keys, table, dst, count);
+    }
+    perf.Stop();
+    check(keys, table, dst, count);
+    aligned_free_helper(keys);
+    aligned_free_helper(table);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define FOREACH_UNIQUE_BENCH(NAME, T_C, T_ISPC)                                                                        \
+    static void NAME##_##T_ISPC(benchmark::State &state) { foreach_unique_bench<T_C>(state, ispc::NAME##_##T_ISPC); } \
+    BENCHMARK(NAME##_##T_ISPC)->ARGS;
+
+#define FOREACH_UNIQUE_BENCHES(T_C, T_ISPC)                                                                            \
+    FOREACH_UNIQUE_BENCH(foreach_unique, T_C, T_ISPC)                                                                  \
+    FOREACH_UNIQUE_BENCH(gather, T_C, T_ISPC)
+
+FOREACH_UNIQUE_BENCHES(int8_t, int8)
+FOREACH_UNIQUE_BENCHES(int16_t, int16)
+FOREACH_UNIQUE_BENCHES(int32_t, int32)
+FOREACH_UNIQUE_BENCHES(float, float)
+FOREACH_UNIQUE_BENCHES(int64_t, int64)
+FOREACH_UNIQUE_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,91 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <stdio.h>
+
+#include "../common.h"
+#include "13_foreach_active_ispc.h"
+
+static Docs docs("Check the performance of foreach_active.\n"
+                 "The kernel is a histogram of the values of the active elements, the updates of the bins are "
+                 "serialized over the active lanes with foreach_active or with a loop over the bits of lanemask().\n"
+                 "The active elements are: 0 - all, 1 - every other one, 2 - one of 64.\n"
+                 "[int8, int16, int32, float, int64, double] x [foreach_active, lanemask_loop] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - foreach_active is faster than lanemask_loop when a few lanes are active\n");
+
+WARM_UP_RUN();
+
+#define BINS 64
+// {active elements pattern, number of elements}
+#define ARGS ArgNames({"pattern", "count"})->ArgsProduct({{0, 1, 2}, {8192}})
+
+template <typename T> static void init(int *keys, T *values, bool *active, int pattern, int count) {
+    for (int i = 0; i < count; i++) {
+        keys[i] = (i * 7) % BINS;
+        values[i] = static_cast<T>(i % 3 + 1);
+        active[i] = pattern == 0 ? true : pattern == 1 ? (i % 2 == 0) : (i % 64 == 0);
+    }
+}
+
+template <typename T> static void check(int *keys, T *values, bool *active, T *hist, int count) {
+    T expected[BINS] = {};
+    for (int i = 0; i < count; i++) {
+        if (active[i]) {
+            expected[keys[i]] = static_cast<T>(expected[keys[i]] + values[i]);
+        }
+    }
+    for (int i = 0; i < BINS; i++) {
+        if (hist[i] != expected[i]) {
+            printf("Error at bin %d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T>
+static void foreach_active_bench(benchmark::State &state, void (*func)(int *, T *, bool *, T *, int)) {
+    const int pattern = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(1));
+    int *keys = static_cast<int *>(aligned_alloc_helper(sizeof(int) * count));
+    T *values = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    bool *active = static_cast<bool *>(aligned_alloc_helper(sizeof(bool) * count));
+    T *hist = static_cast<T *>(aligned_alloc_helper(sizeof(T) * BINS));
+    init(keys, values, active, pattern, count);
+    memset(hist, 0, sizeof(T) * BINS);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(keys, values, active, hist, count);
+    }
+    perf.Stop();
+    // The bins accumulate over the iterations, so the check uses a separate run.
+    memset(hist, 0, sizeof(T) * BINS);
+    func(keys, values, active, hist, count);
+    check(keys, values, active, hist, count);
+    aligned_free_helper(keys);
+    aligned_free_helper(values);
+    aligned_free_helper(active);
+    aligned_free_helper(hist);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define FOREACH_ACTIVE_BENCH(NAME, T_C, T_ISPC)                                                                        \
+    static void NAME##_##T_ISPC(benchmark::State &state) { foreach_active_bench<T_C>(state, ispc::NAME##_##T_ISPC); } \
+    BENCHMARK(NAME##_##T_ISPC)->ARGS;
+
+#define FOREACH_ACTIVE_BENCHES(T_C, T_ISPC)                                                                            \
+    FOREACH_ACTIVE_BENCH(foreach_active, T_C, T_ISPC)                                                                  \
+    FOREACH_ACTIVE_BENCH(lanemask_loop, T_C, T_ISPC)
+
+FOREACH_ACTIVE_BENCHES(int8_t, int8)
+FOREACH_ACTIVE_BENCHES(int16_t, int16)
+FOREACH_ACTIVE_BENCHES(int32_t, int32)
+FOREACH_ACTIVE_BENCHES(float, float)
+FOREACH_ACTIVE_BENCHES(int64_t, int64)
+FOREACH_ACTIVE_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,105 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <stdio.h>
+
+#include "../common.h"
+#include "14_gather_scatter_ispc.h"
+
+static Docs docs("Check the performance of gathers and scatters with different index patterns.\n"
+                 "The kernels are dst[i] = src[index[i]] and dst[index[i]] = src[i], the patterns of the indices "
+                 "are:\n"
+                 " - 0: linear, index[i] = i\n"
+                 " - 1: strided, consecutive elements are 16 elements apart\n"
+                 " - 2: random permutation\n"
+                 " - 3: broadcast, 64 consecutive elements have the same index (gather only)\n"
+                 "[int8, int16, int32, float, int64, double] x [gather, scatter] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+#define STRIDE 16
+// 8K elements fit L1 and 1M don't fit L2.
+#define GATHER_ARGS ArgNames({"pattern", "count"})->ArgsProduct({{0, 1, 2, 3}, {8192, 1 << 20}})
+// The scatter patterns must be permutations, so that the result doesn't depend on the order of the stores.
+#define SCATTER_ARGS ArgNames({"pattern", "count"})->ArgsProduct({{0, 1, 2}, {8192, 1 << 20}})
+
+static void init_index(int *index, int pattern, int count) {
+    for (int i = 0; i < count; i++) {
+        switch (pattern) {
+        case 1:
+            // A permutation as count is a multiple of STRIDE.
+            index[i] = (i * STRIDE) % count + (i * STRIDE) / count;
+            break;
+        case 3:
+            index[i] = i & ~63;
+            break;
+        default:
+            index[i] = i;
+        }
+    }
+    if (pattern == 2) {
+        std::shuffle(index, index + count, std::mt19937(42));
+    }
+}
+
+template <typename T> static void init(T *src, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        src[i] = static_cast<T>(i % 32);
+        dst[i] = 0;
+    }
+}
+
+template <typename T> static void check(int *index, T *src, T *dst, int count, bool gather) {
+    for (int i = 0; i < count; i++) {
+        if (gather ? dst[i] != src[index[i]] : dst[index[i]] != src[i]) {
+            printf("Error at i=%d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T>
+static void gather_scatter_bench(benchmark::State &state, void (*func)(int *, T *, T *, int), bool gather) {
+    const int pattern = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(1));
+    int *index = static_cast<int *>(aligned_alloc_helper(sizeof(int) * count));
+    T *src = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    init_index(index, pattern, count);
+    init(src, dst, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(index, src, dst, count);
+    }
+    perf.Stop();
+    check(index, src, dst, count, gather);
+    aligned_free_helper(index);
+    aligned_free_helper(src);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define GATHER_SCATTER_BENCHES(T_C, T_ISPC)                                                                            \
+    static void gather_##T_ISPC(benchmark::State &state) {                                                             \
+        gather_scatter_bench<T_C>(state, ispc::gather_##T_ISPC, true);                                                 \
+    }                                                                                                                  \
+    BENCHMARK(gather_##T_ISPC)->GATHER_ARGS;                                                                           \
+    static void scatter_##T_ISPC(benchmark::State &state) {                                                            \
+        gather_scatter_bench<T_C>(state, ispc::scatter_##T_ISPC, false);                                               \
+    }                                                                                                                  \
+    BENCHMARK(scatter_##T_ISPC)->SCATTER_ARGS;
+
+GATHER_SCATTER_BENCHES(int8_t, int8)
+GATHER_SCATTER_BENCHES(int16_t, int16)
+GATHER_SCATTER_BENCHES(int32_t, int32)
+GATHER_SCATTER_BENCHES(float, float)
+GATHER_SCATTER_BENCHES(int64_t, int64)
+GATHER_SCATTER_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,82 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <stdio.h>
+
+#include "../common.h"
+#include "15_select_ispc.h"
+
+static Docs docs("Check the performance of select() vs the conditional operator vs if/else.\n"
+                 "The kernel is dst[i] = a[i] > b[i] ? a[i] * 2 : b[i] + 1, the condition is:\n"
+                 " - 0: always true\n"
+                 " - 1: true for every other element\n"
+                 " - 2: random\n"
+                 "[int8, int16, int32, float, int64, double] x [select, ternary, if_else] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - select and ternary have the same performance, which doesn't depend on the condition\n");
+
+WARM_UP_RUN();
+
+// {condition pattern, number of elements}
+#define ARGS ArgNames({"pattern", "count"})->ArgsProduct({{0, 1, 2}, {8192}})
+
+template <typename T> static void init(T *a, T *b, T *dst, int pattern, int count) {
+    std::mt19937 gen(42);
+    for (int i = 0; i < count; i++) {
+        bool cond = pattern == 0 ? true : pattern == 1 ? (i % 2 == 0) : (gen() & 1);
+        a[i] = static_cast<T>(i % 32 + 1);
+        b[i] = cond ? static_cast<T>(i % 32) : static_cast<T>(i % 32 + 2);
+        dst[i] = 0;
+    }
+}
+
+template <typename T> static void check(T *a, T *b, T *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        T expected = a[i] > b[i] ? static_cast<T>(a[i] * 2) : static_cast<T>(b[i] + 1);
+        if (dst[i] != expected) {
+            printf("Error at i=%d\n", i);
+            return;
+        }
+    }
+}
+
+template <typename T> static void select_bench(benchmark::State &state, void (*func)(T *, T *, T *, int)) {
+    const int pattern = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(1));
+    T *a = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    T *b = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    T *dst = static_cast<T *>(aligned_alloc_helper(sizeof(T) * count));
+    init(a, b, dst, pattern, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(a, b, dst, count);
+    }
+    perf.Stop();
+    check(a, b, dst, count);
+    aligned_free_helper(a);
+    aligned_free_helper(b);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+#define SELECT_BENCH(NAME, T_C, T_ISPC)                                                                                \
+    static void NAME##_##T_ISPC(benchmark::State &state) { select_bench<T_C>(state, ispc::NAME##_##T_ISPC); }         \
+    BENCHMARK(NAME##_##T_ISPC)->ARGS;
+
+#define SELECT_BENCHES(T_C, T_ISPC)                                                                                    \
+    SELECT_BENCH(select, T_C, T_ISPC)                                                                                  \
+    SELECT_BENCH(ternary, T_C, T_ISPC)                                                                                 \
+    SELECT_BENCH(if_else, T_C, T_ISPC)
+
+SELECT_BENCHES(int8_t, int8)
+SELECT_BENCHES(int16_t, int16)
+SELECT_BENCHES(int32_t, int32)
+SELECT_BENCHES(float, float)
+SELECT_BENCHES(int64_t, int64)
+SELECT_BENCHES(double, double)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdint>
+#include <stdio.h>
+
+#include "../common.h"
+#include "16_short_vector_ispc.h"
+
+static Docs docs("Check the performance of float<3> code: swizzles, component writes and non-inlined\n"
+                 "functions with float<3> parameters and results.\n"
+                 "[short_vector, scalar] versions, where scalar is the same code with separate floats.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - short_vector is as fast as scalar\n");
+
+WARM_UP_RUN();
+
+// Number of float<3> elements
+#define ARGS Arg(8192)
+
+static void init(float *dirs, float *normals, float *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        dirs[3 * i] = static_cast<float>(i % 7) - 3;
+        dirs[3 * i + 1] = static_cast<float>(i % 5) - 2;
+        dirs[3 * i + 2] = 1;
+        normals[3 * i] = 0;
+        normals[3 * i + 1] = static_cast<float>(i % 2);
+        normals[3 * i + 2] = static_cast<float>(1 - i % 2);
+    }
+    for (int i = 0; i < 3 * count; i++) {
+        dst[i] = 0;
+    }
+}
+
+static void check(float *dirs, float *normals, float *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        const float *d = dirs + 3 * i, *n = normals + 3 * i;
+        float t[3] = {n[1] * d[2] - n[2] * d[1], n[2] * d[0] - n[0] * d[2], n[0] * d[1] - n[1] * d[0]};
+        float k = 2 * (d[0] * n[0] + d[1] * n[1] + d[2] * n[2]);
+        float r[3] = {d[0] - k * n[0], std::fmax(d[1] - k * n[1], 0.f), d[2] - k * n[2]};
+        float expected[3] = {r[0] + t[2] * 0.5f, r[1] + t[0] * 0.5f, r[2] + t[1] * 0.5f};
+        for (int j = 0; j < 3; j++) {
+            if (std::fabs(dst[3 * i + j] - expected[j]) > 1e-4f) {
+                printf("Error at i=%d\n", i);
+                return;
+            }
+        }
+    }
+}
+
+static void bench(benchmark::State &state, void (*func)(float *, float *, float *, int)) {
+    const int count = static_cast<int>(state.range(0));
+    float *dirs = static_cast<float *>(aligned_alloc_helper(sizeof(float) * 3 * count));
+    float *normals = static_cast<float *>(aligned_alloc_helper(sizeof(float) * 3 * count));
+    float *dst = static_cast<float *>(aligned_alloc_helper(sizeof(float) * 3 * count));
+    init(dirs, normals, dst, count);
+    PerfCounters perf(state);
+    for (auto _ : state) {
+        func(dirs, normals, dst, count);
+    }
+    perf.Stop();
+    check(dirs, normals, dst, count);
+    aligned_free_helper(dirs);
+    aligned_free_helper(normals);
+    aligned_free_helper(dst);
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void short_vector(benchmark::State &state) { bench(state, ispc::short_vector); }
+BENCHMARK(short_vector)->ARGS;
+
+static void scalar(benchmark::State &state) { bench(state, ispc::scalar); }
+BENCHMARK(scalar)->ARGS;
+
+BENCHMARK_MAIN();
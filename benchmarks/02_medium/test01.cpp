@@ -47,9 +47,11 @@ static void test01_1(benchmark::State &state) {
     FVector *dst = new FVector[count];
     init(dst, src0, src1, count);
 
+    PerfCounters perf(state);
     for (auto _ : state) {
         TestUniform1(dst, src0, src1, count);
     }
+    perf.Stop();
 
     check(dst, src0, src1, count);
     delete[] src0;
@@ -65,9 +67,11 @@ static void test01_2(benchmark::State &state) {
     FVector *dst = new FVector[count];
     init(dst, src0, src1, count);
 
+    PerfCounters perf(state);
     for (auto _ : state) {
         TestUniform2(dst, src0, src1, count);
     }
+    perf.Stop();
 
     check(dst, src0, src1, count);
     delete[] src0;
@@ -83,9 +87,11 @@ static void test01_3(benchmark::State &state) {
     FVector *dst = new FVector[count];
     init(dst, src0, src1, count);
 
+    PerfCounters perf(state);
     for (auto _ : state) {
         TestUniform3(dst, src0, src1, count);
     }
+    perf.Stop();
 
     check(dst, src0, src1, count);
     delete[] src0;
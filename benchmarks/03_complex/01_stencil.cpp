@@ -0,0 +1,107 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+
+#include "../common.h"
+#include "01_stencil_ispc.h"
+
+static Docs docs("Stencil sweep: one time step of the 3D wave equation with a 25 points stencil, lifted from "
+                 "examples/cpu/stencil.\n"
+                 "The kernel is dominated by unaligned vector loads with constant offsets along x and strided ones "
+                 "along y and z.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - ISPC version is faster than C++ one\n");
+
+WARM_UP_RUN();
+
+// N^3 floats: 128 KB, 1 MB and 8 MB per buffer.
+#define ARGS Arg(32)->Arg(64)->Arg(128)
+
+static void stencil_step_cpp(int N, const float coef[4], const float vsq[], const float Ain[], float Aout[]) {
+    const int Nxy = N * N;
+    for (int z = 3; z < N - 3; z++) {
+        for (int y = 3; y < N - 3; y++) {
+            for (int x = 3; x < N - 3; x++) {
+                int index = (z * Nxy) + (y * N) + x;
+#define A_cur(x, y, z) Ain[index + (x) + ((y)*N) + ((z)*Nxy)]
+#define A_next(x, y, z) Aout[index + (x) + ((y)*N) + ((z)*Nxy)]
+                float div = coef[0] * A_cur(0, 0, 0) +
+                            coef[1] * (A_cur(+1, 0, 0) + A_cur(-1, 0, 0) + A_cur(0, +1, 0) + A_cur(0, -1, 0) +
+                                       A_cur(0, 0, +1) + A_cur(0, 0, -1)) +
+                            coef[2] * (A_cur(+2, 0, 0) + A_cur(-2, 0, 0) + A_cur(0, +2, 0) + A_cur(0, -2, 0) +
+                                       A_cur(0, 0, +2) + A_cur(0, 0, -2)) +
+                            coef[3] * (A_cur(+3, 0, 0) + A_cur(-3, 0, 0) + A_cur(0, +3, 0) + A_cur(0, -3, 0) +
+                                       A_cur(0, 0, +3) + A_cur(0, 0, -3));
+
+                A_next(0, 0, 0) = 2 * A_cur(0, 0, 0) - A_next(0, 0, 0) + vsq[index] * div;
+#undef A_cur
+#undef A_next
+            }
+        }
+    }
+}
+
+static const float coef[4] = {0.5f, -0.25f, 0.125f, -0.0625f};
+
+static void init(float *vsq, float *Ain, float *Aout, int N) {
+    for (int z = 0; z < N; z++) {
+        for (int y = 0; y < N; y++) {
+            for (int x = 0; x < N; x++) {
+                int index = (z * N + y) * N + x;
+                vsq[index] = 0.1f + 0.001f * (x + y + z);
+                Ain[index] = std::sin(0.1f * x) * std::cos(0.2f * y) + 0.01f * z;
+                Aout[index] = 0.0f;
+            }
+        }
+    }
+}
+
+static void check(float *vsq, float *Ain, float *Aout, int N) {
+    size_t size = static_cast<size_t>(N) * N * N;
+    float *ref = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size));
+    for (size_t i = 0; i < size; i++) {
+        Aout[i] = ref[i] = 0.0f;
+    }
+    ispc::stencil_step(N, coef, vsq, Ain, Aout);
+    stencil_step_cpp(N, coef, vsq, Ain, ref);
+    for (size_t i = 0; i < size; i++) {
+        if (std::abs(Aout[i] - ref[i]) > 1e-5f * (1.0f + std::abs(ref[i]))) {
+            printf("Error i=%zu: %f != %f\n", i, Aout[i], ref[i]);
+            break;
+        }
+    }
+    aligned_free_helper(ref);
+}
+
+#define STENCIL_BENCH(IMPL, FUNC)                                                                                      \
+    static void stencil_##IMPL(benchmark::State &state) {                                                              \
+        int N = static_cast<int>(state.range(0));                                                                      \
+        size_t size = static_cast<size_t>(N) * N * N;                                                                  \
+        float *vsq = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size));                                 \
+        float *Ain = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size));                                 \
+        float *Aout = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size));                                \
+        init(vsq, Ain, Aout, N);                                                                                       \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(N, coef, vsq, Ain, Aout);                                                                             \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(vsq, Ain, Aout, N);                                                                                      \
+        state.SetItemsProcessed(state.iterations() * (N - 6) * (N - 6) * (N - 6));                                     \
+        aligned_free_helper(vsq);                                                                                      \
+        aligned_free_helper(Ain);                                                                                      \
+        aligned_free_helper(Aout);                                                                                     \
+    }                                                                                                                  \
+    BENCHMARK(stencil_##IMPL)->ARGS;
+
+STENCIL_BENCH(ispc, ispc::stencil_step)
+STENCIL_BENCH(cpp, stencil_step_cpp)
+
+BENCHMARK_MAIN();
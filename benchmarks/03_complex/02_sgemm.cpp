@@ -0,0 +1,85 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <stdio.h>
+
+#include "../common.h"
+#include "02_sgemm_ispc.h"
+
+static Docs docs("SGEMM with register tiling: every gang computes 4 rows x programCount columns of C.\n"
+                 "The kernel relies on the broadcasts of uniform loads, vector loads and the accumulators kept "
+                 "in registers.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - ISPC version is faster than C++ one\n");
+
+WARM_UP_RUN();
+
+// Square matrices: 16 KB, 64 KB and 256 KB per matrix.
+#define ARGS Arg(64)->Arg(128)->Arg(256)
+
+static void sgemm_cpp(const float A[], const float B[], float C[], int M, int N, int K) {
+    for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+            C[i * N + j] = 0.0f;
+        }
+        for (int k = 0; k < K; k++) {
+            float a = A[i * K + k];
+            for (int j = 0; j < N; j++) {
+                C[i * N + j] += a * B[k * N + j];
+            }
+        }
+    }
+}
+
+static void init(float *A, float *B, float *C, int N) {
+    for (int i = 0; i < N * N; i++) {
+        A[i] = static_cast<float>((i * 7) % 13) / 13.0f - 0.5f;
+        B[i] = static_cast<float>((i * 5) % 11) / 11.0f - 0.5f;
+        C[i] = 0.0f;
+    }
+}
+
+static void check(float *A, float *B, float *C, int N) {
+    float *ref = static_cast<float *>(aligned_alloc_helper(sizeof(float) * N * N));
+    ispc::sgemm(A, B, C, N, N, N);
+    sgemm_cpp(A, B, ref, N, N, N);
+    for (int i = 0; i < N * N; i++) {
+        if (std::abs(C[i] - ref[i]) > 1e-4f * N) {
+            printf("Error i=%d: %f != %f\n", i, C[i], ref[i]);
+            break;
+        }
+    }
+    aligned_free_helper(ref);
+}
+
+#define SGEMM_BENCH(IMPL, FUNC)                                                                                        \
+    static void sgemm_##IMPL(benchmark::State &state) {                                                                \
+        int N = static_cast<int>(state.range(0));                                                                      \
+        float *A = static_cast<float *>(aligned_alloc_helper(sizeof(float) * N * N));                                  \
+        float *B = static_cast<float *>(aligned_alloc_helper(sizeof(float) * N * N));                                  \
+        float *C = static_cast<float *>(aligned_alloc_helper(sizeof(float) * N * N));                                  \
+        init(A, B, C, N);                                                                                              \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(A, B, C, N, N, N);                                                                                    \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(A, B, C, N);                                                                                             \
+        state.counters["flops"] = benchmark::Counter(2.0 * N * N * N * state.iterations(),                             \
+                                                     benchmark::Counter::kIsRate);                                     \
+        aligned_free_helper(A);                                                                                        \
+        aligned_free_helper(B);                                                                                        \
+        aligned_free_helper(C);                                                                                        \
+    }                                                                                                                  \
+    BENCHMARK(sgemm_##IMPL)->ARGS;
+
+SGEMM_BENCH(ispc, ispc::sgemm)
+SGEMM_BENCH(cpp, sgemm_cpp)
+
+BENCHMARK_MAIN();
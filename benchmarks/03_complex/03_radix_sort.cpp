@@ -0,0 +1,99 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "03_radix_sort_ispc.h"
+
+static Docs docs("LSD radix sort of 32 bit keys with 8 bit digits, lifted from examples/cpu/sort.\n"
+                 "Every program instance sorts its own strip of the keys, the kernel is dominated by gathers and "
+                 "scatters to the per lane histograms and by the scatters of the keys.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n");
+
+WARM_UP_RUN();
+
+// 16 KB, 256 KB and 4 MB of keys.
+#define ARGS Arg(4096)->Arg(4096 << 4)->Arg(4096 << 8)
+
+#define RADIX 256
+// Room for the histograms of the widest target.
+#define MAX_WIDTH 64
+
+static void radix_sort_cpp(int n, const uint32_t src[], uint32_t keys[], uint32_t temp[], int hist[]) {
+    const uint32_t *from = src;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t *to = (shift / 8) % 2 == 0 ? temp : keys;
+        for (int d = 0; d < RADIX; d++) {
+            hist[d] = 0;
+        }
+        for (int k = 0; k < n; k++) {
+            hist[(from[k] >> shift) & (RADIX - 1)]++;
+        }
+        int sum = 0;
+        for (int d = 0; d < RADIX; d++) {
+            int count = hist[d];
+            hist[d] = sum;
+            sum += count;
+        }
+        for (int k = 0; k < n; k++) {
+            uint32_t key = from[k];
+            to[hist[(key >> shift) & (RADIX - 1)]++] = key;
+        }
+        from = to;
+    }
+}
+
+static void init(uint32_t *src, int n) {
+    std::mt19937 gen(42);
+    for (int i = 0; i < n; i++) {
+        src[i] = static_cast<uint32_t>(gen());
+    }
+}
+
+static void check(const uint32_t *src, const uint32_t *keys, int n) {
+    std::vector<uint32_t> ref(src, src + n);
+    std::sort(ref.begin(), ref.end());
+    for (int i = 0; i < n; i++) {
+        if (keys[i] != ref[i]) {
+            printf("Error i=%d: %u != %u\n", i, keys[i], ref[i]);
+            return;
+        }
+    }
+}
+
+#define RADIX_SORT_BENCH(IMPL, FUNC)                                                                                   \
+    static void radix_sort_##IMPL(benchmark::State &state) {                                                           \
+        int n = static_cast<int>(state.range(0));                                                                      \
+        uint32_t *src = static_cast<uint32_t *>(aligned_alloc_helper(sizeof(uint32_t) * n));                           \
+        uint32_t *keys = static_cast<uint32_t *>(aligned_alloc_helper(sizeof(uint32_t) * n));                          \
+        uint32_t *temp = static_cast<uint32_t *>(aligned_alloc_helper(sizeof(uint32_t) * n));                          \
+        int *hist = static_cast<int *>(aligned_alloc_helper(sizeof(int) * RADIX * MAX_WIDTH));                         \
+        init(src, n);                                                                                                  \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(n, src, keys, temp, hist);                                                                            \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(src, keys, n);                                                                                           \
+        state.SetItemsProcessed(state.iterations() * n);                                                               \
+        aligned_free_helper(src);                                                                                      \
+        aligned_free_helper(keys);                                                                                     \
+        aligned_free_helper(temp);                                                                                     \
+        aligned_free_helper(hist);                                                                                     \
+    }                                                                                                                  \
+    BENCHMARK(radix_sort_##IMPL)->ARGS;
+
+RADIX_SORT_BENCH(ispc, ispc::radix_sort)
+RADIX_SORT_BENCH(cpp, radix_sort_cpp)
+
+BENCHMARK_MAIN();
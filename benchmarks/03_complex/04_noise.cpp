@@ -0,0 +1,138 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdio.h>
+
+#include "../common.h"
+#include "04_noise_ispc.h"
+
+static Docs docs("Perlin noise turbulence with 8 octaves, lifted from examples/cpu/noise.\n"
+                 "The kernel mixes arithmetic, floor() and dependent gathers from the permutation table.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - ISPC version is faster than C++ one\n");
+
+WARM_UP_RUN();
+
+// Square images of 64x64, 256x256 and 512x512 pixels.
+#define ARGS Arg(64)->Arg(256)->Arg(512)
+
+#define NOISE_PERM_SIZE 256
+#define OCTAVES 8
+
+static inline float Grad(const int perm[], int x, int y, int z, float dx, float dy, float dz) {
+    int h = perm[perm[perm[x] + y] + z];
+    h &= 15;
+    float u = h < 8 || h == 12 || h == 13 ? dx : dy;
+    float v = h < 4 || h == 12 || h == 13 ? dy : dz;
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+static inline float NoiseWeight(float t) {
+    float t3 = t * t * t;
+    float t4 = t3 * t;
+    return 6.f * t4 * t - 15.f * t4 + 10.f * t3;
+}
+
+static inline float Lerp(float t, float low, float high) { return (1.f - t) * low + t * high; }
+
+static float Noise(const int perm[], float x, float y, float z) {
+    int ix = static_cast<int>(std::floor(x));
+    int iy = static_cast<int>(std::floor(y));
+    int iz = static_cast<int>(std::floor(z));
+    float dx = x - ix, dy = y - iy, dz = z - iz;
+
+    ix &= (NOISE_PERM_SIZE - 1);
+    iy &= (NOISE_PERM_SIZE - 1);
+    iz &= (NOISE_PERM_SIZE - 1);
+    float w000 = Grad(perm, ix, iy, iz, dx, dy, dz);
+    float w100 = Grad(perm, ix + 1, iy, iz, dx - 1, dy, dz);
+    float w010 = Grad(perm, ix, iy + 1, iz, dx, dy - 1, dz);
+    float w110 = Grad(perm, ix + 1, iy + 1, iz, dx - 1, dy - 1, dz);
+    float w001 = Grad(perm, ix, iy, iz + 1, dx, dy, dz - 1);
+    float w101 = Grad(perm, ix + 1, iy, iz + 1, dx - 1, dy, dz - 1);
+    float w011 = Grad(perm, ix, iy + 1, iz + 1, dx, dy - 1, dz - 1);
+    float w111 = Grad(perm, ix + 1, iy + 1, iz + 1, dx - 1, dy - 1, dz - 1);
+
+    float wx = NoiseWeight(dx), wy = NoiseWeight(dy), wz = NoiseWeight(dz);
+    float x00 = Lerp(wx, w000, w100);
+    float x10 = Lerp(wx, w010, w110);
+    float x01 = Lerp(wx, w001, w101);
+    float x11 = Lerp(wx, w011, w111);
+    float y0 = Lerp(wy, x00, x10);
+    float y1 = Lerp(wy, x01, x11);
+    return Lerp(wz, y0, y1);
+}
+
+static float Turbulence(const int perm[], float x, float y, float z, int octaves) {
+    float sum = 0.f, lambda = 1.f, o = 1.f;
+    for (int i = 0; i < octaves; ++i) {
+        sum += std::abs(o * Noise(perm, lambda * x, lambda * y, lambda * z));
+        lambda *= 1.99f;
+        o *= 0.6f;
+    }
+    return sum * 0.5f;
+}
+
+static void noise_cpp(const int perm[], float x0, float y0, float x1, float y1, int width, int height, int octaves,
+                      float output[]) {
+    float dx = (x1 - x0) / width;
+    float dy = (y1 - y0) / height;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            float x = x0 + i * dx;
+            float y = y0 + j * dy;
+            output[j * width + i] = Turbulence(perm, x, y, 0.6f, octaves);
+        }
+    }
+}
+
+static void init(int *perm) {
+    std::iota(perm, perm + NOISE_PERM_SIZE, 0);
+    std::shuffle(perm, perm + NOISE_PERM_SIZE, std::mt19937(42));
+    std::copy(perm, perm + NOISE_PERM_SIZE, perm + NOISE_PERM_SIZE);
+}
+
+static void check(const int *perm, float *output, int size) {
+    float *ref = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size * size));
+    ispc::noise(perm, -10.f, -10.f, 10.f, 10.f, size, size, OCTAVES, output);
+    noise_cpp(perm, -10.f, -10.f, 10.f, 10.f, size, size, OCTAVES, ref);
+    for (int i = 0; i < size * size; i++) {
+        if (std::abs(output[i] - ref[i]) > 1e-4f) {
+            printf("Error i=%d: %f != %f\n", i, output[i], ref[i]);
+            break;
+        }
+    }
+    aligned_free_helper(ref);
+}
+
+#define NOISE_BENCH(IMPL, FUNC)                                                                                        \
+    static void noise_##IMPL(benchmark::State &state) {                                                                \
+        int size = static_cast<int>(state.range(0));                                                                   \
+        int *perm = static_cast<int *>(aligned_alloc_helper(sizeof(int) * 2 * NOISE_PERM_SIZE));                       \
+        float *output = static_cast<float *>(aligned_alloc_helper(sizeof(float) * size * size));                      \
+        init(perm);                                                                                                    \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(perm, -10.f, -10.f, 10.f, 10.f, size, size, OCTAVES, output);                                         \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(perm, output, size);                                                                                     \
+        state.SetItemsProcessed(state.iterations() * size * size);                                                     \
+        aligned_free_helper(perm);                                                                                     \
+        aligned_free_helper(output);                                                                                   \
+    }                                                                                                                  \
+    BENCHMARK(noise_##IMPL)->ARGS;
+
+NOISE_BENCH(ispc, ispc::noise)
+NOISE_BENCH(cpp, noise_cpp)
+
+BENCHMARK_MAIN();
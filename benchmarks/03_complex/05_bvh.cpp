@@ -0,0 +1,248 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+#include "../common.h"
+#include "05_bvh_ispc.h"
+
+static Docs docs("Packet traversal of a BVH of random triangles, lifted from examples/cpu/rt.\n"
+                 "A ray per pixel of a 256x256 image, the gang shares the traversal stack.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - ISPC version is faster than C++ one\n");
+
+WARM_UP_RUN();
+
+// The number of triangles in the scene.
+#define ARGS Arg(1024)->Arg(16384)->Arg(131072)
+
+#define XRES 256
+#define YRES 256
+#define LEAF_SIZE 4
+
+using ispc::LinearBVHNode;
+using ispc::Triangle;
+
+struct Ray {
+    float origin[3], dir[3], invDir[3];
+    unsigned int dirIsNeg[3];
+    float mint, maxt;
+    int hitId;
+};
+
+static inline float Dot(const float a[3], const float b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+static inline void Cross(const float v1[3], const float v2[3], float ret[3]) {
+    ret[0] = (v1[1] * v2[2]) - (v1[2] * v2[1]);
+    ret[1] = (v1[2] * v2[0]) - (v1[0] * v2[2]);
+    ret[2] = (v1[0] * v2[1]) - (v1[1] * v2[0]);
+}
+
+static inline bool BBoxIntersect(const float bounds[2][3], const Ray &ray) {
+    float t0 = ray.mint, t1 = ray.maxt;
+    for (int a = 0; a < 3; a++) {
+        float tNear = (bounds[0][a] - ray.origin[a]) * ray.invDir[a];
+        float tFar = (bounds[1][a] - ray.origin[a]) * ray.invDir[a];
+        t0 = std::max(t0, std::min(tNear, tFar));
+        t1 = std::min(t1, std::max(tNear, tFar));
+    }
+    return t0 <= t1;
+}
+
+static inline void TriIntersect(const Triangle &tri, Ray &ray) {
+    float e1[3], e2[3], s1[3], s2[3], d[3];
+    for (int a = 0; a < 3; a++) {
+        e1[a] = tri.p[1][a] - tri.p[0][a];
+        e2[a] = tri.p[2][a] - tri.p[0][a];
+        d[a] = ray.origin[a] - tri.p[0][a];
+    }
+
+    Cross(ray.dir, e2, s1);
+    float divisor = Dot(s1, e1);
+    float invDivisor = 1.f / divisor;
+
+    float b1 = Dot(d, s1) * invDivisor;
+    Cross(d, e1, s2);
+    float b2 = Dot(ray.dir, s2) * invDivisor;
+    float t = Dot(e2, s2) * invDivisor;
+
+    if (divisor != 0.f && b1 >= 0.f && b1 <= 1.f && b2 >= 0.f && b1 + b2 <= 1.f && t >= ray.mint && t <= ray.maxt) {
+        ray.maxt = t;
+        ray.hitId = tri.id;
+    }
+}
+
+static void BVHIntersect(const LinearBVHNode nodes[], const Triangle tris[], Ray &ray) {
+    int todoOffset = 0, nodeNum = 0;
+    int todo[64];
+
+    while (true) {
+        const LinearBVHNode &node = nodes[nodeNum];
+        if (BBoxIntersect(node.bounds, ray)) {
+            if (node.nPrimitives > 0) {
+                for (unsigned int i = 0; i < node.nPrimitives; ++i)
+                    TriIntersect(tris[node.offset + i], ray);
+                if (todoOffset == 0)
+                    break;
+                nodeNum = todo[--todoOffset];
+            } else {
+                if (ray.dirIsNeg[node.splitAxis]) {
+                    todo[todoOffset++] = nodeNum + 1;
+                    nodeNum = node.offset;
+                } else {
+                    todo[todoOffset++] = node.offset;
+                    nodeNum = nodeNum + 1;
+                }
+            }
+        } else {
+            if (todoOffset == 0)
+                break;
+            nodeNum = todo[--todoOffset];
+        }
+    }
+}
+
+static void bvh_intersect_cpp(const LinearBVHNode nodes[], const Triangle tris[], int xres, int yres, float hitT[],
+                              int hitId[]) {
+    for (int y = 0; y < yres; y++) {
+        for (int x = 0; x < xres; x++) {
+            Ray ray;
+            ray.origin[0] = 0.f;
+            ray.origin[1] = 0.f;
+            ray.origin[2] = -3.f;
+            ray.dir[0] = 2.f * (x + 0.5f) / xres - 1.f;
+            ray.dir[1] = 2.f * (y + 0.5f) / yres - 1.f;
+            ray.dir[2] = 1.5f;
+            for (int a = 0; a < 3; a++) {
+                ray.invDir[a] = 1.f / ray.dir[a];
+                ray.dirIsNeg[a] = ray.invDir[a] < 0 ? 1 : 0;
+            }
+            ray.mint = 0.f;
+            ray.maxt = 1e30f;
+            ray.hitId = -1;
+
+            BVHIntersect(nodes, tris, ray);
+
+            hitT[y * xres + x] = ray.maxt;
+            hitId[y * xres + x] = ray.hitId;
+        }
+    }
+}
+
+static float centroid(const Triangle &tri, int axis) { return tri.p[0][axis] + tri.p[1][axis] + tri.p[2][axis]; }
+
+// Build the nodes of tris[begin, end) depth-first, splitting at the median
+// centroid along the longest axis of the bounds, and return the index of
+// the root node.
+static int buildBVH(std::vector<LinearBVHNode> &nodes, Triangle *tris, int begin, int end) {
+    LinearBVHNode node = {};
+    for (int a = 0; a < 3; a++) {
+        node.bounds[0][a] = INFINITY;
+        node.bounds[1][a] = -INFINITY;
+    }
+    for (int i = begin; i < end; i++) {
+        for (int v = 0; v < 3; v++) {
+            for (int a = 0; a < 3; a++) {
+                node.bounds[0][a] = std::min(node.bounds[0][a], tris[i].p[v][a]);
+                node.bounds[1][a] = std::max(node.bounds[1][a], tris[i].p[v][a]);
+            }
+        }
+    }
+
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(node);
+    if (end - begin <= LEAF_SIZE) {
+        nodes[index].offset = begin;
+        nodes[index].nPrimitives = static_cast<uint8_t>(end - begin);
+        return index;
+    }
+
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (node.bounds[1][a] - node.bounds[0][a] > node.bounds[1][axis] - node.bounds[0][axis])
+            axis = a;
+    }
+    int mid = (begin + end) / 2;
+    std::nth_element(tris + begin, tris + mid, tris + end,
+                     [axis](const Triangle &a, const Triangle &b) { return centroid(a, axis) < centroid(b, axis); });
+
+    buildBVH(nodes, tris, begin, mid);
+    nodes[index].offset = buildBVH(nodes, tris, mid, end);
+    nodes[index].splitAxis = static_cast<uint8_t>(axis);
+    return index;
+}
+
+// Small random triangles in the [-1, 1] cube.
+static std::vector<LinearBVHNode> init(Triangle *tris, int n) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> pos(-1.f, 1.f);
+    std::uniform_real_distribution<float> size(-0.05f, 0.05f);
+    for (int i = 0; i < n; i++) {
+        Triangle &tri = tris[i];
+        tri = {};
+        float c[3] = {pos(gen), pos(gen), pos(gen)};
+        for (int v = 0; v < 3; v++) {
+            for (int a = 0; a < 3; a++)
+                tri.p[v][a] = c[a] + size(gen);
+        }
+        tri.id = i;
+    }
+
+    std::vector<LinearBVHNode> nodes;
+    nodes.reserve(2 * n / LEAF_SIZE + 1);
+    buildBVH(nodes, tris, 0, n);
+    return nodes;
+}
+
+static void check(const LinearBVHNode *nodes, const Triangle *tris, float *hitT, int *hitId) {
+    float *refT = static_cast<float *>(aligned_alloc_helper(sizeof(float) * XRES * YRES));
+    int *refId = static_cast<int *>(aligned_alloc_helper(sizeof(int) * XRES * YRES));
+    ispc::bvh_intersect(nodes, tris, XRES, YRES, hitT, hitId);
+    bvh_intersect_cpp(nodes, tris, XRES, YRES, refT, refId);
+    // The packets may visit the triangles in another order than the single
+    // rays, so the ties between the triangles may be resolved differently.
+    int mismatches = 0;
+    for (int i = 0; i < XRES * YRES; i++) {
+        if (hitId[i] != refId[i] || std::abs(hitT[i] - refT[i]) > 1e-5f * refT[i])
+            mismatches++;
+    }
+    if (mismatches > XRES * YRES / 1000) {
+        printf("Error: %d pixels mismatch\n", mismatches);
+    }
+    aligned_free_helper(refT);
+    aligned_free_helper(refId);
+}
+
+#define BVH_BENCH(IMPL, FUNC)                                                                                          \
+    static void bvh_##IMPL(benchmark::State &state) {                                                                  \
+        int n = static_cast<int>(state.range(0));                                                                      \
+        Triangle *tris = static_cast<Triangle *>(aligned_alloc_helper(sizeof(Triangle) * n));                          \
+        float *hitT = static_cast<float *>(aligned_alloc_helper(sizeof(float) * XRES * YRES));                         \
+        int *hitId = static_cast<int *>(aligned_alloc_helper(sizeof(int) * XRES * YRES));                              \
+        std::vector<LinearBVHNode> nodes = init(tris, n);                                                              \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(nodes.data(), tris, XRES, YRES, hitT, hitId);                                                         \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(nodes.data(), tris, hitT, hitId);                                                                        \
+        state.SetItemsProcessed(state.iterations() * XRES * YRES);                                                     \
+        aligned_free_helper(tris);                                                                                     \
+        aligned_free_helper(hitT);                                                                                     \
+        aligned_free_helper(hitId);                                                                                    \
+    }                                                                                                                  \
+    BENCHMARK(bvh_##IMPL)->ARGS;
+
+BVH_BENCH(ispc, ispc::bvh_intersect)
+BVH_BENCH(cpp, bvh_intersect_cpp)
+
+BENCHMARK_MAIN();
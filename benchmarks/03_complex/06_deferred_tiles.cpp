@@ -0,0 +1,217 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+
+#include "../common.h"
+#include "06_deferred_tiles_ispc.h"
+
+static Docs docs("Tiled deferred shading of a 512x512 G-buffer, lifted from examples/cpu/deferred.\n"
+                 "Every 16x16 tile reduces its depth range, culls the lights packing the visible ones\n"
+                 "into a list with packed_store_active(), and shades its pixels with them.\n"
+                 "[ISPC, C++] versions.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - ISPC version is faster than C++ one\n");
+
+WARM_UP_RUN();
+
+// The number of lights.
+#define ARGS Arg(256)->Arg(1024)->Arg(4096)
+
+#define XRES 512
+#define YRES 512
+#define TILE_SIZE 16
+#define PROJ_11 1.5f
+#define PROJ_22 1.5f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.f
+
+struct GBuffer {
+    float *viewZ, *normalX, *normalY, *normalZ;
+};
+
+struct Lights {
+    int num;
+    float *x, *y, *z, *radius, *intensity;
+};
+
+static void ComputeZBounds(int tileStartX, int tileEndX, int tileStartY, int tileEndY, const float viewZ[], int xres,
+                           float &minZ, float &maxZ) {
+    minZ = CAMERA_FAR;
+    maxZ = CAMERA_NEAR;
+    for (int y = tileStartY; y < tileEndY; ++y) {
+        for (int x = tileStartX; x < tileEndX; ++x) {
+            float z = viewZ[y * xres + x];
+            if (z < CAMERA_FAR && z >= CAMERA_NEAR) {
+                minZ = std::min(minZ, z);
+                maxZ = std::max(maxZ, z);
+            }
+        }
+    }
+}
+
+static int CullLights(int tileStartX, int tileEndX, int tileStartY, int tileEndY, float minZ, float maxZ, int xres,
+                      int yres, int numLights, const float lightX[], const float lightY[], const float lightZ[],
+                      const float lightRadius[], int tileLights[]) {
+    float scaleX = 0.5f * xres;
+    float scaleY = 0.5f * yres;
+
+    float planesXY[4] = {-(PROJ_11 * scaleX), (PROJ_11 * scaleX), (PROJ_22 * scaleY), -(PROJ_22 * scaleY)};
+    float planesZ[4] = {tileEndX - scaleX, -tileStartX + scaleX, tileEndY - scaleY, -tileStartY + scaleY};
+    for (int i = 0; i < 4; ++i) {
+        float norm = 1.f / std::sqrt(planesXY[i] * planesXY[i] + planesZ[i] * planesZ[i]);
+        planesXY[i] *= norm;
+        planesZ[i] *= norm;
+    }
+
+    int tileNumLights = 0;
+    for (int lightIndex = 0; lightIndex < numLights; ++lightIndex) {
+        float x = lightX[lightIndex];
+        float y = lightY[lightIndex];
+        float z = lightZ[lightIndex];
+        float negRadius = -lightRadius[lightIndex];
+
+        bool inFrustum = z - minZ >= negRadius && maxZ - z >= negRadius;
+        inFrustum = inFrustum && z * planesZ[0] + x * planesXY[0] >= negRadius;
+        inFrustum = inFrustum && z * planesZ[1] + x * planesXY[1] >= negRadius;
+        inFrustum = inFrustum && z * planesZ[2] + y * planesXY[2] >= negRadius;
+        inFrustum = inFrustum && z * planesZ[3] + y * planesXY[3] >= negRadius;
+        if (inFrustum)
+            tileLights[tileNumLights++] = lightIndex;
+    }
+    return tileNumLights;
+}
+
+static void deferred_tiles_cpp(int xres, int yres, const GBuffer &gbuf, const Lights &lights, int tileLights[],
+                               float output[]) {
+    float scaleX = 0.5f * xres;
+    float scaleY = 0.5f * yres;
+
+    for (int tileStartY = 0; tileStartY < yres; tileStartY += TILE_SIZE) {
+        int tileEndY = std::min(tileStartY + TILE_SIZE, yres);
+        for (int tileStartX = 0; tileStartX < xres; tileStartX += TILE_SIZE) {
+            int tileEndX = std::min(tileStartX + TILE_SIZE, xres);
+
+            float minZ, maxZ;
+            ComputeZBounds(tileStartX, tileEndX, tileStartY, tileEndY, gbuf.viewZ, xres, minZ, maxZ);
+            int tileNumLights = CullLights(tileStartX, tileEndX, tileStartY, tileEndY, minZ, maxZ, xres, yres,
+                                           lights.num, lights.x, lights.y, lights.z, lights.radius, tileLights);
+
+            for (int y = tileStartY; y < tileEndY; ++y) {
+                for (int x = tileStartX; x < tileEndX; ++x) {
+                    int offset = y * xres + x;
+                    float z = gbuf.viewZ[offset];
+                    float px = ((x + 0.5f) / scaleX - 1.f) * z / PROJ_11;
+                    float py = (1.f - (y + 0.5f) / scaleY) * z / PROJ_22;
+                    float nx = gbuf.normalX[offset], ny = gbuf.normalY[offset], nz = gbuf.normalZ[offset];
+
+                    float lit = 0.f;
+                    for (int i = 0; i < tileNumLights; ++i) {
+                        int light = tileLights[i];
+                        float radius = lights.radius[light];
+                        float lx = lights.x[light] - px, ly = lights.y[light] - py, lz = lights.z[light] - z;
+                        float dist2 = lx * lx + ly * ly + lz * lz;
+                        if (dist2 < radius * radius) {
+                            float dist = std::sqrt(dist2);
+                            float nDotL = std::max((nx * lx + ny * ly + nz * lz) / dist, 0.f);
+                            lit += nDotL * (1.f - dist / radius) * lights.intensity[light];
+                        }
+                    }
+                    output[offset] = z < CAMERA_FAR && z >= CAMERA_NEAR ? lit : 0.f;
+                }
+            }
+        }
+    }
+}
+
+static void deferred_tiles_ispc(int xres, int yres, const GBuffer &gbuf, const Lights &lights, int tileLights[],
+                                float output[]) {
+    ispc::deferred_tiles(xres, yres, PROJ_11, PROJ_22, CAMERA_NEAR, CAMERA_FAR, gbuf.viewZ, gbuf.normalX,
+                         gbuf.normalY, gbuf.normalZ, lights.num, lights.x, lights.y, lights.z, lights.radius,
+                         lights.intensity, tileLights, output);
+}
+
+static float *alloc(int n) { return static_cast<float *>(aligned_alloc_helper(sizeof(float) * n)); }
+
+// A wavy surface with some background pixels, lit by random lights in the
+// view frustum.
+static void init(GBuffer &gbuf, Lights &lights, int numLights) {
+    gbuf = {alloc(XRES * YRES), alloc(XRES * YRES), alloc(XRES * YRES), alloc(XRES * YRES)};
+    for (int y = 0; y < YRES; y++) {
+        for (int x = 0; x < XRES; x++) {
+            int offset = y * XRES + x;
+            float sx = std::sin(x * 0.05f), cy = std::cos(y * 0.03f);
+            gbuf.viewZ[offset] = sx * cy > 0.9f ? CAMERA_FAR : 10.f + 4.f * sx * cy;
+            float nx = 0.5f * std::cos(x * 0.05f) * cy, ny = -0.3f * sx * std::sin(y * 0.03f), nz = -1.f;
+            float norm = 1.f / std::sqrt(nx * nx + ny * ny + nz * nz);
+            gbuf.normalX[offset] = nx * norm;
+            gbuf.normalY[offset] = ny * norm;
+            gbuf.normalZ[offset] = nz * norm;
+        }
+    }
+
+    lights = {numLights, alloc(numLights), alloc(numLights), alloc(numLights), alloc(numLights), alloc(numLights)};
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    for (int i = 0; i < numLights; i++) {
+        float z = 4.f + 12.f * uniform(gen);
+        lights.x[i] = (2.f * uniform(gen) - 1.f) * z / PROJ_11;
+        lights.y[i] = (2.f * uniform(gen) - 1.f) * z / PROJ_22;
+        lights.z[i] = z;
+        lights.radius[i] = 0.5f + 1.5f * uniform(gen);
+        lights.intensity[i] = uniform(gen);
+    }
+}
+
+static void release(GBuffer &gbuf, Lights &lights) {
+    for (float *p : {gbuf.viewZ, gbuf.normalX, gbuf.normalY, gbuf.normalZ})
+        aligned_free_helper(p);
+    for (float *p : {lights.x, lights.y, lights.z, lights.radius, lights.intensity})
+        aligned_free_helper(p);
+}
+
+static void check(const GBuffer &gbuf, const Lights &lights, int *tileLights, float *output) {
+    float *ref = alloc(XRES * YRES);
+    deferred_tiles_ispc(XRES, YRES, gbuf, lights, tileLights, output);
+    deferred_tiles_cpp(XRES, YRES, gbuf, lights, tileLights, ref);
+    for (int i = 0; i < XRES * YRES; i++) {
+        if (std::abs(output[i] - ref[i]) > 1e-3f * (1.f + ref[i])) {
+            printf("Error i=%d: %f != %f\n", i, output[i], ref[i]);
+            break;
+        }
+    }
+    aligned_free_helper(ref);
+}
+
+#define DEFERRED_BENCH(IMPL, FUNC)                                                                                     \
+    static void deferred_tiles_##IMPL(benchmark::State &state) {                                                       \
+        int numLights = static_cast<int>(state.range(0));                                                              \
+        GBuffer gbuf;                                                                                                  \
+        Lights lights;                                                                                                 \
+        init(gbuf, lights, numLights);                                                                                 \
+        int *tileLights = static_cast<int *>(aligned_alloc_helper(sizeof(int) * numLights));                           \
+        float *output = alloc(XRES * YRES);                                                                            \
+                                                                                                                       \
+        PerfCounters perf(state);                                                                                      \
+        for (auto _ : state) {                                                                                         \
+            FUNC(XRES, YRES, gbuf, lights, tileLights, output);                                                        \
+        }                                                                                                              \
+        perf.Stop();                                                                                                   \
+                                                                                                                       \
+        check(gbuf, lights, tileLights, output);                                                                       \
+        state.SetItemsProcessed(state.iterations() * XRES * YRES);                                                     \
+        release(gbuf, lights);                                                                                         \
+        aligned_free_helper(tileLights);                                                                               \
+        aligned_free_helper(output);                                                                                   \
+    }                                                                                                                  \
+    BENCHMARK(deferred_tiles_##IMPL)->ARGS;
+
+DEFERRED_BENCH(ispc, deferred_tiles_ispc)
+DEFERRED_BENCH(cpp, deferred_tiles_cpp)
+
+BENCHMARK_MAIN();
@@ -0,0 +1,169 @@
+// Copyright (c) 2024, Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+// Scalability of the task systems of examples/common/tasksys.cpp.  The
+// benchmark is built once per task system (ISPC_USE_* define), and it calls
+// ISPCAlloc(), ISPCLaunch() and ISPCSync() the same way as the code generated
+// by ispc for "launch" and "sync" does, so the numbers don't depend on the
+// ISPC target.
+
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+extern "C" {
+void ISPCLaunch(void **handlePtr, void *f, void *data, int countx, int county, int countz);
+void *ISPCAlloc(void **handlePtr, int64_t size, int32_t alignment);
+void ISPCSync(void *handle);
+}
+
+class Docs {
+  public:
+    Docs(std::string message) {
+        std::cout << "BENCHMARKS_TASK_SYSTEM: " << BENCHMARKS_TASK_SYSTEM << "\n";
+        std::cout << message << "\n";
+        benchmark::AddCustomContext("task_system", BENCHMARKS_TASK_SYSTEM);
+    }
+};
+
+static Docs docs("Task system scalability: throughput of launches of 1 to 1M empty tasks, imbalanced tasks, nested "
+                 "launches and the latency of a launch of a single task followed by sync.\n"
+                 "The number of threads is the one of the task system, use scripts/tasking_matrix.py to sweep it.\n"
+                 "Expectation:\n"
+                 " - No regressions\n"
+                 " - Launch throughput scales with the number of threads for the large counts\n");
+
+// Maximum threadCount passed to the tasks, reported as the "threads" counter.
+static std::atomic<int> maxThreadCount{0};
+
+static void lRecordThreadCount(int threadCount) {
+    int seen = maxThreadCount.load(std::memory_order_relaxed);
+    while (threadCount > seen && !maxThreadCount.compare_exchange_weak(seen, threadCount, std::memory_order_relaxed))
+        ;
+}
+
+// Busy work, which isn't optimized away.
+static void lWork(int64_t iterations) {
+    for (int64_t i = 0; i < iterations; ++i)
+        benchmark::DoNotOptimize(i);
+}
+
+// Arguments of the tasks, allocated with ISPCAlloc() like the ones of the ispc
+// task functions.
+struct TaskArgs {
+    int64_t work;
+    int pattern;
+    int innerCount;
+};
+
+// The signature of the ispc task functions.
+#define TASK_FUNCTION(name)                                                                                            \
+    static void name(void *data, int threadIndex, int threadCount, int taskIndex, int taskCount, int taskIndex0,       \
+                     int taskIndex1, int taskIndex2, int taskCount0, int taskCount1, int taskCount2)
+
+TASK_FUNCTION(emptyTask) { lRecordThreadCount(threadCount); }
+
+static void lLaunch(void **handle, void *func, int count, const TaskArgs &args) {
+    TaskArgs *data = (TaskArgs *)ISPCAlloc(handle, sizeof(TaskArgs), 64);
+    *data = args;
+    ISPCLaunch(handle, func, data, count, 1, 1);
+}
+
+static void lSync(void *handle) {
+    if (handle != nullptr)
+        ISPCSync(handle);
+}
+
+static void lSetCounters(benchmark::State &state, int64_t tasks) {
+    state.SetItemsProcessed(state.iterations() * tasks);
+    state.counters["threads"] = maxThreadCount.load();
+}
+
+// Throughput of a launch of the given number of empty tasks and the sync.
+static void launch_throughput(benchmark::State &state) {
+    const int count = state.range(0);
+    for (auto _ : state) {
+        void *handle = nullptr;
+        lLaunch(&handle, (void *)emptyTask, count, TaskArgs{});
+        lSync(handle);
+    }
+    lSetCounters(state, count);
+}
+BENCHMARK(launch_throughput)->ArgName("tasks")->RangeMultiplier(16)->Range(1, 1 << 20)->UseRealTime();
+
+// The amount of work per task of the imbalance benchmark for the patterns:
+//  0 - the same work in every task;
+//  1 - the work grows linearly with the task index;
+//  2 - the first task does a half of all work.
+// The total work is the same for all of them.
+static int64_t lTaskWork(int pattern, int64_t work, int taskIndex, int taskCount) {
+    switch (pattern) {
+    case 1:
+        return 2 * work * (taskIndex + 1) / (taskCount + 1);
+    case 2:
+        return taskIndex == 0 ? work * taskCount / 2 : work * taskCount / 2 / std::max(taskCount - 1, 1);
+    default:
+        return work;
+    }
+}
+
+TASK_FUNCTION(imbalancedTask) {
+    const TaskArgs *args = (const TaskArgs *)data;
+    lRecordThreadCount(threadCount);
+    lWork(lTaskWork(args->pattern, args->work, taskIndex, taskCount));
+}
+
+// Tasks with uneven amounts of work: the better the task system balances
+// them, the closer the time of the patterns 1 and 2 is to the pattern 0.
+static void imbalance(benchmark::State &state) {
+    const int pattern = state.range(0);
+    const int count = state.range(1);
+    const TaskArgs args{10000, pattern, 0};
+    for (auto _ : state) {
+        void *handle = nullptr;
+        lLaunch(&handle, (void *)imbalancedTask, count, args);
+        lSync(handle);
+    }
+    lSetCounters(state, count);
+}
+BENCHMARK(imbalance)->ArgNames({"pattern", "tasks"})->ArgsProduct({{0, 1, 2}, {64, 1024}})->UseRealTime();
+
+TASK_FUNCTION(outerTask) {
+    const TaskArgs *args = (const TaskArgs *)data;
+    lRecordThreadCount(threadCount);
+    void *handle = nullptr;
+    lLaunch(&handle, (void *)emptyTask, args->innerCount, TaskArgs{});
+    lSync(handle);
+}
+
+// Every task launches the inner tasks and waits for them, so the task system
+// must run the tasks of the inner launches while the outer ones are waiting.
+static void nested_launch(benchmark::State &state) {
+    const int outer = state.range(0);
+    const int inner = state.range(1);
+    const TaskArgs args{0, 0, inner};
+    for (auto _ : state) {
+        void *handle = nullptr;
+        lLaunch(&handle, (void *)outerTask, outer, args);
+        lSync(handle);
+    }
+    lSetCounters(state, int64_t(outer) * (inner + 1));
+}
+BENCHMARK(nested_launch)->ArgNames({"outer", "inner"})->ArgsProduct({{16, 256}, {16, 256}})->UseRealTime();
+
+// Round trip of a launch of one empty task and the sync, i.e. the latency of
+// waking up a worker and of sync noticing that the task is done.
+static void sync_latency(benchmark::State &state) {
+    for (auto _ : state) {
+        void *handle = nullptr;
+        lLaunch(&handle, (void *)emptyTask, 1, TaskArgs{});
+        lSync(handle);
+    }
+    lSetCounters(state, 1);
+}
+BENCHMARK(sync_latency)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
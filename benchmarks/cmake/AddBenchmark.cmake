@@ -42,6 +42,9 @@ else()
     endif()
 endif()
 
+# ISPC header included by the sources of all benchmarks
+set(BENCHMARKS_COMMON_ISPH "${CMAKE_CURRENT_LIST_DIR}/../common.isph")
+
 # Suffixes for multi-target compilation (x86 only)
 set(ISPC_KNOWN_TARGETS "sse2" "sse4" "avx1" "avx2" "avx512knl" "avx512skx")
 
@@ -125,7 +128,7 @@ function(add_ispc_to_target)
             COMMENT "Compiling ${ISPC_SRC_FILE} for ${BENCHMARKS_ISPC_TARGETS} target(s)"
             COMMAND           ${ISPC_EXECUTABLE} ${SRC_LOCATION} -o ${ISPC_OBJ} -h ${ISPC_HEADER} --arch=${ISPC_ARCH} --target=${BENCHMARKS_ISPC_TARGETS} ${ISPC_PIC} "$<JOIN:${FLAGS},;>"
             DEPENDS ${ISPC_EXECUTABLE} stdlibs-bc
-            DEPENDS ${ISPC_SRC_FILE}
+            DEPENDS ${ISPC_SRC_FILE} ${BENCHMARKS_COMMON_ISPH}
             COMMAND_EXPAND_LISTS
         )
         if(MSVC)
@@ -1,26 +1,172 @@
 // Copyright (c) 2021-2024, Intel Corporation
 // SPDX-License-Identifier: BSD-3-Clause
 
+#include <benchmark/benchmark.h>
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <malloc.h>
-#else
-#include <cstdlib>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif
 
 // Set maximum alignment for existing ISPC targets.
 #define ALIGNMENT 64
 
+// Width of the ISPC target, defined in common.isph.
+extern "C" int width();
+
 class Docs {
   public:
     Docs(std::string message) {
         std::cout << "BENCHMARKS_ISPC_TARGETS: " << BENCHMARKS_ISPC_TARGETS << "\n";
         std::cout << "BENCHMARKS_ISPC_FLAGS: " << BENCHMARKS_ISPC_FLAGS << "\n";
         std::cout << message << "\n";
+        // Record the target in the report, so the results of the different
+        // targets can be told apart.
+        benchmark::AddCustomContext("ispc_targets", BENCHMARKS_ISPC_TARGETS);
+        benchmark::AddCustomContext("ispc_flags", BENCHMARKS_ISPC_FLAGS);
+        benchmark::AddCustomContext("ispc_width", std::to_string(width()));
+    }
+};
+
+// Optional hardware performance counters (Linux only), enabled by the
+// BENCHMARKS_PERF_COUNTERS environment variable with a comma separated list of
+// counters or "1" for the default ones (cycles, instructions, l1d_misses,
+// llc_misses). "avx512_license" counts the cycles in the AVX-512 frequency
+// license (CORE_POWER.LVL2_TURBO_LICENSE on Skylake-SP, Cascade Lake and Ice
+// Lake server), it's never enabled by default as the event is model specific.
+// The counters are reported per iteration, so they must be started right
+// before the benchmark loop and stopped right after it:
+//
+//   PerfCounters perf(state);
+//   for (auto _ : state) { ... }
+//   perf.Stop();
+class PerfCounters {
+  public:
+#if defined(__linux__)
+    PerfCounters(benchmark::State &state) : m_state(state) {
+        const char *env = getenv("BENCHMARKS_PERF_COUNTERS");
+        if (env == nullptr || *env == '\0' || strcmp(env, "0") == 0) {
+            return;
+        }
+        std::string list = strcmp(env, "1") == 0 ? "cycles,instructions,l1d_misses,llc_misses" : env;
+        // Cycles lead the group, they are needed for the derived counters.
+        addEvent("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        if (m_events.empty()) {
+            return;
+        }
+        size_t begin = 0;
+        while (begin <= list.size()) {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            std::string name = list.substr(begin, end - begin);
+            if (name == "instructions") {
+                addEvent("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            } else if (name == "l1d_misses") {
+                addEvent("l1d_misses", PERF_TYPE_HW_CACHE,
+                     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            } else if (name == "llc_misses") {
+                addEvent("llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            } else if (name == "avx512_license") {
+                addEvent("avx512_license", PERF_TYPE_RAW, 0x2028);
+            } else if (!name.empty() && name != "cycles") {
+                m_state.SkipWithError(("Unknown perf counter " + name).c_str());
+            }
+            begin = end + 1;
+        }
+        ioctl(m_events[0].fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_events[0].fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    PerfCounters(benchmark::State &) {}
+#endif
+
+    ~PerfCounters() {
+        Stop();
+#if defined(__linux__)
+        for (const Event &e : m_events) {
+            close(e.fd);
+        }
+#endif
     }
+
+    // Stop counting and report the counters of the loop.
+    void Stop() {
+#if defined(__linux__)
+        if (m_events.empty() || m_stopped) {
+            return;
+        }
+        m_stopped = true;
+        ioctl(m_events[0].fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // PERF_FORMAT_GROUP layout: the number of events and their values
+        std::vector<uint64_t> values(m_events.size() + 1);
+        if (read(m_events[0].fd, values.data(), values.size() * sizeof(uint64_t)) !=
+            static_cast<ssize_t>(values.size() * sizeof(uint64_t))) {
+            return;
+        }
+        double cycles = static_cast<double>(values[1]);
+        for (size_t i = 0; i < m_events.size(); i++) {
+            double value = static_cast<double>(values[i + 1]);
+            m_state.counters[m_events[i].name] = benchmark::Counter(value, benchmark::Counter::kAvgIterations);
+            if (m_events[i].name == "instructions" && cycles > 0) {
+                m_state.counters["ipc"] = value / cycles;
+            } else if (m_events[i].name == "avx512_license" && cycles > 0) {
+                m_state.counters["avx512_license_share"] = value / cycles;
+            }
+        }
+#endif
+    }
+
+  private:
+#if defined(__linux__)
+    benchmark::State &m_state;
+    struct Event {
+        std::string name;
+        int fd;
+    };
+    std::vector<Event> m_events;
+    bool m_stopped{false};
+
+    void addEvent(const char *name, uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = m_events.empty() ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        int group = m_events.empty() ? -1 : m_events[0].fd;
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+        if (fd < 0) {
+            // Not supported by the CPU or not permitted by perf_event_paranoid.
+            static bool warned = false;
+            if (!warned) {
+                std::cerr << "Cannot open perf counter " << name << ": " << strerror(errno) << "\n";
+                warned = true;
+            }
+            return;
+        }
+        m_events.push_back({name, fd});
+    }
+#endif
 };
 
 // Helper function to enabled allocated allocations.
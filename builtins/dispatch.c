@@ -4,8 +4,8 @@
   SPDX-License-Identifier: BSD-3-Clause
 */
 
-// This is the source code of __get_system_isa and __set_system_isa functions
-// for dispatch built-in module.
+// This is the source code of __get_system_isa, __set_system_isa and
+// __ispc_set_dispatch_isa functions for dispatch built-in module.
 //
 // This file is compiled with clang during ISPC build in the following way:
 // - clang dispatch.c -O2 -emit-llvm -S -c -DREGULAR -o isa_dispatch.ll
@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 // __system_best_isa __get_system_isa and __set_system_isa are weak symbols
 // because we want to have the only version of them across user application
@@ -87,6 +88,9 @@ __attribute__((weak)) int32_t __get_system_isa() {
     _Bool avx_rdrand =          (info[2] & (1 << 30))  != 0;
     _Bool osxsave =             (info[2] & (1 << 27))  != 0;
     _Bool avx512_f =            (info2[1] & (1 << 16)) != 0;
+#if !defined(MACOS)
+    _Bool avx10 =               (info3[3] & (1 << 19)) != 0;
+#endif // !MACOS
     // clang-format on
 
     // NOTE: the values returned below must be the same as the
@@ -156,6 +160,15 @@ __attribute__((weak)) int32_t __get_system_isa() {
         // or whatever is available in the machine.
     }
 
+#if !defined(MACOS)
+    // AVX10 limited to 256-bit vectors doesn't report AVX-512.  The dispatch
+    // functions never select the avx512 variants on these CPUs, even though
+    // AVX10 comes after SPR in Target::ISA.
+    if (osxsave && avx10 && __os_has_avx512_support()) {
+        return 10; // AVX10
+    }
+#endif // !MACOS
+
     if (osxsave && avx && __os_has_avx_support()) {
         if (avx_vnni) {
             return 5; // ADL
@@ -176,8 +189,64 @@ __attribute__((weak)) int32_t __get_system_isa() {
     }
 }
 
+// Return the Target::ISA enumerant value for the ISA name, as used in the
+// names of the per-target output files, or -1 if the name is unknown.
+static int32_t __isa_from_name(const char *name) {
+    static const struct {
+        const char *name;
+        int32_t isa;
+    } isas[] = {
+        {"sse2", 0},      {"sse4.1", 1},    {"sse4", 2},      {"sse4.2", 2},      {"avx", 3},
+        {"avx1", 3},      {"avx2", 4},      {"avx2vnni", 5},  {"avx512knl", 6},   {"avx512skx", 7},
+        {"avx512icl", 8}, {"avx512spr", 9}, {"avx10", 10},
+    };
+    for (unsigned int i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+        if (strcmp(name, isas[i].name) == 0) {
+            return isas[i].isa;
+        }
+    }
+    return -1;
+}
+
+// The position of the ISA in the order in which the dispatch functions try
+// the variants: AVX10 (10) doesn't have 512-bit vectors, so it is tried after
+// the avx512 ISAs (6 to 9) and before ADL (5).
+static int32_t __isa_rank(int32_t isa) {
+    if (isa == 10) {
+        return 6;
+    }
+    return isa >= 6 ? isa + 1 : isa;
+}
+
+// Cap the ISA that the dispatch functions select with the ISA name, unless
+// the system doesn't support it.  A null name restores the most capable ISA
+// of the system.  Returns 0 on success and -1 if the name is unknown.
+__attribute__((weak)) int32_t __ispc_set_dispatch_isa(const char *name) {
+    int32_t isa = __get_system_isa();
+    if (name != NULL) {
+        int32_t cap = __isa_from_name(name);
+        if (cap == -1) {
+            return -1;
+        }
+        if (cap == 10 && isa < 9) {
+            // Only SPR and AVX10 can run the avx10 variants.
+            cap = 5;
+        }
+        if (__isa_rank(cap) < __isa_rank(isa)) {
+            isa = cap;
+        }
+    }
+    __system_best_isa = isa;
+    return 0;
+}
+
 __attribute__((weak)) void __set_system_isa() {
     if (__system_best_isa == -1) {
-        __system_best_isa = __get_system_isa();
+        // The ISPC_DISPATCH_ISA environment variable caps the selected ISA,
+        // e.g. to avoid the frequency reduction of AVX-512 on some systems.
+        const char *name = getenv("ISPC_DISPATCH_ISA");
+        if (name == NULL || __ispc_set_dispatch_isa(name) != 0) {
+            __system_best_isa = __get_system_isa();
+        }
     }
 }
@@ -0,0 +1,8 @@
+;;  Copyright (c) 2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+;; The avx512spr builtins of this width only use 128 and 256-bit vectors, so
+;; they are shared with the avx10 target.
+
+include(`target-avx512spr-x4.ll')
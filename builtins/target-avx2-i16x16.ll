@@ -768,6 +768,7 @@ scatterbo32_64(double)
 
 ;; TODO better intrinsic implementation is available
 packed_load_and_store(FALSE)
+crc32c_builtins()
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -233,3 +233,21 @@ define <16 x i32> @__dot2add_i16packed_sat(<16 x i32> %a, <16 x i32> %b, <16 x i
   %ret = call <16 x i32> @llvm.x86.avx512.vpdpwssds.512(<16 x i32> %acc, <16 x i32> %a, <16 x i32> %b)
   ret <16 x i32> %ret
 }
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; bfloat16
+declare <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float>) nounwind readnone
+define <16 x i16> @__float_to_bfloat16_varying(<16 x float> %v) nounwind readnone alwaysinline {
+  %ret = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v)
+  ret <16 x i16> %ret
+}
+
+declare <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float>, <16 x i32>, <16 x i32>) nounwind readnone
+define <16 x float> @__dot2add_bf16(<16 x i32> %a, <16 x i32> %b, <16 x float> %acc) nounwind readnone alwaysinline {
+  %ret = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc, <16 x i32> %a, <16 x i32> %b)
+  ret <16 x float> %ret
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX
+amx_tile_dot_products()
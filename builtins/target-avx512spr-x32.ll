@@ -804,6 +804,7 @@ scatterbo32_64(double)
 
 ;; TODO better intrinsic implementation is available
 packed_load_and_store(FALSE)
+crc32c_builtins()
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; prefetch
@@ -868,3 +869,29 @@ define <32 x i32> @__dot2add_i16packed_sat(<32 x i32> %a, <32 x i32> %b, <32 x i
   v16tov32(i32, %ret0, %ret1, %ret)
   ret <32 x i32> %ret
 }
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; bfloat16
+declare <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float>) nounwind readnone
+define <32 x i16> @__float_to_bfloat16_varying(<32 x float> %v) nounwind readnone alwaysinline {
+  v32tov16(float, %v, %v0, %v1)
+  %ret0 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v0)
+  %ret1 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v1)
+  v16tov32(i16, %ret0, %ret1, %ret)
+  ret <32 x i16> %ret
+}
+
+declare <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float>, <16 x i32>, <16 x i32>) nounwind readnone
+define <32 x float> @__dot2add_bf16(<32 x i32> %a, <32 x i32> %b, <32 x float> %acc) nounwind readnone alwaysinline {
+  v32tov16(i32, %a, %a0, %a1)
+  v32tov16(i32, %b, %b0, %b1)
+  v32tov16(float, %acc, %acc0, %acc1)
+  %ret0 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc0, <16 x i32> %a0, <16 x i32> %b0)
+  %ret1 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc1, <16 x i32> %a1, <16 x i32> %b1)
+  v16tov32(float, %ret0, %ret1, %ret)
+  ret <32 x float> %ret
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX
+amx_tile_dot_products()
@@ -162,3 +162,23 @@ define <4 x i32> @__dot2add_i16packed_sat(<4 x i32> %a, <4 x i32> %b, <4 x i32>
   %ret = call <4 x i32> @llvm.x86.avx512.vpdpwssds.128(<4 x i32> %acc, <4 x i32> %a, <4 x i32> %b)
   ret <4 x i32> %ret
 }
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; bfloat16
+declare <8 x i16> @llvm.x86.avx512bf16.mask.cvtneps2bf16.128(<4 x float>, <8 x i16>, <4 x i1>) nounwind readnone
+define <4 x i16> @__float_to_bfloat16_varying(<4 x float> %v) nounwind readnone alwaysinline {
+  %cvt = call <8 x i16> @llvm.x86.avx512bf16.mask.cvtneps2bf16.128(<4 x float> %v, <8 x i16> undef,
+                                                                  <4 x i1> <i1 true, i1 true, i1 true, i1 true>)
+  %ret = shufflevector <8 x i16> %cvt, <8 x i16> undef, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  ret <4 x i16> %ret
+}
+
+declare <4 x float> @llvm.x86.avx512bf16.dpbf16ps.128(<4 x float>, <4 x i32>, <4 x i32>) nounwind readnone
+define <4 x float> @__dot2add_bf16(<4 x i32> %a, <4 x i32> %b, <4 x float> %acc) nounwind readnone alwaysinline {
+  %ret = call <4 x float> @llvm.x86.avx512bf16.dpbf16ps.128(<4 x float> %acc, <4 x i32> %a, <4 x i32> %b)
+  ret <4 x float> %ret
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX
+amx_tile_dot_products()
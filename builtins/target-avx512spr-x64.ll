@@ -884,6 +884,7 @@ scatterbo32_64(double)
 
 ;; TODO better intrinsic implementation is available
 packed_load_and_store(FALSE)
+crc32c_builtins()
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -957,3 +958,33 @@ define <64 x i32> @__dot2add_i16packed_sat(<64 x i32> %a, <64 x i32> %b, <64 x i
   v16tov64(i32, %ret0, %ret1, %ret2, %ret3, %ret)
   ret <64 x i32> %ret
 }
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; bfloat16
+declare <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float>) nounwind readnone
+define <64 x i16> @__float_to_bfloat16_varying(<64 x float> %v) nounwind readnone alwaysinline {
+  v64tov16(float, %v, %v0, %v1, %v2, %v3)
+  %ret0 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v0)
+  %ret1 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v1)
+  %ret2 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v2)
+  %ret3 = call <16 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.512(<16 x float> %v3)
+  v16tov64(i16, %ret0, %ret1, %ret2, %ret3, %ret)
+  ret <64 x i16> %ret
+}
+
+declare <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float>, <16 x i32>, <16 x i32>) nounwind readnone
+define <64 x float> @__dot2add_bf16(<64 x i32> %a, <64 x i32> %b, <64 x float> %acc) nounwind readnone alwaysinline {
+  v64tov16(i32, %a, %a0, %a1, %a2, %a3)
+  v64tov16(i32, %b, %b0, %b1, %b2, %b3)
+  v64tov16(float, %acc, %acc0, %acc1, %acc2, %acc3)
+  %ret0 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc0, <16 x i32> %a0, <16 x i32> %b0)
+  %ret1 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc1, <16 x i32> %a1, <16 x i32> %b1)
+  %ret2 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc2, <16 x i32> %a2, <16 x i32> %b2)
+  %ret3 = call <16 x float> @llvm.x86.avx512bf16.dpbf16ps.512(<16 x float> %acc3, <16 x i32> %a3, <16 x i32> %b3)
+  v16tov64(float, %ret0, %ret1, %ret2, %ret3, %ret)
+  ret <64 x float> %ret
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX
+amx_tile_dot_products()
@@ -171,3 +171,21 @@ define <8 x i32> @__dot2add_i16packed_sat(<8 x i32> %a, <8 x i32> %b, <8 x i32>
   %ret = call <8 x i32> @llvm.x86.avx512.vpdpwssds.256(<8 x i32> %acc, <8 x i32> %a, <8 x i32> %b)
   ret <8 x i32> %ret
 }
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; bfloat16
+declare <8 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.256(<8 x float>) nounwind readnone
+define <8 x i16> @__float_to_bfloat16_varying(<8 x float> %v) nounwind readnone alwaysinline {
+  %ret = call <8 x i16> @llvm.x86.avx512bf16.cvtneps2bf16.256(<8 x float> %v)
+  ret <8 x i16> %ret
+}
+
+declare <8 x float> @llvm.x86.avx512bf16.dpbf16ps.256(<8 x float>, <8 x i32>, <8 x i32>) nounwind readnone
+define <8 x float> @__dot2add_bf16(<8 x i32> %a, <8 x i32> %b, <8 x float> %acc) nounwind readnone alwaysinline {
+  %ret = call <8 x float> @llvm.x86.avx512bf16.dpbf16ps.256(<8 x float> %acc, <8 x i32> %a, <8 x i32> %b)
+  ret <8 x float> %ret
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX
+amx_tile_dot_products()
@@ -0,0 +1,493 @@
+;;  Copyright (c) 2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+;; Common definitions of the RISC-V Vector (RVV 1.0) targets.
+;;
+;; The code is vector length agnostic: it only assumes the minimal VLEN of
+;; 128 bits of the V extension (the vscale_range attribute is set by
+;; Target), and the back-end picks the register group size, LMUL, for the
+;; width of the target: 1 for WIDTH 4, 2 for WIDTH 8 and 4 for WIDTH 16,
+;; the "double-pumped" widths of the other targets.  The mask,
+;; <WIDTH x i1>, is an RVV mask register.  The builtins are written with the
+;; generic LLVM intrinsics, which the back-end lowers to the masked RVV
+;; instructions: the masked loads and stores are unit-stride accesses
+;; under v0.t (the inactive lanes are not accessed, so the partial vectors
+;; of foreach tails can't fault), and the gathers and scatters are indexed
+;; accesses, or strided ones when the back-end finds that the addresses
+;; have a constant stride.
+
+define(`MASK',`i1')
+define(`HAVE_GATHER',`1')
+define(`HAVE_SCATTER',`1')
+
+include(`util.m4')
+
+stdlib_core()
+scans()
+reduce_equal(WIDTH)
+define_shuffles()
+define_vector_permutations()
+aossoa()
+ctlztz()
+popcnt()
+halfTypeGenericImplementation()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; fast math mode
+
+;; RISC-V has no flush-to-zero mode.
+
+define void @__fastmath() nounwind alwaysinline {
+  ret void
+}
+
+define i32 @__set_ftz_daz_flags() nounwind alwaysinline {
+  ret i32 0
+}
+
+define void @__restore_ftz_daz_flags(i32 %oldVal) nounwind alwaysinline {
+  ret void
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; round/floor/ceil/trunc
+
+;; $1: function suffix (round, floor, ceil)
+;; $2: LLVM intrinsic (roundeven, floor, ceil)
+define(`rvv_rounding', `
+declare float @llvm.$2.f32(float)
+declare double @llvm.$2.f64(double)
+declare <WIDTH x float> @llvm.$2.TYPE_SUFFIX(float)(<WIDTH x float>)
+declare <WIDTH x double> @llvm.$2.TYPE_SUFFIX(double)(<WIDTH x double>)
+
+define float @__$1_uniform_float(float) nounwind readnone alwaysinline {
+  %r = call float @llvm.$2.f32(float %0)
+  ret float %r
+}
+
+define double @__$1_uniform_double(double) nounwind readnone alwaysinline {
+  %r = call double @llvm.$2.f64(double %0)
+  ret double %r
+}
+
+define <WIDTH x float> @__$1_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.$2.TYPE_SUFFIX(float)(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__$1_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.$2.TYPE_SUFFIX(double)(<WIDTH x double> %0)
+  ret <WIDTH x double> %r
+}
+')
+
+rvv_rounding(round, roundeven)
+rvv_rounding(floor, floor)
+rvv_rounding(ceil, ceil)
+truncate()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; min/max
+
+;; $1: min or max
+;; $2: function suffix (float, int32, ...)
+;; $3: element type
+;; $4: compare instruction
+;; $5: predicate
+define(`rvv_minmax', `
+define $3 @__$1_uniform_$2($3, $3) nounwind readnone alwaysinline {
+  %cmp = $4 $5 $3 %0, %1
+  %r = select i1 %cmp, $3 %0, $3 %1
+  ret $3 %r
+}
+
+define <WIDTH x $3> @__$1_varying_$2(<WIDTH x $3>, <WIDTH x $3>) nounwind readnone alwaysinline {
+  %m = $4 $5 <WIDTH x $3> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x $3> %0, <WIDTH x $3> %1
+  ret <WIDTH x $3> %r
+}
+')
+
+rvv_minmax(min, float, float, fcmp, olt)
+rvv_minmax(max, float, float, fcmp, ogt)
+rvv_minmax(min, double, double, fcmp, olt)
+rvv_minmax(max, double, double, fcmp, ogt)
+rvv_minmax(min, int32, i32, icmp, slt)
+rvv_minmax(max, int32, i32, icmp, sgt)
+rvv_minmax(min, uint32, i32, icmp, ult)
+rvv_minmax(max, uint32, i32, icmp, ugt)
+rvv_minmax(min, int64, i64, icmp, slt)
+rvv_minmax(max, int64, i64, icmp, sgt)
+rvv_minmax(min, uint64, i64, icmp, ult)
+rvv_minmax(max, uint64, i64, icmp, ugt)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; sqrt/rsqrt/rcp
+
+declare float @llvm.sqrt.f32(float)
+declare double @llvm.sqrt.f64(double)
+declare <WIDTH x float> @llvm.sqrt.TYPE_SUFFIX(float)(<WIDTH x float>)
+declare <WIDTH x double> @llvm.sqrt.TYPE_SUFFIX(double)(<WIDTH x double>)
+
+define float @__sqrt_uniform_float(float) nounwind readnone alwaysinline {
+  %r = call float @llvm.sqrt.f32(float %0)
+  ret float %r
+}
+
+define double @__sqrt_uniform_double(double) nounwind readnone alwaysinline {
+  %r = call double @llvm.sqrt.f64(double %0)
+  ret double %r
+}
+
+define <WIDTH x float> @__sqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.sqrt.TYPE_SUFFIX(float)(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__sqrt_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.sqrt.TYPE_SUFFIX(double)(<WIDTH x double> %0)
+  ret <WIDTH x double> %r
+}
+
+;; The "fast" variants allow the back-end to use the vfrec7/vfrsqrt7
+;; estimates instead of the divisions.
+
+define float @__rcp_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv float 1., %0
+  ret float %r
+}
+
+define float @__rcp_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %r = fdiv fast float 1., %0
+  ret float %r
+}
+
+define float @__rsqrt_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call float @llvm.sqrt.f32(float %0)
+  %r = fdiv float 1., %s
+  ret float %r
+}
+
+define float @__rsqrt_fast_uniform_float(float) nounwind readnone alwaysinline {
+  %s = call fast float @llvm.sqrt.f32(float %0)
+  %r = fdiv fast float 1., %s
+  ret float %r
+}
+
+define <WIDTH x float> @__rcp_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rcp_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv fast <WIDTH x float> const_vector(float, 1.), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x float> @llvm.sqrt.TYPE_SUFFIX(float)(<WIDTH x float> %0)
+  %r = fdiv <WIDTH x float> const_vector(float, 1.), %s
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call fast <WIDTH x float> @llvm.sqrt.TYPE_SUFFIX(float)(<WIDTH x float> %0)
+  %r = fdiv fast <WIDTH x float> const_vector(float, 1.), %s
+  ret <WIDTH x float> %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; mask tests
+
+declare i1 @llvm.vector.reduce.or.TYPE_SUFFIX(i1)(<WIDTH x i1>)
+declare i1 @llvm.vector.reduce.and.TYPE_SUFFIX(i1)(<WIDTH x i1>)
+
+define i64 @__movmsk(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %intmask = bitcast <WIDTH x MASK> %mask to i`'WIDTH
+  %res = zext i`'WIDTH %intmask to i64
+  ret i64 %res
+}
+
+define i1 @__any(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %res = call i1 @llvm.vector.reduce.or.TYPE_SUFFIX(i1)(<WIDTH x i1> %mask)
+  ret i1 %res
+}
+
+define i1 @__all(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %res = call i1 @llvm.vector.reduce.and.TYPE_SUFFIX(i1)(<WIDTH x i1> %mask)
+  ret i1 %res
+}
+
+define i1 @__none(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %any = call i1 @llvm.vector.reduce.or.TYPE_SUFFIX(i1)(<WIDTH x i1> %mask)
+  %res = xor i1 %any, true
+  ret i1 %res
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; reductions
+
+;; The floating point additions are reassociated, so that they are done
+;; with vfredusum instead of the strictly ordered vfredosum.
+;; $1: function suffix
+;; $2: element type
+define(`rvv_reduce_fp', `
+declare $2 @llvm.vector.reduce.fadd.TYPE_SUFFIX($2)($2, <WIDTH x $2>)
+declare $2 @llvm.vector.reduce.fmin.TYPE_SUFFIX($2)(<WIDTH x $2>)
+declare $2 @llvm.vector.reduce.fmax.TYPE_SUFFIX($2)(<WIDTH x $2>)
+
+define $2 @__reduce_add_$1(<WIDTH x $2>) nounwind readnone alwaysinline {
+  %r = call reassoc $2 @llvm.vector.reduce.fadd.TYPE_SUFFIX($2)($2 -0., <WIDTH x $2> %0)
+  ret $2 %r
+}
+
+define $2 @__reduce_min_$1(<WIDTH x $2>) nounwind readnone alwaysinline {
+  %r = call $2 @llvm.vector.reduce.fmin.TYPE_SUFFIX($2)(<WIDTH x $2> %0)
+  ret $2 %r
+}
+
+define $2 @__reduce_max_$1(<WIDTH x $2>) nounwind readnone alwaysinline {
+  %r = call $2 @llvm.vector.reduce.fmax.TYPE_SUFFIX($2)(<WIDTH x $2> %0)
+  ret $2 %r
+}
+')
+
+;; $1: function suffix (signed type)
+;; $2: function suffix (unsigned type)
+;; $3: element type
+define(`rvv_reduce_minmax_int', `
+declare $3 @llvm.vector.reduce.smin.TYPE_SUFFIX($3)(<WIDTH x $3>)
+declare $3 @llvm.vector.reduce.smax.TYPE_SUFFIX($3)(<WIDTH x $3>)
+declare $3 @llvm.vector.reduce.umin.TYPE_SUFFIX($3)(<WIDTH x $3>)
+declare $3 @llvm.vector.reduce.umax.TYPE_SUFFIX($3)(<WIDTH x $3>)
+
+define $3 @__reduce_min_$1(<WIDTH x $3>) nounwind readnone alwaysinline {
+  %r = call $3 @llvm.vector.reduce.smin.TYPE_SUFFIX($3)(<WIDTH x $3> %0)
+  ret $3 %r
+}
+
+define $3 @__reduce_max_$1(<WIDTH x $3>) nounwind readnone alwaysinline {
+  %r = call $3 @llvm.vector.reduce.smax.TYPE_SUFFIX($3)(<WIDTH x $3> %0)
+  ret $3 %r
+}
+
+define $3 @__reduce_min_$2(<WIDTH x $3>) nounwind readnone alwaysinline {
+  %r = call $3 @llvm.vector.reduce.umin.TYPE_SUFFIX($3)(<WIDTH x $3> %0)
+  ret $3 %r
+}
+
+define $3 @__reduce_max_$2(<WIDTH x $3>) nounwind readnone alwaysinline {
+  %r = call $3 @llvm.vector.reduce.umax.TYPE_SUFFIX($3)(<WIDTH x $3> %0)
+  ret $3 %r
+}
+')
+
+;; The sums of the narrow types are computed in a wider type, like vwredsum.
+;; $1: element type
+;; $2: type of the sum
+define(`rvv_reduce_add_int', `
+declare $2 @llvm.vector.reduce.add.TYPE_SUFFIX($2)(<WIDTH x $2>)
+
+define $2 @__reduce_add_int`'SIZEOF_BITS($1)(<WIDTH x $1>) nounwind readnone alwaysinline {
+ifelse($1, $2, `
+  %r = call $2 @llvm.vector.reduce.add.TYPE_SUFFIX($2)(<WIDTH x $2> %0)
+', `
+  %ext = sext <WIDTH x $1> %0 to <WIDTH x $2>
+  %r = call $2 @llvm.vector.reduce.add.TYPE_SUFFIX($2)(<WIDTH x $2> %ext)
+')
+  ret $2 %r
+}
+')
+
+define(`SIZEOF_BITS', `eval(8 * SIZEOF($1))')
+
+rvv_reduce_fp(float, float)
+rvv_reduce_fp(double, double)
+rvv_reduce_minmax_int(int32, uint32, i32)
+rvv_reduce_minmax_int(int64, uint64, i64)
+rvv_reduce_add_int(i8, i16)
+rvv_reduce_add_int(i16, i32)
+rvv_reduce_add_int(i32, i64)
+
+;; __reduce_add_int32 sums in i64, so the i64 sum of int64 is declared
+;; there already.
+define i64 @__reduce_add_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  %r = call i64 @llvm.vector.reduce.add.TYPE_SUFFIX(i64)(<WIDTH x i64> %0)
+  ret i64 %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; masked loads and stores
+
+;; $1: element type
+define(`rvv_masked_load_store', `
+declare <WIDTH x $1> @llvm.masked.load.TYPE_SUFFIX($1).p0`'TYPE_SUFFIX($1)(<WIDTH x $1>*, i32, <WIDTH x i1>, <WIDTH x $1>)
+declare void @llvm.masked.store.TYPE_SUFFIX($1).p0`'TYPE_SUFFIX($1)(<WIDTH x $1>, <WIDTH x $1>*, i32, <WIDTH x i1>)
+
+define <WIDTH x $1> @__masked_load_$1(i8 *, <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %ptr = bitcast i8 * %0 to <WIDTH x $1> *
+  %res = call <WIDTH x $1> @llvm.masked.load.TYPE_SUFFIX($1).p0`'TYPE_SUFFIX($1)(<WIDTH x $1>* %ptr,
+                                   i32 SIZEOF($1), <WIDTH x i1> %mask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %res
+}
+
+define void @__masked_store_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>, <WIDTH x MASK>) nounwind alwaysinline {
+  call void @llvm.masked.store.TYPE_SUFFIX($1).p0`'TYPE_SUFFIX($1)(<WIDTH x $1> %1, <WIDTH x $1>* %0,
+                                   i32 SIZEOF($1), <WIDTH x i1> %2)
+  ret void
+}
+
+;; The predicated store doesnt touch the inactive lanes, so it is also
+;; used for the blend, instead of a load, a select and a full store.
+define void @__masked_store_blend_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>,
+                                     <WIDTH x MASK>) nounwind alwaysinline {
+  call void @llvm.masked.store.TYPE_SUFFIX($1).p0`'TYPE_SUFFIX($1)(<WIDTH x $1> %1, <WIDTH x $1>* %0,
+                                   i32 SIZEOF($1), <WIDTH x i1> %2)
+  ret void
+}
+')
+
+rvv_masked_load_store(i8)
+rvv_masked_load_store(i16)
+rvv_masked_load_store(half)
+rvv_masked_load_store(i32)
+rvv_masked_load_store(float)
+rvv_masked_load_store(i64)
+rvv_masked_load_store(double)
+
+packed_load_and_store(FALSE)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; gather/scatter
+;;
+;; The factored generic implementations are needed when --opt=disable-gathers
+;; or --opt=disable-scatters is used.
+
+;; $1: element type
+define(`rvv_gather_scatter', `
+gen_gather_factored_generic($1)
+gen_scatter_factored($1)
+
+declare <WIDTH x $1> @llvm.masked.gather.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1*>, i32,
+                                   <WIDTH x i1>, <WIDTH x $1>)
+declare void @llvm.masked.scatter.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1>, <WIDTH x $1*>, i32,
+                                   <WIDTH x i1>)
+
+define <WIDTH x $1> @__gather64_$1(<WIDTH x i64> %ptrs, <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %p = inttoptr <WIDTH x i64> %ptrs to <WIDTH x $1*>
+  %res = call <WIDTH x $1> @llvm.masked.gather.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1*> %p,
+                                   i32 SIZEOF($1), <WIDTH x i1> %vecmask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1> @__gather32_$1(<WIDTH x i32> %ptrs, <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %ptrs64 = zext <WIDTH x i32> %ptrs to <WIDTH x i64>
+  %res = call <WIDTH x $1> @__gather64_$1(<WIDTH x i64> %ptrs64, <WIDTH x MASK> %vecmask)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1> @__gather_base_offsets64_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i64> %offsets,
+                                   <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %scale64 = sext i32 %offset_scale to i64
+  %scale_ins = insertelement <WIDTH x i64> undef, i64 %scale64, i32 0
+  %scale = shufflevector <WIDTH x i64> %scale_ins, <WIDTH x i64> undef, <WIDTH x i32> zeroinitializer
+  %byte_offsets = mul <WIDTH x i64> %offsets, %scale
+  %addrs = getelementptr i8, i8 * %ptr, <WIDTH x i64> %byte_offsets
+  %p = bitcast <WIDTH x i8*> %addrs to <WIDTH x $1*>
+  %res = call <WIDTH x $1> @llvm.masked.gather.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1*> %p,
+                                   i32 SIZEOF($1), <WIDTH x i1> %vecmask, <WIDTH x $1> undef)
+  ret <WIDTH x $1> %res
+}
+
+define <WIDTH x $1> @__gather_base_offsets32_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i32> %offsets,
+                                   <WIDTH x MASK> %vecmask) nounwind readonly alwaysinline {
+  %offsets64 = sext <WIDTH x i32> %offsets to <WIDTH x i64>
+  %res = call <WIDTH x $1> @__gather_base_offsets64_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i64> %offsets64,
+                                   <WIDTH x MASK> %vecmask)
+  ret <WIDTH x $1> %res
+}
+
+define void @__scatter64_$1(<WIDTH x i64> %ptrs, <WIDTH x $1> %values,
+                            <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %p = inttoptr <WIDTH x i64> %ptrs to <WIDTH x $1*>
+  call void @llvm.masked.scatter.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1> %values,
+                                   <WIDTH x $1*> %p, i32 SIZEOF($1), <WIDTH x i1> %vecmask)
+  ret void
+}
+
+define void @__scatter32_$1(<WIDTH x i32> %ptrs, <WIDTH x $1> %values,
+                            <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %ptrs64 = zext <WIDTH x i32> %ptrs to <WIDTH x i64>
+  call void @__scatter64_$1(<WIDTH x i64> %ptrs64, <WIDTH x $1> %values, <WIDTH x MASK> %vecmask)
+  ret void
+}
+
+define void @__scatter_base_offsets64_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i64> %offsets,
+                                         <WIDTH x $1> %values, <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %scale64 = sext i32 %offset_scale to i64
+  %scale_ins = insertelement <WIDTH x i64> undef, i64 %scale64, i32 0
+  %scale = shufflevector <WIDTH x i64> %scale_ins, <WIDTH x i64> undef, <WIDTH x i32> zeroinitializer
+  %byte_offsets = mul <WIDTH x i64> %offsets, %scale
+  %addrs = getelementptr i8, i8 * %ptr, <WIDTH x i64> %byte_offsets
+  %p = bitcast <WIDTH x i8*> %addrs to <WIDTH x $1*>
+  call void @llvm.masked.scatter.TYPE_SUFFIX($1).v`'WIDTH`'p0`'LLVM_OVERLOADED_TYPE($1)(<WIDTH x $1> %values,
+                                   <WIDTH x $1*> %p, i32 SIZEOF($1), <WIDTH x i1> %vecmask)
+  ret void
+}
+
+define void @__scatter_base_offsets32_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i32> %offsets,
+                                         <WIDTH x $1> %values, <WIDTH x MASK> %vecmask) nounwind alwaysinline {
+  %offsets64 = sext <WIDTH x i32> %offsets to <WIDTH x i64>
+  call void @__scatter_base_offsets64_$1(i8 * %ptr, i32 %offset_scale, <WIDTH x i64> %offsets64,
+                                         <WIDTH x $1> %values, <WIDTH x MASK> %vecmask)
+  ret void
+}
+')
+
+rvv_gather_scatter(i8)
+rvv_gather_scatter(i16)
+rvv_gather_scatter(half)
+rvv_gather_scatter(i32)
+rvv_gather_scatter(float)
+rvv_gather_scatter(i64)
+rvv_gather_scatter(double)
+
+;; yuck.  We need declarations of these, even though we shouldnt ever
+;; actually generate calls to them for the RVV targets...
+
+include(`svml.m4')
+svml_stubs(float,f,WIDTH)
+svml_stubs(double,d,WIDTH)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; int8/int16 builtins
+
+define_avgs()
+
+;; $1: add or sub
+;; $2: element type
+define(`rvv_saturation', `
+declare <WIDTH x $2> @llvm.s$1.sat.TYPE_SUFFIX($2)(<WIDTH x $2>, <WIDTH x $2>)
+declare <WIDTH x $2> @llvm.u$1.sat.TYPE_SUFFIX($2)(<WIDTH x $2>, <WIDTH x $2>)
+
+define <WIDTH x $2> @__p$1s_v$2(<WIDTH x $2>, <WIDTH x $2>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $2> @llvm.s$1.sat.TYPE_SUFFIX($2)(<WIDTH x $2> %0, <WIDTH x $2> %1)
+  ret <WIDTH x $2> %r
+}
+
+define <WIDTH x $2> @__p$1us_v$2(<WIDTH x $2>, <WIDTH x $2>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $2> @llvm.u$1.sat.TYPE_SUFFIX($2)(<WIDTH x $2> %0, <WIDTH x $2> %1)
+  ret <WIDTH x $2> %r
+}
+')
+
+rvv_saturation(add, i8)
+rvv_saturation(add, i16)
+rvv_saturation(sub, i8)
+rvv_saturation(sub, i16)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; prefetch
+
+define_prefetches()
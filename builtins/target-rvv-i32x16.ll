@@ -0,0 +1,8 @@
+;;  Copyright (c) 2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+define(`WIDTH',`16')
+define(`ISA',`RVV')
+
+include(`target-rvv-common.ll')
@@ -13,6 +13,7 @@ include(`util.m4')
 
 stdlib_core()
 packed_load_and_store(FALSE)
+crc32c_builtins()
 scans()
 int64minmax()
 saturation_arithmetic()
@@ -0,0 +1,563 @@
+;;  Copyright (c) 2020-2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+;; Authors:
+;; Anton Schreiner
+
+;; Common definitions for the WebAssembly SIMD128 targets.  The target files
+;; set the vector width (4, or 8 for the "double-pumped" targets that use two
+;; v128 registers per 32-bit varying) and whether the relaxed-simd proposal
+;; may be used.
+
+;; FIXME: Workaround for "BUILD_OS should be defined to either UNIX or WINDOWS" error
+define(`BUILD_OS',`UNIX')
+define(`MASK',`i32')
+define(`ISA',`WASM')
+;; Wasm has custom clock function
+define(`HAS_CUSTOM_CLOCK',`1')
+
+include(`util.m4')
+
+stdlib_core()
+scans()
+define_vector_permutations()
+aossoa()
+ctlztz()
+include(`svml.m4')
+svml_stubs(float,f,WIDTH)
+svml_stubs(double,d,WIDTH)
+define_avgs()
+saturation_arithmetic()
+halfTypeGenericImplementation()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; helpers
+
+;; i32 0, i32 1, ..., i32 $1-1
+define(`wasm_seq', `forloop(si, 0, eval($1-2), `i32 si, ')i32 eval($1-1)')
+
+;; Apply a v128 intrinsic to each 128-bit chunk of two varying operands.
+;; $1: name of the result
+;; $2: element type
+;; $3: number of elements in 128 bits
+;; $4: intrinsic
+;; $5, $6: operands
+
+define(`wasm_binary_v128', `
+forloop(ci, 0, eval(WIDTH/$3-1), `
+  %$1_a`'ci = shufflevector <WIDTH x $2> $5, <WIDTH x $2> undef,
+      <$3 x i32> <forloop(li, 0, eval($3-2), `i32 eval(ci*$3+li), ')i32 eval(ci*$3+$3-1)>
+  %$1_b`'ci = shufflevector <WIDTH x $2> $6, <WIDTH x $2> undef,
+      <$3 x i32> <forloop(li, 0, eval($3-2), `i32 eval(ci*$3+li), ')i32 eval(ci*$3+$3-1)>
+  %$1_r`'ci = call <$3 x $2> $4(<$3 x $2> %$1_a`'ci, <$3 x $2> %$1_b`'ci)')
+ifelse(eval(WIDTH/$3), `1', `
+  %$1 = shufflevector <$3 x $2> %$1_r0, <$3 x $2> undef, <WIDTH x i32> <wasm_seq(WIDTH)>',
+       eval(WIDTH/$3), `2', `
+  %$1 = shufflevector <$3 x $2> %$1_r0, <$3 x $2> %$1_r1, <WIDTH x i32> <wasm_seq(WIDTH)>', `
+  %$1_lo = shufflevector <$3 x $2> %$1_r0, <$3 x $2> %$1_r1, <eval(2*$3) x i32> <wasm_seq(eval(2*$3))>
+  %$1_hi = shufflevector <$3 x $2> %$1_r2, <$3 x $2> %$1_r3, <eval(2*$3) x i32> <wasm_seq(eval(2*$3))>
+  %$1 = shufflevector <eval(2*$3) x $2> %$1_lo, <eval(2*$3) x $2> %$1_hi, <WIDTH x i32> <wasm_seq(WIDTH)>')
+')
+
+;; OR ($2 = or) or AND ($2 = and) the 128-bit halves of the mask in $1 into
+;; a single i128 %$1_128.
+
+define(`wasm_mask_to_i128', `
+ifelse(WIDTH, `4', `
+  %$1_128 = bitcast <4 x MASK> %$1 to i128', `
+  %$1_lo = shufflevector <8 x MASK> %$1, <8 x MASK> undef, <4 x i32> <i32 0, i32 1, i32 2, i32 3>
+  %$1_hi = shufflevector <8 x MASK> %$1, <8 x MASK> undef, <4 x i32> <i32 4, i32 5, i32 6, i32 7>
+  %$1_v = $2 <4 x MASK> %$1_lo, %$1_hi
+  %$1_128 = bitcast <4 x MASK> %$1_v to i128')
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; shuffles
+;;
+;; A variable 32-bit shuffle of a single v128 is one i8x16.swizzle on byte
+;; indices.  Constant indices keep the generic extract/insert sequence, which
+;; InstCombine folds into a shufflevector.
+
+ifdef(`WASM_RELAXED', `
+declare <16 x i8> @llvm.wasm.relaxed.swizzle(<16 x i8>, <16 x i8>)
+define(`WASM_SWIZZLE', `@llvm.wasm.relaxed.swizzle($1, $2)')
+', `
+declare <16 x i8> @llvm.wasm.swizzle(<16 x i8>, <16 x i8>)
+define(`WASM_SWIZZLE', `@llvm.wasm.swizzle($1, $2)')
+')
+
+define(`wasm_shuffle_swizzle', `
+define <4 x $1> @__shuffle_$1(<4 x $1>, <4 x i32>) nounwind readnone alwaysinline {
+  %isc = call i1 @__is_compile_time_constant_varying_int32(<4 x i32> %1)
+  br i1 %isc, label %is_const, label %not_const
+
+is_const:
+forloop(i, 0, 3, `
+  %index_`'i = extractelement <4 x i32> %1, i32 i')
+forloop(i, 0, 3, `
+  %v_`'i = extractelement <4 x $1> %0, i32 %index_`'i')
+  %ret_0 = insertelement <4 x $1> undef, $1 %v_0, i32 0
+forloop(i, 1, 3, `  %ret_`'i = insertelement <4 x $1> %ret_`'eval(i-1), $1 %v_`'i, i32 i
+')
+  ret <4 x $1> %ret_3
+
+not_const:
+  ; lane n of the index selects bytes 4n .. 4n+3
+  %lane_bytes = mul <4 x i32> %1, const_vector(i32, 67372036)
+  %bytes = add <4 x i32> %lane_bytes, const_vector(i32, 50462976)
+  %idx = bitcast <4 x i32> %bytes to <16 x i8>
+  %v = bitcast <4 x $1> %0 to <16 x i8>
+  %r = call <16 x i8> WASM_SWIZZLE(<16 x i8> %v, <16 x i8> %idx)
+  %res = bitcast <16 x i8> %r to <4 x $1>
+  ret <4 x $1> %res
+}
+')
+
+shuffle1(i8)
+shuffle1(i16)
+shuffle1(half)
+shuffle1(double)
+shuffle1(i64)
+ifelse(WIDTH, `4', `
+wasm_shuffle_swizzle(i32)
+wasm_shuffle_swizzle(float)
+', `
+shuffle1(i32)
+shuffle1(float)
+')
+define_shuffle2_const()
+define_shuffle2()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+define i1 @__wasm_cmp_msk_eq(<WIDTH x i32> %v1, <WIDTH x i32> %v2) nounwind readnone alwaysinline {
+  %diff = xor <WIDTH x i32> %v1, %v2
+  wasm_mask_to_i128(diff, or)
+  %ret = icmp eq i128 %diff_128, 0
+  ret i1 %ret
+}
+
+define i64 @__clock() {
+entry:
+  %call = tail call i32 @clock()
+  %conv = sext i32 %call to i64
+  ret i64 %conv
+}
+
+declare i32 @clock()
+
+define void @__fastmath() {
+entry:
+  ret void
+}
+
+define i32 @__set_ftz_daz_flags() nounwind alwaysinline {
+  ret i32 0
+}
+
+define void @__restore_ftz_daz_flags(i32 %oldVal) nounwind alwaysinline {
+  ret void
+}
+
+define void @__masked_store_blend_i8(<WIDTH x i8>* nocapture %ptr, <WIDTH x i8> %new,
+                                     <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x i8> ')  %ptr
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %result = select <WIDTH x i1> %mask1, <WIDTH x i8> %new, <WIDTH x i8> %old
+  store <WIDTH x i8> %result, <WIDTH x i8> * %ptr
+  ret void
+}
+
+define void @__masked_store_blend_i16(<WIDTH x i16>* nocapture %ptr, <WIDTH x i16> %new,
+                                      <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x i16> ')  %ptr
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %result = select <WIDTH x i1> %mask1, <WIDTH x i16> %new, <WIDTH x i16> %old
+  store <WIDTH x i16> %result, <WIDTH x i16> * %ptr
+  ret void
+}
+
+define void @__masked_store_blend_i32(<WIDTH x i32>* nocapture %ptr, <WIDTH x i32> %new,
+                                      <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x i32> ')  %ptr
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %result = select <WIDTH x i1> %mask1, <WIDTH x i32> %new, <WIDTH x i32> %old
+  store <WIDTH x i32> %result, <WIDTH x i32> * %ptr
+  ret void
+}
+
+define void @__masked_store_blend_i64(<WIDTH x i64>* nocapture %ptr,
+                            <WIDTH x i64> %new, <WIDTH x MASK> %mask) nounwind alwaysinline {
+  %old = load PTR_OP_ARGS(`<WIDTH x i64> ')  %ptr
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %result = select <WIDTH x i1> %mask1, <WIDTH x i64> %new, <WIDTH x i64> %old
+  store <WIDTH x i64> %result, <WIDTH x i64> * %ptr
+  ret void
+}
+
+define i64 @__movmsk(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %mask1 = trunc <WIDTH x MASK> %mask to <WIDTH x i1>
+  %res = bitcast <WIDTH x i1> %mask1 to i`'WIDTH
+  %res_i64 = zext i`'WIDTH %res to i64
+  ret i64 %res_i64
+}
+
+define i1 @__any(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+entry:
+  wasm_mask_to_i128(mask, or)
+  %cmp = icmp ne i128 %mask_128, 0
+  ret i1 %cmp
+}
+
+define i1 @__all(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+entry:
+  wasm_mask_to_i128(mask, and)
+  %cmp = icmp eq i128 %mask_128, -1
+  ret i1 %cmp
+}
+
+define i1 @__none(<WIDTH x MASK> %mask) nounwind readnone alwaysinline {
+  %any = call i1 @__any(<WIDTH x MASK> %mask)
+  %none = icmp eq i1 %any, 0
+  ret i1 %none
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; sqrt/rsqrt/rcp
+
+declare float @llvm.sqrt.f32(float)
+declare double @llvm.sqrt.f64(double)
+declare <WIDTH x float> @llvm.sqrt.v`'WIDTH`'f32(<WIDTH x float>)
+declare <WIDTH x double> @llvm.sqrt.v`'WIDTH`'f64(<WIDTH x double>)
+
+define <WIDTH x float> @__sqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @llvm.sqrt.v`'WIDTH`'f32(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__sqrt_varying_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.sqrt.v`'WIDTH`'f64(<WIDTH x double> %0)
+  ret <WIDTH x double> %r
+}
+
+define <WIDTH x float> @__rsqrt_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %s = call <WIDTH x float> @llvm.sqrt.v`'WIDTH`'f32(<WIDTH x float> %0)
+  %r = fdiv <WIDTH x float> const_vector(float, 1.0), %s
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rsqrt_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x float> @__rsqrt_varying_float(<WIDTH x float> %0)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rcp_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.0), %0
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__rcp_fast_varying_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = fdiv <WIDTH x float> const_vector(float, 1.0), %0
+  ret <WIDTH x float> %r
+}
+
+define float @__sqrt_uniform_float(float) nounwind readonly alwaysinline {
+  %ret = call float @llvm.sqrt.f32(float %0)
+  ret float %ret
+}
+
+define double @__sqrt_uniform_double(double) nounwind readonly alwaysinline {
+  %ret = call double @llvm.sqrt.f64(double %0)
+  ret double %ret
+}
+
+define float @__rsqrt_uniform_float(float) nounwind readonly alwaysinline {
+  %s = call float @__sqrt_uniform_float(float %0)
+  %r = call float @__rcp_uniform_float(float %s)
+  ret float %r
+}
+
+define float @__rsqrt_fast_uniform_float(float) nounwind readonly alwaysinline {
+  %s = call float @__sqrt_uniform_float(float %0)
+  %r = call float @__rcp_uniform_float(float %s)
+  ret float %r
+}
+
+define float @__rcp_uniform_float(float) nounwind readonly alwaysinline {
+  %r = fdiv float 1.,%0
+  ret float %r
+}
+
+define float @__rcp_fast_uniform_float(float) nounwind readonly alwaysinline {
+  %r = fdiv float 1.,%0
+  ret float %r
+}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; rounding
+;;
+;; These map to f32.nearest/floor/ceil and their f64 and f32x4/f64x2
+;; counterparts; nearbyint rounds half to even in the default environment.
+
+define(`wasm_rounding', `
+declare $1 @llvm.$3.$4($1)
+declare <WIDTH x $1> @llvm.$3.v`'WIDTH`'$4(<WIDTH x $1>)
+
+define $1 @__$2_uniform_$1($1) nounwind readnone alwaysinline {
+  %r = call $1 @llvm.$3.$4($1 %0)
+  ret $1 %r
+}
+
+define <WIDTH x $1> @__$2_varying_$1(<WIDTH x $1>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x $1> @llvm.$3.v`'WIDTH`'$4(<WIDTH x $1> %0)
+  ret <WIDTH x $1> %r
+}
+')
+
+wasm_rounding(float, round, nearbyint, f32)
+wasm_rounding(float, floor, floor, f32)
+wasm_rounding(float, ceil, ceil, f32)
+wasm_rounding(double, round, nearbyint, f64)
+wasm_rounding(double, floor, floor, f64)
+wasm_rounding(double, ceil, ceil, f64)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; trunc float and double
+
+truncate()
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; min/max
+
+define float @__max_uniform_float(float, float) nounwind readnone alwaysinline {
+  %cmp = fcmp ugt float %0, %1
+  %r = select i1 %cmp, float %0, float %1
+  ret float %r
+}
+
+define float @__min_uniform_float(float, float) nounwind readnone alwaysinline {
+  %cmp = fcmp ult float %0, %1
+  %r = select i1 %cmp, float %0, float %1
+  ret float %r
+}
+
+define double @__min_uniform_double(double, double) nounwind readnone alwaysinline {
+  %cmp = fcmp olt double %0, %1
+  %r = select i1 %cmp, double %0, double %1
+  ret double %r
+}
+
+define double @__max_uniform_double(double, double) nounwind readnone alwaysinline {
+  %cmp = fcmp ogt double %0, %1
+  %r = select i1 %cmp, double %0, double %1
+  ret double %r
+}
+
+;; $1: type, $2: ispc type name, $3: min or max, $4: icmp predicate
+
+define(`wasm_minmax_int', `
+define $1 @__$3_uniform_$2($1, $1) nounwind readnone alwaysinline {
+  %cmp = icmp $4 $1 %0, %1
+  %r = select i1 %cmp, $1 %0, $1 %1
+  ret $1 %r
+}
+
+define <WIDTH x $1> @__$3_varying_$2(<WIDTH x $1>, <WIDTH x $1>) nounwind readnone alwaysinline {
+  %m = icmp $4 <WIDTH x $1> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x $1> %0, <WIDTH x $1> %1
+  ret <WIDTH x $1> %r
+}
+')
+
+wasm_minmax_int(i32, int32, min, slt)
+wasm_minmax_int(i32, int32, max, sgt)
+wasm_minmax_int(i32, uint32, min, ult)
+wasm_minmax_int(i32, uint32, max, ugt)
+wasm_minmax_int(i64, int64, min, slt)
+wasm_minmax_int(i64, int64, max, sgt)
+wasm_minmax_int(i64, uint64, min, ult)
+wasm_minmax_int(i64, uint64, max, ugt)
+
+;; Relaxed min/max leave the result for NaN and -0.0 vs +0.0 inputs to the
+;; implementation, which lets engines emit a single minps/maxps on x86.
+;; The strict variants keep the pre-existing semantics.
+
+ifdef(`WASM_RELAXED', `
+declare <4 x float> @llvm.wasm.relaxed.min.v4f32(<4 x float>, <4 x float>)
+declare <4 x float> @llvm.wasm.relaxed.max.v4f32(<4 x float>, <4 x float>)
+declare <2 x double> @llvm.wasm.relaxed.min.v2f64(<2 x double>, <2 x double>)
+declare <2 x double> @llvm.wasm.relaxed.max.v2f64(<2 x double>, <2 x double>)
+
+define <WIDTH x float> @__min_varying_float(<WIDTH x float>, <WIDTH x float>) nounwind readnone alwaysinline {
+  wasm_binary_v128(r, float, 4, @llvm.wasm.relaxed.min.v4f32, %0, %1)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__max_varying_float(<WIDTH x float>, <WIDTH x float>) nounwind readnone alwaysinline {
+  wasm_binary_v128(r, float, 4, @llvm.wasm.relaxed.max.v4f32, %0, %1)
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__min_varying_double(<WIDTH x double>, <WIDTH x double>) nounwind readnone alwaysinline {
+  wasm_binary_v128(r, double, 2, @llvm.wasm.relaxed.min.v2f64, %0, %1)
+  ret <WIDTH x double> %r
+}
+
+define <WIDTH x double> @__max_varying_double(<WIDTH x double>, <WIDTH x double>) nounwind readnone alwaysinline {
+  wasm_binary_v128(r, double, 2, @llvm.wasm.relaxed.max.v2f64, %0, %1)
+  ret <WIDTH x double> %r
+}
+', `
+declare <WIDTH x double> @llvm.minimum.v`'WIDTH`'f64(<WIDTH x double>, <WIDTH x double>)
+declare <WIDTH x double> @llvm.maximum.v`'WIDTH`'f64(<WIDTH x double>, <WIDTH x double>)
+
+define <WIDTH x float> @__min_varying_float(<WIDTH x float>, <WIDTH x float>) nounwind readnone alwaysinline {
+  %m = fcmp olt <WIDTH x float> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x float> %0, <WIDTH x float> %1
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x float> @__max_varying_float(<WIDTH x float>, <WIDTH x float>) nounwind readnone alwaysinline {
+  %m = fcmp ogt <WIDTH x float> %0, %1
+  %r = select <WIDTH x i1> %m, <WIDTH x float> %0, <WIDTH x float> %1
+  ret <WIDTH x float> %r
+}
+
+define <WIDTH x double> @__min_varying_double(<WIDTH x double>, <WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.minimum.v`'WIDTH`'f64(<WIDTH x double> %0, <WIDTH x double> %1)
+  ret <WIDTH x double> %r
+}
+
+define <WIDTH x double> @__max_varying_double(<WIDTH x double>, <WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call <WIDTH x double> @llvm.maximum.v`'WIDTH`'f64(<WIDTH x double> %0, <WIDTH x double> %1)
+  ret <WIDTH x double> %r
+}
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; horizontal ops / reductions
+
+declare i16 @llvm.vector.reduce.add.v`'WIDTH`'i16(<WIDTH x i16>)
+declare i32 @llvm.vector.reduce.add.v`'WIDTH`'i32(<WIDTH x i32>)
+declare i64 @llvm.vector.reduce.add.v`'WIDTH`'i64(<WIDTH x i64>)
+declare float @llvm.vector.reduce.fadd.v`'WIDTH`'f32(float, <WIDTH x float>)
+declare double @llvm.vector.reduce.fadd.v`'WIDTH`'f64(double, <WIDTH x double>)
+
+define i16 @__reduce_add_int8(<WIDTH x i8>) nounwind readnone alwaysinline {
+  %ext = sext <WIDTH x i8> %0 to <WIDTH x i16>
+  %r = call i16 @llvm.vector.reduce.add.v`'WIDTH`'i16(<WIDTH x i16> %ext)
+  ret i16 %r
+}
+
+define i16 @__reduce_add_int16(<WIDTH x i16>) nounwind readnone alwaysinline {
+  %r = call i16 @llvm.vector.reduce.add.v`'WIDTH`'i16(<WIDTH x i16> %0)
+  ret i16 %r
+}
+
+define i32 @__reduce_add_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  %r = call i32 @llvm.vector.reduce.add.v`'WIDTH`'i32(<WIDTH x i32> %0)
+  ret i32 %r
+}
+
+define i64 @__reduce_add_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  %r = call i64 @llvm.vector.reduce.add.v`'WIDTH`'i64(<WIDTH x i64> %0)
+  ret i64 %r
+}
+
+define float @__reduce_add_float(<WIDTH x float>) nounwind readnone alwaysinline {
+  %r = call reassoc float @llvm.vector.reduce.fadd.v`'WIDTH`'f32(float -0.0, <WIDTH x float> %0)
+  ret float %r
+}
+
+define double @__reduce_add_double(<WIDTH x double>) nounwind readnone alwaysinline {
+  %r = call reassoc double @llvm.vector.reduce.fadd.v`'WIDTH`'f64(double -0.0, <WIDTH x double> %0)
+  ret double %r
+}
+
+define float @__reduce_min_float(<WIDTH x float>) nounwind readnone {
+  reduce_func(float, @__min_varying_float, @__min_uniform_float)
+}
+
+define float @__reduce_max_float(<WIDTH x float>) nounwind readnone {
+  reduce_func(float, @__max_varying_float, @__max_uniform_float)
+}
+
+define double @__reduce_min_double(<WIDTH x double>) nounwind readnone {
+  reduce_func(double, @__min_varying_double, @__min_uniform_double)
+}
+
+define double @__reduce_max_double(<WIDTH x double>) nounwind readnone {
+  reduce_func(double, @__max_varying_double, @__max_uniform_double)
+}
+
+define i32 @__reduce_min_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce_func(i32, @__min_varying_int32, @__min_uniform_int32)
+}
+
+define i32 @__reduce_max_int32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce_func(i32, @__max_varying_int32, @__max_uniform_int32)
+}
+
+define i32 @__reduce_min_uint32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce_func(i32, @__min_varying_uint32, @__min_uniform_uint32)
+}
+
+define i32 @__reduce_max_uint32(<WIDTH x i32>) nounwind readnone alwaysinline {
+  reduce_func(i32, @__max_varying_uint32, @__max_uniform_uint32)
+}
+
+define i64 @__reduce_min_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce_func(i64, @__min_varying_int64, @__min_uniform_int64)
+}
+
+define i64 @__reduce_max_int64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce_func(i64, @__max_varying_int64, @__max_uniform_int64)
+}
+
+define i64 @__reduce_min_uint64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce_func(i64, @__min_varying_uint64, @__min_uniform_uint64)
+}
+
+define i64 @__reduce_max_uint64(<WIDTH x i64>) nounwind readnone alwaysinline {
+  reduce_func(i64, @__max_varying_uint64, @__max_uniform_uint64)
+}
+
+reduce_equal(WIDTH)
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; gather/scatter, masked load/store
+
+gen_gather_factored(i8)
+gen_gather_factored(i16)
+gen_gather_factored(half)
+gen_gather_factored(i32)
+gen_gather_factored(float)
+gen_gather_factored(i64)
+gen_gather_factored(double)
+
+masked_load(i8,  1)
+masked_load(i16, 2)
+masked_load(half, 2)
+masked_load(i32, 4)
+masked_load(float, 4)
+masked_load(i64, 8)
+masked_load(double, 8)
+
+gen_masked_store(i8)
+gen_masked_store(i16)
+gen_masked_store(i32)
+gen_masked_store(i64)
+masked_store_float_double()
+
+gen_scatter(i8)
+gen_scatter(i16)
+gen_scatter(half)
+gen_scatter(i32)
+gen_scatter(float)
+gen_scatter(i64)
+gen_scatter(double)
+
+packed_load_and_store(4)
+define_prefetches()
+popcnt()
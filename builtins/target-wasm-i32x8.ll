@@ -0,0 +1,7 @@
+;;  Copyright (c) 2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+define(`WIDTH',`8')
+
+include(`target-wasm-common.ll')
@@ -0,0 +1,8 @@
+;;  Copyright (c) 2024, Intel Corporation
+;;
+;;  SPDX-License-Identifier: BSD-3-Clause
+
+define(`WIDTH',`8')
+define(`WASM_RELAXED',`1')
+
+include(`target-wasm-common.ll')
@@ -1034,6 +1034,107 @@ xe_masked_load(float)
 xe_masked_load(double)
 xe_masked_load(i64)
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; LSC block load/store
+;; Xe2 has transposed LSC messages that move a contiguous block of memory
+;; with a single message. ImproveMemoryOps emits calls to these functions
+;; for unit-stride accesses whose address is known to be aligned to the block
+;; element: 4 bytes for d32 blocks (used for 1, 2 and 4 byte types) and
+;; 8 bytes for d64 blocks. The mask is checked at runtime; if the block
+;; message is not safe, these functions fall back to __masked_load and
+;; __masked_store.
+
+ifdef(`XE_LSC_BLOCK', `
+define(`LSC_BLOCK_TYPE', `ifelse(SIZEOF($1), 8, i64, i32)')
+define(`LSC_BLOCK_LEN', `ifelse(SIZEOF($1), 8, WIDTH, eval(WIDTH * SIZEOF($1) / 4))')
+;; LSC data size encoding: 3 is d32, 4 is d64.
+define(`LSC_DATA_SIZE', `ifelse(SIZEOF($1), 8, 4, 3)')
+;; LSC vector size encoding of the number of block elements.
+define(`LSC_VECTOR_SIZE',
+`ifelse(LSC_BLOCK_LEN($1), 4, 4,
+        LSC_BLOCK_LEN($1), 8, 5,
+        LSC_BLOCK_LEN($1), 16, 6,
+        LSC_BLOCK_LEN($1), 32, 7,
+        LSC_BLOCK_LEN($1), 64, 8)')
+define(`LSC_BLOCK', `<LSC_BLOCK_LEN($1) x LSC_BLOCK_TYPE($1)>')
+define(`LSC_BLOCK_SUFFIX', `XE_SUFFIXN(LSC_BLOCK_TYPE($1), LSC_BLOCK_LEN($1))')
+
+;; Types of the same size share the block type, so the intrinsics are
+;; declared once per size.
+define(`xe_lsc_block_decl', `
+declare LSC_BLOCK($1) @llvm.genx.lsc.load.stateless.LSC_BLOCK_SUFFIX($1).i1.i64(i1, i8, i8, i8, i16, i32, i8, i8, i8, i8, i64, i32)
+declare void @llvm.genx.lsc.store.stateless.i1.i64.LSC_BLOCK_SUFFIX($1)(i1, i8, i8, i8, i16, i32, i8, i8, i8, i8, i64, LSC_BLOCK($1), i32)
+')
+
+xe_lsc_block_decl(i8)
+xe_lsc_block_decl(i16)
+xe_lsc_block_decl(i32)
+xe_lsc_block_decl(i64)
+
+define(`xe_lsc_block_load', `
+; Like __masked_load, the block is read if the first and the last lanes are on
+; since then all of the accessed memory is touched by the active lanes.
+define <WIDTH x $1> @__masked_load_block_$1(i8 *, <WIDTH x MASK> %mask) nounwind alwaysinline {
+entry:
+  %mm = call i64 @__movmsk(<WIDTH x MASK> %mask)
+  %mm_and_low = and i64 %mm, 1
+  %mm_and_high = and i64 %mm, MASK_HIGH_BIT_ON
+  %mm_and_high_shift = lshr i64 %mm_and_high, eval(WIDTH-1)
+  %mm_and_low_i1 = trunc i64 %mm_and_low to i1
+  %mm_and_high_shift_i1 = trunc i64 %mm_and_high_shift to i1
+  %can_block_load = and i1 %mm_and_low_i1, %mm_and_high_shift_i1
+  br i1 %can_block_load, label %block_load, label %fallback
+
+block_load:
+  %addr = ptrtoint i8* %0 to i64
+  %block = call LSC_BLOCK($1) @llvm.genx.lsc.load.stateless.LSC_BLOCK_SUFFIX($1).i1.i64(i1 true, i8 0, i8 0, i8 0, i16 1, i32 0, i8 LSC_DATA_SIZE($1), i8 LSC_VECTOR_SIZE($1), i8 2, i8 0, i64 %addr, i32 0)
+  %res = bitcast LSC_BLOCK($1) %block to <WIDTH x $1>
+  %res_masked = select <WIDTH x MASK> %mask, <WIDTH x $1> %res, <WIDTH x $1> undef
+  ret <WIDTH x $1> %res_masked
+
+fallback:
+  %res_fallback = call <WIDTH x $1> @__masked_load_$1(i8 * %0, <WIDTH x MASK> %mask)
+  ret <WIDTH x $1> %res_fallback
+}
+')
+
+define(`xe_lsc_block_store', `
+; Block stores have no per-element mask, so they are only used when all of
+; the lanes are on.
+define void @__masked_store_block_$1(<WIDTH x $1>* nocapture, <WIDTH x $1>, <WIDTH x MASK> %mask) nounwind alwaysinline {
+entry:
+  %all_on = call i1 @__all(<WIDTH x MASK> %mask)
+  br i1 %all_on, label %block_store, label %fallback
+
+block_store:
+  %addr = ptrtoint <WIDTH x $1>* %0 to i64
+  %block = bitcast <WIDTH x $1> %1 to LSC_BLOCK($1)
+  call void @llvm.genx.lsc.store.stateless.i1.i64.LSC_BLOCK_SUFFIX($1)(i1 true, i8 4, i8 0, i8 0, i16 1, i32 0, i8 LSC_DATA_SIZE($1), i8 LSC_VECTOR_SIZE($1), i8 2, i8 0, i64 %addr, LSC_BLOCK($1) %block, i32 0)
+  ret void
+
+fallback:
+  call void @__masked_store_$1(<WIDTH x $1>* %0, <WIDTH x $1> %1, <WIDTH x MASK> %mask)
+  ret void
+}
+')
+
+xe_lsc_block_load(i8)
+xe_lsc_block_load(i16)
+xe_lsc_block_load(half)
+xe_lsc_block_load(i32)
+xe_lsc_block_load(float)
+xe_lsc_block_load(double)
+xe_lsc_block_load(i64)
+
+xe_lsc_block_store(i8)
+xe_lsc_block_store(i16)
+xe_lsc_block_store(half)
+xe_lsc_block_store(i32)
+xe_lsc_block_store(float)
+xe_lsc_block_store(double)
+xe_lsc_block_store(i64)
+')
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; gather/scatter
 ;; TODO_GEN: add computation of the block size and the number of blocks for svm gather/scatter.
@@ -7,5 +7,6 @@ define(`WIDTH_X2',`32')
 define(`WIDTH_X4',`64')
 define(`XE_SUFFIX',`CONCAT(`v16', XE_TYPE($1))')
 define(`BITCAST_WIDTH',`i16')
+define(`XE_LSC_BLOCK',`1')
 
 include(`target-xe.ll')
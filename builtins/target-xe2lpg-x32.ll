@@ -7,5 +7,6 @@ define(`WIDTH_X2',`64')
 define(`WIDTH_X4',`128')
 define(`XE_SUFFIX',`CONCAT(`v32', XE_TYPE($1))')
 define(`BITCAST_WIDTH',`i32')
+define(`XE_LSC_BLOCK',`1')
 
 include(`target-xe.ll')
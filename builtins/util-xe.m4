@@ -4010,6 +4010,12 @@ define void @__do_assume_uniform(i1 %test) alwaysinline {
   ret void
 }
 
+define void @__do_assume_aligned(i8 * %ptr, i32 %align) alwaysinline {
+  %align64 = zext i32 %align to i64
+  call void @llvm.assume(i1 true) [ "align"(i8 * %ptr, i64 %align64) ]
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; assert
 
@@ -4548,6 +4554,16 @@ define void @__memory_barrier() nounwind readnone alwaysinline {
   ret void
 }
 
+;; Synchronizes the tasks of the workgroup. The arguments of the SPIR-V
+;; control barrier are the execution and memory scopes (2 is Workgroup) and
+;; the memory semantics (AcquireRelease | WorkgroupMemory), so the accesses
+;; to the shared local memory done before the barrier are visible after it.
+declare void @__spirv_ControlBarrier(i32, i32, i32)
+define void @__task_barrier() nounwind alwaysinline {
+  call void @__spirv_ControlBarrier(i32 2, i32 2, i32 264)
+  ret void
+}
+
 global_atomic_associative(WIDTH, add, i32, int32, 0)
 global_atomic_associative(WIDTH, sub, i32, int32, 0)
 global_atomic_associative(WIDTH, and, i32, int32, -1)
@@ -5059,6 +5075,8 @@ define i32 @__packed_store_active2$1(i8 * %startptr, <WIDTH x $1> %vals,
 ;; loads a sequential value from the array.
 
 define(`packed_load_and_store', `
+  packed_load_and_store_type(i8, 1)
+  packed_load_and_store_type(i16, 2)
   packed_load_and_store_type(i32, 4)
   packed_load_and_store_type(i64, 8)
 ')
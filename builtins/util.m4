@@ -2217,7 +2217,10 @@ vector_permutations(i64, 8)
 ;; result0 = atomic_op(ptr, tmp)
 ;; result1 = (result0 op val0)
 ;; ..
-;; And more efficiently compute the same result
+;; And more efficiently compute the same result.  The partial results
+;; (val0 op ... op val(i-1)) are computed with log2(WIDTH) steps of a
+;; parallel prefix scan; they're only needed if the values returned by the
+;; atomic are used.  For sub, the values are summed with add.
 ;;
 ;; Takes five parameters:
 ;; $1: vector width of the target
@@ -2312,6 +2315,20 @@ define internal <$1 x i64> @convertmask_i64_i64_$1(<$1 x i64>) {
 
 mask_converts(WIDTH)
 
+;; Shuffle mask for a $1-wide shufflevector that moves the elements of the
+;; first operand $2 lanes up, filling the low lanes with the first element of
+;; the second operand.
+define(`shift_lanes_up_mask', `<$1 x i32> < forloop(i, 0, eval($1-2), `i32 ifelse(eval(i < $2), 1, $1, eval(i-$2)), ') i32 eval($1-1-$2) >')
+
+;; Steps of an inclusive prefix scan of %scan_0 with the operation $2 and the
+;; identity vector %idvec: %scan_<n> holds (val(i-2n+1) op ... op val(i)) in
+;; lane i, so %scan_<$1/2> holds the scan.
+;; $1: vector width, $2: operation, $3: element type, $4: step (1 to start)
+define(`prefix_scan_steps', `ifelse(eval($4 < $1), 1, `
+  %scan_shifted_$4 = shufflevector <$1 x $3> %scan_`'eval($4/2), <$1 x $3> %idvec, shift_lanes_up_mask($1, $4)
+  %scan_$4 = $2 <$1 x $3> %scan_`'eval($4/2), %scan_shifted_$4
+  prefix_scan_steps($1, $2, $3, eval($4*2))')')
+
 define(`global_atomic_associative', `
 
 define <$1 x $3> @__atomic_$2_$4_global(i8 * %ptr, <$1 x $3> %val,
@@ -2336,21 +2353,18 @@ define <$1 x $3> @__atomic_$2_$4_global(i8 * %ptr, <$1 x $3> %val,
   %idoff = and <$1 x $3> %idvec, %notmask
 
   ; and comptue the merged vector that holds the identity in the off lanes
-  %valp = or <$1 x $3> %valoff, %idoff
-
-  ; now compute the local reduction (val0 op val1 op ... )--initialize
-  ; %eltvec so that the 0th element is the identity, the first is val0,
-  ; the second is (val0 op val1), ..
-  %red0 = extractelement <$1 x $3> %valp, i32 0
-  %eltvec0 = insertelement <$1 x $3> undef, $3 $5, i32 0
+  %scan_0 = or <$1 x $3> %valoff, %idoff
 
-  forloop(i, 1, eval($1-1), `
-  %elt`'i = extractelement <$1 x $3> %valp, i32 i
-  %red`'i = $2 $3 %red`'eval(i-1), %elt`'i
-  %eltvec`'i = insertelement <$1 x $3> %eltvec`'eval(i-1), $3 %red`'eval(i-1), i32 i')
+  ; now compute the prefix scan of it, so that the last element holds the
+  ; local reduction (val0 op val1 op ... ), and shift it up by one lane to
+  ; get %eltvec, whose 0th element is the identity, the first is val0, the
+  ; second is (val0 op val1), ..
+  prefix_scan_steps($1, ifelse($2, `sub', `add', $2), $3, 1)
+  %red = extractelement <$1 x $3> %scan_`'eval($1/2), i32 eval($1-1)
+  %eltvec = shufflevector <$1 x $3> %scan_`'eval($1/2), <$1 x $3> %idvec, shift_lanes_up_mask($1, 1)
 
   ; make the atomic call, passing it the final reduced value
-  %final0 = atomicrmw $2 $3 * %ptr_typed, $3 %red`'eval($1-1) seq_cst
+  %final0 = atomicrmw $2 $3 * %ptr_typed, $3 %red seq_cst
 
   ; now go back and compute the values to be returned for each program
   ; instance--this just involves smearing the old value returned from the
@@ -2359,7 +2373,7 @@ define <$1 x $3> @__atomic_$2_$4_global(i8 * %ptr, <$1 x $3> %val,
   %finalv1 = bitcast $3 %final0 to <1 x $3>
   %final_base = shufflevector <1 x $3> %finalv1, <1 x $3> undef,
      <$1 x i32> < forloop(i, 1, eval($1-1), `i32 0, ') i32 0 >
-  %r = $2 <$1 x $3> %final_base, %eltvec`'eval($1-1)
+  %r = $2 <$1 x $3> %final_base, %eltvec
 
   ret <$1 x $3> %r
 }
@@ -5388,6 +5402,12 @@ define void @__do_assume_uniform(i1 %test) alwaysinline {
   ret void
 }
 
+define void @__do_assume_aligned(i8 * %ptr, i32 %align) alwaysinline {
+  %align64 = zext i32 %align to i64
+  call void @llvm.assume(i1 true) [ "align"(i8 * %ptr, i64 %align64) ]
+  ret void
+}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; assert
 
@@ -5883,6 +5903,13 @@ define void @__memory_barrier() nounwind readnone alwaysinline {
   ret void
 }
 
+;; Every task runs as a group of its own on CPU targets, so the task group
+;; barrier only needs to order the memory accesses.
+define void @__task_barrier() nounwind alwaysinline {
+  fence seq_cst
+  ret void
+}
+
 global_atomic_associative(WIDTH, add, i32, int32, 0)
 global_atomic_associative(WIDTH, sub, i32, int32, 0)
 global_atomic_associative(WIDTH, and, i32, int32, -1)
@@ -6654,9 +6681,178 @@ done:
 ;;     For other targets branchless emulation sequence should be used (triggered by 'FALSE').
 
 define(`packed_load_and_store', `
+  packed_load_and_store_type(i8, $1, 1)
+  packed_load_and_store_type(i16, $1, 2)
   packed_load_and_store_type(i32, $1, 4)
   packed_load_and_store_type(i64, $1, 8)
 ')
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; AMX tile dot products
+;;
+;; __amx_tile_dp_<op>(C, ldc, A, lda, B, ldb, M, N, K) accumulates the
+;; product of the M x K matrix A and of the K x N matrix B into the M x N
+;; matrix C, with M <= 16 and N <= 16.  B is in the VNNI layout: each row
+;; of it holds 4 bytes of K for each column of C.  The strides are in bytes
+;; and K is the size of a row of A in bytes, a multiple of 4.
+;;
+;; C stays in tmm0 while K is consumed in chunks of 64 bytes, with A in tmm1
+;; and B in tmm2.  A shorter last chunk needs another tile configuration,
+;; and loading a configuration zeroes the tiles, so C is stored and loaded
+;; again around it.
+
+define(`amx_tile_dot_products', `
+declare void @llvm.x86.ldtilecfg(i8*)
+declare void @llvm.x86.tilerelease()
+declare void @llvm.x86.tileloadd64(i8, i8*, i64)
+declare void @llvm.x86.tilestored64(i8, i8*, i64)
+declare void @llvm.x86.tdpbssd(i8, i8, i8)
+declare void @llvm.x86.tdpbsud(i8, i8, i8)
+declare void @llvm.x86.tdpbusd(i8, i8, i8)
+declare void @llvm.x86.tdpbuud(i8, i8, i8)
+declare void @llvm.x86.tdpbf16ps(i8, i8, i8)
+
+;; Palette 1: the bytes per row of tile t are the i16 at 16 + 2 * t and its
+;; number of rows is the i8 at 48 + t.
+define internal void @__amx_load_config(i8* %cfg, i32 %m, i32 %n, i32 %kbytes) nounwind alwaysinline {
+  %cfg_vec = bitcast i8* %cfg to <64 x i8>*
+  store <64 x i8> zeroinitializer, <64 x i8>* %cfg_vec, align 64
+  store i8 1, i8* %cfg
+  %colsb_ptr = getelementptr PTR_OP_ARGS(`i8') %cfg, i32 16
+  %colsb = bitcast i8* %colsb_ptr to i16*
+  %rows = getelementptr PTR_OP_ARGS(`i8') %cfg, i32 48
+  %nbytes = mul i32 %n, 4
+  %nbytes16 = trunc i32 %nbytes to i16
+  %kbytes16 = trunc i32 %kbytes to i16
+  %m8 = trunc i32 %m to i8
+  %krows = udiv i32 %kbytes, 4
+  %krows8 = trunc i32 %krows to i8
+  %colsb1 = getelementptr PTR_OP_ARGS(`i16') %colsb, i32 1
+  %colsb2 = getelementptr PTR_OP_ARGS(`i16') %colsb, i32 2
+  store i16 %nbytes16, i16* %colsb
+  store i16 %kbytes16, i16* %colsb1
+  store i16 %nbytes16, i16* %colsb2
+  %rows1 = getelementptr PTR_OP_ARGS(`i8') %rows, i32 1
+  %rows2 = getelementptr PTR_OP_ARGS(`i8') %rows, i32 2
+  store i8 %m8, i8* %rows
+  store i8 %m8, i8* %rows1
+  store i8 %krows8, i8* %rows2
+  call void @llvm.x86.ldtilecfg(i8* %cfg)
+  ret void
+}
+
+amx_tile_dot_product(ssd, tdpbssd)
+amx_tile_dot_product(sud, tdpbsud)
+amx_tile_dot_product(usd, tdpbusd)
+amx_tile_dot_product(uud, tdpbuud)
+amx_tile_dot_product(bf16ps, tdpbf16ps)
+')
+
+;; $1: suffix of the function
+;; $2: tile dot product instruction
+
+define(`amx_tile_dot_product', `
+define void @__amx_tile_dp_$1(i8* %c, i64 %ldc, i8* %a, i64 %lda, i8* %b, i64 %ldb,
+                              i32 %m, i32 %n, i32 %k) nounwind alwaysinline {
+entry:
+  %cfg = alloca <64 x i8>, align 64
+  %cfg_ptr = bitcast <64 x i8>* %cfg to i8*
+  %full = udiv i32 %k, 64
+  %tail = urem i32 %k, 64
+  %has_full = icmp ugt i32 %full, 0
+  br i1 %has_full, label %full_setup, label %tail_check
+
+full_setup:
+  call void @__amx_load_config(i8* %cfg_ptr, i32 %m, i32 %n, i32 64)
+  call void @llvm.x86.tileloadd64(i8 0, i8* %c, i64 %ldc)
+  br label %full_loop
+
+full_loop:
+  %i = phi i32 [ 0, %full_setup ], [ %i_next, %full_loop ]
+  %i64 = zext i32 %i to i64
+  %a_offset = mul i64 %i64, 64
+  %b_offset = mul i64 %i64, %ldb
+  %b_offset16 = mul i64 %b_offset, 16
+  %a_chunk = getelementptr PTR_OP_ARGS(`i8') %a, i64 %a_offset
+  %b_chunk = getelementptr PTR_OP_ARGS(`i8') %b, i64 %b_offset16
+  call void @llvm.x86.tileloadd64(i8 1, i8* %a_chunk, i64 %lda)
+  call void @llvm.x86.tileloadd64(i8 2, i8* %b_chunk, i64 %ldb)
+  call void @llvm.x86.$2(i8 0, i8 1, i8 2)
+  %i_next = add i32 %i, 1
+  %more = icmp ult i32 %i_next, %full
+  br i1 %more, label %full_loop, label %full_done
+
+full_done:
+  call void @llvm.x86.tilestored64(i8 0, i8* %c, i64 %ldc)
+  br label %tail_check
+
+tail_check:
+  %has_tail = icmp ne i32 %tail, 0
+  br i1 %has_tail, label %tail_chunk, label %done
+
+tail_chunk:
+  %full64 = zext i32 %full to i64
+  %a_tail_offset = mul i64 %full64, 64
+  %b_tail_offset = mul i64 %full64, %ldb
+  %b_tail_offset16 = mul i64 %b_tail_offset, 16
+  %a_tail = getelementptr PTR_OP_ARGS(`i8') %a, i64 %a_tail_offset
+  %b_tail = getelementptr PTR_OP_ARGS(`i8') %b, i64 %b_tail_offset16
+  call void @__amx_load_config(i8* %cfg_ptr, i32 %m, i32 %n, i32 %tail)
+  call void @llvm.x86.tileloadd64(i8 0, i8* %c, i64 %ldc)
+  call void @llvm.x86.tileloadd64(i8 1, i8* %a_tail, i64 %lda)
+  call void @llvm.x86.tileloadd64(i8 2, i8* %b_tail, i64 %ldb)
+  call void @llvm.x86.$2(i8 0, i8 1, i8 2)
+  call void @llvm.x86.tilestored64(i8 0, i8* %c, i64 %ldc)
+  br label %done
+
+done:
+  call void @llvm.x86.tilerelease()
+  ret void
+}
+')
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; crc32c
+;;
+;; __crc32c_u8/u32/u64(crc, v) update crc with the bytes of v, without the
+;; inversions at the start and at the end, like the SSE4.2 crc32
+;; instruction.  32-bit targets have no 64-bit form of it, so they do the
+;; two halves of v in turn.
+
+define(`crc32c_builtins', `
+declare i32 @llvm.x86.sse42.crc32.32.8(i32, i8) nounwind readnone
+declare i32 @llvm.x86.sse42.crc32.32.32(i32, i32) nounwind readnone
+
+define i32 @__crc32c_u8(i32 %crc, i8 %v) nounwind readnone alwaysinline {
+  %ret = call i32 @llvm.x86.sse42.crc32.32.8(i32 %crc, i8 %v)
+  ret i32 %ret
+}
+
+define i32 @__crc32c_u32(i32 %crc, i32 %v) nounwind readnone alwaysinline {
+  %ret = call i32 @llvm.x86.sse42.crc32.32.32(i32 %crc, i32 %v)
+  ret i32 %ret
+}
+
+ifelse(RUNTIME, `64', `
+declare i64 @llvm.x86.sse42.crc32.64.64(i64, i64) nounwind readnone
+
+define i32 @__crc32c_u64(i32 %crc, i64 %v) nounwind readnone alwaysinline {
+  %crc64 = zext i32 %crc to i64
+  %ret64 = call i64 @llvm.x86.sse42.crc32.64.64(i64 %crc64, i64 %v)
+  %ret = trunc i64 %ret64 to i32
+  ret i32 %ret
+}
+', `
+define i32 @__crc32c_u64(i32 %crc, i64 %v) nounwind readnone alwaysinline {
+  %lo = trunc i64 %v to i32
+  %hi64 = lshr i64 %v, 32
+  %hi = trunc i64 %hi64 to i32
+  %crc_lo = call i32 @llvm.x86.sse42.crc32.32.32(i32 %crc, i32 %lo)
+  %ret = call i32 @llvm.x86.sse42.crc32.32.32(i32 %crc_lo, i32 %hi)
+  ret i32 %ret
+}
+')
+')
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; reduce_equal
 
@@ -18,7 +18,7 @@ function(determine_arch_and_os target bit os out_arch out_os)
         else()
             set(arch "error")
         endif()
-    elseif ("${target}" MATCHES "neon")
+    elseif ("${target}" MATCHES "neon|sve")
         if ("${bit}" STREQUAL "32")
             set(arch "arm")
         elseif ("${bit}" STREQUAL "64")
@@ -34,6 +34,12 @@ function(determine_arch_and_os target bit os out_arch out_os)
         else()
             set(arch "error")
         endif()
+    elseif ("${target}" MATCHES "rvv")
+        if ("${bit}" STREQUAL "64")
+            set(arch "riscv64")
+        else()
+            set(arch "error")
+        endif()
     elseif ("${target}" MATCHES "gen9|xe")
         set(arch "xe64")
     endif()
@@ -125,6 +131,16 @@ function (generate_stdlib_or_target_builtins func ispc_name CPP_LIST BC_LIST)
             # Not all targets have 64bit
             disp_target_stdlib(${func} ${ispc_name} neon-i32x4 64 ${os} ${CPP_LIST} ${BC_LIST})
             disp_target_stdlib(${func} ${ispc_name} neon-i32x8 64 ${os} ${CPP_LIST} ${BC_LIST})
+            foreach (target ${ARM_SVE_TARGETS})
+                disp_target_stdlib(${func} ${ispc_name} ${target} 64 ${os} ${CPP_LIST} ${BC_LIST})
+            endforeach()
+        endforeach()
+    endif()
+
+    # RISC-V targets, 64-bit Linux only.
+    if (RISCV_ENABLED AND ISPC_UNIX_TARGET)
+        foreach (target ${RISCV_TARGETS})
+            disp_target_stdlib(${func} ${ispc_name} ${target} 64 unix ${CPP_LIST} ${BC_LIST})
         endforeach()
     endif()
 
@@ -52,9 +52,14 @@ list(APPEND M4_IMPLICIT_DEPENDENCIES
     builtins/target-avx512-common-8.ll
     builtins/target-avx512-common-16.ll
     builtins/target-avx512-utils.ll
+    builtins/target-avx512spr-x4.ll
+    builtins/target-avx512spr-x8.ll
     builtins/target-neon-common.ll
+    builtins/target-rvv-common.ll
     builtins/target-sse2-common.ll
     builtins/target-sse4-common.ll
+    builtins/target-sve-common.ll
+    builtins/target-wasm-common.ll
     builtins/target-xe.ll
     builtins/util-xe.m4
     builtins/util.m4)
@@ -81,7 +86,7 @@ function(target_ll_to_cpp target bit os CPP_LIST BC_LIST)
 
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=ispc-target --runtime=${bit} --os=${OS_UP} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=ispc-target --runtime=${bit} --os=${OS_UP} ${cpp}
         DEPENDS ${bc} ${BITCODE2CPP}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
     )
@@ -123,7 +128,7 @@ function(generate_dispatcher os)
 
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=dispatch --os=${os} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=dispatch --os=${os} ${cpp}
         DEPENDS ${bc} ${BITCODE2CPP}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
     )
@@ -166,7 +171,7 @@ function(builtin_wasm_to_cpp bit os arch)
 
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
         DEPENDS ${bc} ${BITCODE2CPP}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
     )
@@ -193,6 +198,9 @@ function (get_target_flags os arch out)
         elseif (${arch} STREQUAL "armv7")
             set(triple ${arch}-unknown-linux-gnueabihf)
             set(debian_triple arm-linux-gnueabihf)
+        elseif (${arch} STREQUAL "riscv64")
+            set(triple ${arch}-unknown-linux-gnu)
+            set(debian_triple ${arch}-linux-gnu)
         else()
             message(FATAL_ERROR "Error")
         endif()
@@ -283,6 +291,8 @@ function(builtin_to_cpp bit os generic_arch)
         set(arch "armv7")
     elseif ("${bit}" STREQUAL "64" AND ${generic_arch} STREQUAL "arm")
         set(arch "aarch64")
+    elseif ("${bit}" STREQUAL "64" AND ${generic_arch} STREQUAL "riscv")
+        set(arch "riscv64")
     else()
         message(FATAL_ERROR "Error")
     endif()
@@ -312,7 +322,7 @@ function(builtin_to_cpp bit os generic_arch)
 
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
         DEPENDS ${bc} ${BITCODE2CPP}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
     )
@@ -347,7 +357,7 @@ function(builtin_xe_to_cpp os)
 
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=builtins-c --runtime=${bit} --os=${os} --arch=${arch} ${cpp}
         DEPENDS ${bc} ${BITCODE2CPP}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
         )
@@ -415,6 +425,10 @@ function (generate_common_builtins)
         builtin_to_cpp(64 linux x86)
     endif()
 
+    if (ISPC_LINUX_TARGET AND RISCV_ENABLED)
+        builtin_to_cpp(64 linux riscv)
+    endif()
+
     if (ISPC_ANDROID_TARGET AND ARM_ENABLED)
         builtin_to_cpp(32 android arm)
         builtin_to_cpp(64 android arm)
@@ -30,8 +30,8 @@ function (stdlib_to_cpp ispc_name target bit os CPP_LIST BC_LIST)
         if ("${bit}" STREQUAL "32")
             return()
         endif()
-        # ISPC doesn't support avx512spr targets on macOS
-        if ("${target}" MATCHES "avx512spr")
+        # ISPC doesn't support avx512spr and avx10 targets on macOS
+        if ("${target}" MATCHES "avx512spr|avx10")
             return()
         endif()
     endif()
@@ -51,7 +51,7 @@ function (stdlib_to_cpp ispc_name target bit os CPP_LIST BC_LIST)
     string(TOUPPER ${os} OS_UP)
     add_custom_command(
         OUTPUT ${cpp}
-        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} --type=stdlib --runtime=${bit} --os=${OS_UP} ${cpp}
+        COMMAND ${Python3_EXECUTABLE} ${BITCODE2CPP} ${bc} ${BITCODE2CPP_FLAGS} --type=stdlib --runtime=${bit} --os=${OS_UP} ${cpp}
         DEPENDS ${BITCODE2CPP} ${bc}
         WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
     )
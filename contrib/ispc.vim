@@ -14,18 +14,18 @@ runtime! syntax/c.vim
 unlet b:current_syntax
 
 " New keywords
-syn keyword	ispcStatement		assert assume cbreak ccontinue creturn delete launch new print soa sync task unmasked
+syn keyword	ispcStatement		assert assume cbreak ccontinue creturn delete launch new print soa sync task task_group unmasked
 syn keyword	ispcConditional		cif
-syn keyword	ispcRepeat		cdo cfor cwhile foreach foreach_tiled foreach_unique foreach_active
+syn keyword	ispcRepeat		cdo cfor cwhile foreach foreach_tiled foreach_unique foreach_active foreach_dynamic parallel_foreach
 syn keyword	ispcBuiltin		programCount programIndex taskCount taskCount0 taskCount1 taskCount3 taskIndex taskIndex0 taskIndex1 taskIndex2
 syn keyword	ispcType		export uniform varying int8 int16 int32 int64 uint8 uint16 uint32 uint64 float16
 syn keyword	ispcOperator		operator in
-syn keyword	ispcStorageClass	noinline __vectorcall __regcall
+syn keyword	ispcStorageClass	noinline constexpr __vectorcall __regcall
 syn keyword	ispcTemplates		template typename
 syn keyword	ispcDefine		ISPC ISPC_POINTER_SIZE ISPC_MAJOR_VERSION ISPC_MINOR_VERSION TARGET_WIDTH PI
 					\ TARGET_ELEMENT_WIDTH ISPC_UINT_IS_DEFINED ISPC_FP16_SUPPORTED ISPC_FP64_SUPPORTED ISPC_LLVM_INTRINSICS_ENABLED
 					\ ISPC_TARGET_NEON ISPC_TARGET_SSE2 ISPC_TARGET_SSE4 ISPC_TARGET_AVX ISPC_TARGET_AVX2 ISPC_TARGET_AVX512KNL ISPC_TARGET_AVX512SKX
-					\ ISPC_TARGET_AVX512SPR
+					\ ISPC_TARGET_AVX512SPR ISPC_TARGET_AVX10
 
 
 " LLVM intrinsics are ISPC intrinsics
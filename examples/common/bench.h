@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+// Command line options and results, which are common to the benchmarking
+// examples, so that examples/cpu/run_benchmarks.py runs them all in the same
+// way:
+//
+//   --iterations=N   run every variant N times instead of the defaults of
+//                    the example
+//   --json=FILE      write the minimum times of the variants to FILE
+//
+// The options may come anywhere on the command line and are removed from
+// argv, so the examples parse the rest of their arguments as before.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    // 0 keeps the defaults of the example.
+    unsigned int iterations = 0;
+    const char *jsonFile = nullptr;
+};
+
+static inline BenchOptions bench_parse_options(int &argc, char *argv[]) {
+    BenchOptions options;
+    int n = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            int iterations = atoi(argv[i] + 13);
+            if (iterations <= 0) {
+                fprintf(stderr, "Invalid number of iterations \"%s\".\n", argv[i] + 13);
+                exit(1);
+            }
+            options.iterations = iterations;
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            options.jsonFile = argv[i] + 7;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    argc = n;
+    argv[n] = nullptr;
+    return options;
+}
+
+// Overrides the numbers of runs of the variants with --iterations.
+static inline void bench_override_iterations(const BenchOptions &options, unsigned int iterations[], int count) {
+    if (options.iterations == 0)
+        return;
+    for (int i = 0; i < count; ++i)
+        iterations[i] = options.iterations;
+}
+
+// The minimum times of the variants of an example. A variant, which has a
+// baseline, gets the speedup over it, which is usually the serial C++
+// implementation of the example.
+class BenchReport {
+  public:
+    BenchReport(const char *name, const char *unit = "mcycles") : name(name), unit(unit) {}
+
+    void add(const char *variant, double time, const char *baseline = nullptr) {
+        results.push_back(Result{variant, time, baseline ? baseline : ""});
+    }
+
+    // Writes the report to the --json file, if there is one.
+    void write(const BenchOptions &options) const {
+        if (options.jsonFile == nullptr)
+            return;
+        FILE *f = fopen(options.jsonFile, "w");
+        if (!f) {
+            perror(options.jsonFile);
+            exit(1);
+        }
+        fprintf(f, "{\n  \"name\": \"%s\",\n  \"unit\": \"%s\",\n", name.c_str(), unit.c_str());
+        if (options.iterations != 0)
+            fprintf(f, "  \"iterations\": %u,\n", options.iterations);
+        fprintf(f, "  \"results\": [");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result &r = results[i];
+            fprintf(f, "%s\n    {\"variant\": \"%s\", \"time\": %.6f", i ? "," : "", r.variant.c_str(), r.time);
+            const Result *base = find(r.baseline);
+            if (base != nullptr && r.time > 0)
+                fprintf(f, ", \"baseline\": \"%s\", \"speedup\": %.4f", base->variant.c_str(), base->time / r.time);
+            fprintf(f, "}");
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+    }
+
+  private:
+    struct Result {
+        std::string variant;
+        double time;
+        std::string baseline;
+    };
+
+    std::string name;
+    std::string unit;
+    std::vector<Result> results;
+
+    const Result *find(const std::string &variant) const {
+        if (variant.empty())
+            return nullptr;
+        for (const Result &r : results) {
+            if (r.variant == variant)
+                return &r;
+        }
+        return nullptr;
+    }
+};
@@ -35,6 +35,14 @@
 #define ISPC_USE_TBB_TASK_GROUP
 #define ISPC_USE_TBB_PARALLEL_FOR
 
+  The idle worker threads of the ISPC_USE_PTHREADS model spin for a while
+  before they block, so back-to-back launches don't pay the wake-up latency.
+  The spin budget adapts to the gaps between the launches up to the maximum
+  set with the ISPCRT_TASK_SPIN_US environment variable (50 microseconds by
+  default, 0 blocks right away).  The ISPCRT_TASK_THREADS environment variable
+  sets the number of the threads running the tasks, including the one which
+  launches them (one thread per CPU by default).
+
   The ISPC_USE_PTHREADS_FULLY_SUBSCRIBED model essentially takes over the machine
   by assigning one pthread to each hyper-thread, and then uses spinlocks and atomics
   for task management.  This model is useful for KNC where tasks can take over
@@ -88,9 +96,11 @@ using namespace Concurrency;
 #endif // ISPC_USE_GCD
 #ifdef ISPC_USE_PTHREADS
 #include <algorithm>
+#include <chrono>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -135,6 +145,9 @@ using namespace Concurrency;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 // Signature of ispc-generated 'task' functions
 typedef void (*TaskFuncType)(void *data, int threadIndex, int threadCount, int taskIndex, int taskCount, int taskIndex0,
@@ -169,11 +182,15 @@ void ISPCSync(void *handle);
 ///////////////////////////////////////////////////////////////////////////
 // TaskGroupBase
 
-#define LOG_TASK_QUEUE_CHUNK_SIZE 14
-#define MAX_TASK_QUEUE_CHUNKS 128
-#define TASK_QUEUE_CHUNK_SIZE (1 << LOG_TASK_QUEUE_CHUNK_SIZE)
+// The first segment of the task storage is a part of the task group, every
+// next one is twice as large as all of the previous ones together, so
+// MAX_TASK_SEGMENTS segments cover all non-negative int task indices.
+#define LOG_FIRST_TASK_SEGMENT_SIZE 4
+#define FIRST_TASK_SEGMENT_SIZE (1 << LOG_FIRST_TASK_SEGMENT_SIZE)
+#define MAX_TASK_SEGMENTS (32 - LOG_FIRST_TASK_SEGMENT_SIZE)
 
-#define MAX_LAUNCHED_TASKS (MAX_TASK_QUEUE_CHUNKS * TASK_QUEUE_CHUNK_SIZE)
+// Number of free segments of every size kept for the reuse.
+#define MAX_FREE_TASK_SEGMENTS 4
 
 #define NUM_MEM_BUFFERS 16
 
@@ -200,12 +217,19 @@ class TaskGroupBase {
     int nextTaskInfoIndex;
 
   private:
-    /* We allocate blocks of TASK_QUEUE_CHUNK_SIZE TaskInfo structures as
-       needed by the calling function.  We hold up to MAX_TASK_QUEUE_CHUNKS
-       of these (and then exit at runtime if more than this many tasks are
-       launched.)
+    TaskInfo *AllocTaskSegment(int segment);
+
+    /* TaskInfo structures are stored in segments of growing size: the
+       first FIRST_TASK_SEGMENT_SIZE ones are in firstTaskSegment, so
+       launching a few tasks doesn't allocate, and segment i > 0 holds
+       FIRST_TASK_SEGMENT_SIZE << (i - 1) of them.  The segments are
+       allocated as needed by the launching thread and never move, so the
+       workers access the tasks without taking any locks.  They are kept
+       across Reset() and returned to a global free list when the task
+       group is destroyed.
      */
-    TaskInfo *taskInfo[MAX_TASK_QUEUE_CHUNKS];
+    TaskInfo *taskSegments[MAX_TASK_SEGMENTS];
+    TaskInfo firstTaskSegment[FIRST_TASK_SEGMENT_SIZE];
 
     /* We also allocate chunks of memory to service ISPCAlloc() calls.  The
        memBuffers[] array holds pointers to this memory.  The first element
@@ -230,15 +254,9 @@ inline TaskGroupBase::TaskGroupBase() {
         memBufferSize[i] = 0;
     }
 
-    for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
-        taskInfo[i] = nullptr;
-}
-
-inline TaskGroupBase::~TaskGroupBase() {
-    // Note: don't delete memBuffers[0], since it points to the start of
-    // the "mem" member!
-    for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
-        delete[](memBuffers[i]);
+    taskSegments[0] = firstTaskSegment;
+    for (int i = 1; i < MAX_TASK_SEGMENTS; ++i)
+        taskSegments[i] = nullptr;
 }
 
 inline void TaskGroupBase::Reset() {
@@ -253,24 +271,30 @@ inline int TaskGroupBase::AllocTaskInfo(int count) {
     return ret;
 }
 
-inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
-    int chunk = (index >> LOG_TASK_QUEUE_CHUNK_SIZE);
-    int offset = index & (TASK_QUEUE_CHUNK_SIZE - 1);
-
-    if (chunk == MAX_TASK_QUEUE_CHUNKS) {
-        fprintf(stderr,
-                "A total of %d tasks have been launched from the "
-                "current function--the simple built-in task system can handle "
-                "no more. You can increase the values of TASK_QUEUE_CHUNK_SIZE "
-                "and LOG_TASK_QUEUE_CHUNK_SIZE to work around this limitation.  "
-                "Sorry!  Exiting.\n",
-                index);
-        exit(1);
-    }
+// Index of the most significant set bit of v, which must be non-zero.
+static inline int lLog2(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanReverse(&result, v);
+    return (int)result;
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
 
-    if (taskInfo[chunk] == nullptr)
-        taskInfo[chunk] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE];
-    return &taskInfo[chunk][offset];
+inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
+    if (index < FIRST_TASK_SEGMENT_SIZE)
+        return &firstTaskSegment[index];
+
+    // Segment i > 0 starts at index 1 << (i - 1 + LOG_FIRST_TASK_SEGMENT_SIZE).
+    int log2 = lLog2((uint32_t)index);
+    int segment = log2 - LOG_FIRST_TASK_SEGMENT_SIZE + 1;
+    int offset = index - (1 << log2);
+
+    TaskInfo *taskSegment = taskSegments[segment];
+    if (taskSegment == nullptr)
+        taskSegment = AllocTaskSegment(segment);
+    return &taskSegment[offset];
 }
 
 inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
@@ -334,6 +358,50 @@ static inline int32_t lAtomicAdd(volatile int32_t *v, int32_t delta) {
 #endif
 }
 
+///////////////////////////////////////////////////////////////////////////
+// TaskGroupBase task storage
+
+static TaskInfo *freeTaskSegments[MAX_TASK_SEGMENTS][MAX_FREE_TASK_SEGMENTS];
+
+inline TaskInfo *TaskGroupBase::AllocTaskSegment(int segment) {
+    for (int i = 0; i < MAX_FREE_TASK_SEGMENTS; ++i) {
+        TaskInfo *ts = freeTaskSegments[segment][i];
+        if (ts != nullptr) {
+            // The swap returns the previous value of the slot: it took the
+            // segment only if that's still the one read above.
+            void *ptr = lAtomicCompareAndSwapPointer((void **)(&freeTaskSegments[segment][i]), nullptr, ts);
+            if (ptr == ts) {
+                taskSegments[segment] = (TaskInfo *)ptr;
+                return taskSegments[segment];
+            }
+        }
+    }
+
+    taskSegments[segment] = new TaskInfo[FIRST_TASK_SEGMENT_SIZE << (segment - 1)];
+    return taskSegments[segment];
+}
+
+inline TaskGroupBase::~TaskGroupBase() {
+    // Note: don't delete memBuffers[0], since it points to the start of
+    // the "mem" member!
+    for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
+        delete[](memBuffers[i]);
+
+    // Same for taskSegments[0], which is firstTaskSegment.
+    for (int segment = 1; segment < MAX_TASK_SEGMENTS; ++segment) {
+        TaskInfo *ts = taskSegments[segment];
+        if (ts == nullptr)
+            continue;
+        bool freed = false;
+        for (int i = 0; i < MAX_FREE_TASK_SEGMENTS && !freed; ++i) {
+            if (freeTaskSegments[segment][i] == nullptr)
+                freed = lAtomicCompareAndSwapPointer((void **)&freeTaskSegments[segment][i], ts, nullptr) == nullptr;
+        }
+        if (!freed)
+            delete[] ts;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 #ifdef ISPC_USE_CONCRT
@@ -548,9 +616,96 @@ static pthread_mutex_t taskSysMutex;
 static std::vector<TaskGroup *> activeTaskGroups;
 static sem_t *workerSemaphore;
 
+#define SPIN_DEFAULT_US 50
+#define SPIN_MAX_US 1000000
+// The budget doesn't shrink below it, so it can grow back.
+#define SPIN_MIN_NS 1000
+
+// Maximum of the spin budget of the idle workers in nanoseconds.
+static int64_t spinMaxNs = int64_t(SPIN_DEFAULT_US) * 1000;
+
+static void lInitSpinBudget() {
+    const char *env = getenv("ISPCRT_TASK_SPIN_US");
+    if (env == nullptr || *env == '\0')
+        return;
+    char *end;
+    long us = strtol(env, &end, 10);
+    if (*end != '\0' || us < 0 || us > SPIN_MAX_US) {
+        fprintf(stderr,
+                "Unknown ISPCRT_TASK_SPIN_US value \"%s\", "
+                "expected a number of microseconds from 0 to %d.\n",
+                env, SPIN_MAX_US);
+        return;
+    }
+    spinMaxNs = int64_t(us) * 1000;
+}
+
+// Number of CPUs the process may run on, so that the pool follows the
+// affinity mask set with taskset or numactl, unless ISPCRT_TASK_THREADS
+// asks for a given number of threads.
+static int lNumCPUs() {
+    const char *env = getenv("ISPCRT_TASK_THREADS");
+    if (env != nullptr && *env != '\0') {
+        char *end;
+        long threads = strtol(env, &end, 10);
+        if (*end == '\0' && threads > 0 && threads <= 4096)
+            return (int)threads;
+        fprintf(stderr, "Unknown ISPCRT_TASK_THREADS value \"%s\", expected a positive number of threads.\n", env);
+    }
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        return CPU_COUNT(&allowed);
+#endif
+    return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static inline void lCpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Wait for the worker semaphore: spin on it for the budget and then block.
+// The budget doubles when the thread is woken up soon after it blocked, and
+// halves when it stayed blocked longer than the maximum budget.
+static void lWaitForWork(int64_t &budgetNs) {
+    using namespace std::chrono;
+    if (budgetNs > 0) {
+        auto start = steady_clock::now();
+        for (unsigned int i = 1;; ++i) {
+            if (sem_trywait(workerSemaphore) == 0)
+                return;
+            lCpuRelax();
+            if ((i & 15) == 0 && steady_clock::now() - start > nanoseconds(budgetNs))
+                break;
+        }
+    }
+    auto start = steady_clock::now();
+    while (sem_wait(workerSemaphore) != 0) {
+        if (errno != EINTR) {
+            fprintf(stderr, "Error from sem_wait: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+    if (steady_clock::now() - start <= nanoseconds(spinMaxNs))
+        budgetNs = std::min(std::max(budgetNs * 2, int64_t(SPIN_MIN_NS)), spinMaxNs);
+    else
+        budgetNs = std::max(budgetNs / 2, std::min(int64_t(SPIN_MIN_NS), spinMaxNs));
+}
+
+// Index of the calling thread, which is passed to the tasks: the workers
+// are threads 1..nThreads and the threads, which launch the tasks, are 0.
+static thread_local int lThreadIndex = 0;
+
 static void *lTaskEntry(void *arg) {
-    int threadIndex = (int)((int64_t)arg);
-    int threadCount = nThreads;
+    int threadIndex = (int)((int64_t)arg) + 1;
+    int threadCount = nThreads + 1;
+    lThreadIndex = threadIndex;
+    int64_t spinBudgetNs = spinMaxNs;
 
     while (1) {
         int err;
@@ -558,10 +713,7 @@ static void *lTaskEntry(void *arg) {
         // Wait on the semaphore until we're woken up due to the arrival of
         // more work.
         //
-        if ((err = sem_wait(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
-            exit(1);
-        }
+        lWaitForWork(spinBudgetNs);
 
         //
         // Acquire the mutex
@@ -632,7 +784,8 @@ static void InitTaskSystem() {
                     // We launch one fewer thread than there are cores,
                     // since the main thread here will also grab jobs from
                     // the task queue itself.
-                    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+                    nThreads = lNumCPUs() - 1;
+                    lInitSpinBudget();
 
                     int err;
                     if ((err = pthread_mutex_init(&taskSysMutex, nullptr)) != 0) {
@@ -780,12 +933,11 @@ inline void TaskGroup::Sync() {
                     fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
                     exit(1);
                 }
-                // FIXME: We basically end up busy-waiting here, which is
-                // extra wasteful in a world with hyper-threading.  It would
-                // be much better to put this thread to sleep on a
-                // condition variable that was signaled when the last task
-                // in this group was finished.
-                usleep(1);
+                // The remaining tasks of this group are running on other
+                // threads and may launch nested tasks, which we can help
+                // with, so poll instead of blocking.  Yield the CPU to the
+                // threads running our tasks in case of oversubscription.
+                sched_yield();
                 continue;
             }
 
@@ -813,10 +965,10 @@ inline void TaskGroup::Sync() {
         //
         // Do work for _myTask_
         //
-        // FIXME: bogus values for thread index/thread count here as well..
-        myTask->func(myTask->data, 0, 1, myTask->taskIndex, myTask->taskCount(), myTask->taskIndex0(),
-                     myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(), myTask->taskCount1(),
-                     myTask->taskCount2());
+        // A worker syncing nested tasks runs them as itself.
+        myTask->func(myTask->data, lThreadIndex, nThreads + 1, myTask->taskIndex, myTask->taskCount(),
+                     myTask->taskIndex0(), myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(),
+                     myTask->taskCount1(), myTask->taskCount2());
 
         //
         // Decrement the number of unfinished tasks counter
@@ -946,8 +1098,10 @@ static inline TaskGroup *AllocTaskGroup() {
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         TaskGroup *tg = freeTaskGroups[i];
         if (tg != nullptr) {
+            // Same as for the task segments: the group is taken only if the
+            // slot still holds it.
             void *ptr = lAtomicCompareAndSwapPointer((void **)(&freeTaskGroups[i]), nullptr, tg);
-            if (ptr != nullptr) {
+            if (ptr == tg) {
                 return (TaskGroup *)ptr;
             }
         }
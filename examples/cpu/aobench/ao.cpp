@@ -27,6 +27,7 @@
 #include "ao_ispc.h"
 using namespace ispc;
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 
 #define NSUBSAMPLES 2
@@ -73,6 +74,7 @@ static void savePPM(const char *fname, int w, int h) {
 }
 
 int main(int argc, char **argv) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     if (argc < 3) {
         printf("%s\n", argv[0]);
         printf("Usage: ao [width] [height] [ispc iterations] [tasks iterations] [serial iterations]\n");
@@ -86,6 +88,7 @@ int main(int argc, char **argv) {
         width = atoi(argv[1]);
         height = atoi(argv[2]);
     }
+    bench_override_iterations(bench, test_iterations, 3);
 
     // Allocate space for output images
     img = new unsigned char[width * height * 3];
@@ -151,5 +154,11 @@ int main(int argc, char **argv) {
            minTimeSerial / minTimeISPCTasks);
     savePPM("ao-serial.ppm", width, height);
 
+    BenchReport report("aobench");
+    report.add("serial", minTimeSerial);
+    report.add("ispc", minTimeISPC, "serial");
+    report.add("ispc + tasks", minTimeISPCTasks, "serial");
+    report.write(bench);
+
     return 0;
 }
@@ -33,9 +33,11 @@ int countbits(uint64_t i) {
 
 // Callback function that ispc compiler emits calls to when --instrument
 // command-line flag is given while compiling.
-void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask) {
+void ISPCInstrument(const ISPCInstrumentSites *sites, uint32_t id, uint64_t mask) {
+    assert(id < sites->numSites);
+    const ISPCInstrumentSite &site = sites->sites[id];
     std::stringstream s;
-    s << fn << "(" << std::setfill('0') << std::setw(4) << line << ") - " << note;
+    s << site.file << "(" << std::setfill('0') << std::setw(4) << site.line << ") - " << site.note;
 
     // Find or create a CallInfo instance for this callsite.
     CallInfo &ci = callInfo[s.str()];
@@ -10,7 +10,23 @@
 #include <stdint.h>
 
 extern "C" {
-void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask);
+// The table of the instrumentation sites of a compiled module, the same as
+// in the header generated by ispc.
+#ifndef ISPC_INSTRUMENT_SITES_DEFINED
+#define ISPC_INSTRUMENT_SITES_DEFINED
+struct ISPCInstrumentSite {
+    const char *file;
+    const char *function;
+    const char *note;
+    int32_t line;
+};
+struct ISPCInstrumentSites {
+    uint32_t numSites;
+    const struct ISPCInstrumentSite *sites;
+};
+#endif // ISPC_INSTRUMENT_SITES_DEFINED
+
+void ISPCInstrument(const struct ISPCInstrumentSites *sites, uint32_t id, uint64_t mask);
 }
 
 void ISPCPrintInstrument();
@@ -28,6 +28,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #endif
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "deferred.h"
 #include "kernels_ispc.h"
@@ -35,6 +36,7 @@
 ///////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char **argv) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     if (argc < 2) {
         printf(
             "usage: deferred_shading <input_file (e.g. data/pp1280x720.bin)> [tasks iterations] [serial iterations]\n");
@@ -46,6 +48,8 @@ int main(int argc, char **argv) {
             test_iterations[i] = atoi(argv[2 + i]);
         }
     }
+    // The number of frames isn't a number of runs.
+    bench_override_iterations(bench, test_iterations, 2);
 
     InputData *input = CreateInputDataFromFile(argv[1]);
     if (!input) {
@@ -91,6 +95,11 @@ int main(int argc, char **argv) {
 
     printf("\t\t\t\t(%.2fx speedup from ISPC + tasks)\n", serialCycles / ispcCycles);
 
+    BenchReport report("deferred");
+    report.add("serial dynamic", serialCycles);
+    report.add("ispc static + tasks", ispcCycles, "serial dynamic");
+    report.write(bench);
+
     DeleteInputData(input);
 
     return 0;
@@ -11,6 +11,7 @@
 #pragma warning(disable : 4305)
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "mandelbrot_tasks_ispc.h"
 #include <algorithm>
@@ -49,6 +50,7 @@ static void usage() {
 }
 
 int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     static unsigned int test_iterations[] = {7, 1};
     unsigned int width = 1536;
     unsigned int height = 1024;
@@ -74,6 +76,7 @@ int main(int argc, char *argv[]) {
             test_iterations[i] = atoi(argv[argc - 2 + i]);
         }
     }
+    bench_override_iterations(bench, test_iterations, 2);
 
     int maxIterations = 512;
     int *buf = new int[width * height];
@@ -118,5 +121,10 @@ int main(int argc, char *argv[]) {
 
     printf("\t\t\t\t(%.2fx speedup from ISPC + tasks)\n", minSerial / minISPC);
 
+    BenchReport report("mandelbrot_tasks");
+    report.add("serial", minSerial);
+    report.add("ispc + tasks", minISPC, "serial");
+    report.write(bench);
+
     return 0;
 }
@@ -11,6 +11,7 @@
 #pragma warning(disable : 4305)
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "noise_ispc.h"
 #include <algorithm>
@@ -44,6 +45,7 @@ static void writePPM(float *buf, int width, int height, const char *fn) {
 }
 
 int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     static unsigned int test_iterations[] = {3, 1};
     unsigned int width = 768;
     unsigned int height = 768;
@@ -64,6 +66,7 @@ int main(int argc, char *argv[]) {
             test_iterations[i] = atoi(argv[argc - 2 + i]);
         }
     }
+    bench_override_iterations(bench, test_iterations, 2);
     float *buf = new float[width * height];
 
     //
@@ -104,5 +107,10 @@ int main(int argc, char *argv[]) {
 
     printf("\t\t\t\t(%.2fx speedup from ISPC)\n", minSerial / minISPC);
 
+    BenchReport report("noise");
+    report.add("serial", minSerial);
+    report.add("ispc", minISPC, "serial");
+    report.write(bench);
+
     return 0;
 }
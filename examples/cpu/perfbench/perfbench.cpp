@@ -14,6 +14,7 @@
 #define WINDOWS
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include <algorithm>
 #include <stdio.h>
@@ -54,34 +55,43 @@ static PerfTest tests[] = {
     {ispc::scatters, "scatter", ispc::stores, "vector store", "Memory writes"},
 };
 
-int main() {
+// The time of 100 calls of the function.
+static double lTime(FuncType *func, float *a, int count, float *zeros) {
+    lInitData(a, count);
+    reset_and_start_timer();
+    float result[3] = {0, 0, 0};
+    for (int j = 0; j < 100; ++j)
+        func(a, count, zeros, result);
+    return get_elapsed_mcycles();
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
+    unsigned int test_iterations[] = {1};
+    bench_override_iterations(bench, test_iterations, 1);
+
     int count = 3 * 64 * 1024;
     float *a = new float[count];
     float zeros[32] = {0};
 
+    BenchReport report("perfbench");
     int nTests = sizeof(tests) / sizeof(tests[0]);
     for (int i = 0; i < nTests; ++i) {
-        lInitData(a, count);
-        reset_and_start_timer();
-        float resultA[3] = {0, 0, 0};
-        for (int j = 0; j < 100; ++j)
-            tests[i].aFunc(a, count, zeros, resultA);
-        double aTime = get_elapsed_mcycles();
-
-        lInitData(a, count);
-        reset_and_start_timer();
-        float resultB[3] = {0, 0, 0};
-        for (int j = 0; j < 100; ++j)
-            tests[i].bFunc(a, count, zeros, resultB);
-        double bTime = get_elapsed_mcycles();
+        double aTime = 1e30, bTime = 1e30;
+        for (unsigned int k = 0; k < test_iterations[0]; ++k) {
+            aTime = std::min(aTime, lTime(tests[i].aFunc, a, count, zeros));
+            bTime = std::min(bTime, lTime(tests[i].bFunc, a, count, zeros));
+        }
 
         printf("%-40s: [%.2f] M cycles %s, [%.2f] M cycles %s (%.2fx speedup).\n", tests[i].testName, aTime,
                tests[i].aName, bTime, tests[i].bName, aTime / bTime);
-#if 0
-        printf("\t(%f %f %f) - (%f %f %f)\n", resultSerial[0], resultSerial[1],
-               resultSerial[2], resultISPC[0], resultISPC[1], resultISPC[2]);
-#endif
+
+        std::string aVariant = std::string(tests[i].testName) + ": " + tests[i].aName;
+        std::string bVariant = std::string(tests[i].testName) + ": " + tests[i].bName;
+        report.add(aVariant.c_str(), aTime);
+        report.add(bVariant.c_str(), bTime, aVariant.c_str());
     }
+    report.write(bench);
 
     return 0;
 }
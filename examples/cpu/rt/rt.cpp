@@ -11,6 +11,7 @@
 #pragma warning(disable : 4305)
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "rt_ispc.h"
 #include <algorithm>
@@ -70,6 +71,7 @@ static void usage() {
 }
 
 int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     static unsigned int test_iterations[] = {3, 7, 1};
     float scale = 1.f;
     const char *filename = nullptr;
@@ -86,6 +88,7 @@ int main(int argc, char *argv[]) {
             test_iterations[i] = atoi(argv[argc - 3 + i]);
         }
     }
+    bench_override_iterations(bench, test_iterations, 3);
 
 #define READ(var, n)                                                                                                   \
     if (fread(&(var), sizeof(var), n, f) != (unsigned int)n) {                                                         \
@@ -232,5 +235,11 @@ int main(int argc, char *argv[]) {
 
     writeImage(id, image, width, height, "rt-serial.ppm");
 
+    BenchReport report("rt");
+    report.add("serial", minTimeSerial);
+    report.add("ispc", minTimeISPC, "serial");
+    report.add("ispc + tasks", minTimeISPCtasks, "serial");
+    report.write(bench);
+
     return 0;
 }
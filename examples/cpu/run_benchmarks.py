@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Registry of the examples, which compare ispc implementations with their
+# serial C++ ones, run with the same options and reported as one JSON file.
+# Every example writes the minimum times of its variants with --json (see
+# examples/common/bench.h), the speedups are relative to the serial
+# implementation of the example.
+#
+#   run_benchmarks.py --build-dir build -o examples.json --iterations=5 --threads=8
+#   run_benchmarks.py --build-dir build-avx2 --target=avx2-i32x8 --filter=rt
+#
+# --target reconfigures and builds the build directory for the given ispc
+# target, otherwise the examples are built for the targets, which the build
+# directory is configured with.  The "run_benchmarks" target of the examples
+# build runs all of them.
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+
+EXAMPLES_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+class Benchmark:
+    # The arguments may refer to the data files of the example in {src}.
+    def __init__(self, name, subdir, executable, args):
+        self.name = name
+        self.subdir = subdir
+        self.executable = executable
+        self.args = args
+
+    def command(self, build_dir):
+        src = os.path.join(EXAMPLES_DIR, self.subdir)
+        candidates = [os.path.join(build_dir, self.subdir), os.path.join(build_dir, self.subdir, "Release")]
+        for d in candidates:
+            for name in [self.executable, self.executable + ".exe"]:
+                path = os.path.join(d, name)
+                if os.path.isfile(path) and os.access(path, os.X_OK):
+                    return [path] + [arg.format(src=src) for arg in self.args]
+        return None
+
+
+BENCHMARKS = [
+    Benchmark("aobench", "aobench", "aobench", ["2048", "2048"]),
+    Benchmark("deferred", "deferred", "deferred_shading", ["{src}/data/pp1280x720.bin"]),
+    Benchmark("mandelbrot_tasks", "mandelbrot_tasks", "mandelbrot_tasks", []),
+    Benchmark("noise", "noise", "noise", []),
+    Benchmark("perfbench", "perfbench", "perfbench", []),
+    Benchmark("rt", "rt", "rt", ["{src}/sponza"]),
+    Benchmark("sgemm", "sgemm", "sgemm", []),
+    Benchmark("stencil", "stencil", "stencil", []),
+    Benchmark("volume_rendering", "volume_rendering", "volume_rendering",
+              ["{src}/camera.dat", "{src}/density_highres.vol"]),
+]
+
+
+def build(build_dir, args):
+    if args.target or not os.path.exists(os.path.join(build_dir, "CMakeCache.txt")):
+        cmd = ["cmake", "-S", EXAMPLES_DIR, "-B", build_dir, "-DCMAKE_BUILD_TYPE=Release"]
+        if args.target:
+            cmd += ["-DISPC_IA_TARGETS=" + args.target, "-DISPC_ARM_TARGETS=" + args.target]
+        if args.ispc:
+            cmd.append("-DISPC_EXECUTABLE=" + args.ispc)
+        subprocess.run(cmd, check=True)
+    subprocess.run(["cmake", "--build", build_dir, "--config", "Release", "--parallel"], check=True)
+
+
+def configured_targets(build_dir):
+    try:
+        with open(os.path.join(build_dir, "CMakeCache.txt")) as f:
+            for line in f:
+                m = re.match(r"ISPC_IA_TARGETS:STRING=(.*)", line)
+                if m and platform.machine().lower() in ["x86_64", "amd64", "i386", "i686"]:
+                    return m.group(1)
+                m = re.match(r"ISPC_ARM_TARGETS:STRING=(.*)", line)
+                if m and platform.machine().lower() in ["aarch64", "arm64"]:
+                    return m.group(1)
+    except OSError:
+        pass
+    return None
+
+
+def run_benchmarks(build_dir, args):
+    env = dict(os.environ)
+    if args.threads:
+        # The pthreads task system of the examples and OpenMP.
+        env["ISPCRT_TASK_THREADS"] = str(args.threads)
+        env["OMP_NUM_THREADS"] = str(args.threads)
+    report = {
+        "context": {
+            "date": datetime.datetime.now().isoformat(timespec="seconds"),
+            "host": platform.node(),
+            "build_dir": os.path.abspath(build_dir),
+            "target": args.target or configured_targets(build_dir),
+            "iterations": args.iterations,
+            "threads": args.threads,
+        },
+        "benchmarks": [],
+    }
+    failed = False
+    with tempfile.TemporaryDirectory() as tmp:
+        for bench in BENCHMARKS:
+            if args.filter and not re.search(args.filter, bench.name):
+                continue
+            cmd = bench.command(build_dir)
+            if cmd is None:
+                print("%s: the executable isn't found in %s" % (bench.name, build_dir), flush=True)
+                failed = True
+                continue
+            out_file = os.path.join(tmp, bench.name + ".json")
+            cmd.append("--json=" + out_file)
+            if args.iterations:
+                cmd.append("--iterations=%d" % args.iterations)
+            print("Running %s" % bench.name, flush=True)
+            # The examples write their images to the working directory.
+            run = subprocess.run(cmd, cwd=os.path.dirname(cmd[0]), env=env, stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT, text=True)
+            if run.returncode != 0 or not os.path.exists(out_file):
+                print("  failed with exit code %d:\n%s" % (run.returncode, run.stdout), flush=True)
+                failed = True
+                continue
+            with open(out_file) as f:
+                report["benchmarks"].append(json.load(f))
+    return report, failed
+
+
+def print_table(report):
+    rows = []
+    for bench in report["benchmarks"]:
+        for result in bench["results"]:
+            speedup = "%.2fx" % result["speedup"] if "speedup" in result else "baseline"
+            rows.append((bench["name"], result["variant"], "%.3f %s" % (result["time"], bench["unit"]), speedup))
+    if not rows:
+        return
+    widths = [max(len(row[i]) for row in rows) for i in range(3)]
+    for row in rows:
+        print("%-*s  %-*s  %*s  %s" % (widths[0], row[0], widths[1], row[1], widths[2], row[2], row[3]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the ispc examples as benchmarks")
+    parser.add_argument("--build-dir", default="build-benchmarks", help="build directory of the examples")
+    parser.add_argument("-o", "--output", help="output JSON file")
+    parser.add_argument("--iterations", type=int, help="runs of every variant, the minimum time is reported")
+    parser.add_argument("--threads", type=int, help="number of threads of the task system")
+    parser.add_argument("--target", help="ispc target to build the examples for, e.g. avx2-i32x8")
+    parser.add_argument("--ispc", help="ispc executable to build the examples with")
+    parser.add_argument("--filter", help="regular expression of the benchmarks to run")
+    parser.add_argument("--no-build", action="store_true", help="run the examples of the build directory as is")
+    parser.add_argument("--list", action="store_true", help="list the benchmarks and exit")
+    args = parser.parse_args()
+
+    if args.list:
+        for bench in BENCHMARKS:
+            print(bench.name)
+        return 0
+    if args.iterations is not None and args.iterations <= 0:
+        parser.error("the number of iterations must be positive")
+    if args.threads is not None and args.threads <= 0:
+        parser.error("the number of threads must be positive")
+    if args.target and args.no_build:
+        parser.error("--target needs to build the examples")
+
+    if not args.no_build:
+        build(args.build_dir, args)
+    report, failed = run_benchmarks(args.build_dir, args)
+    print_table(report)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -26,6 +26,7 @@ M  |         |   X     N |         |   =     M |         |
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 
 #include <math.h>
@@ -122,6 +123,9 @@ typedef void (*SGEMMFuncPtr_SingleThreaded)(float matrixA[], float matrixB[], fl
 typedef void (*SGEMMFuncPtr_MultiThreaded)(float matrixA[], float matrixB[], float matrixC[], unsigned int M,
                                            unsigned int N, unsigned int K);
 
+// The average times of the calls in milliseconds.
+static BenchReport report("sgemm", "msec");
+
 void Test_SGEMM(SGEMMFuncPtr SGEMMFunc, char *pcFuncName, float matrixA[], float matrixB[], float matrixC[],
                 unsigned int M, unsigned int N, unsigned int K, bool tasks, unsigned int numIterations,
                 float matrixValid[]) {
@@ -156,10 +160,13 @@ void Test_SGEMM(SGEMMFuncPtr SGEMMFunc, char *pcFuncName, float matrixA[], float
     bValid = Validate_result(matrixC, matrixValid, M, K);
     printf("%40s %10.4f millisecs %10.4f GFLOPs Validation: %s.\n", pcFuncName, avgTime,
            (fFlopsPerGEMM / (avgTime / 1000.0f)) / 1000000000.0f, (bValid ? "valid" : "ERROR"));
+    report.add(pcFuncName, avgTime, "serial");
     init_matrix(matrixC, M, K, 0.0f);
 }
 
 int main(int argc, char **argv) {
+    BenchOptions bench = bench_parse_options(argc, argv);
+
     // Random number filled matrix test case:
 
     // Default values for input parameters
@@ -202,6 +209,8 @@ int main(int argc, char **argv) {
         printf("\nInvalid number of inputs\n");
         exit(-1);
     }
+    if (bench.iterations != 0)
+        ITERATIONS = bench.iterations;
 
     int programCount = SGEMM_get_program_count();
     int tileSize = SGEMM_get_tile_size();
@@ -236,8 +245,13 @@ int main(int argc, char **argv) {
     matrixValid = (float *)malloc(M * K * sizeof(float));
     bool tasks = false;
 
-    // Generate a validation matrix using CPU code:
+    // Generate a validation matrix using CPU code, which is also the
+    // baseline of the report:
+    TIMER_DECLARE_AND_INIT();
+    TIMER_RESET_AND_START();
     SGEMM_CPU_validation(matrixA, matrixB, matrixValid, M, N, K);
+    double serialTime = TIMER_GET_ELAPSED_MSEC();
+    report.add("serial", serialTime);
 
     // Single threaded test cases:
     Test_SGEMM((SGEMMFuncPtr)SGEMM_naive, (char *)"SGEMM_naive", matrixA, matrixB, matrixC, M, N, K, tasks, ITERATIONS,
@@ -277,5 +291,6 @@ int main(int argc, char **argv) {
     free(matrixB);
     free(matrixC);
     free(matrixValid);
+    report.write(bench);
     return 0;
 }
@@ -11,6 +11,7 @@
 #pragma warning(disable : 4305)
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "stencil_ispc.h"
 #include <algorithm>
@@ -35,6 +36,7 @@ void InitData(int Nx, int Ny, int Nz, float *A[2], float *vsq) {
 }
 
 int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     static unsigned int test_iterations[] = {3, 3, 3}; // the last two numbers must be equal here
     int Nx = 256, Ny = 256, Nz = 256;
     int width = 4;
@@ -52,6 +54,7 @@ int main(int argc, char *argv[]) {
             test_iterations[i] = atoi(argv[argc - 3 + i]);
         }
     }
+    bench_override_iterations(bench, test_iterations, 3);
 
     float *Aserial[2], *Aispc[2];
     Aserial[0] = new float[Nx * Ny * Nz];
@@ -118,6 +121,12 @@ int main(int argc, char *argv[]) {
     printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n", minTimeSerial / minTimeISPC,
            minTimeSerial / minTimeISPCTasks);
 
+    BenchReport report("stencil");
+    report.add("serial", minTimeSerial);
+    report.add("ispc", minTimeISPC, "serial");
+    report.add("ispc + tasks", minTimeISPCTasks, "serial");
+    report.write(bench);
+
     // Check for agreement
     int offset = 0;
     for (int z = 0; z < Nz; ++z)
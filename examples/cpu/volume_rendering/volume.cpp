@@ -11,6 +11,7 @@
 #pragma warning(disable : 4305)
 #endif
 
+#include "../../common/bench.h"
 #include "../../common/timing.h"
 #include "volume_ispc.h"
 #include <algorithm>
@@ -109,6 +110,7 @@ static float *loadVolume(const char *fn, int n[3]) {
 }
 
 int main(int argc, char *argv[]) {
+    BenchOptions bench = bench_parse_options(argc, argv);
     static unsigned int test_iterations[] = {3, 7, 1};
     if (argc < 3) {
         fprintf(stderr, "usage: volume <camera.dat> <volume_density.vol> [ispc iterations] [tasks iterations] [serial "
@@ -120,6 +122,7 @@ int main(int argc, char *argv[]) {
             test_iterations[i] = atoi(argv[3 + i]);
         }
     }
+    bench_override_iterations(bench, test_iterations, 3);
 
     //
     // Load viewing data and the volume density data
@@ -191,5 +194,11 @@ int main(int argc, char *argv[]) {
     printf("\t\t\t\t(%.2fx speedup from ISPC, %.2fx speedup from ISPC + tasks)\n", minSerial / minISPC,
            minSerial / minISPCtasks);
 
+    BenchReport report("volume_rendering");
+    report.add("serial", minSerial);
+    report.add("ispc", minISPC, "serial");
+    report.add("ispc + tasks", minISPCtasks, "serial");
+    report.write(bench);
+
     return 0;
 }
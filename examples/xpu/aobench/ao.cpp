@@ -107,7 +107,7 @@ static int run() {
     // Init compute device (CPU or GPU)
     auto run_kernel = [&](ISPCRTDeviceType type) {
         auto device = ispcrtGetDevice(type, gpu_device_idx);
-        ISPCRTNewMemoryViewFlags flags;
+        ISPCRTNewMemoryViewFlags flags = {};
         flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
         flags.smHint = ISPCRT_SM_HOST_WRITE_DEVICE_READ;
 
@@ -145,7 +145,7 @@ int main(int argc, char *argv[]) {
     // Create task queue and execute kernel
     auto queue = ispcrtNewTaskQueue(device);
 
-    ISPCRTNewMemoryViewFlags flags;
+    ISPCRTNewMemoryViewFlags flags = {};
     flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
 
     std::vector<Plane> planes = {Plane{vec3f{0.f, -0.5f, 0.f}, vec3f{0.f, 1.f, 0.f}}};
@@ -0,0 +1,221 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+// Benchmarks of the overheads of ISPC Runtime itself: kernel launches,
+// command lists, copies and memory view allocations.  Every benchmark takes
+// the device type as its first argument and is skipped if there is no such
+// device.
+
+// Google Benchmark
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// ispcrt
+#include "ispcrt.hpp"
+
+// The device, the module and the queue are created once per device type, as
+// their creation is not what is measured.  They are never destroyed, so they
+// don't outlive the driver at exit.
+struct Setup {
+    explicit Setup(ISPCRTDeviceType type)
+        : device(type), module(device, "xe_overhead"), kernel(device, module, "empty_ispc"), queue(device) {}
+
+    ispcrt::Device device;
+    ispcrt::Module module;
+    ispcrt::Kernel kernel;
+    ispcrt::TaskQueue queue;
+};
+
+static Setup *getSetup(benchmark::State &state) {
+    static std::map<int64_t, Setup *> setups;
+    const auto type = static_cast<ISPCRTDeviceType>(state.range(0));
+    Setup *&setup = setups[state.range(0)];
+    if (setup == nullptr) {
+        if (ispcrt::Device::deviceCount(type) == 0) {
+            state.SkipWithError("no device of this type");
+            return nullptr;
+        }
+        setup = new Setup(type);
+    }
+    return setup;
+}
+
+static void deviceArgs(benchmark::internal::Benchmark *b) {
+    b->ArgName("device");
+    b->Arg(ISPCRT_DEVICE_TYPE_CPU);
+    b->Arg(ISPCRT_DEVICE_TYPE_GPU);
+}
+
+// Latency of a launch of the empty kernel followed by a sync.
+static void launch_latency(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    for (auto _ : state) {
+        s->queue.launch(s->kernel, 1);
+        s->queue.sync();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(launch_latency)->Apply(deviceArgs)->Unit(benchmark::kMicrosecond);
+
+// Throughput of back-to-back launches of the empty kernel, which are synced
+// once per batch.
+static void launch_batch(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    const int64_t batch = state.range(1);
+    for (auto _ : state) {
+        for (int64_t i = 0; i < batch; ++i)
+            s->queue.launch(s->kernel, 1);
+        s->queue.sync();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(launch_batch)
+    ->ArgNames({"device", "launches"})
+    ->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU}, {16, 256}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Cost of recording a command list of launches, without submitting it.
+static void command_list_record(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    const int64_t launches = state.range(1);
+    ispcrt::CommandQueue cq(s->device, 0);
+    ispcrt::CommandList cl = cq.createCommandList();
+    for (auto _ : state) {
+        for (int64_t i = 0; i < launches; ++i)
+            cl.launch(s->kernel, 1);
+        cl.close();
+        state.PauseTiming();
+        cl.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * launches);
+}
+BENCHMARK(command_list_record)
+    ->ArgNames({"device", "launches"})
+    ->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU}, {1, 64}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Cost of submitting a recorded command list and waiting for its fence.
+static void command_list_submit_sync(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    const int64_t launches = state.range(1);
+    ispcrt::CommandQueue cq(s->device, 0);
+    ispcrt::CommandList cl = cq.createCommandList();
+    for (int64_t i = 0; i < launches; ++i)
+        cl.launch(s->kernel, 1);
+    cl.close();
+    for (auto _ : state) {
+        ispcrt::Fence fence = cl.submit();
+        fence.sync();
+    }
+    state.SetItemsProcessed(state.iterations() * launches);
+}
+BENCHMARK(command_list_submit_sync)
+    ->ArgNames({"device", "launches"})
+    ->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU}, {1, 64}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Bandwidth of the copies of a device memory view from and to the host.
+template <bool toDevice> static void copy_bandwidth(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    std::vector<uint8_t> host(state.range(1), 1);
+    ispcrt::Array<uint8_t> view(s->device, host);
+    for (auto _ : state) {
+        if (toDevice)
+            s->queue.copyToDevice(view);
+        else
+            s->queue.copyToHost(view);
+        s->queue.sync();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(1));
+}
+static void copySizes(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"device", "bytes"});
+    b->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU},
+                    benchmark::CreateRange(int64_t(4) << 10, int64_t(256) << 20, /*multi=*/16)});
+}
+BENCHMARK_TEMPLATE(copy_bandwidth, true)->Name("copy_to_device")->Apply(copySizes)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(copy_bandwidth, false)->Name("copy_to_host")->Apply(copySizes)->Unit(benchmark::kMicrosecond);
+
+// Cost of creating, allocating and destroying a shared memory view with the
+// given ISPCRTSharedMemoryAllocationHint.  The views with the
+// ISPCRT_SM_HOST_WRITE_DEVICE_READ and ISPCRT_SM_HOST_READ_DEVICE_WRITE hints
+// come from the memory pool if ISPCRT_MEM_POOL=1.
+static void memory_view_create_destroy(benchmark::State &state) {
+    Setup *s = getSetup(state);
+    if (s == nullptr)
+        return;
+    ISPCRTNewMemoryViewFlags flags = {};
+    flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
+    flags.smHint = static_cast<ISPCRTSharedMemoryAllocationHint>(state.range(1));
+    const size_t bytes = state.range(2);
+    for (auto _ : state) {
+        ISPCRTMemoryView view = ispcrtNewMemoryView(s->device.handle(), nullptr, bytes, &flags);
+        // The memory is allocated on the first use.
+        benchmark::DoNotOptimize(ispcrtSharedPtr(view));
+        ispcrtRelease(view);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(memory_view_create_destroy)
+    ->ArgNames({"device", "hint", "bytes"})
+    ->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU},
+                   {ISPCRT_SM_HOST_DEVICE_READ_WRITE, ISPCRT_SM_HOST_WRITE_DEVICE_READ,
+                    ISPCRT_SM_HOST_READ_DEVICE_WRITE},
+                   {64, 64 << 10, 4 << 20}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Hit path of the memory pool: the chunk of the destroyed view is reused by
+// the next one.  The pool belongs to the context, so the views are created
+// for it.
+static void mem_pool_hit(benchmark::State &state) {
+    const char *env = getenv("ISPCRT_MEM_POOL");
+    if (env == nullptr || std::string(env) != "1") {
+        state.SkipWithError("the memory pool is enabled with ISPCRT_MEM_POOL=1");
+        return;
+    }
+    const auto type = static_cast<ISPCRTDeviceType>(state.range(0));
+    if (ispcrt::Device::deviceCount(type) == 0) {
+        state.SkipWithError("no device of this type");
+        return;
+    }
+    ispcrt::Context context(type);
+    ISPCRTNewMemoryViewFlags flags = {};
+    flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
+    flags.smHint = ISPCRT_SM_HOST_WRITE_DEVICE_READ;
+    const size_t bytes = state.range(1);
+    // Reserve the bulk of the pool before the measurement.
+    ISPCRTMemoryView warmup = ispcrtNewMemoryViewForContext(context.handle(), nullptr, bytes, &flags);
+    benchmark::DoNotOptimize(ispcrtSharedPtr(warmup));
+    ispcrtRelease(warmup);
+    for (auto _ : state) {
+        ISPCRTMemoryView view = ispcrtNewMemoryViewForContext(context.handle(), nullptr, bytes, &flags);
+        benchmark::DoNotOptimize(ispcrtSharedPtr(view));
+        ispcrtRelease(view);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(mem_pool_hit)
+    ->ArgNames({"device", "bytes"})
+    ->ArgsProduct({{ISPCRT_DEVICE_TYPE_CPU, ISPCRT_DEVICE_TYPE_GPU}, {64, 64 << 10}})
+    ->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,54 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include <iostream>
+#include <string>
+
+// ispcrt
+#include "ispcrt.hpp"
+
+// Launch the empty kernel of the benchmarks once, so the functional tests
+// check that the module of bench-overhead is built and loads on the device.
+static int run(const ISPCRTDeviceType device_type) {
+    ispcrt::Device device(device_type);
+    ispcrt::Module module(device, "xe_overhead");
+    ispcrt::Kernel kernel(device, module, "empty_ispc");
+    ispcrt::TaskQueue queue(device);
+
+    queue.launch(kernel, 1);
+    queue.sync();
+
+    std::cout << "Launched the empty kernel" << std::endl;
+    return 0;
+}
+
+void usage(const char *p) {
+    std::cout << "Usage:\n";
+    std::cout << p << " --cpu | --gpu | -h\n";
+}
+
+int main(int argc, char *argv[]) {
+    ISPCRTDeviceType device_type = ISPCRT_DEVICE_TYPE_AUTO;
+
+    if (argc > 2 || (argc == 2 && std::string(argv[1]) == "-h")) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (argc == 2) {
+        std::string dev_param = argv[1];
+        if (dev_param == "--cpu") {
+            device_type = ISPCRT_DEVICE_TYPE_CPU;
+        } else if (dev_param == "--gpu") {
+            device_type = ISPCRT_DEVICE_TYPE_GPU;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return run(device_type);
+}
@@ -24,6 +24,12 @@ struct CommandList : public RefCounted {
     virtual base::Future *copyToDevice(base::MemoryView &mv) = 0;
     virtual base::Future *copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) = 0;
     virtual base::Future *launch(Kernel &k, base::MemoryView *params, size_t dim0, size_t dim1, size_t dim2) = 0;
+    // Replace the parameters of the recorded launch identified by the future
+    // returned by launch(). It takes effect from the next submission.
+    virtual void updateLaunch(base::Future &launch, base::MemoryView *params) = 0;
+    // Shared memory hints, the range is checked by the caller.
+    virtual void prefetch(base::MemoryView &mv, size_t size) = 0;
+    virtual void memAdvise(base::MemoryView &mv, ISPCRTMemAdvice advice) = 0;
 
     virtual void close() = 0;
     virtual base::Fence *submit() = 0;
@@ -18,6 +18,24 @@ struct Context : public RefCounted {
     virtual ISPCRTDeviceType getDeviceType() const = 0;
 
     virtual void *contextNativeHandle() const = 0;
+
+    // Memory pool of the shared memory views with the allocation hint, see
+    // ispcrtContextGetMemPoolStats(). The context without pools has none.
+    virtual void memPoolStats(ISPCRTSharedMemoryAllocationHint, ISPCRTMemPoolStats *stats, ISPCRTMemPoolChunkStats *,
+                              uint32_t *numChunks) const {
+        if (stats)
+            *stats = {};
+        if (numChunks)
+            *numChunks = 0;
+    }
+    virtual size_t trimMemPool(ISPCRTSharedMemoryAllocationHint) const { return 0; }
+    virtual void setMemPoolLimit(ISPCRTSharedMemoryAllocationHint, size_t) const {}
+
+    // Executor of the tasks of the devices of the context, see
+    // ispcrtContextSetTaskingCallbacks().
+    virtual void setTaskingCallbacks(const ISPCRTTaskingCallbacks *) {
+        throw std::logic_error("tasking callbacks are supported only by CPU contexts");
+    }
 };
 
 } // namespace base
@@ -20,23 +20,32 @@ struct Device : public RefCounted {
 
     virtual ~Device() = default;
 
-    virtual MemoryView *newMemoryView(void *appMemory, size_t numBytes,
-                                      const ISPCRTNewMemoryViewFlags *flags) const = 0;
+    // placement is null for the default placement.
+    virtual MemoryView *newMemoryView(void *appMemory, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags,
+                                      const ISPCRTMemoryPlacement *placement) const = 0;
 
     virtual CommandQueue *newCommandQueue(uint32_t ordinal) const = 0;
 
-    virtual TaskQueue *newTaskQueue() const = 0;
+    // flags is a combination of ISPCRTTaskQueueFlags
+    virtual TaskQueue *newTaskQueue(uint32_t flags) const = 0;
 
     virtual ModuleOptions *newModuleOptions() const = 0;
     virtual ModuleOptions *newModuleOptions(ISPCRTModuleType moduleType, bool libraryCompilation,
                                             uint32_t stackSize) const = 0;
 
     virtual Module *newModule(const char *moduleFile, const ModuleOptions &opts) const = 0;
+    // Compile the ISPC source code with libispc and load it in memory.
+    virtual Module *newModuleFromSource(const char *source, const char *const *options,
+                                        uint32_t numOptions) const = 0;
+    // Load the module from the image of its file in memory.
+    virtual Module *newModuleFromMemory(const void *data, size_t size, const ModuleOptions &opts) const = 0;
 
     virtual void dynamicLinkModules(Module **modules, uint32_t numModules) const = 0;
     virtual Module *staticLinkModules(Module **modules, uint32_t numModules) const = 0;
 
-    virtual Kernel *newKernel(const Module &module, const char *name) const = 0;
+    // Create the kernel. On GPU, the width selects the variant of the kernel
+    // compiled with --xe-kernel-widths, 0 lets the runtime choose.
+    virtual Kernel *newKernel(const Module &module, const char *name, uint32_t width) const = 0;
 
     virtual void *platformNativeHandle() const = 0;
     virtual void *deviceNativeHandle() const = 0;
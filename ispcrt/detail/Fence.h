@@ -16,6 +16,8 @@ struct Fence : public RefCounted {
     virtual ~Fence() = default;
 
     virtual void sync() = 0;
+    // Return false if the fence isn't signaled after timeoutNs nanoseconds.
+    virtual bool wait(uint64_t timeoutNs) = 0;
     virtual ISPCRTFenceStatus status() const = 0;
     virtual void reset() = 0;
 
@@ -23,6 +23,8 @@ class RefCounted {
 
     void refInc() const;
     void refDec() const;
+    // Take a reference unless the object is already being destroyed.
+    bool tryRefInc() const;
     long long useCount() const;
 
   private:
@@ -38,6 +40,15 @@ inline void RefCounted::refDec() const {
         delete this;
 }
 
+inline bool RefCounted::tryRefInc() const {
+    long long count = refCounter.load();
+    while (count > 0) {
+        if (refCounter.compare_exchange_weak(count, count + 1))
+            return true;
+    }
+    return false;
+}
+
 inline long long RefCounted::useCount() const { return refCounter.load(); }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -11,6 +11,15 @@ namespace base {
 struct Kernel : public RefCounted {
     Kernel() = default;
     virtual ~Kernel() = default;
+
+    // Use the given group size for the following launches instead of the one
+    // suggested by the device. Zero in any dimension restores the default.
+    // Devices without the notion of groups ignore it.
+    virtual void setGroupSize(uint32_t /*x*/, uint32_t /*y*/, uint32_t /*z*/) {}
+
+    // The vector width of the variant of the kernel selected on creation, 0
+    // if the kernel has a single variant.
+    virtual uint32_t width() const { return 0; }
 };
 
 } // namespace base
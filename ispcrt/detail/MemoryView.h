@@ -18,6 +18,10 @@ struct MemoryView : public RefCounted {
     virtual void *hostPtr() = 0;
     virtual void *devicePtr() = 0;
     virtual size_t numBytes() = 0;
+
+    // Returns a new view of numBytes bytes at offset of this one, which
+    // shares its host and device memory and keeps it alive.
+    virtual MemoryView *slice(size_t offset, size_t numBytes) = 0;
 };
 
 } // namespace base
@@ -3,7 +3,14 @@
 
 #pragma once
 
+#include "../ispcrt.h"
 #include "IntrusivePtr.h"
+#include "Kernel.h"
+// std
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
 
 namespace ispcrt {
 namespace base {
@@ -13,6 +20,39 @@ struct Module : public RefCounted {
     virtual ~Module() = default;
 
     virtual void *functionPtr(const char *name) const = 0;
+
+    // Fill the resources used by the kernel and return true, or return false
+    // if they are not known.
+    virtual bool kernelResources(const char * /*name*/, ISPCRTKernelResources & /*resources*/) const { return false; }
+
+    // Return a new reference to the live kernel with the name and the width
+    // or the one made by create(), which is kept for the following calls.
+    // The kernels hold the module, so the cache doesn't hold them, and they
+    // leave it with forgetKernel() when destroyed.
+    template <typename F> Kernel *kernel(const char *name, uint32_t width, F create) const {
+        std::lock_guard<std::mutex> lock(m_kernelsMutex);
+        auto key = std::make_pair(std::string(name), width);
+        auto it = m_kernels.find(key);
+        if (it != m_kernels.end() && it->second->tryRefInc())
+            return it->second;
+        Kernel *kernel = create();
+        m_kernels[key] = kernel;
+        return kernel;
+    }
+
+    void forgetKernel(const Kernel *kernel) const {
+        std::lock_guard<std::mutex> lock(m_kernelsMutex);
+        for (auto it = m_kernels.begin(); it != m_kernels.end();) {
+            if (it->second == kernel)
+                it = m_kernels.erase(it);
+            else
+                ++it;
+        }
+    }
+
+  private:
+    mutable std::mutex m_kernelsMutex;
+    mutable std::map<std::pair<std::string, uint32_t>, Kernel *> m_kernels;
 };
 
 } // namespace base
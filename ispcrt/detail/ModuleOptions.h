@@ -8,6 +8,10 @@
 // internal
 #include "IntrusivePtr.h"
 
+#include <cstdint>
+#include <map>
+#include <vector>
+
 namespace ispcrt {
 namespace base {
 
@@ -17,9 +21,14 @@ struct ModuleOptions : public RefCounted {
     virtual uint32_t stackSize() const = 0;
     virtual bool libraryCompilation() const = 0;
     virtual ISPCRTModuleType moduleType() const = 0;
+    virtual bool eagerKernels() const = 0;
+    // The values of the specialization constants by ID.
+    virtual const std::map<uint32_t, std::vector<uint8_t>> &specConstants() const = 0;
     virtual void setStackSize(uint32_t) = 0;
     virtual void setLibraryCompilation(bool) = 0;
     virtual void setModuleType(ISPCRTModuleType) = 0;
+    virtual void setEagerKernels(bool) = 0;
+    virtual void setSpecConstant(uint32_t id, const void *value, size_t size) = 0;
 };
 
 } // namespace base
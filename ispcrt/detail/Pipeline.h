@@ -0,0 +1,295 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include "Device.h"
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ispcrt {
+namespace base {
+
+// A chain of stages, which every submitted item passes in order, see
+// ispcrtNewPipeline(). The items in flight occupy the slots of the pipeline,
+// each of which has the buffers of its own, a task queue and a thread driving
+// the item through the stages. So the copies and the kernels of the items in
+// different slots overlap, and the depth of the pipeline bounds the number
+// of the items in flight. The host stages are called for one item at a time,
+// in the order the items were submitted.
+struct Pipeline : public RefCounted {
+    Pipeline(Device &device, uint32_t depth) : m_device(device), m_slots(depth) {
+        if (depth == 0)
+            throw std::invalid_argument("the depth of a pipeline must be at least 1");
+        m_device.refInc();
+    }
+
+    ~Pipeline() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cvDone.wait(lock, [this] { return m_inFlight == 0; });
+            m_stop = true;
+        }
+        m_cvWork.notify_all();
+        for (auto &slot : m_slots) {
+            if (slot.thread.joinable())
+                slot.thread.join();
+            if (slot.queue)
+                slot.queue->refDec();
+        }
+        for (auto &stage : m_stages) {
+            if (stage.kernel)
+                stage.kernel->refDec();
+            for (auto *p : stage.params) {
+                if (p)
+                    p->refDec();
+            }
+        }
+        for (auto &buffer : m_buffers) {
+            for (auto *mv : buffer)
+                mv->refDec();
+        }
+        m_device.refDec();
+    }
+
+    uint32_t depth() const { return (uint32_t)m_slots.size(); }
+
+    // The device buffers get the host memory owned by the pipeline for the
+    // host stages and the copies.
+    uint32_t addBuffer(size_t size, const ISPCRTNewMemoryViewFlags *flags) {
+        checkNotStarted();
+        std::vector<MemoryView *> buffer;
+        try {
+            for (uint32_t s = 0; s < depth(); s++) {
+                void *appMemory = nullptr;
+                if (flags->allocType == ISPCRT_ALLOC_TYPE_DEVICE) {
+                    const size_t n = (size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+                    m_hostMemory.emplace_back(new std::max_align_t[n > 0 ? n : 1]);
+                    appMemory = m_hostMemory.back().get();
+                }
+                buffer.push_back(m_device.newMemoryView(appMemory, size, flags, nullptr));
+            }
+        } catch (...) {
+            for (auto *mv : buffer)
+                mv->refDec();
+            throw;
+        }
+        m_buffers.push_back(std::move(buffer));
+        return (uint32_t)m_buffers.size() - 1;
+    }
+
+    MemoryView &buffer(uint32_t buffer, uint32_t slot) const {
+        if (buffer >= m_buffers.size() || slot >= depth())
+            throw std::out_of_range("no such buffer or slot of the pipeline");
+        return *m_buffers[buffer][slot];
+    }
+
+    // params has an entry for every slot or is null.
+    void addKernelStage(Kernel &kernel, MemoryView *const *params, size_t dim0, size_t dim1, size_t dim2) {
+        checkNotStarted();
+        Stage stage;
+        stage.type = Stage::Type::Kernel;
+        stage.kernel = &kernel;
+        stage.params.assign(depth(), nullptr);
+        if (params)
+            stage.params.assign(params, params + depth());
+        stage.dims[0] = dim0;
+        stage.dims[1] = dim1;
+        stage.dims[2] = dim2;
+        kernel.refInc();
+        for (auto *p : stage.params) {
+            if (p)
+                p->refInc();
+        }
+        m_stages.push_back(std::move(stage));
+    }
+
+    void addCopyStage(uint32_t buffer, bool toDevice) {
+        checkNotStarted();
+        if (buffer >= m_buffers.size())
+            throw std::out_of_range("no such buffer of the pipeline");
+        Stage stage;
+        stage.type = toDevice ? Stage::Type::CopyToDevice : Stage::Type::CopyToHost;
+        stage.buffer = buffer;
+        m_stages.push_back(std::move(stage));
+    }
+
+    void addHostStage(ISPCRTPipelineStageFType fcn, void *userData) {
+        checkNotStarted();
+        if (fcn == nullptr)
+            throw std::invalid_argument("the function of a host stage cannot be null");
+        Stage stage;
+        stage.type = Stage::Type::Host;
+        stage.fcn = fcn;
+        stage.userData = userData;
+        m_stages.push_back(std::move(stage));
+    }
+
+    // Waits for a free slot, returns the index of the item.
+    uint64_t submit() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        rethrowError();
+        if (!m_started)
+            start();
+        m_cvDone.wait(lock, [this] { return m_inFlight < depth(); });
+        Slot *slot = nullptr;
+        for (auto &s : m_slots) {
+            if (!s.busy) {
+                slot = &s;
+                break;
+            }
+        }
+        slot->busy = true;
+        slot->item = m_nextItem++;
+        m_inFlight++;
+        m_cvWork.notify_all();
+        return slot->item;
+    }
+
+    // Waits until all the submitted items have left the pipeline.
+    void sync() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvDone.wait(lock, [this] { return m_inFlight == 0; });
+        rethrowError();
+    }
+
+  private:
+    struct Stage {
+        enum class Type { Kernel, CopyToDevice, CopyToHost, Host };
+        Type type;
+        Kernel *kernel{nullptr};
+        std::vector<MemoryView *> params;
+        size_t dims[3]{1, 1, 1};
+        uint32_t buffer{0};
+        ISPCRTPipelineStageFType fcn{nullptr};
+        void *userData{nullptr};
+        // The next item to pass the host stage, guarded by m_mutex.
+        uint64_t nextItem{0};
+    };
+
+    struct Slot {
+        TaskQueue *queue{nullptr};
+        std::thread thread;
+        bool busy{false};
+        uint64_t item{0};
+    };
+
+    Device &m_device;
+    std::vector<Stage> m_stages;
+    std::vector<std::vector<MemoryView *>> m_buffers;
+    std::vector<std::unique_ptr<std::max_align_t[]>> m_hostMemory;
+    std::vector<Slot> m_slots;
+
+    std::mutex m_mutex;
+    // Signaled when an item is submitted or the pipeline is destroyed.
+    std::condition_variable m_cvWork;
+    // Signaled when an item leaves the pipeline or passes a host stage.
+    std::condition_variable m_cvDone;
+    bool m_started{false};
+    bool m_stop{false};
+    uint32_t m_inFlight{0};
+    uint64_t m_nextItem{0};
+    // The first error of the stages, reported by the next submit() or sync().
+    std::exception_ptr m_error;
+
+    void checkNotStarted() const {
+        if (m_started)
+            throw std::logic_error("the stages and the buffers can't be added once the pipeline runs");
+    }
+
+    void rethrowError() {
+        if (m_error) {
+            std::exception_ptr e = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    // Called with m_mutex locked.
+    void start() {
+        try {
+            for (auto &slot : m_slots)
+                slot.queue = m_device.newTaskQueue(ISPCRT_TASK_QUEUE_DEFAULT);
+        } catch (...) {
+            for (auto &slot : m_slots) {
+                if (slot.queue)
+                    slot.queue->refDec();
+                slot.queue = nullptr;
+            }
+            throw;
+        }
+        for (uint32_t s = 0; s < depth(); s++)
+            m_slots[s].thread = std::thread(&Pipeline::run, this, s);
+        m_started = true;
+    }
+
+    void run(uint32_t s) {
+        Slot &slot = m_slots[s];
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_cvWork.wait(lock, [&] { return m_stop || slot.busy; });
+            if (!slot.busy)
+                return;
+            const uint64_t item = slot.item;
+            lock.unlock();
+            bool failed = false;
+            for (auto &stage : m_stages) {
+                if (stage.type == Stage::Type::Host) {
+                    // The host stage sees the results of the previous ones.
+                    if (!runDeviceStage(slot, nullptr))
+                        failed = true;
+                    lock.lock();
+                    m_cvDone.wait(lock, [&] { return stage.nextItem == item; });
+                    lock.unlock();
+                    if (!failed)
+                        stage.fcn(item, s, stage.userData);
+                    lock.lock();
+                    stage.nextItem++;
+                    lock.unlock();
+                    m_cvDone.notify_all();
+                } else if (!failed) {
+                    failed = !runDeviceStage(slot, &stage);
+                }
+            }
+            runDeviceStage(slot, nullptr);
+            lock.lock();
+            slot.busy = false;
+            m_inFlight--;
+            m_cvDone.notify_all();
+        }
+    }
+
+    // Enqueues the stage or syncs the queue of the slot if stage is null.
+    // Returns false and keeps the first error if it fails.
+    bool runDeviceStage(Slot &slot, Stage *stage) {
+        try {
+            const uint32_t s = (uint32_t)(&slot - m_slots.data());
+            if (stage == nullptr) {
+                slot.queue->sync();
+            } else if (stage->type == Stage::Type::Kernel) {
+                slot.queue->launch(*stage->kernel, stage->params[s], stage->dims[0], stage->dims[1], stage->dims[2]);
+            } else if (stage->type == Stage::Type::CopyToDevice) {
+                slot.queue->copyToDevice(*m_buffers[stage->buffer][s]);
+            } else {
+                slot.queue->copyToHost(*m_buffers[stage->buffer][s]);
+            }
+            return true;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+                m_error = std::current_exception();
+            return false;
+        }
+    }
+};
+
+} // namespace base
+} // namespace ispcrt
@@ -8,9 +8,22 @@
 #include "Kernel.h"
 #include "MemoryView.h"
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 namespace ispcrt {
 namespace base {
 
+// Arguments of a kernel passed by value, see ispcrtLaunchWithArgs3D(). The
+// launch copies them, the caller reuses the block for the next launch.
+struct KernelArgs {
+    // The values of the arguments laid out like the fields of a C structure.
+    std::vector<uint8_t> data;
+    // The offset in data and the size of each argument.
+    std::vector<std::pair<size_t, size_t>> args;
+};
+
 struct TaskQueue : public RefCounted {
     TaskQueue() = default;
     virtual ~TaskQueue() = default;
@@ -19,12 +32,19 @@ struct TaskQueue : public RefCounted {
 
     virtual void copyToHost(base::MemoryView &mv) = 0;
     virtual void copyToDevice(base::MemoryView &mv) = 0;
+    // Copy size bytes at offset of the view, the range is checked by the caller
+    virtual void copyToHost(base::MemoryView &mv, size_t offset, size_t size) = 0;
+    virtual void copyToDevice(base::MemoryView &mv, size_t offset, size_t size) = 0;
     virtual void copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) = 0;
 
     virtual base::Future *launch(Kernel &k, base::MemoryView *params, size_t dim0, size_t dim1, size_t dim2) = 0;
+    virtual base::Future *launch(Kernel &k, const KernelArgs &args, size_t dim0, size_t dim1, size_t dim2) = 0;
 
     virtual void sync() = 0;
 
+    // Priority of the following launches, see ispcrtSetLaunchPriority().
+    virtual void setLaunchPriority(ISPCRTTaskPriority) {}
+
     virtual void *taskQueueNativeHandle() const = 0;
 };
 
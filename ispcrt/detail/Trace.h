@@ -0,0 +1,289 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include "Future.h"
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ispcrt {
+namespace base {
+namespace trace {
+
+// A traced runtime call. The name is a string literal, the detail is a copy
+// of the call specific string (a module file or a kernel name).
+struct Record {
+    const char *name{nullptr};
+    uint64_t begin{0};
+    uint64_t end{0};
+    // The queue or the command list the call enqueues the command to
+    const void *queue{nullptr};
+    // The kernel of the launch
+    const void *kernel{nullptr};
+    // The future of the launch to the task queue, which is referenced
+    Future *future{nullptr};
+    // Bytes of the copy or dimensions of the launch
+    uint64_t args[3]{0, 0, 0};
+    char detail[64]{0};
+};
+
+// The ring of the recent records of a thread. Only the owning thread
+// writes to it, so the recording doesn't take any locks.
+struct ThreadBuffer {
+    ThreadBuffer(size_t capacity, uint32_t tid) : records(capacity), tid(tid) {}
+
+    ~ThreadBuffer() {
+        for (auto &r : records) {
+            if (r.future)
+                r.future->refDec();
+        }
+    }
+
+    void push(const Record &r) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        Record &slot = records[h % records.size()];
+        if (slot.future)
+            slot.future->refDec();
+        slot = r;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    std::vector<Record> records;
+    // The number of records pushed since the buffer is created
+    std::atomic<uint64_t> head{0};
+    uint32_t tid{0};
+};
+
+class Tracer {
+  public:
+    // The tracer is never destroyed, as the recorded futures may belong to
+    // device libraries, which are unloaded at exit.
+    static Tracer &get() {
+        static Tracer *tracer = new Tracer;
+        return *tracer;
+    }
+
+    bool enabled() const { return m_capacity.load(std::memory_order_relaxed) != 0; }
+
+    // Not thread safe with respect to the traced calls.
+    void enable(size_t capacity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.clear();
+        m_kernelNames.clear();
+        m_generation++;
+        m_start = std::chrono::steady_clock::now();
+        m_capacity.store(capacity, std::memory_order_relaxed);
+    }
+
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start)
+            .count();
+    }
+
+    void record(const Record &r) {
+        thread_local ThreadBuffer *t_buffer = nullptr;
+        thread_local uint64_t t_generation = 0;
+        if (t_buffer == nullptr || t_generation != m_generation) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const size_t capacity = m_capacity.load(std::memory_order_relaxed);
+            if (capacity == 0) {
+                if (r.future)
+                    r.future->refDec();
+                return;
+            }
+            m_buffers.emplace_back(new ThreadBuffer(capacity, uint32_t(m_buffers.size())));
+            t_buffer = m_buffers.back().get();
+            t_generation = m_generation;
+        }
+        t_buffer->push(r);
+    }
+
+    void kernelName(const void *kernel, const char *name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_kernelNames[kernel] = name;
+    }
+
+    // Write the records in the Chrome trace event format. Not thread safe
+    // with respect to the traced calls.
+    bool write(const char *fileName) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FILE *f = fopen(fileName, "w");
+        if (f == nullptr)
+            return false;
+
+        struct Event {
+            const Record *r;
+            uint32_t tid;
+        };
+        std::vector<Event> events;
+        for (const auto &b : m_buffers) {
+            const uint64_t head = b->head.load(std::memory_order_acquire);
+            const uint64_t size = b->records.size();
+            for (uint64_t i = head > size ? head - size : 0; i < head; i++)
+                events.push_back({&b->records[i % size], b->tid});
+        }
+        std::sort(events.begin(), events.end(),
+                  [](const Event &a, const Event &b) { return a.r->begin < b.r->begin; });
+
+        fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ispcrt host\"}},\n");
+        fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"ispcrt device\"}}");
+        for (const auto &e : events) {
+            const Record &r = *e.r;
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"ispcrt\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                       "\"dur\":%.3f",
+                    r.name, e.tid, r.begin / 1000.0, (r.end - r.begin) / 1000.0);
+            writeArgs(f, r);
+            fprintf(f, "}");
+        }
+        writeDeviceEvents(f, events);
+        fprintf(f, "\n]}\n");
+        const bool ok = !ferror(f);
+        return fclose(f) == 0 && ok;
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::atomic<size_t> m_capacity{0};
+    std::atomic<uint64_t> m_generation{0};
+    std::chrono::steady_clock::time_point m_start{std::chrono::steady_clock::now()};
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    std::unordered_map<const void *, std::string> m_kernelNames;
+
+    static void writeString(FILE *f, const char *s) {
+        fputc('"', f);
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\')
+                fprintf(f, "\\%c", *s);
+            else if ((unsigned char)*s < 0x20)
+                fprintf(f, "\\u%04x", *s);
+            else
+                fputc(*s, f);
+        }
+        fputc('"', f);
+    }
+
+    void writeArgs(FILE *f, const Record &r) {
+        fprintf(f, ",\"args\":{\"queue\":\"%p\"", r.queue);
+        if (r.kernel) {
+            auto it = m_kernelNames.find(r.kernel);
+            fprintf(f, ",\"kernel\":");
+            writeString(f, it != m_kernelNames.end() ? it->second.c_str() : "");
+            fprintf(f, ",\"dims\":[%llu,%llu,%llu]", (unsigned long long)r.args[0], (unsigned long long)r.args[1],
+                    (unsigned long long)r.args[2]);
+        } else if (r.args[0]) {
+            fprintf(f, ",\"bytes\":%llu", (unsigned long long)r.args[0]);
+        }
+        if (r.detail[0]) {
+            fprintf(f, ",\"detail\":");
+            writeString(f, r.detail);
+        }
+        fprintf(f, "}");
+    }
+
+    // The device timestamps are not correlated with the host clock, so the
+    // measured kernels of every task queue are laid out back to back, ending
+    // with the end of the sync, which waited for them.
+    template <typename E> void writeDeviceEvents(FILE *f, const std::vector<E> &events) {
+        std::unordered_map<const void *, uint32_t> queueIds;
+        std::unordered_map<const void *, std::vector<const Record *>> pending;
+        for (const auto &e : events) {
+            const Record &r = *e.r;
+            if (r.future) {
+                pending[r.queue].push_back(&r);
+                continue;
+            }
+            if (std::strcmp(r.name, "sync") != 0)
+                continue;
+            auto it = pending.find(r.queue);
+            if (it == pending.end() || it->second.empty())
+                continue;
+            if (queueIds.find(r.queue) == queueIds.end())
+                fprintf(f,
+                        ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":%u,"
+                        "\"args\":{\"name\":\"queue %p\"}}",
+                        uint32_t(queueIds.size()), r.queue);
+            const uint32_t tid = queueIds.emplace(r.queue, uint32_t(queueIds.size())).first->second;
+            uint64_t end = r.end;
+            for (auto l = it->second.rbegin(); l != it->second.rend(); ++l) {
+                const Record &launch = **l;
+                if (!launch.future->valid())
+                    continue;
+                const uint64_t time = std::min<uint64_t>(launch.future->time(), end);
+                auto name = m_kernelNames.find(launch.kernel);
+                fprintf(f, ",\n{\"name\":");
+                writeString(f, name != m_kernelNames.end() ? name->second.c_str() : "kernel");
+                fprintf(f,
+                        ",\"cat\":\"ispcrt\",\"ph\":\"X\",\"pid\":2,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"args\":{\"approximate_start\":true}}",
+                        tid, (end - time) / 1000.0, time / 1000.0);
+                end -= time;
+            }
+            it->second.clear();
+        }
+    }
+};
+
+// Records the traced call from its construction till its destruction if the
+// tracing is enabled.
+class Scope {
+  public:
+    Scope(const char *name, const void *queue = nullptr) : m_enabled(Tracer::get().enabled()) {
+        if (m_enabled) {
+            m_record.name = name;
+            m_record.queue = queue;
+            m_record.begin = Tracer::get().now();
+        }
+    }
+
+    ~Scope() {
+        if (m_enabled) {
+            m_record.end = Tracer::get().now();
+            Tracer::get().record(m_record);
+        }
+    }
+
+    bool enabled() const { return m_enabled; }
+
+    void bytes(uint64_t size) { m_record.args[0] = size; }
+
+    void launch(const void *kernel, size_t dim0, size_t dim1, size_t dim2) {
+        m_record.kernel = kernel;
+        m_record.args[0] = dim0;
+        m_record.args[1] = dim1;
+        m_record.args[2] = dim2;
+    }
+
+    // The future is referenced until its record is overwritten
+    void future(Future *f) {
+        if (m_enabled && f) {
+            f->refInc();
+            m_record.future = f;
+        }
+    }
+
+    void detail(const char *s) {
+        if (m_enabled && s) {
+            std::strncpy(m_record.detail, s, sizeof(m_record.detail) - 1);
+        }
+    }
+
+  private:
+    bool m_enabled;
+    Record m_record;
+};
+
+} // namespace trace
+} // namespace base
+} // namespace ispcrt
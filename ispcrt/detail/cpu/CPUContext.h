@@ -5,6 +5,8 @@
 
 #include "../Context.h"
 
+#include <memory>
+
 namespace ispcrt {
 
 struct CPUContext : public base::Context {
@@ -14,6 +16,14 @@ struct CPUContext : public base::Context {
     ISPCRTDeviceType getDeviceType() const override;
 
     virtual void *contextNativeHandle() const override;
+
+    void setTaskingCallbacks(const ISPCRTTaskingCallbacks *callbacks) override;
+
+    // Null if the devices use the built-in tasking runtime.
+    std::shared_ptr<const ISPCRTTaskingCallbacks> executor() const { return m_executor; }
+
+  private:
+    std::shared_ptr<const ISPCRTTaskingCallbacks> m_executor;
 };
 
 } // namespace ispcrt
@@ -21,4 +31,5 @@ struct CPUContext : public base::Context {
 // Expose API of CPU device solib for dlsym.
 extern "C" {
 ispcrt::base::Context *load_cpu_context();
+ispcrt::base::Device *load_cpu_device_from_context(ispcrt::base::Context *context);
 }
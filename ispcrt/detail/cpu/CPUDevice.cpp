@@ -3,26 +3,65 @@
 
 #include "CPUDevice.h"
 #include "CPUContext.h"
+#include "../Exception.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "windows.h"
 #else
 #include <dlfcn.h>
 #endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
 ispcrt::base::Device *load_cpu_device() { return new ispcrt::CPUDevice; }
+ispcrt::base::Device *load_cpu_sub_device(const ISPCRTCpuDeviceOptions *options) {
+    return new ispcrt::CPUDevice(*options);
+}
 uint32_t cpu_device_count() { return ispcrt::cpu::deviceCount(); }
 ISPCRTDeviceInfo cpu_device_info(uint32_t idx) { return ispcrt::cpu::deviceInfo(idx); }
+void cpu_set_device_options(const ISPCRTCpuDeviceOptions *options) { ispcrt::cpu::setDeviceOptions(*options); }
+void cpu_topology(ISPCRTCpuTopology *topology) { *topology = ispcrt::cpu::topology(); }
+ISPCRTTaskPriority cpu_current_task_priority() { return ispcrt::cpu::currentTaskPriority(); }
 ispcrt::base::Context *load_cpu_context() { return new ispcrt::CPUContext; }
+ispcrt::base::Device *load_cpu_device_from_context(ispcrt::base::Context *context) {
+    return new ispcrt::CPUDevice(*(ispcrt::CPUContext *)context);
+}
+#ifdef ISPCRT_BUILD_TASKING
+// Implemented in ispc_tasking.cpp.
+void ISPCSetAffinity_cpu(int policy, const uint32_t *cores, uint32_t numCores);
+void ISPCLaunch_cpu(void **handlePtr, void *f, void *data, int countx, int county, int countz);
+void ISPCSync_cpu(void *handle);
+void *ISPCNewWorkerPool_cpu(int policy, const uint32_t *cores, uint32_t numCores);
+void ISPCDeleteWorkerPool_cpu(void *pool);
+void *ISPCSetWorkerPool_cpu(void *pool);
+void ISPCPinToWorkerPool_cpu(void *pool);
+const ISPCRTTaskingCallbacks *ISPCSetExecutor_cpu(const ISPCRTTaskingCallbacks *executor);
+int ISPCSetPriority_cpu(int priority);
+int ISPCGetPriority_cpu();
+#endif
 }
 
 namespace ispcrt {
@@ -32,15 +71,24 @@ struct Future : public ispcrt::base::Future {
     Future() = default;
     virtual ~Future() = default;
 
-    bool valid() override { return m_valid; }
-    uint64_t time() override { return m_time; }
+    bool valid() override { return m_valid.load(std::memory_order_acquire); }
+    uint64_t time() override { return m_time.load(std::memory_order_relaxed); }
 
     friend struct TaskQueue;
     friend struct CommandListImpl;
 
   private:
-    uint64_t m_time{0};
-    bool m_valid{false};
+    // The future may be completed by the worker thread of the TaskQueue
+    // while the application polls it.
+    void complete(uint64_t time) {
+        m_time.store(time, std::memory_order_relaxed);
+        m_valid.store(true, std::memory_order_release);
+    }
+
+    std::atomic<uint64_t> m_time{0};
+    std::atomic<bool> m_valid{false};
+    // The next future in the list of the futures of the TaskQueue.
+    Future *m_nextInQueue{nullptr};
 };
 
 struct Fence : public ispcrt::base::Fence {
@@ -51,6 +99,8 @@ struct Fence : public ispcrt::base::Fence {
         // no-op
     }
 
+    bool wait(uint64_t) override { return true; }
+
     ISPCRTFenceStatus status() const override { return ISPCRT_FENCE_SIGNALED; }
 
     void reset() override {
@@ -62,18 +112,277 @@ struct Fence : public ispcrt::base::Fence {
 
 using CPUKernelEntryPoint = void (*)(void *, size_t, size_t, size_t);
 
+// NUMA node for the memory of MemoryViews: -2 if not initialized yet, -1 to
+// use the default policy of the OS.
+static std::atomic<int32_t> g_memoryNode{-2};
+
+static int32_t memoryNode() {
+    int32_t node = g_memoryNode.load();
+    if (node == -2) {
+        const char *env = getenv("ISPCRT_CPU_MEMORY_NODE");
+        int32_t envNode = (env != nullptr && *env != '\0') ? atoi(env) : -1;
+        // Don't overwrite the value set by setDeviceOptions() in the meantime.
+        g_memoryNode.compare_exchange_strong(node, envNode < 0 ? -1 : envNode);
+        node = g_memoryNode.load();
+    }
+    return node;
+}
+
+// Alignment of the memory of MemoryViews, which is the cache line size.
+static const size_t memoryAlignment = 64;
+
+static void *allocateAligned(size_t size, size_t alignment) {
+#if defined(_WIN32) || defined(_WIN64)
+    return _aligned_malloc(size, alignment);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return nullptr;
+    return ptr;
+#endif
+}
+
+static void freeAligned(void *ptr) {
+#if defined(_WIN32) || defined(_WIN64)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// Allocate the memory, which prefers the given NUMA node for its pages. The
+// memory is freed with freeAligned().
+static void *allocateOnNode(size_t size, [[maybe_unused]] int32_t node, size_t alignment = memoryAlignment) {
+#ifdef __linux__
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t maxNodes = 1024;
+    if (size > 0 && node >= 0 && size_t(node) < maxNodes) {
+        void *ptr = allocateAligned(size, std::max(alignment, pageSize));
+        if (ptr == nullptr)
+            return nullptr;
+        // mbind() is called directly to avoid the dependency on libnuma.
+        // MPOL_PREFERRED falls back to other nodes if the node is full, and
+        // MPOL_MF_MOVE moves the pages, which the allocator has touched.
+        const int MPOL_PREFERRED_ = 1;
+        const unsigned MPOL_MF_MOVE_ = 1 << 1;
+        const size_t bitsPerWord = 8 * sizeof(unsigned long);
+        unsigned long nodeMask[maxNodes / bitsPerWord] = {};
+        nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+        size_t length = (size + pageSize - 1) / pageSize * pageSize;
+        // The failure is not fatal, the memory is just placed by the OS.
+        syscall(SYS_mbind, ptr, length, MPOL_PREFERRED_, nodeMask, maxNodes, MPOL_MF_MOVE_);
+        return ptr;
+    }
+#endif
+    return allocateAligned(size, alignment);
+}
+
+// Allocate the memory with the placement flags of ISPCRTMemoryPlacementFlags
+// directly from the OS.  The length of the mapping, which munmap() needs to
+// free the memory, is returned in mappedSize.  It is 0 if the placement isn't
+// supported and the memory is allocated as usual, to be freed with
+// freeAligned().
+static void *allocatePlaced(size_t size, uint32_t placement, [[maybe_unused]] uint32_t numaNode, int32_t defaultNode,
+                            size_t &mappedSize) {
+    mappedSize = 0;
+#ifdef __linux__
+    if (size > 0) {
+        const size_t pageSize = sysconf(_SC_PAGESIZE);
+        void *ptr = MAP_FAILED;
+        if (placement & (ISPCRT_MEM_HUGE_PAGES_2MB | ISPCRT_MEM_HUGE_PAGES_1GB)) {
+            // The log2 of the huge page size is passed above MAP_HUGE_SHIFT.
+            const int hugeShift = (placement & ISPCRT_MEM_HUGE_PAGES_1GB) ? 30 : 21;
+            const int MAP_HUGE_SHIFT_ = 26;
+            const size_t hugePageSize = size_t(1) << hugeShift;
+            mappedSize = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+            ptr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (hugeShift << MAP_HUGE_SHIFT_), -1, 0);
+            // Fall back to the transparent huge pages if the reserved ones
+            // are exhausted.
+            if (ptr == MAP_FAILED)
+                placement |= ISPCRT_MEM_HUGE_PAGES;
+        }
+        if (ptr == MAP_FAILED) {
+            mappedSize = (size + pageSize - 1) / pageSize * pageSize;
+            ptr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                mappedSize = 0;
+                return nullptr;
+            }
+            if (placement & ISPCRT_MEM_HUGE_PAGES)
+                madvise(ptr, mappedSize, MADV_HUGEPAGE);
+        }
+
+        // The policy must be set before the pages are faulted in, so
+        // MAP_POPULATE is not used and the pages are touched instead.
+        const int MPOL_PREFERRED_ = 1, MPOL_BIND_ = 2, MPOL_INTERLEAVE_ = 3;
+        const size_t maxNodes = 1024;
+        const size_t bitsPerWord = 8 * sizeof(unsigned long);
+        unsigned long nodeMask[maxNodes / bitsPerWord] = {};
+        if (placement & ISPCRT_MEM_NUMA_INTERLEAVE) {
+            // The kernel limits the mask to the nodes with memory.
+            std::fill(std::begin(nodeMask), std::end(nodeMask), ~0UL);
+            syscall(SYS_mbind, ptr, mappedSize, MPOL_INTERLEAVE_, nodeMask, maxNodes, 0);
+        } else if (placement & ISPCRT_MEM_NUMA_BIND) {
+            if (numaNode < maxNodes)
+                nodeMask[numaNode / bitsPerWord] = 1UL << (numaNode % bitsPerWord);
+            if (numaNode >= maxNodes || syscall(SYS_mbind, ptr, mappedSize, MPOL_BIND_, nodeMask, maxNodes, 0) != 0) {
+                munmap(ptr, mappedSize);
+                mappedSize = 0;
+                throw std::logic_error("could not bind the memory to NUMA node " + std::to_string(numaNode));
+            }
+        } else if (defaultNode >= 0 && size_t(defaultNode) < maxNodes) {
+            const int32_t node = defaultNode;
+            nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+            syscall(SYS_mbind, ptr, mappedSize, MPOL_PREFERRED_, nodeMask, maxNodes, 0);
+        }
+        if (placement & ISPCRT_MEM_PREFAULT) {
+            for (size_t offset = 0; offset < mappedSize; offset += pageSize)
+                static_cast<volatile char *>(ptr)[offset] = 0;
+        }
+        return ptr;
+    }
+#endif
+    return allocateOnNode(size, defaultNode);
+}
+
+// Parse the value of the environment variable in [minValue, maxValue].
+static size_t numberEnv(const char *name, size_t defaultValue, size_t minValue, size_t maxValue) {
+    const char *env = getenv(name);
+    if (env == nullptr)
+        return defaultValue;
+    char *end = nullptr;
+    unsigned long long value = strtoull(env, &end, 10);
+    if (*env == '\0' || *end != '\0' || value < minValue || value > maxValue)
+        throw std::runtime_error(std::string(name) + " is beyond reasonable limits");
+    return size_t(value);
+}
+
+// ChunkedPool keeps the chunks of power of 2 sizes for the shared memory
+// views, which are created with ISPCRT_SM_HOST_WRITE_DEVICE_READ or
+// ISPCRT_SM_HOST_READ_DEVICE_WRITE hint when ISPCRT_MEM_POOL=1, like the GPU
+// memory pool does.  The chunks are carved out of 2 MB bulks, which are
+// aligned to their size so they can be backed by huge pages.  The freed
+// chunks are kept in the free list of their size and are never returned to
+// the OS.
+class ChunkedPool {
+  public:
+    static ChunkedPool *get() {
+        // The pool is never destroyed, so the memory views, which are
+        // released at the exit, still can return their chunks.
+        static ChunkedPool *pool = new ChunkedPool;
+        return pool;
+    }
+
+    static bool enabled(const ISPCRTNewMemoryViewFlags *flags) {
+        static const bool envEnabled = numberEnv("ISPCRT_MEM_POOL", 0, 0, 1) != 0;
+        return envEnabled && flags->allocType == ISPCRT_ALLOC_TYPE_SHARED &&
+               (flags->smHint == ISPCRT_SM_HOST_WRITE_DEVICE_READ || flags->smHint == ISPCRT_SM_HOST_READ_DEVICE_WRITE);
+    }
+
+    // Size of the chunk to keep size bytes or 0 if it is too large for the pool.
+    size_t chunkSize(size_t size) const {
+        if (size > m_maxChunkSize)
+            return 0;
+        size_t chunkSize = m_minChunkSize;
+        while (chunkSize < size)
+            chunkSize *= 2;
+        return chunkSize;
+    }
+
+    void *allocate(size_t chunkSize) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto &freeChunks = m_freeChunks[sizeClass(chunkSize)];
+        if (freeChunks.empty()) {
+            char *bulk = (char *)allocateOnNode(m_bulkSize, memoryNode(), m_bulkSize);
+            if (bulk == nullptr)
+                return nullptr;
+#ifdef __linux__
+            madvise(bulk, m_bulkSize, MADV_HUGEPAGE);
+#endif
+            for (size_t offset = m_bulkSize; offset > 0; offset -= chunkSize)
+                freeChunks.push_back(bulk + offset - chunkSize);
+        }
+        void *ptr = freeChunks.back();
+        freeChunks.pop_back();
+        return ptr;
+    }
+
+    void deallocate(void *ptr, size_t chunkSize) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeChunks[sizeClass(chunkSize)].push_back(ptr);
+    }
+
+  private:
+    ChunkedPool() {
+        size_t minPow2 = numberEnv("ISPCRT_MEM_POOL_MIN_CHUNK_POW2", 6, 6, 30);
+        size_t maxPow2 = numberEnv("ISPCRT_MEM_POOL_MAX_CHUNK_POW2", 21, minPow2, 30);
+        m_minChunkSize = size_t(1) << minPow2;
+        m_maxChunkSize = size_t(1) << maxPow2;
+        m_bulkSize = std::max(m_maxChunkSize, size_t(1) << 21);
+        m_freeChunks.resize(maxPow2 - minPow2 + 1);
+    }
+
+    size_t sizeClass(size_t chunkSize) const {
+        size_t sizeClass = 0;
+        while ((m_minChunkSize << sizeClass) < chunkSize)
+            sizeClass++;
+        return sizeClass;
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::vector<void *>> m_freeChunks;
+
+    size_t m_minChunkSize{0};
+    size_t m_maxChunkSize{0};
+    size_t m_bulkSize{0};
+};
+
+// The host and the device memory are the same on CPU, so the view of the
+// application memory is zero-copy: the device pointer aliases it and the
+// copies are no-ops.  The memory is allocated only if the view is created
+// without the application memory.
 struct MemoryView : public ispcrt::base::MemoryView {
-    MemoryView(void *appMem, size_t numBytes, bool shared)
-        : m_shared(shared), m_hostPtr(appMem), m_devicePtr(appMem), m_size(numBytes) {}
+    // memoryNode is the node of the sub-device, which created the view, or -2
+    // for the process wide node.  The chunks of ChunkedPool are on the latter.
+    MemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags,
+               const ISPCRTMemoryPlacement *placement = nullptr, int32_t memoryNode = -2)
+        : m_shared(flags->allocType == ISPCRT_ALLOC_TYPE_SHARED),
+          m_usePool(ChunkedPool::enabled(flags) && (!placement || placement->flags == ISPCRT_MEM_DEFAULT) &&
+                    memoryNode == -2),
+          m_placement(placement ? placement->flags : uint32_t(ISPCRT_MEM_DEFAULT)),
+          m_numaNode(placement ? placement->numaNode : 0), m_memoryNode(memoryNode), m_hostPtr(appMem),
+          m_devicePtr(appMem), m_size(numBytes) {}
+
+    // The slice of the memory of parent, see slice().
+    MemoryView(MemoryView &parent, size_t offset, size_t numBytes)
+        : m_shared(parent.m_shared), m_parent(parent.m_parent ? parent.m_parent : &parent),
+          m_offset(parent.m_offset + offset), m_size(numBytes) {
+        m_parent->refInc();
+    }
 
     ~MemoryView() {
-        if (!m_external_alloc && m_devicePtr)
-            free(m_devicePtr);
+        if (m_parent) {
+            m_parent->refDec();
+            return;
+        }
+        if (!m_external_alloc && m_devicePtr) {
+            if (m_chunkSize)
+                ChunkedPool::get()->deallocate(m_devicePtr, m_chunkSize);
+#ifdef __linux__
+            else if (m_mappedSize)
+                munmap(m_devicePtr, m_mappedSize);
+#endif
+            else
+                freeAligned(m_devicePtr);
+        }
     }
 
     bool isShared() { return m_shared; }
 
     void *hostPtr() {
+        if (m_parent)
+            return static_cast<char *>(m_parent->hostPtr()) + m_offset;
         if (m_shared) {
             return devicePtr();
         } else {
@@ -84,6 +393,8 @@ struct MemoryView : public ispcrt::base::MemoryView {
     };
 
     void *devicePtr() {
+        if (m_parent)
+            return static_cast<char *>(m_parent->devicePtr()) + m_offset;
         if (!m_devicePtr)
             allocate();
         return m_devicePtr;
@@ -91,18 +402,41 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
     size_t numBytes() { return m_size; };
 
+    ispcrt::base::MemoryView *slice(size_t offset, size_t numBytes) { return new MemoryView(*this, offset, numBytes); }
+
   private:
     void allocate() {
-        m_devicePtr = malloc(m_size);
+        if (m_usePool)
+            m_chunkSize = ChunkedPool::get()->chunkSize(m_size);
+        if (m_chunkSize)
+            m_devicePtr = ChunkedPool::get()->allocate(m_chunkSize);
+        else if (m_placement != ISPCRT_MEM_DEFAULT)
+            m_devicePtr = allocatePlaced(m_size, m_placement, m_numaNode, node(), m_mappedSize);
+        else
+            m_devicePtr = allocateOnNode(m_size, node());
         if (!m_devicePtr)
             throw std::bad_alloc();
         m_external_alloc = false;
     }
+    int32_t node() const { return m_memoryNode == -2 ? memoryNode() : m_memoryNode; }
+
     bool m_external_alloc{true};
     bool m_shared{false};
+    bool m_usePool{false};
+    uint32_t m_placement{ISPCRT_MEM_DEFAULT};
+    uint32_t m_numaNode{0};
+    int32_t m_memoryNode{-2};
+    // The view this one is a slice of, which owns the memory, and the
+    // offset of the slice in it.
+    MemoryView *m_parent{nullptr};
+    size_t m_offset{0};
     void *m_hostPtr{nullptr};
     void *m_devicePtr{nullptr};
     size_t m_size{0};
+    // Size of the chunk from ChunkedPool or 0 if the memory isn't pooled.
+    size_t m_chunkSize{0};
+    // Length of the mapping of the placed memory or 0 if it isn't mapped.
+    size_t m_mappedSize{0};
 };
 
 struct ModuleOptions : public ispcrt::base::ModuleOptions {
@@ -113,19 +447,67 @@ struct ModuleOptions : public ispcrt::base::ModuleOptions {
     uint32_t stackSize() const { return m_stackSize; }
     bool libraryCompilation() const { return m_libraryCompilation; }
     ISPCRTModuleType moduleType() const { return m_moduleType; }
+    bool eagerKernels() const { return m_eagerKernels; }
+    const std::map<uint32_t, std::vector<uint8_t>> &specConstants() const { return m_specConstants; }
 
     void setStackSize(uint32_t size) { m_stackSize = size; }
     void setLibraryCompilation(bool isLibraryCompilation) { m_libraryCompilation = isLibraryCompilation; }
     void setModuleType(ISPCRTModuleType type) { m_moduleType = type; }
+    void setEagerKernels(bool eager) { m_eagerKernels = eager; }
+    void setSpecConstant(uint32_t id, const void *value, size_t size) {
+        m_specConstants[id].assign((const uint8_t *)value, (const uint8_t *)value + size);
+    }
 
   private:
     ISPCRTModuleType m_moduleType{ISPCRTModuleType::ISPCRT_VECTOR_MODULE};
     bool m_libraryCompilation{false};
     uint32_t m_stackSize{0};
+    bool m_eagerKernels{false};
+    std::map<uint32_t, std::vector<uint8_t>> m_specConstants;
+};
+
+// The C interface of libispc (see libispc.h of ispc), which is loaded on the
+// first compilation of a module from source.
+struct LibISPC {
+    void *(*compile)(const char *source, const char *const *options, uint32_t numOptions){nullptr};
+    void *(*getSymbol)(void *module, const char *name){nullptr};
+    void (*release)(void *module){nullptr};
+
+    static const LibISPC &get() {
+        static LibISPC libispc;
+        if (!libispc.compile || !libispc.getSymbol || !libispc.release)
+            throw std::logic_error("could not load libispc to compile CPU module from source");
+        return libispc;
+    }
+
+  private:
+    LibISPC() {
+#if defined(_WIN32) || defined(_WIN64)
+        SetDllDirectory("");
+        HMODULE lib = LoadLibraryEx("ispc.dll", NULL, 0);
+        if (!lib)
+            return;
+        compile = (decltype(compile))GetProcAddress(lib, "ispcJITCompile");
+        getSymbol = (decltype(getSymbol))GetProcAddress(lib, "ispcJITGetSymbol");
+        release = (decltype(release))GetProcAddress(lib, "ispcJITRelease");
+#else
+#if defined(__MACOSX__) || defined(__APPLE__)
+        void *lib = dlopen("libispc.dylib", RTLD_LAZY | RTLD_LOCAL);
+#else
+        void *lib = dlopen("libispc.so", RTLD_LAZY | RTLD_LOCAL);
+#endif
+        if (!lib)
+            return;
+        compile = (decltype(compile))dlsym(lib, "ispcJITCompile");
+        getSymbol = (decltype(getSymbol))dlsym(lib, "ispcJITGetSymbol");
+        release = (decltype(release))dlsym(lib, "ispcJITRelease");
+#endif
+    }
 };
 
 struct Module : public ispcrt::base::Module {
-    Module(const char *moduleFile) : m_file(moduleFile) {
+    // The eager module binds all the symbols of the library at load.
+    Module(const char *moduleFile, bool eager = false) : m_file(moduleFile) {
         if (!m_file.empty()) {
 #if defined(__MACOSX__) || defined(__APPLE__)
             std::string ext = ".dylib";
@@ -140,7 +522,7 @@ struct Module : public ispcrt::base::Module {
             SetDllDirectory("");
             lib = LoadLibraryEx((m_file + ext).c_str(), NULL, 0);
 #else
-            lib = dlopen(("lib" + m_file + ext).c_str(), RTLD_LAZY | RTLD_LOCAL);
+            lib = dlopen(("lib" + m_file + ext).c_str(), (eager ? RTLD_NOW : RTLD_LAZY) | RTLD_LOCAL);
 #endif
 
             if (!lib)
@@ -149,11 +531,55 @@ struct Module : public ispcrt::base::Module {
         }
     }
 
+    // Load the shared library from its image in memory. On Linux the image is
+    // written to an anonymous memory file, so the file system isn't touched.
+    Module(const void *data, size_t size, bool eager = false) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+        int fd = (int)syscall(SYS_memfd_create, "ispcrt_module", 0);
+        if (fd < 0)
+            throw std::runtime_error("could not create memory file for CPU module");
+        const char *image = (const char *)data;
+        while (size > 0) {
+            ssize_t written = write(fd, image, size);
+            if (written <= 0) {
+                close(fd);
+                throw std::runtime_error("could not write CPU module to memory file");
+            }
+            image += written;
+            size -= written;
+        }
+        // The library stays mapped after the file is closed.
+        void *lib =
+            dlopen(("/proc/self/fd/" + std::to_string(fd)).c_str(), (eager ? RTLD_NOW : RTLD_LAZY) | RTLD_LOCAL);
+        close(fd);
+        if (!lib)
+            throw std::logic_error(std::string("could not load CPU shared module from memory: ") + dlerror());
+        m_libs.push_back(lib);
+#else
+        (void)data;
+        (void)size;
+        (void)eager;
+        throw std::logic_error("loading CPU modules from memory is only supported on Linux");
+#endif
+    }
+
+    // Compile the source code with libispc, the code is kept in memory.
+    Module(const char *source, const char *const *options, const uint32_t numOptions) {
+        const LibISPC &libispc = LibISPC::get();
+        void *jitModule = libispc.compile(source, options, numOptions);
+        if (!jitModule)
+            throw std::logic_error("could not compile CPU module from source");
+        m_jitModules.emplace_back(jitModule, libispc.release);
+    }
+
     Module(Module **modules, const uint32_t numModules) {
         for (uint32_t i = 0; i < numModules; i++) {
             for (auto lib : modules[i]->libs()) {
                 m_libs.push_back(lib);
             }
+            for (auto jitModule : modules[i]->jitModules()) {
+                m_jitModules.push_back(jitModule);
+            }
         }
     }
 
@@ -171,7 +597,13 @@ struct Module : public ispcrt::base::Module {
         }
     }
 
+    // The symbols are looked up in all the libraries and the compiled modules,
+    // so the found ones are cached.
     void *functionPtr(const char *name) const override {
+        std::lock_guard<std::mutex> lock(m_symbolsMutex);
+        auto it = m_symbols.find(name);
+        if (it != m_symbols.end())
+            return it->second;
         void *fptr = nullptr;
         for (auto lib : m_libs) {
 #if defined(_WIN32) || defined(_WIN64)
@@ -182,16 +614,26 @@ struct Module : public ispcrt::base::Module {
             if (fptr != nullptr)
                 break;
         }
+        for (uint32_t i = 0; fptr == nullptr && i < m_jitModules.size(); i++) {
+            fptr = LibISPC::get().getSymbol(m_jitModules[i].get(), name);
+        }
         if (!fptr)
             throw std::logic_error("could not find CPU function");
+        m_symbols.emplace(name, fptr);
         return fptr;
     }
 
     std::vector<void *> libs() { return m_libs; };
+    std::vector<std::shared_ptr<void>> jitModules() { return m_jitModules; };
 
   private:
     std::string m_file;
     std::vector<void *> m_libs;
+    // The modules compiled from source, which are shared by the modules
+    // linked with them.
+    std::vector<std::shared_ptr<void>> m_jitModules;
+    mutable std::mutex m_symbolsMutex;
+    mutable std::unordered_map<std::string, void *> m_symbols;
 };
 
 struct Kernel : public ispcrt::base::Kernel {
@@ -209,8 +651,10 @@ struct Kernel : public ispcrt::base::Kernel {
     }
 
     ~Kernel() {
-        if (m_module)
+        if (m_module) {
+            m_module->forgetKernel(this);
             m_module->refDec();
+        }
     }
 
     CPUKernelEntryPoint entryPoint() const { return m_fcn; }
@@ -222,36 +666,53 @@ struct Kernel : public ispcrt::base::Kernel {
     const ispcrt::base::Module *m_module{nullptr};
 };
 
+// The commands of the CommandList are recorded and executed by submit().
+// barrier() splits them into stages: the commands of one stage don't depend
+// on each other, so they are run concurrently, as tasks of the tasking
+// runtime, and the next stage starts only after all of them are finished.
+// submit() returns when the whole list is executed, so the Fence is always
+// signaled.  The recorded list can be submitted any number of times.
+// The commands of the lists of a sub-device run in the worker pool of the
+// sub-device, the ones of a device of a context with an executor run in the
+// executor.
 struct CommandListImpl : ispcrt::base::CommandList {
-    CommandListImpl() { /* no-op */
-    }
+    CommandListImpl(const std::shared_ptr<void> &workerPool,
+                    const std::shared_ptr<const ISPCRTTaskingCallbacks> &executor)
+        : m_workerPool(workerPool), m_executor(executor) {}
     ~CommandListImpl() {
         clearFences();
-        clearFutures();
+        clearCommands();
     }
 
-    void barrier() override { /* no-op */
+    void barrier() override {
+        if (!m_stages.empty() && !m_stages.back().empty())
+            m_stages.emplace_back();
     }
 
     ispcrt::base::Future *copyToHost(ispcrt::base::MemoryView &) override {
         Future *f = new Future();
-        m_futures.push_back(f);
+        record(f, [](void *) {});
         return f;
     }
 
     ispcrt::base::Future *copyToDevice(ispcrt::base::MemoryView &) override {
         Future *f = new Future();
-        m_futures.push_back(f);
+        record(f, [](void *) {});
         return f;
     }
 
+    // The host memory is the device memory.
+    void prefetch(ispcrt::base::MemoryView &, size_t) override {}
+    void memAdvise(ispcrt::base::MemoryView &, ISPCRTMemAdvice) override {}
+
     ispcrt::base::Future *copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src,
                                          const size_t size) override {
         auto view_dst_ptr = static_cast<std::byte *>(((cpu::MemoryView &)mv_dst).devicePtr());
         auto view_src_ptr = static_cast<std::byte *>(((cpu::MemoryView &)mv_src).devicePtr());
-        std::copy(view_src_ptr, view_src_ptr + size, view_dst_ptr);
+        retain(&mv_dst);
+        retain(&mv_src);
         Future *f = new Future();
-        m_futures.push_back(f);
+        record(f, [=](void *) { std::copy(view_src_ptr, view_src_ptr + size, view_dst_ptr); });
         return f;
     }
 
@@ -261,27 +722,48 @@ struct CommandListImpl : ispcrt::base::CommandList {
         auto *parameters = (cpu::MemoryView *)params;
 
         auto *fcn = kernel.entryPoint();
+        void *paramsPtr = parameters ? parameters->devicePtr() : nullptr;
+        retain(&kernel);
+        if (parameters)
+            retain(parameters);
 
         auto *future = new cpu::Future;
         assert(future);
+        record(future, [=](void *p) { fcn(p, dim0, dim1, dim2); }, paramsPtr, true);
+        return future;
+    }
 
-        auto start = std::chrono::high_resolution_clock::now();
-        fcn(parameters ? parameters->devicePtr() : nullptr, dim0, dim1, dim2);
-        auto end = std::chrono::high_resolution_clock::now();
-
-        if (m_timestamps) {
-            future->m_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    void updateLaunch(ispcrt::base::Future &launch, ispcrt::base::MemoryView *params) override {
+        auto *parameters = (cpu::MemoryView *)params;
+        for (auto &stage : m_stages) {
+            for (auto &command : stage) {
+                if (command.future == &launch && command.isLaunch) {
+                    if (parameters)
+                        retain(parameters);
+                    command.params = parameters ? parameters->devicePtr() : nullptr;
+                    return;
+                }
+            }
         }
-        future->m_valid = true;
-
-        m_futures.push_back(future);
-        return future;
+        throw std::logic_error("the future is not returned by a kernel launch of the command list");
     }
 
     void close() override { /* no-op */
     }
 
     ispcrt::base::Fence *submit() override {
+#ifdef ISPCRT_BUILD_TASKING
+        void *previousPool = m_workerPool ? ISPCSetWorkerPool_cpu(m_workerPool.get()) : nullptr;
+        const ISPCRTTaskingCallbacks *previousExecutor = ISPCSetExecutor_cpu(m_executor.get());
+#endif
+        for (auto &stage : m_stages) {
+            runStage(stage);
+        }
+#ifdef ISPCRT_BUILD_TASKING
+        ISPCSetExecutor_cpu(previousExecutor);
+        if (m_workerPool)
+            ISPCSetWorkerPool_cpu(previousPool);
+#endif
         Fence *f = new Fence;
         m_fences.push_back(f);
         return f;
@@ -289,19 +771,75 @@ struct CommandListImpl : ispcrt::base::CommandList {
 
     void reset() override {
         clearFences();
-        clearFutures();
+        clearCommands();
     }
 
-    // This has no effect at the moment.
     void enableTimestamps() override { m_timestamps = true; }
 
     void *nativeHandle() const override { return nullptr; }
 
   private:
+    struct Command {
+        std::function<void(void *)> fcn;
+        Future *future;
+        bool timestamps;
+        // The argument of fcn, the parameters of the kernel for launches.
+        void *params;
+        bool isLaunch;
+
+        void run() {
+            auto start = std::chrono::high_resolution_clock::now();
+            fcn(params);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            uint64_t time = 0;
+            if (timestamps) {
+                time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            }
+            future->complete(time);
+        }
+    };
+    using Stage = std::vector<Command>;
+
     bool m_timestamps{false};
+    std::shared_ptr<void> m_workerPool;
+    std::shared_ptr<const ISPCRTTaskingCallbacks> m_executor;
 
-    std::vector<Future *> m_futures;
+    std::vector<Stage> m_stages;
     std::vector<Fence *> m_fences;
+    // Kernels and memory views used by the recorded commands.
+    std::vector<RefCounted *> m_retained;
+
+    void record(Future *future, std::function<void(void *)> &&fcn, void *params = nullptr, bool isLaunch = false) {
+        if (m_stages.empty())
+            m_stages.emplace_back();
+        m_stages.back().push_back({std::move(fcn), future, m_timestamps, params, isLaunch});
+    }
+
+    void retain(RefCounted *object) {
+        object->refInc();
+        m_retained.push_back(object);
+    }
+
+#ifdef ISPCRT_BUILD_TASKING
+    static void runCommandTask(void *data, int, int, int taskIndex, int, int, int, int, int, int, int) {
+        (*(Stage *)data)[taskIndex].run();
+    }
+#endif
+
+    static void runStage(Stage &stage) {
+#ifdef ISPCRT_BUILD_TASKING
+        if (stage.size() > 1) {
+            void *handle = nullptr;
+            ISPCLaunch_cpu(&handle, (void *)runCommandTask, &stage, (int)stage.size(), 1, 1);
+            ISPCSync_cpu(handle);
+            return;
+        }
+#endif
+        for (auto &command : stage) {
+            command.run();
+        }
+    }
 
     void clearFences() {
         if (m_fences.size()) {
@@ -312,25 +850,35 @@ struct CommandListImpl : ispcrt::base::CommandList {
         }
     }
 
-    void clearFutures() {
-        if (m_futures.size()) {
-            for (const auto &f : m_futures) {
-                f->refDec();
+    void clearCommands() {
+        for (auto &stage : m_stages) {
+            for (auto &command : stage) {
+                command.future->refDec();
             }
-            m_futures.clear();
         }
+        m_stages.clear();
+        for (const auto &o : m_retained) {
+            o->refDec();
+        }
+        m_retained.clear();
     }
 };
 
+// The command lists may be created by several threads at once, but each list
+// is recorded and submitted by one thread at a time.
 struct CommandQueueImpl : ispcrt::base::CommandQueue {
-    CommandQueueImpl() { /* no-op */
-    }
+    CommandQueueImpl(const std::shared_ptr<void> &workerPool,
+                     const std::shared_ptr<const ISPCRTTaskingCallbacks> &executor)
+        : m_workerPool(workerPool), m_executor(executor) {}
 
     ~CommandQueueImpl() { clearCommandList(); }
 
     ispcrt::base::CommandList *createCommandList() override {
-        CommandListImpl *p = new CommandListImpl();
+        CommandListImpl *p = new CommandListImpl(m_workerPool, m_executor);
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_cmdlists.push_back(p);
+        // The returned reference belongs to the caller
+        p->refInc();
         return p;
     }
 
@@ -340,6 +888,9 @@ struct CommandQueueImpl : ispcrt::base::CommandQueue {
     void *nativeHandle() const override { return nullptr; }
 
   private:
+    std::shared_ptr<void> m_workerPool;
+    std::shared_ptr<const ISPCRTTaskingCallbacks> m_executor;
+    std::mutex m_mutex;
     std::vector<CommandListImpl *> m_cmdlists;
 
     void clearCommandList() {
@@ -352,20 +903,42 @@ struct CommandQueueImpl : ispcrt::base::CommandQueue {
     }
 };
 
+// The commands of the TaskQueue are executed asynchronously, in the order
+// they were enqueued, by the worker thread owned by the queue.  The kernels
+// themselves spread their tasks over the tasking runtime as usual, so the
+// worker thread only drives the queue.  Since the execution is in order,
+// every command already observes the results of all previous ones and
+// barrier() needs no extra work.
+// Any number of threads may enqueue commands at once: they are ordered as
+// they enter the queue, which holds its lock only to push the command, and
+// the futures are kept in a lock-free list until the queue is destroyed.
+// The worker thread of a queue of a sub-device runs on the CPUs of the
+// sub-device and launches the tasks into its worker pool, the one of a queue
+// of a device with an executor launches them into the executor.  Every
+// launch runs with the priority the queue had when it was enqueued.
 struct TaskQueue : public ispcrt::base::TaskQueue {
-    TaskQueue() {
-        // no-op
-    }
+    TaskQueue(const std::shared_ptr<void> &workerPool, const std::shared_ptr<const ISPCRTTaskingCallbacks> &executor)
+        : m_workerPool(workerPool), m_executor(executor), m_worker(&TaskQueue::run, this) {}
 
     ~TaskQueue() {
-        for (auto f : m_futures) {
-            delete f;
+        sync();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cvCommand.notify_one();
+        m_worker.join();
+
+        cpu::Future *f = m_futures.exchange(nullptr, std::memory_order_acquire);
+        while (f) {
+            cpu::Future *next = f->m_nextInQueue;
+            f->refDec();
+            f = next;
         }
-        m_futures.clear();
     }
 
     void barrier() override {
-        // no-op
+        // no-op, commands are executed in order
     }
 
     void copyToHost(ispcrt::base::MemoryView &) override {
@@ -376,10 +949,26 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         // no-op
     }
 
+    void copyToHost(ispcrt::base::MemoryView &, size_t, size_t) override {
+        // no-op
+    }
+
+    void copyToDevice(ispcrt::base::MemoryView &, size_t, size_t) override {
+        // no-op
+    }
+
     void copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src, const size_t size) override {
+        // Allocate the memory, if needed, on the calling thread, so the
+        // allocation failure is reported to the caller.
         auto view_dst_ptr = static_cast<std::byte *>(((cpu::MemoryView &)mv_dst).devicePtr());
         auto view_src_ptr = static_cast<std::byte *>(((cpu::MemoryView &)mv_src).devicePtr());
-        std::copy(view_src_ptr, view_src_ptr + size, view_dst_ptr);
+        mv_dst.refInc();
+        mv_src.refInc();
+        enqueue([=, &mv_dst, &mv_src]() {
+            std::copy(view_src_ptr, view_src_ptr + size, view_dst_ptr);
+            mv_dst.refDec();
+            mv_src.refDec();
+        });
     }
 
     ispcrt::base::Future *launch(ispcrt::base::Kernel &k, ispcrt::base::MemoryView *params, size_t dim0, size_t dim1,
@@ -387,35 +976,149 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         auto &kernel = (cpu::Kernel &)k;
         auto *parameters = (cpu::MemoryView *)params;
 
+        auto *fcn = kernel.entryPoint();
+        void *paramsPtr = parameters ? parameters->devicePtr() : nullptr;
+
+        auto *future = new cpu::Future;
+        assert(future);
+        // List to know what to deallocate when TaskQueue object destructed
+        addFuture(future);
+
+        // Keep the kernel and its parameters alive until the launch is done.
+        kernel.refInc();
+        if (parameters)
+            parameters->refInc();
+        enqueue([=, &kernel, priority = m_priority.load(std::memory_order_relaxed)]() {
+            setTaskPriority(priority);
+            auto start = std::chrono::high_resolution_clock::now();
+            fcn(paramsPtr, dim0, dim1, dim2);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            future->complete(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            if (parameters)
+                parameters->refDec();
+            kernel.refDec();
+        });
+
+        return future;
+    }
+
+    ispcrt::base::Future *launch(ispcrt::base::Kernel &k, const ispcrt::base::KernelArgs &args, size_t dim0,
+                                 size_t dim1, size_t dim2) override {
+        auto &kernel = (cpu::Kernel &)k;
+
         auto *fcn = kernel.entryPoint();
 
         auto *future = new cpu::Future;
         assert(future);
-        // Vector to know what to deallocate when TaskQueue object destructed
-        m_futures.push_back(future);
+        addFuture(future);
 
-        auto start = std::chrono::high_resolution_clock::now();
-        fcn(parameters ? parameters->devicePtr() : nullptr, dim0, dim1, dim2);
-        auto end = std::chrono::high_resolution_clock::now();
+        // The block of the arguments is owned by the command, the entry point
+        // gets it as its parameters.
+        kernel.refInc();
+        enqueue([=, &kernel, data = args.data, priority = m_priority.load(std::memory_order_relaxed)]() mutable {
+            setTaskPriority(priority);
+            auto start = std::chrono::high_resolution_clock::now();
+            fcn(data.empty() ? nullptr : data.data(), dim0, dim1, dim2);
+            auto end = std::chrono::high_resolution_clock::now();
 
-        future->m_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-        future->m_valid = true;
+            future->complete(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            kernel.refDec();
+        });
 
         return future;
     }
 
     void sync() override {
-        // no-op
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvIdle.wait(lock, [this] { return m_commands.empty() && !m_busy; });
+    }
+
+    void setLaunchPriority(ISPCRTTaskPriority priority) override {
+        m_priority.store(priority, std::memory_order_relaxed);
     }
 
     void *taskQueueNativeHandle() const override { return nullptr; }
 
   private:
-    std::vector<cpu::Future *> m_futures;
+    std::shared_ptr<void> m_workerPool;
+    std::shared_ptr<const ISPCRTTaskingCallbacks> m_executor;
+    std::atomic<ISPCRTTaskPriority> m_priority{ISPCRT_TASK_PRIORITY_NORMAL};
+    // Head of the list of the futures linked by Future::m_nextInQueue.
+    std::atomic<cpu::Future *> m_futures{nullptr};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cvCommand;
+    std::condition_variable m_cvIdle;
+    std::deque<std::function<void()>> m_commands;
+    bool m_busy{false};
+    bool m_stop{false};
+    std::thread m_worker;
+
+    void addFuture(cpu::Future *future) {
+        future->m_nextInQueue = m_futures.load(std::memory_order_relaxed);
+        while (!m_futures.compare_exchange_weak(future->m_nextInQueue, future, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+    }
+
+    void enqueue(std::function<void()> &&command) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_commands.push_back(std::move(command));
+        }
+        m_cvCommand.notify_one();
+    }
+
+    static void setTaskPriority([[maybe_unused]] ISPCRTTaskPriority priority) {
+#ifdef ISPCRT_BUILD_TASKING
+        ISPCSetPriority_cpu(priority);
+#endif
+    }
+
+    void run() {
+#ifdef ISPCRT_BUILD_TASKING
+        if (m_workerPool) {
+            ISPCSetWorkerPool_cpu(m_workerPool.get());
+            ISPCPinToWorkerPool_cpu(m_workerPool.get());
+        }
+        ISPCSetExecutor_cpu(m_executor.get());
+#endif
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_cvCommand.wait(lock, [this] { return m_stop || !m_commands.empty(); });
+            if (m_commands.empty())
+                return;
+            auto command = std::move(m_commands.front());
+            m_commands.pop_front();
+            m_busy = true;
+            lock.unlock();
+            command();
+            lock.lock();
+            m_busy = false;
+            if (m_commands.empty())
+                m_cvIdle.notify_all();
+        }
+    }
 };
 
 uint32_t deviceCount() { return 1; }
 
+void setDeviceOptions(const ISPCRTCpuDeviceOptions &options) {
+#ifdef ISPCRT_BUILD_TASKING
+    ISPCSetAffinity_cpu(options.affinity, options.cores, options.numCores);
+#endif
+    g_memoryNode = options.memoryNode < 0 ? -1 : options.memoryNode;
+}
+
+ISPCRTTaskPriority currentTaskPriority() {
+#ifdef ISPCRT_BUILD_TASKING
+    return (ISPCRTTaskPriority)ISPCGetPriority_cpu();
+#else
+    return ISPCRT_TASK_PRIORITY_NORMAL;
+#endif
+}
+
 ISPCRTDeviceInfo deviceInfo([[maybe_unused]] uint32_t deviceIdx) {
     ISPCRTDeviceInfo info;
     info.deviceId = 0; // for CPU we don't support it yet
@@ -425,16 +1128,35 @@ ISPCRTDeviceInfo deviceInfo([[maybe_unused]] uint32_t deviceIdx) {
 
 } // namespace cpu
 
+CPUDevice::CPUDevice([[maybe_unused]] const ISPCRTCpuDeviceOptions &options)
+    : m_memoryNode(options.memoryNode < 0 ? -1 : options.memoryNode) {
+#ifdef ISPCRT_BUILD_TASKING
+    void *pool = ISPCNewWorkerPool_cpu(options.affinity, options.cores, options.numCores);
+    if (pool == nullptr)
+        throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED, "CPU sub-devices require the pthreads tasking model");
+    m_workerPool = std::shared_ptr<void>(pool, ISPCDeleteWorkerPool_cpu);
+#else
+    throw base::ispcrt_runtime_error(ISPCRT_UNSUPPORTED, "CPU sub-devices require the built-in tasking");
+#endif
+}
+
+CPUDevice::CPUDevice(const CPUContext &context) : m_executor(context.executor()) {}
+
 ispcrt::base::MemoryView *CPUDevice::newMemoryView(void *appMem, size_t numBytes,
-                                                   const ISPCRTNewMemoryViewFlags *flags) const {
-    return new cpu::MemoryView(appMem, numBytes, flags->allocType == ISPCRT_ALLOC_TYPE_SHARED);
+                                                   const ISPCRTNewMemoryViewFlags *flags,
+                                                   const ISPCRTMemoryPlacement *placement) const {
+    return new cpu::MemoryView(appMem, numBytes, flags, placement, m_memoryNode);
 }
 
 ispcrt::base::CommandQueue *CPUDevice::newCommandQueue([[maybe_unused]] uint32_t ordinal) const {
-    return new cpu::CommandQueueImpl();
+    return new cpu::CommandQueueImpl(m_workerPool, m_executor);
 }
 
-ispcrt::base::TaskQueue *CPUDevice::newTaskQueue() const { return new cpu::TaskQueue(); }
+// The commands of the CPU TaskQueue are always started as soon as they are
+// enqueued, so there is nothing to do for ISPCRT_TASK_QUEUE_IMMEDIATE.
+ispcrt::base::TaskQueue *CPUDevice::newTaskQueue(uint32_t) const {
+    return new cpu::TaskQueue(m_workerPool, m_executor);
+}
 
 ispcrt::base::ModuleOptions *CPUDevice::newModuleOptions() const { return new cpu::ModuleOptions(); }
 
@@ -444,8 +1166,18 @@ ispcrt::base::ModuleOptions *CPUDevice::newModuleOptions(ISPCRTModuleType module
 }
 
 ispcrt::base::Module *CPUDevice::newModule(const char *moduleFile,
-                                           [[maybe_unused]] const ispcrt::base::ModuleOptions &moduleOpts) const {
-    return new cpu::Module(moduleFile);
+                                           const ispcrt::base::ModuleOptions &moduleOpts) const {
+    return new cpu::Module(moduleFile, moduleOpts.eagerKernels());
+}
+
+ispcrt::base::Module *CPUDevice::newModuleFromSource(const char *source, const char *const *options,
+                                                     uint32_t numOptions) const {
+    return new cpu::Module(source, options, numOptions);
+}
+
+ispcrt::base::Module *CPUDevice::newModuleFromMemory(const void *data, size_t size,
+                                                     const ispcrt::base::ModuleOptions &opts) const {
+    return new cpu::Module(data, size, opts.eagerKernels());
 }
 
 void CPUDevice::dynamicLinkModules([[maybe_unused]] base::Module **modules,
@@ -455,7 +1187,8 @@ ispcrt::base::Module *CPUDevice::staticLinkModules(base::Module **modules, const
     return new cpu::Module((cpu::Module **)modules, numModules);
 }
 
-ispcrt::base::Kernel *CPUDevice::newKernel(const ispcrt::base::Module &module, const char *name) const {
+ispcrt::base::Kernel *CPUDevice::newKernel(const ispcrt::base::Module &module, const char *name,
+                                           [[maybe_unused]] uint32_t width) const {
     return new cpu::Kernel(module, name);
 }
 
@@ -473,11 +1206,17 @@ ISPCRTAllocationType CPUDevice::getMemAllocType([[maybe_unused]] void *appMemory
 
 ispcrt::base::MemoryView *CPUContext::newMemoryView(void *appMem, size_t numBytes,
                                                     const ISPCRTNewMemoryViewFlags *flags) const {
-    return new cpu::MemoryView(appMem, numBytes, flags->allocType == ISPCRT_ALLOC_TYPE_SHARED);
+    return new cpu::MemoryView(appMem, numBytes, flags);
 }
 
 ISPCRTDeviceType CPUContext::getDeviceType() const { return ISPCRTDeviceType::ISPCRT_DEVICE_TYPE_CPU; }
 
 void *CPUContext::contextNativeHandle() const { return nullptr; }
 
+void CPUContext::setTaskingCallbacks(const ISPCRTTaskingCallbacks *callbacks) {
+    if (callbacks && (!callbacks->launch || !callbacks->alloc || !callbacks->sync))
+        throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "all of the tasking callbacks must be set");
+    m_executor = callbacks ? std::make_shared<const ISPCRTTaskingCallbacks>(*callbacks) : nullptr;
+}
+
 } // namespace ispcrt
@@ -7,6 +7,9 @@
 #include "../Device.h"
 #include "../Future.h"
 #include "../ModuleOptions.h"
+#include "CPUTopology.h"
+
+#include <memory>
 
 namespace ispcrt {
 
@@ -14,29 +17,41 @@ namespace cpu {
 
 uint32_t deviceCount();
 ISPCRTDeviceInfo deviceInfo(uint32_t deviceIdx);
+void setDeviceOptions(const ISPCRTCpuDeviceOptions &options);
+ISPCRTTaskPriority currentTaskPriority();
 
 }; // namespace cpu
 
+struct CPUContext;
+
 struct CPUDevice : public base::Device {
     CPUDevice() = default;
+    // Device running its launches with the executor of the context.
+    explicit CPUDevice(const CPUContext &context);
+    // Sub-device with the worker threads of its own, placed as the options
+    // say, and the memory on options.memoryNode.
+    explicit CPUDevice(const ISPCRTCpuDeviceOptions &options);
 
-    base::MemoryView *newMemoryView(void *appMem, size_t numBytes,
-                                    const ISPCRTNewMemoryViewFlags *flags) const override;
+    base::MemoryView *newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags,
+                                    const ISPCRTMemoryPlacement *placement) const override;
 
     base::CommandQueue *newCommandQueue(uint32_t ordinal) const override;
 
-    base::TaskQueue *newTaskQueue() const override;
+    base::TaskQueue *newTaskQueue(uint32_t flags) const override;
 
     base::ModuleOptions *newModuleOptions() const override;
     base::ModuleOptions *newModuleOptions(ISPCRTModuleType moduleType, bool libraryCompilation,
                                           uint32_t stackSize) const override;
 
     base::Module *newModule(const char *moduleFile, const base::ModuleOptions &moduleOpts) const override;
+    base::Module *newModuleFromSource(const char *source, const char *const *options,
+                                      uint32_t numOptions) const override;
+    base::Module *newModuleFromMemory(const void *data, size_t size, const base::ModuleOptions &opts) const override;
 
     void dynamicLinkModules(base::Module **modules, const uint32_t numModules) const override;
     base::Module *staticLinkModules(base::Module **modules, const uint32_t numModules) const override;
 
-    base::Kernel *newKernel(const base::Module &module, const char *name) const override;
+    base::Kernel *newKernel(const base::Module &module, const char *name, uint32_t width) const override;
 
     void *platformNativeHandle() const override;
     void *deviceNativeHandle() const override;
@@ -45,6 +60,15 @@ struct CPUDevice : public base::Device {
     ISPCRTDeviceType getType() const override;
 
     ISPCRTAllocationType getMemAllocType(void *appMemory) const override;
+
+  private:
+    // Worker pool of the tasking runtime, shared with the queues, which may
+    // outlive the device.  Null for the device, which uses the default pool.
+    std::shared_ptr<void> m_workerPool;
+    // NUMA node of the memory views, -2 to use ispcrtSetCpuDeviceOptions().
+    int32_t m_memoryNode{-2};
+    // Executor of the context, null for the built-in tasking runtime.
+    std::shared_ptr<const ISPCRTTaskingCallbacks> m_executor;
 };
 
 } // namespace ispcrt
@@ -52,6 +76,10 @@ struct CPUDevice : public base::Device {
 // Expose API of CPU device solib for dlsym.
 extern "C" {
 ispcrt::base::Device *load_cpu_device();
+ispcrt::base::Device *load_cpu_sub_device(const ISPCRTCpuDeviceOptions *options);
 uint32_t cpu_device_count();
 ISPCRTDeviceInfo cpu_device_info(uint32_t idx);
+void cpu_set_device_options(const ISPCRTCpuDeviceOptions *options);
+void cpu_topology(ISPCRTCpuTopology *topology);
+ISPCRTTaskPriority cpu_current_task_priority();
 }
@@ -0,0 +1,632 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "CPUTopology.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define HOST_IS_WINDOWS
+#include <intrin.h>
+#include <windows.h>
+#elif defined(__APPLE__)
+#define HOST_IS_APPLE
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+// std
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace ispcrt {
+namespace cpu {
+
+///////////////////////////////////////////////////////////////////////////
+// ISA detection
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#if !defined(HOST_IS_WINDOWS)
+static void __cpuid(int info[4], int infoType) {
+    __asm__ __volatile__("cpuid" : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3]) : "0"(infoType));
+}
+
+static void __cpuidex(int info[4], int level, int count) {
+    __asm__ __volatile__("cpuid" : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3]) : "0"(level), "2"(count));
+}
+#endif // !HOST_IS_WINDOWS
+
+static bool __os_has_avx_support() {
+#if defined(HOST_IS_WINDOWS)
+    // Check if the OS will save the YMM registers
+    unsigned long long xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
+    return (xcrFeatureMask & 6) == 6;
+#else  // !defined(HOST_IS_WINDOWS)
+    // Check xgetbv; this uses a .byte sequence instead of the instruction
+    // directly because older assemblers do not include support for xgetbv and
+    // there is no easy way to conditionally compile based on the assembler used.
+    int rEAX = 0, rEDX = 0;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(rEAX), "=d"(rEDX) : "c"(0));
+    return (rEAX & 6) == 6;
+#endif // !defined(HOST_IS_WINDOWS)
+}
+
+static bool __os_has_avx512_support() {
+#if defined(HOST_IS_WINDOWS)
+    // Check if the OS saves the XMM, YMM and ZMM registers, i.e. it supports AVX2 and AVX512.
+    // See section 2.1 of software.intel.com/sites/default/files/managed/0d/53/319433-022.pdf
+    unsigned long long xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
+    return (xcrFeatureMask & 0xE6) == 0xE6;
+#elif defined(HOST_IS_APPLE)
+    // macOS has different way of dealing with AVX512 than Windows and Linux:
+    // - by default AVX512 is off in the newly created thread, which means CPUID flags will
+    //   indicate AVX512 availability, but OS support check (XCR0) will not succeed.
+    // - AVX512 can be enabled either by calling thread_set_state() or by executing any
+    //   AVX512 instruction, which would cause #UD exception handled by the OS.
+    // The purpose of this check is to identify if AVX512 is potentially available, so we
+    // need to bypass OS check and look at CPUID flags only.
+    // See ispc issue #1854 for more details.
+    return true;
+#else  // !defined(HOST_IS_WINDOWS)
+    // Check xgetbv; this uses a .byte sequence instead of the instruction
+    // directly because older assemblers do not include support for xgetbv and
+    // there is no easy way to conditionally compile based on the assembler used.
+    int rEAX = 0, rEDX = 0;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(rEAX), "=d"(rEDX) : "c"(0));
+    return (rEAX & 0xE6) == 0xE6;
+#endif // !defined(HOST_IS_WINDOWS)
+}
+
+static bool __os_enabled_amx_support() {
+#if defined(HOST_IS_WINDOWS)
+    // Check if the OS will save the YMM registers
+    unsigned long long xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
+    return (xcrFeatureMask & 0x60000) == 0x60000;
+#else  // !defined(HOST_IS_WINDOWS)
+    // Check xgetbv; this uses a .byte sequence instead of the instruction
+    // directly because older assemblers do not include support for xgetbv and
+    // there is no easy way to conditionally compile based on the assembler used.
+    int rEAX = 0, rEDX = 0;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(rEAX), "=d"(rEDX) : "c"(0));
+    return (rEAX & 0x60000) == 0x60000;
+#endif // !defined(HOST_IS_WINDOWS)
+}
+
+static std::string lBrandString() {
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned)info[0] < 0x80000004)
+        return "";
+    char brand[49] = {};
+    for (int i = 0; i < 3; ++i) {
+        __cpuid(info, 0x80000002 + i);
+        memcpy(brand + 16 * i, info, 16);
+    }
+    return brand;
+}
+#endif // !__x86_64__
+
+enum class ISA { Error, SSE2, SSE41, SSE42, AVX, AVX11, AVX2, AVX2VNNI, AVX10, KNL, SKX, ICL, SPR };
+
+static ISA lDetectISA(bool &amx) {
+    amx = false;
+#if defined(__arm__) || defined(__aarch64__) || defined(_M_ARM64)
+    return ISA::Error;
+#elif defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    int info[4];
+    __cpuid(info, 1);
+
+    int info2[4];
+    // Call cpuid with eax=7, ecx=0
+    __cpuidex(info2, 7, 0);
+
+    int info3[4] = {0, 0, 0, 0};
+    int max_subleaf = info2[0];
+    // Call cpuid with eax=7, ecx=1
+    if (max_subleaf >= 1)
+        __cpuidex(info3, 7, 1);
+
+    // clang-format off
+    bool sse2 =                (info[3] & (1 << 26))  != 0;
+    bool sse41 =               (info[2] & (1 << 19))  != 0;
+    bool sse42 =               (info[2] & (1 << 20))  != 0;
+    bool avx_f16c =            (info[2] & (1 << 29))  != 0;
+    bool avx_rdrand =          (info[2] & (1 << 30))  != 0;
+    bool osxsave =             (info[2] & (1 << 27))  != 0;
+    bool avx =                 (info[2] & (1 << 28))  != 0;
+    bool avx2 =                (info2[1] & (1 << 5))  != 0;
+    bool avx_vnni =            (info3[0] & (1 << 4))  != 0;
+    bool avx10 =               (info3[3] & (1 << 19)) != 0;
+    bool avx512_f =            (info2[1] & (1 << 16)) != 0;
+    // clang-format on
+
+    if (osxsave && avx2 && avx512_f && __os_has_avx512_support()) {
+        // We need to verify that AVX2 is also available,
+        // as well as AVX512, because our targets are supposed
+        // to use both.
+        // clang-format off
+        bool avx512_dq =           (info2[1] & (1 << 17)) != 0;
+        bool avx512_pf =           (info2[1] & (1 << 26)) != 0;
+        bool avx512_er =           (info2[1] & (1 << 27)) != 0;
+        bool avx512_cd =           (info2[1] & (1 << 28)) != 0;
+        bool avx512_bw =           (info2[1] & (1 << 30)) != 0;
+        bool avx512_vl =           (info2[1] & (1 << 31)) != 0;
+        bool avx512_vbmi2 =        (info2[2] & (1 << 6))  != 0;
+        bool avx512_gfni =         (info2[2] & (1 << 8))  != 0;
+        bool avx512_vaes =         (info2[2] & (1 << 9))  != 0;
+        bool avx512_vpclmulqdq =   (info2[2] & (1 << 10)) != 0;
+        bool avx512_vnni =         (info2[2] & (1 << 11)) != 0;
+        bool avx512_bitalg =       (info2[2] & (1 << 12)) != 0;
+        bool avx512_vpopcntdq =    (info2[2] & (1 << 14)) != 0;
+        bool avx512_bf16 =         (info3[0] & (1 << 5))  != 0;
+        bool avx512_vp2intersect = (info2[3] & (1 << 8))  != 0;
+        bool avx512_amx_bf16 =     (info2[3] & (1 << 22)) != 0;
+        bool avx512_amx_tile =     (info2[3] & (1 << 24)) != 0;
+        bool avx512_amx_int8 =     (info2[3] & (1 << 25)) != 0;
+        bool avx512_fp16 =         (info2[3] & (1 << 23)) != 0;
+        // clang-format on
+
+        // Knights Landing:          KNL = F + PF + ER + CD
+        // Skylake server:           SKX = F + DQ + CD + BW + VL
+        // Cascade Lake server:      CLX = SKX + VNNI
+        // Cooper Lake server:       CPX = CLX + BF16
+        // Ice Lake client & server: ICL = CLX + VBMI2 + GFNI + VAES + VPCLMULQDQ + BITALG + VPOPCNTDQ
+        // Tiger Lake:               TGL = ICL + VP2INTERSECT
+        // Sapphire Rapids:          SPR = ICL + BF16 + AMX_BF16 + AMX_TILE + AMX_INT8 + AVX_VNNI + FP16
+        bool knl = avx512_pf && avx512_er && avx512_cd;
+        bool skx = avx512_dq && avx512_cd && avx512_bw && avx512_vl;
+        bool clx = skx && avx512_vnni;
+        [[maybe_unused]] bool cpx = clx && avx512_bf16;
+        bool icl =
+            clx && avx512_vbmi2 && avx512_gfni && avx512_vaes && avx512_vpclmulqdq && avx512_bitalg && avx512_vpopcntdq;
+        [[maybe_unused]] bool tgl = icl && avx512_vp2intersect;
+        bool spr =
+            icl && avx512_bf16 && avx512_amx_bf16 && avx512_amx_tile && avx512_amx_int8 && avx_vnni && avx512_fp16;
+        if (spr) {
+            amx = __os_enabled_amx_support();
+            return ISA::SPR;
+        } else if (icl) {
+            return ISA::ICL;
+        } else if (skx) {
+            return ISA::SKX;
+        } else if (knl) {
+            return ISA::KNL;
+        }
+        // If it's unknown AVX512 target, fall through and use AVX2
+        // or whatever is available in the machine.
+    }
+
+    if (osxsave && avx10 && __os_has_avx512_support()) {
+        return ISA::AVX10;
+    }
+
+    if (osxsave && avx && __os_has_avx_support()) {
+        if (avx_vnni) {
+            return ISA::AVX2VNNI;
+        }
+        // AVX1 for sure....
+        // Ivy Bridge?
+        if (avx_f16c && avx_rdrand) {
+            // So far, so good.  AVX2?
+            // Ivy Bridge specific target was deprecated in ISPC, but no harm
+            // detecting it.
+            return avx2 ? ISA::AVX2 : ISA::AVX11;
+        }
+        // Regular AVX
+        return ISA::AVX;
+    } else if (sse42) {
+        return ISA::SSE42;
+    } else if (sse41) {
+        return ISA::SSE41;
+    } else if (sse2) {
+        return ISA::SSE2;
+    } else {
+        return ISA::Error;
+    }
+#else
+#error "Unsupported host CPU architecture."
+#endif
+}
+
+static const char *lISAName(ISA isa, bool amx) {
+#if defined(__arm__) || defined(__aarch64__) || defined(_M_ARM64)
+    return "ARM NEON";
+#else
+    switch (isa) {
+    case ISA::SPR:
+        return amx ? "SPR (AMX on)" : "SPR (AMX off)";
+    case ISA::ICL:
+        return "ICL";
+    case ISA::SKX:
+        return "SKX";
+    case ISA::KNL:
+        return "KNL";
+    case ISA::AVX10:
+        return "AVX10 (256-bit)";
+    case ISA::AVX2VNNI:
+        return "AVX2VNNI (codename Alder Lake)";
+    case ISA::AVX2:
+        return "AVX2 (codename Haswell)";
+    case ISA::AVX11:
+        return "AVX1.1 (codename Ivy Bridge)";
+    case ISA::AVX:
+        return "AVX (codename Sandy Bridge)";
+    case ISA::SSE42:
+        return "SSE4.2";
+    case ISA::SSE41:
+        return "SSE4.1";
+    case ISA::SSE2:
+        return "SSE2";
+    default:
+        return "Error";
+    }
+#endif
+}
+
+/* Number of 512-bit FMA units per core.  CPUID doesn't report it, so it's
+   guessed from the brand string of the Skylake family processors: Xeon Phi,
+   Platinum, Gold 6xxx, Xeon W and the HEDT Core processors have two units,
+   Gold 5xxx (except 5122), Silver and Bronze have one.  The newer client
+   processors have one unit too.  Returns 0 if it's unknown.
+ */
+static uint32_t lAVX512FMAUnits([[maybe_unused]] ISA isa) {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    if (isa < ISA::KNL)
+        return 0;
+    std::string brand = lBrandString();
+    if (brand.find("Xeon Phi") != std::string::npos || brand.find("Platinum") != std::string::npos ||
+        brand.find("Gold 5122") != std::string::npos)
+        return 2;
+    if (brand.find("Gold 5") != std::string::npos || brand.find("Silver") != std::string::npos ||
+        brand.find("Bronze") != std::string::npos)
+        return 1;
+    if (brand.find("Gold") != std::string::npos || brand.find("Xeon") != std::string::npos)
+        return 2;
+    if (brand.find("Core") != std::string::npos)
+        return isa == ISA::SKX ? 2 : 1;
+#endif
+    return 0;
+}
+
+// The best target of the ISA first, followed by the fallbacks for the older
+// CPUs.  With one FMA unit the 512-bit vectors don't pay off, so the AVX512
+// target uses 8 lanes.
+static std::string lRecommendedTargets(ISA isa, uint32_t fmaUnits) {
+#if defined(__arm__) || defined(__aarch64__) || defined(_M_ARM64)
+    return "neon-i32x4";
+#else
+    const char *width = fmaUnits == 1 ? "x8" : "x16";
+    std::string best;
+    switch (isa) {
+    case ISA::SPR:
+        best = std::string("avx512spr-") + width;
+        break;
+    case ISA::ICL:
+        best = std::string("avx512icl-") + width;
+        break;
+    case ISA::SKX:
+        best = std::string("avx512skx-") + width;
+        break;
+    case ISA::KNL:
+        best = "avx512knl-x16";
+        break;
+    case ISA::AVX10:
+        best = "avx10-x8";
+        break;
+    case ISA::AVX2VNNI:
+        best = "avx2vnni-i32x8";
+        break;
+    case ISA::AVX2:
+        best = "avx2-i32x8";
+        break;
+    case ISA::AVX11:
+    case ISA::AVX:
+        best = "avx1-i32x8";
+        break;
+    case ISA::SSE42:
+        best = "sse4.2-i32x4";
+        break;
+    case ISA::SSE41:
+        best = "sse4.1-i32x4";
+        break;
+    case ISA::SSE2:
+        best = "sse2-i32x4";
+        break;
+    default:
+        return "";
+    }
+    if (isa > ISA::AVX2)
+        best += ",avx2-i32x8";
+    if (isa > ISA::SSE42)
+        best += ",sse4-i32x4";
+    return best;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Topology detection
+
+bool parseCPUList(const char *str, std::vector<int> &cpus) {
+    while (*str != '\0' && *str != '\n') {
+        char *end;
+        long first = strtol(str, &end, 10);
+        if (end == str || first < 0)
+            return false;
+        long last = first;
+        str = end;
+        if (*str == '-') {
+            last = strtol(str + 1, &end, 10);
+            if (end == str + 1 || last < first)
+                return false;
+            str = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+            cpus.push_back((int)cpu);
+        if (*str == ',')
+            ++str;
+        else if (*str != '\0' && *str != '\n')
+            return false;
+    }
+    return true;
+}
+
+#ifdef __linux__
+// First line of a sysfs file, empty if it can't be read.
+static std::string lReadLine(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == nullptr)
+        return "";
+    char buf[4096];
+    std::string line;
+    if (fgets(buf, sizeof(buf), f) != nullptr)
+        line = buf;
+    fclose(f);
+    while (!line.empty() && (line.back() == '\n' || line.back() == ' '))
+        line.pop_back();
+    return line;
+}
+
+static bool lReadCPUList(const char *path, std::vector<int> &cpus) {
+    std::string line = lReadLine(path);
+    return !line.empty() && parseCPUList(line.c_str(), cpus);
+}
+#endif // __linux__
+
+int readNUMANodes([[maybe_unused]] std::vector<int> &cpuToNode) {
+#ifdef __linux__
+    for (int node = 0;; ++node) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (f == nullptr)
+            return std::max(node, 1);
+        fclose(f);
+        std::vector<int> cpus;
+        if (lReadCPUList(path, cpus)) {
+            for (int cpu : cpus) {
+                if (cpu >= (int)cpuToNode.size())
+                    cpuToNode.resize(cpu + 1, 0);
+                cpuToNode[cpu] = node;
+            }
+        }
+    }
+#else
+    return 1;
+#endif // __linux__
+}
+
+bool readHybridCPUs([[maybe_unused]] std::vector<int> &performanceCPUs,
+                    [[maybe_unused]] std::vector<int> &efficientCPUs) {
+#ifdef __linux__
+    // Hybrid processors have separate PMUs for the performance and the
+    // efficient cores.
+    return lReadCPUList("/sys/devices/cpu_core/cpus", performanceCPUs) &&
+           lReadCPUList("/sys/devices/cpu_atom/cpus", efficientCPUs);
+#else
+    return false;
+#endif // __linux__
+}
+
+#if defined(__linux__)
+static void lDetectTopology(ISPCRTCpuTopology &topo) {
+    std::vector<int> online;
+    if (!lReadCPUList("/sys/devices/system/cpu/online", online))
+        return;
+    std::set<int> packages;
+    std::set<std::pair<int, int>> cores;
+    // Caches are identified by their level and the first CPU sharing them.
+    std::set<std::pair<int, int>> caches;
+    char path[256];
+    for (int cpu : online) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = atoi(lReadLine(path).c_str());
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        packages.insert(package);
+        cores.insert({package, atoi(lReadLine(path).c_str())});
+
+        for (int index = 0;; ++index) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+            std::string level = lReadLine(path);
+            if (level.empty())
+                break;
+            int l = atoi(level.c_str());
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, index);
+            if (l < 1 || l > ISPCRT_CPU_CACHE_LEVELS || lReadLine(path) == "Instruction")
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+            std::vector<int> sharing;
+            if (!lReadCPUList(path, sharing) || sharing.empty() || !caches.insert({l, sharing[0]}).second)
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, index);
+            std::string size = lReadLine(path);
+            uint64_t bytes = strtoull(size.c_str(), nullptr, 10);
+            if (!size.empty() && size.back() == 'K')
+                bytes <<= 10;
+            else if (!size.empty() && size.back() == 'M')
+                bytes <<= 20;
+            topo.cacheSize[l - 1] = bytes;
+            topo.cacheSharing[l - 1] = (uint32_t)sharing.size();
+        }
+    }
+    topo.numThreads = (uint32_t)online.size();
+    topo.numPackages = (uint32_t)packages.size();
+    topo.numCores = (uint32_t)cores.size();
+
+    std::vector<int> pCPUs, eCPUs;
+    if (readHybridCPUs(pCPUs, eCPUs)) {
+        auto countCores = [](const std::vector<int> &cpus) {
+            std::set<std::string> ids;
+            char path[256];
+            for (int cpu : cpus) {
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+                std::string id = lReadLine(path) + ":";
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+                ids.insert(id + lReadLine(path));
+            }
+            return (uint32_t)ids.size();
+        };
+        topo.numPerformanceCores = countCores(pCPUs);
+        topo.numEfficiencyCores = countCores(eCPUs);
+    }
+
+    std::vector<int> cpuToNode;
+    topo.numNumaNodes = (uint32_t)readNUMANodes(cpuToNode);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        topo.numAvailableThreads = (uint32_t)CPU_COUNT(&allowed);
+}
+#elif defined(HOST_IS_WINDOWS)
+static void lDetectTopology(ISPCRTCpuTopology &topo) {
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        return;
+    std::vector<char> buffer(length);
+    if (!GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(),
+                                          &length))
+        return;
+
+    auto popcount = [](KAFFINITY mask) {
+        uint32_t n = 0;
+        for (; mask != 0; mask &= mask - 1)
+            ++n;
+        return n;
+    };
+    BYTE maxEfficiency = 0;
+    std::vector<BYTE> coreEfficiency;
+    for (DWORD offset = 0; offset < length;) {
+        auto *info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+        switch (info->Relationship) {
+        case RelationProcessorCore:
+            ++topo.numCores;
+            for (WORD g = 0; g < info->Processor.GroupCount; ++g)
+                topo.numThreads += popcount(info->Processor.GroupMask[g].Mask);
+            coreEfficiency.push_back(info->Processor.EfficiencyClass);
+            maxEfficiency = std::max(maxEfficiency, info->Processor.EfficiencyClass);
+            break;
+        case RelationProcessorPackage:
+            ++topo.numPackages;
+            break;
+        case RelationNumaNode:
+            ++topo.numNumaNodes;
+            break;
+        case RelationCache: {
+            const CACHE_RELATIONSHIP &cache = info->Cache;
+            if (cache.Level >= 1 && cache.Level <= ISPCRT_CPU_CACHE_LEVELS && cache.Type != CacheInstruction &&
+                topo.cacheSize[cache.Level - 1] == 0) {
+                topo.cacheSize[cache.Level - 1] = cache.CacheSize;
+                topo.cacheSharing[cache.Level - 1] = popcount(cache.GroupMask.Mask);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        offset += info->Size;
+    }
+    // The performance cores have the highest efficiency class on hybrid
+    // processors, all cores have the same class otherwise.
+    if (maxEfficiency > 0) {
+        for (BYTE efficiency : coreEfficiency) {
+            if (efficiency == maxEfficiency)
+                ++topo.numPerformanceCores;
+            else
+                ++topo.numEfficiencyCores;
+        }
+    }
+
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        topo.numAvailableThreads = popcount(processMask);
+}
+#elif defined(HOST_IS_APPLE)
+static uint64_t lSysctl(const char *name) {
+    uint64_t value = 0;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0)
+        return 0;
+    // Some of the values are 32-bit.
+    return size == sizeof(uint32_t) ? (uint32_t)value : value;
+}
+
+static void lDetectTopology(ISPCRTCpuTopology &topo) {
+    topo.numPackages = (uint32_t)lSysctl("hw.packages");
+    topo.numCores = (uint32_t)lSysctl("hw.physicalcpu");
+    topo.numThreads = (uint32_t)lSysctl("hw.logicalcpu");
+    // Apple silicon reports the performance and the efficiency cores as
+    // performance levels 0 and 1.
+    if (lSysctl("hw.nperflevels") > 1) {
+        topo.numPerformanceCores = (uint32_t)lSysctl("hw.perflevel0.physicalcpu");
+        topo.numEfficiencyCores = (uint32_t)lSysctl("hw.perflevel1.physicalcpu");
+    }
+    topo.cacheSize[0] = lSysctl("hw.l1dcachesize");
+    topo.cacheSize[1] = lSysctl("hw.l2cachesize");
+    topo.cacheSize[2] = lSysctl("hw.l3cachesize");
+}
+#else
+static void lDetectTopology(ISPCRTCpuTopology &) {}
+#endif
+
+static ISPCRTCpuTopology lDetect() {
+    ISPCRTCpuTopology topo = {};
+    lDetectTopology(topo);
+
+    // Whatever is not detected falls back to the number of hardware threads
+    // reported by the standard library.
+    if (topo.numThreads == 0)
+        topo.numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (topo.numCores == 0 || topo.numCores > topo.numThreads)
+        topo.numCores = topo.numThreads;
+    if (topo.numAvailableThreads == 0 || topo.numAvailableThreads > topo.numThreads)
+        topo.numAvailableThreads = topo.numThreads;
+    topo.numPackages = std::max(topo.numPackages, 1u);
+    topo.numNumaNodes = std::max(topo.numNumaNodes, 1u);
+
+    bool amx = false;
+    ISA isa = lDetectISA(amx);
+    topo.isa = lISAName(isa, amx);
+    topo.avx512FmaUnits = lAVX512FMAUnits(isa);
+    static std::string targets = lRecommendedTargets(isa, topo.avx512FmaUnits);
+    topo.targets = targets.c_str();
+
+    // A few tasks per thread balance the load, more of them on the hybrid
+    // processors, whose cores run at different speeds.
+    bool hybrid = topo.numPerformanceCores > 0 && topo.numEfficiencyCores > 0;
+    topo.taskCount = topo.numAvailableThreads * (hybrid ? 8 : 4);
+    return topo;
+}
+
+const ISPCRTCpuTopology &topology() {
+    static const ISPCRTCpuTopology topo = lDetect();
+    return topo;
+}
+
+} // namespace cpu
+} // namespace ispcrt
@@ -0,0 +1,30 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include "../../ispcrt.h"
+
+#include <vector>
+
+// Detection of the host CPU, shared by ispcrtGetCpuTopology(), the tasking
+// runtime and the check_isa tool, so it doesn't depend on the rest of ispcrt.
+
+namespace ispcrt {
+namespace cpu {
+
+// Topology of the host CPU, detected on the first call.
+const ISPCRTCpuTopology &topology();
+
+// Parse a list of CPUs in the format of Linux cpulist files, e.g. "0-3,8".
+bool parseCPUList(const char *str, std::vector<int> &cpus);
+
+// Read the CPU to NUMA node mapping.  Returns the number of nodes.
+int readNUMANodes(std::vector<int> &cpuToNode);
+
+// Read the hardware threads of the performance and of the efficient cores.
+// Returns false if the CPU is not hybrid or the core types are unknown.
+bool readHybridCPUs(std::vector<int> &performanceCPUs, std::vector<int> &efficientCPUs);
+
+} // namespace cpu
+} // namespace ispcrt
@@ -17,6 +17,7 @@
     - Microsoft's Concurrency Runtime (ISPC_USE_CONCRT)
     - Apple's Grand Central Dispatch (ISPC_USE_GCD)
     - bare pthreads (ISPC_USE_PTHREADS, ISPC_USE_PTHREADS_FULLY_SUBSCRIBED)
+    - pthreads with work-stealing scheduler (ISPC_USE_WORK_STEALING)
     - TBB (ISPC_USE_TBB_TASK_GROUP, ISPC_USE_TBB_PARALLEL_FOR)
     - OpenMP (ISPC_USE_OMP)
     - HPX (ISPC_USE_HPX)
@@ -31,10 +32,66 @@
 #define ISPC_USE_CONCRT
 #define ISPC_USE_PTHREADS
 #define ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
+#define ISPC_USE_WORK_STEALING
 #define ISPC_USE_OMP
 #define ISPC_USE_TBB_TASK_GROUP
 #define ISPC_USE_TBB_PARALLEL_FOR
 
+  The ISPC_USE_PTHREADS model has two schedulers.  The default one keeps all
+  the launched tasks in a single queue protected by a mutex.  The
+  work-stealing one gives every thread its own Chase-Lev deque of task
+  ranges, so launching and running tasks doesn't take any locks; idle
+  threads steal the ranges from the other threads, preferring the threads on
+  the same NUMA node.  ISPC_USE_WORK_STEALING is ISPC_USE_PTHREADS with the
+  work-stealing scheduler used by default.  The scheduler can also be chosen
+  at runtime with the ISPCRT_TASK_SCHEDULER environment variable set to
+  "work-stealing" or "shared-queue".
+
+  Launches of more than MAX_RANGE_LAUNCH_RECORDS tasks are run by a few
+  records, which claim blocks of tasks from a shared counter, so launching
+  doesn't write per task data.  The number of tasks claimed at once can be
+  set with the ISPCRT_TASK_GRAIN_SIZE environment variable, which also
+  enables this mode for smaller launches.
+
+  On Linux, the worker threads of the ISPC_USE_PTHREADS model can be pinned
+  to CPUs with the ISPCRT_CPU_AFFINITY environment variable (or
+  ISPCSetAffinity_cpu() before the first launch): "compact" fills NUMA nodes
+  one after another, "scatter" distributes the threads over the nodes round
+  robin, and a list of CPUs like "0-7,16-23" runs one thread per listed CPU.
+  "performance" runs the threads on the performance cores of a hybrid CPU
+  only, which suits the kernels with wide vectors, e.g. AVX-512.
+
+  On hybrid CPUs, the cores run the tasks at different speeds, so the slowest
+  ones would determine the sync time with a static split.  There the launches
+  are split into more, smaller ranges (or blocks of range launches) and the
+  ISPC_USE_PTHREADS model uses the work-stealing scheduler by default, so the
+  faster cores take more of the work.
+
+  The shared-queue scheduler of the ISPC_USE_PTHREADS model can also run
+  several pools of worker threads, created with ISPCNewWorkerPool_cpu() for
+  the CPU sub-devices of ispcrt.  A thread launches its tasks into the pool
+  set with ISPCSetWorkerPool_cpu(), the nested tasks go to the pool of the
+  worker running them, so the launches of the pools don't share the threads
+  or the queue.  The other models support only the default pool.
+
+  Every launch has a priority (ISPCRTTaskPriority), which the thread sets
+  with ISPCSetPriority_cpu() and the nested launches inherit.  The
+  shared-queue scheduler keeps the task groups of every priority class in a
+  list of its own and the threads take the next task from the highest class
+  with any, so the tasks of a high priority launch run before the waiting
+  tasks of the lower ones, but don't interrupt the running ones.  The other
+  schedulers ignore the priority.
+
+  The thread can also direct its launches to the executor of the
+  application with ISPCSetExecutor_cpu(), e.g. the one set for the context
+  of the device, which runs the launch.
+
+  The idle worker threads of the ISPC_USE_PTHREADS model spin for a while
+  before they block, so back-to-back launches don't pay the wake-up latency.
+  The spin budget adapts to the gaps between the launches up to the maximum
+  set with the ISPCRT_TASK_SPIN_US environment variable (50 microseconds by
+  default, 0 blocks right away).
+
   The ISPC_USE_PTHREADS_FULLY_SUBSCRIBED model essentially takes over the machine
   by assigning one pthread to each hyper-thread, and then uses spinlocks and atomics
   for task management.  This model is useful for KNC where tasks can take over
@@ -50,6 +107,10 @@
 
 */
 
+#if defined(ISPC_USE_WORK_STEALING) && !defined(ISPC_USE_PTHREADS)
+#define ISPC_USE_PTHREADS
+#endif
+
 #if !(defined ISPC_USE_CONCRT || defined ISPC_USE_GCD || defined ISPC_USE_PTHREADS ||                                  \
       defined ISPC_USE_PTHREADS_FULLY_SUBSCRIBED || defined ISPC_USE_TBB_TASK_GROUP ||                                 \
       defined ISPC_USE_TBB_PARALLEL_FOR || defined ISPC_USE_OMP || defined ISPC_USE_HPX)
@@ -88,15 +149,24 @@ using namespace Concurrency;
 #endif // ISPC_USE_GCD
 #ifdef ISPC_USE_PTHREADS
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <errno.h>
 #include <fcntl.h>
+#include <mutex>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <vector>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif // __linux__
 #endif // ISPC_USE_PTHREADS
 #ifdef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 #include <algorithm>
@@ -135,17 +205,28 @@ using namespace Concurrency;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "CPUTopology.h"
 
 // Signature of ispc-generated 'task' functions
 typedef void (*TaskFuncType)(void *data, int threadIndex, int threadCount, int taskIndex, int taskCount, int taskIndex0,
                              int taskIndex1, int taskIndex2, int taskCount0, int taskCount1, int taskCount2);
 
+struct TaskRange;
+
 // Small structure used to hold the data for each task
 struct TaskInfo {
     TaskFuncType func;
     void *data;
     int taskIndex;
     int taskCount3d[3];
+    // Not null for the records of a range launch, which run the tasks
+    // claimed from the range instead of the single task taskIndex.
+    TaskRange *range;
 #if defined(ISPC_USE_CONCRT)
     event taskEvent;
 #endif
@@ -157,23 +238,75 @@ struct TaskInfo {
     int taskCount1() const { return taskCount3d[1]; }
     int taskCount2() const { return taskCount3d[2]; }
     TaskInfo() = default;
+
+    inline void Run(int threadIndex, int threadCount);
+};
+
+/* Launches of many tasks don't get a TaskInfo for every task.  Instead, a
+   few TaskInfo records share a TaskRange, and every record claims
+   grainSize tasks at a time from it until all of the tasks are claimed.
+   So the cost of the launch doesn't depend on the number of tasks.
+ */
+struct TaskRange {
+    volatile int32_t nextTaskIndex;
+    int32_t grainSize;
 };
 
+// Maximum number of TaskInfo records of a range launch.
+#define MAX_RANGE_LAUNCH_RECORDS 256
+// Number of blocks, which every record claims on average, if the grain
+// size is not set with ISPCRT_TASK_GRAIN_SIZE.
+#define RANGE_LAUNCH_BLOCKS_PER_RECORD 4
+
 // ispc expects these functions to have C linkage / not be mangled
 extern "C" {
 void ISPCLaunch_cpu(void **handlePtr, void *f, void *data, int countx, int county, int countz);
 void *ISPCAlloc_cpu(void **handlePtr, int64_t size, int32_t alignment);
 void ISPCSync_cpu(void *handle);
+void ISPCSetAffinity_cpu(int policy, const uint32_t *cores, uint32_t numCores);
+void *ISPCNewWorkerPool_cpu(int policy, const uint32_t *cores, uint32_t numCores);
+void ISPCDeleteWorkerPool_cpu(void *pool);
+void *ISPCSetWorkerPool_cpu(void *pool);
+void ISPCPinToWorkerPool_cpu(void *pool);
+const ISPCRTTaskingCallbacks *ISPCSetExecutor_cpu(const ISPCRTTaskingCallbacks *executor);
+int ISPCSetPriority_cpu(int priority);
+int ISPCGetPriority_cpu();
+}
+
+// Executor of the launches of the calling thread, nullptr for the task
+// system of this file.
+static thread_local const ISPCRTTaskingCallbacks *lExecutor = nullptr;
+
+// Priority of the launches of the calling thread.  The threads running the
+// tasks take the priority of their launch, so the nested launches inherit it.
+static thread_local int lPriority = ISPCRT_TASK_PRIORITY_NORMAL;
+
+// Number of priority classes, the highest is class 0.
+#define TASK_PRIORITY_CLASSES 3
+
+[[maybe_unused]] static inline int lPriorityClass(int priority) {
+    switch (priority) {
+    case ISPCRT_TASK_PRIORITY_HIGH:
+        return 0;
+    case ISPCRT_TASK_PRIORITY_LOW:
+        return 2;
+    default:
+        return 1;
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////
 // TaskGroupBase
 
-#define LOG_TASK_QUEUE_CHUNK_SIZE 14
-#define MAX_TASK_QUEUE_CHUNKS 128
-#define TASK_QUEUE_CHUNK_SIZE (1 << LOG_TASK_QUEUE_CHUNK_SIZE)
+// The first segment of the task storage is a part of the task group, every
+// next one is twice as large as all of the previous ones together, so
+// MAX_TASK_SEGMENTS segments cover all non-negative int task indices.
+#define LOG_FIRST_TASK_SEGMENT_SIZE 4
+#define FIRST_TASK_SEGMENT_SIZE (1 << LOG_FIRST_TASK_SEGMENT_SIZE)
+#define MAX_TASK_SEGMENTS (32 - LOG_FIRST_TASK_SEGMENT_SIZE)
 
-#define MAX_LAUNCHED_TASKS (MAX_TASK_QUEUE_CHUNKS * TASK_QUEUE_CHUNK_SIZE)
+// Number of free segments of every size kept for the reuse.
+#define MAX_FREE_TASK_SEGMENTS 4
 
 #define NUM_MEM_BUFFERS 16
 
@@ -200,12 +333,19 @@ class TaskGroupBase {
     int nextTaskInfoIndex;
 
   private:
-    /* We allocate blocks of TASK_QUEUE_CHUNK_SIZE TaskInfo structures as
-       needed by the calling function.  We hold up to MAX_TASK_QUEUE_CHUNKS
-       of these (and then exit at runtime if more than this many tasks are
-       launched.)
+    TaskInfo *AllocTaskSegment(int segment);
+
+    /* TaskInfo structures are stored in segments of growing size: the
+       first FIRST_TASK_SEGMENT_SIZE ones are in firstTaskSegment, so
+       launching a few tasks doesn't allocate, and segment i > 0 holds
+       FIRST_TASK_SEGMENT_SIZE << (i - 1) of them.  The segments are
+       allocated as needed by the launching thread and never move, so the
+       workers access the tasks without taking any locks.  They are kept
+       across Reset() and returned to a global free list when the task
+       group is destroyed.
      */
-    TaskInfo *taskInfo[MAX_TASK_QUEUE_CHUNKS];
+    TaskInfo *taskSegments[MAX_TASK_SEGMENTS];
+    TaskInfo firstTaskSegment[FIRST_TASK_SEGMENT_SIZE];
 
     /* We also allocate chunks of memory to service ISPCAlloc_cpu() calls.  The
        memBuffers[] array holds pointers to this memory.  The first element
@@ -215,7 +355,7 @@ class TaskGroupBase {
     int curMemBuffer, curMemBufferOffset;
     int memBufferSize[NUM_MEM_BUFFERS];
     char *memBuffers[NUM_MEM_BUFFERS];
-    char mem[256];
+    alignas(64) char mem[256];
 };
 
 inline TaskGroupBase::TaskGroupBase() {
@@ -230,15 +370,9 @@ inline TaskGroupBase::TaskGroupBase() {
         memBufferSize[i] = 0;
     }
 
-    for (int i = 0; i < MAX_TASK_QUEUE_CHUNKS; ++i)
-        taskInfo[i] = nullptr;
-}
-
-inline TaskGroupBase::~TaskGroupBase() {
-    // Note: don't delete memBuffers[0], since it points to the start of
-    // the "mem" member!
-    for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
-        delete[](memBuffers[i]);
+    taskSegments[0] = firstTaskSegment;
+    for (int i = 1; i < MAX_TASK_SEGMENTS; ++i)
+        taskSegments[i] = nullptr;
 }
 
 inline void TaskGroupBase::Reset() {
@@ -253,24 +387,30 @@ inline int TaskGroupBase::AllocTaskInfo(int count) {
     return ret;
 }
 
-inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
-    int chunk = (index >> LOG_TASK_QUEUE_CHUNK_SIZE);
-    int offset = index & (TASK_QUEUE_CHUNK_SIZE - 1);
-
-    if (chunk == MAX_TASK_QUEUE_CHUNKS) {
-        fprintf(stderr,
-                "A total of %d tasks have been launched from the "
-                "current function--the simple built-in task system can handle "
-                "no more. You can increase the values of TASK_QUEUE_CHUNK_SIZE "
-                "and LOG_TASK_QUEUE_CHUNK_SIZE to work around this limitation.  "
-                "Sorry!  Exiting.\n",
-                index);
-        exit(1);
-    }
+// Index of the most significant set bit of v, which must be non-zero.
+static inline int lLog2(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanReverse(&result, v);
+    return (int)result;
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
 
-    if (taskInfo[chunk] == nullptr)
-        taskInfo[chunk] = new TaskInfo[TASK_QUEUE_CHUNK_SIZE];
-    return &taskInfo[chunk][offset];
+inline TaskInfo *TaskGroupBase::GetTaskInfo(int index) {
+    if (index < FIRST_TASK_SEGMENT_SIZE)
+        return &firstTaskSegment[index];
+
+    // Segment i > 0 starts at index 1 << (i - 1 + LOG_FIRST_TASK_SEGMENT_SIZE).
+    int log2 = lLog2((uint32_t)index);
+    int segment = log2 - LOG_FIRST_TASK_SEGMENT_SIZE + 1;
+    int offset = index - (1 << log2);
+
+    TaskInfo *taskSegment = taskSegments[segment];
+    if (taskSegment == nullptr)
+        taskSegment = AllocTaskSegment(segment);
+    return &taskSegment[offset];
 }
 
 inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
@@ -288,11 +428,15 @@ inline void *TaskGroupBase::AllocMemory(int64_t size, int32_t alignment) {
     curMemBufferOffset = 0;
     assert(curMemBuffer < NUM_MEM_BUFFERS);
 
+    // The buffers are kept across Reset(), so the task groups, which are
+    // reused for the launches with the same parameter sizes, don't allocate.
     int allocSize = 1 << (12 + curMemBuffer);
     allocSize = std::max(int(size + alignment), allocSize);
-    char *newBuf = new char[allocSize];
-    memBufferSize[curMemBuffer] = allocSize;
-    memBuffers[curMemBuffer] = newBuf;
+    if (memBufferSize[curMemBuffer] < allocSize) {
+        delete[](memBuffers[curMemBuffer]);
+        memBuffers[curMemBuffer] = new char[allocSize];
+        memBufferSize[curMemBuffer] = allocSize;
+    }
     return AllocMemory(size, alignment);
 }
 
@@ -334,6 +478,85 @@ static void *lAtomicCompareAndSwapPointer(void **v, void *newValue, void *oldVal
 #endif
 }
 
+// Unlike lAtomicAdd(), returns the old value on all platforms.
+static inline int32_t lAtomicFetchAdd(volatile int32_t *v, int32_t delta) {
+#ifdef ISPC_IS_WINDOWS
+    return InterlockedExchangeAdd((volatile LONG *)v, delta);
+#else
+    return __sync_fetch_and_add(v, delta);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////
+// TaskInfo
+
+inline void TaskInfo::Run(int threadIndex, int threadCount) {
+    if (range == nullptr) {
+        func(data, threadIndex, threadCount, taskIndex, taskCount(), taskIndex0(), taskIndex1(), taskIndex2(),
+             taskCount0(), taskCount1(), taskCount2());
+        return;
+    }
+
+    int count = taskCount();
+    int grainSize = range->grainSize;
+    // Check before claiming, so the counter doesn't keep growing past the
+    // end of the range.
+    while (range->nextTaskIndex < count) {
+        int begin = lAtomicFetchAdd(&range->nextTaskIndex, grainSize);
+        if (begin >= count)
+            break;
+        int end = std::min(count, begin + grainSize);
+        for (int i = begin; i < end; ++i) {
+            func(data, threadIndex, threadCount, i, count, i % taskCount3d[0], (i / taskCount3d[0]) % taskCount3d[1],
+                 i / (taskCount3d[0] * taskCount3d[1]), taskCount3d[0], taskCount3d[1], taskCount3d[2]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////
+// TaskGroupBase task storage
+
+static TaskInfo *freeTaskSegments[MAX_TASK_SEGMENTS][MAX_FREE_TASK_SEGMENTS];
+
+inline TaskInfo *TaskGroupBase::AllocTaskSegment(int segment) {
+    for (int i = 0; i < MAX_FREE_TASK_SEGMENTS; ++i) {
+        TaskInfo *ts = freeTaskSegments[segment][i];
+        if (ts != nullptr) {
+            // The swap returns the previous value of the slot: it took the
+            // segment only if that's still the one read above.
+            void *ptr = lAtomicCompareAndSwapPointer((void **)(&freeTaskSegments[segment][i]), nullptr, ts);
+            if (ptr == ts) {
+                taskSegments[segment] = (TaskInfo *)ptr;
+                return taskSegments[segment];
+            }
+        }
+    }
+
+    taskSegments[segment] = new TaskInfo[FIRST_TASK_SEGMENT_SIZE << (segment - 1)];
+    return taskSegments[segment];
+}
+
+inline TaskGroupBase::~TaskGroupBase() {
+    // Note: don't delete memBuffers[0], since it points to the start of
+    // the "mem" member!
+    for (int i = 1; i < NUM_MEM_BUFFERS; ++i)
+        delete[](memBuffers[i]);
+
+    // Same for taskSegments[0], which is firstTaskSegment.
+    for (int segment = 1; segment < MAX_TASK_SEGMENTS; ++segment) {
+        TaskInfo *ts = taskSegments[segment];
+        if (ts == nullptr)
+            continue;
+        bool freed = false;
+        for (int i = 0; i < MAX_FREE_TASK_SEGMENTS && !freed; ++i) {
+            if (freeTaskSegments[segment][i] == nullptr)
+                freed = lAtomicCompareAndSwapPointer((void **)&freeTaskSegments[segment][i], ts, nullptr) == nullptr;
+        }
+        if (!freed)
+            delete[] ts;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 #ifdef ISPC_USE_CONCRT
@@ -371,6 +594,7 @@ class TaskGroup : public TaskGroupBase {
         numUnfinishedTasks = 0;
         waitingTasks.reserve(128);
         inActiveList = false;
+        priority = ISPCRT_TASK_PRIORITY_NORMAL;
     }
 
     void Reset() {
@@ -385,11 +609,18 @@ class TaskGroup : public TaskGroupBase {
 
   private:
     friend void *lTaskEntry(void *arg);
+    friend class WorkStealingScheduler;
+
+    void LaunchWorkStealing(int baseIndex, int count);
+    void SyncWorkStealing();
+    void RunTasks(int begin, int end, int threadIndex, int threadCount);
 
     int32_t numUnfinishedTasks;
     int32_t pad[3];
     std::vector<int> waitingTasks;
     bool inActiveList;
+    // Priority of the launches, ISPCRTTaskPriority.
+    int priority;
 };
 
 #endif // ISPC_USE_PTHREADS
@@ -441,6 +672,54 @@ class TaskGroup : public TaskGroupBase {
 #endif // ISPC_USE_HPX
 
 ///////////////////////////////////////////////////////////////////////////
+// Thread affinity
+
+// The same values as ISPCRTCpuAffinity in ispcrt.h.
+enum AffinityPolicy { AFFINITY_NONE = 0, AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_EXPLICIT, AFFINITY_PERFORMANCE };
+
+// Set with ISPCSetAffinity_cpu() or ISPCRT_CPU_AFFINITY environment variable
+// and used when the worker threads are started.  Only the pthreads model
+// pins its threads, the other models manage their threads themselves.
+static int affinityPolicy = -1;
+static std::vector<int> affinityCores;
+
+[[maybe_unused]] static void lInitAffinityPolicy() {
+    if (affinityPolicy >= 0)
+        return;
+
+    affinityPolicy = AFFINITY_NONE;
+    const char *env = getenv("ISPCRT_CPU_AFFINITY");
+    if (env == nullptr || *env == '\0' || !strcmp(env, "none"))
+        return;
+    if (!strcmp(env, "compact"))
+        affinityPolicy = AFFINITY_COMPACT;
+    else if (!strcmp(env, "scatter"))
+        affinityPolicy = AFFINITY_SCATTER;
+    else if (!strcmp(env, "performance"))
+        affinityPolicy = AFFINITY_PERFORMANCE;
+    else if (ispcrt::cpu::parseCPUList(env, affinityCores) && !affinityCores.empty())
+        affinityPolicy = AFFINITY_EXPLICIT;
+    else {
+        affinityCores.clear();
+        fprintf(stderr,
+                "Unknown ISPCRT_CPU_AFFINITY value \"%s\", "
+                "expected \"none\", \"compact\", \"scatter\", \"performance\" or a list of CPUs.\n",
+                env);
+    }
+}
+
+// Whether the worker threads run on the cores of different speeds, i.e. the
+// CPU is hybrid and the threads are not restricted to the performance cores.
+[[maybe_unused]] static bool lIsHybridHost() {
+    lInitAffinityPolicy();
+    const ISPCRTCpuTopology &topo = ispcrt::cpu::topology();
+    return topo.numPerformanceCores > 0 && topo.numEfficiencyCores > 0 && affinityPolicy != AFFINITY_PERFORMANCE;
+}
+
+// The launches are split into this many times more pieces on hybrid CPUs.
+#define HYBRID_SPLIT_FACTOR 4
+
+[[maybe_unused]] static int lSplitFactor() { return lIsHybridHost() ? HYBRID_SPLIT_FACTOR : 1; }
 
 ///////////////////////////////////////////////////////////////////////////
 // Grand Central Dispatch
@@ -478,9 +757,7 @@ static void lRunTask(void *ti) {
     int threadCount = 1;
 
     // Actually run the task
-    taskInfo->func(taskInfo->data, threadIndex, threadCount, taskInfo->taskIndex, taskInfo->taskCount(),
-                   taskInfo->taskIndex0(), taskInfo->taskIndex1(), taskInfo->taskIndex2(), taskInfo->taskCount0(),
-                   taskInfo->taskCount1(), taskInfo->taskCount2());
+    taskInfo->Run(threadIndex, threadCount);
 }
 
 inline void TaskGroup::Launch(int baseIndex, int count) {
@@ -512,8 +789,7 @@ static void __cdecl lRunTask(LPVOID param) {
     // will cause bugs in code that uses those.
     int threadIndex = 0;
     int threadCount = 1;
-    ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(), ti->taskIndex1(),
-             ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+    ti->Run(threadIndex, threadCount);
 
     // Signal the event that this task is done
     ti->taskEvent.set();
@@ -541,26 +817,278 @@ inline void TaskGroup::Sync() {
 
 static volatile int32_t lock = 0;
 
-static int nThreads;
-static pthread_t *threads = nullptr;
+/* Worker threads, which run the tasks of the shared queue.  The default
+   pool is started on the first launch and placed by the affinity policy,
+   the pools of CPU sub-devices are started when they are created.
+ */
+struct WorkerPool {
+    int nThreads = 0;
+    std::vector<pthread_t> threads;
+    volatile bool started = false;
+    // Set when the pool is deleted, the workers exit when they see it.
+    volatile bool stop = false;
+
+    pthread_mutex_t taskSysMutex;
+    // Task groups with waiting tasks of every priority class.
+    std::vector<TaskGroup *> activeTaskGroups[TASK_PRIORITY_CLASSES];
+    sem_t *workerSemaphore = nullptr;
+
+    // CPU of every worker thread, empty if the threads are not pinned.
+    std::vector<int> workerCPUs;
+    // All CPUs of the pool, empty if the threads are not pinned.
+    std::vector<int> cpus;
+};
 
-static pthread_mutex_t taskSysMutex;
-static std::vector<TaskGroup *> activeTaskGroups;
-static sem_t *workerSemaphore;
+// The active task groups of the highest priority class, which has any, or
+// nullptr.  Called with taskSysMutex held.
+static std::vector<TaskGroup *> *lHighestActive(WorkerPool &pool) {
+    for (std::vector<TaskGroup *> &groups : pool.activeTaskGroups) {
+        if (!groups.empty())
+            return &groups;
+    }
+    return nullptr;
+}
+
+static WorkerPool defaultPool;
+
+// Pool, which the calling thread launches the tasks into, nullptr for the
+// default pool.  Workers run the nested tasks in their own pool.
+static thread_local WorkerPool *lCurrentPool = nullptr;
+
+static inline WorkerPool *lPool() { return lCurrentPool != nullptr ? lCurrentPool : &defaultPool; }
+
+/* Choose CPUs for the worker threads according to the affinity policy.
+   Worker i gets the (i + 1)-th CPU of the policy order, as the first one is
+   left for the thread, which launches the tasks.  With an explicit list of
+   CPUs, there is one thread per CPU in the list, with the performance
+   policy, one per hardware thread of the performance cores.
+ */
+static void lInitWorkerCPUs(WorkerPool &pool, int policy, const std::vector<int> &cores) {
+    int &numWorkers = pool.nThreads;
+    if (policy == AFFINITY_NONE)
+        return;
+
+#ifdef __linux__
+    std::vector<int> order;
+    if (policy == AFFINITY_EXPLICIT) {
+        order = cores;
+        numWorkers = std::max((int)order.size() - 1, 0);
+    } else {
+        // Only the CPUs, which the process is allowed to run on.
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return;
+        std::vector<int> performanceCPUs, efficientCPUs;
+        if (policy == AFFINITY_PERFORMANCE && ispcrt::cpu::readHybridCPUs(performanceCPUs, efficientCPUs)) {
+            for (int cpu : efficientCPUs) {
+                if (cpu < CPU_SETSIZE)
+                    CPU_CLR(cpu, &allowed);
+            }
+            numWorkers = std::max(CPU_COUNT(&allowed) - 1, 0);
+        }
+        std::vector<int> cpuToNode;
+        int numNodes = ispcrt::cpu::readNUMANodes(cpuToNode);
+        std::vector<std::vector<int>> nodeCPUs(numNodes);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                int node = cpu < (int)cpuToNode.size() ? cpuToNode[cpu] : 0;
+                nodeCPUs[node].push_back(cpu);
+            }
+        }
+        if (policy != AFFINITY_SCATTER) {
+            // Fill one node after another.
+            for (const std::vector<int> &cpus : nodeCPUs)
+                order.insert(order.end(), cpus.begin(), cpus.end());
+        } else {
+            // Round robin over the nodes.
+            for (size_t i = 0; order.size() < (size_t)CPU_COUNT(&allowed); ++i) {
+                for (const std::vector<int> &cpus : nodeCPUs) {
+                    if (i < cpus.size())
+                        order.push_back(cpus[i]);
+                }
+            }
+        }
+    }
+    if (order.empty())
+        return;
+    pool.cpus = order;
+    pool.workerCPUs.resize(numWorkers);
+    for (int i = 0; i < numWorkers; ++i)
+        pool.workerCPUs[i] = order[(i + 1) % order.size()];
+#else
+    fprintf(stderr, "Thread affinity is not supported on this platform, ignoring it.\n");
+#endif // __linux__
+}
+
+static void lPinWorkerThread([[maybe_unused]] const WorkerPool &pool, [[maybe_unused]] int worker) {
+#ifdef __linux__
+    const std::vector<int> &workerCPUs = pool.workerCPUs;
+    if (worker >= (int)workerCPUs.size() || workerCPUs[worker] >= CPU_SETSIZE)
+        return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(workerCPUs[worker], &cpus);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0)
+        fprintf(stderr, "Error pinning thread %d to CPU %d: %s\n", worker, workerCPUs[worker], strerror(err));
+#endif // __linux__
+}
+
+// Restrict the calling thread, which launches the tasks into the pool, to
+// the CPUs of the pool.
+static void lPinToPool([[maybe_unused]] const WorkerPool &pool) {
+#ifdef __linux__
+    if (pool.cpus.empty())
+        return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : pool.cpus) {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpus);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0)
+        fprintf(stderr, "Error pinning thread to the CPUs of the pool: %s\n", strerror(err));
+#endif // __linux__
+}
+
+///////////////////////////////////////////////////////////////////////////
+// pthreads: idle waiting
+
+#define SPIN_DEFAULT_US 50
+#define SPIN_MAX_US 1000000
+// The budget doesn't shrink below it, so it can grow back.
+#define SPIN_MIN_NS 1000
+
+// Maximum of the spin budget in nanoseconds, -1 if not initialized yet.
+static int64_t spinMaxNs = -1;
+
+// Called before any pool is started, by every pool.
+static void lInitSpinBudget() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        spinMaxNs = int64_t(SPIN_DEFAULT_US) * 1000;
+        const char *env = getenv("ISPCRT_TASK_SPIN_US");
+        if (env == nullptr || *env == '\0')
+            return;
+        char *end;
+        long us = strtol(env, &end, 10);
+        if (*end != '\0' || us < 0 || us > SPIN_MAX_US) {
+            fprintf(stderr,
+                    "Unknown ISPCRT_TASK_SPIN_US value \"%s\", "
+                    "expected a number of microseconds from 0 to %d.\n",
+                    env, SPIN_MAX_US);
+            return;
+        }
+        spinMaxNs = int64_t(us) * 1000;
+    });
+}
+
+static inline void lCpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/* Spin-then-block waiting of an idle thread.  The thread polls for the work
+   for the spin budget and then blocks.  The budget adapts to the gaps
+   between the launches: if the thread is woken up soon after it blocked,
+   spinning a bit longer would have caught the work, so the budget doubles;
+   if it stayed blocked longer than the maximum budget, the budget halves,
+   so the threads of an idle process stop burning cores.
+ */
+class SpinBudget {
+  public:
+    SpinBudget() : budgetNs(spinMaxNs) {}
+
+    // Poll tryWork() until it returns true or the budget is spent.
+    template <typename F> bool Spin(F tryWork) {
+        if (budgetNs <= 0)
+            return false;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 1;; ++i) {
+            if (tryWork())
+                return true;
+            lCpuRelax();
+            // Don't read the clock on every iteration.
+            if ((i & 15) == 0 && std::chrono::steady_clock::now() - start > std::chrono::nanoseconds(budgetNs))
+                return false;
+        }
+    }
+
+    // Block in wait() and adapt the budget to the time it took.
+    template <typename F> void Block(F wait) {
+        auto start = std::chrono::steady_clock::now();
+        wait();
+        auto blocked = std::chrono::steady_clock::now() - start;
+        if (blocked <= std::chrono::nanoseconds(spinMaxNs))
+            budgetNs = std::min(std::max(budgetNs * 2, int64_t(SPIN_MIN_NS)), spinMaxNs);
+        else
+            budgetNs = std::max(budgetNs / 2, std::min(int64_t(SPIN_MIN_NS), spinMaxNs));
+    }
+
+  private:
+    int64_t budgetNs;
+};
+
+// Block while *word == value.  Spurious returns are possible, so the caller
+// rechecks the condition.
+[[maybe_unused]] static void lFutexWait(std::atomic<unsigned int> *word, unsigned int value) {
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<unsigned int>) == sizeof(int), "futex word must be 32 bits");
+    syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#endif // __linux__
+}
+
+[[maybe_unused]] static void lFutexWake(std::atomic<unsigned int> *word, int count) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#endif // __linux__
+}
+
+// Index of the calling thread, which is passed to the tasks: the workers
+// are threads 1..nThreads and the threads, which launch the tasks, are 0, as
+// in the work-stealing scheduler.
+static thread_local int lThreadIndex = 0;
+
+// Argument of the entry functions of the worker threads.
+struct WorkerStart {
+    WorkerPool *pool;
+    int worker;
+};
 
 static void *lTaskEntry(void *arg) {
-    int threadIndex = (int)((int64_t)arg);
-    int threadCount = nThreads;
+    WorkerStart start = *(WorkerStart *)arg;
+    delete (WorkerStart *)arg;
+    WorkerPool *pool = start.pool;
+    lPinWorkerThread(*pool, start.worker);
+    int threadIndex = start.worker + 1;
+    int threadCount = pool->nThreads + 1;
+    lThreadIndex = threadIndex;
+    lCurrentPool = pool;
+    sem_t *workerSemaphore = pool->workerSemaphore;
+    pthread_mutex_t &taskSysMutex = pool->taskSysMutex;
+    SpinBudget spinBudget;
 
     while (1) {
         int err;
         //
         // Wait on the semaphore until we're woken up due to the arrival of
-        // more work.
+        // more work, spinning on it first.  The semaphore blocks on a futex
+        // on Linux.
         //
-        if ((err = sem_wait(workerSemaphore)) != 0) {
-            fprintf(stderr, "Error from sem_wait: %s\n", strerror(err));
-            exit(1);
+        if (!spinBudget.Spin([workerSemaphore] { return sem_trywait(workerSemaphore) == 0; })) {
+            spinBudget.Block([workerSemaphore] {
+                while (sem_wait(workerSemaphore) != 0) {
+                    if (errno != EINTR) {
+                        fprintf(stderr, "Error from sem_wait: %s\n", strerror(errno));
+                        exit(1);
+                    }
+                }
+            });
         }
 
         //
@@ -571,7 +1099,13 @@ static void *lTaskEntry(void *arg) {
             exit(1);
         }
 
-        if (activeTaskGroups.size() == 0) {
+        if (pool->stop) {
+            pthread_mutex_unlock(&taskSysMutex);
+            break;
+        }
+
+        std::vector<TaskGroup *> *activeTaskGroups = lHighestActive(*pool);
+        if (activeTaskGroups == nullptr) {
             //
             // Task queue is empty, go back and wait on the semaphore
             //
@@ -583,10 +1117,10 @@ static void *lTaskEntry(void *arg) {
         }
 
         //
-        // Get the last task group on the active list and the last task
-        // from its waiting tasks list.
+        // Get the last task group on the active list of the highest
+        // priority and the last task from its waiting tasks list.
         //
-        TaskGroup *tg = activeTaskGroups.back();
+        TaskGroup *tg = activeTaskGroups->back();
         assert(tg->waitingTasks.size() > 0);
         int taskNumber = tg->waitingTasks.back();
         tg->waitingTasks.pop_back();
@@ -594,7 +1128,7 @@ static void *lTaskEntry(void *arg) {
         if (tg->waitingTasks.size() == 0) {
             // We just took the last task from this task group, so remove
             // it from the active list.
-            activeTaskGroups.pop_back();
+            activeTaskGroups->pop_back();
             tg->inActiveList = false;
         }
 
@@ -608,9 +1142,8 @@ static void *lTaskEntry(void *arg) {
         //
         DBG(fprintf(stderr, "running task %d from group %p\n", taskNumber, tg));
         TaskInfo *myTask = tg->GetTaskInfo(taskNumber);
-        myTask->func(myTask->data, threadIndex, threadCount, myTask->taskIndex, myTask->taskCount(),
-                     myTask->taskIndex0(), myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(),
-                     myTask->taskCount1(), myTask->taskCount2());
+        lPriority = tg->priority;
+        myTask->Run(threadIndex, threadCount);
 
         //
         // Decrement the "number of unfinished tasks" counter in the task
@@ -624,58 +1157,520 @@ static void *lTaskEntry(void *arg) {
     return 0;
 }
 
-static void InitTaskSystem() {
-    if (threads == nullptr) {
-        while (1) {
-            if (lAtomicCompareAndSwap32(&lock, 1, 0) == 0) {
-                if (threads == nullptr) {
-                    // We launch one fewer thread than there are cores,
-                    // since the main thread here will also grab jobs from
-                    // the task queue itself.
-                    nThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
-
-                    int err;
-                    if ((err = pthread_mutex_init(&taskSysMutex, nullptr)) != 0) {
-                        fprintf(stderr, "Error creating mutex: %s\n", strerror(err));
-                        exit(1);
-                    }
+///////////////////////////////////////////////////////////////////////////
+// pthreads: work-stealing scheduler
+
+// Contiguous range [begin, end) of the task indices of a task group.
+struct WSRange {
+    TaskGroup *tg;
+    int begin, end;
+    // Ranges larger than the grain are split before running.
+    int grain;
+    // Link in the free list of the thread.
+    WSRange *next;
+};
 
-                    constexpr std::size_t SEM_NAME_MAX_SIZE{1024UL};
-                    char semaphoreName[SEM_NAME_MAX_SIZE];
-                    bool success = false;
-                    srand(time(nullptr));
-                    for (int i = 0; i < 10; i++) {
-                        // Some platforms (e.g. FreeBSD) require the name to begin with a slash
-                        snprintf(semaphoreName, SEM_NAME_MAX_SIZE, "/ispc_task.%d.%d", static_cast<int>(getpid()),
-                                 static_cast<int>(rand()));
-                        workerSemaphore = sem_open(semaphoreName, O_CREAT, S_IRUSR | S_IWUSR, 0);
-                        if (workerSemaphore != SEM_FAILED) {
-                            success = true;
-                            break;
-                        }
-                        fprintf(stderr, "Failed to create %s\n", semaphoreName);
-                    }
+/* Chase-Lev work-stealing deque, as described in "Correct and Efficient
+   Work-Stealing for Weak Memory Models" by N. M. Le et al.  The owner
+   thread pushes and pops ranges at the bottom, the other threads steal
+   them from the top.
+ */
+class WSDeque {
+  public:
+    WSDeque() : top(0), bottom(0), array(new Array(8)) {}
+
+    // Only the owner thread may call Push() and Pop().
+    void Push(WSRange *r) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->Size() - 1) {
+            a = Grow(a, t, b);
+        }
+        a->Put(b, r);
+        bottom.store(b + 1, std::memory_order_release);
+    }
 
-                    if (!success) {
-                        fprintf(stderr, "Error creating semaphore (%s): %s\n", semaphoreName, strerror(errno));
-                        exit(1);
-                    }
+    WSRange *Pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array *a = array.load(std::memory_order_relaxed);
+        // The store of bottom must be ordered before the load of top, which
+        // is where the original algorithm uses a full fence.
+        bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            // Empty.
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        WSRange *r = a->Get(b);
+        if (t == b) {
+            // The last element, race with the thieves for it.
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                r = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return r;
+    }
 
-                    threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
-                    if (threads == nullptr) {
-                        fprintf(stderr, "Error creating pthreads: %s\n", strerror(err));
-                        exit(1);
-                    }
+    WSRange *Steal() {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b) {
+            return nullptr;
+        }
+        Array *a = array.load(std::memory_order_acquire);
+        WSRange *r = a->Get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            // Lost the race with another thief or with the owner.
+            return nullptr;
+        }
+        return r;
+    }
 
-                    for (int i = 0; i < nThreads; ++i) {
-                        err = pthread_create(&threads[i], nullptr, &lTaskEntry, (void *)((long long)i));
-                        if (err != 0) {
-                            fprintf(stderr, "Error creating pthread %d: %s\n", i, strerror(err));
-                            exit(1);
-                        }
-                    }
+  private:
+    struct Array {
+        explicit Array(int logSize) : logSize(logSize), buffer(new std::atomic<WSRange *>[size_t(1) << logSize]) {}
+        ~Array() { delete[] buffer; }
+        int64_t Size() const { return int64_t(1) << logSize; }
+        WSRange *Get(int64_t i) const { return buffer[i & (Size() - 1)].load(std::memory_order_relaxed); }
+        void Put(int64_t i, WSRange *r) { buffer[i & (Size() - 1)].store(r, std::memory_order_relaxed); }
+
+        int logSize;
+        std::atomic<WSRange *> *buffer;
+    };
+
+    Array *Grow(Array *a, int64_t t, int64_t b) {
+        Array *newArray = new Array(a->logSize + 1);
+        for (int64_t i = t; i < b; ++i) {
+            newArray->Put(i, a->Get(i));
+        }
+        // Thieves may still read from the old array, so it is never freed.
+        // Deques live as long as the process and grow rarely.
+        retired.push_back(a);
+        array.store(newArray, std::memory_order_release);
+        return newArray;
+    }
+
+    // top and bottom are written by different threads, keep them on
+    // different cache lines.
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Array *> array;
+    std::vector<Array *> retired;
+};
+
+// Every thread, which launches or runs tasks, is a participant of the
+// work-stealing scheduler with its own deque.
+struct WSParticipant {
+    WSDeque deque;
+    // Index passed to the tasks as threadIndex.
+    int threadIndex;
+    // NUMA node of the thread, which is used for the victim selection.
+    std::atomic<int> node;
+    unsigned int random;
+    // Free ranges, which are reused to avoid allocations.
+    WSRange *freeRanges;
+    // Cleared when the thread exits, so the next thread, which registers,
+    // takes over the participant and its slot.
+    std::atomic<bool> inUse;
+};
+
+#define WS_MAX_PARTICIPANTS 1024
+
+class WorkStealingScheduler {
+  public:
+    static void Init(int numWorkers);
+    static void *WorkerEntry(void *arg);
+    static void Launch(TaskGroup *tg, int baseIndex, int count);
+    static void Sync(TaskGroup *tg);
+
+  private:
+    static WSParticipant *Self();
+    static WSParticipant *Register(int threadIndex);
+    static int GetCurrentNode();
+    static WSRange *AllocRange(WSParticipant *p, TaskGroup *tg, int begin, int end, int grain);
+    static void FreeRange(WSParticipant *p, WSRange *r);
+    static WSRange *Steal(WSParticipant *p);
+    static bool RunOne(WSParticipant *p);
+    static void Execute(WSParticipant *p, WSRange *r);
+    static void Wake();
+    static void Idle(unsigned int e);
+
+    static std::atomic<WSParticipant *> participants[WS_MAX_PARTICIPANTS];
+    static std::atomic<int> numParticipants;
+    static int numWorkers;
+    static std::vector<int> cpuToNode;
+    static int numNodes;
+
+    // Sleeping workers are woken up when epoch changes.  They wait on it
+    // with a futex on Linux and on the condition variable elsewhere.
+    static std::atomic<unsigned int> epoch;
+    static std::atomic<int> numSleeping;
+    // Never destroyed, as the workers may still wait on them at exit.
+    static std::mutex *sleepMutex;
+    static std::condition_variable *sleepCondition;
+
+    // Releases the participant of the thread when the thread exits.  The
+    // participant isn't freed, as the thieves may still look at its deque,
+    // which is empty by then, since the thread has synced all its tasks.
+    struct ThreadParticipant {
+        WSParticipant *participant{nullptr};
+        ~ThreadParticipant() {
+            if (participant != nullptr) {
+                participant->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local ThreadParticipant self;
+};
+
+std::atomic<WSParticipant *> WorkStealingScheduler::participants[WS_MAX_PARTICIPANTS];
+std::atomic<int> WorkStealingScheduler::numParticipants{0};
+int WorkStealingScheduler::numWorkers = 0;
+std::vector<int> WorkStealingScheduler::cpuToNode;
+int WorkStealingScheduler::numNodes = 1;
+std::atomic<unsigned int> WorkStealingScheduler::epoch{0};
+std::atomic<int> WorkStealingScheduler::numSleeping{0};
+std::mutex *WorkStealingScheduler::sleepMutex = nullptr;
+std::condition_variable *WorkStealingScheduler::sleepCondition = nullptr;
+thread_local WorkStealingScheduler::ThreadParticipant WorkStealingScheduler::self;
+
+void WorkStealingScheduler::Init(int nWorkers) {
+    numWorkers = nWorkers;
+    sleepMutex = new std::mutex;
+    sleepCondition = new std::condition_variable;
+    numNodes = ispcrt::cpu::readNUMANodes(cpuToNode);
+}
+
+int WorkStealingScheduler::GetCurrentNode() {
+#if defined(ISPC_IS_LINUX) && defined(__GLIBC__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < (int)cpuToNode.size()) {
+        return cpuToNode[cpu];
+    }
+#endif
+    return 0;
+}
+
+WSParticipant *WorkStealingScheduler::Register(int threadIndex) {
+    // Take over the participant of a thread, which has exited, if there is
+    // one, so the slots aren't used up by the short-lived threads.
+    WSParticipant *p = nullptr;
+    int n = std::min(numParticipants.load(std::memory_order_acquire), WS_MAX_PARTICIPANTS);
+    for (int i = 0; i < n && p == nullptr; ++i) {
+        WSParticipant *q = participants[i].load(std::memory_order_acquire);
+        bool inUse = false;
+        if (q != nullptr && q->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+            p = q;
+        }
+    }
+    if (p == nullptr) {
+        if (numParticipants.load(std::memory_order_relaxed) >= WS_MAX_PARTICIPANTS) {
+            return nullptr;
+        }
+        int index = numParticipants.fetch_add(1);
+        if (index >= WS_MAX_PARTICIPANTS) {
+            return nullptr;
+        }
+        p = new WSParticipant;
+        p->random = 2654435761u * (index + 1);
+        p->freeRanges = nullptr;
+        p->inUse.store(true, std::memory_order_relaxed);
+        participants[index].store(p, std::memory_order_release);
+    }
+    p->threadIndex = threadIndex;
+    p->node.store(GetCurrentNode(), std::memory_order_relaxed);
+    self.participant = p;
+    return p;
+}
+
+WSParticipant *WorkStealingScheduler::Self() {
+    if (self.participant == nullptr) {
+        // The threads, which are not the workers, run the tasks as thread 0
+        // as in the shared queue scheduler.
+        Register(0);
+    }
+    return self.participant;
+}
+
+WSRange *WorkStealingScheduler::AllocRange(WSParticipant *p, TaskGroup *tg, int begin, int end, int grain) {
+    WSRange *r = p->freeRanges;
+    if (r != nullptr) {
+        p->freeRanges = r->next;
+    } else {
+        r = new WSRange;
+    }
+    r->tg = tg;
+    r->begin = begin;
+    r->end = end;
+    r->grain = grain;
+    r->next = nullptr;
+    return r;
+}
+
+void WorkStealingScheduler::FreeRange(WSParticipant *p, WSRange *r) {
+    r->next = p->freeRanges;
+    p->freeRanges = r;
+}
+
+WSRange *WorkStealingScheduler::Steal(WSParticipant *p) {
+    int n = std::min(numParticipants.load(std::memory_order_acquire), WS_MAX_PARTICIPANTS);
+    if (n <= 1) {
+        return nullptr;
+    }
+    // Start from a random victim, so thieves don't all hit the same deque.
+    p->random = p->random * 1103515245u + 12345u;
+    int start = (p->random >> 8) % n;
+    // Try the victims on the same NUMA node first, their ranges are likely
+    // to work on the data in the local memory.
+    int node = p->node.load(std::memory_order_relaxed);
+    for (int round = (numNodes > 1) ? 0 : 1; round < 2; ++round) {
+        for (int k = 0; k < n; ++k) {
+            WSParticipant *victim = participants[(start + k) % n].load(std::memory_order_acquire);
+            if (victim == nullptr || victim == p) {
+                continue;
+            }
+            if (round == 0 && victim->node.load(std::memory_order_relaxed) != node) {
+                continue;
+            }
+            if (WSRange *r = victim->deque.Steal()) {
+                return r;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void WorkStealingScheduler::Execute(WSParticipant *p, WSRange *r) {
+    // Split the range in halves, leaving the upper halves to the thieves,
+    // until it is small enough to run.
+    while (r->end - r->begin > r->grain) {
+        int mid = r->begin + (r->end - r->begin) / 2;
+        p->deque.Push(AllocRange(p, r->tg, mid, r->end, r->grain));
+        Wake();
+        r->end = mid;
+    }
+    TaskGroup *tg = r->tg;
+    int count = r->end - r->begin;
+    tg->RunTasks(r->begin, r->end, p->threadIndex, numWorkers + 1);
+    FreeRange(p, r);
+    lAtomicAdd(&tg->numUnfinishedTasks, -count);
+}
+
+bool WorkStealingScheduler::RunOne(WSParticipant *p) {
+    WSRange *r = p->deque.Pop();
+    if (r == nullptr) {
+        r = Steal(p);
+    }
+    if (r == nullptr) {
+        return false;
+    }
+    Execute(p, r);
+    return true;
+}
+
+void WorkStealingScheduler::Wake() {
+    epoch.fetch_add(1);
+    if (numSleeping.load() > 0) {
+#ifdef __linux__
+        // The futex compares the epoch atomically with going to sleep.
+        lFutexWake(&epoch, 1);
+#else
+        // Taking the lock guarantees that the worker either is already
+        // waiting or sees the new epoch before it starts to wait.
+        { std::lock_guard<std::mutex> lock(*sleepMutex); }
+        sleepCondition->notify_one();
+#endif // __linux__
+    }
+}
+
+// Sleep until the epoch changes from e.
+void WorkStealingScheduler::Idle(unsigned int e) {
+    numSleeping.fetch_add(1);
+#ifdef __linux__
+    while (epoch.load() == e)
+        lFutexWait(&epoch, e);
+#else
+    {
+        std::unique_lock<std::mutex> lock(*sleepMutex);
+        sleepCondition->wait(lock, [e] { return epoch.load() != e; });
+    }
+#endif // __linux__
+    numSleeping.fetch_sub(1);
+}
+
+void *WorkStealingScheduler::WorkerEntry(void *arg) {
+    // Workers are threads 1..numWorkers, thread 0 is the thread, which
+    // launches the tasks.
+    int worker = ((WorkerStart *)arg)->worker;
+    delete (WorkerStart *)arg;
+    // Pin the thread before the registration, which records its NUMA node.
+    lPinWorkerThread(defaultPool, worker);
+    WSParticipant *p = Register(worker + 1);
+    if (p == nullptr) {
+        return nullptr;
+    }
+    SpinBudget spinBudget;
+    while (1) {
+        if (RunOne(p) || spinBudget.Spin([p] { return RunOne(p); }))
+            continue;
+        // No work for a while, go to sleep until new ranges are pushed.  The
+        // epoch is read before the last attempt, so the ranges pushed after
+        // it wake the thread up.  A failed steal may be a lost race, so one
+        // more attempt is made after the wake up.
+        unsigned int e = epoch.load();
+        if (RunOne(p))
+            continue;
+        spinBudget.Block([e] { Idle(e); });
+    }
+    return nullptr;
+}
+
+void WorkStealingScheduler::Launch(TaskGroup *tg, int baseIndex, int count) {
+    lAtomicAdd(&tg->numUnfinishedTasks, count);
+    WSParticipant *p = Self();
+    if (p == nullptr) {
+        // Out of participant slots: run the tasks right away.
+        tg->RunTasks(baseIndex, baseIndex + count, 0, numWorkers + 1);
+        lAtomicAdd(&tg->numUnfinishedTasks, -count);
+        return;
+    }
+    // Split the launch into a few ranges per thread, which is enough for
+    // the load balancing and keeps the overhead low for small tasks.
+    int grain = std::max(1, count / (4 * lSplitFactor() * (numWorkers + 1)));
+    p->deque.Push(AllocRange(p, tg, baseIndex, baseIndex + count, grain));
+    Wake();
+}
+
+void WorkStealingScheduler::Sync(TaskGroup *tg) {
+    WSParticipant *p = Self();
+    while (tg->numUnfinishedTasks > 0) {
+        // Help to run the tasks while waiting.
+        if (p == nullptr || !RunOne(p)) {
+            sched_yield();
+        }
+    }
+    lMemFence();
+}
+
+inline void TaskGroup::RunTasks(int begin, int end, int threadIndex, int threadCount) {
+    for (int i = begin; i < end; ++i) {
+        TaskInfo *myTask = GetTaskInfo(i);
+        myTask->Run(threadIndex, threadCount);
+    }
+}
+
+inline void TaskGroup::LaunchWorkStealing(int baseIndex, int count) {
+    WorkStealingScheduler::Launch(this, baseIndex, count);
+}
+
+inline void TaskGroup::SyncWorkStealing() { WorkStealingScheduler::Sync(this); }
+
+static bool useWorkStealing = false;
+
+// Choose the scheduler: ISPCRT_TASK_SCHEDULER environment variable takes
+// precedence over the build time default, which is work-stealing on hybrid
+// CPUs.
+static bool lUseWorkStealing() {
+    const char *scheduler = getenv("ISPCRT_TASK_SCHEDULER");
+    if (scheduler != nullptr && *scheduler != '\0') {
+        if (!strcmp(scheduler, "work-stealing")) {
+            return true;
+        }
+        if (!strcmp(scheduler, "shared-queue")) {
+            return false;
+        }
+        fprintf(stderr,
+                "Unknown ISPCRT_TASK_SCHEDULER value \"%s\", "
+                "expected \"work-stealing\" or \"shared-queue\".\n",
+                scheduler);
+    }
+#ifdef ISPC_USE_WORK_STEALING
+    return true;
+#else
+    return lIsHybridHost();
+#endif
+}
+
+// Create the mutex and the semaphore of the shared queue of the pool.
+static void lInitSharedQueue(WorkerPool &pool) {
+    int err;
+    if ((err = pthread_mutex_init(&pool.taskSysMutex, nullptr)) != 0) {
+        fprintf(stderr, "Error creating mutex: %s\n", strerror(err));
+        exit(1);
+    }
+
+    constexpr std::size_t SEM_NAME_MAX_SIZE{1024UL};
+    char semaphoreName[SEM_NAME_MAX_SIZE];
+    bool success = false;
+    srand(time(nullptr));
+    for (int i = 0; i < 10; i++) {
+        // Some platforms (e.g. FreeBSD) require the name to begin with a slash
+        snprintf(semaphoreName, SEM_NAME_MAX_SIZE, "/ispc_task.%d.%d", static_cast<int>(getpid()),
+                 static_cast<int>(rand()));
+        pool.workerSemaphore = sem_open(semaphoreName, O_CREAT, S_IRUSR | S_IWUSR, 0);
+        if (pool.workerSemaphore != SEM_FAILED) {
+            success = true;
+            break;
+        }
+        fprintf(stderr, "Failed to create %s\n", semaphoreName);
+    }
 
-                    activeTaskGroups.reserve(64);
+    if (!success) {
+        fprintf(stderr, "Error creating semaphore (%s): %s\n", semaphoreName, strerror(errno));
+        exit(1);
+    }
+    // The semaphore stays valid until it is closed, the name is not needed.
+    sem_unlink(semaphoreName);
+
+    for (std::vector<TaskGroup *> &groups : pool.activeTaskGroups)
+        groups.reserve(64);
+}
+
+static void lStartWorkers(WorkerPool &pool, void *(*entry)(void *)) {
+    pool.threads.resize(pool.nThreads);
+    for (int i = 0; i < pool.nThreads; ++i) {
+        int err = pthread_create(&pool.threads[i], nullptr, entry, new WorkerStart{&pool, i});
+        if (err != 0) {
+            fprintf(stderr, "Error creating pthread %d: %s\n", i, strerror(err));
+            exit(1);
+        }
+    }
+}
+
+static void InitTaskSystem() {
+    // The pools of the sub-devices are started when they are created.
+    if (lCurrentPool != nullptr)
+        return;
+    if (!defaultPool.started) {
+        while (1) {
+            if (lAtomicCompareAndSwap32(&lock, 1, 0) == 0) {
+                if (!defaultPool.started) {
+                    // We launch one fewer thread than there are hardware
+                    // threads available to the process, since the main
+                    // thread here will also grab jobs from the task queue
+                    // itself.
+                    defaultPool.nThreads = (int)ispcrt::cpu::topology().numAvailableThreads - 1;
+                    lInitAffinityPolicy();
+                    lInitWorkerCPUs(defaultPool, affinityPolicy, affinityCores);
+                    lInitSpinBudget();
+
+                    // The work-stealing scheduler doesn't use the shared
+                    // queue and its semaphore.
+                    useWorkStealing = lUseWorkStealing();
+                    if (useWorkStealing)
+                        WorkStealingScheduler::Init(defaultPool.nThreads);
+                    else
+                        lInitSharedQueue(defaultPool);
+
+                    lStartWorkers(defaultPool, useWorkStealing ? &WorkStealingScheduler::WorkerEntry : &lTaskEntry);
+
+                    // Make sure all of the above goes to memory before the
+                    // other threads see the pool started.
+                    lMemFence();
+                    defaultPool.started = true;
                 }
 
                 // Make sure all of the above goes to memory before we
@@ -688,7 +1683,39 @@ static void InitTaskSystem() {
     }
 }
 
+static WorkerPool *lNewWorkerPool(int policy, const std::vector<int> &cores) {
+    WorkerPool *pool = new WorkerPool;
+    pool->nThreads = (int)ispcrt::cpu::topology().numAvailableThreads - 1;
+    lInitWorkerCPUs(*pool, policy, cores);
+    lInitSpinBudget();
+    lInitSharedQueue(*pool);
+    lStartWorkers(*pool, &lTaskEntry);
+    pool->started = true;
+    return pool;
+}
+
+// All the tasks launched into the pool must be synced.
+static void lDeleteWorkerPool(WorkerPool *pool) {
+    pthread_mutex_lock(&pool->taskSysMutex);
+    pool->stop = true;
+    pthread_mutex_unlock(&pool->taskSysMutex);
+    for (int i = 0; i < pool->nThreads; ++i)
+        sem_post(pool->workerSemaphore);
+    for (pthread_t &thread : pool->threads)
+        pthread_join(thread, nullptr);
+    sem_close(pool->workerSemaphore);
+    pthread_mutex_destroy(&pool->taskSysMutex);
+    delete pool;
+}
+
 inline void TaskGroup::Launch(int baseCoord, int count) {
+    WorkerPool *pool = lPool();
+    if (useWorkStealing && pool == &defaultPool) {
+        LaunchWorkStealing(baseCoord, count);
+        return;
+    }
+    pthread_mutex_t &taskSysMutex = pool->taskSysMutex;
+
     //
     // Acquire mutex, add task
     //
@@ -711,7 +1738,8 @@ inline void TaskGroup::Launch(int baseCoord, int count) {
     // Add the task group to the global active list if it isn't there
     // already.
     if (inActiveList == false) {
-        activeTaskGroups.push_back(this);
+        priority = lPriority;
+        pool->activeTaskGroups[lPriorityClass(priority)].push_back(this);
         inActiveList = true;
     }
 
@@ -732,13 +1760,22 @@ inline void TaskGroup::Launch(int baseCoord, int count) {
     // sleeping waiting for tasks to show up
     //
     for (int i = 0; i < count; ++i)
-        if ((err = sem_post(workerSemaphore)) != 0) {
+        if ((err = sem_post(pool->workerSemaphore)) != 0) {
             fprintf(stderr, "Error from sem_post: %s\n", strerror(err));
             exit(1);
         }
 }
 
 inline void TaskGroup::Sync() {
+    // The tasks are synced by the thread, which launched them, so the pool
+    // is the same as at the launch.
+    WorkerPool *pool = lPool();
+    if (useWorkStealing && pool == &defaultPool) {
+        SyncWorkStealing();
+        return;
+    }
+    pthread_mutex_t &taskSysMutex = pool->taskSysMutex;
+
     DBG(fprintf(stderr, "syncing %p - %d unfinished\n", tg, numUnfinishedTasks));
 
     while (numUnfinishedTasks > 0) {
@@ -765,6 +1802,7 @@ inline void TaskGroup::Sync() {
             if (waitingTasks.size() == 0) {
                 // There's nothing left to start running from this group,
                 // so remove it from the active task list.
+                std::vector<TaskGroup *> &activeTaskGroups = pool->activeTaskGroups[lPriorityClass(priority)];
                 activeTaskGroups.erase(std::find(activeTaskGroups.begin(), activeTaskGroups.end(), this));
                 inActiveList = false;
             }
@@ -774,24 +1812,24 @@ inline void TaskGroup::Sync() {
             // Other threads are already working on all of the tasks in
             // this group, so we can't help out by running one ourself.
             // We'll try to run one from another group to make ourselves
-            // useful here.
-            if (activeTaskGroups.size() == 0) {
+            // useful here, preferring the highest priority.
+            std::vector<TaskGroup *> *activeTaskGroups = lHighestActive(*pool);
+            if (activeTaskGroups == nullptr) {
                 // No active task groups left--there's nothing for us to do.
                 if ((err = pthread_mutex_unlock(&taskSysMutex)) != 0) {
                     fprintf(stderr, "Error from pthread_mutex_unlock: %s\n", strerror(err));
                     exit(1);
                 }
-                // FIXME: We basically end up busy-waiting here, which is
-                // extra wasteful in a world with hyper-threading.  It would
-                // be much better to put this thread to sleep on a
-                // condition variable that was signaled when the last task
-                // in this group was finished.
-                usleep(1);
+                // The remaining tasks of this group are running on other
+                // threads and may launch nested tasks, which we can help
+                // with, so poll instead of blocking.  Yield the CPU to the
+                // threads running our tasks in case of oversubscription.
+                sched_yield();
                 continue;
             }
 
             // Get a task to run from another task group.
-            runtg = activeTaskGroups.back();
+            runtg = activeTaskGroups->back();
             assert(runtg->waitingTasks.size() > 0);
 
             int taskNumber = runtg->waitingTasks.back();
@@ -799,7 +1837,7 @@ inline void TaskGroup::Sync() {
             if (runtg->waitingTasks.size() == 0) {
                 // There's left to start running from this group, so remove
                 // it from the active task list.
-                activeTaskGroups.pop_back();
+                activeTaskGroups->pop_back();
                 runtg->inActiveList = false;
             }
             myTask = runtg->GetTaskInfo(taskNumber);
@@ -814,10 +1852,12 @@ inline void TaskGroup::Sync() {
         //
         // Do work for _myTask_
         //
-        // FIXME: bogus values for thread index/thread count here as well..
-        myTask->func(myTask->data, 0, 1, myTask->taskIndex, myTask->taskCount(), myTask->taskIndex0(),
-                     myTask->taskIndex1(), myTask->taskIndex2(), myTask->taskCount0(), myTask->taskCount1(),
-                     myTask->taskCount2());
+        // A worker syncing nested tasks runs them as itself, and with the
+        // priority of their launch.
+        int syncPriority = lPriority;
+        lPriority = runtg->priority;
+        myTask->Run(lThreadIndex, pool->nThreads + 1);
+        lPriority = syncPriority;
 
         //
         // Decrement the number of unfinished tasks counter
@@ -850,8 +1890,7 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
             TaskInfo *ti = GetTaskInfo(baseIndex + i);
 
             // Actually run the task.
-            ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(),
-                     ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+            ti->Run(threadIndex, threadCount);
         }
     }
 }
@@ -879,8 +1918,7 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
         int threadIndex = ti->taskIndex;
         int threadCount = ti->taskCount();
 
-        ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(), ti->taskIndex1(),
-                 ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+        ti->Run(threadIndex, threadCount);
     });
 }
 
@@ -903,8 +1941,7 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
             // TBB does not expose the task -> thread mapping so we pretend it's 1:1
             int threadIndex = ti->taskIndex;
             int threadCount = ti->taskCount();
-            ti->func(ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(), ti->taskIndex0(),
-                     ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(), ti->taskCount1(), ti->taskCount2());
+            ti->Run(threadIndex, threadCount);
         });
     }
 }
@@ -925,9 +1962,7 @@ inline void TaskGroup::Launch(int baseIndex, int count) {
         TaskInfo *ti = GetTaskInfo(baseIndex + i);
         int threadIndex = i;
         int threadCount = count;
-        futures.push_back(hpx::async(ti->func, ti->data, threadIndex, threadCount, ti->taskIndex, ti->taskCount(),
-                                     ti->taskIndex0(), ti->taskIndex1(), ti->taskIndex2(), ti->taskCount0(),
-                                     ti->taskCount1(), ti->taskCount2()));
+        futures.push_back(hpx::async([=]() { ti->Run(threadIndex, threadCount); }));
     }
 }
 
@@ -938,6 +1973,71 @@ inline void TaskGroup::Sync() {
 #endif
 ///////////////////////////////////////////////////////////////////////////
 
+// Takes effect only if it is called before the first launch, which starts
+// the worker threads.
+void ISPCSetAffinity_cpu(int policy, const uint32_t *cores, uint32_t numCores) {
+    if (policy < AFFINITY_NONE || policy > AFFINITY_PERFORMANCE || (policy == AFFINITY_EXPLICIT && numCores == 0)) {
+        fprintf(stderr, "Invalid thread affinity policy %d, ignoring it.\n", policy);
+        return;
+    }
+    affinityCores.clear();
+    if (policy == AFFINITY_EXPLICIT)
+        affinityCores.assign(cores, cores + numCores);
+    affinityPolicy = policy;
+}
+
+// The executor must be set and reset between the launches of the thread, as
+// the handles of the task system and of the executor can't be mixed.
+const ISPCRTTaskingCallbacks *ISPCSetExecutor_cpu(const ISPCRTTaskingCallbacks *executor) {
+    const ISPCRTTaskingCallbacks *previous = lExecutor;
+    lExecutor = executor;
+    return previous;
+}
+
+// Returns the previous priority of the calling thread.
+int ISPCSetPriority_cpu(int priority) {
+    int previous = lPriority;
+    lPriority = priority;
+    return previous;
+}
+
+int ISPCGetPriority_cpu() { return lPriority; }
+
+#ifdef ISPC_USE_PTHREADS
+// Returns nullptr if the pool can't be created.
+void *ISPCNewWorkerPool_cpu(int policy, const uint32_t *cores, uint32_t numCores) {
+    if (policy < AFFINITY_NONE || policy > AFFINITY_PERFORMANCE || (policy == AFFINITY_EXPLICIT && numCores == 0))
+        return nullptr;
+    std::vector<int> poolCores;
+    if (policy == AFFINITY_EXPLICIT)
+        poolCores.assign(cores, cores + numCores);
+    return lNewWorkerPool(policy, poolCores);
+}
+
+void ISPCDeleteWorkerPool_cpu(void *pool) {
+    if (pool != nullptr)
+        lDeleteWorkerPool((WorkerPool *)pool);
+}
+
+// Returns the previous pool of the calling thread.
+void *ISPCSetWorkerPool_cpu(void *pool) {
+    WorkerPool *previous = lCurrentPool;
+    lCurrentPool = (WorkerPool *)pool;
+    return previous;
+}
+
+void ISPCPinToWorkerPool_cpu(void *pool) {
+    if (pool != nullptr)
+        lPinToPool(*(WorkerPool *)pool);
+}
+#else
+// Only the default pool of the task system is supported.
+void *ISPCNewWorkerPool_cpu(int, const uint32_t *, uint32_t) { return nullptr; }
+void ISPCDeleteWorkerPool_cpu(void *) {}
+void *ISPCSetWorkerPool_cpu(void *) { return nullptr; }
+void ISPCPinToWorkerPool_cpu(void *) {}
+#endif // ISPC_USE_PTHREADS
+
 #ifndef ISPC_USE_PTHREADS_FULLY_SUBSCRIBED
 
 #define MAX_FREE_TASK_GROUPS 64
@@ -947,8 +2047,10 @@ static inline TaskGroup *AllocTaskGroup() {
     for (int i = 0; i < MAX_FREE_TASK_GROUPS; ++i) {
         TaskGroup *tg = freeTaskGroups[i];
         if (tg != nullptr) {
+            // Same as for the task segments: the group is taken only if the
+            // slot still holds it.
             void *ptr = lAtomicCompareAndSwapPointer((void **)(&freeTaskGroups[i]), nullptr, tg);
-            if (ptr != nullptr) {
+            if (ptr == tg) {
                 return (TaskGroup *)ptr;
             }
         }
@@ -973,7 +2075,61 @@ static inline void FreeTaskGroup(TaskGroup *tg) {
 
 ///////////////////////////////////////////////////////////////////////////
 
+// Returns the number of tasks, which the records of a range launch of count
+// tasks claim at once, or 0 if the tasks should be launched one by one.
+static int lGetTaskGrainSize(int count) {
+    static volatile int32_t envGrainSize = -1;
+    int grainSize = envGrainSize;
+    if (grainSize < 0) {
+        const char *env = getenv("ISPCRT_TASK_GRAIN_SIZE");
+        grainSize = (env != nullptr) ? std::max(atoi(env), 0) : 0;
+        envGrainSize = grainSize;
+    }
+
+    if (count <= 1)
+        return 0;
+    if (grainSize > 0)
+        return grainSize;
+    if (count <= MAX_RANGE_LAUNCH_RECORDS)
+        return 0;
+    // Smaller blocks on hybrid CPUs, so the faster cores claim more of them.
+    int blocksPerRecord = RANGE_LAUNCH_BLOCKS_PER_RECORD * lSplitFactor();
+    return (count - 1) / (MAX_RANGE_LAUNCH_RECORDS * blocksPerRecord) + 1;
+}
+
+// The task of a launch run by an executor.  The threads of the executor
+// run it with the executor and the priority of the launch, so the nested
+// launches go to the same executor.
+struct ExecutorTask {
+    TaskFuncType func;
+    void *data;
+    const ISPCRTTaskingCallbacks *executor;
+    int priority;
+};
+
+static void lRunExecutorTask(void *data, int threadIndex, int threadCount, int taskIndex, int taskCount,
+                             int taskIndex0, int taskIndex1, int taskIndex2, int taskCount0, int taskCount1,
+                             int taskCount2) {
+    ExecutorTask *task = (ExecutorTask *)data;
+    const ISPCRTTaskingCallbacks *executor = lExecutor;
+    int priority = lPriority;
+    lExecutor = task->executor;
+    lPriority = task->priority;
+    task->func(task->data, threadIndex, threadCount, taskIndex, taskCount, taskIndex0, taskIndex1, taskIndex2,
+               taskCount0, taskCount1, taskCount2);
+    lExecutor = executor;
+    lPriority = priority;
+}
+
 void ISPCLaunch_cpu(void **taskGroupPtr, void *func, void *data, int count0, int count1, int count2) {
+    if (lExecutor != nullptr) {
+        // Allocated with the task group, so freed by the sync of the launch.
+        ExecutorTask *task =
+            (ExecutorTask *)lExecutor->alloc(taskGroupPtr, sizeof(ExecutorTask), alignof(ExecutorTask));
+        *task = {(TaskFuncType)func, data, lExecutor, lPriority};
+        lExecutor->launch(taskGroupPtr, (void *)lRunExecutorTask, task, count0, count1, count2);
+        return;
+    }
     const int count = count0 * count1 * count2;
     TaskGroup *taskGroup;
     if (*taskGroupPtr == nullptr) {
@@ -983,8 +2139,21 @@ void ISPCLaunch_cpu(void **taskGroupPtr, void *func, void *data, int count0, int
     } else
         taskGroup = (TaskGroup *)(*taskGroupPtr);
 
-    int baseIndex = taskGroup->AllocTaskInfo(count);
-    for (int i = 0; i < count; ++i) {
+    // Launch the tasks one by one or as a range, which is run by
+    // numRecords TaskInfo records.
+    TaskRange *range = nullptr;
+    int numRecords = count;
+    int grainSize = lGetTaskGrainSize(count);
+    if (grainSize > 0) {
+        range = (TaskRange *)taskGroup->AllocMemory(sizeof(TaskRange), alignof(TaskRange));
+        range->nextTaskIndex = 0;
+        range->grainSize = grainSize;
+        int numBlocks = (count - 1) / grainSize + 1;
+        numRecords = std::min(numBlocks, MAX_RANGE_LAUNCH_RECORDS);
+    }
+
+    int baseIndex = taskGroup->AllocTaskInfo(numRecords);
+    for (int i = 0; i < numRecords; ++i) {
         TaskInfo *ti = taskGroup->GetTaskInfo(baseIndex + i);
         ti->func = (TaskFuncType)func;
         ti->data = data;
@@ -992,11 +2161,16 @@ void ISPCLaunch_cpu(void **taskGroupPtr, void *func, void *data, int count0, int
         ti->taskCount3d[0] = count0;
         ti->taskCount3d[1] = count1;
         ti->taskCount3d[2] = count2;
+        ti->range = range;
     }
-    taskGroup->Launch(baseIndex, count);
+    taskGroup->Launch(baseIndex, numRecords);
 }
 
 void ISPCSync_cpu(void *h) {
+    if (lExecutor != nullptr) {
+        lExecutor->sync(h);
+        return;
+    }
     TaskGroup *taskGroup = (TaskGroup *)h;
     if (taskGroup != nullptr) {
         taskGroup->Sync();
@@ -1005,6 +2179,8 @@ void ISPCSync_cpu(void *h) {
 }
 
 void *ISPCAlloc_cpu(void **taskGroupPtr, int64_t size, int32_t alignment) {
+    if (lExecutor != nullptr)
+        return lExecutor->alloc(taskGroupPtr, size, alignment);
     TaskGroup *taskGroup;
     if (*taskGroupPtr == nullptr) {
         InitTaskSystem();
@@ -19,6 +19,10 @@ struct GPUContext : public ispcrt::base::Context {
     ISPCRTDeviceType getDeviceType() const override;
 
     virtual void *contextNativeHandle() const override;
+    void memPoolStats(ISPCRTSharedMemoryAllocationHint type, ISPCRTMemPoolStats *stats,
+                      ISPCRTMemPoolChunkStats *chunks, uint32_t *numChunks) const override;
+    size_t trimMemPool(ISPCRTSharedMemoryAllocationHint type) const override;
+    void setMemPoolLimit(ISPCRTSharedMemoryAllocationHint type, size_t maxBytesReserved) const override;
     gpu::ChunkedPool *memPool(ISPCRTSharedMemoryAllocationHint type) const;
 
   private:
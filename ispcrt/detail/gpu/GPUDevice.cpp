@@ -5,23 +5,31 @@
 #include "GPUContext.h"
 
 #if defined(_WIN32) || defined(_WIN64)
-
+#include <process.h>
 #else
 #include <dlfcn.h>
+#include <unistd.h>
 #endif
 // std
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <deque>
 #include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -49,6 +57,7 @@ ispcrt::base::Context *load_gpu_context_ctx(void *ctx) { return new ispcrt::GPUC
 #define DECLARE_ENV(NAME) const char *NAME = #NAME;
 DECLARE_ENV(ISPCRT_VERBOSE)
 DECLARE_ENV(ISPCRT_MAX_KERNEL_LAUNCHES)
+DECLARE_ENV(ISPCRT_EVENT_POOL_SIZE)
 DECLARE_ENV(ISPCRT_GPU_DRIVER)
 DECLARE_ENV(ISPCRT_GPU_DEVICE)
 DECLARE_ENV(ISPCRT_MOCK_DEVICE)
@@ -59,9 +68,14 @@ DECLARE_ENV(ISPCRT_DISABLE_MULTI_COMMAND_LISTS)
 DECLARE_ENV(ISPCRT_DISABLE_COPY_ENGINE)
 DECLARE_ENV(ISPCRT_IGC_OPTIONS)
 DECLARE_ENV(ISPCRT_USE_ZEBIN)
+DECLARE_ENV(ISPCRT_GPU_CACHE_DIR)
 DECLARE_ENV(ISPCRT_MEM_POOL)
 DECLARE_ENV(ISPCRT_MEM_POOL_MIN_CHUNK_POW2)
 DECLARE_ENV(ISPCRT_MEM_POOL_MAX_CHUNK_POW2)
+DECLARE_ENV(ISPCRT_DEVICE_MEM_POOL)
+DECLARE_ENV(ISPCRT_DEVICE_MEM_POOL_SIZE)
+DECLARE_ENV(ISPCRT_STAGING_BUFFER_SIZE)
+DECLARE_ENV(ISPCRT_DISABLE_ZERO_COPY)
 #undef DECLARE_ENV
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -317,14 +331,21 @@ struct Future : public ispcrt::base::Future {
     Future() {}
     virtual ~Future() {}
 
-    bool valid() override { return m_valid; }
-    uint64_t time() override { return m_time; }
+    bool valid() override { return m_valid.load(std::memory_order_acquire); }
+    uint64_t time() override { return m_time.load(std::memory_order_relaxed); }
 
     friend struct TaskQueue;
 
   private:
-    uint64_t m_time{0};
-    bool m_valid{false};
+    // The future is completed by the thread syncing the TaskQueue while
+    // other threads may poll it.
+    void complete(uint64_t time) {
+        m_time.store(time, std::memory_order_relaxed);
+        m_valid.store(true, std::memory_order_release);
+    }
+
+    std::atomic<uint64_t> m_time{0};
+    std::atomic<bool> m_valid{false};
 };
 
 struct Fence : public ispcrt::base::Fence {
@@ -347,6 +368,14 @@ struct Fence : public ispcrt::base::Fence {
         L0_SAFE_CALL(zeFenceHostSynchronize(m_handle, infinity));
     }
 
+    bool wait(uint64_t timeoutNs) override {
+        ze_result_t res = zeFenceHostSynchronize(m_handle, timeoutNs);
+        if (res == ZE_RESULT_NOT_READY)
+            return false;
+        L0_THROW_IF(res);
+        return true;
+    }
+
     ISPCRTFenceStatus status() const override {
         ze_result_t res = zeFenceQueryStatus(m_handle);
         switch (res) {
@@ -368,8 +397,43 @@ struct Fence : public ispcrt::base::Fence {
     ze_fence_handle_t m_handle;
 };
 
+// The fences of a command queue. The pool holds a reference to every fence it
+// created, so a fence released by the command list and by the user is reset
+// and handed out again instead of being destroyed.
+struct FencePool {
+    FencePool(ze_command_queue_handle_t q) : m_q(q) {}
+
+    ~FencePool() {
+        for (const auto &f : m_fences) {
+            f->refDec();
+        }
+    }
+
+    // The returned fence is unsignaled and referenced for the caller.
+    Fence *acquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &f : m_fences) {
+            if (f->useCount() == 1) {
+                f->reset();
+                f->refInc();
+                return f;
+            }
+        }
+        Fence *f = new Fence(m_q);
+        m_fences.push_back(f);
+        f->refInc();
+        return f;
+    }
+
+  private:
+    ze_command_queue_handle_t m_q{nullptr};
+    // The command lists of the queue may be submitted by several threads.
+    std::mutex m_mutex;
+    std::vector<Fence *> m_fences;
+};
+
 struct Event {
-    Event(ze_event_pool_handle_t pool, uint32_t index) : m_pool(pool), m_index(index) {}
+    Event(ze_event_pool_handle_t pool, uint32_t index, size_t id) : m_pool(pool), m_index(index), m_id(id) {}
 
     ze_event_handle_t handle() {
         if (!m_handle)
@@ -384,6 +448,9 @@ struct Event {
 
     uint32_t index() { return m_index; }
 
+    // Index of the event in its EventPool
+    size_t id() { return m_id; }
+
     void resetEvent() { L0_SAFE_CALL(zeEventHostReset(m_handle)); }
 
     bool isReady() {
@@ -416,17 +483,31 @@ struct Event {
     ze_event_handle_t m_handle{nullptr};
     ze_event_pool_handle_t m_pool{nullptr};
     uint32_t m_index{0};
+    size_t m_id{0};
     // This property tracks if event is "active" and should be used as
     // dependency for kernel launches.
     bool m_in_use{false};
 };
 
+// Immediate command list executes the commands as they are appended, so it is
+// neither closed, submitted nor reset.
 struct CommandList {
-    CommandList(ze_device_handle_t device, ze_context_handle_t context, const uint32_t ordinal)
-        : m_device(device), m_context(context), m_ordinal(ordinal) {
-        ze_command_list_desc_t commandListDesc = {ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC, nullptr, m_ordinal, 0};
+    CommandList(ze_device_handle_t device, ze_context_handle_t context, const uint32_t ordinal,
+                const bool immediate = false)
+        : m_device(device), m_context(context), m_ordinal(ordinal), m_immediate(immediate) {
+        if (m_immediate) {
+            ze_command_queue_desc_t queueDesc = {};
+            queueDesc.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC;
+            queueDesc.ordinal = m_ordinal;
+            queueDesc.mode = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS;
+            queueDesc.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+
+            L0_SAFE_CALL(zeCommandListCreateImmediate(m_context, m_device, &queueDesc, &m_handle));
+        } else {
+            ze_command_list_desc_t commandListDesc = {ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC, nullptr, m_ordinal, 0};
 
-        L0_SAFE_CALL(zeCommandListCreate(m_context, m_device, &commandListDesc, &m_handle));
+            L0_SAFE_CALL(zeCommandListCreate(m_context, m_device, &commandListDesc, &m_handle));
+        }
         if (!m_handle)
             throw std::runtime_error("Failed to create command list!");
     }
@@ -441,6 +522,8 @@ struct CommandList {
 
     uint32_t ordinal() { return m_ordinal; }
 
+    bool immediate() const { return m_immediate; }
+
     void clear() {
         m_numCommands = 0;
         m_events.clear();
@@ -448,14 +531,14 @@ struct CommandList {
     }
 
     void reset() {
-        if (m_numCommands > 0) {
+        if (!m_immediate && m_numCommands > 0) {
             L0_SAFE_CALL(zeCommandListReset(m_handle));
         }
         clear();
     }
 
     void submit(ze_command_queue_handle_t q) {
-        if (!m_submitted && m_numCommands > 0) {
+        if (!m_immediate && !m_submitted && m_numCommands > 0) {
             L0_SAFE_CALL(zeCommandListClose(m_handle));
             L0_SAFE_CALL(zeCommandQueueExecuteCommandLists(q, 1, &m_handle, nullptr));
             m_submitted = true;
@@ -484,6 +567,7 @@ struct CommandList {
     ze_device_handle_t m_device{nullptr};
     ze_context_handle_t m_context{nullptr};
     const uint32_t m_ordinal{0};
+    const bool m_immediate{false};
     bool m_submitted{false};
     uint32_t m_numCommands{0};
     // List of events associated with command list
@@ -494,6 +578,7 @@ enum class ISPCRTEventPoolType { compute, copy };
 
 struct EventPool {
     constexpr static uint32_t POOL_SIZE_CAP = 100000;
+    constexpr static uint32_t DEFAULT_BLOCK_SIZE = 1024;
 
     EventPool(ze_context_handle_t context, ze_device_handle_t device,
               ISPCRTEventPoolType type = ISPCRTEventPoolType::compute)
@@ -510,35 +595,28 @@ struct EventPool {
             // so simple solution for this case.
             m_timestampMaxValue = (uint64_t)-1;
         }
-        // Create pool
-        m_poolSize = POOL_SIZE_CAP;
+        // Events are created in blocks of m_blockSize, and a new block is
+        // added when all events are in use, so the pool grows as needed.
+        m_blockSize = get_number_envvar(ISPCRT_EVENT_POOL_SIZE, DEFAULT_BLOCK_SIZE);
+        if (m_blockSize == 0 || m_blockSize > POOL_SIZE_CAP) {
+            throw std::runtime_error("ISPCRT_EVENT_POOL_SIZE is beyond reasonable limits");
+        }
         // For compute event pool check if ISPCRT_MAX_KERNEL_LAUNCHES is set
         if (type == ISPCRTEventPoolType::compute) {
-            // User can set a lower limit for the pool size, which in fact limits
+            // User can set a limit for the pool size, which in fact limits
             // the number of possible kernel launches. To make it more clear for the user,
             // the variable is named ISPCRT_MAX_KERNEL_LAUNCHES
-            m_poolSize = get_number_envvar(ISPCRT_MAX_KERNEL_LAUNCHES, m_poolSize);
-            if (m_poolSize > POOL_SIZE_CAP) {
-                m_poolSize = POOL_SIZE_CAP;
+            m_maxPoolSize = get_number_envvar(ISPCRT_MAX_KERNEL_LAUNCHES, m_maxPoolSize);
+            if (m_maxPoolSize > POOL_SIZE_CAP) {
+                m_maxPoolSize = POOL_SIZE_CAP;
                 std::cerr << "[ISPCRT][WARNING] " << ISPCRT_MAX_KERNEL_LAUNCHES << " value too large, using "
                           << POOL_SIZE_CAP << " instead." << std::endl;
             }
+            if (m_maxPoolSize != 0 && m_blockSize > m_maxPoolSize) {
+                m_blockSize = m_maxPoolSize;
+            }
         }
-        ze_event_pool_desc_t eventPoolDesc = {};
-        eventPoolDesc.count = m_poolSize;
-        eventPoolDesc.flags =
-            (ze_event_pool_flag_t)(ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE);
-        L0_SAFE_CALL(zeEventPoolCreate(m_context, &eventPoolDesc, 1, &m_device, &m_pool));
-        if (!m_pool) {
-            std::stringstream ss;
-            ss << "Failed to create event pool for device 0x" << std::hex << m_device << " (context 0x" << m_context
-               << ")";
-            throw std::runtime_error(ss.str());
-        }
-        // Put all event ids into a freelist
-        for (size_t i = 0; i < m_poolSize; i++) {
-            m_freeList.push_back(i);
-        }
+        addBlock();
     }
 
     ~EventPool() {
@@ -546,29 +624,50 @@ struct EventPool {
             deleteEvent(p);
         }
         m_events_pool.clear();
-        if (m_pool) {
-            L0_SAFE_CALL_NOEXCEPT(zeEventPoolDestroy(m_pool));
+        for (const auto &e : m_recycled) {
+            deleteEvent(e);
+        }
+        m_recycled.clear();
+        for (const auto &pool : m_pools) {
+            L0_SAFE_CALL_NOEXCEPT(zeEventPoolDestroy(pool));
         }
         assert(m_freeList.size() == m_poolSize);
         m_freeList.clear();
     }
 
+    // Return the event, which is not signaled.  The events released with
+    // recycleEvent() are reused first, so no zeEventCreate() is needed.
     Event *createEvent() {
-        if (m_freeList.empty()) {
+        if (!m_recycled.empty()) {
+            auto e = m_recycled.back();
+            m_recycled.pop_back();
+            return e;
+        }
+        if (m_freeList.empty() && !addBlock()) {
             return nullptr;
         }
-        auto e = new Event(m_pool, m_freeList.front());
+        size_t id = m_freeList.front();
+        auto e = new Event(m_pools[id / m_blockSize], id % m_blockSize, id);
         assert(e);
         m_freeList.pop_front();
         return e;
     }
 
+    // Destroy the event, which can't be reused: it was not appended to a
+    // command list or its completion was not observed.
     void deleteEvent(Event *e) {
         assert(e);
-        m_freeList.push_back(e->index());
+        m_freeList.push_back(e->id());
         delete e;
     }
 
+    // Return the event, which is known to be completed, to the pool.
+    void recycleEvent(Event *e) {
+        assert(e);
+        e->resetEvent();
+        m_recycled.push_back(e);
+    }
+
     Event *getEvent() {
         // Get event from pool or create a new one if there is no ready event yet
         Event *event = nullptr;
@@ -608,10 +707,50 @@ struct EventPool {
     ze_event_pool_handle_t m_pool{nullptr};
     uint64_t m_timestampFreq;
     uint64_t m_timestampMaxValue;
-    size_t m_poolSize;
+    // Size of every ze_event_pool_handle_t, the total number of events and
+    // its limit (0 if there is no limit).
+    size_t m_blockSize{0};
+    size_t m_poolSize{0};
+    size_t m_maxPoolSize{0};
+    std::vector<ze_event_pool_handle_t> m_pools;
+    // Ids of the events, which are not created yet: event id / m_blockSize
+    // is the index of its pool.
     std::deque<size_t> m_freeList;
+    // Completed events, which are reset and can be appended again
+    std::vector<Event *> m_recycled;
     // Events pool for reuse
     std::vector<Event *> m_events_pool;
+
+    bool addBlock() {
+        size_t blockSize = m_blockSize;
+        if (m_maxPoolSize != 0) {
+            if (m_poolSize >= m_maxPoolSize) {
+                return false;
+            }
+            // Only the last block may be smaller, so the pool of the event is
+            // still its id / m_blockSize.
+            blockSize = std::min(blockSize, m_maxPoolSize - m_poolSize);
+        }
+        ze_event_pool_desc_t eventPoolDesc = {};
+        eventPoolDesc.count = (uint32_t)blockSize;
+        eventPoolDesc.flags =
+            (ze_event_pool_flag_t)(ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE);
+        ze_event_pool_handle_t pool = nullptr;
+        L0_SAFE_CALL(zeEventPoolCreate(m_context, &eventPoolDesc, 1, &m_device, &pool));
+        if (!pool) {
+            std::stringstream ss;
+            ss << "Failed to create event pool for device 0x" << std::hex << m_device << " (context 0x" << m_context
+               << ")";
+            throw std::runtime_error(ss.str());
+        }
+        m_pools.push_back(pool);
+        // Put all event ids of the new block into the freelist
+        for (size_t i = 0; i < blockSize; i++) {
+            m_freeList.push_back(m_poolSize + i);
+        }
+        m_poolSize += blockSize;
+        return true;
+    }
 };
 
 // Class to contain a single rather big memory hunk. This hunk allocated once.
@@ -674,6 +813,14 @@ class Bulk {
     // Return true if there is no empty chunks
     bool full() { return !(m_initFreeChunks < m_numChunks) && m_freeChunks.empty(); }
 
+    // Return true if the memory hunk is allocated
+    bool allocated() const { return m_memPtr != nullptr; }
+    // Return true if no chunk is in use
+    bool empty() const { return m_usedChunks.empty(); }
+
+    size_t size() const { return m_size; }
+    size_t usedBytes() const { return m_usedChunks.size() * m_chunkSize; }
+
     // Getter and setter for device handle. It is needed because sometimes Bulk
     // objects are created before device handle is constructed.
     ze_device_handle_t hDev() const { return m_dev; }
@@ -752,11 +899,14 @@ class ChunkedPool {
                 delete b;
     }
 
+    // Return nullptr if a new bulk is needed, but it would exceed the limit
+    // of the reserved memory.
     void *allocate(size_t size) {
         assert(size == round_up_pow2(size));
         assert(size <= m_maxChunkSize);
         assert(size >= m_minChunkSize);
 
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto &bulks = m_bulks[size];
 
         bool allFull = true;
@@ -776,12 +926,23 @@ class ChunkedPool {
             bulks.push_back(blk);
         }
 
-        void *mem_ptr = blk->allocChunk();
+        const bool reserving = !blk->allocated();
+        if (reserving && !reserve(blk->size()))
+            return nullptr;
+        void *mem_ptr = nullptr;
+        try {
+            mem_ptr = blk->allocChunk();
+        } catch (...) {
+            if (reserving)
+                m_reserved -= blk->size();
+            throw;
+        }
         m_allocated[mem_ptr] = blk;
         return mem_ptr;
     }
 
     void deallocate(void *ptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_allocated.find(ptr);
         assert(it != m_allocated.end());
         Bulk *blk = it->second;
@@ -804,10 +965,99 @@ class ChunkedPool {
     size_t minChunkSize() const { return m_minChunkSize; }
     size_t maxChunkSize() const { return m_maxChunkSize; }
 
+    // Fill the statistics of the pool and, if chunks is not nullptr, of up to
+    // *numChunks chunk sizes. *numChunks is set to the number of chunk sizes.
+    void stats(ISPCRTMemPoolStats *stats, ISPCRTMemPoolChunkStats *chunks, uint32_t *numChunks) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (stats) {
+            stats->bytesReserved = m_reserved;
+            stats->bytesInUse = 0;
+            stats->peakBytesReserved = m_peakReserved;
+            stats->maxBytesReserved = m_maxReserved;
+        }
+        uint32_t i = 0;
+        for (size_t pow2 = m_minPow2; pow2 <= m_maxPow2; pow2++, i++) {
+            ISPCRTMemPoolChunkStats chunk = {};
+            chunk.chunkSize = 1ULL << pow2;
+            for (auto b : m_bulks[chunk.chunkSize]) {
+                if (!b->allocated())
+                    continue;
+                chunk.numBulks++;
+                chunk.bytesReserved += b->size();
+                chunk.bytesInUse += b->usedBytes();
+            }
+            if (stats)
+                stats->bytesInUse += chunk.bytesInUse;
+            if (chunks && numChunks && i < *numChunks)
+                chunks[i] = chunk;
+        }
+        if (numChunks)
+            *numChunks = i;
+    }
+
+    // Free the memory of the bulks without any chunk in use and return the
+    // number of bytes released.
+    size_t trim() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return trimUnlocked();
+    }
+
+    // Limit the reserved memory, 0 means unlimited. Allocations, which need a
+    // new bulk beyond the limit, are not served by the pool.
+    void setLimit(size_t maxBytesReserved) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxReserved = maxBytesReserved;
+        if (m_maxReserved != 0 && m_reserved > m_maxReserved)
+            trimUnlocked();
+    }
+
   private:
     // Shared memory with allocation hint stored in this ChunkedPool
     ISPCRTSharedMemoryAllocationHint m_type;
 
+    // Protects the bulks, so the statistics can be queried from any thread.
+    std::mutex m_mutex;
+    // Bytes of the allocated bulks, its peak and limit (0 if there is no limit)
+    size_t m_reserved{0};
+    size_t m_peakReserved{0};
+    size_t m_maxReserved{0};
+
+    bool reserve(size_t bytes) {
+        if (m_maxReserved != 0 && m_reserved + bytes > m_maxReserved) {
+            trimUnlocked();
+            if (m_reserved + bytes > m_maxReserved)
+                return false;
+        }
+        m_reserved += bytes;
+        m_peakReserved = std::max(m_peakReserved, m_reserved);
+        return true;
+    }
+
+    size_t trimUnlocked() {
+        size_t released = 0;
+        for (auto &l : m_bulks) {
+            auto &bulks = l.second;
+            for (auto it = bulks.begin(); it != bulks.end();) {
+                Bulk *b = *it;
+                if (b->allocated() && b->empty()) {
+                    released += b->size();
+                    delete b;
+                    it = bulks.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            // Keep a bulk, which is allocated lazily, for every chunk size.
+            if (bulks.empty())
+                bulks.push_back(new Bulk(l.first, m_maxChunkSize, m_ctxt, m_dev));
+        }
+        m_reserved -= released;
+        if (UNLIKELY(is_verbose) && released) {
+            std::cout << "ChunkedPool for " << m_type << " released " << released << " bytes" << std::endl;
+        }
+        return released;
+    }
+
     // Contains lists of bulks for some chunk sizes.
     std::unordered_map<size_t, std::list<Bulk *>> m_bulks;
 
@@ -828,11 +1078,164 @@ class ChunkedPool {
     size_t m_maxChunkSize{1ULL << 21};
 };
 
+// Cache of the device memory of the device memory views of a GPU device,
+// enabled with ISPCRT_DEVICE_MEM_POOL=1. The allocations are rounded up to
+// power of 2 size classes, and the blocks of the released views are reused
+// by the following allocations of the same class instead of being freed.
+// The task queues don't keep the memory views of their commands, so a block
+// is released in stream order: it's reused only after every task queue that
+// had commands in flight when it was released has been synced since, as the
+// kernels may still use it until then. The blocks cached beyond the limit of
+// ISPCRT_DEVICE_MEM_POOL_SIZE megabytes (256 by default) are freed instead.
+class DeviceMemoryPool {
+  public:
+    // The progress of a task queue, which the released blocks wait for.
+    struct QueueProgress {
+        // Set when a command is enqueued, cleared by the next sync.
+        std::atomic<bool> busy{false};
+        std::atomic<uint64_t> syncs{0};
+
+        void used() { busy = true; }
+        void synced() {
+            busy = false;
+            syncs++;
+        }
+    };
+
+    DeviceMemoryPool(ze_context_handle_t context, ze_device_handle_t device) : m_context(context), m_device(device) {
+        m_maxCached = get_number_envvar(ISPCRT_DEVICE_MEM_POOL_SIZE, m_maxCached >> 20) << 20;
+    }
+
+    ~DeviceMemoryPool() {
+        for (auto &p : m_pending)
+            L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, p.ptr));
+        trim();
+    }
+
+    static bool enabled() { return get_bool_envvar(ISPCRT_DEVICE_MEM_POOL); }
+
+    // The queue is tracked as long as it holds the returned object.
+    std::shared_ptr<QueueProgress> addQueue() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto progress = std::make_shared<QueueProgress>();
+        m_queues.erase(std::remove_if(m_queues.begin(), m_queues.end(),
+                                      [](const std::weak_ptr<QueueProgress> &q) { return q.expired(); }),
+                       m_queues.end());
+        m_queues.push_back(progress);
+        return progress;
+    }
+
+    // Return the block for size bytes and set blockSize to its size class.
+    void *allocate(size_t size, size_t alignment, size_t &blockSize) {
+        blockSize = round_up_pow2(std::max(size, m_minBlockSize));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            collect();
+            auto &blocks = m_free[blockSize];
+            if (!blocks.empty()) {
+                void *ptr = blocks.back();
+                blocks.pop_back();
+                m_cached -= blockSize;
+                return ptr;
+            }
+        }
+        ze_device_mem_alloc_desc_t allocDesc = {};
+        void *ptr = nullptr;
+        ze_result_t status = zeMemAllocDevice(m_context, &allocDesc, blockSize, alignment, m_device, &ptr);
+        if (status == ZE_RESULT_ERROR_OUT_OF_DEVICE_MEMORY && trim() > 0)
+            status = zeMemAllocDevice(m_context, &allocDesc, blockSize, alignment, m_device, &ptr);
+        L0_THROW_IF(status);
+        if (UNLIKELY(is_verbose)) {
+            std::cout << "Device MemPool allocation " << blockSize << "(" << size << ") at " << ptr << std::endl;
+        }
+        return ptr;
+    }
+
+    void deallocate(void *ptr, size_t blockSize) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Pending p{ptr, blockSize, {}};
+        for (const auto &q : m_queues) {
+            if (auto progress = q.lock()) {
+                if (progress->busy)
+                    p.waits.push_back({progress, progress->syncs.load()});
+            }
+        }
+        m_pending.push_back(std::move(p));
+        collect();
+    }
+
+    // Free the cached blocks, which aren't waited for, and return the number
+    // of bytes released.
+    size_t trim() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        collect();
+        size_t released = 0;
+        for (auto &blocks : m_free) {
+            for (void *ptr : blocks.second) {
+                L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, ptr));
+                released += blocks.first;
+            }
+            blocks.second.clear();
+        }
+        m_cached = 0;
+        return released;
+    }
+
+  private:
+    struct Pending {
+        void *ptr;
+        size_t size;
+        // The queues and the numbers of their syncs when the block was
+        // released.
+        std::vector<std::pair<std::shared_ptr<QueueProgress>, uint64_t>> waits;
+    };
+
+    // Move the released blocks, which aren't used anymore, to the free lists
+    // or free them if the cache is full. Called with m_mutex locked.
+    void collect() {
+        for (auto it = m_pending.begin(); it != m_pending.end();) {
+            const bool ready = std::all_of(it->waits.begin(), it->waits.end(), [](const auto &w) {
+                return w.first.use_count() == 1 || w.first->syncs > w.second;
+            });
+            if (!ready) {
+                ++it;
+                continue;
+            }
+            if (m_cached + it->size <= m_maxCached) {
+                m_free[it->size].push_back(it->ptr);
+                m_cached += it->size;
+            } else {
+                L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, it->ptr));
+            }
+            it = m_pending.erase(it);
+        }
+    }
+
+    ze_context_handle_t m_context{nullptr};
+    ze_device_handle_t m_device{nullptr};
+    std::mutex m_mutex;
+    std::vector<std::weak_ptr<QueueProgress>> m_queues;
+    std::map<size_t, std::vector<void *>> m_free;
+    std::list<Pending> m_pending;
+    // Bytes in m_free and the limit of them.
+    size_t m_cached{0};
+    size_t m_maxCached{256ULL << 20};
+    size_t m_minBlockSize{64};
+};
+
 struct MemoryView : public ispcrt::base::MemoryView {
+    // A zero-copy view uses the application memory, which the device can
+    // access, as the device memory, so the copies are no-ops.
     MemoryView(ze_context_handle_t context, ze_device_handle_t device, void *appMem, size_t numBytes,
-               const ISPCRTNewMemoryViewFlags *flags, const GPUContext *ctxt)
+               const ISPCRTNewMemoryViewFlags *flags, const GPUContext *ctxt, bool zeroCopy = false,
+               std::shared_ptr<DeviceMemoryPool> deviceMemPool = nullptr, uint32_t placement = ISPCRT_MEM_DEFAULT)
         : m_size(numBytes), m_requestedSize(numBytes), m_context(context), m_device(device),
-          m_shared(flags->allocType == ISPCRT_ALLOC_TYPE_SHARED), m_smhint(flags->smHint), m_ctxtGPU(ctxt) {
+          m_shared(flags->allocType == ISPCRT_ALLOC_TYPE_SHARED), m_smhint(flags->smHint), m_ctxtGPU(ctxt),
+          m_zeroCopy(zeroCopy) {
+        // The driver backs the allocations aligned to 2 MB with 2 MB pages,
+        // the other placement flags are left to the driver.
+        if (placement & (ISPCRT_MEM_HUGE_PAGES | ISPCRT_MEM_HUGE_PAGES_2MB | ISPCRT_MEM_HUGE_PAGES_1GB))
+            m_alignment = 1ULL << 21;
         // We need context object to be alive until memoryview is alive
         if (m_ctxtGPU) {
             m_ctxtGPU->refInc();
@@ -843,24 +1246,43 @@ struct MemoryView : public ispcrt::base::MemoryView {
         } else {
             m_hostPtr = appMem;
         }
+        if (m_zeroCopy) {
+            m_devicePtr = appMem;
+        }
 
         // Use MemPool only when it is explicitly enabled with env var and memory hint is not device/host read/write
         m_useMemPool = get_bool_envvar(ISPCRT_MEM_POOL) && (m_smhint != ISPCRT_SM_HOST_DEVICE_READ_WRITE) &&
-                       (m_smhint != ISPCRT_SM_APPLICATION_MANAGED_DEVICE);
+                       (m_smhint != ISPCRT_SM_APPLICATION_MANAGED_DEVICE) && placement == ISPCRT_MEM_DEFAULT;
         if (m_ctxtGPU && m_useMemPool) {
             m_memPool = m_ctxtGPU->memPool(m_smhint);
             if (!m_memPool->hDev())
                 m_memPool->hDev(device);
         }
+        if (!m_shared && placement == ISPCRT_MEM_DEFAULT)
+            m_deviceMemPool = std::move(deviceMemPool);
+    }
+
+    // The slice of the memory of parent, see slice().
+    MemoryView(MemoryView &parent, size_t offset, size_t numBytes)
+        : m_size(numBytes), m_requestedSize(numBytes), m_context(parent.m_context), m_device(parent.m_device),
+          m_shared(parent.m_shared), m_smhint(parent.m_smhint), m_zeroCopy(parent.m_zeroCopy),
+          m_parent(parent.m_parent ? parent.m_parent : &parent), m_offset(parent.m_offset + offset) {
+        m_parent->refInc();
     }
 
     ~MemoryView() {
-        if (m_devicePtr && m_smhint != ISPCRT_SM_APPLICATION_MANAGED_DEVICE) {
-            if (m_shared && m_useMemPool && m_size <= m_memPool->maxChunkSize()) {
+        if (m_parent) {
+            m_parent->refDec();
+            return;
+        }
+        if (m_devicePtr && !m_zeroCopy && m_smhint != ISPCRT_SM_APPLICATION_MANAGED_DEVICE) {
+            if (m_fromMemPool) {
                 m_memPool->deallocate(m_devicePtr);
                 if (UNLIKELY(is_verbose)) {
                     std::cout << "MemPool deallocation at " << m_devicePtr << std::endl;
                 }
+            } else if (m_deviceMemPool) {
+                m_deviceMemPool->deallocate(m_devicePtr, m_blockSize);
             } else {
                 L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, m_devicePtr));
             }
@@ -873,9 +1295,19 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
     bool isShared() { return m_shared; }
 
-    void *hostPtr() { return m_shared ? devicePtr() : m_hostPtr; };
+    bool isZeroCopy() { return m_zeroCopy; }
+
+    void *hostPtr() {
+        if (m_parent) {
+            char *ptr = static_cast<char *>(m_parent->hostPtr());
+            return ptr ? ptr + m_offset : nullptr;
+        }
+        return m_shared ? devicePtr() : m_hostPtr;
+    };
 
     void *devicePtr() {
+        if (m_parent)
+            return static_cast<char *>(m_parent->devicePtr()) + m_offset;
         if (!m_devicePtr)
             allocate();
         return m_devicePtr;
@@ -883,13 +1315,20 @@ struct MemoryView : public ispcrt::base::MemoryView {
 
     size_t numBytes() { return m_size; };
 
+    ispcrt::base::MemoryView *slice(size_t offset, size_t numBytes) { return new MemoryView(*this, offset, numBytes); }
+
   private:
     void allocDevice() {
         if (!m_device)
             throw std::runtime_error("Device handle is NULL!");
 
+        if (m_deviceMemPool) {
+            m_devicePtr = m_deviceMemPool->allocate(m_size, m_alignment, m_blockSize);
+            return;
+        }
+
         ze_device_mem_alloc_desc_t allocDesc = {};
-        ze_result_t status = zeMemAllocDevice(m_context, &allocDesc, m_size, 64, m_device, &m_devicePtr);
+        ze_result_t status = zeMemAllocDevice(m_context, &allocDesc, m_size, m_alignment, m_device, &m_devicePtr);
 
         if (status != ZE_RESULT_SUCCESS)
             m_devicePtr = nullptr;
@@ -903,7 +1342,8 @@ struct MemoryView : public ispcrt::base::MemoryView {
         ze_device_mem_alloc_desc_t device_alloc_desc = {};
         ze_host_mem_alloc_desc_t host_alloc_desc = {};
         ze_result_t status =
-            zeMemAllocShared(m_context, &device_alloc_desc, &host_alloc_desc, m_size, 64, m_device, &m_devicePtr);
+            zeMemAllocShared(m_context, &device_alloc_desc, &host_alloc_desc, m_size, m_alignment, m_device,
+                             &m_devicePtr);
 
         if (status != ZE_RESULT_SUCCESS)
             m_devicePtr = nullptr;
@@ -924,10 +1364,16 @@ struct MemoryView : public ispcrt::base::MemoryView {
                 }
 
                 m_devicePtr = m_memPool->allocate(m_size);
-                assert(m_devicePtr);
-                if (UNLIKELY(is_verbose)) {
-                    std::cout << "MemPool allocation " << m_size << "(" << m_requestedSize << ") at " << m_devicePtr
-                              << std::endl;
+                if (m_devicePtr) {
+                    m_fromMemPool = true;
+                    if (UNLIKELY(is_verbose)) {
+                        std::cout << "MemPool allocation " << m_size << "(" << m_requestedSize << ") at "
+                                  << m_devicePtr << std::endl;
+                    }
+                } else {
+                    // The pool reached its limit
+                    m_size = m_requestedSize;
+                    allocShared();
                 }
             } else {
                 allocShared();
@@ -941,6 +1387,7 @@ struct MemoryView : public ispcrt::base::MemoryView {
     void *m_hostPtr{nullptr};
     size_t m_size{0};
     size_t m_requestedSize{0};
+    size_t m_alignment{64};
 
     ze_context_handle_t m_context{nullptr};
     ze_device_handle_t m_device{nullptr};
@@ -952,7 +1399,18 @@ struct MemoryView : public ispcrt::base::MemoryView {
     const GPUContext *m_ctxtGPU{nullptr};
 
     bool m_useMemPool{false};
+    bool m_fromMemPool{false};
     ChunkedPool *m_memPool{nullptr};
+    // The pool of the device memory and the size class of the block from it.
+    std::shared_ptr<DeviceMemoryPool> m_deviceMemPool;
+    size_t m_blockSize{0};
+
+    bool m_zeroCopy{false};
+
+    // The view this one is a slice of, which owns the memory, and the
+    // offset of the slice in it.
+    MemoryView *m_parent{nullptr};
+    size_t m_offset{0};
 };
 
 struct ModuleOptions : public ispcrt::base::ModuleOptions {
@@ -963,20 +1421,296 @@ struct ModuleOptions : public ispcrt::base::ModuleOptions {
     uint32_t stackSize() const { return m_stackSize; }
     bool libraryCompilation() const { return m_libraryCompilation; }
     ISPCRTModuleType moduleType() const { return m_moduleType; }
+    bool eagerKernels() const { return m_eagerKernels; }
+    const std::map<uint32_t, std::vector<uint8_t>> &specConstants() const { return m_specConstants; }
 
     void setStackSize(uint32_t size) { m_stackSize = size; }
     void setLibraryCompilation(bool isLibraryCompilation) { m_libraryCompilation = isLibraryCompilation; }
     void setModuleType(ISPCRTModuleType type) { m_moduleType = type; }
+    void setEagerKernels(bool eager) { m_eagerKernels = eager; }
+    void setSpecConstant(uint32_t id, const void *value, size_t size) {
+        m_specConstants[id].assign((const uint8_t *)value, (const uint8_t *)value + size);
+    }
 
   private:
     ISPCRTModuleType m_moduleType{ISPCRTModuleType::ISPCRT_VECTOR_MODULE};
     bool m_libraryCompilation{false};
     uint32_t m_stackSize{0};
+    bool m_eagerKernels{false};
+    std::map<uint32_t, std::vector<uint8_t>> m_specConstants;
+};
+
+// Persistent cache of the native binaries of SPIR-V modules, which saves the
+// JIT compilation on the following runs.  It is enabled by setting
+// ISPCRT_GPU_CACHE_DIR to an existing directory.  The binary is stored in a
+// file named after the hash of the SPIR-V code, the IGC options, the device
+// and the driver version, so any change of them results in a new entry.
+// The values of the specialization constants are a part of the key as well,
+// so every configuration of the module is compiled once.
+class ModuleCache {
+  public:
+    ModuleCache(ze_driver_handle_t driver, ze_device_handle_t device, const std::vector<unsigned char> &code,
+                const std::string &options, const std::map<uint32_t, std::vector<uint8_t>> &specConstants) {
+        const char *dir = getenv_wr(ISPCRT_GPU_CACHE_DIR);
+        if (dir == nullptr || *dir == '\0' || driver == nullptr || code.empty())
+            return;
+
+        ze_driver_properties_t driverProps = {};
+        driverProps.stype = ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES;
+        ze_device_properties_t deviceProps = {};
+        deviceProps.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+        if (zeDriverGetProperties(driver, &driverProps) != ZE_RESULT_SUCCESS ||
+            zeDeviceGetProperties(device, &deviceProps) != ZE_RESULT_SUCCESS)
+            return;
+
+        uint64_t hash = 14695981039346656037ULL;
+        addToHash(hash, code.data(), code.size());
+        addToHash(hash, options.data(), options.size());
+        for (const auto &constant : specConstants) {
+            addToHash(hash, &constant.first, sizeof(constant.first));
+            addToHash(hash, constant.second.data(), constant.second.size());
+        }
+        addToHash(hash, &deviceProps.vendorId, sizeof(deviceProps.vendorId));
+        addToHash(hash, &deviceProps.deviceId, sizeof(deviceProps.deviceId));
+        addToHash(hash, deviceProps.uuid.id, sizeof(deviceProps.uuid.id));
+        addToHash(hash, &driverProps.driverVersion, sizeof(driverProps.driverVersion));
+
+        std::stringstream ss;
+        ss << dir << "/ispcrt-" << std::hex << hash << "-" << std::dec << code.size() << ".zebin";
+        m_path = ss.str();
+    }
+
+    bool enabled() const { return !m_path.empty(); }
+
+    // Return the cached native binary or an empty vector if there is none.
+    std::vector<unsigned char> load() const {
+        std::vector<unsigned char> binary;
+        std::ifstream is(m_path, std::ios::binary | std::ios::ate);
+        if (!is.good())
+            return binary;
+        binary.resize((size_t)is.tellg());
+        is.seekg(0, std::ios::beg);
+        if (!is.read((char *)binary.data(), binary.size()))
+            binary.clear();
+        if (UNLIKELY(is_verbose)) {
+            std::cout << "Module cache " << (binary.empty() ? "miss: " : "hit: ") << m_path << std::endl;
+        }
+        return binary;
+    }
+
+    // Store the native binary of the module.  Failures are not fatal, the
+    // module is just compiled again next time.
+    void store(ze_module_handle_t module) const {
+        size_t size = 0;
+        if (zeModuleGetNativeBinary(module, &size, nullptr) != ZE_RESULT_SUCCESS || size == 0)
+            return;
+        std::vector<uint8_t> binary(size);
+        if (zeModuleGetNativeBinary(module, &size, binary.data()) != ZE_RESULT_SUCCESS)
+            return;
+
+        // Write a temporary file first and then rename it, so concurrent
+        // processes never read a partially written entry.
+#if defined(_WIN32) || defined(_WIN64)
+        std::string tmpPath = m_path + ".tmp." + std::to_string(_getpid());
+#else
+        std::string tmpPath = m_path + ".tmp." + std::to_string(getpid());
+#endif
+        {
+            std::ofstream os(tmpPath, std::ios::binary);
+            if (!os.write((const char *)binary.data(), size)) {
+                os.close();
+                std::remove(tmpPath.c_str());
+                return;
+            }
+        }
+        if (std::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+            // Most likely another process has stored the same entry first.
+            std::remove(tmpPath.c_str());
+            return;
+        }
+        if (UNLIKELY(is_verbose)) {
+            std::cout << "Module cache store: " << m_path << std::endl;
+        }
+    }
+
+  private:
+    std::string m_path;
+
+    // FNV-1a hash, the size is added as well, so the key is not ambiguous
+    // when the pieces of data are concatenated.
+    static void addToHash(uint64_t &hash, const void *data, size_t size) {
+        auto addBytes = [&hash](const unsigned char *bytes, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+        };
+        uint64_t size64 = size;
+        addBytes((const unsigned char *)&size64, sizeof(size64));
+        addBytes((const unsigned char *)data, size);
+    }
 };
 
+// Return the contents of the .ze_info section of the zebin, which is a 64-bit
+// little endian ELF file, or an empty string if there is none.
+static std::string getZeInfo(const std::vector<uint8_t> &elf) {
+    auto read = [&elf](size_t offset, size_t size) -> uint64_t {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size && offset + i < elf.size(); i++)
+            value |= (uint64_t)elf[offset + i] << (8 * i);
+        return value;
+    };
+    const uint8_t magic[] = {0x7f, 'E', 'L', 'F', 2 /* 64-bit */, 1 /* little endian */};
+    if (elf.size() < 64 || !std::equal(std::begin(magic), std::end(magic), elf.begin()))
+        return "";
+
+    const uint64_t shOff = read(0x28, 8);
+    const uint64_t shEntSize = read(0x3a, 2);
+    const uint64_t shNum = read(0x3c, 2);
+    const uint64_t shStrNdx = read(0x3e, 2);
+    if (shStrNdx >= shNum || shOff + shNum * shEntSize > elf.size())
+        return "";
+    const uint64_t strTabOff = read(shOff + shStrNdx * shEntSize + 0x18, 8);
+    for (uint64_t i = 0; i < shNum; i++) {
+        const uint64_t sh = shOff + i * shEntSize;
+        const uint64_t nameOff = strTabOff + read(sh, 4);
+        const uint64_t offset = read(sh + 0x18, 8);
+        const uint64_t size = read(sh + 0x20, 8);
+        if (nameOff >= elf.size() || offset + size > elf.size())
+            continue;
+        if (strncmp((const char *)elf.data() + nameOff, ".ze_info", elf.size() - nameOff) == 0)
+            return std::string((const char *)elf.data() + offset, size);
+    }
+    return "";
+}
+
+// Find the kernel in the YAML document of the .ze_info section and fill its
+// resources. Only the few keys of interest are read, so a simple line-based
+// parser is enough. The spill and private sizes are given by the execution
+// environment of the kernel in the newer versions of the format and by its
+// per-thread memory buffers in the older ones.
+static bool parseZeInfo(const std::string &zeInfo, const std::string &name, ISPCRTKernelResources &resources) {
+    bool inKernels = false, found = false;
+    bool hasExecEnvSpill = false, hasExecEnvPrivate = false;
+    std::string bufferUsage;
+    std::istringstream is(zeInfo);
+    std::string line;
+    while (std::getline(is, line)) {
+        size_t indent = line.find_first_not_of(' ');
+        if (indent == std::string::npos)
+            continue;
+        std::string text = line.substr(indent);
+        text.erase(text.find_last_not_of(" \r") + 1);
+        if (indent == 0) {
+            inKernels = text == "kernels:";
+            continue;
+        }
+        if (!inKernels)
+            continue;
+        bool listItem = text.compare(0, 2, "- ") == 0;
+        if (listItem) {
+            text = text.substr(2);
+            bufferUsage.clear();
+        }
+        size_t colon = text.find(':');
+        std::string key = text.substr(0, colon);
+        std::string value = colon == std::string::npos ? "" : text.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" '"));
+        value.erase(value.find_last_not_of(" '") + 1);
+        if (indent == 2 && listItem && key == "name") {
+            // The kernel entries follow each other, so the next one ends
+            // the kernel looked for.
+            if (found)
+                break;
+            found = value == name;
+            if (found)
+                resources = {};
+            continue;
+        }
+        if (!found)
+            continue;
+
+        char *end = nullptr;
+        unsigned long number = strtoul(value.c_str(), &end, 10);
+        bool isNumber = !value.empty() && *end == '\0';
+        if (!isNumber) {
+            if (key == "usage")
+                bufferUsage = value;
+        } else if (key == "grf_count") {
+            resources.grfCount = (uint32_t)number;
+        } else if (key == "slm_size") {
+            resources.slmSize = (uint32_t)number;
+        } else if (key == "spill_size") {
+            resources.spillSize = (uint32_t)number;
+            hasExecEnvSpill = true;
+        } else if (key == "private_size") {
+            resources.privateSize = (uint32_t)number;
+            hasExecEnvPrivate = true;
+        } else if (key == "size") {
+            if (bufferUsage == "spill_fill_space" && !hasExecEnvSpill)
+                resources.spillSize = (uint32_t)number;
+            else if (bufferUsage == "private_space" && !hasExecEnvPrivate)
+                resources.privateSize = (uint32_t)number;
+        }
+    }
+    return found;
+}
+
+// Return the largest of the stack sizes that ISPC computed for the kernels of
+// the SPIR-V module, which are the values of the constant variables named
+// "__ispc_stack_size_<kernel>", or 0 if there are none.
+static uint32_t getSPIRVStackSize(const std::vector<unsigned char> &spirv) {
+    constexpr uint32_t SpvMagicNumber = 0x07230203;
+    constexpr uint32_t SpvOpName = 5;
+    constexpr uint32_t SpvOpConstant = 43;
+    constexpr uint32_t SpvOpVariable = 59;
+    constexpr size_t SpvHeaderWords = 5;
+    const std::string prefix = "__ispc_stack_size_";
+
+    const size_t numWords = spirv.size() / sizeof(uint32_t);
+    if (numWords < SpvHeaderWords)
+        return 0;
+    std::vector<uint32_t> words(numWords);
+    memcpy(words.data(), spirv.data(), numWords * sizeof(uint32_t));
+    if (words[0] != SpvMagicNumber)
+        return 0;
+
+    std::set<uint32_t> variables;
+    std::map<uint32_t, uint32_t> constants;
+    std::map<uint32_t, uint32_t> initializers;
+    for (size_t i = SpvHeaderWords; i < numWords;) {
+        const uint32_t wordCount = words[i] >> 16;
+        const uint32_t opcode = words[i] & 0xffff;
+        if (wordCount == 0 || i + wordCount > numWords)
+            break;
+        if (opcode == SpvOpName && wordCount > 2) {
+            const char *name = (const char *)&words[i + 2];
+            const size_t maxLength = (wordCount - 2) * sizeof(uint32_t);
+            if (maxLength > prefix.size() && strncmp(name, prefix.c_str(), prefix.size()) == 0)
+                variables.insert(words[i + 1]);
+        } else if (opcode == SpvOpConstant && wordCount == 4) {
+            constants[words[i + 2]] = words[i + 3];
+        } else if (opcode == SpvOpVariable && wordCount == 5) {
+            initializers[words[i + 2]] = words[i + 4];
+        }
+        i += wordCount;
+    }
+
+    uint32_t stackSize = 0;
+    for (uint32_t variable : variables) {
+        auto init = initializers.find(variable);
+        if (init == initializers.end())
+            continue;
+        auto constant = constants.find(init->second);
+        if (constant != constants.end())
+            stackSize = std::max(stackSize, constant->second);
+    }
+    return stackSize;
+}
+
 struct Module : public ispcrt::base::Module {
-    Module(ze_device_handle_t device, ze_context_handle_t context, const char *moduleFile, const bool is_mock_dev,
-           const base::ModuleOptions &opts)
+    Module(ze_driver_handle_t driver, ze_device_handle_t device, ze_context_handle_t context, const char *moduleFile,
+           const bool is_mock_dev, const base::ModuleOptions &opts)
         : m_file(moduleFile) {
         m_module_desc.stype = ZE_STRUCTURE_TYPE_MODULE_DESC;
         m_module_desc_exp.stype = ZE_STRUCTURE_TYPE_MODULE_PROGRAM_EXP_DESC;
@@ -1012,81 +1746,47 @@ struct Module : public ispcrt::base::Module {
 
             is.read((char *)m_code.data(), codeSize);
             is.close();
-        }
 
-        // Collect potential additional options for the compiler from the environment.
-        // We assume some default options for the compiler, but we also
-        // allow adding more options by the user. The content of the
-        // ISPCRT_IGC_OPTIONS variable should be prefixed by the user with
-        // + or = sign. '+' means that the content of the variable should
-        // be added to the default igc options, while '=' will replace
-        // the options with the content of the env var.
-        m_igc_options = "";
-        // If scalar module is passed to ISPC Runtime, do not use VC backend
-        // options on it
-        if (opts.moduleType() != ISPCRTModuleType::ISPCRT_SCALAR_MODULE) {
-            m_igc_options += "-vc-codegen -no-optimize -Xfinalizer '-presched' -Xfinalizer '-newspillcostispc'";
-        }
-        // If stackSize has default value 0, do not set -stateless-stack-mem-size,
-        // it will be set to 8192 in VC backend by default.
-        if (opts.stackSize() > 0) {
-            m_igc_options += " -stateless-stack-mem-size=" + std::to_string(opts.stackSize());
-        }
-        // If module is a library for the kernel, add " -library-compilation"
-        if (opts.libraryCompilation()) {
-            m_igc_options += " -library-compilation";
-        }
-        const char *userIgcOptionsEnv = getenv_wr(ISPCRT_IGC_OPTIONS);
-        if (userIgcOptionsEnv) {
-            // Copy at most MAX_ISPCRT_IGC_OPTIONS characters from the env - just to be safe
-            constexpr auto MAX_ISPCRT_IGC_OPTIONS = 2000UL;
-            const auto numCopyChars = strnlen(userIgcOptionsEnv, MAX_ISPCRT_IGC_OPTIONS);
-            std::string userIgcOptions{userIgcOptionsEnv, numCopyChars};
-            if (userIgcOptions.length() >= 3) {
-                auto prefix = userIgcOptions.substr(0, 2);
-                if (prefix == "+ ") {
-                    m_igc_options += ' ' + userIgcOptions.substr(2);
-                } else if (prefix == "= ") {
-                    m_igc_options = userIgcOptions.substr(2);
-                } else {
-                    throw std::runtime_error("Invalid ISPCRT_IGC_OPTIONS string" + userIgcOptions);
-                }
-            } else {
-                throw std::runtime_error("Invalid ISPCRT_IGC_OPTIONS string" + userIgcOptions);
+            if (isFatModule(m_code.data(), m_code.size())) {
+                std::vector<unsigned char> fat;
+                fat.swap(m_code);
+                readFat(fat.data(), fat.size());
+                moduleFormat = ZE_MODULE_FORMAT_IL_SPIRV;
             }
         }
 
-        m_module_desc.format = moduleFormat;
-        m_module_desc.inputSize = codeSize;
-        m_module_desc.pInputModule = m_code.data();
-        m_module_desc.pBuildFlags = m_igc_options.c_str();
-
-        assert(device != nullptr);
-        if (UNLIKELY(is_verbose)) {
-            ze_module_build_log_handle_t hLog = nullptr;
-            size_t size = 0;
-
-            std::cout << "Module " << m_file << " format=" << moduleFormat;
-            std::cout << " size=" << codeSize << std::endl;
-            std::cout << "IGC options: " << m_igc_options << std::endl;
+        build(driver, device, context, moduleFormat, is_mock_dev, opts);
+        if (opts.eagerKernels())
+            createKernels();
+    }
 
-            L0_SAFE_CALL(zeModuleCreate(context, device, &m_module_desc, &m_module, &hLog));
-            L0_SAFE_CALL(zeModuleBuildLogGetString(hLog, &size, nullptr));
-            if (size > 0) {
-                std::vector<char> log(size);
-                L0_SAFE_CALL(zeModuleBuildLogGetString(hLog, &size, log.data()));
+    // The module is built from the SPIR-V or native binary in memory, which is
+    // told apart by its magic number.
+    Module(ze_driver_handle_t driver, ze_device_handle_t device, ze_context_handle_t context, const void *data,
+           size_t size, const bool is_mock_dev, const base::ModuleOptions &opts)
+        : m_file("<memory>") {
+        m_module_desc.stype = ZE_STRUCTURE_TYPE_MODULE_DESC;
+        m_module_desc_exp.stype = ZE_STRUCTURE_TYPE_MODULE_PROGRAM_EXP_DESC;
 
-                std::cout << "Build log (" << size << "): " << log.data() << std::endl;
-                L0_SAFE_CALL(zeModuleBuildLogDestroy(hLog));
-            } else {
-                std::cout << "Build log is empty" << std::endl;
-            }
+        const uint32_t SPIRV_MAGIC = 0x07230203;
+        const unsigned char ELF_MAGIC[] = {0x7f, 'E', 'L', 'F'};
+        ze_module_format_t moduleFormat = ZE_MODULE_FORMAT_IL_SPIRV;
+        uint32_t magic = 0;
+        if (size >= sizeof(magic))
+            memcpy(&magic, data, sizeof(magic));
+        if (isFatModule(data, size)) {
+            readFat((const unsigned char *)data, size);
         } else {
-            L0_SAFE_CALL(zeModuleCreate(context, device, &m_module_desc, &m_module, nullptr));
+            if (size >= sizeof(ELF_MAGIC) && memcmp(data, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0)
+                moduleFormat = ZE_MODULE_FORMAT_NATIVE;
+            else if (magic != SPIRV_MAGIC && !is_mock_dev)
+                throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "The module is neither SPIR-V, zebin nor fat module");
+            m_code.assign((const unsigned char *)data, (const unsigned char *)data + size);
         }
-
-        if (m_module == nullptr)
-            throw std::runtime_error("Failed to load spv module!");
+        build(driver, device, context, moduleFormat, is_mock_dev, opts);
+        if (opts.eagerKernels())
+            createKernels();
     }
 
     Module(ze_device_handle_t device, ze_context_handle_t context, Module **modules, const uint32_t numModules) {
@@ -1098,10 +1798,12 @@ struct Module : public ispcrt::base::Module {
         std::vector<const char *> buildFlags;
         std::vector<size_t> inputSizes;
         std::vector<const uint8_t *> inputModules;
+        std::vector<const ze_module_constants_t *> constants;
         for (uint32_t i = 0; i < numModules; i++) {
             buildFlags.push_back(modules[i]->m_module_desc.pBuildFlags);
             inputSizes.push_back(modules[i]->m_module_desc.inputSize);
             inputModules.push_back(modules[i]->m_module_desc.pInputModule);
+            constants.push_back(modules[i]->m_module_desc.pConstants);
         }
 
         m_module_desc_exp.count = numModules;
@@ -1109,7 +1811,7 @@ struct Module : public ispcrt::base::Module {
         m_module_desc_exp.pInputModules = inputModules.data();
         m_module_desc_exp.pBuildFlags = buildFlags.data();
         m_module_desc_exp.pNext = nullptr;
-        m_module_desc_exp.pConstants = nullptr;
+        m_module_desc_exp.pConstants = constants.data();
 
         m_module_desc.pNext = &m_module_desc_exp;
         m_module_desc.format = useZEBinFormat ? ZE_MODULE_FORMAT_NATIVE : ZE_MODULE_FORMAT_IL_SPIRV;
@@ -1138,6 +1840,8 @@ struct Module : public ispcrt::base::Module {
             throw std::runtime_error("Failed to create module!");
     }
     ~Module() {
+        for (auto &kernel : m_eagerKernels)
+            L0_SAFE_CALL_NOEXCEPT(zeKernelDestroy(kernel.second));
         if (m_module)
             L0_SAFE_CALL_NOEXCEPT(zeModuleDestroy(m_module));
     }
@@ -1145,36 +1849,357 @@ struct Module : public ispcrt::base::Module {
     ze_module_handle_t handle() const { return m_module; }
 
     void *functionPtr(const char *name) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_functions.find(name);
+        if (it != m_functions.end())
+            return it->second;
         void *fptr = nullptr;
         L0_SAFE_CALL(zeModuleGetFunctionPointer(m_module, name, &fptr));
         if (!fptr)
             throw std::logic_error("could not find GPU function");
+        m_functions.emplace(name, fptr);
         return fptr;
     }
 
+    const std::vector<std::string> &kernelNames() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_kernelNamesKnown) {
+            uint32_t count = 0;
+            L0_SAFE_CALL(zeModuleGetKernelNames(m_module, &count, nullptr));
+            std::vector<const char *> names(count);
+            if (count > 0) {
+                L0_SAFE_CALL(zeModuleGetKernelNames(m_module, &count, names.data()));
+            }
+            m_kernelNames.assign(names.begin(), names.end());
+            m_kernelNamesKnown = true;
+        }
+        return m_kernelNames;
+    }
+
+    // Return the handle of the kernel created at load, which the caller owns
+    // from now on, or nullptr.
+    ze_kernel_handle_t takeKernel(const std::string &name) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_eagerKernels.find(name);
+        if (it == m_eagerKernels.end())
+            return nullptr;
+        ze_kernel_handle_t kernel = it->second;
+        m_eagerKernels.erase(it);
+        return kernel;
+    }
+
+    bool kernelResources(const char *name, ISPCRTKernelResources &resources) const override {
+        size_t size = 0;
+        L0_SAFE_CALL(zeModuleGetNativeBinary(m_module, &size, nullptr));
+        std::vector<uint8_t> binary(size);
+        if (size > 0)
+            L0_SAFE_CALL(zeModuleGetNativeBinary(m_module, &size, binary.data()));
+        return parseZeInfo(getZeInfo(binary), name, resources);
+    }
+
     std::string filename() { return m_file; }
 
   private:
+    // Build the module from m_code.
+    void build(ze_driver_handle_t driver, ze_device_handle_t device, ze_context_handle_t context,
+               ze_module_format_t moduleFormat, const bool is_mock_dev, const base::ModuleOptions &opts) {
+        const size_t codeSize = m_code.size();
+
+        // Collect potential additional options for the compiler from the environment.
+        // We assume some default options for the compiler, but we also
+        // allow adding more options by the user. The content of the
+        // ISPCRT_IGC_OPTIONS variable should be prefixed by the user with
+        // + or = sign. '+' means that the content of the variable should
+        // be added to the default igc options, while '=' will replace
+        // the options with the content of the env var.
+        m_igc_options = "";
+        // If scalar module is passed to ISPC Runtime, do not use VC backend
+        // options on it
+        if (opts.moduleType() != ISPCRTModuleType::ISPCRT_SCALAR_MODULE) {
+            m_igc_options += "-vc-codegen -no-optimize -Xfinalizer '-presched' -Xfinalizer '-newspillcostispc'";
+        }
+        // If stackSize has default value 0, use the stack size that ISPC
+        // computed for the kernels of the module. If there is none, do not set
+        // -stateless-stack-mem-size, it will be set to 8192 in VC backend by default.
+        uint32_t stackSize = opts.stackSize();
+        if (stackSize == 0 && moduleFormat == ZE_MODULE_FORMAT_IL_SPIRV)
+            stackSize = getSPIRVStackSize(m_code);
+        if (stackSize > 0) {
+            m_igc_options += " -stateless-stack-mem-size=" + std::to_string(stackSize);
+        }
+        // If module is a library for the kernel, add " -library-compilation"
+        if (opts.libraryCompilation()) {
+            m_igc_options += " -library-compilation";
+        }
+        const char *userIgcOptionsEnv = getenv_wr(ISPCRT_IGC_OPTIONS);
+        if (userIgcOptionsEnv) {
+            // Copy at most MAX_ISPCRT_IGC_OPTIONS characters from the env - just to be safe
+            constexpr auto MAX_ISPCRT_IGC_OPTIONS = 2000UL;
+            const auto numCopyChars = strnlen(userIgcOptionsEnv, MAX_ISPCRT_IGC_OPTIONS);
+            std::string userIgcOptions{userIgcOptionsEnv, numCopyChars};
+            if (userIgcOptions.length() >= 3) {
+                auto prefix = userIgcOptions.substr(0, 2);
+                if (prefix == "+ ") {
+                    m_igc_options += ' ' + userIgcOptions.substr(2);
+                } else if (prefix == "= ") {
+                    m_igc_options = userIgcOptions.substr(2);
+                } else {
+                    throw std::runtime_error("Invalid ISPCRT_IGC_OPTIONS string" + userIgcOptions);
+                }
+            } else {
+                throw std::runtime_error("Invalid ISPCRT_IGC_OPTIONS string" + userIgcOptions);
+            }
+        }
+
+        m_module_desc.format = moduleFormat;
+        m_module_desc.inputSize = codeSize;
+        m_module_desc.pInputModule = m_code.data();
+        m_module_desc.pBuildFlags = m_igc_options.c_str();
+
+        // The specialization constants are folded in by the compilation of
+        // the SPIR-V code, the native binaries have the default values.
+        if (moduleFormat == ZE_MODULE_FORMAT_IL_SPIRV && !opts.specConstants().empty()) {
+            m_specConstants = opts.specConstants();
+            for (const auto &constant : m_specConstants) {
+                m_specConstantIds.push_back(constant.first);
+                m_specConstantValues.push_back(constant.second.data());
+            }
+            m_module_constants.numConstants = (uint32_t)m_specConstantIds.size();
+            m_module_constants.pConstantIds = m_specConstantIds.data();
+            m_module_constants.pConstantValues = m_specConstantValues.data();
+            m_module_desc.pConstants = &m_module_constants;
+        }
+
+        assert(device != nullptr);
+        // The zebins of the fat module are skipped for the specialized
+        // SPIR-V code.
+        if (m_fat && (m_specConstants.empty() || m_code.empty())) {
+            if (createFromFat(context, device))
+                return;
+            if (m_code.empty())
+                throw std::runtime_error("The fat module has neither binary for the device nor SPIR-V code!");
+        }
+
+        ModuleCache cache(driver, device, m_code, m_igc_options, m_specConstants);
+        const bool useCache = !is_mock_dev && moduleFormat == ZE_MODULE_FORMAT_IL_SPIRV && cache.enabled();
+        if (useCache && createFromCache(context, device, cache))
+            return;
+
+        if (UNLIKELY(is_verbose)) {
+            ze_module_build_log_handle_t hLog = nullptr;
+            size_t size = 0;
+
+            std::cout << "Module " << m_file << " format=" << moduleFormat;
+            std::cout << " size=" << codeSize << std::endl;
+            std::cout << "IGC options: " << m_igc_options << std::endl;
+            if (!m_specConstants.empty())
+                std::cout << "Specialization constants: " << m_specConstants.size() << std::endl;
+
+            L0_SAFE_CALL(zeModuleCreate(context, device, &m_module_desc, &m_module, &hLog));
+            L0_SAFE_CALL(zeModuleBuildLogGetString(hLog, &size, nullptr));
+            if (size > 0) {
+                std::vector<char> log(size);
+                L0_SAFE_CALL(zeModuleBuildLogGetString(hLog, &size, log.data()));
+
+                std::cout << "Build log (" << size << "): " << log.data() << std::endl;
+                L0_SAFE_CALL(zeModuleBuildLogDestroy(hLog));
+            } else {
+                std::cout << "Build log is empty" << std::endl;
+            }
+        } else {
+            L0_SAFE_CALL(zeModuleCreate(context, device, &m_module_desc, &m_module, nullptr));
+        }
+
+        if (m_module == nullptr)
+            throw std::runtime_error("Failed to load spv module!");
+
+        if (useCache)
+            cache.store(m_module);
+    }
+
+    // Create the module from the cached native binary.  m_module_desc still
+    // describes the SPIR-V code, which is needed for linking of the modules.
+    bool createFromCache(ze_context_handle_t context, ze_device_handle_t device, const ModuleCache &cache) {
+        std::vector<unsigned char> binary = cache.load();
+        if (binary.empty())
+            return false;
+
+        ze_module_desc_t nativeDesc = m_module_desc;
+        nativeDesc.format = ZE_MODULE_FORMAT_NATIVE;
+        nativeDesc.inputSize = binary.size();
+        nativeDesc.pInputModule = binary.data();
+        nativeDesc.pBuildFlags = "";
+        nativeDesc.pConstants = nullptr;
+        // The stale or corrupted entry is not fatal, the SPIR-V code is
+        // compiled instead.
+        ze_module_handle_t module = nullptr;
+        if (zeModuleCreate(context, device, &nativeDesc, &module, nullptr) != ZE_RESULT_SUCCESS || module == nullptr)
+            return false;
+        m_module = module;
+        return true;
+    }
+
+    // Create the handles of all the kernels for the eager module.
+    void createKernels() {
+        for (const auto &name : kernelNames()) {
+            ze_kernel_handle_t kernel = nullptr;
+            ze_kernel_desc_t kernelDesc = {};
+            kernelDesc.pKernelName = name.c_str();
+            L0_SAFE_CALL(zeKernelCreate(m_module, &kernelDesc, &kernel));
+            if (kernel != nullptr)
+                m_eagerKernels.emplace(name, kernel);
+        }
+    }
+
+    // The fat module written by ispc with --xe-devices is the magic, the
+    // number of the entries and the entries, each of them the format (0 for
+    // SPIR-V, 1 for zebin), the length and the name of the device and the
+    // size and the data of the binary, all little-endian and 32-bit except
+    // for the 64-bit size of the binary.
+    static bool isFatModule(const void *data, size_t size) {
+        return size >= sizeof(FAT_MAGIC) && memcmp(data, FAT_MAGIC, sizeof(FAT_MAGIC)) == 0;
+    }
+
+    // Keep the zebins of the fat module in m_fatBinaries and its SPIR-V code
+    // in m_code.
+    void readFat(const unsigned char *data, size_t size) {
+        size_t pos = sizeof(FAT_MAGIC);
+        auto need = [&](uint64_t bytes) {
+            if (size - pos < bytes)
+                throw base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "The fat module is truncated");
+        };
+        auto read = [&](unsigned bytes) {
+            need(bytes);
+            uint64_t value = 0;
+            for (unsigned i = 0; i < bytes; i++)
+                value |= (uint64_t)data[pos + i] << (8 * i);
+            pos += bytes;
+            return value;
+        };
+        m_fat = true;
+        const uint64_t count = read(4);
+        for (uint64_t i = 0; i < count; i++) {
+            const uint64_t format = read(4);
+            const uint64_t nameSize = read(4);
+            need(nameSize);
+            std::string device((const char *)data + pos, nameSize);
+            pos += nameSize;
+            const uint64_t binarySize = read(8);
+            need(binarySize);
+            std::vector<unsigned char> binary(data + pos, data + pos + binarySize);
+            pos += binarySize;
+            // The entries of unknown formats are skipped.
+            if (format == 0)
+                m_code = std::move(binary);
+            else if (format == 1)
+                m_fatBinaries.emplace_back(device, std::move(binary));
+        }
+    }
+
+    // Create the module from the first zebin of the fat module, which the
+    // driver accepts for the device.  As with the cache, m_module_desc still
+    // describes the SPIR-V code.
+    bool createFromFat(ze_context_handle_t context, ze_device_handle_t device) {
+        for (const auto &binary : m_fatBinaries) {
+            ze_module_desc_t nativeDesc = m_module_desc;
+            nativeDesc.format = ZE_MODULE_FORMAT_NATIVE;
+            nativeDesc.inputSize = binary.second.size();
+            nativeDesc.pInputModule = binary.second.data();
+            nativeDesc.pBuildFlags = "";
+            nativeDesc.pConstants = nullptr;
+            ze_module_handle_t module = nullptr;
+            if (zeModuleCreate(context, device, &nativeDesc, &module, nullptr) == ZE_RESULT_SUCCESS &&
+                module != nullptr) {
+                if (UNLIKELY(is_verbose)) {
+                    std::cout << "Module " << m_file << " uses the zebin for " << binary.first << std::endl;
+                }
+                m_module = module;
+                break;
+            }
+        }
+        m_fatBinaries.clear();
+        return m_module != nullptr;
+    }
+
+    static constexpr char FAT_MAGIC[8] = {'I', 'S', 'P', 'C', 'F', 'A', 'T', '1'};
+
     std::string m_file;
     std::vector<unsigned char> m_code;
+    // The zebins of the fat module by device, which are tried before the
+    // SPIR-V code in m_code.
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> m_fatBinaries;
+    bool m_fat{false};
 
     ze_module_desc_t m_module_desc{};
     ze_module_program_exp_desc_t m_module_desc_exp{};
     ze_module_handle_t m_module{nullptr};
 
     std::string m_igc_options;
+
+    // The specialization constants of the SPIR-V code, which
+    // m_module_desc.pConstants points to.
+    std::map<uint32_t, std::vector<uint8_t>> m_specConstants;
+    std::vector<uint32_t> m_specConstantIds;
+    std::vector<const void *> m_specConstantValues;
+    ze_module_constants_t m_module_constants{};
+
+    // The lookups of the functions and the kernels are cached.
+    mutable std::mutex m_mutex;
+    mutable std::unordered_map<std::string, void *> m_functions;
+    mutable std::vector<std::string> m_kernelNames;
+    mutable bool m_kernelNamesKnown{false};
+    mutable std::map<std::string, ze_kernel_handle_t> m_eagerKernels;
 };
 
+// Return the vector widths of the variants of the kernel compiled with
+// --xe-kernel-widths, which are named "<name>__x<width>", in ascending order.
+static std::vector<uint32_t> getKernelWidthVariants(const Module &module, const std::string &name) {
+    const std::string prefix = name + "__x";
+    std::vector<uint32_t> widths;
+    for (const std::string &n : module.kernelNames()) {
+        if (n.size() > prefix.size() && n.compare(0, prefix.size(), prefix) == 0 &&
+            n.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+            widths.push_back((uint32_t)std::stoul(n.substr(prefix.size())));
+        }
+    }
+    std::sort(widths.begin(), widths.end());
+    return widths;
+}
+
+static ze_kernel_handle_t createKernel(const Module &module, const std::string &name) {
+    ze_kernel_handle_t kernel = module.takeKernel(name);
+    if (kernel != nullptr)
+        return kernel;
+    ze_kernel_desc_t kernelDesc = {};
+    kernelDesc.pKernelName = name.c_str();
+    L0_SAFE_CALL(zeKernelCreate(module.handle(), &kernelDesc, &kernel));
+
+    if (kernel == nullptr)
+        throw std::runtime_error("Failed to load kernel!");
+    return kernel;
+}
+
 struct Kernel : public ispcrt::base::Kernel {
-    Kernel(const ispcrt::base::Module &_module, const char *name) : m_fcnName(name), m_module(&_module) {
+    Kernel(const ispcrt::base::Module &_module, const char *name, uint32_t width)
+        : m_fcnName(name), m_module(&_module) {
         const gpu::Module &module = (const gpu::Module &)_module;
 
-        ze_kernel_desc_t kernelDesc = {};
-        kernelDesc.pKernelName = name;
-        L0_SAFE_CALL(zeKernelCreate(module.handle(), &kernelDesc, &m_kernel));
-
-        if (m_kernel == nullptr)
-            throw std::runtime_error("Failed to load kernel!");
+        std::vector<uint32_t> widths = getKernelWidthVariants(module, m_fcnName);
+        if (widths.empty()) {
+            if (width != 0)
+                throw ispcrt::base::ispcrt_runtime_error(
+                    ISPCRT_INVALID_ARGUMENT, "Kernel \"" + m_fcnName + "\" has no variants for several widths.");
+            m_kernel = createKernel(module, m_fcnName);
+        } else if (width != 0) {
+            if (std::find(widths.begin(), widths.end(), width) == widths.end())
+                throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                         "Kernel \"" + m_fcnName + "\" has no variant with width " +
+                                                             std::to_string(width) + ".");
+            m_kernel = createKernel(module, m_fcnName + "__x" + std::to_string(width));
+            m_width = width;
+        } else {
+            selectWidthVariant(module, widths);
+        }
 
         // Set device/shared indirect flags
         ze_kernel_indirect_access_flags_t kernel_flags =
@@ -1187,22 +2212,106 @@ struct Kernel : public ispcrt::base::Kernel {
 
     ~Kernel() {
         L0_SAFE_CALL_NOEXCEPT(zeKernelDestroy(m_kernel));
-        if (m_module)
+        if (m_module) {
+            m_module->forgetKernel(this);
             m_module->refDec();
+        }
     }
 
     ze_kernel_handle_t handle() const { return m_kernel; }
 
+    // The arguments and the group size are state of the kernel handle, which
+    // the appended launch captures, so the threads launching the kernel hold
+    // the lock from setting them until the launch is appended.
+    std::mutex &launchMutex() { return m_launchMutex; }
+
+    uint32_t width() const override { return m_width; }
+
+    void setGroupSize(uint32_t x, uint32_t y, uint32_t z) override {
+        if (x == 0 || y == 0 || z == 0)
+            m_pinnedGroupSize = {0, 0, 0};
+        else
+            m_pinnedGroupSize = {x, y, z};
+    }
+
+    // Return the group size for the launch and set it to the kernel, if it
+    // differs from the current one. The group size suggested by the driver is
+    // cached per launch dimensions, since zeKernelSuggestGroupSize is not
+    // cheap and steady state loops launch the kernel with the same dimensions.
+    const std::array<uint32_t, 3> &prepareGroupSize(size_t dim0, size_t dim1, size_t dim2) {
+        const std::array<uint32_t, 3> *groupSize = &m_pinnedGroupSize;
+        if (m_pinnedGroupSize[0] == 0) {
+            const std::array<uint32_t, 3> dims = {uint32_t(dim0), uint32_t(dim1), uint32_t(dim2)};
+            auto it = m_suggestedGroupSizes.find(dims);
+            if (it == m_suggestedGroupSizes.end()) {
+                std::array<uint32_t, 3> suggested = {0};
+                L0_SAFE_CALL(zeKernelSuggestGroupSize(m_kernel, dims[0], dims[1], dims[2], &suggested[0],
+                                                      &suggested[1], &suggested[2]));
+                // TODO: Is this needed? Didn't find info in spec on the valid values that zeKernelSuggestGroupSize
+                // will return
+                suggested[0] = std::max(suggested[0], uint32_t(1));
+                suggested[1] = std::max(suggested[1], uint32_t(1));
+                suggested[2] = std::max(suggested[2], uint32_t(1));
+                it = m_suggestedGroupSizes.emplace(dims, suggested).first;
+            }
+            groupSize = &it->second;
+        }
+
+        if (*groupSize != m_currentGroupSize) {
+            L0_SAFE_CALL(zeKernelSetGroupSize(m_kernel, (*groupSize)[0], (*groupSize)[1], (*groupSize)[2]));
+            m_currentGroupSize = *groupSize;
+        }
+        return m_currentGroupSize;
+    }
+
   private:
+    // Create the variants of the kernel and keep the widest one that doesn't
+    // spill registers, or the one with the smallest spill size if all of
+    // them do, as reported by the driver.
+    void selectWidthVariant(const Module &module, const std::vector<uint32_t> &widths) {
+        uint32_t bestSpill = std::numeric_limits<uint32_t>::max();
+        for (uint32_t w : widths) {
+            ze_kernel_handle_t kernel = createKernel(module, m_fcnName + "__x" + std::to_string(w));
+            ze_kernel_properties_t props = {};
+            props.stype = ZE_STRUCTURE_TYPE_KERNEL_PROPERTIES;
+            L0_SAFE_CALL(zeKernelGetProperties(kernel, &props));
+            // The widths are in ascending order, so the wider variant wins
+            // the ties.
+            if (props.spillMemSize <= bestSpill) {
+                if (m_kernel != nullptr)
+                    L0_SAFE_CALL(zeKernelDestroy(m_kernel));
+                m_kernel = kernel;
+                m_width = w;
+                bestSpill = props.spillMemSize;
+            } else {
+                L0_SAFE_CALL(zeKernelDestroy(kernel));
+            }
+        }
+    }
+
     std::string m_fcnName;
 
     const ispcrt::base::Module *m_module{nullptr};
     ze_kernel_handle_t m_kernel{nullptr};
+    std::mutex m_launchMutex;
+    // The width of the selected variant, 0 if the kernel has no variants.
+    uint32_t m_width{0};
+
+    // The group size set by the user, all zeros if it is not set.
+    std::array<uint32_t, 3> m_pinnedGroupSize{0, 0, 0};
+    // The group size currently set to the kernel handle.
+    std::array<uint32_t, 3> m_currentGroupSize{0, 0, 0};
+    std::map<std::array<uint32_t, 3>, std::array<uint32_t, 3>> m_suggestedGroupSizes;
 };
 
+// The appended commands are recorded as well, so the closed list can be
+// submitted any number of times and, when a launch is updated with new
+// parameters by updateLaunch(), the list is rebuilt from the recording at the
+// next submit() without the user re-recording it.
 struct CommandListImpl : ispcrt::base::CommandList {
-    CommandListImpl(ze_device_handle_t hDev, ze_context_handle_t hCtx, ze_command_queue_handle_t hQ, uint32_t ordinal)
-        : m_q(hQ) {
+    CommandListImpl(ze_device_handle_t hDev, ze_context_handle_t hCtx, ze_command_queue_handle_t hQ, uint32_t ordinal,
+                    FencePool &fences, std::mutex &submitMutex)
+        : m_device(hDev), m_q(hQ), m_fencePool(fences), m_submitMutex(submitMutex) {
         ze_command_list_desc_t desc = {};
         desc.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
         desc.pNext = nullptr;
@@ -1218,37 +2327,85 @@ struct CommandListImpl : ispcrt::base::CommandList {
     ~CommandListImpl() {
         clearFences();
         clearFutures();
+        clearCommands();
         L0_SAFE_CALL_NOEXCEPT(zeCommandListDestroy(m_handle));
     }
 
-    void barrier() override { L0_SAFE_CALL(zeCommandListAppendBarrier(m_handle, nullptr, 0, nullptr)); }
+    void barrier() override {
+        record([this]() { L0_SAFE_CALL(zeCommandListAppendBarrier(m_handle, nullptr, 0, nullptr)); });
+    }
 
     ispcrt::base::Future *copyToHost(ispcrt::base::MemoryView &mv) override {
         auto &view = (gpu::MemoryView &)mv;
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view.hostPtr(), view.devicePtr(), view.numBytes(), nullptr,
-                                                   0, nullptr));
-        // TODO! Support timestamp events.
         Future *f = new Future();
         m_futures.push_back(f);
+        if (view.isZeroCopy())
+            return f;
+        retain(&view);
+        record([this, &view]() {
+            L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view.hostPtr(), view.devicePtr(), view.numBytes(),
+                                                       nullptr, 0, nullptr));
+        });
+        // TODO! Support timestamp events.
         return f;
     }
 
     ispcrt::base::Future *copyToDevice(ispcrt::base::MemoryView &mv) override {
         auto &view = (gpu::MemoryView &)mv;
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view.devicePtr(), view.hostPtr(), view.numBytes(), nullptr,
-                                                   0, nullptr));
-        // TODO! Support timestamp events.
         Future *f = new Future();
         m_futures.push_back(f);
+        if (view.isZeroCopy())
+            return f;
+        retain(&view);
+        record([this, &view]() {
+            L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view.devicePtr(), view.hostPtr(), view.numBytes(),
+                                                       nullptr, 0, nullptr));
+        });
+        // TODO! Support timestamp events.
         return f;
     }
 
+    // Only the shared memory migrates between the host and the device.
+    void prefetch(base::MemoryView &mv, size_t size) override {
+        auto &view = (gpu::MemoryView &)mv;
+        if (!view.isShared())
+            return;
+        retain(&view);
+        record([this, &view, size]() {
+            L0_SAFE_CALL(zeCommandListAppendMemoryPrefetch(m_handle, view.devicePtr(), size));
+        });
+    }
+
+    void memAdvise(base::MemoryView &mv, ISPCRTMemAdvice advice) override {
+        auto &view = (gpu::MemoryView &)mv;
+        if (!view.isShared())
+            return;
+        static const std::map<ISPCRTMemAdvice, ze_memory_advice_t> zeAdvices = {
+            {ISPCRT_MEM_ADVICE_SET_READ_MOSTLY, ZE_MEMORY_ADVICE_SET_READ_MOSTLY},
+            {ISPCRT_MEM_ADVICE_CLEAR_READ_MOSTLY, ZE_MEMORY_ADVICE_CLEAR_READ_MOSTLY},
+            {ISPCRT_MEM_ADVICE_SET_PREFERRED_LOCATION, ZE_MEMORY_ADVICE_SET_PREFERRED_LOCATION},
+            {ISPCRT_MEM_ADVICE_CLEAR_PREFERRED_LOCATION, ZE_MEMORY_ADVICE_CLEAR_PREFERRED_LOCATION},
+            {ISPCRT_MEM_ADVICE_SET_NON_ATOMIC_MOSTLY, ZE_MEMORY_ADVICE_SET_NON_ATOMIC_MOSTLY},
+            {ISPCRT_MEM_ADVICE_CLEAR_NON_ATOMIC_MOSTLY, ZE_MEMORY_ADVICE_CLEAR_NON_ATOMIC_MOSTLY},
+        };
+        const ze_memory_advice_t zeAdvice = zeAdvices.at(advice);
+        retain(&view);
+        record([this, &view, zeAdvice]() {
+            L0_SAFE_CALL(
+                zeCommandListAppendMemAdvise(m_handle, m_device, view.devicePtr(), view.numBytes(), zeAdvice));
+        });
+    }
+
     ispcrt::base::Future *copyMemoryView(base::MemoryView &mv_dst, base::MemoryView &mv_src,
                                          const size_t size) override {
         auto &view_dst = (gpu::MemoryView &)mv_dst;
         auto &view_src = (gpu::MemoryView &)mv_src;
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view_dst.devicePtr(), view_src.devicePtr(), size, nullptr,
-                                                   0, nullptr));
+        retain(&view_dst);
+        retain(&view_src);
+        record([this, &view_dst, &view_src, size]() {
+            L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_handle, view_dst.devicePtr(), view_src.devicePtr(), size,
+                                                       nullptr, 0, nullptr));
+        });
         // TODO! Support timestamp events.
         Future *f = new Future();
         m_futures.push_back(f);
@@ -1258,36 +2415,44 @@ struct CommandListImpl : ispcrt::base::CommandList {
     ispcrt::base::Future *launch(ispcrt::base::Kernel &k, ispcrt::base::MemoryView *params, size_t dim0, size_t dim1,
                                  size_t dim2) override {
         auto &kernel = (gpu::Kernel &)k;
+        retain(&kernel);
 
-        void *param_ptr = nullptr;
-        if (params)
-            param_ptr = params->devicePtr();
-
-        // If param_ptr is nullptr, it was not set on host, so do not set kernel argument.
-        if (param_ptr != nullptr) {
-            L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), 0, sizeof(void *), &param_ptr));
-        }
-
-        std::array<uint32_t, 3> groupSize = {0};
-        L0_SAFE_CALL(zeKernelSuggestGroupSize(kernel.handle(), uint32_t(dim0), uint32_t(dim1), uint32_t(dim2),
-                                              &groupSize[0], &groupSize[1], &groupSize[2]));
-        // TODO: Is this needed? Didn't find info in spec on the valid values that zeKernelSuggestGroupSize will return
-        groupSize[0] = std::max(groupSize[0], uint32_t(1));
-        groupSize[1] = std::max(groupSize[1], uint32_t(1));
-        groupSize[2] = std::max(groupSize[2], uint32_t(1));
+        // TODO! Support timestamp events.
+        Future *f = new Future();
+        m_launches.push_back({f, nullptr});
+        Launch *launch = &m_launches.back();
+        setLaunchParams(*launch, params);
+
+        record([this, &kernel, launch, dim0, dim1, dim2]() {
+            std::lock_guard<std::mutex> lock(kernel.launchMutex());
+            // If params is nullptr, it was not set on host, so do not set kernel argument.
+            if (launch->params != nullptr) {
+                L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), 0, sizeof(void *), &launch->params));
+            }
 
-        L0_SAFE_CALL(zeKernelSetGroupSize(kernel.handle(), groupSize[0], groupSize[1], groupSize[2]));
+            const std::array<uint32_t, 3> groupSize = kernel.prepareGroupSize(dim0, dim1, dim2);
 
-        const ze_group_count_t dispatchTraits = {uint32_t(dim0) / groupSize[0], uint32_t(dim1) / groupSize[1],
-                                                 uint32_t(dim2) / groupSize[2]};
+            const ze_group_count_t dispatchTraits = {uint32_t(dim0) / groupSize[0], uint32_t(dim1) / groupSize[1],
+                                                     uint32_t(dim2) / groupSize[2]};
 
-        L0_SAFE_CALL(zeCommandListAppendLaunchKernel(m_handle, kernel.handle(), &dispatchTraits, nullptr, 0, nullptr));
-        // TODO! Support timestamp events.
-        Future *f = new Future();
+            L0_SAFE_CALL(
+                zeCommandListAppendLaunchKernel(m_handle, kernel.handle(), &dispatchTraits, nullptr, 0, nullptr));
+        });
         m_futures.push_back(f);
         return f;
     }
 
+    void updateLaunch(ispcrt::base::Future &future, ispcrt::base::MemoryView *params) override {
+        for (auto &launch : m_launches) {
+            if (launch.future == &future) {
+                setLaunchParams(launch, params);
+                m_outdated = true;
+                return;
+            }
+        }
+        throw std::logic_error("the future is not returned by a kernel launch of the command list");
+    }
+
     void close() override {
         if (!m_closed) {
             L0_SAFE_CALL(zeCommandListClose(m_handle));
@@ -1296,19 +2461,28 @@ struct CommandListImpl : ispcrt::base::CommandList {
     }
 
     ispcrt::base::Fence *submit() override {
+        if (m_outdated)
+            rebuild();
         close();
+        releaseSignaledFences();
 
-        Fence *fence = new Fence(m_q);
+        Fence *fence = m_fencePool.acquire();
         m_fences.push_back(fence);
         ze_fence_handle_t hFence = (ze_fence_handle_t)fence->nativeHandle();
-        L0_SAFE_CALL(zeCommandQueueExecuteCommandLists(m_q, 1, &m_handle, hFence));
+        {
+            // The queue must not be executing lists from several threads at once.
+            std::lock_guard<std::mutex> lock(m_submitMutex);
+            L0_SAFE_CALL(zeCommandQueueExecuteCommandLists(m_q, 1, &m_handle, hFence));
+        }
         return fence;
     }
 
     void reset() override {
         m_closed = false;
+        m_outdated = false;
         clearFences();
         clearFutures();
+        clearCommands();
         L0_SAFE_CALL(zeCommandListReset(m_handle));
     }
 
@@ -1317,16 +2491,90 @@ struct CommandListImpl : ispcrt::base::CommandList {
 
     void *nativeHandle() const override { return m_handle; }
 
+    // All the submissions of the list have completed.
+    bool idle() const {
+        for (const auto &f : m_fences) {
+            if (f->status() != ISPCRT_FENCE_SIGNALED)
+                return false;
+        }
+        return true;
+    }
+
   private:
+    struct Launch {
+        Future *future;
+        void *params;
+    };
+
     ze_command_list_handle_t m_handle{nullptr};
+    ze_device_handle_t m_device{nullptr};
     ze_command_queue_handle_t m_q{nullptr};
+    FencePool &m_fencePool;
+    std::mutex &m_submitMutex;
 
     bool m_closed{false};
     bool m_timestamps{false};
+    // A launch was updated after its command was appended.
+    bool m_outdated{false};
 
     std::vector<Future *> m_futures;
     std::vector<Fence *> m_fences;
 
+    // The recorded commands, each of them appends itself to m_handle.
+    std::vector<std::function<void()>> m_commands;
+    // std::deque keeps the addresses of launches used by the commands stable.
+    std::deque<Launch> m_launches;
+    // Kernels and memory views used by the recorded commands.
+    std::vector<RefCounted *> m_retained;
+
+    void record(std::function<void()> &&command) {
+        if (m_outdated)
+            rebuild();
+        command();
+        m_commands.push_back(std::move(command));
+    }
+
+    void retain(RefCounted *object) {
+        object->refInc();
+        m_retained.push_back(object);
+    }
+
+    void setLaunchParams(Launch &launch, ispcrt::base::MemoryView *params) {
+        if (params)
+            retain(params);
+        launch.params = params ? params->devicePtr() : nullptr;
+    }
+
+    // Append the recorded commands again with the updated launch parameters
+    // (kernel arguments are captured when the launch is appended). The list
+    // must not be executed meanwhile, so wait for the previous submissions.
+    void rebuild() {
+        for (const auto &f : m_fences) {
+            f->sync();
+        }
+        const bool closed = m_closed;
+        L0_SAFE_CALL(zeCommandListReset(m_handle));
+        m_closed = false;
+        m_outdated = false;
+        for (auto &command : m_commands) {
+            command();
+        }
+        if (closed)
+            close();
+    }
+
+    // The fences of the completed submissions return to the pool unless the
+    // user retains them.
+    void releaseSignaledFences() {
+        auto signaled = [](Fence *f) {
+            if (f->status() != ISPCRT_FENCE_SIGNALED)
+                return false;
+            f->refDec();
+            return true;
+        };
+        m_fences.erase(std::remove_if(m_fences.begin(), m_fences.end(), signaled), m_fences.end());
+    }
+
     void clearFences() {
         if (m_fences.size()) {
             for (const auto &f : m_fences) {
@@ -1344,6 +2592,15 @@ struct CommandListImpl : ispcrt::base::CommandList {
             m_futures.clear();
         }
     }
+
+    void clearCommands() {
+        m_commands.clear();
+        m_launches.clear();
+        for (const auto &o : m_retained) {
+            o->refDec();
+        }
+        m_retained.clear();
+    }
 };
 
 struct CommandQueueImpl : ispcrt::base::CommandQueue {
@@ -1362,16 +2619,31 @@ struct CommandQueueImpl : ispcrt::base::CommandQueue {
 
         if (!m_handle)
             throw std::runtime_error("Failed to create command queue!");
+        m_fencePool = std::make_unique<FencePool>(m_handle);
     }
 
     ~CommandQueueImpl() {
         clearCommandList();
+        m_fencePool.reset();
         L0_SAFE_CALL_NOEXCEPT(zeCommandQueueDestroy(m_handle));
     }
 
+    // The queue keeps a reference to its command lists. A list released by the
+    // user, whose submissions have completed, is reset and handed out again.
+    // The lists may be created and submitted by several threads at once, but
+    // each of them is recorded by one thread at a time.
     ispcrt::base::CommandList *createCommandList() override {
-        CommandListImpl *p = new CommandListImpl(m_dev, m_ctx, m_handle, m_ordinal);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &l : m_cmdlists) {
+            if (l->useCount() == 1 && l->idle()) {
+                l->reset();
+                l->refInc();
+                return l;
+            }
+        }
+        CommandListImpl *p = new CommandListImpl(m_dev, m_ctx, m_handle, m_ordinal, *m_fencePool, m_submitMutex);
         m_cmdlists.push_back(p);
+        p->refInc();
         return p;
     }
 
@@ -1388,6 +2660,9 @@ struct CommandQueueImpl : ispcrt::base::CommandQueue {
     ze_context_handle_t m_ctx{nullptr};
     uint32_t m_ordinal{0};
 
+    std::unique_ptr<FencePool> m_fencePool;
+    std::mutex m_mutex;
+    std::mutex m_submitMutex;
     std::vector<CommandListImpl *> m_cmdlists;
 
     void clearCommandList() {
@@ -1401,10 +2676,11 @@ struct CommandQueueImpl : ispcrt::base::CommandQueue {
 };
 
 struct CommandQueue {
-    CommandQueue(ze_device_handle_t dev, ze_context_handle_t ctxt, uint32_t ordinal) {
+    CommandQueue(ze_device_handle_t dev, ze_context_handle_t ctxt, uint32_t ordinal, uint32_t index = 0) {
         // Create compute command queue
         ze_command_queue_desc_t desc = {};
         desc.ordinal = ordinal;
+        desc.index = index;
         desc.mode = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS;
         desc.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
 
@@ -1422,20 +2698,71 @@ struct CommandQueue {
     ze_command_queue_handle_t m_handle{nullptr};
 };
 
+// Pinned host memory, through which the task queue copies the memory views
+// created over pageable application memory (ISPCRT_STAGING_BUFFER_SIZE), as
+// the copy engine transfers pinned memory faster than the driver's internal
+// staging does. Every copy gets its own part of the buffer, so in immediate
+// mode the memcpy to the staging memory of a copy overlaps the transfer of
+// the previous one. The parts are released when the task queue is synced.
+struct StagingBuffer {
+    StagingBuffer(ze_context_handle_t context, size_t size) : m_context(context), m_size(size) {}
+
+    ~StagingBuffer() {
+        if (m_ptr)
+            L0_SAFE_CALL_NOEXCEPT(zeMemFree(m_context, m_ptr));
+    }
+
+    // Return nullptr if there is not enough space left until the next reset
+    char *get(size_t size) {
+        const size_t alignedSize = (size + 63) & ~size_t(63);
+        if (alignedSize < size || alignedSize > m_size - m_used)
+            return nullptr;
+        // Allocate the buffer lazily on the first copy using it
+        if (!m_ptr) {
+            ze_host_mem_alloc_desc_t desc = {};
+            desc.stype = ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC;
+            L0_SAFE_CALL(zeMemAllocHost(m_context, &desc, m_size, 64, (void **)&m_ptr));
+        }
+        char *ptr = m_ptr + m_used;
+        m_used += alignedSize;
+        return ptr;
+    }
+
+    void reset() { m_used = 0; }
+
+  private:
+    ze_context_handle_t m_context{nullptr};
+    char *m_ptr{nullptr};
+    size_t m_size{0};
+    size_t m_used{0};
+};
+
+// Level Zero command lists must not be appended to by several threads at once,
+// and a barrier orders the commands of all the threads, so the task queue
+// serializes the threads with a lock held only while a command is appended,
+// or while the queue is synced. The kernel handle is locked as well while
+// its arguments are set for a launch, as the kernel may be launched on other
+// queues at the same time.
 struct TaskQueue : public ispcrt::base::TaskQueue {
-    TaskQueue(ze_device_handle_t device, ze_context_handle_t context, const bool is_mock_dev)
+    TaskQueue(ze_device_handle_t device, ze_context_handle_t context, const bool is_mock_dev, const bool immediate,
+              const bool multiEngine = false, DeviceMemoryPool *deviceMemPool = nullptr)
         : m_ep_compute(context, device, ISPCRTEventPoolType::compute),
           m_ep_copy(context, device, ISPCRTEventPoolType::copy) {
         m_context = context;
         m_device = device;
+        if (deviceMemPool)
+            m_progress = deviceMemPool->addQueue();
 
         uint32_t copyOrdinal = std::numeric_limits<uint32_t>::max();
         uint32_t computeOrdinal = 0;
+        uint32_t computeEngines = 1;
         // Check env variable before queue configuration
         bool isCopyEngineEnabled = !get_bool_envvar(ISPCRT_DISABLE_COPY_ENGINE);
-        bool useMultipleCommandLists = !get_bool_envvar(ISPCRT_DISABLE_MULTI_COMMAND_LISTS);
+        // Immediate mode uses a single in-order command list, which is executed
+        // as the commands are appended.
+        bool useMultipleCommandLists = !immediate && !get_bool_envvar(ISPCRT_DISABLE_MULTI_COMMAND_LISTS);
         // No need to create copy queue if only one command list is requested.
-        if (!is_mock_dev && isCopyEngineEnabled && useMultipleCommandLists) {
+        if (!is_mock_dev && (isCopyEngineEnabled || multiEngine) && useMultipleCommandLists) {
             // Discover all command queue groups
             uint32_t queueGroupCount = 0;
             L0_SAFE_CALL(zeDeviceGetCommandQueueGroupProperties(device, &queueGroupCount, nullptr));
@@ -1447,11 +2774,13 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
                 for (uint32_t i = 0; i < queueGroupCount; i++) {
                     if (queueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE) {
                         computeOrdinal = i;
+                        if (multiEngine)
+                            computeEngines = std::max(queueGroupProperties[i].numQueues, 1u);
                         break;
                     }
                 }
 
-                for (uint32_t i = 0; i < queueGroupCount; i++) {
+                for (uint32_t i = 0; isCopyEngineEnabled && i < queueGroupCount; i++) {
                     if ((queueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE) == 0 &&
                         (queueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY)) {
                         copyOrdinal = i;
@@ -1468,7 +2797,7 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
             useCopyEngine = true;
         }
 
-        m_cl_compute = createCommandList(computeOrdinal);
+        m_cl_compute = createCommandList(computeOrdinal, immediate);
         if (!is_mock_dev && useMultipleCommandLists) {
             m_cl_mem_d2h = createCommandList(copyOrdinal);
             m_cl_mem_h2d = createCommandList(copyOrdinal);
@@ -1478,12 +2807,24 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         }
 
         m_q_compute = createCommandQueue(computeOrdinal);
+        m_cl_engines.push_back(m_cl_compute);
+        m_q_engines.push_back(m_q_compute);
+        for (uint32_t i = 1; i < computeEngines; i++) {
+            m_cl_engines.push_back(createCommandList(computeOrdinal));
+            m_q_engines.push_back(createCommandQueue(computeOrdinal, i));
+        }
         // If there is no copy engine in HW, no need to create separate queue
         if (useCopyEngine) {
             m_q_copy = createCommandQueue(copyOrdinal);
         } else {
             m_q_copy = m_q_compute;
         }
+
+        // The size is given in megabytes, no staging by default
+        const size_t stagingSize = get_number_envvar(ISPCRT_STAGING_BUFFER_SIZE, 0);
+        if (stagingSize > 0) {
+            m_staging.reset(new StagingBuffer(context, stagingSize << 20));
+        }
     }
 
     ~TaskQueue() {
@@ -1493,7 +2834,7 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
             auto f = p.second;
             // Any commands associated with this future will never
             // be executed so we mark the future as not valid
-            f->m_valid = false;
+            f->m_valid.store(false, std::memory_order_release);
             f->refDec();
             m_ep_compute.deleteEvent(e);
         }
@@ -1501,28 +2842,70 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         m_events_compute_list.clear();
     }
 
-    void barrier() override { L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), nullptr, 0, nullptr)); }
+    void barrier() override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!multiEngine()) {
+            L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), nullptr, 0, nullptr));
+            return;
+        }
+        // The commands after the barrier wait for the launches since the
+        // previous one, which waited for the launches before it in turn.
+        if (!m_launch_events.empty()) {
+            m_barrier_events = std::move(m_launch_events);
+            m_launch_events.clear();
+        }
+    }
+
+    void copyToHost(ispcrt::base::MemoryView &mv) override { copyToHost(mv, 0, mv.numBytes()); }
+
+    void copyToDevice(ispcrt::base::MemoryView &mv) override { copyToDevice(mv, 0, mv.numBytes()); }
 
-    void copyToHost(ispcrt::base::MemoryView &mv) override {
+    // The copy of a range waits only for the kernels launched before it, and
+    // the kernel waits only for the copies to the device appended before it.
+    // So interleaving the copies of the slices of a view with the launches
+    // processing them overlaps the transfers on the copy engine with compute.
+    void copyToHost(ispcrt::base::MemoryView &mv, size_t offset, size_t size) override {
         auto &view = (gpu::MemoryView &)mv;
+        // The kernels write the application memory, which sync waits for.
+        if (view.isZeroCopy())
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        used();
         // Form a vector of compute events which should complete before copying memory to host
         std::vector<ze_event_handle_t> waitEvents;
         for (const auto &ev : m_events_compute_list) {
             waitEvents.push_back(ev.first->handle());
         }
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_d2h->handle(), view.hostPtr(), view.devicePtr(),
-                                                   view.numBytes(), nullptr, (uint32_t)waitEvents.size(),
-                                                   waitEvents.data()));
+        char *hostPtr = static_cast<char *>(view.hostPtr()) + offset;
+        // The staged data is copied to the application memory on sync
+        char *staged = staging(view, size);
+        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_d2h->handle(), staged ? staged : hostPtr,
+                                                   static_cast<char *>(view.devicePtr()) + offset, size, nullptr,
+                                                   (uint32_t)waitEvents.size(), waitEvents.data()));
+        if (staged) {
+            m_staged_d2h.push_back({hostPtr, staged, size});
+        }
 
         m_cl_mem_d2h->inc();
     }
 
-    void copyToDevice(ispcrt::base::MemoryView &mv) override {
+    void copyToDevice(ispcrt::base::MemoryView &mv, size_t offset, size_t size) override {
         auto &view = (gpu::MemoryView &)mv;
+        if (view.isZeroCopy())
+            return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        used();
+        char *hostPtr = static_cast<char *>(view.hostPtr()) + offset;
+        // The application memory is read now, not when the copy is executed
+        char *staged = staging(view, size);
+        if (staged) {
+            std::memcpy(staged, hostPtr, size);
+        }
         // Create event which will signal when memory copy is completed
         Event *copyEvent = m_ep_copy.getEvent();
-        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_h2d->handle(), view.devicePtr(), view.hostPtr(),
-                                                   view.numBytes(), copyEvent->handle(), 0, nullptr));
+        L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_mem_h2d->handle(),
+                                                   static_cast<char *>(view.devicePtr()) + offset,
+                                                   staged ? staged : hostPtr, size, copyEvent->handle(), 0, nullptr));
         m_cl_mem_h2d->inc();
         m_cl_mem_h2d->addEvent(copyEvent);
     }
@@ -1531,13 +2914,16 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         auto &view_dst = (gpu::MemoryView &)mv_dst;
         auto &view_src = (gpu::MemoryView &)mv_src;
 
+        std::lock_guard<std::mutex> lock(m_mutex);
+        used();
         // Create event and add it to m_cl_compute command list
         auto event = m_ep_compute.createEvent();
         if (event == nullptr)
             throw std::runtime_error("Failed to create event!");
         try {
             L0_SAFE_CALL(zeCommandListAppendMemoryCopy(m_cl_compute->handle(), view_dst.devicePtr(),
-                                                       view_src.devicePtr(), size, event->handle(), 0, nullptr));
+                                                       view_src.devicePtr(), size, event->handle(),
+                                                       (uint32_t)m_barrier_events.size(), m_barrier_events.data()));
             m_cl_compute->inc();
         } catch (ispcrt::base::ispcrt_runtime_error &e) {
             // cleanup and rethrow
@@ -1557,52 +2943,49 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         if (params)
             param_ptr = params->devicePtr();
 
+        std::lock_guard<std::mutex> queueLock(m_mutex);
+        std::lock_guard<std::mutex> kernelLock(kernel.launchMutex());
         // If param_ptr is nullptr, it was not set on host, so do not set kernel argument.
         if (param_ptr != nullptr) {
             L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), 0, sizeof(void *), &param_ptr));
         }
 
-        std::array<uint32_t, 3> suggestedGroupSize = {0};
-        L0_SAFE_CALL(zeKernelSuggestGroupSize(kernel.handle(), uint32_t(dim0), uint32_t(dim1), uint32_t(dim2),
-                                              &suggestedGroupSize[0], &suggestedGroupSize[1], &suggestedGroupSize[2]));
-        // TODO: Is this needed? Didn't find info in spec on the valid values that zeKernelSuggestGroupSize will return
-        suggestedGroupSize[0] = std::max(suggestedGroupSize[0], uint32_t(1));
-        suggestedGroupSize[1] = std::max(suggestedGroupSize[1], uint32_t(1));
-        suggestedGroupSize[2] = std::max(suggestedGroupSize[2], uint32_t(1));
+        return appendLaunch(kernel, dim0, dim1, dim2);
+    }
 
-        L0_SAFE_CALL(
-            zeKernelSetGroupSize(kernel.handle(), suggestedGroupSize[0], suggestedGroupSize[1], suggestedGroupSize[2]));
+    ispcrt::base::Future *launch(ispcrt::base::Kernel &k, const ispcrt::base::KernelArgs &args, size_t dim0,
+                                 size_t dim1, size_t dim2) override {
+        auto &kernel = (gpu::Kernel &)k;
 
-        const ze_group_count_t dispatchTraits = {uint32_t(dim0) / suggestedGroupSize[0],
-                                                 uint32_t(dim1) / suggestedGroupSize[1],
-                                                 uint32_t(dim2) / suggestedGroupSize[2]};
-        auto event = m_ep_compute.createEvent();
-        if (event == nullptr)
-            throw std::runtime_error("Failed to create event!");
-        try {
-            L0_SAFE_CALL(zeCommandListAppendLaunchKernel(
-                m_cl_compute->handle(), kernel.handle(), &dispatchTraits, event->handle(),
-                (uint32_t)m_cl_mem_h2d->getEventHandlers().size(), m_cl_mem_h2d->getEventHandlers().data()));
-            m_cl_compute->inc();
-        } catch (ispcrt::base::ispcrt_runtime_error &e) {
-            // cleanup and rethrow
-            m_ep_compute.deleteEvent(event);
-            throw e;
+        std::lock_guard<std::mutex> queueLock(m_mutex);
+        std::lock_guard<std::mutex> kernelLock(kernel.launchMutex());
+        // The values of the arguments are copied by the driver, so they are
+        // passed to the kernel without a memory allocation.
+        for (size_t i = 0; i < args.args.size(); i++) {
+            L0_SAFE_CALL(zeKernelSetArgumentValue(kernel.handle(), (uint32_t)i, args.args[i].second,
+                                                  args.data.data() + args.args[i].first));
         }
 
-        auto *future = new gpu::Future;
-        assert(future);
-        m_events_compute_list.push_back(std::make_pair(event, future));
-
-        return future;
+        return appendLaunch(kernel, dim0, dim1, dim2);
     }
 
+    // The other threads enqueueing commands wait until the sync is done, as
+    // the submitted command lists are reset after they complete.
     void sync() override {
+        std::lock_guard<std::mutex> lock(m_mutex);
         // Submit command lists
         submit();
 
         // Synchronize
-        if (useCopyEngine) {
+        if (m_cl_compute->immediate()) {
+            // There is no queue to synchronize with, so wait for the barrier
+            // appended after all the commands.
+            if (anyD2HCopyCommand() || anyH2DCopyCommand() || anyComputeCommand()) {
+                Event *syncEvent = m_ep_copy.getEvent();
+                L0_SAFE_CALL(zeCommandListAppendBarrier(m_cl_compute->handle(), syncEvent->handle(), 0, nullptr));
+                L0_SAFE_CALL(zeEventHostSynchronize(syncEvent->handle(), std::numeric_limits<uint64_t>::max()));
+            }
+        } else if (useCopyEngine) {
             // If there are commands to copy from device to host,
             // run sync of copy queue - it will ensure that all commands in pipeline were executed before.
             if (anyD2HCopyCommand()) {
@@ -1611,8 +2994,7 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
                 // If there are commands in compute list, run sync of compute queue -
                 // it will ensure that dependent copy commands from host to device were executed before.
                 if (anyComputeCommand()) {
-                    L0_SAFE_CALL(
-                        zeCommandQueueSynchronize(m_q_compute->handle(), std::numeric_limits<uint64_t>::max()));
+                    syncCompute();
                 }
                 // If there are commands in copy to device commandlist only, run sync of copy queue.
                 else if (anyH2DCopyCommand()) {
@@ -1622,12 +3004,24 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
         } else {
             // If we have any command in one of our command lists, make queue sync
             if (anyD2HCopyCommand() || anyH2DCopyCommand() || anyComputeCommand()) {
-                L0_SAFE_CALL(zeCommandQueueSynchronize(m_q_compute->handle(), std::numeric_limits<uint64_t>::max()));
+                syncCompute();
             }
         }
-        m_cl_compute->reset();
+        for (auto &cl : m_cl_engines)
+            cl->reset();
         m_cl_mem_h2d->reset();
         m_cl_mem_d2h->reset();
+        m_next_engine = 0;
+        m_launch_events.clear();
+        m_barrier_events.clear();
+
+        if (m_staging) {
+            for (const auto &c : m_staged_d2h) {
+                std::memcpy(c.hostPtr, c.staged, c.size);
+            }
+            m_staged_d2h.clear();
+            m_staging->reset();
+        }
 
         // Update future objects corresponding to the events that have just completed
         for (const auto &p : m_events_compute_list) {
@@ -1635,30 +3029,45 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
             auto f = p.second;
             ze_kernel_timestamp_result_t tsResult;
             L0_SAFE_CALL(zeEventQueryKernelTimestamp(e->handle(), &tsResult));
+            uint64_t time = 0;
             if (tsResult.context.kernelEnd >= tsResult.context.kernelStart) {
-                f->m_time = (tsResult.context.kernelEnd - tsResult.context.kernelStart);
+                time = (tsResult.context.kernelEnd - tsResult.context.kernelStart);
             } else {
                 // If we overflow kernelEnd counter then this method
                 // should be used for calculate time.
-                f->m_time = ((m_ep_compute.getTimestampMaxValue() - tsResult.context.kernelStart) +
-                             tsResult.context.kernelEnd + 1);
+                time = ((m_ep_compute.getTimestampMaxValue() - tsResult.context.kernelStart) +
+                        tsResult.context.kernelEnd + 1);
             }
-            f->m_time *= m_ep_compute.getTimestampRes();
-            f->m_valid = true;
+            f->complete(time * m_ep_compute.getTimestampRes());
             f->refDec();
-            m_ep_compute.deleteEvent(e);
+            // The event is completed, so it can be reset and reused.
+            m_ep_compute.recycleEvent(e);
         }
 
         m_events_compute_list.clear();
         m_ep_copy.releaseEvents();
+        // The device memory released before the sync can be reused.
+        if (m_progress)
+            m_progress->synced();
     }
 
     void *taskQueueNativeHandle() const override { return m_q_compute->handle(); }
 
   private:
+    // The progress of the queue for the device memory pool, if it's enabled.
+    std::shared_ptr<DeviceMemoryPool::QueueProgress> m_progress;
+
+    void used() {
+        if (m_progress)
+            m_progress->used();
+    }
+
     ze_context_handle_t m_context{nullptr};
     ze_device_handle_t m_device{nullptr};
 
+    // Held while a command is appended and while the queue is synced.
+    std::mutex m_mutex;
+
     std::shared_ptr<CommandQueue> m_q_compute;
     std::shared_ptr<CommandQueue> m_q_copy;
 
@@ -1666,28 +3075,110 @@ struct TaskQueue : public ispcrt::base::TaskQueue {
     std::shared_ptr<CommandList> m_cl_mem_h2d;
     std::shared_ptr<CommandList> m_cl_mem_d2h;
 
+    // The compute command lists and queues of the engines, which the launches
+    // are spread over, the first ones are m_cl_compute and m_q_compute.
+    std::vector<std::shared_ptr<CommandList>> m_cl_engines;
+    std::vector<std::shared_ptr<CommandQueue>> m_q_engines;
+    size_t m_next_engine{0};
+    // The events of the launches since the last barrier and of the launches
+    // between the last two barriers, which the following commands wait for.
+    std::vector<ze_event_handle_t> m_launch_events;
+    std::vector<ze_event_handle_t> m_barrier_events;
+
     EventPool m_ep_compute, m_ep_copy;
     std::vector<std::pair<Event *, Future *>> m_events_compute_list;
 
     bool useCopyEngine{false};
 
-    std::shared_ptr<CommandList> createCommandList(uint32_t ordinal) {
-        std::shared_ptr<CommandList> cmdl{new CommandList(m_device, m_context, ordinal)};
+    struct StagedCopy {
+        void *hostPtr;
+        const void *staged;
+        size_t size;
+    };
+    std::unique_ptr<StagingBuffer> m_staging;
+    std::vector<StagedCopy> m_staged_d2h;
+
+    // Return the staging memory for the copy of the view, or nullptr if the
+    // copy has to use the application memory directly: the staging is
+    // disabled or full, or the memory is not pageable anyway.
+    char *staging(gpu::MemoryView &view, size_t size) {
+        if (!m_staging || view.isShared() || size == 0)
+            return nullptr;
+        ze_memory_allocation_properties_t memProperties{};
+        memProperties.stype = ZE_STRUCTURE_TYPE_MEMORY_ALLOCATION_PROPERTIES;
+        ze_device_handle_t dev = nullptr;
+        L0_SAFE_CALL(zeMemGetAllocProperties(m_context, view.hostPtr(), &memProperties, &dev));
+        if (memProperties.type != ZE_MEMORY_TYPE_UNKNOWN)
+            return nullptr;
+        return m_staging->get(size);
+    }
+
+    std::shared_ptr<CommandList> createCommandList(uint32_t ordinal, bool immediate = false) {
+        std::shared_ptr<CommandList> cmdl{new CommandList(m_device, m_context, ordinal, immediate)};
         assert(cmdl.get());
         return cmdl;
     }
 
-    std::shared_ptr<CommandQueue> createCommandQueue(uint32_t ordinal) {
-        std::shared_ptr<CommandQueue> cmdq{new CommandQueue(m_device, m_context, ordinal)};
+    std::shared_ptr<CommandQueue> createCommandQueue(uint32_t ordinal, uint32_t index = 0) {
+        std::shared_ptr<CommandQueue> cmdq{new CommandQueue(m_device, m_context, ordinal, index)};
         return cmdq;
     }
 
+    bool multiEngine() const { return m_cl_engines.size() > 1; }
+
     void submit() {
         m_cl_mem_h2d->submit(m_q_copy->handle());
-        m_cl_compute->submit(m_q_compute->handle());
+        for (size_t i = 0; i < m_cl_engines.size(); i++)
+            m_cl_engines[i]->submit(m_q_engines[i]->handle());
         m_cl_mem_d2h->submit(m_q_copy->handle());
     }
 
+    void syncCompute() {
+        for (size_t i = 0; i < m_q_engines.size(); i++) {
+            if (i == 0 || m_cl_engines[i]->count() > 0)
+                L0_SAFE_CALL(
+                    zeCommandQueueSynchronize(m_q_engines[i]->handle(), std::numeric_limits<uint64_t>::max()));
+        }
+    }
+
+    // Append the launch of the kernel, whose arguments are set, to the
+    // compute command list.
+    ispcrt::base::Future *appendLaunch(gpu::Kernel &kernel, size_t dim0, size_t dim1, size_t dim2) {
+        used();
+        const std::array<uint32_t, 3> groupSize = kernel.prepareGroupSize(dim0, dim1, dim2);
+
+        const ze_group_count_t dispatchTraits = {uint32_t(dim0) / groupSize[0], uint32_t(dim1) / groupSize[1],
+                                                 uint32_t(dim2) / groupSize[2]};
+        // The launch waits for the copies to the device and, on multiple
+        // engines, for the launches before the last barrier.
+        std::vector<ze_event_handle_t> waitEvents = m_cl_mem_h2d->getEventHandlers();
+        waitEvents.insert(waitEvents.end(), m_barrier_events.begin(), m_barrier_events.end());
+        auto &cl = m_cl_engines[m_next_engine];
+        m_next_engine = (m_next_engine + 1) % m_cl_engines.size();
+
+        auto event = m_ep_compute.createEvent();
+        if (event == nullptr)
+            throw std::runtime_error("Failed to create event!");
+        try {
+            L0_SAFE_CALL(zeCommandListAppendLaunchKernel(cl->handle(), kernel.handle(), &dispatchTraits,
+                                                         event->handle(), (uint32_t)waitEvents.size(),
+                                                         waitEvents.data()));
+            cl->inc();
+        } catch (ispcrt::base::ispcrt_runtime_error &e) {
+            // cleanup and rethrow
+            m_ep_compute.deleteEvent(event);
+            throw e;
+        }
+        if (multiEngine())
+            m_launch_events.push_back(event->handle());
+
+        auto *future = new gpu::Future;
+        assert(future);
+        m_events_compute_list.push_back(std::make_pair(event, future));
+
+        return future;
+    }
+
     bool anyH2DCopyCommand() { return m_cl_mem_h2d->count() > 0; }
     bool anyD2HCopyCommand() { return m_cl_mem_d2h->count() > 0; }
     bool anyComputeCommand() { return m_events_compute_list.size(); }
@@ -1712,10 +3203,16 @@ static void deviceDiscovery(bool *p_is_mock) {
         print_env(ISPCRT_DISABLE_COPY_ENGINE);
         print_env(ISPCRT_IGC_OPTIONS);
         print_env(ISPCRT_USE_ZEBIN);
+        print_env(ISPCRT_GPU_CACHE_DIR);
         print_env(ISPCRT_MAX_KERNEL_LAUNCHES);
+        print_env(ISPCRT_EVENT_POOL_SIZE);
         print_env(ISPCRT_MEM_POOL);
         print_env(ISPCRT_MEM_POOL_MIN_CHUNK_POW2);
         print_env(ISPCRT_MEM_POOL_MAX_CHUNK_POW2);
+        print_env(ISPCRT_DEVICE_MEM_POOL);
+        print_env(ISPCRT_DEVICE_MEM_POOL_SIZE);
+        print_env(ISPCRT_STAGING_BUFFER_SIZE);
+        print_env(ISPCRT_DISABLE_ZERO_COPY);
     }
 
     bool is_mock = get_bool_envvar(ISPCRT_MOCK_DEVICE);
@@ -1902,25 +3399,65 @@ GPUDevice::GPUDevice(void *nativeContext, void *nativeDevice, uint32_t deviceIdx
     }
     if (!m_context)
         throw std::runtime_error("failed to create GPU context");
+
+    if (gpu::DeviceMemoryPool::enabled()) {
+        m_deviceMemPool =
+            std::make_shared<gpu::DeviceMemoryPool>((ze_context_handle_t)m_context, (ze_device_handle_t)m_device);
+    }
+
+    // Integrated GPUs share the physical memory with the host, so the device
+    // memory views of the application memory, which the device can access,
+    // use it in place instead of copying it.
+    ze_device_properties_t deviceProperties = {};
+    deviceProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+    L0_SAFE_CALL(zeDeviceGetProperties((ze_device_handle_t)m_device, &deviceProperties));
+    if ((deviceProperties.flags & ZE_DEVICE_PROPERTY_FLAG_INTEGRATED) && !get_bool_envvar(ISPCRT_DISABLE_ZERO_COPY)) {
+        m_integrated = true;
+        ze_device_memory_access_properties_t accessProperties = {};
+        accessProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_ACCESS_PROPERTIES;
+        L0_SAFE_CALL(zeDeviceGetMemoryAccessProperties((ze_device_handle_t)m_device, &accessProperties));
+        m_system_memory_access = (accessProperties.sharedSystemAllocCapabilities & ZE_MEMORY_ACCESS_CAP_FLAG_RW) != 0;
+    }
 }
 
 GPUDevice::~GPUDevice() {
+    // The memory views, which may outlive the device, keep the pool.
+    if (m_deviceMemPool)
+        m_deviceMemPool->trim();
     // Destroy context if it was created in GPUDevice.
     if (m_context && m_has_context_ownership)
         L0_SAFE_CALL_NOEXCEPT(zeContextDestroy((ze_context_handle_t)m_context));
 }
 
-base::MemoryView *GPUDevice::newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags) const {
+// The device can access the host or shared USM allocations, and any memory
+// allocated by the system if it supports the shared system allocations. The
+// memory has to be aligned as the device allocations are.
+bool GPUDevice::canAccessInPlace(void *appMem) const {
+    if (appMem == nullptr || reinterpret_cast<uintptr_t>(appMem) % 64 != 0)
+        return false;
+    if (m_system_memory_access)
+        return true;
+    ISPCRTAllocationType type = getMemAllocType(appMem);
+    return type == ISPCRT_ALLOC_TYPE_HOST || type == ISPCRT_ALLOC_TYPE_SHARED;
+}
+
+base::MemoryView *GPUDevice::newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags,
+                                           const ISPCRTMemoryPlacement *placement) const {
+    const bool zeroCopy = m_integrated && flags->allocType == ISPCRT_ALLOC_TYPE_DEVICE &&
+                          flags->smHint != ISPCRT_SM_APPLICATION_MANAGED_DEVICE && canAccessInPlace(appMem);
     return new gpu::MemoryView((ze_context_handle_t)m_context, (ze_device_handle_t)m_device, appMem, numBytes, flags,
-                               nullptr);
+                               nullptr, zeroCopy, zeroCopy ? nullptr : m_deviceMemPool,
+                               placement ? placement->flags : uint32_t(ISPCRT_MEM_DEFAULT));
 }
 
 base::CommandQueue *GPUDevice::newCommandQueue(uint32_t ordinal) const {
     return new gpu::CommandQueueImpl((ze_device_handle_t)m_device, (ze_context_handle_t)m_context, ordinal);
 }
 
-base::TaskQueue *GPUDevice::newTaskQueue() const {
-    return new gpu::TaskQueue((ze_device_handle_t)m_device, (ze_context_handle_t)m_context, m_is_mock);
+base::TaskQueue *GPUDevice::newTaskQueue(uint32_t flags) const {
+    return new gpu::TaskQueue((ze_device_handle_t)m_device, (ze_context_handle_t)m_context, m_is_mock,
+                              (flags & ISPCRT_TASK_QUEUE_IMMEDIATE) != 0,
+                              (flags & ISPCRT_TASK_QUEUE_MULTI_ENGINE) != 0, m_deviceMemPool.get());
 }
 
 base::ModuleOptions *GPUDevice::newModuleOptions() const { return new gpu::ModuleOptions(); }
@@ -1930,8 +3467,20 @@ base::ModuleOptions *GPUDevice::newModuleOptions(ISPCRTModuleType moduleType, bo
     return new gpu::ModuleOptions(moduleType, libraryCompilation, stackSize);
 }
 
+base::Module *GPUDevice::newModuleFromSource([[maybe_unused]] const char *source,
+                                             [[maybe_unused]] const char *const *options,
+                                             [[maybe_unused]] uint32_t numOptions) const {
+    throw std::logic_error("loading modules from source is not supported for GPU devices");
+}
+
 base::Module *GPUDevice::newModule(const char *moduleFile, const base::ModuleOptions &opts) const {
-    return new gpu::Module((ze_device_handle_t)m_device, (ze_context_handle_t)m_context, moduleFile, m_is_mock, opts);
+    return new gpu::Module((ze_driver_handle_t)m_driver, (ze_device_handle_t)m_device, (ze_context_handle_t)m_context,
+                           moduleFile, m_is_mock, opts);
+}
+
+base::Module *GPUDevice::newModuleFromMemory(const void *data, size_t size, const base::ModuleOptions &opts) const {
+    return new gpu::Module((ze_driver_handle_t)m_driver, (ze_device_handle_t)m_device, (ze_context_handle_t)m_context,
+                           data, size, m_is_mock, opts);
 }
 
 void GPUDevice::dynamicLinkModules(base::Module **modules, const uint32_t numModules) const {
@@ -1943,8 +3492,8 @@ base::Module *GPUDevice::staticLinkModules(base::Module **modules, const uint32_
                                   (ze_context_handle_t)m_context);
 }
 
-base::Kernel *GPUDevice::newKernel(const base::Module &module, const char *name) const {
-    return new gpu::Kernel(module, name);
+base::Kernel *GPUDevice::newKernel(const base::Module &module, const char *name, uint32_t width) const {
+    return new gpu::Kernel(module, name, width);
 }
 
 void *GPUDevice::platformNativeHandle() const { return m_driver; }
@@ -2026,6 +3575,17 @@ ISPCRTDeviceType GPUContext::getDeviceType() const { return ISPCRTDeviceType::IS
 
 void *GPUContext::contextNativeHandle() const { return m_context; }
 
+void GPUContext::memPoolStats(ISPCRTSharedMemoryAllocationHint type, ISPCRTMemPoolStats *stats,
+                              ISPCRTMemPoolChunkStats *chunks, uint32_t *numChunks) const {
+    memPool(type)->stats(stats, chunks, numChunks);
+}
+
+size_t GPUContext::trimMemPool(ISPCRTSharedMemoryAllocationHint type) const { return memPool(type)->trim(); }
+
+void GPUContext::setMemPoolLimit(ISPCRTSharedMemoryAllocationHint type, size_t maxBytesReserved) const {
+    memPool(type)->setLimit(maxBytesReserved);
+}
+
 gpu::ChunkedPool *GPUContext::memPool(ISPCRTSharedMemoryAllocationHint type) const {
     switch (type) {
     case ISPCRT_SM_HOST_DEVICE_READ_WRITE:
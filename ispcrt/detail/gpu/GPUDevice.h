@@ -11,6 +11,7 @@
 #include "../Future.h"
 
 // std
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -21,6 +22,8 @@ namespace gpu {
 uint32_t deviceCount();
 ISPCRTDeviceInfo deviceInfo(uint32_t deviceIdx);
 
+class DeviceMemoryPool;
+
 }; // namespace gpu
 
 struct GPUDevice : public base::Device {
@@ -30,23 +33,26 @@ struct GPUDevice : public base::Device {
 
     ~GPUDevice();
 
-    base::MemoryView *newMemoryView(void *appMem, size_t numBytes,
-                                    const ISPCRTNewMemoryViewFlags *flags) const override;
+    base::MemoryView *newMemoryView(void *appMem, size_t numBytes, const ISPCRTNewMemoryViewFlags *flags,
+                                    const ISPCRTMemoryPlacement *placement) const override;
 
     base::CommandQueue *newCommandQueue(uint32_t ordinal) const override;
 
-    base::TaskQueue *newTaskQueue() const override;
+    base::TaskQueue *newTaskQueue(uint32_t flags) const override;
 
     base::ModuleOptions *newModuleOptions() const override;
     base::ModuleOptions *newModuleOptions(ISPCRTModuleType moduleType, bool libraryCompilation,
                                           uint32_t stackSize) const override;
 
     base::Module *newModule(const char *moduleFile, const base::ModuleOptions &opts) const override;
+    base::Module *newModuleFromSource(const char *source, const char *const *options,
+                                      uint32_t numOptions) const override;
+    base::Module *newModuleFromMemory(const void *data, size_t size, const base::ModuleOptions &opts) const override;
 
     void dynamicLinkModules(base::Module **modules, const uint32_t numModules) const override;
     base::Module *staticLinkModules(base::Module **modules, const uint32_t numModules) const override;
 
-    base::Kernel *newKernel(const base::Module &module, const char *name) const override;
+    base::Kernel *newKernel(const base::Module &module, const char *name, uint32_t width) const override;
 
     void *platformNativeHandle() const override;
     void *deviceNativeHandle() const override;
@@ -57,11 +63,19 @@ struct GPUDevice : public base::Device {
     ISPCRTAllocationType getMemAllocType(void *appMemory) const override;
 
   private:
+    bool canAccessInPlace(void *appMem) const;
+
     void *m_driver{nullptr};
     void *m_device{nullptr};
     void *m_context{nullptr};
     bool m_is_mock{false};
     bool m_has_context_ownership{true};
+    // Zero-copy memory views are used on integrated GPUs.
+    bool m_integrated{false};
+    bool m_system_memory_access{false};
+    // Cache of the device memory of the memory views, see
+    // ISPCRT_DEVICE_MEM_POOL.
+    std::shared_ptr<gpu::DeviceMemoryPool> m_deviceMemPool;
 };
 
 } // namespace ispcrt
@@ -11,14 +11,25 @@
 
 #include "ispcrt.h"
 // std
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 // ispcrt
 #include "detail/Exception.h"
 #include "detail/Module.h"
 #include "detail/ModuleOptions.h"
+#include "detail/Pipeline.h"
 #include "detail/TaskQueue.h"
+#include "detail/Trace.h"
 
 #ifdef ISPCRT_BUILD_CPU
 #include "detail/cpu/CPUContext.h"
@@ -164,6 +175,14 @@ static ISPCRTTaskingLaunchFType ispc_launch_fptr = nullptr;
 static ISPCRTTaskingAllocFType ispc_alloc_fptr = nullptr;
 static ISPCRTTaskingSyncFType ispc_sync_fptr = nullptr;
 
+#if defined(ISPCRT_BUILD_STATIC) && defined(ISPCRT_BUILD_TASKING)
+// Linked from detail/cpu/ispc_tasking.cpp.
+extern "C" {
+void ISPCLaunch_cpu(void **handlePtr, void *f, void *data, int countx, int county, int countz);
+void ISPCSync_cpu(void *handle);
+}
+#endif
+
 // Applications can provide their own implementation of ISPCLaunch/ISPCAlloc/ISPCSync tasking API.
 void ispcrtSetTaskingCallbacks(ISPCRTTaskingLaunchFType launch, ISPCRTTaskingAllocFType alloc,
                                ISPCRTTaskingSyncFType sync) {
@@ -263,7 +282,12 @@ void *handleGPUDeviceLib() {
 uint32_t cpuDeviceCount();
 ISPCRTDeviceInfo cpuDeviceInfo(uint32_t idx);
 ispcrt::base::Device *loadCPUDevice();
+ispcrt::base::Device *loadCPUSubDevice(const ISPCRTCpuDeviceOptions *options);
 ispcrt::base::Context *loadCPUContext();
+ispcrt::base::Device *loadCPUDeviceFromContext(ispcrt::base::Context *context);
+void cpuSetDeviceOptions(const ISPCRTCpuDeviceOptions *options);
+void cpuTopology(ISPCRTCpuTopology *topology);
+ISPCRTTaskPriority cpuCurrentTaskPriority();
 
 // Stubs around GPU device solibs API.
 uint32_t gpuDeviceCount();
@@ -277,9 +301,14 @@ ispcrt::base::Context *loadGPUContext(void *ctx);
 typedef uint32_t (*DeviceCountF)();
 typedef ISPCRTDeviceInfo (*DeviceInfoF)(uint32_t);
 typedef ispcrt::base::Device *(*LoadDeviceF)();
+typedef ispcrt::base::Device *(*LoadSubDeviceF)(const ISPCRTCpuDeviceOptions *);
 typedef ispcrt::base::Device *(*LoadDeviceCtxF)(void *, void *, uint32_t);
 typedef ispcrt::base::Context *(*LoadContextF)();
 typedef ispcrt::base::Context *(*LoadContextCtxF)(void *);
+typedef ispcrt::base::Device *(*LoadDeviceFromContextF)(ispcrt::base::Context *);
+typedef void (*SetDeviceOptionsF)(const ISPCRTCpuDeviceOptions *);
+typedef void (*TopologyF)(ISPCRTCpuTopology *);
+typedef ISPCRTTaskPriority (*TaskPriorityF)();
 
 // CPU stubs
 uint32_t cpuDeviceCount() {
@@ -346,6 +375,25 @@ ispcrt::base::Device *loadCPUDevice() {
 #endif
 }
 
+ispcrt::base::Device *loadCPUSubDevice(const ISPCRTCpuDeviceOptions *options) {
+#ifdef ISPCRT_BUILD_STATIC
+#ifdef ISPCRT_BUILD_CPU
+    return new ispcrt::CPUDevice(*options);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+#else
+    static LoadSubDeviceF load_sub_device = nullptr;
+    if (!load_sub_device) {
+        load_sub_device = (LoadSubDeviceF)dyn_load_sym(handleCPUDeviceLib(), "load_cpu_sub_device");
+        if (!load_sub_device) {
+            throw std::runtime_error("Missing load_cpu_sub_device symbol");
+        }
+    }
+    return load_sub_device(options);
+#endif
+}
+
 ispcrt::base::Context *loadCPUContext() {
 #ifdef ISPCRT_BUILD_STATIC
 #ifdef ISPCRT_BUILD_CPU
@@ -368,6 +416,82 @@ ispcrt::base::Context *loadCPUContext() {
 #endif
 }
 
+ispcrt::base::Device *loadCPUDeviceFromContext(ispcrt::base::Context *context) {
+#ifdef ISPCRT_BUILD_STATIC
+#ifdef ISPCRT_BUILD_CPU
+    return new ispcrt::CPUDevice(*(ispcrt::CPUContext *)context);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+#else
+    static LoadDeviceFromContextF load_device = nullptr;
+    if (!load_device) {
+        load_device = (LoadDeviceFromContextF)dyn_load_sym(handleCPUDeviceLib(), "load_cpu_device_from_context");
+        if (!load_device) {
+            throw std::runtime_error("Missing load_cpu_device_from_context symbol");
+        }
+    }
+    return load_device(context);
+#endif
+}
+
+void cpuSetDeviceOptions(const ISPCRTCpuDeviceOptions *options) {
+#ifdef ISPCRT_BUILD_STATIC
+#ifdef ISPCRT_BUILD_CPU
+    ispcrt::cpu::setDeviceOptions(*options);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+#else
+    static SetDeviceOptionsF set_device_options = nullptr;
+    if (!set_device_options) {
+        set_device_options = (SetDeviceOptionsF)dyn_load_sym(handleCPUDeviceLib(), "cpu_set_device_options");
+        if (!set_device_options) {
+            throw std::runtime_error("Missing cpu_set_device_options symbol");
+        }
+    }
+    set_device_options(options);
+#endif
+}
+
+void cpuTopology(ISPCRTCpuTopology *topology) {
+#ifdef ISPCRT_BUILD_STATIC
+#ifdef ISPCRT_BUILD_CPU
+    *topology = ispcrt::cpu::topology();
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+#else
+    static TopologyF cpu_topology = nullptr;
+    if (!cpu_topology) {
+        cpu_topology = (TopologyF)dyn_load_sym(handleCPUDeviceLib(), "cpu_topology");
+        if (!cpu_topology) {
+            throw std::runtime_error("Missing cpu_topology symbol");
+        }
+    }
+    cpu_topology(topology);
+#endif
+}
+
+ISPCRTTaskPriority cpuCurrentTaskPriority() {
+#ifdef ISPCRT_BUILD_STATIC
+#ifdef ISPCRT_BUILD_CPU
+    return ispcrt::cpu::currentTaskPriority();
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+#else
+    static TaskPriorityF current_task_priority = nullptr;
+    if (!current_task_priority) {
+        current_task_priority = (TaskPriorityF)dyn_load_sym(handleCPUDeviceLib(), "cpu_current_task_priority");
+        if (!current_task_priority) {
+            throw std::runtime_error("Missing cpu_current_task_priority symbol");
+        }
+    }
+    return current_task_priority();
+#endif
+}
+
 // GPU stubs.
 uint32_t gpuDeviceCount() {
 #ifdef ISPCRT_BUILD_STATIC
@@ -569,7 +693,11 @@ static ISPCRTDevice getISPCRTDevice(ISPCRTDeviceType type, ISPCRTContext context
         break;
     case ISPCRT_DEVICE_TYPE_CPU:
 #ifdef ISPCRT_BUILD_CPU
-        device = loadCPUDevice();
+        // The devices of a context share its executor.
+        if (context)
+            device = loadCPUDeviceFromContext(&referenceFromHandle<ispcrt::base::Context>(context));
+        else
+            device = loadCPUDevice();
 #else
         throw std::runtime_error("CPU support not enabled");
 #endif
@@ -714,13 +842,41 @@ ISPCRTContext ispcrtGetContextFromNativeHandle(ISPCRTDeviceType type, ISPCRTGene
 // MemoryViews ////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+static void checkMemoryPlacement(const ISPCRTMemoryPlacement *placement) {
+    const uint32_t all = ISPCRT_MEM_HUGE_PAGES | ISPCRT_MEM_HUGE_PAGES_2MB | ISPCRT_MEM_HUGE_PAGES_1GB |
+                         ISPCRT_MEM_NUMA_BIND | ISPCRT_MEM_NUMA_INTERLEAVE | ISPCRT_MEM_PREFAULT;
+    if (placement == nullptr)
+        return;
+    const uint32_t p = placement->flags;
+    if (p & ~all)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "Unknown memory placement flags!");
+    if ((p & ISPCRT_MEM_HUGE_PAGES_2MB) && (p & ISPCRT_MEM_HUGE_PAGES_1GB))
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "Only one huge page size can be requested!");
+    if ((p & ISPCRT_MEM_NUMA_BIND) && (p & ISPCRT_MEM_NUMA_INTERLEAVE))
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "NUMA binding and interleaving are mutually exclusive!");
+}
+
 ISPCRTMemoryView ispcrtNewMemoryView(ISPCRTDevice d, void *appMemory, size_t numBytes,
                                      ISPCRTNewMemoryViewFlags *flags) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
     if (flags->allocType != ISPCRT_ALLOC_TYPE_SHARED && flags->allocType != ISPCRT_ALLOC_TYPE_DEVICE) {
         throw std::runtime_error("Unsupported memory allocation type requested!");
     }
-    return (ISPCRTMemoryView)device.newMemoryView(appMemory, numBytes, flags);
+    return (ISPCRTMemoryView)device.newMemoryView(appMemory, numBytes, flags, nullptr);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTMemoryView ispcrtNewMemoryViewWithPlacement(ISPCRTDevice d, void *appMemory, size_t numBytes,
+                                                  ISPCRTNewMemoryViewFlags *flags,
+                                                  const ISPCRTMemoryPlacement *placement) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (flags->allocType != ISPCRT_ALLOC_TYPE_SHARED && flags->allocType != ISPCRT_ALLOC_TYPE_DEVICE) {
+        throw std::runtime_error("Unsupported memory allocation type requested!");
+    }
+    checkMemoryPlacement(placement);
+    return (ISPCRTMemoryView)device.newMemoryView(appMemory, numBytes, flags, placement);
 }
 ISPCRT_CATCH_END(nullptr)
 
@@ -734,6 +890,29 @@ ISPCRTMemoryView ispcrtNewMemoryViewForContext(ISPCRTContext c, void *appMemory,
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTMemoryView ispcrtNewZeroCopyMemoryView(ISPCRTDevice d, void *appMemory, size_t numBytes) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (appMemory == nullptr) {
+        throw std::runtime_error("Zero-copy memory view requires application memory!");
+    }
+    // The CPU device memory view of the application memory aliases it.
+    ISPCRTNewMemoryViewFlags flags = {};
+    flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
+    flags.smHint = ISPCRT_SM_HOST_DEVICE_READ_WRITE;
+    return (ISPCRTMemoryView)device.newMemoryView(appMemory, numBytes, &flags, nullptr);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTMemoryView ispcrtNewMemoryViewSlice(ISPCRTMemoryView p, size_t offset, size_t numBytes) ISPCRT_CATCH_BEGIN {
+    auto &parent = referenceFromHandle<ispcrt::base::MemoryView>(p);
+    if (offset > parent.numBytes() || numBytes > parent.numBytes() - offset) {
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "Requested slice is beyond the memory view size!");
+    }
+    return (ISPCRTMemoryView)parent.slice(offset, numBytes);
+}
+ISPCRT_CATCH_END(nullptr)
+
 void *ispcrtHostPtr(ISPCRTMemoryView h) ISPCRT_CATCH_BEGIN {
     auto &mv = referenceFromHandle<ispcrt::base::MemoryView>(h);
     return mv.hostPtr();
@@ -765,6 +944,129 @@ ISPCRTAllocationType ispcrtGetMemoryAllocType(ISPCRTDevice d, void *memBuffer) I
 }
 ISPCRT_CATCH_END(ISPCRTAllocationType::ISPCRT_ALLOC_TYPE_UNKNOWN)
 
+void ispcrtContextGetMemPoolStats(ISPCRTContext c, ISPCRTSharedMemoryAllocationHint type, ISPCRTMemPoolStats *stats,
+                                  ISPCRTMemPoolChunkStats *chunks, uint32_t *numChunks) ISPCRT_CATCH_BEGIN {
+    const auto &context = referenceFromHandle<ispcrt::base::Context>(c);
+    if (chunks && !numChunks)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "numChunks is required with chunks");
+    context.memPoolStats(type, stats, chunks, numChunks);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+size_t ispcrtContextTrimMemPool(ISPCRTContext c, ISPCRTSharedMemoryAllocationHint type) ISPCRT_CATCH_BEGIN {
+    const auto &context = referenceFromHandle<ispcrt::base::Context>(c);
+    return context.trimMemPool(type);
+}
+ISPCRT_CATCH_END(0)
+
+void ispcrtContextSetMemPoolLimit(ISPCRTContext c, ISPCRTSharedMemoryAllocationHint type,
+                                  size_t maxBytesReserved) ISPCRT_CATCH_BEGIN {
+    const auto &context = referenceFromHandle<ispcrt::base::Context>(c);
+    context.setMemPoolLimit(type, maxBytesReserved);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtContextSetTaskingCallbacks(ISPCRTContext c, const ISPCRTTaskingCallbacks *callbacks) ISPCRT_CATCH_BEGIN {
+    auto &context = referenceFromHandle<ispcrt::base::Context>(c);
+    context.setTaskingCallbacks(callbacks);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+struct FirstTouchData {
+    char *ptr;
+    size_t chunkSize;
+    size_t size;
+};
+
+// Has the signature of ispc task functions.
+[[maybe_unused]] static void firstTouchTask(void *data, int, int, int taskIndex, int, int, int, int, int, int, int) {
+    auto *ft = (FirstTouchData *)data;
+    size_t begin = ft->chunkSize * taskIndex;
+    size_t end = std::min(ft->size, begin + ft->chunkSize);
+    if (begin < end)
+        memset(ft->ptr + begin, 0, end - begin);
+}
+
+void ispcrtFirstTouch(ISPCRTDevice d, ISPCRTMemoryView h, uint32_t numChunks) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (device.getType() != ISPCRT_DEVICE_TYPE_CPU)
+        throw std::runtime_error("First touch is supported only for CPU devices");
+
+    auto &mv = referenceFromHandle<ispcrt::base::MemoryView>(h);
+    FirstTouchData ft;
+    ft.ptr = (char *)mv.devicePtr();
+    ft.size = mv.numBytes();
+    if (ft.size == 0)
+        return;
+    size_t count = std::min<size_t>(std::max<uint32_t>(numChunks, 1), std::min<size_t>(ft.size, INT_MAX));
+    ft.chunkSize = (ft.size + count - 1) / count;
+
+#ifdef ISPCRT_BUILD_TASKING
+    ISPCRTTaskingLaunchFType launch = ispc_launch_fptr;
+    ISPCRTTaskingSyncFType sync = ispc_sync_fptr;
+#ifdef ISPCRT_BUILD_STATIC
+    if (!launch) {
+        launch = ISPCLaunch_cpu;
+        sync = ISPCSync_cpu;
+    }
+#endif
+    if (launch && sync) {
+        void *handle = nullptr;
+        launch(&handle, (void *)firstTouchTask, &ft, (int)count, 1, 1);
+        sync(handle);
+        return;
+    }
+#endif
+    memset(ft.ptr, 0, ft.size);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtSetCpuDeviceOptions(const ISPCRTCpuDeviceOptions *options) ISPCRT_CATCH_BEGIN {
+    if (options == nullptr)
+        throw std::runtime_error("options cannot be null!");
+    if (options->affinity == ISPCRT_CPU_AFFINITY_EXPLICIT && (options->cores == nullptr || options->numCores == 0))
+        throw std::runtime_error("explicit CPU affinity requires a list of cores");
+#ifdef ISPCRT_BUILD_CPU
+    cpuSetDeviceOptions(options);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+ISPCRTDevice ispcrtNewCpuSubDevice(const ISPCRTCpuDeviceOptions *options) ISPCRT_CATCH_BEGIN {
+    if (options == nullptr)
+        throw std::runtime_error("options cannot be null!");
+    if (options->affinity == ISPCRT_CPU_AFFINITY_EXPLICIT && (options->cores == nullptr || options->numCores == 0))
+        throw std::runtime_error("explicit CPU affinity requires a list of cores");
+#ifdef ISPCRT_BUILD_CPU
+    return (ISPCRTDevice)loadCPUSubDevice(options);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+}
+ISPCRT_CATCH_END(nullptr)
+
+void ispcrtGetCpuTopology(ISPCRTCpuTopology *topology) ISPCRT_CATCH_BEGIN {
+    if (topology == nullptr)
+        throw std::runtime_error("topology cannot be null!");
+#ifdef ISPCRT_BUILD_CPU
+    cpuTopology(topology);
+#else
+    throw std::runtime_error("CPU support not enabled");
+#endif
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+ISPCRTTaskPriority ispcrtGetCurrentTaskPriority() ISPCRT_CATCH_BEGIN {
+#ifdef ISPCRT_BUILD_CPU
+    return cpuCurrentTaskPriority();
+#else
+    return ISPCRT_TASK_PRIORITY_NORMAL;
+#endif
+}
+ISPCRT_CATCH_END(ISPCRT_TASK_PRIORITY_NORMAL)
+
 void *ispcrtSharedPtr(ISPCRTMemoryView h) ISPCRT_CATCH_BEGIN {
     auto &mv = referenceFromHandle<ispcrt::base::MemoryView>(h);
     return mv.devicePtr();
@@ -824,6 +1126,99 @@ void ispcrtModuleOptionsSetModuleType(ISPCRTModuleOptions o, ISPCRTModuleType ty
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+bool ispcrtModuleOptionsGetEagerKernels(ISPCRTModuleOptions o) ISPCRT_CATCH_BEGIN {
+    const auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    return opts.eagerKernels();
+}
+ISPCRT_CATCH_END(false)
+
+void ispcrtModuleOptionsSetEagerKernels(ISPCRTModuleOptions o, bool eager) ISPCRT_CATCH_BEGIN {
+    auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    opts.setEagerKernels(eager);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtModuleOptionsSetSpecConstant(ISPCRTModuleOptions o, uint32_t id, const void *value,
+                                        size_t size) ISPCRT_CATCH_BEGIN {
+    if (value == nullptr || (size != 1 && size != 2 && size != 4 && size != 8))
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "Invalid value of the specialization constant!");
+    auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    opts.setSpecConstant(id, value, size);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+namespace ispcrt {
+namespace base {
+
+// Module created by ispcrtLoadModuleAsync(), which is loaded by the device on
+// a separate thread.  The functions using the module wait for the loading with
+// get(), which also rethrows the exception, if the loading failed.
+struct AsyncModule : public Module {
+    AsyncModule(const Device &device, const char *moduleFile, const ModuleOptions &opts)
+        : m_device(device), m_opts(opts) {
+        m_device.refInc();
+        m_opts.refInc();
+        std::string file(moduleFile);
+        m_future = std::async(std::launch::async, [this, file]() { return m_device.newModule(file.c_str(), m_opts); });
+    }
+
+    ~AsyncModule() {
+        try {
+            tryGet()->refDec();
+        } catch (...) {
+            // The error is reported by the functions using the module.
+        }
+        m_opts.refDec();
+        m_device.refDec();
+    }
+
+    void *functionPtr(const char *name) const override { return get().functionPtr(name); }
+
+    bool kernelResources(const char *name, ISPCRTKernelResources &resources) const override {
+        return get().kernelResources(name, resources);
+    }
+
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_module != nullptr || m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    Module &get() const { return *tryGet(); }
+
+    // Return the module as is, if the module handle is not AsyncModule.
+    static Module &resolve(Module &module) {
+        auto *async = dynamic_cast<AsyncModule *>(&module);
+        return async ? async->get() : module;
+    }
+
+  private:
+    Module *tryGet() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_module == nullptr)
+            m_module = m_future.get();
+        return m_module;
+    }
+
+    const Device &m_device;
+    const ModuleOptions &m_opts;
+    mutable std::mutex m_mutex;
+    mutable std::future<Module *> m_future;
+    mutable Module *m_module{nullptr};
+};
+
+} // namespace base
+} // namespace ispcrt
+
+static std::vector<ispcrt::base::Module *> resolveModules(ISPCRTModule *modules, const uint32_t numModules) {
+    std::vector<ispcrt::base::Module *> resolved;
+    for (uint32_t i = 0; i < numModules; i++) {
+        auto &module = referenceFromHandle<ispcrt::base::Module>(modules[i]);
+        resolved.push_back(&ispcrt::base::AsyncModule::resolve(module));
+    }
+    return resolved;
+}
+
 ISPCRTModule ispcrtLoadModule(ISPCRTDevice d, const char *moduleFile) ISPCRT_CATCH_BEGIN {
     ISPCRTModule module;
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
@@ -838,20 +1233,83 @@ ISPCRTModule ispcrtLoadModuleWithOptions(ISPCRTDevice d, const char *moduleFile,
                                          ISPCRTModuleOptions o) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
     const auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    ispcrt::base::trace::Scope trace("module load");
+    trace.detail(moduleFile);
     return (ISPCRTModule)device.newModule(moduleFile, opts);
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTModule ispcrtLoadModuleFromSource(ISPCRTDevice d, const char *source, const char *const *options,
+                                        uint32_t numOptions) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    ispcrt::base::trace::Scope trace("module load from source");
+    return (ISPCRTModule)device.newModuleFromSource(source, options, numOptions);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTModule ispcrtLoadModuleFromMemory(ISPCRTDevice d, const void *data, size_t size,
+                                        ISPCRTModuleOptions o) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (data == nullptr || size == 0)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "The module image is empty");
+    ispcrt::base::trace::Scope trace("module load from memory");
+    if (o == nullptr) {
+        auto *opts = device.newModuleOptions();
+        try {
+            auto *module = device.newModuleFromMemory(data, size, *opts);
+            opts->refDec();
+            return (ISPCRTModule)module;
+        } catch (...) {
+            opts->refDec();
+            throw;
+        }
+    }
+    const auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    return (ISPCRTModule)device.newModuleFromMemory(data, size, opts);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTModule ispcrtLoadModuleAsync(ISPCRTDevice d, const char *moduleFile,
+                                   ISPCRTModuleOptions o) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    ispcrt::base::trace::Scope trace("module load async");
+    trace.detail(moduleFile);
+    if (o == nullptr) {
+        auto *opts = device.newModuleOptions();
+        auto *module = new ispcrt::base::AsyncModule(device, moduleFile, *opts);
+        opts->refDec();
+        return (ISPCRTModule)module;
+    }
+    const auto &opts = referenceFromHandle<ispcrt::base::ModuleOptions>(o);
+    return (ISPCRTModule) new ispcrt::base::AsyncModule(device, moduleFile, opts);
+}
+ISPCRT_CATCH_END(nullptr)
+
+bool ispcrtModuleIsLoaded(ISPCRTModule m) ISPCRT_CATCH_BEGIN {
+    auto &module = referenceFromHandle<ispcrt::base::Module>(m);
+    auto *async = dynamic_cast<ispcrt::base::AsyncModule *>(&module);
+    return async == nullptr || async->ready();
+}
+ISPCRT_CATCH_END(false)
+
+void ispcrtModuleWait(ISPCRTModule m) ISPCRT_CATCH_BEGIN {
+    auto &module = referenceFromHandle<ispcrt::base::Module>(m);
+    ispcrt::base::AsyncModule::resolve(module);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtDynamicLinkModules(ISPCRTDevice d, ISPCRTModule *modules, const uint32_t numModules) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
-    device.dynamicLinkModules((ispcrt::base::Module **)modules, numModules);
+    auto resolved = resolveModules(modules, numModules);
+    device.dynamicLinkModules(resolved.data(), numModules);
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
 ISPCRTModule ispcrtStaticLinkModules(ISPCRTDevice d, ISPCRTModule *modules,
                                      const uint32_t numModules) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
-    return (ISPCRTModule)device.staticLinkModules((ispcrt::base::Module **)modules, numModules);
+    auto resolved = resolveModules(modules, numModules);
+    return (ISPCRTModule)device.staticLinkModules(resolved.data(), numModules);
 }
 ISPCRT_CATCH_END(nullptr)
 
@@ -861,13 +1319,46 @@ void *ispcrtFunctionPtr(ISPCRTModule m, const char *name) ISPCRT_CATCH_BEGIN {
 }
 ISPCRT_CATCH_END(nullptr)
 
+bool ispcrtModuleGetKernelResources(ISPCRTModule m, const char *name,
+                                    ISPCRTKernelResources *resources) ISPCRT_CATCH_BEGIN {
+    if (name == nullptr || resources == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "kernel name and resources are required");
+    const auto &module = referenceFromHandle<ispcrt::base::Module>(m);
+    return module.kernelResources(name, *resources);
+}
+ISPCRT_CATCH_END(false)
+
 ISPCRTKernel ispcrtNewKernel(ISPCRTDevice d, ISPCRTModule m, const char *name) ISPCRT_CATCH_BEGIN {
+    return ispcrtNewKernelWithWidth(d, m, name, 0);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTKernel ispcrtNewKernelWithWidth(ISPCRTDevice d, ISPCRTModule m, const char *name,
+                                      uint32_t width) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
-    const auto &module = referenceFromHandle<ispcrt::base::Module>(m);
-    return (ISPCRTKernel)device.newKernel(module, name);
+    auto &module = referenceFromHandle<ispcrt::base::Module>(m);
+    ispcrt::base::trace::Scope trace("kernel create");
+    trace.detail(name);
+    const auto &resolved = ispcrt::base::AsyncModule::resolve(module);
+    auto *kernel = resolved.kernel(name, width, [&]() { return device.newKernel(resolved, name, width); });
+    if (trace.enabled())
+        ispcrt::base::trace::Tracer::get().kernelName(kernel, name);
+    return (ISPCRTKernel)kernel;
 }
 ISPCRT_CATCH_END(nullptr)
 
+uint32_t ispcrtKernelGetWidth(ISPCRTKernel k) ISPCRT_CATCH_BEGIN {
+    const auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    return kernel.width();
+}
+ISPCRT_CATCH_END(0)
+
+void ispcrtKernelSetGroupSize(ISPCRTKernel k, uint32_t x, uint32_t y, uint32_t z) ISPCRT_CATCH_BEGIN {
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    kernel.setGroupSize(x, y, z);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 ///////////////////////////////////////////////////////////////////////////////
 // Command lists //////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -878,9 +1369,31 @@ void ispcrtCommandListBarrier(ISPCRTCommandList l) ISPCRT_CATCH_BEGIN {
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+void ispcrtCommandListPrefetch(ISPCRTCommandList l, ISPCRTMemoryView mv, size_t size) ISPCRT_CATCH_BEGIN {
+    auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
+    auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    if (size > view.numBytes())
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "the prefetch is out of the memory view");
+    ispcrt::base::trace::Scope trace("prefetch", &list);
+    trace.bytes(size == 0 ? view.numBytes() : size);
+    list.prefetch(view, size == 0 ? view.numBytes() : size);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtCommandListMemAdvise(ISPCRTCommandList l, ISPCRTMemoryView mv, ISPCRTMemAdvice advice) ISPCRT_CATCH_BEGIN {
+    auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
+    auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    if (advice < ISPCRT_MEM_ADVICE_SET_READ_MOSTLY || advice > ISPCRT_MEM_ADVICE_CLEAR_NON_ATOMIC_MOSTLY)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "unknown memory advice");
+    list.memAdvise(view, advice);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 ISPCRTFuture ispcrtCommandListCopyToDevice(ISPCRTCommandList l, ISPCRTMemoryView mv) ISPCRT_CATCH_BEGIN {
     auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
     auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    ispcrt::base::trace::Scope trace("copy to device", &list);
+    trace.bytes(view.numBytes());
     return (ISPCRTFuture)list.copyToDevice(view);
 }
 ISPCRT_CATCH_END(nullptr)
@@ -888,6 +1401,8 @@ ISPCRT_CATCH_END(nullptr)
 ISPCRTFuture ispcrtCommandListCopyToHost(ISPCRTCommandList l, ISPCRTMemoryView mv) ISPCRT_CATCH_BEGIN {
     auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
     auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    ispcrt::base::trace::Scope trace("copy to host", &list);
+    trace.bytes(view.numBytes());
     return (ISPCRTFuture)list.copyToHost(view);
 }
 ISPCRT_CATCH_END(nullptr)
@@ -903,6 +1418,8 @@ ISPCRTFuture ispcrtCommandListCopyMemoryView(ISPCRTCommandList l, ISPCRTMemoryVi
     if (size > viewSrc.numBytes()) {
         throw std::runtime_error("Requested copy size is bigger than source buffer size!");
     }
+    ispcrt::base::trace::Scope trace("copy memory view", &list);
+    trace.bytes(size);
     return (ISPCRTFuture)list.copyMemoryView(viewDst, viewSrc, size);
 }
 ISPCRT_CATCH_END(nullptr)
@@ -929,10 +1446,25 @@ ISPCRTFuture ispcrtCommandListLaunch3D(ISPCRTCommandList l, ISPCRTKernel k, ISPC
     if (p)
         params = &referenceFromHandle<ispcrt::base::MemoryView>(p);
 
+    ispcrt::base::trace::Scope trace("launch", &list);
+    trace.launch(&kernel, dim0, dim1, dim2);
     return (ISPCRTFuture)list.launch(kernel, params, dim0, dim1, dim2);
 }
 ISPCRT_CATCH_END(nullptr)
 
+void ispcrtCommandListUpdateLaunch(ISPCRTCommandList l, ISPCRTFuture f, ISPCRTMemoryView p) ISPCRT_CATCH_BEGIN {
+    auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
+    auto &future = referenceFromHandle<ispcrt::base::Future>(f);
+
+    ispcrt::base::MemoryView *params = nullptr;
+
+    if (p)
+        params = &referenceFromHandle<ispcrt::base::MemoryView>(p);
+
+    list.updateLaunch(future, params);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtCommandListClose(ISPCRTCommandList l) ISPCRT_CATCH_BEGIN {
     auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
     list.close();
@@ -941,6 +1473,7 @@ ISPCRT_CATCH_END_NO_RETURN()
 
 ISPCRTFence ispcrtCommandListSubmit(ISPCRTCommandList l) ISPCRT_CATCH_BEGIN {
     auto &list = referenceFromHandle<ispcrt::base::CommandList>(l);
+    ispcrt::base::trace::Scope trace("submit", &list);
     return (ISPCRTFence)list.submit();
 }
 ISPCRT_CATCH_END(nullptr)
@@ -981,6 +1514,7 @@ ISPCRT_CATCH_END(nullptr)
 
 void ispcrtCommandQueueSync(ISPCRTCommandQueue q) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::CommandQueue>(q);
+    ispcrt::base::trace::Scope trace("command queue sync", &queue);
     queue.sync();
 }
 ISPCRT_CATCH_END_NO_RETURN()
@@ -997,10 +1531,24 @@ ISPCRT_CATCH_END(nullptr)
 
 ISPCRTTaskQueue ispcrtNewTaskQueue(ISPCRTDevice d) ISPCRT_CATCH_BEGIN {
     const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
-    return (ISPCRTTaskQueue)device.newTaskQueue();
+    return (ISPCRTTaskQueue)device.newTaskQueue(ISPCRT_TASK_QUEUE_DEFAULT);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTTaskQueue ispcrtNewTaskQueueWithFlags(ISPCRTDevice d, uint32_t flags) ISPCRT_CATCH_BEGIN {
+    const auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    return (ISPCRTTaskQueue)device.newTaskQueue(flags);
 }
 ISPCRT_CATCH_END(nullptr)
 
+void ispcrtSetLaunchPriority(ISPCRTTaskQueue q, ISPCRTTaskPriority priority) ISPCRT_CATCH_BEGIN {
+    if (priority < ISPCRT_TASK_PRIORITY_NORMAL || priority > ISPCRT_TASK_PRIORITY_LOW)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "unknown task priority");
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    queue.setLaunchPriority(priority);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtDeviceBarrier(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
     queue.barrier();
@@ -1010,6 +1558,8 @@ ISPCRT_CATCH_END_NO_RETURN()
 void ispcrtCopyToDevice(ISPCRTTaskQueue q, ISPCRTMemoryView mv) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
     auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    ispcrt::base::trace::Scope trace("copy to device", &queue);
+    trace.bytes(view.numBytes());
     queue.copyToDevice(view);
 }
 ISPCRT_CATCH_END_NO_RETURN()
@@ -1017,10 +1567,39 @@ ISPCRT_CATCH_END_NO_RETURN()
 void ispcrtCopyToHost(ISPCRTTaskQueue q, ISPCRTMemoryView mv) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
     auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    ispcrt::base::trace::Scope trace("copy to host", &queue);
+    trace.bytes(view.numBytes());
     queue.copyToHost(view);
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+static void checkCopyRange(ispcrt::base::MemoryView &view, size_t offset, size_t size) {
+    if (offset > view.numBytes() || size > view.numBytes() - offset) {
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                 "Requested copy range is beyond the memory view size!");
+    }
+}
+
+void ispcrtCopyToDeviceRange(ISPCRTTaskQueue q, ISPCRTMemoryView mv, size_t offset, size_t size) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    checkCopyRange(view, offset, size);
+    ispcrt::base::trace::Scope trace("copy to device", &queue);
+    trace.bytes(size);
+    queue.copyToDevice(view, offset, size);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtCopyToHostRange(ISPCRTTaskQueue q, ISPCRTMemoryView mv, size_t offset, size_t size) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &view = referenceFromHandle<ispcrt::base::MemoryView>(mv);
+    checkCopyRange(view, offset, size);
+    ispcrt::base::trace::Scope trace("copy to host", &queue);
+    trace.bytes(size);
+    queue.copyToHost(view, offset, size);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtCopyMemoryView(ISPCRTTaskQueue q, ISPCRTMemoryView mvDst, ISPCRTMemoryView mvSrc,
                           const size_t size) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
@@ -1032,6 +1611,8 @@ void ispcrtCopyMemoryView(ISPCRTTaskQueue q, ISPCRTMemoryView mvDst, ISPCRTMemor
     if (size > viewSrc.numBytes()) {
         throw std::runtime_error("Requested copy size is bigger than source buffer size!");
     }
+    ispcrt::base::trace::Scope trace("copy memory view", &queue);
+    trace.bytes(size);
     queue.copyMemoryView(viewDst, viewSrc, size);
 }
 ISPCRT_CATCH_END_NO_RETURN()
@@ -1057,18 +1638,240 @@ ISPCRTFuture ispcrtLaunch3D(ISPCRTTaskQueue q, ISPCRTKernel k, ISPCRTMemoryView
     if (p)
         params = &referenceFromHandle<ispcrt::base::MemoryView>(p);
 
-    return (ISPCRTFuture)queue.launch(kernel, params, dim0, dim1, dim2);
+    ispcrt::base::trace::Scope trace("launch", &queue);
+    trace.launch(&kernel, dim0, dim1, dim2);
+    auto *future = queue.launch(kernel, params, dim0, dim1, dim2);
+    trace.future(future);
+    return (ISPCRTFuture)future;
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTFuture ispcrtLaunchWithArgs1D(ISPCRTTaskQueue q, ISPCRTKernel k, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0) ISPCRT_CATCH_BEGIN {
+    return ispcrtLaunchWithArgs3D(q, k, numArgs, args, dim0, 1, 1);
+}
+ISPCRT_CATCH_END(nullptr)
+
+ISPCRTFuture ispcrtLaunchWithArgs2D(ISPCRTTaskQueue q, ISPCRTKernel k, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0, size_t dim1) ISPCRT_CATCH_BEGIN {
+    return ispcrtLaunchWithArgs3D(q, k, numArgs, args, dim0, dim1, 1);
 }
 ISPCRT_CATCH_END(nullptr)
 
+ISPCRTFuture ispcrtLaunchWithArgs3D(ISPCRTTaskQueue q, ISPCRTKernel k, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0, size_t dim1, size_t dim2) ISPCRT_CATCH_BEGIN {
+    auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+
+    if (numArgs > 0 && args == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "the kernel arguments are null");
+
+    // Lay out the arguments like the fields of a C structure, each of them is
+    // aligned to the largest power of two dividing its size up to 16 bytes.
+    // The block is reused by the launches of the thread, which copy it.
+    static thread_local ispcrt::base::KernelArgs kernelArgs;
+    kernelArgs.args.clear();
+    size_t offset = 0;
+    for (uint32_t i = 0; i < numArgs; i++) {
+        if (args[i].value == nullptr || args[i].size == 0)
+            throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "the kernel argument has no value");
+        const size_t alignment = std::min(args[i].size & (~args[i].size + 1), (size_t)16);
+        offset = (offset + alignment - 1) & ~(alignment - 1);
+        kernelArgs.args.push_back({offset, args[i].size});
+        offset += args[i].size;
+    }
+    kernelArgs.data.resize(offset);
+    for (uint32_t i = 0; i < numArgs; i++)
+        memcpy(kernelArgs.data.data() + kernelArgs.args[i].first, args[i].value, args[i].size);
+
+    ispcrt::base::trace::Scope trace("launch", &queue);
+    trace.launch(&kernel, dim0, dim1, dim2);
+    auto *future = queue.launch(kernel, kernelArgs, dim0, dim1, dim2);
+    trace.future(future);
+    return (ISPCRTFuture)future;
+}
+ISPCRT_CATCH_END(nullptr)
+
+///////////////////////////////////////////////////////////////////////////////
+// Multi-device launches //////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void ispcrtLaunchSplit3D(uint32_t numQueues, const ISPCRTTaskQueue *queues, const ISPCRTKernel *kernels,
+                         const ISPCRTMemoryView *params, const float *weights, size_t dim0, size_t dim1, size_t dim2,
+                         ISPCRTFuture *futures) ISPCRT_CATCH_BEGIN {
+    if (numQueues == 0 || queues == nullptr || kernels == nullptr || params == nullptr || futures == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "no queues to split the launch over");
+
+    const size_t dims[3] = {dim0, dim1, dim2};
+    if (dim0 > UINT32_MAX || dim1 > UINT32_MAX || dim2 > UINT32_MAX)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "the launch is too large to split");
+
+    // Split the slowest varying dimension, so every part is a contiguous
+    // range of the task indices.
+    int splitDim = 0;
+    for (int d = 2; d > 0; d--) {
+        if (dims[d] > 1) {
+            splitDim = d;
+            break;
+        }
+    }
+
+    double totalWeight = 0;
+    for (uint32_t i = 0; i < numQueues; i++) {
+        const double w = weights ? weights[i] : 1.0;
+        if (!(w >= 0))
+            throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "negative weight of the launch part");
+        totalWeight += w;
+    }
+    if (totalWeight == 0)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "all weights of the launch parts are zero");
+
+    const size_t total = dims[splitDim];
+    double cumulativeWeight = 0;
+    size_t begin = 0;
+    for (uint32_t i = 0; i < numQueues; i++) {
+        cumulativeWeight += weights ? weights[i] : 1.0;
+        const size_t end = i + 1 == numQueues ? total : std::min(total, size_t(total * cumulativeWeight / totalWeight));
+        futures[i] = nullptr;
+        if (end <= begin)
+            continue;
+
+        auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(queues[i]);
+        auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(kernels[i]);
+        auto &view = referenceFromHandle<ispcrt::base::MemoryView>(params[i]);
+        if (view.numBytes() < sizeof(ISPCRTTaskOffset))
+            throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT,
+                                                     "the parameters don't start with ISPCRTTaskOffset");
+
+        ISPCRTTaskOffset header = {{0, 0, 0}, {uint32_t(dim0), uint32_t(dim1), uint32_t(dim2)}};
+        header.offset[splitDim] = uint32_t(begin);
+        std::memcpy(view.hostPtr(), &header, sizeof(header));
+        if (!view.isShared())
+            queue.copyToDevice(view);
+
+        size_t partDims[3] = {dim0, dim1, dim2};
+        partDims[splitDim] = end - begin;
+        futures[i] = (ISPCRTFuture)queue.launch(kernel, &view, partDims[0], partDims[1], partDims[2]);
+        begin = end;
+    }
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtUpdateSplitWeights(uint32_t numParts, const ISPCRTFuture *futures, float *weights) ISPCRT_CATCH_BEGIN {
+    if (numParts == 0 || futures == nullptr || weights == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "no launch parts to update");
+
+    const double minShare = 0.01;
+    double totalWeight = 0;
+    for (uint32_t i = 0; i < numParts; i++)
+        totalWeight += weights[i] > 0 ? weights[i] : 0;
+    if (totalWeight == 0)
+        totalWeight = 1;
+
+    // Old shares and the measured throughput of the parts.
+    std::vector<double> share(numParts), rate(numParts, 0);
+    double measuredShare = 0, totalRate = 0;
+    for (uint32_t i = 0; i < numParts; i++) {
+        share[i] = (weights[i] > 0 ? weights[i] : 0) / totalWeight;
+        if (futures[i] == nullptr)
+            continue;
+        auto &future = referenceFromHandle<ispcrt::base::Future>(futures[i]);
+        if (!future.valid() || future.time() == 0 || share[i] == 0)
+            continue;
+        rate[i] = share[i] / future.time();
+        measuredShare += share[i];
+        totalRate += rate[i];
+    }
+
+    // The measured parts split their old share in proportion to their rate.
+    double newTotal = 0;
+    for (uint32_t i = 0; i < numParts; i++) {
+        double s = share[i];
+        if (rate[i] > 0)
+            s = 0.5 * s + 0.5 * measuredShare * rate[i] / totalRate;
+        share[i] = std::max(s, minShare);
+        newTotal += share[i];
+    }
+    for (uint32_t i = 0; i < numParts; i++)
+        weights[i] = float(share[i] / newTotal);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+///////////////////////////////////////////////////////////////////////////////
+// Pipelines //////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+ISPCRTPipeline ispcrtNewPipeline(ISPCRTDevice d, uint32_t depth) ISPCRT_CATCH_BEGIN {
+    auto &device = referenceFromHandle<ispcrt::base::Device>(d);
+    if (depth == 0)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "the depth of a pipeline must be at least 1");
+    return (ISPCRTPipeline) new ispcrt::base::Pipeline(device, depth);
+}
+ISPCRT_CATCH_END(nullptr)
+
+uint32_t ispcrtPipelineAddBuffer(ISPCRTPipeline p, size_t size, ISPCRTNewMemoryViewFlags *flags) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    if (flags->allocType != ISPCRT_ALLOC_TYPE_SHARED && flags->allocType != ISPCRT_ALLOC_TYPE_DEVICE) {
+        throw std::runtime_error("Unsupported memory allocation type requested!");
+    }
+    return pipeline.addBuffer(size, flags);
+}
+ISPCRT_CATCH_END(UINT32_MAX)
+
+ISPCRTMemoryView ispcrtPipelineGetBuffer(ISPCRTPipeline p, uint32_t buffer, uint32_t slot) ISPCRT_CATCH_BEGIN {
+    const auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    return (ISPCRTMemoryView)&pipeline.buffer(buffer, slot);
+}
+ISPCRT_CATCH_END(nullptr)
+
+void ispcrtPipelineAddKernelStage(ISPCRTPipeline p, ISPCRTKernel k, const ISPCRTMemoryView *params, size_t dim0,
+                                  size_t dim1, size_t dim2) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    auto &kernel = referenceFromHandle<ispcrt::base::Kernel>(k);
+    pipeline.addKernelStage(kernel, (ispcrt::base::MemoryView *const *)params, dim0, dim1, dim2);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtPipelineAddCopyToDeviceStage(ISPCRTPipeline p, uint32_t buffer) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    pipeline.addCopyStage(buffer, true);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtPipelineAddCopyToHostStage(ISPCRTPipeline p, uint32_t buffer) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    pipeline.addCopyStage(buffer, false);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+void ispcrtPipelineAddHostStage(ISPCRTPipeline p, ISPCRTPipelineStageFType fcn, void *userData) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    pipeline.addHostStage(fcn, userData);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+uint64_t ispcrtPipelineSubmit(ISPCRTPipeline p) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    return pipeline.submit();
+}
+ISPCRT_CATCH_END(UINT64_MAX)
+
+void ispcrtPipelineSync(ISPCRTPipeline p) ISPCRT_CATCH_BEGIN {
+    auto &pipeline = referenceFromHandle<ispcrt::base::Pipeline>(p);
+    pipeline.sync();
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 void ispcrtSync(ISPCRTTaskQueue q) ISPCRT_CATCH_BEGIN {
     auto &queue = referenceFromHandle<ispcrt::base::TaskQueue>(q);
+    ispcrt::base::trace::Scope trace("sync", &queue);
     queue.sync();
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
 void ispcrtFenceSync(ISPCRTFence f) ISPCRT_CATCH_BEGIN {
     auto &fence = referenceFromHandle<ispcrt::base::Fence>(f);
+    ispcrt::base::trace::Scope trace("fence sync");
     fence.sync();
 }
 ISPCRT_CATCH_END_NO_RETURN()
@@ -1085,6 +1888,143 @@ void ispcrtFenceReset(ISPCRTFence f) ISPCRT_CATCH_BEGIN {
 }
 ISPCRT_CATCH_END_NO_RETURN()
 
+static std::vector<ispcrt::base::Fence *> fenceList(const ISPCRTFence *fences, uint32_t numFences) {
+    if (fences == nullptr || numFences == 0)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "No fences to wait for");
+    std::vector<ispcrt::base::Fence *> list;
+    for (uint32_t i = 0; i < numFences; i++)
+        list.push_back(&referenceFromHandle<ispcrt::base::Fence>(fences[i]));
+    return list;
+}
+
+// Level Zero can only block on a single fence, so the waits for several fences
+// block on one of them at a time for this long and check the others in between.
+static constexpr uint64_t FENCE_WAIT_SLICE_NS = 100000;
+
+int32_t ispcrtFenceWaitAny(const ISPCRTFence *fences, uint32_t numFences, uint64_t timeoutNs) ISPCRT_CATCH_BEGIN {
+    const auto list = fenceList(fences, numFences);
+    ispcrt::base::trace::Scope trace("fence wait any");
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t next = 0;; next = (next + 1) % numFences) {
+        for (uint32_t i = 0; i < numFences; i++) {
+            if (list[i]->status() == ISPCRT_FENCE_SIGNALED)
+                return (int32_t)i;
+        }
+        const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+        if (elapsed >= timeoutNs)
+            return -1;
+        if (list[next]->wait(std::min(FENCE_WAIT_SLICE_NS, timeoutNs - elapsed)))
+            return (int32_t)next;
+    }
+}
+ISPCRT_CATCH_END(-1)
+
+bool ispcrtFenceWaitAll(const ISPCRTFence *fences, uint32_t numFences, uint64_t timeoutNs) ISPCRT_CATCH_BEGIN {
+    const auto list = fenceList(fences, numFences);
+    ispcrt::base::trace::Scope trace("fence wait all");
+    const auto start = std::chrono::steady_clock::now();
+    for (auto *fence : list) {
+        const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+        if (timeoutNs == UINT64_MAX ? !fence->wait(UINT64_MAX)
+                                    : (elapsed > timeoutNs || !fence->wait(timeoutNs - elapsed)))
+            return false;
+    }
+    return true;
+}
+ISPCRT_CATCH_END(false)
+
+namespace ispcrt {
+namespace base {
+
+// The thread running the fence callbacks, which is started with the first
+// callback. It blocks on the oldest unsignaled fence for a while and checks the
+// others in between, or sleeps while there are no callbacks.
+class FenceCallbacks {
+  public:
+    static FenceCallbacks &instance() {
+        static FenceCallbacks callbacks;
+        return callbacks;
+    }
+
+    ~FenceCallbacks() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void add(Fence &fence, ISPCRTFenceCallback callback, void *userData) {
+        fence.refInc();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_added.push_back({&fence, callback, userData});
+        if (!m_thread.joinable())
+            m_thread = std::thread(&FenceCallbacks::run, this);
+        m_cv.notify_one();
+    }
+
+  private:
+    struct Callback {
+        Fence *fence;
+        ISPCRTFenceCallback callback;
+        void *userData;
+    };
+
+    void run() {
+        std::vector<Callback> waiting;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]() { return m_stop || !m_added.empty() || !waiting.empty(); });
+                if (m_stop)
+                    return;
+                waiting.insert(waiting.end(), m_added.begin(), m_added.end());
+                m_added.clear();
+            }
+            waiting.erase(std::remove_if(waiting.begin(), waiting.end(), done), waiting.end());
+            if (!waiting.empty())
+                wait(*waiting.front().fence);
+        }
+    }
+
+    // Run the callback if the fence is signaled. The callback is dropped if
+    // the status of the fence can't be queried.
+    static bool done(const Callback &c) ISPCRT_CATCH_BEGIN {
+        if (c.fence->status() != ISPCRT_FENCE_SIGNALED)
+            return false;
+        c.callback((ISPCRTFence)c.fence, c.userData);
+        c.fence->refDec();
+        return true;
+    }
+    ISPCRT_CATCH_END(true)
+
+    static void wait(Fence &fence) ISPCRT_CATCH_BEGIN { fence.wait(FENCE_WAIT_SLICE_NS); }
+    ISPCRT_CATCH_END_NO_RETURN()
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    std::vector<Callback> m_added;
+    bool m_stop{false};
+};
+
+} // namespace base
+} // namespace ispcrt
+
+void ispcrtFenceSetCallback(ISPCRTFence f, ISPCRTFenceCallback callback, void *userData) ISPCRT_CATCH_BEGIN {
+    auto &fence = referenceFromHandle<ispcrt::base::Fence>(f);
+    if (callback == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "No fence callback");
+    ispcrt::base::FenceCallbacks::instance().add(fence, callback, userData);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
 ISPCRTGenericHandle ispcrtFenceNativeHandle(ISPCRTFence f) ISPCRT_CATCH_BEGIN {
     auto &fence = referenceFromHandle<ispcrt::base::Fence>(f);
     return fence.nativeHandle();
@@ -1110,6 +2050,22 @@ bool ispcrtFutureIsValid(ISPCRTFuture f) ISPCRT_CATCH_BEGIN {
 }
 ISPCRT_CATCH_END(false)
 
+///////////////////////////////////////////////////////////////////////////////
+// Tracing ////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void ispcrtTraceEnable(uint32_t eventsPerThread) ISPCRT_CATCH_BEGIN {
+    ispcrt::base::trace::Tracer::get().enable(eventsPerThread);
+}
+ISPCRT_CATCH_END_NO_RETURN()
+
+bool ispcrtTraceWrite(const char *fileName) ISPCRT_CATCH_BEGIN {
+    if (fileName == nullptr)
+        throw ispcrt::base::ispcrt_runtime_error(ISPCRT_INVALID_ARGUMENT, "no trace file name");
+    return ispcrt::base::trace::Tracer::get().write(fileName);
+}
+ISPCRT_CATCH_END(false)
+
 ///////////////////////////////////////////////////////////////////////////////
 // Native handles//////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@ struct _ISPCRTFuture;
 struct _ISPCRTFence;
 struct _ISPCRTCommandQueue;
 struct _ISPCRTCommandList;
+struct _ISPCRTPipeline;
 
 typedef _ISPCRTContext *ISPCRTContext;
 typedef _ISPCRTDevice *ISPCRTDevice;
@@ -36,6 +37,7 @@ typedef _ISPCRTFuture *ISPCRTFuture;
 typedef _ISPCRTFence *ISPCRTFence;
 typedef _ISPCRTCommandQueue *ISPCRTCommandQueue;
 typedef _ISPCRTCommandList *ISPCRTCommandList;
+typedef _ISPCRTPipeline *ISPCRTPipeline;
 #else
 typedef void *ISPCRTContext;
 typedef void *ISPCRTDevice;
@@ -48,6 +50,7 @@ typedef void *ISPCRTFuture;
 typedef void *ISPCRTFence;
 typedef void *ISPCRTCommandQueue;
 typedef void *ISPCRTCommandList;
+typedef void *ISPCRTPipeline;
 #endif
 
 // NOTE: ISPCRTGenericHandle usage implies compatibility with any of the above
@@ -85,6 +88,98 @@ typedef void (*ISPCRTTaskingSyncFType)(void *);
 // Applications can provide their own implementation of ISPCLaunch/ISPCAlloc/ISPCSync tasking API.
 void ispcrtSetTaskingCallbacks(ISPCRTTaskingLaunchFType, ISPCRTTaskingAllocFType, ISPCRTTaskingSyncFType);
 
+typedef struct {
+    ISPCRTTaskingLaunchFType launch;
+    ISPCRTTaskingAllocFType alloc;
+    ISPCRTTaskingSyncFType sync;
+} ISPCRTTaskingCallbacks;
+
+// Priority of the kernel launches of a task queue, see
+// ispcrtSetLaunchPriority(). The nested launches of the tasks inherit it.
+typedef enum {
+    ISPCRT_TASK_PRIORITY_NORMAL = 0,
+    // Latency critical launches: the tasks of the lower priority launches,
+    // which are waiting to run, run only after the waiting tasks of these.
+    // The running tasks are not interrupted.
+    ISPCRT_TASK_PRIORITY_HIGH,
+    // Batch launches, which run when no tasks of the higher priorities wait.
+    ISPCRT_TASK_PRIORITY_LOW,
+} ISPCRTTaskPriority;
+
+// Priority of the launch, which the calling thread runs, e.g. for the
+// executors set by ispcrtContextSetTaskingCallbacks() to pick the queue or
+// the arena for the tasks. ISPCRT_TASK_PRIORITY_NORMAL outside of launches.
+ISPCRTTaskPriority ispcrtGetCurrentTaskPriority(void);
+
+// CPU thread and memory placement.
+typedef enum {
+    // Worker threads are not pinned.
+    ISPCRT_CPU_AFFINITY_NONE = 0,
+    // Fill the CPUs of one NUMA node before the next one.
+    ISPCRT_CPU_AFFINITY_COMPACT,
+    // Distribute the worker threads over the NUMA nodes round robin.
+    ISPCRT_CPU_AFFINITY_SCATTER,
+    // One worker thread per CPU in ISPCRTCpuDeviceOptions::cores.
+    ISPCRT_CPU_AFFINITY_EXPLICIT,
+    // Only the performance cores of a hybrid CPU, e.g. for the kernels with
+    // wide vectors, which run slower on the efficient cores.  The same as
+    // compact on the other CPUs.
+    ISPCRT_CPU_AFFINITY_PERFORMANCE,
+} ISPCRTCpuAffinity;
+
+typedef struct {
+    ISPCRTCpuAffinity affinity;
+    const uint32_t *cores;
+    uint32_t numCores;
+    // NUMA node, which allocates the memory of CPU memory views, or -1 to let
+    // the OS place the pages where they are first touched.
+    int32_t memoryNode;
+} ISPCRTCpuDeviceOptions;
+
+// Overrides ISPCRT_CPU_AFFINITY and ISPCRT_CPU_MEMORY_NODE environment
+// variables. The thread affinity is used only by the built-in pthreads
+// tasking model and only if it is set before the first launch.
+void ispcrtSetCpuDeviceOptions(const ISPCRTCpuDeviceOptions *);
+
+// Creates a CPU sub-device, which runs the kernels launched through its
+// queues and their tasks on a worker pool of its own, placed with the given
+// affinity, e.g. on an explicit list of cores, and allocates its memory views
+// on options->memoryNode.  Sub-devices on disjoint cores don't share threads,
+// so the workloads on them don't delay each other.  Requires the built-in
+// pthreads tasking model, ISPCRT_UNSUPPORTED is reported otherwise.  The
+// tasks launched by the application threads directly still go to the
+// default pool.
+ISPCRTDevice ispcrtNewCpuSubDevice(const ISPCRTCpuDeviceOptions *);
+
+// Host CPU topology, the same as reported by the check_isa tool.
+#define ISPCRT_CPU_CACHE_LEVELS 4
+
+typedef struct {
+    // Best ISA of the CPU, e.g. "AVX2 (codename Haswell)".
+    const char *isa;
+    // Recommended --target list, best target first.
+    const char *targets;
+    uint32_t numPackages;
+    uint32_t numCores;
+    uint32_t numThreads;
+    // Hardware threads, which the process is allowed to run on.
+    uint32_t numAvailableThreads;
+    // Both are zero if the CPU is not hybrid.
+    uint32_t numPerformanceCores;
+    uint32_t numEfficiencyCores;
+    uint32_t numNumaNodes;
+    // Data or unified cache size in bytes and the number of hardware threads
+    // sharing one cache per level (index 0 is L1), zero if unknown.
+    uint64_t cacheSize[ISPCRT_CPU_CACHE_LEVELS];
+    uint32_t cacheSharing[ISPCRT_CPU_CACHE_LEVELS];
+    // 512-bit FMA units per core, zero if unknown or no AVX512.
+    uint32_t avx512FmaUnits;
+    // Recommended number of tasks to launch for a parallel loop.
+    uint32_t taskCount;
+} ISPCRTCpuTopology;
+
+void ispcrtGetCpuTopology(ISPCRTCpuTopology *);
+
 // Object lifetime ////////////////////////////////////////////////////////////
 
 long long ispcrtUseCount(ISPCRTGenericHandle);
@@ -123,6 +218,14 @@ ISPCRTContext ispcrtNewContext(ISPCRTDeviceType);
 // Alternatively ISPCRTContext can be constructed from context native handler
 ISPCRTContext ispcrtGetContextFromNativeHandle(ISPCRTDeviceType, ISPCRTGenericHandle c);
 
+// Run the tasks of the kernels launched by the CPU devices of the context,
+// i.e. obtained with ispcrtGetDeviceFromContext() after this call, with the
+// executor of the application, e.g. in a TBB arena, instead of the built-in
+// tasking runtime. The nested launches of these tasks use the executor too.
+// The callbacks set with ispcrtSetTaskingCallbacks() replace both for the
+// whole process. NULL restores the built-in runtime. CPU contexts only.
+void ispcrtContextSetTaskingCallbacks(ISPCRTContext, const ISPCRTTaskingCallbacks *);
+
 // MemoryViews ////////////////////////////////////////////////////////////////
 
 // Choose allocation type
@@ -155,6 +258,51 @@ ISPCRTMemoryView ispcrtNewMemoryView(ISPCRTDevice, void *appMemory, size_t numBy
 ISPCRTMemoryView ispcrtNewMemoryViewForContext(ISPCRTContext c, void *appMemory, size_t numBytes,
                                                ISPCRTNewMemoryViewFlags *flags);
 
+// Page and NUMA placement of the memory allocated for the view. The flags are
+// honored by the CPU device on Linux and ignored where the OS or the device
+// doesn't support them.
+typedef enum {
+    ISPCRT_MEM_DEFAULT = 0,
+    // Advise the OS to back the memory with transparent huge pages.
+    ISPCRT_MEM_HUGE_PAGES = 1 << 0,
+    // Allocate the memory from the reserved 2 MB or 1 GB huge pages, falling
+    // back to ISPCRT_MEM_HUGE_PAGES if there are not enough of them.
+    ISPCRT_MEM_HUGE_PAGES_2MB = 1 << 1,
+    ISPCRT_MEM_HUGE_PAGES_1GB = 1 << 2,
+    // Bind the memory to the NUMA node numaNode.
+    ISPCRT_MEM_NUMA_BIND = 1 << 3,
+    // Interleave the pages of the memory over all NUMA nodes.
+    ISPCRT_MEM_NUMA_INTERLEAVE = 1 << 4,
+    // Fault in all pages of the memory at the allocation.
+    ISPCRT_MEM_PREFAULT = 1 << 5,
+} ISPCRTMemoryPlacementFlags;
+
+typedef struct {
+    // A bitmask of ISPCRTMemoryPlacementFlags.
+    uint32_t flags;
+    // The node for ISPCRT_MEM_NUMA_BIND.
+    uint32_t numaNode;
+} ISPCRTMemoryPlacement;
+
+// The same as ispcrtNewMemoryView(), with the placement of the memory that is
+// allocated for the view.  A NULL placement is the default placement.
+ISPCRTMemoryView ispcrtNewMemoryViewWithPlacement(ISPCRTDevice, void *appMemory, size_t numBytes,
+                                                  ISPCRTNewMemoryViewFlags *flags,
+                                                  const ISPCRTMemoryPlacement *placement);
+// Create the device memory view of appMemory (which must not be NULL), which
+// is zero-copy on the CPU device: the device pointer is appMemory itself, no
+// memory is allocated for the view and copies between the host and the
+// device are no-ops.  On the other devices it is the same as the memory view
+// created with ISPCRT_ALLOC_TYPE_DEVICE, so code that is portable between
+// the devices keeps the explicit copies.
+ISPCRTMemoryView ispcrtNewZeroCopyMemoryView(ISPCRTDevice, void *appMemory, size_t numBytes);
+// Create the view of numBytes bytes at offset of the memory of the view
+// parent, which shares its host and device memory, so no memory is allocated
+// for it.  The slice can be passed to the kernels and the copies like any
+// other view, and its copies transfer only its range.  It keeps parent alive
+// and it is released like any other view.  The range must be within parent.
+ISPCRTMemoryView ispcrtNewMemoryViewSlice(ISPCRTMemoryView parent, size_t offset, size_t numBytes);
+
 void *ispcrtHostPtr(ISPCRTMemoryView);
 void *ispcrtDevicePtr(ISPCRTMemoryView);
 void *ispcrtSharedPtr(ISPCRTMemoryView);
@@ -164,6 +312,44 @@ size_t ispcrtSize(ISPCRTMemoryView);
 ISPCRTAllocationType ispcrtGetMemoryViewAllocType(ISPCRTMemoryView);
 ISPCRTAllocationType ispcrtGetMemoryAllocType(ISPCRTDevice d, void *memBuffer);
 
+// Memory pools of the shared memory (ISPCRT_MEM_POOL=1) exist for the
+// ISPCRT_SM_HOST_WRITE_DEVICE_READ and ISPCRT_SM_HOST_READ_DEVICE_WRITE hints
+// of the GPU context. The pool reserves bulks of memory, which are split into
+// chunks of the same power of 2 size.
+typedef struct {
+    size_t bytesReserved;
+    size_t bytesInUse;
+    size_t peakBytesReserved;
+    // The limit set by ispcrtContextSetMemPoolLimit, 0 if there is none
+    size_t maxBytesReserved;
+} ISPCRTMemPoolStats;
+
+typedef struct {
+    size_t chunkSize;
+    uint32_t numBulks;
+    // Reserved bytes minus bytes in use are free, but can be used only by
+    // the chunks of this size.
+    size_t bytesReserved;
+    size_t bytesInUse;
+} ISPCRTMemPoolChunkStats;
+
+// Fill stats and up to *numChunks elements of chunks (if not NULL), then set
+// *numChunks to the number of chunk sizes of the pool.
+void ispcrtContextGetMemPoolStats(ISPCRTContext, ISPCRTSharedMemoryAllocationHint, ISPCRTMemPoolStats *stats,
+                                  ISPCRTMemPoolChunkStats *chunks, uint32_t *numChunks);
+// Return the memory of the bulks without any chunk in use to the driver and
+// return the number of bytes released.
+size_t ispcrtContextTrimMemPool(ISPCRTContext, ISPCRTSharedMemoryAllocationHint);
+// Limit the memory reserved by the pool, 0 means unlimited. The empty bulks
+// are released when the limit is reached, the allocations, which still don't
+// fit, bypass the pool.
+void ispcrtContextSetMemPoolLimit(ISPCRTContext, ISPCRTSharedMemoryAllocationHint, size_t maxBytesReserved);
+
+// Zero the memory of the CPU memory view in numChunks tasks of the tasking
+// runtime, so every page is first touched by the thread, which runs the
+// task with the same index over the same part of the memory.
+void ispcrtFirstTouch(ISPCRTDevice, ISPCRTMemoryView, uint32_t numChunks);
+
 // Modules ////////////////////////////////////////////////////////////////////
 typedef enum {
     // Module using IGC VC backend
@@ -181,13 +367,75 @@ ISPCRTModuleType ispcrtModuleOptionsGetModuleType(ISPCRTModuleOptions);
 void ispcrtModuleOptionsSetStackSize(ISPCRTModuleOptions, uint32_t);
 void ispcrtModuleOptionsSetLibraryCompilation(ISPCRTModuleOptions, bool);
 void ispcrtModuleOptionsSetModuleType(ISPCRTModuleOptions, ISPCRTModuleType);
+// Resolve the kernels of the module when it is loaded instead of at their
+// first ispcrtNewKernel: the GPU kernel objects are created up front and the
+// symbols of the CPU shared library are bound at load.
+bool ispcrtModuleOptionsGetEagerKernels(ISPCRTModuleOptions);
+void ispcrtModuleOptionsSetEagerKernels(ISPCRTModuleOptions, bool);
+// Set the value of the specialization constant with the given ID, i.e. of
+// the "specconst" global variable whose ID ispc writes to the header as
+// <name>_specconst_id, for the modules loaded with the options. The size is
+// the size of its type: 1, 2, 4 or 8 bytes. On GPU, the SPIR-V code is
+// compiled with the values folded in, once per set of values if the module
+// cache is enabled; the CPU modules keep the default values.
+void ispcrtModuleOptionsSetSpecConstant(ISPCRTModuleOptions, uint32_t id, const void *value, size_t size);
 
 ISPCRTModule ispcrtLoadModule(ISPCRTDevice, const char *moduleFile);
 ISPCRTModule ispcrtLoadModuleWithOptions(ISPCRTDevice, const char *moduleFile, ISPCRTModuleOptions);
+// Start loading the module on a separate thread and return immediately.  NULL
+// options mean the default ones.  The module can be used as any other one: the
+// functions using it (e.g. ispcrtNewKernel) wait until the loading is
+// finished and report its error, if any.
+ISPCRTModule ispcrtLoadModuleAsync(ISPCRTDevice, const char *moduleFile, ISPCRTModuleOptions);
+// Compile the ISPC source code with the ispc command line options (without
+// input and output files) and load it in memory, without a shared library.
+// Only CPU devices are supported, the compilation is done by libispc, which
+// is loaded on the first use.
+ISPCRTModule ispcrtLoadModuleFromSource(ISPCRTDevice, const char *source, const char *const *options,
+                                        uint32_t numOptions);
+// Load the module from the image of its file in memory, e.g. embedded in the
+// application: SPIR-V or zebin on GPU, told apart by the magic number, and the
+// shared library on CPU, which is supported on Linux only. The image is copied
+// or loaded at the call. NULL options mean the default ones.
+ISPCRTModule ispcrtLoadModuleFromMemory(ISPCRTDevice, const void *data, size_t size, ISPCRTModuleOptions);
+// Return true if the module is loaded (always for modules not created with
+// ispcrtLoadModuleAsync).
+bool ispcrtModuleIsLoaded(ISPCRTModule);
+// Wait until the module is loaded.
+void ispcrtModuleWait(ISPCRTModule);
 void ispcrtDynamicLinkModules(ISPCRTDevice, ISPCRTModule *modules, uint32_t numModules);
 ISPCRTModule ispcrtStaticLinkModules(ISPCRTDevice, ISPCRTModule *modules, uint32_t numModules);
 void *ispcrtFunctionPtr(ISPCRTModule, const char *name);
+
+// The resources used by a GPU kernel, as reported in the .ze_info section of
+// the native binary of the module. The spill and private sizes are per
+// hardware thread.
+typedef struct {
+    uint32_t grfCount;
+    uint32_t spillSize;
+    uint32_t privateSize;
+    uint32_t slmSize;
+} ISPCRTKernelResources;
+// Fill the resources used by the kernel of the GPU module and return true,
+// or return false if the kernel is not found. Always false on CPU.
+bool ispcrtModuleGetKernelResources(ISPCRTModule, const char *name, ISPCRTKernelResources *resources);
+// The kernels are cached by the module: while a kernel is alive, creating
+// the kernel with the same name and width again returns a new reference to
+// it, so its state, e.g. the pinned group size, is shared.
 ISPCRTKernel ispcrtNewKernel(ISPCRTDevice, ISPCRTModule, const char *name);
+// Create the variant of the kernel compiled for the given vector width with
+// the --xe-kernel-widths option of ispc. ispcrtNewKernel selects the widest
+// variant that doesn't spill registers, or the one with the smallest spill
+// size. Zero width is the same as ispcrtNewKernel. Ignored on CPU.
+ISPCRTKernel ispcrtNewKernelWithWidth(ISPCRTDevice, ISPCRTModule, const char *name, uint32_t width);
+// Return the vector width of the selected variant of the kernel, or 0 if the
+// kernel has a single variant.
+uint32_t ispcrtKernelGetWidth(ISPCRTKernel);
+// Pin the group size used by the following launches of the kernel on GPU
+// instead of the one suggested by the driver. The launch dimensions should be
+// multiples of it. Zero in any dimension restores the suggested group size.
+// Ignored on CPU.
+void ispcrtKernelSetGroupSize(ISPCRTKernel, uint32_t x, uint32_t y, uint32_t z);
 
 // Command lists //////////////////////////////////////////////////////////////
 void ispcrtCommandListBarrier(ISPCRTCommandList);
@@ -203,6 +451,34 @@ ISPCRTFuture ispcrtCommandListLaunch2D(ISPCRTCommandList, ISPCRTKernel, ISPCRTMe
 ISPCRTFuture ispcrtCommandListLaunch3D(ISPCRTCommandList, ISPCRTKernel, ISPCRTMemoryView params, size_t dim0,
                                        size_t dim1, size_t dim2);
 
+// Replace the parameters of the launch recorded in the command list, which is
+// identified by the future returned by ispcrtCommandListLaunch*D(). The update
+// takes effect from the next submission, so a closed list can be submitted
+// repeatedly with different parameters without being reset and re-recorded.
+// On GPU the next submission waits for the previous ones and rebuilds the list.
+void ispcrtCommandListUpdateLaunch(ISPCRTCommandList, ISPCRTFuture launch, ISPCRTMemoryView params);
+
+// Hints about the use of the shared memory, see ze_memory_advice_t. The
+// preferred location is the device of the command list.
+typedef enum {
+    ISPCRT_MEM_ADVICE_SET_READ_MOSTLY = 0,
+    ISPCRT_MEM_ADVICE_CLEAR_READ_MOSTLY,
+    ISPCRT_MEM_ADVICE_SET_PREFERRED_LOCATION,
+    ISPCRT_MEM_ADVICE_CLEAR_PREFERRED_LOCATION,
+    ISPCRT_MEM_ADVICE_SET_NON_ATOMIC_MOSTLY,
+    ISPCRT_MEM_ADVICE_CLEAR_NON_ATOMIC_MOSTLY,
+} ISPCRTMemAdvice;
+
+// Migrate the first size bytes of the shared memory view to the device before
+// the following commands touch it, or the whole view if size is 0, and give
+// the driver a hint about its use, which applies from the submission of the
+// command. Both are no-ops for the views that are not shared and on CPU.
+void ispcrtCommandListPrefetch(ISPCRTCommandList, ISPCRTMemoryView, size_t size);
+void ispcrtCommandListMemAdvise(ISPCRTCommandList, ISPCRTMemoryView, ISPCRTMemAdvice advice);
+
+// A closed command list can be submitted any number of times, until it is reset.
+// The returned fence belongs to the command list. Once it is signaled, a later
+// submission may reset and reuse it, unless it is retained with ispcrtRetain().
 void ispcrtCommandListClose(ISPCRTCommandList);
 ISPCRTFence ispcrtCommandListSubmit(ISPCRTCommandList);
 void ispcrtCommandListReset(ISPCRTCommandList);
@@ -211,17 +487,56 @@ void ispcrtCommandListEnableTimestamps(ISPCRTCommandList);
 // Command queues /////////////////////////////////////////////////////////////
 ISPCRTCommandQueue ispcrtNewCommandQueue(ISPCRTDevice, uint32_t ordinal);
 
+// The command list is released with ispcrtRelease(). The queue keeps it, and
+// on GPU hands it out again, reset, once its submissions have completed. The
+// lists are destroyed with the queue. Several threads may create and submit
+// the lists of a queue at once, but a list is used by one thread at a time.
 ISPCRTCommandList ispcrtCommandQueueCreateCommandList(ISPCRTCommandQueue);
 void ispcrtCommandQueueSync(ISPCRTCommandQueue);
 
 // Task queues ////////////////////////////////////////////////////////////////
 
+typedef enum {
+    ISPCRT_TASK_QUEUE_DEFAULT = 0,
+    // GPU: append the commands to a Level Zero immediate command list, so they
+    // start executing right away instead of on ispcrtSync(). It lowers the
+    // latency of a single kernel launch at the cost of submitting every
+    // command separately; the copy engine is not used. No effect on CPU.
+    ISPCRT_TASK_QUEUE_IMMEDIATE = 1 << 0,
+    // GPU: spread the kernel launches over the engines of the compute queue
+    // group round robin. The launches between two barriers run concurrently
+    // on different engines, and the commands after a barrier wait for all the
+    // launches before it. Ignored with ISPCRT_TASK_QUEUE_IMMEDIATE and on CPU.
+    ISPCRT_TASK_QUEUE_MULTI_ENGINE = 1 << 1,
+} ISPCRTTaskQueueFlags;
+
+// A task queue may be used by several threads at once. The commands enqueued
+// by the threads are ordered as they enter the queue, a barrier orders them
+// with the commands of all the threads enqueued before it, and ispcrtSync()
+// waits for all of them. On GPU the threads enqueueing commands wait while
+// another thread syncs the queue.
 ISPCRTTaskQueue ispcrtNewTaskQueue(ISPCRTDevice);
+// flags is a combination of ISPCRTTaskQueueFlags
+ISPCRTTaskQueue ispcrtNewTaskQueueWithFlags(ISPCRTDevice, uint32_t flags);
+
+// Priority of the kernel launches enqueued into the queue after the call,
+// ISPCRT_TASK_PRIORITY_NORMAL by default. The launches of one queue run in
+// order anyway, the priority orders the tasks of the launches of different
+// queues of the CPU devices. It is honored by the shared-queue scheduler of
+// the built-in runtime and passed to the executors of the contexts, see
+// ispcrtGetCurrentTaskPriority(). Ignored on GPU.
+void ispcrtSetLaunchPriority(ISPCRTTaskQueue, ISPCRTTaskPriority);
 
 void ispcrtDeviceBarrier(ISPCRTTaskQueue);
 
 void ispcrtCopyToDevice(ISPCRTTaskQueue, ISPCRTMemoryView);
 void ispcrtCopyToHost(ISPCRTTaskQueue, ISPCRTMemoryView);
+// Copy only size bytes at offset of the view. A launch waits only for the
+// copies to the device appended before it, and a copy to the host waits only
+// for the launches before it, so the copies of the slices of a large view
+// interleaved with the launches processing them are overlapped with compute.
+void ispcrtCopyToDeviceRange(ISPCRTTaskQueue, ISPCRTMemoryView, size_t offset, size_t size);
+void ispcrtCopyToHostRange(ISPCRTTaskQueue, ISPCRTMemoryView, size_t offset, size_t size);
 void ispcrtCopyMemoryView(ISPCRTTaskQueue, ISPCRTMemoryView, ISPCRTMemoryView, const size_t size);
 
 // NOTE: 'params' can be a nullptr handle (nullptr will get passed to the ISPC task as the function parameter)
@@ -230,8 +545,105 @@ ISPCRTFuture ispcrtLaunch2D(ISPCRTTaskQueue, ISPCRTKernel, ISPCRTMemoryView para
 ISPCRTFuture ispcrtLaunch3D(ISPCRTTaskQueue, ISPCRTKernel, ISPCRTMemoryView params, size_t dim0, size_t dim1,
                             size_t dim2);
 
+// Launch the kernel with its arguments passed by value instead of a parameter
+// memory view, which saves the allocation and the copy of the parameters to
+// the device and the indirection in the kernel. On GPU, each argument is set
+// to the kernel argument of the same index by zeKernelSetArgumentValue(), so
+// the task takes them as its parameters, e.g. 'task void k(uniform float *
+// uniform a, uniform int n)'. On CPU, the arguments are copied to a block laid
+// out like a C structure with them as its fields, which is passed to the
+// entry point as its parameters. The values are copied at the call.
+typedef struct {
+    const void *value;
+    size_t size;
+} ISPCRTKernelArg;
+
+ISPCRTFuture ispcrtLaunchWithArgs1D(ISPCRTTaskQueue, ISPCRTKernel, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0);
+ISPCRTFuture ispcrtLaunchWithArgs2D(ISPCRTTaskQueue, ISPCRTKernel, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0, size_t dim1);
+ISPCRTFuture ispcrtLaunchWithArgs3D(ISPCRTTaskQueue, ISPCRTKernel, uint32_t numArgs, const ISPCRTKernelArg *args,
+                                    size_t dim0, size_t dim1, size_t dim2);
+
 void ispcrtSync(ISPCRTTaskQueue);
 
+// Multi-device launches //////////////////////////////////////////////////////
+
+// Header of the parameters of the kernel launched by ispcrtLaunchSplit3D().
+// Every part of the launch sees its own task indices starting from zero, so
+// the kernel adds offset to them; count is the size of the whole launch.
+typedef struct {
+    uint32_t offset[3];
+    uint32_t count[3];
+} ISPCRTTaskOffset;
+
+// Split the launch of dim0 x dim1 x dim2 tasks over numQueues task queues,
+// e.g. of the devices of one context or the tiles of a GPU exposed as
+// devices. The slowest varying dimension greater than one is split in
+// proportion to weights (NULL means equal parts). kernels[i] and params[i]
+// belong to the device of queues[i]. Every params[i] is a separate memory
+// view starting with ISPCRTTaskOffset, which is filled in (and copied to
+// the device, if the view is not shared) before the launch; the rest of the
+// parameters, typically pointers to shared memory views of the context, is
+// up to the caller. futures[i] receives the future of the i-th part, or NULL
+// if the part is empty. The queues are synchronized separately.
+void ispcrtLaunchSplit3D(uint32_t numQueues, const ISPCRTTaskQueue *queues, const ISPCRTKernel *kernels,
+                         const ISPCRTMemoryView *params, const float *weights, size_t dim0, size_t dim1, size_t dim2,
+                         ISPCRTFuture *futures);
+
+// Adapt the weights of ispcrtLaunchSplit3D() to the measured speed of the
+// devices, e.g. to balance a launch between the CPU and the GPU. futures are
+// the ones returned by the previous split launch with these weights, after
+// its queues were synchronized. Every part gets a new weight proportional to
+// its measured throughput (weight / time), averaged with the old weight to
+// smooth out the noise; parts without a valid time keep their share. The
+// weights are normalized to sum up to 1 and every part keeps at least 1% of
+// the launch, so a device once found slow is still measured.
+void ispcrtUpdateSplitWeights(uint32_t numParts, const ISPCRTFuture *futures, float *weights);
+
+// Pipelines //////////////////////////////////////////////////////////////////
+
+// A chain of stages (copies, kernel launches and host functions), which every
+// submitted item, e.g. a frame of a video, passes in the order they were
+// added. Up to depth items are in flight at once, each in a slot of the
+// pipeline with its own copy of every buffer and its own task queue, so the
+// copies and the kernels of the items overlap: depth 2 is double buffering,
+// 3 is triple buffering. The stages of an item run in order, and a host stage
+// sees the results of the stages before it. The host stages are called for
+// one item at a time in the order of the items, on the threads of the
+// pipeline. The stages and the buffers are added before the first item is
+// submitted. The pipeline is released with ispcrtRelease(), which waits for
+// the items in flight.
+ISPCRTPipeline ispcrtNewPipeline(ISPCRTDevice, uint32_t depth);
+
+// Add a buffer of size bytes, allocated depth times, once for every slot, and
+// return its index. The memory views belong to the pipeline. The device
+// buffers get their host memory from the pipeline as well, the copy stages
+// move the data between the two, while the shared buffers need no copies.
+uint32_t ispcrtPipelineAddBuffer(ISPCRTPipeline, size_t size, ISPCRTNewMemoryViewFlags *flags);
+ISPCRTMemoryView ispcrtPipelineGetBuffer(ISPCRTPipeline, uint32_t buffer, uint32_t slot);
+
+// Launch the kernel with params[slot] as its parameters, typically pointing
+// to the buffers of the slot. params has depth entries, or is NULL.
+void ispcrtPipelineAddKernelStage(ISPCRTPipeline, ISPCRTKernel, const ISPCRTMemoryView *params, size_t dim0,
+                                  size_t dim1, size_t dim2);
+void ispcrtPipelineAddCopyToDeviceStage(ISPCRTPipeline, uint32_t buffer);
+void ispcrtPipelineAddCopyToHostStage(ISPCRTPipeline, uint32_t buffer);
+
+// The function of a host stage gets the index of the item, counted from 0,
+// and the slot of its buffers, e.g. to fill in the input of the item with
+// ispcrtHostPtr() of the buffer of the slot or to consume the output.
+typedef void (*ISPCRTPipelineStageFType)(uint64_t item, uint32_t slot, void *userData);
+void ispcrtPipelineAddHostStage(ISPCRTPipeline, ISPCRTPipelineStageFType fcn, void *userData);
+
+// Push the next item into the pipeline, waiting for a free slot if depth
+// items are in flight, and return its index. The first error of the stages
+// of the items is reported by the next submission or synchronization, and
+// the later stages of the failed item are skipped.
+uint64_t ispcrtPipelineSubmit(ISPCRTPipeline);
+// Wait until all the submitted items have passed the pipeline.
+void ispcrtPipelineSync(ISPCRTPipeline);
+
 // Fence //////////////////////////////////////////////////////////////////////
 typedef enum {
     ISPCRT_FENCE_UNSIGNALED = 0,
@@ -242,11 +654,35 @@ void ispcrtFenceSync(ISPCRTFence);
 ISPCRTFenceStatus ispcrtFenceStatus(ISPCRTFence);
 void ispcrtFenceReset(ISPCRTFence);
 
+// Wait until any of the fences is signaled and return its index, or -1 if none
+// is signaled after timeoutNs nanoseconds. UINT64_MAX waits without a timeout.
+int32_t ispcrtFenceWaitAny(const ISPCRTFence *fences, uint32_t numFences, uint64_t timeoutNs);
+// Wait until all the fences are signaled. Return false on timeout.
+bool ispcrtFenceWaitAll(const ISPCRTFence *fences, uint32_t numFences, uint64_t timeoutNs);
+
+// Call callback(fence, userData) once the fence is signaled. The callbacks run
+// one by one on a thread of the runtime, so they should hand longer work over
+// to the application. The fence is retained until its callback has returned.
+typedef void (*ISPCRTFenceCallback)(ISPCRTFence, void *userData);
+void ispcrtFenceSetCallback(ISPCRTFence, ISPCRTFenceCallback callback, void *userData);
+
 // Futures and task timing ////////////////////////////////////////////////////
 
 uint64_t ispcrtFutureGetTimeNs(ISPCRTFuture);
 bool ispcrtFutureIsValid(ISPCRTFuture);
 
+// Tracing ////////////////////////////////////////////////////////////////////
+
+// Record module loading, kernel creation, copies, launches, submissions and
+// synchronizations in the ring buffer of the calling thread, keeping the
+// latest eventsPerThread of them. 0 stops the tracing. The recorded events
+// are dropped. It must not be called while other threads use the runtime.
+void ispcrtTraceEnable(uint32_t eventsPerThread);
+// Write the recorded events in the Chrome trace event format, which can be
+// opened in chrome://tracing or Perfetto UI. It must not be called while other
+// threads use the runtime. Return false if the file can't be written.
+bool ispcrtTraceWrite(const char *fileName);
+
 // Access to objects of native runtime ///////////////////////////////////////
 
 ISPCRTGenericHandle ispcrtPlatformNativeHandle(ISPCRTDevice);
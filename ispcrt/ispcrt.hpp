@@ -115,6 +115,16 @@ class Fence : public GenericObject<ISPCRTFence> {
     ISPCRTFenceStatus status() const;
     void reset();
     void *nativeFenceHandle() const;
+
+    // See ispcrtFenceSetCallback()
+    void setCallback(ISPCRTFenceCallback callback, void *userData) const;
+
+    // See ispcrtFenceWaitAny() and ispcrtFenceWaitAll()
+    static int32_t waitAny(const std::vector<Fence> &fences, uint64_t timeoutNs = UINT64_MAX);
+    static bool waitAll(const std::vector<Fence> &fences, uint64_t timeoutNs = UINT64_MAX);
+
+  private:
+    static std::vector<ISPCRTFence> handles(const std::vector<Fence> &fences);
 };
 
 inline Fence::Fence(ISPCRTFence f) : GenericObject<ISPCRTFence>(f) {
@@ -130,6 +140,27 @@ inline void Fence::reset() { ispcrtFenceReset(handle()); }
 
 inline void *Fence::nativeFenceHandle() const { return ispcrtFenceNativeHandle(handle()); }
 
+inline void Fence::setCallback(ISPCRTFenceCallback callback, void *userData) const {
+    ispcrtFenceSetCallback(handle(), callback, userData);
+}
+
+inline int32_t Fence::waitAny(const std::vector<Fence> &fences, uint64_t timeoutNs) {
+    const auto h = handles(fences);
+    return ispcrtFenceWaitAny(h.data(), (uint32_t)h.size(), timeoutNs);
+}
+
+inline bool Fence::waitAll(const std::vector<Fence> &fences, uint64_t timeoutNs) {
+    const auto h = handles(fences);
+    return ispcrtFenceWaitAll(h.data(), (uint32_t)h.size(), timeoutNs);
+}
+
+inline std::vector<ISPCRTFence> Fence::handles(const std::vector<Fence> &fences) {
+    std::vector<ISPCRTFence> h;
+    for (const auto &f : fences)
+        h.push_back(f.handle());
+    return h;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Context wrapper ///////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -141,6 +172,14 @@ class Context : public GenericObject<ISPCRTContext> {
     Context(ISPCRTDeviceType type, ISPCRTGenericHandle nativeContextHandle);
     ~Context() = default;
     void *nativeContextHandle() const;
+    // memory pools of the shared memory
+    ISPCRTMemPoolStats memPoolStats(ISPCRTSharedMemoryAllocationHint type) const;
+    std::vector<ISPCRTMemPoolChunkStats> memPoolChunkStats(ISPCRTSharedMemoryAllocationHint type) const;
+    size_t trimMemPool(ISPCRTSharedMemoryAllocationHint type) const;
+    void setMemPoolLimit(ISPCRTSharedMemoryAllocationHint type, size_t maxBytesReserved) const;
+    // executor of the tasks of the CPU devices obtained from the context
+    void setTaskingCallbacks(const ISPCRTTaskingCallbacks &callbacks) const;
+    void resetTaskingCallbacks() const;
 };
 
 // Inlined definitions //
@@ -150,6 +189,36 @@ inline Context::Context(ISPCRTDeviceType type, ISPCRTGenericHandle nativeContext
     : GenericObject<ISPCRTContext>(ispcrtGetContextFromNativeHandle(type, nativeContextHandle)) {}
 
 inline void *Context::nativeContextHandle() const { return ispcrtContextNativeHandle(handle()); }
+
+inline ISPCRTMemPoolStats Context::memPoolStats(ISPCRTSharedMemoryAllocationHint type) const {
+    ISPCRTMemPoolStats stats = {};
+    ispcrtContextGetMemPoolStats(handle(), type, &stats, nullptr, nullptr);
+    return stats;
+}
+
+inline std::vector<ISPCRTMemPoolChunkStats> Context::memPoolChunkStats(ISPCRTSharedMemoryAllocationHint type) const {
+    uint32_t numChunks = 0;
+    ispcrtContextGetMemPoolStats(handle(), type, nullptr, nullptr, &numChunks);
+    std::vector<ISPCRTMemPoolChunkStats> chunks(numChunks);
+    ispcrtContextGetMemPoolStats(handle(), type, nullptr, chunks.data(), &numChunks);
+    chunks.resize(numChunks);
+    return chunks;
+}
+
+inline size_t Context::trimMemPool(ISPCRTSharedMemoryAllocationHint type) const {
+    return ispcrtContextTrimMemPool(handle(), type);
+}
+
+inline void Context::setMemPoolLimit(ISPCRTSharedMemoryAllocationHint type, size_t maxBytesReserved) const {
+    ispcrtContextSetMemPoolLimit(handle(), type, maxBytesReserved);
+}
+
+inline void Context::setTaskingCallbacks(const ISPCRTTaskingCallbacks &callbacks) const {
+    ispcrtContextSetTaskingCallbacks(handle(), &callbacks);
+}
+
+inline void Context::resetTaskingCallbacks() const { ispcrtContextSetTaskingCallbacks(handle(), nullptr); }
+
 /////////////////////////////////////////////////////////////////////////////
 // Device wrapper ///////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -167,6 +236,8 @@ class Device : public GenericObject<ISPCRTDevice> {
     Device(ISPCRTDeviceType type, uint32_t deviceIdx);
     Device(const Context &context, uint32_t deviceIdx);
     Device(const Context &context, ISPCRTGenericHandle nativeDeviceHandle);
+    // CPU sub-device with its own worker threads
+    explicit Device(const ISPCRTCpuDeviceOptions &options);
     void *nativePlatformHandle() const;
     void *nativeDeviceHandle() const;
     void *nativeContextHandle() const;
@@ -180,6 +251,10 @@ class Device : public GenericObject<ISPCRTDevice> {
     Module staticLinkModules(ISPCRTModule *modules, const uint32_t num);
     // check memory type
     ISPCRTAllocationType getMemoryAllocType(void *memBuffer);
+    // CPU thread and memory placement
+    static void setCpuDeviceOptions(const ISPCRTCpuDeviceOptions &options);
+    static ISPCRTCpuTopology cpuTopology();
+    void firstTouch(ISPCRTMemoryView view, uint32_t numChunks) const;
 };
 
 // Inlined definitions //
@@ -194,6 +269,9 @@ inline Device::Device(const Context &context) : Device(context, uint32_t(0)) {}
 inline Device::Device(const Context &context, ISPCRTGenericHandle nativeDeviceHandle)
     : GenericObject<ISPCRTDevice>(ispcrtGetDeviceFromNativeHandle(context.handle(), nativeDeviceHandle)) {}
 
+inline Device::Device(const ISPCRTCpuDeviceOptions &options)
+    : GenericObject<ISPCRTDevice>(ispcrtNewCpuSubDevice(&options)) {}
+
 inline void *Device::nativePlatformHandle() const { return ispcrtPlatformNativeHandle(handle()); }
 inline void *Device::nativeDeviceHandle() const { return ispcrtDeviceNativeHandle(handle()); }
 inline void *Device::nativeContextHandle() const { return ispcrtDeviceContextNativeHandle(handle()); }
@@ -225,6 +303,18 @@ inline ISPCRTAllocationType Device::getMemoryAllocType(void *memBuffer) {
     return ispcrtGetMemoryAllocType(handle(), memBuffer);
 }
 
+inline void Device::setCpuDeviceOptions(const ISPCRTCpuDeviceOptions &options) { ispcrtSetCpuDeviceOptions(&options); }
+
+inline ISPCRTCpuTopology Device::cpuTopology() {
+    ISPCRTCpuTopology topology;
+    ispcrtGetCpuTopology(&topology);
+    return topology;
+}
+
+inline void Device::firstTouch(ISPCRTMemoryView view, uint32_t numChunks) const {
+    ispcrtFirstTouch(handle(), view, numChunks);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Arrays (MemoryView wrapper w/ element type) //////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -249,7 +339,7 @@ template <typename T, AllocType AT = AllocType::Device> class Array : public Gen
 
     //////// Constructors that can be used for Device memory allocations ////////
 
-    // Construct from raw array //
+    // Construct from raw array (zero-copy on CPU, see ispcrtNewZeroCopyMemoryView()) //
     template <AllocType alloc = AT>
     Array(const Device &device, T *appMemory, size_t size, EnableForDeviceAllocation<alloc> = 0);
 
@@ -302,7 +392,13 @@ template <typename T, AllocType AT = AllocType::Device> class Array : public Gen
     size_t size() const;
     AllocType type() const;
 
+    // The view of count elements starting at first, which shares the memory
+    // of this array (see ispcrtNewMemoryViewSlice()) //
+    Array<T, AT> slice(size_t first, size_t count) const;
+
   private:
+    Array(ISPCRTMemoryView view, SharedMemoryUsageHint smuh) : GenericObject<ISPCRTMemoryView>(view), m_smuh(smuh) {}
+
     SharedMemoryUsageHint m_smuh{SharedMemoryUsageHint::HostDeviceReadWrite};
 };
 
@@ -313,7 +409,7 @@ template <typename T, AllocType AT>
 template <AllocType alloc>
 inline Array<T, AT>::Array(const Device &device, T *appMemory, size_t size, EnableForDeviceAllocation<alloc>)
     : GenericObject<ISPCRTMemoryView>() {
-    ISPCRTNewMemoryViewFlags flags;
+    ISPCRTNewMemoryViewFlags flags = {};
     flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
     flags.smHint = ISPCRT_SM_HOST_DEVICE_READ_WRITE;
     m_handle = ispcrtNewMemoryView(device.handle(), appMemory, size * sizeof(T), &flags);
@@ -370,7 +466,7 @@ template <AllocType alloc>
 inline Array<T, AT>::Array(const Device &device, size_t size, SharedMemoryUsageHint smuh,
                            EnableForSharedAllocation<alloc>)
     : m_smuh(smuh), GenericObject<ISPCRTMemoryView>() {
-    ISPCRTNewMemoryViewFlags flags;
+    ISPCRTNewMemoryViewFlags flags = {};
     set_shared_memory_view_flags(&flags, smuh);
     m_handle = ispcrtNewMemoryView(device.handle(), nullptr, size * sizeof(T), &flags);
 }
@@ -380,7 +476,7 @@ template <AllocType alloc>
 inline Array<T, AT>::Array(const Context &context, size_t size, SharedMemoryUsageHint smuh,
                            EnableForSharedAllocation<alloc>)
     : m_smuh(smuh), GenericObject<ISPCRTMemoryView>() {
-    ISPCRTNewMemoryViewFlags flags;
+    ISPCRTNewMemoryViewFlags flags = {};
     set_shared_memory_view_flags(&flags, smuh);
     m_handle = ispcrtNewMemoryViewForContext(context.handle(), nullptr, size * sizeof(T), &flags);
 }
@@ -421,6 +517,10 @@ template <typename T, AllocType AT> inline size_t Array<T, AT>::size() const {
 
 template <typename T, AllocType AT> inline AllocType Array<T, AT>::type() const { return AT; }
 
+template <typename T, AllocType AT> inline Array<T, AT> Array<T, AT>::slice(size_t first, size_t count) const {
+    return Array<T, AT>(ispcrtNewMemoryViewSlice(handle(), first * sizeof(T), count * sizeof(T)), m_smuh);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Shared Memory Allocator //////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -485,9 +585,14 @@ class ModuleOptions : public GenericObject<ISPCRTModuleOptions> {
     uint32_t stackSize();
     bool libraryCompilation();
     ISPCRTModuleType moduleType();
+    bool eagerKernels();
     void setStackSize(uint32_t);
     void setLibraryCompilation(bool);
     void setModuleType(ISPCRTModuleType);
+    void setEagerKernels(bool);
+    // The ID of the "specconst" variable is <name>_specconst_id of the
+    // header of the module, T is its type.
+    template <typename T> void setSpecConstant(uint32_t id, const T &value);
 };
 
 // Inlined definitions //
@@ -508,6 +613,8 @@ inline bool ModuleOptions::libraryCompilation() { return ispcrtModuleOptionsGetL
 
 inline ISPCRTModuleType ModuleOptions::moduleType() { return ispcrtModuleOptionsGetModuleType(handle()); }
 
+inline bool ModuleOptions::eagerKernels() { return ispcrtModuleOptionsGetEagerKernels(handle()); }
+
 inline void ModuleOptions::setStackSize(uint32_t size) { return ispcrtModuleOptionsSetStackSize(handle(), size); }
 
 inline void ModuleOptions::setLibraryCompilation(bool isLibraryCompilation) {
@@ -518,6 +625,12 @@ inline void ModuleOptions::setModuleType(ISPCRTModuleType type) {
     return ispcrtModuleOptionsSetModuleType(handle(), type);
 }
 
+inline void ModuleOptions::setEagerKernels(bool eager) { return ispcrtModuleOptionsSetEagerKernels(handle(), eager); }
+
+template <typename T> inline void ModuleOptions::setSpecConstant(uint32_t id, const T &value) {
+    return ispcrtModuleOptionsSetSpecConstant(handle(), id, &value, sizeof(T));
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Module wrapper ///////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -529,6 +642,18 @@ class Module : public GenericObject<ISPCRTModule> {
     Module(const Device &device, const char *moduleName, const ModuleOptions &opts);
     Module(ISPCRTModule module);
     void *functionPtr(const char *functionName);
+    // See ispcrtModuleGetKernelResources()
+    bool kernelResources(const char *kernelName, ISPCRTKernelResources &resources) const;
+    // Start loading the module on a separate thread, see ispcrtLoadModuleAsync()
+    static Module loadAsync(const Device &device, const char *moduleName);
+    static Module loadAsync(const Device &device, const char *moduleName, const ModuleOptions &opts);
+    // Compile the source code and load it in memory, see ispcrtLoadModuleFromSource()
+    static Module fromSource(const Device &device, const char *source, const std::vector<const char *> &options = {});
+    // Load the module from the image of its file in memory, see ispcrtLoadModuleFromMemory()
+    static Module fromMemory(const Device &device, const void *data, size_t size);
+    static Module fromMemory(const Device &device, const void *data, size_t size, const ModuleOptions &opts);
+    bool isLoaded() const;
+    void wait() const;
 };
 
 // Inlined definitions //
@@ -543,6 +668,34 @@ inline Module::Module(ISPCRTModule module) : GenericObject<ISPCRTModule>(module)
 
 inline void *Module::functionPtr(const char *functionName) { return ispcrtFunctionPtr(handle(), functionName); }
 
+inline bool Module::kernelResources(const char *kernelName, ISPCRTKernelResources &resources) const {
+    return ispcrtModuleGetKernelResources(handle(), kernelName, &resources);
+}
+
+inline Module Module::loadAsync(const Device &device, const char *moduleName) {
+    return Module(ispcrtLoadModuleAsync(device.handle(), moduleName, nullptr));
+}
+
+inline Module Module::loadAsync(const Device &device, const char *moduleName, const ModuleOptions &opts) {
+    return Module(ispcrtLoadModuleAsync(device.handle(), moduleName, opts.handle()));
+}
+
+inline Module Module::fromSource(const Device &device, const char *source, const std::vector<const char *> &options) {
+    return Module(ispcrtLoadModuleFromSource(device.handle(), source, options.data(), (uint32_t)options.size()));
+}
+
+inline Module Module::fromMemory(const Device &device, const void *data, size_t size) {
+    return Module(ispcrtLoadModuleFromMemory(device.handle(), data, size, nullptr));
+}
+
+inline Module Module::fromMemory(const Device &device, const void *data, size_t size, const ModuleOptions &opts) {
+    return Module(ispcrtLoadModuleFromMemory(device.handle(), data, size, opts.handle()));
+}
+
+inline bool Module::isLoaded() const { return ispcrtModuleIsLoaded(handle()); }
+
+inline void Module::wait() const { ispcrtModuleWait(handle()); }
+
 inline Module Device::staticLinkModules(ISPCRTModule *modules, const uint32_t num) {
     return Module(ispcrtStaticLinkModules(handle(), (ISPCRTModule *)modules, num));
 }
@@ -555,6 +708,11 @@ class Kernel : public GenericObject<ISPCRTKernel> {
   public:
     Kernel() = default;
     Kernel(const Device &device, const Module &module, const char *kernelName);
+    // Create the variant for the given vector width, see ispcrtNewKernelWithWidth()
+    Kernel(const Device &device, const Module &module, const char *kernelName, uint32_t width);
+    // Pin the group size used on GPU, see ispcrtKernelSetGroupSize()
+    void setGroupSize(uint32_t x, uint32_t y = 1, uint32_t z = 1);
+    uint32_t width() const;
 };
 
 // Inlined definitions //
@@ -562,6 +720,13 @@ class Kernel : public GenericObject<ISPCRTKernel> {
 inline Kernel::Kernel(const Device &device, const Module &module, const char *kernelName)
     : GenericObject<ISPCRTKernel>(ispcrtNewKernel(device.handle(), module.handle(), kernelName)) {}
 
+inline Kernel::Kernel(const Device &device, const Module &module, const char *kernelName, uint32_t width)
+    : GenericObject<ISPCRTKernel>(ispcrtNewKernelWithWidth(device.handle(), module.handle(), kernelName, width)) {}
+
+inline void Kernel::setGroupSize(uint32_t x, uint32_t y, uint32_t z) { ispcrtKernelSetGroupSize(handle(), x, y, z); }
+
+inline uint32_t Kernel::width() const { return ispcrtKernelGetWidth(handle()); }
+
 /////////////////////////////////////////////////////////////////////////////
 // CommandList wrapper //////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -588,6 +753,13 @@ class CommandList : public GenericObject<ISPCRTCommandList> {
     template <typename T, AllocType AT>
     Future launch(const Kernel &k, const Array<T, AT> &p, size_t dim0, size_t dim1, size_t dim2) const;
 
+    // Replace the parameters of the recorded launch, see ispcrtCommandListUpdateLaunch()
+    template <typename T, AllocType AT> void updateLaunch(const Future &launch, const Array<T, AT> &p) const;
+
+    // Shared memory hints, see ispcrtCommandListPrefetch() and ispcrtCommandListMemAdvise()
+    template <typename T, AllocType AT> void prefetch(const Array<T, AT> &arr, size_t bytes = 0) const;
+    template <typename T, AllocType AT> void memAdvise(const Array<T, AT> &arr, ISPCRTMemAdvice advice) const;
+
     void close();
     Fence submit();
     void reset();
@@ -643,6 +815,20 @@ inline Future CommandList::launch(const Kernel &k, const Array<T, AT> &p, size_t
     return ispcrtCommandListLaunch3D(handle(), k.handle(), p.handle(), dim0, dim1, dim2);
 }
 
+template <typename T, AllocType AT>
+inline void CommandList::updateLaunch(const Future &launch, const Array<T, AT> &p) const {
+    ispcrtCommandListUpdateLaunch(handle(), launch.handle(), p.handle());
+}
+
+template <typename T, AllocType AT> inline void CommandList::prefetch(const Array<T, AT> &arr, size_t bytes) const {
+    ispcrtCommandListPrefetch(handle(), arr.handle(), bytes);
+}
+
+template <typename T, AllocType AT>
+inline void CommandList::memAdvise(const Array<T, AT> &arr, ISPCRTMemAdvice advice) const {
+    ispcrtCommandListMemAdvise(handle(), arr.handle(), advice);
+}
+
 inline void CommandList::close() { ispcrtCommandListClose(handle()); }
 
 inline Fence CommandList::submit() { return ispcrtCommandListSubmit(handle()); }
@@ -671,7 +857,12 @@ class CommandQueue : public GenericObject<ISPCRTCommandQueue> {
 inline CommandQueue::CommandQueue(const Device &device, uint32_t ordinal)
     : GenericObject<ISPCRTCommandQueue>(ispcrtNewCommandQueue(device.handle(), ordinal)) {}
 
-inline CommandList CommandQueue::createCommandList() { return ispcrtCommandQueueCreateCommandList(handle()); }
+inline CommandList CommandQueue::createCommandList() {
+    CommandList l = ispcrtCommandQueueCreateCommandList(handle());
+    // The wrapper retained the list, drop the reference returned by the call
+    ispcrtRelease(l.handle());
+    return l;
+}
 
 inline void CommandQueue::sync() { ispcrtCommandQueueSync(handle()); }
 
@@ -685,11 +876,19 @@ class TaskQueue : public GenericObject<ISPCRTTaskQueue> {
   public:
     TaskQueue() = default;
     TaskQueue(const Device &device);
+    // flags is a combination of ISPCRTTaskQueueFlags
+    TaskQueue(const Device &device, uint32_t flags);
 
     void barrier() const;
 
+    // priority of the following launches, see ispcrtSetLaunchPriority()
+    void setLaunchPriority(ISPCRTTaskPriority priority) const;
+
     template <typename T, AllocType AT> void copyToDevice(const Array<T, AT> &arr) const;
     template <typename T, AllocType AT> void copyToHost(const Array<T, AT> &arr) const;
+    // copy count elements starting with the element first
+    template <typename T, AllocType AT> void copyToDevice(const Array<T, AT> &arr, size_t first, size_t count) const;
+    template <typename T, AllocType AT> void copyToHost(const Array<T, AT> &arr, size_t first, size_t count) const;
     template <typename T, AllocType AT>
     void copyArray(const Array<T, AT> &arrDst, const Array<T, AT> &arrSrc, const size_t size) const;
 
@@ -703,6 +902,10 @@ class TaskQueue : public GenericObject<ISPCRTTaskQueue> {
     template <typename T, AllocType AT>
     Future launch(const Kernel &k, const Array<T, AT> &p, size_t dim0, size_t dim1, size_t dim2) const;
 
+    // Launch the kernel with the arguments passed by value, see ispcrtLaunchWithArgs3D()
+    template <typename... Args>
+    Future launchWithArgs(const Kernel &k, size_t dim0, size_t dim1, size_t dim2, const Args &...args) const;
+
     // wait for the command list to be executed (start the execution if needed as well)
     void sync() const;
 
@@ -714,8 +917,15 @@ class TaskQueue : public GenericObject<ISPCRTTaskQueue> {
 inline TaskQueue::TaskQueue(const Device &device)
     : GenericObject<ISPCRTTaskQueue>(ispcrtNewTaskQueue(device.handle())) {}
 
+inline TaskQueue::TaskQueue(const Device &device, uint32_t flags)
+    : GenericObject<ISPCRTTaskQueue>(ispcrtNewTaskQueueWithFlags(device.handle(), flags)) {}
+
 inline void TaskQueue::barrier() const { ispcrtDeviceBarrier(handle()); }
 
+inline void TaskQueue::setLaunchPriority(ISPCRTTaskPriority priority) const {
+    ispcrtSetLaunchPriority(handle(), priority);
+}
+
 template <typename T, AllocType AT> inline void TaskQueue::copyToDevice(const Array<T, AT> &arr) const {
     ispcrtCopyToDevice(handle(), arr.handle());
 }
@@ -724,6 +934,16 @@ template <typename T, AllocType AT> inline void TaskQueue::copyToHost(const Arra
     ispcrtCopyToHost(handle(), arr.handle());
 }
 
+template <typename T, AllocType AT>
+inline void TaskQueue::copyToDevice(const Array<T, AT> &arr, size_t first, size_t count) const {
+    ispcrtCopyToDeviceRange(handle(), arr.handle(), first * sizeof(T), count * sizeof(T));
+}
+
+template <typename T, AllocType AT>
+inline void TaskQueue::copyToHost(const Array<T, AT> &arr, size_t first, size_t count) const {
+    ispcrtCopyToHostRange(handle(), arr.handle(), first * sizeof(T), count * sizeof(T));
+}
+
 template <typename T, AllocType AT>
 inline void TaskQueue::copyArray(const Array<T, AT> &arrDst, const Array<T, AT> &arrSrc, const size_t size) const {
     ispcrtCopyMemoryView(handle(), arrDst.handle(), arrSrc.handle(), size * sizeof(T));
@@ -756,8 +976,182 @@ inline Future TaskQueue::launch(const Kernel &k, const Array<T, AT> &p, size_t d
     return ispcrtLaunch3D(handle(), k.handle(), p.handle(), dim0, dim1, dim2);
 }
 
+template <typename... Args>
+inline Future TaskQueue::launchWithArgs(const Kernel &k, size_t dim0, size_t dim1, size_t dim2,
+                                        const Args &...args) const {
+    const ISPCRTKernelArg kernelArgs[] = {{&args, sizeof(Args)}..., {nullptr, 0}};
+    return ispcrtLaunchWithArgs3D(handle(), k.handle(), sizeof...(Args), kernelArgs, dim0, dim1, dim2);
+}
+
 inline void TaskQueue::sync() const { ispcrtSync(handle()); }
 
 inline void *TaskQueue::nativeTaskQueueHandle() const { return ispcrtTaskQueueNativeHandle(handle()); }
 
+/////////////////////////////////////////////////////////////////////////////
+// Typed kernel wrapper /////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+// Kernel launched with its arguments passed by value, which are converted to
+// the parameter types of the signature at compile time. The header generated
+// by ispc for Xe targets declares the signature of every kernel in the
+// ispc::kernel namespace, e.g. TypedKernel<ispc::kernel::add>.
+template <typename Signature> class TypedKernel;
+
+template <typename... Params> class TypedKernel<void(Params...)> : public Kernel {
+  public:
+    TypedKernel() = default;
+    TypedKernel(const Device &device, const Module &module, const char *kernelName)
+        : Kernel(device, module, kernelName) {}
+
+    // See TaskQueue::launchWithArgs()
+    Future launch(const TaskQueue &queue, const std::array<size_t, 3> &dims, Params... args) const {
+        return queue.launchWithArgs(*this, dims[0], dims[1], dims[2], args...);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Multi-device launches ////////////////////////////////////////////////////
+
+// Split the launch over the task queues, see ispcrtLaunchSplit3D()
+template <typename T, AllocType AT>
+std::vector<Future> launchSplit(const std::vector<TaskQueue> &queues, const std::vector<Kernel> &kernels,
+                                const std::vector<Array<T, AT>> &params, size_t dim0, size_t dim1, size_t dim2,
+                                const std::vector<float> &weights = {}) {
+    assert(kernels.size() == queues.size() && params.size() == queues.size());
+    assert(weights.empty() || weights.size() == queues.size());
+    std::vector<ISPCRTTaskQueue> hQueues;
+    std::vector<ISPCRTKernel> hKernels;
+    std::vector<ISPCRTMemoryView> hParams;
+    for (size_t i = 0; i < queues.size(); i++) {
+        hQueues.push_back(queues[i].handle());
+        hKernels.push_back(kernels[i].handle());
+        hParams.push_back(params[i].handle());
+    }
+    std::vector<ISPCRTFuture> hFutures(queues.size(), nullptr);
+    ispcrtLaunchSplit3D((uint32_t)queues.size(), hQueues.data(), hKernels.data(), hParams.data(),
+                        weights.empty() ? nullptr : weights.data(), dim0, dim1, dim2, hFutures.data());
+    return std::vector<Future>(hFutures.begin(), hFutures.end());
+}
+
+// Launches split over the task queues, e.g. of the CPU and the GPU, which
+// adapts the split to the speed of the devices measured by every sync(), see
+// ispcrtUpdateSplitWeights().
+template <typename T, AllocType AT> class SplitLauncher {
+  public:
+    SplitLauncher(const std::vector<TaskQueue> &queues, const std::vector<Kernel> &kernels,
+                  const std::vector<Array<T, AT>> &params)
+        : m_queues(queues), m_kernels(kernels), m_params(params), m_weights(queues.size(), 1.f) {}
+
+    void launch(size_t dim0, size_t dim1 = 1, size_t dim2 = 1) {
+        m_futures = launchSplit(m_queues, m_kernels, m_params, dim0, dim1, dim2, m_weights);
+    }
+
+    // Wait for the launch on all queues and update the weights
+    void sync() {
+        for (const auto &q : m_queues) {
+            q.sync();
+        }
+        if (m_futures.empty())
+            return;
+        std::vector<ISPCRTFuture> hFutures;
+        for (const auto &f : m_futures) {
+            hFutures.push_back(f.handle());
+        }
+        ispcrtUpdateSplitWeights((uint32_t)hFutures.size(), hFutures.data(), m_weights.data());
+        m_futures.clear();
+    }
+
+    const std::vector<Future> &futures() const { return m_futures; }
+    const std::vector<float> &weights() const { return m_weights; }
+    void setWeights(const std::vector<float> &weights) { m_weights = weights; }
+
+  private:
+    std::vector<TaskQueue> m_queues;
+    std::vector<Kernel> m_kernels;
+    std::vector<Array<T, AT>> m_params;
+    std::vector<float> m_weights;
+    std::vector<Future> m_futures;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// Pipeline wrapper /////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+// See ispcrtNewPipeline()
+class Pipeline : public GenericObject<ISPCRTPipeline> {
+  public:
+    Pipeline() = default;
+    Pipeline(const Device &device, uint32_t depth);
+
+    // Returns the index of the buffer
+    uint32_t addBuffer(size_t size, AllocType allocType = AllocType::Device) const;
+    // The memory view of the buffer for the slot, which belongs to the pipeline
+    ISPCRTMemoryView buffer(uint32_t buffer, uint32_t slot) const;
+    template <typename T> T *hostPtr(uint32_t buffer, uint32_t slot) const;
+    template <typename T> T *devicePtr(uint32_t buffer, uint32_t slot) const;
+
+    void addKernelStage(const Kernel &k, size_t dim0, size_t dim1 = 1, size_t dim2 = 1) const;
+    // params has an entry for every slot
+    template <typename T, AllocType AT>
+    void addKernelStage(const Kernel &k, const std::vector<Array<T, AT>> &params, size_t dim0, size_t dim1 = 1,
+                        size_t dim2 = 1) const;
+    void addCopyToDeviceStage(uint32_t buffer) const;
+    void addCopyToHostStage(uint32_t buffer) const;
+    void addHostStage(ISPCRTPipelineStageFType fcn, void *userData) const;
+
+    uint64_t submit() const;
+    void sync() const;
+};
+
+// Inlined definitions //
+
+inline Pipeline::Pipeline(const Device &device, uint32_t depth)
+    : GenericObject<ISPCRTPipeline>(ispcrtNewPipeline(device.handle(), depth)) {}
+
+inline uint32_t Pipeline::addBuffer(size_t size, AllocType allocType) const {
+    ISPCRTNewMemoryViewFlags flags = {};
+    flags.allocType = allocType == AllocType::Shared ? ISPCRT_ALLOC_TYPE_SHARED : ISPCRT_ALLOC_TYPE_DEVICE;
+    return ispcrtPipelineAddBuffer(handle(), size, &flags);
+}
+
+inline ISPCRTMemoryView Pipeline::buffer(uint32_t buffer, uint32_t slot) const {
+    return ispcrtPipelineGetBuffer(handle(), buffer, slot);
+}
+
+template <typename T> inline T *Pipeline::hostPtr(uint32_t buffer, uint32_t slot) const {
+    return (T *)ispcrtHostPtr(this->buffer(buffer, slot));
+}
+
+template <typename T> inline T *Pipeline::devicePtr(uint32_t buffer, uint32_t slot) const {
+    return (T *)ispcrtDevicePtr(this->buffer(buffer, slot));
+}
+
+inline void Pipeline::addKernelStage(const Kernel &k, size_t dim0, size_t dim1, size_t dim2) const {
+    ispcrtPipelineAddKernelStage(handle(), k.handle(), nullptr, dim0, dim1, dim2);
+}
+
+template <typename T, AllocType AT>
+inline void Pipeline::addKernelStage(const Kernel &k, const std::vector<Array<T, AT>> &params, size_t dim0,
+                                     size_t dim1, size_t dim2) const {
+    std::vector<ISPCRTMemoryView> hParams;
+    for (const auto &p : params) {
+        hParams.push_back(p.handle());
+    }
+    ispcrtPipelineAddKernelStage(handle(), k.handle(), hParams.data(), dim0, dim1, dim2);
+}
+
+inline void Pipeline::addCopyToDeviceStage(uint32_t buffer) const {
+    ispcrtPipelineAddCopyToDeviceStage(handle(), buffer);
+}
+
+inline void Pipeline::addCopyToHostStage(uint32_t buffer) const { ispcrtPipelineAddCopyToHostStage(handle(), buffer); }
+
+inline void Pipeline::addHostStage(ISPCRTPipelineStageFType fcn, void *userData) const {
+    ispcrtPipelineAddHostStage(handle(), fcn, userData);
+}
+
+inline uint64_t Pipeline::submit() const { return ispcrtPipelineSubmit(handle()); }
+
+inline void Pipeline::sync() const { ispcrtPipelineSync(handle()); }
+
 } // namespace ispcrt
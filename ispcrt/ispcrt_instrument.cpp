@@ -0,0 +1,429 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "ispcrt_instrument.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <sys/time.h>
+#define ISPCRT_LANE_PROFILE_SIGPROF
+#endif
+// std
+#include <atomic>
+#include <bitset>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Counters {
+    uint64_t calls{0};
+    uint64_t lanes{0};
+    uint64_t allOff{0};
+    // All lanes seen active at the site
+    uint64_t mask{0};
+};
+
+// The counters of the sites called by a thread, an array per module, indexed
+// by the site IDs.
+struct ThreadSites {
+    Counters *find(const ISPCInstrumentSites *sites) {
+        if (sites == lastSites)
+            return lastCounters;
+        for (auto &m : modules) {
+            if (m.first == sites) {
+                lastSites = sites;
+                lastCounters = m.second.data();
+                return lastCounters;
+            }
+        }
+        modules.emplace_back(sites, std::vector<Counters>(sites->numSites));
+        lastSites = sites;
+        lastCounters = modules.back().second.data();
+        return lastCounters;
+    }
+
+    // There are only a few instrumented modules, so they are searched linearly
+    std::vector<std::pair<const ISPCInstrumentSites *, std::vector<Counters>>> modules;
+    const ISPCInstrumentSites *lastSites{nullptr};
+    Counters *lastCounters{nullptr};
+    // Instrumented calls of the thread, for the sampling
+    uint64_t tick{0};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadSites>> threads;
+    // Changed by ispcrtInstrumentReset(), so the threads register new tables
+    std::atomic<uint64_t> generation{1};
+    std::atomic<uint32_t> period{1};
+    std::atomic<uint32_t> width{0};
+    std::string reportFile;
+};
+
+// Never destroyed, so the instrumented code may run during the exit.
+Registry &registry() {
+    static Registry *r = new Registry;
+    return *r;
+}
+
+void reportAtExit() {
+    const std::string &file = registry().reportFile;
+    if (file == "-") {
+        ispcrtInstrumentReport(stdout);
+        return;
+    }
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == nullptr) {
+        fprintf(stderr, "[ISPCRT][WARNING] Cannot write instrumentation report to %s\n", file.c_str());
+        return;
+    }
+    ispcrtInstrumentReport(f);
+    fclose(f);
+}
+
+uint32_t envNumber(const char *name) {
+    const char *val = getenv(name);
+    if (val == nullptr)
+        return 0;
+    return uint32_t(strtoul(val, nullptr, 10));
+}
+
+void readEnvironment() {
+    Registry &r = registry();
+    if (const uint32_t period = envNumber("ISPCRT_INSTRUMENT_SAMPLING"))
+        r.period = period;
+    if (const uint32_t width = envNumber("ISPCRT_INSTRUMENT_WIDTH"))
+        r.width = width;
+    if (const char *file = getenv("ISPCRT_INSTRUMENT_REPORT")) {
+        r.reportFile = file;
+        std::atexit(reportAtExit);
+    }
+}
+
+// The gang size for the report: the one set by the user or the highest
+// active lane seen rounded up to a power of 2.
+uint32_t gangWidth(uint64_t mask) {
+    uint32_t width = registry().width;
+    if (width == 0) {
+        width = 1;
+        while (width < 64 && (mask >> width) != 0)
+            width *= 2;
+    }
+    return width;
+}
+
+ThreadSites &threadSites() {
+    thread_local ThreadSites *t_sites = nullptr;
+    thread_local uint64_t t_generation = 0;
+    Registry &r = registry();
+    if (t_sites == nullptr || t_generation != r.generation.load(std::memory_order_relaxed)) {
+        static std::once_flag envFlag;
+        std::call_once(envFlag, readEnvironment);
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.emplace_back(new ThreadSites);
+        t_sites = r.threads.back().get();
+        t_generation = r.generation.load(std::memory_order_relaxed);
+    }
+    return *t_sites;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////
+// Sampling lane profiler
+
+// The state, which the code compiled with --lane-profile updates at every
+// instrumentation site, see Module::GetLaneProfileState() in ispc.
+struct ISPCLaneProfileState {
+    const ISPCInstrumentSites *sites;
+    uint32_t id;
+    uint64_t mask;
+};
+
+extern "C" {
+thread_local ISPCLaneProfileState __ispc_lane_profile_state = {nullptr, 0, 0};
+}
+
+namespace {
+
+#define LANE_PROFILE_SLOTS 4096
+#define LANE_PROFILE_DEFAULT_INTERVAL_US 1000
+
+// The samples of a site.  The slots are a fixed size hash table, as the
+// signal handler must not allocate.
+struct SampleSlot {
+    const ISPCInstrumentSites *sites;
+    uint32_t id;
+    uint64_t samples;
+    uint64_t lanes;
+    uint64_t allOff;
+    uint64_t mask;
+};
+
+struct LaneProfile {
+    // Taken by the signal handler and the report.  The handler doesn't wait
+    // for it, so the report doesn't deadlock when its thread is sampled.
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    SampleSlot slots[LANE_PROFILE_SLOTS];
+    uint64_t samples{0};
+    uint64_t outside{0};
+    std::atomic<uint64_t> dropped{0};
+    bool running{false};
+    std::string reportFile;
+#ifdef ISPCRT_LANE_PROFILE_SIGPROF
+    struct sigaction oldAction;
+#endif
+};
+
+// Created before the profiler starts and never destroyed, so the handler
+// doesn't run the initialization of a static variable.
+LaneProfile *g_laneProfile = nullptr;
+
+LaneProfile &laneProfile() {
+    static std::once_flag flag;
+    std::call_once(flag, [] { g_laneProfile = new LaneProfile; });
+    return *g_laneProfile;
+}
+
+void lock(LaneProfile &p) {
+    while (p.busy.test_and_set(std::memory_order_acquire))
+        ;
+}
+
+void unlock(LaneProfile &p) { p.busy.clear(std::memory_order_release); }
+
+[[maybe_unused]] void onSample(int) {
+    LaneProfile *p = g_laneProfile;
+    if (p == nullptr)
+        return;
+    // The state of the interrupted thread, it may be in the middle of an
+    // update, so the ID is checked.
+    const ISPCLaneProfileState state = __ispc_lane_profile_state;
+    if (p->busy.test_and_set(std::memory_order_acquire)) {
+        p->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    p->samples++;
+    if (state.sites == nullptr || state.id >= state.sites->numSites) {
+        p->outside++;
+        unlock(*p);
+        return;
+    }
+    uint64_t hash = (uint64_t(uintptr_t(state.sites)) >> 4) * 0x9E3779B97F4A7C15ull + state.id;
+    for (uint32_t i = 0; i < LANE_PROFILE_SLOTS; i++) {
+        SampleSlot &slot = p->slots[(hash + i) % LANE_PROFILE_SLOTS];
+        if (slot.sites == nullptr) {
+            slot.sites = state.sites;
+            slot.id = state.id;
+        } else if (slot.sites != state.sites || slot.id != state.id) {
+            continue;
+        }
+        slot.samples++;
+        slot.lanes += std::bitset<64>(state.mask).count();
+        slot.allOff += state.mask == 0;
+        slot.mask |= state.mask;
+        unlock(*p);
+        return;
+    }
+    // The table is full.
+    p->outside++;
+    p->dropped.fetch_add(1, std::memory_order_relaxed);
+    unlock(*p);
+}
+
+void laneProfileReportAtExit() {
+    ispcrtLaneProfileStop();
+    const std::string &file = laneProfile().reportFile;
+    if (file == "-") {
+        ispcrtLaneProfileReport(stdout);
+        return;
+    }
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == nullptr) {
+        fprintf(stderr, "[ISPCRT][WARNING] Cannot write lane profile report to %s\n", file.c_str());
+        return;
+    }
+    ispcrtLaneProfileReport(f);
+    fclose(f);
+}
+
+// Starts the profiler when the program starts, if it's requested in the
+// environment.
+struct LaneProfileFromEnvironment {
+    LaneProfileFromEnvironment() {
+        const char *file = getenv("ISPCRT_LANE_PROFILE_REPORT");
+        if (file == nullptr || *file == '\0')
+            return;
+        laneProfile().reportFile = file;
+        ispcrtLaneProfileStart(envNumber("ISPCRT_LANE_PROFILE_INTERVAL_US"));
+        std::atexit(laneProfileReportAtExit);
+    }
+} g_laneProfileFromEnvironment;
+
+} // namespace
+
+extern "C" {
+
+void ISPCInstrument(const ISPCInstrumentSites *sites, uint32_t id, uint64_t mask) {
+    ThreadSites &t = threadSites();
+    const uint32_t period = registry().period.load(std::memory_order_relaxed);
+    if (period > 1 && ++t.tick % period != 0)
+        return;
+    Counters &c = t.find(sites)[id];
+    c.calls++;
+    c.lanes += std::bitset<64>(mask).count();
+    c.allOff += mask == 0;
+    c.mask |= mask;
+}
+
+void ispcrtInstrumentSetWidth(uint32_t width) { registry().width = width; }
+
+void ispcrtInstrumentSetSampling(uint32_t period) { registry().period = period > 0 ? period : 1; }
+
+void ispcrtInstrumentReset() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.clear();
+    r.generation++;
+}
+
+void ispcrtInstrumentReport(FILE *f) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // Merge the sites of all threads and of all targets of the modules by
+    // their source position
+    std::map<std::tuple<std::string, int, std::string, std::string>, Counters> merged;
+    uint64_t mask = 0;
+    for (const auto &t : r.threads) {
+        for (const auto &module : t->modules) {
+            for (uint32_t id = 0; id < module.first->numSites; id++) {
+                const ISPCInstrumentSite &site = module.first->sites[id];
+                const Counters &c = module.second[id];
+                if (c.calls == 0)
+                    continue;
+                Counters &m = merged[std::make_tuple(std::string(site.file), site.line, std::string(site.function),
+                                                     std::string(site.note))];
+                m.calls += c.calls;
+                m.lanes += c.lanes;
+                m.allOff += c.allOff;
+                mask |= c.mask;
+            }
+        }
+    }
+
+    const uint32_t width = gangWidth(mask);
+    const uint32_t period = r.period;
+
+    fprintf(f, "# gang size %u", width);
+    if (period > 1)
+        fprintf(f, ", every %u-th call sampled", period);
+    fprintf(f, "\n");
+    for (const auto &m : merged) {
+        const Counters &s = m.second;
+        fprintf(f, "%s(%04d) - %s: %s: %llu calls (%.2f%% all off), %.2f%% active lanes\n",
+                std::get<0>(m.first).c_str(), std::get<1>(m.first), std::get<2>(m.first).c_str(),
+                std::get<3>(m.first).c_str(), (unsigned long long)(s.calls * period), 100.0 * s.allOff / s.calls,
+                100.0 * s.lanes / (double(width) * s.calls));
+    }
+}
+
+void ispcrtLaneProfileStart(uint32_t intervalUs) {
+    LaneProfile &p = laneProfile();
+    if (p.running)
+        return;
+#ifdef ISPCRT_LANE_PROFILE_SIGPROF
+    if (intervalUs == 0)
+        intervalUs = LANE_PROFILE_DEFAULT_INTERVAL_US;
+    struct sigaction action = {};
+    action.sa_handler = onSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &p.oldAction) != 0) {
+        fprintf(stderr, "[ISPCRT][WARNING] Cannot install the SIGPROF handler of the lane profiler\n");
+        return;
+    }
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = intervalUs / 1000000;
+    timer.it_interval.tv_usec = intervalUs % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        sigaction(SIGPROF, &p.oldAction, nullptr);
+        fprintf(stderr, "[ISPCRT][WARNING] Cannot start the timer of the lane profiler\n");
+        return;
+    }
+    p.running = true;
+#else
+    (void)intervalUs;
+    fprintf(stderr, "[ISPCRT][WARNING] The lane profiler is not supported on this platform\n");
+#endif
+}
+
+void ispcrtLaneProfileStop() {
+    LaneProfile &p = laneProfile();
+    if (!p.running)
+        return;
+#ifdef ISPCRT_LANE_PROFILE_SIGPROF
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &p.oldAction, nullptr);
+#endif
+    p.running = false;
+}
+
+void ispcrtLaneProfileReset() {
+    LaneProfile &p = laneProfile();
+    lock(p);
+    for (SampleSlot &slot : p.slots)
+        slot = SampleSlot{};
+    p.samples = 0;
+    p.outside = 0;
+    p.dropped = 0;
+    unlock(p);
+}
+
+void ispcrtLaneProfileReport(FILE *f) {
+    LaneProfile &p = laneProfile();
+
+    // Merge the sites of all targets of the modules by their source position.
+    std::map<std::tuple<std::string, int, std::string, std::string>, SampleSlot> merged;
+    uint64_t mask = 0;
+    lock(p);
+    const uint64_t samples = p.samples;
+    const uint64_t inside = p.samples - p.outside;
+    for (const SampleSlot &slot : p.slots) {
+        if (slot.sites == nullptr)
+            continue;
+        const ISPCInstrumentSite &site = slot.sites->sites[slot.id];
+        SampleSlot &m = merged[std::make_tuple(std::string(site.file), site.line, std::string(site.function),
+                                               std::string(site.note))];
+        m.samples += slot.samples;
+        m.lanes += slot.lanes;
+        m.allOff += slot.allOff;
+        mask |= slot.mask;
+    }
+    unlock(p);
+
+    const uint32_t width = gangWidth(mask);
+    fprintf(f, "# gang size %u, %llu samples, %llu in ispc code", width, (unsigned long long)samples,
+            (unsigned long long)inside);
+    if (const uint64_t dropped = p.dropped.load())
+        fprintf(f, ", %llu dropped", (unsigned long long)dropped);
+    fprintf(f, "\n");
+    for (const auto &m : merged) {
+        const SampleSlot &s = m.second;
+        fprintf(f, "%s(%04d) - %s: %s: %llu samples (%.2f%%, %.2f%% all off), %.2f%% active lanes\n",
+                std::get<0>(m.first).c_str(), std::get<1>(m.first), std::get<2>(m.first).c_str(),
+                std::get<3>(m.first).c_str(), (unsigned long long)s.samples, 100.0 * s.samples / inside,
+                100.0 * s.allOff / s.samples, 100.0 * s.lanes / (double(width) * s.samples));
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,93 @@
+// Copyright 2024 Intel Corporation
+// SPDX-License-Identifier: BSD-3-Clause
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Runtime of the code compiled with the ispc --instrument flag. Link the
+// ispcrt_instrument static library to provide ISPCInstrument(), which counts
+// the calls, the active lanes and the calls with all lanes off for every
+// instrumented site in per-thread arrays indexed by the site IDs.
+//
+// Environment variables read on the first instrumented call:
+//  * ISPCRT_INSTRUMENT_REPORT - write the report to this file ("-" for
+//    stdout) at exit
+//  * ISPCRT_INSTRUMENT_SAMPLING - count only every N-th call of every thread
+//  * ISPCRT_INSTRUMENT_WIDTH - the gang size of the target
+//
+// It also provides the sampling lane profiler for the code compiled with the
+// ispc --lane-profile flag. Such code doesn't call ISPCInstrument(), it only
+// records the last instrumentation site and the mask at it in a thread-local
+// variable, so it's cheap enough to stay enabled in production builds. The
+// profiler samples the running threads with a CPU time timer (SIGPROF,
+// POSIX only) and attributes the samples and the active lanes to the sites.
+//
+// Environment variables read when the program starts:
+//  * ISPCRT_LANE_PROFILE_REPORT - start the profiler and write the report to
+//    this file ("-" for stdout) at exit
+//  * ISPCRT_LANE_PROFILE_INTERVAL_US - the sampling interval, 1000 by default
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The table of the instrumentation sites of a compiled module, the same as
+// in the headers generated by ispc.
+#ifndef ISPC_INSTRUMENT_SITES_DEFINED
+#define ISPC_INSTRUMENT_SITES_DEFINED
+struct ISPCInstrumentSite {
+    const char *file;
+    const char *function;
+    const char *note;
+    int32_t line;
+};
+struct ISPCInstrumentSites {
+    uint32_t numSites;
+    const struct ISPCInstrumentSite *sites;
+};
+#endif // ISPC_INSTRUMENT_SITES_DEFINED
+
+// The hook the compiler emits calls to. The id is the index of the site in
+// the table of the module.
+void ISPCInstrument(const struct ISPCInstrumentSites *sites, uint32_t id, uint64_t mask);
+
+// Set the gang size used for the lane occupancy. If it's 0 (the default), the
+// highest active lane seen rounded up to a power of 2 is used.
+void ispcrtInstrumentSetWidth(uint32_t width);
+
+// Count only every period-th instrumented call of every thread, 1 counts all
+// of them (the default). The report scales the number of the sampled calls
+// by the period, the rates are estimated from the sampled calls only.
+void ispcrtInstrumentSetSampling(uint32_t period);
+
+// Drop the collected counters. It must not be called while the instrumented
+// code is running.
+void ispcrtInstrumentReset();
+
+// Write the report of the collected counters, one line per source line and
+// note, sorted by file and line. It must not be called while the
+// instrumented code is running, nor after unloading an instrumented library,
+// as the report reads the tables of the sites of the libraries.
+void ispcrtInstrumentReport(FILE *f);
+
+// Start sampling with the given interval of the CPU time of the process in
+// microseconds (0 for the default). The SIGPROF handler of the application,
+// if any, is replaced until ispcrtLaneProfileStop().
+void ispcrtLaneProfileStart(uint32_t intervalUs);
+
+void ispcrtLaneProfileStop();
+
+// Drop the collected samples.
+void ispcrtLaneProfileReset();
+
+// Write the report of the samples, one line per source line and note, sorted
+// by file and line: the number of samples, their share of all samples in the
+// ispc code and the percentage of the active lanes. The same restrictions as
+// for ispcrtInstrumentReport() apply.
+void ispcrtLaneProfileReport(FILE *f);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -24,6 +24,11 @@ std::unordered_map<std::string, ze_result_t> Config::resultsMap;
 std::vector<CmdListElem> Config::cmdList;
 bool Config::cmdListOpened = true;
 uint32_t Config::expectedDevice = 0;
+std::vector<std::string> Config::kernelNames;
+std::unordered_map<std::string, uint32_t> Config::kernelSpillSizes;
+std::string Config::lastKernelName;
+std::vector<uint8_t> Config::nativeBinary;
+std::vector<std::vector<uint8_t>> Config::kernelArgs;
 
 const DeviceProperties DefaultGpuDevice(VendorId::Intel, DeviceId::Gen9);
 
@@ -40,6 +45,11 @@ void Config::cleanup() {
     setExpectedDevice(0);
     resetCmdList();
     resultsMap.clear();
+    kernelNames.clear();
+    kernelSpillSizes.clear();
+    lastKernelName.clear();
+    nativeBinary.clear();
+    kernelArgs.clear();
 }
 
 void Config::addToCmdList(CmdListElem cle) { cmdList.push_back(cle); }
@@ -74,6 +84,33 @@ void Config::setDeviceProperties(uint32_t deviceIdx, const DeviceProperties &dp)
     devices[deviceIdx] = dp;
 }
 
+void Config::setKernelNames(const std::vector<std::string> &names) { kernelNames = names; }
+
+const std::vector<std::string> &Config::getKernelNames() { return kernelNames; }
+
+void Config::setKernelSpillSize(const std::string &name, uint32_t size) { kernelSpillSizes[name] = size; }
+
+uint32_t Config::getKernelSpillSize(const std::string &name) {
+    return kernelSpillSizes.count(name) == 0 ? 0 : kernelSpillSizes[name];
+}
+
+void Config::setLastKernelName(const std::string &name) { lastKernelName = name; }
+
+const std::string &Config::getLastKernelName() { return lastKernelName; }
+
+void Config::setNativeBinary(const std::vector<uint8_t> &binary) { nativeBinary = binary; }
+
+const std::vector<uint8_t> &Config::getNativeBinary() { return nativeBinary; }
+
+void Config::setKernelArg(uint32_t index, size_t size, const void *value) {
+    if (index >= kernelArgs.size())
+        kernelArgs.resize(index + 1);
+    const uint8_t *bytes = (const uint8_t *)value;
+    kernelArgs[index].assign(bytes, bytes + size);
+}
+
+const std::vector<std::vector<uint8_t>> &Config::getKernelArgs() { return kernelArgs; }
+
 } // namespace mock
 } // namespace testing
 } // namespace ispcrt
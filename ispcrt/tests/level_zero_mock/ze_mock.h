@@ -17,7 +17,7 @@ namespace ispcrt {
 namespace testing {
 namespace mock {
 
-enum class CmdListElem { MemoryCopy, KernelLaunch, Barrier };
+enum class CmdListElem { MemoryCopy, KernelLaunch, Barrier, MemoryPrefetch, MemAdvise };
 
 namespace VendorId {
 constexpr uint32_t Intel = 0x8086;
@@ -36,6 +36,8 @@ constexpr uint32_t GenericAMD = 0x5678;
 struct DeviceProperties {
     uint32_t vendorId;
     uint32_t deviceId;
+    ze_device_property_flags_t flags{0};
+    ze_memory_access_cap_flags_t sharedSystemAllocCapabilities{0};
 
     DeviceProperties() = default;
     DeviceProperties(uint32_t vendorId, uint32_t deviceId) : vendorId(vendorId), deviceId(deviceId) {}
@@ -67,6 +69,16 @@ class Config {
     static void setExpectedDevice(uint32_t deviceIdx);
     static uint32_t getExpectedDevice();
     static void setDeviceProperties(uint32_t deviceIdx, const DeviceProperties &dp);
+    static void setKernelNames(const std::vector<std::string> &names);
+    static const std::vector<std::string> &getKernelNames();
+    static void setKernelSpillSize(const std::string &name, uint32_t size);
+    static uint32_t getKernelSpillSize(const std::string &name);
+    static void setLastKernelName(const std::string &name);
+    static const std::string &getLastKernelName();
+    static void setNativeBinary(const std::vector<uint8_t> &binary);
+    static const std::vector<uint8_t> &getNativeBinary();
+    static void setKernelArg(uint32_t index, size_t size, const void *value);
+    static const std::vector<std::vector<uint8_t>> &getKernelArgs();
 
   private:
     static std::unordered_map<std::string, ze_result_t> resultsMap;
@@ -74,6 +86,11 @@ class Config {
     static bool cmdListOpened;
     static std::vector<DeviceProperties> devices;
     static uint32_t expectedDevice;
+    static std::vector<std::string> kernelNames;
+    static std::unordered_map<std::string, uint32_t> kernelSpillSizes;
+    static std::string lastKernelName;
+    static std::vector<uint8_t> nativeBinary;
+    static std::vector<std::vector<uint8_t>> kernelArgs;
 };
 
 } // namespace mock
@@ -83,6 +83,7 @@ ze_result_t zeDeviceGetProperties(ze_device_handle_t hDevice, ze_device_properti
     pDeviceProperties->type = ZE_DEVICE_TYPE_GPU;
     pDeviceProperties->deviceId = dp->deviceId;
     pDeviceProperties->vendorId = dp->vendorId;
+    pDeviceProperties->flags = dp->flags;
 
     const std::string MOCK_NAME{"ISPCRT Mock Device"};
     std::copy(MOCK_NAME.cbegin(), MOCK_NAME.cend(), pDeviceProperties->name);
@@ -90,6 +91,17 @@ ze_result_t zeDeviceGetProperties(ze_device_handle_t hDevice, ze_device_properti
     MOCK_RET;
 }
 
+ze_result_t zeDeviceGetMemoryAccessProperties(ze_device_handle_t hDevice,
+                                              ze_device_memory_access_properties_t *pMemAccessProperties) {
+    MOCK_CNT_CALL;
+    if (!ValidDevice(hDevice) || pMemAccessProperties == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+
+    auto dp = reinterpret_cast<DeviceProperties *>(hDevice);
+    pMemAccessProperties->sharedSystemAllocCapabilities = dp->sharedSystemAllocCapabilities;
+    MOCK_RET;
+}
+
 ze_result_t zeContextCreate(ze_driver_handle_t hDriver, const ze_context_desc_t *desc, ze_context_handle_t *phContext) {
     MOCK_CNT_CALL;
     *phContext = ContextHandle.get();
@@ -143,6 +155,16 @@ ze_result_t zeCommandListCreate(ze_context_handle_t hContext, ze_device_handle_t
     MOCK_RET;
 }
 
+ze_result_t zeCommandListCreateImmediate(ze_context_handle_t hContext, ze_device_handle_t hDevice,
+                                         const ze_command_queue_desc_t *altdesc,
+                                         ze_command_list_handle_t *phCommandList) {
+    MOCK_CNT_CALL;
+    if (!ExpectedDevice(hDevice) || hContext != ContextHandle.get() || altdesc == nullptr || phCommandList == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    *phCommandList = CmdListHandle.get();
+    MOCK_RET;
+}
+
 ze_result_t zeCommandListDestroy(ze_command_list_handle_t hCommandList) {
     MOCK_CNT_CALL;
     if (hCommandList != CmdListHandle.get())
@@ -187,6 +209,25 @@ ze_result_t zeCommandListAppendMemoryCopy(ze_command_list_handle_t hCommandList,
     MOCK_RET;
 }
 
+ze_result_t zeCommandListAppendMemoryPrefetch(ze_command_list_handle_t hCommandList, const void *ptr, size_t size) {
+    MOCK_CNT_CALL;
+    if (hCommandList != CmdListHandle.get() || Config::isCmdListClosed())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (MOCK_SHOULD_SUCCEED)
+        Config::addToCmdList(CmdListElem::MemoryPrefetch);
+    MOCK_RET;
+}
+
+ze_result_t zeCommandListAppendMemAdvise(ze_command_list_handle_t hCommandList, ze_device_handle_t hDevice,
+                                         const void *ptr, size_t size, ze_memory_advice_t advice) {
+    MOCK_CNT_CALL;
+    if (hCommandList != CmdListHandle.get() || Config::isCmdListClosed())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (MOCK_SHOULD_SUCCEED)
+        Config::addToCmdList(CmdListElem::MemAdvise);
+    MOCK_RET;
+}
+
 ze_result_t zeEventPoolCreate(ze_context_handle_t hContext, const ze_event_pool_desc_t *desc, uint32_t numDevices,
                               ze_device_handle_t *phDevices, ze_event_pool_handle_t *phEventPool) {
     MOCK_CNT_CALL;
@@ -231,6 +272,11 @@ ze_result_t zeEventHostReset(ze_event_handle_t hEvent) {
     MOCK_RET;
 }
 
+ze_result_t zeEventHostSynchronize(ze_event_handle_t hEvent, uint64_t timeout) {
+    MOCK_CNT_CALL;
+    MOCK_RET;
+}
+
 static int fenceSignalTimerCounter = 0;
 ze_result_t zeFenceCreate(ze_command_queue_handle_t hCommandQueue, const ze_fence_desc_t *desc,
                           ze_fence_handle_t *phFence) {
@@ -294,6 +340,30 @@ ze_result_t zeMemAllocShared(ze_context_handle_t hContext, const ze_device_mem_a
     MOCK_RET;
 }
 
+ze_result_t zeMemAllocHost(ze_context_handle_t hContext, const ze_host_mem_alloc_desc_t *host_desc, size_t size,
+                           size_t alignment, void **pptr) {
+    MOCK_CNT_CALL;
+    if (hContext != ContextHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (MOCK_SHOULD_SUCCEED)
+        *pptr = new uint8_t[size];
+    MOCK_RET;
+}
+
+// The mock doesn't track the allocations, so all memory is reported as
+// allocated by the application.
+ze_result_t zeMemGetAllocProperties(ze_context_handle_t hContext, const void *ptr,
+                                    ze_memory_allocation_properties_t *pMemAllocProperties,
+                                    ze_device_handle_t *phDevice) {
+    MOCK_CNT_CALL;
+    if (hContext != ContextHandle.get() || !pMemAllocProperties)
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    pMemAllocProperties->type = ZE_MEMORY_TYPE_UNKNOWN;
+    if (phDevice)
+        *phDevice = nullptr;
+    MOCK_RET;
+}
+
 ze_result_t zeMemFree(ze_context_handle_t hContext, void *ptr) {
     MOCK_CNT_CALL;
     if (hContext != ContextHandle.get() || !ptr)
@@ -353,13 +423,54 @@ ze_result_t zeModuleGetFunctionPointer(ze_module_handle_t hModule, const char *p
     MOCK_RET;
 }
 
+ze_result_t zeModuleGetNativeBinary(ze_module_handle_t hModule, size_t *pSize, uint8_t *pModuleNativeBinary) {
+    MOCK_CNT_CALL;
+    if (hModule != ModuleHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (pSize == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_POINTER;
+    const auto &binary = Config::getNativeBinary();
+    if (pModuleNativeBinary != nullptr)
+        std::copy_n(binary.begin(), std::min(*pSize, binary.size()), pModuleNativeBinary);
+    *pSize = binary.size();
+    MOCK_RET;
+}
+
+ze_result_t zeModuleGetKernelNames(ze_module_handle_t hModule, uint32_t *pCount, const char **pNames) {
+    MOCK_CNT_CALL;
+    if (hModule != ModuleHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (pCount == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_POINTER;
+    const auto &names = Config::getKernelNames();
+    if (pNames != nullptr) {
+        for (uint32_t i = 0; i < *pCount && i < names.size(); i++)
+            pNames[i] = names[i].c_str();
+    }
+    *pCount = names.size();
+    MOCK_RET;
+}
+
 ze_result_t zeKernelCreate(ze_module_handle_t hModule, const ze_kernel_desc_t *desc, ze_kernel_handle_t *phKernel) {
     MOCK_CNT_CALL;
     if (hModule != ModuleHandle.get())
         return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
 
     *phKernel = KernelHandle.get();
+    Config::setLastKernelName(desc->pKernelName);
+
+    MOCK_RET;
+}
 
+// All of the kernels share the same handle, so the properties are the ones
+// of the kernel created last.
+ze_result_t zeKernelGetProperties(ze_kernel_handle_t hKernel, ze_kernel_properties_t *pKernelProperties) {
+    MOCK_CNT_CALL;
+    if (hKernel != KernelHandle.get())
+        return ZE_RESULT_ERROR_INVALID_NULL_HANDLE;
+    if (pKernelProperties == nullptr)
+        return ZE_RESULT_ERROR_INVALID_NULL_POINTER;
+    pKernelProperties->spillMemSize = Config::getKernelSpillSize(Config::getLastKernelName());
     MOCK_RET;
 }
 
@@ -374,6 +485,8 @@ ze_result_t zeKernelDestroy(ze_kernel_handle_t hKernel) {
 ze_result_t zeKernelSetArgumentValue(ze_kernel_handle_t hKernel, uint32_t argIndex, size_t argSize,
                                      const void *pArgValue) {
     MOCK_CNT_CALL;
+    if (pArgValue != nullptr)
+        Config::setKernelArg(argIndex, argSize, pArgValue);
     MOCK_RET;
 }
 
@@ -439,6 +552,7 @@ ze_result_t zeGetDriverProcAddrTable(ze_api_version_t version, ze_driver_dditabl
 ze_result_t zeGetDeviceProcAddrTable(ze_api_version_t version, ze_device_dditable_t *pDdiTable) {
     pDdiTable->pfnGet = ispcrt::testing::mock::driver::zeDeviceGet;
     pDdiTable->pfnGetProperties = ispcrt::testing::mock::driver::zeDeviceGetProperties;
+    pDdiTable->pfnGetMemoryAccessProperties = ispcrt::testing::mock::driver::zeDeviceGetMemoryAccessProperties;
     return ZE_RESULT_SUCCESS;
 }
 
@@ -458,12 +572,15 @@ ze_result_t zeGetCommandQueueProcAddrTable(ze_api_version_t version, ze_command_
 
 ze_result_t zeGetCommandListProcAddrTable(ze_api_version_t version, ze_command_list_dditable_t *pDdiTable) {
     pDdiTable->pfnCreate = ispcrt::testing::mock::driver::zeCommandListCreate;
+    pDdiTable->pfnCreateImmediate = ispcrt::testing::mock::driver::zeCommandListCreateImmediate;
     pDdiTable->pfnDestroy = ispcrt::testing::mock::driver::zeCommandListDestroy;
     pDdiTable->pfnClose = ispcrt::testing::mock::driver::zeCommandListClose;
     pDdiTable->pfnReset = ispcrt::testing::mock::driver::zeCommandListReset;
     pDdiTable->pfnAppendBarrier = ispcrt::testing::mock::driver::zeCommandListAppendBarrier;
     pDdiTable->pfnAppendMemoryCopy = ispcrt::testing::mock::driver::zeCommandListAppendMemoryCopy;
     pDdiTable->pfnAppendLaunchKernel = ispcrt::testing::mock::driver::zeCommandListAppendLaunchKernel;
+    pDdiTable->pfnAppendMemoryPrefetch = ispcrt::testing::mock::driver::zeCommandListAppendMemoryPrefetch;
+    pDdiTable->pfnAppendMemAdvise = ispcrt::testing::mock::driver::zeCommandListAppendMemAdvise;
     return ZE_RESULT_SUCCESS;
 }
 
@@ -473,6 +590,7 @@ ze_result_t zeGetEventProcAddrTable(ze_api_version_t version, ze_event_dditable_
     pDdiTable->pfnQueryKernelTimestamp = ispcrt::testing::mock::driver::zeEventQueryKernelTimestamp;
     pDdiTable->pfnQueryStatus = ispcrt::testing::mock::driver::zeEventQueryStatus;
     pDdiTable->pfnHostReset = ispcrt::testing::mock::driver::zeEventHostReset;
+    pDdiTable->pfnHostSynchronize = ispcrt::testing::mock::driver::zeEventHostSynchronize;
     return ZE_RESULT_SUCCESS;
 }
 
@@ -489,12 +607,15 @@ ze_result_t zeGetKernelProcAddrTable(ze_api_version_t version, ze_kernel_dditabl
     pDdiTable->pfnSetIndirectAccess = ispcrt::testing::mock::driver::zeKernelSetIndirectAccess;
     pDdiTable->pfnSetGroupSize = ispcrt::testing::mock::driver::zeKernelSetGroupSize;
     pDdiTable->pfnSuggestGroupSize = ispcrt::testing::mock::driver::zeKernelSuggestGroupSize;
+    pDdiTable->pfnGetProperties = ispcrt::testing::mock::driver::zeKernelGetProperties;
     return ZE_RESULT_SUCCESS;
 }
 
 ze_result_t zeGetMemProcAddrTable(ze_api_version_t version, ze_mem_dditable_t *pDdiTable) {
     pDdiTable->pfnAllocDevice = ispcrt::testing::mock::driver::zeMemAllocDevice;
     pDdiTable->pfnAllocShared = ispcrt::testing::mock::driver::zeMemAllocShared;
+    pDdiTable->pfnAllocHost = ispcrt::testing::mock::driver::zeMemAllocHost;
+    pDdiTable->pfnGetAllocProperties = ispcrt::testing::mock::driver::zeMemGetAllocProperties;
 
     pDdiTable->pfnFree = ispcrt::testing::mock::driver::zeMemFree;
     return ZE_RESULT_SUCCESS;
@@ -505,6 +626,8 @@ ze_result_t zeGetModuleProcAddrTable(ze_api_version_t version, ze_module_dditabl
     pDdiTable->pfnDestroy = ispcrt::testing::mock::driver::zeModuleDestroy;
     pDdiTable->pfnDynamicLink = ispcrt::testing::mock::driver::zeModuleDynamicLink;
     pDdiTable->pfnGetFunctionPointer = ispcrt::testing::mock::driver::zeModuleGetFunctionPointer;
+    pDdiTable->pfnGetKernelNames = ispcrt::testing::mock::driver::zeModuleGetKernelNames;
+    pDdiTable->pfnGetNativeBinary = ispcrt::testing::mock::driver::zeModuleGetNativeBinary;
     return ZE_RESULT_SUCCESS;
 }
 
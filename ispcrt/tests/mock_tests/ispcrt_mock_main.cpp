@@ -6,7 +6,12 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
 #include <stdlib.h>
+#include <thread>
 
 namespace ispcrt {
 namespace testing {
@@ -335,6 +340,78 @@ TEST_F(MockTestWithContextMemPool, CheckFreeList) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
+TEST_F(MockTestWithContextMemPool, MemPoolStats) {
+    ispcrt::SharedMemoryAllocator<char> sma(m_ctxt, ispcrt::SharedMemoryUsageHint::HostWriteDeviceRead);
+    for (int i = 0; i < 3; i++)
+        sma.allocate(1ULL << 20);
+    sma.allocate(100);
+    auto stats = m_ctxt.memPoolStats(ISPCRT_SM_HOST_WRITE_DEVICE_READ);
+    ASSERT_EQ(stats.bytesReserved, 3 * (1ULL << 21));
+    ASSERT_EQ(stats.bytesInUse, 3 * (1ULL << 20) + 128);
+    ASSERT_EQ(stats.peakBytesReserved, stats.bytesReserved);
+    ASSERT_EQ(stats.maxBytesReserved, 0);
+    auto chunks = m_ctxt.memPoolChunkStats(ISPCRT_SM_HOST_WRITE_DEVICE_READ);
+    ASSERT_EQ(chunks.size(), 16);
+    for (const auto &c : chunks) {
+        if (c.chunkSize == 128) {
+            ASSERT_EQ(c.numBulks, 1);
+            ASSERT_EQ(c.bytesInUse, 128);
+        } else if (c.chunkSize == (1ULL << 20)) {
+            ASSERT_EQ(c.numBulks, 2);
+            ASSERT_EQ(c.bytesReserved, 2 * (1ULL << 21));
+        } else {
+            ASSERT_EQ(c.numBulks, 0);
+        }
+    }
+    // The other pool is not touched
+    stats = m_ctxt.memPoolStats(ISPCRT_SM_HOST_READ_DEVICE_WRITE);
+    ASSERT_EQ(stats.bytesReserved, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithContextMemPool, MemPoolTrim) {
+    ispcrt::SharedMemoryAllocator<char> sma(m_ctxt, ispcrt::SharedMemoryUsageHint::HostWriteDeviceRead);
+    const size_t size = 1ULL << 20;
+    auto *p1 = sma.allocate(size);
+    auto *p2 = sma.allocate(size);
+    auto *p3 = sma.allocate(size);
+    sma.deallocate(p3, size);
+    ASSERT_EQ(m_ctxt.trimMemPool(ISPCRT_SM_HOST_WRITE_DEVICE_READ), 1ULL << 21);
+    ASSERT_EQ(CallCounters::get("zeMemFree"), 1);
+    sma.deallocate(p1, size);
+    ASSERT_EQ(m_ctxt.trimMemPool(ISPCRT_SM_HOST_WRITE_DEVICE_READ), 0);
+    sma.deallocate(p2, size);
+    ASSERT_EQ(m_ctxt.trimMemPool(ISPCRT_SM_HOST_WRITE_DEVICE_READ), 1ULL << 21);
+    auto stats = m_ctxt.memPoolStats(ISPCRT_SM_HOST_WRITE_DEVICE_READ);
+    ASSERT_EQ(stats.bytesReserved, 0);
+    ASSERT_EQ(stats.peakBytesReserved, 2 * (1ULL << 21));
+    // The pool is still usable after trimming
+    sma.allocate(size);
+    ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 3);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithContextMemPool, MemPoolLimit) {
+    ispcrt::SharedMemoryAllocator<char> sma(m_ctxt, ispcrt::SharedMemoryUsageHint::HostWriteDeviceRead);
+    m_ctxt.setMemPoolLimit(ISPCRT_SM_HOST_WRITE_DEVICE_READ, 1ULL << 21);
+    const size_t size = 1ULL << 20;
+    auto *p1 = sma.allocate(size);
+    sma.allocate(size);
+    // Beyond the limit, so allocated directly
+    auto *p3 = sma.allocate(size);
+    ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 2);
+    auto stats = m_ctxt.memPoolStats(ISPCRT_SM_HOST_WRITE_DEVICE_READ);
+    ASSERT_EQ(stats.bytesReserved, 1ULL << 21);
+    ASSERT_EQ(stats.maxBytesReserved, 1ULL << 21);
+    sma.deallocate(p3, size);
+    ASSERT_EQ(CallCounters::get("zeMemFree"), 1);
+    // The freed chunk of the pool is reused
+    sma.deallocate(p1, size);
+    ASSERT_EQ(sma.allocate(size), p1);
+    ASSERT_EQ(CallCounters::get("zeMemAllocShared"), 2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Module tests
 
@@ -376,6 +453,20 @@ TEST_F(MockTestWithDevice, Module_Constructor_zeModuleCreateWithOptionsSetters)
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
+TEST_F(MockTestWithDevice, Module_Constructor_zeModuleCreateWithSpecConstants) {
+    // Create module with specialization constants
+    ispcrt::ModuleOptions opts{m_device};
+    opts.setSpecConstant<int32_t>(0, 32);
+    opts.setSpecConstant(1, 0.5f);
+    ispcrt::Module m(m_device, "", opts);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Only the sizes of the scalar types are accepted
+    const char value[3] = {};
+    ispcrtModuleOptionsSetSpecConstant(opts.handle(), 2, value, sizeof(value));
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+}
+
 TEST_F(MockTestWithDevice, Module_Constructor_zeModuleCreate) {
     // Check if error is reported from module constructor
     Config::setRetValue("zeModuleCreate", ZE_RESULT_ERROR_DEVICE_LOST);
@@ -383,6 +474,53 @@ TEST_F(MockTestWithDevice, Module_Constructor_zeModuleCreate) {
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+TEST_F(MockTestWithDevice, Module_FromMemory) {
+    // Create a module from a SPIR-V image in memory
+    const uint32_t spirv[] = {0x07230203, 0, 0, 0, 0};
+    auto m = ispcrt::Module::fromMemory(m_device, spirv, sizeof(spirv));
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_NE(m.handle(), nullptr);
+    // Empty image is rejected
+    ispcrtLoadModuleFromMemory(m_device.handle(), nullptr, 0, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+}
+
+// Build the fat module of ispc --xe-devices with the zebins for the devices
+// and the SPIR-V code.
+static std::vector<uint8_t> makeFatModule(const std::vector<std::string> &devices) {
+    std::vector<uint8_t> fat = {'I', 'S', 'P', 'C', 'F', 'A', 'T', '1'};
+    auto write = [&fat](uint64_t value, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            fat.push_back(uint8_t(value >> (8 * i)));
+    };
+    auto entry = [&](uint32_t format, const std::string &device, const std::vector<uint8_t> &data) {
+        write(format, 4);
+        write(device.size(), 4);
+        fat.insert(fat.end(), device.begin(), device.end());
+        write(data.size(), 8);
+        fat.insert(fat.end(), data.begin(), data.end());
+    };
+    write(devices.size() + 1, 4);
+    for (const auto &device : devices)
+        entry(1, device, {0x7f, 'E', 'L', 'F'});
+    entry(0, "", {0x03, 0x02, 0x23, 0x07});
+    return fat;
+}
+
+TEST_F(MockTestWithDevice, Module_FromMemoryFat) {
+    // The first zebin accepted by the device is used
+    std::vector<uint8_t> fat = makeFatModule({"acm-g10", "pvc"});
+    auto m = ispcrt::Module::fromMemory(m_device, fat.data(), fat.size());
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_NE(m.handle(), nullptr);
+    ASSERT_EQ(CallCounters::get("zeModuleCreate"), 1);
+    // Truncated image is rejected
+    ispcrtLoadModuleFromMemory(m_device.handle(), fat.data(), fat.size() - 1, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+}
+
 /////////////////////////////////////////////////////////////////////
 // Dynamic binary linking tests
 
@@ -420,6 +558,73 @@ TEST_F(MockTestWithModule, Module_FunctionPtr_zeModuleGetFunctionPointer_invalid
     ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
 }
 
+// Build a 64-bit ELF file with the section string table and the .ze_info
+// section, which is all that is read from the zebin.
+static std::vector<uint8_t> makeZebin(const std::string &zeInfo) {
+    const std::string strTab = std::string("\0.shstrtab\0.ze_info\0", 20);
+    const size_t strTabOff = 64, zeInfoOff = strTabOff + strTab.size();
+    const size_t shOff = (zeInfoOff + zeInfo.size() + 7) & ~size_t(7);
+    std::vector<uint8_t> elf(shOff + 3 * 64, 0);
+    auto write = [&elf](size_t offset, uint64_t value, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            elf[offset + i] = (uint8_t)(value >> (8 * i));
+    };
+    const uint8_t ident[] = {0x7f, 'E', 'L', 'F', 2, 1, 1};
+    std::copy(std::begin(ident), std::end(ident), elf.begin());
+    write(0x28, shOff, 8);
+    write(0x34, 64, 2);
+    write(0x3a, 64, 2);
+    write(0x3c, 3, 2);
+    write(0x3e, 1, 2);
+    std::copy(strTab.begin(), strTab.end(), elf.begin() + strTabOff);
+    std::copy(zeInfo.begin(), zeInfo.end(), elf.begin() + zeInfoOff);
+    // Section 0 is the null section
+    write(shOff + 64, 1, 4);
+    write(shOff + 64 + 0x18, strTabOff, 8);
+    write(shOff + 64 + 0x20, strTab.size(), 8);
+    write(shOff + 128, 11, 4);
+    write(shOff + 128 + 0x18, zeInfoOff, 8);
+    write(shOff + 128 + 0x20, zeInfo.size(), 8);
+    return elf;
+}
+
+TEST_F(MockTestWithModule, Module_KernelResources) {
+    Config::setNativeBinary(makeZebin("version: '1.40'\n"
+                                      "kernels:\n"
+                                      "  - name: foo\n"
+                                      "    execution_env:\n"
+                                      "      grf_count: 256\n"
+                                      "      slm_size: 1024\n"
+                                      "      private_size: 64\n"
+                                      "      spill_size: 128\n"
+                                      "  - name: bar\n"
+                                      "    execution_env:\n"
+                                      "      grf_count: 128\n"
+                                      "    per_thread_memory_buffers:\n"
+                                      "      - type: scratch\n"
+                                      "        usage: spill_fill_space\n"
+                                      "        size: 32\n"));
+    ISPCRTKernelResources res = {};
+    ASSERT_TRUE(m_module.kernelResources("foo", res));
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(res.grfCount, 256u);
+    ASSERT_EQ(res.spillSize, 128u);
+    ASSERT_EQ(res.privateSize, 64u);
+    ASSERT_EQ(res.slmSize, 1024u);
+    ASSERT_TRUE(m_module.kernelResources("bar", res));
+    ASSERT_EQ(res.grfCount, 128u);
+    ASSERT_EQ(res.spillSize, 32u);
+    ASSERT_EQ(res.privateSize, 0u);
+    ASSERT_FALSE(m_module.kernelResources("baz", res));
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithModule, Module_KernelResourcesNoBinary) {
+    ISPCRTKernelResources res = {};
+    ASSERT_FALSE(m_module.kernelResources("foo", res));
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 // Static binary linking tests
 TEST_F(MockTestWithDevice, Module_StaticLink) {
     // Create 2 modules and link them
@@ -455,6 +660,76 @@ TEST_F(MockTestWithModule, Kernel_Constructor_zeKernelCreateSetIndirectAccess) {
     ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
 }
 
+TEST_F(MockTestWithModule, Kernel_WidthVariantsNoSpill) {
+    // The widest variant without spills is selected
+    Config::setKernelNames({"foo__x8", "foo__x16", "bar"});
+    ispcrt::Kernel k(m_device, m_module, "foo");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(k.width(), 16u);
+    ASSERT_EQ(CallCounters::get("zeKernelCreate"), 2);
+    ASSERT_EQ(CallCounters::get("zeKernelGetProperties"), 2);
+}
+
+TEST_F(MockTestWithModule, Kernel_WidthVariantsSpill) {
+    // The variant with the smallest spill size is selected
+    Config::setKernelNames({"foo__x8", "foo__x16", "foo__x32"});
+    Config::setKernelSpillSize("foo__x8", 64);
+    Config::setKernelSpillSize("foo__x16", 128);
+    Config::setKernelSpillSize("foo__x32", 256);
+    ispcrt::Kernel k(m_device, m_module, "foo");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(k.width(), 8u);
+}
+
+TEST_F(MockTestWithModule, Kernel_WidthVariantsOverride) {
+    Config::setKernelNames({"foo__x8", "foo__x16"});
+    ispcrt::Kernel k(m_device, m_module, "foo", 8);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(k.width(), 8u);
+    ASSERT_EQ(Config::getLastKernelName(), "foo__x8");
+    ASSERT_EQ(CallCounters::get("zeKernelGetProperties"), 0);
+    // No variant with this width
+    ispcrt::Kernel k2(m_device, m_module, "foo", 32);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+}
+
+TEST_F(MockTestWithModule, Kernel_NoWidthVariants) {
+    Config::setKernelNames({"foo"});
+    ispcrt::Kernel k(m_device, m_module, "foo");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(k.width(), 0u);
+    ASSERT_EQ(Config::getLastKernelName(), "foo");
+}
+
+TEST_F(MockTestWithModule, Kernel_Cached) {
+    Config::setKernelNames({"foo"});
+    {
+        // The live kernel is shared
+        ispcrt::Kernel k(m_device, m_module, "foo");
+        ispcrt::Kernel k2(m_device, m_module, "foo");
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(k.handle(), k2.handle());
+        ASSERT_EQ(CallCounters::get("zeKernelCreate"), 1);
+    }
+    ispcrt::Kernel k3(m_device, m_module, "foo");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelCreate"), 2);
+}
+
+TEST_F(MockTestWithDevice, Kernel_EagerModule) {
+    Config::setKernelNames({"foo", "bar"});
+    ispcrt::ModuleOptions opts{m_device};
+    opts.setEagerKernels(true);
+    ASSERT_TRUE(opts.eagerKernels());
+    ispcrt::Module m(m_device, "", opts);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelCreate"), 2);
+    // The kernel is created at load
+    ispcrt::Kernel k(m_device, m, "foo");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelCreate"), 2);
+}
+
 /////////////////////////////////////////////////////////////////////
 // Memory allocation tests
 TEST_F(MockTestWithDevice, ArrayObj) {
@@ -483,6 +758,66 @@ TEST_F(MockTest, ArrayObj_contextAlloc) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
+// Device memory views of accessible application memory are zero-copy on integrated GPUs
+TEST_F(MockTest, ArrayObj_ZeroCopyIntegrated) {
+    DeviceProperties dp(VendorId::Intel, DeviceId::Gen12);
+    dp.flags = ZE_DEVICE_PROPERTY_FLAG_INTEGRATED;
+    dp.sharedSystemAllocCapabilities = ZE_MEMORY_ACCESS_CAP_FLAG_RW;
+    Config::setDeviceProperties(0, dp);
+    ispcrt::Device device(ISPCRT_DEVICE_TYPE_GPU);
+    ispcrt::TaskQueue tq(device);
+    alignas(64) static float buf[1024];
+    ispcrt::Array<float> buf_dev(device, buf, 1024);
+    ASSERT_EQ(buf_dev.devicePtr(), buf);
+    tq.copyToDevice(buf_dev);
+    tq.copyToHost(buf_dev);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 0);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 0);
+    // Unaligned memory is copied
+    ispcrt::Array<float> unaligned_dev(device, buf + 1, 1023);
+    tq.copyToDevice(unaligned_dev);
+    ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 1);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTest, ArrayObj_NoZeroCopyDiscrete) {
+    ispcrt::Device device(ISPCRT_DEVICE_TYPE_GPU);
+    ispcrt::TaskQueue tq(device);
+    alignas(64) static float buf[1024];
+    ispcrt::Array<float> buf_dev(device, buf, 1024);
+    tq.copyToDevice(buf_dev);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 1);
+}
+
+TEST_F(MockTest, ArrayObj_DeviceMemPool) {
+    setenv("ISPCRT_DEVICE_MEM_POOL", "1", 1);
+    {
+        ispcrt::Device device(ISPCRT_DEVICE_TYPE_GPU);
+        ispcrt::TaskQueue tq(device);
+        std::vector<float> buf(1000);
+        {
+            ispcrt::Array<float> buf_dev(device, buf);
+            tq.copyToDevice(buf_dev);
+        }
+        // The queue may still use the released memory
+        ispcrt::Array<float> other_dev(device, buf);
+        other_dev.devicePtr();
+        ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 2);
+        tq.sync();
+        // Both blocks are in the same size class
+        ispcrt::Array<float> smaller_dev(device, buf.data(), 900);
+        smaller_dev.devicePtr();
+        ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 2);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    }
+    unsetenv("ISPCRT_DEVICE_MEM_POOL");
+}
+
 /////////////////////////////////////////////////////////////////////
 // TaskQueue tests
 
@@ -703,6 +1038,44 @@ TEST_F(MockTestWithDevice, TaskQueue_CopyToHost_Events) {
     ASSERT_TRUE(Config::checkCmdList({}));
 }
 
+TEST_F(MockTestWithDevice, TaskQueue_CopyStaging) {
+    setenv("ISPCRT_STAGING_BUFFER_SIZE", "1", 1);
+    ispcrt::TaskQueue tq(m_device);
+    unsetenv("ISPCRT_STAGING_BUFFER_SIZE");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // 256 KB, so 4 copies fit into the staging buffer
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.copyToDevice(buf_dev);
+    tq.copyToHost(buf_dev);
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), 1);
+    ASSERT_EQ(CallCounters::get("zeMemGetAllocProperties"), 2);
+    // The buffer is full, so the last copy is direct
+    for (int i = 0; i < 3; i++)
+        tq.copyToDevice(buf_dev);
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 5);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The buffer is reused after sync
+    tq.copyToDevice(buf_dev);
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), 1);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
+TEST_F(MockTestWithDevice, TaskQueue_CopyNoStaging) {
+    ispcrt::TaskQueue tq(m_device);
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    tq.copyToDevice(buf_dev);
+    tq.copyToHost(buf_dev);
+    ASSERT_EQ(CallCounters::get("zeMemAllocHost"), 0);
+    ASSERT_EQ(CallCounters::get("zeMemGetAllocProperties"), 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+}
+
 // Normal kernel launch (plus a few memory transfers) - but no waiting on future
 TEST_F(MockTestWithModuleQueueKernel, TaskQueue_FullKernelLaunchNoFuture) {
     auto tq = m_task_queue;
@@ -748,6 +1121,129 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_FullKernelLaunch) {
     ASSERT_TRUE(f.valid());
 }
 
+// Kernel arguments passed by value are set to the kernel one by one
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchWithArgs) {
+    auto tq = m_task_queue;
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    float *ptr = buf_dev.devicePtr();
+    int32_t n = 42;
+    double scale = 0.5;
+    auto f = tq.launchWithArgs(m_kernel, 16, 1, 1, ptr, n, scale);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
+    ASSERT_EQ(CallCounters::get("zeKernelSetArgumentValue"), 3);
+    auto &args = Config::getKernelArgs();
+    ASSERT_EQ(args.size(), 3u);
+    ASSERT_EQ(args[0].size(), sizeof(ptr));
+    ASSERT_EQ(memcmp(args[0].data(), &ptr, sizeof(ptr)), 0);
+    ASSERT_EQ(args[1].size(), sizeof(n));
+    ASSERT_EQ(memcmp(args[1].data(), &n, sizeof(n)), 0);
+    ASSERT_EQ(args[2].size(), sizeof(scale));
+    ASSERT_EQ(memcmp(args[2].data(), &scale, sizeof(scale)), 0);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(f.valid());
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_TypedKernelLaunch) {
+    // The signature as declared in the header generated by ispc
+    typedef void scale(float *a, int32_t n, double s);
+    ispcrt::TypedKernel<scale> k(m_device, m_module, "");
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    std::vector<float> buf(1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    float *ptr = buf_dev.devicePtr();
+    // The arguments are converted to the parameter types
+    auto f = k.launch(m_task_queue, {16, 1, 1}, ptr, (int16_t)42, 0.5f);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
+    auto &args = Config::getKernelArgs();
+    ASSERT_EQ(args.size(), 3u);
+    ASSERT_EQ(args[1].size(), sizeof(int32_t));
+    ASSERT_EQ(*(const int32_t *)args[1].data(), 42);
+    ASSERT_EQ(args[2].size(), sizeof(double));
+    ASSERT_EQ(*(const double *)args[2].data(), 0.5);
+    m_task_queue.sync();
+    ASSERT_TRUE(f.valid());
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchWithArgs_Invalid) {
+    ISPCRTKernelArg arg = {nullptr, 4};
+    ispcrtLaunchWithArgs1D(m_task_queue.handle(), m_kernel.handle(), 1, &arg, 16);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtLaunchWithArgs1D(m_task_queue.handle(), m_kernel.handle(), 1, nullptr, 16);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ASSERT_EQ(CallCounters::get("zeKernelSetArgumentValue"), 0);
+    ASSERT_TRUE(Config::checkCmdList({}));
+}
+
+// Slices of the view are copied by separate commands interleaved with launches
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchCopyRanges) {
+    auto tq = m_task_queue;
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    const size_t slice = buf.size() / 2;
+    for (size_t i = 0; i < 2; i++) {
+        tq.copyToDevice(buf_dev, i * slice, slice);
+        tq.launch(m_kernel, 0);
+        tq.copyToHost(buf_dev, i * slice, slice);
+    }
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 4);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::MemoryCopy, CmdListElem::KernelLaunch, CmdListElem::MemoryCopy,
+                                      CmdListElem::MemoryCopy, CmdListElem::KernelLaunch, CmdListElem::MemoryCopy}));
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({}));
+}
+
+TEST_F(MockTestWithDevice, TaskQueue_CopyRange_Invalid) {
+    ispcrt::TaskQueue tq(m_device);
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    tq.copyToDevice(buf_dev, buf.size() - 1, 2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    tq.copyToHost(buf_dev, buf.size() + 1, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 0);
+    ASSERT_TRUE(Config::checkCmdList({}));
+}
+
+TEST_F(MockTestWithDevice, TaskQueue_CopySlices) {
+    ispcrt::TaskQueue tq(m_device);
+    std::vector<float> buf(64 * 1024);
+    ispcrt::Array<float> buf_dev(m_device, buf);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    const size_t slice = buf.size() / 4;
+    {
+        auto first = buf_dev.slice(slice, 2 * slice);
+        auto second = first.slice(slice, slice);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(ispcrtUseCount(buf_dev.handle()), 3);
+        ASSERT_EQ(first.size(), 2 * slice);
+        ASSERT_EQ(second.size(), slice);
+        ASSERT_EQ(first.hostPtr(), buf.data() + slice);
+        ASSERT_EQ(second.devicePtr(), buf_dev.devicePtr() + 2 * slice);
+        // No memory is allocated for the slices
+        ASSERT_EQ(CallCounters::get("zeMemAllocDevice"), 1);
+        tq.copyToDevice(first);
+        tq.copyToHost(second);
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+        ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 2);
+        tq.sync();
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    }
+    ASSERT_EQ(ispcrtUseCount(buf_dev.handle()), 1);
+    buf_dev.slice(buf.size() - 1, 2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+}
+
 // Try to submit a lot of kernel launches
 TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultipleKernelLaunchesBasic) { testMultipleKernelLaunches(1000); }
 
@@ -759,17 +1255,61 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultipleKernelLaunchesAdvanced)
     }
 }
 
-// Test the limit of number of launches
-TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultipleKernelLaunchesLimit) {
-    constexpr unsigned LIMIT = 100000;
-    // OK to add LIMIT kernel launches
-    testMultipleKernelLaunches(LIMIT);
-    // But not OK to add more
-    testMultipleKernelLaunches(LIMIT + 1, true, LIMIT);
-    ResetError();
-    Config::resetCmdList();
-    // Double check that we still can enqueue correct amount of events;
-    testMultipleKernelLaunches(LIMIT);
+// Without ISPCRT_MAX_KERNEL_LAUNCHES the event pool grows as needed
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultipleKernelLaunchesNoLimit) {
+    auto poolCnt = CallCounters::get("zeEventPoolCreate");
+    testMultipleKernelLaunches(100001);
+    // 98 blocks of 1024 compute events and 1 block of copy ones
+    ASSERT_EQ(CallCounters::get("zeEventPoolCreate"), poolCnt + 99);
+}
+
+// Completed events are reset and reused by the following launches
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultipleKernelLaunchesReuseEvents) {
+    ispcrt::TaskQueue tq(m_device);
+    for (int i = 0; i < 3; i++) {
+        tq.launch(m_kernel, 0);
+        tq.sync();
+        ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    }
+    ASSERT_EQ(CallCounters::get("zeEventCreate"), 1);
+    ASSERT_EQ(CallCounters::get("zeEventHostReset"), 3);
+}
+
+// Several threads can enqueue into the same task queue
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_ConcurrentKernelLaunches) {
+    ispcrt::TaskQueue tq(m_device);
+    constexpr int threadsCnt = 4;
+    constexpr int launchesCnt = 100;
+    std::vector<std::vector<ispcrt::Future>> futures(threadsCnt);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsCnt; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < launchesCnt; i++) {
+                futures[t].push_back(tq.launch(m_kernel, 0));
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    for (auto &tf : futures) {
+        ASSERT_EQ(tf.size(), static_cast<size_t>(launchesCnt));
+        for (auto &f : tf) {
+            ASSERT_TRUE(f.valid());
+        }
+    }
+}
+
+// Check the size of the blocks the event pool grows with
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_EventPoolSize) {
+    auto poolCnt = CallCounters::get("zeEventPoolCreate");
+    setenv("ISPCRT_EVENT_POOL_SIZE", "10", 1);
+    testMultipleKernelLaunches(100);
+    unsetenv("ISPCRT_EVENT_POOL_SIZE");
+    // 10 blocks for compute events and 1 for copy ones
+    ASSERT_EQ(CallCounters::get("zeEventPoolCreate"), poolCnt + 11);
 }
 
 // Check if setting the expected maximum of kernel launches with env var works
@@ -874,6 +1414,73 @@ TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchGroupSize) {
     ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch}));
 }
 
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchGroupSizeCached) {
+    m_task_queue.launch(m_kernel, 8);
+    m_task_queue.launch(m_kernel, 8);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelSuggestGroupSize"), 1);
+    ASSERT_EQ(CallCounters::get("zeKernelSetGroupSize"), 1);
+    // Suggested group size is the same for the new dimensions, so it is not set again
+    m_task_queue.launch(m_kernel, 16);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelSuggestGroupSize"), 2);
+    ASSERT_EQ(CallCounters::get("zeKernelSetGroupSize"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), 3);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_KernelLaunchPinnedGroupSize) {
+    m_kernel.setGroupSize(4);
+    m_task_queue.launch(m_kernel, 8);
+    m_task_queue.launch(m_kernel, 16);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelSuggestGroupSize"), 0);
+    ASSERT_EQ(CallCounters::get("zeKernelSetGroupSize"), 1);
+    // Back to the suggested group size
+    m_kernel.setGroupSize(0);
+    m_task_queue.launch(m_kernel, 8);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeKernelSuggestGroupSize"), 1);
+    ASSERT_EQ(CallCounters::get("zeKernelSetGroupSize"), 2);
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Immediate) {
+    ispcrt::TaskQueue tq(m_device, ISPCRT_TASK_QUEUE_IMMEDIATE);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandListCreateImmediate"), 1);
+    auto f = tq.launch(m_kernel, 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), 1);
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Immediate command list is neither closed, executed nor reset
+    ASSERT_EQ(CallCounters::get("zeCommandListClose"), 0);
+    ASSERT_EQ(CallCounters::get("zeCommandQueueExecuteCommandLists"), 0);
+    ASSERT_EQ(CallCounters::get("zeCommandListReset"), 0);
+    ASSERT_EQ(CallCounters::get("zeEventHostSynchronize"), 1);
+    ASSERT_TRUE(f.valid());
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_MultiEngine) {
+    // The mock device has a single compute engine, so the queue behaves as
+    // a batched one with the barrier appended to the command list.
+    ispcrt::TaskQueue tq(m_device, ISPCRT_TASK_QUEUE_MULTI_ENGINE);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    auto f = tq.launch(m_kernel, 0);
+    tq.barrier();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::KernelLaunch, CmdListElem::Barrier}));
+    tq.sync();
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandQueueSynchronize"), 1);
+    ASSERT_TRUE(f.valid());
+}
+
+TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Immediate_zeCommandListCreateImmediate) {
+    Config::setRetValue("zeCommandListCreateImmediate", ZE_RESULT_ERROR_DEVICE_LOST);
+    ispcrt::TaskQueue tq(m_device, ISPCRT_TASK_QUEUE_IMMEDIATE);
+    ASSERT_EQ(sm_rt_error, ISPCRT_DEVICE_LOST);
+}
+
 TEST_F(MockTestWithModuleQueueKernel, TaskQueue_Sync_zeCommandQueueSynchronize) {
     auto tq = m_task_queue;
     auto f = tq.launch(m_kernel, 0);
@@ -953,6 +1560,18 @@ TEST_F(MockTest, C_API_DeviceInfoCPU) {
     ASSERT_EQ(0, di.vendorId);
 }
 
+TEST_F(MockTest, C_API_CpuTopology) {
+    ISPCRTCpuTopology topo;
+    ispcrtGetCpuTopology(&topo);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_GE(topo.numThreads, 1);
+    ASSERT_LE(topo.numCores, topo.numThreads);
+    ASSERT_LE(topo.numAvailableThreads, topo.numThreads);
+    ASSERT_GE(topo.taskCount, topo.numAvailableThreads);
+    ASSERT_NE(topo.isa, nullptr);
+    ASSERT_NE(topo.targets, nullptr);
+}
+
 TEST_F(MockTest, C_API_DeviceInfoGPU) {
     std::vector<DeviceProperties> dps = {
         DeviceProperties(VendorId::Intel, DeviceId::Gen9), DeviceProperties(VendorId::Nvidia, DeviceId::GenericNvidia),
@@ -992,7 +1611,7 @@ TEST_F(MockTest, C_API_CreateDeviceFromContext) {
 TEST_F(MockTest, C_API_AllocateSharedMemoryForGPU) {
     ISPCRTContext context = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
     std::vector<uint8_t> buffer;
-    ISPCRTNewMemoryViewFlags mem_flags;
+    ISPCRTNewMemoryViewFlags mem_flags = {};
     mem_flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
     mem_flags.smHint = ISPCRT_SM_HOST_WRITE_DEVICE_READ;
     ISPCRTMemoryView mem = ispcrtNewMemoryViewForContext(context, buffer.data(), buffer.size(), &mem_flags);
@@ -1004,7 +1623,7 @@ TEST_F(MockTest, C_API_AllocateSharedMemoryForGPU) {
 TEST_F(MockTest, C_API_AllocateSharedMemoryForCPU) {
     ISPCRTContext context = ispcrtNewContext(ISPCRT_DEVICE_TYPE_CPU);
     std::vector<uint8_t> buffer;
-    ISPCRTNewMemoryViewFlags mem_flags;
+    ISPCRTNewMemoryViewFlags mem_flags = {};
     mem_flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
     mem_flags.smHint = ISPCRT_SM_HOST_WRITE_DEVICE_READ;
     ISPCRTMemoryView mem = ispcrtNewMemoryViewForContext(context, buffer.data(), buffer.size(), &mem_flags);
@@ -1013,10 +1632,128 @@ TEST_F(MockTest, C_API_AllocateSharedMemoryForCPU) {
     ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
 }
 
+TEST_F(MockTest, C_API_MemoryPlacementForCPU) {
+    ISPCRTDevice device = ispcrtGetDevice(ISPCRT_DEVICE_TYPE_CPU, 0);
+    ISPCRTNewMemoryViewFlags mem_flags = {};
+    mem_flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
+    ISPCRTMemoryPlacement placement = {};
+    placement.flags = ISPCRT_MEM_HUGE_PAGES_2MB | ISPCRT_MEM_NUMA_INTERLEAVE | ISPCRT_MEM_PREFAULT;
+    ISPCRTMemoryView mem = ispcrtNewMemoryViewWithPlacement(device, nullptr, 3 << 20, &mem_flags, &placement);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    auto data = (uint8_t *)ispcrtSharedPtr(mem);
+    ASSERT_NE(data, nullptr);
+    data[0] = data[(3 << 20) - 1] = 1;
+    ispcrtRelease(mem);
+    // Mutually exclusive flags
+    placement.flags = ISPCRT_MEM_NUMA_BIND | ISPCRT_MEM_NUMA_INTERLEAVE;
+    mem = ispcrtNewMemoryViewWithPlacement(device, nullptr, 64, &mem_flags, &placement);
+    ASSERT_EQ(mem, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtRelease(device);
+}
+
+TEST_F(MockTest, C_API_CpuSubDevice) {
+    uint32_t cores[] = {0};
+    ISPCRTCpuDeviceOptions options = {ISPCRT_CPU_AFFINITY_EXPLICIT, cores, 1, -1};
+    ISPCRTDevice device = ispcrtNewCpuSubDevice(&options);
+    if (sm_rt_error == ISPCRT_UNSUPPORTED) {
+        ResetError();
+        GTEST_SKIP() << "CPU sub-devices are not supported by the tasking model";
+    }
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(ispcrtGetDeviceType(device), ISPCRT_DEVICE_TYPE_CPU);
+    ISPCRTTaskQueue queue = ispcrtNewTaskQueue(device);
+    ISPCRTNewMemoryViewFlags mem_flags = {};
+    mem_flags.allocType = ISPCRT_ALLOC_TYPE_SHARED;
+    ISPCRTMemoryView mem = ispcrtNewMemoryView(device, nullptr, 64, &mem_flags);
+    ASSERT_NE(ispcrtSharedPtr(mem), nullptr);
+    ispcrtSync(queue);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The queue and the memory may outlive the device.
+    ispcrtRelease(device);
+    ispcrtRelease(mem);
+    ispcrtRelease(queue);
+    // Explicit affinity needs the cores
+    options.numCores = 0;
+    device = ispcrtNewCpuSubDevice(&options);
+    ASSERT_EQ(device, nullptr);
+    ASSERT_NE(sm_rt_error, ISPCRT_NO_ERROR);
+    ResetError();
+}
+
+TEST_F(MockTest, C_API_ContextTaskingCallbacksAndPriority) {
+    ISPCRTContext context = ispcrtNewContext(ISPCRT_DEVICE_TYPE_CPU);
+    ISPCRTTaskingCallbacks callbacks = {};
+    // All of the callbacks are required
+    ispcrtContextSetTaskingCallbacks(context, &callbacks);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtContextSetTaskingCallbacks(context, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ISPCRTDevice device = ispcrtGetDeviceFromContext(context, 0);
+    ISPCRTTaskQueue queue = ispcrtNewTaskQueue(device);
+    ispcrtSetLaunchPriority(queue, ISPCRT_TASK_PRIORITY_HIGH);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ispcrtSetLaunchPriority(queue, (ISPCRTTaskPriority)42);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ASSERT_EQ(ispcrtGetCurrentTaskPriority(), ISPCRT_TASK_PRIORITY_NORMAL);
+    ispcrtRelease(queue);
+    ispcrtRelease(device);
+    ispcrtRelease(context);
+    // The executors are for CPU contexts only
+    context = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
+    ispcrtContextSetTaskingCallbacks(context, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    ispcrtRelease(context);
+}
+
+static void PipelineStageOrder(uint64_t item, uint32_t, void *userData) {
+    ((std::vector<uint64_t> *)userData)->push_back(item);
+}
+
+TEST_F(MockTest, C_API_Pipeline) {
+    ISPCRTDevice device = ispcrtGetDevice(ISPCRT_DEVICE_TYPE_GPU, 0);
+    ISPCRTPipeline pipeline = ispcrtNewPipeline(device, 2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ISPCRTNewMemoryViewFlags mem_flags = {};
+    mem_flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
+    uint32_t buffer = ispcrtPipelineAddBuffer(pipeline, 64, &mem_flags);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // Every slot has a buffer of its own
+    ASSERT_NE(ispcrtPipelineGetBuffer(pipeline, buffer, 0), ispcrtPipelineGetBuffer(pipeline, buffer, 1));
+    std::vector<uint64_t> input, output;
+    ispcrtPipelineAddHostStage(pipeline, PipelineStageOrder, &input);
+    ispcrtPipelineAddCopyToDeviceStage(pipeline, buffer);
+    ispcrtPipelineAddCopyToHostStage(pipeline, buffer);
+    ispcrtPipelineAddHostStage(pipeline, PipelineStageOrder, &output);
+    for (uint64_t i = 0; i < 10; i++)
+        ASSERT_EQ(ispcrtPipelineSubmit(pipeline), i);
+    ispcrtPipelineSync(pipeline);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The host stages see the items in order
+    std::vector<uint64_t> expected(10);
+    std::iota(expected.begin(), expected.end(), 0);
+    ASSERT_EQ(input, expected);
+    ASSERT_EQ(output, expected);
+    // The stages are fixed once the pipeline runs
+    ispcrtPipelineAddCopyToHostStage(pipeline, buffer);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+    ispcrtRelease(pipeline);
+    // At least one slot is needed
+    ASSERT_EQ(ispcrtNewPipeline(device, 0), nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtRelease(device);
+}
+
 TEST_F(MockTest, C_API_AllocateDeviceMemory) {
     ISPCRTContext context = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
     std::vector<uint8_t> buffer;
-    ISPCRTNewMemoryViewFlags mem_flags;
+    ISPCRTNewMemoryViewFlags mem_flags = {};
     mem_flags.allocType = ISPCRT_ALLOC_TYPE_DEVICE;
     mem_flags.smHint = ISPCRT_SM_HOST_WRITE_DEVICE_READ;
     ISPCRTMemoryView mem = ispcrtNewMemoryViewForContext(context, buffer.data(), buffer.size(), &mem_flags);
@@ -1480,8 +2217,10 @@ TEST_F(MockTest, C_API_ispcrtCommandQueueCreateCommandList) {
     ISPCRTCommandList l = ispcrtCommandQueueCreateCommandList(q);
     ASSERT_EQ(CallCounters::get("zeCommandListCreate"), 1);
     ispcrtRelease(l);
-    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
+    // The queue keeps the list for reuse
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 0);
     ispcrtRelease(q);
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
     ispcrtRelease(dev);
     ispcrtRelease(ctx);
 }
@@ -1503,8 +2242,62 @@ TEST_F(MockTest, C_API_ispcrtCommandListBarrierCloseSubmitReset) {
     ispcrtCommandListReset(l);
     ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
     ispcrtRelease(l);
+    // The queue keeps the list for reuse
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 0);
+    ispcrtRelease(q);
     ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
+    ispcrtRelease(dev);
+    ispcrtRelease(ctx);
+}
+
+TEST_F(MockTest, C_API_ispcrtCommandListResubmitUpdateLaunch) {
+    ISPCRTContext ctx = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
+    ISPCRTDevice dev = ispcrtGetDeviceFromContext(ctx, 0);
+    ISPCRTModule m = ispcrtLoadModule(dev, "");
+    ISPCRTKernel k = ispcrtNewKernel(dev, m, "");
+    ISPCRTNewMemoryViewFlags flags = {ISPCRT_ALLOC_TYPE_SHARED};
+    char mem[100] = {0};
+    ISPCRTMemoryView mem1 = ispcrtNewMemoryView(dev, &mem, 10, &flags);
+    ISPCRTMemoryView mem2 = ispcrtNewMemoryView(dev, &mem[50], 10, &flags);
+
+    ISPCRTCommandQueue q = ispcrtNewCommandQueue(dev, 0);
+    ISPCRTCommandList l = ispcrtCommandQueueCreateCommandList(q);
+    ISPCRTFuture f = ispcrtCommandListLaunch1D(l, k, mem1, 128);
+    ispcrtCommandListBarrier(l);
+    ISPCRTFuture c = ispcrtCommandListCopyToHost(l, mem1);
+    ispcrtCommandListClose(l);
+    // The closed list is submitted repeatedly without re-recording
+    ispcrtCommandListSubmit(l);
+    ispcrtCommandListSubmit(l);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandQueueExecuteCommandLists"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListClose"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListReset"), 0);
+    // Updated launch rebuilds the list at the next submission only
+    ispcrtCommandListUpdateLaunch(l, f, mem2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandListReset"), 0);
+    ispcrtCommandListSubmit(l);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeFenceHostSynchronize"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendLaunchKernel"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendBarrier"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryCopy"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandListClose"), 2);
+    ASSERT_EQ(CallCounters::get("zeCommandQueueExecuteCommandLists"), 3);
+    // Only launches can be updated
+    ispcrtCommandListUpdateLaunch(l, c, mem2);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_OPERATION);
+    ResetError();
+
+    ispcrtRelease(l);
     ispcrtRelease(q);
+    ispcrtRelease(mem2);
+    ispcrtRelease(mem1);
+    ispcrtRelease(k);
+    ispcrtRelease(m);
     ispcrtRelease(dev);
     ispcrtRelease(ctx);
 }
@@ -1545,8 +2338,10 @@ TEST_F(MockTest, C_API_ispcrtCommandListCopyLaunchSyncQueue) {
     ispcrtCommandListReset(l);
     ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
     ispcrtRelease(l);
-    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
+    // The queue keeps the list for reuse
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 0);
     ispcrtRelease(q);
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
     ispcrtRelease(mem3);
     ispcrtRelease(mem2);
     ispcrtRelease(mem1);
@@ -1599,8 +2394,10 @@ TEST_F(MockTest, C_API_ispcrtCommandListCopyLaunchFence) {
     ispcrtCommandListReset(l);
     ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
     ispcrtRelease(l);
-    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
+    // The queue keeps the list for reuse
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 0);
     ispcrtRelease(q);
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 1);
     ispcrtRelease(mem3);
     ispcrtRelease(mem2);
     ispcrtRelease(mem1);
@@ -1610,6 +2407,95 @@ TEST_F(MockTest, C_API_ispcrtCommandListCopyLaunchFence) {
     ispcrtRelease(ctx);
 }
 
+TEST_F(MockTest, C_API_ispcrtCommandListFenceReuse) {
+    ISPCRTContext ctx = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
+    ISPCRTDevice dev = ispcrtGetDeviceFromContext(ctx, 0);
+    ISPCRTCommandQueue q = ispcrtNewCommandQueue(dev, 0);
+    ISPCRTCommandList l = ispcrtCommandQueueCreateCommandList(q);
+    ispcrtCommandListBarrier(l);
+    ispcrtCommandListClose(l);
+    ISPCRTFence f1 = ispcrtCommandListSubmit(l);
+    ispcrtFenceSync(f1);
+    // The signaled fence is reused by the next submission
+    ISPCRTFence f2 = ispcrtCommandListSubmit(l);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(f1, f2);
+    ASSERT_EQ(CallCounters::get("zeFenceCreate"), 1);
+    ASSERT_EQ(CallCounters::get("zeFenceReset"), 1);
+    // The retained fence is not
+    ispcrtRetain(f2);
+    ispcrtFenceSync(f2);
+    ISPCRTFence f3 = ispcrtCommandListSubmit(l);
+    ASSERT_NE(f2, f3);
+    ASSERT_EQ(CallCounters::get("zeFenceCreate"), 2);
+    ispcrtRelease(f2);
+    ispcrtFenceSync(f3);
+
+    // The released list is reset and handed out again
+    ispcrtRelease(l);
+    ISPCRTCommandList l2 = ispcrtCommandQueueCreateCommandList(q);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(l, l2);
+    ASSERT_EQ(CallCounters::get("zeCommandListCreate"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
+    // The list in use is not
+    ISPCRTCommandList l3 = ispcrtCommandQueueCreateCommandList(q);
+    ASSERT_NE(l2, l3);
+    ASSERT_EQ(CallCounters::get("zeCommandListCreate"), 2);
+    ispcrtRelease(l3);
+    ispcrtRelease(l2);
+    ispcrtRelease(q);
+    ASSERT_EQ(CallCounters::get("zeCommandListDestroy"), 2);
+    ASSERT_EQ(CallCounters::get("zeFenceDestroy"), 2);
+    ispcrtRelease(dev);
+    ispcrtRelease(ctx);
+}
+
+TEST_F(MockTest, C_API_ispcrtFenceWaitAnyAll) {
+    ISPCRTContext ctx = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
+    ISPCRTDevice dev = ispcrtGetDeviceFromContext(ctx, 0);
+    ISPCRTCommandQueue q = ispcrtNewCommandQueue(dev, 0);
+    ISPCRTCommandList l = ispcrtCommandQueueCreateCommandList(q);
+    ispcrtCommandListBarrier(l);
+    ISPCRTFence f = ispcrtCommandListSubmit(l);
+    ASSERT_TRUE(ispcrtFenceWaitAll(&f, 1, UINT64_MAX));
+    ASSERT_EQ(CallCounters::get("zeFenceHostSynchronize"), 1);
+    ASSERT_EQ(ispcrtFenceWaitAny(&f, 1, 0), 0);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(ispcrtFenceWaitAny(nullptr, 0, UINT64_MAX), -1);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtRelease(l);
+    ispcrtRelease(q);
+    ispcrtRelease(dev);
+    ispcrtRelease(ctx);
+}
+
+static void fenceCallback(ISPCRTFence, void *userData) { ((std::atomic<int> *)userData)->fetch_add(1); }
+
+TEST_F(MockTest, C_API_ispcrtFenceSetCallback) {
+    ISPCRTContext ctx = ispcrtNewContext(ISPCRT_DEVICE_TYPE_GPU);
+    ISPCRTDevice dev = ispcrtGetDeviceFromContext(ctx, 0);
+    ISPCRTCommandQueue q = ispcrtNewCommandQueue(dev, 0);
+    ISPCRTCommandList l = ispcrtCommandQueueCreateCommandList(q);
+    ispcrtCommandListBarrier(l);
+    ISPCRTFence f = ispcrtCommandListSubmit(l);
+    std::atomic<int> called{0};
+    ispcrtFenceSetCallback(f, fenceCallback, &called);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The callback runs on the thread of the runtime once the fence is signaled
+    for (int i = 0; i < 1000 && called.load() == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(called.load(), 1);
+    ispcrtFenceSetCallback(f, nullptr, nullptr);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    ispcrtRelease(l);
+    ispcrtRelease(q);
+    ispcrtRelease(dev);
+    ispcrtRelease(ctx);
+}
+
 /// C++ Command Queue/List/Fence API
 TEST_F(MockTest, CPP_API_NewCommandQueue) {
     auto ctx = Context(ISPCRT_DEVICE_TYPE_GPU);
@@ -1644,6 +2530,32 @@ TEST_F(MockTest, CPP_API_CommandListBarrierCloseSubmitReset) {
     ASSERT_EQ(CallCounters::get("zeCommandListReset"), 1);
 }
 
+TEST_F(MockTest, CPP_API_CommandListPrefetchMemAdvise) {
+    auto ctx = Context(ISPCRT_DEVICE_TYPE_GPU);
+    auto dev = Device(ctx);
+    auto q = CommandQueue(dev, 0);
+    auto l = q.createCommandList();
+    auto shared = Array<float, AllocType::Shared>(dev, 1024);
+    std::vector<float> buf(1024);
+    auto device = Array<float>(dev, buf);
+    l.memAdvise(shared, ISPCRT_MEM_ADVICE_SET_PREFERRED_LOCATION);
+    l.prefetch(shared);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    // The hints are ignored for the memory that is not shared
+    l.memAdvise(device, ISPCRT_MEM_ADVICE_SET_READ_MOSTLY);
+    l.prefetch(device);
+    ASSERT_EQ(sm_rt_error, ISPCRT_NO_ERROR);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemAdvise"), 1);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryPrefetch"), 1);
+    ASSERT_TRUE(Config::checkCmdList({CmdListElem::MemAdvise, CmdListElem::MemoryPrefetch}));
+    l.prefetch(shared, 1024 * sizeof(float) + 1);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ResetError();
+    l.memAdvise(shared, (ISPCRTMemAdvice)100);
+    ASSERT_EQ(sm_rt_error, ISPCRT_INVALID_ARGUMENT);
+    ASSERT_EQ(CallCounters::get("zeCommandListAppendMemoryPrefetch"), 1);
+}
+
 TEST_F(MockTest, CPP_API_CommandListCopyLaunchSyncQueue) {
     auto ctx = Context(ISPCRT_DEVICE_TYPE_GPU);
     auto dev = Device(ctx);
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Comparison of two runs of the benchmarks, e.g. of two ispc versions or two
+# BENCHMARKS_ISPC_FLAGS settings.  Every side is a Google Benchmark JSON file
+# (--benchmark_out) or a build directory configured with
+# -DISPC_INCLUDE_BENCHMARKS=ON, whose benchmarks are run first.  The speedup of
+# every benchmark is the ratio of the median times of the repetitions, its
+# confidence interval is estimated by bootstrap.  A benchmark has regressed if
+# the whole interval is below 1 - noise and the speedup is below
+# 1 - threshold; the script exits with 1 if any benchmark has regressed.
+# Benchmarks, whose coefficient of variation is above --max-cv, are reported as
+# noisy and don't fail the comparison.
+#
+#   scripts/bench_compare.py run build-base -o base.json --repetitions=10
+#   scripts/bench_compare.py compare base.json build-new --threshold=0.05
+
+import argparse
+import json
+import os
+import random
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+
+BENCHMARK_RE = re.compile(r"^\d\d_\w+(\.exe)?$")
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+BOOTSTRAP_SAMPLES = 1000
+
+
+def find_benchmarks(build_dir):
+    found = []
+    for root, _, files in os.walk(os.path.join(build_dir, "benchmarks")):
+        if "CMakeFiles" in root:
+            continue
+        for name in files:
+            path = os.path.join(root, name)
+            if BENCHMARK_RE.match(name) and os.access(path, os.X_OK):
+                found.append(path)
+    return sorted(found)
+
+
+# Run all benchmarks of the build directory and return the combined report.
+def run_benchmarks(build_dir, args):
+    benchmarks = find_benchmarks(build_dir)
+    if not benchmarks:
+        sys.exit("No benchmarks are found in %s" % build_dir)
+    report = {"context": {"build_dir": os.path.abspath(build_dir)}, "benchmarks": []}
+    with tempfile.TemporaryDirectory() as tmp:
+        for binary in benchmarks:
+            name = os.path.splitext(os.path.basename(binary))[0]
+            print("Running %s" % name, flush=True)
+            out_file = os.path.join(tmp, name + ".json")
+            cmd = [binary, "--benchmark_out=" + out_file, "--benchmark_out_format=json",
+                   "--benchmark_repetitions=%d" % args.repetitions, "--benchmark_min_time=%s" % args.min_time]
+            if args.filter:
+                cmd.append("--benchmark_filter=" + args.filter)
+            run = subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+            if run.returncode != 0 or not os.path.exists(out_file):
+                print("  failed with exit code %d" % run.returncode, flush=True)
+                continue
+            with open(out_file) as f:
+                single = json.load(f)
+            for bench in single["benchmarks"]:
+                bench["binary"] = name
+                report["benchmarks"].append(bench)
+            report["context"].setdefault("ispc_targets", single["context"].get("ispc_targets"))
+            report["context"].setdefault("ispc_flags", single["context"].get("ispc_flags"))
+    return report
+
+
+def load_side(path, args):
+    if os.path.isdir(path):
+        return run_benchmarks(path, args)
+    with open(path) as f:
+        return json.load(f)
+
+
+# Times of the repetitions of every benchmark in ns, the aggregates are skipped.
+def samples(report, field):
+    result = {}
+    for bench in report["benchmarks"]:
+        if bench.get("run_type", "iteration") != "iteration" or bench.get("error_occurred"):
+            continue
+        name = bench.get("run_name", bench["name"])
+        if "binary" in bench:
+            name = bench["binary"] + ":" + name
+        scale = TIME_UNITS.get(bench.get("time_unit", "ns"), 1.0)
+        result.setdefault(name, []).append(bench[field] * scale)
+    return result
+
+
+def coefficient_of_variation(values):
+    if len(values) < 2:
+        return 0.0
+    return statistics.stdev(values) / statistics.mean(values)
+
+
+# Confidence interval of the ratio of the medians, estimated by bootstrap.
+def bootstrap_interval(base, new, confidence, rng):
+    ratios = []
+    for _ in range(BOOTSTRAP_SAMPLES):
+        b = statistics.median(rng.choices(base, k=len(base)))
+        n = statistics.median(rng.choices(new, k=len(new)))
+        ratios.append(b / n if n > 0 else float("inf"))
+    ratios.sort()
+    tail = (1.0 - confidence) / 2
+    return ratios[int(tail * (len(ratios) - 1))], ratios[int((1.0 - tail) * (len(ratios) - 1))]
+
+
+def compare(base, new, args):
+    rng = random.Random(0)
+    rows = []
+    for name in sorted(set(base) & set(new)):
+        b, n = base[name], new[name]
+        speedup = statistics.median(b) / statistics.median(n)
+        if len(b) > 1 and len(n) > 1:
+            low, high = bootstrap_interval(b, n, args.confidence, rng)
+        else:
+            # A single run: no interval, the speedup itself is used.
+            low, high = speedup, speedup
+        cv = max(coefficient_of_variation(b), coefficient_of_variation(n))
+        if cv > args.max_cv:
+            status = "noisy"
+        elif high < 1.0 - args.noise and speedup < 1.0 - args.threshold:
+            status = "regressed"
+        elif low > 1.0 + args.noise:
+            status = "improved"
+        else:
+            status = "same"
+        rows.append({
+            "name": name,
+            "base_ns": statistics.median(b),
+            "new_ns": statistics.median(n),
+            "speedup": speedup,
+            "ci_low": low,
+            "ci_high": high,
+            "cv": cv,
+            "repetitions": [len(b), len(n)],
+            "status": status,
+        })
+    return rows
+
+
+def print_table(rows, only_changes):
+    width = max([len(row["name"]) for row in rows] + [9])
+    print("%-*s %12s %12s %8s %17s %6s  %s" % (width, "Benchmark", "Base, ns", "New, ns", "Speedup", "CI", "CV",
+                                              "Status"))
+    for row in rows:
+        if only_changes and row["status"] == "same":
+            continue
+        print("%-*s %12.1f %12.1f %8.3f  [%6.3f, %6.3f] %5.1f%%  %s" %
+              (width, row["name"], row["base_ns"], row["new_ns"], row["speedup"], row["ci_low"], row["ci_high"],
+               row["cv"] * 100, row["status"]))
+
+
+def geomean(values):
+    values = [v for v in values if v > 0]
+    if not values:
+        return None
+    return statistics.geometric_mean(values)
+
+
+def add_run_args(parser):
+    parser.add_argument("--repetitions", type=int, default=10, help="repetitions of every benchmark")
+    parser.add_argument("--min-time", default="0.1", help="minimum time of every repetition in seconds")
+    parser.add_argument("--filter", help="regular expression of the benchmarks to run")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two runs of the ispc benchmarks")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    run_parser = commands.add_parser("run", help="run the benchmarks of a build directory")
+    run_parser.add_argument("build_dir", help="build directory configured with -DISPC_INCLUDE_BENCHMARKS=ON")
+    run_parser.add_argument("-o", "--output", required=True, help="output JSON file")
+    add_run_args(run_parser)
+
+    compare_parser = commands.add_parser("compare", help="compare two runs")
+    compare_parser.add_argument("base", help="JSON file or build directory of the baseline")
+    compare_parser.add_argument("new", help="JSON file or build directory to compare with the baseline")
+    compare_parser.add_argument("--field", default="real_time", choices=["real_time", "cpu_time"],
+                                help="time to compare")
+    compare_parser.add_argument("--threshold", type=float, default=0.05,
+                                help="a slowdown below it isn't a regression, 0.05 is 5%%")
+    compare_parser.add_argument("--noise", type=float, default=0.02,
+                                help="changes within it are treated as the same time, 0.02 is 2%%")
+    compare_parser.add_argument("--max-cv", type=float, default=0.1,
+                                help="benchmarks with a larger coefficient of variation are reported as noisy")
+    compare_parser.add_argument("--confidence", type=float, default=0.95, help="confidence level of the intervals")
+    compare_parser.add_argument("--changes-only", action="store_true", help="don't print the unchanged benchmarks")
+    compare_parser.add_argument("-o", "--output", help="write the comparison to a JSON file")
+    add_run_args(compare_parser)
+    args = parser.parse_args()
+
+    if args.command == "run":
+        report = run_benchmarks(args.build_dir, args)
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+        print("Written %d results to %s" % (len(report["benchmarks"]), args.output))
+        return 0
+
+    base = samples(load_side(args.base, args), args.field)
+    new = samples(load_side(args.new, args), args.field)
+    rows = compare(base, new, args)
+    if not rows:
+        print("No common benchmarks")
+        return 1
+
+    print_table(rows, args.changes_only)
+    counts = {status: sum(1 for row in rows if row["status"] == status)
+              for status in ("improved", "regressed", "same", "noisy")}
+    missing = sorted(set(base) ^ set(new))
+    print("\n%d benchmarks: %d improved, %d regressed, %d same, %d noisy; geomean speedup %.3f" %
+          (len(rows), counts["improved"], counts["regressed"], counts["same"], counts["noisy"],
+           geomean([row["speedup"] for row in rows])))
+    if missing:
+        print("%d benchmarks are present in one run only" % len(missing))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump({"results": rows, "missing": missing, "summary": counts}, f, indent=2)
+
+    failed = counts["regressed"] > 0
+    print("FAIL" if failed else "PASS")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
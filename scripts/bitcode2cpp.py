@@ -17,10 +17,15 @@ from tempfile import NamedTemporaryFile
 
 
 # Read input data and put it in the form of byte array in the source file.
-def write_data(src, outfile):
+def write_data(src, outfile, compress='none'):
     width = 16
     with open(src, 'rb') as file:
         data = file.read()
+        if compress == 'zstd':
+            # The frame stores the size of the original data, which is used
+            # by BitcodeLib to decompress it.
+            import zstandard
+            data = zstandard.ZstdCompressor(level=19, write_content_size=True).compress(data)
         for i in range(0, len(data), 1):
             outfile.write("0x%0.2X," % ord(data[i:i+1]))
             if i%width == (width-1):
@@ -51,7 +56,8 @@ parser.add_argument("output", help="Output file")
 parser.add_argument("--type", help="Type of processed file", choices=['dispatch', 'builtins-c', 'ispc-target', 'stdlib', 'header'], required=True)
 parser.add_argument("--runtime", help="Runtime", choices=['32', '64'], nargs='?', default='')
 parser.add_argument("--os", help="Target OS", choices=['windows', 'linux', 'macos', 'freebsd', 'android', 'ios', 'ps4', 'web', 'WINDOWS', 'UNIX', 'WEB'], default='')
-parser.add_argument("--arch", help="Target architecture", choices=['i686', 'x86_64', 'armv7', 'arm64', 'aarch64', 'wasm32', 'wasm64', 'xe64'], default='')
+parser.add_argument("--arch", help="Target architecture", choices=['i686', 'x86_64', 'armv7', 'arm64', 'aarch64', 'riscv64', 'wasm32', 'wasm64', 'xe64'], default='')
+parser.add_argument("--compress", help="Compression of the embedded bitcode", choices=['none', 'zstd'], default='none')
 
 args = parser.parse_known_args()
 src = args[0].src
@@ -96,7 +102,7 @@ else:
 
 target_arch = ""
 ispc_arch = ""
-if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "wasm32", "wasm64", "xe64"]:
+if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "riscv64", "wasm32", "wasm64", "xe64"]:
     target_arch = args[0].arch + "_"
     # Canoncalization of arch value for Arch enum in ISPC.
     if args[0].arch == "i686":
@@ -107,6 +113,8 @@ if args[0].arch in ["i686", "x86_64", "amd64", "armv7", "arm64", "aarch64", "was
         ispc_arch = "arm"
     elif args[0].arch == "arm64" or args[0].arch == "aarch64":
         ispc_arch = "aarch64"
+    elif args[0].arch == "riscv64":
+        ispc_arch = "riscv64"
     elif args[0].arch == "wasm32":
         ispc_arch = "wasm32"
     elif args[0].arch == "wasm64":
@@ -127,7 +135,7 @@ with NamedTemporaryFile(mode='w', dir=dirname(output), delete=False) as outfile:
 
     outfile.write("extern const unsigned char " + name + "[] = {\n")
 
-    length = write_data(src, outfile)
+    length = write_data(src, outfile, args[0].compress)
 
     outfile.write("0x00 };\n\n")
     outfile.write(f"int {name}_length = {length};\n")
@@ -148,6 +156,10 @@ with NamedTemporaryFile(mode='w', dir=dirname(output), delete=False) as outfile:
             arch = "x86" if args[0].runtime == "32" else "x86_64" if args[0].runtime == "64" else "error"
         elif "neon" in target:
             arch = "arm" if args[0].runtime == "32" else "aarch64" if args[0].runtime == "64" else "error"
+        elif "sve" in target:
+            arch = "aarch64" if args[0].runtime == "64" else "error"
+        elif "rvv" in target:
+            arch = "riscv64" if args[0].runtime == "64" else "error"
         elif "wasm" in target:
             arch = "wasm32" if args[0].runtime == "32" else "wasm64" if args[0].runtime == "64" else "error"
         elif ("gen9" in target) or ("xe" in target):
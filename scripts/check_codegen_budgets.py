@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Codegen quality checks: the kernels of tests/codegen-budgets are compiled for
+# every CPU target with --emit-asm and --opt-report-file, and the budgets
+# written in their "// BUDGET:" comments are checked for every function:
+#  - the operations of the optimization report (gather, scatter, masked_load,
+#    masked_store, blended_store, int_division, uint_float_conversion,
+#    variable_shift_right) are counted per function and must not exceed the
+#    budget;
+#  - spills and inner_loop_spills are the spill and reload instructions of the
+#    whole function and of its innermost loops in the assembly;
+#  - vector_bits is the minimum width of the widest vector register used by
+#    the function, the native width of the target by default;
+#  - the number of instructions in the assembly must be within --tolerance of
+#    the baseline file, which is written with --update.
+# The script exits with 1 if any budget is exceeded, so codegen performance
+# regressions fail like the functional ones.  It's run by the
+# check-codegen-budgets target of the ispc build.
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+KERNELS_DIR = os.path.join(ROOT, "tests", "codegen-budgets")
+DEFAULT_BASELINE = os.path.join(KERNELS_DIR, "baseline.json")
+X86_TARGETS = "sse4-i32x4,avx2-i32x8,avx512skx-x16"
+ARM_TARGETS = "neon-i32x4"
+
+# "// BUDGET: <function> <key>=<value> ..." or "// BUDGET(<targets>): ...".
+# The budgets are maximums, except vector_bits, which is a minimum.
+BUDGET_RE = re.compile(r"^//\s*BUDGET(?:\(([\w.,-]+)\))?:\s*(\w+)\s*(.*)$")
+REPORT_KINDS = {
+    "Gather": "gather",
+    "Scatter": "scatter",
+    "MaskedLoad": "masked_load",
+    "MaskedStore": "masked_store",
+    "BlendedStore": "blended_store",
+    "IntDivision": "int_division",
+    "UIntFloatConversion": "uint_float_conversion",
+    "VariableShiftRight": "variable_shift_right",
+}
+ASM_KEYS = ("spills", "inner_loop_spills", "vector_bits")
+
+VECTOR_REG_RE = re.compile(r"\b(?:%?([xyz])mm\d+|v\d+\.\d*[bhsd]|q\d+)\b")
+LOOP_DEPTH_RE = re.compile(r"Depth=(\d+)")
+SPILL_RE = re.compile(r"(?:Spill|Reload)\b")
+
+
+def host_targets():
+    if platform.machine().lower() in ("aarch64", "arm64"):
+        return ARM_TARGETS
+    return X86_TARGETS
+
+
+# Width of the vector registers of the target, like 256 for avx2-i32x8 and
+# 512 for avx512skx-x16.
+def native_vector_bits(target):
+    isa, _, width = target.partition("-")
+    if isa.startswith("sse") or isa.startswith("neon"):
+        return 128
+    if isa.startswith("avx512"):
+        lanes = int(re.search(r"x(\d+)$", width).group(1))
+        bits = 16 if "i16" in width else 8 if "i8" in width else 32
+        return min(512, max(128, lanes * bits))
+    return 256
+
+
+# Budgets of the kernel: {function: {key: value}} for the given target, the
+# target specific lines override the common ones.
+def read_budgets(path, target):
+    common, specific = {}, {}
+    with open(path) as f:
+        for line in f:
+            match = BUDGET_RE.match(line.strip())
+            if not match:
+                continue
+            targets, function, items = match.groups()
+            if targets and target not in targets.split(","):
+                continue
+            budgets = (specific if targets else common).setdefault(function, {})
+            for item in items.split():
+                key, _, value = item.partition("=")
+                budgets[key] = int(value)
+    for function, budgets in specific.items():
+        common.setdefault(function, {}).update(budgets)
+    return common
+
+
+# Counts of the operations of the optimization report per function:
+# {function: {kind: count}}.
+def read_opt_report(path):
+    counts = {}
+    if not os.path.exists(path):
+        return counts
+    entry = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line == "...":
+                kind = REPORT_KINDS.get(entry.get("Name"))
+                if kind and "Function" in entry:
+                    function = counts.setdefault(entry["Function"], {})
+                    function[kind] = function.get(kind, 0) + int(entry.get("Count", 1))
+                entry = {}
+                continue
+            key, sep, value = line.lstrip("- ").partition(":")
+            if sep:
+                entry[key.strip()] = value.strip().strip("'")
+    return counts
+
+
+def is_instruction(line):
+    return line and not line.endswith(":") and not line.startswith(".")
+
+
+# Statistics of every function of the assembly: the number of instructions,
+# the spills and reloads of the whole function and of its innermost loops and
+# the widest vector register.  The functions and the loop depth of the blocks
+# are taken from the comments that LLVM prints.
+def read_asm(path, comment_marker):
+    functions = {}
+    current = None
+    depth = 0
+    with open(path) as f:
+        for line in f:
+            code, _, comment = line.partition(comment_marker)
+            code = code.strip()
+            match = re.search(r"-- Begin function (\S+)", comment)
+            if match:
+                name = match.group(1)
+                if sys.platform == "darwin":
+                    name = name[1:]
+                current = functions.setdefault(name, {"instructions": 0, "spills": 0, "loop_spills": {},
+                                                      "max_depth": 0, "vector_bits": 0})
+                depth = 0
+                continue
+            if current is None:
+                continue
+            if "-- End function" in comment:
+                current = None
+                continue
+            # The loop comments of a block are printed at its label and on
+            # the following comment lines, the innermost loop is the last.
+            match = LOOP_DEPTH_RE.search(comment)
+            if code.endswith(":") or (not code and "%bb." in comment):
+                depth = int(match.group(1)) if match else 0
+            elif not code and match:
+                depth = int(match.group(1))
+            if match:
+                current["max_depth"] = max(current["max_depth"], depth)
+            if not is_instruction(code):
+                continue
+            current["instructions"] += 1
+            if SPILL_RE.search(comment):
+                current["spills"] += 1
+                current["loop_spills"][depth] = current["loop_spills"].get(depth, 0) + 1
+            for match in VECTOR_REG_RE.finditer(code):
+                bits = {"x": 128, "y": 256, "z": 512}.get(match.group(1), 128)
+                current["vector_bits"] = max(current["vector_bits"], bits)
+    for stats in functions.values():
+        depth = stats["max_depth"]
+        stats["inner_loop_spills"] = stats["loop_spills"].get(depth, 0) if depth > 0 else 0
+    return functions
+
+
+# The function and its variants, like "saxpy" and "saxpy___un_3C_unf_3E_...".
+def variants(names, function):
+    return sorted(name for name in names if name == function or name.startswith(function + "___"))
+
+
+def check_kernel(args, work_dir, kernel, target, baseline, measured):
+    src = os.path.join(args.kernels, kernel)
+    base = os.path.join(work_dir, "%s_%s" % (os.path.splitext(kernel)[0], target))
+    asm, report = base + ".s", base + ".yaml"
+    if os.path.exists(report):
+        os.remove(report)
+    cmd = [args.ispc, src, "--target=" + target, "--emit-asm", "-o", asm, "--opt-report-file=" + report] + \
+        args.flags.split()
+    run = subprocess.run(cmd, capture_output=True, text=True)
+    if run.returncode != 0:
+        return ["%s %s: compilation failed: %s" % (kernel, target, run.stderr.strip())]
+
+    failures = []
+    budgets = read_budgets(src, target)
+    asm_stats = read_asm(asm, "//" if target.startswith("neon") else "#")
+    report_counts = read_opt_report(report)
+    for function, budget in sorted(budgets.items()):
+        names = variants(asm_stats, function)
+        if not names:
+            failures.append("%s %s: function %s is not found in the assembly" % (kernel, target, function))
+            continue
+        budget.setdefault("vector_bits", native_vector_bits(target))
+        for name in names:
+            where = "%s %s %s" % (kernel, target, name)
+            stats = asm_stats[name]
+            counts = report_counts.get(name, {})
+            for key, limit in sorted(budget.items()):
+                if key == "vector_bits":
+                    if stats["vector_bits"] < limit:
+                        failures.append("%s: widest vector register is %d bits, expected %d" %
+                                        (where, stats["vector_bits"], limit))
+                elif key in ASM_KEYS:
+                    if stats[key] > limit:
+                        failures.append("%s: %d %s, budget %d" % (where, stats[key], key, limit))
+                elif key in REPORT_KINDS.values():
+                    if counts.get(key, 0) > limit:
+                        failures.append("%s: %d %s, budget %d" % (where, counts.get(key, 0), key, limit))
+                else:
+                    failures.append("%s: unknown budget %s" % (where, key))
+
+            key = "%s:%s:%s" % (kernel, target, name)
+            measured[key] = stats["instructions"]
+            expected = baseline.get(key)
+            if expected is not None and not args.update:
+                if abs(stats["instructions"] - expected) > args.tolerance * expected:
+                    failures.append("%s: %d instructions, baseline %d (tolerance %.0f%%)" %
+                                    (where, stats["instructions"], expected, args.tolerance * 100))
+            if args.verbose:
+                print("  %s: %d instructions, %d spills (%d in inner loop), %d bit vectors, %s" %
+                      (where, stats["instructions"], stats["spills"], stats["inner_loop_spills"],
+                       stats["vector_bits"], counts or "no reported operations"))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the codegen budgets of the representative kernels")
+    parser.add_argument("--ispc", default="ispc", help="ispc executable")
+    parser.add_argument("--targets", help="comma separated list of targets, the CPU targets of the host by default")
+    parser.add_argument("--flags", default="-O2 --woff", help="other ispc flags")
+    parser.add_argument("--kernels", default=KERNELS_DIR, help="directory of the kernels")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE, help="instruction counts baseline file")
+    parser.add_argument("--tolerance", type=float, default=0.1,
+                        help="allowed change of the number of instructions, 0.1 is 10%%")
+    parser.add_argument("--update", action="store_true", help="write the instruction counts to the baseline file")
+    parser.add_argument("--filter", help="substring of the names of the kernels to check")
+    parser.add_argument("-v", "--verbose", action="store_true", help="print the statistics of every function")
+    args = parser.parse_args()
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    elif not args.update:
+        print("No baseline %s, the instruction counts aren't checked" % args.baseline)
+
+    kernels = sorted(name for name in os.listdir(args.kernels)
+                     if name.endswith(".ispc") and (not args.filter or args.filter in name))
+    targets = (args.targets or host_targets()).split(",")
+    failures = []
+    measured = {}
+    with tempfile.TemporaryDirectory() as work_dir:
+        for kernel in kernels:
+            for target in targets:
+                print("%s (%s)" % (kernel, target), flush=True)
+                for failure in check_kernel(args, work_dir, kernel, target, baseline, measured):
+                    print("  FAIL " + failure, flush=True)
+                    failures.append(failure)
+
+    if args.update:
+        baseline.update(measured)
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Written %d instruction counts to %s" % (len(measured), args.baseline))
+
+    print("%d kernels, %d targets: %d failures" % (len(kernels), len(targets), len(failures)))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Compile time benchmark: a fixed corpus is compiled by ispc with --time-trace
+# and the wall time, the peak RSS of the ispc process and the per phase times
+# of the trace ("Total <phase>" events) are written to a JSON table for every
+# file.  The corpus consists of:
+#  - the kernels of examples/cpu with the flags of their CMakeLists.txt;
+#  - generated files with many calls of the standard library functions;
+#  - generated files with many template instantiations;
+#  - multi-target builds of some of the examples (x86 only).
+# It's run by the compile-bench target of the ispc build.
+
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+EXAMPLES_DIR = os.path.join(ROOT, "examples", "cpu")
+
+# examples/cpu kernels and their ispc flags.
+EXAMPLES = [
+    ("aobench/ao.ispc", []),
+    ("aobench_instrumented/ao_instrumented.ispc", ["--instrument"]),
+    ("deferred/kernels.ispc", ["--opt=fast-math"]),
+    ("gmres/matrix.ispc", []),
+    ("mandelbrot/mandelbrot.ispc", []),
+    ("mandelbrot_tasks/mandelbrot_tasks.ispc", []),
+    ("noise/noise.ispc", []),
+    ("options/options.ispc", []),
+    ("perfbench/perfbench.ispc", []),
+    ("rt/rt.ispc", []),
+    ("sgemm/SGEMM_kernels.ispc", []),
+    ("simple/simple.ispc", []),
+    ("sort/sort.ispc", []),
+    ("stencil/stencil.ispc", []),
+    ("volume_rendering/volume.ispc", []),
+]
+MULTI_TARGET_EXAMPLES = ["aobench/ao.ispc", "deferred/kernels.ispc", "rt/rt.ispc"]
+X86_MULTI_TARGETS = "sse4-i32x4,avx2-i32x8,avx512skx-x16"
+
+STDLIB_FUNCTION = """
+export void stdlib_heavy_{i}(uniform float a[], uniform float b[], uniform int n) {{
+    foreach (j = 0 ... n) {{
+        float x = a[j] + {i};
+        float y = sin(x) * cos(x) + tan(x) + asin(clamp(x, -1.f, 1.f)) + acos(clamp(x, -1.f, 1.f)) + atan(x) +
+                  atan2(x, 2.f) + exp(x) * log(abs(x) + 1.f) + pow(abs(x), 1.5f) + sqrt(abs(x)) +
+                  rsqrt(abs(x) + 1.f) + rcp(abs(x) + 2.f) + floor(x) + ceil(x) + round(x);
+        double d = x;
+        d = sin(d) + cos(d) + exp(d) + log(abs(d) + 1) + sqrt(abs(d));
+        y += (float)d;
+        y += reduce_add(x) + reduce_max(x) + broadcast(x, 0) + rotate(x, 1) + shuffle(x, programIndex ^ 1) +
+             exclusive_scan_add(x);
+        int ix = (int)x;
+        y += popcnt(ix) + count_leading_zeros(ix) + count_trailing_zeros(ix);
+        b[j] = y;
+    }}
+}}
+"""
+
+TEMPLATE_HEADER = """
+template <typename T, uniform int N> T poly(T x) {
+    T r = 0;
+    for (uniform int i = 0; i < N; i++)
+        r = r * x + (T)(i + 1);
+    return r;
+}
+
+template <typename T, uniform int N, uniform int M> T chain(T x) {
+    return poly<T, N>(x) * poly<T, M>(x) - poly<T, M>(x);
+}
+"""
+
+TEMPLATE_FUNCTION = """
+export void templates_{type}_{i}(uniform {type} a[], uniform int n) {{
+    foreach (j = 0 ... n) {{
+        a[j] = chain<{type}, {i}, {j}>(a[j]) + chain<{type}, {j}, {k}>(a[j]);
+    }}
+}}
+"""
+TEMPLATE_TYPES = ["float", "double", "int32", "int64", "int16", "int8"]
+
+
+def generate_corpus(work_dir, scale):
+    files = []
+    path = os.path.join(work_dir, "stdlib_heavy.ispc")
+    with open(path, "w") as f:
+        for i in range(16 * scale):
+            f.write(STDLIB_FUNCTION.format(i=i))
+    files.append(path)
+    path = os.path.join(work_dir, "templates.ispc")
+    with open(path, "w") as f:
+        f.write(TEMPLATE_HEADER)
+        for type_name in TEMPLATE_TYPES:
+            for i in range(1, 4 * scale + 1):
+                f.write(TEMPLATE_FUNCTION.format(type=type_name, i=i, j=i + 1, k=i + 2))
+    files.append(path)
+    return files
+
+
+def host_target():
+    if platform.machine().lower() in ("aarch64", "arm64"):
+        return "neon-i32x4"
+    return "avx2-i32x8"
+
+
+def corpus(work_dir, args):
+    target = args.target or host_target()
+    entries = []
+    for src, flags in EXAMPLES:
+        entries.append(("examples/cpu/" + src, "example", os.path.join(EXAMPLES_DIR, src), target, flags))
+    for path in generate_corpus(work_dir, args.scale):
+        name = os.path.splitext(os.path.basename(path))[0]
+        entries.append((name, "generated", path, target, []))
+    if host_target() != "neon-i32x4":
+        for src in MULTI_TARGET_EXAMPLES:
+            flags = dict(EXAMPLES)[src]
+            entries.append(("examples/cpu/" + src, "multi-target", os.path.join(EXAMPLES_DIR, src),
+                            args.multi_targets, flags))
+    return entries
+
+
+# Run ispc and return its exit code, the wall time in ms and the peak RSS in
+# KB (None if it's not available on the OS).
+def run_ispc(cmd):
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall_ms = (time.perf_counter() - start) * 1000
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        # ru_maxrss is in bytes on macOS and in kilobytes elsewhere.
+        rss_kb = usage.ru_maxrss // 1024 if sys.platform == "darwin" else usage.ru_maxrss
+        return proc.returncode, wall_ms, rss_kb
+    proc.wait()
+    wall_ms = (time.perf_counter() - start) * 1000
+    return proc.returncode, wall_ms, None
+
+
+# The "Total <phase>" events of the trace sum up all executions of the phase.
+def read_phases(trace_file):
+    with open(trace_file) as f:
+        trace = json.load(f)
+    phases = {}
+    for event in trace.get("traceEvents", []):
+        name = event.get("name", "")
+        if event.get("ph") == "X" and name.startswith("Total "):
+            phases[name[len("Total "):]] = event.get("dur", 0) / 1000.0
+    return phases
+
+
+def compile_entry(args, work_dir, index, entry):
+    name, kind, src, targets, flags = entry
+    obj = os.path.join(work_dir, "%d.o" % index)
+    cmd = [args.ispc, src, "-o", obj, "--target=" + targets, "-I", os.path.dirname(src), "--time-trace",
+           "--woff"] + args.flags.split() + flags
+    if sys.platform != "win32":
+        cmd.append("--pic")
+
+    runs = []
+    rss = []
+    for _ in range(args.repeat):
+        code, wall_ms, rss_kb = run_ispc(cmd)
+        if code != 0:
+            return "compilation failed with exit code %d" % code, None
+        if rss_kb is not None:
+            rss.append(rss_kb)
+        runs.append((wall_ms, read_phases(obj + ".json")))
+    # The phases of the run with the median wall time are reported.
+    runs.sort(key=lambda run: run[0])
+    walls = [run[0] for run in runs]
+    phases = runs[(len(runs) - 1) // 2][1]
+
+    return None, {
+        "name": name,
+        "kind": kind,
+        "targets": targets,
+        "flags": " ".join(args.flags.split() + flags),
+        "wall_ms": statistics.median_low(walls),
+        "wall_ms_min": min(walls),
+        "peak_rss_kb": max(rss) if rss else None,
+        "phases_ms": phases,
+    }
+
+
+def ispc_version(ispc):
+    out = subprocess.run([ispc, "--version"], capture_output=True, text=True).stdout
+    return out.strip().splitlines()[0] if out.strip() else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile time and memory benchmark of ispc")
+    parser.add_argument("--ispc", default="ispc", help="ispc executable")
+    parser.add_argument("-o", "--output", default="compile_bench.json", help="output JSON file")
+    parser.add_argument("--target", help="target of the single target builds, avx2-i32x8 or neon-i32x4 by default")
+    parser.add_argument("--multi-targets", default=X86_MULTI_TARGETS, help="targets of the multi-target builds")
+    parser.add_argument("--flags", default="-O2", help="other ispc flags")
+    parser.add_argument("--repeat", type=int, default=3, help="number of compilations of every file")
+    parser.add_argument("--scale", type=int, default=4, help="size of the generated files")
+    parser.add_argument("--filter", help="substring of the names of the files to compile")
+    args = parser.parse_args()
+
+    results = []
+    errors = []
+    with tempfile.TemporaryDirectory() as work_dir:
+        for index, entry in enumerate(corpus(work_dir, args)):
+            name, kind = entry[0], entry[1]
+            if args.filter and args.filter not in name:
+                continue
+            print("%s (%s)" % (name, kind), flush=True)
+            error, row = compile_entry(args, work_dir, index, entry)
+            if error:
+                print("  " + error, flush=True)
+                errors.append({"name": name, "kind": kind, "error": error})
+            else:
+                results.append(row)
+
+    with open(args.output, "w") as f:
+        json.dump({"ispc": ispc_version(args.ispc), "results": results, "errors": errors}, f, indent=2)
+    print("Written %d results to %s" % (len(results), args.output))
+    return 1 if errors or not results else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
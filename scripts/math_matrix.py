@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Speed and accuracy matrix of the standard library math functions: the
+# 06_math benchmark is built for every --math-lib and target in an ispc build
+# directory configured with -DISPC_INCLUDE_BENCHMARKS=ON, and the throughput
+# and the maximum error in ulp of every function are written to a single JSON
+# table.  The configurations that fail to build or to run (e.g. svml without
+# the library, or targets that the host CPU doesn't support) are recorded
+# with the error.
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+
+MATH_LIBS = ["default", "fast", "svml", "system"]
+DEFAULT_FLAGS = "-O3 --woff"
+OS_NAMES = {"Linux": "Linux", "Darwin": "macOS", "Windows": "Windows", "FreeBSD": "FreeBSD"}
+
+
+# The CPU targets of the host OS and architecture from "ispc --support-matrix".
+def supported_targets(ispc):
+    out = subprocess.run([ispc, "--support-matrix"], capture_output=True, text=True, check=True).stdout
+    rows = [[cell.strip() for cell in line.split("|")] for line in out.splitlines() if "|" in line]
+    column = rows[0].index(OS_NAMES[platform.system()])
+    arch = "aarch64" if platform.machine().lower() in ("aarch64", "arm64") else "x86-64"
+    return [row[0] for row in rows[1:] if arch in row[column].split(", ")]
+
+
+def cmake_cache(build_dir, name):
+    with open(os.path.join(build_dir, "CMakeCache.txt")) as cache:
+        for line in cache:
+            if line.startswith(name + ":"):
+                return line.split("=", 1)[1].rstrip("\n")
+    return None
+
+
+def configure(build_dir, target, flags):
+    subprocess.run(["cmake", build_dir, "-DBENCHMARKS_ISPC_TARGETS=" + target, "-DBENCHMARKS_ISPC_FLAGS=" + flags],
+                   check=True, stdout=subprocess.DEVNULL)
+
+
+def find_benchmark(build_dir):
+    for root, _, files in os.walk(os.path.join(build_dir, "benchmarks")):
+        for name in ("06_math", "06_math.exe"):
+            if name in files:
+                return os.path.join(root, name)
+    return None
+
+
+def run_config(args, target, math_lib):
+    flags = "%s --math-lib=%s" % (args.flags, math_lib)
+    configure(args.build_dir, target, flags)
+    build = subprocess.run(["cmake", "--build", args.build_dir, "--target", "06_math", "-j", str(os.cpu_count())],
+                           capture_output=True, text=True)
+    if build.returncode != 0:
+        return "build failed", []
+    binary = find_benchmark(args.build_dir)
+    if binary is None:
+        return "06_math is not found", []
+
+    with tempfile.TemporaryDirectory() as tmp:
+        out_file = os.path.join(tmp, "06_math.json")
+        cmd = [binary, "--benchmark_out=" + out_file, "--benchmark_out_format=json",
+               "--benchmark_min_time=%s" % args.min_time]
+        if args.filter:
+            cmd.append("--benchmark_filter=" + args.filter)
+        run = subprocess.run(cmd, capture_output=True, text=True)
+        if run.returncode != 0 or not os.path.exists(out_file):
+            return "run failed with exit code %d" % run.returncode, []
+        with open(out_file) as f:
+            report = json.load(f)
+
+    rows = []
+    for bench in report["benchmarks"]:
+        # The names are <function>_<type>/<count>.
+        name, _, count = bench["name"].partition("/")
+        function, _, elem_type = name.rpartition("_")
+        rows.append({
+            "function": function,
+            "type": elem_type,
+            "count": int(count) if count.isdigit() else count,
+            "target": target,
+            "math_lib": math_lib,
+            "items_per_second": bench.get("items_per_second"),
+            "max_ulp": bench.get("max_ulp"),
+            "cpu_time_ns": bench.get("cpu_time"),
+        })
+    return None, rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Speed vs. accuracy matrix of the stdlib math functions")
+    parser.add_argument("build_dir", help="ispc build directory configured with -DISPC_INCLUDE_BENCHMARKS=ON")
+    parser.add_argument("-o", "--output", default="math_matrix.json", help="output JSON file")
+    parser.add_argument("--targets", help="comma separated list of targets, all CPU targets of the host by default")
+    parser.add_argument("--math-libs", default=",".join(MATH_LIBS), help="comma separated list of math libraries")
+    parser.add_argument("--flags", default=DEFAULT_FLAGS, help="other ispc flags")
+    parser.add_argument("--filter", help="regular expression of the benchmarks to run, like 'exp|log'")
+    parser.add_argument("--min-time", default="0.1", help="minimum time of every benchmark in seconds")
+    parser.add_argument("--ispc", help="ispc executable, the one of the build directory by default")
+    args = parser.parse_args()
+
+    ispc = args.ispc or os.path.join(args.build_dir, "bin", "ispc")
+    targets = args.targets.split(",") if args.targets else supported_targets(ispc)
+
+    # The configuration of the build directory is restored at the end.
+    saved_targets = cmake_cache(args.build_dir, "BENCHMARKS_ISPC_TARGETS")
+    saved_flags = cmake_cache(args.build_dir, "BENCHMARKS_ISPC_FLAGS")
+
+    results = []
+    errors = []
+    try:
+        for target in targets:
+            for math_lib in args.math_libs.split(","):
+                print("%s, --math-lib=%s" % (target, math_lib), flush=True)
+                error, rows = run_config(args, target, math_lib)
+                if error:
+                    print("  " + error, flush=True)
+                    errors.append({"target": target, "math_lib": math_lib, "error": error})
+                results.extend(rows)
+    finally:
+        if saved_targets is not None and saved_flags is not None:
+            configure(args.build_dir, saved_targets, saved_flags)
+
+    with open(args.output, "w") as f:
+        json.dump({"results": results, "errors": errors}, f, indent=2)
+    print("Written %d results to %s" % (len(results), args.output))
+    return 1 if not results else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
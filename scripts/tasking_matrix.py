@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2024, Intel Corporation
+#
+#  SPDX-License-Identifier: BSD-3-Clause
+
+# Scalability matrix of the task systems: every 01_tasking_<task system>
+# benchmark of an ispc build directory configured with
+# -DISPC_INCLUDE_BENCHMARKS=ON is run for every number of threads, and the
+# launch throughput, imbalance, nested launch and sync latency results are
+# written to a single JSON table.  The number of threads is set with the
+# affinity mask of the process (Linux only), which limits the pthreads and TBB
+# task systems, and with OMP_NUM_THREADS for OpenMP.  The other task systems
+# (GCD, ConcRT) and the other OSes run with the default number of threads only.
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+BENCHMARK_RE = re.compile(r"^01_tasking_(\w+?)(\.exe)?$")
+# The task systems, which follow the affinity mask or OMP_NUM_THREADS.
+SWEEPABLE = ("pthreads", "omp", "tbb_task_group", "tbb_parallel_for")
+
+
+def find_benchmarks(build_dir):
+    found = {}
+    for root, _, files in os.walk(os.path.join(build_dir, "benchmarks")):
+        for name in files:
+            match = BENCHMARK_RE.match(name)
+            if match:
+                found[match.group(1)] = os.path.join(root, name)
+    return found
+
+
+def allowed_cpus():
+    if hasattr(os, "sched_getaffinity"):
+        return sorted(os.sched_getaffinity(0))
+    return None
+
+
+def default_thread_counts(cpus):
+    count = len(cpus)
+    counts = []
+    n = 1
+    while n < count:
+        counts.append(n)
+        n *= 2
+    counts.append(count)
+    return counts
+
+
+def run_config(args, task_system, binary, threads, cpus):
+    env = dict(os.environ)
+    cmd = [binary]
+    if threads is not None:
+        env["OMP_NUM_THREADS"] = str(threads)
+        cmd = ["taskset", "--cpu-list", ",".join(str(cpu) for cpu in cpus[:threads])] + cmd
+
+    with tempfile.TemporaryDirectory() as tmp:
+        out_file = os.path.join(tmp, "01_tasking.json")
+        cmd += ["--benchmark_out=" + out_file, "--benchmark_out_format=json",
+                "--benchmark_min_time=%s" % args.min_time]
+        if args.filter:
+            cmd.append("--benchmark_filter=" + args.filter)
+        run = subprocess.run(cmd, capture_output=True, text=True, env=env)
+        if run.returncode != 0 or not os.path.exists(out_file):
+            return "run failed with exit code %d" % run.returncode, []
+        with open(out_file) as f:
+            report = json.load(f)
+
+    rows = []
+    for bench in report["benchmarks"]:
+        # The names are <benchmark>/<arg name>:<value>/.../real_time.
+        parts = bench.get("run_name", bench["name"]).split("/")
+        params = {}
+        for part in parts[1:]:
+            key, sep, value = part.partition(":")
+            if sep:
+                params[key] = int(value)
+        rows.append({
+            "benchmark": parts[0],
+            "params": params,
+            "task_system": task_system,
+            "threads": threads,
+            "task_threads": bench.get("threads"),
+            "items_per_second": bench.get("items_per_second"),
+            "real_time": bench.get("real_time"),
+            "time_unit": bench.get("time_unit"),
+        })
+    return None, rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Scalability matrix of the task systems")
+    parser.add_argument("build_dir", help="ispc build directory configured with -DISPC_INCLUDE_BENCHMARKS=ON")
+    parser.add_argument("-o", "--output", default="tasking_matrix.json", help="output JSON file")
+    parser.add_argument("--task-systems", help="comma separated list of task systems, all built ones by default")
+    parser.add_argument("--threads", help="comma separated list of thread counts, powers of two up to the number "
+                        "of CPUs by default")
+    parser.add_argument("--filter", help="regular expression of the benchmarks to run, like 'sync|nested'")
+    parser.add_argument("--min-time", default="0.1", help="minimum time of every benchmark in seconds")
+    args = parser.parse_args()
+
+    benchmarks = find_benchmarks(args.build_dir)
+    if not benchmarks:
+        print("No 01_tasking benchmarks are found in %s" % args.build_dir)
+        return 1
+    task_systems = args.task_systems.split(",") if args.task_systems else sorted(benchmarks)
+
+    cpus = allowed_cpus()
+    can_sweep = cpus is not None and sys.platform.startswith("linux")
+    if not can_sweep:
+        if args.threads:
+            print("The number of threads can be set on Linux only, the default one is used")
+        thread_counts = [None]
+    elif args.threads:
+        thread_counts = [int(n) for n in args.threads.split(",")]
+    else:
+        thread_counts = default_thread_counts(cpus)
+    if can_sweep and any(n > len(cpus) for n in thread_counts):
+        print("The process may run on %d CPUs only" % len(cpus))
+        return 1
+
+    results = []
+    errors = []
+    for task_system in task_systems:
+        if task_system not in benchmarks:
+            errors.append({"task_system": task_system, "threads": None, "error": "not built"})
+            continue
+        counts = thread_counts if can_sweep and task_system in SWEEPABLE else [None]
+        for threads in counts:
+            print("%s, %s threads" % (task_system, threads or "default"), flush=True)
+            error, rows = run_config(args, task_system, benchmarks[task_system], threads, cpus)
+            if error:
+                print("  " + error, flush=True)
+                errors.append({"task_system": task_system, "threads": threads, "error": error})
+            results.extend(rows)
+
+    with open(args.output, "w") as f:
+        json.dump({"results": results, "errors": errors}, f, indent=2)
+    print("Written %d results to %s" % (len(results), args.output))
+    return 1 if not results else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
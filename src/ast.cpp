@@ -120,11 +120,12 @@ AST::~AST() {
     }
 }
 
-void AST::AddFunction(Symbol *sym, Stmt *code) {
+void AST::AddFunction(Symbol *sym, Stmt *code, const std::vector<FunctionSpecialization> &specializations,
+                      const FunctionTargets &targets, const FunctionNarrowing &narrowing, bool isConstexpr) {
     if (sym == nullptr) {
         return;
     }
-    functions.push_back(new Function(sym, code));
+    functions.push_back(new Function(sym, code, specializations, targets, narrowing, isConstexpr));
 }
 
 void AST::AddFunctionTemplate(TemplateSymbol *templSym, Stmt *code) {
@@ -141,11 +142,17 @@ void AST::GenerateIR() {
     llvm::TimeTraceScope TimeScope("GenerateIR");
     for (auto fn : functions) {
         fn->GenerateIR();
+        fn->ReleaseAST(false);
     }
 
     for (auto templateFn : functionTemplates) {
         templateFn->GenerateIR();
     }
+
+    // The remaining ASTs may only be referred to by template instantiations.
+    for (auto fn : functions) {
+        fn->ReleaseAST(true);
+    }
 }
 
 void AST::Print(Globals::ASTDumpKind printKind) const {
@@ -231,6 +238,10 @@ ASTNode *ispc::WalkAST(ASTNode *node, ASTPreCallBackFunc preFunc, ASTPostCallBac
         } else if (ForeachUniqueStmt *fus = llvm::dyn_cast<ForeachUniqueStmt>(node)) {
             fus->expr = (Expr *)WalkAST(fus->expr, preFunc, postFunc, data);
             fus->stmts = (Stmt *)WalkAST(fus->stmts, preFunc, postFunc, data);
+        } else if (ForeachDynamicStmt *fds = llvm::dyn_cast<ForeachDynamicStmt>(node)) {
+            fds->startExpr = (Expr *)WalkAST(fds->startExpr, preFunc, postFunc, data);
+            fds->endExpr = (Expr *)WalkAST(fds->endExpr, preFunc, postFunc, data);
+            fds->stmts = (Stmt *)WalkAST(fds->stmts, preFunc, postFunc, data);
         } else if (CaseStmt *cs = llvm::dyn_cast<CaseStmt>(node)) {
             cs->stmts = (Stmt *)WalkAST(cs->stmts, preFunc, postFunc, data);
         } else if (DefaultStmt *defs = llvm::dyn_cast<DefaultStmt>(node)) {
@@ -287,6 +298,7 @@ ASTNode *ispc::WalkAST(ASTNode *node, ASTPreCallBackFunc preFunc, ASTPostCallBac
             for (int k = 0; k < 3; k++) {
                 fce->launchCountExpr[k] = (Expr *)WalkAST(fce->launchCountExpr[k], preFunc, postFunc, data);
             }
+            fce->reduceTarget = (Expr *)WalkAST(fce->reduceTarget, preFunc, postFunc, data);
         } else if (IndexExpr *ie = llvm::dyn_cast<IndexExpr>(node)) {
             ie->baseExpr = (Expr *)WalkAST(ie->baseExpr, preFunc, postFunc, data);
             ie->index = (Expr *)WalkAST(ie->index, preFunc, postFunc, data);
@@ -422,7 +434,8 @@ static bool lCheckAllOffSafety(ASTNode *node, void *data) {
     }
 
     if (llvm::dyn_cast<ForeachStmt>(node) != nullptr || llvm::dyn_cast<ForeachActiveStmt>(node) != nullptr ||
-        llvm::dyn_cast<ForeachUniqueStmt>(node) != nullptr || llvm::dyn_cast<UnmaskedStmt>(node) != nullptr) {
+        llvm::dyn_cast<ForeachUniqueStmt>(node) != nullptr || llvm::dyn_cast<ForeachDynamicStmt>(node) != nullptr ||
+        llvm::dyn_cast<UnmaskedStmt>(node) != nullptr) {
         // The various foreach statements also shouldn't be run with an
         // all-off mask.  Since they can re-establish an 'all on' mask,
         // this would be pretty unintuitive.  (More generally, it's
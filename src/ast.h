@@ -88,6 +88,10 @@ class ASTNode : public Traceable {
     ASTNode(SourcePos p, unsigned scid) : SubclassID(scid), pos(p) {}
     virtual ~ASTNode();
 
+    /** AST nodes are allocated in the arena of the function definition
+        that is being parsed, if any (see BookKeeper::Arena). */
+    void *operator new(size_t size) { return BookKeeper::in().addNode(static_cast<Traceable *>(::operator new(size))); }
+
     /** The Optimize() method should perform any appropriate early-stage
         optimizations on the node (e.g. constant folding).  This method
         will be called after the node's children have already been
@@ -154,6 +158,7 @@ class ASTNode : public Traceable {
         DoStmtID,
         ExprStmtID,
         ForeachActiveStmtID,
+        ForeachDynamicStmtID,
         ForeachStmtID,
         ForeachUniqueStmtID,
         ForStmtID,
@@ -181,13 +186,41 @@ class ASTNode : public Traceable {
     static inline bool classof(ASTNode const *) { return true; }
 };
 
+/** The values of a uniform integer parameter, which an exported function
+    is specialized for with '#pragma ispc specialize'. */
+struct FunctionSpecialization {
+    std::string paramName;
+    std::vector<int64_t> values;
+    SourcePos pos;
+};
+
+/** The ISAs, which '#pragma ispc targets' restricts the exported version
+    of a function to in multi-target compilation. */
+struct FunctionTargets {
+    std::vector<std::string> isaNames;
+    SourcePos pos;
+};
+
+/** The uniform integer parameter and its threshold, below which the calls
+    of an exported function are dispatched to its version compiled for the
+    target of the same family with 'width' lanes, with '#pragma ispc
+    narrow'. */
+struct FunctionNarrowing {
+    static constexpr int width = 4;
+    std::string paramName;
+    int64_t threshold = 0;
+    SourcePos pos;
+};
+
 class AST {
   public:
     ~AST();
 
     /** Add the AST for a function described by the given declaration
         information and source code. */
-    void AddFunction(Symbol *sym, Stmt *code);
+    void AddFunction(Symbol *sym, Stmt *code, const std::vector<FunctionSpecialization> &specializations = {},
+                     const FunctionTargets &targets = {}, const FunctionNarrowing &narrowing = {},
+                     bool isConstexpr = false);
 
     void AddFunctionTemplate(TemplateSymbol *templ, Stmt *code);
 
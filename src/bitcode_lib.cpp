@@ -21,6 +21,10 @@
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Path.h>
 
+#ifdef ISPC_COMPRESS_BITCODE
+#include <zstd.h>
+#endif
+
 using namespace ispc;
 
 // Dispatch constructors
@@ -126,18 +130,64 @@ bool BitcodeLib::fileExists() const {
     return llvm::sys::fs::exists(filePath);
 }
 
+// Embedded libraries are stored as zstd frames when ISPC is built with
+// ISPC_COMPRESS_BITCODE. They are distinguished from the plain bitcode by
+// the frame magic number.
+static bool lIsZstdFrame(const unsigned char *data, size_t size) {
+    return size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD;
+}
+
+llvm::StringRef BitcodeLib::getEmbeddedBitcode() const {
+    if (!lIsZstdFrame(m_lib, m_size)) {
+        return llvm::StringRef((const char *)m_lib, m_size);
+    }
+#ifdef ISPC_COMPRESS_BITCODE
+    // Only the libraries for the requested targets are ever decompressed.
+    std::call_once(m_decompressOnce, [this]() {
+        unsigned long long size = ZSTD_getFrameContentSize(m_lib, m_size);
+        if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+            Error(SourcePos(), "Error decompressing embedded bitcode library: unknown size");
+            exit(1);
+        }
+        m_decompressed.reset(new char[size]);
+        size_t result = ZSTD_decompress(m_decompressed.get(), size, m_lib, m_size);
+        if (ZSTD_isError(result) || result != size) {
+            Error(SourcePos(), "Error decompressing embedded bitcode library: %s",
+                  ZSTD_isError(result) ? ZSTD_getErrorName(result) : "size mismatch");
+            exit(1);
+        }
+        m_decompressedSize = size;
+    });
+    return llvm::StringRef(m_decompressed.get(), m_decompressedSize);
+#else
+    Error(SourcePos(), "Embedded bitcode library is compressed, but ISPC is built without ISPC_COMPRESS_BITCODE");
+    exit(1);
+#endif
+}
+
 llvm::Module *BitcodeLib::getLLVMModule() const {
+    // Libraries are big and only a small subset of their functions is
+    // usually needed, so read only the module level information here.
+    // Bodies of the functions are read from the bitcode when the linker
+    // materializes them (with LinkOnlyNeeded it does that only for the
+    // referenced ones), using the function offsets stored in the bitcode.
     switch (m_storage) {
     case BitcodeLibStorage::FileSystem: {
         llvm::SmallString<128> filePath(g->shareDirPath);
         llvm::sys::path::append(filePath, m_filename);
-        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> bufferOrErr = llvm::MemoryBuffer::getFile(filePath.str());
+        // Bitcode reader doesn't need the null terminator, which allows
+        // MemoryBuffer to mmap the file instead of reading it, so only the
+        // pages of the materialized functions are loaded.
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> bufferOrErr =
+            llvm::MemoryBuffer::getFile(filePath.str(), /*IsText*/ false, /*RequiresNullTerminator*/ false);
         if (std::error_code EC = bufferOrErr.getError()) {
             Error(SourcePos(), "Error reading bc_filename %s\n%s\n", m_filename.c_str(), EC.message().c_str());
             exit(1);
         }
+        // The module takes ownership of the buffer, as it is needed until
+        // all the functions are materialized.
         llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr =
-            llvm::parseBitcodeFile(bufferOrErr->get()->getMemBufferRef(), *g->ctx);
+            llvm::getOwningLazyBitcodeModule(std::move(bufferOrErr.get()), *g->ctx);
         if (!ModuleOrErr) {
             Error(SourcePos(), "Error parsing bitcode from filename %s\n", m_filename.c_str());
             exit(1);
@@ -148,9 +198,11 @@ llvm::Module *BitcodeLib::getLLVMModule() const {
         return nullptr;
     }
     case BitcodeLibStorage::Embedded: {
-        llvm::StringRef sb = llvm::StringRef((const char *)m_lib, m_size);
-        llvm::MemoryBufferRef bcBuf = llvm::MemoryBuffer::getMemBuffer(sb)->getMemBufferRef();
-        llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr = llvm::parseBitcodeFile(bcBuf, *g->ctx);
+        // Embedded bitcode (or its decompressed copy) lives as long as the
+        // process, so the module may refer to it directly.
+        llvm::StringRef sb = getEmbeddedBitcode();
+        llvm::MemoryBufferRef bcBuf(sb, "");
+        llvm::Expected<std::unique_ptr<llvm::Module>> ModuleOrErr = llvm::getLazyBitcodeModule(bcBuf, *g->ctx);
         if (!ModuleOrErr) {
             Error(SourcePos(), "Error parsing stdlib bitcode: %s", toString(ModuleOrErr.takeError()).c_str());
             exit(1);
@@ -14,6 +14,9 @@
 
 #include <llvm/IR/Module.h>
 
+#include <memory>
+#include <mutex>
+
 namespace ispc {
 
 class BitcodeLib {
@@ -37,6 +40,14 @@ class BitcodeLib {
 
     const std::string m_filename;
 
+    // Embedded library may be compressed. It is decompressed on the first
+    // use and kept for the lifetime of the process.
+    mutable std::once_flag m_decompressOnce;
+    mutable std::unique_ptr<char[]> m_decompressed;
+    mutable size_t m_decompressedSize = 0;
+
+    llvm::StringRef getEmbeddedBitcode() const;
+
   public:
     // Every constructor is presented in two types: one for embedded bitcode
     // library and one for file system bitcode.
@@ -62,6 +73,9 @@ class BitcodeLib {
     ISPCTarget getISPCTarget() const;
     const std::string &getFilename() const;
     bool fileExists() const;
+    // Returns lazily loaded module: function bodies are deserialized only
+    // when they are materialized, e.g. by the linker for the functions that
+    // are actually needed.
     llvm::Module *getLLVMModule() const;
 };
 
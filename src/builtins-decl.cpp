@@ -119,6 +119,13 @@ DECL_BUILTIN_NAME(__masked_load_blend_i16);
 DECL_BUILTIN_NAME(__masked_load_blend_i32);
 DECL_BUILTIN_NAME(__masked_load_blend_i64);
 DECL_BUILTIN_NAME(__masked_load_blend_i8);
+DECL_BUILTIN_NAME(__masked_load_block_double);
+DECL_BUILTIN_NAME(__masked_load_block_float);
+DECL_BUILTIN_NAME(__masked_load_block_half);
+DECL_BUILTIN_NAME(__masked_load_block_i16);
+DECL_BUILTIN_NAME(__masked_load_block_i32);
+DECL_BUILTIN_NAME(__masked_load_block_i64);
+DECL_BUILTIN_NAME(__masked_load_block_i8);
 DECL_BUILTIN_NAME(__masked_load_double);
 DECL_BUILTIN_NAME(__masked_load_float);
 DECL_BUILTIN_NAME(__masked_load_half);
@@ -133,6 +140,13 @@ DECL_BUILTIN_NAME(__masked_store_blend_i16);
 DECL_BUILTIN_NAME(__masked_store_blend_i32);
 DECL_BUILTIN_NAME(__masked_store_blend_i64);
 DECL_BUILTIN_NAME(__masked_store_blend_i8);
+DECL_BUILTIN_NAME(__masked_store_block_double);
+DECL_BUILTIN_NAME(__masked_store_block_float);
+DECL_BUILTIN_NAME(__masked_store_block_half);
+DECL_BUILTIN_NAME(__masked_store_block_i16);
+DECL_BUILTIN_NAME(__masked_store_block_i32);
+DECL_BUILTIN_NAME(__masked_store_block_i64);
+DECL_BUILTIN_NAME(__masked_store_block_i8);
 DECL_BUILTIN_NAME(__masked_store_double);
 DECL_BUILTIN_NAME(__masked_store_float);
 DECL_BUILTIN_NAME(__masked_store_half);
@@ -377,6 +391,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_double,
             __masked_load_double,
             __masked_load_blend_double,
+            __masked_load_block_double,
             __gather64_generic_double,
             __gather64_double,
             __gather32_generic_double,
@@ -398,6 +413,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_float,
             __masked_load_float,
             __masked_load_blend_float,
+            __masked_load_block_float,
             __gather64_generic_float,
             __gather64_float,
             __gather32_generic_float,
@@ -419,6 +435,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_half,
             __masked_load_half,
             __masked_load_blend_half,
+            __masked_load_block_half,
             __gather64_generic_half,
             __gather64_half,
             __gather32_generic_half,
@@ -440,6 +457,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_i16,
             __masked_load_i16,
             __masked_load_blend_i16,
+            __masked_load_block_i16,
             __gather64_generic_i16,
             __gather64_i16,
             __gather32_generic_i16,
@@ -461,6 +479,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_i32,
             __masked_load_i32,
             __masked_load_blend_i32,
+            __masked_load_block_i32,
             __gather64_generic_i32,
             __gather64_i32,
             __gather32_generic_i32,
@@ -482,6 +501,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_i64,
             __masked_load_i64,
             __masked_load_blend_i64,
+            __masked_load_block_i64,
             __gather64_generic_i64,
             __gather64_i64,
             __gather32_generic_i64,
@@ -503,6 +523,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_gather_factored_base_offsets32_i8,
             __masked_load_i8,
             __masked_load_blend_i8,
+            __masked_load_block_i8,
             __gather64_generic_i8,
             __gather64_i8,
             __gather32_generic_i8,
@@ -532,6 +553,10 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_prefetch_read_varying_nt_native,
             __prefetch_read_varying_nt,
             __prefetch_read_varying_nt_native,
+            __prefetch_read_sized_varying_1,
+            __prefetch_read_sized_varying_2,
+            __prefetch_read_sized_varying_3,
+            __prefetch_read_sized_varying_nt,
         },
     },
     {
@@ -563,6 +588,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_double,
             __masked_store_blend_double,
             __masked_store_double,
+            __masked_store_block_double,
             __scatter64_generic_double,
             __scatter64_double,
             __scatter32_generic_double,
@@ -585,6 +611,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_float,
             __masked_store_blend_float,
             __masked_store_float,
+            __masked_store_block_float,
             __scatter64_generic_float,
             __scatter64_float,
             __scatter32_generic_float,
@@ -607,6 +634,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_half,
             __masked_store_blend_half,
             __masked_store_half,
+            __masked_store_block_half,
             __scatter64_generic_half,
             __scatter64_half,
             __scatter32_generic_half,
@@ -629,6 +657,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_i16,
             __masked_store_blend_i16,
             __masked_store_i16,
+            __masked_store_block_i16,
             __scatter64_generic_i16,
             __scatter64_i16,
             __scatter32_generic_i16,
@@ -651,6 +680,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_i32,
             __masked_store_blend_i32,
             __masked_store_i32,
+            __masked_store_block_i32,
             __scatter64_generic_i32,
             __scatter64_i32,
             __scatter32_generic_i32,
@@ -673,6 +703,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_i64,
             __masked_store_blend_i64,
             __masked_store_i64,
+            __masked_store_block_i64,
             __scatter64_generic_i64,
             __scatter64_i64,
             __scatter32_generic_i64,
@@ -695,6 +726,7 @@ std::unordered_map<PersistentGroup, std::vector<const char *>> persistentGroups
             __pseudo_masked_store_i8,
             __masked_store_blend_i8,
             __masked_store_i8,
+            __masked_store_block_i8,
             __scatter64_generic_i8,
             __scatter64_i8,
             __scatter32_generic_i8,
@@ -167,6 +167,13 @@ extern const char *const __masked_load_blend_i16;
 extern const char *const __masked_load_blend_i32;
 extern const char *const __masked_load_blend_i64;
 extern const char *const __masked_load_blend_i8;
+extern const char *const __masked_load_block_double;
+extern const char *const __masked_load_block_float;
+extern const char *const __masked_load_block_half;
+extern const char *const __masked_load_block_i16;
+extern const char *const __masked_load_block_i32;
+extern const char *const __masked_load_block_i64;
+extern const char *const __masked_load_block_i8;
 extern const char *const __masked_load_double;
 extern const char *const __masked_load_float;
 extern const char *const __masked_load_half;
@@ -181,6 +188,13 @@ extern const char *const __masked_store_blend_i16;
 extern const char *const __masked_store_blend_i32;
 extern const char *const __masked_store_blend_i64;
 extern const char *const __masked_store_blend_i8;
+extern const char *const __masked_store_block_double;
+extern const char *const __masked_store_block_float;
+extern const char *const __masked_store_block_half;
+extern const char *const __masked_store_block_i16;
+extern const char *const __masked_store_block_i32;
+extern const char *const __masked_store_block_i64;
+extern const char *const __masked_store_block_i8;
 extern const char *const __masked_store_double;
 extern const char *const __masked_store_float;
 extern const char *const __masked_store_half;
@@ -377,10 +377,20 @@ void lExtractUsedFunctions(llvm::GlobalVariable *llvmUsed, std::unordered_set<ll
     }
 }
 
+// Persistent groups that optimization passes may emit calls to, so they
+// need to be kept even if the program doesn't use them.
+bool lIsPersistentGroupRequired(builtin::PersistentGroup group) {
+    return group == builtin::PersistentGroup::PREFETCH_READ && g->opt.prefetchDistance > 0;
+}
+
 // Find persistent groups that are used in the module.
 void lFindUsedPersistentGroups(llvm::Module *M, std::unordered_set<llvm::Function *> &usedFunctions,
                                std::unordered_set<const builtin::PersistentGroup *> &usedPersistentGroups) {
     for (auto const &[group, functions] : builtin::persistentGroups) {
+        if (lIsPersistentGroupRequired(group)) {
+            usedPersistentGroups.insert(&group);
+            continue;
+        }
         for (auto const &name : functions) {
             llvm::Function *F = M->getFunction(name);
             if (usedFunctions.find(F) != usedFunctions.end()) {
@@ -520,7 +530,7 @@ void lAddPersistentToLLVMUsed(llvm::Module &M) {
     // Bitcast all function pointer to i8*
     std::vector<llvm::Constant *> ConstPtrs;
     for (auto const &[group, functions] : persistentGroups) {
-        bool isGroupUsed = false;
+        bool isGroupUsed = lIsPersistentGroupRequired(group);
         for (auto const &name : functions) {
             llvm::Function *F = M.getFunction(name);
             if (F && F->getNumUses() > 0) {
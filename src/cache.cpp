@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file cache.cpp
+    @brief Implementation of CompilationCache.
+*/
+
+#include "cache.h"
+#include "util.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+
+using namespace ispc;
+
+///////////////////////////////////////////////////////////////////////////
+// CompilationCache::Key
+
+CompilationCache::Key::Key() {}
+
+void CompilationCache::Key::Add(llvm::StringRef data) {
+    // Hash the size as well, so the key is not ambiguous when the pieces of
+    // data are concatenated.
+    std::string size = std::to_string(data.size()) + ":";
+    m_hasher.update(size);
+    m_hasher.update(data);
+}
+
+std::string CompilationCache::Key::Finalize() { return llvm::toHex(m_hasher.final(), /* LowerCase */ true); }
+
+///////////////////////////////////////////////////////////////////////////
+// CompilationCache
+
+CompilationCache::CompilationCache(const std::string &dir) : m_dir(dir) {}
+
+std::string CompilationCache::getEntryPath(const std::string &key) const {
+    // Use the first two characters of the key as a subdirectory to keep the
+    // number of entries per directory reasonable.
+    llvm::SmallString<256> path(m_dir);
+    llvm::sys::path::append(path, key.substr(0, 2), key);
+    return std::string(path.str());
+}
+
+bool CompilationCache::Restore(const std::string &key, const std::vector<std::string> &files) const {
+    std::string entry = getEntryPath(key);
+    // The entry is created with rename() of a complete directory, so if it
+    // exists, all of its files are there.
+    if (!llvm::sys::fs::is_directory(entry)) {
+        Debug(SourcePos(), "Compilation cache miss: %s", key.c_str());
+        return false;
+    }
+
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        llvm::SmallString<256> cached(entry);
+        llvm::sys::path::append(cached, std::to_string(i));
+        if (std::error_code ec = llvm::sys::fs::copy_file(cached, files[i])) {
+            Warning(SourcePos(), "Failed to restore \"%s\" from compilation cache: %s", files[i].c_str(),
+                    ec.message().c_str());
+            return false;
+        }
+    }
+
+    Debug(SourcePos(), "Compilation cache hit: %s", key.c_str());
+    return true;
+}
+
+void CompilationCache::Store(const std::string &key, const std::vector<std::string> &files) const {
+    std::string entry = getEntryPath(key);
+    if (llvm::sys::fs::is_directory(entry)) {
+        return;
+    }
+
+    // Populate a temporary directory first and then move it into place, so
+    // concurrent compilations never see partially written entries.
+    std::string tmpEntry = entry + ".tmp." + std::to_string(llvm::sys::Process::getProcessId());
+    if (std::error_code ec = llvm::sys::fs::create_directories(tmpEntry)) {
+        Debug(SourcePos(), "Failed to create compilation cache entry \"%s\": %s", tmpEntry.c_str(),
+              ec.message().c_str());
+        return;
+    }
+
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        llvm::SmallString<256> cached(tmpEntry);
+        llvm::sys::path::append(cached, std::to_string(i));
+        if (std::error_code ec = llvm::sys::fs::copy_file(files[i], cached)) {
+            Debug(SourcePos(), "Failed to store \"%s\" to compilation cache: %s", files[i].c_str(),
+                  ec.message().c_str());
+            llvm::sys::fs::remove_directories(tmpEntry);
+            return;
+        }
+    }
+
+    if (llvm::sys::fs::rename(tmpEntry, entry)) {
+        // Most likely another compilation has stored the same entry first.
+        llvm::sys::fs::remove_directories(tmpEntry);
+        return;
+    }
+    Debug(SourcePos(), "Stored compilation cache entry: %s", key.c_str());
+}
@@ -0,0 +1,65 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file cache.h
+    @brief Declaration of CompilationCache, a persistent on-disk cache of
+           compilation results.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/SHA256.h>
+
+namespace ispc {
+
+/** @brief Persistent on-disk cache of compilation results (--cache-dir).
+
+    Every cache entry is identified by a key computed over everything that
+    may affect the compilation result: the compiler version, the command
+    line options, the target list and the preprocessed source for every
+    target.  An entry holds the copies of all the output files of the
+    compilation (object files, headers, etc.) in the order they were
+    passed to Store(), so a hit restores all of them at once.
+ */
+class CompilationCache {
+  public:
+    /** Builder of the cache key. */
+    class Key {
+      public:
+        Key();
+
+        /** Add a piece of data to the key. */
+        void Add(llvm::StringRef data);
+
+        /** Finish the key computation and return the key as a hex string. */
+        std::string Finalize();
+
+      private:
+        llvm::SHA256 m_hasher;
+    };
+
+    explicit CompilationCache(const std::string &dir);
+
+    /** Copy the files of the entry with the given key to the given
+        locations.  Returns true on a cache hit. */
+    bool Restore(const std::string &key, const std::vector<std::string> &files) const;
+
+    /** Store the given files as an entry with the given key.  Failure to
+        store the entry is not an error, it is just reported with the
+        --debug switch. */
+    void Store(const std::string &key, const std::vector<std::string> &files) const;
+
+  private:
+    std::string getEntryPath(const std::string &key) const;
+
+    std::string m_dir;
+};
+
+} // namespace ispc
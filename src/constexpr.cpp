@@ -0,0 +1,1126 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file constexpr.cpp
+    @brief Interpreter of the AST of "constexpr" functions, which evaluates
+           their calls with constant arguments at compile time.
+*/
+
+#include "constexpr.h"
+#include "expr.h"
+#include "func.h"
+#include "stmt.h"
+#include "sym.h"
+#include "type.h"
+#include "util.h"
+
+#include <cmath>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/APFloat.h>
+#include <llvm/IR/Type.h>
+
+using namespace ispc;
+
+// Limits of the evaluation, so that an endless loop or recursion in a
+// constexpr function is an error rather than a hang of the compiler.
+static const int lMaxConstexprSteps = 1 << 24;
+static const int lMaxConstexprDepth = 256;
+
+///////////////////////////////////////////////////////////////////////////
+// Values
+
+/** A value computed by the interpreter.  Integer and bool values are kept
+    in \c bits, sign- or zero-extended to 64 bits according to the type, and
+    floating-point values in \c fp, rounded to the precision of the type.
+    Structs and arrays hold a value per member or element.  Variables of
+    reference type only set \c ref to the referenced value. */
+struct CEValue {
+    const Type *type = nullptr;
+    uint64_t bits = 0;
+    double fp = 0.;
+    std::vector<CEValue> elements;
+    CEValue *ref = nullptr;
+};
+
+static AtomicType::BasicType lBasicType(const Type *type) {
+    if (CastType<EnumType>(type) != nullptr) {
+        return AtomicType::TYPE_UINT32;
+    }
+    const AtomicType *at = CastType<AtomicType>(type);
+    return at != nullptr ? at->basicType : AtomicType::TYPE_VOID;
+}
+
+static bool lIsScalar(AtomicType::BasicType bt) {
+    return bt != AtomicType::TYPE_VOID && bt != AtomicType::TYPE_DEPENDENT;
+}
+
+static bool lIsFloat(AtomicType::BasicType bt) {
+    return bt == AtomicType::TYPE_FLOAT16 || bt == AtomicType::TYPE_FLOAT || bt == AtomicType::TYPE_DOUBLE;
+}
+
+static bool lIsSigned(AtomicType::BasicType bt) {
+    return bt == AtomicType::TYPE_INT8 || bt == AtomicType::TYPE_INT16 || bt == AtomicType::TYPE_INT32 ||
+           bt == AtomicType::TYPE_INT64;
+}
+
+static int lBitWidth(AtomicType::BasicType bt) {
+    switch (bt) {
+    case AtomicType::TYPE_BOOL:
+        return 1;
+    case AtomicType::TYPE_INT8:
+    case AtomicType::TYPE_UINT8:
+        return 8;
+    case AtomicType::TYPE_INT16:
+    case AtomicType::TYPE_UINT16:
+    case AtomicType::TYPE_FLOAT16:
+        return 16;
+    case AtomicType::TYPE_INT32:
+    case AtomicType::TYPE_UINT32:
+    case AtomicType::TYPE_FLOAT:
+        return 32;
+    default:
+        return 64;
+    }
+}
+
+/** Bring the value back to the range and the precision of its type after
+    it has been computed with 64-bit integers or doubles. */
+static void lNormalize(CEValue &v) {
+    switch (lBasicType(v.type)) {
+    case AtomicType::TYPE_BOOL:
+        v.bits = v.bits != 0;
+        break;
+    case AtomicType::TYPE_INT8:
+        v.bits = (uint64_t)(int64_t)(int8_t)v.bits;
+        break;
+    case AtomicType::TYPE_UINT8:
+        v.bits = (uint8_t)v.bits;
+        break;
+    case AtomicType::TYPE_INT16:
+        v.bits = (uint64_t)(int64_t)(int16_t)v.bits;
+        break;
+    case AtomicType::TYPE_UINT16:
+        v.bits = (uint16_t)v.bits;
+        break;
+    case AtomicType::TYPE_INT32:
+        v.bits = (uint64_t)(int64_t)(int32_t)v.bits;
+        break;
+    case AtomicType::TYPE_UINT32:
+        v.bits = (uint32_t)v.bits;
+        break;
+    case AtomicType::TYPE_FLOAT16: {
+        llvm::APFloat f(v.fp);
+        bool ignored;
+        f.convert(llvm::APFloat::IEEEhalf(), llvm::APFloat::rmNearestTiesToEven, &ignored);
+        f.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &ignored);
+        v.fp = f.convertToDouble();
+        break;
+    }
+    case AtomicType::TYPE_FLOAT:
+        v.fp = (float)v.fp;
+        break;
+    default:
+        break;
+    }
+}
+
+bool ispc::IsConstexprType(const Type *type) {
+    if (type == nullptr || !type->IsUniformType()) {
+        return false;
+    }
+    if (CastType<AtomicType>(type) != nullptr || CastType<EnumType>(type) != nullptr) {
+        return lIsScalar(lBasicType(type));
+    }
+    if (const StructType *st = CastType<StructType>(type)) {
+        for (int i = 0; i < st->GetElementCount(); ++i) {
+            if (!IsConstexprType(st->GetElementType(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (const ArrayType *at = CastType<ArrayType>(type)) {
+        return at->GetElementCount() > 0 && IsConstexprType(at->GetElementType());
+    }
+    return false;
+}
+
+/** Turn the computed value into the AST of a constant of the given type. */
+static Expr *lValueToExpr(const CEValue &v, const Type *type, SourcePos pos) {
+    if (const StructType *st = CastType<StructType>(type)) {
+        ExprList *list = new ExprList(pos);
+        for (int i = 0; i < st->GetElementCount(); ++i) {
+            list->exprs.push_back(lValueToExpr(v.elements[i], st->GetElementType(i), pos));
+        }
+        return list;
+    }
+    if (const ArrayType *at = CastType<ArrayType>(type)) {
+        ExprList *list = new ExprList(pos);
+        for (int i = 0; i < at->GetElementCount(); ++i) {
+            list->exprs.push_back(lValueToExpr(v.elements[i], at->GetElementType(), pos));
+        }
+        return list;
+    }
+
+    switch (lBasicType(type)) {
+    case AtomicType::TYPE_BOOL:
+        return new ConstExpr(type, v.bits != 0, pos);
+    case AtomicType::TYPE_INT8:
+        return new ConstExpr(type, (int8_t)v.bits, pos);
+    case AtomicType::TYPE_UINT8:
+        return new ConstExpr(type, (uint8_t)v.bits, pos);
+    case AtomicType::TYPE_INT16:
+        return new ConstExpr(type, (int16_t)v.bits, pos);
+    case AtomicType::TYPE_UINT16:
+        return new ConstExpr(type, (uint16_t)v.bits, pos);
+    case AtomicType::TYPE_INT32:
+        return new ConstExpr(type, (int32_t)v.bits, pos);
+    case AtomicType::TYPE_UINT32:
+        return new ConstExpr(type, (uint32_t)v.bits, pos);
+    case AtomicType::TYPE_INT64:
+        return new ConstExpr(type, (int64_t)v.bits, pos);
+    case AtomicType::TYPE_UINT64:
+        return new ConstExpr(type, (uint64_t)v.bits, pos);
+    case AtomicType::TYPE_FLOAT16: {
+        llvm::APFloat f(v.fp);
+        bool ignored;
+        f.convert(llvm::APFloat::IEEEhalf(), llvm::APFloat::rmNearestTiesToEven, &ignored);
+        return new ConstExpr(type, f, pos);
+    }
+    case AtomicType::TYPE_FLOAT:
+        return new ConstExpr(type, llvm::APFloat((float)v.fp), pos);
+    case AtomicType::TYPE_DOUBLE:
+        return new ConstExpr(type, llvm::APFloat(v.fp), pos);
+    default:
+        FATAL("Unexpected type of constexpr value");
+        return nullptr;
+    }
+}
+
+/** Returns true if the function is declared in the standard library. */
+static bool lIsStdlibFunction(const Symbol *sym) {
+    std::string file = sym->pos.name != nullptr ? sym->pos.name : "";
+    const std::string stdlib = "stdlib.isph";
+    return file.size() >= stdlib.size() && file.compare(file.size() - stdlib.size(), stdlib.size(), stdlib) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ConstexprEvaluator
+
+namespace {
+
+enum class CEFlow { Normal, Break, Continue, Return, Failed };
+
+/** Local variables and parameters of a call of a constexpr function, and
+    the temporary values of the statement that is being evaluated. */
+struct CEFrame {
+    std::map<const Symbol *, CEValue> vars;
+    std::deque<CEValue> temps;
+    CEValue result;
+};
+
+class ConstexprEvaluator {
+  public:
+    ConstexprEvaluator() : steps(0), depth(0), failed(false) { frames.push_back(&topFrame); }
+
+    /** Evaluate the function call, with the arguments evaluated in a frame
+        without any variables. */
+    bool Call(const FunctionCallExpr *call, CEValue &result) { return callFunction(call, result); }
+
+    // The position and the reason of the first failure.
+    SourcePos failPos;
+    std::string failReason;
+
+  private:
+    bool fail(SourcePos pos, const std::string &reason);
+    bool step(SourcePos pos);
+
+    bool zero(const Type *type, CEValue &out, SourcePos pos);
+    bool convert(const CEValue &from, const Type *to, CEValue &out, SourcePos pos);
+    bool initialize(const Type *type, const Expr *init, CEValue &out);
+    bool binary(BinaryExpr::Op op, const CEValue &a, const CEValue &b, const Type *resultType, SourcePos pos,
+                CEValue &out);
+
+    CEValue *location(const Expr *expr);
+    bool eval(const Expr *expr, CEValue &out);
+    bool evalBool(const Expr *expr, bool &out);
+    CEFlow exec(const Stmt *stmt);
+
+    bool callFunction(const FunctionCallExpr *call, CEValue &out);
+    bool callStdlib(const Symbol *sym, const std::vector<CEValue> &args, const Type *retType, SourcePos pos,
+                    CEValue &out);
+
+    CEFrame topFrame;
+    std::vector<CEFrame *> frames;
+    int steps, depth;
+    bool failed;
+};
+
+} // namespace
+
+bool ConstexprEvaluator::fail(SourcePos pos, const std::string &reason) {
+    if (!failed) {
+        failed = true;
+        failPos = pos;
+        failReason = reason;
+    }
+    return false;
+}
+
+bool ConstexprEvaluator::step(SourcePos pos) {
+    if (failed) {
+        return false;
+    }
+    if (++steps > lMaxConstexprSteps) {
+        return fail(pos, "the evaluation takes more than " + std::to_string(lMaxConstexprSteps) + " steps");
+    }
+    return true;
+}
+
+bool ConstexprEvaluator::zero(const Type *type, CEValue &out, SourcePos pos) {
+    if (!IsConstexprType(type)) {
+        return fail(pos, "values of type \"" + (type ? type->GetString() : std::string("?")) +
+                             "\" can't be computed at compile time");
+    }
+    out = CEValue();
+    out.type = type;
+    if (const StructType *st = CastType<StructType>(type)) {
+        out.elements.resize(st->GetElementCount());
+        for (int i = 0; i < st->GetElementCount(); ++i) {
+            if (!zero(st->GetElementType(i), out.elements[i], pos)) {
+                return false;
+            }
+        }
+    } else if (const ArrayType *at = CastType<ArrayType>(type)) {
+        CEValue element;
+        if (!zero(at->GetElementType(), element, pos)) {
+            return false;
+        }
+        out.elements.assign(at->GetElementCount(), element);
+    }
+    return true;
+}
+
+bool ConstexprEvaluator::convert(const CEValue &from, const Type *to, CEValue &out, SourcePos pos) {
+    to = to->GetReferenceTarget();
+    if (!IsConstexprType(to)) {
+        return fail(pos, "values of type \"" + to->GetString() + "\" can't be computed at compile time");
+    }
+
+    AtomicType::BasicType fromBT = lBasicType(from.type), toBT = lBasicType(to);
+    if (!lIsScalar(fromBT) || !lIsScalar(toBT)) {
+        if (from.type == nullptr || !Type::EqualIgnoringConst(from.type, to)) {
+            return fail(pos, "can't convert \"" + (from.type ? from.type->GetString() : std::string("?")) +
+                                 "\" to \"" + to->GetString() + "\"");
+        }
+        out = from;
+        out.type = to;
+        out.ref = nullptr;
+        return true;
+    }
+
+    CEValue result;
+    result.type = to;
+    if (toBT == AtomicType::TYPE_BOOL) {
+        result.bits = lIsFloat(fromBT) ? from.fp != 0. : from.bits != 0;
+    } else if (lIsFloat(toBT)) {
+        if (lIsFloat(fromBT)) {
+            result.fp = from.fp;
+        } else if (toBT == AtomicType::TYPE_FLOAT) {
+            result.fp = lIsSigned(fromBT) ? (float)(int64_t)from.bits : (float)from.bits;
+        } else {
+            result.fp = lIsSigned(fromBT) ? (double)(int64_t)from.bits : (double)from.bits;
+        }
+    } else if (lIsFloat(fromBT)) {
+        if (std::isnan(from.fp) || std::fabs(from.fp) >= 18446744073709551616.) {
+            return fail(pos, "floating-point value is out of the range of \"" + to->GetString() + "\"");
+        }
+        result.bits = from.fp < 0. ? (uint64_t)(int64_t)from.fp : (uint64_t)from.fp;
+    } else {
+        result.bits = from.bits;
+    }
+    lNormalize(result);
+    out = result;
+    return true;
+}
+
+bool ConstexprEvaluator::initialize(const Type *type, const Expr *init, CEValue &out) {
+    const ExprList *list = llvm::dyn_cast<ExprList>(init);
+    if (list == nullptr) {
+        CEValue value;
+        return eval(init, value) && convert(value, type, out, init->pos);
+    }
+
+    if (!zero(type, out, init->pos)) {
+        return false;
+    }
+    const StructType *st = CastType<StructType>(type);
+    const ArrayType *at = CastType<ArrayType>(type);
+    if (st == nullptr && at == nullptr) {
+        if (list->exprs.size() != 1) {
+            return fail(init->pos, "expected a single value to initialize \"" + type->GetString() + "\"");
+        }
+        return initialize(type, list->exprs[0], out);
+    }
+    if (list->exprs.size() > out.elements.size()) {
+        return fail(init->pos, "too many initializer values for \"" + type->GetString() + "\"");
+    }
+    for (size_t i = 0; i < list->exprs.size(); ++i) {
+        const Type *elementType = st ? st->GetElementType(i) : at->GetElementType();
+        if (list->exprs[i] == nullptr || !initialize(elementType, list->exprs[i], out.elements[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConstexprEvaluator::binary(BinaryExpr::Op op, const CEValue &a, const CEValue &b, const Type *resultType,
+                                SourcePos pos, CEValue &out) {
+    AtomicType::BasicType bt = lBasicType(a.type);
+    if (!lIsScalar(bt) || !lIsScalar(lBasicType(b.type))) {
+        return fail(pos, "operator can only be evaluated for atomic and enum values");
+    }
+
+    CEValue result;
+    result.type = resultType;
+    if (lIsFloat(bt)) {
+        double x = a.fp, y = b.fp;
+        switch (op) {
+        case BinaryExpr::Add:
+            result.fp = x + y;
+            break;
+        case BinaryExpr::Sub:
+            result.fp = x - y;
+            break;
+        case BinaryExpr::Mul:
+            result.fp = x * y;
+            break;
+        case BinaryExpr::Div:
+            result.fp = x / y;
+            break;
+        case BinaryExpr::Mod:
+            result.fp = std::fmod(x, y);
+            break;
+        case BinaryExpr::Lt:
+            result.bits = x < y;
+            break;
+        case BinaryExpr::Gt:
+            result.bits = x > y;
+            break;
+        case BinaryExpr::Le:
+            result.bits = x <= y;
+            break;
+        case BinaryExpr::Ge:
+            result.bits = x >= y;
+            break;
+        case BinaryExpr::Equal:
+            result.bits = x == y;
+            break;
+        case BinaryExpr::NotEqual:
+            result.bits = x != y;
+            break;
+        default:
+            return fail(pos, "operator isn't supported for floating-point values");
+        }
+        lNormalize(result);
+        out = result;
+        return true;
+    }
+
+    bool isSigned = lIsSigned(bt);
+    uint64_t x = a.bits, y = b.bits;
+    int64_t sx = (int64_t)x, sy = (int64_t)y;
+    switch (op) {
+    case BinaryExpr::Add:
+        result.bits = x + y;
+        break;
+    case BinaryExpr::Sub:
+        result.bits = x - y;
+        break;
+    case BinaryExpr::Mul:
+        result.bits = x * y;
+        break;
+    case BinaryExpr::Div:
+    case BinaryExpr::Mod:
+        if (y == 0) {
+            return fail(pos, "division by zero");
+        }
+        if (isSigned && sy == -1 && sx == INT64_MIN) {
+            return fail(pos, "integer overflow in division");
+        }
+        if (op == BinaryExpr::Div) {
+            result.bits = isSigned ? (uint64_t)(sx / sy) : x / y;
+        } else {
+            result.bits = isSigned ? (uint64_t)(sx % sy) : x % y;
+        }
+        break;
+    case BinaryExpr::Shl:
+    case BinaryExpr::Shr:
+        if ((lIsSigned(lBasicType(b.type)) && sy < 0) || y >= (uint64_t)lBitWidth(bt)) {
+            return fail(pos, "shift amount " + std::to_string(sy) + " is out of range");
+        }
+        if (op == BinaryExpr::Shl) {
+            result.bits = x << y;
+        } else {
+            result.bits = isSigned ? (uint64_t)(sx >> y) : x >> y;
+        }
+        break;
+    case BinaryExpr::Lt:
+        result.bits = isSigned ? sx < sy : x < y;
+        break;
+    case BinaryExpr::Gt:
+        result.bits = isSigned ? sx > sy : x > y;
+        break;
+    case BinaryExpr::Le:
+        result.bits = isSigned ? sx <= sy : x <= y;
+        break;
+    case BinaryExpr::Ge:
+        result.bits = isSigned ? sx >= sy : x >= y;
+        break;
+    case BinaryExpr::Equal:
+        result.bits = x == y;
+        break;
+    case BinaryExpr::NotEqual:
+        result.bits = x != y;
+        break;
+    case BinaryExpr::BitAnd:
+        result.bits = x & y;
+        break;
+    case BinaryExpr::BitXor:
+        result.bits = x ^ y;
+        break;
+    case BinaryExpr::BitOr:
+        result.bits = x | y;
+        break;
+    case BinaryExpr::LogicalAnd:
+        result.bits = x != 0 && y != 0;
+        break;
+    case BinaryExpr::LogicalOr:
+        result.bits = x != 0 || y != 0;
+        break;
+    default:
+        return fail(pos, "operator isn't supported");
+    }
+    lNormalize(result);
+    out = result;
+    return true;
+}
+
+/** Returns the storage of the value of an lvalue expression, or of a
+    temporary value for the other expressions. */
+CEValue *ConstexprEvaluator::location(const Expr *expr) {
+    if (expr == nullptr || !step(expr->pos)) {
+        return nullptr;
+    }
+
+    if (const SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr)) {
+        const Symbol *sym = se->GetBaseSymbol();
+        auto it = frames.back()->vars.find(sym);
+        if (it == frames.back()->vars.end()) {
+            fail(expr->pos, "\"" + sym->name + "\" isn't a local variable or a parameter of a constexpr function");
+            return nullptr;
+        }
+        CEValue *value = &it->second;
+        while (value->ref != nullptr) {
+            value = value->ref;
+        }
+        return value;
+    }
+    if (const RefDerefExpr *rde = llvm::dyn_cast<RefDerefExpr>(expr)) {
+        return location(rde->expr);
+    }
+    if (const ReferenceExpr *re = llvm::dyn_cast<ReferenceExpr>(expr)) {
+        return location(re->expr);
+    }
+    if (const IndexExpr *ie = llvm::dyn_cast<IndexExpr>(expr)) {
+        const Type *baseType = ie->baseExpr ? ie->baseExpr->GetType() : nullptr;
+        if (baseType == nullptr || CastType<ArrayType>(baseType->GetReferenceTarget()) == nullptr) {
+            fail(expr->pos, "only arrays can be indexed in constexpr functions");
+            return nullptr;
+        }
+        CEValue *base = location(ie->baseExpr);
+        CEValue index;
+        if (base == nullptr || !eval(ie->index, index)) {
+            return nullptr;
+        }
+        if (!lIsScalar(lBasicType(index.type)) || lIsFloat(lBasicType(index.type))) {
+            fail(ie->index->pos, "array index must be an integer");
+            return nullptr;
+        }
+        int64_t i = (int64_t)index.bits;
+        if ((!lIsSigned(lBasicType(index.type)) && index.bits >= base->elements.size()) || i < 0 ||
+            i >= (int64_t)base->elements.size()) {
+            fail(ie->index->pos, "array index " + std::to_string(i) + " is out of bounds");
+            return nullptr;
+        }
+        return &base->elements[i];
+    }
+    if (const StructMemberExpr *sme = llvm::dyn_cast<StructMemberExpr>(expr)) {
+        const Type *baseType = sme->expr ? sme->expr->GetType() : nullptr;
+        const StructType *st = baseType ? CastType<StructType>(baseType->GetReferenceTarget()) : nullptr;
+        if (sme->dereferenceExpr || st == nullptr) {
+            fail(expr->pos, "pointers can't be dereferenced in constexpr functions");
+            return nullptr;
+        }
+        CEValue *base = location(sme->expr);
+        if (base == nullptr) {
+            return nullptr;
+        }
+        int member = st->GetElementNumber(sme->identifier);
+        if (member < 0 || member >= (int)base->elements.size()) {
+            fail(expr->pos, "unknown struct member \"" + sme->identifier + "\"");
+            return nullptr;
+        }
+        return &base->elements[member];
+    }
+
+    CEFrame *frame = frames.back();
+    frame->temps.emplace_back();
+    CEValue *temp = &frame->temps.back();
+    return eval(expr, *temp) ? temp : nullptr;
+}
+
+bool ConstexprEvaluator::eval(const Expr *expr, CEValue &out) {
+    if (expr == nullptr) {
+        return fail(SourcePos(), "invalid expression");
+    }
+    if (!step(expr->pos)) {
+        return false;
+    }
+
+    if (const ConstExpr *ce = llvm::dyn_cast<ConstExpr>(expr)) {
+        const Type *type = ce->GetType();
+        AtomicType::BasicType bt = lBasicType(type);
+        if (!type->IsUniformType() || !lIsScalar(bt)) {
+            return fail(expr->pos, "values of type \"" + type->GetString() + "\" can't be computed at compile time");
+        }
+        out = CEValue();
+        out.type = type;
+        if (lIsFloat(bt)) {
+            std::vector<llvm::APFloat> values;
+            ce->GetValues(values, llvm::Type::getDoubleTy(*g->ctx));
+            out.fp = values[0].convertToDouble();
+        } else if (bt == AtomicType::TYPE_BOOL) {
+            bool value;
+            ce->GetValues(&value);
+            out.bits = value;
+        } else if (lIsSigned(bt)) {
+            int64_t value;
+            ce->GetValues(&value);
+            out.bits = (uint64_t)value;
+        } else {
+            uint64_t value;
+            ce->GetValues(&value);
+            out.bits = value;
+        }
+        return true;
+    }
+
+    if (llvm::isa<SymbolExpr>(expr) || llvm::isa<IndexExpr>(expr) || llvm::isa<StructMemberExpr>(expr) ||
+        llvm::isa<RefDerefExpr>(expr)) {
+        CEValue *value = location(expr);
+        if (value == nullptr) {
+            return false;
+        }
+        out = *value;
+        return true;
+    }
+
+    if (const BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        CEValue a, b;
+        if (be->op == BinaryExpr::Comma) {
+            return eval(be->arg0, a) && eval(be->arg1, out);
+        }
+        if (be->op == BinaryExpr::LogicalAnd || be->op == BinaryExpr::LogicalOr) {
+            bool x, y = false;
+            if (!evalBool(be->arg0, x)) {
+                return false;
+            }
+            // Short-circuit evaluation, as for uniform values at runtime.
+            if (x == (be->op == BinaryExpr::LogicalAnd) && !evalBool(be->arg1, y)) {
+                return false;
+            }
+            out = CEValue();
+            out.type = expr->GetType();
+            out.bits = be->op == BinaryExpr::LogicalAnd ? x && y : x || y;
+            return true;
+        }
+        return eval(be->arg0, a) && eval(be->arg1, b) && binary(be->op, a, b, expr->GetType(), expr->pos, out);
+    }
+
+    if (const UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(expr)) {
+        if (ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PreDec || ue->op == UnaryExpr::PostInc ||
+            ue->op == UnaryExpr::PostDec) {
+            CEValue *value = location(ue->expr);
+            if (value == nullptr) {
+                return false;
+            }
+            CEValue int1, one, result;
+            int1.type = AtomicType::UniformInt32;
+            int1.bits = 1;
+            if (!convert(int1, value->type, one, expr->pos)) {
+                return false;
+            }
+            bool inc = ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PostInc;
+            if (!binary(inc ? BinaryExpr::Add : BinaryExpr::Sub, *value, one, value->type, expr->pos, result)) {
+                return false;
+            }
+            bool post = ue->op == UnaryExpr::PostInc || ue->op == UnaryExpr::PostDec;
+            out = post ? *value : result;
+            *value = result;
+            return true;
+        }
+
+        CEValue value;
+        if (!eval(ue->expr, value)) {
+            return false;
+        }
+        AtomicType::BasicType bt = lBasicType(value.type);
+        if (!lIsScalar(bt)) {
+            return fail(expr->pos, "operator can only be evaluated for atomic and enum values");
+        }
+        out = value;
+        out.type = expr->GetType();
+        switch (ue->op) {
+        case UnaryExpr::Negate:
+            out.fp = -value.fp;
+            out.bits = 0 - value.bits;
+            break;
+        case UnaryExpr::LogicalNot:
+            out.bits = lIsFloat(bt) ? value.fp == 0. : value.bits == 0;
+            break;
+        case UnaryExpr::BitNot:
+            out.bits = ~value.bits;
+            break;
+        default:
+            return fail(expr->pos, "operator isn't supported");
+        }
+        lNormalize(out);
+        return true;
+    }
+
+    if (const AssignExpr *ae = llvm::dyn_cast<AssignExpr>(expr)) {
+        CEValue *value = location(ae->lvalue);
+        CEValue rvalue;
+        if (value == nullptr || !eval(ae->rvalue, rvalue)) {
+            return false;
+        }
+        if (ae->op == AssignExpr::Assign) {
+            if (!convert(rvalue, value->type, *value, expr->pos)) {
+                return false;
+            }
+            out = *value;
+            return true;
+        }
+
+        BinaryExpr::Op op;
+        switch (ae->op) {
+        case AssignExpr::MulAssign:
+            op = BinaryExpr::Mul;
+            break;
+        case AssignExpr::DivAssign:
+            op = BinaryExpr::Div;
+            break;
+        case AssignExpr::ModAssign:
+            op = BinaryExpr::Mod;
+            break;
+        case AssignExpr::AddAssign:
+            op = BinaryExpr::Add;
+            break;
+        case AssignExpr::SubAssign:
+            op = BinaryExpr::Sub;
+            break;
+        case AssignExpr::ShlAssign:
+            op = BinaryExpr::Shl;
+            break;
+        case AssignExpr::ShrAssign:
+            op = BinaryExpr::Shr;
+            break;
+        case AssignExpr::AndAssign:
+            op = BinaryExpr::BitAnd;
+            break;
+        case AssignExpr::XorAssign:
+            op = BinaryExpr::BitXor;
+            break;
+        default:
+            op = BinaryExpr::BitOr;
+            break;
+        }
+        CEValue operand, result;
+        if (op != BinaryExpr::Shl && op != BinaryExpr::Shr) {
+            if (!convert(rvalue, value->type, operand, expr->pos)) {
+                return false;
+            }
+        } else {
+            operand = rvalue;
+        }
+        if (!binary(op, *value, operand, value->type, expr->pos, result)) {
+            return false;
+        }
+        *value = result;
+        out = result;
+        return true;
+    }
+
+    if (const SelectExpr *se = llvm::dyn_cast<SelectExpr>(expr)) {
+        bool test;
+        CEValue value;
+        return evalBool(se->test, test) && eval(test ? se->expr1 : se->expr2, value) &&
+               convert(value, expr->GetType(), out, expr->pos);
+    }
+
+    if (const TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        CEValue value;
+        return eval(tce->expr, value) && convert(value, tce->GetType(), out, expr->pos);
+    }
+
+    if (const FunctionCallExpr *fce = llvm::dyn_cast<FunctionCallExpr>(expr)) {
+        return callFunction(fce, out);
+    }
+
+    if (llvm::isa<ExprList>(expr)) {
+        return fail(expr->pos, "initializer lists are only supported in declarations");
+    }
+    return fail(expr->pos, "expression can't be evaluated at compile time");
+}
+
+bool ConstexprEvaluator::evalBool(const Expr *expr, bool &out) {
+    CEValue value, test;
+    if (!eval(expr, value) || !convert(value, AtomicType::UniformBool, test, expr->pos)) {
+        return false;
+    }
+    out = test.bits != 0;
+    return true;
+}
+
+CEFlow ConstexprEvaluator::exec(const Stmt *stmt) {
+    if (stmt == nullptr) {
+        return CEFlow::Normal;
+    }
+    if (!step(stmt->pos)) {
+        return CEFlow::Failed;
+    }
+    CEFrame *frame = frames.back();
+
+    if (const StmtList *sl = llvm::dyn_cast<StmtList>(stmt)) {
+        for (const Stmt *s : sl->stmts) {
+            CEFlow flow = exec(s);
+            if (flow != CEFlow::Normal) {
+                return flow;
+            }
+        }
+        return CEFlow::Normal;
+    }
+
+    if (const ExprStmt *es = llvm::dyn_cast<ExprStmt>(stmt)) {
+        CEValue value;
+        bool ok = es->expr == nullptr || eval(es->expr, value);
+        frame->temps.clear();
+        return ok ? CEFlow::Normal : CEFlow::Failed;
+    }
+
+    if (const DeclStmt *ds = llvm::dyn_cast<DeclStmt>(stmt)) {
+        for (const VariableDeclaration &var : ds->vars) {
+            if (var.sym == nullptr) {
+                fail(stmt->pos, "invalid declaration");
+                return CEFlow::Failed;
+            }
+            if (var.sym->storageClass == SC_STATIC) {
+                fail(var.sym->pos, "static variables aren't supported in constexpr functions");
+                return CEFlow::Failed;
+            }
+            if (var.sym->storageClass == SC_TASK_SHARED) {
+                fail(var.sym->pos, "task_shared variables aren't supported in constexpr functions");
+                return CEFlow::Failed;
+            }
+            if (var.sym->storageClass == SC_SPECCONST) {
+                fail(var.sym->pos, "specconst variables aren't supported in constexpr functions");
+                return CEFlow::Failed;
+            }
+            CEValue value;
+            if (CastType<ReferenceType>(var.sym->type) != nullptr) {
+                value.type = var.sym->type;
+                value.ref = var.init ? location(var.init) : nullptr;
+                if (value.ref == nullptr) {
+                    fail(var.sym->pos, "reference \"" + var.sym->name + "\" must be initialized");
+                    return CEFlow::Failed;
+                }
+            } else if (var.init != nullptr ? !initialize(var.sym->type, var.init, value)
+                                           : !zero(var.sym->type, value, var.sym->pos)) {
+                return CEFlow::Failed;
+            }
+            frame->vars[var.sym] = std::move(value);
+        }
+        frame->temps.clear();
+        return CEFlow::Normal;
+    }
+
+    if (const IfStmt *is = llvm::dyn_cast<IfStmt>(stmt)) {
+        bool test;
+        if (!evalBool(is->test, test)) {
+            return CEFlow::Failed;
+        }
+        frame->temps.clear();
+        return exec(test ? is->trueStmts : is->falseStmts);
+    }
+
+    if (const ForStmt *fs = llvm::dyn_cast<ForStmt>(stmt)) {
+        if (exec(fs->init) == CEFlow::Failed) {
+            return CEFlow::Failed;
+        }
+        while (true) {
+            bool test = true;
+            if (fs->test != nullptr && !evalBool(fs->test, test)) {
+                return CEFlow::Failed;
+            }
+            frame->temps.clear();
+            if (!test) {
+                break;
+            }
+            CEFlow flow = exec(fs->stmts);
+            if (flow == CEFlow::Failed || flow == CEFlow::Return) {
+                return flow;
+            }
+            if (flow == CEFlow::Break) {
+                break;
+            }
+            if (exec(fs->step) == CEFlow::Failed) {
+                return CEFlow::Failed;
+            }
+        }
+        return CEFlow::Normal;
+    }
+
+    if (const DoStmt *dos = llvm::dyn_cast<DoStmt>(stmt)) {
+        while (true) {
+            CEFlow flow = exec(dos->bodyStmts);
+            if (flow == CEFlow::Failed || flow == CEFlow::Return) {
+                return flow;
+            }
+            if (flow == CEFlow::Break) {
+                break;
+            }
+            bool test;
+            if (!evalBool(dos->testExpr, test)) {
+                return CEFlow::Failed;
+            }
+            frame->temps.clear();
+            if (!test) {
+                break;
+            }
+        }
+        return CEFlow::Normal;
+    }
+
+    if (llvm::isa<BreakStmt>(stmt)) {
+        return CEFlow::Break;
+    }
+    if (llvm::isa<ContinueStmt>(stmt)) {
+        return CEFlow::Continue;
+    }
+
+    if (const ReturnStmt *rs = llvm::dyn_cast<ReturnStmt>(stmt)) {
+        if (rs->expr == nullptr) {
+            fail(stmt->pos, "constexpr function must return a value");
+            return CEFlow::Failed;
+        }
+        CEValue value;
+        if (!eval(rs->expr, value)) {
+            return CEFlow::Failed;
+        }
+        frame->result = std::move(value);
+        return CEFlow::Return;
+    }
+
+    fail(stmt->pos, "statement can't be evaluated at compile time");
+    return CEFlow::Failed;
+}
+
+bool ConstexprEvaluator::callFunction(const FunctionCallExpr *call, CEValue &out) {
+    const FunctionSymbolExpr *fse = llvm::dyn_cast<FunctionSymbolExpr>(call->func);
+    const Symbol *sym = fse ? fse->GetBaseSymbol() : nullptr;
+    const FunctionType *ftype = sym ? CastType<FunctionType>(sym->type) : nullptr;
+    if (ftype == nullptr || call->isLaunch || call->isInvoke || call->args == nullptr) {
+        return fail(call->pos, "only direct calls of functions can be evaluated at compile time");
+    }
+    const Function *func = sym->parentFunction;
+    bool isConstexpr = func != nullptr && func->IsConstexpr();
+    if (!isConstexpr && !lIsStdlibFunction(sym)) {
+        return fail(call->pos, "\"" + sym->name + "\" isn't a \"constexpr\" function defined before the call");
+    }
+
+    // The arguments are evaluated in the frame of the caller.
+    std::vector<CEValue> args(ftype->GetNumParameters());
+    std::vector<CEValue *> refs(ftype->GetNumParameters(), nullptr);
+    for (int i = 0; i < ftype->GetNumParameters(); ++i) {
+        const Expr *arg = i < (int)call->args->exprs.size() ? call->args->exprs[i] : ftype->GetParameterDefault(i);
+        if (arg == nullptr) {
+            return fail(call->pos, "missing argument of \"" + sym->name + "\"");
+        }
+        const Type *paramType = ftype->GetParameterType(i);
+        if (CastType<ReferenceType>(paramType) != nullptr) {
+            refs[i] = location(arg);
+            if (refs[i] == nullptr) {
+                return false;
+            }
+        } else {
+            CEValue value;
+            if (!eval(arg, value) || !convert(value, paramType, args[i], arg->pos)) {
+                return false;
+            }
+        }
+    }
+
+    if (!isConstexpr) {
+        return callStdlib(sym, args, ftype->GetReturnType(), call->pos, out);
+    }
+    if (depth >= lMaxConstexprDepth) {
+        return fail(call->pos, "the nesting of calls is deeper than " + std::to_string(lMaxConstexprDepth));
+    }
+
+    CEFrame frame;
+    const std::vector<Symbol *> &params = func->GetParameterSymbols();
+    for (size_t i = 0; i < params.size() && i < args.size(); ++i) {
+        if (params[i] == nullptr) {
+            continue;
+        }
+        if (refs[i] != nullptr) {
+            frame.vars[params[i]].type = params[i]->type;
+            frame.vars[params[i]].ref = refs[i];
+        } else {
+            frame.vars[params[i]] = std::move(args[i]);
+        }
+    }
+
+    frames.push_back(&frame);
+    ++depth;
+    CEFlow flow = exec(func->GetCode());
+    --depth;
+    frames.pop_back();
+
+    if (flow == CEFlow::Failed) {
+        return false;
+    }
+    if (flow != CEFlow::Return) {
+        return fail(call->pos, "\"" + sym->name + "\" ended without returning a value");
+    }
+    return convert(frame.result, ftype->GetReturnType(), out, call->pos);
+}
+
+/** Evaluate the math functions of the standard library with the host C
+    library. */
+bool ConstexprEvaluator::callStdlib(const Symbol *sym, const std::vector<CEValue> &args, const Type *retType,
+                                    SourcePos pos, CEValue &out) {
+    const std::string &name = sym->name;
+    AtomicType::BasicType bt = lBasicType(retType);
+    auto unsupported = [&]() {
+        return fail(pos, "standard library function \"" + name + "\" can't be evaluated at compile time");
+    };
+    if (!retType->IsUniformType() || !lIsScalar(bt) || bt == AtomicType::TYPE_BOOL || args.empty()) {
+        return unsupported();
+    }
+    for (const CEValue &arg : args) {
+        if (lBasicType(arg.type) != bt) {
+            return unsupported();
+        }
+    }
+
+    CEValue result;
+    result.type = retType;
+    if (lIsFloat(bt)) {
+        static const std::map<std::string, double (*)(double)> unary = {
+            {"sqrt", [](double x) { return std::sqrt(x); }},
+            {"rsqrt", [](double x) { return 1. / std::sqrt(x); }},
+            {"rcp", [](double x) { return 1. / x; }},
+            {"exp", [](double x) { return std::exp(x); }},
+            {"log", [](double x) { return std::log(x); }},
+            {"sin", [](double x) { return std::sin(x); }},
+            {"cos", [](double x) { return std::cos(x); }},
+            {"tan", [](double x) { return std::tan(x); }},
+            {"asin", [](double x) { return std::asin(x); }},
+            {"acos", [](double x) { return std::acos(x); }},
+            {"atan", [](double x) { return std::atan(x); }},
+            {"floor", [](double x) { return std::floor(x); }},
+            {"ceil", [](double x) { return std::ceil(x); }},
+            {"round", [](double x) { return std::nearbyint(x); }},
+            {"trunc", [](double x) { return std::trunc(x); }},
+            {"abs", [](double x) { return std::fabs(x); }},
+        };
+        auto it = unary.find(name);
+        if (it != unary.end() && args.size() == 1) {
+            result.fp = it->second(args[0].fp);
+        } else if (name == "pow" && args.size() == 2) {
+            result.fp = std::pow(args[0].fp, args[1].fp);
+        } else if (name == "atan2" && args.size() == 2) {
+            result.fp = std::atan2(args[0].fp, args[1].fp);
+        } else if (name == "min" && args.size() == 2) {
+            result.fp = args[0].fp < args[1].fp ? args[0].fp : args[1].fp;
+        } else if (name == "max" && args.size() == 2) {
+            result.fp = args[0].fp > args[1].fp ? args[0].fp : args[1].fp;
+        } else if (name == "clamp" && args.size() == 3) {
+            double x = args[0].fp > args[1].fp ? args[0].fp : args[1].fp;
+            result.fp = x < args[2].fp ? x : args[2].fp;
+        } else {
+            return unsupported();
+        }
+    } else {
+        bool isSigned = lIsSigned(bt);
+        auto less = [isSigned](uint64_t a, uint64_t b) { return isSigned ? (int64_t)a < (int64_t)b : a < b; };
+        if (name == "abs" && args.size() == 1) {
+            result.bits = isSigned && (int64_t)args[0].bits < 0 ? 0 - args[0].bits : args[0].bits;
+        } else if (name == "min" && args.size() == 2) {
+            result.bits = less(args[0].bits, args[1].bits) ? args[0].bits : args[1].bits;
+        } else if (name == "max" && args.size() == 2) {
+            result.bits = less(args[1].bits, args[0].bits) ? args[0].bits : args[1].bits;
+        } else if (name == "clamp" && args.size() == 3) {
+            uint64_t x = less(args[0].bits, args[1].bits) ? args[1].bits : args[0].bits;
+            result.bits = less(args[2].bits, x) ? args[2].bits : x;
+        } else {
+            return unsupported();
+        }
+    }
+    lNormalize(result);
+    out = result;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+Expr *ispc::EvaluateConstexprCall(const FunctionCallExpr *call, bool reportErrors) {
+    if (call == nullptr || call->func == nullptr || call->args == nullptr) {
+        return nullptr;
+    }
+    const FunctionSymbolExpr *fse = llvm::dyn_cast<FunctionSymbolExpr>(call->func);
+    const Symbol *sym = fse ? fse->GetBaseSymbol() : nullptr;
+    const Function *func = sym ? sym->parentFunction : nullptr;
+    if (!reportErrors) {
+        // Without diagnostics, only the calls with constant arguments are
+        // tried, which is the case the folding of expressions is after.
+        if (func == nullptr || !func->IsConstexpr() || call->isLaunch || call->isInvoke) {
+            return nullptr;
+        }
+        for (const Expr *arg : call->args->exprs) {
+            if (!llvm::isa<ConstExpr>(arg)) {
+                return nullptr;
+            }
+        }
+    }
+
+    ConstexprEvaluator evaluator;
+    CEValue result;
+    if (!evaluator.Call(call, result)) {
+        if (reportErrors) {
+            Error(evaluator.failPos, "Can't evaluate call of \"%s\" at compile time: %s.",
+                  sym ? sym->name.c_str() : "function", evaluator.failReason.c_str());
+        }
+        return nullptr;
+    }
+    return lValueToExpr(result, CastType<FunctionType>(sym->type)->GetReturnType(), call->pos);
+}
@@ -0,0 +1,33 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file constexpr.h
+    @brief Compile-time evaluation of the calls of "constexpr" functions.
+*/
+
+#pragma once
+
+namespace ispc {
+
+class Expr;
+class FunctionCallExpr;
+class Type;
+
+/** Returns true if values of the given type can be computed at compile
+    time: uniform atomic and enum types, and uniform structs and arrays of
+    them.  These are the types allowed for the parameters (also as
+    references) and the return value of "constexpr" functions. */
+bool IsConstexprType(const Type *type);
+
+/** Evaluate the call of a "constexpr" function with constant arguments by
+    interpreting the AST of its body.  Returns a ConstExpr for atomic and
+    enum return types and an ExprList of constants for structs and arrays,
+    or nullptr if the call can't be evaluated at compile time.  In the
+    latter case, the reason is reported with Error() if \c reportErrors is
+    true. */
+Expr *EvaluateConstexprCall(const FunctionCallExpr *call, bool reportErrors);
+
+} // namespace ispc
@@ -23,6 +23,7 @@
 
 #include <llvm/BinaryFormat/Dwarf.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
@@ -235,6 +236,7 @@ FunctionEmitContext::FunctionEmitContext(const Function *func, Symbol *funSym, l
     llvm::BranchInst::Create(bblock, allocaBlock);
 
     funcStartPos = funSym->pos;
+    funcName = funSym->name;
 
     internalMaskAddressInfo = AllocaInst(LLVMTypes::MaskType, "internal_mask_memory");
     StoreInst(LLVMMaskAllOn, internalMaskAddressInfo);
@@ -267,6 +269,8 @@ FunctionEmitContext::FunctionEmitContext(const Function *func, Symbol *funSym, l
     launchedTasks = false;
     launchGroupHandleAddressInfo = AllocaInst(LLVMTypes::VoidPointerType, "launch_group_handle");
     StoreInst(llvm::Constant::getNullValue(LLVMTypes::VoidPointerType), launchGroupHandleAddressInfo);
+    taskResultPtr = nullptr;
+    scratchHandle = nullptr;
 
     disableGSWarningCount = 0;
 
@@ -1250,6 +1254,16 @@ void FunctionEmitContext::DisableGatherScatterWarnings() { ++disableGSWarningCou
 
 void FunctionEmitContext::EnableGatherScatterWarnings() { --disableGSWarningCount; }
 
+void FunctionEmitContext::PushExpectations(unsigned int flags) {
+    unsigned int enclosingFlags = expectationsStack.empty() ? 0 : expectationsStack.back();
+    expectationsStack.push_back(enclosingFlags | flags);
+}
+
+void FunctionEmitContext::PopExpectations() {
+    Assert(!expectationsStack.empty());
+    expectationsStack.pop_back();
+}
+
 bool FunctionEmitContext::initLabelBBlocks(ASTNode *node, void *data) {
     LabeledStmt *ls = llvm::dyn_cast<LabeledStmt>(node);
     if (ls == nullptr) {
@@ -1504,38 +1518,62 @@ llvm::Value *FunctionEmitContext::I1VecToBoolVec(llvm::Value *b) {
     }
 }
 
-static llvm::Value *lGetStringAsValue(llvm::BasicBlock *bblock, const char *s) {
-    llvm::Constant *sConstant = llvm::ConstantDataArray::getString(*g->ctx, s, true);
-    std::string var_name = "_";
-    var_name = var_name + s;
-    llvm::GlobalVariable *sPtr =
-        new llvm::GlobalVariable(*m->module, sConstant->getType(), true /* const */, llvm::GlobalValue::InternalLinkage,
-                                 sConstant, var_name.c_str());
-    llvm::Value *indices[2] = {LLVMInt32(0), LLVMInt32(0)};
-    llvm::ArrayRef<llvm::Value *> arrayRef(&indices[0], &indices[2]);
-    return llvm::GetElementPtrInst::Create(sPtr->getValueType(), sPtr, arrayRef, "sptr", bblock);
-}
-
 void FunctionEmitContext::AddInstrumentationPoint(const char *note) {
     AssertPos(currentPos, note != nullptr);
-    if (!g->emitInstrumentation) {
+    if (!g->emitInstrumentation && !g->emitLaneProfile) {
+        return;
+    }
+
+    if (g->emitLaneProfile) {
+        // Only the site and the mask are recorded, the sampler reads them.
+        storeLaneProfileState(m->GetInstrumentationTable(),
+                              LLVMInt32(m->AddInstrumentationSite(currentPos, funcName, note)),
+                              LaneMask(GetFullMask()));
         return;
     }
 
+    // The source position and the note are not passed with every call, but
+    // recorded in the table of the instrumentation sites of the module.
     std::vector<llvm::Value *> args;
-    // arg 1: filename as string
-    args.push_back(lGetStringAsValue(bblock, currentPos.name));
-    // arg 2: provided note
-    args.push_back(lGetStringAsValue(bblock, note));
-    // arg 3: line number
-    args.push_back(LLVMInt32(currentPos.first_line));
-    // arg 4: current mask, movmsk'ed down to an int64
+    // arg 1: table of the sites of the module
+    args.push_back(m->GetInstrumentationTable());
+    // arg 2: ID of the site in the table
+    args.push_back(LLVMInt32(m->AddInstrumentationSite(currentPos, funcName, note)));
+    // arg 3: current mask, movmsk'ed down to an int64
     args.push_back(LaneMask(GetFullMask()));
 
     llvm::Function *finst = m->module->getFunction(builtin::ISPCInstrument);
     CallInst(finst, nullptr, args, "");
 }
 
+// The stores and the loads are volatile, so they are neither merged nor
+// dropped: the state is read asynchronously by the signal handler of the
+// profiler.
+void FunctionEmitContext::storeLaneProfileState(llvm::Value *sites, llvm::Value *id, llvm::Value *mask) {
+    llvm::GlobalVariable *state = m->GetLaneProfileState();
+    llvm::Value *fields[3] = {sites, id, mask};
+    for (int i = 0; i < 3; ++i) {
+        llvm::Value *indices[2] = {LLVMInt32(0), LLVMInt32(i)};
+        llvm::Value *ptr =
+            llvm::GetElementPtrInst::CreateInBounds(state->getValueType(), state, indices, "lane_profile_ptr", bblock);
+        new llvm::StoreInst(fields[i], ptr, true /* volatile */, bblock);
+    }
+}
+
+void FunctionEmitContext::SaveLaneProfileState() {
+    if (!g->emitLaneProfile) {
+        return;
+    }
+    llvm::GlobalVariable *state = m->GetLaneProfileState();
+    llvm::StructType *type = llvm::cast<llvm::StructType>(state->getValueType());
+    for (int i = 0; i < 3; ++i) {
+        llvm::Value *indices[2] = {LLVMInt32(0), LLVMInt32(i)};
+        llvm::Value *ptr = llvm::GetElementPtrInst::CreateInBounds(type, state, indices, "lane_profile_ptr", bblock);
+        savedLaneProfileState[i] =
+            new llvm::LoadInst(type->getElementType(i), ptr, "lane_profile_saved", true /* volatile */, bblock);
+    }
+}
+
 void FunctionEmitContext::SetDebugPos(SourcePos pos) { currentPos = pos; }
 
 SourcePos FunctionEmitContext::GetDebugPos() const { return currentPos; }
@@ -2793,6 +2831,20 @@ void FunctionEmitContext::addGSMetadata(llvm::Value *v, SourcePos pos) {
     inst->setMetadata("last_column", md);
 }
 
+/** Add metadata to the given call with the '#pragma ispc expect_no_*'
+    flags of the code that it is in and its source file position.  This
+    data is used by CheckExpectationsPass.
+*/
+void FunctionEmitContext::addExpectMetadata(llvm::Instruction *inst, unsigned int flags, SourcePos pos) {
+    llvm::Metadata *md[] = {llvm::ConstantAsMetadata::get(LLVMInt32(flags)),
+                            llvm::MDString::get(*g->ctx, pos.name),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.first_line)),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.first_column)),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.last_line)),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.last_column))};
+    inst->setMetadata("ispc_expect", llvm::MDNode::get(*g->ctx, md));
+}
+
 llvm::Value *FunctionEmitContext::AddrSpaceCastInst(llvm::Value *val, AddressSpace as, bool atEntryBlock) {
     Assert(llvm::isa<llvm::PointerType>(val->getType()));
     llvm::PointerType *pt = llvm::dyn_cast<llvm::PointerType>(val->getType());
@@ -3023,7 +3075,12 @@ void FunctionEmitContext::maskedStore(llvm::Value *value, llvm::Value *ptr, cons
     args.push_back(value);
     args.push_back(mask);
 
-    CallInst(maskedStoreFunc, nullptr, args);
+    llvm::Value *inst = CallInst(maskedStoreFunc, nullptr, args);
+
+    // The source position is used by the optimization report.
+    if (disableGSWarningCount == 0) {
+        addGSMetadata(inst, currentPos);
+    }
 }
 
 /** Scatter the given varying value to the locations given by the varying
@@ -3295,10 +3352,17 @@ void FunctionEmitContext::setLoopUnrollMetadata(llvm::Instruction *inst,
 #endif
     );
     Args.push_back(TempNode.get());
-    if (loopAttribute.first == Globals::pragmaUnrollType::count) {
+    if (loopAttribute.first == Globals::pragmaUnrollType::count ||
+        loopAttribute.first == Globals::pragmaUnrollType::countReductions) {
         llvm::Metadata *Vals[] = {llvm::MDString::get(*g->ctx, "llvm.loop.unroll.count"),
                                   llvm::ConstantAsMetadata::get(LLVMInt32(loopAttribute.second))};
         Args.push_back(llvm::MDNode::get(*g->ctx, Vals));
+        if (loopAttribute.first == Globals::pragmaUnrollType::countReductions) {
+            // Used by SplitReductionsPass after the loop has been unrolled.
+            llvm::Metadata *SplitVals[] = {llvm::MDString::get(*g->ctx, "ispc.loop.split_reductions"),
+                                           llvm::ConstantAsMetadata::get(LLVMInt32(loopAttribute.second))};
+            Args.push_back(llvm::MDNode::get(*g->ctx, SplitVals));
+        }
     } else if (loopAttribute.first == Globals::pragmaUnrollType::unroll) {
         llvm::Metadata *Vals[] = {llvm::MDString::get(*g->ctx, "llvm.loop.unroll.enable")};
         Args.push_back(llvm::MDNode::get(*g->ctx, Vals));
@@ -3564,6 +3628,9 @@ llvm::Value *FunctionEmitContext::CallInst(llvm::Value *func, const FunctionType
         }
 
         AddDebugPos(ci);
+        if (!expectationsStack.empty() && expectationsStack.back() != 0) {
+            addExpectMetadata(ci, expectationsStack.back(), currentPos);
+        }
         return ci;
     } else {
         // Emit the code for a varying function call, where we have an
@@ -3618,9 +3685,52 @@ llvm::Value *FunctionEmitContext::CallInst(llvm::Value *func, const FunctionType
         // Mask wasn't initialized
         Assert(oldFullMask != nullptr && "Mask is not initialized");
 
-        // And now we branch to the test to see if there's more work to be
-        // done.
-        BranchInst(bbTest);
+        if (emitXeHardwareMask()) {
+            // And now we branch to the test to see if there's more work to
+            // be done.
+            BranchInst(bbTest);
+        } else {
+            // The running program instances usually all have the same
+            // function pointer, so check for that first and then call the
+            // function just once with the current mask, without the loop
+            // below and the masked stores of its results.
+            llvm::BasicBlock *bbCoherent = CreateBasicBlock("varying_funcall_coherent", GetCurrentBasicBlock());
+            llvm::Function *cttz = m->module->getFunction(builtin::__count_trailing_zeros_i64);
+            AssertPos(currentPos, cttz != nullptr);
+            llvm::Value *firstLane64 = CallInst(cttz, nullptr, LaneMask(oldFullMask), "first_active_lane64");
+            llvm::Value *firstLane = TruncInst(firstLane64, LLVMTypes::Int32Type, "first_active_lane32");
+            // The lane is out of range when no program instances are
+            // running, which is checked below.
+            firstLane = BinaryOperator(llvm::Instruction::And, firstLane, LLVMInt32(g->target->getVectorWidth() - 1),
+                                       WrapSemantics::None, "first_active_lane");
+            llvm::Value *fptr = llvm::ExtractElementInst::Create(func, firstLane, "first_fptr", bblock);
+            llvm::Value *sameFptr =
+                CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, SmearUniform(fptr, "first_fptr"), func);
+            sameFptr = I1VecToBoolVec(sameFptr);
+            // sameOrOff = sameFptr | ~oldFullMask
+            llvm::Value *notFullMask = BinaryOperator(llvm::Instruction::Xor, oldFullMask, LLVMMaskAllOn,
+                                                      WrapSemantics::None, "~oldFullMask");
+            llvm::Value *sameOrOff =
+                BinaryOperator(llvm::Instruction::Or, sameFptr, notFullMask, WrapSemantics::None, "same_fptr");
+            llvm::Value *coherent = BinaryOperator(llvm::Instruction::And, Any(oldFullMask), All(sameOrOff),
+                                                   WrapSemantics::None, "coherent_fptr");
+            BranchInst(bbCoherent, bbTest, coherent);
+
+            SetCurrentBasicBlock(bbCoherent);
+            {
+                llvm::Type *llvmFuncType = funcType->LLVMFunctionType(g->ctx);
+                llvm::Type *llvmFPtrType = llvm::PointerType::get(llvmFuncType, 0);
+                llvm::Value *fptrCast = IntToPtrInst(fptr, llvmFPtrType);
+                llvm::Value *callResult = CallInst(fptrCast, funcType, args, name);
+                // The values of the program instances that aren't running
+                // don't matter, so the result is stored as a whole.
+                if (callResult != nullptr && callResult->getType() != LLVMTypes::VoidType) {
+                    AssertPos(currentPos, resultPtrInfo != nullptr);
+                    StoreInst(callResult, resultPtrInfo);
+                }
+                BranchInst(bbDone);
+            }
+        }
 
         // bbTest: are any lanes of the mask still on?  If so, jump to
         // bbCall
@@ -3750,6 +3860,9 @@ llvm::Instruction *FunctionEmitContext::ReturnInst() {
     if (launchedTasks) {
         // Add a sync call at the end of any function that launched tasks
         SyncInst();
+        for (AddressInfo *groupHandle : taskGroupHandles) {
+            SyncInst(groupHandle);
+        }
     }
 
 #ifdef ISPC_XE_ENABLED
@@ -3769,12 +3882,23 @@ llvm::Instruction *FunctionEmitContext::ReturnInst() {
     if (functionFTZ_DAZValue != nullptr) {
         RestoreFunctionFTZ_DAZFlags();
     }
+    // The samples after the return belong to the caller.
+    if (savedLaneProfileState[0] != nullptr) {
+        storeLaneProfileState(savedLaneProfileState[0], savedLaneProfileState[1], savedLaneProfileState[2]);
+    }
     llvm::Instruction *rinst = nullptr;
     if (returnValueAddressInfo != nullptr) {
         // We have value(s) to return; load them from their storage
         // location
         llvm::Value *retVal = LoadInst(returnValueAddressInfo, function->GetReturnType(), "return_value");
-        rinst = llvm::ReturnInst::Create(*g->ctx, retVal, bblock);
+        if (taskResultPtr != nullptr) {
+            // Tasks return their value through the array of the results
+            // of the "reduce" clause of the launch.
+            StoreInst(retVal, new AddressInfo(taskResultPtr, function->GetReturnType()));
+            rinst = llvm::ReturnInst::Create(*g->ctx, bblock);
+        } else {
+            rinst = llvm::ReturnInst::Create(*g->ctx, retVal, bblock);
+        }
     } else {
         AssertPos(currentPos, function->GetReturnType()->IsVoidType());
         rinst = llvm::ReturnInst::Create(*g->ctx, bblock);
@@ -3785,8 +3909,28 @@ llvm::Instruction *FunctionEmitContext::ReturnInst() {
     return rinst;
 }
 
+/** Returns the type of the block of the arguments of the launches of the
+    task function of type \p funcType, which is what the first parameter of
+    the task function points to. */
+static llvm::StructType *lLaunchArgStructType(const FunctionType *funcType) {
+    std::vector<llvm::Type *> llvmArgTypes = funcType->LLVMFunctionArgTypes(g->ctx);
+    return llvm::StructType::get(*g->ctx, llvmArgTypes);
+}
+
+/** The alignment of the blocks of the arguments of the launches. */
+static int lLaunchArgAlignment() { return 4 * RoundUpPow2(g->target->getNativeVectorWidth()); }
+
+/** Returns the distance in bytes between the consecutive argument blocks of
+    a fused launch, which are allocated as a single array. */
+static uint64_t lLaunchArgStride(llvm::StructType *argStructType) {
+    uint64_t size = g->target->getDataLayout()->getTypeAllocSize(argStructType);
+    uint64_t align = lLaunchArgAlignment();
+    return (size + align - 1) / align * align;
+}
+
 llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<llvm::Value *> &argVals,
-                                             llvm::Value *launchCount[3], const FunctionType *funcType) {
+                                             llvm::Value *launchCount[3], const FunctionType *funcType,
+                                             AddressInfo *groupHandle, llvm::Value *results) {
     if (g->target->isXeTarget()) {
         Error(currentPos, "\"launch\" keyword is not supported for Xe targets");
         return nullptr;
@@ -3803,35 +3947,81 @@ llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<ll
         return nullptr;
     }
 
+    if (groupHandle == nullptr) {
+        groupHandle = launchGroupHandleAddressInfo;
+    }
+
+    llvm::Value *voidmem = LaunchAllocInst(funcType, nullptr, groupHandle);
+    LaunchArgsInst(voidmem, nullptr, funcType, argVals, results);
+
+    // And emit the call to the user-supplied task launch function, passing
+    // a pointer to the task function being called and a pointer to the
+    // argument block we just filled in
+    llvm::Value *fptr = BitCastInst(callee, LLVMTypes::VoidPointerType);
+    llvm::Function *flaunch = m->module->getFunction(builtin::ISPCLaunch);
+    AssertPos(currentPos, flaunch != nullptr);
+    std::vector<llvm::Value *> args;
+    args.push_back(groupHandle->getPointer());
+    args.push_back(fptr);
+    args.push_back(voidmem);
+    args.push_back(launchCount[0]);
+    args.push_back(launchCount[1]);
+    args.push_back(launchCount[2]);
+    return CallInst(flaunch, nullptr, args, "");
+}
+
+llvm::Value *FunctionEmitContext::LaunchAllocInst(const FunctionType *funcType, llvm::Value *count,
+                                                  AddressInfo *groupHandle) {
     launchedTasks = true;
+    if (groupHandle == nullptr) {
+        groupHandle = launchGroupHandleAddressInfo;
+    }
 
     AssertPos(currentPos, funcType != nullptr);
-    llvm::Type *llvmFuncType = funcType->LLVMFunctionType(g->ctx);
     AssertPos(currentPos, funcType->LLVMFunctionType(g->ctx)->getFunctionNumParams() > 0);
-    llvm::Type *argType = llvmFuncType->getFunctionParamType(0);
-    AssertPos(currentPos, llvm::PointerType::classof(argType));
-
-    llvm::PointerType *pt = llvm::dyn_cast<llvm::PointerType>(argType);
-    AssertPos(currentPos, pt);
-    std::vector<llvm::Type *> llvmArgTypes = funcType->LLVMFunctionArgTypes(g->ctx);
-    llvm::StructType *argStructType = llvm::StructType::get(*g->ctx, llvmArgTypes);
+    llvm::StructType *argStructType = lLaunchArgStructType(funcType);
     AssertPos(currentPos, argStructType != nullptr);
 
     llvm::Function *falloc = m->module->getFunction(builtin::ISPCAlloc);
     AssertPos(currentPos, falloc != nullptr);
-    llvm::Value *structSize = g->target->SizeOf(argStructType, bblock);
-    if (structSize->getType() != LLVMTypes::Int64Type) {
-        // ISPCAlloc expects the size as an uint64_t, but on 32-bit
-        // targets, SizeOf returns a 32-bit value
-        structSize = ZExtInst(structSize, LLVMTypes::Int64Type, "struct_size_to_64");
+    llvm::Value *structSize = nullptr;
+    if (count == nullptr) {
+        structSize = g->target->SizeOf(argStructType, bblock);
+        if (structSize->getType() != LLVMTypes::Int64Type) {
+            // ISPCAlloc expects the size as an uint64_t, but on 32-bit
+            // targets, SizeOf returns a 32-bit value
+            structSize = ZExtInst(structSize, LLVMTypes::Int64Type, "struct_size_to_64");
+        }
+    } else {
+        llvm::Value *count64 = ZExtInst(count, LLVMTypes::Int64Type, "launch_count_to_64");
+        structSize = BinaryOperator(llvm::Instruction::Mul, count64, LLVMInt64(lLaunchArgStride(argStructType)),
+                                    WrapSemantics::None, "args_size");
     }
-    int align = 4 * RoundUpPow2(g->target->getNativeVectorWidth());
 
     std::vector<llvm::Value *> allocArgs;
-    allocArgs.push_back(launchGroupHandleAddressInfo->getPointer());
+    allocArgs.push_back(groupHandle->getPointer());
     allocArgs.push_back(structSize);
-    allocArgs.push_back(LLVMInt32(align));
-    llvm::Value *voidmem = CallInst(falloc, nullptr, allocArgs, "args_ptr");
+    allocArgs.push_back(LLVMInt32(lLaunchArgAlignment()));
+    return CallInst(falloc, nullptr, allocArgs, "args_ptr");
+}
+
+void FunctionEmitContext::LaunchArgsInst(llvm::Value *voidmem, llvm::Value *index, const FunctionType *funcType,
+                                         std::vector<llvm::Value *> &argVals, llvm::Value *results) {
+    llvm::Type *argType = funcType->LLVMFunctionType(g->ctx)->getFunctionParamType(0);
+    llvm::PointerType *pt = llvm::dyn_cast<llvm::PointerType>(argType);
+    AssertPos(currentPos, pt);
+    std::vector<llvm::Type *> llvmArgTypes = funcType->LLVMFunctionArgTypes(g->ctx);
+    llvm::StructType *argStructType = lLaunchArgStructType(funcType);
+
+    if (index != nullptr) {
+        // The argument blocks of a fused launch are consecutive elements
+        // of the array that LaunchAllocInst() allocated.
+        llvm::Value *index64 = ZExtInst(index, LLVMTypes::Int64Type, "launch_index_to_64");
+        llvm::Value *offset = BinaryOperator(llvm::Instruction::Mul, index64,
+                                             LLVMInt64(lLaunchArgStride(argStructType)), WrapSemantics::None,
+                                             "args_offset");
+        voidmem = GetElementPtrInst(voidmem, offset, PointerType::GetUniform(AtomicType::UniformInt8), "args_block");
+    }
     llvm::Value *argmem = BitCastInst(voidmem, pt);
 
     // Copy the values of the parameters into the appropriate place in
@@ -3843,36 +4033,102 @@ llvm::Value *FunctionEmitContext::LaunchInst(llvm::Value *callee, std::vector<ll
         StoreInst(argVals[i], new AddressInfo(ptr, llvmArgTypes[i]));
     }
 
-    if (argStructType->getNumElements() == argVals.size() + 1) {
+    // Tasks with a return value have the pointer to the array of the
+    // results as the last member of the argument block.
+    unsigned int numResults = funcType->GetReturnType()->IsVoidType() ? 0 : 1;
+    if (argStructType->getNumElements() == argVals.size() + numResults + 1) {
         // copy in the mask
         llvm::Value *mask = GetFullMask();
         llvm::Value *ptr = AddElementOffset(argmemInfo, argVals.size(), "funarg_mask");
         StoreInst(mask, new AddressInfo(ptr, LLVMTypes::MaskType));
     }
-
-    // And emit the call to the user-supplied task launch function, passing
-    // a pointer to the task function being called and a pointer to the
-    // argument block we just filled in
-    llvm::Value *fptr = BitCastInst(callee, LLVMTypes::VoidPointerType);
+    if (numResults > 0) {
+        AssertPos(currentPos, results != nullptr);
+        llvm::Value *ptr = AddElementOffset(argmemInfo, argStructType->getNumElements() - 1, "funarg_results");
+        StoreInst(results, new AddressInfo(ptr, LLVMTypes::VoidPointerType));
+    }
+}
+
+/** Returns the task function that runs the task with the indices
+    (taskIndex0, taskIndex1) of a fused launch of \p callee: it calls
+    \p callee with the argument block with the index taskIndex1 and the
+    task indices and counts of the one-dimensional launch whose tasks
+    taskIndex0 enumerates. */
+static llvm::Function *lGetFusedLaunchTask(llvm::Function *callee, llvm::StructType *argStructType) {
+    std::string name = callee->getName().str() + "___fused_launch";
+    llvm::Function *task = m->module->getFunction(name);
+    if (task != nullptr) {
+        return task;
+    }
+
+    llvm::FunctionType *calleeType = callee->getFunctionType();
+    std::vector<llvm::Type *> paramTypes(calleeType->param_begin(), calleeType->param_end());
+    paramTypes[0] = LLVMTypes::VoidPointerType;
+    llvm::FunctionType *taskType = llvm::FunctionType::get(LLVMTypes::VoidType, paramTypes, false);
+    task = llvm::Function::Create(taskType, llvm::GlobalValue::InternalLinkage, name, m->module);
+    g->target->markFuncWithTargetAttr(task);
+    task->addFnAttr(llvm::Attribute::NoUnwind);
+
+    llvm::BasicBlock *entry = llvm::BasicBlock::Create(*g->ctx, "entry", task);
+    llvm::IRBuilder<> builder(entry);
+    llvm::Value *params[11];
+    for (unsigned int i = 0; i < 11; ++i) {
+        params[i] = task->getArg(i);
+    }
+    // The parameters are (args, threadIndex, threadCount, taskIndex,
+    // taskCount, taskIndex0, taskIndex1, taskIndex2, taskCount0,
+    // taskCount1, taskCount2).
+    llvm::Value *offset = builder.CreateMul(builder.CreateZExt(params[6], LLVMTypes::Int64Type),
+                                            LLVMInt64(lLaunchArgStride(argStructType)), "args_offset");
+    llvm::Value *block = builder.CreateGEP(LLVMTypes::Int8Type, params[0], offset, "args_block");
+    std::vector<llvm::Value *> args = {builder.CreateBitCast(block, calleeType->getParamType(0)),
+                                       params[1],
+                                       params[2],
+                                       params[5],
+                                       params[8],
+                                       params[5],
+                                       LLVMInt32(0),
+                                       LLVMInt32(0),
+                                       params[8],
+                                       LLVMInt32(1),
+                                       LLVMInt32(1)};
+    llvm::CallInst *call = builder.CreateCall(calleeType, callee, args);
+    call->setCallingConv(callee->getCallingConv());
+    builder.CreateRetVoid();
+    return task;
+}
+
+llvm::Value *FunctionEmitContext::FusedLaunchInst(llvm::Function *callee, const FunctionType *funcType,
+                                                  llvm::Value *voidmem, llvm::Value *count0, llvm::Value *count1,
+                                                  AddressInfo *groupHandle) {
+    if (groupHandle == nullptr) {
+        groupHandle = launchGroupHandleAddressInfo;
+    }
+
+    llvm::Function *task = lGetFusedLaunchTask(callee, lLaunchArgStructType(funcType));
+    llvm::Value *fptr = BitCastInst(task, LLVMTypes::VoidPointerType);
     llvm::Function *flaunch = m->module->getFunction(builtin::ISPCLaunch);
     AssertPos(currentPos, flaunch != nullptr);
     std::vector<llvm::Value *> args;
-    args.push_back(launchGroupHandleAddressInfo->getPointer());
+    args.push_back(groupHandle->getPointer());
     args.push_back(fptr);
     args.push_back(voidmem);
-    args.push_back(launchCount[0]);
-    args.push_back(launchCount[1]);
-    args.push_back(launchCount[2]);
+    args.push_back(count0);
+    args.push_back(count1);
+    args.push_back(LLVMInt32(1));
     return CallInst(flaunch, nullptr, args, "");
 }
 
-void FunctionEmitContext::SyncInst() {
+void FunctionEmitContext::SyncInst(AddressInfo *groupHandle) {
     if (g->target->isXeTarget()) {
         Error(currentPos, "\"sync\" keyword is not supported for Xe targets");
         return;
     }
+    if (groupHandle == nullptr) {
+        groupHandle = launchGroupHandleAddressInfo;
+    }
 
-    llvm::Value *launchGroupHandle = LoadInst(launchGroupHandleAddressInfo);
+    llvm::Value *launchGroupHandle = LoadInst(groupHandle);
     llvm::Value *nullPtrValue = llvm::Constant::getNullValue(LLVMTypes::VoidPointerType);
     llvm::Value *nonNull = CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, launchGroupHandle, nullPtrValue);
     llvm::BasicBlock *bSync = CreateBasicBlock("call_sync");
@@ -3888,13 +4144,208 @@ void FunctionEmitContext::SyncInst() {
 
     // zero out the handle so that if ISPCLaunch is called again in this
     // function, it knows it's starting out from scratch
-    StoreInst(nullPtrValue, launchGroupHandleAddressInfo);
+    StoreInst(nullPtrValue, groupHandle);
 
-    BranchInst(bPostSync);
+    // The results of the reductions of the group are combined here, once
+    // all of the code of the function is emitted.
+    llvm::BasicBlock *bCombine = CreateBasicBlock("task_reduce");
+    BranchInst(bCombine);
+    taskReductionSyncs.push_back({groupHandle, bCombine, bPostSync});
 
     SetCurrentBasicBlock(bPostSync);
 }
 
+AddressInfo *FunctionEmitContext::AddTaskGroup(const char *name) {
+    if (g->target->isXeTarget()) {
+        Error(currentPos, "\"task_group\" is not supported for Xe targets");
+        return nullptr;
+    }
+
+    // The handle is initialized in the entry block, so that a group that is
+    // declared in a loop keeps the tasks of the earlier iterations until it
+    // is synchronized.
+    AddressInfo *groupHandle = AllocaInst(LLVMTypes::VoidPointerType, name);
+    new llvm::StoreInst(llvm::Constant::getNullValue(LLVMTypes::VoidPointerType), groupHandle->getPointer(),
+                        ISPC_INSERTION_POINT_INSTRUCTION(allocaBlock->getTerminator()));
+    taskGroupHandles.push_back(groupHandle);
+    return groupHandle;
+}
+
+llvm::Value *FunctionEmitContext::ScratchAllocInst(llvm::Value *size, const llvm::Twine &name) {
+    // The handle is synchronized at every return, like the ones of the
+    // named task groups, but a "sync" statement doesn't free the memory.
+    if (scratchHandle == nullptr) {
+        scratchHandle = AddTaskGroup("scratch_handle");
+        if (scratchHandle == nullptr) {
+            return nullptr;
+        }
+    }
+    launchedTasks = true;
+
+    llvm::Function *falloc = m->module->getFunction(builtin::ISPCAlloc);
+    AssertPos(currentPos, falloc != nullptr);
+    if (size->getType() != LLVMTypes::Int64Type) {
+        size = ZExtInst(size, LLVMTypes::Int64Type, "scratch_size_to_64");
+    }
+    std::vector<llvm::Value *> allocArgs = {scratchHandle->getPointer(), size, LLVMInt32(ScratchAlignment())};
+    return CallInst(falloc, nullptr, allocArgs, name);
+}
+
+int FunctionEmitContext::ScratchAlignment() const {
+    // This matches ISPC_MEMORY_ALIGNMENT_VAL of the stdlib.
+    if (g->forceAlignment != -1) {
+        return g->forceAlignment;
+    }
+    int width = g->target->getVectorWidth();
+    return width == 1 ? 16 : width * 4;
+}
+
+// The pending array of the results of a launch with a "reduce" clause: the
+// next array of the launch site, the pointer to the target of the
+// reduction, the number of tasks and their results.
+static llvm::StructType *lTaskReductionNodeType(llvm::Type *elementType) {
+    return llvm::StructType::get(*g->ctx, {LLVMTypes::VoidPointerType, LLVMTypes::VoidPointerType,
+                                           LLVMTypes::Int64Type, llvm::ArrayType::get(elementType, 0)});
+}
+
+llvm::Value *FunctionEmitContext::TaskReductionInst(AddressInfo *groupHandle, const Type *type, TaskReductionOp op,
+                                                    llvm::Value *target, llvm::Value *launchCount[3]) {
+    if (groupHandle == nullptr) {
+        groupHandle = launchGroupHandleAddressInfo;
+    }
+
+    // The list of the pending arrays of the launch site is empty at the
+    // entry of the function.
+    AddressInfo *listHead = AllocaInst(LLVMTypes::VoidPointerType, "reduce_list");
+    new llvm::StoreInst(llvm::Constant::getNullValue(LLVMTypes::VoidPointerType), listHead->getPointer(),
+                        ISPC_INSERTION_POINT_INSTRUCTION(allocaBlock->getTerminator()));
+    taskReductions.push_back({groupHandle, listHead, type, op});
+
+    llvm::Type *elementType = type->LLVMStorageType(g->ctx);
+    llvm::StructType *nodeType = lTaskReductionNodeType(elementType);
+    const llvm::DataLayout *dataLayout = g->target->getDataLayout();
+    uint64_t headerSize = dataLayout->getStructLayout(nodeType)->getElementOffset(3);
+    uint64_t elementSize = dataLayout->getTypeAllocSize(elementType);
+
+    llvm::Value *count = BinaryOperator(llvm::Instruction::Mul, launchCount[0], launchCount[1], WrapSemantics::None);
+    count = BinaryOperator(llvm::Instruction::Mul, count, launchCount[2], WrapSemantics::None);
+    count = ZExtInst(count, LLVMTypes::Int64Type, "reduce_count");
+    llvm::Value *size = BinaryOperator(llvm::Instruction::Mul, count, LLVMInt64(elementSize), WrapSemantics::None);
+    size = BinaryOperator(llvm::Instruction::Add, size, LLVMInt64(headerSize), WrapSemantics::None, "reduce_size");
+
+    llvm::Function *fnew = m->module->getFunction(g->target->is32Bit() ? builtin::__new_uniform_32rt
+                                                                         : builtin::__new_uniform_64rt);
+    AssertPos(currentPos, fnew != nullptr);
+    llvm::Value *node = CallInst(fnew, nullptr, size, "reduce_node");
+
+    AddressInfo *nodeInfo = new AddressInfo(node, nodeType);
+    StoreInst(LoadInst(listHead), new AddressInfo(AddElementOffset(nodeInfo, 0), LLVMTypes::VoidPointerType));
+    StoreInst(target, new AddressInfo(AddElementOffset(nodeInfo, 1), LLVMTypes::VoidPointerType));
+    StoreInst(count, new AddressInfo(AddElementOffset(nodeInfo, 2), LLVMTypes::Int64Type));
+    StoreInst(node, listHead);
+    return AddElementOffset(nodeInfo, 3, "reduce_results");
+}
+
+// Combine the values a and b of the uniform type with the operator of a
+// "reduce" clause.
+static llvm::Value *lTaskReductionCombine(FunctionEmitContext *ctx, const Type *type, TaskReductionOp op,
+                                          llvm::Value *a, llvm::Value *b) {
+    bool isFloat = type->IsFloatType();
+    switch (op) {
+    case TaskReductionOp::Add:
+        return ctx->BinaryOperator(isFloat ? llvm::Instruction::FAdd : llvm::Instruction::Add, a, b,
+                                   WrapSemantics::None);
+    case TaskReductionOp::Mul:
+        return ctx->BinaryOperator(isFloat ? llvm::Instruction::FMul : llvm::Instruction::Mul, a, b,
+                                   WrapSemantics::None);
+    case TaskReductionOp::Min:
+    case TaskReductionOp::Max: {
+        llvm::CmpInst::Predicate pred = isFloat                  ? llvm::CmpInst::FCMP_OLT
+                                        : type->IsUnsignedType() ? llvm::CmpInst::ICMP_ULT
+                                                                 : llvm::CmpInst::ICMP_SLT;
+        llvm::Value *less = ctx->CmpInst(isFloat ? llvm::Instruction::FCmp : llvm::Instruction::ICmp, pred, a, b);
+        return op == TaskReductionOp::Min ? ctx->SelectInst(less, a, b) : ctx->SelectInst(less, b, a);
+    }
+    }
+    UNREACHABLE();
+}
+
+void FunctionEmitContext::EmitTaskReductions() {
+    llvm::Value *nullPtrValue = llvm::Constant::getNullValue(LLVMTypes::VoidPointerType);
+    llvm::Function *fdelete = m->module->getFunction(g->target->is32Bit() ? builtin::__delete_uniform_32rt
+                                                                           : builtin::__delete_uniform_64rt);
+    for (const TaskReductionSync &sync : taskReductionSyncs) {
+        SetCurrentBasicBlock(sync.combine);
+        for (const TaskReduction &reduction : taskReductions) {
+            if (reduction.groupHandle != sync.groupHandle) {
+                continue;
+            }
+            // Walk the list of the pending arrays of the launch site and
+            // combine the results of every array into its target in the
+            // order of the task indices, so that floating-point reductions
+            // are reproducible.
+            AssertPos(currentPos, fdelete != nullptr);
+            const PointerType *ptrType = PointerType::GetUniform(reduction.type);
+            llvm::Type *elementType = reduction.type->LLVMStorageType(g->ctx);
+            llvm::StructType *nodeType = lTaskReductionNodeType(elementType);
+            AddressInfo *nodePtr = AllocaInst(LLVMTypes::VoidPointerType, "reduce_node_ptr");
+            AddressInfo *indexPtr = AllocaInst(LLVMTypes::Int64Type, "reduce_index");
+            AddressInfo *accPtr = AllocaInst(reduction.type, "reduce_acc");
+            StoreInst(LoadInst(reduction.listHead), nodePtr);
+            StoreInst(nullPtrValue, reduction.listHead);
+
+            llvm::BasicBlock *bNodeTest = CreateBasicBlock("reduce_node_test");
+            llvm::BasicBlock *bNode = CreateBasicBlock("reduce_node");
+            llvm::BasicBlock *bElementTest = CreateBasicBlock("reduce_element_test");
+            llvm::BasicBlock *bElement = CreateBasicBlock("reduce_element");
+            llvm::BasicBlock *bNodeDone = CreateBasicBlock("reduce_node_done");
+            llvm::BasicBlock *bDone = CreateBasicBlock("reduce_done");
+            BranchInst(bNodeTest);
+
+            SetCurrentBasicBlock(bNodeTest);
+            llvm::Value *node = LoadInst(nodePtr, nullptr, "reduce_node");
+            BranchInst(bNode, bDone, CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, node, nullPtrValue));
+
+            SetCurrentBasicBlock(bNode);
+            AddressInfo *nodeInfo = new AddressInfo(node, nodeType);
+            llvm::Value *target =
+                LoadInst(new AddressInfo(AddElementOffset(nodeInfo, 1), LLVMTypes::VoidPointerType), nullptr,
+                         "reduce_target");
+            AddressInfo *targetInfo = new AddressInfo(target, reduction.type);
+            StoreInst(LoadInst(targetInfo, reduction.type), accPtr, reduction.type);
+            StoreInst(LLVMInt64(0), indexPtr);
+            BranchInst(bElementTest);
+
+            SetCurrentBasicBlock(bElementTest);
+            llvm::Value *count =
+                LoadInst(new AddressInfo(AddElementOffset(nodeInfo, 2), LLVMTypes::Int64Type), nullptr, "reduce_count");
+            llvm::Value *index = LoadInst(indexPtr);
+            BranchInst(bElement, bNodeDone, CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_ULT, index, count));
+
+            SetCurrentBasicBlock(bElement);
+            llvm::Value *results = AddElementOffset(nodeInfo, 3, "reduce_results");
+            llvm::Value *elementPtr = GetElementPtrInst(results, index, ptrType, "reduce_result");
+            llvm::Value *value = LoadInst(new AddressInfo(elementPtr, reduction.type), reduction.type);
+            llvm::Value *acc = LoadInst(accPtr, reduction.type);
+            StoreInst(lTaskReductionCombine(this, reduction.type, reduction.op, acc, value), accPtr, reduction.type);
+            StoreInst(BinaryOperator(llvm::Instruction::Add, index, LLVMInt64(1), WrapSemantics::None), indexPtr);
+            BranchInst(bElementTest);
+
+            SetCurrentBasicBlock(bNodeDone);
+            StoreInst(LoadInst(accPtr, reduction.type), targetInfo, reduction.type);
+            llvm::Value *next = LoadInst(new AddressInfo(AddElementOffset(nodeInfo, 0), LLVMTypes::VoidPointerType),
+                                         nullptr, "reduce_next");
+            CallInst(fdelete, nullptr, node, "");
+            StoreInst(next, nodePtr);
+            BranchInst(bNodeTest);
+
+            SetCurrentBasicBlock(bDone);
+        }
+        BranchInst(sync.done);
+    }
+    taskReductionSyncs.clear();
+}
+
 /** When we gathering from or scattering to a varying atomic type, we need
     to add an appropriate offset to the final address for each lane right
     before we use it.  Given a varying pointer we're about to use and its
@@ -24,6 +24,9 @@ namespace ispc {
 
 struct CFInfo;
 
+/** The operators of the "reduce" clause of a "launch". */
+enum class TaskReductionOp { Add, Mul, Min, Max };
+
 ///////////////////////////////////////////////////////////////////////////
 /** AddressInfo is a helper class to work with pointers.
     It keeps llvm pointer, llvm element type, and ISPC type.
@@ -248,6 +251,16 @@ class FunctionEmitContext {
     /** Reenables emission of gather/scatter performance warnings. */
     void EnableGatherScatterWarnings();
 
+    /** Adds the given Globals::pragmaExpectType flags of a loop or function
+        with '#pragma ispc expect_no_*' to the ones that subsequent calls are
+        marked with, so that CheckExpectationsPass can check them after
+        optimization. */
+    void PushExpectations(unsigned int flags);
+
+    /** Restores the flags that calls were marked with before the matching
+        PushExpectations() call. */
+    void PopExpectations();
+
     void SetContinueTarget(llvm::BasicBlock *bb) { continueTarget = bb; }
 
     /** Step through the code and find label statements; create a basic
@@ -327,6 +340,10 @@ class FunctionEmitContext {
         this inserts a callback to the user-supplied instrumentation
         function at the current point in the code. */
     void AddInstrumentationPoint(const char *note);
+
+    /** With --lane-profile, saves the state of the lane profiler at the
+        function entry, so the returns restore it for the caller. */
+    void SaveLaneProfileState();
     /** @} */
 
     /** @name Debugging support
@@ -590,11 +607,74 @@ class FunctionEmitContext {
                           const llvm::Twine &name = "");
 
     /** Launch an asynchronous task to run the given function, passing it
-        he given argument values. */
+        he given argument values.  The task is added to the group of the
+        handle \p groupHandle, or to the default group of the function if
+        it is nullptr.  The tasks of functions with a return value store it
+        to the element taskIndex of the array \p results. */
     llvm::Value *LaunchInst(llvm::Value *callee, std::vector<llvm::Value *> &argVals, llvm::Value *launchCount[3],
-                            const FunctionType *funcType);
-
-    void SyncInst();
+                            const FunctionType *funcType, AddressInfo *groupHandle = nullptr,
+                            llvm::Value *results = nullptr);
+
+    /** Allocate the block of the arguments of a launch of the task function
+        of type \p funcType in the group of the handle \p groupHandle (or in
+        the default group).  If \p count is not nullptr, an array of \p count
+        such blocks is allocated for a fused launch, see FusedLaunchInst().
+        Returns the pointer to the memory, as a void pointer. */
+    llvm::Value *LaunchAllocInst(const FunctionType *funcType, llvm::Value *count, AddressInfo *groupHandle = nullptr);
+
+    /** Store the given argument values, the mask and the pointer to the
+        array of the results of the tasks (for tasks with a return value)
+        to the argument block at \p voidmem that LaunchAllocInst()
+        allocated, or to the block with the given index of the array of
+        them, if \p index is not nullptr. */
+    void LaunchArgsInst(llvm::Value *voidmem, llvm::Value *index, const FunctionType *funcType,
+                        std::vector<llvm::Value *> &argVals, llvm::Value *results = nullptr);
+
+    /** Launch the tasks of \p count1 launches of \p count0 tasks of the task
+        function \p callee as a single launch[count0, count1], given the
+        array of their argument blocks that LaunchAllocInst() allocated.
+        The task (i, j) runs the task i of the launch that gets the
+        arguments of the block j. */
+    llvm::Value *FusedLaunchInst(llvm::Function *callee, const FunctionType *funcType, llvm::Value *voidmem,
+                                 llvm::Value *count0, llvm::Value *count1, AddressInfo *groupHandle = nullptr);
+
+    /** Allocate the array of the results of the tasks of a "launch ...
+        reduce(op: target)" of launchCount tasks that return values of the
+        uniform type \p type.  The results are combined with \p op into the
+        value at the pointer \p target when the group of \p groupHandle (or
+        the default group) is synchronized.  Returns the pointer to the
+        array that is passed to LaunchInst(). */
+    llvm::Value *TaskReductionInst(AddressInfo *groupHandle, const Type *type, TaskReductionOp op, llvm::Value *target,
+                                   llvm::Value *launchCount[3]);
+
+    /** Emit the code that combines the results of the reductions at every
+        synchronization of the function.  This is called once all of the
+        code of the function is emitted, since a sync may precede the
+        launches of its group in the code, as in a loop. */
+    void EmitTaskReductions();
+
+    /** Set the pointer where the return value of the current task function
+        is stored for the "reduce" clause of its launch. */
+    void SetTaskResultPointer(llvm::Value *ptr) { taskResultPtr = ptr; }
+
+    /** Wait for the tasks of the group of the handle \p groupHandle, or of
+        the default group of the function if it is nullptr. */
+    void SyncInst(AddressInfo *groupHandle = nullptr);
+
+    /** Allocate the handle of the named task group \p name.  The group is
+        empty at the entry of the function and it is synchronized at every
+        return, like the default group. */
+    AddressInfo *AddTaskGroup(const char *name);
+
+    /** Allocate \p size bytes of the scratch memory of the function for a
+        "scratch new".  The memory comes from ISPCAlloc() with a task group
+        handle of its own, so that it's freed by the ISPCSync() of the
+        handle when the function returns. */
+    llvm::Value *ScratchAllocInst(llvm::Value *size, const llvm::Twine &name = "");
+
+    /** The alignment of the allocations of ScratchAllocInst(), which is the
+        one of the __new_*() builtins. */
+    int ScratchAlignment() const;
 
     llvm::Instruction *ReturnInst();
 
@@ -696,6 +776,17 @@ class FunctionEmitContext {
         for error messages and debugging symbols. */
     SourcePos funcStartPos;
 
+    /** Name of the function in the source.  Used for the instrumentation
+        sites. */
+    std::string funcName;
+
+    /** The fields of the lane profiler state at the function entry, which
+        are restored at the returns (see SaveLaneProfileState()). */
+    llvm::Value *savedLaneProfileState[3]{nullptr, nullptr, nullptr};
+
+    /** Stores the fields of the lane profiler state. */
+    void storeLaneProfileState(llvm::Value *sites, llvm::Value *id, llvm::Value *mask);
+
     /** If currently in a loop body or switch statement, the value of the
         mask at the start of it. */
     llvm::Value *blockEntryMask;
@@ -804,16 +895,53 @@ class FunctionEmitContext {
         tasks launched from the current function. */
     AddressInfo *launchGroupHandleAddressInfo;
 
+    /** The handles of the named task groups ("task_group") of the function. */
+    std::vector<AddressInfo *> taskGroupHandles;
+
+    /** A launch site with a "reduce" clause: the pending arrays of results
+        of its launches are linked in a list starting at listHead until the
+        group is synchronized. */
+    struct TaskReduction {
+        AddressInfo *groupHandle;
+        AddressInfo *listHead;
+        const Type *type;
+        TaskReductionOp op;
+    };
+    std::vector<TaskReduction> taskReductions;
+
+    /** The blocks after the ISPCSync() calls where the results of the
+        reductions of the group are combined, and the blocks that follow
+        them. */
+    struct TaskReductionSync {
+        AddressInfo *groupHandle;
+        llvm::BasicBlock *combine;
+        llvm::BasicBlock *done;
+    };
+    std::vector<TaskReductionSync> taskReductionSyncs;
+
+    /** For task functions launched with a "reduce" clause, the pointer
+        where the return value of the task is stored; nullptr otherwise. */
+    llvm::Value *taskResultPtr;
+
+    /** The task group handle of the scratch memory of the function, or
+        nullptr if it has no "scratch new". */
+    AddressInfo *scratchHandle;
+
     /** Nesting count of the number of times calling code has disabled (and
         not yet reenabled) gather/scatter performance warnings. */
     int disableGSWarningCount;
 
+    /** Stack of the '#pragma ispc expect_no_*' flags of the enclosing loops
+        and function; each entry includes the flags of the ones below. */
+    std::vector<unsigned int> expectationsStack;
+
     std::map<std::string, llvm::BasicBlock *> labelMap;
 
     static bool initLabelBBlocks(ASTNode *node, void *data);
 
     llvm::Value *pointerVectorToVoidPointers(llvm::Value *value);
     static void addGSMetadata(llvm::Value *inst, SourcePos pos);
+    static void addExpectMetadata(llvm::Instruction *inst, unsigned int flags, SourcePos pos);
     bool ifsInCFAllUniform(int cfType) const;
     void jumpIfAllLoopLanesAreDone(llvm::BasicBlock *target);
     llvm::Value *emitGatherCallback(llvm::Value *lvalue, llvm::Value *retPtr);
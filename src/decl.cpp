@@ -100,9 +100,15 @@ static void lPrintTypeQualifiers(int typeQualifiers) {
     if (typeQualifiers & TYPEQUAL_INLINE) {
         printf("inline ");
     }
+    if (typeQualifiers & TYPEQUAL_CONSTEXPR) {
+        printf("constexpr ");
+    }
     if (typeQualifiers & TYPEQUAL_CONST) {
         printf("const ");
     }
+    if (typeQualifiers & TYPEQUAL_RESTRICT) {
+        printf("restrict ");
+    }
     if (typeQualifiers & TYPEQUAL_UNIFORM) {
         printf("uniform ");
     }
@@ -138,6 +144,15 @@ static const Type *lApplyTypeQualifiers(int typeQualifiers, const Type *type, So
         type = type->GetAsConstType();
     }
 
+    if ((typeQualifiers & TYPEQUAL_RESTRICT) != 0) {
+        if (const PointerType *pt = CastType<PointerType>(type)) {
+            type = pt->GetAsRestrict();
+        } else {
+            Error(pos, "\"restrict\" qualifier is illegal with non-pointer type \"%s\".",
+                  type->ResolveUnboundVariability(Variability::Varying)->GetString().c_str());
+        }
+    }
+
     if (((typeQualifiers & TYPEQUAL_UNIFORM) != 0) && ((typeQualifiers & TYPEQUAL_VARYING) != 0)) {
         Error(pos, "Type \"%s\" cannot be qualified with both uniform and varying.", type->GetString().c_str());
     }
@@ -214,7 +229,8 @@ Attribute::Attribute(const Attribute &a) : name(a.name), arg(a.arg) {}
 bool Attribute::IsKnownAttribute() const {
     // Known/supported attributes.
     static std::unordered_set<std::string> lKnownParamAttrs = {"noescape", "address_space", "unmangled",
-                                                               "memory",   "cdecl",         "external_only"};
+                                                               "memory",   "cdecl",         "external_only",
+                                                               "width",    "optimize",      "batch"};
 
     if (lKnownParamAttrs.find(name) != lKnownParamAttrs.end()) {
         return true;
@@ -423,6 +439,10 @@ static const char *lGetStorageClassName(StorageClass storageClass) {
         return "static";
     case SC_TYPEDEF:
         return "typedef";
+    case SC_TASK_SHARED:
+        return "task_shared";
+    case SC_SPECCONST:
+        return "specconst";
     default:
         FATAL("Unhandled storage class in lGetStorageClassName");
         return "";
@@ -610,6 +630,7 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
     bool hasUniformQual = ((typeQualifiers & TYPEQUAL_UNIFORM) != 0);
     bool hasVaryingQual = ((typeQualifiers & TYPEQUAL_VARYING) != 0);
     bool isConst = ((typeQualifiers & TYPEQUAL_CONST) != 0);
+    bool isRestrict = ((typeQualifiers & TYPEQUAL_RESTRICT) != 0);
 
     if (hasUniformQual && hasVaryingQual) {
         Error(pos, "Can't provide both \"uniform\" and \"varying\" qualifiers.");
@@ -635,7 +656,8 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
         /* For now, any pointer to an SOA type gets the slice property; if
            we add the capability to declare pointers as slices or not,
            we'll want to set this based on a type qualifier here. */
-        const Type *ptrType = new PointerType(baseType, variability, isConst, baseType->IsSOAType());
+        const Type *ptrType = new PointerType(baseType, variability, isConst, baseType->IsSOAType(), false,
+                                              AddressSpace::ispc_default, isRestrict);
         if (child != nullptr) {
             child->InitFromType(ptrType, ds);
             type = child->type;
@@ -656,6 +678,10 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
             Error(pos, "\"const\" qualifier is to illegal apply to references.");
             return;
         }
+        if (isRestrict) {
+            Error(pos, "\"restrict\" qualifier is illegal to apply to references.");
+            return;
+        }
         // The parser should disallow this already, but double check.
         if (CastType<ReferenceType>(baseType) != nullptr) {
             Error(pos, "References to references are illegal.");
@@ -832,6 +858,20 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
             return;
         }
 
+        int vectorWidth = 0;
+        if (ds && ds->attributeList && ds->attributeList->HasAttribute("width")) {
+            const AttrArgument &arg = ds->attributeList->GetAttribute("width")->arg;
+            vectorWidth = arg.kind == ATTR_ARG_UINT32 ? (int)arg.intVal : 0;
+            if (!isExported) {
+                Error(pos, "\"width\" attribute is only valid for exported functions.");
+                return;
+            }
+            if (vectorWidth <= 0) {
+                Error(pos, "\"width\" attribute requires a positive vector width.");
+                return;
+            }
+        }
+
         if (isExported && isTask) {
             Error(pos, "Function can't have both \"task\" and \"export\" "
                        "qualifiers");
@@ -885,6 +925,7 @@ void Declarator::InitFromType(const Type *baseType, DeclSpecs *ds) {
         const FunctionType *functionType =
             new FunctionType(returnType, args, argNames, argDefaults, argPos, isTask, isExported, isExternalOnly,
                              isExternC, isExternSYCL, isUnmasked, isUnmangled, isVectorCall, isRegCall, isCdecl, pos);
+        (const_cast<FunctionType *>(functionType))->vectorWidth = vectorWidth;
 
         // handle any explicit __declspecs on the function
         if (ds != nullptr) {
@@ -951,6 +992,9 @@ std::vector<VariableDeclaration> Declaration::GetVariableDeclarations() const {
 
         if (decl->type->IsVoidType()) {
             Error(decl->pos, "\"void\" type variable illegal in declaration.");
+        } else if (CastType<FunctionType>(decl->type) == nullptr && (declSpecs->typeQualifiers & TYPEQUAL_CONSTEXPR)) {
+            Error(decl->pos, "\"constexpr\" qualifier is only supported for global variables, not for \"%s\".",
+                  decl->name.c_str());
         } else if (CastType<FunctionType>(decl->type) == nullptr) {
             if (!decl->type->IsDependentType()) {
                 decl->type = decl->type->ResolveUnboundVariability(Variability::Varying);
@@ -55,6 +55,8 @@ class Declarator;
 #define TYPEQUAL_NOINLINE (1 << 9)
 #define TYPEQUAL_VECTORCALL (1 << 10)
 #define TYPEQUAL_REGCALL (1 << 11)
+#define TYPEQUAL_RESTRICT (1 << 12)
+#define TYPEQUAL_CONSTEXPR (1 << 13)
 
 enum AttrArgKind { ATTR_ARG_UINT32, ATTR_ARG_STRING, ATTR_ARG_UNKNOWN };
 
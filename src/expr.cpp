@@ -11,6 +11,7 @@
 #include "expr.h"
 #include "ast.h"
 #include "builtins-decl.h"
+#include "constexpr.h"
 #include "ctx.h"
 #include "func.h"
 #include "llvmutil.h"
@@ -1047,9 +1048,11 @@ static llvm::Value *lMaskForSymbol(Symbol *baseSym, FunctionEmitContext *ctx) {
         return ctx->GetFullMask();
     }
 
-    llvm::Value *mask = (baseSym->parentFunction == ctx->GetFunction() && baseSym->storageClass != SC_STATIC)
-                            ? ctx->GetInternalMask()
-                            : ctx->GetFullMask();
+    // Static and task_shared variables are visible outside of the current
+    // call, so the stores to them need the full mask.
+    bool isShared = baseSym->storageClass == SC_STATIC || baseSym->storageClass == SC_TASK_SHARED;
+    llvm::Value *mask = (baseSym->parentFunction == ctx->GetFunction() && !isShared) ? ctx->GetInternalMask()
+                                                                                      : ctx->GetFullMask();
     return mask;
 }
 
@@ -1060,6 +1063,7 @@ static void lStoreAssignResult(llvm::Value *value, llvm::Value *ptr, const Type
     Assert(baseSym == nullptr || baseSym->varyingCFDepth <= ctx->VaryingCFDepth());
     if (!g->opt.disableMaskedStoreToStore && !g->opt.disableMaskAllOnOptimizations && baseSym != nullptr &&
         baseSym->varyingCFDepth == ctx->VaryingCFDepth() && baseSym->storageClass != SC_STATIC &&
+        baseSym->storageClass != SC_TASK_SHARED &&
         CastType<ReferenceType>(baseSym->type) == nullptr && CastType<PointerType>(baseSym->type) == nullptr) {
         // If the variable is declared at the same varying control flow
         // depth as where it's being assigned, then we don't need to do any
@@ -4033,28 +4037,8 @@ static const Type *lGetFunctionType(Expr *func) {
     return ftype;
 }
 
-llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
-    if (func == nullptr || args == nullptr) {
-        return nullptr;
-    }
-
-    ctx->SetDebugPos(pos);
-
-    llvm::Value *callee = func->GetValue(ctx);
-
-    if (callee == nullptr) {
-        AssertPos(pos, m->errorCount > 0);
-        return nullptr;
-    }
-
-    const Type *type = lGetFunctionType(func);
-    if (type->IsDependentType()) {
-        Error(pos, "Can't call function with dependent type.");
-    }
-    const FunctionType *ft = CastType<FunctionType>(type);
-    AssertPos(pos, ft != nullptr);
-    bool isVoidFunc = ft->GetReturnType()->IsVoidType();
-
+bool FunctionCallExpr::GetArgValues(FunctionEmitContext *ctx, const FunctionType *ft,
+                                    std::vector<llvm::Value *> &argVals) const {
     // Automatically convert function call args to references if needed.
     // FIXME: this should move to the TypeCheck() method... (but the
     // GetLValue call below needs a FunctionEmitContext, which is
@@ -4065,7 +4049,7 @@ llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
     // overload resolution.
     if ((int)callargs.size() > ft->GetNumParameters()) {
         AssertPos(pos, m->errorCount > 0);
-        return nullptr;
+        return false;
     }
 
     for (unsigned int i = 0; i < callargs.size(); ++i) {
@@ -4083,13 +4067,13 @@ llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
                   "Illegal to pass a \"varying\" lvalue to a "
                   "reference parameter of type \"%s\".",
                   paramType->GetString().c_str());
-            return nullptr;
+            return false;
         }
 
         // Do whatever type conversion is needed
         argExpr = TypeConvertExpr(argExpr, paramType, "function call argument");
         if (argExpr == nullptr) {
-            return nullptr;
+            return false;
         }
         callargs[i] = argExpr;
     }
@@ -4103,30 +4087,60 @@ llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
         // type!
         Expr *d = TypeConvertExpr(paramDefault, paramType, "function call default argument");
         if (d == nullptr) {
-            return nullptr;
+            return false;
         }
         callargs.push_back(d);
     }
 
     // Now evaluate the values of all of the parameters being passed.
-    std::vector<llvm::Value *> argVals;
     for (unsigned int i = 0; i < callargs.size(); ++i) {
         Expr *argExpr = callargs[i];
         if (argExpr == nullptr) {
             // give up; we hit an error earlier
-            return nullptr;
+            return false;
         }
 
         llvm::Value *argValue = argExpr->GetValue(ctx);
         if (argValue == nullptr) {
             // something went wrong in evaluating the argument's
             // expression, so give up on this
-            return nullptr;
+            return false;
         }
 
         argVals.push_back(argValue);
     }
 
+    return true;
+}
+
+llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
+    if (func == nullptr || args == nullptr) {
+        return nullptr;
+    }
+
+    ctx->SetDebugPos(pos);
+
+    llvm::Value *callee = func->GetValue(ctx);
+
+    if (callee == nullptr) {
+        AssertPos(pos, m->errorCount > 0);
+        return nullptr;
+    }
+
+    const Type *type = lGetFunctionType(func);
+    if (type->IsDependentType()) {
+        Error(pos, "Can't call function with dependent type.");
+    }
+    const FunctionType *ft = CastType<FunctionType>(type);
+    AssertPos(pos, ft != nullptr);
+    // The return values of tasks are only used by the reduce clause.
+    bool isVoidFunc = ft->GetReturnType()->IsVoidType() || ft->isTask;
+
+    std::vector<llvm::Value *> argVals;
+    if (!GetArgValues(ctx, ft, argVals)) {
+        return nullptr;
+    }
+
     llvm::Value *retVal = nullptr;
     ctx->SetDebugPos(pos);
     if (ft->isTask) {
@@ -4134,8 +4148,19 @@ llvm::Value *FunctionCallExpr::GetValue(FunctionEmitContext *ctx) const {
         llvm::Value *launchCount[3] = {launchCountExpr[0]->GetValue(ctx), launchCountExpr[1]->GetValue(ctx),
                                        launchCountExpr[2]->GetValue(ctx)};
 
+        AddressInfo *groupHandle = launchGroup ? launchGroup->storageInfo : nullptr;
+        llvm::Value *results = nullptr;
+        if (reduceTarget != nullptr) {
+            llvm::Value *target = reduceTarget->GetLValue(ctx);
+            if (target == nullptr || launchCount[0] == nullptr) {
+                AssertPos(pos, m->errorCount > 0);
+                return nullptr;
+            }
+            results = ctx->TaskReductionInst(groupHandle, ft->GetReturnType(), reduceOp, target, launchCount);
+        }
+
         if (launchCount[0] != nullptr) {
-            ctx->LaunchInst(callee, argVals, launchCount, ft);
+            ctx->LaunchInst(callee, argVals, launchCount, ft, groupHandle, results);
         }
     } else {
         if (isInvoke) {
@@ -4198,6 +4223,11 @@ const Type *FunctionCallExpr::GetType() const {
         return type;
     }
     const FunctionType *ftype = CastType<FunctionType>(type);
+    if (ftype != nullptr && ftype->isTask) {
+        // The return values of the tasks are only accessible through the
+        // "reduce" clause of the launch.
+        return AtomicType::Void;
+    }
     return ftype ? ftype->GetReturnType() : nullptr;
 }
 
@@ -4220,6 +4250,15 @@ Expr *FunctionCallExpr::Optimize() {
     if (func == nullptr || args == nullptr) {
         return nullptr;
     }
+    // Fold the calls of constexpr functions with constant arguments.  The
+    // struct and array results can only be used as initializers, so they
+    // are left to the declarations (see Module::AddGlobalVariable()).
+    const Type *type = GetType();
+    if (CastType<AtomicType>(type) != nullptr || CastType<EnumType>(type) != nullptr) {
+        if (Expr *value = EvaluateConstexprCall(this, false)) {
+            return value;
+        }
+    }
     return this;
 }
 
@@ -4343,6 +4382,37 @@ Expr *FunctionCallExpr::TypeCheck() {
                 return nullptr;
             }
         }
+
+        const Type *retType = funcType->GetReturnType();
+        if (reduceTarget == nullptr && !retType->IsVoidType()) {
+            Error(pos, "Launch of task with return type \"%s\" needs a \"reduce\" clause.",
+                  retType->GetString().c_str());
+            return nullptr;
+        }
+        if (reduceTarget != nullptr) {
+            if (retType->IsVoidType()) {
+                Error(reduceTarget->pos, "\"reduce\" clause illegal with task without return value.");
+                return nullptr;
+            }
+            const Type *targetType = reduceTarget->GetType();
+            if (targetType == nullptr) {
+                return nullptr;
+            }
+            if (CastType<ReferenceType>(targetType) != nullptr) {
+                targetType = targetType->GetReferenceTarget();
+            }
+            if (reduceTarget->GetLValueType() == nullptr || targetType->IsConstType()) {
+                Error(reduceTarget->pos, "Target of \"reduce\" clause must be a non-const lvalue.");
+                return nullptr;
+            }
+            if (!Type::Equal(targetType, retType->GetAsNonConstType())) {
+                Error(reduceTarget->pos,
+                      "Type \"%s\" of the target of \"reduce\" clause doesn't match the return type \"%s\" "
+                      "of the task.",
+                      targetType->GetString().c_str(), retType->GetString().c_str());
+                return nullptr;
+            }
+        }
     } else {
         if (isLaunch) {
             Error(pos, "\"launch\" expression illegal with non-\"task\"-"
@@ -4411,6 +4481,9 @@ FunctionCallExpr *FunctionCallExpr::Instantiate(TemplateInstantiation &templInst
     inst->launchCountExpr[0] = launchCountExpr[0] ? launchCountExpr[0]->Instantiate(templInst) : nullptr;
     inst->launchCountExpr[1] = launchCountExpr[1] ? launchCountExpr[1]->Instantiate(templInst) : nullptr;
     inst->launchCountExpr[2] = launchCountExpr[2] ? launchCountExpr[2]->Instantiate(templInst) : nullptr;
+    inst->launchGroup = templInst.InstantiateSymbol(launchGroup);
+    inst->reduceTarget = reduceTarget ? reduceTarget->Instantiate(templInst) : nullptr;
+    inst->reduceOp = reduceOp;
     return inst;
 }
 
@@ -5510,7 +5583,6 @@ llvm::Value *VectorMemberExpr::GetValue(FunctionEmitContext *ctx) const {
         }
 
         llvm::Value *basePtr = nullptr;
-        AddressInfo *basePtrInfo = nullptr;
         const Type *basePtrType = nullptr;
         if (dereferenceExpr) {
             basePtr = expr->GetValue(ctx);
@@ -5521,24 +5593,21 @@ llvm::Value *VectorMemberExpr::GetValue(FunctionEmitContext *ctx) const {
         }
 
         if (basePtr == nullptr || basePtrType == nullptr) {
-            // Check that expression on the left side is a rvalue expression
+            // The expression on the left side is an rvalue, e.g. the result
+            // of a function call: shuffle its elements in registers rather
+            // than storing it to memory first.
             llvm::Value *exprValue = expr->GetValue(ctx);
-            basePtrInfo = ctx->AllocaInst(expr->GetType());
-            basePtrType = PointerType::GetUniform(exprVectorType);
-            if (basePtrInfo == nullptr || basePtrType == nullptr) {
+            if (exprValue == nullptr) {
                 AssertPos(pos, m->errorCount > 0);
                 return nullptr;
             }
-            basePtr = basePtrInfo->getPointer();
-            AssertPos(pos, basePtr != nullptr);
-            ctx->StoreInst(exprValue, basePtrInfo, expr->GetType());
-        }
-
-        // Allocate temporary memory to store the result
-        AddressInfo *resultPtrInfo = ctx->AllocaInst(memberType, "vector_tmp");
-        if (resultPtrInfo == nullptr) {
-            AssertPos(pos, m->errorCount > 0);
-            return nullptr;
+            ctx->SetDebugPos(pos);
+            llvm::Value *result = llvm::UndefValue::get(memberType->LLVMType(g->ctx));
+            for (size_t i = 0; i < identifier.size(); ++i) {
+                llvm::Value *elementValue = ctx->ExtractInst(exprValue, indices[i]);
+                result = ctx->InsertInst(result, elementValue, i);
+            }
+            return result;
         }
 
         // FIXME: we should be able to use the internal mask here according
@@ -5550,6 +5619,31 @@ llvm::Value *VectorMemberExpr::GetValue(FunctionEmitContext *ctx) const {
                                          ? PointerType::GetUniform(exprVectorType->GetElementType())
                                          : PointerType::GetVarying(exprVectorType->GetElementType());
         ctx->SetDebugPos(pos);
+
+        // The loaded elements of bool vectors have the register type of the
+        // mask, while the elements of the varying vectors have the storage
+        // type, so these go through a temporary in memory, as do the elements
+        // loaded with varying pointers.  The others are put together in
+        // registers.
+        if (ptrType->IsUniformType() && !exprVectorType->GetElementType()->IsBoolType()) {
+            llvm::Value *result = llvm::UndefValue::get(memberType->LLVMType(g->ctx));
+            for (size_t i = 0; i < identifier.size(); ++i) {
+                char idStr[2] = {identifier[i], '\0'};
+                llvm::Value *elementPtr = ctx->AddElementOffset(new AddressInfo(basePtr, basePtrType), indices[i],
+                                                                llvm::Twine(basePtr->getName()) + idStr);
+                llvm::Value *elementValue = ctx->LoadInst(elementPtr, elementMask, elementPtrType);
+                result = ctx->InsertInst(result, elementValue, i, llvm::Twine(basePtr->getName()) + "_swizzle");
+            }
+            return result;
+        }
+
+        // Allocate temporary memory to store the result
+        AddressInfo *resultPtrInfo = ctx->AllocaInst(memberType, "vector_tmp");
+        if (resultPtrInfo == nullptr) {
+            AssertPos(pos, m->errorCount > 0);
+            return nullptr;
+        }
+
         for (size_t i = 0; i < identifier.size(); ++i) {
             char idStr[2] = {identifier[i], '\0'};
             llvm::Value *elementPtr = ctx->AddElementOffset(new AddressInfo(basePtr, basePtrType), indices[i],
@@ -9026,6 +9120,18 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
             continue;
         }
 
+        // Without explicit template arguments, the deduction only depends on the types of the function arguments,
+        // so it's done once for each of them.
+        FunctionTemplate *functionTemplate = templSym->functionTemplate;
+        const bool memoizeDeduction = templateArgs.empty();
+        Symbol *deducedSym = nullptr;
+        if (memoizeDeduction && functionTemplate->LookupDeduction(argTypes, &deducedSym)) {
+            if (deducedSym != nullptr) {
+                ret.push_back(deducedSym);
+            }
+            continue;
+        }
+
         // Create substitution map for specified template parameters
         TemplateInstantiation inst(*templateParms, templateArgs, templSym->isInline, templSym->isNoInline);
 
@@ -9112,6 +9218,9 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
         }
 
         if (deductionFailed) {
+            if (memoizeDeduction) {
+                functionTemplate->AddDeduction(argTypes, nullptr);
+            }
             continue;
         }
 
@@ -9132,16 +9241,22 @@ FunctionSymbolExpr::getCandidateTemplateFunctions(const std::vector<const Type *
             }
         }
         if (deductionFailed) {
+            if (memoizeDeduction) {
+                functionTemplate->AddDeduction(argTypes, nullptr);
+            }
             continue;
         }
 
         // All template arguments were either explicitly specified or deduced, now get the instantiation.
-        Symbol *funcSym = templSym->functionTemplate->LookupInstantiation(deducedArgs);
+        Symbol *funcSym = functionTemplate->LookupInstantiation(deducedArgs);
         if (funcSym == nullptr) {
-            funcSym = templSym->functionTemplate->AddInstantiation(deducedArgs, TemplateInstantiationKind::Implicit,
-                                                                   templSym->isInline, templSym->isNoInline);
+            funcSym = functionTemplate->AddInstantiation(deducedArgs, TemplateInstantiationKind::Implicit,
+                                                         templSym->isInline, templSym->isNoInline);
         }
         AssertPos(pos, funcSym);
+        if (memoizeDeduction) {
+            functionTemplate->AddDeduction(argTypes, funcSym);
+        }
         // Success
         ret.push_back(funcSym);
     }
@@ -9407,16 +9522,23 @@ const Type *SyncExpr::GetType() const { return AtomicType::Void; }
 
 llvm::Value *SyncExpr::GetValue(FunctionEmitContext *ctx) const {
     ctx->SetDebugPos(pos);
-    ctx->SyncInst();
+    ctx->SyncInst(group ? group->storageInfo : nullptr);
     return nullptr;
 }
 
 int SyncExpr::EstimateCost() const { return COST_SYNC; }
 
-SyncExpr *SyncExpr::Instantiate(TemplateInstantiation &templInst) const { return new SyncExpr(pos); }
+SyncExpr *SyncExpr::Instantiate(TemplateInstantiation &templInst) const {
+    return new SyncExpr(pos, templInst.InstantiateSymbol(group));
+}
 
 void SyncExpr::Print(Indent &indent) const {
-    indent.PrintLn("SyncExpr", pos);
+    if (group != nullptr) {
+        indent.Print("SyncExpr", pos);
+        printf("group: %s\n", group->name.c_str());
+    } else {
+        indent.PrintLn("SyncExpr", pos);
+    }
     indent.Done();
 }
 
@@ -9466,8 +9588,8 @@ NullPointerExpr *NullPointerExpr::Instantiate(TemplateInstantiation &templInst)
 ///////////////////////////////////////////////////////////////////////////
 // NewExpr
 
-NewExpr::NewExpr(int typeQual, const Type *t, Expr *init, Expr *count, SourcePos tqPos, SourcePos p)
-    : Expr(p, NewExprID) {
+NewExpr::NewExpr(int typeQual, const Type *t, Expr *init, Expr *count, SourcePos tqPos, SourcePos p, bool isS)
+    : Expr(p, NewExprID), isScratch(isS) {
     allocType = t;
 
     initExpr = init;
@@ -9495,8 +9617,46 @@ NewExpr::NewExpr(int typeQual, const Type *t, Expr *init, Expr *count, SourcePos
 }
 
 // Private constructor for cloning.
-NewExpr::NewExpr(const Type *type, Expr *count, Expr *init, bool isV, SourcePos p)
-    : Expr(p, NewExprID), allocType(type), countExpr(count), initExpr(init), isVarying(isV) {}
+NewExpr::NewExpr(const Type *type, Expr *count, Expr *init, bool isV, bool isS, SourcePos p)
+    : Expr(p, NewExprID), allocType(type), countExpr(count), initExpr(init), isVarying(isV), isScratch(isS) {}
+
+/** Allocates the memory of a "scratch new" of \p allocSize bytes, or of
+    the sizes of the active program instances if it's varying, with a single
+    allocation of the scratch memory of the function.  The pointers are
+    returned as for the __new_*() builtins: the pointers of the inactive
+    program instances of a varying allocation are null, and they are 64-bit
+    integers. */
+static llvm::Value *lScratchNew(FunctionEmitContext *ctx, bool isVarying, llvm::Value *allocSize) {
+    if (!isVarying) {
+        return ctx->ScratchAllocInst(allocSize, "new");
+    }
+
+    // Every program instance gets a block that is rounded up to the
+    // alignment of the allocations, at the offset of the sum of the blocks
+    // of the program instances before it.
+    int width = g->target->getVectorWidth();
+    uint64_t alignment = ctx->ScratchAlignment();
+    llvm::Value *active = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, ctx->GetFullMask(),
+                                       llvm::Constant::getNullValue(LLVMTypes::MaskType), "active");
+    llvm::Value *offsets = llvm::UndefValue::get(LLVMTypes::Int64VectorType);
+    llvm::Value *total = LLVMInt64(0);
+    for (int i = 0; i < width; ++i) {
+        llvm::Value *size = ctx->ExtractInst(allocSize, i);
+        if (size->getType() != LLVMTypes::Int64Type) {
+            size = ctx->ZExtInst(size, LLVMTypes::Int64Type);
+        }
+        size = ctx->BinaryOperator(llvm::Instruction::Add, size, LLVMInt64(alignment - 1), WrapSemantics::None);
+        size = ctx->BinaryOperator(llvm::Instruction::And, size, LLVMInt64(~(alignment - 1)), WrapSemantics::None);
+        size = ctx->SelectInst(ctx->ExtractInst(active, i), size, LLVMInt64(0));
+        offsets = ctx->InsertInst(offsets, total, i);
+        total = ctx->BinaryOperator(llvm::Instruction::Add, total, size, WrapSemantics::None, "scratch_size");
+    }
+
+    llvm::Value *base = ctx->PtrToIntInst(ctx->ScratchAllocInst(total, "new"), LLVMTypes::Int64Type);
+    llvm::Value *ptrs = ctx->BinaryOperator(llvm::Instruction::Add, ctx->SmearUniform(base), offsets,
+                                            WrapSemantics::None, "new");
+    return ctx->SelectInst(active, ptrs, llvm::Constant::getNullValue(LLVMTypes::Int64VectorType));
+}
 
 llvm::Value *NewExpr::GetValue(FunctionEmitContext *ctx) const {
     bool do32Bit = (g->target->is32Bit() || g->opt.force32BitAddressing);
@@ -9538,32 +9698,37 @@ llvm::Value *NewExpr::GetValue(FunctionEmitContext *ctx) const {
     llvm::Value *allocSize =
         ctx->BinaryOperator(llvm::Instruction::Mul, countValue, eltSize, WrapSemantics::NSW, "alloc_size");
 
-    // Determine which allocation builtin function to call: uniform or
-    // varying, and taking 32-bit or 64-bit allocation counts.
-    llvm::Function *func = nullptr;
-    if (isVarying) {
-        if (g->target->is32Bit()) {
-            func = m->module->getFunction(builtin::__new_varying32_32rt);
-        } else if (g->opt.force32BitAddressing) {
-            func = m->module->getFunction(builtin::__new_varying32_64rt);
-        } else {
-            func = m->module->getFunction(builtin::__new_varying64_64rt);
-        }
+    llvm::Value *ptrValue = nullptr;
+    if (isScratch) {
+        ptrValue = lScratchNew(ctx, isVarying, allocSize);
     } else {
-        // FIXME: __new_uniform_32rt should take i32
-        if (allocSize->getType() != LLVMTypes::Int64Type) {
-            allocSize = ctx->SExtInst(allocSize, LLVMTypes::Int64Type, "alloc_size64");
-        }
-        if (g->target->is32Bit()) {
-            func = m->module->getFunction(builtin::__new_uniform_32rt);
+        // Determine which allocation builtin function to call: uniform or
+        // varying, and taking 32-bit or 64-bit allocation counts.
+        llvm::Function *func = nullptr;
+        if (isVarying) {
+            if (g->target->is32Bit()) {
+                func = m->module->getFunction(builtin::__new_varying32_32rt);
+            } else if (g->opt.force32BitAddressing) {
+                func = m->module->getFunction(builtin::__new_varying32_64rt);
+            } else {
+                func = m->module->getFunction(builtin::__new_varying64_64rt);
+            }
         } else {
-            func = m->module->getFunction(builtin::__new_uniform_64rt);
+            // FIXME: __new_uniform_32rt should take i32
+            if (allocSize->getType() != LLVMTypes::Int64Type) {
+                allocSize = ctx->SExtInst(allocSize, LLVMTypes::Int64Type, "alloc_size64");
+            }
+            if (g->target->is32Bit()) {
+                func = m->module->getFunction(builtin::__new_uniform_32rt);
+            } else {
+                func = m->module->getFunction(builtin::__new_uniform_64rt);
+            }
         }
-    }
-    AssertPos(pos, func != nullptr);
+        AssertPos(pos, func != nullptr);
 
-    // Make the call for the the actual allocation.
-    llvm::Value *ptrValue = ctx->CallInst(func, nullptr, allocSize, "new");
+        // Make the call for the the actual allocation.
+        ptrValue = ctx->CallInst(func, nullptr, allocSize, "new");
+    }
 
     // Now handle initializers and returning the right type for the result.
     const Type *retType = GetType();
@@ -9705,8 +9870,8 @@ Expr *NewExpr::Optimize() { return this; }
 void NewExpr::Print(Indent &indent) const {
     indent.Print("NewExpr", pos);
 
-    printf("[%s] isVarying: %s\n", allocType ? allocType->GetString().c_str() : "<NULL allocType>",
-           isVarying ? "true" : "false");
+    printf("[%s] isVarying: %s%s\n", allocType ? allocType->GetString().c_str() : "<NULL allocType>",
+           isVarying ? "true" : "false", isScratch ? " isScratch: true" : "");
 
     if (countExpr || initExpr) {
         int kids = (countExpr ? 1 : 0) + (initExpr ? 1 : 0);
@@ -9730,5 +9895,5 @@ NewExpr *NewExpr::Instantiate(TemplateInstantiation &templInst) const {
     const Type *instType = allocType ? allocType->ResolveDependenceForTopType(templInst) : nullptr;
     Expr *instInit = initExpr ? initExpr->Instantiate(templInst) : nullptr;
     Expr *instCount = countExpr ? countExpr->Instantiate(templInst) : nullptr;
-    return new NewExpr(instType, instCount, instInit, isVarying, pos);
+    return new NewExpr(instType, instCount, instInit, isVarying, isScratch, pos);
 }
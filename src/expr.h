@@ -295,11 +295,24 @@ class FunctionCallExpr : public Expr {
     int EstimateCost() const;
     FunctionCallExpr *Instantiate(TemplateInstantiation &templInst) const;
 
+    /** Evaluate the arguments of the call of a function of type \p ft,
+        including the default values of the ones that aren't given, after
+        converting them to the types of the parameters.  Returns false if
+        an error was encountered. */
+    bool GetArgValues(FunctionEmitContext *ctx, const FunctionType *ft, std::vector<llvm::Value *> &argVals) const;
+
     Expr *func;
     ExprList *args;
     bool isLaunch;
     bool isInvoke;
     Expr *launchCountExpr[3];
+    /** The task group of "launch ... in group", or nullptr for the default
+        group of the function. */
+    Symbol *launchGroup = nullptr;
+    /** The target of "launch ... reduce(op: target)", or nullptr for the
+        launches of tasks without a return value. */
+    Expr *reduceTarget = nullptr;
+    TaskReductionOp reduceOp = TaskReductionOp::Add;
 };
 
 /** @brief Expression representing indexing into something with an integer
@@ -807,7 +820,7 @@ class FunctionSymbolExpr : public Expr {
     proceeding). */
 class SyncExpr : public Expr {
   public:
-    SyncExpr(SourcePos p) : Expr(p, SyncExprID) {}
+    SyncExpr(SourcePos p, Symbol *g = nullptr) : Expr(p, SyncExprID), group(g) {}
 
     static inline bool classof(SyncExpr const *) { return true; }
     static inline bool classof(ASTNode const *N) { return N->getValueID() == SyncExprID; }
@@ -819,6 +832,10 @@ class SyncExpr : public Expr {
     void Print(Indent &indent) const;
     int EstimateCost() const;
     SyncExpr *Instantiate(TemplateInstantiation &templInst) const;
+
+    /** The task group of "sync(group)", or nullptr for the default group of
+        the function. */
+    Symbol *group;
 };
 
 /** @brief An expression that represents a nullptr pointer. */
@@ -844,7 +861,8 @@ class NullPointerExpr : public Expr {
 */
 class NewExpr : public Expr {
   public:
-    NewExpr(int typeQual, const Type *type, Expr *initializer, Expr *count, SourcePos tqPos, SourcePos p);
+    NewExpr(int typeQual, const Type *type, Expr *initializer, Expr *count, SourcePos tqPos, SourcePos p,
+            bool isScratch = false);
 
     static inline bool classof(NewExpr const *) { return true; }
     static inline bool classof(ASTNode const *N) { return N->getValueID() == NewExprID; }
@@ -871,9 +889,13 @@ class NewExpr : public Expr {
         instance, or whether a single allocation is performed for the
         entire gang of program instances.) */
     bool isVarying;
+    /** Indicates whether this is a "scratch new", which allocates the
+        memory from the task system with ISPCAlloc(); it's freed when the
+        function returns instead of by "delete". */
+    bool isScratch;
 
   private:
-    NewExpr(const Type *type, Expr *count, Expr *init, bool isV, SourcePos p);
+    NewExpr(const Type *type, Expr *count, Expr *init, bool isV, bool isS, SourcePos p);
 };
 
 /** This function indicates whether it's legal to convert from fromType to
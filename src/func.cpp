@@ -10,19 +10,24 @@
 
 #include "func.h"
 #include "builtins-decl.h"
+#include "constexpr.h"
 #include "ctx.h"
 #include "expr.h"
 #include "llvmutil.h"
 #include "module.h"
 #include "stmt.h"
 #include "sym.h"
+#include "time_report.h"
 #include "type.h"
 #include "util.h"
 
+#include <algorithm>
 #include <stdio.h>
 
 #include <llvm/IR/CFG.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Intrinsics.h>
@@ -37,6 +42,7 @@
 #include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 #include <llvm/Transforms/IPO.h>
 
 #ifdef ISPC_XE_ENABLED
@@ -48,6 +54,51 @@ using namespace ispc;
 ///////////////////////////////////////////////////////////////////////////
 // Function
 
+/** Overrides g->opt with the options that apply to a function, according
+    to its "optimize" attribute, while its body is type checked, optimized
+    and emitted.  The options of the functions that are instantiated from
+    templates meanwhile are based on the ones given on the command line,
+    not on the ones of the function being processed. */
+class FunctionOptScope {
+  public:
+    FunctionOptScope(const llvm::Function *function) : saved(g->opt), outermost(commandLineOpt == nullptr) {
+        if (outermost) {
+            commandLineOpt = &saved;
+        }
+        g->opt = commandLineOpt->ForFunction(function);
+    }
+    ~FunctionOptScope() {
+        g->opt = saved;
+        if (outermost) {
+            commandLineOpt = nullptr;
+        }
+    }
+
+  private:
+    Opt saved;
+    bool outermost;
+    static const Opt *commandLineOpt;
+};
+
+const Opt *FunctionOptScope::commandLineOpt = nullptr;
+
+/** Copies the attributes that the "optimize" attribute of a function has
+    set to the version of the function for the application. */
+static void lCopyOptimizeAttributes(const llvm::Function *function, llvm::Function *appFunction) {
+    for (const char *name : {"ispc-opt-level", "ispc-fast-math", "ispc-fma", "ispc-unroll-loops"}) {
+        if (function->hasFnAttribute(name)) {
+            appFunction->addFnAttr(function->getFnAttribute(name));
+        }
+    }
+    if (function->hasOptNone()) {
+        appFunction->addFnAttr(llvm::Attribute::OptimizeNone);
+        appFunction->addFnAttr(llvm::Attribute::NoInline);
+    }
+    if (function->hasFnAttribute(llvm::Attribute::OptimizeForSize)) {
+        appFunction->addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+}
+
 bool Function::IsInternal() const {
     ispc::StorageClass sc = sym->storageClass;
     bool isInline = false;
@@ -143,7 +194,9 @@ void Function::Print(Indent &indent) const {
 // handling during code generation must be saved. This includes symbols for arguments and special symbols
 // like __mask and thread / task variables.
 // Type checking and optimization is also done here.
-Function::Function(Symbol *s, Stmt *c) : sym(s), code(c) {
+Function::Function(Symbol *s, Stmt *c, const std::vector<FunctionSpecialization> &specializations,
+                   const FunctionTargets &targets, const FunctionNarrowing &narrowing, bool constexprFunction)
+    : sym(s), code(c), arena(BookKeeper::in().getCurrentArena()), emitExportedFunction(true), isConstexpr(false) {
     maskSymbol = m->symbolTable->LookupVariable("__mask");
     Assert(maskSymbol != nullptr);
 
@@ -193,27 +246,173 @@ Function::Function(Symbol *s, Stmt *c) : sym(s), code(c) {
         taskCountSym0 = taskCountSym1 = taskCountSym2 = nullptr;
     }
 
+    size_t numVersions = 1;
+    for (const FunctionSpecialization &spec : specializations) {
+        if (!type->isExported) {
+            Error(spec.pos, "'#pragma ispc specialize' is only supported for exported functions.");
+            break;
+        }
+        int index = 0;
+        while (index < type->GetNumParameters() && type->GetParameterName(index) != spec.paramName) {
+            ++index;
+        }
+        if (index == type->GetNumParameters()) {
+            Error(spec.pos, "Function \"%s\" has no parameter \"%s\" to specialize.", sym->name.c_str(),
+                  spec.paramName.c_str());
+            continue;
+        }
+        const Type *paramType = type->GetParameterType(index);
+        if (!paramType->IsUniformType() || !paramType->IsIntType() || paramType->IsReferenceType()) {
+            Error(spec.pos, "Only uniform integer parameters can be specialized, not \"%s\" of type \"%s\".",
+                  spec.paramName.c_str(), paramType->GetString().c_str());
+            continue;
+        }
+        if (std::any_of(specializedParams.begin(), specializedParams.end(),
+                        [index](const auto &param) { return param.first == index; })) {
+            Error(spec.pos, "Parameter \"%s\" is specialized more than once.", spec.paramName.c_str());
+            continue;
+        }
+        numVersions *= spec.values.size();
+        if (numVersions > 64) {
+            Error(spec.pos, "Too many specializations of function \"%s\"; at most 64 are supported.",
+                  sym->name.c_str());
+            break;
+        }
+        specializedParams.push_back({index, spec.values});
+    }
+    if (!specializedParams.empty() && g->target->isXeTarget()) {
+        Warning(sym->pos, "'#pragma ispc specialize' is ignored for Xe targets.");
+        specializedParams.clear();
+    }
+
+    if (!narrowing.paramName.empty()) {
+        int index = 0;
+        while (index < type->GetNumParameters() && type->GetParameterName(index) != narrowing.paramName) {
+            ++index;
+        }
+        const Type *paramType = index < type->GetNumParameters() ? type->GetParameterType(index) : nullptr;
+        if (!type->isExported) {
+            Error(narrowing.pos, "'#pragma ispc narrow' is only supported for exported functions.");
+        } else if (paramType == nullptr) {
+            Error(narrowing.pos, "Function \"%s\" has no parameter \"%s\" to dispatch on.", sym->name.c_str(),
+                  narrowing.paramName.c_str());
+        } else if (!paramType->IsUniformType() || !paramType->IsIntType() || paramType->IsReferenceType()) {
+            Error(narrowing.pos, "Only uniform integer parameters can be dispatched on, not \"%s\" of type \"%s\".",
+                  narrowing.paramName.c_str(), paramType->GetString().c_str());
+        } else if (type->vectorWidth > 0 || g->isMultiTargetCompilation || g->target->isXeTarget()) {
+            Warning(narrowing.pos, "'#pragma ispc narrow' is ignored for %s.",
+                    type->vectorWidth > 0        ? "functions with the \"width\" attribute"
+                    : g->isMultiTargetCompilation ? "multi-target compilation"
+                                                  : "Xe targets");
+        } else if (g->isWidthVariantCompilation) {
+            // This is the compilation of the narrow version itself.
+            narrowVersion = g->target->getVectorWidth() == FunctionNarrowing::width;
+        } else if (g->target->getVectorWidth() > FunctionNarrowing::width) {
+            narrowParam = index;
+            narrowThreshold = narrowing.threshold;
+            if (!m->hasNarrowFunctions) {
+                m->hasNarrowFunctions = true;
+                m->narrowFunctionPos = narrowing.pos;
+            }
+        }
+    }
+
+    if (!targets.isaNames.empty()) {
+        if (!type->isExported) {
+            Error(targets.pos, "'#pragma ispc targets' is only supported for exported functions.");
+        } else {
+            bool currentTarget = false;
+            for (const std::string &name : targets.isaNames) {
+                bool known = false;
+                for (int i = 0; i < Target::NUM_ISAS; ++i) {
+                    known |= name == Target::ISAToString((Target::ISA)i);
+                }
+                if (!known) {
+                    Error(targets.pos, "Unknown ISA \"%s\" in '#pragma ispc targets'.", name.c_str());
+                }
+                currentTarget |= name == g->target->GetISAString();
+            }
+            // With a single target, there is no other variant that the
+            // calls could be dispatched to.
+            emitExportedFunction = currentTarget || !g->isMultiTargetCompilation;
+        }
+    }
+
+    // The exported functions with the "width" attribute are compiled for
+    // the target of that width, and the other ones for the target given on
+    // the command line.
+    if (type->vectorWidth > 0 && (g->isMultiTargetCompilation || g->target->isXeTarget())) {
+        Warning(sym->pos, "\"width\" attribute is ignored for %s.",
+                g->isMultiTargetCompilation ? "multi-target compilation" : "Xe targets");
+    } else if (type->vectorWidth > 0) {
+        emitExportedFunction &= type->vectorWidth == g->target->getVectorWidth();
+    } else if (type->isExported) {
+        emitExportedFunction &= !g->isWidthVariantCompilation || narrowVersion;
+    }
+
+    if (constexprFunction) {
+        checkConstexpr();
+    }
+
     typeCheckAndOptimize();
 }
 
 // The version of constructor, which accepts symbols directly instead of doing lookup in the symbol table.
 // This is necessary to instantiate template functions, as symbol lookup is not available during instantiation.
 Function::Function(Symbol *s, Stmt *c, Symbol *ms, std::vector<Symbol *> &a)
-    : sym(s), args(a), code(c), maskSymbol(ms), threadIndexSym(nullptr), threadCountSym(nullptr), taskIndexSym(nullptr),
-      taskCountSym(nullptr), taskIndexSym0(nullptr), taskCountSym0(nullptr), taskIndexSym1(nullptr),
-      taskCountSym1(nullptr), taskIndexSym2(nullptr), taskCountSym2(nullptr) {
+    : sym(s), args(a), code(c), arena(nullptr), maskSymbol(ms), threadIndexSym(nullptr), threadCountSym(nullptr),
+      taskIndexSym(nullptr), taskCountSym(nullptr), taskIndexSym0(nullptr), taskCountSym0(nullptr),
+      taskIndexSym1(nullptr), taskCountSym1(nullptr), taskIndexSym2(nullptr), taskCountSym2(nullptr),
+      emitExportedFunction(true), isConstexpr(false) {
     typeCheckAndOptimize();
 }
 
+/** Checks that the calls of a "constexpr" function can be evaluated at
+    compile time and, if so, makes its body reachable from its symbol for
+    EvaluateConstexprCall().  This is done before the body is type checked,
+    so that the recursive calls are found as well. */
+void Function::checkConstexpr() {
+    const FunctionType *type = GetType();
+    if (type->isTask || type->isExported || type->isExternC || type->isExternSYCL) {
+        Error(sym->pos, "\"constexpr\" qualifier is illegal with %s function \"%s\".",
+              type->isTask ? "task" : (type->isExported ? "exported" : "extern"), sym->name.c_str());
+        return;
+    }
+    if (!IsConstexprType(type->GetReturnType())) {
+        Error(sym->pos,
+              "Return type \"%s\" of constexpr function \"%s\" can't be computed at compile time; only "
+              "uniform atomic, enum, struct and array types are supported.",
+              type->GetReturnType()->GetString().c_str(), sym->name.c_str());
+        return;
+    }
+    for (int i = 0; i < type->GetNumParameters(); ++i) {
+        const Type *paramType = type->GetParameterType(i);
+        if (!IsConstexprType(paramType->GetReferenceTarget())) {
+            Error(sym->pos,
+                  "Parameter \"%s\" of constexpr function \"%s\" has type \"%s\"; only uniform atomic, "
+                  "enum, struct and array types and references to them are supported.",
+                  type->GetParameterName(i).c_str(), sym->name.c_str(), paramType->GetString().c_str());
+            return;
+        }
+    }
+    isConstexpr = true;
+    sym->parentFunction = this;
+}
+
 void Function::typeCheckAndOptimize() {
     if (code != nullptr) {
+        FunctionOptScope optScope(sym->function);
         debugPrintHelper(DebugPrintPoint::Initial);
 
-        code = TypeCheck(code);
+        {
+            TimeReportScope TimeReport("typecheck", sym->name);
+            code = TypeCheck(code);
+        }
 
         debugPrintHelper(DebugPrintPoint::AfterTypeChecking);
 
         if (code != nullptr) {
+            TimeReportScope TimeReport("ast_optimize", sym->name);
             code = Optimize(code);
 
             debugPrintHelper(DebugPrintPoint::AfterOptimization);
@@ -233,6 +432,23 @@ const FunctionType *Function::GetType() const {
     return type;
 }
 
+/** Tells the optimizer that the task or thread index passed to a task is
+    less than the corresponding count and that the count is positive, so
+    that the index arithmetic in the task is known not to wrap.
+ */
+static void lAssumeIndexInRange(FunctionEmitContext *ctx, llvm::Value *index, llvm::Value *count) {
+    llvm::Function *assumeFunc = m->module->getFunction(builtin::__do_assume_uniform);
+    if (assumeFunc == nullptr) {
+        return;
+    }
+    llvm::Value *countPositive =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGT, count, LLVMInt32(0), "count_positive");
+    ctx->CallInst(assumeFunc, nullptr, countPositive, "");
+    llvm::Value *indexInRange =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_ULT, index, count, "index_in_range");
+    ctx->CallInst(assumeFunc, nullptr, indexInRange, "");
+}
+
 /** Parameters for tasks are stored in a big structure; this utility
     function emits code to copy those values out of the task structure into
     local stack-allocated variables.  (Which we expect that LLVM's
@@ -295,10 +511,6 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
     if (g->NoOmitFramePointer) {
         function->addFnAttr("frame-pointer", "all");
     }
-    if (g->target->getArch() == Arch::wasm32 || g->target->getArch() == Arch::wasm64) {
-        function->addFnAttr("target-features", "+simd128");
-    }
-
     g->target->markFuncWithTargetAttr(function);
     const FunctionType *type = CastType<FunctionType>(sym->type);
     Assert(type != nullptr);
@@ -341,6 +553,17 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
             ctx->SetFunctionMask(ptrval);
         }
 
+        if (type->GetReturnType()->IsVoidType() == false) {
+            // The return value is stored to the element taskIndex of the
+            // array of results, which is the last member of the structure.
+            int resultsIndex = (int)llvmArgTypes.size() - 1;
+            llvm::Value *ptr = ctx->AddElementOffset(stInfo, resultsIndex, "task_struct_results");
+            llvm::Value *results =
+                ctx->LoadInst(new AddressInfo(ptr, LLVMTypes::VoidPointerType), nullptr, "task_results");
+            ctx->SetTaskResultPointer(ctx->GetElementPtrInst(
+                results, taskIndex, PointerType::GetUniform(type->GetReturnType()), "task_result"));
+        }
+
         // Copy threadIndex and threadCount into stack-allocated storage so
         // that their symbols point to something reasonable.
         threadIndexSym->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "threadIndex");
@@ -370,6 +593,13 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         ctx->StoreInst(taskCount1, taskCountSym1->storageInfo);
         taskCountSym2->storageInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "taskCount2");
         ctx->StoreInst(taskCount2, taskCountSym2->storageInfo);
+
+        // The runtime launches every task with the indices in range.
+        lAssumeIndexInRange(ctx, threadIndex, threadCount);
+        lAssumeIndexInRange(ctx, taskIndex, taskCount);
+        lAssumeIndexInRange(ctx, taskIndex0, taskCount0);
+        lAssumeIndexInRange(ctx, taskIndex1, taskCount1);
+        lAssumeIndexInRange(ctx, taskIndex2, taskCount2);
     } else {
         // Regular, non-task function or GPU task
         llvm::Function::arg_iterator argIter = function->arg_begin();
@@ -472,6 +702,7 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
     // Finally, we can generate code for the function
     if (code != nullptr) {
         ctx->SetDebugPos(code->pos);
+        ctx->SaveLaneProfileState();
         ctx->AddInstrumentationPoint("function entry");
 
         int costEstimate = EstimateCost(code);
@@ -489,6 +720,10 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         checkMask &= (g->target->getMaskingIsFree() == false);
         checkMask &= (g->opt.disableCoherentControlFlow == false);
 
+        // Mark the calls in the function with its '#pragma ispc expect_no_*'
+        // flags, if any.
+        ctx->PushExpectations(code->expectAttribute);
+
         if (checkMask) {
             llvm::Value *mask = ctx->GetFunctionMask();
             llvm::Value *allOn = ctx->All(mask);
@@ -535,6 +770,8 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
             // No check, just emit the code
             code->EmitCode(ctx);
         }
+
+        ctx->PopExpectations();
     }
 
     if (ctx->GetCurrentBasicBlock()) {
@@ -563,6 +800,7 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
         // return instruction.  Need to add a return instruction.
         ctx->ReturnInst();
     }
+    ctx->EmitTaskReductions();
 #ifdef ISPC_XE_ENABLED
     if (type->IsISPCKernel()) {
         // Emit metadata for XE kernel
@@ -636,6 +874,238 @@ void Function::emitCode(FunctionEmitContext *ctx, llvm::Function *function, Sour
 #endif
 }
 
+// Replace the body of the exported function with a dispatch on the values of
+// the specialized parameters.  The body is cloned for every combination of
+// the values with the parameters replaced by the constants, so that they are
+// propagated by the optimizer, and once more for the other values.
+static void lSpecializeFunction(llvm::Function *function,
+                                const std::vector<std::pair<int, std::vector<int64_t>>> &params) {
+    std::vector<std::vector<int64_t>> combinations = {{}};
+    for (const auto &param : params) {
+        std::vector<std::vector<int64_t>> extended;
+        for (const std::vector<int64_t> &combination : combinations) {
+            for (int64_t value : param.second) {
+                extended.push_back(combination);
+                extended.back().push_back(value);
+            }
+        }
+        combinations.swap(extended);
+    }
+
+    auto cloneBody = [function](const std::string &suffix, llvm::ValueToValueMapTy &VMap) {
+        llvm::Function *clone = llvm::CloneFunction(function, VMap);
+        clone->setName(function->getName() + suffix);
+        clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+        clone->setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+        return clone;
+    };
+
+    std::vector<llvm::Function *> versions;
+    for (const std::vector<int64_t> &combination : combinations) {
+        std::string suffix = "___specialized";
+        for (int64_t value : combination) {
+            suffix += "_" + std::to_string(value);
+        }
+        llvm::ValueToValueMapTy VMap;
+        llvm::Function *clone = cloneBody(suffix, VMap);
+        for (size_t i = 0; i < params.size(); ++i) {
+            llvm::Argument *arg = llvm::cast<llvm::Argument>(VMap[function->getArg(params[i].first)]);
+            arg->replaceAllUsesWith(llvm::ConstantInt::get(arg->getType(), combination[i], true));
+        }
+        versions.push_back(clone);
+    }
+    llvm::ValueToValueMapTy VMap;
+    versions.push_back(cloneBody("___generic", VMap));
+
+    // Deleting the body drops the debug information of the function too.
+    llvm::DISubprogram *subprogram = function->getSubprogram();
+    function->deleteBody();
+    function->setSubprogram(subprogram);
+
+    llvm::LLVMContext &context = function->getContext();
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", function));
+    if (subprogram != nullptr) {
+        builder.SetCurrentDebugLocation(llvm::DILocation::get(context, subprogram->getLine(), 0, subprogram));
+    }
+    std::vector<llvm::Value *> args;
+    for (llvm::Argument &arg : function->args()) {
+        args.push_back(&arg);
+    }
+    for (size_t version = 0; version < versions.size(); ++version) {
+        if (version < combinations.size()) {
+            llvm::Value *matches = nullptr;
+            for (size_t i = 0; i < params.size(); ++i) {
+                llvm::Argument *arg = function->getArg(params[i].first);
+                llvm::Value *value = llvm::ConstantInt::get(arg->getType(), combinations[version][i], true);
+                llvm::Value *equal = builder.CreateICmpEQ(arg, value);
+                matches = matches ? builder.CreateAnd(matches, equal) : equal;
+            }
+            llvm::BasicBlock *callBlock = llvm::BasicBlock::Create(context, "specialized", function);
+            llvm::BasicBlock *nextBlock = llvm::BasicBlock::Create(context, "next", function);
+            builder.CreateCondBr(matches, callBlock, nextBlock);
+            builder.SetInsertPoint(callBlock);
+            llvm::CallInst *call = builder.CreateCall(versions[version], args);
+            call->setCallingConv(function->getCallingConv());
+            function->getReturnType()->isVoidTy() ? builder.CreateRetVoid() : builder.CreateRet(call);
+            builder.SetInsertPoint(nextBlock);
+        } else {
+            llvm::CallInst *call = builder.CreateCall(versions[version], args);
+            call->setCallingConv(function->getCallingConv());
+            function->getReturnType()->isVoidTy() ? builder.CreateRetVoid() : builder.CreateRet(call);
+        }
+    }
+}
+
+// Replace the body of the exported function with a dispatch to its narrow
+// version, which is compiled for the target of the same family with
+// FunctionNarrowing::width lanes and linked in by lCompileWidthVariants(),
+// when the parameter is below the threshold, and to a clone of the body
+// otherwise.
+static void lDispatchToNarrowVersion(llvm::Function *function, int param, int64_t threshold, bool isUnsigned) {
+    llvm::ValueToValueMapTy VMap;
+    llvm::Function *wide = llvm::CloneFunction(function, VMap);
+    wide->setName(function->getName() + "___wide");
+    wide->setLinkage(llvm::GlobalValue::InternalLinkage);
+    wide->setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+
+    llvm::Module *module = function->getParent();
+    std::string narrowName = function->getName().str() + "___narrow";
+    llvm::Function *narrow = module->getFunction(narrowName);
+    if (narrow == nullptr) {
+        narrow = llvm::Function::Create(function->getFunctionType(), llvm::GlobalValue::ExternalLinkage, narrowName,
+                                        module);
+        narrow->setCallingConv(function->getCallingConv());
+    }
+
+    // Deleting the body drops the debug information of the function too.
+    llvm::DISubprogram *subprogram = function->getSubprogram();
+    function->deleteBody();
+    function->setSubprogram(subprogram);
+
+    llvm::LLVMContext &context = function->getContext();
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", function));
+    if (subprogram != nullptr) {
+        builder.SetCurrentDebugLocation(llvm::DILocation::get(context, subprogram->getLine(), 0, subprogram));
+    }
+    std::vector<llvm::Value *> args;
+    for (llvm::Argument &arg : function->args()) {
+        args.push_back(&arg);
+    }
+    llvm::Argument *arg = function->getArg(param);
+    llvm::Value *value = llvm::ConstantInt::get(arg->getType(), threshold, true);
+    llvm::Value *isSmall = isUnsigned ? builder.CreateICmpULT(arg, value) : builder.CreateICmpSLT(arg, value);
+    llvm::BasicBlock *narrowBlock = llvm::BasicBlock::Create(context, "narrow", function);
+    llvm::BasicBlock *wideBlock = llvm::BasicBlock::Create(context, "wide", function);
+    builder.CreateCondBr(isSmall, narrowBlock, wideBlock);
+    for (auto [block, callee] : {std::make_pair(narrowBlock, narrow), std::make_pair(wideBlock, wide)}) {
+        builder.SetInsertPoint(block);
+        llvm::CallInst *call = builder.CreateCall(callee, args);
+        call->setCallingConv(function->getCallingConv());
+        function->getReturnType()->isVoidTy() ? builder.CreateRetVoid() : builder.CreateRet(call);
+    }
+}
+
+// Emit the "batch" entry point of the exported function with the "batch"
+// attribute, e.g. "void foo_batch(const struct foo_args *args, size_t n)",
+// which calls the exported function for every element of args, so the
+// application pays for the call and the dispatch once per batch.  The
+// structure has a field for every parameter of the function, in their order.
+// The symbol is exported like the ones of the source program, so it gets the
+// declaration in the header and the dispatch function.
+static void lEmitBatchFunction(const Symbol *sym, const FunctionType *type, llvm::Function *appFunction) {
+    const std::string argsName = sym->name + "_args";
+    const std::string batchName = sym->name + "_batch";
+    if (m->symbolTable->LookupType(argsName.c_str()) != nullptr || m->symbolTable->LookupFunction(batchName.c_str())) {
+        Error(sym->pos, "Can't emit the batch entry point of function \"%s\": \"%s\" or \"%s\" is already defined.",
+              sym->name.c_str(), argsName.c_str(), batchName.c_str());
+        return;
+    }
+
+    llvm::SmallVector<const Type *, 8> fieldTypes;
+    llvm::SmallVector<std::string, 8> fieldNames;
+    llvm::SmallVector<SourcePos, 8> fieldPositions;
+    for (int i = 0; i < type->GetNumParameters(); ++i) {
+        const Type *paramType = type->GetParameterType(i);
+        // References are passed as pointers in the structure.
+        if (CastType<ReferenceType>(paramType) != nullptr) {
+            paramType = PointerType::GetUniform(paramType->GetReferenceTarget());
+        }
+        fieldTypes.push_back(paramType->GetAsNonConstType());
+        const std::string &name = type->GetParameterName(i);
+        fieldNames.push_back(name.empty() ? "arg" + std::to_string(i) : name);
+        fieldPositions.push_back(type->GetParameterSourcePos(i));
+    }
+    const StructType *argsType = new StructType(argsName, fieldTypes, fieldNames, fieldPositions, false,
+                                                Variability(Variability::Uniform), false, sym->pos);
+
+    llvm::SmallVector<const Type *, 8> batchParamTypes = {PointerType::GetUniform(argsType->GetAsConstType()),
+                                                          m->symbolTable->LookupType("size_t")->GetAsUniformType()};
+    llvm::SmallVector<std::string, 8> batchParamNames = {"args", "n"};
+    llvm::SmallVector<Expr *, 8> batchParamDefaults = {nullptr, nullptr};
+    llvm::SmallVector<SourcePos, 8> batchParamPositions = {sym->pos, sym->pos};
+    FunctionType *batchType =
+        new FunctionType(AtomicType::Void, batchParamTypes, batchParamNames, batchParamDefaults, batchParamPositions,
+                         false, true, type->isExternalOnly, false, false, false, type->isUnmangled,
+                         type->isVectorCall, type->isRegCall, type->isCdecl, sym->pos);
+    batchType->vectorWidth = type->vectorWidth;
+
+    auto [name_pref, name_suf] = batchType->GetFunctionMangledName(true);
+    llvm::Function *batchFunction =
+        batchType->CreateLLVMFunction(name_pref + batchName + name_suf, g->ctx, /*disableMask*/ true);
+    batchFunction->setDoesNotThrow();
+    batchFunction->setCallingConv(batchType->GetCallingConv());
+    batchFunction->setDLLStorageClass(appFunction->getDLLStorageClass());
+    AddUWTableFuncAttr(batchFunction);
+    g->target->markFuncWithTargetAttr(batchFunction);
+
+    // The loop over the elements of args with the calls of the exported
+    // function, which is inlined unless it's too large, so the setup of the
+    // mask and of the constants is hoisted out of the loop.
+    llvm::LLVMContext &context = *g->ctx;
+    llvm::BasicBlock *entryBlock = llvm::BasicBlock::Create(context, "entry", batchFunction);
+    llvm::BasicBlock *loopBlock = llvm::BasicBlock::Create(context, "loop", batchFunction);
+    llvm::BasicBlock *exitBlock = llvm::BasicBlock::Create(context, "exit", batchFunction);
+    llvm::IRBuilder<> builder(entryBlock);
+    llvm::Value *args = batchFunction->getArg(0);
+    llvm::Value *n = batchFunction->getArg(1);
+    args->setName("args");
+    n->setName("n");
+    llvm::Constant *zero = llvm::ConstantInt::get(n->getType(), 0);
+    builder.CreateCondBr(builder.CreateICmpEQ(n, zero), exitBlock, loopBlock);
+
+    builder.SetInsertPoint(loopBlock);
+    llvm::PHINode *index = builder.CreatePHI(n->getType(), 2, "index");
+    index->addIncoming(zero, entryBlock);
+    llvm::Type *argsLLVMType = argsType->LLVMStorageType(g->ctx);
+    llvm::Value *element = builder.CreateGEP(argsLLVMType, args, index, "element");
+    std::vector<llvm::Value *> callArgs;
+    for (int i = 0; i < type->GetNumParameters(); ++i) {
+        llvm::Type *paramType = appFunction->getFunctionType()->getParamType(i);
+        llvm::Value *field = builder.CreateStructGEP(argsLLVMType, element, i);
+        llvm::Type *fieldType = llvm::cast<llvm::StructType>(argsLLVMType)->getElementType(i);
+        llvm::Value *value = builder.CreateLoad(fieldType, field, fieldNames[i]);
+        if (fieldType != paramType) {
+            // The booleans are stored as bytes.
+            value = paramType->isIntegerTy(1) ? builder.CreateICmpNE(value, llvm::Constant::getNullValue(fieldType))
+                                              : builder.CreateBitCast(value, paramType);
+        }
+        callArgs.push_back(value);
+    }
+    llvm::CallInst *call = builder.CreateCall(appFunction, callArgs);
+    call->setCallingConv(appFunction->getCallingConv());
+    llvm::Value *next = builder.CreateAdd(index, llvm::ConstantInt::get(n->getType(), 1), "next");
+    index->addIncoming(next, loopBlock);
+    builder.CreateCondBr(builder.CreateICmpULT(next, n), loopBlock, exitBlock);
+
+    builder.SetInsertPoint(exitBlock);
+    builder.CreateRetVoid();
+
+    Symbol *batchSym = new Symbol(batchName, sym->pos, Symbol::SymbolKind::Function, batchType);
+    batchSym->function = batchFunction;
+    batchSym->exportedFunction = batchFunction;
+    m->symbolTable->AddFunction(batchSym);
+}
+
 void Function::GenerateIR() const {
     if (sym == nullptr) {
         // May be nullptr due to error earlier in compilation
@@ -659,6 +1129,8 @@ void Function::GenerateIR() const {
         return;
     }
 
+    FunctionOptScope optScope(function);
+
     // Figure out a reasonable source file position for the start of the
     // function body.  If possible, get the position of the first actual
     // non-StmtList statment...
@@ -678,6 +1150,7 @@ void Function::GenerateIR() const {
         const FunctionType *type = CastType<FunctionType>(sym->type);
         if (!type->IsISPCKernel()) {
             llvm::TimeTraceScope TimeScope("emitCode", llvm::StringRef(sym->name));
+            TimeReportScope TimeReport("codegen", sym->name);
             FunctionEmitContext ec(this, sym, function, firstStmtPos);
             emitCode(&ec, function, firstStmtPos);
         }
@@ -693,6 +1166,7 @@ void Function::GenerateIR() const {
         // <target> suffix.
         if (!type->isExternalOnly && !((type->isExternC || type->isExternSYCL) && g->mangleFunctionsWithTarget)) {
             llvm::TimeTraceScope TimeScope("emitCode", llvm::StringRef(sym->name));
+            TimeReportScope TimeReport("codegen", sym->name);
             FunctionEmitContext ec(this, sym, function, firstStmtPos);
             emitCode(&ec, function, firstStmtPos);
         }
@@ -705,14 +1179,24 @@ void Function::GenerateIR() const {
         // For 'extern "C"' we emit the version without mask parameter only.
         // For Xe we emit a version without mask parameter only for ISPC kernels and
         // ISPC external functions.
-        if (type->isExported || type->isExternC || type->isExternSYCL || type->IsISPCExternal() ||
+        // If '#pragma ispc targets' excludes the current target, the
+        // application's calls are dispatched to the variant of a lower
+        // target, so only the masked version is kept for the calls from
+        // the ispc code of this module.
+        if (type->isExported && !emitExportedFunction) {
+            UpdateLinkage(llvm::GlobalValue::InternalLinkage);
+        } else if (type->isExported || type->isExternC || type->isExternSYCL || type->IsISPCExternal() ||
             type->IsISPCKernel()) {
             auto [name_pref, name_suf] = type->GetFunctionMangledName(true);
             std::string functionName = name_pref + sym->name + name_suf;
+            if (narrowVersion) {
+                functionName += "___narrow";
+            }
 
             llvm::Function *appFunction = type->CreateLLVMFunction(functionName, g->ctx, /*disableMask*/ true);
             appFunction->setDoesNotThrow();
             appFunction->setCallingConv(type->GetCallingConv());
+            lCopyOptimizeAttributes(function, appFunction);
 
             AddUWTableFuncAttr(appFunction);
 
@@ -748,11 +1232,22 @@ void Function::GenerateIR() const {
                 appFunction->eraseFromParent();
             } else {
                 llvm::TimeTraceScope TimeScope("emitCode", llvm::StringRef(sym->name));
+                TimeReportScope TimeReport("codegen", sym->name);
                 // And emit the code again
                 FunctionEmitContext ec(this, sym, appFunction, firstStmtPos);
                 emitCode(&ec, appFunction, firstStmtPos);
                 if (m->errorCount == 0) {
                     sym->exportedFunction = appFunction;
+                    if (!specializedParams.empty()) {
+                        lSpecializeFunction(appFunction, specializedParams);
+                    }
+                    if (narrowParam >= 0) {
+                        lDispatchToNarrowVersion(appFunction, narrowParam, narrowThreshold,
+                                                 type->GetParameterType(narrowParam)->IsUnsignedType());
+                    }
+                    if (function->hasFnAttribute("ispc-batch")) {
+                        lEmitBatchFunction(sym, type, appFunction);
+                    }
                 }
             }
         } else {
@@ -779,6 +1274,15 @@ void Function::GenerateIR() const {
     }
 }
 
+void Function::ReleaseAST(bool releasePinned) {
+    if (arena == nullptr || (arena->pinned && !releasePinned)) {
+        return;
+    }
+    BookKeeper::in().freeArena(arena);
+    arena = nullptr;
+    code = nullptr;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // TemplateParam
 
@@ -1101,17 +1605,32 @@ void FunctionTemplate::Print(Indent &indent) const {
 };
 
 Symbol *FunctionTemplate::LookupInstantiation(const TemplateArgs &tArgs) {
-    TemplateArgs argsToMatch(tArgs);
     for (const auto &inst : instantiations) {
-        if (inst.args == argsToMatch) {
+        if (inst.args == tArgs) {
             return inst.symbol;
         }
     }
     return nullptr;
 }
 
+bool FunctionTemplate::LookupDeduction(const std::vector<const Type *> &argTypes, Symbol **s) const {
+    auto iter = deductions.find(argTypes);
+    if (iter == deductions.end()) {
+        return false;
+    }
+    *s = iter->second;
+    return true;
+}
+
+void FunctionTemplate::AddDeduction(const std::vector<const Type *> &argTypes, Symbol *s) { deductions[argTypes] = s; }
+
 Symbol *FunctionTemplate::AddInstantiation(const TemplateArgs &tArgs, TemplateInstantiationKind kind, bool isInline,
                                            bool isNoinline) {
+    // The instantiation outlives the function that it's made for, whose
+    // arena also holds the template arguments.
+    BookKeeper::in().pinCurrentArena();
+    BookKeeper::SuspendArena suspendArena;
+
     const TemplateParms *typenames = GetTemplateParms();
     Assert(typenames);
     TemplateInstantiation templInst(*typenames, tArgs, isInline, isNoinline);
@@ -1134,6 +1653,9 @@ Symbol *FunctionTemplate::AddInstantiation(const TemplateArgs &tArgs, TemplateIn
 
 Symbol *FunctionTemplate::AddSpecialization(const FunctionType *ftype, const TemplateArgs &tArgs, bool isInline,
                                             bool isNoInline, SourcePos pos) {
+    BookKeeper::in().pinCurrentArena();
+    BookKeeper::SuspendArena suspendArena;
+
     const TemplateParms *typenames = GetTemplateParms();
     Assert(typenames);
     TemplateInstantiation templInst(*typenames, tArgs, isInline, isNoInline);
@@ -1235,6 +1757,8 @@ Symbol *TemplateInstantiation::InstantiateSymbol(Symbol *sym) {
     return instSym;
 }
 
+void TemplateInstantiation::MapSymbol(Symbol *sym, Symbol *to) { symMap[sym] = to; }
+
 Symbol *TemplateInstantiation::InstantiateTemplateSymbol(TemplateSymbol *sym) {
     // The function is assumed to be called once per instantiation and
     // only for the tempalte that is being instantiated.
@@ -14,6 +14,7 @@
 #include "ispc.h"
 #include "type.h"
 
+#include <map>
 #include <unordered_map>
 #include <vector>
 
@@ -21,7 +22,9 @@ namespace ispc {
 
 class Function {
   public:
-    Function(Symbol *sym, Stmt *code);
+    Function(Symbol *sym, Stmt *code, const std::vector<FunctionSpecialization> &specializations = {},
+             const FunctionTargets &targets = {}, const FunctionNarrowing &narrowing = {},
+             bool isConstexpr = false);
     Function(Symbol *sym, Stmt *code, Symbol *maskSymbol, std::vector<Symbol *> &args);
 
     const Type *GetReturnType() const;
@@ -30,6 +33,11 @@ class Function {
     /** Generate LLVM IR for the function into the current module. */
     void GenerateIR() const;
 
+    /** Free the AST of the body of the function once it has been emitted.
+        If other functions may refer to it, it is only freed with
+        \c releasePinned (see BookKeeper::Arena). */
+    void ReleaseAST(bool releasePinned);
+
     void Print() const;
     void Print(Indent &indent) const;
 
@@ -39,22 +47,47 @@ class Function {
     /** Sets requested linkage */
     void UpdateLinkage(llvm::GlobalValue::LinkageTypes linkage) const;
 
+    /** Returns true if the function was defined with the "constexpr"
+        qualifier, so that its calls may be evaluated at compile time (see
+        EvaluateConstexprCall()). */
+    bool IsConstexpr() const { return isConstexpr; }
+    const std::vector<Symbol *> &GetParameterSymbols() const { return args; }
+    const Stmt *GetCode() const { return code; }
+
   private:
     enum class DebugPrintPoint { Initial, AfterTypeChecking, AfterOptimization };
     void debugPrintHelper(DebugPrintPoint dumpPoint);
     void typeCheckAndOptimize();
+    void checkConstexpr();
 
     void emitCode(FunctionEmitContext *ctx, llvm::Function *function, SourcePos firstStmtPos) const;
 
     Symbol *sym;
     std::vector<Symbol *> args;
     Stmt *code;
+    // Arena of the AST nodes of the body, if the function was parsed as a
+    // function definition.
+    BookKeeper::Arena *arena;
     Symbol *maskSymbol;
     Symbol *threadIndexSym, *threadCountSym;
     Symbol *taskIndexSym, *taskCountSym;
     Symbol *taskIndexSym0, *taskCountSym0;
     Symbol *taskIndexSym1, *taskCountSym1;
     Symbol *taskIndexSym2, *taskCountSym2;
+    // Indices of the parameters of an exported function, which it is
+    // specialized for with '#pragma ispc specialize', and their values.
+    std::vector<std::pair<int, std::vector<int64_t>>> specializedParams;
+    // The index of the parameter of an exported function, whose values
+    // below narrowThreshold are dispatched to its narrow version with
+    // '#pragma ispc narrow', or -1.  narrowVersion is true when that
+    // version is compiled, for the target of the narrow width.
+    int narrowParam{-1};
+    int64_t narrowThreshold{0};
+    bool narrowVersion{false};
+    // False if '#pragma ispc targets' excludes the current target, so that
+    // the exported version of the function isn't emitted for it.
+    bool emitExportedFunction;
+    bool isConstexpr;
 };
 
 // Represents a single template parameter, which can either be a type (TemplateTypeParmType) or a non-type
@@ -160,6 +193,12 @@ class FunctionTemplate {
     StorageClass GetStorageClass();
 
     Symbol *LookupInstantiation(const TemplateArgs &tArgs);
+    /** Looks for the result of a previous deduction of all the template
+        arguments from the given types of the function call arguments.
+        Returns false if there was none, otherwise sets \c sym to the
+        instantiation (nullptr if the deduction failed). */
+    bool LookupDeduction(const std::vector<const Type *> &argTypes, Symbol **sym) const;
+    void AddDeduction(const std::vector<const Type *> &argTypes, Symbol *sym);
     Symbol *AddInstantiation(const TemplateArgs &tArgs, TemplateInstantiationKind kind, bool isInline, bool isNoInline);
     Symbol *AddSpecialization(const FunctionType *ftype, const TemplateArgs &tArgs, bool isInline, bool isNoInline,
                               SourcePos pos);
@@ -184,6 +223,9 @@ class FunctionTemplate {
     Symbol *maskSymbol;
 
     std::vector<InstantiationMap> instantiations;
+    // Results of the template argument deductions, so that the calls with
+    // the same argument types don't deduce them again.
+    std::map<std::vector<const Type *>, Symbol *> deductions;
 };
 
 // A helper class to drive function instantiation, it provides the following:
@@ -194,6 +236,8 @@ class TemplateInstantiation {
     TemplateInstantiation(const TemplateParms &typeParms, const TemplateArgs &tArgs, bool IsInline, bool IsNoInline);
     const Type *InstantiateType(const std::string &name);
     Symbol *InstantiateSymbol(Symbol *sym);
+    // Make the given symbol be replaced by \c to in the instantiation instead of by a copy.
+    void MapSymbol(Symbol *sym, Symbol *to);
     Symbol *InstantiateTemplateSymbol(TemplateSymbol *sym);
     void SetFunction(Function *func);
 
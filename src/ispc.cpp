@@ -33,6 +33,7 @@
 #include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/DebugInfo.h>
+#include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
@@ -150,6 +151,7 @@ static ISPCTarget lGetSystemISA() {
     bool avx =                 (info[2] & (1 << 28))  != 0;
     bool avx2 =                (info2[1] & (1 << 5))  != 0;
     bool avx_vnni =            (info3[0] & (1 << 4))  != 0;
+    bool avx10 =               (info3[3] & (1 << 19)) != 0;
 
     bool avx512_f =            (info2[1] & (1 << 16)) != 0;
     // clang-format on
@@ -211,6 +213,11 @@ static ISPCTarget lGetSystemISA() {
         // or whatever is available in the machine.
     }
 
+    // AVX10 limited to 256-bit vectors doesn't report AVX-512.
+    if (osxsave && avx10 && __os_has_avx512_support()) {
+        return ISPCTarget::avx10_x8;
+    }
+
     if (osxsave && avx && __os_has_avx_support()) {
         if (avx_vnni) {
             return ISPCTarget::avx2vnni_i32x8;
@@ -252,6 +259,14 @@ static bool lIsTargetValidforArch(ISPCTarget target, Arch arch) {
         if (arch != Arch::arm && arch != Arch::aarch64) {
             ret = false;
         }
+    } else if (ISPCTargetIsSve(target)) {
+        if (arch != Arch::aarch64) {
+            ret = false;
+        }
+    } else if (ISPCTargetIsRvv(target)) {
+        if (arch != Arch::riscv64) {
+            ret = false;
+        }
     } else if (ISPCTargetIsGen(target)) {
         if (arch != Arch::xe64) {
             ret = false;
@@ -348,6 +363,12 @@ typedef enum {
     CPU_CortexA53,
     CPU_CortexA57,
 
+    // Arm CPUs with SVE: Neoverse N2 (128-bit SVE2), Neoverse V1 (256-bit
+    // SVE) and A64FX (512-bit SVE).
+    CPU_NeoverseN2,
+    CPU_NeoverseV1,
+    CPU_A64FX,
+
     // Apple CPUs.
     CPU_AppleA7,
     CPU_AppleA10,
@@ -411,6 +432,9 @@ std::map<DeviceType, std::set<std::string>> CPUFeatures = {
     {CPU_CortexA35, {}},
     {CPU_CortexA53, {}},
     {CPU_CortexA57, {}},
+    {CPU_NeoverseN2, {}},
+    {CPU_NeoverseV1, {}},
+    {CPU_A64FX, {}},
     {CPU_AppleA7, {}},
     {CPU_AppleA10, {}},
     {CPU_AppleA11, {}},
@@ -520,6 +544,9 @@ class AllCPUs {
         names[CPU_CortexA35].push_back("cortex-a35");
         names[CPU_CortexA53].push_back("cortex-a53");
         names[CPU_CortexA57].push_back("cortex-a57");
+        names[CPU_NeoverseN2].push_back("neoverse-n2");
+        names[CPU_NeoverseV1].push_back("neoverse-v1");
+        names[CPU_A64FX].push_back("a64fx");
 
         names[CPU_AppleA7].push_back("apple-a7");
         names[CPU_AppleA10].push_back("apple-a10");
@@ -612,6 +639,9 @@ class AllCPUs {
         compat[CPU_CortexA35] = Set(CPU_CortexA35, CPU_None);
         compat[CPU_CortexA53] = Set(CPU_CortexA53, CPU_None);
         compat[CPU_CortexA57] = Set(CPU_CortexA57, CPU_None);
+        compat[CPU_NeoverseN2] = Set(CPU_NeoverseN2, CPU_None);
+        compat[CPU_NeoverseV1] = Set(CPU_NeoverseV1, CPU_None);
+        compat[CPU_A64FX] = Set(CPU_A64FX, CPU_None);
         compat[CPU_AppleA7] = Set(CPU_AppleA7, CPU_None);
         compat[CPU_AppleA10] = Set(CPU_AppleA10, CPU_None);
         compat[CPU_AppleA11] = Set(CPU_AppleA11, CPU_None);
@@ -697,6 +727,14 @@ Arch lGetArchFromTarget(ISPCTarget target) {
         return Arch::aarch64;
 #endif
     }
+    if (ISPCTargetIsSve(target)) {
+        return Arch::aarch64;
+    }
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    if (ISPCTargetIsRvv(target)) {
+        return Arch::riscv64;
+    }
 #endif
 #if ISPC_XE_ENABLED
     if (ISPCTargetIsGen(target)) {
@@ -714,10 +752,11 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
       m_isa(SSE2), m_arch(Arch::none), m_is32Bit(true), m_cpu(""), m_attributes(""), m_tf_attributes(nullptr),
       m_nativeVectorWidth(-1), m_nativeVectorAlignment(-1), m_dataTypeWidth(-1), m_vectorWidth(-1),
       m_picLevel(picLevel), m_codeModel(code_model), m_maskingIsFree(false), m_maskBitCount(-1),
-      m_hasDotProductVNNI(false), m_hasHalfConverts(false), m_hasHalfFullSupport(false), m_hasRand(false),
-      m_hasGather(false), m_hasScatter(false), m_hasTranscendentals(false), m_hasTrigonometry(false),
-      m_hasRsqrtd(false), m_hasRcpd(false), m_hasVecPrefetch(false), m_hasSaturatingArithmetic(false),
-      m_hasFp16Support(false), m_hasFp64Support(true), m_warnings(0) {
+      m_hasDotProductVNNI(false), m_hasAMX(false), m_hasBF16(false), m_hasCRC32(false),
+      m_hasHalfConverts(false), m_hasHalfFullSupport(false), m_hasRand(false), m_hasGather(false), m_hasScatter(false),
+      m_hasTranscendentals(false), m_hasTrigonometry(false), m_hasRsqrtd(false), m_hasRcpd(false),
+      m_hasVecPrefetch(false), m_hasSaturatingArithmetic(false), m_hasFp16Support(false), m_hasFp64Support(true),
+      m_warnings(0) {
     DeviceType CPUID = CPU_None, CPUfromISA = CPU_None;
     AllCPUs a;
     std::string featuresString;
@@ -763,6 +802,17 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         case CPU_AppleA14:
             m_ispc_target = ISPCTarget::neon_i32x4;
             break;
+        // The SVE targets are compiled for a fixed vector length, which is
+        // the one of the CPU.
+        case CPU_NeoverseN2:
+            m_ispc_target = ISPCTarget::sve_i32x4;
+            break;
+        case CPU_NeoverseV1:
+            m_ispc_target = ISPCTarget::sve_i32x8;
+            break;
+        case CPU_A64FX:
+            m_ispc_target = ISPCTarget::sve_i32x16;
+            break;
 #endif
 
 #ifdef ISPC_XE_ENABLED
@@ -895,7 +945,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
     }
 
     // FP16 support for Xe and Arm. For x86 set is individually for appropriate targets.
-    if (ISPCTargetIsGen(m_ispc_target) || ISPCTargetIsNeon(m_ispc_target)) {
+    if (ISPCTargetIsGen(m_ispc_target) || ISPCTargetIsNeon(m_ispc_target) || ISPCTargetIsSve(m_ispc_target)) {
         m_hasFp16Support = true;
     }
 
@@ -1258,6 +1308,8 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         this->m_hasDotProductVNNI = true;
+        this->m_hasAMX = true;
+        this->m_hasBF16 = true;
         CPUfromISA = CPU_SPR;
         this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
         this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
@@ -1280,6 +1332,8 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         this->m_hasDotProductVNNI = true;
+        this->m_hasAMX = true;
+        this->m_hasBF16 = true;
         CPUfromISA = CPU_SPR;
         this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
         this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
@@ -1302,6 +1356,8 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         this->m_hasDotProductVNNI = true;
+        this->m_hasAMX = true;
+        this->m_hasBF16 = true;
         CPUfromISA = CPU_SPR;
         if (g->opt.disableZMM) {
             this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
@@ -1329,6 +1385,8 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         this->m_hasDotProductVNNI = true;
+        this->m_hasAMX = true;
+        this->m_hasBF16 = true;
         CPUfromISA = CPU_SPR;
         break;
     case ISPCTarget::avx512spr_x32:
@@ -1349,8 +1407,36 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_hasVecPrefetch = false;
         this->m_hasFp16Support = true;
         this->m_hasDotProductVNNI = true;
+        this->m_hasAMX = true;
+        this->m_hasBF16 = true;
         CPUfromISA = CPU_SPR;
         break;
+    case ISPCTarget::avx10_x4:
+    case ISPCTarget::avx10_x8:
+        // The AVX-512 feature set of Sapphire Rapids without AMX, with no
+        // zmm registers: the vectors are at most 256 bits wide.
+        this->m_isa = Target::AVX10;
+        this->m_nativeVectorWidth = 8;
+        this->m_nativeVectorAlignment = 32;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = (m_ispc_target == ISPCTarget::avx10_x4) ? 4 : 8;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasHalfConverts = true;
+        this->m_hasHalfFullSupport = true;
+        this->m_hasRand = true;
+        this->m_hasGather = this->m_hasScatter = true;
+        this->m_hasTranscendentals = false;
+        this->m_hasTrigonometry = false;
+        this->m_hasRsqrtd = this->m_hasRcpd = true;
+        this->m_hasVecPrefetch = false;
+        this->m_hasFp16Support = true;
+        this->m_hasDotProductVNNI = true;
+        this->m_hasBF16 = true;
+        CPUfromISA = CPU_SPR;
+        this->m_funcAttributes.push_back(std::make_pair("prefer-vector-width", "256"));
+        this->m_funcAttributes.push_back(std::make_pair("min-legal-vector-width", "256"));
+        break;
 #ifdef ISPC_ARM_ENABLED
     case ISPCTarget::neon_i8x16:
         this->m_isa = Target::NEON;
@@ -1403,21 +1489,80 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         this->m_maskingIsFree = (arch == Arch::aarch64);
         this->m_maskBitCount = 32;
         break;
+    // The SVE targets are compiled for a fixed vector length of 32 * width
+    // bits, so that the varying values are single SVE registers and the
+    // mask is a predicate register.  The masked loads, stores, gathers and
+    // scatters are emitted as the predicated SVE instructions.
+    case ISPCTarget::sve_i32x4:
+    case ISPCTarget::sve_i32x8:
+    case ISPCTarget::sve_i32x16: {
+        int width = m_ispc_target == ISPCTarget::sve_i32x4 ? 4 : (m_ispc_target == ISPCTarget::sve_i32x8 ? 8 : 16);
+        this->m_isa = Target::SVE;
+        this->m_nativeVectorWidth = width;
+        this->m_nativeVectorAlignment = width * 4;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = width;
+        this->m_hasHalfConverts = true;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasGather = this->m_hasScatter = true;
+        break;
+    }
 #else
     case ISPCTarget::neon_i8x16:
     case ISPCTarget::neon_i16x8:
     case ISPCTarget::neon_i32x4:
     case ISPCTarget::neon_i32x8:
+    case ISPCTarget::sve_i32x4:
+    case ISPCTarget::sve_i32x8:
+    case ISPCTarget::sve_i32x16:
+        unsupported_target = true;
+        break;
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    // The RVV targets only assume the minimal VLEN of 128 bits, so the
+    // varying int32 values are register groups of LMUL = width / 4, and the
+    // mask is a mask register.  The masked loads, stores, gathers and
+    // scatters are emitted as the masked RVV instructions.
+    case ISPCTarget::rvv_i32x4:
+    case ISPCTarget::rvv_i32x8:
+    case ISPCTarget::rvv_i32x16: {
+        int width = m_ispc_target == ISPCTarget::rvv_i32x4 ? 4 : (m_ispc_target == ISPCTarget::rvv_i32x8 ? 8 : 16);
+        this->m_isa = Target::RVV;
+        this->m_nativeVectorWidth = width;
+        this->m_nativeVectorAlignment = width * 4;
+        this->m_dataTypeWidth = 32;
+        this->m_vectorWidth = width;
+        this->m_hasHalfConverts = false;
+        this->m_hasHalfFullSupport = false;
+        this->m_maskingIsFree = true;
+        this->m_maskBitCount = 1;
+        this->m_hasTranscendentals = false;
+        this->m_hasTrigonometry = false;
+        this->m_hasRcpd = false;
+        this->m_hasRsqrtd = false;
+        this->m_hasGather = this->m_hasScatter = true;
+        this->m_hasVecPrefetch = false;
+        break;
+    }
+#else
+    case ISPCTarget::rvv_i32x4:
+    case ISPCTarget::rvv_i32x8:
+    case ISPCTarget::rvv_i32x16:
         unsupported_target = true;
         break;
 #endif
 #ifdef ISPC_WASM_ENABLED
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x8:
         this->m_isa = Target::WASM;
         this->m_nativeVectorWidth = 4;
         this->m_nativeVectorAlignment = 16;
         this->m_dataTypeWidth = 32;
-        this->m_vectorWidth = 4;
+        this->m_vectorWidth =
+            (m_ispc_target == ISPCTarget::wasm_i32x8 || m_ispc_target == ISPCTarget::wasm_relaxed_i32x8) ? 8 : 4;
         this->m_hasHalfConverts = false;
         this->m_hasHalfFullSupport = false;
         this->m_maskingIsFree = false;
@@ -1432,6 +1577,9 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         break;
 #else
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x8:
         unsupported_target = true;
         break;
 #endif
@@ -1712,6 +1860,7 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
     case Target::SKX_AVX512:
     case Target::ICL_AVX512:
     case Target::SPR_AVX512:
+    case Target::AVX10:
         this->setWarning(PerfWarningType::DIVModInt);
         break;
     default:
@@ -1719,6 +1868,9 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         ;
     }
 
+    // The crc32 instruction came with SSE4.2, so all the later x86 ISAs have it.
+    this->m_hasCRC32 = this->m_isa >= Target::SSE42 && this->m_isa <= Target::AVX10;
+
 #if defined(ISPC_ARM_ENABLED)
     if ((CPUID == CPU_None) && ISPCTargetIsNeon(m_ispc_target)) {
         if (arch == Arch::arm) {
@@ -1736,6 +1888,16 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
             UNREACHABLE();
         }
     }
+    if ((CPUID == CPU_None) && ISPCTargetIsSve(m_ispc_target)) {
+        // Pick a CPU with the vector length of the target.
+        if (m_ispc_target == ISPCTarget::sve_i32x4) {
+            CPUID = CPU_NeoverseN2;
+        } else if (m_ispc_target == ISPCTarget::sve_i32x8) {
+            CPUID = CPU_NeoverseV1;
+        } else {
+            CPUID = CPU_A64FX;
+        }
+    }
 #endif
 
     if (CPUID == CPU_None) {
@@ -1800,13 +1962,41 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
             }
             featuresString = "+neon,+fp16";
         } else if (arch == Arch::aarch64) {
+            std::string sveFeatures = m_isa == Target::SVE ? ",+sve" : "";
             if (g->target_os == TargetOS::custom_linux) {
                 this->m_funcAttributes.push_back(
-                    std::make_pair("target-features", "+aes,+crc,+crypto,+fp-armv8,+neon,+sha2"));
+                    std::make_pair("target-features", "+aes,+crc,+crypto,+fp-armv8,+neon,+sha2" + sveFeatures));
             } else {
-                this->m_funcAttributes.push_back(std::make_pair("target-features", "+neon"));
+                this->m_funcAttributes.push_back(std::make_pair("target-features", "+neon" + sveFeatures));
             }
-            featuresString = "+neon";
+            featuresString = "+neon" + sveFeatures;
+        }
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        if (arch == Arch::riscv64) {
+            // RV64GC with the V extension and the lp64d ABI, like the
+            // Linux distributions.
+            this->m_funcAttributes.push_back(std::make_pair("target-features", "+m,+a,+f,+d,+c,+v"));
+            featuresString = "+m,+a,+f,+d,+c,+v";
+            options.MCOptions.ABIName = "lp64d";
+        }
+#endif
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
+        if (m_isa == Target::AVX10) {
+            // Keep the AVX-512 instructions of the CPU but forbid the 512-bit
+            // registers, also in the code that LLVM generates on its own.
+            this->m_funcAttributes.push_back(std::make_pair("target-features", "-evex512"));
+            featuresString = "-evex512";
+        }
+#endif
+#ifdef ISPC_WASM_ENABLED
+        if (arch == Arch::wasm32 || arch == Arch::wasm64) {
+            // The relaxed targets may also use the relaxed-simd instructions,
+            // whose results are implementation-defined for corner cases.
+            bool relaxed = m_ispc_target == ISPCTarget::wasm_relaxed_i32x4 ||
+                           m_ispc_target == ISPCTarget::wasm_relaxed_i32x8;
+            featuresString = relaxed ? "+simd128,+relaxed-simd" : "+simd128";
+            this->m_funcAttributes.push_back(std::make_pair("target-features", featuresString));
         }
 #endif
 
@@ -1876,9 +2066,21 @@ Target::Target(Arch arch, const char *cpu, ISPCTarget ispc_target, PICLevel picL
         // TO-DO : Revisit addition of "target-features" and "target-cpu" for ARM support.
         llvm::AttrBuilder *fattrBuilder = new llvm::AttrBuilder(*g->ctx);
 #ifdef ISPC_ARM_ENABLED
-        if (m_isa == Target::NEON) {
+        if (m_isa == Target::NEON || m_isa == Target::SVE) {
             fattrBuilder->addAttribute("target-cpu", this->m_cpu);
         }
+        if (m_isa == Target::SVE) {
+            // The number of 128-bit granules of the SVE registers.
+            unsigned vscale = m_vectorWidth * 32 / 128;
+            fattrBuilder->addVScaleRangeAttr(vscale, vscale);
+        }
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        if (m_isa == Target::RVV) {
+            // vscale is VLEN / 64 for RVV: VLEN is at least 128 bits (Zvl128b)
+            // and at most 65536 bits.
+            fattrBuilder->addVScaleRangeAttr(2, 1024);
+        }
 #endif
         for (auto const &f_attr : m_funcAttributes) {
             fattrBuilder->addAttribute(f_attr.first, f_attr.second);
@@ -1961,6 +2163,16 @@ std::string Target::SupportedCPUs() {
     return a.HumanReadableListOfNames();
 }
 
+bool Target::IsXeDevice(const std::string &name) {
+#ifdef ISPC_XE_ENABLED
+    AllCPUs a;
+    DeviceType type = a.GetTypeFromName(name);
+    return type >= GPU_SKL && type <= GPU_LNL_M;
+#else
+    return false;
+#endif
+}
+
 std::string Target::GetTripleString() const {
     llvm::Triple triple;
     switch (g->target_os) {
@@ -2003,6 +2215,8 @@ std::string Target::GetTripleString() const {
             triple.setArchName("armv7");
         } else if (m_arch == Arch::aarch64) {
             triple.setArchName("aarch64");
+        } else if (m_arch == Arch::riscv64) {
+            triple.setArchName("riscv64");
         } else if (m_arch == Arch::xe64) {
             triple.setArchName("spir64");
         } else {
@@ -2019,7 +2233,8 @@ std::string Target::GetTripleString() const {
 #endif
         triple.setVendor(llvm::Triple::VendorType::UnknownVendor);
         triple.setOS(llvm::Triple::OSType::Linux);
-        if (m_arch == Arch::x86 || m_arch == Arch::x86_64 || m_arch == Arch::aarch64 || m_arch == Arch::xe64) {
+        if (m_arch == Arch::x86 || m_arch == Arch::x86_64 || m_arch == Arch::aarch64 || m_arch == Arch::riscv64 ||
+            m_arch == Arch::xe64) {
             triple.setEnvironment(llvm::Triple::EnvironmentType::GNU);
         } else if (m_arch == Arch::arm) {
             triple.setEnvironment(llvm::Triple::EnvironmentType::GNUEABIHF);
@@ -2138,6 +2353,12 @@ const char *Target::ISAToString(ISA isa) {
 #ifdef ISPC_ARM_ENABLED
     case Target::NEON:
         return "neon";
+    case Target::SVE:
+        return "sve";
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    case Target::RVV:
+        return "rvv";
 #endif
 #ifdef ISPC_WASM_ENABLED
     case Target::WASM:
@@ -2162,6 +2383,8 @@ const char *Target::ISAToString(ISA isa) {
         return "avx512icl";
     case Target::SPR_AVX512:
         return "avx512spr";
+    case Target::AVX10:
+        return "avx10";
 #ifdef ISPC_XE_ENABLED
     case Target::GEN9:
         return "gen9";
@@ -2194,6 +2417,12 @@ const char *Target::ISAToTargetString(ISA isa) {
 #ifdef ISPC_ARM_ENABLED
     case Target::NEON:
         return "neon-i32x4";
+    case Target::SVE:
+        return "sve-i32x4";
+#endif
+#ifdef ISPC_RISCV_ENABLED
+    case Target::RVV:
+        return "rvv-i32x4";
 #endif
 #ifdef ISPC_WASM_ENABLED
     case Target::WASM:
@@ -2233,6 +2462,8 @@ const char *Target::ISAToTargetString(ISA isa) {
         return "avx512icl-x16";
     case Target::SPR_AVX512:
         return "avx512spr-x16";
+    case Target::AVX10:
+        return "avx10-x8";
     default:
         FATAL("Unhandled target in ISAToTargetString()");
     }
@@ -2399,13 +2630,104 @@ bool Target::hasXePrefetch() const {
     }
     return false;
 }
+
+bool Target::hasXeLSCBlockMemOps() const {
+    switch (getXePlatform()) {
+    case XePlatform::xe2_hpg:
+    case XePlatform::xe2_lpg:
+        return true;
+    default:
+        return false;
+    }
+    return false;
+}
+#endif
+
+int Target::getDataCacheSize(int level) const {
+    Assert(level == 1 || level == 2);
+    AllCPUs a;
+    int l1 = 32 * 1024, l2 = 256 * 1024;
+    switch (a.GetTypeFromName(m_cpu)) {
+    case CPU_Bonnell:
+    case CPU_Silvermont:
+        l1 = 24 * 1024;
+        l2 = 512 * 1024;
+        break;
+    case CPU_Core2:
+    case CPU_Penryn:
+        // The L2 cache is shared by two cores.
+        l2 = 1024 * 1024;
+        break;
+    case CPU_KNL:
+        // The L2 cache is shared by the two cores of a tile.
+        l2 = 512 * 1024;
+        break;
+    case CPU_SKX:
+        l2 = 1024 * 1024;
+        break;
+    case CPU_ICL:
+        l1 = 48 * 1024;
+        l2 = 512 * 1024;
+        break;
+    case CPU_ICX:
+    case CPU_TGL:
+    case CPU_ADL:
+        l1 = 48 * 1024;
+        l2 = 1280 * 1024;
+        break;
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
+    case CPU_MTL:
+#endif
+    case CPU_SPR:
+        l1 = 48 * 1024;
+        l2 = 2048 * 1024;
+        break;
+    case CPU_PS4:
+    case CPU_ZNVER1:
+    case CPU_ZNVER2:
+    case CPU_ZNVER3:
+        l2 = 512 * 1024;
+        break;
+#ifdef ISPC_ARM_ENABLED
+    case CPU_CortexA15:
+    case CPU_CortexA57:
+        l2 = 512 * 1024;
+        break;
+    case CPU_NeoverseN2:
+    case CPU_NeoverseV1:
+        l1 = 64 * 1024;
+        l2 = 1024 * 1024;
+        break;
+    case CPU_A64FX:
+        // The L2 cache is shared by the 12 cores of a CMG.
+        l1 = 64 * 1024;
+        l2 = 8 * 1024 * 1024;
+        break;
+    case CPU_AppleA7:
+        l1 = 64 * 1024;
+        l2 = 1024 * 1024;
+        break;
+    case CPU_AppleA10:
+    case CPU_AppleA11:
+    case CPU_AppleA12:
+    case CPU_AppleA13:
+    case CPU_AppleA14:
+        // The L2 cache is shared by the performance cores.
+        l1 = 64 * 1024;
+        l2 = 2048 * 1024;
+        break;
 #endif
+    default:
+        break;
+    }
+    return level == 1 ? l1 : l2;
+}
 
 ///////////////////////////////////////////////////////////////////////////
 // Opt
 
 Opt::Opt() {
-    level = 1;
+    level = 2;
     fastMath = false;
     fastMaskedVload = false;
     force32BitAddressing = true;
@@ -2425,17 +2747,61 @@ Opt::Opt() {
     disableGatherScatterFlattening = false;
     disableUniformMemoryOptimizations = false;
     disableCoalescing = false;
+    disableInvariantDivision = false;
+    disableLocalArrayPromotion = false;
+    disableMaskedMemOpHoisting = false;
+    disableLaunchFusion = false;
+    disableForeachFusion = false;
+    disableInternalRegCall = false;
+    foreachSingleBody = false;
+    maskMultiversioning = false;
+    coherentGathers = false;
+    mergeTargetVariants = false;
+    uniformityInference = false;
+    prefetchDistance = 0;
+    switchDispatchThreshold = 8;
+    streamingStores = false;
     disableZMM = false;
     resetFTZ_DAZ = false;
 #ifdef ISPC_XE_ENABLED
     disableXeGatherCoalescing = false;
     thresholdForXeGatherCoalescing = 0;
+    disableXeBlockMemOps = false;
     enableForeachInsideVarying = false;
     emitXeHardwareMask = false;
     enableXeUnsafeMaskedLoad = false;
 #endif
 }
 
+/** Sets flag from the given boolean string attribute of the function, if
+    it has it.  For the options that disable something, the value of the
+    attribute is the opposite of the flag. */
+static void lOverrideFlag(const llvm::Function *function, const char *name, bool &flag, bool disables) {
+    llvm::Attribute attr = function->getFnAttribute(name);
+    if (attr.isStringAttribute()) {
+        flag = (attr.getValueAsString() == "true") != disables;
+    }
+}
+
+Opt Opt::ForFunction(const llvm::Function *function) const {
+    Opt opt = *this;
+    if (function == nullptr) {
+        return opt;
+    }
+    llvm::Attribute levelAttr = function->getFnAttribute("ispc-opt-level");
+    if (levelAttr.isStringAttribute()) {
+        opt.level = levelAttr.getValueAsString() == "0" ? 0 : (levelAttr.getValueAsString() == "1" ? 1 : 2);
+        if (opt.level == 1) {
+            // As for -O1 on the command line.
+            opt.disableCoherentControlFlow = true;
+        }
+    }
+    lOverrideFlag(function, "ispc-fast-math", opt.fastMath, false);
+    lOverrideFlag(function, "ispc-fma", opt.disableFMA, true);
+    lOverrideFlag(function, "ispc-unroll-loops", opt.unrollLoops, false);
+    return opt;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // Globals
 
@@ -2468,6 +2834,7 @@ Globals::Globals() {
     disableLineWrap = false;
     emitPerfWarnings = true;
     emitInstrumentation = false;
+    emitLaneProfile = false;
     noPragmaOnce = false;
     generateDebuggingSymbols = false;
     debugInfoType = Globals::DebugInfoType::None;
@@ -2475,11 +2842,20 @@ Globals::Globals() {
     enableLLVMIntrinsics = false;
     mangleFunctionsWithTarget = false;
     isMultiTargetCompilation = false;
+    isWidthVariantCompilation = false;
     errorLimit = -1;
 
     enableTimeTrace = false;
     // set default granularity to 500.
     timeTraceGranularity = 500;
+    numJobs = 1;
+    codegenThreads = 1;
+    emitThinLTO = false;
+    emitLTO = false;
+    ifuncDispatch = false;
+    singleObject = false;
+    jitSource = nullptr;
+    jitObject = nullptr;
     target = nullptr;
     ctx = new llvm::LLVMContext;
 
@@ -2492,6 +2868,7 @@ Globals::Globals() {
 
 #ifdef ISPC_XE_ENABLED
     stackMemSize = 0;
+    resourceReport = false;
 #endif
 
 #ifdef ISPC_HOST_IS_WINDOWS
@@ -2502,6 +2879,8 @@ Globals::Globals() {
     }
 #endif
     forceAlignment = -1;
+    profileGenerate = false;
+    optReport = false;
     dllExport = false;
 
     // Target OS defaults to host OS.
@@ -2578,5 +2957,47 @@ BookKeeper &BookKeeper::in() {
     return instance;
 }
 
+void *BookKeeper::addNode(Traceable *p) {
+    if (currentArena == nullptr) {
+        return add(p);
+    }
+    currentArena->nodes.push_back(p);
+    return p;
+}
+
+void BookKeeper::beginArena() {
+    // An arena may be left open after a syntax error in a function body.
+    currentArena = new Arena;
+    arenas.push_back(currentArena);
+}
+
+void BookKeeper::endArena() { currentArena = nullptr; }
+
+void BookKeeper::pinCurrentArena() {
+    if (currentArena != nullptr) {
+        currentArena->pinned = true;
+    }
+}
+
+void BookKeeper::freeArena(Arena *arena) {
+    Assert(arena != currentArena);
+    for (auto e : arena->nodes) {
+        delete e;
+    }
+    // The Arena itself is kept until freeAll(), as functions may still
+    // refer to it.
+    arena->nodes.clear();
+    arena->nodes.shrink_to_fit();
+}
+
 // Traverse all bookkeeped objects and call delete for every one.
-void BookKeeper::freeAll() { BookKeeper::in().freeOne<Traceable>(); }
+void BookKeeper::freeAll() {
+    BookKeeper &bk = BookKeeper::in();
+    bk.currentArena = nullptr;
+    for (auto arena : bk.arenas) {
+        bk.freeArena(arena);
+        delete arena;
+    }
+    bk.arenas.clear();
+    bk.freeOne<Traceable>();
+}
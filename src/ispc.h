@@ -62,6 +62,7 @@ class Function;
 class FunctionType;
 class LLVMContext;
 class Module;
+template <typename T> class SmallVectorImpl;
 class Target;
 class TargetMachine;
 class Type;
@@ -99,7 +100,16 @@ class Type;
 struct VariableDeclaration;
 typedef std::vector<TemplateArg> TemplateArgs;
 
-enum StorageClass { SC_NONE, SC_EXTERN, SC_STATIC, SC_TYPEDEF, SC_EXTERN_C, SC_EXTERN_SYCL };
+enum StorageClass {
+    SC_NONE,
+    SC_EXTERN,
+    SC_STATIC,
+    SC_TYPEDEF,
+    SC_EXTERN_C,
+    SC_EXTERN_SYCL,
+    SC_TASK_SHARED,
+    SC_SPECCONST
+};
 
 // Enumerant for address spaces.
 enum class AddressSpace {
@@ -203,8 +213,14 @@ class Target {
         SKX_AVX512 = 7,
         ICL_AVX512 = 8,
         SPR_AVX512 = 9,
+        // AVX-512 instructions with opmasks, limited to 256-bit vectors.
+        AVX10 = 10,
 #ifdef ISPC_ARM_ENABLED
         NEON,
+        SVE,
+#endif
+#ifdef ISPC_RISCV_ENABLED
+        RVV,
 #endif
 #ifdef ISPC_WASM_ENABLED
         WASM,
@@ -253,6 +269,9 @@ class Target {
         supported CPUs. */
     static std::string SupportedCPUs();
 
+    /** Returns true if the name is one of the Xe devices. */
+    static bool IsXeDevice(const std::string &name);
+
     /** Returns a triple string specifying the target architecture, vendor,
         and environment. */
     std::string GetTripleString() const;
@@ -323,6 +342,7 @@ class Target {
     XePlatform getXePlatform() const;
     uint32_t getXeGrfSize() const;
     bool hasXePrefetch() const;
+    bool hasXeLSCBlockMemOps() const;
 #endif
 
     Arch getArch() const { return m_arch; }
@@ -331,6 +351,11 @@ class Target {
 
     std::string getCPU() const { return m_cpu; }
 
+    /** Returns the size in bytes of the level 1 or 2 data cache of a core
+        of the target CPU, as far as it is known; approximate values for
+        a generic CPU are returned otherwise. */
+    int getDataCacheSize(int level) const;
+
     int getNativeVectorWidth() const { return m_nativeVectorWidth; }
 
     int getNativeVectorAlignment() const { return m_nativeVectorAlignment; }
@@ -349,6 +374,12 @@ class Target {
 
     bool hasDotProductVNNI() const { return m_hasDotProductVNNI; }
 
+    bool hasAMX() const { return m_hasAMX; }
+
+    bool hasBF16() const { return m_hasBF16; }
+
+    bool hasCRC32() const { return m_hasCRC32; }
+
     bool hasHalfConverts() const { return m_hasHalfConverts; }
 
     bool hasHalfFullSupport() const { return m_hasHalfFullSupport; }
@@ -462,6 +493,16 @@ class Target {
     /** Indicates whether the target has native support for VNNI dot product. */
     bool m_hasDotProductVNNI;
 
+    /** Indicates whether the target has the AMX tile instructions (AMX-TILE,
+        AMX-INT8 and AMX-BF16). */
+    bool m_hasAMX;
+
+    /** Indicates whether the target has the AVX512-BF16 conversions and dot products. */
+    bool m_hasBF16;
+
+    /** Indicates whether the target has the SSE4.2 crc32 instruction. */
+    bool m_hasCRC32;
+
     /** Indicates whether the target has native support for float/half conversions. */
     bool m_hasHalfConverts;
 
@@ -518,9 +559,17 @@ class Target {
 struct Opt {
     Opt();
 
+    /** Returns the options that apply to the given function: these ones,
+        with the optimization level, fast-math, FMA and loop unrolling
+        settings overridden by the "optimize" attribute of the function,
+        which is kept in the "ispc-*" string attributes of its LLVM
+        function. */
+    Opt ForFunction(const llvm::Function *function) const;
+
     /** Optimization level.  Currently, the only valid values are 0,
-        indicating essentially no optimization, and 1, indicating as much
-        optimization as possible. */
+        indicating essentially no optimization, 1, indicating the fast
+        optimization of -O1, and 2, indicating as much optimization as
+        possible. */
     int level;
 
     /** Indicates whether "fast and loose" numerically unsafe optimizations
@@ -626,6 +675,80 @@ struct Opt {
         access from gathers into wider vector operations, when possible. */
     bool disableCoalescing;
 
+    /** Disables the lowering of varying integer divisions by loop invariant
+        uniform divisors to multiplications by the magic numbers of the
+        divisors, which are computed before the loop. */
+    bool disableInvariantDivision;
+
+    /** Disables the lowering of gathers and scatters from small local
+        arrays indexed with varying values to selects and permutes of the
+        elements of the arrays, which are then kept in registers. */
+    bool disableLocalArrayPromotion;
+
+    /** Disables hoisting the masked loads of loop invariant addresses out
+        of the loops, where the memory is known to be dereferenceable, and
+        sinking the masked stores of such addresses to the exits of the
+        loops. */
+    bool disableMaskedMemOpHoisting;
+
+    /** Disables emitting the "for" loops that launch the same task function
+        in each iteration as a single two-dimensional launch. */
+    bool disableLaunchFusion;
+
+    /** Disables fusing adjacent "foreach" loops over the same domain into
+        a single loop. */
+    bool disableForeachFusion;
+
+    /** Keeps the default calling convention for the functions that aren't
+        inlined and can only be called from the module, rather than passing
+        their vector arguments in registers with regcall on x86 targets. */
+    bool disableInternalRegCall;
+
+    /** On targets where masking is free, emit a single copy of the body of
+        foreach loops that runs with the mask of the active iterations for
+        all of them, instead of a copy for full vectors with the mask all
+        on and a masked copy for the remainder. */
+    bool foreachSingleBody;
+
+    /** Create versions of the non-inlined internal functions that run
+        with the mask all on, and call them when it is. */
+    bool maskMultiversioning;
+
+    /** Check at run time whether the addresses of every gather are the
+        same or consecutive, and do a broadcast or a vector load if they
+        are, as '#pragma ispc coherent_gathers' does for a loop or a
+        function. */
+    bool coherentGathers;
+
+    /** In multi-target compilation, drop the exported functions whose
+        optimized IR is the same as for a lower target compiled before, so
+        that the dispatch functions call the variant of the lower target. */
+    bool mergeTargetVariants;
+
+    /** If positive, the number of loop iterations ahead that software
+        prefetches are inserted for gathers with indices that are loaded
+        from a contiguous stream, like data[idx[i]], and on Xe targets
+        with prefetch messages also for the loads with a constant stride.
+        Zero disables the insertion. */
+    int prefetchDistance;
+
+    /** The minimal number of "case" labels of a "switch" statement with a
+        varying condition for it to be lowered to a loop over the unique
+        values of the condition in the active program instances, which
+        runs the matching case once for each of them, instead of running
+        all of the cases with the lanes that match them.  Zero disables
+        the unique-value dispatch. */
+    int switchDispatchThreshold;
+
+    /** On x86 targets, mark vector stores in loops that write a large
+        contiguous range of memory that the function doesn't read as
+        non-temporal. */
+    bool streamingStores;
+
+    /** Do the computation of the varying values that are proven to have
+        the same value in all program instances with scalars. */
+    bool uniformityInference;
+
     /** Disable using zmm registers for avx512 target in favour of ymm.
         Affects only >= 512 bit wide targets and only if avx512vl is available */
     bool disableZMM;
@@ -645,6 +768,10 @@ struct Opt {
         the default value should be adjusted with some experiments. */
     int thresholdForXeGatherCoalescing;
 
+    /** Disables lowering of aligned unit-stride masked loads and stores
+        to LSC block messages on Xe2. */
+    bool disableXeBlockMemOps;
+
     /** Enables experimental support of foreach statement inside varying CF.
         Current implementation brings performance degradation due to ineffective
         implementation of unmasked.*/
@@ -802,6 +929,11 @@ struct Globals {
         manual.) */
     bool emitInstrumentation;
 
+    /** Indicates whether the instrumentation points should record the
+        site and the mask in the thread-local state of the sampling lane
+        profiler of ispcrt_instrument instead of calling ISPCInstrument(). */
+    bool emitLaneProfile;
+
 #ifdef ISPC_XE_ENABLED
     /** Arguments to pass to Vector Compiler backend for offline
     compilation to L0 binary */
@@ -809,6 +941,18 @@ struct Globals {
 
     /* Stateless stack memory size in VC backend */
     unsigned int stackMemSize;
+
+    /* Vector widths, in addition to the one of the target, to compile the
+       kernels for (--xe-kernel-widths). */
+    std::vector<int> xeKernelWidths;
+
+    /* Devices to put the L0 binaries for in the fat binary with the SPIR-V
+       code (--xe-devices). */
+    std::vector<std::string> xeDevices;
+
+    /* Print the registers, spills, private memory and SLM used by each
+       kernel of the L0 binary (--resource-report). */
+    bool resourceReport;
 #endif
 
     bool noPragmaOnce;
@@ -855,17 +999,58 @@ struct Globals {
         forced to have given value. -1 value means natural alignment for the platforms. */
     int forceAlignment;
 
+    /** When true, the generated code is instrumented to collect an
+        execution profile for --profile-use. */
+    bool profileGenerate;
+
+    /** Name of the raw profile file that the instrumented code writes.
+        Empty for the default of the profile runtime. */
+    std::string profileGenerateFile;
+
+    /** Name of the indexed profile that is used to annotate the code with
+        branch weights and function entry counts, or empty if there is
+        none. */
+    std::string profileUseFile;
+
+    /** When true, the gathers, scatters, masked memory operations and
+        expensive operations that remain after optimization are reported
+        on stderr. */
+    bool optReport;
+
+    /** Name of the file that the optimization report is written to as
+        YAML, or empty if there is none. */
+    std::string optReportFile;
+
     /** When true, flag non-static functions with dllexport attribute on Windows. */
     bool dllExport;
 
     /** Lines for which warnings are turned off. */
     std::map<std::pair<int, std::string>, bool> turnOffWarnings;
 
-    enum pragmaUnrollType { none, nounroll, unroll, count };
+    /* The 'countReductions' type is '#pragma unroll_reductions COUNT', which
+       also splits the reductions in the loop into COUNT accumulators. */
+    enum pragmaUnrollType { none, nounroll, unroll, count, countReductions };
+
+    /* Operations that '#pragma ispc expect_no_*' asserts don't remain in a
+       loop or a function after optimization, and 'coherentGathers', which
+       '#pragma ispc coherent_gathers' sets to add a run-time coherence check
+       to the gathers of a loop or a function. */
+    enum pragmaExpectType : unsigned int {
+        expectNoGather = 0x1,
+        expectNoScatter = 0x2,
+        expectNoMaskedStore = 0x4,
+        expectNoCall = 0x8,
+        coherentGathers = 0x10,
+    };
 
     /* If true, we are compiling for more than one target. */
     bool isMultiTargetCompilation;
 
+    /* If true, we are compiling the exported functions with the "width"
+       attribute, which differs from the width of the target, for a target
+       of the same family with that width. */
+    bool isWidthVariantCompilation;
+
     /* Number of errors to show in ISPC. */
     int errorLimit;
 
@@ -874,6 +1059,56 @@ struct Globals {
 
     /* When compile time tracing is enabled, set time granularity. */
     int timeTraceGranularity;
+
+    /* Maximum number of targets that are optimized and code generated
+       concurrently in multi-target compilation. */
+    int numJobs;
+
+    /* Number of threads that generate the machine code of the module of a
+       target in parallel, each for a part of its functions. */
+    int codegenThreads;
+
+    /* File name of the per phase compile time report in JSON format.
+       Empty string means that the report is disabled. */
+    std::string timeReportFile;
+
+    /* File name of the bitcode of the module going into the optimization,
+       which is replayed by "ispc-opt --replay". Empty string means that the
+       module is not captured. */
+    std::string captureFile;
+
+    /* Directory of the persistent compilation cache. Empty string means
+       that the cache is disabled. */
+    std::string cacheDir;
+
+    /* Command line arguments, which may affect the result of compilation.
+       They are a part of the compilation cache key. */
+    std::vector<std::string> cacheKeyArgs;
+
+    /* When true, the bitcode output carries the ThinLTO module summary, so
+       that it can take part in ThinLTO of the application. */
+    bool emitThinLTO;
+
+    /* When true, the bitcode output is the module going into the
+       optimization, which "ispc link --lto" optimizes together with the
+       other modules of the program. */
+    bool emitLTO;
+
+    /* When true, the dispatch functions of multi-target compilations are
+       replaced with GNU IFUNC symbols, whose resolvers select the target
+       variants once, when the symbols are bound. */
+    bool ifuncDispatch;
+
+    /* When true, the variants of all of the targets of a multi-target
+       compilation and the dispatch functions are written to the single
+       output file instead of one file per target. */
+    bool singleObject;
+
+    /* With the JIT compilation of libispc, the source code, which is
+       compiled instead of the input file, and the buffer, which the object
+       file is emitted to instead of the output file. */
+    const char *jitSource;
+    llvm::SmallVectorImpl<char> *jitObject;
 };
 
 enum {
@@ -915,12 +1150,38 @@ enum {
 extern Globals *g;
 extern Module *m;
 
+class Traceable;
+
 // Singleton object for bookkeeping heap objects to destroy them later to
 // avoid memory leak.
 class BookKeeper {
+  public:
+    // The AST nodes of the body of a function definition, which can be freed
+    // once the function has been emitted to LLVM IR.  An arena is pinned when
+    // other functions may refer to its nodes (e.g. template instantiations
+    // with arguments of the function); it's freed after all of them then.
+    struct Arena {
+        std::vector<Traceable *> nodes;
+        bool pinned = false;
+    };
+
+    // Allocates the AST nodes in the global storage while it exists, e.g.
+    // for the template instantiations made while a function is parsed.
+    class SuspendArena {
+      public:
+        SuspendArena() : arena(BookKeeper::in().currentArena) { BookKeeper::in().currentArena = nullptr; }
+        ~SuspendArena() { BookKeeper::in().currentArena = arena; }
+
+      private:
+        Arena *arena;
+    };
+
   private:
     BookKeeper() {}
 
+    std::vector<Arena *> arenas;
+    Arena *currentArena = nullptr;
+
     template <typename T> std::vector<T *> &getStorage() {
         // Vector to store bookkeeped objects.
         static std::vector<T *> v;
@@ -945,6 +1206,20 @@ class BookKeeper {
         return p;
     }
 
+    // Add an AST node to the current arena, or to the global storage if
+    // there is none.
+    void *addNode(Traceable *p);
+
+    // Start a new arena for the AST nodes that are created from now on.
+    void beginArena();
+    // Stop allocating the AST nodes in the current arena.
+    void endArena();
+    Arena *getCurrentArena() const { return currentArena; }
+    // Mark the current arena (if any) as referred to by other functions.
+    void pinCurrentArena();
+    // Free the AST nodes of the arena.
+    void freeArena(Arena *arena);
+
     // Free all bookkeeped objects.
     void freeAll();
 };
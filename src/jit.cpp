@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file jit.cpp
+    @brief Implementation of the C interface of libispc: the object file
+           produced by the compiler is loaded with the ORC JIT of LLVM.
+*/
+
+#include "jit.h"
+#include "ispc.h"
+#include "libispc.h"
+#include "util.h"
+
+#include <memory>
+#include <mutex>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+using namespace ispc;
+
+struct _ISPCJITModule {
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+};
+
+// The compiler keeps its state in globals, so only one compilation may run
+// at a time.
+static std::mutex lCompileMutex;
+
+ISPCJITModule ispcJITCompile(const char *source, const char *const *options, uint32_t numOptions) {
+    if (source == nullptr) {
+        return nullptr;
+    }
+    std::vector<std::string> opts;
+    for (uint32_t i = 0; i < numOptions; ++i) {
+        opts.push_back(options[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(lCompileMutex);
+    llvm::SmallVector<char, 0> object;
+    if (CompileForJIT(source, opts, object) != 0 || object.empty()) {
+        return nullptr;
+    }
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit) {
+        Error(SourcePos(), "Cannot create the JIT: %s.", llvm::toString(jit.takeError()).c_str());
+        return nullptr;
+    }
+
+    // The task system and the math library functions are resolved from the
+    // symbols of the process.
+    auto generator =
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) {
+        Error(SourcePos(), "Cannot resolve the symbols of the process: %s.",
+              llvm::toString(generator.takeError()).c_str());
+        return nullptr;
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+    auto buffer = llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(object.data(), object.size()), JIT_SOURCE_NAME);
+    if (llvm::Error err = (*jit)->addObjectFile(std::move(buffer))) {
+        Error(SourcePos(), "Cannot load the compiled code: %s.", llvm::toString(std::move(err)).c_str());
+        return nullptr;
+    }
+
+    return new _ISPCJITModule{std::move(*jit)};
+}
+
+void *ispcJITGetSymbol(ISPCJITModule module, const char *name) {
+    if (module == nullptr || name == nullptr) {
+        return nullptr;
+    }
+    auto address = module->jit->lookup(name);
+    if (!address) {
+        llvm::consumeError(address.takeError());
+        return nullptr;
+    }
+    return address->toPtr<void *>();
+}
+
+void ispcJITRelease(ISPCJITModule module) { delete module; }
@@ -0,0 +1,31 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file jit.h
+    @brief Internal interface between the compiler and the JIT of libispc.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+template <typename T> class SmallVectorImpl;
+} // namespace llvm
+
+namespace ispc {
+
+/** The name of the source code in the diagnostics and the debug
+    information of the JIT compilation. */
+#define JIT_SOURCE_NAME "<jit>"
+
+/** Compile the source code \p source with the command line options
+    \p options and emit the object file to \p object.  Returns the exit
+    code of ispc.  This is defined in main.cpp. */
+int CompileForJIT(const char *source, const std::vector<std::string> &options, llvm::SmallVectorImpl<char> &object);
+
+} // namespace ispc
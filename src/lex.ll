@@ -11,22 +11,42 @@
 #include "util.h"
 #include "module.h"
 #include "type.h"
+#include <ctype.h>
+#include <functional>
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <llvm/ADT/StringMap.h>
+
 using namespace ispc;
 #include "parse.hh"
 
+// The flex scanner is called by yylex() defined below, which reads the
+// tokens passed by the preprocessor instead, when they are available.
+#define YY_DECL static int lFlexLex()
+
 static uint64_t lParseBinary(const char *ptr, SourcePos pos, char **endPtr);
-static int lParseInteger(bool dotdotdot);
-static int lParseFP();
+static int lParseIdentifier(const char *text);
+static int lParseInteger(const char *text, bool dotdotdot);
+static int lParseFP(const char *text);
+static int lParseFortranDouble(const char *text);
+static int lParseHexFP(const char *text);
 static int lParseOperator(const char *ptr);
 static void lCComment(SourcePos *);
 static void lCppComment(SourcePos *);
 static void lNextValidChar(SourcePos *, char const*&);
 static void lPragmaIgnoreWarning(SourcePos *, std::string);
 static void lPragmaUnroll(YYSTYPE *, SourcePos *, std::string, bool);
+static void lPragmaCacheBlock(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaVectorizeDim(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaFuse(YYSTYPE *, SourcePos *, std::string, bool);
+static void lPragmaExpect(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaCoherentGathers(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaSpecialize(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaNarrow(YYSTYPE *, SourcePos *, std::string);
+static void lPragmaTargets(YYSTYPE *, SourcePos *, std::string);
 static bool lConsumePragma(YYSTYPE *, SourcePos *);
+static bool lHandlePragma(YYSTYPE *, SourcePos *, std::string);
 static void lHandleCppHash(SourcePos *);
 static void lStringConst(YYSTYPE *, SourcePos *);
 static double lParseHexFloat(const char *ptr);
@@ -56,6 +76,7 @@ void ParserInit() {
     tokenToName[TOKEN_CIF] = "cif";
     tokenToName[TOKEN_CWHILE] = "cwhile";
     tokenToName[TOKEN_CONST] = "const";
+    tokenToName[TOKEN_CONSTEXPR] = "constexpr";
     tokenToName[TOKEN_CONTINUE] = "continue";
     tokenToName[TOKEN_DEFAULT] = "default";
     tokenToName[TOKEN_DO] = "do";
@@ -71,6 +92,7 @@ void ParserInit() {
     tokenToName[TOKEN_FOR] = "for";
     tokenToName[TOKEN_FOREACH] = "foreach";
     tokenToName[TOKEN_FOREACH_ACTIVE] = "foreach_active";
+    tokenToName[TOKEN_FOREACH_DYNAMIC] = "foreach_dynamic";
     tokenToName[TOKEN_FOREACH_TILED] = "foreach_tiled";
     tokenToName[TOKEN_FOREACH_UNIQUE] = "foreach_unique";
     tokenToName[TOKEN_GOTO] = "goto";
@@ -80,6 +102,7 @@ void ParserInit() {
     tokenToName[TOKEN_NOINLINE] = "noinline";
     tokenToName[TOKEN_VECTORCALL] = "__vectorcall";
     tokenToName[TOKEN_REGCALL] = "__regcall";
+    tokenToName[TOKEN_RESTRICT] = "restrict";
     tokenToName[TOKEN_INT] = "int";
     tokenToName[TOKEN_UINT] = "uint";
     tokenToName[TOKEN_INT8] = "int8";
@@ -94,17 +117,21 @@ void ParserInit() {
     tokenToName[TOKEN_ATTRIBUTE] = "__attribute__";
     tokenToName[TOKEN_NEW] = "new";
     tokenToName[TOKEN_NULL] = "NULL";
+    tokenToName[TOKEN_PARALLEL_FOREACH] = "parallel_foreach";
     tokenToName[TOKEN_PRINT] = "print";
     tokenToName[TOKEN_RETURN] = "return";
     tokenToName[TOKEN_SOA] = "soa";
     tokenToName[TOKEN_SIGNED] = "signed";
     tokenToName[TOKEN_SIZEOF] = "sizeof";
+    tokenToName[TOKEN_SPECCONST] = "specconst";
     tokenToName[TOKEN_ALLOCA] = "alloca";
     tokenToName[TOKEN_STATIC] = "static";
     tokenToName[TOKEN_STRUCT] = "struct";
     tokenToName[TOKEN_SWITCH] = "switch";
     tokenToName[TOKEN_SYNC] = "sync";
     tokenToName[TOKEN_TASK] = "task";
+    tokenToName[TOKEN_TASK_GROUP] = "task_group";
+    tokenToName[TOKEN_TASK_SHARED] = "task_shared";
     tokenToName[TOKEN_TEMPLATE] = "template";
     tokenToName[TOKEN_TRUE] = "true";
     tokenToName[TOKEN_TYPEDEF] = "typedef";
@@ -185,6 +212,7 @@ void ParserInit() {
     tokenNameRemap["TOKEN_CIF"] = "\'cif\'";
     tokenNameRemap["TOKEN_CWHILE"] = "\'cwhile\'";
     tokenNameRemap["TOKEN_CONST"] = "\'const\'";
+    tokenNameRemap["TOKEN_CONSTEXPR"] = "\'constexpr\'";
     tokenNameRemap["TOKEN_CONTINUE"] = "\'continue\'";
     tokenNameRemap["TOKEN_DEFAULT"] = "\'default\'";
     tokenNameRemap["TOKEN_DO"] = "\'do\'";
@@ -200,6 +228,7 @@ void ParserInit() {
     tokenNameRemap["TOKEN_FOR"] = "\'for\'";
     tokenNameRemap["TOKEN_FOREACH"] = "\'foreach\'";
     tokenNameRemap["TOKEN_FOREACH_ACTIVE"] = "\'foreach_active\'";
+    tokenNameRemap["TOKEN_FOREACH_DYNAMIC"] = "\'foreach_dynamic\'";
     tokenNameRemap["TOKEN_FOREACH_TILED"] = "\'foreach_tiled\'";
     tokenNameRemap["TOKEN_FOREACH_UNIQUE"] = "\'foreach_unique\'";
     tokenNameRemap["TOKEN_GOTO"] = "\'goto\'";
@@ -210,6 +239,7 @@ void ParserInit() {
     tokenNameRemap["TOKEN_NOINLINE"] = "\'noinline\'";
     tokenNameRemap["TOKEN_VECTORCALL"] = "\'__vectorcall\'";
     tokenNameRemap["TOKEN_REGCALL"] = "\'__regcall\'";
+    tokenNameRemap["TOKEN_RESTRICT"] = "\'restrict\'";
     tokenNameRemap["TOKEN_INT"] = "\'int\'";
     tokenNameRemap["TOKEN_UINT"] = "\'uint\'";
     tokenNameRemap["TOKEN_INT8"] = "\'int8\'";
@@ -224,17 +254,21 @@ void ParserInit() {
     tokenNameRemap["TOKEN_ATTRIBUTE"] = "\'__attribute__\'";
     tokenNameRemap["TOKEN_NEW"] = "\'new\'";
     tokenNameRemap["TOKEN_NULL"] = "\'NULL\'";
+    tokenNameRemap["TOKEN_PARALLEL_FOREACH"] = "\'parallel_foreach\'";
     tokenNameRemap["TOKEN_PRINT"] = "\'print\'";
     tokenNameRemap["TOKEN_RETURN"] = "\'return\'";
     tokenNameRemap["TOKEN_SOA"] = "\'soa\'";
     tokenNameRemap["TOKEN_SIGNED"] = "\'signed\'";
     tokenNameRemap["TOKEN_SIZEOF"] = "\'sizeof\'";
     tokenNameRemap["TOKEN_ALLOCA"] = "\'TOKEN_ALLOCA\'";
+    tokenNameRemap["TOKEN_SPECCONST"] = "\'specconst\'";
     tokenNameRemap["TOKEN_STATIC"] = "\'static\'";
     tokenNameRemap["TOKEN_STRUCT"] = "\'struct\'";
     tokenNameRemap["TOKEN_SWITCH"] = "\'switch\'";
     tokenNameRemap["TOKEN_SYNC"] = "\'sync\'";
     tokenNameRemap["TOKEN_TASK"] = "\'task\'";
+    tokenNameRemap["TOKEN_TASK_GROUP"] = "\'task_group\'";
+    tokenNameRemap["TOKEN_TASK_SHARED"] = "\'task_shared\'";
     tokenNameRemap["TOKEN_TEMPLATE"] = "\'template\'";
     tokenNameRemap["TOKEN_TRUE"] = "\'true\'";
     tokenNameRemap["TOKEN_TYPEDEF"] = "\'typedef\'";
@@ -315,80 +349,7 @@ ZO_SWIZZLE ([01]+[w-z]+)+|([01]+[rgba]+)+|([01]+[uv]+)+
 }
 
 
-__assert { return TOKEN_ASSERT; }
-bool { return TOKEN_BOOL; }
-break { return TOKEN_BREAK; }
-case { return TOKEN_CASE; }
-cbreak { Warning(yylloc, "\"cbreak\" is deprecated. Use \"break\"."); return TOKEN_BREAK; }
-ccontinue { Warning(yylloc, "\"ccontinue\" is deprecated. Use \"continue\"."); return TOKEN_CONTINUE; }
-cdo { return TOKEN_CDO; }
-cfor { return TOKEN_CFOR; }
-cif { return TOKEN_CIF; }
-cwhile { return TOKEN_CWHILE; }
-const { return TOKEN_CONST; }
-continue { return TOKEN_CONTINUE; }
-creturn { Warning(yylloc, "\"creturn\" is deprecated. Use \"return\"."); return TOKEN_RETURN; }
-__declspec { return TOKEN_DECLSPEC; }
-default { return TOKEN_DEFAULT; }
-do { return TOKEN_DO; }
-delete { return TOKEN_DELETE; }
 delete\[\] { return TOKEN_DELETE; }
-double { return TOKEN_DOUBLE; }
-else { return TOKEN_ELSE; }
-enum { return TOKEN_ENUM; }
-export { return TOKEN_EXPORT; }
-extern { return TOKEN_EXTERN; }
-false { return TOKEN_FALSE; }
-float { return TOKEN_FLOAT; }
-for { return TOKEN_FOR; }
-foreach { return TOKEN_FOREACH; }
-foreach_active { return TOKEN_FOREACH_ACTIVE; }
-foreach_tiled { return TOKEN_FOREACH_TILED; }
-foreach_unique { return TOKEN_FOREACH_UNIQUE; }
-float16 { return TOKEN_FLOAT16; }
-goto { return TOKEN_GOTO; }
-if { return TOKEN_IF; }
-in { return TOKEN_IN; }
-inline { return TOKEN_INLINE; }
-noinline { return TOKEN_NOINLINE; }
-__vectorcall { return TOKEN_VECTORCALL; }
-__regcall { return TOKEN_REGCALL; }
-int { return TOKEN_INT; }
-uint { return TOKEN_UINT; }
-int8 { return TOKEN_INT8; }
-uint8 { return TOKEN_UINT8; }
-int16 { return TOKEN_INT16; }
-uint16 { return TOKEN_UINT16; }
-int32 { return TOKEN_INT; }
-uint32 { return TOKEN_UINT; }
-int64 { return TOKEN_INT64; }
-uint64 { return TOKEN_UINT64; }
-launch { return TOKEN_LAUNCH; }
-invoke_sycl { return TOKEN_INVOKE_SYCL; }
-__attribute__ { return TOKEN_ATTRIBUTE; }
-new { return TOKEN_NEW; }
-NULL { return TOKEN_NULL; }
-print { return TOKEN_PRINT; }
-return { return TOKEN_RETURN; }
-soa { return TOKEN_SOA; }
-signed { return TOKEN_SIGNED; }
-sizeof { return TOKEN_SIZEOF; }
-alloca { return TOKEN_ALLOCA; }
-static { return TOKEN_STATIC; }
-struct { return TOKEN_STRUCT; }
-switch { return TOKEN_SWITCH; }
-sync { return TOKEN_SYNC; }
-task { return TOKEN_TASK; }
-template { return TOKEN_TEMPLATE; }
-true { return TOKEN_TRUE; }
-typedef { return TOKEN_TYPEDEF; }
-typename { return TOKEN_TYPENAME; }
-uniform { return TOKEN_UNIFORM; }
-unmasked { return TOKEN_UNMASKED; }
-unsigned { return TOKEN_UNSIGNED; }
-varying { return TOKEN_VARYING; }
-void { return TOKEN_VOID; }
-while { return TOKEN_WHILE; }
 \"C\" { return TOKEN_STRING_C_LITERAL; }
 \"SYCL\" { return TOKEN_STRING_SYCL_LITERAL; }
 \.\.\. { return TOKEN_DOTDOTDOT; }
@@ -404,15 +365,7 @@ while { return TOKEN_WHILE; }
 L?\"(\\.|[^\\"])*\" { lStringConst(&yylval, &yylloc); return TOKEN_STRING_LITERAL; }
 
 {IDENT} {
-    /* We have an identifier--is it a type name or an identifier?
-       The symbol table will straighten us out... */
-    yylval.stringVal = new std::string(yytext);
-    if (m->symbolTable->LookupType(yytext) != nullptr)
-        return TOKEN_TYPE_NAME;
-    else if (m->symbolTable->LookupFunctionTemplate(yytext))
-        return TOKEN_TEMPLATE_NAME;
-    else
-        return TOKEN_IDENTIFIER;
+    return lParseIdentifier(yytext);
 }
 
 {INTRINSIC_CALL} {
@@ -422,56 +375,33 @@ L?\"(\\.|[^\\"])*\" { lStringConst(&yylval, &yylloc); return TOKEN_STRING_LITERA
 }
 
 {INT_NUMBER} {
-    return lParseInteger(false);
+    return lParseInteger(yytext, false);
 }
 
 {INT_NUMBER_DOTDOTDOT} {
-    return lParseInteger(true);
+    return lParseInteger(yytext, true);
 }
 
 {FORTRAN_DOUBLE_NUMBER} {
-    {
-      int i = 0;
-      while (yytext[i] != 'd' && yytext[i] != 'D') i++;
-      yytext[i] = 'E';
-    }
-    yylval.doubleVal = atof(yytext);
-    return TOKEN_DOUBLE_CONSTANT;
+    return lParseFortranDouble(yytext);
 }
 
 {FLOAT_NUMBER_DECIMAL}|{FLOAT_NUMBER_SCIENTIFIC} {
-    return lParseFP();
+    return lParseFP(yytext);
 }
 
 {FLOAT_NUMBER_DECIMAL_DEPRECATED} {
     Warning(yylloc, "single precision floating point literal should have a radix separator (dot)");
-    return lParseFP();
+    return lParseFP(yytext);
 }
 
 {FLOAT_NUMBER_DECIMAL_ILLEGAL} {
     Error(yylloc, "floating point literal should have a radix separator (dot)");
-    return lParseFP();
+    return lParseFP(yytext);
 }
 
 {FLOAT_NUMBER_HEXADECIMAL} {
-    std::string val(yytext);
-    std::string fp16S("f16");
-    std::string fp16C("F16");
-    if (val.size() >= fp16S.size() && ((val.compare(val.size() - fp16S.size(), fp16S.size(), fp16S) == 0)
-           || (val.compare(val.size() - fp16C.size(), fp16C.size(), fp16C) == 0))) {
-        yylval.stringVal = new std::string(val.substr(0, val.length() - 3));
-        return TOKEN_FLOAT16_CONSTANT;
-    }
-    double dval = lParseHexFloat(yytext);
-    std::string fp64S("d");
-    std::string fp64C("D");
-    if (val.size() >= fp64S.size() && ((val.compare(val.size() - fp64S.size(), fp64S.size(), fp64S) == 0)
-           || (val.compare(val.size() - fp64C.size(), fp64C.size(), fp64C) == 0))) {
-        yylval.doubleVal = dval;
-        return TOKEN_DOUBLE_CONSTANT;
-    }
-    yylval.floatVal = (float)dval;
-    return TOKEN_FLOAT_CONSTANT;
+    return lParseHexFP(yytext);
 }
 
 
@@ -548,6 +478,126 @@ L?\"(\\.|[^\\"])*\" { lStringConst(&yylval, &yylloc); return TOKEN_STRING_LITERA
 /*union { return TOKEN_UNION; }*/
 /*"..." { return TOKEN_ELLIPSIS; }*/
 
+/** Keywords of the language.  The replacement is set for the deprecated
+    ones.
+ */
+struct Keyword {
+    int token;
+    const char *replacement;
+};
+
+static const llvm::StringMap<Keyword> &
+lKeywords() {
+    static const llvm::StringMap<Keyword> keywords = {
+        {"__assert", {TOKEN_ASSERT, nullptr}},
+        {"bool", {TOKEN_BOOL, nullptr}},
+        {"break", {TOKEN_BREAK, nullptr}},
+        {"case", {TOKEN_CASE, nullptr}},
+        {"cbreak", {TOKEN_BREAK, "break"}},
+        {"ccontinue", {TOKEN_CONTINUE, "continue"}},
+        {"cdo", {TOKEN_CDO, nullptr}},
+        {"cfor", {TOKEN_CFOR, nullptr}},
+        {"cif", {TOKEN_CIF, nullptr}},
+        {"cwhile", {TOKEN_CWHILE, nullptr}},
+        {"const", {TOKEN_CONST, nullptr}},
+        {"constexpr", {TOKEN_CONSTEXPR, nullptr}},
+        {"continue", {TOKEN_CONTINUE, nullptr}},
+        {"creturn", {TOKEN_RETURN, "return"}},
+        {"__declspec", {TOKEN_DECLSPEC, nullptr}},
+        {"default", {TOKEN_DEFAULT, nullptr}},
+        {"do", {TOKEN_DO, nullptr}},
+        {"delete", {TOKEN_DELETE, nullptr}},
+        {"double", {TOKEN_DOUBLE, nullptr}},
+        {"else", {TOKEN_ELSE, nullptr}},
+        {"enum", {TOKEN_ENUM, nullptr}},
+        {"export", {TOKEN_EXPORT, nullptr}},
+        {"extern", {TOKEN_EXTERN, nullptr}},
+        {"false", {TOKEN_FALSE, nullptr}},
+        {"float", {TOKEN_FLOAT, nullptr}},
+        {"for", {TOKEN_FOR, nullptr}},
+        {"foreach", {TOKEN_FOREACH, nullptr}},
+        {"foreach_active", {TOKEN_FOREACH_ACTIVE, nullptr}},
+        {"foreach_dynamic", {TOKEN_FOREACH_DYNAMIC, nullptr}},
+        {"foreach_tiled", {TOKEN_FOREACH_TILED, nullptr}},
+        {"foreach_unique", {TOKEN_FOREACH_UNIQUE, nullptr}},
+        {"float16", {TOKEN_FLOAT16, nullptr}},
+        {"goto", {TOKEN_GOTO, nullptr}},
+        {"if", {TOKEN_IF, nullptr}},
+        {"in", {TOKEN_IN, nullptr}},
+        {"inline", {TOKEN_INLINE, nullptr}},
+        {"noinline", {TOKEN_NOINLINE, nullptr}},
+        {"__vectorcall", {TOKEN_VECTORCALL, nullptr}},
+        {"__regcall", {TOKEN_REGCALL, nullptr}},
+        {"restrict", {TOKEN_RESTRICT, nullptr}},
+        {"__restrict", {TOKEN_RESTRICT, nullptr}},
+        {"__restrict__", {TOKEN_RESTRICT, nullptr}},
+        {"int", {TOKEN_INT, nullptr}},
+        {"uint", {TOKEN_UINT, nullptr}},
+        {"int8", {TOKEN_INT8, nullptr}},
+        {"uint8", {TOKEN_UINT8, nullptr}},
+        {"int16", {TOKEN_INT16, nullptr}},
+        {"uint16", {TOKEN_UINT16, nullptr}},
+        {"int32", {TOKEN_INT, nullptr}},
+        {"uint32", {TOKEN_UINT, nullptr}},
+        {"int64", {TOKEN_INT64, nullptr}},
+        {"uint64", {TOKEN_UINT64, nullptr}},
+        {"launch", {TOKEN_LAUNCH, nullptr}},
+        {"invoke_sycl", {TOKEN_INVOKE_SYCL, nullptr}},
+        {"__attribute__", {TOKEN_ATTRIBUTE, nullptr}},
+        {"new", {TOKEN_NEW, nullptr}},
+        {"NULL", {TOKEN_NULL, nullptr}},
+        {"parallel_foreach", {TOKEN_PARALLEL_FOREACH, nullptr}},
+        {"print", {TOKEN_PRINT, nullptr}},
+        {"return", {TOKEN_RETURN, nullptr}},
+        {"soa", {TOKEN_SOA, nullptr}},
+        {"signed", {TOKEN_SIGNED, nullptr}},
+        {"sizeof", {TOKEN_SIZEOF, nullptr}},
+        {"specconst", {TOKEN_SPECCONST, nullptr}},
+        {"alloca", {TOKEN_ALLOCA, nullptr}},
+        {"static", {TOKEN_STATIC, nullptr}},
+        {"struct", {TOKEN_STRUCT, nullptr}},
+        {"switch", {TOKEN_SWITCH, nullptr}},
+        {"sync", {TOKEN_SYNC, nullptr}},
+        {"task", {TOKEN_TASK, nullptr}},
+        {"task_group", {TOKEN_TASK_GROUP, nullptr}},
+        {"task_shared", {TOKEN_TASK_SHARED, nullptr}},
+        {"template", {TOKEN_TEMPLATE, nullptr}},
+        {"true", {TOKEN_TRUE, nullptr}},
+        {"typedef", {TOKEN_TYPEDEF, nullptr}},
+        {"typename", {TOKEN_TYPENAME, nullptr}},
+        {"uniform", {TOKEN_UNIFORM, nullptr}},
+        {"unmasked", {TOKEN_UNMASKED, nullptr}},
+        {"unsigned", {TOKEN_UNSIGNED, nullptr}},
+        {"varying", {TOKEN_VARYING, nullptr}},
+        {"void", {TOKEN_VOID, nullptr}},
+        {"while", {TOKEN_WHILE, nullptr}},
+    };
+    return keywords;
+}
+
+/** Return the token for a keyword or an identifier.
+ */
+static int
+lParseIdentifier(const char *text) {
+    const llvm::StringMap<Keyword> &keywords = lKeywords();
+    auto keyword = keywords.find(text);
+    if (keyword != keywords.end()) {
+        if (keyword->second.replacement != nullptr)
+            Warning(yylloc, "\"%s\" is deprecated. Use \"%s\".", text, keyword->second.replacement);
+        return keyword->second.token;
+    }
+
+    /* We have an identifier--is it a type name or an identifier?
+       The symbol table will straighten us out... */
+    yylval.stringVal = new std::string(text);
+    if (m->symbolTable->LookupType(text) != nullptr)
+        return TOKEN_TYPE_NAME;
+    else if (m->symbolTable->LookupFunctionTemplate(text))
+        return TOKEN_TEMPLATE_NAME;
+    else
+        return TOKEN_IDENTIFIER;
+}
+
 /** Return the integer version of a binary constant from a string.
  */
 static uint64_t
@@ -571,19 +621,19 @@ lParseBinary(const char *ptr, SourcePos pos, char **endPtr) {
 
 
 static int
-lParseInteger(bool dotdotdot) {
+lParseInteger(const char *text, bool dotdotdot) {
     int ls = 0, us = 0;
 
     char *endPtr = nullptr;
-    if (yytext[0] == '0' && yytext[1] == 'b')
-        yylval.intVal = lParseBinary(yytext+2, yylloc, &endPtr);
+    if (text[0] == '0' && text[1] == 'b')
+        yylval.intVal = lParseBinary(text+2, yylloc, &endPtr);
     else {
 #if defined(ISPC_HOST_IS_WINDOWS) && !defined(__MINGW32__)
-        yylval.intVal = _strtoui64(yytext, &endPtr, 0);
+        yylval.intVal = _strtoui64(text, &endPtr, 0);
 #else
         // FIXME: should use strtouq and then issue an error if we can't
         // fit into 64 bits...
-        yylval.intVal = strtoull(yytext, &endPtr, 0);
+        yylval.intVal = strtoull(text, &endPtr, 0);
 #endif
     }
 
@@ -664,8 +714,8 @@ lParseInteger(bool dotdotdot) {
 }
 
 static int
-lParseFP() {
-    std::string val(yytext);
+lParseFP(const char *text) {
+    std::string val(text);
     std::string fp64S("d");
     std::string fp64C("D");
     std::string fp16S("f16");
@@ -676,10 +726,46 @@ lParseFP() {
         return TOKEN_FLOAT16_CONSTANT;
     } else if (val.size() >= fp64S.size() && ((val.compare(val.size() - fp64S.size(), fp64S.size(), fp64S) == 0)
            || (val.compare(val.size() - fp64C.size(), fp64C.size(), fp64C) == 0))) {
-        yylval.doubleVal = atof(yytext);
+        yylval.doubleVal = atof(text);
         return TOKEN_DOUBLE_CONSTANT;
     }
-    yylval.floatVal = (float)atof(yytext);
+    yylval.floatVal = (float)atof(text);
+    return TOKEN_FLOAT_CONSTANT;
+}
+
+/** Parse a double precision constant with the exponent after 'd', like
+    "1d-3".
+*/
+static int
+lParseFortranDouble(const char *text) {
+    std::string val(text);
+    val[val.find_first_of("dD")] = 'E';
+    yylval.doubleVal = atof(val.c_str());
+    return TOKEN_DOUBLE_CONSTANT;
+}
+
+/** Parse a hexadecimal floating point constant with the optional precision
+    suffix.
+*/
+static int
+lParseHexFP(const char *text) {
+    std::string val(text);
+    std::string fp16S("f16");
+    std::string fp16C("F16");
+    if (val.size() >= fp16S.size() && ((val.compare(val.size() - fp16S.size(), fp16S.size(), fp16S) == 0)
+           || (val.compare(val.size() - fp16C.size(), fp16C.size(), fp16C) == 0))) {
+        yylval.stringVal = new std::string(val.substr(0, val.length() - 3));
+        return TOKEN_FLOAT16_CONSTANT;
+    }
+    double dval = lParseHexFloat(text);
+    std::string fp64S("d");
+    std::string fp64C("D");
+    if (val.size() >= fp64S.size() && ((val.compare(val.size() - fp64S.size(), fp64S.size(), fp64S) == 0)
+           || (val.compare(val.size() - fp64C.size(), fp64C.size(), fp64C) == 0))) {
+        yylval.doubleVal = dval;
+        return TOKEN_DOUBLE_CONSTANT;
+    }
+    yylval.floatVal = (float)dval;
     return TOKEN_FLOAT_CONSTANT;
 }
 
@@ -782,6 +868,336 @@ static void lPragmaUnroll(YYSTYPE *yylval, SourcePos *pos, std::string fromUserR
     pos->last_column = 1;
 }
 
+/** Handle pragma directive to block a foreach_tiled loop for the L1 or L2
+    data cache.
+*/
+static void lPragmaCacheBlock(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmacacheblock;
+    yylval->pragmaAttributes->cacheLevel = 2;
+
+    lNextValidChar(pos, currChar);
+
+    if (*currChar == '(') {
+        currChar++;
+        ++pos->last_column;
+        lNextValidChar(pos, currChar);
+        if ((currChar[0] == 'l' || currChar[0] == 'L') && (currChar[1] == '1' || currChar[1] == '2')) {
+            yylval->pragmaAttributes->cacheLevel = currChar[1] - '0';
+            currChar += 2;
+            pos->last_column += 2;
+            lNextValidChar(pos, currChar);
+            if (*currChar == ')') {
+                currChar++;
+                ++pos->last_column;
+                lNextValidChar(pos, currChar);
+            } else {
+                Error(*pos, "Incomplete '#pragma cache_block()' : expected ')'.");
+            }
+        } else {
+            Error(*pos, "Incorrect argument for '#pragma cache_block()' : expected 'L1' or 'L2'.");
+        }
+    }
+
+    if (*currChar != '\n') {
+        Warning(*pos, "extra tokens at end of '#pragma cache_block'.");
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to choose the dimension of a multidimensional
+    foreach loop that is vectorized.
+*/
+static void lPragmaVectorizeDim(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmavectorizedim;
+
+    lNextValidChar(pos, currChar);
+    std::string name;
+    if (*currChar == '(') {
+        currChar++;
+        ++pos->last_column;
+        lNextValidChar(pos, currChar);
+        while (isalnum((unsigned char)*currChar) || *currChar == '_') {
+            name += *currChar;
+            currChar++;
+            ++pos->last_column;
+        }
+        lNextValidChar(pos, currChar);
+        if (*currChar == ')') {
+            currChar++;
+            ++pos->last_column;
+            lNextValidChar(pos, currChar);
+        } else {
+            Error(*pos, "Incomplete '#pragma vectorize_dim()' : expected ')'.");
+        }
+    }
+    if (name.empty() || isdigit((unsigned char)name[0])) {
+        Error(*pos, "Incorrect '#pragma vectorize_dim' : expected '(<foreach variable>)'.");
+    }
+    yylval->pragmaAttributes->vectorizeDim = name;
+
+    if (*currChar != '\n') {
+        Warning(*pos, "extra tokens at end of '#pragma vectorize_dim'.");
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to fuse a foreach loop with the preceding one,
+    or to keep it separate from it.
+*/
+static void lPragmaFuse(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq, bool isNofuse) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmafuse;
+    yylval->pragmaAttributes->fuse = !isNofuse;
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '\n') {
+        Warning(*pos, isNofuse ? "extra tokens at end of '#pragma nofuse'." : "extra tokens at end of '#pragma fuse'.");
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to assert that no gathers, scatters, masked
+    stores or function calls remain in a loop or function after
+    optimization.
+*/
+static void lPragmaExpect(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmaexpect;
+
+    std::string name;
+    while (*currChar != 0 && *currChar != '\n' && *currChar != ' ' && *currChar != '\t' && *currChar != '\r') {
+        name += *currChar;
+        currChar++;
+        ++pos->last_column;
+    }
+    if (name == "gather") {
+        yylval->pragmaAttributes->expectFlags = Globals::pragmaExpectType::expectNoGather;
+    } else if (name == "scatter") {
+        yylval->pragmaAttributes->expectFlags = Globals::pragmaExpectType::expectNoScatter;
+    } else if (name == "masked_store") {
+        yylval->pragmaAttributes->expectFlags = Globals::pragmaExpectType::expectNoMaskedStore;
+    } else if (name == "call") {
+        yylval->pragmaAttributes->expectFlags = Globals::pragmaExpectType::expectNoCall;
+    } else {
+        Error(*pos, "Incorrect argument for '#pragma ispc expect_no_' : expected 'gather', 'scatter', "
+                    "'masked_store' or 'call'.");
+    }
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '\n') {
+        Warning(*pos, "extra tokens at end of '#pragma ispc expect_no_%s'.", name.c_str());
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to add a run-time check to the gathers of a
+    loop or function, which replaces them with broadcasts or vector loads
+    when their addresses are the same or consecutive.  It's passed to the
+    gathers in the same way as the '#pragma ispc expect_no_*' flags.
+*/
+static void lPragmaCoherentGathers(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmaexpect;
+    yylval->pragmaAttributes->expectFlags = Globals::pragmaExpectType::coherentGathers;
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '\n') {
+        Warning(*pos, "extra tokens at end of '#pragma ispc coherent_gathers'.");
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to specialize an exported function for the
+    given values of its uniform integer parameter.
+*/
+static void lPragmaSpecialize(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmaspecialize;
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '(') {
+        Error(*pos, "Incorrect '#pragma ispc specialize' : expected '(<parameter>: <values>)'.");
+        pos->last_line++;
+        pos->last_column = 1;
+        return;
+    }
+    currChar++;
+    ++pos->last_column;
+    lNextValidChar(pos, currChar);
+
+    std::string name;
+    while (isalnum((unsigned char)*currChar) || *currChar == '_') {
+        name += *currChar;
+        currChar++;
+        ++pos->last_column;
+    }
+    lNextValidChar(pos, currChar);
+    if (name.empty() || isdigit((unsigned char)name[0]) || *currChar != ':') {
+        Error(*pos, "Incorrect '#pragma ispc specialize' : expected a parameter name followed by ':'.");
+        pos->last_line++;
+        pos->last_column = 1;
+        return;
+    }
+    yylval->pragmaAttributes->specializeParam = name;
+    currChar++;
+    ++pos->last_column;
+
+    while (true) {
+        lNextValidChar(pos, currChar);
+        char *endPtr = nullptr;
+        long long value = strtoll(currChar, &endPtr, 0);
+        if (endPtr == currChar) {
+            Error(*pos, "Incorrect '#pragma ispc specialize' : expected an integer value.");
+            break;
+        }
+        yylval->pragmaAttributes->specializeValues.push_back(value);
+        pos->last_column += endPtr - currChar;
+        currChar = endPtr;
+        lNextValidChar(pos, currChar);
+        if (*currChar == ',') {
+            currChar++;
+            ++pos->last_column;
+            continue;
+        }
+        if (*currChar == ')') {
+            currChar++;
+            ++pos->last_column;
+            lNextValidChar(pos, currChar);
+            if (*currChar != '\n') {
+                Warning(*pos, "extra tokens at end of '#pragma ispc specialize'.");
+            }
+        } else {
+            Error(*pos, "Incomplete '#pragma ispc specialize()' : expected ')'.");
+        }
+        break;
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to dispatch the calls of an exported function,
+    whose uniform integer parameter is below the given threshold, to its
+    version compiled for a narrow target.
+*/
+static void lPragmaNarrow(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmanarrow;
+
+    lNextValidChar(pos, currChar);
+    std::string name;
+    if (*currChar == '(') {
+        currChar++;
+        ++pos->last_column;
+        lNextValidChar(pos, currChar);
+        while (isalnum((unsigned char)*currChar) || *currChar == '_') {
+            name += *currChar;
+            currChar++;
+            ++pos->last_column;
+        }
+        lNextValidChar(pos, currChar);
+    }
+    if (name.empty() || isdigit((unsigned char)name[0]) || *currChar != ':') {
+        Error(*pos, "Incorrect '#pragma ispc narrow' : expected '(<parameter>: <threshold>)'.");
+        pos->last_line++;
+        pos->last_column = 1;
+        return;
+    }
+    currChar++;
+    ++pos->last_column;
+    lNextValidChar(pos, currChar);
+
+    char *endPtr = nullptr;
+    long long threshold = strtoll(currChar, &endPtr, 0);
+    if (endPtr == currChar) {
+        Error(*pos, "Incorrect '#pragma ispc narrow' : expected an integer threshold.");
+    } else {
+        pos->last_column += endPtr - currChar;
+        currChar = endPtr;
+        lNextValidChar(pos, currChar);
+        if (*currChar == ')') {
+            yylval->pragmaAttributes->narrowParam = name;
+            yylval->pragmaAttributes->narrowThreshold = threshold;
+            currChar++;
+            ++pos->last_column;
+            lNextValidChar(pos, currChar);
+            if (*currChar != '\n') {
+                Warning(*pos, "extra tokens at end of '#pragma ispc narrow'.");
+            }
+        } else {
+            Error(*pos, "Incomplete '#pragma ispc narrow()' : expected ')'.");
+        }
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
+/** Handle pragma directive to restrict the targets, which an exported
+    function is compiled for in multi-target compilation.
+*/
+static void lPragmaTargets(YYSTYPE *yylval, SourcePos *pos, std::string fromUserReq) {
+    const char *currChar = fromUserReq.data();
+    yylval->pragmaAttributes = new PragmaAttributes();
+    yylval->pragmaAttributes->aType = PragmaAttributes::AttributeType::pragmatargets;
+
+    lNextValidChar(pos, currChar);
+    if (*currChar != '(') {
+        Error(*pos, "Incorrect '#pragma ispc targets' : expected '(<isa>, ...)'.");
+        pos->last_line++;
+        pos->last_column = 1;
+        return;
+    }
+    currChar++;
+    ++pos->last_column;
+
+    while (true) {
+        lNextValidChar(pos, currChar);
+        std::string name;
+        while (isalnum((unsigned char)*currChar)) {
+            name += *currChar;
+            currChar++;
+            ++pos->last_column;
+        }
+        if (name.empty()) {
+            Error(*pos, "Incorrect '#pragma ispc targets' : expected an ISA name.");
+            break;
+        }
+        yylval->pragmaAttributes->targetNames.push_back(name);
+        lNextValidChar(pos, currChar);
+        if (*currChar == ',') {
+            currChar++;
+            ++pos->last_column;
+            continue;
+        }
+        if (*currChar == ')') {
+            currChar++;
+            ++pos->last_column;
+            lNextValidChar(pos, currChar);
+            if (*currChar != '\n') {
+                Warning(*pos, "extra tokens at end of '#pragma ispc targets'.");
+            }
+        } else {
+            Error(*pos, "Incomplete '#pragma ispc targets()' : expected ')'.");
+        }
+        break;
+    }
+    pos->last_line++;
+    pos->last_column = 1;
+}
+
 /** Handle pragma directive to ignore warning.
 */
 static void
@@ -863,8 +1279,30 @@ static bool lConsumePragma(YYSTYPE *yylval, SourcePos *pos) {
         c = yyinput();
     }
     userReq += c;
-    std::string loopUnroll("unroll"), loopNounroll("nounroll"), ignoreWarning("ignore warning");
-    if (loopUnroll == userReq.substr(0, loopUnroll.size())) {
+    return lHandlePragma(yylval, pos, userReq);
+}
+
+/** Decide on next action based on the directive of '#pragma', which is
+ * given without the leading whitespace and with the trailing newline.
+ */
+static bool lHandlePragma(YYSTYPE *yylval, SourcePos *pos, std::string userReq) {
+    std::string loopUnroll("unroll"), loopNounroll("nounroll"), ignoreWarning("ignore warning"),
+        cacheBlock("cache_block"), vectorizeDim("vectorize_dim"), loopFuse("fuse"), loopNofuse("nofuse"),
+        expectNo("ispc expect_no_"), coherentGathers("ispc coherent_gathers"),
+        unrollReductions("unroll_reductions"), specialize("ispc specialize"), targets("ispc targets"),
+        narrow("ispc narrow");
+    if (unrollReductions == userReq.substr(0, unrollReductions.size())) {
+        SourcePos pragmaPos = *pos;
+        pos->last_column += unrollReductions.size();
+        lPragmaUnroll(yylval, pos, userReq.erase(0, unrollReductions.size()), false);
+        if (yylval->pragmaAttributes->unrollType == Globals::pragmaUnrollType::count) {
+            yylval->pragmaAttributes->unrollType = Globals::pragmaUnrollType::countReductions;
+        } else {
+            Error(pragmaPos, "'#pragma unroll_reductions' requires a count.");
+        }
+        return true;
+    }
+    else if (loopUnroll == userReq.substr(0, loopUnroll.size())) {
         pos->last_column += loopUnroll.size();
         lPragmaUnroll(yylval, pos, userReq.erase(0, loopUnroll.size()), false);
         return true;
@@ -874,6 +1312,51 @@ static bool lConsumePragma(YYSTYPE *yylval, SourcePos *pos) {
         lPragmaUnroll(yylval, pos, userReq.erase(0, loopNounroll.size()), true);
         return true;
     }
+    else if (cacheBlock == userReq.substr(0, cacheBlock.size())) {
+        pos->last_column += cacheBlock.size();
+        lPragmaCacheBlock(yylval, pos, userReq.erase(0, cacheBlock.size()));
+        return true;
+    }
+    else if (vectorizeDim == userReq.substr(0, vectorizeDim.size())) {
+        pos->last_column += vectorizeDim.size();
+        lPragmaVectorizeDim(yylval, pos, userReq.erase(0, vectorizeDim.size()));
+        return true;
+    }
+    else if (loopFuse == userReq.substr(0, loopFuse.size())) {
+        pos->last_column += loopFuse.size();
+        lPragmaFuse(yylval, pos, userReq.erase(0, loopFuse.size()), false);
+        return true;
+    }
+    else if (loopNofuse == userReq.substr(0, loopNofuse.size())) {
+        pos->last_column += loopNofuse.size();
+        lPragmaFuse(yylval, pos, userReq.erase(0, loopNofuse.size()), true);
+        return true;
+    }
+    else if (coherentGathers == userReq.substr(0, coherentGathers.size())) {
+        pos->last_column += coherentGathers.size();
+        lPragmaCoherentGathers(yylval, pos, userReq.erase(0, coherentGathers.size()));
+        return true;
+    }
+    else if (expectNo == userReq.substr(0, expectNo.size())) {
+        pos->last_column += expectNo.size();
+        lPragmaExpect(yylval, pos, userReq.erase(0, expectNo.size()));
+        return true;
+    }
+    else if (narrow == userReq.substr(0, narrow.size())) {
+        pos->last_column += narrow.size();
+        lPragmaNarrow(yylval, pos, userReq.erase(0, narrow.size()));
+        return true;
+    }
+    else if (specialize == userReq.substr(0, specialize.size())) {
+        pos->last_column += specialize.size();
+        lPragmaSpecialize(yylval, pos, userReq.erase(0, specialize.size()));
+        return true;
+    }
+    else if (targets == userReq.substr(0, targets.size())) {
+        pos->last_column += targets.size();
+        lPragmaTargets(yylval, pos, userReq.erase(0, targets.size()));
+        return true;
+    }
     else if (ignoreWarning == userReq.substr(0, ignoreWarning.size())) {
         pos->last_column += ignoreWarning.size();
         lPragmaIgnoreWarning(pos, userReq.erase(0, ignoreWarning.size()));
@@ -1099,3 +1582,131 @@ lParseOperator(const char *ptr) {
     else
         return TOKEN_IDENTIFIER;
 }
+
+/** Punctuators of the language, as spelled by the clang preprocessor.
+ */
+static const llvm::StringMap<int> &
+lPunctuators() {
+    static const llvm::StringMap<int> punctuators = {
+        {"...", TOKEN_DOTDOTDOT}, {"++", TOKEN_INC_OP}, {"--", TOKEN_DEC_OP}, {"<<", TOKEN_LEFT_OP},
+        {">>", TOKEN_RIGHT_OP}, {"<=", TOKEN_LE_OP}, {">=", TOKEN_GE_OP}, {"==", TOKEN_EQ_OP},
+        {"!=", TOKEN_NE_OP}, {"&&", TOKEN_AND_OP}, {"||", TOKEN_OR_OP}, {"*=", TOKEN_MUL_ASSIGN},
+        {"/=", TOKEN_DIV_ASSIGN}, {"%=", TOKEN_MOD_ASSIGN}, {"+=", TOKEN_ADD_ASSIGN}, {"-=", TOKEN_SUB_ASSIGN},
+        {"<<=", TOKEN_LEFT_ASSIGN}, {">>=", TOKEN_RIGHT_ASSIGN}, {"&=", TOKEN_AND_ASSIGN},
+        {"^=", TOKEN_XOR_ASSIGN}, {"|=", TOKEN_OR_ASSIGN}, {"->", TOKEN_PTR_OP}, {";", ';'}, {"{", '{'},
+        {"}", '}'}, {",", ','}, {":", ':'}, {"=", '='}, {"(", '('}, {")", ')'}, {"[", '['}, {"]", ']'},
+        {".", '.'}, {"&", '&'}, {"!", '!'}, {"~", '~'}, {"-", '-'}, {"+", '+'}, {"*", '*'}, {"/", '/'},
+        {"%", '%'}, {"<", '<'}, {">", '>'}, {"^", '^'}, {"|", '|'}, {"?", '?'},
+    };
+    return punctuators;
+}
+
+/*
+ * The tokens of the preprocessed source are normally passed by the clang
+ * preprocessor straight to the parser (see Module::preprocessAndParse()),
+ * instead of printing the preprocessed source and scanning it again.  While
+ * the token source is set, yylex() returns its tokens.  The token source maps
+ * the identifiers, the keywords, the punctuators and the pragmas with the
+ * Lex*() functions below and passes the rest as text to the flex rules with
+ * LexText(), which only scans the text of those tokens.
+ */
+
+static std::function<int()> lTokenSource;
+static YY_BUFFER_STATE lTextBuffer = nullptr;
+// Text of the current token for the parser, which reads yytext.
+static std::string lTokenText;
+
+static void
+lSetToken(llvm::StringRef text, const SourcePos &pos) {
+    lTokenText.assign(text.data(), text.size());
+    yytext = &lTokenText[0];
+    yylloc = pos;
+}
+
+static int
+lNextTextToken() {
+    int token = lFlexLex();
+    if (token == 0) {
+        yy_delete_buffer(lTextBuffer);
+        lTextBuffer = nullptr;
+    }
+    return token;
+}
+
+int
+yylex() {
+    if (!lTokenSource)
+        return lFlexLex();
+    if (lTextBuffer != nullptr) {
+        int token = lNextTextToken();
+        if (token != 0)
+            return token;
+    }
+    return lTokenSource();
+}
+
+/** Set the source of the tokens for yylex(), or reset it to the flex
+    buffer if the source is empty.
+ */
+void
+SetTokenSource(std::function<int()> source) {
+    if (lTextBuffer != nullptr) {
+        yy_delete_buffer(lTextBuffer);
+        lTextBuffer = nullptr;
+    }
+    lTokenSource = std::move(source);
+}
+
+/** Return the token for an identifier or a keyword.
+ */
+int
+LexIdentifier(llvm::StringRef name, const SourcePos &pos) {
+    lSetToken(name, pos);
+    return lParseIdentifier(yytext);
+}
+
+/** Return the token for a punctuator, or 0 if it's not a punctuator of the
+    language.
+ */
+int
+LexPunctuator(llvm::StringRef spelling, const SourcePos &pos) {
+    const llvm::StringMap<int> &punctuators = lPunctuators();
+    auto punctuator = punctuators.find(spelling);
+    if (punctuator == punctuators.end())
+        return 0;
+    lSetToken(spelling, pos);
+    return punctuator->second;
+}
+
+/** Scan the text starting at the given position with the flex rules.
+    Returns the first token, or 0 if the text has no tokens; the rest of the
+    tokens are returned by yylex().
+ */
+int
+LexText(llvm::StringRef text, const SourcePos &pos) {
+    Assert(lTextBuffer == nullptr);
+    lTextBuffer = yy_scan_bytes(text.data(), (int)text.size());
+    yylloc = SourcePos(pos.name, pos.first_line, pos.first_column, pos.first_line, pos.first_column);
+    return lNextTextToken();
+}
+
+/** Handle the directive of '#pragma' given without the leading whitespace
+    and the trailing newline.  Returns TOKEN_PRAGMA or 0 if there's no token
+    for the parser.
+ */
+int
+LexPragma(const std::string &text, const SourcePos &pos) {
+    if (text.empty())
+        // Ignore pragma since - directive provided.
+        return 0;
+    lSetToken("#pragma", pos);
+    return lHandlePragma(&yylval, &yylloc, text + "\n") ? TOKEN_PRAGMA : 0;
+}
+
+/** Return the end of the source.
+ */
+int
+LexEndOfFile(const SourcePos &pos) {
+    lSetToken("", pos);
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file libispc.h
+    @brief C interface of libispc, the library for the compilation of ispc
+           source code to executable code in the calling process.
+
+    The source code is compiled for the host CPU, as with the ispc command
+    line, and the object file is loaded into the process by the ORC JIT of
+    LLVM.  The undefined symbols of the code, like the task system
+    functions (ISPCLaunch, ISPCSync and ISPCAlloc) and the math library
+    functions, are resolved from the symbols of the process.
+
+    The compilations are serialized, and the diagnostics are printed to
+    stderr.  The options, which make the ispc command line exit, like
+    --help, terminate the process.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(ISPC_LIBRARY_BUILD)
+#define LIBISPC_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define LIBISPC_API __declspec(dllimport)
+#else
+#define LIBISPC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque handle of the executable code of a compiled source. */
+typedef struct _ISPCJITModule *ISPCJITModule;
+
+/** Compile the null-terminated ispc source code \p source with the ispc
+    command line options \p options (like "--target=avx2-i32x8" or "-O2",
+    without an input or an output file) for the host CPU, and load it into
+    the current process.  Only a single CPU target is supported.  Returns
+    NULL on error. */
+LIBISPC_API ISPCJITModule ispcJITCompile(const char *source, const char *const *options, uint32_t numOptions);
+
+/** Return the address of the exported function or the global variable
+    \p name of \p module, or NULL if there is no such symbol. */
+LIBISPC_API void *ispcJITGetSymbol(ISPCJITModule module, const char *name);
+
+/** Release \p module and its executable code. */
+LIBISPC_API void ispcJITRelease(ISPCJITModule module);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -11,14 +11,17 @@
 #include "llvmutil.h"
 #include "type.h"
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <vector>
 
+#include <llvm/Analysis/AssumptionCache.h>
 #include <llvm/Analysis/ValueTracking.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/KnownBits.h>
 
 #ifdef ISPC_XE_ENABLED
 #include <llvm/GenXIntrinsics/GenXIntrinsics.h>
@@ -1474,6 +1477,19 @@ bool LLVMVectorIsLinear(llvm::Value *v, int stride) {
     return linear;
 }
 
+int LLVMGetKnownAlignment(llvm::Value *ptr, int align, llvm::Instruction *ctxI, llvm::AssumptionCache *AC) {
+    int maxAlign = g->target->getNativeVectorAlignment();
+    if (align >= maxAlign || !ptr->getType()->isPointerTy()) {
+        return align;
+    }
+
+    const llvm::DataLayout &DL = ctxI->getModule()->getDataLayout();
+    llvm::KnownBits known = llvm::computeKnownBits(ptr, DL, 0, AC, ctxI);
+    unsigned trailingZeros = known.countMinTrailingZeros();
+    int knownAlign = trailingZeros >= 31 ? maxAlign : std::min(1 << trailingZeros, maxAlign);
+    return std::max(align, knownAlign);
+}
+
 static void lDumpValue(llvm::Value *v, std::set<llvm::Value *> &done) {
     if (done.find(v) != done.end()) {
         return;
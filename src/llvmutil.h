@@ -23,6 +23,7 @@
 #endif
 
 namespace llvm {
+class AssumptionCache;
 class PHINode;
 class InsertElementInst;
 } // namespace llvm
@@ -246,6 +247,13 @@ extern bool IsOrEquivalentToAdd(llvm::Value *op);
     */
 extern bool LLVMVectorIsLinear(llvm::Value *v, int stride);
 
+/** Returns the alignment in bytes of the memory that the pointer ptr
+    points to at the instruction ctxI: the larger one of align and the
+    alignment that is known from the computation of the pointer and from
+    the llvm.assume() calls in AC, like the ones added for assume_aligned().
+    The result is at most the native vector alignment of the target. */
+extern int LLVMGetKnownAlignment(llvm::Value *ptr, int align, llvm::Instruction *ctxI, llvm::AssumptionCache *AC);
+
 /** Given a vector-typed value v, if the vector is a vector with constant
     element values, this function extracts those element values into the
     ret[] array and returns the number of elements (i.e. the vector type's
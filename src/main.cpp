@@ -10,12 +10,16 @@
 
 #include "binary_type.h"
 #include "ispc.h"
+#include "jit.h"
 #include "module.h"
+#include "server.h"
 #include "target_registry.h"
+#include "time_report.h"
 #include "type.h"
 #include "util.h"
 
 #include <cstdarg>
+#include <mutex>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
@@ -65,6 +69,10 @@ static void lPrintVersion() {
 #ifndef ISPC_HOST_IS_WINDOWS
     printf("    [--colored-output]\t\t\tAlways use terminal colors in error/warning messages\n");
 #endif
+    printf("    [--cache-dir=<path>]\t\tCache compilation results in <path> and reuse them for identical "
+           "compilations\n");
+    printf("    [--codegen-threads=<value>]\t\tGenerate the machine code of each target in <value> threads, "
+           "emitting an object file per thread\n");
     printf("    [--cpu=<type>]\t\t\tAn alias for [--device=<type>] switch\n");
     printf("    [-D<foo>]\t\t\t\t#define given value when running preprocessor\n");
     printf("    [--dev-stub <filename>]\t\tEmit device-side offload stub functions to file\n");
@@ -81,6 +89,8 @@ static void lPrintVersion() {
     printf("    [--emit-llvm]\t\t\tEmit LLVM bitcode file as output\n");
     printf("    [--emit-llvm-text]\t\t\tEmit LLVM bitcode file as output in textual form\n");
     printf("    [--emit-obj]\t\t\tGenerate object file file as output (default)\n");
+    printf("    [--emit-thinlto]\t\t\tEmit LLVM bitcode file with ThinLTO module summary as output\n");
+    printf("    [--emit-lto]\t\t\tEmit LLVM bitcode file to be optimized by \"ispc link --lto\" as output\n");
 #ifdef ISPC_XE_ENABLED
     printf("    [--emit-spirv]\t\t\tGenerate SPIR-V file as output\n");
     // AOT compilation is temporary disabled on Windows
@@ -98,8 +108,13 @@ static void lPrintVersion() {
     printf("    [--host-stub <filename>]\t\tEmit host-side offload stub functions to file\n");
     printf("    [-h <name>/--header-outfile=<name>]\tOutput filename for header\n");
     printf("    [-I <path>]\t\t\t\tAdd <path> to #include file search path\n");
+    printf("    [--ifunc-dispatch]\t\t\tSelect the target of multi-target exported functions once, with GNU "
+           "IFUNC resolvers.  ELF target OSes only\n");
     printf("    [--ignore-preprocessor-errors]\tSuppress errors from the preprocessor\n");
     printf("    [--instrument]\t\t\tEmit instrumentation to gather performance data\n");
+    printf("    [--jobs=<value>]\t\t\tOptimize and generate code for up to <value> targets in parallel when "
+           "compiling for multiple targets\n");
+    printf("    [--lane-profile]\t\t\tRecord the lane occupancy for the sampling profiler of ispcrt_instrument\n");
     printf("    [--math-lib=<option>]\t\tSelect math library\n");
     printf("        default\t\t\t\tUse ispc's built-in math functions\n");
     printf("        fast\t\t\t\tUse high-performance but lower-accuracy math functions\n");
@@ -123,9 +138,11 @@ static void lPrintVersion() {
     printf("    [-o <name>/--outfile=<name>]\tOutput filename (may be \"-\" for standard output)\n");
     printf("    [-O0/-O(1/2/3)]\t\t\tSet optimization level. Default behavior is to optimize for speed\n");
     printf("        -O0\t\t\t\tOptimizations disabled\n");
-    printf("        -O1\t\t\t\tOptimization for size\n");
+    printf("        -O1\t\t\t\tFast optimization for size: ispc specific optimizations and basic LLVM "
+           "clean-up only\n");
     printf("        -O2/O3\t\t\t\tOptimization for speed\n");
     printf("    [--opt=<option>]\t\t\tSet optimization option\n");
+    printf("        coherent-gathers\t\tCheck at run time if the addresses of gathers are the same or consecutive\n");
     printf("        disable-assertions\t\tRemove assertion statements from final code\n");
     printf("        disable-fma\t\t\tDisable 'fused multiply-add' instructions (on targets that support them)\n");
     printf("        disable-gathers\t\t\tDisable gathers generation on targets that support them\n");
@@ -141,12 +158,40 @@ static void lPrintVersion() {
     printf("        fast-masked-vload\t\tFaster masked vector loads on SSE (may go past end of array)\n");
     printf("        fast-math\t\t\tPerform non-IEEE-compliant optimizations of numeric expressions\n");
     printf("        force-aligned-memory\t\tAlways issue \"aligned\" vector load and store instructions\n");
+    printf("        foreach-single-body\t\tEmit one masked copy of foreach loop bodies on targets where masking is "
+           "free\n");
+    printf("        mask-multiversioning\t\tCall all-on versions of non-inlined functions when the mask is all on\n");
+    printf("        merge-target-variants\t\tShare exported functions with the same IR between targets of "
+           "multi-target compilation\n");
     printf("        reset-ftz-daz\t\t\tReset FTZ/DAZ flags on ISPC extern function entrance / restore on return\n");
+    printf("        streaming-stores\t\tUse non-temporal stores for large write-only outputs of loops on x86\n");
+    printf("        uniformity-inference\t\tUse scalars for varying values proven equal in all program instances\n");
+    printf("    [--opt-report]\t\t\tReport the gathers, scatters and masked memory operations left after "
+           "optimization\n");
+    printf("    [--opt-report-file=<file>]\t\tWrite the optimization report to <file> as YAML\n");
     printf("    [--pic]\t\t\t\tGenerate position-independent code.  Ignored for Windows target\n");
     printf("    [--PIC]\t\t\t\tGenerate position-independent code avoiding any limit on the size of the global offset "
            "table. Ignored for Windows target\n");
+    printf("    [--prefetch-distance=<value>]\tInsert prefetches <value> loop iterations ahead for gathers with "
+           "indices loaded from contiguous memory (and strided loads on Xe)\n");
+    printf("    [--profile-generate[=<file>]]\tInstrument the code to write an execution profile to <file> "
+           "(default.profraw by default)\n");
+    printf("    [--profile-use=<file>]\t\tUse the execution profile in <file> (as merged by llvm-profdata) to "
+           "guide optimization\n");
     printf("    [--quiet]\t\t\t\tSuppress all output\n");
+#ifdef ISPC_XE_ENABLED
+    printf("    [--resource-report]\t\t\tReport the registers, spills, private memory and SLM used by each "
+           "kernel of the L0 binary\n");
+#endif
+#ifndef ISPC_HOST_IS_WINDOWS
+    printf("    [--server=<socket>]\t\tRun as a compilation server for the clients with ISPC_SERVER=<socket> in "
+           "the environment.  Must be the first argument\n");
+#endif
+    printf("    [--single-object]\t\t\tWrite all targets of multi-target compilation and the dispatch functions "
+           "to the single output file\n");
     printf("    [--support-matrix]\t\t\tPrint full matrix of supported targets, architectures and OSes\n");
+    printf("    [--switch-dispatch-threshold=<n>]\tDispatch varying \"switch\" statements with at least <n> "
+           "cases over the unique values of the condition (8 by default, 0 disables)\n");
     printf("    ");
     char targetHelp[2048];
     snprintf(targetHelp, sizeof(targetHelp),
@@ -173,6 +218,10 @@ static void lPrintVersion() {
     printf("        intel\t\t\t\tEmit Intel-style assembly\n");
     printf("        att\t\t\t\tEmit AT&T-style assembly\n");
 #ifdef ISPC_XE_ENABLED
+    printf("    [--xe-devices=<d1>[,<d2>...]]\tWith --emit-zebin, generate a fat binary with L0 binaries for these "
+           "devices and SPIR-V for the others\n");
+    printf("    [--xe-kernel-widths=<w1>[,<w2>...]]\tAlso compile the kernels for the Xe targets of the same "
+           "family with these vector widths, to be selected by ISPCRT\n");
     printf("    [--xe-stack-mem-size=<value>\t\tSet size of stateless stack memory in VC backend\n");
 #endif
     printf("    [@<filename>]\t\t\tRead additional arguments from the given file\n");
@@ -184,11 +233,14 @@ static void lPrintVersion() {
     lPrintVersion();
     printf("\nusage: ispc link\n");
     printf("\nLink several IR or SPIR-V files to selected output format: LLVM BC (default), LLVM text or SPIR-V\n");
+    printf("    [--emit-asm]\t\t\tGenerate assembly language file as output (with --lto only)\n");
     printf("    [--emit-llvm]\t\t\tEmit LLVM bitcode file as output\n");
     printf("    [--emit-llvm-text]\t\t\tEmit LLVM bitcode file as output in textual form\n");
+    printf("    [--emit-obj]\t\t\tGenerate object file as output (with --lto only)\n");
 #ifdef ISPC_XE_ENABLED
     printf("    [--emit-spirv]\t\t\tEmit SPIR-V file as output\n");
 #endif
+    printf("    [--lto]\t\t\t\tOptimize the files compiled with --emit-lto together, for their target\n");
     printf("    [-o <name>/--outfile=<name>]\tOutput filename (may be \"-\" for standard output)\n");
     printf("    <files to link or \"-\" for stdin>\n");
     printf("\nExamples:\n");
@@ -196,6 +248,8 @@ static void lPrintVersion() {
     printf("        ispc link test_a.spv test_b.spv --emit-llvm -o test.bc\n");
     printf("    Link LLVM bitcode files to SPIR-V output:\n");
     printf("        ispc link test_a.bc test_b.bc --emit-spirv -o test.spv\n");
+    printf("    Optimize LLVM bitcode files compiled with --emit-lto together to an object file:\n");
+    printf("        ispc link --lto test_a.bc test_b.bc --emit-obj -o test.o\n");
     exit(ret);
 }
 
@@ -204,6 +258,8 @@ static void lPrintVersion() {
     printf("\nusage (developer options): ispc\n");
     printf("    [--ast-dump]\t\tDump AST.\n");
     printf("    [--binary-type]\t\t\tPrint binary type (slim or composite).\n");
+    printf("    [--capture=<file>]\t\tWrite the module going into the optimization to <file> as bitcode, to be "
+           "replayed by \"ispc-opt --replay\"\n");
     printf("    [--debug]\t\t\t\tPrint information useful for debugging ispc\n");
     printf("    [--debug-llvm]\t\t\tEnable LLVM debugging information (dumps to stderr)\n");
     printf("    [--debug-pm]\t\t\tPrint verbose information from ispc pass manager\n");
@@ -221,14 +277,25 @@ static void lPrintVersion() {
     printf("        disable-all-on-optimizations\t\tDisable optimizations that take advantage of \"all on\" mask\n");
     printf("        disable-blended-masked-stores\t\tScalarize masked stores on SSE (vs. using vblendps)\n");
     printf("        disable-blending-removal\t\tDisable eliminating blend at same scope\n");
-    printf("        disable-coalescing\t\t\tDisable gather coalescing\n");
+    printf("        disable-coalescing\t\t\tDisable gather and scatter coalescing\n");
     printf("        disable-coherent-control-flow\t\tDisable coherent control flow optimizations\n");
+    printf("        disable-foreach-fusion\t\t\tKeep adjacent \"foreach\" loops over the same domain separate\n");
     printf("        disable-gather-scatter-flattening\tDisable flattening when all lanes are on\n");
     printf("        disable-gather-scatter-optimizations\tDisable improvements to gather/scatter\n");
     printf("        disable-handle-pseudo-memory-ops\tLeave __pseudo_* calls for gather/scatter/etc. in final IR\n");
+    printf("        disable-internal-regcall\t\tUse the default calling convention for the functions that are "
+           "only called from the module\n");
+    printf("        disable-invariant-division\t\tDisable multiplication by magic numbers for division by loop "
+           "invariant uniform divisors\n");
+    printf("        disable-launch-fusion\t\t\tLaunch the tasks of each iteration of loops of launches separately\n");
+    printf("        disable-local-array-promotion\t\tKeep gathers and scatters from small local arrays indexed with "
+           "varying values\n");
+    printf("        disable-masked-mem-op-hoisting\tKeep masked loads and stores of loop invariant addresses in the "
+           "loops\n");
     printf("        disable-uniform-control-flow\t\tDisable uniform control flow optimizations\n");
     printf("        disable-uniform-memory-optimizations\tDisable uniform-based coherent memory access\n");
 #ifdef ISPC_XE_ENABLED
+    printf("        disable-xe-block-mem-ops\t\tDisable Xe2 LSC block loads and stores\n");
     printf("        disable-xe-gather-coalescing\t\tDisable Xe gather coalescing\n");
     printf("        threshold-for-xe-gather-coalescing=<0>\tMinimal number of eliminated memory instructions for "
            "Xe gather coalescing\n");
@@ -236,6 +303,8 @@ static void lPrintVersion() {
            "Xe gather coalescing\n");
     printf("        enable-xe-unsafe-masked-load\t\tEnable Xe unsafe masked load\n");
 #endif
+    printf("    [--time-report=<file>]\t\tWrite wall time and peak memory usage of compilation phases per target "
+           "and function to <file> in JSON format\n");
     printf("    [--time-trace]\t\t\tTurn on time profiler. Generates JSON file based on output filename\n");
     printf("    [--time-trace-granularity=<value>]\tMinimum time granularity (in microseconds) traced by time "
            "profiler\n");
@@ -570,55 +639,11 @@ void lFreeArgv(std::vector<char *> &argv) {
 
 extern int yydebug;
 
-int main(int Argc, char *Argv[]) {
-    std::vector<char *> argv;
-    lGetAllArgs(Argc, Argv, argv);
+// Run a single compilation (or linkage) with the given command line. With
+// the JIT compilation, jitSource is compiled instead of the input file and
+// the object file is emitted to jitObject.
+static int lCompile(std::vector<char *> &argv, const char *jitSource, llvm::SmallVectorImpl<char> *jitObject) {
     int argc = argv.size();
-#ifdef ISPC_HOST_IS_WINDOWS
-    // While ispc doesn't load any libraries explicitly using LoadLibrary API (or alternatives), it uses vcruntime that
-    // loads vcruntime140.dll and msvcp140.dll. Moreover LLVM loads dbghelp.dll.
-    // There is no way to modify DLL search order for vcruntime140.dll and msvcp140.dll but we
-    // can prevent searching in CWD while loading dbghelp.dll.
-    // So before initiating any LLVM call, remove CWD from the search path to reduce the risk of DLL injection
-    // when Safe DLL search mode is OFF.
-    // https://learn.microsoft.com/en-us/windows/win32/dlls/dynamic-link-library-search-order
-    SetDllDirectory("");
-#endif
-    llvm::sys::AddSignalHandler(lSignal, nullptr);
-    // initialize available LLVM targets
-#ifdef ISPC_X86_ENABLED
-    LLVMInitializeX86TargetInfo();
-    LLVMInitializeX86Target();
-    LLVMInitializeX86AsmPrinter();
-    LLVMInitializeX86AsmParser();
-    LLVMInitializeX86Disassembler();
-    LLVMInitializeX86TargetMC();
-#endif
-
-#ifdef ISPC_ARM_ENABLED
-    LLVMInitializeARMTargetInfo();
-    LLVMInitializeARMTarget();
-    LLVMInitializeARMAsmPrinter();
-    LLVMInitializeARMAsmParser();
-    LLVMInitializeARMDisassembler();
-    LLVMInitializeARMTargetMC();
-
-    LLVMInitializeAArch64TargetInfo();
-    LLVMInitializeAArch64Target();
-    LLVMInitializeAArch64AsmPrinter();
-    LLVMInitializeAArch64AsmParser();
-    LLVMInitializeAArch64Disassembler();
-    LLVMInitializeAArch64TargetMC();
-#endif
-
-#ifdef ISPC_WASM_ENABLED
-    LLVMInitializeWebAssemblyAsmParser();
-    LLVMInitializeWebAssemblyAsmPrinter();
-    LLVMInitializeWebAssemblyDisassembler();
-    LLVMInitializeWebAssemblyTarget();
-    LLVMInitializeWebAssemblyTargetInfo();
-    LLVMInitializeWebAssemblyTargetMC();
-#endif
     char *file = nullptr;
     const char *headerFileName = nullptr;
     const char *outFileName = nullptr;
@@ -631,6 +656,8 @@ int main(int Argc, char *Argv[]) {
     // Initiailize globals early so that we can set various option values
     // as we're parsing below
     g = new Globals;
+    g->jitSource = jitSource;
+    g->jitObject = jitObject;
 
     Module::OutputType ot = Module::Object;
     Module::OutputFlags flags;
@@ -641,7 +668,7 @@ int main(int Argc, char *Argv[]) {
     BooleanOptValue discardValueNames = BooleanOptValue::none;
     BooleanOptValue wrapSignedInt = BooleanOptValue::none;
 
-    std::string ISPCAbsPath = llvm::sys::fs::getMainExecutable(argv[0], (void *)(intptr_t)main);
+    std::string ISPCAbsPath = llvm::sys::fs::getMainExecutable(argv[0], (void *)(intptr_t)lCompile);
     initializeBinaryType(ISPCAbsPath.c_str());
 
     ArgErrors errorHandler;
@@ -651,6 +678,7 @@ int main(int Argc, char *Argv[]) {
     if (argc > 1 && !strncmp(argv[1], "link", 4)) {
         // Use bitcode format by default
         ot = Module::Bitcode;
+        bool lto = false;
 
         if (argc < 2) {
             // Not sufficient number of arguments
@@ -675,6 +703,12 @@ int main(int Argc, char *Argv[]) {
                 ot = Module::Bitcode;
             } else if (!strcmp(argv[i], "--emit-llvm-text")) {
                 ot = Module::BitcodeText;
+            } else if (!strcmp(argv[i], "--emit-obj")) {
+                ot = Module::Object;
+            } else if (!strcmp(argv[i], "--emit-asm")) {
+                ot = Module::Asm;
+            } else if (!strcmp(argv[i], "--lto")) {
+                lto = true;
             } else if (argv[i][0] == '-') {
                 errorHandler.AddError("Unknown option \"%s\".", argv[i]);
             } else {
@@ -682,6 +716,9 @@ int main(int Argc, char *Argv[]) {
                 linkFileNames.push_back(file);
             }
         }
+        if (!lto && (ot == Module::Object || ot == Module::Asm)) {
+            errorHandler.AddError("Object file and assembly output require --lto.");
+        }
         // Emit accumulted errors and warnings, if any.
         errorHandler.Emit();
 
@@ -696,7 +733,7 @@ int main(int Argc, char *Argv[]) {
                                  "be issued, but no output will be generated.");
         }
 
-        int ret = Module::LinkAndOutput(linkFileNames, ot, outFileName);
+        int ret = Module::LinkAndOutput(linkFileNames, ot, outFileName, lto);
         lFreeArgv(argv);
         return ret;
     }
@@ -793,6 +830,12 @@ int main(int Argc, char *Argv[]) {
             g->NoOmitFramePointer = true;
         } else if (!strcmp(argv[i], "--instrument")) {
             g->emitInstrumentation = true;
+        } else if (!strcmp(argv[i], "--lane-profile")) {
+            g->emitLaneProfile = true;
+        } else if (!strcmp(argv[i], "--ifunc-dispatch")) {
+            g->ifuncDispatch = true;
+        } else if (!strcmp(argv[i], "--single-object")) {
+            g->singleObject = true;
         } else if (!strcmp(argv[i], "--no-pragma-once")) {
             g->noPragmaOnce = true;
         } else if (!strcmp(argv[i], "-g")) {
@@ -808,6 +851,12 @@ int main(int Argc, char *Argv[]) {
             ot = Module::BitcodeText;
         } else if (!strcmp(argv[i], "--emit-obj")) {
             ot = Module::Object;
+        } else if (!strcmp(argv[i], "--emit-thinlto")) {
+            ot = Module::Bitcode;
+            g->emitThinLTO = true;
+        } else if (!strcmp(argv[i], "--emit-lto")) {
+            ot = Module::Bitcode;
+            g->emitLTO = true;
         }
 #ifdef ISPC_XE_ENABLED
         else if (!strcmp(argv[i], "--emit-spirv")) {
@@ -828,6 +877,29 @@ int main(int Argc, char *Argv[]) {
             lParseInclude(argv[i] + 2);
         } else if (!strcmp(argv[i], "--ignore-preprocessor-errors")) {
             g->ignoreCPPErrors = true;
+        } else if (!strncmp(argv[i], "--codegen-threads=", 18)) {
+            int threads = atoi(argv[i] + 18);
+            if (threads >= 1) {
+                g->codegenThreads = threads;
+            } else {
+                errorHandler.AddError("Invalid value for --codegen-threads: \"%s\" -- "
+                                      "value must be a positive number.",
+                                      argv[i] + 18);
+            }
+        } else if (!strncmp(argv[i], "--jobs=", 7)) {
+            int jobs = atoi(argv[i] + 7);
+            if (jobs >= 1) {
+                g->numJobs = jobs;
+            } else {
+                errorHandler.AddError("Invalid value for --jobs: \"%s\" -- "
+                                      "value must be a positive number.",
+                                      argv[i] + 7);
+            }
+        } else if (!strncmp(argv[i], "--cache-dir=", 12)) {
+            g->cacheDir = argv[i] + strlen("--cache-dir=");
+            if (g->cacheDir.empty()) {
+                errorHandler.AddError("No path specified after --cache-dir= option.");
+            }
         } else if (!strcmp(argv[i], "--target")) {
             // FIXME: should remove this way of specifying the target...
             if (++i != argc) {
@@ -870,6 +942,13 @@ int main(int Argc, char *Argv[]) {
             } else {
                 errorHandler.AddError("Unknown --math-lib= option \"%s\".", lib);
             }
+        } else if (!strcmp(argv[i], "--opt-report")) {
+            g->optReport = true;
+        } else if (!strncmp(argv[i], "--opt-report-file=", 18)) {
+            g->optReportFile = argv[i] + 18;
+            if (g->optReportFile.empty()) {
+                errorHandler.AddError("No file name given for --opt-report-file.");
+            }
         } else if (!strncmp(argv[i], "--opt=", 6)) {
             const char *opt = argv[i] + 6;
             if (!strcmp(opt, "fast-math")) {
@@ -880,6 +959,8 @@ int main(int Argc, char *Argv[]) {
                 g->opt.disableAsserts = true;
             } else if (!strcmp(opt, "disable-gathers")) {
                 g->opt.disableGathers = true;
+            } else if (!strcmp(opt, "coherent-gathers")) {
+                g->opt.coherentGathers = true;
             } else if (!strcmp(opt, "disable-scatters")) {
                 g->opt.disableScatters = true;
             } else if (!strcmp(opt, "disable-loop-unroll")) {
@@ -890,8 +971,18 @@ int main(int Argc, char *Argv[]) {
                 g->opt.disableZMM = true;
             } else if (!strcmp(opt, "force-aligned-memory")) {
                 g->opt.forceAlignedMemory = true;
+            } else if (!strcmp(opt, "foreach-single-body")) {
+                g->opt.foreachSingleBody = true;
+            } else if (!strcmp(opt, "mask-multiversioning")) {
+                g->opt.maskMultiversioning = true;
+            } else if (!strcmp(opt, "merge-target-variants")) {
+                g->opt.mergeTargetVariants = true;
             } else if (!strcmp(opt, "reset-ftz-daz")) {
                 g->opt.resetFTZ_DAZ = true;
+            } else if (!strcmp(opt, "streaming-stores")) {
+                g->opt.streamingStores = true;
+            } else if (!strcmp(opt, "uniformity-inference")) {
+                g->opt.uniformityInference = true;
             }
 
             // These are only used for performance tests of specific
@@ -900,6 +991,18 @@ int main(int Argc, char *Argv[]) {
                 g->opt.disableMaskAllOnOptimizations = true;
             } else if (!strcmp(opt, "disable-coalescing")) {
                 g->opt.disableCoalescing = true;
+            } else if (!strcmp(opt, "disable-foreach-fusion")) {
+                g->opt.disableForeachFusion = true;
+            } else if (!strcmp(opt, "disable-internal-regcall")) {
+                g->opt.disableInternalRegCall = true;
+            } else if (!strcmp(opt, "disable-invariant-division")) {
+                g->opt.disableInvariantDivision = true;
+            } else if (!strcmp(opt, "disable-launch-fusion")) {
+                g->opt.disableLaunchFusion = true;
+            } else if (!strcmp(opt, "disable-local-array-promotion")) {
+                g->opt.disableLocalArrayPromotion = true;
+            } else if (!strcmp(opt, "disable-masked-mem-op-hoisting")) {
+                g->opt.disableMaskedMemOpHoisting = true;
             } else if (!strcmp(opt, "disable-handle-pseudo-memory-ops")) {
                 g->opt.disableHandlePseudoMemoryOps = true;
             } else if (!strcmp(opt, "disable-blended-masked-stores")) {
@@ -920,6 +1023,8 @@ int main(int Argc, char *Argv[]) {
 #ifdef ISPC_XE_ENABLED
             else if (!strcmp(opt, "disable-xe-gather-coalescing")) {
                 g->opt.disableXeGatherCoalescing = true;
+            } else if (!strcmp(opt, "disable-xe-block-mem-ops")) {
+                g->opt.disableXeBlockMemOps = true;
             } else if (!strncmp(opt, "threshold-for-xe-gather-coalescing=", 37)) {
                 g->opt.thresholdForXeGatherCoalescing = atoi(opt + 37);
             } else if (!strcmp(opt, "emit-xe-hardware-mask")) {
@@ -935,10 +1040,43 @@ int main(int Argc, char *Argv[]) {
             }
         } else if (!strncmp(argv[i], "--force-alignment=", 18)) {
             g->forceAlignment = atoi(argv[i] + 18);
+        } else if (!strncmp(argv[i], "--prefetch-distance=", 20)) {
+            int distance = atoi(argv[i] + 20);
+            if (distance >= 0) {
+                g->opt.prefetchDistance = distance;
+            } else {
+                errorHandler.AddError("Invalid value for --prefetch-distance: \"%s\" -- "
+                                      "must be non-negative.",
+                                      argv[i] + 20);
+            }
+        } else if (!strncmp(argv[i], "--switch-dispatch-threshold=", 28)) {
+            int threshold = atoi(argv[i] + 28);
+            if (threshold >= 0) {
+                g->opt.switchDispatchThreshold = threshold;
+            } else {
+                errorHandler.AddError("Invalid value for --switch-dispatch-threshold: \"%s\" -- "
+                                      "must be non-negative.",
+                                      argv[i] + 28);
+            }
+        } else if (!strcmp(argv[i], "--profile-generate")) {
+            g->profileGenerate = true;
+        } else if (!strncmp(argv[i], "--profile-generate=", 19)) {
+            g->profileGenerate = true;
+            g->profileGenerateFile = ParsePath(argv[i] + 19, errorHandler);
+        } else if (!strncmp(argv[i], "--profile-use=", 14)) {
+            g->profileUseFile = ParsePath(argv[i] + 14, errorHandler);
+            if (g->profileUseFile.empty()) {
+                errorHandler.AddError("No profile file name specified after --profile-use option.");
+            }
         } else if (!strcmp(argv[i], "--time-trace")) {
             g->enableTimeTrace = true;
         } else if (!strncmp(argv[i], "--time-trace-granularity=", 25)) {
             g->timeTraceGranularity = atoi(argv[i] + 25);
+        } else if (!strncmp(argv[i], "--time-report=", 14)) {
+            g->timeReportFile = argv[i] + strlen("--time-report=");
+            if (g->timeReportFile.empty()) {
+                errorHandler.AddError("No file name specified after --time-report= option.");
+            }
         } else if (!strcmp(argv[i], "--woff") || !strcmp(argv[i], "-woff")) {
             g->disableWarnings = true;
             g->emitPerfWarnings = false;
@@ -982,9 +1120,10 @@ int main(int Argc, char *Argv[]) {
             g->codegenOptLevel = Globals::CodegenOptLevel::None;
         } else if (!strcmp(argv[i], "-O") || !strcmp(argv[i], "-O1") || !strcmp(argv[i], "-O2") ||
                    !strcmp(argv[i], "-O3")) {
-            g->opt.level = 1;
+            g->opt.level = 2;
             g->codegenOptLevel = Globals::CodegenOptLevel::Aggressive;
             if (!strcmp(argv[i], "-O1")) {
+                g->opt.level = 1;
                 g->opt.disableCoherentControlFlow = true;
             }
         } else if (!strcmp(argv[i], "-")) {
@@ -1062,6 +1201,11 @@ int main(int Argc, char *Argv[]) {
                                     "handles the phases and it may possibly make some bugs go"
                                     "away or introduce the new ones.");
             g->debug_stages = ParsingPhases(argv[i] + strlen("--debug-phase="), errorHandler);
+        } else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            g->captureFile = argv[i] + strlen("--capture=");
+            if (g->captureFile.empty()) {
+                errorHandler.AddError("No file name specified after --capture= option.");
+            }
         } else if (strncmp(argv[i], "--dump-file=", 12) == 0) {
             g->dumpFile = true;
             g->dumpFilePath = ParsePath(argv[i] + strlen("--dump-file="), errorHandler);
@@ -1083,6 +1227,29 @@ int main(int Argc, char *Argv[]) {
         } else if (!strncmp(argv[i], "--xe-stack-mem-size=", 20)) {
             unsigned int memSize = atoi(argv[i] + 20);
             g->stackMemSize = memSize;
+        } else if (!strcmp(argv[i], "--resource-report")) {
+            g->resourceReport = true;
+        } else if (!strncmp(argv[i], "--xe-devices=", 13)) {
+            llvm::SmallVector<llvm::StringRef, 4> devices;
+            llvm::StringRef(argv[i] + 13).split(devices, ',');
+            for (llvm::StringRef device : devices) {
+                if (!Target::IsXeDevice(device.str())) {
+                    errorHandler.AddError("Invalid Xe device \"%s\" for --xe-devices.", device.str().c_str());
+                } else {
+                    g->xeDevices.push_back(device.str());
+                }
+            }
+        } else if (!strncmp(argv[i], "--xe-kernel-widths=", 19)) {
+            llvm::SmallVector<llvm::StringRef, 4> widths;
+            llvm::StringRef(argv[i] + 19).split(widths, ',');
+            for (llvm::StringRef width : widths) {
+                int w = 0;
+                if (width.getAsInteger(10, w) || w <= 0) {
+                    errorHandler.AddError("Invalid vector width \"%s\" for --xe-kernel-widths.", width.str().c_str());
+                } else {
+                    g->xeKernelWidths.push_back(w);
+                }
+            }
 #endif
         } else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--version")) {
             lPrintVersion();
@@ -1105,6 +1272,19 @@ int main(int Argc, char *Argv[]) {
     // All the rest of errors and warnigns will be processed in regullar way.
     errorHandler.Emit();
 
+    if (!g->cacheDir.empty()) {
+        // Remember the options affecting the compilation result, they are a
+        // part of the compilation cache key.
+        for (int i = 1; i < argc; ++i) {
+            if (argv[i] == file || !strncmp(argv[i], "--cache-dir=", 12) || !strncmp(argv[i], "--jobs=", 7) ||
+                !strcmp(argv[i], "--quiet") || !strcmp(argv[i], "--nowrap") ||
+                !strcmp(argv[i], "--colored-output")) {
+                continue;
+            }
+            g->cacheKeyArgs.push_back(argv[i]);
+        }
+    }
+
     if (file == nullptr) {
         Error(SourcePos(), "No input file were specified. To read text from stdin use \"-\" as file name.");
         exit(1);
@@ -1187,8 +1367,8 @@ int main(int Argc, char *Argv[]) {
         g->target_os = TargetOS::web;
     }
     for (auto target : targets) {
-        if (target == ISPCTarget::wasm_i32x4) {
-            Assert(targets.size() == 1 && "wasm supports only one target: i32x4");
+        if (ISPCTargetIsWasm(target)) {
+            Assert(targets.size() == 1 && "wasm supports only one target");
             g->target_os = TargetOS::web;
             if (arch == Arch::none) {
                 arch = Arch::wasm32;
@@ -1227,7 +1407,7 @@ int main(int Argc, char *Argv[]) {
     }
 
     if (outFileName == nullptr && headerFileName == nullptr && (depsFileName == nullptr && !flags.isDepsToStdout()) &&
-        hostStubFileName == nullptr && devStubFileName == nullptr) {
+        hostStubFileName == nullptr && devStubFileName == nullptr && g->jitObject == nullptr) {
         Warning(SourcePos(), "No output file or header file name specified. "
                              "Program will be compiled and warnings/errors will "
                              "be issued, but no output will be generated.");
@@ -1241,6 +1421,12 @@ int main(int Argc, char *Argv[]) {
         Warning(SourcePos(), "--dllexport switch will be ignored, as the target OS is not Windows.");
     }
 
+    if (g->ifuncDispatch && g->target_os != TargetOS::linux && g->target_os != TargetOS::custom_linux &&
+        g->target_os != TargetOS::freebsd && g->target_os != TargetOS::android) {
+        Warning(SourcePos(), "--ifunc-dispatch switch will be ignored, as the target OS doesn't support IFUNC.");
+        g->ifuncDispatch = false;
+    }
+
     if (vectorCall != BooleanOptValue::none &&
         (g->target_os != TargetOS::windows ||
          // This is a hacky check. Arch is properly set later, so we rely that default means x86_64.
@@ -1249,6 +1435,25 @@ int main(int Argc, char *Argv[]) {
                              "options will be ignored.");
     }
 
+#ifdef ISPC_HOST_IS_WINDOWS
+    if (g->numJobs > 1) {
+        Warning(SourcePos(), "--jobs switch is not supported on Windows host and will be ignored.");
+        g->numJobs = 1;
+    }
+#endif
+
+    if (g->singleObject && g->numJobs > 1) {
+        Warning(SourcePos(), "--jobs switch is ignored with --single-object, as the targets are written to the "
+                             "single output file.");
+        g->numJobs = 1;
+    }
+
+    if (g->codegenThreads > 1 && ot != Module::Object && ot != Module::Asm) {
+        Warning(SourcePos(), "--codegen-threads is only supported for object file and assembly output and will be "
+                             "ignored.");
+        g->codegenThreads = 1;
+    }
+
     if (targets.size() > 1) {
         g->isMultiTargetCompilation = true;
     }
@@ -1280,6 +1485,61 @@ int main(int Argc, char *Argv[]) {
     }
 #endif
 
+    // The summary is written only with bitcode output, when another output
+    // type was given after --emit-thinlto.
+    if (ot != Module::Bitcode) {
+        g->emitThinLTO = false;
+    }
+    if (g->emitThinLTO && targetIsGen) {
+        Error(SourcePos(), "--emit-thinlto is not supported for Xe targets.");
+        exit(1);
+    }
+    // Likewise, the module is left unoptimized for "ispc link --lto" only
+    // with bitcode output.
+    if (ot != Module::Bitcode) {
+        g->emitLTO = false;
+    }
+    if (g->emitLTO && (targetIsGen || targets.size() > 1 || g->emitThinLTO)) {
+        Error(SourcePos(), "--emit-lto is only supported for a single CPU target.");
+        exit(1);
+    }
+#ifdef ISPC_XE_ENABLED
+    if (g->resourceReport && (!targetIsGen || ot != Module::ZEBIN)) {
+        Warning(SourcePos(), "--resource-report is only supported with --emit-zebin for Xe targets.");
+        g->resourceReport = false;
+    }
+    if (!g->xeDevices.empty() && (!targetIsGen || ot != Module::ZEBIN)) {
+        Warning(SourcePos(), "--xe-devices is only supported with --emit-zebin for Xe targets.");
+        g->xeDevices.clear();
+    }
+#endif
+
+    if (g->jitObject != nullptr && (ot != Module::Object || targetIsGen || g->onlyCPP)) {
+        Error(SourcePos(), "Only object files for CPU targets can be produced by JIT compilation.");
+        exit(1);
+    }
+
+    if (g->emitInstrumentation && g->emitLaneProfile) {
+        Error(SourcePos(), "--instrument and --lane-profile can't be used together.");
+        exit(1);
+    }
+    if (targetIsGen && g->emitLaneProfile) {
+        Error(SourcePos(), "--lane-profile is not supported for Xe targets.");
+        exit(1);
+    }
+    if (g->profileGenerate && !g->profileUseFile.empty()) {
+        Error(SourcePos(), "--profile-generate and --profile-use can't be used together.");
+        exit(1);
+    }
+    if (targetIsGen && (g->profileGenerate || !g->profileUseFile.empty())) {
+        Error(SourcePos(), "Profile-guided optimization is not supported for Xe targets.");
+        exit(1);
+    }
+    if (!g->profileUseFile.empty() && !llvm::sys::fs::exists(g->profileUseFile)) {
+        Error(SourcePos(), "Profile file \"%s\" does not exist.", g->profileUseFile.c_str());
+        exit(1);
+    }
+
     for (auto target : targets) {
         if (target == ISPCTarget::avx512knl_x16) {
             Warning(SourcePos(), "The target avx512knl_x16 is deprecated and will be removed in the future.");
@@ -1311,6 +1571,10 @@ int main(int Argc, char *Argv[]) {
                                        depsTargetName, hostStubFileName, devStubFileName);
     }
 
+    if (!g->timeReportFile.empty()) {
+        TimeReport::in().Write(g->timeReportFile, file);
+    }
+
     if (g->enableTimeTrace) {
         // Write to file only if compilation is successfull.
         if ((ret == 0) && (outFileName != nullptr)) {
@@ -1325,3 +1589,113 @@ int main(int Argc, char *Argv[]) {
     lFreeArgv(argv);
     return ret;
 }
+
+static int lCompile(std::vector<char *> &argv) { return lCompile(argv, nullptr, nullptr); }
+
+// Initialize the available LLVM targets.
+static void lInitializeTargets() {
+#ifdef ISPC_X86_ENABLED
+    LLVMInitializeX86TargetInfo();
+    LLVMInitializeX86Target();
+    LLVMInitializeX86AsmPrinter();
+    LLVMInitializeX86AsmParser();
+    LLVMInitializeX86Disassembler();
+    LLVMInitializeX86TargetMC();
+#endif
+
+#ifdef ISPC_ARM_ENABLED
+    LLVMInitializeARMTargetInfo();
+    LLVMInitializeARMTarget();
+    LLVMInitializeARMAsmPrinter();
+    LLVMInitializeARMAsmParser();
+    LLVMInitializeARMDisassembler();
+    LLVMInitializeARMTargetMC();
+
+    LLVMInitializeAArch64TargetInfo();
+    LLVMInitializeAArch64Target();
+    LLVMInitializeAArch64AsmPrinter();
+    LLVMInitializeAArch64AsmParser();
+    LLVMInitializeAArch64Disassembler();
+    LLVMInitializeAArch64TargetMC();
+#endif
+
+#ifdef ISPC_RISCV_ENABLED
+    LLVMInitializeRISCVTargetInfo();
+    LLVMInitializeRISCVTarget();
+    LLVMInitializeRISCVAsmPrinter();
+    LLVMInitializeRISCVAsmParser();
+    LLVMInitializeRISCVDisassembler();
+    LLVMInitializeRISCVTargetMC();
+#endif
+
+#ifdef ISPC_WASM_ENABLED
+    LLVMInitializeWebAssemblyAsmParser();
+    LLVMInitializeWebAssemblyAsmPrinter();
+    LLVMInitializeWebAssemblyDisassembler();
+    LLVMInitializeWebAssemblyTarget();
+    LLVMInitializeWebAssemblyTargetInfo();
+    LLVMInitializeWebAssemblyTargetMC();
+#endif
+}
+
+#ifdef ISPC_LIBRARY_BUILD
+int ispc::CompileForJIT(const char *source, const std::vector<std::string> &options,
+                        llvm::SmallVectorImpl<char> &object) {
+    static std::once_flag targetsInitialized;
+    std::call_once(targetsInitialized, lInitializeTargets);
+
+    // The command line is the options followed by the name of the source,
+    // which is used in the diagnostics and the debug information. The code
+    // is position independent, so that it may be loaded anywhere.
+    std::vector<char *> argv;
+    argv.push_back(strdup("ispc"));
+    for (const std::string &option : options) {
+        lAddSingleArg(const_cast<char *>(option.c_str()), argv, true);
+    }
+#ifndef ISPC_HOST_IS_WINDOWS
+    argv.push_back(strdup("--pic"));
+#endif
+    argv.push_back(strdup(JIT_SOURCE_NAME));
+    return lCompile(argv, source, &object);
+}
+#else
+int main(int Argc, char *Argv[]) {
+    std::vector<char *> argv;
+    lGetAllArgs(Argc, Argv, argv);
+
+    // Hand over the compilation to the compilation server, if there is one.
+    // This is done before any initialization, which the server has done
+    // already.
+    const char *server = getenv("ISPC_SERVER");
+    if (server != nullptr && *server != '\0' && !(argv.size() > 1 && !strncmp(argv[1], "--server=", 9))) {
+        int ret = 0;
+        if (CompileOnServer(server, argv, ret)) {
+            lFreeArgv(argv);
+            return ret;
+        }
+    }
+
+#ifdef ISPC_HOST_IS_WINDOWS
+    // While ispc doesn't load any libraries explicitly using LoadLibrary API (or alternatives), it uses vcruntime that
+    // loads vcruntime140.dll and msvcp140.dll. Moreover LLVM loads dbghelp.dll.
+    // There is no way to modify DLL search order for vcruntime140.dll and msvcp140.dll but we
+    // can prevent searching in CWD while loading dbghelp.dll.
+    // So before initiating any LLVM call, remove CWD from the search path to reduce the risk of DLL injection
+    // when Safe DLL search mode is OFF.
+    // https://learn.microsoft.com/en-us/windows/win32/dlls/dynamic-link-library-search-order
+    SetDllDirectory("");
+#endif
+    llvm::sys::AddSignalHandler(lSignal, nullptr);
+    lInitializeTargets();
+
+    // If the first argument is "--server=<socket>", ispc runs as a
+    // compilation server, which compiles the jobs sent by clients.
+    if (argv.size() > 1 && !strncmp(argv[1], "--server=", 9)) {
+        int ret = RunCompileServer(argv[1] + 9, lCompile);
+        lFreeArgv(argv);
+        return ret;
+    }
+
+    return lCompile(argv);
+}
+#endif // ISPC_LIBRARY_BUILD
@@ -12,6 +12,8 @@
 #include "module.h"
 #include "binary_type.h"
 #include "builtins.h"
+#include "cache.h"
+#include "constexpr.h"
 #include "ctx.h"
 #include "expr.h"
 #include "func.h"
@@ -20,20 +22,29 @@
 #include "opt.h"
 #include "stmt.h"
 #include "sym.h"
+#include "time_report.h"
 #include "type.h"
 #include "util.h"
 
 #include <algorithm>
 #include <ctype.h>
+#include <deque>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <set>
 #include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
+#include <functional>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifndef ISPC_HOST_IS_WINDOWS
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 #include <clang/Basic/CharInfo.h>
 #include <clang/Basic/FileManager.h>
@@ -50,10 +61,15 @@
 #include <clang/Lex/HeaderSearch.h>
 #include <clang/Lex/HeaderSearchOptions.h>
 #include <clang/Lex/ModuleLoader.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Pragma.h>
 #include <clang/Lex/Preprocessor.h>
 #include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/CodeGen/ParallelCG.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/DerivedTypes.h>
@@ -68,15 +84,19 @@
 #include <llvm/IR/Verifier.h>
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/PassRegistry.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/FileUtilities.h>
 #include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/MemoryBufferRef.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
@@ -343,26 +363,240 @@ extern YY_BUFFER_STATE yy_scan_string(const char *);
 extern YY_BUFFER_STATE yy_create_buffer(FILE *, int);
 extern void yy_delete_buffer(YY_BUFFER_STATE);
 extern void ParserInit();
+extern void SetTokenSource(std::function<int()> source);
+extern int LexIdentifier(llvm::StringRef name, const SourcePos &pos);
+extern int LexPunctuator(llvm::StringRef spelling, const SourcePos &pos);
+extern int LexText(llvm::StringRef text, const SourcePos &pos);
+extern int LexPragma(const std::string &text, const SourcePos &pos);
+extern int LexEndOfFile(const SourcePos &pos);
+
+// Source of the tokens for the parser, which reads them straight from the
+// clang preprocessor, so the preprocessed source isn't printed and scanned
+// again.  The identifiers, the keywords, the punctuators and the pragmas are
+// mapped to the tokens of the parser directly.  The literals and the token
+// sequences, which ispc splits differently than clang (like "delete[]" or
+// "@llvm.foo"), are scanned with the flex rules.
+class PreprocessorTokenSource {
+  public:
+    explicit PreprocessorTokenSource(clang::Preprocessor &prep)
+        : m_prep(prep), m_pragmaHandler(*this, ""), m_gccPragmaHandler(*this, "GCC"),
+          m_clangPragmaHandler(*this, "clang") {
+        // Pass the pragmas unknown to clang to the parser, like
+        // clang::DoPrintPreprocessedInput() prints them.
+        m_prep.AddPragmaHandler(&m_pragmaHandler);
+        m_prep.AddPragmaHandler("GCC", &m_gccPragmaHandler);
+        m_prep.AddPragmaHandler("clang", &m_clangPragmaHandler);
+        m_prep.addPPCallbacks(std::make_unique<FileCallbacks>(*this));
+        m_prep.EnterMainSourceFile();
+    }
+
+    ~PreprocessorTokenSource() {
+        m_prep.RemovePragmaHandler(&m_pragmaHandler);
+        m_prep.RemovePragmaHandler("GCC", &m_gccPragmaHandler);
+        m_prep.RemovePragmaHandler("clang", &m_clangPragmaHandler);
+    }
+
+    // Return the next token for the parser.
+    int Next() {
+        while (true) {
+            const Item item = pop();
+            if (item.isPragma) {
+                if (int token = LexPragma(item.text, item.pos)) {
+                    return token;
+                }
+                continue;
+            }
 
-int Module::preprocessAndParse() {
-    llvm::SmallVector<llvm::StringRef, 6> refs;
+            const clang::Token &tok = item.token;
+            if (tok.is(clang::tok::eof)) {
+                return LexEndOfFile(item.pos);
+            }
+
+            int token = 0;
+            if (const clang::IdentifierInfo *ident = tok.getIdentifierInfo()) {
+                llvm::StringRef name = ident->getName();
+                if (name == "delete" && isAttached(0, "[") && isAttached(1, "]")) {
+                    pop();
+                    pop();
+                    token = LexText("delete[]", item.pos);
+                } else if (name == "operator" && isAttached(0) && strchr("*+-<>/%", spelling(0)[0]) != nullptr) {
+                    token = LexText(name.str() + spelling(0), item.pos);
+                    pop();
+                } else {
+                    token = LexIdentifier(name, item.pos);
+                }
+            } else if (const char *punctuator = clang::tok::getPunctuatorSpelling(tok.getKind())) {
+                token = LexPunctuator(punctuator, item.pos);
+                if (token == 0) {
+                    token = LexText(punctuator, item.pos);
+                }
+            } else {
+                std::string text = m_prep.getSpelling(tok);
+                if (text == "@") {
+                    // The name of an LLVM intrinsic is split by clang into
+                    // several tokens.
+                    while (isAttached(0) && llvm::all_of(spelling(0), [](char c) {
+                               return c == '.' || c == '_' || isalnum((unsigned char)c);
+                           })) {
+                        text += spelling(0);
+                        pop();
+                    }
+                }
+                token = LexText(text, item.pos);
+            }
+            if (token != 0) {
+                return token;
+            }
+        }
+    }
 
-    initCPPBuffer();
+  private:
+    // A token of the preprocessor or the text of a pragma.
+    struct Item {
+        clang::Token token;
+        bool isPragma{false};
+        std::string text;
+        SourcePos pos;
+    };
 
-    const int numErrors = execPreprocessor(filename, bufferCPP->os.get());
-    errorCount += (g->ignoreCPPErrors) ? 0 : numErrors;
+    class UnknownPragmaHandler : public clang::PragmaHandler {
+      public:
+        UnknownPragmaHandler(PreprocessorTokenSource &source, const char *ns) : m_source(source), m_namespace(ns) {}
+
+        void HandlePragma(clang::Preprocessor &prep, clang::PragmaIntroducer introducer,
+                          clang::Token &tok) override {
+            std::string text = m_namespace;
+            llvm::SmallString<32> buffer;
+            for (; tok.isNot(clang::tok::eod); prep.LexUnexpandedToken(tok)) {
+                if (!text.empty() && tok.hasLeadingSpace()) {
+                    text += ' ';
+                }
+                llvm::StringRef spelling = prep.getSpelling(tok, buffer);
+                text.append(spelling.data(), spelling.size());
+            }
+            Item item;
+            item.token.startToken();
+            item.isPragma = true;
+            item.text = std::move(text);
+            item.pos = m_source.position(introducer.Loc, 7);
+            m_source.m_items.push_back(std::move(item));
+        }
+
+      private:
+        PreprocessorTokenSource &m_source;
+        const char *m_namespace;
+    };
+
+    // Register the files entered by the preprocessor as the dependencies,
+    // including the files without tokens.
+    class FileCallbacks : public clang::PPCallbacks {
+      public:
+        explicit FileCallbacks(PreprocessorTokenSource &source) : m_source(source) {}
+
+        void FileChanged(clang::SourceLocation loc, FileChangeReason, clang::SrcMgr::CharacteristicKind,
+                         clang::FileID) override {
+            m_source.position(loc, 0);
+        }
+
+      private:
+        PreprocessorTokenSource &m_source;
+    };
+
+    clang::Preprocessor &m_prep;
+    UnknownPragmaHandler m_pragmaHandler;
+    UnknownPragmaHandler m_gccPragmaHandler;
+    UnknownPragmaHandler m_clangPragmaHandler;
+    // The lookahead tokens.  The pragmas are added by the pragma handlers
+    // while the preprocessor reads the next token.
+    std::deque<Item> m_items;
+    // Names of the files registered with RegisterDependency().
+    llvm::DenseMap<const char *, const char *> m_fileNames;
+    SourcePos m_lastPos;
+
+    SourcePos position(clang::SourceLocation loc, unsigned length) {
+        clang::PresumedLoc presumed = m_prep.getSourceManager().getPresumedLoc(loc);
+        if (presumed.isInvalid()) {
+            return m_lastPos;
+        }
+        const char *&name = m_fileNames[presumed.getFilename()];
+        if (name == nullptr) {
+            name = RegisterDependency(presumed.getFilename());
+        }
+        int line = presumed.getLine(), column = presumed.getColumn();
+        m_lastPos = SourcePos(name, line, column, line, column + length);
+        return m_lastPos;
+    }
 
+    // Return the lookahead token with the given index.
+    const Item &peek(size_t index) {
+        while (m_items.size() <= index) {
+            Item item;
+            m_prep.Lex(item.token);
+            item.pos = position(item.token.getLocation(), item.token.getLength());
+            m_items.push_back(std::move(item));
+        }
+        return m_items[index];
+    }
+
+    Item pop() {
+        peek(0);
+        Item item = std::move(m_items.front());
+        m_items.pop_front();
+        return item;
+    }
+
+    std::string spelling(size_t index) { return m_prep.getSpelling(peek(index).token); }
+
+    // Is the lookahead token with the given index attached to the previous
+    // one without whitespace?
+    bool isAttached(size_t index) {
+        const clang::Token &tok = peek(index).token;
+        return !peek(index).isPragma && tok.isNot(clang::tok::eof) && !tok.hasLeadingSpace() && !tok.isAtStartOfLine();
+    }
+
+    bool isAttached(size_t index, const char *text) { return isAttached(index) && spelling(index) == text; }
+};
+
+int Module::preprocessAndParse() {
     if (g->onlyCPP) {
+        initCPPBuffer();
+        int numErrors = 0;
+        {
+            TimeReportScope TimeReport("preprocess");
+            numErrors = execPreprocessor(filename, bufferCPP->os.get());
+        }
+        errorCount += (g->ignoreCPPErrors) ? 0 : numErrors;
         return errorCount; // Return early
     }
 
-    parseCPPBuffer();
-    clearCPPBuffer();
+    // The preprocessor runs on demand of the parser, so the "preprocess"
+    // phase covers its setup only.
+    auto setupTimeReport = std::make_unique<TimeReportScope>("preprocess");
+    int numErrors = execPreprocessor(filename, [&](clang::Preprocessor &prep) {
+        setupTimeReport.reset();
+        TimeReportScope TimeReport("parse");
+        PreprocessorTokenSource tokens(prep);
+        SetTokenSource([&tokens]() { return tokens.Next(); });
+        yyparse();
+        SetTokenSource(nullptr);
+    });
+    errorCount += (g->ignoreCPPErrors) ? 0 : numErrors;
 
     return 0;
 }
 
 int Module::parse() {
+    // With the JIT compilation, the source code is parsed from memory.
+    if (g->jitSource != nullptr) {
+        YY_BUFFER_STATE strbuf = yy_scan_string(g->jitSource);
+        {
+            TimeReportScope TimeReport("parse");
+            yyparse();
+        }
+        yy_delete_buffer(strbuf);
+        return 0;
+    }
+
     // No preprocessor, just open up the file if it's not stdin..
     FILE *f = nullptr;
     if (IsStdin(filename)) {
@@ -376,13 +610,16 @@ int Module::parse() {
     }
     yyin = f;
     yy_switch_to_buffer(yy_create_buffer(yyin, 4096));
-    yyparse();
+    {
+        TimeReportScope TimeReport("parse");
+        yyparse();
+    }
     fclose(f);
 
     return 0;
 }
 
-int Module::CompileFile() {
+int Module::CompileFile(bool optimize) {
     llvm::TimeTraceScope CompileFileTimeScope(
         "CompileFile", llvm::StringRef(filename + ("_" + std::string(g->target->GetISAString()))));
     ParserInit();
@@ -415,11 +652,13 @@ int Module::CompileFile() {
         g->target->markFuncWithTargetAttr(&f);
     }
     ast->GenerateIR();
+    finalizeInstrumentationTable();
 
     debugDumpModule(module, "GenerateIR", pre_stage++);
 
     if (!g->genStdlib) {
         llvm::TimeTraceScope TimeScope("DefineStdlib");
+        TimeReportScope TimeReport("link_stdlib");
         LinkStandardLibraries(module, pre_stage);
     }
 
@@ -431,16 +670,35 @@ int Module::CompileFile() {
         diBuilder->finalize();
     }
 
+    if (optimize) {
+        OptimizeFile();
+    }
+
+    return errorCount;
+}
+
+static void lCaptureModule(llvm::Module *module);
+static void lAddLTOMetadata(llvm::Module *module);
+
+void Module::OptimizeFile() {
     // Skip optimization for stdlib. We need to consider shipping optimized
     // stdlibs library but at the moment it is not so.
     if (!g->genStdlib) {
+        if (errorCount == 0 && !g->captureFile.empty()) {
+            lCaptureModule(module);
+        }
+        if (g->emitLTO) {
+            // The module is optimized by "ispc link --lto" together with
+            // the other modules of the program.
+            lAddLTOMetadata(module);
+            return;
+        }
         llvm::TimeTraceScope TimeScope("Optimize");
+        TimeReportScope TimeReport("optimize");
         if (errorCount == 0) {
             Optimize(module, g->opt.level);
         }
     }
-
-    return errorCount;
 }
 
 Symbol *Module::AddLLVMIntrinsicDecl(const std::string &name, ExprList *args, SourcePos pos) {
@@ -513,6 +771,96 @@ Symbol *Module::AddLLVMIntrinsicDecl(const std::string &name, ExprList *args, So
     return funcSym;
 }
 
+int Module::AddInstrumentationSite(SourcePos pos, const std::string &function, const char *note) {
+    instrumentationSites.push_back({pos.name != nullptr ? pos.name : "", function, note, pos.first_line});
+    return static_cast<int>(instrumentationSites.size() - 1);
+}
+
+// The table is passed to ISPCInstrument() as a pointer to the following
+// structure, declared in the header file:
+//
+//   struct ISPCInstrumentSites {
+//       uint32_t numSites;
+//       const struct ISPCInstrumentSite { const char *file, *function, *note; int32_t line; } *sites;
+//   };
+//
+// It has internal linkage, so the tables of different modules and of
+// different targets of the same module don't clash.
+static llvm::StructType *lInstrumentationTableType() {
+    return llvm::StructType::get(*g->ctx, {LLVMTypes::Int32Type, LLVMTypes::Int8PointerType});
+}
+
+llvm::Constant *Module::GetInstrumentationTable() {
+    if (instrumentationTable == nullptr) {
+        llvm::StructType *type = lInstrumentationTableType();
+        instrumentationTable =
+            new llvm::GlobalVariable(*module, type, true /* const */, llvm::GlobalValue::InternalLinkage,
+                                     llvm::ConstantAggregateZero::get(type), "__ispc_instrument_sites");
+    }
+    return llvm::ConstantExpr::getBitCast(instrumentationTable, LLVMTypes::Int8PointerType);
+}
+
+// The state of the lane profiler is a thread-local variable of the type
+//
+//   struct ISPCLaneProfileState {
+//       const struct ISPCInstrumentSites *sites;
+//       uint32_t id;
+//       uint64_t mask;
+//   };
+//
+// which holds the last instrumentation site the thread passed and the mask
+// at it.  The profiler reads it when it samples the thread.
+llvm::GlobalVariable *Module::GetLaneProfileState() {
+    if (laneProfileState == nullptr) {
+        llvm::StructType *type = llvm::StructType::get(
+            *g->ctx, {LLVMTypes::Int8PointerType, LLVMTypes::Int32Type, LLVMTypes::Int64Type});
+        laneProfileState = new llvm::GlobalVariable(*module, type, false /* not const */,
+                                                    llvm::GlobalValue::ExternalLinkage, nullptr,
+                                                    "__ispc_lane_profile_state", nullptr,
+                                                    llvm::GlobalValue::GeneralDynamicTLSModel);
+    }
+    return laneProfileState;
+}
+
+void Module::finalizeInstrumentationTable() {
+    if (instrumentationTable == nullptr) {
+        return;
+    }
+
+    // The file names and the function names repeat, so the strings are shared.
+    std::map<std::string, llvm::Constant *> strings;
+    auto getString = [&](const std::string &s) {
+        llvm::Constant *&str = strings[s];
+        if (str == nullptr) {
+            llvm::Constant *init = llvm::ConstantDataArray::getString(*g->ctx, s, true /* AddNull */);
+            auto *gv = new llvm::GlobalVariable(*module, init->getType(), true /* const */,
+                                                llvm::GlobalValue::PrivateLinkage, init, "__ispc_instrument_str");
+            gv->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+            llvm::Constant *indices[2] = {LLVMInt32(0), LLVMInt32(0)};
+            str = llvm::ConstantExpr::getInBoundsGetElementPtr(gv->getValueType(), gv, indices);
+        }
+        return str;
+    };
+
+    llvm::StructType *siteType = llvm::StructType::get(
+        *g->ctx, {LLVMTypes::Int8PointerType, LLVMTypes::Int8PointerType, LLVMTypes::Int8PointerType,
+                  LLVMTypes::Int32Type});
+    std::vector<llvm::Constant *> sites;
+    for (const InstrumentationSite &site : instrumentationSites) {
+        sites.push_back(llvm::ConstantStruct::get(
+            siteType, {getString(site.file), getString(site.function), getString(site.note), LLVMInt32(site.line)}));
+    }
+    llvm::ArrayType *sitesType = llvm::ArrayType::get(siteType, sites.size());
+    auto *sitesArray =
+        new llvm::GlobalVariable(*module, sitesType, true /* const */, llvm::GlobalValue::InternalLinkage,
+                                 llvm::ConstantArray::get(sitesType, sites), "__ispc_instrument_site");
+
+    instrumentationTable->setInitializer(llvm::ConstantStruct::get(
+        lInstrumentationTableType(),
+        {LLVMInt32(static_cast<int32_t>(sites.size())),
+         llvm::ConstantExpr::getBitCast(sitesArray, LLVMTypes::Int8PointerType)}));
+}
+
 void Module::AddTypeDef(const std::string &name, const Type *type, SourcePos pos) {
     // Typedefs are easy; just add the mapping between the given name and
     // the given type.
@@ -637,10 +985,12 @@ Expr *lConvertExprListToConstExpr(Expr *initExpr, const Type *type, const std::s
     return nullptr;
 }
 
-void Module::AddGlobalVariable(Declarator *decl, bool isConst) {
+void Module::AddGlobalVariable(Declarator *decl, bool isConst, bool isConstexpr) {
     const std::string &name = decl->name;
     const Type *type = decl->type;
     Expr *initExpr = decl->initExpr;
+    // A declaration in a function body makes its AST visible to the others.
+    BookKeeper::in().pinCurrentArena();
     StorageClass storageClass = decl->storageClass;
     SourcePos pos = decl->pos;
 
@@ -682,11 +1032,28 @@ void Module::AddGlobalVariable(Declarator *decl, bool isConst) {
         return;
     }
 
+    if (storageClass == SC_TASK_SHARED) {
+        Error(pos, "\"task_shared\" variable \"%s\" must be declared inside a task function.", name.c_str());
+        return;
+    }
+
     if (type->IsVoidType()) {
         Error(pos, "\"void\" type global variable is illegal.");
         return;
     }
 
+    if (storageClass == SC_SPECCONST) {
+        if (!type->IsAtomicType() || !type->IsUniformType() || !type->IsNumericType()) {
+            Error(pos, "\"specconst\" variable \"%s\" must have a uniform integer or floating-point type.",
+                  name.c_str());
+            return;
+        }
+        if (initExpr == nullptr) {
+            Error(pos, "Missing default value for \"specconst\" variable \"%s\".", name.c_str());
+            return;
+        }
+    }
+
     type = ArrayType::SizeUnsizedArrays(type, initExpr);
     if (type == nullptr) {
         return;
@@ -714,8 +1081,21 @@ void Module::AddGlobalVariable(Declarator *decl, bool isConst) {
             Error(pos, "Initializer can't be provided with \"extern\" global variable \"%s\".", name.c_str());
         }
     } else {
+        if (isConstexpr && initExpr == nullptr) {
+            Error(pos, "Missing initializer for constexpr variable \"%s\".", name.c_str());
+        }
         if (initExpr != nullptr) {
             initExpr = TypeCheck(initExpr);
+            // The calls of constexpr functions that return structs and
+            // arrays aren't folded by Optimize(), so they are turned into
+            // initializer lists here.
+            if (FunctionCallExpr *call = llvm::dyn_cast_or_null<FunctionCallExpr>(initExpr)) {
+                if (Expr *value = EvaluateConstexprCall(call, isConstexpr)) {
+                    initExpr = value;
+                } else if (isConstexpr) {
+                    initExpr = nullptr;
+                }
+            }
             if (initExpr != nullptr) {
                 // We need to make sure the initializer expression is
                 // the same type as the global.
@@ -817,16 +1197,33 @@ void Module::AddGlobalVariable(Declarator *decl, bool isConst) {
         sym = new Symbol(name, pos, Symbol::SymbolKind::Variable, type, storageClass);
         symbolTable->AddVariable(sym);
     }
-    sym->constValue = constValue;
+    // On Xe, the value of a "specconst" variable is set when the module is
+    // loaded, so it isn't folded here; the loads of the variable are turned
+    // into SPIR-V specialization constants by XeSpecConstants.  Elsewhere,
+    // it's a constant with its default value.
+    bool isSpecConst = storageClass == SC_SPECCONST && g->target->isXeTarget();
+    sym->constValue = isSpecConst ? nullptr : constValue;
 
-    llvm::GlobalValue::LinkageTypes linkage =
-        (sym->storageClass == SC_STATIC) ? llvm::GlobalValue::InternalLinkage : llvm::GlobalValue::ExternalLinkage;
+    llvm::GlobalValue::LinkageTypes linkage = (sym->storageClass == SC_STATIC || isSpecConst)
+                                                  ? llvm::GlobalValue::InternalLinkage
+                                                  : llvm::GlobalValue::ExternalLinkage;
 
     // Note that the nullptr llvmInitializer is what leads to "extern"
     // declarations coming up extern and not defining storage (a bit
     // subtle)...
-    sym->storageInfo = new AddressInfo(
-        new llvm::GlobalVariable(*module, llvmType, isConst, linkage, llvmInitializer, sym->name.c_str()), llvmType);
+    llvm::GlobalVariable *gv = new llvm::GlobalVariable(*module, llvmType, isConst && !isSpecConst, linkage,
+                                                        llvmInitializer, sym->name.c_str());
+    sym->storageInfo = new AddressInfo(gv, llvmType);
+
+    // The IDs of the specialization constants are the indices of the
+    // variables in specConstants, they're written to the header.
+    if (storageClass == SC_SPECCONST) {
+        if (isSpecConst) {
+            llvm::Constant *id = LLVMInt32((int32_t)specConstants.size());
+            gv->setMetadata("ispc.specconst", llvm::MDNode::get(*g->ctx, llvm::ConstantAsMetadata::get(id)));
+        }
+        specConstants.push_back(sym);
+    }
 
     // Patch up any references to the previous GlobalVariable (e.g. from a
     // declaration of a global that was later defined.)
@@ -981,6 +1378,59 @@ static void lCheckForStructParameters(const FunctionType *ftype, SourcePos pos)
     }
 }
 
+/** Applies the "optimize" attribute of a function: a comma-separated list
+    of "O0", "O1" or "O2" and of "fast-math", "fma" and "unroll-loops",
+    each optionally prefixed with "no-", which override the options given on
+    the command line for the function.  The settings are kept in "ispc-*"
+    string attributes of the LLVM function, which Opt::ForFunction() reads;
+    the lower optimization levels are also mapped to the "optnone" and
+    "optsize" attributes, so that the LLVM passes and the code generator
+    honor them. */
+static void lSetOptimizeAttributes(llvm::Function *function, const std::string &settings, const std::string &name,
+                                   bool isInline, SourcePos pos) {
+    std::stringstream stream(settings);
+    std::string setting;
+    while (std::getline(stream, setting, ',')) {
+        setting.erase(0, setting.find_first_not_of(" \t"));
+        setting.erase(setting.find_last_not_of(" \t") + 1);
+        bool enable = true;
+        std::string option = setting;
+        if (option.compare(0, 3, "no-") == 0) {
+            enable = false;
+            option = option.substr(3);
+        }
+        if (option == "fast-math" || option == "fma" || option == "unroll-loops") {
+            function->addFnAttr("ispc-" + option, enable ? "true" : "false");
+        } else if (setting == "O0" || setting == "O1" || setting == "O2") {
+            int level = setting[1] - '0';
+            if (level > g->opt.level) {
+                Warning(pos,
+                        "Optimization level \"%s\" of function \"%s\" is ignored, as the module is compiled "
+                        "with -O%d.",
+                        setting.c_str(), name.c_str(), g->opt.level);
+            } else if (level == 0 && g->target->isXeTarget()) {
+                Warning(pos, "Optimization level \"O0\" of function \"%s\" is ignored for Xe targets.", name.c_str());
+            } else if (level == 0 && isInline) {
+                Error(pos, "Illegal to use optimization level \"O0\" with \"inline\" qualifier on function \"%s\".",
+                      name.c_str());
+            } else if (level < g->opt.level) {
+                function->addFnAttr("ispc-opt-level", std::to_string(level));
+                if (level == 0) {
+                    // The ispc passes that lower the code to something that
+                    // can run are required, so they still run on it.
+                    function->addFnAttr(llvm::Attribute::OptimizeNone);
+                    function->addFnAttr(llvm::Attribute::NoInline);
+                } else {
+                    function->addFnAttr(llvm::Attribute::OptimizeForSize);
+                }
+            }
+        } else {
+            Error(pos, "Unknown setting \"%s\" in \"optimize\" attribute of function \"%s\".", setting.c_str(),
+                  name.c_str());
+        }
+    }
+}
+
 /** We've got a declaration for a function to process.  This function does
     all the work of creating the corresponding llvm::Function instance,
     adding the symbol for the function to the symbol table and doing
@@ -990,6 +1440,19 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
                                     StorageClass storageClass, Declarator *decl, bool isInline, bool isNoInline,
                                     bool isVectorCall, bool isRegCall, SourcePos pos) {
     Assert(functionType != nullptr);
+    // The default values of the parameters of a function declared in a
+    // function body are in the arena of that function.
+    BookKeeper::in().pinCurrentArena();
+
+    if (storageClass == SC_TASK_SHARED) {
+        Error(pos, "\"task_shared\" qualifier can only be used for variables.");
+        return;
+    }
+
+    if (storageClass == SC_SPECCONST) {
+        Error(pos, "\"specconst\" qualifier can only be used for variables.");
+        return;
+    }
 
     // If a global variable with the same name has already been declared
     // issue an error.
@@ -1147,6 +1610,22 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
                 Error(pos, "Unknown memory attribute \"%s\".", memory.c_str());
             }
         }
+        if (al->HasAttribute("optimize")) {
+            lSetOptimizeAttributes(function, al->GetAttribute("optimize")->arg.stringVal, name, isInline, pos);
+        }
+        // The batch entry point of the function is emitted with its exported
+        // version, see lEmitBatchFunction().
+        if (al->HasAttribute("batch")) {
+            if (!functionType->isExported) {
+                Error(pos, "The \"batch\" attribute is only supported for exported functions.");
+            } else if (!functionType->GetReturnType()->IsVoidType()) {
+                Error(pos, "Exported function \"%s\" with the \"batch\" attribute must return void.", name.c_str());
+            } else if (g->target->isXeTarget()) {
+                Warning(pos, "Ignoring the \"batch\" attribute of function \"%s\" for Xe targets.", name.c_str());
+            } else {
+                function->addFnAttr("ispc-batch");
+            }
+        }
     }
 
     if (functionType->isTask) {
@@ -1169,7 +1648,19 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
     }
 
     if (functionType->isTask && functionType->GetReturnType()->IsVoidType() == false) {
-        Error(pos, "Task-qualified functions must have void return type.");
+        // On CPU targets the tasks may return a uniform number, which is
+        // combined with the results of the other tasks by the "reduce"
+        // clause of their launch.
+        const Type *returnType = functionType->GetReturnType();
+        const AtomicType *atomicType = CastType<AtomicType>(returnType);
+        if (g->target->isXeTarget()) {
+            Error(pos, "Task-qualified functions must have void return type.");
+        } else if (atomicType == nullptr || !atomicType->IsUniformType() || !atomicType->IsNumericType()) {
+            Error(pos,
+                  "Task-qualified functions must have void or uniform numeric return type, "
+                  "not \"%s\".",
+                  returnType->GetString().c_str());
+        }
     }
 
     if (functionType->isExported || functionType->isExternC || functionType->isExternSYCL ||
@@ -1223,6 +1714,22 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
             function->addParamAttr(i, llvm::Attribute::NoAlias);
         }
 
+        // An explicit "restrict" asks for the noalias attribute above, so
+        // report the parameters where it can't be honored.
+        const PointerType *argPtrType = CastType<PointerType>(argType);
+        if (argPtrType != nullptr && argPtrType->IsRestrict()) {
+            if (functionType->isTask) {
+                PerformanceWarning(argPos,
+                                   "\"restrict\" qualifier of parameter \"%s\" of task function \"%s\" is "
+                                   "ignored, as task parameters are passed in memory. Pass the pointer on to a "
+                                   "non-task function to have it treated as not aliased.",
+                                   argName.c_str(), name.c_str());
+            } else if (!argType->IsUniformType() || argPtrType->IsSlice() || functionType->isExternSYCL) {
+                PerformanceWarning(argPos, "\"restrict\" qualifier of parameter \"%s\" is ignored for \"%s\".",
+                                   argName.c_str(), argType->GetString().c_str());
+            }
+        }
+
         Assert(decl && decl->functionParams.size() == nArgs);
         DeclSpecs *declSpecs = decl->functionParams[i]->declSpecs;
         AttributeList *attrList = declSpecs ? declSpecs->attributeList : nullptr;
@@ -1284,7 +1791,10 @@ void Module::AddFunctionDeclaration(const std::string &name, const FunctionType
     Assert(ok);
 }
 
-void Module::AddFunctionDefinition(const std::string &name, const FunctionType *type, Stmt *code) {
+void Module::AddFunctionDefinition(const std::string &name, const FunctionType *type, Stmt *code,
+                                   const std::vector<FunctionSpecialization> &specializations,
+                                   const FunctionTargets &targets, const FunctionNarrowing &narrowing,
+                                   bool isConstexpr) {
     Symbol *sym = symbolTable->LookupFunction(name.c_str(), type);
     if (sym == nullptr || code == nullptr) {
         Assert(m->errorCount > 0);
@@ -1300,7 +1810,7 @@ void Module::AddFunctionDefinition(const std::string &name, const FunctionType *
     // include the names in FunctionType...
     sym->type = type;
 
-    ast->AddFunction(sym, code);
+    ast->AddFunction(sym, code, specializations, targets, narrowing, isConstexpr);
 }
 
 //
@@ -1605,6 +2115,9 @@ bool Module::writeOutput(OutputType outputType, OutputFlags flags, const char *o
 
     lReportInvalidSuffixWarning(outFileName, outputType);
 
+    // Generation of object files and assembly is reported as "backend" phase.
+    TimeReportScope TimeReport((outputType == Asm || outputType == Object) ? nullptr : "write_output");
+
     switch (outputType) {
     case Asm:
     case Object:
@@ -1661,7 +2174,17 @@ bool Module::writeBitcode(llvm::Module *module, const char *outFileName, OutputT
     }
 
     llvm::raw_fd_ostream fos(fd, (fd != 1), false);
-    if (outputType == Bitcode) {
+    if (outputType == Bitcode && g->emitThinLTO) {
+        // Write the module summary and the module hash like Clang does with
+        // -flto=thin, so that the linker's ThinLTO can import and inline the
+        // functions of the module into the application.
+        if (!module->getModuleFlag("EnableSplitLTOUnit")) {
+            module->addModuleFlag(llvm::Module::Error, "EnableSplitLTOUnit", uint32_t(0));
+        }
+        llvm::ProfileSummaryInfo PSI(*module);
+        llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(*module, nullptr, &PSI);
+        llvm::WriteBitcodeToFile(*module, fos, false, &index, true);
+    } else if (outputType == Bitcode) {
         llvm::WriteBitcodeToFile(*module, fos);
     } else if (outputType == BitcodeText) {
         module->print(fos, nullptr);
@@ -1692,6 +2215,104 @@ std::unique_ptr<llvm::Module> Module::translateFromSPIRV(std::ifstream &is) {
     return std::unique_ptr<llvm::Module>(m);
 }
 
+// The stack usage of a function is unknown if it is recursive, has allocas
+// of dynamic size, or calls a function indirectly or a function that isn't
+// defined in the module (other than the intrinsics and SPIR-V builtins).
+static constexpr uint64_t UnknownStackSize = std::numeric_limits<uint64_t>::max();
+
+// Return an upper bound of the private stack used by the function and the
+// functions that it calls.  A stack call may save the whole register file on
+// the stack, so this is added for each call of a function, which isn't
+// inlined; it makes the bound loose for such calls, but the kernels without
+// them only need the memory of their allocas.
+static uint64_t lGetXeStackSize(const llvm::Function *F, std::map<const llvm::Function *, uint64_t> &sizes,
+                                uint64_t callOverhead) {
+    auto iter = sizes.find(F);
+    if (iter != sizes.end()) {
+        return iter->second;
+    }
+    // Mark the function as visited, so recursion makes the size unknown.
+    sizes[F] = UnknownStackSize;
+
+    const llvm::DataLayout &DL = F->getParent()->getDataLayout();
+    uint64_t frameSize = 0, calleesSize = 0;
+    for (const llvm::Instruction &I : llvm::instructions(F)) {
+        if (const llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(&I)) {
+            auto sizeInBits = alloca->getAllocationSizeInBits(DL);
+            if (!sizeInBits || sizeInBits->isScalable()) {
+                return UnknownStackSize;
+            }
+            frameSize = llvm::alignTo(frameSize, alloca->getAlign()) + sizeInBits->getFixedValue() / 8;
+        } else if (const llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(&I)) {
+            const llvm::Function *callee = call->getCalledFunction();
+            if (callee == nullptr) {
+                return UnknownStackSize;
+            }
+            if (callee->isDeclaration()) {
+                if (!callee->isIntrinsic() && !callee->getName().contains("__spirv_")) {
+                    return UnknownStackSize;
+                }
+                continue;
+            }
+            uint64_t calleeSize = lGetXeStackSize(callee, sizes, callOverhead);
+            if (calleeSize == UnknownStackSize) {
+                return UnknownStackSize;
+            }
+            calleesSize = std::max(calleesSize, calleeSize + callOverhead);
+        }
+    }
+    sizes[F] = frameSize + calleesSize;
+    return sizes[F];
+}
+
+// Compute the private stack size needed by each kernel of the module, where
+// it is known, and embed it into the module as the constant global variable
+// "__ispc_stack_size_<kernel>", which ISPCRT looks for in the SPIR-V module
+// to set the stack size of the module when it isn't set by the user.
+// Return the largest of the sizes, or 0 if the size of any kernel is
+// unknown.
+static uint64_t lEmbedXeStackSizes(llvm::Module *module) {
+    // The number of GRF registers is 256 at most.
+    const uint64_t grfSize = g->target != nullptr ? g->target->getXeGrfSize() : 64;
+    const uint64_t callOverhead = 256 * grfSize;
+    std::map<const llvm::Function *, uint64_t> sizes;
+    uint64_t maxSize = 0;
+    llvm::Type *int32Type = llvm::Type::getInt32Ty(module->getContext());
+    for (const llvm::Function &F : module->functions()) {
+        if (F.isDeclaration() || F.getCallingConv() != llvm::CallingConv::SPIR_KERNEL) {
+            continue;
+        }
+        std::string name = "__ispc_stack_size_" + F.getName().str();
+        uint64_t size = lGetXeStackSize(&F, sizes, callOverhead);
+        if (size == UnknownStackSize || size > std::numeric_limits<uint32_t>::max()) {
+            // The kernels of the module linked with "ispc link" may already
+            // have a size, which doesn't hold anymore.
+            if (llvm::GlobalVariable *gv = module->getGlobalVariable(name)) {
+                gv->eraseFromParent();
+            }
+            maxSize = UnknownStackSize;
+            continue;
+        }
+        // The stack size is set in bytes and 0 means the default size, so it
+        // is rounded up to a non-zero multiple of the GRF size.
+        size = std::max(llvm::alignTo(size, grfSize), grfSize);
+        if (maxSize != UnknownStackSize) {
+            maxSize = std::max(maxSize, size);
+        }
+
+        llvm::Constant *init = llvm::ConstantInt::get(int32Type, size);
+        llvm::GlobalVariable *gv = module->getGlobalVariable(name);
+        if (gv == nullptr) {
+            gv = new llvm::GlobalVariable(*module, int32Type, true, llvm::GlobalValue::ExternalLinkage, init, name,
+                                          nullptr, llvm::GlobalValue::NotThreadLocal,
+                                          (unsigned)AddressSpace::ispc_constant);
+        } else {
+            gv->setInitializer(init);
+        }
+    }
+    return maxSize == UnknownStackSize ? 0 : maxSize;
+}
+
 bool Module::translateToSPIRV(llvm::Module *module, std::stringstream &ss) {
     std::string err;
     SPIRV::TranslatorOpts Opts;
@@ -1710,6 +2331,7 @@ bool Module::translateToSPIRV(llvm::Module *module, std::stringstream &ss) {
 }
 
 bool Module::writeSPIRV(llvm::Module *module, const char *outFileName) {
+    lEmbedXeStackSizes(module);
     std::stringstream translatedStream;
     bool success = translateToSPIRV(module, translatedStream);
     if (!success) {
@@ -1751,17 +2373,131 @@ static void saveOutput(uint32_t numOutputs, uint8_t **dataOutputs, uint64_t *len
     oclocRes.assign(binRef.begin(), binRef.end());
 }
 
-bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
-    std::stringstream translatedStream;
-    bool success = translateToSPIRV(module, translatedStream);
-    if (!success) {
-        return false;
+// The resources used by a kernel, as reported in the .ze_info section of
+// the zebin.
+struct XeKernelResources {
+    std::string name;
+    unsigned grfCount = 0;
+    unsigned spillSize = 0;
+    unsigned privateSize = 0;
+    unsigned slmSize = 0;
+};
+
+// Parse the kernels of the YAML document of the .ze_info section.  Only the
+// few keys of interest are read, so a simple line-based parser is enough.
+// The spill and private sizes are given by the execution environment of
+// the kernel in the newer versions of the format and by its per-thread
+// memory buffers in the older ones.
+static std::vector<XeKernelResources> lParseZeInfo(llvm::StringRef zeInfo) {
+    std::vector<XeKernelResources> kernels;
+    bool inKernels = false;
+    bool hasExecEnvSpill = false, hasExecEnvPrivate = false;
+    llvm::StringRef bufferUsage;
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    zeInfo.split(lines, '\n');
+    for (llvm::StringRef line : lines) {
+        size_t indent = line.find_first_not_of(' ');
+        if (indent == llvm::StringRef::npos) {
+            continue;
+        }
+        llvm::StringRef text = line.drop_front(indent).rtrim();
+        if (indent == 0) {
+            inKernels = text == "kernels:";
+            continue;
+        }
+        if (!inKernels) {
+            continue;
+        }
+        if (indent == 2 && text.consume_front("- name:")) {
+            kernels.push_back(XeKernelResources());
+            kernels.back().name = text.trim().trim('\'').str();
+            hasExecEnvSpill = hasExecEnvPrivate = false;
+            continue;
+        }
+        if (kernels.empty()) {
+            continue;
+        }
+        XeKernelResources &kernel = kernels.back();
+        if (text.consume_front("- ")) {
+            bufferUsage = "";
+        }
+        auto [key, value] = text.split(':');
+        value = value.trim();
+        unsigned number = 0;
+        bool isNumber = !value.getAsInteger(10, number);
+        if (key == "grf_count" && isNumber) {
+            kernel.grfCount = number;
+        } else if (key == "slm_size" && isNumber) {
+            kernel.slmSize = number;
+        } else if (key == "spill_size" && isNumber) {
+            kernel.spillSize = number;
+            hasExecEnvSpill = true;
+        } else if (key == "private_size" && isNumber) {
+            kernel.privateSize = number;
+            hasExecEnvPrivate = true;
+        } else if (key == "usage") {
+            bufferUsage = value;
+        } else if (key == "size" && isNumber) {
+            if (bufferUsage == "spill_fill_space" && !hasExecEnvSpill) {
+                kernel.spillSize = number;
+            } else if (bufferUsage == "private_space" && !hasExecEnvPrivate) {
+                kernel.privateSize = number;
+            }
+        }
     }
-    const std::string &translatedStr = translatedStream.str();
-    std::vector<char> spirStr(translatedStr.begin(), translatedStr.end());
+    return kernels;
+}
+
+// Print the resources used by each kernel of the zebin (--resource-report).
+// The device is given for the L0 binaries of the fat binary.
+static void lPrintXeResourceReport(const std::vector<char> &zebin, const std::string &device = "") {
+    llvm::MemoryBufferRef buffer(llvm::StringRef(zebin.data(), zebin.size()), "zebin");
+    auto object = llvm::object::ObjectFile::createELFObjectFile(buffer);
+    if (!object) {
+        llvm::consumeError(object.takeError());
+        Warning(SourcePos(), "Cannot read the resource report from the L0 binary.");
+        return;
+    }
+    llvm::StringRef zeInfo;
+    for (const llvm::object::SectionRef &section : (*object)->sections()) {
+        llvm::Expected<llvm::StringRef> name = section.getName();
+        if (name && *name == ".ze_info") {
+            llvm::Expected<llvm::StringRef> contents = section.getContents();
+            if (contents) {
+                zeInfo = *contents;
+            } else {
+                llvm::consumeError(contents.takeError());
+            }
+            break;
+        } else if (!name) {
+            llvm::consumeError(name.takeError());
+        }
+    }
+    if (zeInfo.empty()) {
+        Warning(SourcePos(), "The L0 binary has no .ze_info section, no resource report is available.");
+        return;
+    }
+
+    std::string target = ISPCTargetToString(g->target->getISPCTarget());
+    if (device.empty()) {
+        fprintf(stderr, "Resource report for target %s:\n", target.c_str());
+    } else {
+        fprintf(stderr, "Resource report for target %s, device %s:\n", target.c_str(), device.c_str());
+    }
+    for (const XeKernelResources &kernel : lParseZeInfo(zeInfo)) {
+        fprintf(stderr, "    %s: %u GRF, %u bytes of spills, %u bytes of private memory, %u bytes of SLM\n",
+                kernel.name.c_str(), kernel.grfCount, kernel.spillSize, kernel.privateSize, kernel.slmSize);
+        if (kernel.spillSize > 0) {
+            PerformanceWarning(SourcePos(), "Kernel \"%s\" spills %u bytes of registers.", kernel.name.c_str(),
+                               kernel.spillSize);
+        }
+    }
+}
 
-    const std::string CPUName = g->target->getCPU();
-    const std::string neoCPU = translateCPU(CPUName);
+// Compile the SPIR-V code to the L0 binary for the device with ocloc.
+static bool lCompileWithOcloc(const std::vector<char> &spirStr, const std::string &device, uint64_t stackSize,
+                              std::vector<char> &oclocRes) {
+    const std::string neoCPU = translateCPU(device);
 
     invokePtr invoke;
     freeOutputPtr freeOutput;
@@ -1792,10 +2528,13 @@ bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
     }
 
     // Add stack size info
-    // If stackMemSize has default value 0, do not set -stateless-stack-mem-size,
+    // If stackMemSize has default value 0, the size computed for the kernels
+    // is used.  If it isn't known either, do not set -stateless-stack-mem-size,
     // it will be set to 8192 in VC backend by default.
     if (g->stackMemSize > 0) {
         options.append(" -stateless-stack-mem-size=" + std::to_string(g->stackMemSize));
+    } else if (stackSize > 0) {
+        options.append(" -stateless-stack-mem-size=" + std::to_string(stackSize));
     }
     std::string internalOptions;
 
@@ -1831,30 +2570,142 @@ bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
         return false;
     }
 
-    std::vector<char> oclocRes;
     saveOutput(numOutputs, dataOutputs, lenOutputs, nameOutputs, oclocRes);
     if (freeOutput(&numOutputs, &dataOutputs, &lenOutputs, &nameOutputs)) {
         Error(SourcePos(), "Call to oclocFreeOutput failed \n");
         return false;
     }
+    return true;
+}
+
+// The fat binary (--xe-devices) is the magic "ISPCFAT1", the number of its
+// entries and the entries, each of them the format (0 for SPIR-V, 1 for L0
+// binary), the length and the name of the device (empty for SPIR-V) and the
+// size and the data of the binary. The numbers are little-endian, 32-bit
+// except for the 64-bit size of the binary.
+enum class FatEntryFormat : uint32_t { SPIRV = 0, ZEBIN = 1 };
+
+static void lAppendLE(std::vector<char> &out, uint64_t value, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+static void lAppendFatEntry(std::vector<char> &fat, FatEntryFormat format, const std::string &device,
+                            const std::vector<char> &data) {
+    lAppendLE(fat, static_cast<uint32_t>(format), 4);
+    lAppendLE(fat, device.size(), 4);
+    fat.insert(fat.end(), device.begin(), device.end());
+    lAppendLE(fat, data.size(), 8);
+    fat.insert(fat.end(), data.begin(), data.end());
+}
+
+bool Module::writeZEBin(llvm::Module *module, const char *outFileName) {
+    const uint64_t stackSize = lEmbedXeStackSizes(module);
+    std::stringstream translatedStream;
+    bool success = translateToSPIRV(module, translatedStream);
+    if (!success) {
+        return false;
+    }
+    const std::string &translatedStr = translatedStream.str();
+    std::vector<char> spirStr(translatedStr.begin(), translatedStr.end());
+
+    std::vector<char> output;
+    if (g->xeDevices.empty()) {
+        if (!lCompileWithOcloc(spirStr, g->target->getCPU(), stackSize, output)) {
+            return false;
+        }
+        if (g->resourceReport) {
+            lPrintXeResourceReport(output);
+        }
+    } else {
+        // The L0 binaries come first, ISPCRT uses the first one accepted by
+        // the device and compiles the SPIR-V code if there is none.
+        const char magic[] = "ISPCFAT1";
+        output.assign(magic, magic + 8);
+        lAppendLE(output, g->xeDevices.size() + 1, 4);
+        for (const std::string &device : g->xeDevices) {
+            std::vector<char> zebin;
+            if (!lCompileWithOcloc(spirStr, device, stackSize, zebin)) {
+                return false;
+            }
+            if (g->resourceReport) {
+                lPrintXeResourceReport(zebin, device);
+            }
+            lAppendFatEntry(output, FatEntryFormat::ZEBIN, device, zebin);
+        }
+        lAppendFatEntry(output, FatEntryFormat::SPIRV, "", spirStr);
+    }
 
     if (!strcmp(outFileName, "-")) {
-        std::cout.write(oclocRes.data(), oclocRes.size());
+        std::cout.write(output.data(), output.size());
     } else {
         std::ofstream fos(outFileName, std::ios::binary);
-        fos.write(oclocRes.data(), oclocRes.size());
+        fos.write(output.data(), output.size());
     }
     return true;
 }
 #endif // ISPC_XE_ENABLED
 
+static std::string lGetTargetFileName(const char *outFileName, const std::string &isaString);
+static bool lIsStdout(const char *fileName);
+
+// Generate the code of the module in g->codegenThreads threads (see
+// llvm::splitCodeGen()): the module is split along function boundaries,
+// and each part is compiled in its own LLVM context with its own target
+// machine.  The part i > 0 is written to the file with the "_part<i>"
+// suffix next to outFileName.
+static bool lWriteSplitObjectFiles(llvm::TargetMachine *targetMachine, llvm::Module *module,
+                                   Module::OutputType outputType, const char *outFileName) {
+    TimeReportScope TimeReport("backend");
+
+#if ISPC_LLVM_VERSION > ISPC_LLVM_17_0
+    llvm::CodeGenFileType fileType =
+        (outputType == Module::Object) ? llvm::CodeGenFileType::ObjectFile : llvm::CodeGenFileType::AssemblyFile;
+#else
+    llvm::CodeGenFileType fileType = (outputType == Module::Object) ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
+#endif
+    llvm::sys::fs::OpenFlags flags = (outputType == Module::Object) ? llvm::sys::fs::OF_None : llvm::sys::fs::OF_Text;
+
+    std::vector<std::unique_ptr<llvm::ToolOutputFile>> files;
+    std::vector<llvm::raw_pwrite_stream *> streams;
+    for (int i = 0; i < g->codegenThreads; ++i) {
+        std::string fileName = i == 0 ? outFileName : lGetTargetFileName(outFileName, "part" + std::to_string(i));
+        std::error_code error;
+        files.push_back(std::make_unique<llvm::ToolOutputFile>(fileName, error, flags));
+        if (error) {
+            Error(SourcePos(), "Cannot open output file \"%s\".\n", fileName.c_str());
+            return false;
+        }
+        streams.push_back(&files.back()->os());
+    }
+
+    auto createTargetMachine = [targetMachine]() {
+        return std::unique_ptr<llvm::TargetMachine>(targetMachine->getTarget().createTargetMachine(
+            targetMachine->getTargetTriple().str(), targetMachine->getTargetCPU(),
+            targetMachine->getTargetFeatureString(), targetMachine->Options, targetMachine->getRelocationModel(),
+            targetMachine->getCodeModel(), targetMachine->getOptLevel()));
+    };
+    llvm::splitCodeGen(*module, streams, {}, createTargetMachine, fileType);
+
+    for (auto &file : files) {
+        file->keep();
+    }
+    return true;
+}
+
 bool Module::writeObjectFileOrAssembly(OutputType outputType, const char *outFileName) {
     llvm::TargetMachine *targetMachine = g->target->GetTargetMachine();
+    if (g->codegenThreads > 1 && g->jitObject == nullptr && !lIsStdout(outFileName)) {
+        return lWriteSplitObjectFiles(targetMachine, module, outputType, outFileName);
+    }
     return writeObjectFileOrAssembly(targetMachine, module, outputType, outFileName);
 }
 
 bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm::Module *module, OutputType outputType,
                                        const char *outFileName) {
+    TimeReportScope TimeReport("backend");
+
     // Figure out if we're generating object file or assembly output, and
     // set binary output for object files
 #if ISPC_LLVM_VERSION > ISPC_LLVM_17_0
@@ -1866,6 +2717,18 @@ bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm:
     bool binary = (fileType == llvm::CGFT_ObjectFile);
 
 #endif
+    llvm::legacy::PassManager pm;
+
+    // With the JIT compilation, the object file is emitted to memory.
+    if (g->jitObject != nullptr && binary) {
+        llvm::raw_svector_ostream os(*g->jitObject);
+        if (targetMachine->addPassesToEmitFile(pm, os, nullptr, fileType)) {
+            FATAL("Failed to add passes to emit object file!");
+        }
+        pm.run(*module);
+        return true;
+    }
+
     llvm::sys::fs::OpenFlags flags = binary ? llvm::sys::fs::OF_None : llvm::sys::fs::OF_Text;
 
     std::error_code error;
@@ -1877,8 +2740,6 @@ bool Module::writeObjectFileOrAssembly(llvm::TargetMachine *targetMachine, llvm:
         return false;
     }
 
-    llvm::legacy::PassManager pm;
-
     {
         llvm::raw_fd_ostream &fos(of->os());
         // Third parameter is for generation of .dwo file, which is separate DWARF
@@ -1927,25 +2788,113 @@ static bool lContainsPtrToVarying(const StructType *st) {
     return false;
 }
 
-/** Emits a declaration for the given struct to the given file.  This
-    function first makes sure that declarations for any structs that are
-    (recursively) members of this struct are emitted first.
+/** Returns true if the C++ AoSoA accessors and conversions are emitted for
+    the given soa<N> struct, i.e. if all of its members are atomic types.
  */
-static void lEmitStructDecl(const StructType *st, std::vector<const StructType *> *emittedStructs, FILE *file,
-                            bool emitUnifs = true) {
-
-    // if we're emitting this for a generic dispatch header file and it's
-    // struct that only contains uniforms, don't bother if we're emitting uniforms
-    if (!emitUnifs && !lContainsPtrToVarying(st)) {
-        return;
+static bool lHasAoSoAHelpers(const StructType *st) {
+    if (st->GetSOAWidth() <= 0) {
+        return false;
     }
-
-    // Has this struct type already been declared?  (This happens if it's a
-    // member of another struct for which we emitted a declaration
-    // previously.)
-    for (int i = 0; i < (int)emittedStructs->size(); ++i) {
-        if (Type::EqualIgnoringConst(st, (*emittedStructs)[i])) {
-            return;
+    for (int i = 0; i < st->GetElementCount(); ++i) {
+        if (CastType<AtomicType>(st->GetElementType(i)) == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Emits C++ helpers for the AoSoA layout of the given soa<N> struct: an
+    array of "struct Foo_SOAN" blocks holding N elements each.  There are
+    accessors of a single element as a "struct Foo" and the conversions of
+    whole arrays to and from the AoS layout, which move the members of a
+    block with separate loops, so that the C++ compiler can vectorize them.
+ */
+static void lEmitAoSoAHelpers(const StructType *st, FILE *file) {
+    const int width = st->GetSOAWidth();
+    const std::string aos = st->GetCStructName();
+    const std::string soa = aos + "_SOA" + std::to_string(width);
+
+    fprintf(file, "#if defined(__cplusplus)\n");
+    fprintf(file,
+            "// Number of the blocks of an AoSoA array of \"struct %s\" with count elements.\n"
+            "static inline uint64_t %s_blocks(uint64_t count) { return (count + %d) / %d; }\n",
+            aos.c_str(), soa.c_str(), width - 1, width);
+
+    fprintf(file, "static inline struct %s %s_get(const struct %s *blocks, uint64_t index) {\n", aos.c_str(),
+            soa.c_str(), soa.c_str());
+    fprintf(file, "    const struct %s &block = blocks[index / %d];\n", soa.c_str(), width);
+    fprintf(file, "    const uint64_t lane = index %% %d;\n", width);
+    fprintf(file, "    struct %s value;\n", aos.c_str());
+    for (int i = 0; i < st->GetElementCount(); ++i) {
+        const char *name = st->GetElementName(i).c_str();
+        fprintf(file, "    value.%s = block.%s[lane];\n", name, name);
+    }
+    fprintf(file, "    return value;\n}\n");
+
+    fprintf(file, "static inline void %s_set(struct %s *blocks, uint64_t index, const struct %s &value) {\n",
+            soa.c_str(), soa.c_str(), aos.c_str());
+    fprintf(file, "    struct %s &block = blocks[index / %d];\n", soa.c_str(), width);
+    fprintf(file, "    const uint64_t lane = index %% %d;\n", width);
+    for (int i = 0; i < st->GetElementCount(); ++i) {
+        const char *name = st->GetElementName(i).c_str();
+        fprintf(file, "    block.%s[lane] = value.%s;\n", name, name);
+    }
+    fprintf(file, "}\n");
+
+    // The bulk conversions handle the full blocks member by member and the
+    // elements of the last partial block with the accessors.
+    for (int toSOA = 1; toSOA >= 0; --toSOA) {
+        if (toSOA) {
+            fprintf(file,
+                    "static inline void %s_from_aos(struct %s *blocks, const struct %s *aos, uint64_t count) {\n",
+                    soa.c_str(), soa.c_str(), aos.c_str());
+        } else {
+            fprintf(file, "static inline void %s_to_aos(struct %s *aos, const struct %s *blocks, uint64_t count) {\n",
+                    soa.c_str(), aos.c_str(), soa.c_str());
+        }
+        fprintf(file, "    const uint64_t fullBlocks = count / %d;\n", width);
+        fprintf(file, "    for (uint64_t b = 0; b < fullBlocks; ++b) {\n");
+        for (int i = 0; i < st->GetElementCount(); ++i) {
+            const char *name = st->GetElementName(i).c_str();
+            fprintf(file, "        for (int lane = 0; lane < %d; ++lane) {\n", width);
+            if (toSOA) {
+                fprintf(file, "            blocks[b].%s[lane] = aos[b * %d + lane].%s;\n", name, width, name);
+            } else {
+                fprintf(file, "            aos[b * %d + lane].%s = blocks[b].%s[lane];\n", width, name, name);
+            }
+            fprintf(file, "        }\n");
+        }
+        fprintf(file, "    }\n");
+        fprintf(file, "    for (uint64_t i = fullBlocks * %d; i < count; ++i) {\n", width);
+        if (toSOA) {
+            fprintf(file, "        %s_set(blocks, i, aos[i]);\n", soa.c_str());
+        } else {
+            fprintf(file, "        aos[i] = %s_get(blocks, i);\n", soa.c_str());
+        }
+        fprintf(file, "    }\n}\n");
+    }
+    fprintf(file, "#endif // __cplusplus\n");
+}
+
+/** Emits a declaration for the given struct to the given file.  This
+    function first makes sure that declarations for any structs that are
+    (recursively) members of this struct are emitted first.
+ */
+static void lEmitStructDecl(const StructType *st, std::vector<const StructType *> *emittedStructs, FILE *file,
+                            bool emitUnifs = true) {
+
+    // if we're emitting this for a generic dispatch header file and it's
+    // struct that only contains uniforms, don't bother if we're emitting uniforms
+    if (!emitUnifs && !lContainsPtrToVarying(st)) {
+        return;
+    }
+
+    // Has this struct type already been declared?  (This happens if it's a
+    // member of another struct for which we emitted a declaration
+    // previously.)
+    for (int i = 0; i < (int)emittedStructs->size(); ++i) {
+        if (Type::EqualIgnoringConst(st, (*emittedStructs)[i])) {
+            return;
         }
     }
 
@@ -1956,6 +2905,11 @@ static void lEmitStructDecl(const StructType *st, std::vector<const StructType *
             lEmitStructDecl(elementStructType, emittedStructs, file, emitUnifs);
         }
     }
+    // The AoSoA helpers of a soa<N> struct use the plain struct.
+    const bool aosoaHelpers = emitUnifs && lHasAoSoAHelpers(st);
+    if (aosoaHelpers) {
+        lEmitStructDecl(st->GetAsUniformType(), emittedStructs, file, emitUnifs);
+    }
 
     // And now it's safe to declare this one
     emittedStructs->push_back(st);
@@ -2039,6 +2993,9 @@ static void lEmitStructDecl(const StructType *st, std::vector<const StructType *
         }
     }
     fprintf(file, "};\n");
+    if (aosoaHelpers) {
+        lEmitAoSoAHelpers(st, file);
+    }
     fprintf(file, "#endif\n\n");
 }
 
@@ -2279,6 +3236,31 @@ static bool lIsExternC(const Symbol *sym) {
     return ft->isExternC;
 }
 
+static bool lIsKernel(const Symbol *sym) {
+    const FunctionType *ft = CastType<FunctionType>(sym->type);
+    Assert(ft);
+    return ft->IsISPCKernel();
+}
+
+// Declare the signature of each kernel as a function type in the ispc::kernel
+// namespace, which ispcrt::TypedKernel checks the launch arguments against.
+static void lPrintKernelSignatures(FILE *file, const std::vector<Symbol *> &kernels) {
+    fprintf(file, "#if defined(__cplusplus)
+");
+    fprintf(file, "namespace kernel {
+");
+    for (const Symbol *sym : kernels) {
+        const FunctionType *ftype = CastType<FunctionType>(sym->type);
+        Assert(ftype);
+        fprintf(file, "    typedef %s;
+", ftype->GetDeclaration(sym->name, DeclarationSyntax::CPP).c_str());
+    }
+    fprintf(file, "} /* namespace kernel */
+");
+    fprintf(file, "#endif // __cplusplus
+");
+}
+
 static void lUnescapeStringInPlace(std::string &str) {
     // There are many more escape sequences, but since this is a path,
     // we can get away with only supporting the basic ones (i.e. no
@@ -2672,6 +3654,26 @@ bool Module::writeHostStub(const char *fn) {
     return true;
 }
 
+// Declarations of the instrumentation hook and of the table of the
+// instrumentation sites (see Module::GetInstrumentationTable()). The guard
+// allows including several headers and ispcrt_instrument.h together.
+static void lEmitInstrumentationDecls(FILE *f) {
+    fprintf(f, "#ifndef ISPC_INSTRUMENT_SITES_DEFINED\n"
+               "#define ISPC_INSTRUMENT_SITES_DEFINED\n"
+               "  struct ISPCInstrumentSite {\n"
+               "    const char *file;\n"
+               "    const char *function;\n"
+               "    const char *note;\n"
+               "    int32_t line;\n"
+               "  };\n"
+               "  struct ISPCInstrumentSites {\n"
+               "    uint32_t numSites;\n"
+               "    const struct ISPCInstrumentSite *sites;\n"
+               "  };\n"
+               "#endif // ISPC_INSTRUMENT_SITES_DEFINED\n");
+    fprintf(f, "  void ISPCInstrument(const struct ISPCInstrumentSites *sites, uint32_t id, uint64_t mask);\n");
+}
+
 bool Module::writeHeader(const char *fn) {
     FILE *f = fopen(fn, "w");
     if (!f) {
@@ -2716,7 +3718,7 @@ bool Module::writeHeader(const char *fn) {
         fprintf(f, "#define ISPC_INSTRUMENTATION 1\n");
         fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern \"C\" "
                    "{\n#endif // __cplusplus\n");
-        fprintf(f, "  void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask);\n");
+        lEmitInstrumentationDecls(f);
         fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
                    "extern C */\n#endif // __cplusplus\n");
     }
@@ -2727,9 +3729,10 @@ bool Module::writeHeader(const char *fn) {
 
     // Collect single linear arrays of the exported and extern "C"
     // functions
-    std::vector<Symbol *> exportedFuncs, externCFuncs;
+    std::vector<Symbol *> exportedFuncs, externCFuncs, kernels;
     m->symbolTable->GetMatchingFunctions(lIsExported, &exportedFuncs);
     m->symbolTable->GetMatchingFunctions(lIsExternC, &externCFuncs);
+    m->symbolTable->GetMatchingFunctions(lIsKernel, &kernels);
 
     // Get all of the struct, vector, and enumerant types used as function
     // parameters.  These vectors may have repeats.
@@ -2738,6 +3741,7 @@ bool Module::writeHeader(const char *fn) {
     std::vector<const VectorType *> exportedVectorTypes;
     lGetExportedParamTypes(exportedFuncs, &exportedStructTypes, &exportedEnumTypes, &exportedVectorTypes);
     lGetExportedParamTypes(externCFuncs, &exportedStructTypes, &exportedEnumTypes, &exportedVectorTypes);
+    lGetExportedParamTypes(kernels, &exportedStructTypes, &exportedEnumTypes, &exportedVectorTypes);
 
     // Go through the explicitly exported types
     for (int i = 0; i < (int)exportedTypes.size(); ++i) {
@@ -2766,6 +3770,27 @@ bool Module::writeHeader(const char *fn) {
         lPrintFunctionDeclarations(f, exportedFuncs);
     }
 
+    // ...and the signatures of the kernels on Xe targets
+    if (kernels.size() > 0) {
+        fprintf(f, "\n");
+        fprintf(f, "///////////////////////////////////////////////////////////////////////////\n");
+        fprintf(f, "// Signatures of the kernels\n");
+        fprintf(f, "///////////////////////////////////////////////////////////////////////////\n");
+        lPrintKernelSignatures(f, kernels);
+    }
+
+    // ...and the IDs of the specialization constants, which are set with
+    // ispcrtModuleOptionsSetSpecConstant() on Xe targets
+    if (m->specConstants.size() > 0) {
+        fprintf(f, "\n");
+        fprintf(f, "///////////////////////////////////////////////////////////////////////////\n");
+        fprintf(f, "// IDs of the specialization constants\n");
+        fprintf(f, "///////////////////////////////////////////////////////////////////////////\n");
+        for (size_t i = 0; i < m->specConstants.size(); ++i) {
+            fprintf(f, "static const uint32_t %s_specconst_id = %d;\n", m->specConstants[i]->name.c_str(), (int)i);
+        }
+    }
+
     // end namespace
     fprintf(f, "\n");
     fprintf(f, "\n#ifdef __cplusplus\n} /* namespace */\n#endif // __cplusplus\n");
@@ -2825,7 +3850,7 @@ bool Module::writeDispatchHeader(DispatchHeaderInfo *DHI) {
             fprintf(f, "#define ISPC_INSTRUMENTATION 1\n");
             fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\nextern "
                        "\"C\" {\n#endif // __cplusplus\n");
-            fprintf(f, "  void ISPCInstrument(const char *fn, const char *note, int line, uint64_t mask);\n");
+            lEmitInstrumentationDecls(f);
             fprintf(f, "#if defined(__cplusplus) && (! defined(__ISPC_NO_EXTERN_C) || !__ISPC_NO_EXTERN_C )\n} /* end "
                        "extern C */\n#endif // __cplusplus\n");
         }
@@ -3106,6 +4131,15 @@ static void lSetTargetSpecificMacroDefinitions(const std::shared_ptr<clang::Prep
     if (g->target->hasDotProductVNNI()) {
         opts->addMacroDef("ISPC_TARGET_HAS_DOT_PRODUCT_VNNI");
     }
+    if (g->target->hasAMX()) {
+        opts->addMacroDef("ISPC_TARGET_HAS_AMX");
+    }
+    if (g->target->hasBF16()) {
+        opts->addMacroDef("ISPC_TARGET_HAS_BF16");
+    }
+    if (g->target->hasCRC32()) {
+        opts->addMacroDef("ISPC_TARGET_HAS_CRC32");
+    }
     // TODO! what is the problem to have g->target->hasXePrefetch function returning bool for non XE_ENABLED builds??
 #ifdef ISPC_XE_ENABLED
     if (g->target->hasXePrefetch()) {
@@ -3207,10 +4241,107 @@ static void lSetPreprocessorOptions(const std::shared_ptr<clang::PreprocessorOpt
     }
 }
 
-static void lSetLangOptions(clang::LangOptions *opts) { opts->LineComment = 1; }
+static void lSetLangOptions(clang::LangOptions *opts) {
+    opts->LineComment = 1;
+    // Split the source into the tokens as the lexer of ispc does.
+    opts->Digraphs = 1;
+    opts->DollarIdents = 0;
+}
+
+// File system used by the preprocessor in multi-target compilation.  Every
+// target preprocesses the same source file with the same include paths, so
+// the target-independent part of this work (probing of the include paths
+// and reading of the included files) is done for the first target only and
+// served from memory for the rest of them.  The preprocessing and parsing
+// themselves can't be shared, as their result depends on the target-specific
+// macros (see lSetTargetSpecificMacroDefinitions) and on the target width.
+class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+  public:
+    explicit CachingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs) : ProxyFileSystem(std::move(fs)) {}
+
+    llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override {
+        std::string key = path.str();
+        auto it = m_statuses.find(key);
+        if (it == m_statuses.end()) {
+            it = m_statuses.emplace(key, ProxyFileSystem::status(path)).first;
+        }
+        return it->second;
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine &path) override {
+        std::string key = path.str();
+        auto it = m_files.find(key);
+        if (it == m_files.end()) {
+            auto file = ProxyFileSystem::openFileForRead(path);
+            if (!file) {
+                return file;
+            }
+            auto status = (*file)->status();
+            auto buffer = (*file)->getBuffer(key);
+            if (!status || !buffer) {
+                // Don't cache anything unusual, let the caller deal with it.
+                return ProxyFileSystem::openFileForRead(path);
+            }
+            it = m_files.emplace(key, CachedFile::Entry{*status, std::move(*buffer)}).first;
+        }
+        return std::unique_ptr<llvm::vfs::File>(new CachedFile(it->second));
+    }
+
+  private:
+    class CachedFile : public llvm::vfs::File {
+      public:
+        struct Entry {
+            llvm::vfs::Status status;
+            std::unique_ptr<llvm::MemoryBuffer> buffer;
+        };
+
+        explicit CachedFile(const Entry &entry) : m_entry(entry) {}
+
+        llvm::ErrorOr<llvm::vfs::Status> status() override { return m_entry.status; }
+
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(const llvm::Twine &name, int64_t fileSize,
+                                                                     bool requiresNullTerminator,
+                                                                     bool isVolatile) override {
+            return llvm::MemoryBuffer::getMemBuffer(m_entry.buffer->getMemBufferRef(), requiresNullTerminator);
+        }
+
+        std::error_code close() override { return std::error_code(); }
+
+      private:
+        const Entry &m_entry;
+    };
+
+    std::map<std::string, llvm::ErrorOr<llvm::vfs::Status>> m_statuses;
+    std::map<std::string, CachedFile::Entry> m_files;
+};
+
+static llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> lGetPreprocessorFileSystem() {
+    if (!g->isMultiTargetCompilation) {
+        // Use the default one.
+        return nullptr;
+    }
+    static llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs(new CachingFileSystem(llvm::vfs::getRealFileSystem()));
+    return fs;
+}
 
 int Module::execPreprocessor(const char *infilename, llvm::raw_string_ostream *ostream) const {
-    clang::FrontendInputFile inputFile(infilename, clang::InputKind());
+    return execPreprocessor(infilename, [ostream](clang::Preprocessor &prep) {
+        // Create and initialize PreprocessorOutputOptions
+        clang::PreprocessorOutputOptions preProcOutOpts;
+        lSetPreprocessorOutputOptions(&preProcOutOpts);
+
+        // do actual preprocessing
+        prep.setPreprocessedOutput(preProcOutOpts.ShowCPP);
+        clang::DoPrintPreprocessedInput(prep, ostream, preProcOutOpts);
+    });
+}
+
+int Module::execPreprocessor(const char *infilename, llvm::function_ref<void(clang::Preprocessor &)> action) const {
+    // With the JIT compilation, the source code is preprocessed from memory.
+    clang::FrontendInputFile inputFile =
+        g->jitSource != nullptr
+            ? clang::FrontendInputFile(llvm::MemoryBufferRef(g->jitSource, infilename), clang::InputKind())
+            : clang::FrontendInputFile(infilename, clang::InputKind());
     llvm::raw_fd_ostream stderrRaw(2, false);
 
     // Create Diagnostic engine
@@ -3230,10 +4361,6 @@ int Module::execPreprocessor(const char *infilename, llvm::raw_string_ostream *o
     tgtOpts->Triple = triple.getTriple();
     clang::TargetInfo *tgtInfo = clang::TargetInfo::CreateTargetInfo(diagEng, tgtOpts);
 
-    // Create and initialize PreprocessorOutputOptions
-    clang::PreprocessorOutputOptions preProcOutOpts;
-    lSetPreprocessorOutputOptions(&preProcOutOpts);
-
     // Create and initialize HeaderSearchOptions
     const std::shared_ptr<clang::HeaderSearchOptions> hdrSearchOpts = std::make_shared<clang::HeaderSearchOptions>();
     lSetHeaderSeachOptions(hdrSearchOpts);
@@ -3248,7 +4375,7 @@ int Module::execPreprocessor(const char *infilename, llvm::raw_string_ostream *o
 
     // Create and initialize SourceManager
     clang::FileSystemOptions fsOpts;
-    clang::FileManager fileMgr(fsOpts);
+    clang::FileManager fileMgr(fsOpts, lGetPreprocessorFileSystem());
     clang::SourceManager srcMgr(diagEng, fileMgr);
     lInitializeSourceManager(inputFile, diagEng, fileMgr, srcMgr);
 
@@ -3262,12 +4389,10 @@ int Module::execPreprocessor(const char *infilename, llvm::raw_string_ostream *o
 
     // intialize preprocessor
     prep.Initialize(*tgtInfo);
-    prep.setPreprocessedOutput(preProcOutOpts.ShowCPP);
     lInitializePreprocessor(prep, *preProcOpts, fileMgr, srcMgr);
 
-    // do actual preprocessing
     diagPrinter.BeginSourceFile(langOpts, &prep);
-    clang::DoPrintPreprocessedInput(prep, ostream, preProcOutOpts);
+    action(prep);
     diagPrinter.EndSourceFile();
 
     // deallocate some objects
@@ -3298,6 +4423,48 @@ static std::string lGetTargetFileName(const char *outFileName, const std::string
     return targetOutFileName;
 }
 
+// Write the module going into the optimization to the --capture file, so
+// "ispc-opt --replay" can run the same pipeline on it.  The target, the
+// optimization level and the addressing are recorded in the "ispc.capture"
+// named metadata.  In multi-target compilation every target is written to its
+// own file, like "foo_avx2-i32x8.bc".
+static void lCaptureModule(llvm::Module *module) {
+    std::string targetString = ISPCTargetToString(g->target->getISPCTarget());
+    std::string fileName = g->captureFile;
+    if (g->isMultiTargetCompilation) {
+        fileName = lGetTargetFileName(fileName.c_str(), targetString);
+    }
+
+    std::error_code EC;
+    llvm::raw_fd_ostream os(fileName, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        Error(SourcePos(), "Cannot open capture file \"%s\": %s", fileName.c_str(), EC.message().c_str());
+        return;
+    }
+
+    llvm::LLVMContext &ctx = module->getContext();
+    llvm::NamedMDNode *capture = module->getOrInsertNamedMetadata("ispc.capture");
+    capture->addOperand(llvm::MDNode::get(
+        ctx, {llvm::MDString::get(ctx, targetString), llvm::MDString::get(ctx, std::to_string(g->opt.level)),
+              llvm::MDString::get(ctx, g->opt.force32BitAddressing ? "32" : "64")}));
+    llvm::WriteBitcodeToFile(*module, os);
+    module->eraseNamedMetadata(capture);
+}
+
+// Record the target and the options that the optimization and the code
+// generation of the module depend on in the "ispc.lto" named metadata, for
+// "ispc link --lto", see lOptimizeLinkedModule().
+static void lAddLTOMetadata(llvm::Module *module) {
+    llvm::LLVMContext &ctx = module->getContext();
+    auto str = [&ctx](const std::string &s) -> llvm::Metadata * { return llvm::MDString::get(ctx, s); };
+    module->getOrInsertNamedMetadata("ispc.lto")
+        ->addOperand(llvm::MDNode::get(
+            ctx, {str(ISPCTargetToString(g->target->getISPCTarget())), str(ArchToString(g->target->getArch())),
+                  str(g->target->getCPU()), str(std::to_string((int)g->target->getPICLevel())),
+                  str(std::to_string((int)g->target->getMCModel())), str(std::to_string(g->opt.level)),
+                  str(g->opt.force32BitAddressing ? "32" : "64")}));
+}
+
 static bool lSymbolIsExported(const Symbol *s) { return s->exportedFunction != nullptr; }
 
 // Small structure to hold pointers to the various different versions of a
@@ -3314,6 +4481,7 @@ struct FunctionTargetVariants {
     // compiled to the corresponding target ISA.
     llvm::Function *func[Target::NUM_ISAS];
     const FunctionType *FTs[Target::NUM_ISAS];
+    SourcePos pos;
 };
 
 // Given the symbol table for a module, return a map from function names to
@@ -3326,6 +4494,103 @@ static void lGetExportedFunctions(SymbolTable *symbolTable, std::map<std::string
         FunctionTargetVariants &ftv = functions[syms[i]->name];
         ftv.func[g->target->getISA()] = syms[i]->exportedFunction;
         ftv.FTs[g->target->getISA()] = CastType<FunctionType>(syms[i]->type);
+        ftv.pos = syms[i]->pos;
+    }
+}
+
+// The optimized IR of an exported function and of the functions that it
+// calls for one of the targets of a multi-target compilation.
+struct TargetVariantIR {
+    Target::ISA isa;
+    int nativeVectorWidth;
+    std::string ir;
+};
+
+// Return the text of the IR of the exported function F and of the functions
+// defined in the module that it references, in a form that doesn't depend on
+// the target, which the names of the functions are mangled with, and on the
+// numbering of the attribute groups and the metadata of the module.
+static std::string lGetVariantIR(llvm::Function *F) {
+    std::vector<llvm::Function *> funcs = {F};
+    std::set<llvm::Function *> visited = {F};
+    std::function<void(llvm::Value *)> addReferenced = [&](llvm::Value *v) {
+        if (llvm::Function *callee = llvm::dyn_cast<llvm::Function>(v)) {
+            if (!callee->isDeclaration() && visited.insert(callee).second) {
+                funcs.push_back(callee);
+            }
+        } else if (llvm::isa<llvm::Constant>(v) && !llvm::isa<llvm::GlobalValue>(v)) {
+            for (llvm::Value *op : llvm::cast<llvm::Constant>(v)->operands()) {
+                addReferenced(op);
+            }
+        }
+    };
+    for (size_t i = 0; i < funcs.size(); ++i) {
+        for (llvm::Instruction &inst : llvm::instructions(funcs[i])) {
+            for (llvm::Value *op : inst.operands()) {
+                addReferenced(op);
+            }
+        }
+    }
+    std::sort(funcs.begin() + 1, funcs.end(),
+              [](llvm::Function *a, llvm::Function *b) { return a->getName() < b->getName(); });
+
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    for (llvm::Function *func : funcs) {
+        func->print(os);
+    }
+    os.flush();
+
+    const std::string suffix = std::string("_") + g->target->GetISAString();
+    std::string ir;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty() || line[0] == ';') {
+            continue;
+        }
+        for (size_t i = 0; i < line.size(); ++i) {
+            if ((line[i] == '#' || line[i] == '!') && i + 1 < line.size() && isdigit((unsigned char)line[i + 1])) {
+                ir += line[i];
+                while (i + 1 < line.size() && isdigit((unsigned char)line[i + 1])) {
+                    ++i;
+                }
+            } else if (line.compare(i, suffix.size(), suffix) == 0 &&
+                       (i + suffix.size() == line.size() || !isalnum((unsigned char)line[i + suffix.size()]))) {
+                ir += "_<isa>";
+                i += suffix.size() - 1;
+            } else {
+                ir += line[i];
+            }
+        }
+        ir += '\n';
+    }
+    return ir;
+}
+
+// With --opt=merge-target-variants, remove the exported functions of the
+// module just compiled for the current target, whose IR is the same as the
+// one of a lower target that was compiled before.  The dispatch functions
+// then call these variants on the systems that support the current target.
+// Only the targets with the same native vector width are compared, as the IR
+// is compiled to different code for wider registers.
+static void lMergeTargetVariants(SymbolTable *symbolTable,
+                                 std::map<std::string, std::vector<TargetVariantIR>> &variants) {
+    std::vector<Symbol *> syms;
+    symbolTable->GetMatchingFunctions(lSymbolIsExported, &syms);
+    for (Symbol *sym : syms) {
+        TargetVariantIR variant = {g->target->getISA(), g->target->getNativeVectorWidth(),
+                                   lGetVariantIR(sym->exportedFunction)};
+        std::vector<TargetVariantIR> &compiled = variants[sym->name];
+        bool same = std::any_of(compiled.begin(), compiled.end(), [&variant](const TargetVariantIR &v) {
+            return v.isa < variant.isa && v.nativeVectorWidth == variant.nativeVectorWidth && v.ir == variant.ir;
+        });
+        if (same && sym->exportedFunction->use_empty()) {
+            sym->exportedFunction->eraseFromParent();
+            sym->exportedFunction = nullptr;
+        } else {
+            compiled.push_back(std::move(variant));
+        }
     }
 }
 
@@ -3375,7 +4640,9 @@ static llvm::FunctionType *lGetVaryingDispatchType(FunctionTargetVariants &funcs
 /** Create the dispatch function for an exported ispc function.
     This function checks to see which vector ISAs the system the
     code is running on supports and calls out to the best available
-    variant that was generated at compile time.
+    variant that was generated at compile time.  With --ifunc-dispatch,
+    it creates instead a GNU IFUNC and its resolver, which returns the
+    best available variant.
 
     @param module      Module in which to create the dispatch function.
     @param setISAFunc  Pointer to the __set_system_isa() function defined
@@ -3429,16 +4696,29 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
         g->target->markFuncNameWithRegCallPrefix(functionName);
     }
 
-    // Now we can emit the definition of the dispatch function..
-    llvm::Function *dispatchFunc =
-        llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, functionName.c_str(), module);
-    dispatchFunc->setCallingConv(callingConv);
-    AddUWTableFuncAttr(dispatchFunc);
+    // With --ifunc-dispatch, the exported symbol is a GNU IFUNC, whose
+    // resolver returns the variant to call.  The dynamic loader runs the
+    // resolver once, when the symbol is bound, so the calls of the
+    // function go directly to the variant instead of checking the ISA of
+    // the system every time.
+    llvm::PointerType *ftypePtr = ftype->getPointerTo();
+    llvm::Function *dispatchFunc = nullptr;
+    if (g->ifuncDispatch) {
+        llvm::FunctionType *resolverType = llvm::FunctionType::get(ftypePtr, false);
+        dispatchFunc = llvm::Function::Create(resolverType, llvm::GlobalValue::InternalLinkage,
+                                              functionName + ".resolver", module);
+        llvm::GlobalIFunc::create(ftype, 0, llvm::GlobalValue::ExternalLinkage, functionName, dispatchFunc, module);
+    } else {
+        // Now we can emit the definition of the dispatch function..
+        dispatchFunc = llvm::Function::Create(ftype, llvm::GlobalValue::ExternalLinkage, functionName.c_str(), module);
+        dispatchFunc->setCallingConv(callingConv);
 
-    // Make dispatch function callable from DLLs.
-    if ((g->target_os == TargetOS::windows) && (g->dllExport)) {
-        dispatchFunc->setDLLStorageClass(llvm::GlobalValue::DLLExportStorageClass);
+        // Make dispatch function callable from DLLs.
+        if ((g->target_os == TargetOS::windows) && (g->dllExport)) {
+            dispatchFunc->setDLLStorageClass(llvm::GlobalValue::DLLExportStorageClass);
+        }
     }
+    AddUWTableFuncAttr(dispatchFunc);
     llvm::BasicBlock *bblock = llvm::BasicBlock::Create(*g->ctx, "entry", dispatchFunc);
 
     // Start by calling out to the function that determines the system's
@@ -3453,22 +4733,52 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
     // successfully on the system the code is running on.  In working
     // through the candidate ISAs here backward, we're taking advantage of
     // the expectation that they are ordered in the Target::ISA enumerant
-    // from least to most capable.
+    // from least to most capable.  The exception is AVX10, which comes after
+    // SPR but has no 512-bit vectors: it is tried after the AVX-512 ISAs.
+    std::vector<int> candidates;
     for (int i = Target::NUM_ISAS - 1; i >= 0; --i) {
+        if (i == Target::AVX10) {
+            continue;
+        }
+        candidates.push_back(i);
+        if (i == Target::KNL_AVX512) {
+            candidates.push_back(Target::AVX10);
+        }
+    }
+    for (int i : candidates) {
         if (targetFuncs[i] == nullptr) {
             continue;
         }
 
         // Emit code to see if the system can run the current candidate
         // variant successfully--"is the system's ISA enumerant value >=
-        // the enumerant value of the current candidate?"
-
-        llvm::Value *ok = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA,
-                                                LLVMInt32(i), "isa_ok", bblock);
+        // the enumerant value of the current candidate?"  The CPUs whose
+        // AVX10 is limited to 256-bit vectors can't run the AVX-512 variants,
+        // while SPR runs the AVX10 ones.
+        llvm::Value *ok = nullptr;
+        if (i == Target::AVX10) {
+            ok = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA,
+                                       LLVMInt32(Target::SPR_AVX512), "isa_ok", bblock);
+        } else {
+            ok = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SGE, systemISA, LLVMInt32(i),
+                                       "isa_ok", bblock);
+            if (i >= Target::KNL_AVX512 && i <= Target::SPR_AVX512) {
+                llvm::Value *zmm = llvm::CmpInst::Create(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, systemISA,
+                                                         LLVMInt32(Target::AVX10), "isa_has_zmm", bblock);
+                ok = llvm::BinaryOperator::CreateAnd(ok, zmm, "isa_ok", bblock);
+            }
+        }
         llvm::BasicBlock *callBBlock = llvm::BasicBlock::Create(*g->ctx, "do_call", dispatchFunc);
         llvm::BasicBlock *nextBBlock = llvm::BasicBlock::Create(*g->ctx, "next_try", dispatchFunc);
         llvm::BranchInst::Create(callBBlock, nextBBlock, ok, bblock);
 
+        if (g->ifuncDispatch) {
+            // The resolver just returns the address of the variant.
+            llvm::ReturnInst::Create(*g->ctx, targetFuncs[i], callBBlock);
+            bblock = nextBBlock;
+            continue;
+        }
+
         // Emit the code to make the call call in callBBlock.
         // Just pass through all of the args from the dispatch function to
         // the target-specific function.
@@ -3513,7 +4823,9 @@ static void lCreateDispatchFunction(llvm::Module *module, llvm::Function *setISA
     // Return an undef value from the function here; we won't get to this
     // point at runtime, but LLVM needs all of the basic blocks to be
     // terminated...
-    if (voidReturn) {
+    if (g->ifuncDispatch) {
+        llvm::ReturnInst::Create(*g->ctx, llvm::ConstantPointerNull::get(ftypePtr), bblock);
+    } else if (voidReturn) {
         llvm::ReturnInst::Create(*g->ctx, bblock);
     } else {
         llvm::Value *undefRet = llvm::UndefValue::get(ftype->getReturnType());
@@ -3658,10 +4970,505 @@ static void lExtractOrCheckGlobals(llvm::Module *msrc, llvm::Module *mdst, bool
     }
 }
 
+// Turn definitions of the external globals of the module into declarations,
+// the same way lExtractOrCheckGlobals() does it, but without touching the
+// dispatch module.
+static void lDemoteGlobalsToDeclarations(llvm::Module *module) {
+    for (llvm::GlobalVariable &gv : module->globals()) {
+        if (gv.getLinkage() == llvm::GlobalValue::ExternalLinkage && gv.hasInitializer()) {
+            gv.setInitializer(nullptr);
+        }
+    }
+}
+
+// Prepare the module of a target of multi-target compilation to be linked
+// with the other targets into the single output file (--single-object).  The
+// code generator then takes the CPU and the features from the attributes of
+// the functions, so the ones of the target machine are recorded there.  The
+// definitions, which may be present in the modules of several targets, like
+// the ones of the builtins, are made internal, so that they don't clash.
+static void lPrepareSingleObjectTarget(llvm::Module *module, llvm::TargetMachine *targetMachine) {
+    std::string cpu = targetMachine->getTargetCPU().str();
+    std::string features = targetMachine->getTargetFeatureString().str();
+    for (llvm::Function &F : module->functions()) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        if (!cpu.empty() && !F.hasFnAttribute("target-cpu")) {
+            F.addFnAttr("target-cpu", cpu);
+        }
+        if (!features.empty()) {
+            // The features of the function come last to take precedence.
+            std::string funcFeatures = features;
+            if (F.hasFnAttribute("target-features")) {
+                funcFeatures += "," + F.getFnAttribute("target-features").getValueAsString().str();
+            }
+            F.addFnAttr("target-features", funcFeatures);
+        }
+        if (!F.hasExternalLinkage() && !F.hasLocalLinkage()) {
+            F.setLinkage(llvm::GlobalValue::InternalLinkage);
+            F.setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+            F.setComdat(nullptr);
+        }
+    }
+    for (llvm::GlobalVariable &gv : module->globals()) {
+        if (gv.hasInitializer() && !gv.hasExternalLinkage() && !gv.hasLocalLinkage()) {
+            gv.setLinkage(llvm::GlobalValue::InternalLinkage);
+            gv.setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+            gv.setComdat(nullptr);
+        }
+    }
+}
+
+// A small pool of child processes used to run optimization and code
+// generation of the per-target modules concurrently (--jobs=N).  Each job is
+// forked once the front-end is done with the target, so the child inherits
+// the fully populated Module, Target and LLVMContext and doesn't need any of
+// them to be thread-safe.  The parent keeps the unoptimized module, which is
+// enough to build the header and the dispatch module.
+class TargetJobPool {
+  public:
+    explicit TargetJobPool(int maxJobs) : m_maxJobs(maxJobs) {}
+    ~TargetJobPool() { WaitAll(); }
+
+    TargetJobPool(const TargetJobPool &) = delete;
+    TargetJobPool &operator=(const TargetJobPool &) = delete;
+
+    /** Run the given job in a child process, waiting for a free slot first
+        if needed.  The job is counted as failed if the child process can't
+        be created. */
+    void Launch(const std::function<bool()> &job) {
+#ifndef ISPC_HOST_IS_WINDOWS
+        while (m_running >= m_maxJobs) {
+            waitOne();
+        }
+        // Don't let the child flush the parent's pending stdio buffers.
+        fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            bool ok = job();
+            fflush(nullptr);
+            _exit(ok ? 0 : 1);
+        } else if (pid > 0) {
+            ++m_running;
+            return;
+        }
+        perror("fork");
+#endif
+        Error(SourcePos(), "Failed to start a compilation job. Use --jobs=1 to compile targets sequentially.");
+        ++m_failed;
+    }
+
+    /** Wait for all the running jobs and return the number of failed ones. */
+    int WaitAll() {
+#ifndef ISPC_HOST_IS_WINDOWS
+        while (m_running > 0) {
+            waitOne();
+        }
+#endif
+        return m_failed;
+    }
+
+  private:
+#ifndef ISPC_HOST_IS_WINDOWS
+    void waitOne() {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            // No more children to wait for.
+            m_failed += m_running;
+            m_running = 0;
+            return;
+        }
+        --m_running;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ++m_failed;
+        }
+    }
+#endif
+
+    int m_maxJobs;
+    int m_running{0};
+    int m_failed{0};
+};
+
+static bool lIsStdout(const char *fileName) { return fileName != nullptr && strcmp(fileName, "-") == 0; }
+
+// Check whether the result of the compilation may be taken from (and stored
+// to) the compilation cache. Only compilations, which produce nothing but
+// regular output files, are cached.
+static bool lIsCompilationCacheable(const char *srcFile, Module::OutputFlags &outputFlags,
+                                    Module::OutputType outputType, const char *outFileName,
+                                    const char *headerFileName, const char *depsFileName,
+                                    const char *hostStubFileName, const char *devStubFileName) {
+    if (g->cacheDir.empty() || IsStdin(srcFile) || g->jitSource != nullptr || g->onlyCPP || g->genStdlib ||
+        g->dumpFile || g->enableTimeTrace || !g->captureFile.empty() || !g->debug_stages.empty() ||
+        g->astDump != Globals::ASTDumpKind::None) {
+        return false;
+    }
+    // The additional object files of --codegen-threads aren't known here.
+    if (g->codegenThreads > 1) {
+        return false;
+    }
+    // The dependency information is not cached, it requires the list of
+    // included files, which is available only after the real compilation.
+    if (depsFileName != nullptr || outputFlags.isDepsToStdout()) {
+        return false;
+    }
+    if (lIsStdout(outFileName) || lIsStdout(headerFileName) || lIsStdout(hostStubFileName) ||
+        lIsStdout(devStubFileName)) {
+        return false;
+    }
+    switch (outputType) {
+    case Module::Asm:
+    case Module::Bitcode:
+    case Module::BitcodeText:
+    case Module::Object:
+#ifdef ISPC_XE_ENABLED
+    case Module::ZEBIN:
+    case Module::SPIRV:
+#endif
+        break;
+    default:
+        return false;
+    }
+    return outFileName != nullptr || headerFileName != nullptr || hostStubFileName != nullptr ||
+           devStubFileName != nullptr;
+}
+
+bool Module::computeCacheKey(const char *srcFile, Arch arch, const char *cpu, const std::vector<ISPCTarget> &targets,
+                             OutputFlags &outputFlags, const char *outFileName, const char *headerFileName,
+                             const char *hostStubFileName, const char *devStubFileName, std::string &key,
+                             std::vector<std::string> &files) {
+    llvm::TimeTraceScope TimeScope("ComputeCacheKey");
+    CompilationCache::Key cacheKey;
+    cacheKey.Add(ISPC_VERSION_STRING);
+    cacheKey.Add(clang::getClangToolFullVersion("LLVM"));
+    for (const std::string &arg : g->cacheKeyArgs) {
+        cacheKey.Add(arg);
+    }
+    if (g->generateDebuggingSymbols) {
+        // Debug info refers to the current directory.
+        cacheKey.Add(g->currentDirectory);
+    }
+    if (!g->profileUseFile.empty()) {
+        // So does the generated code to the contents of the profile.
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> profile = llvm::MemoryBuffer::getFile(g->profileUseFile);
+        if (!profile) {
+            return false;
+        }
+        cacheKey.Add((*profile)->getBuffer());
+    }
+
+    std::vector<ISPCTarget> keyTargets = targets;
+    if (keyTargets.empty()) {
+        keyTargets.push_back(ISPCTarget::none);
+    }
+    bool multiTarget = keyTargets.size() > 1;
+    if (outFileName != nullptr) {
+        files.push_back(outFileName);
+    }
+    if (headerFileName != nullptr) {
+        files.push_back(headerFileName);
+    }
+
+    // Preprocessed source differs between targets because of target specific
+    // macros, so the source is preprocessed for every target.  The diagnostics
+    // are reported later by the real compilation, if it happens.
+    bool ignoreCPPErrors = g->ignoreCPPErrors;
+    g->ignoreCPPErrors = true;
+    bool ok = true;
+    for (ISPCTarget target : keyTargets) {
+        g->target = new Target(arch, cpu, target, outputFlags.getPICLevel(), outputFlags.getMCModel(), false);
+        if (!g->target->isValid()) {
+            ok = false;
+        } else {
+            std::string isaName{g->target->GetISAString()};
+            cacheKey.Add(ISPCTargetToString(target));
+            cacheKey.Add(isaName);
+
+            Module *mod = new Module(srcFile);
+            std::string buffer;
+            llvm::raw_string_ostream os(buffer);
+            mod->execPreprocessor(srcFile, &os);
+            os.flush();
+            cacheKey.Add(buffer);
+            delete mod;
+
+            if (multiTarget) {
+                if (outFileName != nullptr && !g->singleObject) {
+                    files.push_back(lGetTargetFileName(outFileName, isaName));
+                }
+                if (headerFileName != nullptr) {
+                    files.push_back(lGetTargetFileName(headerFileName, isaName));
+                }
+            }
+        }
+        delete g->target;
+        g->target = nullptr;
+        if (!ok) {
+            break;
+        }
+    }
+    g->ignoreCPPErrors = ignoreCPPErrors;
+
+    if (!multiTarget) {
+        if (hostStubFileName != nullptr) {
+            files.push_back(hostStubFileName);
+        }
+        if (devStubFileName != nullptr) {
+            files.push_back(devStubFileName);
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+    key = cacheKey.Finalize();
+    return true;
+}
+
+static bool lHasWidthAttribute(const Symbol *s) {
+    const FunctionType *ft = CastType<FunctionType>(s->type);
+    return ft != nullptr && ft->isExported && ft->vectorWidth > 0;
+}
+
+// Return the target of the same family as the given one (e.g. avx512skx)
+// with the given vector width, or ISPCTarget::none if there is none.
+static ISPCTarget lGetTargetWithWidth(ISPCTarget target, int width) {
+    std::string name = ISPCTargetToString(target);
+    std::string family = name.substr(0, name.find('-'));
+    for (const char *lanes : {"-x", "-i32x", "-i16x", "-i8x", "-i64x"}) {
+        ISPCTarget t = ParseISPCTarget(family + lanes + std::to_string(width));
+        if (t != ISPCTarget::error) {
+            return t;
+        }
+    }
+    return ISPCTarget::none;
+}
+
+// Prepare the module compiled for the exported functions of one width to be
+// linked into the module of the target given on the command line: only these
+// exported functions are kept visible, while the global variables are
+// defined by the other module.
+static void lPrepareWidthVariant(llvm::Module *module, SymbolTable *symbolTable) {
+    std::vector<Symbol *> syms;
+    symbolTable->GetMatchingFunctions(lSymbolIsExported, &syms);
+    std::set<llvm::Function *> exported;
+    for (Symbol *sym : syms) {
+        exported.insert(sym->exportedFunction);
+    }
+    for (llvm::Function &F : module->functions()) {
+        if (!F.isDeclaration() && exported.find(&F) == exported.end()) {
+            F.setLinkage(llvm::GlobalValue::InternalLinkage);
+            F.setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+            F.setComdat(nullptr);
+        }
+    }
+    lDemoteGlobalsToDeclarations(module);
+
+    llvm::ModulePassManager mpm;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder pb = llvm::PassBuilder();
+    pb.registerModuleAnalyses(mam);
+    mpm.addPass(llvm::GlobalDCEPass());
+    mpm.run(*module, mam);
+}
+
+// Compile the exported functions of the module, whose "width" attribute
+// differs from the vector width of the target, for the targets of the same
+// family with these widths, and link them into the module.  The whole
+// source file is compiled again for each of the widths.  The narrow versions
+// of the functions with '#pragma ispc narrow' are compiled in the same way
+// and are only called by the dispatch in these functions.
+static int lCompileWidthVariants(Module *mainModule, const char *srcFile, Arch arch, const char *cpu,
+                                 Module::OutputFlags &outputFlags) {
+    std::vector<Symbol *> syms;
+    mainModule->symbolTable->GetMatchingFunctions(lHasWidthAttribute, &syms);
+    std::map<int, SourcePos> widths;
+    for (Symbol *sym : syms) {
+        int width = CastType<FunctionType>(sym->type)->vectorWidth;
+        if (width != g->target->getVectorWidth()) {
+            widths.emplace(width, sym->pos);
+        }
+    }
+    if (mainModule->hasNarrowFunctions) {
+        widths.emplace(FunctionNarrowing::width, mainModule->narrowFunctionPos);
+    }
+
+    if (!widths.empty() && g->emitLTO) {
+        Error(widths.begin()->second, "Functions with another vector width are not supported with --emit-lto.");
+        return 1;
+    }
+
+    Target *mainTarget = g->target;
+    int result = 0;
+    for (const auto &[width, pos] : widths) {
+        ISPCTarget target = lGetTargetWithWidth(mainTarget->getISPCTarget(), width);
+        if (target == ISPCTarget::none) {
+            Error(pos, "There is no target of the family of \"%s\" with vector width %d.",
+                  ISPCTargetToString(mainTarget->getISPCTarget()).c_str(), width);
+            result = 1;
+            break;
+        }
+
+        g->target = new Target(arch, cpu, target, outputFlags.getPICLevel(), outputFlags.getMCModel(), false);
+        if (g->target->isValid()) {
+            g->isWidthVariantCompilation = true;
+            // As for multi-target compilation, the module is kept around,
+            // as its symbols are referenced by the types.
+            m = new Module(srcFile);
+            result = m->CompileFile();
+            g->isWidthVariantCompilation = false;
+            if (result == 0 && m->errorCount == 0) {
+                lPrepareWidthVariant(m->module, m->symbolTable);
+                if (llvm::Linker::linkModules(*mainModule->module, std::unique_ptr<llvm::Module>(m->module))) {
+                    Error(pos, "Failed to link the functions compiled for vector width %d.", width);
+                    result = 1;
+                }
+                m->module = nullptr;
+                for (llvm::Function &F : mainModule->module->functions()) {
+                    llvm::StringRef name = F.getName();
+                    if (!F.isDeclaration() && name.consume_back("___narrow")) {
+                        F.setLinkage(llvm::GlobalValue::InternalLinkage);
+                        F.setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+                    }
+                }
+            } else {
+                result = 1;
+            }
+        } else {
+            result = 1;
+        }
+
+        delete g->target;
+        g->target = mainTarget;
+        m = mainModule;
+        InitLLVMUtil(g->ctx, *g->target);
+        if (result != 0) {
+            break;
+        }
+    }
+    return result;
+}
+
+#ifdef ISPC_XE_ENABLED
+// Append the vector width of the target to the names of the kernels of the
+// module, so that the kernels compiled for several widths can be told apart.
+static void lAddWidthToXeKernelNames(llvm::Module *module, int width) {
+    for (llvm::Function &F : module->functions()) {
+        if (!F.isDeclaration() && F.getCallingConv() == llvm::CallingConv::SPIR_KERNEL) {
+            F.setName(F.getName() + "__x" + llvm::Twine(width));
+        }
+    }
+}
+
+// Prepare the module compiled for another width to be linked into the module
+// of the target given on the command line: only the kernels are kept
+// visible, while the global variables are defined by the other module.
+static void lPrepareXeKernelWidthVariant(llvm::Module *module, int width) {
+    lAddWidthToXeKernelNames(module, width);
+    for (llvm::Function &F : module->functions()) {
+        if (!F.isDeclaration() && F.getCallingConv() != llvm::CallingConv::SPIR_KERNEL) {
+            F.setLinkage(llvm::GlobalValue::InternalLinkage);
+            F.setDLLStorageClass(llvm::GlobalValue::DefaultStorageClass);
+            F.setComdat(nullptr);
+        }
+    }
+    lDemoteGlobalsToDeclarations(module);
+
+    llvm::ModulePassManager mpm;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder pb = llvm::PassBuilder();
+    pb.registerModuleAnalyses(mam);
+    mpm.addPass(llvm::GlobalDCEPass());
+    mpm.run(*module, mam);
+}
+
+// Compile the kernels of the module for the Xe targets of the same family
+// with the widths given with --xe-kernel-widths and link them into the
+// module.  All of the kernels, including the ones of the target given on
+// the command line, get the width appended to their names ("foo__x16"), and
+// ISPCRT selects one of them when the kernel is created.
+static int lCompileXeKernelWidthVariants(Module *mainModule, const char *srcFile, Arch arch, const char *cpu,
+                                         Module::OutputFlags &outputFlags) {
+    Target *mainTarget = g->target;
+    std::set<int> widths(g->xeKernelWidths.begin(), g->xeKernelWidths.end());
+    widths.erase(mainTarget->getVectorWidth());
+    lAddWidthToXeKernelNames(mainModule->module, mainTarget->getVectorWidth());
+
+    int result = 0;
+    for (int width : widths) {
+        ISPCTarget target = lGetTargetWithWidth(mainTarget->getISPCTarget(), width);
+        if (target == ISPCTarget::none) {
+            Error(SourcePos(), "There is no target of the family of \"%s\" with vector width %d.",
+                  ISPCTargetToString(mainTarget->getISPCTarget()).c_str(), width);
+            result = 1;
+            break;
+        }
+
+        g->target = new Target(arch, cpu, target, outputFlags.getPICLevel(), outputFlags.getMCModel(), false);
+        if (g->target->isValid()) {
+            // As for multi-target compilation, the module is kept around,
+            // as its symbols are referenced by the types.
+            m = new Module(srcFile);
+            result = m->CompileFile();
+            if (result == 0 && m->errorCount == 0) {
+                lPrepareXeKernelWidthVariant(m->module, width);
+                if (llvm::Linker::linkModules(*mainModule->module, std::unique_ptr<llvm::Module>(m->module))) {
+                    Error(SourcePos(), "Failed to link the kernels compiled for vector width %d.", width);
+                    result = 1;
+                }
+                m->module = nullptr;
+            } else {
+                result = 1;
+            }
+        } else {
+            result = 1;
+        }
+
+        delete g->target;
+        g->target = mainTarget;
+        m = mainModule;
+        InitLLVMUtil(g->ctx, *g->target);
+        if (result != 0) {
+            break;
+        }
+    }
+    return result;
+}
+#endif
+
 int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, std::vector<ISPCTarget> targets,
                              OutputFlags outputFlags, OutputType outputType, const char *outFileName,
                              const char *headerFileName, const char *depsFileName, const char *depsTargetName,
                              const char *hostStubFileName, const char *devStubFileName) {
+    if (!lIsCompilationCacheable(srcFile, outputFlags, outputType, outFileName, headerFileName, depsFileName,
+                                 hostStubFileName, devStubFileName)) {
+        return compileAndOutput(srcFile, arch, cpu, targets, outputFlags, outputType, outFileName, headerFileName,
+                                depsFileName, depsTargetName, hostStubFileName, devStubFileName);
+    }
+
+    std::string key;
+    std::vector<std::string> files;
+    CompilationCache cache(g->cacheDir);
+    if (computeCacheKey(srcFile, arch, cpu, targets, outputFlags, outFileName, headerFileName, hostStubFileName,
+                        devStubFileName, key, files) &&
+        cache.Restore(key, files)) {
+        return 0;
+    }
+
+    int result = compileAndOutput(srcFile, arch, cpu, targets, outputFlags, outputType, outFileName, headerFileName,
+                                  depsFileName, depsTargetName, hostStubFileName, devStubFileName);
+    if (result == 0 && !key.empty()) {
+        cache.Store(key, files);
+    }
+    return result;
+}
+
+int Module::compileAndOutput(const char *srcFile, Arch arch, const char *cpu, std::vector<ISPCTarget> targets,
+                             OutputFlags outputFlags, OutputType outputType, const char *outFileName,
+                             const char *headerFileName, const char *depsFileName, const char *depsTargetName,
+                             const char *hostStubFileName, const char *devStubFileName) {
     if (targets.size() == 0 || targets.size() == 1) {
         // We're only compiling to a single target
         // TODO something wrong here
@@ -3675,7 +5482,15 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
         }
 
         m = new Module(srcFile);
-        const int compileResult = m->CompileFile();
+        int compileResult = m->CompileFile();
+        if (compileResult == 0 && !g->target->isXeTarget() && !g->onlyCPP) {
+            compileResult = lCompileWidthVariants(m, srcFile, arch, cpu, outputFlags);
+        }
+#ifdef ISPC_XE_ENABLED
+        if (compileResult == 0 && g->target->isXeTarget() && !g->xeKernelWidths.empty() && !g->onlyCPP) {
+            compileResult = lCompileXeKernelWidthVariants(m, srcFile, arch, cpu, outputFlags);
+        }
+#endif
 
         llvm::TimeTraceScope TimeScope("Backend");
 
@@ -3696,7 +5511,7 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                 return 1;
             }
 #endif
-            if (outFileName != nullptr) {
+            if (outFileName != nullptr || g->jitObject != nullptr) {
                 if (!m->writeOutput(outputType, outputFlags, outFileName)) {
                     return 1;
                 }
@@ -3759,6 +5574,10 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                                "an intermediate temporary file.");
             return 1;
         }
+        if (g->jitSource != nullptr) {
+            Error(SourcePos(), "JIT compilation isn't supported when compiling for multiple targets.");
+            return 1;
+        }
         if (cpu != nullptr) {
             Error(SourcePos(), "Illegal to specify cpu type when compiling for multiple targets.");
             return 1;
@@ -3783,6 +5602,7 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
         llvm::Module *dispatchModule = nullptr;
 
         std::map<std::string, FunctionTargetVariants> exportedFunctions;
+        std::map<std::string, std::vector<TargetVariantIR>> variantIRs;
         int errorCount = 0;
 
         // Handle creating a "generic" header file for multiple targets
@@ -3805,6 +5625,21 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             DHI.EmitBackMatter = false;
         }
 
+        // With --single-object, the variants of the targets are written
+        // together with the dispatch module to the output file.
+        const bool singleObject = g->singleObject && outFileName != nullptr &&
+                                  (outputType == Object || outputType == Asm || outputType == Bitcode ||
+                                   outputType == BitcodeText);
+
+        // Optimization and code generation of the targets are offloaded to
+        // child processes if more than one job is requested.
+        const bool parallelJobs = g->numJobs > 1 && !g->onlyCPP;
+        TargetJobPool jobs(g->numJobs);
+        if (parallelJobs && g->opt.mergeTargetVariants) {
+            Warning(SourcePos(), "--opt=merge-target-variants is ignored with --jobs, as the targets are "
+                                 "optimized in separate processes.");
+        }
+
         std::vector<Module *> modules(targets.size());
         for (unsigned int i = 0; i < targets.size(); ++i) {
             g->target =
@@ -3826,11 +5661,32 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
 
             m = new Module(srcFile);
             modules.push_back(m);
-            const int compileResult = m->CompileFile();
+            const int compileResult = m->CompileFile(!parallelJobs);
 
             llvm::TimeTraceScope TimeScope("Backend");
 
             if (compileResult == 0) {
+                if (parallelJobs) {
+                    // The child process gets its own copy of the module with
+                    // the global definitions still in place, so they are
+                    // available to the optimizer.  The job is either run in
+                    // the child or synchronously, so capturing by reference
+                    // is fine here.
+                    jobs.Launch([&]() {
+                        m->OptimizeFile();
+                        if (m->errorCount > 0) {
+                            return false;
+                        }
+                        lDemoteGlobalsToDeclarations(m->module);
+                        if (outFileName != nullptr) {
+                            std::string isaName{g->target->GetISAString()};
+                            std::string targetOutFileName = lGetTargetFileName(outFileName, isaName);
+                            return m->writeOutput(outputType, outputFlags, targetOutFileName.c_str());
+                        }
+                        return true;
+                    });
+                }
+
                 // Create the dispatch module, unless already created;
                 // in the latter case, just do the checking
                 bool check = (dispatchModule != nullptr);
@@ -3839,12 +5695,25 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
                 }
                 lExtractOrCheckGlobals(m->module, dispatchModule, check);
 
+                // The variants are compared after optimization, so this is
+                // only done when the targets are optimized here.
+                if (g->opt.mergeTargetVariants && !parallelJobs) {
+                    lMergeTargetVariants(m->symbolTable, variantIRs);
+                }
+
                 // Grab pointers to the exported functions from the module we
                 // just compiled, for use in generating the dispatch function
                 // later.
                 lGetExportedFunctions(m->symbolTable, exportedFunctions);
 
-                if (outFileName != nullptr) {
+                if (singleObject) {
+                    // The module is linked into the dispatch module once all
+                    // of the targets are compiled.
+                    if (m->diBuilder) {
+                        lStripUnusedDebugInfo(m->module);
+                    }
+                    lPrepareSingleObjectTarget(m->module, g->target->GetTargetMachine());
+                } else if (outFileName != nullptr && !parallelJobs) {
                     std::string targetOutFileName;
                     std::string isaName{g->target->GetISAString()};
                     targetOutFileName = lGetTargetFileName(outFileName, isaName);
@@ -3891,6 +5760,10 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             // we generate the dispatch module's functions...
         }
 
+        if (jobs.WaitAll() > 0) {
+            return 1;
+        }
+
         // Find the first initialized target machine from the targets we
         // compiled to above.  We'll use this as the target machine for
         // compiling the dispatch module--this is safe in that it is the
@@ -3916,9 +5789,22 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             return 1;
         }
 
+        // '#pragma ispc targets' may leave out targets of an exported
+        // function, whose calls are then dispatched to the variant of the
+        // nearest lower target.  There is none for the lowest target.
+        for (const auto &[name, ftv] : exportedFunctions) {
+            if (ftv.func[firstTargetISA] == nullptr) {
+                Error(ftv.pos,
+                      "Exported function \"%s\" must be compiled for the lowest target \"%s\" of the compilation; "
+                      "add it to '#pragma ispc targets'.",
+                      name.c_str(), Target::ISAToString((Target::ISA)firstTargetISA));
+                return 1;
+            }
+        }
+
         lEmitDispatchModule(dispatchModule, exportedFunctions);
 
-        if (outFileName != nullptr) {
+        if (outFileName != nullptr && !singleObject) {
             switch (outputType) {
             case CPPStub:
                 // No preprocessor output for dispatch module.
@@ -3964,9 +5850,37 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
             }
         }
 
+        if (singleObject) {
+            // This is done last, as linking consumes the modules of the
+            // targets, which are still needed above.
+            for (auto module : modules) {
+                if (module == nullptr) {
+                    continue;
+                }
+                bool failed =
+                    llvm::Linker::linkModules(*dispatchModule, std::unique_ptr<llvm::Module>(module->module));
+                module->module = nullptr;
+                if (failed) {
+                    Error(SourcePos(), "Failed to link the targets into the single output file.");
+                    return 1;
+                }
+            }
+            if (llvm::verifyModule(*dispatchModule, &llvm::errs())) {
+                FATAL("Resulting module verification failed!");
+            }
+            lReportInvalidSuffixWarning(outFileName, outputType);
+            bool written = (outputType == Bitcode || outputType == BitcodeText)
+                               ? writeBitcode(dispatchModule, outFileName, outputType)
+                               : writeObjectFileOrAssembly(firstTargetMachine, dispatchModule, outputType, outFileName);
+            if (!written) {
+                return 1;
+            }
+        }
+
         for (auto module : modules) {
             delete module;
         }
+        m = nullptr;
 
         delete g->target;
         g->target = nullptr;
@@ -3975,7 +5889,45 @@ int Module::CompileAndOutput(const char *srcFile, Arch arch, const char *cpu, st
     }
 }
 
-int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName) {
+// Set up the target of the modules compiled with --emit-lto from the
+// "ispc.lto" metadata that they carry, and run the optimization of ispc on
+// the module they are linked to, so that the functions of one of them are
+// inlined into the other ones and optimized in place.
+static bool lOptimizeLinkedModule(llvm::Module *module) {
+    llvm::NamedMDNode *lto = module->getNamedMetadata("ispc.lto");
+    Assert(lto != nullptr && lto->getNumOperands() > 0);
+    // The identical nodes of the inputs are merged by the linker.
+    llvm::MDNode *node = lto->getOperand(0);
+    for (llvm::MDNode *other : lto->operands()) {
+        if (other != node || node->getNumOperands() != 7) {
+            Error(SourcePos(), "The inputs of \"ispc link --lto\" must be compiled for the same target with the "
+                               "same optimization options.");
+            return false;
+        }
+    }
+    auto str = [node](unsigned i) {
+        llvm::MDString *s = llvm::dyn_cast<llvm::MDString>(node->getOperand(i));
+        return s != nullptr ? s->getString().str() : std::string();
+    };
+    std::string cpu = str(2);
+    g->opt.level = std::atoi(str(5).c_str());
+    g->opt.force32BitAddressing = str(6) == "32";
+    g->codegenOptLevel =
+        g->opt.level == 0 ? Globals::CodegenOptLevel::None : Globals::CodegenOptLevel::Aggressive;
+    g->target = new Target(ParseArch(str(1)), cpu.empty() ? nullptr : cpu.c_str(), ParseISPCTarget(str(0)),
+                           (PICLevel)std::atoi(str(3).c_str()), (MCModel)std::atoi(str(4).c_str()), false);
+    if (!g->target->isValid()) {
+        return false;
+    }
+    module->eraseNamedMetadata(lto);
+
+    InitLLVMUtil(g->ctx, *g->target);
+    Optimize(module, g->opt.level);
+    return true;
+}
+
+int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName,
+                          bool lto) {
     auto llvmLink = std::make_unique<llvm::Module>("llvm-link", *g->ctx);
     llvm::Linker linker(*llvmLink);
     for (const auto &file : linkFiles) {
@@ -3998,14 +5950,26 @@ int Module::LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputT
             Error(SourcePos(), "Unrecognized format of input file %s", file.c_str());
             return 1;
         }
-        if (m) {
-            linker.linkInModule(std::move(m), 0);
+        if (m && lto && m->getNamedMetadata("ispc.lto") == nullptr) {
+            Error(SourcePos(), "%s is not compiled with --emit-lto.", file.c_str());
+            return 1;
+        }
+        if (m && linker.linkInModule(std::move(m), 0)) {
+            Error(SourcePos(), "Failed to link %s.", file.c_str());
+            return 1;
         }
         inputStream.close();
     }
+    if (lto && !lOptimizeLinkedModule(llvmLink.get())) {
+        return 1;
+    }
     if (outFileName != nullptr) {
         if ((outputType == Bitcode) || (outputType == BitcodeText)) {
             writeBitcode(llvmLink.get(), outFileName, outputType);
+        } else if (outputType == Object || outputType == Asm) {
+            if (!writeObjectFileOrAssembly(g->target->GetTargetMachine(), llvmLink.get(), outputType, outFileName)) {
+                return 1;
+            }
         }
 #ifdef ISPC_XE_ENABLED
         else if (outputType == SPIRV) {
@@ -4027,14 +5991,3 @@ void Module::initCPPBuffer() {
     bufferCPP.reset(new CPPBuffer{});
 }
 
-void Module::parseCPPBuffer() {
-    YY_BUFFER_STATE strbuf = yy_scan_string(bufferCPP->str.c_str());
-    yyparse();
-    yy_delete_buffer(strbuf);
-}
-
-void Module::clearCPPBuffer() {
-    if (bufferCPP) {
-        bufferCPP.reset();
-    }
-}
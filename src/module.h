@@ -19,6 +19,7 @@
 #include <string>
 
 #include <clang/Frontend/FrontendOptions.h>
+#include <llvm/ADT/STLFunctionalExtras.h>
 #include <llvm/IR/DebugInfo.h>
 
 #include <llvm/Support/TimeProfiler.h>
@@ -31,6 +32,10 @@ namespace llvm {
 class raw_string_ostream;
 }
 
+namespace clang {
+class Preprocessor;
+}
+
 namespace ispc {
 
 struct DispatchHeaderInfo;
@@ -59,14 +64,21 @@ class Module {
 
     /** Compiles the source file passed to the Module constructor, adding
         its global variables and functions to both the llvm::Module and
-        SymbolTable.  Returns the number of errors during compilation.  */
-    int CompileFile();
+        SymbolTable.  If \c optimize is false, the optimization pipeline is
+        not run and it is up to the caller to run it later with
+        OptimizeFile().  Returns the number of errors during compilation.  */
+    int CompileFile(bool optimize = true);
+
+    /** Runs the optimization pipeline over the compiled module. */
+    void OptimizeFile();
 
     /** Add a named type definition to the module. */
     void AddTypeDef(const std::string &name, const Type *type, SourcePos pos);
 
-    /** Add a new global variable corresponding to the decl. */
-    void AddGlobalVariable(Declarator *decl, bool isConst);
+    /** Add a new global variable corresponding to the decl.  The
+        initializer of a "constexpr" variable must be evaluated at compile
+        time. */
+    void AddGlobalVariable(Declarator *decl, bool isConst, bool isConstexpr = false);
 
     /** Add a declaration of the function defined by the given function
         symbol to the module. */
@@ -74,8 +86,13 @@ class Module {
                                 bool isInline, bool isNoInline, bool isVectorCall, bool isRegCall, SourcePos pos);
 
     /** Adds the function described by the declaration information and the
-        provided statements to the module. */
-    void AddFunctionDefinition(const std::string &name, const FunctionType *ftype, Stmt *code);
+        provided statements to the module.  The calls of a function defined
+        with the "constexpr" qualifier are evaluated at compile time when
+        their arguments are constant. */
+    void AddFunctionDefinition(const std::string &name, const FunctionType *ftype, Stmt *code,
+                               const std::vector<FunctionSpecialization> &specializations = {},
+                               const FunctionTargets &targets = {}, const FunctionNarrowing &narrowing = {},
+                               bool isConstexpr = false);
 
     /** Add a declaration of the function template defined by the given function
         symbol to the module. */
@@ -106,6 +123,20 @@ class Module {
         function symbol for it. */
     Symbol *AddLLVMIntrinsicDecl(const std::string &name, ExprList *args, SourcePos po);
 
+    /** Adds a site of --instrument to the table of instrumentation sites
+        of the module and returns its ID, which is its index in the table. */
+    int AddInstrumentationSite(SourcePos pos, const std::string &function, const char *note);
+
+    /** Returns the pointer to the table of instrumentation sites, which is
+        passed to ISPCInstrument().  The table is filled in after the IR of
+        all functions is generated. */
+    llvm::Constant *GetInstrumentationTable();
+
+    /** Returns the thread-local state of the sampling lane profiler, which
+        the code compiled with --lane-profile updates at the instrumentation
+        points.  It's defined in the ispcrt_instrument library. */
+    llvm::GlobalVariable *GetLaneProfileState();
+
     /** Returns pointer to FunctionTemplate based on template name and template argument types provided. Also makes
        template argument types normalization, i.e apply "varying type default":
        template <typename T> void foo(T t);
@@ -222,7 +253,13 @@ class Module {
                                 OutputFlags outputFlags, OutputType outputType, const char *outFileName,
                                 const char *headerFileName, const char *depsFileName, const char *depsTargetName,
                                 const char *hostStubFileName, const char *devStubFileName);
-    static int LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName);
+    /** Link the given bitcode or SPIR-V files and write the result.  With
+        lto, the files have to be compiled with --emit-lto for the same
+        target; the linked module is optimized for it, so that the
+        functions of one file can be inlined into the other ones, and may
+        also be written as an object file or assembly. */
+    static int LinkAndOutput(std::vector<std::string> linkFiles, OutputType outputType, const char *outFileName,
+                             bool lto = false);
 
     /** Total number of errors encountered during compilation. */
     int errorCount{0};
@@ -249,6 +286,16 @@ class Module {
         is handled by lMangleStructName() below. */
     std::map<std::string, llvm::StructType *> structTypeMap;
 
+    /** True if an exported function dispatches to its narrow version with
+        '#pragma ispc narrow', which is compiled with the width variants;
+        narrowFunctionPos is the position of the first of them. */
+    bool hasNarrowFunctions{false};
+    SourcePos narrowFunctionPos;
+
+    /** The "specconst" global variables, the ID of the specialization
+        constant of each is its index. */
+    std::vector<Symbol *> specConstants;
+
   private:
     const char *filename{nullptr};
     AST *ast{nullptr};
@@ -265,6 +312,19 @@ class Module {
 
     std::vector<std::pair<const Type *, SourcePos>> exportedTypes;
 
+    struct InstrumentationSite {
+        std::string file;
+        std::string function;
+        std::string note;
+        int line;
+    };
+    std::vector<InstrumentationSite> instrumentationSites;
+    llvm::GlobalVariable *instrumentationTable{nullptr};
+    llvm::GlobalVariable *laneProfileState{nullptr};
+
+    /** Set the initializer of the table of instrumentation sites. */
+    void finalizeInstrumentationTable();
+
     /** Write the corresponding output type to the given file.  Returns
         true on success, false if there has been an error.  The given
         filename may be nullptr, indicating that output should go to standard
@@ -290,6 +350,19 @@ class Module {
     static bool writeZEBin(llvm::Module *module, const char *outFileName);
 #endif
 
+    static int compileAndOutput(const char *srcFile, Arch arch, const char *cpu, std::vector<ISPCTarget> targets,
+                                OutputFlags outputFlags, OutputType outputType, const char *outFileName,
+                                const char *headerFileName, const char *depsFileName, const char *depsTargetName,
+                                const char *hostStubFileName, const char *devStubFileName);
+
+    /** Compute the compilation cache key for the given compilation and the
+        list of files it produces.  Returns false if the key can't be
+        computed. */
+    static bool computeCacheKey(const char *srcFile, Arch arch, const char *cpu, const std::vector<ISPCTarget> &targets,
+                                OutputFlags &outputFlags, const char *outFileName, const char *headerFileName,
+                                const char *hostStubFileName, const char *devStubFileName, std::string &key,
+                                std::vector<std::string> &files);
+
     int preprocessAndParse();
     int parse();
 
@@ -297,14 +370,13 @@ class Module {
         Returns the number of diagnostic errors encountered. */
     int execPreprocessor(const char *filename, llvm::raw_string_ostream *ostream) const;
 
+    /** Set up the preprocessor for the given file and call the given
+        function, which reads the tokens from it.  Returns the number of
+        diagnostic errors encountered. */
+    int execPreprocessor(const char *filename, llvm::function_ref<void(clang::Preprocessor &)> action) const;
+
     /** Helper function to initialize the internal CPP buffer. **/
     void initCPPBuffer();
-
-    /** Helper function to parse internal CPP buffer. **/
-    void parseCPPBuffer();
-
-    /** Helper function to clean internal CPP buffer. **/
-    void clearCPPBuffer();
 };
 
 } // namespace ispc
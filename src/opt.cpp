@@ -13,7 +13,9 @@
 #include "llvmutil.h"
 #include "module.h"
 #include "opt/ISPCPasses.h"
+#include "pass_stats.h"
 #include "sym.h"
+#include "time_report.h"
 #include "util.h"
 
 #include <map>
@@ -22,7 +24,9 @@
 #include <sstream>
 #include <stdio.h>
 
+#include <llvm/ADT/Any.h>
 #include <llvm/ADT/SmallSet.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/Analysis/BasicAliasAnalysis.h>
 #include <llvm/Analysis/ConstantFolding.h>
 #include <llvm/Analysis/GlobalsModRef.h>
@@ -64,6 +68,8 @@
 #else
 #include <llvm/Transforms/Instrumentation.h>
 #endif
+#include <llvm/Transforms/Instrumentation/InstrProfiling.h>
+#include <llvm/Transforms/Instrumentation/PGOInstrumentation.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/ADCE.h>
 #include <llvm/Transforms/Scalar/CorrelatedValuePropagation.h>
@@ -136,6 +142,53 @@ static std::string getDumpFilePath(std::string className, int pnum) {
     return pathDirFile;
 }
 
+// Returns the registered name of the ISPC pass (used as the phase name in
+// --time-report and in the pass statistics) by its class name, or nullptr for the other passes.
+static const char *lGetISPCPassName(llvm::StringRef className) {
+    static const llvm::StringMap<const char *> names = {
+#define MODULE_PASS(NAME, CREATE_PASS) {decltype(CREATE_PASS)::name(), NAME},
+#define FUNCTION_PASS(NAME, CREATE_PASS) {decltype(CREATE_PASS)::name(), NAME},
+#include "opt/ISPCPassRegistry.def"
+    };
+    auto it = names.find(className);
+    return it != names.end() ? it->second : nullptr;
+}
+
+static void lRegisterTimeReportCallbacks(llvm::PassInstrumentationCallbacks &PIC) {
+    // ISPC passes don't nest, so every pass started here is finished by
+    // one of the callbacks below.
+    PIC.registerBeforeNonSkippedPassCallback([](llvm::StringRef P, llvm::Any IR) {
+        if (const char *name = lGetISPCPassName(P)) {
+            const llvm::Function **F = llvm::any_cast<const llvm::Function *>(&IR);
+            TimeReport::in().Begin(name, F != nullptr ? (*F)->getName() : "");
+        }
+    });
+    PIC.registerAfterPassCallback([](llvm::StringRef P, llvm::Any IR, const llvm::PreservedAnalyses &) {
+        if (lGetISPCPassName(P)) {
+            TimeReport::in().End();
+        }
+    });
+    PIC.registerAfterPassInvalidatedCallback([](llvm::StringRef P, const llvm::PreservedAnalyses &) {
+        if (lGetISPCPassName(P)) {
+            TimeReport::in().End();
+        }
+    });
+}
+
+static void lRegisterPassStatisticsCallbacks(llvm::PassInstrumentationCallbacks &PIC) {
+    // Unlike the time report, all passes are tracked here, including the
+    // pass managers and adaptors, so PassStatistics can tell them apart.
+    PIC.registerBeforeNonSkippedPassCallback([](llvm::StringRef P, llvm::Any IR) {
+        const char *name = lGetISPCPassName(P);
+        PassStatistics::in().Begin(name != nullptr ? llvm::StringRef(name) : P, IR);
+    });
+    PIC.registerAfterPassCallback([](llvm::StringRef P, llvm::Any IR, const llvm::PreservedAnalyses &) {
+        PassStatistics::in().End(&IR);
+    });
+    PIC.registerAfterPassInvalidatedCallback(
+        [](llvm::StringRef P, const llvm::PreservedAnalyses &) { PassStatistics::in().End(nullptr); });
+}
+
 DebugModulePassManager::DebugModulePassManager(llvm::Module &M, int optLevel) : m_passNumber(0), m_optLevel(optLevel) {
     m = &M;
     llvm::Triple targetTriple = llvm::Triple(m->getTargetTriple());
@@ -151,6 +204,12 @@ DebugModulePassManager::DebugModulePassManager(llvm::Module &M, int optLevel) :
         // Enable time traces for optimization passes.
         TimePasses.registerCallbacks(PIC);
     }
+    if (TimeReport::IsEnabled()) {
+        lRegisterTimeReportCallbacks(PIC);
+    }
+    if (PassStatistics::IsEnabled()) {
+        lRegisterPassStatisticsCallbacks(PIC);
+    }
     // Create the new pass manager builder using our target machine.
 #if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
     pb = llvm::PassBuilder(targetMachine, llvm::PipelineTuningOptions(), std::nullopt, &PIC);
@@ -295,7 +354,27 @@ void DebugModulePassManager::commitLoopToFunctionPassManager() {
     m_isLPMOpen = false;
 }
 
+// Returns true if the loop unroller has to run on the module: unless the
+// unrolling is disabled on the command line and not enabled for any function
+// with its "optimize" attribute.
+static bool lUnrollsLoops(const llvm::Module &module) {
+    if (g->opt.unrollLoops) {
+        return true;
+    }
+    for (const llvm::Function &F : module) {
+        if (!F.isDeclaration() && g->opt.ForFunction(&F).unrollLoops) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void ispc::Optimize(llvm::Module *module, int optLevel) {
+    // The Xe targets need the passes that prepare the code for the SPIR-V
+    // translator, which only the full pipeline has.
+    if (optLevel == 1 && g->target->isXeTarget()) {
+        optLevel = 2;
+    }
     if (g->debugPrint) {
         printf("*** Code going into optimization ***\n");
         module->print(llvm::errs(), nullptr);
@@ -312,6 +391,36 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.addModulePass(llvm::VerifierPass(), INIT_OPT_NUMBER);
     }
 
+    // The instrumented code and the code that the profile is used for have
+    // to have the same CFG for the profile to match it, so both are done
+    // before any optimization.  The branch weights and function entry
+    // counts from the profile then guide the inliner, the passes that
+    // use block frequencies, and block placement in the code generator.
+    if (g->profileGenerate) {
+        optPM.addModulePass(llvm::PGOInstrumentationGen());
+        llvm::InstrProfOptions profileOptions;
+        profileOptions.InstrProfileOutput = g->profileGenerateFile;
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
+        optPM.addModulePass(llvm::InstrProfilingLoweringPass(profileOptions, false));
+#else
+        optPM.addModulePass(llvm::InstrProfiling(profileOptions, false));
+#endif
+    } else if (!g->profileUseFile.empty()) {
+        optPM.addModulePass(llvm::PGOInstrumentationUse(g->profileUseFile));
+    }
+
+    // The FMA settings of the functions are applied to their operations
+    // before they are inlined into other functions.
+    optPM.addModulePass(ContractFPOpsPass());
+
+#ifdef ISPC_XE_ENABLED
+    // The "specconst" variables are replaced before the optimizations fold
+    // their default values.
+    if (g->target->isXeTarget()) {
+        optPM.addModulePass(XeSpecConstants());
+    }
+#endif
+
     optPM.initFunctionPassManager();
     optPM.initLoopPassManager();
     optPM.addLoopPass(llvm::IndVarSimplifyPass());
@@ -346,6 +455,10 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.addFunctionPass(IsCompileTimeConstantPass(true));
         optPM.commitFunctionToModulePassManager();
 
+        if (g->optReport || !g->optReportFile.empty()) {
+            optPM.addModulePass(OptReportPass());
+        }
+        optPM.addModulePass(CheckExpectationsPass(false));
         optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
         optPM.addModulePass(RemovePersistentFuncsPass());
 
@@ -368,6 +481,7 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
             optPM.addFunctionPass(llvm::SROAPass());
 #endif
             optPM.addFunctionPass(ReplaceLLVMIntrinsics());
+            optPM.addFunctionPass(XeLowerSLM());
             optPM.addFunctionPass(CheckIRForXeTarget());
             optPM.addFunctionPass(MangleOpenCLBuiltins());
             optPM.commitFunctionToModulePassManager();
@@ -377,7 +491,83 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
             optPM.addModulePass(llvm::GlobalDCEPass());
         }
 #endif
+    } else if (optLevel == 1) {
+        // A fast pipeline: the ispc specific optimizations run once, after
+        // the functions have been inlined into their callers, and only a
+        // small set of LLVM clean-up passes is run around them.
+        optPM.addModulePass(llvm::GlobalDCEPass(), 150);
+
+        optPM.initFunctionPassManager();
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt), 151);
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
+        optPM.addFunctionPass(llvm::SROAPass(llvm::SROAOptions::ModifyCFG));
+#else
+        optPM.addFunctionPass(llvm::SROAPass());
+#endif
+        optPM.addFunctionPass(llvm::EarlyCSEPass());
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
+        optPM.addFunctionPass(llvm::InferAlignmentPass());
+#endif
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        optPM.commitFunctionToModulePassManager();
+
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass(), 155);
+
+        optPM.initFunctionPassManager();
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
+        optPM.addFunctionPass(llvm::SROAPass(llvm::SROAOptions::ModifyCFG), 160);
+#else
+        optPM.addFunctionPass(llvm::SROAPass(), 160);
+#endif
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
+        optPM.addFunctionPass(llvm::InferAlignmentPass());
+#endif
+        optPM.addFunctionPass(llvm::InstCombinePass());
+        if (!g->opt.disableMaskAllOnOptimizations) {
+            optPM.addFunctionPass(IntrinsicsOpt(), 162);
+            optPM.addFunctionPass(InstructionSimplifyPass());
+            optPM.addFunctionPass(MaskDataflowPass());
+        }
+        if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
+            optPM.addFunctionPass(ImproveMemoryOpsPass(), 165);
+            if (g->opt.disableCoalescing == false) {
+                optPM.addFunctionPass(llvm::EarlyCSEPass());
+                optPM.addFunctionPass(GatherCoalescePass());
+                optPM.addFunctionPass(ScatterCoalescePass());
+            }
+            optPM.addFunctionPass(ImproveMemoryOpsPass(true));
+        }
+        if (g->opt.disableHandlePseudoMemoryOps == false) {
+            optPM.addFunctionPass(ReplacePseudoMemoryOpsPass(), 170);
+        }
+        optPM.addFunctionPass(IntrinsicsOpt(), 171);
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        optPM.addFunctionPass(IsCompileTimeConstantPass(true));
+        optPM.commitFunctionToModulePassManager();
+
+        if (g->optReport || !g->optReportFile.empty()) {
+            optPM.addModulePass(OptReportPass());
+        }
+        optPM.addModulePass(CheckExpectationsPass(false));
+        optPM.addModulePass(llvm::ModuleInlinerWrapperPass(), 175);
+        optPM.addModulePass(RemovePersistentFuncsPass());
+
+        optPM.initFunctionPassManager();
+#if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
+        optPM.addFunctionPass(llvm::InferAlignmentPass(), 180);
+        optPM.addFunctionPass(llvm::InstCombinePass());
+#else
+        optPM.addFunctionPass(llvm::InstCombinePass(), 180);
+#endif
+        optPM.addFunctionPass(InstructionSimplifyPass());
+        optPM.addFunctionPass(llvm::SimplifyCFGPass(simplifyCFGopt));
+        optPM.addFunctionPass(llvm::ADCEPass());
+        optPM.commitFunctionToModulePassManager();
+
+        optPM.addModulePass(llvm::StripDeadPrototypesPass());
+        optPM.addModulePass(llvm::GlobalDCEPass());
     } else {
+        const bool invariantDivision = !g->opt.disableInvariantDivision && !g->target->isXeTarget();
         optPM.addModulePass(llvm::GlobalDCEPass(), 184);
 
         optPM.initFunctionPassManager();
@@ -409,6 +599,10 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
             optPM.addFunctionPass(llvm::InstCombinePass(), 210);
             optPM.addFunctionPass(ImproveMemoryOpsPass());
+            if (!g->opt.disableLocalArrayPromotion && !g->target->isXeTarget()) {
+                // Before SROA, which then promotes the arrays.
+                optPM.addFunctionPass(PromoteLocalArraysPass());
+            }
         }
         if (!g->opt.disableMaskAllOnOptimizations) {
             optPM.addFunctionPass(IntrinsicsOpt(), 215);
@@ -498,12 +692,22 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
             optPM.addModulePass(llvm::GlobalDCEPass());
         }
 #endif
+        if (g->opt.maskMultiversioning && !g->target->isXeTarget()) {
+            optPM.addModulePass(MaskMultiversioningPass());
+        }
+        if (g->opt.uniformityInference && g->target->getVectorWidth() > 1) {
+            optPM.addModulePass(UniformityInferencePass());
+        }
         optPM.initFunctionPassManager();
         optPM.addFunctionPass(llvm::TailCallElimPass());
 
         if (!g->opt.disableMaskAllOnOptimizations) {
             optPM.addFunctionPass(IntrinsicsOpt(), 250);
             optPM.addFunctionPass(InstructionSimplifyPass());
+            // The masks of the nested varying control flow are known on
+            // the paths of the branches on them now that the functions
+            // are inlined.
+            optPM.addFunctionPass(MaskDataflowPass());
         }
 
         if (g->opt.disableGatherScatterOptimizations == false && g->target->getVectorWidth() > 1) {
@@ -515,9 +719,15 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
 
             if (g->opt.disableCoalescing == false) {
                 // It is important to run this here to make it easier to
-                // finding matching gathers we can coalesce..
+                // finding matching gathers and scatters we can coalesce..
                 optPM.addFunctionPass(llvm::EarlyCSEPass(), 260);
                 optPM.addFunctionPass(GatherCoalescePass());
+                optPM.addFunctionPass(ScatterCoalescePass());
+            }
+            if (!g->opt.disableMaskedMemOpHoisting) {
+                // While the masked loads are still calls of __masked_load_*()
+                // and before LICM, which moves the rest of the invariant code.
+                optPM.addFunctionPass(HoistMaskedMemOpsPass());
             }
         }
         optPM.commitFunctionToModulePassManager();
@@ -536,7 +746,24 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
             optPM.addFunctionPass(llvm::InferAlignmentPass());
 #endif
             optPM.addFunctionPass(llvm::InstCombinePass(), 270);
-            optPM.addFunctionPass(ImproveMemoryOpsPass());
+            if (g->opt.prefetchDistance > 0) {
+                // This is done before the strided gathers are lowered below,
+                // so that the inserted prefetches are turned into vector
+                // prefetches where they're available.
+                optPM.addFunctionPass(InsertPrefetchesPass());
+            }
+            if (!g->target->isXeTarget()) {
+                // Before the lowering below, so that the vector loads of
+                // the gathers with coherent addresses are improved as well.
+                optPM.addFunctionPass(CoherentGathersPass());
+            }
+            // Gathers with a small constant stride that were not coalesced
+            // are turned into vector loads and shuffles here.
+            optPM.addFunctionPass(ImproveMemoryOpsPass(true));
+            if (!g->opt.disableLocalArrayPromotion && !g->target->isXeTarget()) {
+                // The arrays of the inlined functions.
+                optPM.addFunctionPass(PromoteLocalArraysPass());
+            }
         }
         optPM.commitFunctionToModulePassManager();
         optPM.addModulePass(llvm::IPSCCPPass(), 275);
@@ -557,6 +784,13 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.addFunctionPass(InstructionSimplifyPass());
         optPM.commitFunctionToModulePassManager();
 
+        // The memory operations that are left are reported, and checked
+        // against '#pragma ispc expect_no_*', before the target's
+        // implementations of them are inlined.
+        if (g->optReport || !g->optReportFile.empty()) {
+            optPM.addModulePass(OptReportPass(invariantDivision));
+        }
+        optPM.addModulePass(CheckExpectationsPass(false));
         optPM.addModulePass(llvm::ModuleInlinerWrapperPass());
         // If we didn't decide to inline a function, check to see if we can
         // transform it to pass arguments by value instead of by reference.
@@ -599,6 +833,10 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.commitLoopToFunctionPassManager();
         optPM.setMemorySSA(false);
         optPM.setBlocksFreq(false);
+        if (invariantDivision) {
+            // Once the divisors are hoisted out of the loops by LICM.
+            optPM.addFunctionPass(InvariantDivisionPass());
+        }
 #if ISPC_LLVM_VERSION >= ISPC_LLVM_18_1
         optPM.addFunctionPass(llvm::InferAlignmentPass());
 #endif
@@ -616,8 +854,10 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.addLoopPass(llvm::LoopDeletionPass());
         optPM.commitLoopToFunctionPassManager();
 
-        if (g->opt.unrollLoops) {
+        if (lUnrollsLoops(*module)) {
+            optPM.addFunctionPass(DisableLoopUnrollPass());
             optPM.addFunctionPass(llvm::LoopUnrollPass(), 300);
+            optPM.addFunctionPass(SplitReductionsPass());
         }
         // For Xe targets NewGVN pass produces more efficient code due to better resolving of branches.
         // On CPU targets it is effective in optimizing certain types of code,
@@ -669,6 +909,9 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
             optPM.addFunctionPass(ReplaceLLVMIntrinsics());
         }
 #endif
+        if (g->target->getArch() == Arch::x86 || g->target->getArch() == Arch::x86_64) {
+            optPM.addFunctionPass(StreamingStoresPass());
+        }
 
         optPM.addFunctionPass(PeepholePass());
         optPM.addFunctionPass(ScalarizePass());
@@ -679,9 +922,15 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
         optPM.addModulePass(RemovePersistentFuncsPass());
         optPM.addModulePass(llvm::GlobalDCEPass());
         optPM.addModulePass(llvm::ConstantMergePass());
+        if (!g->opt.disableInternalRegCall &&
+            (g->target->getArch() == Arch::x86 || g->target->getArch() == Arch::x86_64)) {
+            // Once the functions that are left are known.
+            optPM.addModulePass(InternalRegCallPass());
+        }
 #ifdef ISPC_XE_ENABLED
         if (g->target->isXeTarget()) {
             optPM.initFunctionPassManager();
+            optPM.addFunctionPass(XeLowerSLM());
             optPM.addFunctionPass(CheckIRForXeTarget());
             optPM.addFunctionPass(MangleOpenCLBuiltins());
             optPM.commitFunctionToModulePassManager();
@@ -692,6 +941,10 @@ void ispc::Optimize(llvm::Module *module, int optLevel) {
 #endif
     }
 
+    // Check that no calls are left in the code with '#pragma ispc
+    // expect_no_call'.
+    optPM.addModulePass(CheckExpectationsPass(true));
+
     // Finish up by making sure we didn't mess anything up in the IR along
     // the way.
     optPM.addModulePass(llvm::VerifierPass(), LAST_OPT_NUMBER);
@@ -25,8 +25,9 @@ namespace ispc {
 
 /** Optimize the functions in the given module, applying the specified
     level of optimization.  optLevel zero corresponds to essentially no
-    optimization--just enough to generate correct code, while level one
-    corresponds to full optimization.
+    optimization--just enough to generate correct code, level one runs the
+    ispc specific optimizations once with a few LLVM clean-up passes, for
+    a fast compilation, while level two corresponds to full optimization.
 */
 void Optimize(llvm::Module *module, int optLevel);
 
@@ -0,0 +1,249 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "CoherentGathers.h"
+#include "builtins-decl.h"
+
+#include <llvm/IR/IRBuilder.h>
+
+#include <unordered_map>
+
+namespace ispc {
+
+using namespace builtin;
+
+// The base+offsets gathers and whether their offsets are factored, i.e.
+// @__pseudo_gather_factored_base_offsets{32,64}_*(i8 *base, <WIDTH x i{32,64}> varyingOffsets, i32 scale,
+//                                                 <WIDTH x i{32,64}> constOffsets, <WIDTH x MASK>)
+// rather than
+// @__pseudo_gather_base_offsets{32,64}_*(i8 *base, i32 scale, <WIDTH x i{32,64}> offsets, <WIDTH x MASK>)
+static bool lIsBaseOffsetsGather(llvm::CallInst *callInst, bool &factored) {
+    static std::unordered_map<std::string, bool> gathers = {
+        {__pseudo_gather_base_offsets32_i8, false},
+        {__pseudo_gather_base_offsets32_i16, false},
+        {__pseudo_gather_base_offsets32_half, false},
+        {__pseudo_gather_base_offsets32_i32, false},
+        {__pseudo_gather_base_offsets32_float, false},
+        {__pseudo_gather_base_offsets32_i64, false},
+        {__pseudo_gather_base_offsets32_double, false},
+        {__pseudo_gather_base_offsets64_i8, false},
+        {__pseudo_gather_base_offsets64_i16, false},
+        {__pseudo_gather_base_offsets64_half, false},
+        {__pseudo_gather_base_offsets64_i32, false},
+        {__pseudo_gather_base_offsets64_float, false},
+        {__pseudo_gather_base_offsets64_i64, false},
+        {__pseudo_gather_base_offsets64_double, false},
+        {__pseudo_gather_factored_base_offsets32_i8, true},
+        {__pseudo_gather_factored_base_offsets32_i16, true},
+        {__pseudo_gather_factored_base_offsets32_half, true},
+        {__pseudo_gather_factored_base_offsets32_i32, true},
+        {__pseudo_gather_factored_base_offsets32_float, true},
+        {__pseudo_gather_factored_base_offsets32_i64, true},
+        {__pseudo_gather_factored_base_offsets32_double, true},
+        {__pseudo_gather_factored_base_offsets64_i8, true},
+        {__pseudo_gather_factored_base_offsets64_i16, true},
+        {__pseudo_gather_factored_base_offsets64_half, true},
+        {__pseudo_gather_factored_base_offsets64_i32, true},
+        {__pseudo_gather_factored_base_offsets64_float, true},
+        {__pseudo_gather_factored_base_offsets64_i64, true},
+        {__pseudo_gather_factored_base_offsets64_double, true},
+    };
+
+    llvm::Function *calledFunc = callInst->getCalledFunction();
+    if (calledFunc == nullptr) {
+        return false;
+    }
+    auto it = gathers.find(calledFunc->getName().str());
+    if (it == gathers.end()) {
+        return false;
+    }
+    factored = it->second;
+    return true;
+}
+
+/** Returns the masked load of vectors of the given element type, or nullptr
+    if there's none. */
+static llvm::Function *lGetMaskedLoadFunc(llvm::Module *M, llvm::Type *elementType) {
+    const char *name = nullptr;
+    if (elementType == LLVMTypes::Int8Type) {
+        name = __masked_load_i8;
+    } else if (elementType == LLVMTypes::Int16Type) {
+        name = __masked_load_i16;
+    } else if (elementType == LLVMTypes::Float16Type) {
+        name = __masked_load_half;
+    } else if (elementType == LLVMTypes::Int32Type) {
+        name = __masked_load_i32;
+    } else if (elementType == LLVMTypes::FloatType) {
+        name = __masked_load_float;
+    } else if (elementType == LLVMTypes::Int64Type) {
+        name = __masked_load_i64;
+    } else if (elementType == LLVMTypes::DoubleType) {
+        name = __masked_load_double;
+    }
+    return name != nullptr ? M->getFunction(name) : nullptr;
+}
+
+/** Returns true if the front-end has marked the given gather with the flag
+    of '#pragma ispc coherent_gathers' of the loop or function it's in. */
+static bool lHasCoherentGathersPragma(llvm::CallInst *callInst) {
+    llvm::MDNode *md = callInst->getMetadata("ispc_expect");
+    if (md == nullptr || md->getNumOperands() == 0) {
+        return false;
+    }
+    llvm::ConstantInt *flags = llvm::mdconst::dyn_extract<llvm::ConstantInt>(md->getOperand(0));
+    return flags != nullptr && (flags->getZExtValue() & Globals::pragmaExpectType::coherentGathers) != 0;
+}
+
+/** Returns the vector of i1 that is true for the active program instances
+    of the given mask. */
+static llvm::Value *lGetActiveLanes(llvm::IRBuilder<> &B, llvm::Value *mask) {
+    if (mask->getType()->getScalarType()->isIntegerTy(1)) {
+        return mask;
+    }
+    return B.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()), "active_lanes");
+}
+
+/** Returns true if the given comparison is true for all of the active
+    program instances, where active has a bit for each of them. */
+static llvm::Value *lAllActive(llvm::IRBuilder<> &B, llvm::Value *cmp, llvm::Value *active, const llvm::Twine &name) {
+    int width = llvm::cast<llvm::FixedVectorType>(cmp->getType())->getNumElements();
+    llvm::Value *bits = B.CreateBitCast(B.CreateOr(cmp, B.CreateNot(active)), B.getIntNTy(width));
+    return B.CreateICmpEQ(bits, llvm::Constant::getAllOnesValue(bits->getType()), name);
+}
+
+bool CoherentGathersPass::addCoherenceCheck(llvm::CallInst *gather) {
+    bool factored = false;
+    if (!lIsBaseOffsetsGather(gather, factored)) {
+        return false;
+    }
+    llvm::Value *base = gather->getArgOperand(0);
+    llvm::Value *offsets = gather->getArgOperand(factored ? 1 : 2);
+    llvm::ConstantInt *scale = llvm::dyn_cast<llvm::ConstantInt>(gather->getArgOperand(factored ? 2 : 1));
+    llvm::Value *constOffsets = factored ? gather->getArgOperand(3) : nullptr;
+    llvm::Value *mask = gather->getArgOperand(factored ? 4 : 3);
+    if (scale == nullptr || llvm::isa<llvm::Constant>(offsets) || llvm::isa<llvm::ConstantAggregateZero>(mask)) {
+        return false;
+    }
+
+    llvm::Module *M = gather->getModule();
+    const llvm::DataLayout &DL = M->getDataLayout();
+    llvm::FixedVectorType *resultType = llvm::cast<llvm::FixedVectorType>(gather->getType());
+    llvm::Type *elementType = resultType->getElementType();
+    llvm::Function *maskedLoadFunc = lGetMaskedLoadFunc(M, elementType);
+    if (maskedLoadFunc == nullptr) {
+        return false;
+    }
+    int width = resultType->getNumElements();
+    int64_t elementSize = DL.getTypeStoreSize(elementType);
+
+    // The checks are done where the gather is, and the rest of the block
+    // goes to the block that merges the results of the three ways.
+    llvm::BasicBlock *bb = gather->getParent();
+    llvm::Function *F = bb->getParent();
+    llvm::BasicBlock *done = bb->splitBasicBlock(gather, "coherent_gather_done");
+    llvm::BasicBlock *checkConsecutive = llvm::BasicBlock::Create(*g->ctx, "coherent_gather_check", F, done);
+    llvm::BasicBlock *uniformBB = llvm::BasicBlock::Create(*g->ctx, "coherent_gather_uniform", F, done);
+    llvm::BasicBlock *consecutiveBB = llvm::BasicBlock::Create(*g->ctx, "coherent_gather_consecutive", F, done);
+    llvm::BasicBlock *gatherBB = llvm::BasicBlock::Create(*g->ctx, "coherent_gather_fallback", F, done);
+    bb->getTerminator()->eraseFromParent();
+
+    // The byte offsets of the program instances from the base pointer.
+    llvm::IRBuilder<> B(bb);
+    llvm::FixedVectorType *offsetsType = llvm::FixedVectorType::get(LLVMTypes::Int64Type, width);
+    llvm::Value *byteOffsets = B.CreateSExt(offsets, offsetsType);
+    byteOffsets = B.CreateMul(byteOffsets, B.CreateVectorSplat(width, B.CreateSExt(scale, LLVMTypes::Int64Type)));
+    if (constOffsets != nullptr) {
+        byteOffsets = B.CreateAdd(byteOffsets, B.CreateSExt(constOffsets, offsetsType), "gather_offsets");
+    }
+
+    // The offset of the first active program instance; it's the one of
+    // the first program instance if there are none, which fails the checks
+    // below.
+    llvm::Value *active = lGetActiveLanes(B, mask);
+    llvm::Value *activeBits = B.CreateBitCast(active, B.getIntNTy(width));
+    llvm::Value *anyActive = B.CreateICmpNE(activeBits, llvm::Constant::getNullValue(activeBits->getType()));
+    llvm::Value *firstLane = B.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, activeBits, B.getFalse());
+    firstLane = B.CreateSelect(anyActive, B.CreateZExtOrTrunc(firstLane, LLVMTypes::Int64Type),
+                               LLVMInt64(0), "first_lane");
+    llvm::Value *firstOffset = B.CreateExtractElement(byteOffsets, firstLane, "first_offset");
+
+    // All of the active program instances read the same element.
+    llvm::Value *sameOffsets = B.CreateICmpEQ(byteOffsets, B.CreateVectorSplat(width, firstOffset));
+    llvm::Value *isUniform = B.CreateAnd(anyActive, lAllActive(B, sameOffsets, active, "all_same"));
+    B.CreateCondBr(isUniform, uniformBB, checkConsecutive);
+
+    // Or consecutive elements, starting at startOffset for the first
+    // program instance.
+    B.SetInsertPoint(checkConsecutive);
+    llvm::Value *startOffset =
+        B.CreateSub(firstOffset, B.CreateMul(firstLane, LLVMInt64(elementSize)), "consecutive_start");
+    std::vector<llvm::Constant *> laneOffsets;
+    for (int i = 0; i < width; ++i) {
+        laneOffsets.push_back(LLVMInt64(i * elementSize));
+    }
+    llvm::Value *expectedOffsets =
+        B.CreateAdd(B.CreateVectorSplat(width, startOffset), llvm::ConstantVector::get(laneOffsets));
+    llvm::Value *consecutiveOffsets = B.CreateICmpEQ(byteOffsets, expectedOffsets);
+    llvm::Value *isConsecutive = B.CreateAnd(anyActive, lAllActive(B, consecutiveOffsets, active, "all_consecutive"));
+    B.CreateCondBr(isConsecutive, consecutiveBB, gatherBB);
+
+    // A scalar load of the element of the first active program instance,
+    // broadcast to all of them.
+    B.SetInsertPoint(uniformBB);
+    llvm::Value *scalarPtr = B.CreateGEP(LLVMTypes::Int8Type, base, firstOffset);
+    scalarPtr = B.CreatePointerCast(scalarPtr, llvm::PointerType::get(elementType, 0));
+    llvm::LoadInst *scalar = B.CreateAlignedLoad(elementType, scalarPtr, DL.getABITypeAlign(elementType),
+                                                 gather->getName() + "_uniform");
+    LLVMCopyMetadata(scalar, gather);
+    llvm::Value *broadcast = B.CreateVectorSplat(width, scalar);
+    B.CreateBr(done);
+
+    // A masked vector load, which doesn't touch the elements of the
+    // inactive program instances.
+    B.SetInsertPoint(consecutiveBB);
+    llvm::Value *vectorPtr = B.CreateGEP(LLVMTypes::Int8Type, base, startOffset);
+    vectorPtr = B.CreatePointerCast(vectorPtr, maskedLoadFunc->getFunctionType()->getParamType(0));
+    llvm::CallInst *vectorLoad = B.CreateCall(maskedLoadFunc, {vectorPtr, mask}, gather->getName() + "_consecutive");
+    LLVMCopyMetadata(vectorLoad, gather);
+    B.CreateBr(done);
+
+    // The gather itself otherwise.
+    B.SetInsertPoint(gatherBB);
+    llvm::BranchInst *gatherBr = B.CreateBr(done);
+    gather->moveBefore(gatherBr);
+
+    B.SetInsertPoint(&done->front());
+    llvm::PHINode *result = B.CreatePHI(resultType, 3, gather->getName() + "_coherent");
+    gather->replaceAllUsesWith(result);
+    result->addIncoming(broadcast, uniformBB);
+    result->addIncoming(vectorLoad, consecutiveBB);
+    result->addIncoming(gather, gatherBB);
+    return true;
+}
+
+llvm::PreservedAnalyses CoherentGathersPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("CoherentGathersPass::run", F.getName());
+
+    std::vector<llvm::CallInst *> gathers;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I);
+            bool factored = false;
+            if (callInst != nullptr && lIsBaseOffsetsGather(callInst, factored) &&
+                (g->opt.coherentGathers || lHasCoherentGathersPragma(callInst))) {
+                gathers.push_back(callInst);
+            }
+        }
+    }
+
+    bool modifiedAny = false;
+    for (llvm::CallInst *gather : gathers) {
+        modifiedAny |= addCoherenceCheck(gather);
+    }
+    return modifiedAny ? llvm::PreservedAnalyses::none() : llvm::PreservedAnalyses::all();
+}
+
+} // namespace ispc
@@ -0,0 +1,36 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+// This pass adds a run-time check of the addresses to the gathers that the
+// compiler couldn't turn into loads, but whose indices are often the same
+// or consecutive in all program instances, e.g. because they're computed
+// from data that is coherent in practice.  It's applied to the gathers in
+// the loops and functions with '#pragma ispc coherent_gathers' and, with
+// --opt=coherent-gathers, to all of them.
+//
+//  If the addresses of the active program instances are all equal, a
+//  scalar load and a broadcast are done, if they're consecutive elements, a
+//  masked vector load starting at the address of the first program
+//  instance is done, and otherwise the gather is done.  The check takes a
+//  few vector compares, which is much cheaper than a gather on the CPU
+//  targets, but is a loss for the gathers whose addresses are incoherent,
+//  hence it is opt-in.
+
+struct CoherentGathersPass : public llvm::PassInfoMixin<CoherentGathersPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool addCoherenceCheck(llvm::CallInst *gather);
+};
+
+} // namespace ispc
@@ -0,0 +1,71 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "ContractFPOps.h"
+
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace ispc {
+
+// Returns true if the operation may be fused into an FMA.
+static bool lIsContractible(const llvm::Instruction &inst) {
+    switch (inst.getOpcode()) {
+    case llvm::Instruction::FAdd:
+    case llvm::Instruction::FSub:
+    case llvm::Instruction::FMul:
+    case llvm::Instruction::FNeg:
+        return true;
+    default:
+        return false;
+    }
+}
+
+llvm::PreservedAnalyses ContractFPOpsPass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("ContractFPOpsPass::run", M.getName());
+
+    bool anyWithFMA = false, anyWithoutFMA = false;
+    for (const llvm::Function &F : M) {
+        if (!F.isDeclaration()) {
+            bool disableFMA = g->opt.ForFunction(&F).disableFMA;
+            anyWithFMA |= !disableFMA;
+            anyWithoutFMA |= disableFMA;
+        }
+    }
+
+    // The target machine is shared by the modules compiled for the target,
+    // so its setting is made again for each of them.
+    bool fuseAll = !g->opt.disableFMA && !anyWithoutFMA;
+    if (llvm::TargetMachine *targetMachine = g->target->GetTargetMachine()) {
+        targetMachine->Options.AllowFPOpFusion = fuseAll ? llvm::FPOpFusion::Fast : llvm::FPOpFusion::Standard;
+    }
+    if (fuseAll || !anyWithFMA) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    bool modifiedAny = false;
+    for (llvm::Function &F : M) {
+        if (F.isDeclaration() || g->opt.ForFunction(&F).disableFMA) {
+            continue;
+        }
+        for (llvm::Instruction &inst : llvm::instructions(F)) {
+            if (lIsContractible(inst) && !inst.hasAllowContract()) {
+                inst.setHasAllowContract(true);
+                modifiedAny = true;
+            }
+        }
+    }
+    if (!modifiedAny) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
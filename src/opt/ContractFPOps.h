@@ -0,0 +1,31 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+/** The FMA contraction is a setting of the target machine, which fuses all
+    of the multiplications and additions of the module with --opt=disable-fma
+    off, and none of them with it on.  This pass applies the settings of the
+    "fma" and "no-fma" options of the "optimize" attribute of the functions
+    instead: it marks the floating-point operations of the functions that use
+    FMA with the "contract" flag, and switches the target machine to fuse only
+    the operations with the flag if some function in the module doesn't use
+    FMA.  It runs before the inlining, so that the operations keep the
+    setting of the function they come from.
+ */
+class ContractFPOpsPass : public llvm::PassInfoMixin<ContractFPOpsPass> {
+  public:
+    explicit ContractFPOpsPass() {}
+
+    static llvm::StringRef getPassName() { return "Contract FP operations per function"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+};
+
+} // namespace ispc
@@ -0,0 +1,42 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "DisableLoopUnroll.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+
+namespace ispc {
+
+llvm::PreservedAnalyses DisableLoopUnrollPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("DisableLoopUnrollPass::run", F.getName());
+    if (g->opt.ForFunction(&F).unrollLoops) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    llvm::LLVMContext &ctx = F.getContext();
+    llvm::MDNode *disable = llvm::MDNode::get(ctx, llvm::MDString::get(ctx, "llvm.loop.unroll.disable"));
+    bool modifiedAny = false;
+    for (llvm::Loop *L : LI.getLoopsInPreorder()) {
+        if (llvm::hasUnrollTransformation(L) != llvm::TM_Unspecified) {
+            continue;
+        }
+        L->setLoopID(llvm::makePostTransformationMetadata(ctx, L->getLoopID(), {}, {disable}));
+        modifiedAny = true;
+    }
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    // Only the metadata of the branches is changed.
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,27 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+/** This pass runs before the loop unroller and marks the loops of the
+    functions that don't unroll loops, because of --opt=disable-loop-unroll
+    or of the "no-unroll-loops" option of their "optimize" attribute, with
+    the same metadata as '#pragma nounroll', so that the unroller, which
+    runs if any function of the module unrolls loops, leaves them alone.
+    The loops with an unroll pragma keep it.  As the pass runs after the
+    inlining, the loops of the inlined functions follow the setting of the
+    function that they were inlined into.
+ */
+struct DisableLoopUnrollPass : public llvm::PassInfoMixin<DisableLoopUnrollPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+};
+
+} // namespace ispc
@@ -7,6 +7,9 @@
 #include "GatherCoalescePass.h"
 #include "builtins-decl.h"
 
+#include <algorithm>
+#include <llvm/IR/IRBuilder.h>
+
 namespace ispc {
 
 /** Representation of a memory load that the gather coalescing code has
@@ -20,8 +23,7 @@ struct CoalescedLoadOp {
     }
 
     /** Starting offset of the load from the common base pointer (in terms
-        of numbers of items of the underlying element type--*not* in terms
-        of bytes). */
+        of numbers of 32-bit words--*not* in terms of bytes). */
     int64_t start;
 
     /** Number of elements to load at this location */
@@ -271,30 +273,116 @@ static llvm::Value *lGEPAndLoad(llvm::Value *basePtr, llvm::Type *baseType, int6
                               ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
 }
 
+/** For a gather with a mask that isn't known to be all on, compute the
+    mask of a coalesced load: an element of the load is read if any of the
+    active lanes needs it, so neither the elements between the needed ones
+    nor the ones of the inactive lanes are touched.  Since more than one
+    lane may need the same element, the lanes needing each element are
+    gathered in rounds of shuffles of the lane mask that are or-ed
+    together.
+ */
+static llvm::Value *lLoadMask(const CoalescedLoadOp &load, const std::vector<int64_t> &constOffsets,
+                              int unitsPerLane, llvm::Value *laneMask, llvm::IRBuilder<> &builder) {
+    int width = g->target->getVectorWidth();
+    std::vector<std::vector<int>> lanes(load.count);
+    for (int i = 0; i < (int)constOffsets.size(); ++i) {
+        int64_t elt = constOffsets[i] - load.start;
+        if (elt >= 0 && elt < load.count) {
+            int lane = (i / unitsPerLane) % width;
+            if (std::find(lanes[elt].begin(), lanes[elt].end(), lane) == lanes[elt].end()) {
+                lanes[elt].push_back(lane);
+            }
+        }
+    }
+
+    // Index "width" selects from the all off vector, i.e. no lane needs the
+    // element in that round.
+    llvm::Value *allOff = llvm::Constant::getNullValue(laneMask->getType());
+    llvm::Value *result = nullptr;
+    for (int round = 0;; ++round) {
+        std::vector<int> shuf(load.count, width);
+        bool any = false;
+        for (int elt = 0; elt < load.count; ++elt) {
+            if (round < (int)lanes[elt].size()) {
+                shuf[elt] = lanes[elt][round];
+                any = true;
+            }
+        }
+        if (!any) {
+            break;
+        }
+        llvm::Value *roundMask = builder.CreateShuffleVector(laneMask, allOff, shuf, "load_mask");
+        result = result ? builder.CreateOr(result, roundMask, "load_mask") : roundMask;
+    }
+    // The first element of a load is always needed by some lane.
+    Assert(result != nullptr);
+    return result;
+}
+
+/** Emit a masked load of count 32-bit elements and set the values of the
+    load op from it, the same way as lEmitLoads() does for the unmasked
+    loads. */
+static void lEmitMaskedLoad(llvm::Value *basePtr, llvm::Type *baseType, CoalescedLoadOp &load, int64_t start,
+                            int align, llvm::Value *mask, llvm::Instruction *insertBefore) {
+    llvm::IRBuilder<> builder(insertBefore);
+    llvm::VectorType *vt = LLVMVECTOR::get(LLVMTypes::Int32Type, load.count);
+    llvm::Value *ptr = LLVMGEPInst(basePtr, baseType, LLVMInt64(start), "new_base", insertBefore);
+    ptr = builder.CreateBitCast(ptr, llvm::PointerType::get(vt, 0), "ptr_cast");
+    llvm::Value *value = builder.CreateMaskedLoad(vt, ptr, llvm::Align(align), mask, nullptr, "gather_masked_load");
+
+    switch (load.count) {
+    case 1:
+        load.load = builder.CreateExtractElement(value, (uint64_t)0, "gather_load");
+        break;
+    case 2:
+        load.load = builder.CreateBitCast(value, LLVMTypes::Int64Type, "load64");
+        load.element0 = builder.CreateExtractElement(value, (uint64_t)0, "load64_elt0");
+        load.element1 = builder.CreateExtractElement(value, (uint64_t)1, "load64_elt1");
+        break;
+    case 4:
+    case 8:
+        load.load = value;
+        break;
+    default:
+        FATAL("Unexpected load count in lEmitMaskedLoad()");
+    }
+}
+
 /* Having decided that we're doing to emit a series of loads, as encoded in
    the loadOps array, this function emits the corresponding load
-   instructions.
+   instructions.  The offsets of the loads are in 32-bit words.  If
+   loadMasks isn't empty, it gives the mask of each load, which is emitted
+   as a masked load.
  */
-static void lEmitLoads(llvm::Value *basePtr, llvm::Type *baseType, std::vector<CoalescedLoadOp> &loadOps,
-                       int elementSize, llvm::Instruction *insertBefore) {
+static void lEmitLoads(llvm::Value *basePtr, llvm::Type *baseType, std::vector<CoalescedLoadOp> &loadOps, int align,
+                       const std::vector<llvm::Value *> &loadMasks, llvm::Instruction *insertBefore) {
     Debug(SourcePos(), "Coalesce doing %d loads.", (int)loadOps.size());
     for (int i = 0; i < (int)loadOps.size(); ++i) {
         Debug(SourcePos(), "Load #%d @ %" PRId64 ", %d items", i, loadOps[i].start, loadOps[i].count);
 
         // basePtr is an i8 *, so the offset from it should be in terms of
         // bytes, not underlying i32 elements.
-        int64_t start = loadOps[i].start * elementSize;
+        int64_t start = loadOps[i].start * 4;
+
+        int loadAlign = align;
+        if (loadOps[i].count >= 4 && g->opt.forceAlignedMemory) {
+            loadAlign = g->target->getNativeVectorAlignment();
+        }
+
+        if (!loadMasks.empty()) {
+            lEmitMaskedLoad(basePtr, baseType, loadOps[i], start, loadAlign, loadMasks[i], insertBefore);
+            continue;
+        }
 
-        int align = 4;
         switch (loadOps[i].count) {
         case 1:
             // Single 32-bit scalar load
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, LLVMTypes::Int32Type);
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, loadAlign, insertBefore, LLVMTypes::Int32Type);
             break;
         case 2: {
             // Emit 2 x i32 loads as i64 loads and then break the result
             // into two 32-bit parts.
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, LLVMTypes::Int64Type);
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, loadAlign, insertBefore, LLVMTypes::Int64Type);
             // element0 = (int32)value;
             loadOps[i].element0 = new llvm::TruncInst(loadOps[i].load, LLVMTypes::Int32Type, "load64_elt0",
                                                       ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
@@ -308,20 +396,14 @@ static void lEmitLoads(llvm::Value *basePtr, llvm::Type *baseType, std::vector<C
         }
         case 4: {
             // 4-wide vector load
-            if (g->opt.forceAlignedMemory) {
-                align = g->target->getNativeVectorAlignment();
-            }
             llvm::VectorType *vt = LLVMVECTOR::get(LLVMTypes::Int32Type, 4);
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, vt);
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, loadAlign, insertBefore, vt);
             break;
         }
         case 8: {
             // 8-wide vector load
-            if (g->opt.forceAlignedMemory) {
-                align = g->target->getNativeVectorAlignment();
-            }
             llvm::VectorType *vt = LLVMVECTOR::get(LLVMTypes::Int32Type, 8);
-            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, align, insertBefore, vt);
+            loadOps[i].load = lGEPAndLoad(basePtr, baseType, start, loadAlign, insertBefore, vt);
             break;
         }
         default:
@@ -642,72 +724,38 @@ static llvm::Value *lAssemble4Vector(const std::vector<CoalescedLoadOp> &loadOps
 
 /** Given the set of loads that we've done and the set of result values to
     be computed, this function computes the final llvm::Value *s for each
-    result vector.
+    result vector.  Each result takes unitsPerGather consecutive 32-bit
+    words of constOffsets.
  */
 static void lAssembleResultVectors(const std::vector<CoalescedLoadOp> &loadOps,
-                                   const std::vector<int64_t> &constOffsets, std::vector<llvm::Value *> &results,
-                                   llvm::Instruction *insertBefore) {
+                                   const std::vector<int64_t> &constOffsets, int unitsPerGather,
+                                   std::vector<llvm::Value *> &results, llvm::Instruction *insertBefore) {
     // We work on 4-wide chunks of the final values, even when we're
     // computing 8-wide or 16-wide vectors.  This gives better code from
     // LLVM's SSE/AVX code generators.
-    Assert((constOffsets.size() % 4) == 0);
+    Assert((constOffsets.size() % 4) == 0 && (unitsPerGather % 4) == 0);
     std::vector<llvm::Value *> vec4s;
     for (int i = 0; i < (int)constOffsets.size(); i += 4) {
         vec4s.push_back(lAssemble4Vector(loadOps, &constOffsets[i], insertBefore));
     }
 
-    // And now concatenate 1, 2, or 4 of the 4-wide vectors computed above
-    // into 4, 8, or 16-wide final result vectors.
-    int numGathers = constOffsets.size() / g->target->getVectorWidth();
+    // And now concatenate the 4-wide vectors computed above pairwise into
+    // the final result vectors.  (The widths above 16 may be reached when
+    // --opt=disable-gathers option is used or for 64-bit elements.)
+    int numGathers = constOffsets.size() / unitsPerGather;
+    int vec4sPerGather = unitsPerGather / 4;
     for (int i = 0; i < numGathers; ++i) {
-        llvm::Value *result = nullptr;
-        switch (g->target->getVectorWidth()) {
-        case 4:
-            result = vec4s[i];
-            break;
-        case 8:
-            result = LLVMConcatVectors(vec4s[2 * i], vec4s[2 * i + 1], insertBefore);
-            break;
-        case 16: {
-            llvm::Value *v1 = LLVMConcatVectors(vec4s[4 * i], vec4s[4 * i + 1], insertBefore);
-            llvm::Value *v2 = LLVMConcatVectors(vec4s[4 * i + 2], vec4s[4 * i + 3], insertBefore);
-            result = LLVMConcatVectors(v1, v2, insertBefore);
-            break;
-        }
-        // The code for 32 and 64 width may be triggered when --opt=disable-gathers option is used.
-        case 32: {
-            llvm::Value *v1 = LLVMConcatVectors(vec4s[4 * i], vec4s[4 * i + 1], insertBefore);
-            llvm::Value *v2 = LLVMConcatVectors(vec4s[4 * i + 2], vec4s[4 * i + 3], insertBefore);
-            llvm::Value *v3 = LLVMConcatVectors(vec4s[4 * i + 4], vec4s[4 * i + 5], insertBefore);
-            llvm::Value *v4 = LLVMConcatVectors(vec4s[4 * i + 6], vec4s[4 * i + 7], insertBefore);
-            llvm::Value *res1 = LLVMConcatVectors(v1, v2, insertBefore);
-            llvm::Value *res2 = LLVMConcatVectors(v3, v4, insertBefore);
-            result = LLVMConcatVectors(res1, res2, insertBefore);
-            break;
-        }
-        case 64: {
-            llvm::Value *v1 = LLVMConcatVectors(vec4s[4 * i], vec4s[4 * i + 1], insertBefore);
-            llvm::Value *v2 = LLVMConcatVectors(vec4s[4 * i + 2], vec4s[4 * i + 3], insertBefore);
-            llvm::Value *v3 = LLVMConcatVectors(vec4s[4 * i + 4], vec4s[4 * i + 5], insertBefore);
-            llvm::Value *v4 = LLVMConcatVectors(vec4s[4 * i + 6], vec4s[4 * i + 7], insertBefore);
-            llvm::Value *v5 = LLVMConcatVectors(vec4s[4 * i + 8], vec4s[4 * i + 9], insertBefore);
-            llvm::Value *v6 = LLVMConcatVectors(vec4s[4 * i + 10], vec4s[4 * i + 11], insertBefore);
-            llvm::Value *v7 = LLVMConcatVectors(vec4s[4 * i + 12], vec4s[4 * i + 13], insertBefore);
-            llvm::Value *v8 = LLVMConcatVectors(vec4s[4 * i + 14], vec4s[4 * i + 15], insertBefore);
-            llvm::Value *res1 = LLVMConcatVectors(v1, v2, insertBefore);
-            llvm::Value *res2 = LLVMConcatVectors(v3, v4, insertBefore);
-            llvm::Value *res3 = LLVMConcatVectors(v5, v6, insertBefore);
-            llvm::Value *res4 = LLVMConcatVectors(v7, v8, insertBefore);
-            llvm::Value *res12 = LLVMConcatVectors(res1, res2, insertBefore);
-            llvm::Value *res34 = LLVMConcatVectors(res3, res4, insertBefore);
-            result = LLVMConcatVectors(res12, res34, insertBefore);
-            break;
-        }
-        default:
-            FATAL("Unhandled vector width in lAssembleResultVectors()");
+        std::vector<llvm::Value *> parts(vec4s.begin() + i * vec4sPerGather,
+                                         vec4s.begin() + (i + 1) * vec4sPerGather);
+        while (parts.size() > 1) {
+            Assert((parts.size() % 2) == 0);
+            std::vector<llvm::Value *> concatenated;
+            for (int j = 0; j < (int)parts.size(); j += 2) {
+                concatenated.push_back(LLVMConcatVectors(parts[j], parts[j + 1], insertBefore));
+            }
+            parts = concatenated;
         }
-
-        results.push_back(result);
+        results.push_back(parts[0]);
     }
 }
 
@@ -738,27 +786,74 @@ static llvm::Value *lComputeBasePtr(llvm::CallInst *gatherInst, llvm::Type *base
 
 /** Extract the constant offsets (from the common base pointer) from each
     of the gathers in a set to be coalesced.  These come in as byte
-    offsets, but we'll transform them into offsets in terms of the size of
-    the base scalar type being gathered.  (e.g. for an i32 gather, we might
-    have offsets like <0,4,16,20>, which would be transformed to <0,1,4,5>
-    here.)
+    offsets, but we'll transform them into offsets of the 32-bit words to
+    load, which the rest of the coalescing works with:
+
+    - 32-bit elements take a word per lane (e.g. for an i32 gather, we
+      might have offsets like <0,4,16,20>, which would be transformed to
+      <0,1,4,5> here).
+    - 64-bit elements take two consecutive words per lane, the lower one
+      first, so the assembled vector of words bitcasts to the result.
+    - 8 and 16-bit elements take the word they are in, and *shifts gets the
+      position of the element in the word, in bits, for each lane.
+
+    Returns false if the offsets can't be expressed this way: the 32 and
+    64-bit elements must be at multiples of 4 bytes and the 8 and 16-bit
+    ones must not straddle two words.  If the mask isn't all on, the words
+    are only loaded for the active lanes, so every word of an 8 or 16-bit
+    element must also be entirely read by the same lane across the gathers
+    of the group; otherwise an active lane might read past the memory the
+    program accesses.
  */
-static void lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGroup, int elementSize,
-                                 std::vector<int64_t> *constOffsets) {
+static bool lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGroup, int elementSize,
+                                 bool maskAllOn, std::vector<int64_t> *constOffsets, std::vector<int32_t> *shifts) {
     int width = g->target->getVectorWidth();
-    *constOffsets = std::vector<int64_t>(coalesceGroup.size() * width, 0);
-
-    int64_t *endPtr = &((*constOffsets)[0]);
-    for (int i = 0; i < (int)coalesceGroup.size(); ++i, endPtr += width) {
+    int unitsPerLane = elementSize == 8 ? 2 : 1;
+    std::vector<int64_t> byteOffsets(coalesceGroup.size() * width, 0);
+    for (int i = 0; i < (int)coalesceGroup.size(); ++i) {
         llvm::Value *offsets = coalesceGroup[i]->getArgOperand(3);
         int nElts = 0;
-        bool ok = LLVMExtractVectorInts(offsets, endPtr, &nElts);
+        bool ok = LLVMExtractVectorInts(offsets, &byteOffsets[i * width], &nElts);
         Assert(ok && nElts == width);
     }
 
-    for (int i = 0; i < (int)constOffsets->size(); ++i) {
-        (*constOffsets)[i] /= elementSize;
+    constOffsets->clear();
+    shifts->clear();
+    for (int64_t offset : byteOffsets) {
+        // Round down, the offsets may be negative.
+        int64_t unit = offset >= 0 ? offset / 4 : -((3 - offset) / 4);
+        int64_t inUnit = offset - unit * 4;
+        if (elementSize >= 4 && inUnit != 0) {
+            return false;
+        }
+        if (elementSize < 4 && inUnit + elementSize > 4) {
+            return false;
+        }
+        for (int u = 0; u < unitsPerLane; ++u) {
+            constOffsets->push_back(unit + u);
+        }
+        shifts->push_back(int32_t(inUnit * 8));
     }
+
+    if (elementSize < 4 && !maskAllOn) {
+        for (int lane = 0; lane < width; ++lane) {
+            std::set<int64_t> laneBytes;
+            for (int i = 0; i < (int)coalesceGroup.size(); ++i) {
+                for (int byte = 0; byte < elementSize; ++byte) {
+                    laneBytes.insert(byteOffsets[i * width + lane] + byte);
+                }
+            }
+            for (int i = 0; i < (int)coalesceGroup.size(); ++i) {
+                int64_t wordStart = (*constOffsets)[i * width + lane] * 4;
+                for (int byte = 0; byte < 4; ++byte) {
+                    if (laneBytes.count(wordStart + byte) == 0) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
 }
 
 /** Actually do the coalescing.  We have a set of gathers all accessing
@@ -769,31 +864,39 @@ static void lExtractConstOffsets(const std::vector<llvm::CallInst *> &coalesceGr
 
     where varyingOffset actually has the same value across all of the SIMD
     lanes and where the part in parenthesis has the same value for all of
-    the gathers in the group.
+    the gathers in the group.  If the mask of the group isn't known to be
+    all on, masked loads are used, so only the memory of the active lanes
+    is read.
  */
 static bool lCoalesceGathers(const std::vector<llvm::CallInst *> &coalesceGroup, llvm::Type *baseType) {
     llvm::Instruction *insertBefore = coalesceGroup[0];
+    int width = g->target->getVectorWidth();
 
-    // First, compute the shared base pointer for all of the gathers
-    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
-
-    int elementSize = 0;
-    if (coalesceGroup[0]->getType() == LLVMTypes::Int32VectorType ||
-        coalesceGroup[0]->getType() == LLVMTypes::FloatVectorType) {
-        elementSize = 4;
-    } else if (coalesceGroup[0]->getType() == LLVMTypes::Int64VectorType ||
-               coalesceGroup[0]->getType() == LLVMTypes::DoubleVectorType) {
-        elementSize = 8;
-    } else {
+    llvm::VectorType *gatherType = llvm::cast<llvm::VectorType>(coalesceGroup[0]->getType());
+    int elementSize = gatherType->getElementType()->getPrimitiveSizeInBits() / 8;
+    if (elementSize != 1 && elementSize != 2 && elementSize != 4 && elementSize != 8) {
         FATAL("Unexpected gather type in lCoalesceGathers");
     }
+    int unitsPerLane = elementSize == 8 ? 2 : 1;
+    if (unitsPerLane * width > ISPC_MAX_NVEC) {
+        return false;
+    }
+
+    llvm::Value *mask = coalesceGroup[0]->getArgOperand(4);
+    bool maskAllOn = GetMaskStatusFromValue(mask) == MaskStatus::all_on;
 
     // Extract the constant offsets from the gathers into the constOffsets
-    // vector: the first vectorWidth elements will be those for the first
-    // gather, the next vectorWidth those for the next gather, and so
-    // forth.
+    // vector: the first unitsPerLane * vectorWidth elements will be those
+    // for the first gather, the next ones those for the next gather, and
+    // so forth.
     std::vector<int64_t> constOffsets;
-    lExtractConstOffsets(coalesceGroup, elementSize, &constOffsets);
+    std::vector<int32_t> shifts;
+    if (!lExtractConstOffsets(coalesceGroup, elementSize, maskAllOn, &constOffsets, &shifts)) {
+        return false;
+    }
+
+    // Compute the shared base pointer for all of the gathers
+    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
 
     // Determine a set of loads to perform to get all of the values we need
     // loaded.
@@ -802,8 +905,23 @@ static bool lCoalesceGathers(const std::vector<llvm::CallInst *> &coalesceGroup,
 
     lCoalescePerfInfo(coalesceGroup, loadOps);
 
-    // Actually emit load instructions for them
-    lEmitLoads(basePtr, baseType, loadOps, elementSize, insertBefore);
+    // For a mask that isn't all on, compute the masks of the loads from
+    // the lane mask.
+    std::vector<llvm::Value *> loadMasks;
+    llvm::IRBuilder<> builder(insertBefore);
+    if (!maskAllOn) {
+        llvm::Value *laneMask = mask;
+        if (!mask->getType()->getScalarType()->isIntegerTy(1)) {
+            laneMask = builder.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()), "lane_mask");
+        }
+        for (const CoalescedLoadOp &load : loadOps) {
+            loadMasks.push_back(lLoadMask(load, constOffsets, unitsPerLane, laneMask, builder));
+        }
+    }
+
+    // Actually emit load instructions for them.  The words of the 8 and
+    // 16-bit elements may not be aligned.
+    lEmitLoads(basePtr, baseType, loadOps, std::min(elementSize, 4), loadMasks, insertBefore);
 
     // Now, for any loads that give us <8 x i32> vectors, split their
     // values into two <4 x i32> vectors; it turns out that LLVM gives us
@@ -814,11 +932,22 @@ static bool lCoalesceGathers(const std::vector<llvm::CallInst *> &coalesceGroup,
     // gives us each result value; the i'th element of results[] gives the
     // result for the i'th gather in coalesceGroup.
     std::vector<llvm::Value *> results;
-    lAssembleResultVectors(loadOps, constOffsets, results, insertBefore);
+    lAssembleResultVectors(loadOps, constOffsets, unitsPerLane * width, results, insertBefore);
+
+    // Extract the 8 or 16-bit elements from their words.  (This is done
+    // before any gather is replaced, as insertBefore is the first one.)
+    Assert(results.size() == coalesceGroup.size());
+    if (elementSize < 4) {
+        llvm::Type *elementsType = elementSize == 1 ? LLVMTypes::Int8VectorType : LLVMTypes::Int16VectorType;
+        for (int i = 0; i < (int)results.size(); ++i) {
+            llvm::Value *shift = LLVMInt32Vector(&shifts[i * width]);
+            results[i] = builder.CreateLShr(results[i], shift, "gather_shift");
+            results[i] = builder.CreateTrunc(results[i], elementsType, "gather_trunc");
+        }
+    }
 
     // Finally, replace each of the original gathers with the instruction
     // that gives the value from the coalescing process.
-    Assert(results.size() == coalesceGroup.size());
     for (int i = 0; i < (int)results.size(); ++i) {
         llvm::Instruction *ir = llvm::dyn_cast<llvm::Instruction>(results[i]);
         Assert(ir != nullptr);
@@ -879,10 +1008,20 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
 
     llvm::Module *M = bb.getModule();
     llvm::Function *gatherFuncs[] = {
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_i8),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_i16),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_half),
         M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_i32),
         M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_float),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_i64),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets32_double),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_i8),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_i16),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_half),
         M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_i32),
         M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_float),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_i64),
+        M->getFunction(builtin::__pseudo_gather_factored_base_offsets64_double),
     };
     int nGatherFuncs = sizeof(gatherFuncs) / sizeof(gatherFuncs[0]);
 
@@ -893,7 +1032,7 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
     for (llvm::BasicBlock::iterator iter = bb.begin(), e = bb.end(); iter != e;) {
         llvm::BasicBlock::iterator curIter = iter++;
         // Iterate over all of the instructions and look for calls to
-        // __pseudo_gather_factored_base_offsets{32,64}_{i32,float} calls.
+        // __pseudo_gather_factored_base_offsets{32,64}_* calls.
         llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&*curIter);
         if (callInst == nullptr) {
             continue;
@@ -927,16 +1066,16 @@ bool GatherCoalescePass::coalesceGathersFactored(llvm::BasicBlock &bb) {
         // To apply this optimization, we need a set of one or more gathers
         // that fulfill the following conditions:
         //
-        // - Mask all on
+        // - Mask not known to be all off
         // - The variable offsets to all have the same value (i.e., to be
         //   uniform).
-        // - Same base pointer, variable offsets, and offset scale (for
-        //   more than one gather)
+        // - Same base pointer, variable offsets, offset scale, and mask
+        //   (for more than one gather)
         //
         // Then and only then do we have a common base pointer with all
         // offsets from that constants (in which case we can potentially
         // coalesce).
-        if (GetMaskStatusFromValue(mask) != MaskStatus::all_on) {
+        if (GetMaskStatusFromValue(mask) == MaskStatus::all_off) {
             continue;
         }
 
@@ -11,9 +11,11 @@
 namespace ispc {
 
 // This pass implements two optimizations to improve the performance of
-// gathers; currently only gathers of 32-bit values where it can be
-// determined at compile time that the mask is all on are supported, though
-// both of those limitations may be generalized in the future.
+// gathers of 8, 16, 32 and 64-bit values.  All of them are handled in
+// terms of 32-bit words: a 64-bit value takes two words and an 8 or 16-bit
+// value is extracted from the word it's in.  If the mask isn't known to be
+// all on at compile time (e.g. the last iteration of foreach), masked
+// loads are emitted, which only read the words needed by the active lanes.
 //
 //  First, for any single gather, see if it's worthwhile to break it into
 //  any of scalar, 2-wide (i.e. 64-bit), 4-wide, or 8-wide loads.  Further,
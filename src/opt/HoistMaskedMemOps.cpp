@@ -0,0 +1,368 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "HoistMaskedMemOps.h"
+#include "builtins-decl.h"
+
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/Loads.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/MemoryLocation.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Transforms/Utils/LoopSimplify.h>
+#include <llvm/Transforms/Utils/SSAUpdater.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ispc {
+
+using namespace builtin;
+
+enum class MaskedMemOp { None, Load, Store };
+
+// The number of instructions before the loop that are looked at for the
+// unmasked accesses of the memory of a hoisted load.
+static const int MAX_SCANNED_INSTS = 256;
+
+/** Returns the kind of the masked load or store that inst is a call of.
+    For the loads, the alignment of their elements is returned in align.
+ */
+static MaskedMemOp lGetMaskedMemOp(const llvm::Instruction &inst, int *align = nullptr) {
+    static std::unordered_map<std::string, int> maskedLoadAlign = {
+        {__masked_load_i8, 1},        {__masked_load_i16, 2},        {__masked_load_half, 2},
+        {__masked_load_i32, 4},       {__masked_load_float, 4},      {__masked_load_i64, 8},
+        {__masked_load_double, 8},    {__masked_load_blend_i8, 1},   {__masked_load_blend_i16, 2},
+        {__masked_load_blend_half, 2}, {__masked_load_blend_i32, 4}, {__masked_load_blend_float, 4},
+        {__masked_load_blend_i64, 8}, {__masked_load_blend_double, 8},
+    };
+    static std::unordered_set<std::string> maskedStores = {
+        __pseudo_masked_store_i8,    __pseudo_masked_store_i16, __pseudo_masked_store_half,
+        __pseudo_masked_store_i32,   __pseudo_masked_store_float, __pseudo_masked_store_i64,
+        __pseudo_masked_store_double,
+    };
+
+    const llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&inst);
+    llvm::Function *called = callInst ? callInst->getCalledFunction() : nullptr;
+    if (called == nullptr) {
+        return MaskedMemOp::None;
+    }
+    std::string name = called->getName().str();
+    auto it = maskedLoadAlign.find(name);
+    if (it != maskedLoadAlign.end()) {
+        if (align) {
+            *align = it->second;
+        }
+        return MaskedMemOp::Load;
+    }
+    return maskedStores.count(name) ? MaskedMemOp::Store : MaskedMemOp::None;
+}
+
+// Returns the memory that the masked load or store accesses.
+static llvm::MemoryLocation lGetMaskedMemOpLocation(const llvm::Instruction &inst, MaskedMemOp op,
+                                                    const llvm::DataLayout &DL) {
+    const llvm::CallInst &callInst = llvm::cast<llvm::CallInst>(inst);
+    llvm::Type *type = op == MaskedMemOp::Load ? callInst.getType() : callInst.getArgOperand(1)->getType();
+    return llvm::MemoryLocation(callInst.getArgOperand(0), llvm::LocationSize::precise(DL.getTypeStoreSize(type)));
+}
+
+// Returns how inst may access the memory at loc.
+static llvm::ModRefInfo lGetModRef(llvm::Instruction &inst, const llvm::MemoryLocation &loc, llvm::AAResults &AA,
+                                   const llvm::DataLayout &DL) {
+    MaskedMemOp op = lGetMaskedMemOp(inst);
+    if (op == MaskedMemOp::None) {
+        return AA.getModRefInfo(&inst, loc);
+    }
+    // The declarations of the masked loads and stores don't tell that they
+    // only access the memory at their pointers.
+    if (AA.isNoAlias(lGetMaskedMemOpLocation(inst, op, DL), loc)) {
+        return llvm::ModRefInfo::NoModRef;
+    }
+    return op == MaskedMemOp::Load ? llvm::ModRefInfo::Ref : llvm::ModRefInfo::Mod;
+}
+
+// Returns true if inst may free memory, which ends the search for the
+// earlier accesses of the memory.
+static bool lMayFree(const llvm::Instruction &inst) {
+    return llvm::isa<llvm::CallBase>(inst) && inst.mayWriteToMemory() &&
+           lGetMaskedMemOp(inst) == MaskedMemOp::None;
+}
+
+/** Returns true if inst is an unmasked load or store of the size bytes at
+    the given offset from base.
+ */
+static bool lAccessCovers(const llvm::Instruction &inst, const llvm::Value *base, int64_t offset, int64_t size,
+                          const llvm::DataLayout &DL) {
+    const llvm::Value *ptr = nullptr;
+    llvm::Type *type = nullptr;
+    if (const llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+        ptr = load->getPointerOperand();
+        type = load->getType();
+    } else if (const llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+        ptr = store->getPointerOperand();
+        type = store->getValueOperand()->getType();
+    } else {
+        return false;
+    }
+
+    int64_t accessOffset = 0;
+    if (llvm::GetPointerBaseWithConstantOffset(ptr, accessOffset, DL) != base) {
+        return false;
+    }
+    int64_t accessSize = DL.getTypeStoreSize(type);
+    return accessOffset <= offset && offset + size <= accessOffset + accessSize;
+}
+
+/** Returns true if the size bytes at ptr are known to be dereferenceable at
+    the end of the preheader of the loop: from the pointer itself, or from
+    the unmasked accesses of the same memory that are executed just before
+    or just after it.
+ */
+static bool lIsDereferenceable(llvm::Value *ptr, int64_t size, llvm::Loop *L, const llvm::DataLayout &DL) {
+    llvm::BasicBlock *preheader = L->getLoopPreheader();
+    llvm::APInt apSize(DL.getIndexTypeSizeInBits(ptr->getType()), size);
+    if (llvm::isDereferenceableAndAlignedPointer(ptr, llvm::Align(1), apSize, DL, preheader->getTerminator())) {
+        return true;
+    }
+
+    int64_t offset = 0;
+    const llvm::Value *base = llvm::GetPointerBaseWithConstantOffset(ptr, offset, DL);
+
+    // The start of the header, which is executed right after the preheader.
+    for (const llvm::Instruction &inst : *L->getHeader()) {
+        if (lAccessCovers(inst, base, offset, size, DL)) {
+            return true;
+        }
+        if (lMayFree(inst) || !llvm::isGuaranteedToTransferExecutionToSuccessor(&inst)) {
+            break;
+        }
+    }
+
+    // The blocks that are executed right before the preheader.
+    int budget = MAX_SCANNED_INSTS;
+    for (llvm::BasicBlock *BB = preheader; BB != nullptr; BB = BB->getSinglePredecessor()) {
+        for (auto it = BB->rbegin(); it != BB->rend(); ++it) {
+            if (--budget < 0 || lMayFree(*it)) {
+                return false;
+            }
+            if (lAccessCovers(*it, base, offset, size, DL)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Returns true if nothing in the loop but inst may write to loc.
+static bool lIsInvariant(llvm::Instruction *inst, const llvm::MemoryLocation &loc,
+                         const std::vector<llvm::Instruction *> &memInsts, llvm::AAResults &AA,
+                         const llvm::DataLayout &DL) {
+    return std::none_of(memInsts.begin(), memInsts.end(), [&](llvm::Instruction *other) {
+        return other != inst && llvm::isModSet(lGetModRef(*other, loc, AA, DL));
+    });
+}
+
+// Returns true if nothing in the loop but inst may access loc.
+static bool lIsOnlyAccess(llvm::Instruction *inst, const llvm::MemoryLocation &loc,
+                          const std::vector<llvm::Instruction *> &memInsts, llvm::AAResults &AA,
+                          const llvm::DataLayout &DL) {
+    return std::none_of(memInsts.begin(), memInsts.end(), [&](llvm::Instruction *other) {
+        return other != inst && llvm::isModOrRefSet(lGetModRef(*other, loc, AA, DL));
+    });
+}
+
+static void lRemove(std::vector<llvm::Instruction *> &memInsts, llvm::Instruction *inst) {
+    memInsts.erase(std::remove(memInsts.begin(), memInsts.end(), inst), memInsts.end());
+}
+
+/** Hoists the load or the masked load to the preheader of the loop, as an
+    unmasked load.  The program instances that are off in the mask of the
+    masked load get the loaded values, rather than undefined ones.
+ */
+static void lHoistLoad(llvm::Instruction *inst, int align, llvm::Loop *L, llvm::AssumptionCache &AC) {
+    llvm::Instruction *insertBefore = L->getLoopPreheader()->getTerminator();
+    if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+        load->moveBefore(insertBefore);
+        // It may not have been executed where these were known.
+        load->setMetadata(llvm::LLVMContext::MD_range, nullptr);
+        load->setMetadata(llvm::LLVMContext::MD_nonnull, nullptr);
+        load->setMetadata(llvm::LLVMContext::MD_noundef, nullptr);
+        return;
+    }
+
+    llvm::CallInst *callInst = llvm::cast<llvm::CallInst>(inst);
+    llvm::Type *ptrType = llvm::PointerType::get(callInst->getType(), 0);
+    llvm::Value *ptr = new llvm::BitCastInst(callInst->getArgOperand(0), ptrType, "ptr_cast_for_load",
+                                             ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
+    if (g->opt.forceAlignedMemory) {
+        align = g->target->getNativeVectorAlignment();
+    } else {
+        align = LLVMGetKnownAlignment(ptr, align, insertBefore, &AC);
+    }
+    llvm::LoadInst *load = new llvm::LoadInst(callInst->getType(), ptr, callInst->getName(), false /* not volatile */,
+                                              llvm::MaybeAlign(align).valueOrOne(),
+                                              ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
+    LLVMCopyMetadata(load, callInst);
+    callInst->replaceAllUsesWith(load);
+    callInst->eraseFromParent();
+}
+
+/** Sinks the masked store to the exits of the loop.  The stored values and
+    the masks are accumulated in the loop, and stored at the exits with the
+    union of the masks, so that the program instances that never store in
+    the loop don't store after it either.
+ */
+static void lSinkStore(llvm::CallInst *callInst, llvm::Loop *L) {
+    llvm::Value *ptr = callInst->getArgOperand(0);
+    llvm::Value *value = callInst->getArgOperand(1);
+    llvm::Value *mask = callInst->getArgOperand(2);
+    llvm::BasicBlock *BB = callInst->getParent();
+
+    llvm::SmallVector<llvm::PHINode *, 8> phis;
+    llvm::SSAUpdater valueSSA(&phis), maskSSA(&phis);
+    valueSSA.Initialize(value->getType(), "sunk_value");
+    maskSSA.Initialize(mask->getType(), "sunk_mask");
+    valueSSA.AddAvailableValue(L->getLoopPreheader(), llvm::UndefValue::get(value->getType()));
+    maskSSA.AddAvailableValue(L->getLoopPreheader(), llvm::Constant::getNullValue(mask->getType()));
+
+    // The values accumulated before the store are filled in once the
+    // accumulated values after it are known to the updaters, which the
+    // phis in the header depend on.
+    llvm::Value *on = mask;
+    if (!mask->getType()->getScalarType()->isIntegerTy(1)) {
+        on = new llvm::ICmpInst(ISPC_INSERTION_POINT_INSTRUCTION(callInst), llvm::CmpInst::ICMP_NE, mask,
+                                llvm::Constant::getNullValue(mask->getType()), "mask_on");
+    }
+    llvm::SelectInst *newValue =
+        llvm::SelectInst::Create(on, value, llvm::UndefValue::get(value->getType()), "sunk_value",
+                                 ISPC_INSERTION_POINT_INSTRUCTION(callInst));
+    llvm::BinaryOperator *newMask =
+        llvm::BinaryOperator::CreateOr(mask, llvm::UndefValue::get(mask->getType()), "sunk_mask",
+                                       ISPC_INSERTION_POINT_INSTRUCTION(callInst));
+    valueSSA.AddAvailableValue(BB, newValue);
+    maskSSA.AddAvailableValue(BB, newMask);
+    newValue->setOperand(2, valueSSA.GetValueInMiddleOfBlock(BB));
+    newMask->setOperand(1, maskSSA.GetValueInMiddleOfBlock(BB));
+
+    llvm::SmallVector<llvm::BasicBlock *, 4> exits;
+    L->getUniqueExitBlocks(exits);
+    for (llvm::BasicBlock *exit : exits) {
+        llvm::Instruction *insertBefore = &*exit->getFirstInsertionPt();
+        llvm::CallInst *store =
+            LLVMCallInst(callInst->getCalledFunction(), ptr, valueSSA.GetValueInMiddleOfBlock(exit),
+                         maskSSA.GetValueInMiddleOfBlock(exit), "", insertBefore);
+        LLVMCopyMetadata(store, callInst);
+        store->setDebugLoc(callInst->getDebugLoc());
+    }
+    callInst->eraseFromParent();
+}
+
+bool HoistMaskedMemOpsPass::hoistMaskedMemOps(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    if (LI.empty()) {
+        return false;
+    }
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+    llvm::AssumptionCache &AC = FAM.getResult<llvm::AssumptionAnalysis>(F);
+    llvm::AAResults &AA = FAM.getResult<llvm::AAManager>(F);
+    const llvm::DataLayout &DL = F.getParent()->getDataLayout();
+    bool modifiedAny = false;
+
+    // The inner loops are visited before the loops that contain them.
+    llvm::SmallVector<llvm::Loop *, 8> loops = LI.getLoopsInPreorder();
+    for (llvm::Loop *L : llvm::reverse(loops)) {
+        std::vector<llvm::Instruction *> loads, stores;
+        for (llvm::BasicBlock *BB : L->blocks()) {
+            if (LI.getLoopFor(BB) != L) {
+                continue;
+            }
+            for (llvm::Instruction &inst : *BB) {
+                MaskedMemOp op = lGetMaskedMemOp(inst);
+                llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&inst);
+                if (op == MaskedMemOp::Load || (load && load->isSimple())) {
+                    loads.push_back(&inst);
+                } else if (op == MaskedMemOp::Store) {
+                    stores.push_back(&inst);
+                }
+            }
+        }
+        if (loads.empty() && stores.empty()) {
+            continue;
+        }
+        if (L->getLoopPreheader() == nullptr || !L->hasDedicatedExits()) {
+            modifiedAny |= llvm::simplifyLoop(L, &DT, &LI, nullptr, &AC, nullptr, false /* PreserveLCSSA */);
+            if (L->getLoopPreheader() == nullptr || !L->hasDedicatedExits()) {
+                continue;
+            }
+        }
+        llvm::Instruction *preheaderEnd = L->getLoopPreheader()->getTerminator();
+
+        std::vector<llvm::Instruction *> memInsts;
+        for (llvm::BasicBlock *BB : L->blocks()) {
+            for (llvm::Instruction &inst : *BB) {
+                if (inst.mayReadOrWriteMemory()) {
+                    memInsts.push_back(&inst);
+                }
+            }
+        }
+
+        for (llvm::Instruction *inst : loads) {
+            int align = 1;
+            MaskedMemOp op = lGetMaskedMemOp(*inst, &align);
+            llvm::Value *ptr = op == MaskedMemOp::Load ? inst->getOperand(0) : llvm::getLoadStorePointerOperand(inst);
+            bool changed = false;
+            bool invariantPtr = L->makeLoopInvariant(ptr, changed, preheaderEnd);
+            modifiedAny |= changed;
+            if (!invariantPtr) {
+                continue;
+            }
+
+            int64_t size = DL.getTypeStoreSize(inst->getType());
+            llvm::MemoryLocation loc(ptr, llvm::LocationSize::precise(size));
+            if (!lIsInvariant(inst, loc, memInsts, AA, DL) || !lIsDereferenceable(ptr, size, L, DL)) {
+                continue;
+            }
+            lRemove(memInsts, inst);
+            lHoistLoad(inst, align, L, AC);
+            modifiedAny = true;
+        }
+
+        for (llvm::Instruction *inst : stores) {
+            llvm::Value *ptr = inst->getOperand(0);
+            bool changed = false;
+            bool invariantPtr = L->makeLoopInvariant(ptr, changed, preheaderEnd);
+            modifiedAny |= changed;
+            if (!invariantPtr ||
+                !lIsOnlyAccess(inst, lGetMaskedMemOpLocation(*inst, MaskedMemOp::Store, DL), memInsts, AA, DL)) {
+                continue;
+            }
+            lRemove(memInsts, inst);
+            lSinkStore(llvm::cast<llvm::CallInst>(inst), L);
+            modifiedAny = true;
+        }
+    }
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses HoistMaskedMemOpsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("HoistMaskedMemOpsPass::run", F.getName());
+
+    if (!hoistMaskedMemOps(F, FAM)) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    // The loops that weren't in the simplified form were updated in place.
+    llvm::PreservedAnalyses PA;
+    PA.preserve<llvm::DominatorTreeAnalysis>();
+    PA.preserve<llvm::LoopAnalysis>();
+    return PA;
+}
+
+} // namespace ispc
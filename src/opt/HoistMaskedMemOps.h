@@ -0,0 +1,47 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+// This pass moves the masked loads and stores of loop invariant addresses
+// out of the loops.  Such accesses are common in the bodies of foreach
+// loops and under varying ifs, e.g. the load of in[programIndex] with a
+// uniform in that doesn't change in the loop.  LICM leaves them in the
+// loops, as the masked loads may not be executed unconditionally, and the
+// masked stores are calls that it doesn't know about.
+//
+//  A masked load, or a load that isn't executed on every iteration, is
+//  hoisted to the preheader of the loop as an unmasked load, if nothing in
+//  the loop may write to the loaded memory, and the memory is known to be
+//  dereferenceable in the preheader.  It is, if LLVM can prove it from the
+//  pointer (allocas, globals, dereferenceable arguments and assumptions),
+//  or if the same memory is accessed with unmasked loads or stores before
+//  the loop or at the start of its header, with no calls in between that
+//  may free it.  The "restrict" qualifier of the pointer parameters helps
+//  to show that the stores in the loop don't write to the memory.
+//
+//  A masked store that is the only access of its memory in the loop is
+//  sunk to the exits of the loop.  The stored values are blended into a
+//  vector under the mask in the loop, and the masks are or-ed together, so
+//  that the store after the loop writes the last value of each program
+//  instance that was stored, and nothing else.
+//
+//  The loops are visited from the innermost, so that the accesses move out
+//  of the nests of the loops as far as they can.
+
+struct HoistMaskedMemOpsPass : public llvm::PassInfoMixin<HoistMaskedMemOpsPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool hoistMaskedMemOps(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+};
+
+} // namespace ispc
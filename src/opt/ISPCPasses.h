@@ -11,17 +11,34 @@
 #pragma once
 
 #include "CheckIRForXeTarget.h"
+#include "CoherentGathers.h"
+#include "ContractFPOps.h"
+#include "DisableLoopUnroll.h"
 #include "GatherCoalescePass.h"
+#include "HoistMaskedMemOps.h"
 #include "ImproveMemoryOps.h"
+#include "InsertPrefetches.h"
 #include "InstructionSimplify.h"
 #include "IntrinsicsOptPass.h"
+#include "InternalRegCall.h"
+#include "InvariantDivision.h"
 #include "IsCompileTimeConstant.h"
 #include "MangleOpenCLBuiltins.h"
+#include "MaskDataflow.h"
+#include "MaskMultiversioning.h"
+#include "OptReport.h"
 #include "PeepholePass.h"
+#include "PromoteLocalArrays.h"
 #include "RemovePersistentFuncs.h"
 #include "ReplaceMaskedMemOps.h"
 #include "ReplacePseudoMemoryOps.h"
 #include "ReplaceStdlibShiftPass.h"
 #include "ScalarizePass.h"
+#include "ScatterCoalescePass.h"
+#include "SplitReductions.h"
+#include "StreamingStores.h"
+#include "UniformityInference.h"
 #include "XeGatherCoalescePass.h"
+#include "XeLowerSLM.h"
 #include "XeReplaceLLVMIntrinsics.h"
+#include "XeSpecConstants.h"
@@ -7,6 +7,13 @@
 #include "ImproveMemoryOps.h"
 #include "builtins-decl.h"
 
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/ConstantRange.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Operator.h>
 #include <unordered_map>
 
 namespace ispc {
@@ -704,6 +711,119 @@ static bool lOffsets32BitSafe(llvm::Value **offsetPtr, llvm::Instruction *insert
     }
 }
 
+/** Compute a conservative range of the signed values of the elements of
+    the given integer vector of offsets.  The arithmetic that computes the
+    offsets is followed, and the ranges of the other values are taken from
+    LLVM's value tracking, which also knows about the llvm.assume() calls
+    that come from assume() in the ispc source.
+ */
+static llvm::ConstantRange lGetOffsetsRange(llvm::Value *v, llvm::Instruction *ctxInst, llvm::AssumptionCache *AC,
+                                            llvm::DominatorTree *DT, unsigned depth = 0) {
+    unsigned bitWidth = v->getType()->getScalarSizeInBits();
+    int64_t elts[ISPC_MAX_NVEC];
+    int nElts = 0;
+    if (llvm::isa<llvm::FixedVectorType>(v->getType()) && LLVMExtractVectorInts(v, elts, &nElts)) {
+        llvm::ConstantRange range(bitWidth, /* isFullSet */ false);
+        for (int i = 0; i < nElts; ++i) {
+            llvm::ConstantRange elt(llvm::APInt(bitWidth, elts[i], /* isSigned */ true));
+            range = range.unionWith(elt, llvm::ConstantRange::Signed);
+        }
+        return range;
+    }
+
+    if (depth < 6) {
+        if (llvm::isa<llvm::VectorType>(v->getType())) {
+            if (llvm::Value *splat = llvm::getSplatValue(v)) {
+                return lGetOffsetsRange(splat, ctxInst, AC, DT, depth + 1);
+            }
+        }
+        if (llvm::CastInst *ci = llvm::dyn_cast<llvm::CastInst>(v)) {
+            switch (ci->getOpcode()) {
+            case llvm::Instruction::SExt:
+                return lGetOffsetsRange(ci->getOperand(0), ctxInst, AC, DT, depth + 1).signExtend(bitWidth);
+            case llvm::Instruction::ZExt:
+                return lGetOffsetsRange(ci->getOperand(0), ctxInst, AC, DT, depth + 1).zeroExtend(bitWidth);
+            case llvm::Instruction::Trunc:
+                return lGetOffsetsRange(ci->getOperand(0), ctxInst, AC, DT, depth + 1).truncate(bitWidth);
+            default:
+                break;
+            }
+        } else if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(v)) {
+            llvm::Instruction::BinaryOps opcode = IsOrEquivalentToAdd(bop) ? llvm::Instruction::Add : bop->getOpcode();
+            llvm::ConstantRange op0 = lGetOffsetsRange(bop->getOperand(0), ctxInst, AC, DT, depth + 1);
+            llvm::ConstantRange op1 = lGetOffsetsRange(bop->getOperand(1), ctxInst, AC, DT, depth + 1);
+            return op0.binaryOp(opcode, op1);
+        } else if (llvm::SelectInst *si = llvm::dyn_cast<llvm::SelectInst>(v)) {
+            llvm::ConstantRange op0 = lGetOffsetsRange(si->getTrueValue(), ctxInst, AC, DT, depth + 1);
+            llvm::ConstantRange op1 = lGetOffsetsRange(si->getFalseValue(), ctxInst, AC, DT, depth + 1);
+            return op0.unionWith(op1, llvm::ConstantRange::Signed);
+        }
+    }
+
+    return llvm::computeConstantRange(v, /* ForSigned */ true, /* UseInstrInfo */ true, AC, ctxInst, DT);
+}
+
+/** If the given base pointer of a gather or scatter points into an object
+    of known size, i.e. a global variable or a fixed size alloca, return
+    the range of the byte offsets from it that stay inside the object.
+    Accessing memory outside of the object is undefined, so the offsets of
+    the active program instances are in this range.  Otherwise the full
+    range is returned.
+ */
+static llvm::ConstantRange lGetExtentRange(llvm::Value *base, const llvm::DataLayout &DL, unsigned bitWidth) {
+    llvm::ConstantRange fullRange(bitWidth, /* isFullSet */ true);
+
+    // The base pointer usually comes as an integer from ptrtoint.
+    while (!llvm::isa<llvm::PointerType>(base->getType())) {
+        llvm::Operator *op = llvm::dyn_cast<llvm::Operator>(base);
+        if (op == nullptr ||
+            (op->getOpcode() != llvm::Instruction::PtrToInt && op->getOpcode() != llvm::Instruction::BitCast)) {
+            return fullRange;
+        }
+        base = op->getOperand(0);
+    }
+
+    llvm::APInt baseOffset(DL.getIndexTypeSizeInBits(base->getType()), 0);
+    const llvm::Value *object = base->stripAndAccumulateConstantOffsets(DL, baseOffset, /* AllowNonInbounds */ true);
+
+    uint64_t size = 0;
+    if (const llvm::AllocaInst *alloca = llvm::dyn_cast<llvm::AllocaInst>(object)) {
+        const llvm::ConstantInt *count = llvm::dyn_cast<llvm::ConstantInt>(alloca->getArraySize());
+        if (count == nullptr) {
+            return fullRange;
+        }
+        size = DL.getTypeAllocSize(alloca->getAllocatedType()) * count->getZExtValue();
+    } else if (const llvm::GlobalVariable *gv = llvm::dyn_cast<llvm::GlobalVariable>(object)) {
+        if (gv->isDeclaration() || gv->isInterposable()) {
+            return fullRange;
+        }
+        size = DL.getTypeAllocSize(gv->getValueType());
+    }
+    if (size == 0 || size > (uint64_t)INT32_MAX) {
+        return fullRange;
+    }
+
+    int64_t offset = baseOffset.getSExtValue();
+    return llvm::ConstantRange(llvm::APInt(bitWidth, -offset, /* isSigned */ true),
+                               llvm::APInt(bitWidth, (int64_t)size - offset, /* isSigned */ true));
+}
+
+static bool lFitsIn32Bits(const llvm::ConstantRange &range) {
+    return !range.isEmptySet() && range.getSignedMin().getSExtValue() >= INT32_MIN &&
+           range.getSignedMax().getSExtValue() <= INT32_MAX;
+}
+
+/** Return the given 64-bit offsets, which are known to fit in 32 bits, as
+    a vector of 32-bit values. */
+static llvm::Value *lTruncateOffsets(llvm::Value *offset, llvm::Instruction *insertBefore) {
+    llvm::SExtInst *sext = llvm::dyn_cast<llvm::SExtInst>(offset);
+    if (sext != nullptr && sext->getOperand(0)->getType() == LLVMTypes::Int32VectorType) {
+        return sext->getOperand(0);
+    }
+    return new llvm::TruncInst(offset, LLVMTypes::Int32VectorType, llvm::Twine(offset->getName()) + "_trunc",
+                               ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
+}
+
 // Contains a function call substitution info for gather/scatter/prefetch calls.
 // We construct this class objects in program constructors phase, i.e., before initialization of g->target
 // and any of LLVMTypes values. Moreover, g->target values are not same during multi-target compilation. Because of
@@ -759,7 +879,8 @@ struct GSInfo {
     GSInfo::Type type;
 };
 
-static llvm::CallInst *lGSToGSBaseOffsets(llvm::CallInst *callInst) {
+static llvm::CallInst *lGSToGSBaseOffsets(llvm::CallInst *callInst, llvm::AssumptionCache *AC,
+                                          llvm::DominatorTree *DT) {
     // A map for call replacement used in lGSToGSBaseOffsets.
     static std::unordered_map<std::string, GSInfo> replacementRules = {
         {__pseudo_gather32_i8,
@@ -869,6 +990,21 @@ static llvm::CallInst *lGSToGSBaseOffsets(llvm::CallInst *callInst) {
         // to the next instruction...
         return nullptr;
     }
+
+    // Without 32-bit addressing, the offsets are 64-bit values.  They are
+    // still passed to the 32-bit variants of the gather/scatter functions
+    // if they are known to fit in 32 bits, either from the way they are
+    // computed or from the size of the object that the base pointer points
+    // into, so the targets can use the gathers and scatters with 32-bit
+    // indices.
+    bool offsetsFit32 = false;
+    llvm::ConstantRange offsetsRange(64, /* isFullSet */ true);
+    if (!g->opt.force32BitAddressing && !info->isPrefetch() && offsetVector->getType() == LLVMTypes::Int64VectorType) {
+        llvm::ConstantRange extentRange = lGetExtentRange(basePtr, callInst->getModule()->getDataLayout(), 64);
+        offsetsRange = lGetOffsetsRange(offsetVector, callInst, AC, DT);
+        offsetsRange = offsetsRange.intersectWith(extentRange, llvm::ConstantRange::Signed);
+        offsetsFit32 = lFitsIn32Bits(offsetsRange);
+    }
     // Cast the base pointer to a void *, since that's what the
     // __pseudo_*_base_offsets_* functions want.
     basePtr = new llvm::IntToPtrInst(basePtr, LLVMTypes::VoidPointerType, llvm::Twine(basePtr->getName()) + "_2void",
@@ -891,6 +1027,10 @@ static llvm::CallInst *lGSToGSBaseOffsets(llvm::CallInst *callInst) {
         // gather/scatter functions.
         if (g->opt.force32BitAddressing && lOffsets32BitSafe(&offsetVector, callInst)) {
             gatherScatterFunc = info->baseOffsets32Func(M);
+        } else if (offsetsFit32) {
+            // offsetVector * offsetScale are the original offsets.
+            offsetVector = lTruncateOffsets(offsetVector, callInst);
+            gatherScatterFunc = info->baseOffsets32Func(M);
         }
 
         if (info->isGather() || info->isPrefetch()) {
@@ -944,6 +1084,15 @@ static llvm::CallInst *lGSToGSBaseOffsets(llvm::CallInst *callInst) {
         // gather/scatter functions.
         if (g->opt.force32BitAddressing && lOffsets32BitSafe(&variableOffset, &constOffset, callInst)) {
             gatherScatterFunc = info->baseOffsets32Func(M);
+        } else if (offsetsFit32) {
+            // Both variableOffset * offsetScale and constOffset have to fit
+            // in 32 bits, too.
+            llvm::ConstantRange constRange = lGetOffsetsRange(constOffset, callInst, AC, DT);
+            if (lFitsIn32Bits(constRange) && lFitsIn32Bits(offsetsRange.sub(constRange))) {
+                variableOffset = lTruncateOffsets(variableOffset, callInst);
+                constOffset = lTruncateOffsets(constOffset, callInst);
+                gatherScatterFunc = info->baseOffsets32Func(M);
+            }
         }
 
         if (info->isGather() || info->isPrefetch()) {
@@ -1192,6 +1341,105 @@ struct ScatterImpInfo {
     Alignment alignment;
 };
 
+/** Gathers of 32 and 64-bit values from a linear sequence of locations
+    with a small constant stride, as in a[3 * programIndex + k], are
+    transformed to contiguous vector loads of the memory that the gather
+    spans followed by shuffles that pick every stride-th element, like
+    aos_to_soa3() and aos_to_soa4() do.  The loads never go past the last
+    location that is read: the tail of the last load is masked off and, if
+    the mask isn't known to be all on, so are the elements of the inactive
+    lanes and the ones in between the gathered elements.
+ */
+static llvm::Instruction *lGSToStridedLoads(llvm::CallInst *callInst, const GatherImpInfo *info, llvm::Value *base,
+                                            llvm::Value *fullOffsets, llvm::Value *mask, const SourcePos &pos) {
+    constexpr int maxStride = 8;
+    int elementSize = info->align();
+    if (elementSize < 4 || callInst->getType()->getScalarType() != info->scalarType()) {
+        return nullptr;
+    }
+    int stride = 0;
+    for (int s = 2; s <= maxStride && stride == 0; ++s) {
+        if (LLVMVectorIsLinear(fullOffsets, s * elementSize)) {
+            stride = s;
+        }
+    }
+    MaskStatus maskStatus = GetMaskStatusFromValue(mask);
+    if (stride == 0 || maskStatus == MaskStatus::all_off) {
+        return nullptr;
+    }
+
+    int width = g->target->getVectorWidth();
+    // Index of the element read by the last lane; the loads cover the
+    // elements [0, stride * width).
+    int last = (width - 1) * stride;
+    llvm::IRBuilder<> builder(callInst);
+    llvm::Value *laneMask = nullptr;
+    if (maskStatus != MaskStatus::all_on) {
+        laneMask = mask;
+        if (!mask->getType()->getScalarType()->isIntegerTy(1)) {
+            laneMask = builder.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()), "lane_mask");
+        }
+    }
+
+    llvm::Type *vecType = callInst->getType();
+    llvm::Value *ptr = lComputeCommonPointer(base, info->baseType(), fullOffsets, callInst);
+    std::vector<llvm::Value *> loads;
+    for (int chunk = 0; chunk < stride; ++chunk) {
+        int start = chunk * width;
+        llvm::Value *chunkPtr = LLVMGEPInst(ptr, info->baseType(), LLVMInt64((int64_t)start * elementSize),
+                                            "stride_ptr", callInst);
+        chunkPtr = builder.CreateBitCast(chunkPtr, llvm::PointerType::get(vecType, 0), "ptr_cast");
+
+        if (laneMask == nullptr && start + width - 1 <= last) {
+            loads.push_back(builder.CreateAlignedLoad(vecType, chunkPtr, llvm::Align(elementSize), "stride_load"));
+            continue;
+        }
+
+        llvm::Value *loadMask = nullptr;
+        if (laneMask == nullptr) {
+            std::vector<llvm::Constant *> bits;
+            for (int i = 0; i < width; ++i) {
+                bits.push_back(start + i <= last ? LLVMTrue : LLVMFalse);
+            }
+            loadMask = llvm::ConstantVector::get(bits);
+        } else {
+            // Index "width" selects from the all off vector.
+            std::vector<int> shuf;
+            for (int i = 0; i < width; ++i) {
+                shuf.push_back((start + i) % stride == 0 ? (start + i) / stride : width);
+            }
+            loadMask = builder.CreateShuffleVector(laneMask, llvm::Constant::getNullValue(laneMask->getType()), shuf,
+                                                   "load_mask");
+        }
+        loads.push_back(builder.CreateMaskedLoad(vecType, chunkPtr, llvm::Align(elementSize), loadMask, nullptr,
+                                                 "stride_masked_load"));
+    }
+
+    // Merge the elements of the lanes into the result one load after the
+    // other; the lanes not set yet are undefined.
+    llvm::Value *result = nullptr;
+    for (int chunk = 0; chunk < stride; ++chunk) {
+        std::vector<int> shuf;
+        for (int lane = 0; lane < width; ++lane) {
+            int elt = lane * stride;
+            if (elt / width == chunk) {
+                shuf.push_back(elt % width + (result ? width : 0));
+            } else {
+                shuf.push_back(result && elt / width < chunk ? lane : -1);
+            }
+        }
+        result = result ? builder.CreateShuffleVector(result, loads[chunk], shuf, "stride_shuf")
+                        : builder.CreateShuffleVector(loads[chunk], shuf, "stride_shuf");
+    }
+
+    Debug(pos, "Transformed gather with stride %d to %d vector loads and shuffles!", stride, stride);
+    llvm::Instruction *resultInst = llvm::cast<llvm::Instruction>(result);
+    LLVMCopyMetadata(resultInst, callInst);
+    callInst->replaceAllUsesWith(resultInst);
+    callInst->eraseFromParent();
+    return resultInst;
+}
+
 /** After earlier optimization passes have run, we are sometimes able to
     determine that gathers/scatters are actually accessing memory in a more
     regular fashion and then change the operation to something simpler and
@@ -1200,14 +1448,16 @@ struct ScatterImpInfo {
     broadcast.  This pass examines gathers and scatters and tries to
     simplify them if at all possible.
 
+    If lowerStrided is set, gathers from a linear sequence of locations
+    with a small constant stride are handled by lGSToStridedLoads() too.
+
     @todo Currently, this only looks for all program instances going to the
     same location and all going to a linear sequence of locations in
     memory.  There are a number of other cases that might make sense to
-    look for, including things that could be handled with a vector load +
-    shuffle or things that could be handled with hybrids of e.g. 2 4-wide
-    vector loads with AVX, etc.
+    look for, including things that could be handled with hybrids of e.g.
+    2 4-wide vector loads with AVX, etc.
 */
-static llvm::Instruction *lGSToLoadStore(llvm::CallInst *callInst) {
+static llvm::Instruction *lGSToLoadStore(llvm::CallInst *callInst, bool lowerStrided) {
 
     static GatherImpInfo GII_i8 =
         GatherImpInfo(__masked_load_i8, __masked_load_blend_i8, &LLVMTypes::Int8Type, Alignment::A1);
@@ -1447,9 +1697,44 @@ static llvm::Instruction *lGSToLoadStore(llvm::CallInst *callInst) {
             llvm::ReplaceInstWithInst(callInst, newCall);
             return newCall;
         }
+        bool stridedOk = lowerStrided && gatherInfo != nullptr;
+#ifdef ISPC_XE_ENABLED
+        stridedOk = stridedOk && !g->target->isXeTarget();
+#endif
+        if (stridedOk) {
+            return lGSToStridedLoads(callInst, gatherInfo, base, fullOffsets, mask, pos);
+        }
+        return nullptr;
+    }
+}
+
+#ifdef ISPC_XE_ENABLED
+/** On Xe2, unit-stride masked loads and stores from global memory can be done
+    with a single LSC block message instead of a gather or scatter. Block
+    messages need the address to be aligned to the block element, which is
+    4 bytes for 1, 2 and 4 byte types and 8 bytes for 8 byte types, so this
+    returns the __masked_{load,store}_block_* builtin only when that alignment
+    can be proven. The builtin checks the mask at runtime and falls back to
+    the regular masked operation when the block message can't be used.
+ */
+static llvm::Function *lXeBlockMemOpFunc(llvm::CallInst *callInst, llvm::Value *ptr, const char *blockName,
+                                         int elementSize, llvm::AssumptionCache *AC) {
+    if (!g->target->isXeTarget() || !g->target->hasXeLSCBlockMemOps() || g->opt.disableXeBlockMemOps ||
+        blockName == nullptr) {
+        return nullptr;
+    }
+    if (GetAddressSpace(ptr) != AddressSpace::ispc_global) {
+        return nullptr;
+    }
+    int requiredAlign = elementSize == 8 ? 8 : 4;
+    int align = g->opt.forceAlignedMemory ? g->target->getNativeVectorAlignment()
+                                          : LLVMGetKnownAlignment(ptr, elementSize, callInst, AC);
+    if (align < requiredAlign) {
         return nullptr;
     }
+    return callInst->getModule()->getFunction(blockName);
 }
+#endif
 
 ///////////////////////////////////////////////////////////////////////////
 // MaskedStoreOptPass
@@ -1460,7 +1745,7 @@ static llvm::Instruction *lGSToLoadStore(llvm::CallInst *callInst) {
     with regular stores or removed entirely, for the cases of an 'all on'
     mask and an 'all off' mask, respectively.
 */
-static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
+static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst, llvm::AssumptionCache *AC) {
     static std::unordered_map<std::string, Alignment> maskedStoreAlign = {
         {__pseudo_masked_store_i8, Alignment::A1},
         {__pseudo_masked_store_i16, Alignment::A2},
@@ -1516,9 +1801,12 @@ static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
         lvalue =
             new llvm::BitCastInst(lvalue, ptrType, "lvalue_to_ptr_type", ISPC_INSERTION_POINT_INSTRUCTION(callInst));
         LLVMCopyMetadata(lvalue, callInst);
-        store = new llvm::StoreInst(
-            rvalue, lvalue, false /* not volatile */,
-            llvm::MaybeAlign(g->opt.forceAlignedMemory ? g->target->getNativeVectorAlignment() : align).valueOrOne());
+        if (g->opt.forceAlignedMemory) {
+            align = g->target->getNativeVectorAlignment();
+        } else {
+            align = LLVMGetKnownAlignment(lvalue, align, callInst, AC);
+        }
+        store = new llvm::StoreInst(rvalue, lvalue, false /* not volatile */, llvm::MaybeAlign(align).valueOrOne());
 
         if (store != nullptr) {
             LLVMCopyMetadata(store, callInst);
@@ -1528,6 +1816,30 @@ static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
 
 #ifdef ISPC_XE_ENABLED
     } else {
+        static std::unordered_map<std::string, const char *> blockStore = {
+            {__pseudo_masked_store_i8, __masked_store_block_i8},
+            {__pseudo_masked_store_i16, __masked_store_block_i16},
+            {__pseudo_masked_store_half, __masked_store_block_half},
+            {__pseudo_masked_store_i32, __masked_store_block_i32},
+            {__pseudo_masked_store_float, __masked_store_block_float},
+            {__pseudo_masked_store_i64, __masked_store_block_i64},
+            {__pseudo_masked_store_double, __masked_store_block_double},
+            {__masked_store_i8, __masked_store_block_i8},
+            {__masked_store_i16, __masked_store_block_i16},
+            {__masked_store_half, __masked_store_block_half},
+            {__masked_store_i32, __masked_store_block_i32},
+            {__masked_store_float, __masked_store_block_float},
+            {__masked_store_i64, __masked_store_block_i64},
+            {__masked_store_double, __masked_store_block_double},
+        };
+        auto blockIt = blockStore.find(name);
+        const char *blockName = blockIt != blockStore.end() ? blockIt->second : nullptr;
+        if (llvm::Function *blockFunc = lXeBlockMemOpFunc(callInst, lvalue, blockName, align, AC)) {
+            llvm::Instruction *blockStoreCall = LLVMCallInst(blockFunc, lvalue, rvalue, mask, "");
+            LLVMCopyMetadata(blockStoreCall, callInst);
+            llvm::ReplaceInstWithInst(callInst, blockStoreCall);
+            return blockStoreCall;
+        }
         if (g->target->isXeTarget() && GetAddressSpace(lvalue) == AddressSpace::ispc_global) {
             // In this case we use masked_store which on Xe target causes scatter usage.
             // Get the source position from the metadata attached to the call
@@ -1543,7 +1855,8 @@ static llvm::Value *lImproveMaskedStore(llvm::CallInst *callInst) {
     return nullptr;
 }
 
-static llvm::Value *lImproveMaskedLoad(llvm::CallInst *callInst, llvm::BasicBlock::iterator iter) {
+static llvm::Value *lImproveMaskedLoad(llvm::CallInst *callInst, llvm::BasicBlock::iterator iter,
+                                       llvm::AssumptionCache *AC) {
     static std::unordered_map<std::string, Alignment> maskedLoadAlign = {
         {__masked_load_i8, Alignment::A1},        {__masked_load_i16, Alignment::A2},
         {__masked_load_half, Alignment::A2},      {__masked_load_i32, Alignment::A4},
@@ -1579,20 +1892,44 @@ static llvm::Value *lImproveMaskedLoad(llvm::CallInst *callInst, llvm::BasicBloc
         llvm::Type *ptrType = llvm::PointerType::get(callInst->getType(), 0);
         ptr = new llvm::BitCastInst(ptr, ptrType, "ptr_cast_for_load", ISPC_INSERTION_POINT_INSTRUCTION(callInst));
         Assert(llvm::isa<llvm::PointerType>(ptr->getType()));
-        load = new llvm::LoadInst(
-            callInst->getType(), ptr, callInst->getName(), false /* not volatile */,
-            llvm::MaybeAlign(g->opt.forceAlignedMemory ? g->target->getNativeVectorAlignment() : align).valueOrOne());
+        if (g->opt.forceAlignedMemory) {
+            align = g->target->getNativeVectorAlignment();
+        } else {
+            align = LLVMGetKnownAlignment(ptr, align, callInst, AC);
+        }
+        load = new llvm::LoadInst(callInst->getType(), ptr, callInst->getName(), false /* not volatile */,
+                                  llvm::MaybeAlign(align).valueOrOne());
 
         if (load != nullptr) {
             LLVMCopyMetadata(load, callInst);
             llvm::ReplaceInstWithInst(callInst, load);
             return load;
         }
+#ifdef ISPC_XE_ENABLED
+    } else {
+        // The blend version is left alone: it is only emitted when the user
+        // asked for unsafe masked loads.
+        static std::unordered_map<std::string, const char *> blockLoad = {
+            {__masked_load_i8, __masked_load_block_i8},       {__masked_load_i16, __masked_load_block_i16},
+            {__masked_load_half, __masked_load_block_half},   {__masked_load_i32, __masked_load_block_i32},
+            {__masked_load_float, __masked_load_block_float}, {__masked_load_i64, __masked_load_block_i64},
+            {__masked_load_double, __masked_load_block_double},
+        };
+        auto blockIt = blockLoad.find(name);
+        const char *blockName = blockIt != blockLoad.end() ? blockIt->second : nullptr;
+        if (llvm::Function *blockFunc = lXeBlockMemOpFunc(callInst, ptr, blockName, align, AC)) {
+            llvm::Instruction *blockLoadCall = LLVMCallInst(blockFunc, ptr, mask, callInst->getName());
+            LLVMCopyMetadata(blockLoadCall, callInst);
+            llvm::ReplaceInstWithInst(callInst, blockLoadCall);
+            return blockLoadCall;
+        }
+#endif
     }
     return nullptr;
 }
 
-bool ImproveMemoryOpsPass::improveMemoryOps(llvm::BasicBlock &bb) {
+bool ImproveMemoryOpsPass::improveMemoryOps(llvm::BasicBlock &bb, llvm::AssumptionCache &AC,
+                                            llvm::DominatorTree &DT) {
     DEBUG_START_BB("ImproveMemoryOps");
 
     bool modifiedAny = false;
@@ -1607,15 +1944,15 @@ bool ImproveMemoryOpsPass::improveMemoryOps(llvm::BasicBlock &bb) {
         while (callInst && callInst->getCalledFunction()) {
             llvm::Value *newValue = nullptr;
 
-            if ((newValue = lGSToGSBaseOffsets(callInst))) {
+            if ((newValue = lGSToGSBaseOffsets(callInst, &AC, &DT))) {
                 modifiedAny = true;
             } else if ((newValue = lGSBaseOffsetsGetMoreConst(callInst))) {
                 modifiedAny = true;
-            } else if ((newValue = lGSToLoadStore(callInst))) {
+            } else if ((newValue = lGSToLoadStore(callInst, lowerStrided))) {
                 modifiedAny = true;
-            } else if ((newValue = lImproveMaskedStore(callInst))) {
+            } else if ((newValue = lImproveMaskedStore(callInst, &AC))) {
                 modifiedAny = true;
-            } else if ((newValue = lImproveMaskedLoad(callInst, curIter))) {
+            } else if ((newValue = lImproveMaskedLoad(callInst, curIter, &AC))) {
                 modifiedAny = true;
             }
 
@@ -1640,8 +1977,13 @@ llvm::PreservedAnalyses ImproveMemoryOpsPass::run(llvm::Function &F, llvm::Funct
     llvm::TimeTraceScope FuncScope("ImproveMemoryOpsPass::run", F.getName());
     bool modifiedAny = false;
 
+    // The assumptions are used to find out the alignment of the pointers
+    // of the loads and stores, and the ranges of the offsets of the gathers
+    // and scatters.
+    llvm::AssumptionCache &AC = FAM.getResult<llvm::AssumptionAnalysis>(F);
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
     for (llvm::BasicBlock &BB : F) {
-        modifiedAny |= improveMemoryOps(BB);
+        modifiedAny |= improveMemoryOps(BB, AC, DT);
     }
     if (!modifiedAny) {
         // No changes, all analyses are preserved.
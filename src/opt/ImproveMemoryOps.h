@@ -19,13 +19,26 @@ namespace ispc {
 
     See for example the comments discussing the __pseudo_gather functions
     in builtins.cpp for more information about this.
+
+    If lowerStrided is set, gathers with a small constant stride are also
+    turned into vector loads and shuffles.  This is done only after
+    GatherCoalescePass has run, which does better with the gathers of the
+    fields of the same structures.
+
+    With 64-bit addressing, the 32-bit variants of the gathers and scatters
+    are still used when the offsets are known to fit in 32 bits, from the
+    arithmetic that computes them, assume() bounds, or the size of the
+    global variable or local array that is indexed.
  */
 struct ImproveMemoryOpsPass : public llvm::PassInfoMixin<ImproveMemoryOpsPass> {
 
+    ImproveMemoryOpsPass(bool strided = false) : lowerStrided(strided) {}
+
     llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
   private:
-    bool improveMemoryOps(llvm::BasicBlock &BB);
+    bool lowerStrided;
+    bool improveMemoryOps(llvm::BasicBlock &BB, llvm::AssumptionCache &AC, llvm::DominatorTree &DT);
 };
 
 } // namespace ispc
@@ -0,0 +1,522 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "InsertPrefetches.h"
+#include "builtins-decl.h"
+
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Transforms/Utils/ScalarEvolutionExpander.h>
+
+#include <set>
+#include <unordered_map>
+
+namespace ispc {
+
+using namespace builtin;
+
+// How the operands of a base+offsets gather are laid out.
+enum class GatherKind {
+    None,
+    // @__pseudo_gather_base_offsets{32,64}_*(i8 *base, i32 scale, <WIDTH x i{32,64}> offsets, <WIDTH x MASK>)
+    BaseOffsets,
+    // @__pseudo_gather_factored_base_offsets{32,64}_*(i8 *base, <WIDTH x i{32,64}> varyingOffsets, i32 scale,
+    //                                                 <WIDTH x i{32,64}> constOffsets, <WIDTH x MASK>)
+    Factored,
+};
+
+static GatherKind lGetGatherKind(llvm::CallInst *callInst) {
+    static std::unordered_map<std::string, GatherKind> gathers = {
+        {__pseudo_gather_base_offsets32_i8, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_i16, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_half, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_i32, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_float, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_i64, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets32_double, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_i8, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_i16, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_half, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_i32, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_float, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_i64, GatherKind::BaseOffsets},
+        {__pseudo_gather_base_offsets64_double, GatherKind::BaseOffsets},
+        {__pseudo_gather_factored_base_offsets32_i8, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_i16, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_half, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_i32, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_float, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_i64, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets32_double, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_i8, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_i16, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_half, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_i32, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_float, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_i64, GatherKind::Factored},
+        {__pseudo_gather_factored_base_offsets64_double, GatherKind::Factored},
+    };
+
+    llvm::Function *calledFunc = callInst->getCalledFunction();
+    if (calledFunc == nullptr) {
+        return GatherKind::None;
+    }
+    auto it = gathers.find(calledFunc->getName().str());
+    return it == gathers.end() ? GatherKind::None : it->second;
+}
+
+static bool lIsMaskedLoad(llvm::CallInst *callInst) {
+    static std::set<std::string> maskedLoads = {
+        __masked_load_i8,  __masked_load_i16, __masked_load_half,  __masked_load_i32,
+        __masked_load_i64, __masked_load_float, __masked_load_double,
+    };
+
+    llvm::Function *calledFunc = callInst->getCalledFunction();
+    return calledFunc != nullptr && maskedLoads.find(calledFunc->getName().str()) != maskedLoads.end();
+}
+
+/** Xe targets with LSC prefetch messages also get prefetches for the loads
+    and gathers whose addresses advance by a constant stride, since their
+    loads have a long latency and there are no hardware prefetchers. */
+static bool lUseXePrefetch() {
+#ifdef ISPC_XE_ENABLED
+    return g->target->isXeTarget() && g->target->hasXePrefetch();
+#else
+    return false;
+#endif
+}
+
+/** Returns the function that prefetches a vector of addresses of the given
+    type into the cache of the given level, 1 or 3, or nullptr if there is
+    none. */
+static llvm::Function *lGetPrefetchFunc(llvm::Module *M, int level, llvm::FixedVectorType *addrType) {
+    const char *name = nullptr;
+    if (lUseXePrefetch()) {
+        name = level == 1 ? __prefetch_read_sized_varying_1 : __prefetch_read_sized_varying_3;
+    } else if (level == 1) {
+        name = __pseudo_prefetch_read_varying_1;
+    }
+    llvm::Function *func = name != nullptr ? M->getFunction(name) : nullptr;
+    if (func == nullptr || func->getFunctionType()->getNumParams() != (lUseXePrefetch() ? 3 : 2) ||
+        func->getFunctionType()->getParamType(0) != addrType) {
+        return nullptr;
+    }
+    return func;
+}
+
+/** Emits a call of the given prefetch function for the given addresses,
+    with the source position of access. */
+static void lEmitPrefetch(llvm::IRBuilder<> &B, llvm::Function *func, llvm::Value *addrs, llvm::Instruction *access) {
+    // Prefetches don't fault, so there's no need to mask off lanes that
+    // may turn out to be inactive.
+    llvm::FunctionType *funcType = func->getFunctionType();
+    llvm::Value *mask = llvm::Constant::getAllOnesValue(funcType->getParamType(funcType->getNumParams() - 1));
+    llvm::CallInst *prefetch = nullptr;
+    if (funcType->getNumParams() == 3) {
+        // The data size of the Xe prefetch message, the same default as
+        // prefetch_l1() and friends use.
+        llvm::Value *dataSize = llvm::ConstantInt::get(funcType->getParamType(1), 4);
+        prefetch = B.CreateCall(func, {addrs, dataSize, mask});
+    } else {
+        prefetch = B.CreateCall(func, {addrs, mask});
+    }
+    LLVMCopyMetadata(prefetch, access);
+}
+
+/** Returns the addresses base + offsets * scale (+ constOffsets) that a
+    base+offsets gather reads. */
+static llvm::Value *lGatherAddresses(llvm::IRBuilder<> &B, llvm::Value *base, llvm::Value *offsets,
+                                     llvm::ConstantInt *scale, llvm::Value *constOffsets,
+                                     llvm::FixedVectorType *addrType) {
+    int width = addrType->getNumElements();
+    llvm::Value *addrOffsets = B.CreateSExtOrTrunc(offsets, addrType);
+    addrOffsets = B.CreateMul(addrOffsets, B.CreateVectorSplat(width, B.CreateSExt(scale, LLVMTypes::Int64Type)));
+    if (constOffsets != nullptr) {
+        addrOffsets = B.CreateAdd(addrOffsets, B.CreateSExtOrTrunc(constOffsets, addrType));
+    }
+    llvm::Value *baseInt = B.CreatePtrToInt(base, LLVMTypes::Int64Type);
+    return B.CreateAdd(B.CreateVectorSplat(width, baseInt), addrOffsets, "prefetch_addrs");
+}
+
+/** Returns the number of bytes between the vectors of a contiguous stream
+    that the given load reads in the loop, i.e. the size of the vector if
+    its address advances by it in each iteration, or 0 otherwise.  The load
+    has to run in every iteration that goes on to the next one, so that all
+    of the stream up to the next to last iteration is known to be there.
+ */
+static int64_t lGetStreamStride(llvm::LoadInst *load, llvm::Loop *L, llvm::ScalarEvolution &SE,
+                                llvm::DominatorTree &DT) {
+    llvm::FixedVectorType *vecType = llvm::dyn_cast<llvm::FixedVectorType>(load->getType());
+    if (!load->isSimple() || vecType == nullptr || !vecType->getElementType()->isIntegerTy()) {
+        return 0;
+    }
+    llvm::BasicBlock *latch = L->getLoopLatch();
+    if (latch == nullptr || !DT.dominates(load->getParent(), latch)) {
+        return 0;
+    }
+
+    const llvm::SCEVAddRecExpr *addRec =
+        llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(load->getPointerOperand()));
+    if (addRec == nullptr || addRec->getLoop() != L || !addRec->isAffine()) {
+        return 0;
+    }
+    const llvm::SCEVConstant *step = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getStepRecurrence(SE));
+    int64_t size = load->getModule()->getDataLayout().getTypeStoreSize(vecType);
+    if (step == nullptr || step->getAPInt().getSExtValue() != size) {
+        return 0;
+    }
+    return size;
+}
+
+/** Finds the load of a contiguous stream of indices in the loop that the
+    given varying offsets are computed from, with casts and arithmetic with
+    loop-invariant values.  The instructions that compute the offsets from
+    the loaded indices are added to chain, in the order in which they have
+    to be emitted.  Returns nullptr if there's no such load.
+ */
+static llvm::LoadInst *lFindIndexLoad(llvm::Value *offsets, llvm::Loop *L, llvm::ScalarEvolution &SE,
+                                      llvm::DominatorTree &DT, std::vector<llvm::Instruction *> &chain,
+                                      int depth = 0) {
+    llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(offsets);
+    if (inst == nullptr || !L->contains(inst) || depth > 8) {
+        return nullptr;
+    }
+
+    if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+        return lGetStreamStride(load, L, SE, DT) != 0 ? load : nullptr;
+    }
+
+    llvm::Value *varyingOperand = nullptr;
+    if (llvm::isa<llvm::SExtInst>(inst) || llvm::isa<llvm::ZExtInst>(inst) || llvm::isa<llvm::TruncInst>(inst)) {
+        varyingOperand = inst->getOperand(0);
+    } else if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(inst)) {
+        switch (bop->getOpcode()) {
+        case llvm::Instruction::Add:
+        case llvm::Instruction::Sub:
+        case llvm::Instruction::Mul:
+        case llvm::Instruction::Shl:
+        case llvm::Instruction::And:
+        case llvm::Instruction::Or:
+            break;
+        default:
+            return nullptr;
+        }
+        bool invariant0 = L->isLoopInvariant(bop->getOperand(0));
+        bool invariant1 = L->isLoopInvariant(bop->getOperand(1));
+        if (invariant0 == invariant1) {
+            return nullptr;
+        }
+        varyingOperand = invariant0 ? bop->getOperand(1) : bop->getOperand(0);
+    } else {
+        return nullptr;
+    }
+
+    llvm::LoadInst *load = lFindIndexLoad(varyingOperand, L, SE, DT, chain, depth + 1);
+    if (load != nullptr) {
+        chain.push_back(inst);
+    }
+    return load;
+}
+
+/** Returns true if expanding the given expression could divide by a value
+    that isn't known not to be zero.
+ */
+static bool lMayDivideByZero(const llvm::SCEV *S) {
+    return llvm::SCEVExprContains(S, [](const llvm::SCEV *E) {
+        const llvm::SCEVUDivExpr *div = llvm::dyn_cast<llvm::SCEVUDivExpr>(E);
+        return div != nullptr && !llvm::isa<llvm::SCEVConstant>(div->getRHS());
+    });
+}
+
+bool InsertPrefetchesPass::insertPrefetches(llvm::CallInst *gather, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE,
+                                            llvm::DominatorTree &DT) {
+    llvm::Loop *L = LI.getLoopFor(gather->getParent());
+    if (L == nullptr) {
+        return false;
+    }
+
+    bool factored = lGetGatherKind(gather) == GatherKind::Factored;
+    llvm::Value *base = gather->getArgOperand(0);
+    llvm::Value *offsets = gather->getArgOperand(factored ? 1 : 2);
+    llvm::ConstantInt *scale = llvm::dyn_cast<llvm::ConstantInt>(gather->getArgOperand(factored ? 2 : 1));
+    llvm::Value *constOffsets = factored ? gather->getArgOperand(3) : nullptr;
+    if (!L->isLoopInvariant(base) || scale == nullptr ||
+        (constOffsets != nullptr && !L->isLoopInvariant(constOffsets))) {
+        return false;
+    }
+
+    std::vector<llvm::Instruction *> chain;
+    llvm::LoadInst *indexLoad = lFindIndexLoad(offsets, L, SE, DT, chain);
+    if (indexLoad == nullptr) {
+        return false;
+    }
+
+    // The vectors of indices that are loaded in the iterations that go on
+    // to the next one are known to be there, so the one for the iteration
+    // before the last one, start + (backedge taken count - 1) * stride,
+    // bounds the ones that may be loaded ahead.
+    const llvm::SCEV *btc = SE.getBackedgeTakenCount(L);
+    if (llvm::isa<llvm::SCEVCouldNotCompute>(btc) || btc->isZero()) {
+        return false;
+    }
+    const llvm::SCEVAddRecExpr *addRec = llvm::cast<llvm::SCEVAddRecExpr>(SE.getSCEV(indexLoad->getPointerOperand()));
+    const llvm::SCEV *last = addRec->evaluateAtIteration(SE.getMinusSCEV(btc, SE.getOne(btc->getType())), SE);
+    if (!SE.isLoopInvariant(last, L) || lMayDivideByZero(last)) {
+        return false;
+    }
+
+    llvm::Module *M = gather->getModule();
+    int width = llvm::cast<llvm::FixedVectorType>(offsets->getType())->getNumElements();
+    llvm::FixedVectorType *addrType = llvm::FixedVectorType::get(LLVMTypes::Int64Type, width);
+    llvm::Function *prefetchFunc = lGetPrefetchFunc(M, 1, addrType);
+    if (prefetchFunc == nullptr) {
+        return false;
+    }
+
+    const llvm::DataLayout &DL = M->getDataLayout();
+    int64_t stride = lGetStreamStride(indexLoad, L, SE, DT);
+    llvm::Value *indexPtr = indexLoad->getPointerOperand();
+    llvm::SCEVExpander expander(SE, DL, "prefetch");
+    llvm::Value *lastPtr = expander.expandCodeFor(last, indexPtr->getType(), gather);
+
+    // Load the indices distance iterations ahead, clamped to
+    // [current, last] so that they're in bounds.
+    llvm::IRBuilder<> B(gather);
+    llvm::Type *intPtrType = DL.getIntPtrType(indexPtr->getType());
+    llvm::Value *current = B.CreatePtrToInt(indexPtr, intPtrType, "prefetch_current");
+    llvm::Value *lastInt = B.CreatePtrToInt(lastPtr, intPtrType, "prefetch_last");
+    llvm::Value *ahead =
+        B.CreateAdd(current, llvm::ConstantInt::get(intPtrType, stride * g->opt.prefetchDistance), "prefetch_ahead");
+    ahead = B.CreateSelect(B.CreateICmpULT(ahead, lastInt), ahead, lastInt);
+    ahead = B.CreateSelect(B.CreateICmpULT(ahead, current), current, ahead, "prefetch_ahead_clamped");
+    llvm::Value *aheadPtr = B.CreateIntToPtr(ahead, indexPtr->getType());
+    llvm::Value *aheadIndices = B.CreateAlignedLoad(indexLoad->getType(), aheadPtr,
+                                                    llvm::commonAlignment(indexLoad->getAlign(), stride),
+                                                    "prefetch_indices");
+
+    // Compute the offsets from them the same way as the gather does.
+    std::unordered_map<llvm::Value *, llvm::Value *> clones = {{indexLoad, aheadIndices}};
+    for (llvm::Instruction *inst : chain) {
+        llvm::Instruction *clone = inst->clone();
+        for (unsigned i = 0; i < clone->getNumOperands(); ++i) {
+            auto it = clones.find(clone->getOperand(i));
+            if (it != clones.end()) {
+                clone->setOperand(i, it->second);
+            }
+        }
+        B.Insert(clone, inst->getName() + "_prefetch");
+        clones[inst] = clone;
+    }
+    llvm::Value *aheadOffsets = clones[offsets];
+
+    llvm::Value *addrs = lGatherAddresses(B, base, aheadOffsets, scale, constOffsets, addrType);
+    lEmitPrefetch(B, prefetchFunc, addrs, gather);
+
+    return true;
+}
+
+/** Returns true and sets step to the amount by which the given value
+    changes in each iteration of the loop, in bytes for pointers, if it's
+    loop-invariant or an affine recurrence of the loop with a constant
+    step. */
+static bool lGetConstantStep(llvm::Value *value, llvm::Loop *L, llvm::ScalarEvolution &SE, int64_t &step) {
+    step = 0;
+    if (L->isLoopInvariant(value)) {
+        return true;
+    }
+    if (!SE.isSCEVable(value->getType())) {
+        return false;
+    }
+    const llvm::SCEV *S = SE.getSCEV(value);
+    if (SE.isLoopInvariant(S, L)) {
+        return true;
+    }
+    const llvm::SCEVAddRecExpr *addRec = llvm::dyn_cast<llvm::SCEVAddRecExpr>(S);
+    if (addRec == nullptr || addRec->getLoop() != L || !addRec->isAffine()) {
+        return false;
+    }
+    const llvm::SCEVConstant *stepConst = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getStepRecurrence(SE));
+    if (stepConst == nullptr) {
+        return false;
+    }
+    step = stepConst->getAPInt().getSExtValue();
+    return true;
+}
+
+/** Returns the scalar value that the given vector of offsets is a splat
+    of, possibly plus a constant vector, like the offsets of a strided
+    gather in a foreach loop, or nullptr otherwise. */
+static llvm::Value *lGetSplatScalar(llvm::Value *offsets) {
+    if (llvm::Value *scalar = llvm::getSplatValue(offsets)) {
+        return scalar;
+    }
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(offsets);
+    if (bop != nullptr && bop->getOpcode() == llvm::Instruction::Add) {
+        if (llvm::isa<llvm::Constant>(bop->getOperand(1))) {
+            return lGetSplatScalar(bop->getOperand(0));
+        }
+        if (llvm::isa<llvm::Constant>(bop->getOperand(0))) {
+            return lGetSplatScalar(bop->getOperand(1));
+        }
+    }
+    return nullptr;
+}
+
+bool InsertPrefetchesPass::insertXePrefetches(llvm::Instruction *access, llvm::LoopInfo &LI,
+                                              llvm::ScalarEvolution &SE) {
+    llvm::Loop *L = LI.getLoopFor(access->getParent());
+    if (L == nullptr) {
+        return false;
+    }
+
+    llvm::Module *M = access->getModule();
+    const llvm::DataLayout &DL = M->getDataLayout();
+    llvm::FixedVectorType *accessType = nullptr;
+    llvm::Value *ptr = nullptr;
+    llvm::Value *base = nullptr, *offsets = nullptr, *constOffsets = nullptr;
+    llvm::ConstantInt *scale = nullptr;
+    int64_t advance = 0;
+    llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(access);
+    if (callInst != nullptr && lGetGatherKind(callInst) != GatherKind::None) {
+        // The offsets of a strided gather are a splat of a value that
+        // advances with the loop, e.g. the index of a foreach loop times
+        // the stride, plus constant offsets of the program instances.
+        bool factored = lGetGatherKind(callInst) == GatherKind::Factored;
+        base = callInst->getArgOperand(0);
+        offsets = callInst->getArgOperand(factored ? 1 : 2);
+        scale = llvm::dyn_cast<llvm::ConstantInt>(callInst->getArgOperand(factored ? 2 : 1));
+        constOffsets = factored ? callInst->getArgOperand(3) : nullptr;
+        llvm::Value *scalar = lGetSplatScalar(offsets);
+        int64_t baseStep = 0, scalarStep = 0;
+        if (scale == nullptr || scalar == nullptr || (constOffsets != nullptr && !L->isLoopInvariant(constOffsets)) ||
+            !lGetConstantStep(base, L, SE, baseStep) || !lGetConstantStep(scalar, L, SE, scalarStep)) {
+            return false;
+        }
+        accessType = llvm::cast<llvm::FixedVectorType>(offsets->getType());
+        advance = baseStep + scalarStep * scale->getSExtValue();
+    } else {
+        // A contiguous load, which is a vector load or a masked load
+        // here.
+        ptr = llvm::isa<llvm::LoadInst>(access) ? llvm::cast<llvm::LoadInst>(access)->getPointerOperand()
+                                                : callInst->getArgOperand(0);
+        accessType = llvm::dyn_cast<llvm::FixedVectorType>(access->getType());
+        if (accessType == nullptr || !lGetConstantStep(ptr, L, SE, advance)) {
+            return false;
+        }
+    }
+    if (advance == 0) {
+        return false;
+    }
+
+    int width = accessType->getNumElements();
+    llvm::FixedVectorType *addrType = llvm::FixedVectorType::get(LLVMTypes::Int64Type, width);
+    llvm::Function *prefetchL1 = lGetPrefetchFunc(M, 1, addrType);
+    llvm::Function *prefetchL3 = lGetPrefetchFunc(M, 3, addrType);
+    if (prefetchL1 == nullptr || prefetchL3 == nullptr) {
+        return false;
+    }
+
+    llvm::IRBuilder<> B(access);
+    llvm::Value *addrs = nullptr;
+    if (ptr != nullptr) {
+        // The addresses of the elements that the program instances load.
+        int64_t elementSize = DL.getTypeStoreSize(accessType->getElementType());
+        std::vector<llvm::Constant *> laneOffsets;
+        for (int i = 0; i < width; ++i) {
+            laneOffsets.push_back(llvm::ConstantInt::get(LLVMTypes::Int64Type, i * elementSize));
+        }
+        llvm::Value *ptrInt = B.CreatePtrToInt(ptr, LLVMTypes::Int64Type);
+        addrs = B.CreateAdd(B.CreateVectorSplat(width, ptrInt), llvm::ConstantVector::get(laneOffsets),
+                            "prefetch_addrs");
+    } else {
+        addrs = lGatherAddresses(B, base, offsets, scale, constOffsets, addrType);
+    }
+
+    // The loads from memory take longer than the ones from L3, so the data
+    // is prefetched into L3 twice as far ahead as into L1.
+    int64_t distance = g->opt.prefetchDistance;
+    llvm::Value *aheadL1 = B.CreateAdd(
+        addrs, B.CreateVectorSplat(width, llvm::ConstantInt::get(LLVMTypes::Int64Type, advance * distance)),
+        "prefetch_l1_addrs");
+    llvm::Value *aheadL3 = B.CreateAdd(
+        addrs, B.CreateVectorSplat(width, llvm::ConstantInt::get(LLVMTypes::Int64Type, 2 * advance * distance)),
+        "prefetch_l3_addrs");
+    lEmitPrefetch(B, prefetchL1, aheadL1, access);
+    lEmitPrefetch(B, prefetchL3, aheadL3, access);
+
+    return true;
+}
+
+llvm::PreservedAnalyses InsertPrefetchesPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("InsertPrefetchesPass::run", F.getName());
+
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    if (LI.empty()) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+
+    std::vector<llvm::CallInst *> gathers;
+    std::vector<llvm::Instruction *> loads;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I);
+            if (callInst != nullptr && lGetGatherKind(callInst) != GatherKind::None) {
+                gathers.push_back(callInst);
+            } else if ((callInst != nullptr && lIsMaskedLoad(callInst)) ||
+                       (llvm::isa<llvm::LoadInst>(&I) && llvm::cast<llvm::LoadInst>(&I)->isSimple() &&
+                        I.getType()->isVectorTy())) {
+                loads.push_back(&I);
+            }
+        }
+    }
+
+    // Gathers with the same base pointer and varying offsets, e.g. of the
+    // members of a structure, access the same cache lines, so only the
+    // first of them is prefetched for.
+    bool modifiedAny = false;
+    std::set<std::pair<llvm::Value *, llvm::Value *>> prefetched;
+    for (llvm::CallInst *gather : gathers) {
+        bool factored = lGetGatherKind(gather) == GatherKind::Factored;
+        std::pair<llvm::Value *, llvm::Value *> key(gather->getArgOperand(0), gather->getArgOperand(factored ? 1 : 2));
+        if (prefetched.find(key) != prefetched.end()) {
+            continue;
+        }
+        if (insertPrefetches(gather, LI, SE, DT) || (lUseXePrefetch() && insertXePrefetches(gather, LI, SE))) {
+            prefetched.insert(key);
+            modifiedAny = true;
+        }
+    }
+    if (lUseXePrefetch()) {
+        for (llvm::Instruction *load : loads) {
+            llvm::Value *ptr = llvm::isa<llvm::LoadInst>(load) ? llvm::cast<llvm::LoadInst>(load)->getPointerOperand()
+                                                              : load->getOperand(0);
+            // Loads from shared local memory don't need prefetches.
+            if (ptr->getType()->getPointerAddressSpace() == 3) {
+                continue;
+            }
+            std::pair<llvm::Value *, llvm::Value *> key(ptr, nullptr);
+            if (prefetched.find(key) == prefetched.end() && insertXePrefetches(load, LI, SE)) {
+                prefetched.insert(key);
+                modifiedAny = true;
+            }
+        }
+    }
+
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,47 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+
+namespace ispc {
+
+// This pass inserts software prefetches for indirect accesses in loops,
+// i.e. gathers like data[idx[i]] whose offsets are computed from a
+// contiguous stream of indices that is loaded in the loop.  The hardware
+// prefetchers deal with the stream of indices itself, but not with the
+// addresses computed from it.
+//
+//  For such a gather, the vector of indices --prefetch-distance iterations
+//  ahead is loaded, clamped to the last one the loop loads so that it never
+//  reads out of bounds, and the addresses that the gather will access then
+//  are prefetched.  The prefetch is emitted as a call to
+//  __pseudo_prefetch_read_varying_1, which the later passes lower to a
+//  vector prefetch where Target::hasVecPrefetch() is true and to
+//  per-lane prefetches otherwise.
+//
+//  On Xe targets with LSC prefetch messages, the vector loads, masked
+//  loads and strided gathers in loops whose addresses advance by a constant
+//  number of bytes in each iteration are prefetched too, into L1
+//  --prefetch-distance iterations ahead and into L3 twice as far ahead, as
+//  the GPU has no hardware prefetchers to hide the latency of its loads.
+//  The indirect prefetches above use the L1 prefetch messages there.
+
+struct InsertPrefetchesPass : public llvm::PassInfoMixin<InsertPrefetchesPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool insertPrefetches(llvm::CallInst *gather, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE,
+                          llvm::DominatorTree &DT);
+    bool insertXePrefetches(llvm::Instruction *access, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE);
+};
+
+} // namespace ispc
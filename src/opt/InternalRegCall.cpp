@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "InternalRegCall.h"
+
+namespace ispc {
+
+// Returns true if the function takes or returns vectors.
+static bool lHasVectorArgs(const llvm::Function &F) {
+    if (F.getReturnType()->isVectorTy()) {
+        return true;
+    }
+    for (const llvm::Argument &arg : F.args()) {
+        if (arg.getType()->isVectorTy()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns true if the calling convention of the function can be changed.
+static bool lCanUseRegCall(const llvm::Function &F) {
+    if (F.isDeclaration() || !F.hasLocalLinkage() || F.isVarArg() || !lHasVectorArgs(F)) {
+        return false;
+    }
+    llvm::CallingConv::ID cc = F.getCallingConv();
+    if (cc != llvm::CallingConv::C && cc != llvm::CallingConv::Fast && cc != llvm::CallingConv::X86_VectorCall) {
+        return false;
+    }
+    // All uses must be direct calls, which are updated with the function.
+    for (const llvm::Use &use : F.uses()) {
+        const llvm::CallBase *call = llvm::dyn_cast<llvm::CallBase>(use.getUser());
+        if (call == nullptr || !call->isCallee(&use) || call->isMustTailCall()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+llvm::PreservedAnalyses InternalRegCallPass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("InternalRegCallPass::run", M.getName());
+    bool modifiedAny = false;
+
+    for (llvm::Function &F : M) {
+        if (!lCanUseRegCall(F)) {
+            continue;
+        }
+        F.setCallingConv(llvm::CallingConv::X86_RegCall);
+        for (llvm::User *user : F.users()) {
+            llvm::cast<llvm::CallBase>(user)->setCallingConv(llvm::CallingConv::X86_RegCall);
+        }
+        modifiedAny = true;
+    }
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,32 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+/** The varying arguments and the mask of the calls of the functions that
+    aren't inlined are passed in memory by the default C calling convention
+    on Windows, and beyond the first eight vectors on Linux.  This pass
+    switches the functions that take or return vectors, and can only be
+    called directly from the module, to the regcall convention, which passes
+    them in vector registers.  These are the functions with local linkage
+    whose address isn't taken: static functions, template instantiations
+    and the functions of the standard library.  The others may be called
+    from other object files, or through pointers from C/C++, so they keep
+    their calling convention.
+ */
+class InternalRegCallPass : public llvm::PassInfoMixin<InternalRegCallPass> {
+  public:
+    explicit InternalRegCallPass() {}
+
+    static llvm::StringRef getPassName() { return "Regcall for internal functions"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+};
+
+} // namespace ispc
@@ -0,0 +1,229 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "InvariantDivision.h"
+
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+
+#include <map>
+#include <tuple>
+
+namespace ispc {
+
+// The magic numbers of a divisor, splatted to the vector type of the
+// divisions that use them.
+struct DivisionMagic {
+    // Multiplier, whose product with the dividend gives the quotient in the
+    // high half.
+    llvm::Value *multiplier = nullptr;
+    // Unsigned: the shifts before and after adding the correction.
+    // Signed: the shift of the quotient and the sign of the divisor.
+    llvm::Value *shift1 = nullptr;
+    llvm::Value *shift2 = nullptr;
+    llvm::Value *sign = nullptr;
+};
+
+/** Returns floor(r * 2^N / v) for N-bit r < v, which fits in N bits.  Up to
+    32 bits, it is a division of 2N-bit integers.  For 64 bits, 128-bit
+    division would need a library call, which isn't available everywhere,
+    so it is done with two 64-bit divisions of the normalized divisor's 32-bit
+    half by the method of Hacker's Delight (divlu), where the corrections of
+    the estimated digits are done with selects.
+ */
+static llvm::Value *lDivideHigh(llvm::IRBuilder<> &B, llvm::Value *r, llvm::Value *v) {
+    llvm::IntegerType *type = llvm::cast<llvm::IntegerType>(r->getType());
+    unsigned N = type->getBitWidth();
+    if (N < 64) {
+        llvm::Type *wideType = B.getIntNTy(2 * N);
+        llvm::Value *wideR = B.CreateShl(B.CreateZExt(r, wideType), N);
+        return B.CreateTrunc(B.CreateUDiv(wideR, B.CreateZExt(v, wideType)), type);
+    }
+
+    llvm::Value *b = B.getInt64(1ull << 32);
+    llvm::Value *s = B.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, v, B.getFalse());
+    llvm::Value *vn = B.CreateShl(v, s);
+    llvm::Value *un32 = B.CreateShl(r, s);
+    llvm::Value *vn1 = B.CreateLShr(vn, 32);
+    llvm::Value *vn0 = B.CreateAnd(vn, B.getInt64(0xFFFFFFFF));
+
+    // Estimate of a 32-bit digit of the quotient of un, which is corrected
+    // at most twice.  The lower digits of the dividend are zero.
+    auto digit = [&](llvm::Value *un) {
+        llvm::Value *q = B.CreateUDiv(un, vn1);
+        llvm::Value *rhat = B.CreateSub(un, B.CreateMul(q, vn1));
+        for (int i = 0; i < 2; ++i) {
+            llvm::Value *rhatSmall = B.CreateICmpULT(rhat, b);
+            llvm::Value *tooBig =
+                B.CreateOr(B.CreateICmpUGE(q, b),
+                           B.CreateAnd(rhatSmall, B.CreateICmpUGT(B.CreateMul(q, vn0), B.CreateShl(rhat, 32))));
+            if (i > 0) {
+                tooBig = B.CreateAnd(tooBig, rhatSmall);
+            }
+            q = B.CreateSelect(tooBig, B.CreateSub(q, B.getInt64(1)), q);
+            rhat = B.CreateSelect(tooBig, B.CreateAdd(rhat, vn1), rhat);
+        }
+        return q;
+    };
+    llvm::Value *q1 = digit(un32);
+    llvm::Value *un21 = B.CreateSub(B.CreateShl(un32, 32), B.CreateMul(q1, vn));
+    llvm::Value *q0 = digit(un21);
+    return B.CreateAdd(B.CreateShl(q1, 32), q0);
+}
+
+/** Computes the magic numbers of the given scalar divisor before the
+    terminator of the loop's preheader (Granlund and Montgomery, figures 4.1
+    and 5.2). */
+static DivisionMagic lComputeMagic(llvm::Value *divisor, bool isSigned, llvm::FixedVectorType *vecType,
+                                   llvm::Instruction *insertBefore) {
+    llvm::IRBuilder<> B(insertBefore);
+    llvm::IntegerType *type = llvm::cast<llvm::IntegerType>(divisor->getType());
+    unsigned N = type->getBitWidth();
+    llvm::Value *zero = llvm::ConstantInt::get(type, 0);
+    llvm::Value *one = llvm::ConstantInt::get(type, 1);
+    llvm::Value *bits = llvm::ConstantInt::get(type, N);
+
+    // Division by zero is undefined, but the loop might not divide at all.
+    llvm::Value *d = B.CreateSelect(B.CreateICmpEQ(divisor, zero), one, divisor, "divisor");
+
+    DivisionMagic magic;
+    unsigned count = vecType->getNumElements();
+    if (!isSigned) {
+        // l = ceil(log2(d)), m = floor(2^N * (2^l - d) / d) + 1
+        llvm::Value *lz = B.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, B.CreateSub(d, one), B.getFalse());
+        llvm::Value *l = B.CreateSub(bits, lz);
+        llvm::Value *lIsZero = B.CreateICmpEQ(l, zero);
+        llvm::Value *pow =
+            B.CreateSelect(B.CreateICmpEQ(l, bits), zero,
+                           B.CreateShl(one, B.CreateAnd(l, llvm::ConstantInt::get(type, N - 1))));
+        llvm::Value *m = B.CreateAdd(lDivideHigh(B, B.CreateSub(pow, d), d), one);
+        magic.multiplier = B.CreateVectorSplat(count, m, "div_magic");
+        magic.shift1 = B.CreateVectorSplat(count, B.CreateSelect(lIsZero, zero, one), "div_shift1");
+        magic.shift2 = B.CreateVectorSplat(count, B.CreateSelect(lIsZero, zero, B.CreateSub(l, one)), "div_shift2");
+    } else {
+        // l = max(ceil(log2(|d|)), 1), m = floor(2^(N+l-1) / |d|) + 1 - 2^N
+        llvm::Value *ad = B.CreateSelect(B.CreateICmpSLT(d, zero), B.CreateNeg(d), d);
+        llvm::Value *lz = B.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, B.CreateSub(ad, one), B.getFalse());
+        llvm::Value *l = B.CreateSub(bits, lz);
+        l = B.CreateSelect(B.CreateICmpEQ(l, zero), one, l);
+        llvm::Value *lMinusOne = B.CreateSub(l, one);
+        llvm::Value *r = B.CreateSelect(B.CreateICmpEQ(ad, one), zero, B.CreateShl(one, lMinusOne));
+        llvm::Value *m = B.CreateAdd(lDivideHigh(B, r, ad), one);
+        magic.multiplier = B.CreateVectorSplat(count, m, "div_magic");
+        magic.shift1 = B.CreateVectorSplat(count, lMinusOne, "div_shift");
+        magic.sign = B.CreateVectorSplat(count, B.CreateAShr(d, N - 1), "div_sign");
+    }
+    return magic;
+}
+
+// High half of the product of the vectors.
+static llvm::Value *lMulHigh(llvm::IRBuilder<> &B, llvm::Value *a, llvm::Value *b, bool isSigned) {
+    llvm::FixedVectorType *vecType = llvm::cast<llvm::FixedVectorType>(a->getType());
+    unsigned N = vecType->getScalarSizeInBits();
+    llvm::Type *wideType = llvm::FixedVectorType::get(B.getIntNTy(2 * N), vecType->getNumElements());
+    llvm::Value *wa = isSigned ? B.CreateSExt(a, wideType) : B.CreateZExt(a, wideType);
+    llvm::Value *wb = isSigned ? B.CreateSExt(b, wideType) : B.CreateZExt(b, wideType);
+    return B.CreateTrunc(B.CreateLShr(B.CreateMul(wa, wb), N), vecType);
+}
+
+// Quotient of the dividend by the divisor with the given magic numbers.
+static llvm::Value *lEmitQuotient(llvm::IRBuilder<> &B, llvm::Value *n, const DivisionMagic &magic, bool isSigned) {
+    if (!isSigned) {
+        llvm::Value *t = lMulHigh(B, magic.multiplier, n, false);
+        llvm::Value *q = B.CreateAdd(t, B.CreateLShr(B.CreateSub(n, t), magic.shift1));
+        return B.CreateLShr(q, magic.shift2);
+    }
+    unsigned N = n->getType()->getScalarSizeInBits();
+    llvm::Value *q = B.CreateAdd(n, lMulHigh(B, magic.multiplier, n, true));
+    q = B.CreateSub(B.CreateAShr(q, magic.shift1), B.CreateAShr(n, N - 1));
+    return B.CreateSub(B.CreateXor(q, magic.sign), magic.sign);
+}
+
+llvm::Loop *GetInvariantDivisionLoop(llvm::Instruction *inst, llvm::LoopInfo &LI) {
+    llvm::Instruction::BinaryOps opcode = (llvm::Instruction::BinaryOps)inst->getOpcode();
+    if (opcode != llvm::Instruction::UDiv && opcode != llvm::Instruction::SDiv && opcode != llvm::Instruction::URem &&
+        opcode != llvm::Instruction::SRem) {
+        return nullptr;
+    }
+    llvm::FixedVectorType *vecType = llvm::dyn_cast<llvm::FixedVectorType>(inst->getType());
+    if (vecType == nullptr || vecType->getNumElements() < 2) {
+        return nullptr;
+    }
+    unsigned bits = vecType->getScalarSizeInBits();
+    if (bits != 8 && bits != 16 && bits != 32 && bits != 64) {
+        return nullptr;
+    }
+    llvm::Value *divisor = llvm::getSplatValue(inst->getOperand(1));
+    if (divisor == nullptr || llvm::isa<llvm::Constant>(divisor)) {
+        return nullptr;
+    }
+
+    // The magic numbers are computed in the preheader of the outermost
+    // loop that the divisor is invariant in.
+    llvm::Loop *L = LI.getLoopFor(inst->getParent());
+    if (L == nullptr || !L->isLoopInvariant(divisor) || L->getLoopPreheader() == nullptr) {
+        return nullptr;
+    }
+    while (L->getParentLoop() != nullptr && L->getParentLoop()->isLoopInvariant(divisor) &&
+           L->getParentLoop()->getLoopPreheader() != nullptr) {
+        L = L->getParentLoop();
+    }
+    return L;
+}
+
+bool InvariantDivisionPass::lowerInvariantDivisions(llvm::Function &F, llvm::LoopInfo &LI) {
+    std::vector<std::pair<llvm::BinaryOperator *, llvm::Loop *>> divisions;
+    for (llvm::Instruction &I : llvm::instructions(F)) {
+        if (llvm::Loop *L = GetInvariantDivisionLoop(&I, LI)) {
+            divisions.push_back({llvm::cast<llvm::BinaryOperator>(&I), L});
+        }
+    }
+
+    // The divisions by the same divisor in the same loop share the magic
+    // numbers.
+    std::map<std::tuple<llvm::Value *, bool, llvm::Type *, llvm::Loop *>, DivisionMagic> magics;
+    for (const auto &[op, L] : divisions) {
+        llvm::Value *divisor = llvm::getSplatValue(op->getOperand(1));
+        llvm::Instruction::BinaryOps opcode = op->getOpcode();
+        bool isSigned = opcode == llvm::Instruction::SDiv || opcode == llvm::Instruction::SRem;
+        bool isRem = opcode == llvm::Instruction::URem || opcode == llvm::Instruction::SRem;
+        llvm::FixedVectorType *vecType = llvm::cast<llvm::FixedVectorType>(op->getType());
+        auto key = std::make_tuple(divisor, isSigned, (llvm::Type *)vecType, L);
+        auto it = magics.find(key);
+        if (it == magics.end()) {
+            DivisionMagic magic = lComputeMagic(divisor, isSigned, vecType, L->getLoopPreheader()->getTerminator());
+            it = magics.emplace(key, magic).first;
+        }
+
+        llvm::IRBuilder<> B(op);
+        llvm::Value *n = op->getOperand(0);
+        llvm::Value *result = lEmitQuotient(B, n, it->second, isSigned);
+        if (isRem) {
+            result = B.CreateSub(n, B.CreateMul(result, op->getOperand(1)));
+        }
+        result->takeName(op);
+        op->replaceAllUsesWith(result);
+        op->eraseFromParent();
+    }
+    return !divisions.empty();
+}
+
+llvm::PreservedAnalyses InvariantDivisionPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("InvariantDivisionPass::run", F.getName());
+
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    if (LI.empty() || !lowerInvariantDivisions(F, LI)) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,45 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+
+namespace ispc {
+
+// This pass lowers varying integer divisions and remainders by a uniform
+// divisor that is invariant in a loop, e.g. x / n or x % n with a uniform n
+// that doesn't change in the loop, to multiplications.
+//
+//  None of the targets has vector integer division, so such divisions are
+//  otherwise done lane by lane with scalar division instructions.  Instead,
+//  the "magic" multiplier and shift amounts of the divisor (Granlund and
+//  Montgomery, "Division by Invariant Integers using Multiplication") are
+//  computed once, in the preheader of the outermost loop that the divisor
+//  is invariant in, and the division in the loop becomes a high half
+//  multiplication, an addition and shifts.  Signed and unsigned divisions
+//  of 8, 16, 32 and 64 bit integers are handled.  Division by constants is
+//  left to LLVM, which does the same thing for them.
+//
+//  The magic numbers are computed with the divisor replaced by 1 if it is
+//  zero, so that computing them doesn't trap when the loop doesn't divide.
+
+// Returns the loop, in the preheader of which the magic numbers of the
+// divisor of the given varying integer division or remainder are computed,
+// or nullptr if it isn't lowered by the pass.
+llvm::Loop *GetInvariantDivisionLoop(llvm::Instruction *inst, llvm::LoopInfo &LI);
+
+struct InvariantDivisionPass : public llvm::PassInfoMixin<InvariantDivisionPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool lowerInvariantDivisions(llvm::Function &F, llvm::LoopInfo &LI);
+};
+
+} // namespace ispc
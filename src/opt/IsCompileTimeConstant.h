@@ -29,6 +29,10 @@ struct IsCompileTimeConstantPass : public llvm::PassInfoMixin<IsCompileTimeConst
 
     llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
+    // The calls have no definitions, so they are resolved in "optnone"
+    // functions too.
+    static bool isRequired() { return true; }
+
   private:
     bool isLastTry;
     bool lowerCompileTimeConstant(llvm::BasicBlock &BB);
@@ -98,7 +98,11 @@ std::string mangleSPIRVBuiltin(const llvm::Function &func) {
     for (const auto &arg : func.args()) {
         tyArgs.push_back(arg.getType());
     }
-    mangleOpenClBuiltin(func.getName().str(), tyArgs,
+    // Overloaded builtins, e.g. __spirv_SpecConstant, have a suffix of the
+    // type, which isn't a part of the name.
+    std::string funcName = func.getName().str();
+    funcName.erase(std::min(funcName.find('.'), funcName.size()));
+    mangleOpenClBuiltin(funcName, tyArgs,
 #if ISPC_LLVM_VERSION == ISPC_LLVM_15_0
                         // spirv builtins doesn't have pointer arguments
                         {},
@@ -0,0 +1,475 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "MaskDataflow.h"
+#include "builtins-decl.h"
+
+#include <llvm/Transforms/Utils/Local.h>
+
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace ispc {
+
+// The limit of the depth of the mask computations that are followed.
+static const int MAX_MASK_DEPTH = 8;
+
+enum class MaskTestKind { All, Any, None };
+
+// A test of a mask: "inst" is true if "kind" holds for "mask", or if it
+// doesn't when "negated" is set.
+struct MaskTest {
+    llvm::Instruction *inst = nullptr;
+    llvm::Value *mask = nullptr;
+    MaskTestKind kind = MaskTestKind::Any;
+    bool negated = false;
+    // Set if the lanes of the mask are known to be either all zeros or all
+    // ones, as for the execution masks that are passed to the builtins.
+    bool laneExact = false;
+};
+
+// The facts that hold for the masks on an edge.  "Lanes on" are the lanes
+// with the sign bit set, as the movmsk instructions report them.
+struct MaskFacts {
+    std::set<llvm::Value *> allOn;
+    std::set<llvm::Value *> allOff;
+    std::set<llvm::Value *> someOn;
+    // The masks of the tests with lane-exact masks.
+    std::set<llvm::Value *> laneExact;
+};
+
+enum class MaskFact { AllOn, AllOff, SomeOn };
+
+static llvm::Value *lStripBitCasts(llvm::Value *value) {
+    while (llvm::BitCastInst *bitCast = llvm::dyn_cast<llvm::BitCastInst>(value)) {
+        llvm::FixedVectorType *fromType = llvm::dyn_cast<llvm::FixedVectorType>(bitCast->getOperand(0)->getType());
+        llvm::FixedVectorType *toType = llvm::dyn_cast<llvm::FixedVectorType>(bitCast->getType());
+        // Only the casts that keep the lanes keep their sign bits.
+        if (fromType == nullptr || toType == nullptr || fromType->getNumElements() != toType->getNumElements()) {
+            break;
+        }
+        value = bitCast->getOperand(0);
+    }
+    return value;
+}
+
+static bool lIsIntVector(llvm::Value *value) {
+    llvm::VectorType *vt = llvm::dyn_cast<llvm::VectorType>(value->getType());
+    return vt != nullptr && vt->getElementType()->isIntegerTy();
+}
+
+static bool lIsNotOf(llvm::BinaryOperator *bop, llvm::Value **operand) {
+    if (bop->getOpcode() != llvm::Instruction::Xor) {
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(bop->getOperand(i));
+        if (c != nullptr && c->isAllOnesValue()) {
+            *operand = bop->getOperand(1 - i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Returns true if all the lanes of the given vector are either all zeros
+    or all ones, so that a mask that has the sign bits of all its lanes set
+    is equal to the all ones vector. */
+static bool lIsLaneExact(llvm::Value *value, std::set<llvm::Value *> &visited, int depth = 0) {
+    value = lStripBitCasts(value);
+    if (!lIsIntVector(value)) {
+        return false;
+    }
+    if (llvm::cast<llvm::VectorType>(value->getType())->getElementType()->isIntegerTy(1)) {
+        return true;
+    }
+    if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(value)) {
+        unsigned int count = llvm::cast<llvm::FixedVectorType>(c->getType())->getNumElements();
+        for (unsigned int i = 0; i < count; ++i) {
+            llvm::Constant *elt = c->getAggregateElement(i);
+            if (elt == nullptr || !(elt->isNullValue() || elt->isAllOnesValue())) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (llvm::Argument *arg = llvm::dyn_cast<llvm::Argument>(value)) {
+        return arg->getName() == "__mask";
+    }
+    if (llvm::SExtInst *sext = llvm::dyn_cast<llvm::SExtInst>(value)) {
+        return sext->getOperand(0)->getType()->getScalarType()->isIntegerTy(1);
+    }
+    // Cycles through the phis are fine, as the values that enter them decide.
+    if (!visited.insert(value).second) {
+        return true;
+    }
+    if (depth >= MAX_MASK_DEPTH) {
+        return false;
+    }
+    if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(value)) {
+        if (bop->getOpcode() != llvm::Instruction::And && bop->getOpcode() != llvm::Instruction::Or &&
+            bop->getOpcode() != llvm::Instruction::Xor) {
+            return false;
+        }
+        return lIsLaneExact(bop->getOperand(0), visited, depth + 1) &&
+               lIsLaneExact(bop->getOperand(1), visited, depth + 1);
+    }
+    if (llvm::SelectInst *select = llvm::dyn_cast<llvm::SelectInst>(value)) {
+        return lIsLaneExact(select->getTrueValue(), visited, depth + 1) &&
+               lIsLaneExact(select->getFalseValue(), visited, depth + 1);
+    }
+    if (llvm::PHINode *phi = llvm::dyn_cast<llvm::PHINode>(value)) {
+        for (llvm::Value *incoming : phi->incoming_values()) {
+            if (!lIsLaneExact(incoming, visited, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/** Match a value with one bit for each lane of a mask, which is set if
+    the lane is on: a call of __movmsk or of one of the x86 movmsk
+    intrinsics, or a bitcast of an i1 vector to an integer. */
+static bool lMatchLaneBits(llvm::Value *value, llvm::Value **mask, unsigned int *numBits, bool *laneExact) {
+    if (llvm::ZExtInst *zext = llvm::dyn_cast<llvm::ZExtInst>(value)) {
+        return lMatchLaneBits(zext->getOperand(0), mask, numBits, laneExact);
+    }
+    if (llvm::BitCastInst *bitCast = llvm::dyn_cast<llvm::BitCastInst>(value)) {
+        llvm::FixedVectorType *fromType = llvm::dyn_cast<llvm::FixedVectorType>(bitCast->getOperand(0)->getType());
+        if (fromType == nullptr || !fromType->getElementType()->isIntegerTy(1) || !bitCast->getType()->isIntegerTy()) {
+            return false;
+        }
+        *mask = bitCast->getOperand(0);
+        *numBits = fromType->getNumElements();
+        *laneExact = true;
+        return true;
+    }
+    llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(value);
+    if (callInst == nullptr || callInst->getCalledFunction() == nullptr || callInst->arg_size() != 1) {
+        return false;
+    }
+    llvm::FixedVectorType *argType = llvm::dyn_cast<llvm::FixedVectorType>(callInst->getArgOperand(0)->getType());
+    if (argType == nullptr) {
+        return false;
+    }
+    if (callInst->getCalledFunction() == callInst->getModule()->getFunction(builtin::__movmsk)) {
+        *laneExact = true;
+    } else {
+        switch (callInst->getIntrinsicID()) {
+        case llvm::Intrinsic::x86_sse_movmsk_ps:
+        case llvm::Intrinsic::x86_sse2_movmsk_pd:
+        case llvm::Intrinsic::x86_sse2_pmovmskb_128:
+        case llvm::Intrinsic::x86_avx_movmsk_ps_256:
+        case llvm::Intrinsic::x86_avx_movmsk_pd_256:
+        case llvm::Intrinsic::x86_avx2_pmovmskb:
+            *laneExact = false;
+            break;
+        default:
+            return false;
+        }
+    }
+    *mask = lStripBitCasts(callInst->getArgOperand(0));
+    *numBits = argType->getNumElements();
+    return lIsIntVector(*mask);
+}
+
+/** Match an i1 value that tests the lanes of a mask. */
+static bool lMatchMaskTest(llvm::Value *value, MaskTest *test) {
+    llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(value);
+    if (inst == nullptr || !inst->getType()->isIntegerTy(1)) {
+        return false;
+    }
+    test->inst = inst;
+
+    if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(inst)) {
+        llvm::Value *operand = nullptr;
+        if (!lIsNotOf(bop, &operand) || !lMatchMaskTest(operand, test)) {
+            return false;
+        }
+        test->inst = inst;
+        test->negated = !test->negated;
+        return true;
+    }
+
+    if (llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(inst)) {
+        llvm::Function *func = callInst->getCalledFunction();
+        if (func == nullptr || callInst->arg_size() != 1) {
+            return false;
+        }
+        llvm::Module *M = inst->getModule();
+        if (func == M->getFunction(builtin::__all)) {
+            test->kind = MaskTestKind::All;
+        } else if (func == M->getFunction(builtin::__any)) {
+            test->kind = MaskTestKind::Any;
+        } else if (func == M->getFunction(builtin::__none)) {
+            test->kind = MaskTestKind::None;
+        } else if (callInst->getIntrinsicID() == llvm::Intrinsic::vector_reduce_and) {
+            test->kind = MaskTestKind::All;
+        } else if (callInst->getIntrinsicID() == llvm::Intrinsic::vector_reduce_or) {
+            test->kind = MaskTestKind::Any;
+        } else {
+            return false;
+        }
+        test->mask = lStripBitCasts(callInst->getArgOperand(0));
+        test->negated = false;
+        test->laneExact = true;
+        return lIsIntVector(test->mask);
+    }
+
+    llvm::ICmpInst *cmp = llvm::dyn_cast<llvm::ICmpInst>(inst);
+    if (cmp == nullptr || (cmp->getPredicate() != llvm::CmpInst::ICMP_EQ &&
+                           cmp->getPredicate() != llvm::CmpInst::ICMP_NE)) {
+        return false;
+    }
+    llvm::ConstantInt *c = llvm::dyn_cast<llvm::ConstantInt>(cmp->getOperand(1));
+    unsigned int numBits = 0;
+    if (c == nullptr || !lMatchLaneBits(cmp->getOperand(0), &test->mask, &numBits, &test->laneExact) ||
+        numBits > c->getBitWidth()) {
+        return false;
+    }
+    if (c->isZero()) {
+        test->kind = MaskTestKind::None;
+    } else if (c->getValue() == llvm::APInt::getLowBitsSet(c->getBitWidth(), numBits)) {
+        test->kind = MaskTestKind::All;
+    } else {
+        return false;
+    }
+    test->negated = cmp->getPredicate() == llvm::CmpInst::ICMP_NE;
+    return true;
+}
+
+/** Record the fact for the mask, and the facts that follow from it for
+    the masks that it is computed from. */
+static void lAddFact(MaskFacts &facts, llvm::Value *mask, MaskFact fact, int depth = 0) {
+    mask = lStripBitCasts(mask);
+    if (!lIsIntVector(mask) || llvm::isa<llvm::Constant>(mask)) {
+        return;
+    }
+    std::set<llvm::Value *> &set =
+        fact == MaskFact::AllOn ? facts.allOn : (fact == MaskFact::AllOff ? facts.allOff : facts.someOn);
+    if (!set.insert(mask).second || depth >= MAX_MASK_DEPTH) {
+        return;
+    }
+
+    if (llvm::SExtInst *sext = llvm::dyn_cast<llvm::SExtInst>(mask)) {
+        lAddFact(facts, sext->getOperand(0), fact, depth + 1);
+        return;
+    }
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(mask);
+    if (bop == nullptr) {
+        return;
+    }
+    llvm::Value *operand = nullptr;
+    if (lIsNotOf(bop, &operand)) {
+        // ~mask is all on if mask is all off and vice versa.
+        if (fact != MaskFact::SomeOn) {
+            lAddFact(facts, operand, fact == MaskFact::AllOn ? MaskFact::AllOff : MaskFact::AllOn, depth + 1);
+        }
+    } else if (bop->getOpcode() == llvm::Instruction::And && fact != MaskFact::AllOff) {
+        // The lanes of a & b are on in both a and b.
+        lAddFact(facts, bop->getOperand(0), fact, depth + 1);
+        lAddFact(facts, bop->getOperand(1), fact, depth + 1);
+    } else if (bop->getOpcode() == llvm::Instruction::Or && fact == MaskFact::AllOff) {
+        lAddFact(facts, bop->getOperand(0), fact, depth + 1);
+        lAddFact(facts, bop->getOperand(1), fact, depth + 1);
+    }
+}
+
+/** Returns what is known about the lanes of the mask from the facts. */
+static std::optional<MaskFact> lGetFact(const MaskFacts &facts, llvm::Value *mask, int depth = 0) {
+    mask = lStripBitCasts(mask);
+    if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(mask)) {
+        if (c->isNullValue()) {
+            return MaskFact::AllOff;
+        }
+        if (c->isAllOnesValue()) {
+            return MaskFact::AllOn;
+        }
+        return std::nullopt;
+    }
+    if (facts.allOn.count(mask)) {
+        return MaskFact::AllOn;
+    }
+    if (facts.allOff.count(mask)) {
+        return MaskFact::AllOff;
+    }
+    std::optional<MaskFact> known;
+    if (facts.someOn.count(mask)) {
+        known = MaskFact::SomeOn;
+    }
+    if (depth >= MAX_MASK_DEPTH) {
+        return known;
+    }
+
+    if (llvm::SExtInst *sext = llvm::dyn_cast<llvm::SExtInst>(mask)) {
+        std::optional<MaskFact> fact = lGetFact(facts, sext->getOperand(0), depth + 1);
+        return fact ? fact : known;
+    }
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(mask);
+    if (bop == nullptr) {
+        return known;
+    }
+    llvm::Value *operand = nullptr;
+    if (lIsNotOf(bop, &operand)) {
+        std::optional<MaskFact> fact = lGetFact(facts, operand, depth + 1);
+        if (fact == MaskFact::AllOn) {
+            return MaskFact::AllOff;
+        }
+        if (fact == MaskFact::AllOff) {
+            return MaskFact::AllOn;
+        }
+        return known;
+    }
+    if (bop->getOpcode() != llvm::Instruction::And && bop->getOpcode() != llvm::Instruction::Or) {
+        return known;
+    }
+    std::optional<MaskFact> a = lGetFact(facts, bop->getOperand(0), depth + 1);
+    std::optional<MaskFact> b = lGetFact(facts, bop->getOperand(1), depth + 1);
+    if (bop->getOpcode() == llvm::Instruction::And) {
+        if (a == MaskFact::AllOff || b == MaskFact::AllOff) {
+            return MaskFact::AllOff;
+        }
+        if (a == MaskFact::AllOn && b == MaskFact::AllOn) {
+            return MaskFact::AllOn;
+        }
+        // A subset of an all on mask is known as well as the other mask.
+        if (a == MaskFact::AllOn) {
+            return b ? b : known;
+        }
+        if (b == MaskFact::AllOn) {
+            return a ? a : known;
+        }
+    } else {
+        if (a == MaskFact::AllOn || b == MaskFact::AllOn) {
+            return MaskFact::AllOn;
+        }
+        if (a == MaskFact::AllOff && b == MaskFact::AllOff) {
+            return MaskFact::AllOff;
+        }
+        if (a == MaskFact::SomeOn || b == MaskFact::SomeOn) {
+            return MaskFact::SomeOn;
+        }
+    }
+    return known;
+}
+
+/** Returns the value of the test if the facts decide it. */
+static std::optional<bool> lEvaluateTest(const MaskTest &test, const MaskFacts &facts) {
+    std::optional<MaskFact> fact = lGetFact(facts, test.mask);
+    if (!fact) {
+        return std::nullopt;
+    }
+    bool value = false;
+    switch (test.kind) {
+    case MaskTestKind::All:
+        if (fact == MaskFact::SomeOn) {
+            return std::nullopt;
+        }
+        value = fact == MaskFact::AllOn;
+        break;
+    case MaskTestKind::Any:
+        value = fact != MaskFact::AllOff;
+        break;
+    case MaskTestKind::None:
+        value = fact == MaskFact::AllOff;
+        break;
+    }
+    return value != test.negated;
+}
+
+bool MaskDataflowPass::propagateMaskFacts(llvm::Function &F, llvm::DominatorTree &DT) {
+    std::vector<MaskTest> tests;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            MaskTest test;
+            if (lMatchMaskTest(&I, &test)) {
+                tests.push_back(test);
+            }
+        }
+    }
+    if (tests.empty()) {
+        return false;
+    }
+
+    bool modifiedAny = false;
+    for (llvm::BasicBlock &BB : F) {
+        llvm::BranchInst *branch = llvm::dyn_cast<llvm::BranchInst>(BB.getTerminator());
+        if (branch == nullptr || !branch->isConditional() || branch->getSuccessor(0) == branch->getSuccessor(1)) {
+            continue;
+        }
+        MaskTest test;
+        if (!lMatchMaskTest(branch->getCondition(), &test)) {
+            continue;
+        }
+
+        for (unsigned int succ = 0; succ < 2; ++succ) {
+            // Whether test.kind holds for the mask on this edge.
+            bool holds = (succ == 0) != test.negated;
+            MaskFacts facts;
+            if (test.kind == MaskTestKind::All && holds) {
+                lAddFact(facts, test.mask, MaskFact::AllOn);
+            } else if ((test.kind == MaskTestKind::Any && !holds) || (test.kind == MaskTestKind::None && holds)) {
+                lAddFact(facts, test.mask, MaskFact::AllOff);
+            } else if ((test.kind == MaskTestKind::Any && holds) || (test.kind == MaskTestKind::None && !holds)) {
+                lAddFact(facts, test.mask, MaskFact::SomeOn);
+            } else {
+                continue;
+            }
+            if (test.laneExact) {
+                facts.laneExact.insert(test.mask);
+            }
+
+            llvm::BasicBlockEdge edge(&BB, branch->getSuccessor(succ));
+            if (!edge.isSingleEdge()) {
+                continue;
+            }
+
+            // The tests that the facts decide...
+            for (const MaskTest &other : tests) {
+                std::optional<bool> value = lEvaluateTest(other, facts);
+                if (value) {
+                    llvm::Constant *c = llvm::ConstantInt::getBool(F.getContext(), *value);
+                    modifiedAny |= llvm::replaceDominatedUsesWith(other.inst, c, DT, edge) > 0;
+                }
+            }
+
+            // ...and the masks with a known value.
+            for (llvm::Value *mask : facts.allOn) {
+                std::set<llvm::Value *> visited;
+                if (facts.laneExact.count(mask) || lIsLaneExact(mask, visited)) {
+                    llvm::Constant *allOn = llvm::Constant::getAllOnesValue(mask->getType());
+                    modifiedAny |= llvm::replaceDominatedUsesWith(mask, allOn, DT, edge) > 0;
+                }
+            }
+            for (llvm::Value *mask : facts.allOff) {
+                std::set<llvm::Value *> visited;
+                if (facts.laneExact.count(mask) || lIsLaneExact(mask, visited)) {
+                    llvm::Constant *allOff = llvm::Constant::getNullValue(mask->getType());
+                    modifiedAny |= llvm::replaceDominatedUsesWith(mask, allOff, DT, edge) > 0;
+                }
+            }
+        }
+    }
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses MaskDataflowPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("MaskDataflowPass::run", F.getName());
+    llvm::DominatorTree &DT = FAM.getResult<llvm::DominatorTreeAnalysis>(F);
+    if (!propagateMaskFacts(F, DT)) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,42 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/IR/Dominators.h>
+
+namespace ispc {
+
+/** This pass removes the mask operations that are redundant on a path of
+    the control flow graph.  The code emitted for nested varying control
+    flow, like the "all on" and "mixed" paths of "cif" statements, tests
+    masks that are derived from each other (e.g. "any(mask & test)" under
+    a branch on "all(mask)") and ANDs and blends with masks whose value is
+    already known there.
+
+    The branches on the tests of a mask (__any, __all, __none, or the
+    equivalent comparisons of __movmsk and of the target's movmsk
+    instructions after they are inlined) give facts on the masks along
+    their edges: all on, all off, or some lanes on.  The facts are
+    propagated to the operands of the ANDs and ORs that compute the mask,
+    and in the blocks dominated by the edge:
+    - the tests that the facts decide are replaced with constants,
+    - the masks that are known to be all on or all off are replaced with
+      the corresponding constants, so that the ANDs, the blends and the
+      masked memory operations with them are simplified by the later
+      passes.
+ */
+struct MaskDataflowPass : public llvm::PassInfoMixin<MaskDataflowPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool propagateMaskFacts(llvm::Function &F, llvm::DominatorTree &DT);
+};
+
+} // namespace ispc
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "MaskMultiversioning.h"
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace ispc {
+
+/** Returns the mask parameter of the given function, i.e. its last
+    parameter if that has the type of the execution mask, or nullptr.
+ */
+static llvm::Argument *lGetMaskArg(llvm::Function &F) {
+    if (F.arg_size() == 0) {
+        return nullptr;
+    }
+    llvm::Argument *arg = F.getArg(F.arg_size() - 1);
+    return arg->getType() == LLVMTypes::MaskType ? arg : nullptr;
+}
+
+bool MaskMultiversioningPass::multiversionFunction(llvm::Function &F) {
+    // Functions with fewer instructions than this aren't worth a second
+    // version.
+    constexpr unsigned minInstructions = 64;
+
+    llvm::Argument *maskArg = lGetMaskArg(F);
+    if (maskArg == nullptr || maskArg->use_empty() || F.getInstructionCount() < minInstructions) {
+        return false;
+    }
+
+    // All of the uses of the function have to be calls of it that can be
+    // changed, and at least one has to be able to use the new version.
+    std::vector<llvm::CallInst *> calls;
+    bool anyCallMayBeAllOn = false;
+    for (llvm::User *user : F.users()) {
+        llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(user);
+        if (callInst == nullptr || callInst->getCalledFunction() != &F || callInst->getFunction() == &F) {
+            return false;
+        }
+        llvm::Value *mask = callInst->getArgOperand(maskArg->getArgNo());
+        if (!llvm::isa<llvm::Constant>(mask) || mask == LLVMMaskAllOn) {
+            anyCallMayBeAllOn = true;
+        }
+        calls.push_back(callInst);
+    }
+    if (!anyCallMayBeAllOn) {
+        return false;
+    }
+
+    llvm::ValueToValueMapTy VMap;
+    llvm::Function *allOnFunc = llvm::CloneFunction(&F, VMap);
+    allOnFunc->setName(F.getName() + "_all_on");
+    llvm::cast<llvm::Argument>(VMap[maskArg])->replaceAllUsesWith(LLVMMaskAllOn);
+
+    for (llvm::CallInst *callInst : calls) {
+        llvm::Value *mask = callInst->getArgOperand(maskArg->getArgNo());
+        if (mask == LLVMMaskAllOn) {
+            callInst->setCalledFunction(allOnFunc);
+            continue;
+        }
+        if (llvm::isa<llvm::Constant>(mask)) {
+            continue;
+        }
+
+        // if (all(mask == all on)) allOnFunc(...) else F(...)
+        llvm::IRBuilder<> B(callInst);
+        llvm::Value *allOn = B.CreateAndReduce(B.CreateICmpEQ(mask, LLVMMaskAllOn));
+        llvm::Instruction *thenTerm = nullptr, *elseTerm = nullptr;
+        llvm::SplitBlockAndInsertIfThenElse(allOn, callInst, &thenTerm, &elseTerm);
+        llvm::BasicBlock *tail = callInst->getParent();
+
+        llvm::CallInst *allOnCall = llvm::cast<llvm::CallInst>(callInst->clone());
+        allOnCall->setCalledFunction(allOnFunc);
+        allOnCall->insertBefore(thenTerm);
+        callInst->moveBefore(elseTerm);
+
+        if (!callInst->getType()->isVoidTy() && !callInst->use_empty()) {
+            llvm::IRBuilder<> TB(tail, tail->begin());
+            llvm::PHINode *result = TB.CreatePHI(callInst->getType(), 2, callInst->getName());
+            callInst->replaceAllUsesWith(result);
+            result->addIncoming(allOnCall, allOnCall->getParent());
+            result->addIncoming(callInst, callInst->getParent());
+        }
+    }
+    return true;
+}
+
+llvm::PreservedAnalyses MaskMultiversioningPass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("MaskMultiversioningPass::run", M.getName());
+
+    // Only the internal functions are versioned: the calls of the others
+    // can't all be seen, and the exported ones are called with the mask
+    // all on anyway.
+    std::vector<llvm::Function *> functions;
+    for (llvm::Function &F : M) {
+        if (!F.isDeclaration() && F.hasLocalLinkage() && !F.hasFnAttribute(llvm::Attribute::AlwaysInline)) {
+            functions.push_back(&F);
+        }
+    }
+
+    bool modifiedAny = false;
+    for (llvm::Function *F : functions) {
+        modifiedAny |= multiversionFunction(*F);
+    }
+
+    return modifiedAny ? llvm::PreservedAnalyses::none() : llvm::PreservedAnalyses::all();
+}
+
+} // namespace ispc
@@ -0,0 +1,38 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+/** With --opt=mask-multiversioning, this pass creates "all on" versions of
+    the internal functions that are called with an execution mask and
+    weren't inlined, and calls them when the mask is all on.  Calls with a
+    mask that is known to be all on at compile time are changed to call the
+    new version; the others test the mask and call one version or the
+    other.  The new versions are compiled with the mask parameter replaced
+    with LLVMMaskAllOn, so that the later passes turn the masked loads,
+    stores, gathers and scatters in them into unmasked ones.
+
+    Only functions with a sizable body are versioned, as for the smaller
+    ones the extra code isn't worth it.  This
+    runs before the passes that optimize masked operations with an all on
+    mask, so that they process the new versions too.
+ */
+class MaskMultiversioningPass : public llvm::PassInfoMixin<MaskMultiversioningPass> {
+  public:
+    explicit MaskMultiversioningPass() {}
+
+    static llvm::StringRef getPassName() { return "Mask multiversioning"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+
+  private:
+    bool multiversionFunction(llvm::Function &F);
+};
+
+} // namespace ispc
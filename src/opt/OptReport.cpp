@@ -0,0 +1,471 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "OptReport.h"
+#include "InvariantDivision.h"
+
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace ispc {
+
+namespace {
+
+enum class ReportKind {
+    Gather,
+    Scatter,
+    MaskedLoad,
+    MaskedStore,
+    BlendedStore,
+    IntDivision,
+    UIntFloatConversion,
+    VariableShiftRight,
+};
+
+struct ReportEntry {
+    int column;
+    int count;
+};
+
+// Entries are grouped by file, line, function, kind and element type.
+using ReportKey = std::tuple<std::string, int, std::string, ReportKind, std::string>;
+
+} // namespace
+
+/** Returns the name of the given kind of entry in the YAML report. */
+static const char *lKindName(ReportKind kind) {
+    switch (kind) {
+    case ReportKind::Gather:
+        return "Gather";
+    case ReportKind::Scatter:
+        return "Scatter";
+    case ReportKind::MaskedLoad:
+        return "MaskedLoad";
+    case ReportKind::MaskedStore:
+        return "MaskedStore";
+    case ReportKind::BlendedStore:
+        return "BlendedStore";
+    case ReportKind::IntDivision:
+        return "IntDivision";
+    case ReportKind::UIntFloatConversion:
+        return "UIntFloatConversion";
+    case ReportKind::VariableShiftRight:
+        return "VariableShiftRight";
+    }
+    return "";
+}
+
+/** Returns the description of the given kind of entry in the text report. */
+static const char *lKindDescription(ReportKind kind, bool plural) {
+    switch (kind) {
+    case ReportKind::Gather:
+        return plural ? "gathers" : "gather";
+    case ReportKind::Scatter:
+        return plural ? "scatters" : "scatter";
+    case ReportKind::MaskedLoad:
+        return plural ? "masked loads" : "masked load";
+    case ReportKind::MaskedStore:
+        return plural ? "masked stores" : "masked store";
+    case ReportKind::BlendedStore:
+        return plural ? "blended masked stores" : "blended masked store";
+    case ReportKind::IntDivision:
+        return plural ? "varying integer divisions" : "varying integer division";
+    case ReportKind::UIntFloatConversion:
+        return plural ? "unsigned integer/floating point conversions" : "unsigned integer/floating point conversion";
+    case ReportKind::VariableShiftRight:
+        return plural ? "variable shifts right" : "variable shift right";
+    }
+    return "";
+}
+
+static bool lStartsWith(llvm::StringRef name, llvm::StringRef prefix) {
+    return name.substr(0, prefix.size()) == prefix;
+}
+
+/** If the given call is a gather, scatter or masked load or store, returns
+    true and the kind of memory operation and the value that is loaded or
+    stored.
+ */
+static bool lGetMemoryOpKind(llvm::CallInst *callInst, ReportKind *kind, llvm::Value **value) {
+    llvm::Function *func = callInst->getCalledFunction();
+    if (func == nullptr) {
+        return false;
+    }
+
+    switch (func->getIntrinsicID()) {
+    case llvm::Intrinsic::masked_gather:
+        *kind = ReportKind::Gather;
+        *value = callInst;
+        return true;
+    case llvm::Intrinsic::masked_scatter:
+        *kind = ReportKind::Scatter;
+        *value = callInst->getArgOperand(0);
+        return true;
+    case llvm::Intrinsic::masked_load:
+        *kind = ReportKind::MaskedLoad;
+        *value = callInst;
+        return true;
+    case llvm::Intrinsic::masked_store:
+        *kind = ReportKind::MaskedStore;
+        *value = callInst->getArgOperand(0);
+        return true;
+    default:
+        break;
+    }
+
+    // The value stored by the ISPC scatters and masked stores is the
+    // argument before the mask.
+    llvm::StringRef name = func->getName();
+    if (lStartsWith(name, "__pseudo_gather") || lStartsWith(name, "__gather")) {
+        *kind = ReportKind::Gather;
+        *value = callInst;
+    } else if (lStartsWith(name, "__pseudo_scatter") || lStartsWith(name, "__scatter")) {
+        *kind = ReportKind::Scatter;
+        *value = callInst->getArgOperand(callInst->arg_size() - 2);
+    } else if (lStartsWith(name, "__masked_load")) {
+        *kind = ReportKind::MaskedLoad;
+        *value = callInst;
+    } else if (lStartsWith(name, "__masked_store_blend")) {
+        *kind = ReportKind::BlendedStore;
+        *value = callInst->getArgOperand(callInst->arg_size() - 2);
+    } else if (lStartsWith(name, "__pseudo_masked_store") || lStartsWith(name, "__masked_store")) {
+        *kind = ReportKind::MaskedStore;
+        *value = callInst->getArgOperand(callInst->arg_size() - 2);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/** Returns true if the given instruction is a vector operation that the
+    target doesn't have an instruction for, and returns its kind. */
+static bool lGetExpensiveOpKind(llvm::Instruction *inst, ReportKind *kind) {
+    if (!inst->getType()->isVectorTy()) {
+        return false;
+    }
+
+    switch (inst->getOpcode()) {
+    case llvm::Instruction::SDiv:
+    case llvm::Instruction::UDiv:
+    case llvm::Instruction::SRem:
+    case llvm::Instruction::URem:
+        // Divisions by constants are done with multiplications.
+        *kind = ReportKind::IntDivision;
+        return !llvm::isa<llvm::Constant>(inst->getOperand(1)) && g->target->shouldWarn(PerfWarningType::DIVModInt);
+    case llvm::Instruction::UIToFP:
+    case llvm::Instruction::FPToUI: {
+        llvm::Type *fpType =
+            inst->getOpcode() == llvm::Instruction::UIToFP ? inst->getType() : inst->getOperand(0)->getType();
+        *kind = ReportKind::UIntFloatConversion;
+        return g->target->shouldWarn(fpType->getScalarType()->isHalfTy() ? PerfWarningType::CVTUIntFloat16
+                                                                         : PerfWarningType::CVTUIntFloat);
+    }
+    case llvm::Instruction::LShr:
+    case llvm::Instruction::AShr:
+        *kind = ReportKind::VariableShiftRight;
+        return !llvm::isa<llvm::Constant>(inst->getOperand(1)) && llvm::getSplatValue(inst->getOperand(1)) == nullptr &&
+               g->target->shouldWarn(PerfWarningType::VariableShiftRight);
+    default:
+        return false;
+    }
+}
+
+static bool lIsStdlibFile(const std::string &file) {
+    const std::string stdlibFile = "stdlib.ispc";
+    return file.length() >= stdlibFile.length() &&
+           file.compare(file.length() - stdlibFile.length(), stdlibFile.length(), stdlibFile) == 0;
+}
+
+/** Gets the source position of the given instruction from the metadata of
+    memory operations or from its debug location.  Returns false if it has
+    neither or if it is in the standard library.
+ */
+static bool lGetReportPos(const llvm::Instruction *inst, std::string *file, int *line, int *column) {
+    SourcePos pos;
+    if (LLVMGetSourcePosFromMetadata(inst, &pos)) {
+        *file = pos.name;
+        *line = pos.first_line;
+        *column = pos.first_column;
+    } else if (const llvm::DILocation *loc = inst->getDebugLoc().get()) {
+        *file = loc->getFilename().str();
+        *line = loc->getLine();
+        *column = loc->getColumn();
+    } else {
+        return false;
+    }
+
+    return !lIsStdlibFile(*file);
+}
+
+namespace {
+/** A statement that the front-end has optimized: a varying "if" statement
+    that it emits like a "cif" or a "foreach" loop that it fused with the
+    preceding one. */
+struct FrontEndStmt {
+    std::string file;
+    int line;
+    int column;
+    std::string function;
+};
+} // namespace
+
+/** Returns the statements that the front-end has recorded in the named
+    metadata \p mdName of the module, sorted by position, and removes the
+    metadata. */
+static std::vector<FrontEndStmt> lTakeFrontEndStmts(llvm::Module &M, const char *mdName) {
+    std::vector<FrontEndStmt> stmts;
+    llvm::NamedMDNode *md = M.getNamedMetadata(mdName);
+    if (md == nullptr) {
+        return stmts;
+    }
+    for (llvm::MDNode *node : md->operands()) {
+        llvm::MDString *file = llvm::dyn_cast<llvm::MDString>(node->getOperand(0));
+        llvm::ConstantInt *line = llvm::mdconst::dyn_extract<llvm::ConstantInt>(node->getOperand(1));
+        llvm::ConstantInt *column = llvm::mdconst::dyn_extract<llvm::ConstantInt>(node->getOperand(2));
+        llvm::MDString *function = llvm::dyn_cast<llvm::MDString>(node->getOperand(3));
+        if (file == nullptr || line == nullptr || column == nullptr || function == nullptr ||
+            lIsStdlibFile(file->getString().str())) {
+            continue;
+        }
+        stmts.push_back({file->getString().str(), (int)line->getZExtValue(), (int)column->getZExtValue(),
+                         function->getString().str()});
+    }
+    M.eraseNamedMetadata(md);
+    std::sort(stmts.begin(), stmts.end(), [](const FrontEndStmt &a, const FrontEndStmt &b) {
+        return std::tie(a.file, a.line, a.column, a.function) < std::tie(b.file, b.line, b.column, b.function);
+    });
+    // The body of a "foreach" loop is emitted for the full and the partial
+    // iterations, so a statement may be recorded more than once.
+    stmts.erase(std::unique(stmts.begin(), stmts.end(),
+                            [](const FrontEndStmt &a, const FrontEndStmt &b) {
+                                return std::tie(a.file, a.line, a.column, a.function) ==
+                                       std::tie(b.file, b.line, b.column, b.function);
+                            }),
+                stmts.end());
+    return stmts;
+}
+
+/** Returns the given string as a single-quoted YAML scalar. */
+static std::string lYAMLQuote(const std::string &str) {
+    std::string quoted = "'";
+    for (char c : str) {
+        quoted += c;
+        if (c == '\'') {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+llvm::PreservedAnalyses OptReportPass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("OptReportPass::run", M.getName());
+
+    llvm::FunctionAnalysisManager &FAM = MAM.getResult<llvm::FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    std::map<ReportKey, ReportEntry> entries;
+    for (llvm::Function &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        // The divisions, which InvariantDivisionPass lowers later, aren't
+        // expensive.
+        llvm::LoopInfo *LI = invariantDivision ? &FAM.getResult<llvm::LoopAnalysis>(F) : nullptr;
+        for (llvm::Instruction &I : llvm::instructions(F)) {
+            ReportKind kind;
+            llvm::Value *value = &I;
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I);
+            bool isMemoryOp = callInst != nullptr && lGetMemoryOpKind(callInst, &kind, &value);
+            if (!isMemoryOp && !lGetExpensiveOpKind(&I, &kind)) {
+                continue;
+            }
+            if (kind == ReportKind::IntDivision && LI != nullptr && GetInvariantDivisionLoop(&I, *LI) != nullptr) {
+                continue;
+            }
+
+            std::string file;
+            int line = 0, column = 0;
+            if (!lGetReportPos(&I, &file, &line, &column)) {
+                continue;
+            }
+
+            std::string type;
+            llvm::raw_string_ostream os(type);
+            value->getType()->getScalarType()->print(os);
+            os.flush();
+
+            ReportKey key(file, line, F.getName().str(), kind, type);
+            auto iter = entries.find(key);
+            if (iter == entries.end()) {
+                entries[key] = {column, 1};
+            } else {
+                iter->second.column = std::min(iter->second.column, column);
+                ++iter->second.count;
+            }
+        }
+    }
+
+    std::vector<FrontEndStmt> coherentIfs = lTakeFrontEndStmts(M, "ispc.coherent_ifs");
+    std::vector<FrontEndStmt> fusedLoops = lTakeFrontEndStmts(M, "ispc.fused_foreach_loops");
+
+    std::string target = ISPCTargetToString(g->target->getISPCTarget());
+    if (g->optReport) {
+        fprintf(stderr, "Optimization report for target %s:\n", target.c_str());
+        if (entries.empty()) {
+            fprintf(stderr, "    No gathers, scatters, masked memory operations or expensive operations remain.\n");
+        }
+        for (const auto &[key, entry] : entries) {
+            const auto &[file, line, function, kind, type] = key;
+            fprintf(stderr, "%s:%d:%d: %d %s of %s values in \"%s\"\n", file.c_str(), line, entry.column, entry.count,
+                    lKindDescription(kind, entry.count > 1), type.c_str(), function.c_str());
+        }
+        for (const FrontEndStmt &coherentIf : coherentIfs) {
+            fprintf(stderr, "%s:%d:%d: varying \"if\" with a coherent condition emitted as \"cif\" in \"%s\"\n",
+                    coherentIf.file.c_str(), coherentIf.line, coherentIf.column, coherentIf.function.c_str());
+        }
+        for (const FrontEndStmt &fusedLoop : fusedLoops) {
+            fprintf(stderr, "%s:%d:%d: \"foreach\" loop fused with the preceding loop in \"%s\"\n",
+                    fusedLoop.file.c_str(), fusedLoop.line, fusedLoop.column, fusedLoop.function.c_str());
+        }
+    }
+
+    if (!g->optReportFile.empty()) {
+        // The file is created for the first target and appended to for the
+        // others.
+        static bool reportFileCreated = false;
+        std::error_code error;
+        llvm::raw_fd_ostream os(g->optReportFile, error,
+                                reportFileCreated ? llvm::sys::fs::OF_Append | llvm::sys::fs::OF_Text
+                                                  : llvm::sys::fs::OF_Text);
+        if (error) {
+            Error(SourcePos(), "Cannot open optimization report file \"%s\".\n", g->optReportFile.c_str());
+            return llvm::PreservedAnalyses::all();
+        }
+        reportFileCreated = true;
+
+        for (const auto &[key, entry] : entries) {
+            const auto &[file, line, function, kind, type] = key;
+            os << "--- !Missed\n";
+            os << "Pass:            ispc-opt-report\n";
+            os << "Name:            " << lKindName(kind) << "\n";
+            os << "DebugLoc:        { File: " << lYAMLQuote(file) << ", Line: " << line << ", Column: " << entry.column
+               << " }\n";
+            os << "Function:        " << lYAMLQuote(function) << "\n";
+            os << "Args:\n";
+            os << "  - Target:          " << lYAMLQuote(target) << "\n";
+            os << "  - Type:            " << lYAMLQuote(type) << "\n";
+            os << "  - Count:           '" << entry.count << "'\n";
+            os << "...\n";
+        }
+        auto writePassed = [&os, &target](const char *name, const FrontEndStmt &stmt) {
+            os << "--- !Passed\n";
+            os << "Pass:            ispc-opt-report\n";
+            os << "Name:            " << name << "\n";
+            os << "DebugLoc:        { File: " << lYAMLQuote(stmt.file) << ", Line: " << stmt.line
+               << ", Column: " << stmt.column << " }\n";
+            os << "Function:        " << lYAMLQuote(stmt.function) << "\n";
+            os << "Args:\n";
+            os << "  - Target:          " << lYAMLQuote(target) << "\n";
+            os << "...\n";
+        };
+        for (const FrontEndStmt &coherentIf : coherentIfs) {
+            writePassed("CoherentIf", coherentIf);
+        }
+        for (const FrontEndStmt &fusedLoop : fusedLoops) {
+            writePassed("ForeachFusion", fusedLoop);
+        }
+    }
+
+    return llvm::PreservedAnalyses::all();
+}
+
+/** Returns the '#pragma ispc expect_no_*' flags that the front-end has
+    marked the given call with, and the source position of the call, or
+    zero if it isn't marked.
+ */
+static unsigned int lGetExpectFlags(const llvm::CallInst *callInst, unsigned int mdKind, SourcePos *pos) {
+    llvm::MDNode *md = callInst->getMetadata(mdKind);
+    if (md == nullptr || md->getNumOperands() != 6) {
+        return 0;
+    }
+
+    llvm::ConstantInt *flags = llvm::mdconst::dyn_extract<llvm::ConstantInt>(md->getOperand(0));
+    llvm::MDString *file = llvm::dyn_cast<llvm::MDString>(md->getOperand(1));
+    int position[4];
+    for (int i = 0; i < 4; ++i) {
+        llvm::ConstantInt *value = llvm::mdconst::dyn_extract<llvm::ConstantInt>(md->getOperand(i + 2));
+        if (value == nullptr) {
+            return 0;
+        }
+        position[i] = (int)value->getZExtValue();
+    }
+    if (flags == nullptr || file == nullptr) {
+        return 0;
+    }
+
+    *pos = SourcePos(file->getString().data(), position[0], position[1], position[2], position[3]);
+    return (unsigned int)flags->getZExtValue();
+}
+
+llvm::PreservedAnalyses CheckExpectationsPass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("CheckExpectationsPass::run", M.getName());
+
+    unsigned int mdKind = M.getContext().getMDKindID("ispc_expect");
+    // Each source position is reported once for each directive, even if
+    // its code has been duplicated.
+    std::set<std::tuple<std::string, int, int, std::string>> reported;
+    for (llvm::Function &F : M) {
+        for (llvm::Instruction &I : llvm::instructions(F)) {
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I);
+            SourcePos pos;
+            unsigned int flags = callInst != nullptr ? lGetExpectFlags(callInst, mdKind, &pos) : 0;
+            if (flags == 0) {
+                continue;
+            }
+
+            const char *operation = nullptr, *pragma = nullptr;
+            ReportKind kind;
+            llvm::Value *value = nullptr;
+            if (afterInlining) {
+                llvm::Function *func = callInst->getCalledFunction();
+                if ((flags & Globals::pragmaExpectType::expectNoCall) && (func == nullptr || !func->isIntrinsic())) {
+                    operation = "Function call";
+                    pragma = "call";
+                }
+            } else if (lGetMemoryOpKind(callInst, &kind, &value)) {
+                if (kind == ReportKind::Gather && (flags & Globals::pragmaExpectType::expectNoGather)) {
+                    operation = "Gather";
+                    pragma = "gather";
+                } else if (kind == ReportKind::Scatter && (flags & Globals::pragmaExpectType::expectNoScatter)) {
+                    operation = "Scatter";
+                    pragma = "scatter";
+                } else if (kind == ReportKind::MaskedStore &&
+                           (flags & Globals::pragmaExpectType::expectNoMaskedStore)) {
+                    operation = "Masked store";
+                    pragma = "masked_store";
+                }
+            }
+
+            if (operation != nullptr &&
+                reported.insert(std::make_tuple(pos.name, pos.first_line, pos.first_column, pragma)).second) {
+                Error(pos, "%s remains after optimization in code with '#pragma ispc expect_no_%s'.", operation,
+                      pragma);
+            }
+        }
+    }
+
+    return llvm::PreservedAnalyses::all();
+}
+
+} // namespace ispc
@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+/** With --opt-report or --opt-report-file, this pass reports the gathers,
+    scatters and masked loads and stores that remain after the memory
+    operations have been optimized, and the vector operations that are
+    expensive on the target (the ones that the performance warnings are
+    about), for each line of the source code that they come from.
+
+    It runs after the pseudo memory operations have been replaced with the
+    target's implementations and before those are inlined, so that they can
+    still be told apart.  The source positions come from the metadata that
+    the front-end adds to memory operations, or from the debug locations
+    with -g.  Operations without a source position, and the ones in the
+    standard library, aren't reported.
+
+    It also lists the varying "if" statements that the front-end emitted
+    like "cif" statements, which it records in the "ispc.coherent_ifs"
+    named metadata of the module; the metadata is removed afterwards.
+
+    The report is printed as text to stderr with --opt-report, and written
+    to a file as YAML documents in the format of LLVM's optimization
+    records with --opt-report-file.
+
+    If InvariantDivisionPass runs later in the pipeline, the divisions that
+    it lowers to multiplications aren't reported.
+ */
+class OptReportPass : public llvm::PassInfoMixin<OptReportPass> {
+  public:
+    explicit OptReportPass(bool invariantDivision = false) : invariantDivision(invariantDivision) {}
+
+    static llvm::StringRef getPassName() { return "Optimization report"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+
+  private:
+    bool invariantDivision;
+};
+
+/** This pass checks the '#pragma ispc expect_no_*' directives of loops and
+    functions, which the front-end marks the calls in their code with.
+
+    Before the target's implementations of the memory operations are
+    inlined (at the same point as OptReportPass), it reports an error for
+    each marked gather, scatter or masked store that remains.  After
+    inlining, it reports an error for each marked call of a function that
+    remains.  The operations that come from functions that are inlined into
+    the marked code aren't marked, so only the ones in the code itself are
+    checked.
+ */
+class CheckExpectationsPass : public llvm::PassInfoMixin<CheckExpectationsPass> {
+  public:
+    explicit CheckExpectationsPass(bool afterInlining) : afterInlining(afterInlining) {}
+
+    static llvm::StringRef getPassName() { return "Check expectations"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+
+  private:
+    bool afterInlining;
+};
+
+} // namespace ispc
@@ -7,56 +7,16 @@
 #include "PeepholePass.h"
 #include "builtins-decl.h"
 
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/IRBuilder.h>
+#ifdef ISPC_ARM_ENABLED
+#include <llvm/IR/IntrinsicsAArch64.h>
+#endif
+
 namespace ispc {
 
 using namespace llvm::PatternMatch;
 
-template <typename Op_t, unsigned Opcode> struct CastClassTypes_match {
-    Op_t Op;
-    const llvm::Type *fromType, *toType;
-
-    CastClassTypes_match(const Op_t &OpMatch, const llvm::Type *f, const llvm::Type *t)
-        : Op(OpMatch), fromType(f), toType(t) {}
-
-    template <typename OpTy> bool match(OpTy *V) {
-        if (llvm::Operator *O = llvm::dyn_cast<llvm::Operator>(V)) {
-            return (O->getOpcode() == Opcode && Op.match(O->getOperand(0)) && O->getType() == toType &&
-                    O->getOperand(0)->getType() == fromType);
-        }
-        return false;
-    }
-};
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::SExt> m_SExt8To16(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::SExt>(Op, LLVMTypes::Int8VectorType,
-                                                               LLVMTypes::Int16VectorType);
-}
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::ZExt> m_ZExt8To16(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::ZExt>(Op, LLVMTypes::Int8VectorType,
-                                                               LLVMTypes::Int16VectorType);
-}
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::Trunc> m_Trunc16To8(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::Trunc>(Op, LLVMTypes::Int16VectorType,
-                                                                LLVMTypes::Int8VectorType);
-}
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::SExt> m_SExt16To32(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::SExt>(Op, LLVMTypes::Int16VectorType,
-                                                               LLVMTypes::Int32VectorType);
-}
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::ZExt> m_ZExt16To32(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::ZExt>(Op, LLVMTypes::Int16VectorType,
-                                                               LLVMTypes::Int32VectorType);
-}
-
-template <typename OpTy> inline CastClassTypes_match<OpTy, llvm::Instruction::Trunc> m_Trunc32To16(const OpTy &Op) {
-    return CastClassTypes_match<OpTy, llvm::Instruction::Trunc>(Op, LLVMTypes::Int32VectorType,
-                                                                LLVMTypes::Int16VectorType);
-}
-
 template <typename Op_t> struct UDiv2_match {
     Op_t Op;
 
@@ -72,10 +32,10 @@ template <typename Op_t> struct UDiv2_match {
             switch (bop->getOpcode()) {
             case llvm::Instruction::UDiv:
                 // divide by 2
-                return (apInt.isIntN(2) && Op.match(bop->getOperand(0)));
+                return (apInt == 2 && Op.match(bop->getOperand(0)));
             case llvm::Instruction::LShr:
-                // shift left by 1
-                return (apInt.isIntN(1) && Op.match(bop->getOperand(0)));
+                // shift right by 1
+                return (apInt == 1 && Op.match(bop->getOperand(0)));
             default:
                 return false;
             }
@@ -101,10 +61,10 @@ template <typename Op_t> struct SDiv2_match {
             switch (bop->getOpcode()) {
             case llvm::Instruction::SDiv:
                 // divide by 2
-                return (apInt.isIntN(2) && Op.match(bop->getOperand(0)));
+                return (apInt == 2 && Op.match(bop->getOperand(0)));
             case llvm::Instruction::AShr:
-                // shift left by 1
-                return (apInt.isIntN(1) && Op.match(bop->getOperand(0)));
+                // shift right by 1
+                return (apInt == 1 && Op.match(bop->getOperand(0)));
             default:
                 return false;
             }
@@ -149,111 +109,342 @@ static llvm::Instruction *lGetBinaryIntrinsic(llvm::Module *M, const char *name,
 
 //////////////////////////////////////////////////
 
-static llvm::Instruction *lMatchAvgUpUInt8(llvm::Instruction *inst) {
-    // (unsigned int8)(((unsigned int16)a + (unsigned int16)b + 1)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    const llvm::APInt *delta = nullptr;
-    if (match(inst, m_Trunc16To8(m_UDiv2(m_CombineOr(
-                        m_CombineOr(m_Add(m_ZExt8To16(m_Value(opa)), m_Add(m_ZExt8To16(m_Value(opb)), m_APInt(delta))),
-                                    m_Add(m_Add(m_ZExt8To16(m_Value(opa)), m_APInt(delta)), m_ZExt8To16(m_Value(opb)))),
-                        m_Add(m_Add(m_ZExt8To16(m_Value(opa)), m_ZExt8To16(m_Value(opb))), m_APInt(delta))))))) {
-        if (delta->isIntN(1) == false) {
+// Collects the terms of the tree of adds rooted at the given value, looking
+// through the adds that have no other uses. Returns false if there are more
+// than maxTerms of them.
+static bool lCollectAddends(llvm::Value *value, llvm::SmallVectorImpl<llvm::Value *> &terms, unsigned maxTerms,
+                            bool isRoot = true) {
+    llvm::Value *lhs = nullptr, *rhs = nullptr;
+    if ((isRoot || value->hasOneUse()) && match(value, m_Add(m_Value(lhs), m_Value(rhs)))) {
+        return lCollectAddends(lhs, terms, maxTerms, false) && lCollectAddends(rhs, terms, maxTerms, false);
+    }
+    terms.push_back(value);
+    return terms.size() <= maxTerms;
+}
+
+static llvm::Instruction *lMatchAvg(llvm::Instruction *inst) {
+    // (int8)(((int16)a + (int16)b + 1)/2) and the same with unsigned types,
+    // int16 results or any wider type of the intermediate sum.
+    llvm::Type *type = inst->getType();
+    if (type != LLVMTypes::Int8VectorType && type != LLVMTypes::Int16VectorType) {
+        return nullptr;
+    }
+
+    llvm::Value *sum = nullptr;
+    bool isSignedDiv = false;
+    if (match(inst, m_Trunc(m_SDiv2(m_Value(sum))))) {
+        isSignedDiv = true;
+    } else if (!match(inst, m_Trunc(m_UDiv2(m_Value(sum))))) {
+        return nullptr;
+    }
+
+    llvm::SmallVector<llvm::Value *, 3> terms;
+    if (!lCollectAddends(sum, terms, 3)) {
+        return nullptr;
+    }
+    llvm::SmallVector<llvm::Value *, 2> ops;
+    int numSExt = 0;
+    bool roundUp = false;
+    for (llvm::Value *term : terms) {
+        llvm::Value *op = nullptr;
+        if (match(term, m_ZExt(m_Value(op))) && op->getType() == type) {
+            ops.push_back(op);
+        } else if (match(term, m_SExt(m_Value(op))) && op->getType() == type) {
+            ops.push_back(op);
+            ++numSExt;
+        } else if (!roundUp && match(term, m_One())) {
+            roundUp = true;
+        } else {
             return nullptr;
         }
+    }
+    // The sum of two sign extended values may be negative, so it has to be
+    // divided as a signed one. The sum of two zero extended values is never
+    // negative and may be divided either way.
+    if (ops.size() != 2 || (numSExt != 0 && numSExt != 2) || (numSExt == 2 && !isSignedDiv)) {
+        return nullptr;
+    }
 
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_up_uint8, opa, opb);
+    bool isSigned = numSExt == 2;
+    const char *name = nullptr;
+    if (type == LLVMTypes::Int8VectorType) {
+        name = roundUp ? (isSigned ? builtin::__avg_up_int8 : builtin::__avg_up_uint8)
+                       : (isSigned ? builtin::__avg_down_int8 : builtin::__avg_down_uint8);
+    } else {
+        name = roundUp ? (isSigned ? builtin::__avg_up_int16 : builtin::__avg_up_uint16)
+                       : (isSigned ? builtin::__avg_down_int16 : builtin::__avg_down_uint16);
     }
-    return nullptr;
+    return lGetBinaryIntrinsic(inst->getModule(), name, ops[0], ops[1]);
 }
 
-static llvm::Instruction *lMatchAvgDownUInt8(llvm::Instruction *inst) {
-    // (unsigned int8)(((unsigned int16)a + (unsigned int16)b)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    if (match(inst, m_Trunc16To8(m_UDiv2(m_Add(m_ZExt8To16(m_Value(opa)), m_ZExt8To16(m_Value(opb))))))) {
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_down_uint8, opa, opb);
+static bool lIsX86() { return g->target->getArch() == Arch::x86 || g->target->getArch() == Arch::x86_64; }
+
+/** Matches the absolute difference of two vectors of unsigned int8 values,
+    in any of the forms it's usually written in, and sets *a and *b to the
+    vectors. */
+static bool lMatchAbsDiffUInt8(llvm::Value *value, llvm::Value **a, llvm::Value **b) {
+    llvm::Value *x = nullptr, *y = nullptr;
+    // max(a, b) - min(a, b)
+    if (match(value, m_Sub(m_UMax(m_Value(x), m_Value(y)), m_c_UMin(m_Deferred(x), m_Deferred(y))))) {
+        *a = x;
+        *b = y;
+        return true;
     }
-    return nullptr;
+    // (uint8)abs((int)a - (int)b)
+    if (match(value, m_Trunc(m_Intrinsic<llvm::Intrinsic::abs>(m_Sub(m_ZExt(m_Value(x)), m_ZExt(m_Value(y)))))) &&
+        x->getType() == value->getType() && y->getType() == value->getType()) {
+        *a = x;
+        *b = y;
+        return true;
+    }
+    // saturating_sub(a, b) | saturating_sub(b, a)
+    if (match(value, m_c_Or(m_Intrinsic<llvm::Intrinsic::usub_sat>(m_Value(x), m_Value(y)),
+                            m_Intrinsic<llvm::Intrinsic::usub_sat>(m_Deferred(y), m_Deferred(x))))) {
+        *a = x;
+        *b = y;
+        return true;
+    }
+    // a > b ? a - b : b - a
+    llvm::Value *p = nullptr, *q = nullptr;
+    llvm::ICmpInst *cmp = nullptr;
+    if (!match(value, m_Select(m_Value(x), m_Sub(m_Value(p), m_Value(q)), m_Sub(m_Deferred(q), m_Deferred(p)))) ||
+        (cmp = llvm::dyn_cast<llvm::ICmpInst>(x)) == nullptr) {
+        return false;
+    }
+    llvm::ICmpInst::Predicate pred = cmp->getPredicate();
+    if (pred == llvm::ICmpInst::ICMP_ULT || pred == llvm::ICmpInst::ICMP_ULE) {
+        std::swap(p, q);
+    } else if (pred != llvm::ICmpInst::ICMP_UGT && pred != llvm::ICmpInst::ICMP_UGE) {
+        return false;
+    }
+    if (p != cmp->getOperand(0) || q != cmp->getOperand(1)) {
+        return false;
+    }
+    *a = p;
+    *b = q;
+    return true;
 }
 
-static llvm::Instruction *lMatchAvgUpUInt16(llvm::Instruction *inst) {
-    // (unsigned int16)(((unsigned int32)a + (unsigned int32)b + 1)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    const llvm::APInt *delta = nullptr;
-    if (match(inst,
-              m_Trunc32To16(m_UDiv2(m_CombineOr(
-                  m_CombineOr(m_Add(m_ZExt16To32(m_Value(opa)), m_Add(m_ZExt16To32(m_Value(opb)), m_APInt(delta))),
-                              m_Add(m_Add(m_ZExt16To32(m_Value(opa)), m_APInt(delta)), m_ZExt16To32(m_Value(opb)))),
-                  m_Add(m_Add(m_ZExt16To32(m_Value(opa)), m_ZExt16To32(m_Value(opb))), m_APInt(delta))))))) {
-        if (delta->isIntN(1) == false) {
-            return nullptr;
-        }
+static llvm::Value *lMatchSAD(llvm::Instruction *inst) {
+    // psadbw(|a - b|, 0), which is how the x86 targets reduce_add() int8
+    // values, computes psadbw(a, b).
+    llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst);
+    if (call == nullptr || (call->getIntrinsicID() != llvm::Intrinsic::x86_sse2_psad_bw &&
+                            call->getIntrinsicID() != llvm::Intrinsic::x86_avx2_psad_bw &&
+                            call->getIntrinsicID() != llvm::Intrinsic::x86_avx512_psad_bw_512)) {
+        return nullptr;
+    }
+    if (!match(call->getArgOperand(1), m_Zero())) {
+        return nullptr;
+    }
 
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_up_uint16, opa, opb);
+    // The bytes of the program instances may be padded to the width of the
+    // instruction, and the inactive program instances may be zeroed.
+    llvm::Value *bytes = call->getArgOperand(0), *padding = nullptr;
+    llvm::ArrayRef<int> paddingMask;
+    if (match(bytes, m_Shuffle(m_Value(bytes), m_Value(padding), m_Mask(paddingMask))) &&
+        !llvm::isa<llvm::UndefValue>(padding) && !match(padding, m_Zero())) {
+        return nullptr;
     }
-    return nullptr;
+    llvm::Value *active = nullptr, *activeBytes = nullptr;
+    if (match(bytes, m_Select(m_Value(active), m_Value(activeBytes), m_Zero()))) {
+        bytes = activeBytes;
+    } else {
+        active = nullptr;
+    }
+
+    llvm::Value *a = nullptr, *b = nullptr;
+    if (!lMatchAbsDiffUInt8(bytes, &a, &b)) {
+        return nullptr;
+    }
+
+    llvm::IRBuilder<> builder(inst);
+    if (active != nullptr) {
+        a = builder.CreateSelect(active, a, llvm::Constant::getNullValue(a->getType()));
+        b = builder.CreateSelect(active, b, llvm::Constant::getNullValue(b->getType()));
+    }
+    if (padding != nullptr) {
+        a = builder.CreateShuffleVector(a, padding, paddingMask);
+        b = builder.CreateShuffleVector(b, padding, paddingMask);
+    }
+    return builder.CreateCall(call->getCalledFunction(), {a, b});
 }
 
-static llvm::Instruction *lMatchAvgDownUInt16(llvm::Instruction *inst) {
-    // (unsigned int16)(((unsigned int32)a + (unsigned int32)b)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    if (match(inst, m_Trunc32To16(m_UDiv2(m_Add(m_ZExt16To32(m_Value(opa)), m_ZExt16To32(m_Value(opb))))))) {
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_down_uint16, opa, opb);
+// Matches the sign extended high int16 half of the int32 values.
+static bool lMatchHighInt16(llvm::Value *value, llvm::Value **packed) {
+    llvm::Value *half = nullptr;
+    return match(value, m_AShr(m_Value(*packed), m_SpecificInt(16))) ||
+           (match(value, m_SExt(m_CombineAnd(m_Value(half), m_Trunc(m_Shr(m_Value(*packed), m_SpecificInt(16)))))) &&
+            half->getType()->getScalarType()->isIntegerTy(16));
+}
+
+// Matches the sign extended low int16 half of the int32 values.
+static bool lMatchLowInt16(llvm::Value *value, llvm::Value **packed) {
+    if (match(value, m_AShr(m_Shl(m_Value(*packed), m_SpecificInt(16)), m_SpecificInt(16)))) {
+        return true;
     }
-    return nullptr;
+    llvm::Value *half = nullptr;
+    return match(value, m_SExt(m_CombineAnd(m_Value(half), m_Trunc(m_Value(*packed))))) &&
+           half->getType()->getScalarType()->isIntegerTy(16);
 }
 
-static llvm::Instruction *lMatchAvgUpInt8(llvm::Instruction *inst) {
-    // (int8)(((int16)a + (int16)b + 1)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    const llvm::APInt *delta = nullptr;
-    if (match(inst, m_Trunc16To8(m_SDiv2(m_CombineOr(
-                        m_CombineOr(m_Add(m_SExt8To16(m_Value(opa)), m_Add(m_SExt8To16(m_Value(opb)), m_APInt(delta))),
-                                    m_Add(m_Add(m_SExt8To16(m_Value(opa)), m_APInt(delta)), m_SExt8To16(m_Value(opb)))),
-                        m_Add(m_Add(m_SExt8To16(m_Value(opa)), m_SExt8To16(m_Value(opb))), m_APInt(delta))))))) {
-        if (delta->isIntN(1) == false) {
-            return nullptr;
+/** Returns the pairwise sums of the products of the int16 halves of the
+    given int32 values, computed with the multiply-add instructions of the
+    target, or nullptr if the target doesn't have them. */
+static llvm::Value *lEmitPMAddWD(llvm::Value *a, llvm::Value *b, llvm::IRBuilder<> &builder) {
+    llvm::Module *module = builder.GetInsertBlock()->getModule();
+    int width = llvm::cast<llvm::FixedVectorType>(a->getType())->getNumElements();
+    Target::ISA isa = g->target->getISA();
+
+    llvm::Function *pmadd = nullptr;
+    int chunkWidth = 0;
+    if (lIsX86() && isa <= Target::AVX10) {
+        llvm::Intrinsic::ID id = llvm::Intrinsic::x86_sse2_pmadd_wd;
+        chunkWidth = 4;
+        if (width >= 16 && isa >= Target::SKX_AVX512 && isa <= Target::SPR_AVX512 && !g->opt.disableZMM) {
+            id = llvm::Intrinsic::x86_avx512_pmaddw_d_512;
+            chunkWidth = 16;
+        } else if (width >= 8 && isa >= Target::AVX2) {
+            id = llvm::Intrinsic::x86_avx2_pmadd_wd;
+            chunkWidth = 8;
         }
+        pmadd = llvm::Intrinsic::getDeclaration(module, id);
+    }
+#ifdef ISPC_ARM_ENABLED
+    else if (g->target->getArch() == Arch::aarch64) {
+        chunkWidth = 4;
+    }
+#endif
+    if (chunkWidth == 0 || width % chunkWidth != 0) {
+        return nullptr;
+    }
 
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_up_int8, opa, opb);
+    llvm::Type *halvesType = llvm::FixedVectorType::get(LLVMTypes::Int16Type, 2 * width);
+    a = builder.CreateBitCast(a, halvesType);
+    b = builder.CreateBitCast(b, halvesType);
+    llvm::SmallVector<llvm::Value *, 4> chunks;
+    for (int first = 0; first < 2 * width; first += 2 * chunkWidth) {
+        llvm::Value *chunkA = a, *chunkB = b;
+        if (chunkWidth < width) {
+            chunkA = builder.CreateShuffleVector(a, llvm::createSequentialMask(first, 2 * chunkWidth, 0));
+            chunkB = builder.CreateShuffleVector(b, llvm::createSequentialMask(first, 2 * chunkWidth, 0));
+        }
+        if (pmadd != nullptr) {
+            chunks.push_back(builder.CreateCall(pmadd, {chunkA, chunkB}));
+            continue;
+        }
+#ifdef ISPC_ARM_ENABLED
+        // Multiply the low and the high four halves with smull and add the
+        // adjacent products with addp.
+        llvm::Type *productType = llvm::FixedVectorType::get(LLVMTypes::Int32Type, 4);
+        llvm::Function *smull = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::aarch64_neon_smull, productType);
+        llvm::Function *addp = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::aarch64_neon_addp, productType);
+        llvm::Value *low = builder.CreateCall(smull, {builder.CreateShuffleVector(chunkA, {0, 1, 2, 3}),
+                                                      builder.CreateShuffleVector(chunkB, {0, 1, 2, 3})});
+        llvm::Value *high = builder.CreateCall(smull, {builder.CreateShuffleVector(chunkA, {4, 5, 6, 7}),
+                                                       builder.CreateShuffleVector(chunkB, {4, 5, 6, 7})});
+        chunks.push_back(builder.CreateCall(addp, {low, high}));
+#endif
     }
-    return nullptr;
+    return llvm::concatenateVectors(builder, chunks);
 }
 
-static llvm::Instruction *lMatchAvgDownInt8(llvm::Instruction *inst) {
-    // (int8)(((int16)a + (int16)b)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    if (match(inst, m_Trunc16To8(m_SDiv2(m_Add(m_SExt8To16(m_Value(opa)), m_SExt8To16(m_Value(opb))))))) {
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_down_int8, opa, opb);
+static llvm::Value *lMatchPMAddWD(llvm::Instruction *inst) {
+    // (int32)(int16)(a >> 16) * (int32)(int16)(b >> 16) + (int32)(int16)a * (int32)(int16)b,
+    // which is how dot2add_i16packed() is computed without VNNI, plus any
+    // other terms.
+    if (inst->getType() != LLVMTypes::Int32VectorType || inst->getOpcode() != llvm::Instruction::Add) {
+        return nullptr;
+    }
+    llvm::SmallVector<llvm::Value *, 8> terms;
+    if (!lCollectAddends(inst, terms, 8)) {
+        return nullptr;
     }
-    return nullptr;
-}
 
-static llvm::Instruction *lMatchAvgUpInt16(llvm::Instruction *inst) {
-    // (int16)(((int32)a + (int32)b + 1)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    const llvm::APInt *delta = nullptr;
-    if (match(inst,
-              m_Trunc32To16(m_SDiv2(m_CombineOr(
-                  m_CombineOr(m_Add(m_SExt16To32(m_Value(opa)), m_Add(m_SExt16To32(m_Value(opb)), m_APInt(delta))),
-                              m_Add(m_Add(m_SExt16To32(m_Value(opa)), m_APInt(delta)), m_SExt16To32(m_Value(opb)))),
-                  m_Add(m_Add(m_SExt16To32(m_Value(opa)), m_SExt16To32(m_Value(opb))), m_APInt(delta))))))) {
-        if (delta->isIntN(1) == false) {
-            return nullptr;
+    for (unsigned i = 0; i < terms.size(); ++i) {
+        llvm::Value *lowA = nullptr, *lowB = nullptr, *lowX = nullptr, *lowY = nullptr;
+        if (!match(terms[i], m_Mul(m_Value(lowX), m_Value(lowY))) || !lMatchLowInt16(lowX, &lowA) ||
+            !lMatchLowInt16(lowY, &lowB)) {
+            continue;
         }
+        for (unsigned j = 0; j < terms.size(); ++j) {
+            llvm::Value *highA = nullptr, *highB = nullptr, *highX = nullptr, *highY = nullptr;
+            if (i == j || !match(terms[j], m_Mul(m_Value(highX), m_Value(highY))) ||
+                !lMatchHighInt16(highX, &highA) || !lMatchHighInt16(highY, &highB)) {
+                continue;
+            }
+            if (!((highA == lowA && highB == lowB) || (highA == lowB && highB == lowA)) ||
+                lowA->getType() != LLVMTypes::Int32VectorType || lowB->getType() != LLVMTypes::Int32VectorType) {
+                continue;
+            }
 
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_up_int16, opa, opb);
+            llvm::IRBuilder<> builder(inst);
+            llvm::Value *result = lEmitPMAddWD(lowA, lowB, builder);
+            if (result == nullptr) {
+                return nullptr;
+            }
+            for (unsigned k = 0; k < terms.size(); ++k) {
+                if (k != i && k != j) {
+                    result = builder.CreateAdd(result, terms[k]);
+                }
+            }
+            return result;
+        }
     }
     return nullptr;
 }
 
-static llvm::Instruction *lMatchAvgDownInt16(llvm::Instruction *inst) {
-    // (int16)(((int32)a + (int32)b)/2)
-    llvm::Value *opa = nullptr, *opb = nullptr;
-    if (match(inst, m_Trunc32To16(m_SDiv2(m_Add(m_SExt16To32(m_Value(opa)), m_SExt16To32(m_Value(opb))))))) {
-        return lGetBinaryIntrinsic(inst->getModule(), builtin::__avg_down_int16, opa, opb);
+#ifdef ISPC_ARM_ENABLED
+static llvm::Value *lMatchSaturatingTrunc(llvm::Instruction *inst) {
+    // (int16)clamp(a, -32768, 32767), (int16)clamp(a, 0, 65535) and
+    // (uint16)min(a, 65535), and the same for the other halving casts, are
+    // single sqxtn, sqxtun and uqxtn instructions.
+    llvm::TruncInst *trunc = llvm::dyn_cast<llvm::TruncInst>(inst);
+    if (trunc == nullptr || g->target->getArch() != Arch::aarch64 || !trunc->getType()->isVectorTy()) {
+        return nullptr;
     }
-    return nullptr;
+    llvm::FixedVectorType *srcType = llvm::cast<llvm::FixedVectorType>(trunc->getSrcTy());
+    unsigned srcBits = srcType->getScalarSizeInBits(), dstBits = trunc->getType()->getScalarSizeInBits();
+    int width = srcType->getNumElements();
+    if (srcBits != 2 * dstBits || dstBits < 8 || dstBits > 32 || (width * srcBits) % 128 != 0) {
+        return nullptr;
+    }
+
+    llvm::Value *value = nullptr;
+    const llvm::APInt *low = nullptr, *high = nullptr;
+    llvm::Intrinsic::ID id = llvm::Intrinsic::not_intrinsic;
+    if (match(trunc->getOperand(0), m_CombineOr(m_SMin(m_SMax(m_Value(value), m_APInt(low)), m_APInt(high)),
+                                                m_SMax(m_SMin(m_Value(value), m_APInt(high)), m_APInt(low))))) {
+        if (*low == llvm::APInt::getSignedMinValue(dstBits).sext(srcBits) &&
+            *high == llvm::APInt::getSignedMaxValue(dstBits).sext(srcBits)) {
+            id = llvm::Intrinsic::aarch64_neon_sqxtn;
+        } else if (low->isZero() && *high == llvm::APInt::getMaxValue(dstBits).zext(srcBits)) {
+            id = llvm::Intrinsic::aarch64_neon_sqxtun;
+        }
+    } else if (match(trunc->getOperand(0), m_UMin(m_Value(value), m_APInt(high))) &&
+               *high == llvm::APInt::getMaxValue(dstBits).zext(srcBits)) {
+        id = llvm::Intrinsic::aarch64_neon_uqxtn;
+    }
+    if (id == llvm::Intrinsic::not_intrinsic) {
+        return nullptr;
+    }
+
+    // The instructions narrow a 128-bit vector.
+    int chunkWidth = 128 / srcBits;
+    llvm::Type *chunkType = llvm::FixedVectorType::get(trunc->getType()->getScalarType(), chunkWidth);
+    llvm::Function *narrow = llvm::Intrinsic::getDeclaration(inst->getModule(), id, chunkType);
+    llvm::IRBuilder<> builder(inst);
+    llvm::SmallVector<llvm::Value *, 4> chunks;
+    for (int first = 0; first < width; first += chunkWidth) {
+        llvm::Value *chunk = value;
+        if (chunkWidth < width) {
+            chunk = builder.CreateShuffleVector(value, llvm::createSequentialMask(first, chunkWidth, 0));
+        }
+        chunks.push_back(builder.CreateCall(narrow, {chunk}));
+    }
+    return llvm::concatenateVectors(builder, chunks);
 }
+#endif
 
 bool PeepholePass::matchAndReplace(llvm::BasicBlock &bb) {
     DEBUG_START_BB("PeepholePass");
@@ -265,30 +456,30 @@ bool PeepholePass::matchAndReplace(llvm::BasicBlock &bb) {
     for (llvm::BasicBlock::iterator iter = bb.begin(), e = bb.end(); iter != e;) {
         llvm::Instruction *inst = &*(iter++);
 
-        llvm::Instruction *builtinCall = lMatchAvgUpUInt8(inst);
-        if (!builtinCall) {
-            builtinCall = lMatchAvgUpUInt16(inst);
-        }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgDownUInt8(inst);
-        }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgDownUInt16(inst);
-        }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgUpInt8(inst);
+        llvm::Instruction *builtinCall = lMatchAvg(inst);
+        if (builtinCall != nullptr) {
+            llvm::ReplaceInstWithInst(inst, builtinCall);
+            modifiedAny = true;
+            continue;
         }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgUpInt16(inst);
+
+        // The other idioms are emitted right before the instruction.
+        llvm::Value *replacement = nullptr;
+        if (lIsX86()) {
+            replacement = lMatchSAD(inst);
         }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgDownInt8(inst);
+        if (!replacement) {
+            replacement = lMatchPMAddWD(inst);
         }
-        if (!builtinCall) {
-            builtinCall = lMatchAvgDownInt16(inst);
+#ifdef ISPC_ARM_ENABLED
+        if (!replacement) {
+            replacement = lMatchSaturatingTrunc(inst);
         }
-        if (builtinCall != nullptr) {
-            llvm::ReplaceInstWithInst(inst, builtinCall);
+#endif
+        if (replacement != nullptr) {
+            replacement->takeName(inst);
+            inst->replaceAllUsesWith(replacement);
+            inst->eraseFromParent();
             modifiedAny = true;
         }
     }
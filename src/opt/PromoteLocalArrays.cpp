@@ -0,0 +1,637 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "PromoteLocalArrays.h"
+#include "builtins-decl.h"
+
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/KnownBits.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ispc {
+
+using namespace builtin;
+
+// How the operands of a base+offsets gather or scatter are laid out.
+enum class MemOpKind {
+    None,
+    // @__pseudo_gather_base_offsets{32,64}_*(i8 *base, i32 scale, <WIDTH x i{32,64}> offsets, <WIDTH x MASK>)
+    Gather,
+    // @__pseudo_gather_factored_base_offsets{32,64}_*(i8 *base, <WIDTH x i{32,64}> varyingOffsets, i32 scale,
+    //                                                 <WIDTH x i{32,64}> constOffsets, <WIDTH x MASK>)
+    FactoredGather,
+    // @__pseudo_scatter_base_offsets{32,64}_*(i8 *base, i32 scale, <WIDTH x i{32,64}> offsets,
+    //                                         <WIDTH x T> value, <WIDTH x MASK>)
+    Scatter,
+    // @__pseudo_scatter_factored_base_offsets{32,64}_*(i8 *base, <WIDTH x i{32,64}> varyingOffsets, i32 scale,
+    //                                                  <WIDTH x i{32,64}> constOffsets, <WIDTH x T> value,
+    //                                                  <WIDTH x MASK>)
+    FactoredScatter,
+};
+
+static MemOpKind lGetMemOpKind(llvm::CallInst *callInst) {
+    static std::unordered_map<std::string, MemOpKind> memOps = {
+        {__pseudo_gather_base_offsets32_i8, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_i16, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_half, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_i32, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_float, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_i64, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets32_double, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_i8, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_i16, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_half, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_i32, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_float, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_i64, MemOpKind::Gather},
+        {__pseudo_gather_base_offsets64_double, MemOpKind::Gather},
+        {__pseudo_gather_factored_base_offsets32_i8, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_i16, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_half, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_i32, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_float, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_i64, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets32_double, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_i8, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_i16, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_half, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_i32, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_float, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_i64, MemOpKind::FactoredGather},
+        {__pseudo_gather_factored_base_offsets64_double, MemOpKind::FactoredGather},
+        {__pseudo_scatter_base_offsets32_i8, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_i16, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_half, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_i32, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_float, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_i64, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets32_double, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_i8, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_i16, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_half, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_i32, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_float, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_i64, MemOpKind::Scatter},
+        {__pseudo_scatter_base_offsets64_double, MemOpKind::Scatter},
+        {__pseudo_scatter_factored_base_offsets32_i8, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_i16, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_half, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_i32, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_float, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_i64, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets32_double, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_i8, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_i16, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_half, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_i32, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_float, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_i64, MemOpKind::FactoredScatter},
+        {__pseudo_scatter_factored_base_offsets64_double, MemOpKind::FactoredScatter},
+    };
+
+    llvm::Function *calledFunc = callInst->getCalledFunction();
+    if (calledFunc == nullptr) {
+        return MemOpKind::None;
+    }
+    auto it = memOps.find(calledFunc->getName().str());
+    return it == memOps.end() ? MemOpKind::None : it->second;
+}
+
+// A gather or scatter from a local array.
+struct ArrayAccess {
+    llvm::CallInst *callInst = nullptr;
+    bool isScatter = false;
+    // The offsets in bytes of the accessed scalars from the start of the
+    // array are offsets * scale + constOffsets.
+    llvm::Value *offsets = nullptr;
+    int64_t scale = 0;
+    std::vector<int64_t> constOffsets;
+    llvm::Value *value = nullptr;
+    llvm::Value *mask = nullptr;
+    // The field of the elements of an array of varying structs that is
+    // accessed.
+    unsigned field = 0;
+};
+
+// A local array, i.e. an alloca of an array of scalars, of vectors of the
+// target width or of varying structs, whose fields are such vectors, and
+// its gathers and scatters.
+struct LocalArray {
+    llvm::AllocaInst *alloca = nullptr;
+    llvm::ArrayType *arrayType = nullptr;
+    // The scalars of the array, i.e. its elements or their lanes, or the
+    // lanes of the fields of varying structs.
+    llvm::Type *scalarType = nullptr;
+    int64_t scalarSize = 0;
+    llvm::StructType *structType = nullptr;
+    bool isVarying = false;
+    bool canLower = true;
+    std::vector<ArrayAccess> accesses;
+};
+
+/** Returns the alloca that the given base pointer of a gather or scatter
+    points into, and adds the offset of the pointer from its start to
+    *baseOffset, or returns nullptr if it isn't a pointer into an alloca
+    with a fixed size. */
+static llvm::AllocaInst *lGetAlloca(llvm::Value *base, const llvm::DataLayout &DL, int64_t *baseOffset) {
+    // The base pointer usually comes from inttoptr of ptrtoint.
+    while (llvm::Operator *op = llvm::dyn_cast<llvm::Operator>(base)) {
+        unsigned opcode = op->getOpcode();
+        if (opcode != llvm::Instruction::IntToPtr && opcode != llvm::Instruction::PtrToInt &&
+            opcode != llvm::Instruction::BitCast) {
+            break;
+        }
+        base = op->getOperand(0);
+    }
+    if (!llvm::isa<llvm::PointerType>(base->getType())) {
+        return nullptr;
+    }
+
+    llvm::APInt offset(DL.getIndexTypeSizeInBits(base->getType()), 0);
+    llvm::AllocaInst *alloca =
+        llvm::dyn_cast<llvm::AllocaInst>(base->stripAndAccumulateConstantOffsets(DL, offset, true));
+    if (alloca == nullptr || !alloca->isStaticAlloca()) {
+        return nullptr;
+    }
+    *baseOffset = offset.getSExtValue();
+    return alloca;
+}
+
+/** Returns the type of the lanes of the given vector of the target width
+    of whole-byte scalars, or nullptr if it isn't such a vector. */
+static llvm::Type *lGetVaryingScalarType(llvm::Type *type, const llvm::DataLayout &DL) {
+    llvm::FixedVectorType *vecType = llvm::dyn_cast<llvm::FixedVectorType>(type);
+    if (vecType == nullptr || (int)vecType->getNumElements() != g->target->getVectorWidth()) {
+        return nullptr;
+    }
+    llvm::Type *scalarType = vecType->getElementType();
+    if ((!scalarType->isIntegerTy() && !scalarType->isFloatingPointTy()) ||
+        DL.getTypeSizeInBits(scalarType) != DL.getTypeStoreSize(scalarType) * 8 ||
+        DL.getTypeAllocSize(vecType) != DL.getTypeStoreSize(scalarType) * vecType->getNumElements()) {
+        return nullptr;
+    }
+    return scalarType;
+}
+
+/** Sets up the type of the given local array, or returns false if it
+    isn't an array of scalars, of vectors of the target width or of structs
+    of such vectors. */
+static bool lInitLocalArray(LocalArray &array, const llvm::DataLayout &DL) {
+    llvm::ConstantInt *count = llvm::dyn_cast<llvm::ConstantInt>(array.alloca->getArraySize());
+    array.arrayType = llvm::dyn_cast<llvm::ArrayType>(array.alloca->getAllocatedType());
+    if (count == nullptr || !count->isOne() || array.arrayType == nullptr) {
+        return false;
+    }
+
+    llvm::Type *elementType = array.arrayType->getElementType();
+    if (llvm::StructType *structType = llvm::dyn_cast<llvm::StructType>(elementType)) {
+        // The structs of varying fields that the varying structs of the
+        // source are laid out as; the scalar type is that of the accesses.
+        if (structType->isOpaque() || structType->getNumElements() == 0) {
+            return false;
+        }
+        for (llvm::Type *fieldType : structType->elements()) {
+            if (lGetVaryingScalarType(fieldType, DL) == nullptr) {
+                return false;
+            }
+        }
+        array.structType = structType;
+        array.isVarying = true;
+        return true;
+    }
+
+    array.scalarType = elementType;
+    if (llvm::FixedVectorType *vecType = llvm::dyn_cast<llvm::FixedVectorType>(elementType)) {
+        if ((int)vecType->getNumElements() != g->target->getVectorWidth()) {
+            return false;
+        }
+        array.scalarType = vecType->getElementType();
+        array.isVarying = true;
+    }
+    if (!array.scalarType->isIntegerTy() && !array.scalarType->isFloatingPointTy()) {
+        return false;
+    }
+
+    // The scalars have to be whole bytes, without padding between them.
+    array.scalarSize = DL.getTypeStoreSize(array.scalarType);
+    int64_t elementSize = array.isVarying ? array.scalarSize * g->target->getVectorWidth() : array.scalarSize;
+    return (int64_t)DL.getTypeSizeInBits(array.scalarType) == array.scalarSize * 8 &&
+           (int64_t)DL.getTypeAllocSize(elementType) == elementSize;
+}
+
+/** Get the operands of the given gather or scatter, or returns false if
+    its offsets aren't in a form that it can be lowered from. */
+static bool lGetArrayAccess(llvm::CallInst *callInst, MemOpKind kind, ArrayAccess &access) {
+    bool factored = kind == MemOpKind::FactoredGather || kind == MemOpKind::FactoredScatter;
+    access.callInst = callInst;
+    access.isScatter = kind == MemOpKind::Scatter || kind == MemOpKind::FactoredScatter;
+    access.offsets = callInst->getArgOperand(factored ? 1 : 2);
+    llvm::ConstantInt *scale = llvm::dyn_cast<llvm::ConstantInt>(callInst->getArgOperand(factored ? 2 : 1));
+    if (scale == nullptr) {
+        return false;
+    }
+    access.scale = scale->getSExtValue();
+
+    int width = g->target->getVectorWidth();
+    access.constOffsets.assign(width, 0);
+    if (factored) {
+        int64_t elts[ISPC_MAX_NVEC];
+        int nElts = 0;
+        if (!LLVMExtractVectorInts(callInst->getArgOperand(3), elts, &nElts) || nElts != width) {
+            return false;
+        }
+        access.constOffsets.assign(elts, elts + nElts);
+    }
+
+    unsigned nextArg = factored ? 4 : 3;
+    if (access.isScatter) {
+        access.value = callInst->getArgOperand(nextArg++);
+    }
+    access.mask = callInst->getArgOperand(nextArg);
+    return true;
+}
+
+/** Returns true if offsets * scale is known to be a multiple of unit,
+    i.e. it has enough trailing zero bits or it's a product with a multiple
+    of unit, as the offsets of the elements of arrays of structs are. */
+static bool lIsMultipleOf(llvm::Value *offsets, int64_t scale, int64_t unit, const llvm::DataLayout &DL) {
+    if (scale % unit == 0) {
+        return true;
+    }
+    if (llvm::isPowerOf2_64(scale) && llvm::isPowerOf2_64(unit)) {
+        unsigned zeros = llvm::computeKnownBits(offsets, DL).countMinTrailingZeros() + llvm::Log2_64(scale);
+        return zeros >= llvm::Log2_64(unit);
+    }
+    if (llvm::isa<llvm::SExtInst>(offsets) || llvm::isa<llvm::ZExtInst>(offsets)) {
+        return lIsMultipleOf(llvm::cast<llvm::Instruction>(offsets)->getOperand(0), scale, unit, DL);
+    }
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(offsets);
+    int64_t elts[ISPC_MAX_NVEC];
+    int nElts = 0;
+    if (bop == nullptr || (bop->getOpcode() != llvm::Instruction::Mul && bop->getOpcode() != llvm::Instruction::Shl) ||
+        !LLVMExtractVectorInts(bop->getOperand(1), elts, &nElts) || nElts == 0 ||
+        std::any_of(elts + 1, elts + nElts, [&elts](int64_t e) { return e != elts[0]; })) {
+        return false;
+    }
+    if (bop->getOpcode() == llvm::Instruction::Shl) {
+        if (elts[0] < 0 || elts[0] >= 32) {
+            return false;
+        }
+        elts[0] = (int64_t)1 << elts[0];
+    }
+    return elts[0] > 0 && lIsMultipleOf(bop->getOperand(0), scale * elts[0], unit, DL);
+}
+
+/** Check that the given access reads or writes whole units of "unit" bytes
+    of the array, at start plus laneStride times the index of the program
+    instance bytes from their start, i.e. whole uniform elements with a
+    zero laneStride, the lanes of the program instances of varying
+    elements, or those of a field of varying structs starting at start.
+ */
+static bool lAccessesUnits(const ArrayAccess &access, int64_t unit, int64_t start, int64_t laneStride,
+                           const llvm::DataLayout &DL) {
+    if (access.scale <= 0 || unit <= 0) {
+        return false;
+    }
+
+    // A constant part of the varying offsets counts as a constant offset.
+    llvm::Value *offsets = access.offsets;
+    std::vector<int64_t> constOffsets = access.constOffsets;
+    llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(offsets);
+    int64_t elts[ISPC_MAX_NVEC];
+    int nElts = 0;
+    if (bop != nullptr && (bop->getOpcode() == llvm::Instruction::Add || IsOrEquivalentToAdd(bop)) &&
+        LLVMExtractVectorInts(bop->getOperand(1), elts, &nElts) && nElts == (int)constOffsets.size()) {
+        offsets = bop->getOperand(0);
+        for (int i = 0; i < nElts; ++i) {
+            constOffsets[i] += elts[i] * access.scale;
+        }
+    }
+
+    if (!lIsMultipleOf(offsets, access.scale, unit, DL)) {
+        return false;
+    }
+    for (int i = 0; i < (int)constOffsets.size(); ++i) {
+        int64_t rem = (constOffsets[i] % unit + unit) % unit;
+        if (rem != start + i * laneStride) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Emit the computation of the indices of the units of "unit" bytes of
+    the array that the program instances access. */
+static llvm::Value *lEmitIndices(const ArrayAccess &access, int64_t unit, llvm::IRBuilder<> &builder) {
+    llvm::Type *type = access.offsets->getType();
+    llvm::SmallVector<llvm::Constant *, ISPC_MAX_NVEC> constOffsets;
+    for (int64_t offset : access.constOffsets) {
+        constOffsets.push_back(llvm::ConstantInt::get(type->getScalarType(), offset, true));
+    }
+    llvm::Value *offsets = builder.CreateMul(access.offsets, llvm::ConstantInt::get(type, access.scale));
+    offsets = builder.CreateAdd(offsets, llvm::ConstantVector::get(constOffsets));
+    if (!llvm::isPowerOf2_64(unit)) {
+        // The offsets of the arrays of structs, e.g. of 3 fields.
+        return builder.CreateSDiv(offsets, llvm::ConstantInt::get(type, unit), "array_index");
+    }
+    return builder.CreateAShr(offsets, llvm::ConstantInt::get(type, llvm::Log2_64(unit)), "array_index");
+}
+
+/** Returns the permute of the target for a gather from an array of the
+    given number of uniform elements of the given type, and sets
+    *twoSources if it takes the elements in two vectors, or returns
+    not_intrinsic if there's no such permute. */
+static llvm::Intrinsic::ID lGetPermute(llvm::Type *scalarType, int numElements, bool *twoSources) {
+    int width = g->target->getVectorWidth();
+    Target::ISA isa = g->target->getISA();
+    bool isFloat = scalarType->isFloatTy();
+    if (!isFloat && !scalarType->isIntegerTy(32)) {
+        return llvm::Intrinsic::not_intrinsic;
+    }
+
+    if (width == 8 && isa >= Target::AVX2 && isa <= Target::AVX10) {
+        if (numElements <= 8) {
+            *twoSources = false;
+            return isFloat ? llvm::Intrinsic::x86_avx2_permps : llvm::Intrinsic::x86_avx2_permd;
+        }
+        if (numElements <= 16 && isa >= Target::SKX_AVX512) {
+            *twoSources = true;
+            return isFloat ? llvm::Intrinsic::x86_avx512_vpermi2var_ps_256
+                           : llvm::Intrinsic::x86_avx512_vpermi2var_d_256;
+        }
+    } else if (width == 16 && isa >= Target::KNL_AVX512 && isa <= Target::SPR_AVX512 && !g->opt.disableZMM) {
+        if (numElements <= 16) {
+            *twoSources = false;
+            return isFloat ? llvm::Intrinsic::x86_avx512_permvar_sf_512 : llvm::Intrinsic::x86_avx512_permvar_si_512;
+        }
+        if (numElements <= 32) {
+            *twoSources = true;
+            return isFloat ? llvm::Intrinsic::x86_avx512_vpermi2var_ps_512
+                           : llvm::Intrinsic::x86_avx512_vpermi2var_d_512;
+        }
+    }
+    return llvm::Intrinsic::not_intrinsic;
+}
+
+/** A rough estimate of the number of instructions of a gather or scatter
+    of the target.  The native ones load or store the lanes one by one in
+    microcode, and the emulated ones also extract the offsets and insert
+    the loaded values lane by lane. */
+static int lMemOpCost(bool isScatter) {
+    int width = g->target->getVectorWidth();
+    bool native = isScatter ? g->target->hasScatter() : g->target->hasGather();
+    return native ? 2 * width : 4 * width;
+}
+
+/** A rough estimate of the number of instructions of the lowering of the
+    given access of the array, i.e. a compare and a select (and an "and"
+    with the mask for scatters) per element of the array, or a permute. */
+static int lLoweredCost(const LocalArray &array, const ArrayAccess &access) {
+    int numElements = (int)array.arrayType->getNumElements();
+    bool twoSources = false;
+    if (!array.isVarying && lGetPermute(array.scalarType, numElements, &twoSources) != llvm::Intrinsic::not_intrinsic) {
+        return twoSources ? 4 : 3;
+    }
+    return (access.isScatter ? 3 : 2) * numElements;
+}
+
+/** Returns the size of the units of the array that the program instances
+    access: the elements, or the vectors of the lanes of all of the
+    program instances for varying ones. */
+static int64_t lUnitSize(const LocalArray &array, const llvm::DataLayout &DL) {
+    if (array.structType != nullptr) {
+        return DL.getTypeAllocSize(array.structType);
+    }
+    return array.isVarying ? array.scalarSize * g->target->getVectorWidth() : array.scalarSize;
+}
+
+/** Returns the pointer to the given element of the array, or to the given
+    field of it for an array of structs, and sets *align to its alignment. */
+static llvm::Value *lElementPointer(const LocalArray &array, int index, unsigned field, llvm::IRBuilder<> &builder,
+                                    llvm::Type **type, llvm::Align *align) {
+    const llvm::DataLayout &DL = array.alloca->getModule()->getDataLayout();
+    llvm::Type *elementType = array.arrayType->getElementType();
+    int64_t offset = index * DL.getTypeAllocSize(elementType);
+    llvm::Value *ptr = nullptr;
+    if (array.structType != nullptr) {
+        *type = array.structType->getElementType(field);
+        offset += DL.getStructLayout(array.structType)->getElementOffset(field);
+        ptr = builder.CreateInBoundsGEP(array.arrayType, array.alloca,
+                                        {builder.getInt32(0), builder.getInt32(index), builder.getInt32(field)});
+    } else {
+        *type = elementType;
+        ptr = builder.CreateConstInBoundsGEP2_32(array.arrayType, array.alloca, 0, index);
+    }
+    *align = llvm::commonAlignment(array.alloca->getAlign(), offset);
+    return ptr;
+}
+
+static llvm::Value *lLoadElement(const LocalArray &array, int index, llvm::IRBuilder<> &builder, unsigned field = 0) {
+    llvm::Type *type = nullptr;
+    llvm::Align align;
+    llvm::Value *ptr = lElementPointer(array, index, field, builder, &type, &align);
+    return builder.CreateAlignedLoad(type, ptr, align, "array_element");
+}
+
+static void lStoreElement(const LocalArray &array, int index, llvm::Value *value, llvm::IRBuilder<> &builder,
+                          unsigned field = 0) {
+    llvm::Type *type = nullptr;
+    llvm::Align align;
+    llvm::Value *ptr = lElementPointer(array, index, field, builder, &type, &align);
+    builder.CreateAlignedStore(value, ptr, align);
+}
+
+/** Emit the vector of the given number of uniform elements of the array
+    that start at the given one, for a permute. */
+static llvm::Value *lLoadTable(const LocalArray &array, int first, int width, llvm::IRBuilder<> &builder) {
+    int numElements = (int)array.arrayType->getNumElements();
+    llvm::Value *table = llvm::UndefValue::get(llvm::FixedVectorType::get(array.scalarType, width));
+    for (int i = 0; i < width && first + i < numElements; ++i) {
+        table = builder.CreateInsertElement(table, lLoadElement(array, first + i, builder), i);
+    }
+    return table;
+}
+
+/** Lower the given gather or scatter of the array and return the value
+    that replaces the gather. */
+static llvm::Value *lLowerAccess(const LocalArray &array, const ArrayAccess &access) {
+    llvm::IRBuilder<> builder(access.callInst);
+    int width = g->target->getVectorWidth();
+    int numElements = (int)array.arrayType->getNumElements();
+
+    if (!array.isVarying) {
+        // result[i] = array[index[i]]
+        llvm::Value *index = lEmitIndices(access, array.scalarSize, builder);
+        bool twoSources = false;
+        llvm::Intrinsic::ID permute = lGetPermute(array.scalarType, numElements, &twoSources);
+        if (permute != llvm::Intrinsic::not_intrinsic) {
+            llvm::Function *permuteFunc = llvm::Intrinsic::getDeclaration(access.callInst->getModule(), permute);
+            index = builder.CreateSExtOrTrunc(index, llvm::FixedVectorType::get(LLVMTypes::Int32Type, width));
+            llvm::Value *table = lLoadTable(array, 0, width, builder);
+            if (twoSources) {
+                return builder.CreateCall(permuteFunc, {table, index, lLoadTable(array, width, width, builder)});
+            }
+            return builder.CreateCall(permuteFunc, {table, index});
+        }
+
+        llvm::Value *result = builder.CreateVectorSplat(width, lLoadElement(array, 0, builder));
+        for (int i = 1; i < numElements; ++i) {
+            llvm::Value *element = builder.CreateVectorSplat(width, lLoadElement(array, i, builder));
+            llvm::Value *match = builder.CreateICmpEQ(index, llvm::ConstantInt::get(index->getType(), i));
+            result = builder.CreateSelect(match, element, result);
+        }
+        return result;
+    }
+
+    // The program instances access their own lanes of the elements, or
+    // of the accessed field of them.
+    const llvm::DataLayout &DL = array.alloca->getModule()->getDataLayout();
+    llvm::Value *index = lEmitIndices(access, lUnitSize(array, DL), builder);
+    if (!access.isScatter) {
+        llvm::Value *result = lLoadElement(array, 0, builder, access.field);
+        for (int i = 1; i < numElements; ++i) {
+            llvm::Value *match = builder.CreateICmpEQ(index, llvm::ConstantInt::get(index->getType(), i));
+            result = builder.CreateSelect(match, lLoadElement(array, i, builder, access.field), result);
+        }
+        return result;
+    }
+
+    llvm::Value *mask = access.mask;
+    if (!mask->getType()->getScalarType()->isIntegerTy(1)) {
+        mask = builder.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()));
+    }
+    for (int i = 0; i < numElements; ++i) {
+        llvm::Value *match = builder.CreateICmpEQ(index, llvm::ConstantInt::get(index->getType(), i));
+        match = builder.CreateAnd(match, mask);
+        llvm::Value *element =
+            builder.CreateSelect(match, access.value, lLoadElement(array, i, builder, access.field));
+        lStoreElement(array, i, element, builder, access.field);
+    }
+    return nullptr;
+}
+
+bool PromoteLocalArraysPass::promoteLocalArrays(llvm::Function &F) {
+    const llvm::DataLayout &DL = F.getParent()->getDataLayout();
+
+    // Find the local arrays that are accessed with gathers and scatters.
+    std::vector<LocalArray> arrays;
+    std::unordered_map<llvm::AllocaInst *, size_t> arrayIndex;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I);
+            MemOpKind kind = callInst != nullptr ? lGetMemOpKind(callInst) : MemOpKind::None;
+            if (kind == MemOpKind::None) {
+                continue;
+            }
+            int64_t baseOffset = 0;
+            llvm::AllocaInst *alloca = lGetAlloca(callInst->getArgOperand(0), DL, &baseOffset);
+            if (alloca == nullptr) {
+                continue;
+            }
+
+            auto it = arrayIndex.find(alloca);
+            if (it == arrayIndex.end()) {
+                it = arrayIndex.emplace(alloca, arrays.size()).first;
+                arrays.emplace_back();
+                arrays.back().alloca = alloca;
+                arrays.back().canLower = lInitLocalArray(arrays.back(), DL);
+            }
+            LocalArray &array = arrays[it->second];
+            ArrayAccess access;
+            if (!array.canLower || !lGetArrayAccess(callInst, kind, access)) {
+                array.canLower = false;
+                continue;
+            }
+            // The offsets are kept from the start of the array.
+            for (int64_t &offset : access.constOffsets) {
+                offset += baseOffset;
+            }
+            array.accesses.push_back(access);
+        }
+    }
+
+    bool modifiedAny = false;
+    llvm::SmallVector<llvm::WeakTrackingVH, 16> deadInsts;
+    for (LocalArray &array : arrays) {
+        // The arrays have to fit in the registers, and all of their
+        // accesses have to be lowered for them to be promoted.
+        if (!array.canLower) {
+            continue;
+        }
+        int numElements = (int)array.arrayType->getNumElements();
+        bool twoSources = false;
+        bool hasPermute = !array.isVarying && lGetPermute(array.scalarType, numElements, &twoSources) !=
+                                                 llvm::Intrinsic::not_intrinsic;
+        if (numElements == 0 || (numElements > 16 && !hasPermute)) {
+            continue;
+        }
+        for (ArrayAccess &access : array.accesses) {
+            llvm::Type *type = access.isScatter ? access.value->getType() : access.callInst->getType();
+            int64_t unit = lUnitSize(array, DL);
+            bool accessesUnits = false;
+            if (array.structType != nullptr) {
+                // The accesses of arrays of varying structs have to read
+                // or write the lanes of one of the fields.
+                const llvm::StructLayout *layout = DL.getStructLayout(array.structType);
+                for (unsigned field = 0; field < array.structType->getNumElements() && !accessesUnits; ++field) {
+                    llvm::Type *scalarType = array.structType->getElementType(field)->getScalarType();
+                    accessesUnits = type->getScalarType() == scalarType &&
+                                    lAccessesUnits(access, unit, layout->getElementOffset(field),
+                                                   DL.getTypeStoreSize(scalarType), DL);
+                    access.field = field;
+                }
+            } else {
+                int64_t laneStride = array.isVarying ? array.scalarSize : 0;
+                accessesUnits = type->getScalarType() == array.scalarType &&
+                                lAccessesUnits(access, unit, 0, laneStride, DL);
+            }
+            if (!accessesUnits || (access.isScatter && !array.isVarying) ||
+                lLoweredCost(array, access) > lMemOpCost(access.isScatter)) {
+                array.canLower = false;
+                break;
+            }
+        }
+        if (!array.canLower) {
+            continue;
+        }
+
+        for (const ArrayAccess &access : array.accesses) {
+            llvm::Value *result = lLowerAccess(array, access);
+            if (result != nullptr) {
+                access.callInst->replaceAllUsesWith(result);
+            }
+            deadInsts.push_back(access.callInst->getArgOperand(0));
+            deadInsts.push_back(access.offsets);
+            access.callInst->eraseFromParent();
+        }
+        modifiedAny = true;
+    }
+
+    // Remove the address computations of the gathers and scatters, so
+    // that SROA doesn't see the arrays escape through ptrtoint.
+    llvm::RecursivelyDeleteTriviallyDeadInstructionsPermissive(deadInsts);
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses PromoteLocalArraysPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("PromoteLocalArraysPass::run", F.getName());
+
+    if (!promoteLocalArrays(F)) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
@@ -0,0 +1,44 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+// This pass lowers the gathers and scatters from small local arrays that
+// are indexed with varying values, e.g. coeffs[i] with a local
+// "float coeffs[8]" and a varying i, to operations on the elements of the
+// arrays.  Such arrays are otherwise accessed through memory with gathers
+// and scatters, and the pointer arithmetic of those keeps SROA from
+// promoting them to registers.
+//
+//  For an array of varying elements, each program instance accesses its
+//  own lane of the elements, so a gather becomes a tree of selects of the
+//  elements on the index of the program instance, and a scatter becomes a
+//  blend into each of the elements.  The same goes for arrays of varying
+//  structs, e.g. "Sample samples[4]" with varying fields, whose accesses
+//  are lowered to the accessed field of each of the elements, so that SROA
+//  splits the structs into registers of their fields.  For an array of uniform elements, a
+//  gather becomes a permute of the elements (vpermps/vpermd or vpermi2*
+//  where the target has them) or a tree of selects of the broadcasts of
+//  the elements.  Scatters to uniform arrays aren't lowered.
+//
+//  The arrays are lowered if all of their gathers and scatters can be, and
+//  each of them is estimated to be cheaper than the gather or scatter of
+//  the target.  Then the remaining accesses of the arrays are loads and
+//  stores of whole elements, which SROA promotes to registers.
+
+struct PromoteLocalArraysPass : public llvm::PassInfoMixin<PromoteLocalArraysPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool promoteLocalArrays(llvm::Function &F);
+};
+
+} // namespace ispc
@@ -6,6 +6,7 @@
 
 #include "ReplaceMaskedMemOps.h"
 
+#include <llvm/Analysis/AssumptionCache.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/Transforms/Utils/Local.h>
 
@@ -174,12 +175,13 @@ llvm::Value *lBitcastPointerType(llvm::IRBuilder<> &B, llvm::Value *ptr, llvm::V
 // This function replaces masked store intrinsic with an unmasked store instruction.
 // Unmasked store instruction stores only the first part of the initial vector
 // with the length of SubVectorLength.
-void lReplaceMaskedStore(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubVectorLength) {
+void lReplaceMaskedStore(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubVectorLength,
+                         llvm::AssumptionCache &AC) {
     llvm::Value *origVec = CI->getOperand(0);
     llvm::Value *ptr = CI->getOperand(1);
     llvm::ConstantInt *alignmentCI = llvm::dyn_cast<llvm::ConstantInt>(CI->getOperand(2));
     Assert(alignmentCI);
-    int alignment = alignmentCI->getZExtValue();
+    int alignment = LLVMGetKnownAlignment(ptr, alignmentCI->getZExtValue(), CI, &AC);
 
     B.SetInsertPoint(CI);
 
@@ -196,12 +198,13 @@ void lReplaceMaskedStore(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubV
 // Masked load intrinsic has the passthrough value that is needed to be
 // preserved in the new vector in case it is used later. It is done by merging
 // the result of the unmasked load with the rest part of the passthrough value.
-void lReplaceMaskedLoad(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubVectorLength) {
+void lReplaceMaskedLoad(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubVectorLength,
+                        llvm::AssumptionCache &AC) {
     llvm::Value *ptr = CI->getOperand(0);
     llvm::ConstantInt *alignmentCI = llvm::dyn_cast<llvm::ConstantInt>(CI->getOperand(1));
     llvm::Constant *passthrough = llvm::dyn_cast<llvm::Constant>(CI->getOperand(3));
     Assert(alignmentCI && passthrough);
-    int alignment = alignmentCI->getZExtValue();
+    int alignment = LLVMGetKnownAlignment(ptr, alignmentCI->getZExtValue(), CI, &AC);
 
     B.SetInsertPoint(CI);
 
@@ -212,7 +215,8 @@ void lReplaceMaskedLoad(llvm::IRBuilder<> &B, llvm::CallInst *CI, unsigned SubVe
     ptr = B.CreateBitCast(ptr, subVecType->getPointerTo());
 
     llvm::LoadInst *subVec = B.CreateLoad(subVecType, ptr, llvm::Twine(origName) + ".part");
-    // It is important to preserve the alignment of the original masked load.
+    // It is important to preserve the alignment of the original masked load,
+    // or to use the larger one known from the pointer.
     subVec->setAlignment(llvm::Align(alignment));
 
     llvm::Value *replacement = lMaskedMergeVectors(B, subVec, passthrough, llvm::Twine(origName));
@@ -264,12 +268,13 @@ llvm::PreservedAnalyses ReplaceMaskedMemOpsPass::run(llvm::Function &F, llvm::Fu
         return llvm::PreservedAnalyses::all();
     }
 
+    llvm::AssumptionCache &AC = FAM.getResult<llvm::AssumptionAnalysis>(F);
     for (auto const &[CI, SubVectorLength] : storesToReplace) {
-        lReplaceMaskedStore(builder, CI, SubVectorLength);
+        lReplaceMaskedStore(builder, CI, SubVectorLength, AC);
     }
 
     for (auto const &[CI, SubVectorLength] : loadsToReplace) {
-        lReplaceMaskedLoad(builder, CI, SubVectorLength);
+        lReplaceMaskedLoad(builder, CI, SubVectorLength, AC);
     }
 
     llvm::PreservedAnalyses PA;
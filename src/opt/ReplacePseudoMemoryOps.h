@@ -18,6 +18,10 @@ struct ReplacePseudoMemoryOpsPass : public llvm::PassInfoMixin<ReplacePseudoMemo
 
     llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 
+    // The code can't run without this lowering, so the pass also runs on
+    // the functions with "optnone", e.g. from optimize("O0").
+    static bool isRequired() { return true; }
+
   private:
     bool replacePseudoMemoryOps(llvm::BasicBlock &BB);
 };
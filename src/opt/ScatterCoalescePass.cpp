@@ -0,0 +1,462 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "ScatterCoalescePass.h"
+#include "builtins-decl.h"
+
+#include <algorithm>
+#include <llvm/IR/IRBuilder.h>
+#include <map>
+#include <set>
+#include <string>
+
+namespace ispc {
+
+/** Representation of a memory store that the scatter coalescing code has
+    decided to generate.
+ */
+struct CoalescedStoreOp {
+    CoalescedStoreOp(int64_t s, int c, bool m) : start(s), count(c), masked(m) {}
+
+    /** Starting offset of the store from the common base pointer (in terms
+        of numbers of 32-bit words--*not* in terms of bytes). */
+    int64_t start;
+
+    /** Number of words to store at this location */
+    int count;
+
+    /** Whether the store has to be a masked one: the mask of the scatters
+        isn't known to be all on, or not all of the words are written. */
+    bool masked;
+};
+
+/** Extract the constant offsets (from the common base pointer) from each
+    of the scatters in a set to be coalesced and transform them from bytes
+    into the offsets of the 32-bit words written: one per lane for 32-bit
+    values and two per lane, the lower one first, for 64-bit values.  The
+    first wordsPerLane * vectorWidth elements will be those for the first
+    scatter, the next ones those for the next scatter, and so forth.
+
+    Returns false if an offset isn't a multiple of 4 bytes or if the same
+    word is written more than once.
+ */
+static bool lExtractWordOffsets(const std::vector<llvm::CallInst *> &coalesceGroup, int wordsPerLane,
+                                std::vector<int64_t> *wordOffsets) {
+    int width = g->target->getVectorWidth();
+    std::set<int64_t> written;
+    wordOffsets->clear();
+    for (llvm::CallInst *scatter : coalesceGroup) {
+        int64_t offsets[ISPC_MAX_NVEC];
+        int nElts = 0;
+        bool ok = LLVMExtractVectorInts(scatter->getArgOperand(3), offsets, &nElts);
+        Assert(ok && nElts == width);
+        for (int lane = 0; lane < width; ++lane) {
+            if ((offsets[lane] % 4) != 0) {
+                return false;
+            }
+            for (int w = 0; w < wordsPerLane; ++w) {
+                int64_t word = offsets[lane] / 4 + w;
+                if (written.insert(word).second == false) {
+                    return false;
+                }
+                wordOffsets->push_back(word);
+            }
+        }
+    }
+    return true;
+}
+
+/** Given the set of words written by the scatters, determine a set of
+    stores that writes them.  Starting from the lowest word, an 8, 4 or
+    2-wide store is used when all of its words are written; the 8 and
+    4-wide ones are also used as masked stores if more than half of their
+    words are written.  Otherwise a scalar store is used.
+ */
+static void lSelectStores(const std::vector<int64_t> &wordOffsets, bool maskAllOn,
+                          std::vector<CoalescedStoreOp> *stores) {
+    std::set<int64_t> words(wordOffsets.begin(), wordOffsets.end());
+
+    std::set<int64_t>::iterator iter = words.begin();
+    while (iter != words.end()) {
+        int64_t start = *iter;
+        int count = 1;
+        bool full = true;
+
+        int storeWidths[] = {8, 4, 2};
+        for (int storeWidth : storeWidths) {
+            int present = 0;
+            for (std::set<int64_t>::iterator it = iter; it != words.end() && *it < start + storeWidth; ++it) {
+                ++present;
+            }
+            if (present == storeWidth || (storeWidth >= 4 && present > storeWidth / 2)) {
+                count = storeWidth;
+                full = present == storeWidth;
+                break;
+            }
+        }
+
+        Debug(SourcePos(), "Store @ %" PRId64 ", %d words%s.", start, count, full ? "" : " with gaps");
+        stores->push_back(CoalescedStoreOp(start, count, !maskAllOn || !full));
+        while (iter != words.end() && *iter < start + count) {
+            ++iter;
+        }
+    }
+}
+
+/** Print a performance message with the details of the result of
+    coalescing over a group of scatters. */
+static void lCoalescePerfInfo(const std::vector<llvm::CallInst *> &coalesceGroup,
+                              const std::vector<CoalescedStoreOp> &storeOps) {
+    if (g->opt.level == 0) {
+        return;
+    }
+
+    SourcePos pos;
+    LLVMGetSourcePosFromMetadata(coalesceGroup[0], &pos);
+
+    // Count how many stores of each size there were.
+    std::map<int, int> storeOpsCount;
+    int nMasked = 0;
+    for (const CoalescedStoreOp &store : storeOps) {
+        ++storeOpsCount[store.count];
+        nMasked += store.masked;
+    }
+
+    std::string storeOpsInfo;
+    for (std::map<int, int>::const_iterator iter = storeOpsCount.begin(); iter != storeOpsCount.end(); ++iter) {
+        if (!storeOpsInfo.empty()) {
+            storeOpsInfo += ", ";
+        }
+        storeOpsInfo += std::to_string(iter->second) + " x " + std::to_string(iter->first) + "-wide";
+    }
+    if (nMasked > 0) {
+        storeOpsInfo += ", " + std::to_string(nMasked) + " masked";
+    }
+
+    if (coalesceGroup.size() == 1) {
+        PerformanceWarning(pos, "Coalesced scatter into %d store%s (%s).", (int)storeOps.size(),
+                           (storeOps.size() > 1) ? "s" : "", storeOpsInfo.c_str());
+    } else {
+        PerformanceWarning(pos, "Coalesced %d scatters starting here into %d store%s (%s).", (int)coalesceGroup.size(),
+                           (int)storeOps.size(), (storeOps.size() > 1) ? "s" : "", storeOpsInfo.c_str());
+    }
+}
+
+/** Given a call to a scatter function, extract the base pointer, the
+    2/4/8 scale, and the first varying offsets value to use them to compute
+    that scalar base pointer that is shared by all of the scatters in the
+    group.
+ */
+static llvm::Value *lComputeBasePtr(llvm::CallInst *scatterInst, llvm::Type *baseType,
+                                    llvm::Instruction *insertBefore) {
+    llvm::Value *basePtr = scatterInst->getArgOperand(0);
+    llvm::Value *variableOffsets = scatterInst->getArgOperand(1);
+    llvm::Value *offsetScale = scatterInst->getArgOperand(2);
+    // All of the variable offsets values should be the same, due to
+    // checking for this in ScatterCoalescePass::coalesceScattersFactored().
+    // Thus, extract the first value and use that as a scalar.
+    llvm::Value *variable = LLVMExtractFirstVectorElement(variableOffsets);
+    Assert(variable != nullptr);
+    if (variable->getType() == LLVMTypes::Int64Type) {
+        offsetScale = new llvm::ZExtInst(offsetScale, LLVMTypes::Int64Type, "scale_to64",
+                                         ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
+    }
+    llvm::Value *offset = llvm::BinaryOperator::Create(llvm::Instruction::Mul, variable, offsetScale, "offset",
+                                                       ISPC_INSERTION_POINT_INSTRUCTION(insertBefore));
+
+    return LLVMGEPInst(basePtr, baseType, offset, "new_base", insertBefore);
+}
+
+/** Shuffle together the value of a store from the words of the scatters'
+    values.  Each of the scatters providing some of the words contributes a
+    shuffle of its value, and these are then merged pairwise. */
+static llvm::Value *lAssembleStoreValue(const CoalescedStoreOp &store, const std::vector<int64_t> &wordOffsets,
+                                        const std::vector<llvm::Value *> &words, llvm::IRBuilder<> &builder) {
+    int wordsPerScatter = wordOffsets.size() / words.size();
+
+    // For each scatter providing words, the shuffle of its value and the
+    // elements of the store it provides.
+    std::vector<llvm::Value *> parts;
+    std::vector<std::vector<bool>> provided;
+    for (int i = 0; i < (int)words.size(); ++i) {
+        std::vector<int> shuf(store.count, -1);
+        std::vector<bool> mine(store.count, false);
+        bool any = false;
+        for (int j = 0; j < wordsPerScatter; ++j) {
+            int64_t elt = wordOffsets[i * wordsPerScatter + j] - store.start;
+            if (elt >= 0 && elt < store.count) {
+                shuf[elt] = j;
+                mine[elt] = true;
+                any = true;
+            }
+        }
+        if (any) {
+            parts.push_back(builder.CreateShuffleVector(words[i], shuf, "store_part"));
+            provided.push_back(mine);
+        }
+    }
+
+    while (parts.size() > 1) {
+        std::vector<llvm::Value *> merged;
+        std::vector<std::vector<bool>> mergedProvided;
+        for (int i = 0; i + 1 < (int)parts.size(); i += 2) {
+            std::vector<int> shuf(store.count, -1);
+            std::vector<bool> mine(store.count, false);
+            for (int elt = 0; elt < store.count; ++elt) {
+                if (provided[i][elt]) {
+                    shuf[elt] = elt;
+                } else if (provided[i + 1][elt]) {
+                    shuf[elt] = store.count + elt;
+                }
+                mine[elt] = provided[i][elt] || provided[i + 1][elt];
+            }
+            merged.push_back(builder.CreateShuffleVector(parts[i], parts[i + 1], shuf, "store_merge"));
+            mergedProvided.push_back(mine);
+        }
+        if ((parts.size() % 2) == 1) {
+            merged.push_back(parts.back());
+            mergedProvided.push_back(provided.back());
+        }
+        parts = merged;
+        provided = mergedProvided;
+    }
+
+    Assert(parts.size() == 1);
+    return parts[0];
+}
+
+/** Compute the mask of a masked store: a word is written if it's written
+    by some lane and that lane is active.  laneMask is nullptr if the mask
+    of the scatters is all on. */
+static llvm::Value *lStoreMask(const CoalescedStoreOp &store, const std::vector<int64_t> &wordOffsets,
+                               int wordsPerLane, llvm::Value *laneMask, llvm::IRBuilder<> &builder) {
+    int width = g->target->getVectorWidth();
+    // The lane writing each word of the store, or -1
+    std::vector<int> lanes(store.count, -1);
+    for (int i = 0; i < (int)wordOffsets.size(); ++i) {
+        int64_t elt = wordOffsets[i] - store.start;
+        if (elt >= 0 && elt < store.count) {
+            lanes[elt] = (i / wordsPerLane) % width;
+        }
+    }
+
+    if (laneMask == nullptr) {
+        std::vector<llvm::Constant *> bits;
+        for (int lane : lanes) {
+            bits.push_back(lane >= 0 ? LLVMTrue : LLVMFalse);
+        }
+        return llvm::ConstantVector::get(bits);
+    }
+
+    // Index "width" selects from the all off vector.
+    std::vector<int> shuf(store.count, width);
+    for (int elt = 0; elt < store.count; ++elt) {
+        if (lanes[elt] >= 0) {
+            shuf[elt] = lanes[elt];
+        }
+    }
+    llvm::Value *allOff = llvm::Constant::getNullValue(laneMask->getType());
+    return builder.CreateShuffleVector(laneMask, allOff, shuf, "store_mask");
+}
+
+/** Actually do the coalescing.  We have a set of scatters all writing to
+    addresses of the form:
+
+    (ptr + {1,2,4,8} * varyingOffset) + constOffset, a.k.a.
+    basePtr + constOffset
+
+    where varyingOffset actually has the same value across all of the SIMD
+    lanes and where the part in parenthesis has the same value for all of
+    the scatters in the group.  The stores are emitted before the last
+    scatter of the group, as the values of all of them are available there.
+ */
+static bool lCoalesceScatters(const std::vector<llvm::CallInst *> &coalesceGroup, llvm::Type *baseType) {
+    llvm::Instruction *insertBefore = coalesceGroup.back();
+    int width = g->target->getVectorWidth();
+
+    llvm::Type *valueType = coalesceGroup[0]->getArgOperand(4)->getType();
+    int elementSize = valueType->getScalarSizeInBits() / 8;
+    Assert(elementSize == 4 || elementSize == 8);
+    int wordsPerLane = elementSize / 4;
+
+    std::vector<int64_t> wordOffsets;
+    if (!lExtractWordOffsets(coalesceGroup, wordsPerLane, &wordOffsets)) {
+        return false;
+    }
+
+    llvm::Value *mask = coalesceGroup[0]->getArgOperand(5);
+    bool maskAllOn = GetMaskStatusFromValue(mask) == MaskStatus::all_on;
+
+    std::vector<CoalescedStoreOp> storeOps;
+    lSelectStores(wordOffsets, maskAllOn, &storeOps);
+
+    // It's not worth it if only scalar stores would be done.
+    bool anyVector = false;
+    for (const CoalescedStoreOp &store : storeOps) {
+        anyVector |= store.count > 1;
+    }
+    if (!anyVector) {
+        return false;
+    }
+
+    lCoalescePerfInfo(coalesceGroup, storeOps);
+
+    llvm::Value *basePtr = lComputeBasePtr(coalesceGroup[0], baseType, insertBefore);
+
+    llvm::IRBuilder<> builder(insertBefore);
+    llvm::Value *laneMask = nullptr;
+    if (!maskAllOn) {
+        laneMask = mask;
+        if (!mask->getType()->getScalarType()->isIntegerTy(1)) {
+            laneMask = builder.CreateICmpNE(mask, llvm::Constant::getNullValue(mask->getType()), "lane_mask");
+        }
+    }
+
+    // The values of the scatters as vectors of words
+    llvm::VectorType *wordsType = LLVMVECTOR::get(LLVMTypes::Int32Type, wordsPerLane * width);
+    std::vector<llvm::Value *> words;
+    for (llvm::CallInst *scatter : coalesceGroup) {
+        words.push_back(builder.CreateBitCast(scatter->getArgOperand(4), wordsType, "scatter_words"));
+    }
+
+    for (const CoalescedStoreOp &store : storeOps) {
+        llvm::Value *value = lAssembleStoreValue(store, wordOffsets, words, builder);
+        llvm::Value *ptr = LLVMGEPInst(basePtr, baseType, LLVMInt64(store.start * 4), "new_base", insertBefore);
+
+        int align = 4;
+        if (store.count >= 4 && g->opt.forceAlignedMemory) {
+            align = g->target->getNativeVectorAlignment();
+        }
+
+        if (store.masked) {
+            ptr = builder.CreateBitCast(ptr, llvm::PointerType::get(value->getType(), 0), "ptr_cast");
+            llvm::Value *storeMask = lStoreMask(store, wordOffsets, wordsPerLane, laneMask, builder);
+            builder.CreateMaskedStore(value, ptr, llvm::Align(align), storeMask);
+        } else {
+            if (store.count == 1) {
+                value = builder.CreateExtractElement(value, (uint64_t)0, "store_word");
+            }
+            ptr = builder.CreateBitCast(ptr, llvm::PointerType::get(value->getType(), 0), "ptr_cast");
+            builder.CreateAlignedStore(value, ptr, llvm::Align(align));
+        }
+    }
+
+    for (llvm::CallInst *scatter : coalesceGroup) {
+        scatter->eraseFromParent();
+    }
+
+    return true;
+}
+
+bool ScatterCoalescePass::coalesceScattersFactored(llvm::BasicBlock &bb) {
+    DEBUG_START_BB("ScatterCoalescePass");
+
+    llvm::Module *M = bb.getModule();
+    llvm::Function *scatterFuncs[] = {
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets32_i32),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets32_float),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets32_i64),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets32_double),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets64_i32),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets64_float),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets64_i64),
+        M->getFunction(builtin::__pseudo_scatter_factored_base_offsets64_double),
+    };
+
+    // First collect the groups of scatters, then coalesce them, as that
+    // removes the scatters from the basic block.
+    std::vector<std::vector<llvm::CallInst *>> groups;
+    std::set<llvm::CallInst *> grouped;
+    for (llvm::Instruction &inst : bb) {
+        llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if (callInst == nullptr || grouped.count(callInst) != 0) {
+            continue;
+        }
+
+        llvm::Function *calledFunc = callInst->getCalledFunction();
+        if (calledFunc == nullptr ||
+            std::find(std::begin(scatterFuncs), std::end(scatterFuncs), calledFunc) == std::end(scatterFuncs)) {
+            continue;
+        }
+
+        SourcePos pos;
+        LLVMGetSourcePosFromMetadata(callInst, &pos);
+        Debug(pos, "Checking for coalescable scatters starting here...");
+
+        llvm::Value *base = callInst->getArgOperand(0);
+        llvm::Value *variableOffsets = callInst->getArgOperand(1);
+        llvm::Value *offsetScale = callInst->getArgOperand(2);
+        llvm::Value *mask = callInst->getArgOperand(5);
+
+        // As for gathers, we need the variable offsets to be uniform, and
+        // the same base pointer, variable offsets, offset scale, and mask
+        // for all of the scatters of the group.
+        if (GetMaskStatusFromValue(mask) == MaskStatus::all_off || !LLVMVectorValuesAllEqual(variableOffsets)) {
+            continue;
+        }
+
+        std::vector<llvm::CallInst *> coalesceGroup;
+        coalesceGroup.push_back(callInst);
+
+        // Look at the following instructions until one may access memory:
+        // the stores of the earlier scatters of the group are moved down
+        // to the last one, so no read nor write may be in between.
+        for (llvm::BasicBlock::iterator fwdIter = std::next(callInst->getIterator()); fwdIter != bb.end(); ++fwdIter) {
+            llvm::CallInst *fwdCall = llvm::dyn_cast<llvm::CallInst>(&*fwdIter);
+            if (fwdCall != nullptr && fwdCall->getCalledFunction() == calledFunc &&
+                base == fwdCall->getArgOperand(0) && variableOffsets == fwdCall->getArgOperand(1) &&
+                offsetScale == fwdCall->getArgOperand(2) && mask == fwdCall->getArgOperand(5)) {
+                SourcePos fwdPos;
+                LLVMGetSourcePosFromMetadata(fwdCall, &fwdPos);
+                Debug(fwdPos, "This scatter can be coalesced.");
+                coalesceGroup.push_back(fwdCall);
+                // As in GatherCoalescePass, don't collect more than 4
+                // scatters to limit the register pressure.
+                if (coalesceGroup.size() == 4) {
+                    break;
+                }
+                continue;
+            }
+            if (fwdIter->mayReadOrWriteMemory()) {
+                break;
+            }
+        }
+
+        grouped.insert(coalesceGroup.begin(), coalesceGroup.end());
+        groups.push_back(coalesceGroup);
+    }
+
+    bool modifiedAny = false;
+    for (const std::vector<llvm::CallInst *> &coalesceGroup : groups) {
+        if (lCoalesceScatters(coalesceGroup, baseType)) {
+            modifiedAny = true;
+        }
+    }
+
+    DEBUG_END_BB("ScatterCoalescePass");
+
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses ScatterCoalescePass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("ScatterCoalescePass::run", F.getName());
+
+    bool modifiedAny = false;
+    for (llvm::BasicBlock &BB : F) {
+        modifiedAny |= coalesceScattersFactored(BB);
+    }
+
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
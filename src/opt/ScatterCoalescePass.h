@@ -0,0 +1,43 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+namespace ispc {
+
+// This pass is the store-side counterpart of GatherCoalescePass: it
+// coalesces scatters of 32 and 64-bit values with a common base pointer and
+// offsets known at compile time into vector stores and shuffles.
+//
+//  A group of scatters with the same base pointer, uniform variable
+//  offsets, offset scale, and mask is collected as long as no instruction
+//  in between may access memory, so the stores can all be done at the
+//  last scatter of the group.  This is what writing SoA values to AoS
+//  structures looks like, e.g. storing the x, y, and z fields of an array
+//  of points in a foreach loop; the generated stores are the same as
+//  soa_to_aos3() would do by hand.
+//
+//  The words written by the group are covered by 8, 4, 2-wide or scalar
+//  stores.  A store that has gaps, or whose mask isn't known to be all on,
+//  is emitted as a masked store that only writes the words of the active
+//  lanes.  Groups where two lanes write the same word are left alone, as
+//  their stores would need to be ordered.
+
+struct ScatterCoalescePass : public llvm::PassInfoMixin<ScatterCoalescePass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    // Type of base pointer element type (the 1st argument of the intrinsic) is i8
+    // e.g. @__pseudo_scatter_factored_base_offsets32_i32(i8 *, <WIDTH x i32>, i32, <WIDTH x i32>, <WIDTH x i32>,
+    // <WIDTH x MASK>)
+    llvm::Type *baseType{LLVMTypes::Int8Type};
+    bool coalesceScattersFactored(llvm::BasicBlock &BB);
+};
+
+} // namespace ispc
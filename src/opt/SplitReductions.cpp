@@ -0,0 +1,247 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "SplitReductions.h"
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+
+namespace ispc {
+
+/** Returns true if the given instruction is an associative and commutative
+    operation of the accumulated value with another one, and returns the
+    operand that the accumulated value is. */
+static bool lIsReductionOp(llvm::Instruction *op, llvm::Value *acc, unsigned *accOperand) {
+    if (llvm::IntrinsicInst *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(op)) {
+        switch (intrinsic->getIntrinsicID()) {
+        case llvm::Intrinsic::smin:
+        case llvm::Intrinsic::smax:
+        case llvm::Intrinsic::umin:
+        case llvm::Intrinsic::umax:
+        case llvm::Intrinsic::minnum:
+        case llvm::Intrinsic::maxnum:
+            break;
+        default:
+            return false;
+        }
+    } else if (llvm::isa<llvm::BinaryOperator>(op)) {
+        switch (op->getOpcode()) {
+        case llvm::Instruction::Add:
+        case llvm::Instruction::FAdd:
+        case llvm::Instruction::Mul:
+        case llvm::Instruction::FMul:
+        case llvm::Instruction::And:
+        case llvm::Instruction::Or:
+        case llvm::Instruction::Xor:
+            break;
+        default:
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    if (op->getOperand(0) == acc && op->getOperand(1) != acc) {
+        *accOperand = 0;
+    } else if (op->getOperand(1) == acc && op->getOperand(0) != acc) {
+        *accOperand = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool lIsSameOperation(llvm::Instruction *a, llvm::Instruction *b) {
+    if (a->getOpcode() != b->getOpcode()) {
+        return false;
+    }
+    llvm::IntrinsicInst *intrinsicA = llvm::dyn_cast<llvm::IntrinsicInst>(a);
+    llvm::IntrinsicInst *intrinsicB = llvm::dyn_cast<llvm::IntrinsicInst>(b);
+    return intrinsicA == nullptr || intrinsicA->getIntrinsicID() == intrinsicB->getIntrinsicID();
+}
+
+/** Returns the value that the additional accumulators of a reduction with
+    the given operation start with: the identity of the operation, or the
+    initial value of the reduction for minimums and maximums, which don't
+    change when a value is accumulated twice. */
+static llvm::Value *lGetInitialValue(llvm::Instruction *op, llvm::Value *init) {
+    llvm::Type *type = op->getType();
+    switch (op->getOpcode()) {
+    case llvm::Instruction::Add:
+    case llvm::Instruction::Or:
+    case llvm::Instruction::Xor:
+        return llvm::Constant::getNullValue(type);
+    case llvm::Instruction::FAdd:
+        return llvm::ConstantFP::getNegativeZero(type);
+    case llvm::Instruction::Mul:
+        return llvm::ConstantInt::get(type, 1);
+    case llvm::Instruction::FMul:
+        return llvm::ConstantFP::get(type, 1.0);
+    case llvm::Instruction::And:
+        return llvm::Constant::getAllOnesValue(type);
+    default:
+        return init;
+    }
+}
+
+/** Emits the given reduction operation for the two values. */
+static llvm::Value *lCreateReductionOp(llvm::IRBuilder<> &B, llvm::Instruction *op, llvm::Value *a, llvm::Value *b) {
+    if (llvm::IntrinsicInst *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(op)) {
+        return B.CreateBinaryIntrinsic(intrinsic->getIntrinsicID(), a, b);
+    }
+    llvm::Value *result = B.CreateBinOp(llvm::cast<llvm::BinaryOperator>(op)->getOpcode(), a, b);
+    if (llvm::isa<llvm::FPMathOperator>(result) && llvm::isa<llvm::Instruction>(result)) {
+        llvm::cast<llvm::Instruction>(result)->copyFastMathFlags(op);
+    }
+    return result;
+}
+
+/** Splits the reduction of the given phi of the header of the loop into up
+    to count accumulators, if its value for the next iteration is computed
+    by a chain of the same operation, each accumulating one more value.
+ */
+static bool lSplitReduction(llvm::PHINode *phi, llvm::Loop *L, unsigned count) {
+    llvm::BasicBlock *latch = L->getLoopLatch();
+    llvm::BasicBlock *preheader = L->getLoopPreheader();
+    llvm::Value *next = phi->getIncomingValueForBlock(latch);
+
+    // Follow the accumulated value from the phi to its value for the next
+    // iteration.  The values in between must not be used for anything else.
+    std::vector<llvm::Instruction *> chain;
+    std::vector<unsigned> accOperands;
+    llvm::Value *acc = phi;
+    while (acc != next) {
+        if (!acc->hasOneUse()) {
+            return false;
+        }
+        llvm::Instruction *op = llvm::dyn_cast<llvm::Instruction>(*acc->user_begin());
+        unsigned accOperand = 0;
+        if (op == nullptr || !L->contains(op) || !lIsReductionOp(op, acc, &accOperand) ||
+            (!chain.empty() && !lIsSameOperation(op, chain[0]))) {
+            return false;
+        }
+        chain.push_back(op);
+        accOperands.push_back(accOperand);
+        acc = op;
+    }
+    if (chain.size() < 2) {
+        return false;
+    }
+
+    // The final value may only be used after the loop, by the phis of the
+    // LCSSA form.
+    std::vector<llvm::PHINode *> exitPhis;
+    for (llvm::User *user : next->users()) {
+        llvm::PHINode *exitPhi = llvm::dyn_cast<llvm::PHINode>(user);
+        if (exitPhi == phi) {
+            continue;
+        }
+        if (exitPhi == nullptr || L->contains(exitPhi) || exitPhi->getNumIncomingValues() != 1) {
+            return false;
+        }
+        exitPhis.push_back(exitPhi);
+    }
+
+    unsigned numAccs = std::min<unsigned>(count, chain.size());
+    llvm::Value *initial = lGetInitialValue(chain[0], phi->getIncomingValueForBlock(preheader));
+    std::vector<llvm::PHINode *> accPhis = {phi};
+    llvm::IRBuilder<> B(phi);
+    for (unsigned i = 1; i < numAccs; ++i) {
+        llvm::PHINode *accPhi = B.CreatePHI(phi->getType(), 2, phi->getName());
+        accPhi->addIncoming(initial, preheader);
+        accPhis.push_back(accPhi);
+    }
+
+    // Accumulate the values of the chain into the accumulators in turn.
+    std::vector<llvm::Value *> accs(accPhis.begin(), accPhis.end());
+    for (unsigned i = 0; i < chain.size(); ++i) {
+        unsigned j = i % numAccs;
+        chain[i]->setOperand(accOperands[i], accs[j]);
+        // The partial sums may overflow where the sum in the original
+        // order didn't.
+        if (!chain[i]->getType()->isFPOrFPVectorTy()) {
+            chain[i]->dropPoisonGeneratingFlags();
+        }
+        accs[j] = chain[i];
+    }
+    phi->setIncomingValueForBlock(latch, accs[0]);
+    for (unsigned j = 1; j < numAccs; ++j) {
+        accPhis[j]->addIncoming(accs[j], latch);
+    }
+
+    // Combine the accumulators after the loop.
+    for (llvm::PHINode *exitPhi : exitPhis) {
+        llvm::BasicBlock *exit = exitPhi->getParent();
+        llvm::BasicBlock *exiting = exitPhi->getIncomingBlock(0);
+        std::vector<llvm::Value *> values;
+        B.SetInsertPoint(exitPhi);
+        for (llvm::Value *accValue : accs) {
+            llvm::PHINode *value = B.CreatePHI(accValue->getType(), 1, exitPhi->getName());
+            value->addIncoming(accValue, exiting);
+            values.push_back(value);
+        }
+
+        B.SetInsertPoint(exit, exit->getFirstInsertionPt());
+        while (values.size() > 1) {
+            std::vector<llvm::Value *> combined;
+            for (unsigned i = 0; i + 1 < values.size(); i += 2) {
+                combined.push_back(lCreateReductionOp(B, chain[0], values[i], values[i + 1]));
+            }
+            if (values.size() % 2 == 1) {
+                combined.push_back(values.back());
+            }
+            values = combined;
+        }
+        exitPhi->replaceAllUsesWith(values[0]);
+        exitPhi->eraseFromParent();
+    }
+    return true;
+}
+
+bool SplitReductionsPass::splitReductions(llvm::Loop *L) {
+    auto count = llvm::getOptionalIntLoopAttribute(L, "ispc.loop.split_reductions");
+    if (!count || *count < 2) {
+        return false;
+    }
+
+    // The values for the next iteration are only combined after the loop if
+    // it is left from the latch.
+    llvm::BasicBlock *latch = L->getLoopLatch();
+    if (latch == nullptr || L->getLoopPreheader() == nullptr || L->getExitingBlock() != latch ||
+        !L->hasDedicatedExits()) {
+        return false;
+    }
+
+    std::vector<llvm::PHINode *> phis;
+    for (llvm::PHINode &phi : L->getHeader()->phis()) {
+        phis.push_back(&phi);
+    }
+    bool modified = false;
+    for (llvm::PHINode *phi : phis) {
+        modified |= lSplitReduction(phi, L, *count);
+    }
+    return modified;
+}
+
+llvm::PreservedAnalyses SplitReductionsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("SplitReductionsPass::run", F.getName());
+
+    llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    bool modifiedAny = false;
+    for (llvm::Loop *L : LI.getLoopsInPreorder()) {
+        modifiedAny |= splitReductions(L);
+    }
+
+    if (!modifiedAny) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
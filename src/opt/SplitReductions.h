@@ -0,0 +1,36 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+
+namespace ispc {
+
+// This pass splits the reductions in the loops with '#pragma
+// unroll_reductions COUNT' into COUNT independent accumulators after the
+// loop unroller has unrolled them COUNT times.  A sum like
+// "sum += a[i] * b[i]" then has COUNT chains of additions that don't wait
+// for each other, instead of one whose length is the latency of an
+// addition times the number of iterations; the accumulators are combined
+// after the loop.
+//
+// Additions, multiplications, bitwise operations and minimums and maximums
+// are split.  Floating-point operations are reassociated by this, in the
+// same way that reduce_add() already adds the program instances' values in
+// no particular order.
+
+struct SplitReductionsPass : public llvm::PassInfoMixin<SplitReductionsPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool splitReductions(llvm::Loop *L);
+};
+
+} // namespace ispc
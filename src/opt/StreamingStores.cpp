@@ -0,0 +1,154 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "StreamingStores.h"
+
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/IRBuilder.h>
+
+#include <unordered_set>
+
+namespace ispc {
+
+/** Returns true if the given store writes a contiguous stream of memory in
+    the innermost loop that contains it, i.e. its address advances by the
+    size of the stored vector in each iteration, over a range that is too
+    large to stay in the cache: either more than the L2 cache size or only
+    known at run time, as in a foreach loop up to a uniform bound.
+ */
+static bool lIsLargeStream(llvm::StoreInst *store, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE) {
+    llvm::Loop *L = LI.getLoopFor(store->getParent());
+    if (L == nullptr) {
+        return false;
+    }
+
+    const llvm::SCEVAddRecExpr *addRec =
+        llvm::dyn_cast<llvm::SCEVAddRecExpr>(SE.getSCEV(store->getPointerOperand()));
+    if (addRec == nullptr || addRec->getLoop() != L || !addRec->isAffine()) {
+        return false;
+    }
+    const llvm::SCEVConstant *step = llvm::dyn_cast<llvm::SCEVConstant>(addRec->getStepRecurrence(SE));
+    int64_t size = store->getModule()->getDataLayout().getTypeStoreSize(store->getValueOperand()->getType());
+    if (step == nullptr || step->getAPInt().getSExtValue() != size) {
+        return false;
+    }
+
+    const llvm::SCEV *btc = SE.getBackedgeTakenCount(L);
+    if (llvm::isa<llvm::SCEVCouldNotCompute>(btc)) {
+        return false;
+    }
+    if (const llvm::SCEVConstant *count = llvm::dyn_cast<llvm::SCEVConstant>(btc)) {
+        uint64_t bytes = (count->getAPInt().getZExtValue() + 1) * size;
+        return bytes > (uint64_t)g->target->getDataCacheSize(2);
+    }
+    return true;
+}
+
+bool StreamingStoresPass::markStreamingStores(llvm::Function &F, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE) {
+    // Collect the objects that the function may read from; stores to them
+    // are left alone, as the data is likely wanted in the cache.
+    std::unordered_set<const llvm::Value *> readObjects;
+    std::vector<llvm::StoreInst *> candidates;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            if (llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(&I)) {
+                readObjects.insert(llvm::getUnderlyingObject(load->getPointerOperand()));
+            } else if (llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(&I)) {
+                if (!callInst->mayReadFromMemory()) {
+                    continue;
+                }
+                for (llvm::Value *arg : callInst->args()) {
+                    if (arg->getType()->isPointerTy()) {
+                        readObjects.insert(llvm::getUnderlyingObject(arg));
+                    }
+                }
+            } else if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+                if (store->isSimple() && store->getValueOperand()->getType()->isVectorTy() &&
+                    !store->hasMetadata(llvm::LLVMContext::MD_nontemporal) && LI.getLoopFor(&BB) != nullptr) {
+                    candidates.push_back(store);
+                }
+            }
+        }
+    }
+
+    bool modifiedAny = false;
+    llvm::MDNode *nontemporal = llvm::MDNode::get(
+        F.getContext(), llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(LLVMTypes::Int32Type, 1)));
+    for (llvm::StoreInst *store : candidates) {
+        const llvm::Value *object = llvm::getUnderlyingObject(store->getPointerOperand());
+        if (llvm::isa<llvm::AllocaInst>(object) || readObjects.find(object) != readObjects.end()) {
+            continue;
+        }
+        if (lIsLargeStream(store, LI, SE)) {
+            store->setMetadata(llvm::LLVMContext::MD_nontemporal, nontemporal);
+            modifiedAny = true;
+        }
+    }
+    return modifiedAny;
+}
+
+bool StreamingStoresPass::insertFences(llvm::Function &F) {
+    // Functions that are going to be inlined get the fence in the function
+    // they're inlined in.
+    if (F.hasFnAttribute(llvm::Attribute::AlwaysInline)) {
+        return false;
+    }
+
+    bool hasStreamingStores = false;
+    std::vector<llvm::ReturnInst *> returns;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(&I);
+            if (store != nullptr && store->hasMetadata(llvm::LLVMContext::MD_nontemporal)) {
+                hasStreamingStores = true;
+            }
+        }
+        if (llvm::ReturnInst *ret = llvm::dyn_cast<llvm::ReturnInst>(BB.getTerminator())) {
+            returns.push_back(ret);
+        }
+    }
+    if (!hasStreamingStores) {
+        return false;
+    }
+
+    llvm::Function *sfence = llvm::Intrinsic::getDeclaration(F.getParent(), llvm::Intrinsic::x86_sse_sfence);
+    bool modifiedAny = false;
+    for (llvm::ReturnInst *ret : returns) {
+        llvm::CallInst *prev = llvm::dyn_cast_or_null<llvm::CallInst>(ret->getPrevNode());
+        if (prev != nullptr && prev->getCalledFunction() == sfence) {
+            continue;
+        }
+        llvm::IRBuilder<>(ret).CreateCall(sfence);
+        modifiedAny = true;
+    }
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses StreamingStoresPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("StreamingStoresPass::run", F.getName());
+
+    bool modifiedAny = false;
+    if (g->opt.streamingStores) {
+        llvm::LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+        if (!LI.empty()) {
+            llvm::ScalarEvolution &SE = FAM.getResult<llvm::ScalarEvolutionAnalysis>(F);
+            modifiedAny |= markStreamingStores(F, LI, SE);
+        }
+    }
+    modifiedAny |= insertFences(F);
+
+    if (!modifiedAny) {
+        // No changes, all analyses are preserved.
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
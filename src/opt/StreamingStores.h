@@ -0,0 +1,39 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+
+namespace ispc {
+
+// This pass deals with non-temporal ("streaming") stores on x86 targets.
+//
+//  With --opt=streaming-stores, vector stores in loops that write a
+//  contiguous stream of memory that the function never reads, over a range
+//  that is larger than the L2 cache or only known at run time, are marked
+//  as non-temporal, so that they're emitted as MOVNT* instructions.  That
+//  saves reading the cache lines before they're written, and keeps the
+//  output from evicting the data that the loop works on.
+//
+//  Non-temporal stores are weakly ordered with respect to other stores, so
+//  an SFENCE is inserted before the returns of functions that do them, be
+//  it from the stores marked here or from calls to streaming_store(), so
+//  that the data is visible to other threads once the function is done.
+
+struct StreamingStoresPass : public llvm::PassInfoMixin<StreamingStoresPass> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool markStreamingStores(llvm::Function &F, llvm::LoopInfo &LI, llvm::ScalarEvolution &SE);
+    bool insertFences(llvm::Function &F);
+};
+
+} // namespace ispc
@@ -0,0 +1,417 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "UniformityInference.h"
+
+#include <llvm/ADT/PostOrderIterator.h>
+#include <llvm/Analysis/VectorUtils.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Transforms/Utils/Local.h>
+
+#include <algorithm>
+
+namespace ispc {
+
+/** Returns true for the intrinsics that operate on each element of their
+    vector operands and are overloaded only on the type of their result, so
+    that the same intrinsic can be called with scalars.
+ */
+static bool lIsElementwiseIntrinsic(llvm::Intrinsic::ID id) {
+    switch (id) {
+    case llvm::Intrinsic::sqrt:
+    case llvm::Intrinsic::fabs:
+    case llvm::Intrinsic::floor:
+    case llvm::Intrinsic::ceil:
+    case llvm::Intrinsic::trunc:
+    case llvm::Intrinsic::rint:
+    case llvm::Intrinsic::nearbyint:
+    case llvm::Intrinsic::round:
+    case llvm::Intrinsic::minnum:
+    case llvm::Intrinsic::maxnum:
+    case llvm::Intrinsic::copysign:
+    case llvm::Intrinsic::fma:
+    case llvm::Intrinsic::fmuladd:
+    case llvm::Intrinsic::smin:
+    case llvm::Intrinsic::smax:
+    case llvm::Intrinsic::umin:
+    case llvm::Intrinsic::umax:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/** If the given value is a chain of insertelement instructions into an
+    undefined vector that only inserts one value, at constant indices,
+    returns that value.  The lanes that aren't written are undefined, so
+    they can be taken to have it too.
+ */
+static llvm::Value *lGetInsertChainScalar(llvm::Value *v) {
+    llvm::Value *scalar = nullptr;
+    while (llvm::InsertElementInst *ie = llvm::dyn_cast<llvm::InsertElementInst>(v)) {
+        if (!llvm::isa<llvm::ConstantInt>(ie->getOperand(2)) ||
+            (scalar != nullptr && ie->getOperand(1) != scalar)) {
+            return nullptr;
+        }
+        scalar = ie->getOperand(1);
+        v = ie->getOperand(0);
+    }
+    return llvm::isa<llvm::UndefValue>(v) ? scalar : nullptr;
+}
+
+/** If all of the elements of the given shuffle are taken from the same
+    operand, returns that operand, or nullptr otherwise.
+ */
+static llvm::Value *lGetShuffleSource(llvm::ShuffleVectorInst *shuffle) {
+    int numSrcElements = llvm::cast<llvm::FixedVectorType>(shuffle->getOperand(0)->getType())->getNumElements();
+    bool fromFirst = false, fromSecond = false;
+    for (int elt : shuffle->getShuffleMask()) {
+        if (elt < 0) {
+            return nullptr;
+        }
+        (elt < numSrcElements ? fromFirst : fromSecond) = true;
+    }
+    return fromSecond ? (fromFirst ? nullptr : shuffle->getOperand(1)) : shuffle->getOperand(0);
+}
+
+/** Returns true if all of the elements of the given shuffle are the same
+    element of its operands.
+ */
+static bool lIsBroadcastShuffle(llvm::ShuffleVectorInst *shuffle) {
+    llvm::ArrayRef<int> mask = shuffle->getShuffleMask();
+    return mask[0] >= 0 && std::all_of(mask.begin(), mask.end(), [&mask](int elt) { return elt == mask[0]; });
+}
+
+bool UniformityInferencePass::isCandidate(llvm::Value *v) const {
+    if (!llvm::isa<llvm::FixedVectorType>(v->getType())) {
+        return false;
+    }
+    if (llvm::Argument *arg = llvm::dyn_cast<llvm::Argument>(v)) {
+        return localFunctions.count(arg->getParent()) != 0;
+    }
+    if (llvm::IntrinsicInst *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(v)) {
+        return lIsElementwiseIntrinsic(intrinsic->getIntrinsicID());
+    }
+    if (llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(v)) {
+        return localFunctions.count(callInst->getCalledFunction()) != 0;
+    }
+    if (llvm::CastInst *cast = llvm::dyn_cast<llvm::CastInst>(v)) {
+        // Only casts between vectors with the same number of elements are
+        // done elementwise.
+        llvm::FixedVectorType *srcType = llvm::dyn_cast<llvm::FixedVectorType>(cast->getSrcTy());
+        return srcType != nullptr &&
+               srcType->getNumElements() == llvm::cast<llvm::FixedVectorType>(cast->getDestTy())->getNumElements();
+    }
+    return llvm::isa<llvm::BinaryOperator>(v) || llvm::isa<llvm::UnaryOperator>(v) || llvm::isa<llvm::CmpInst>(v) ||
+           llvm::isa<llvm::SelectInst>(v) || llvm::isa<llvm::PHINode>(v) || llvm::isa<llvm::FreezeInst>(v) ||
+           llvm::isa<llvm::GetElementPtrInst>(v);
+}
+
+bool UniformityInferencePass::isUniform(llvm::Value *v) const {
+    if (!v->getType()->isVectorTy()) {
+        // Scalar operands of vector instructions are the same for all lanes.
+        return true;
+    }
+    if (isCandidate(v)) {
+        return uniformValues.count(v) != 0;
+    }
+    if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(v)) {
+        return llvm::isa<llvm::UndefValue>(c) || c->getSplatValue() != nullptr;
+    }
+    if (llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(v)) {
+        if (lIsBroadcastShuffle(shuffle)) {
+            return true;
+        }
+        llvm::Value *source = lGetShuffleSource(shuffle);
+        return source != nullptr && isUniform(source);
+    }
+    return lGetInsertChainScalar(v) != nullptr;
+}
+
+bool UniformityInferencePass::checkUniform(llvm::Value *v) const {
+    if (llvm::Argument *arg = llvm::dyn_cast<llvm::Argument>(v)) {
+        for (llvm::User *user : arg->getParent()->users()) {
+            if (!isUniform(llvm::cast<llvm::CallInst>(user)->getArgOperand(arg->getArgNo()))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(v);
+    if (callInst != nullptr && !llvm::isa<llvm::IntrinsicInst>(callInst)) {
+        for (llvm::BasicBlock &BB : *callInst->getCalledFunction()) {
+            llvm::ReturnInst *ret = llvm::dyn_cast<llvm::ReturnInst>(BB.getTerminator());
+            if (ret != nullptr && !isUniform(ret->getReturnValue())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Phis, selects and the elementwise operations are uniform if all of
+    // their operands are.
+    for (llvm::Value *op : llvm::cast<llvm::Instruction>(v)->operands()) {
+        if (!isUniform(op)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UniformityInferencePass::inferUniformValues(llvm::Module &M) {
+    // Start by assuming that all of the candidates are uniform, and remove
+    // the ones that turn out not to be until nothing changes, so that the
+    // values that depend on each other through phis and calls are proven
+    // uniform together.
+    std::vector<llvm::Value *> worklist;
+    for (llvm::Function &F : M) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+        for (llvm::Argument &arg : F.args()) {
+            if (isCandidate(&arg)) {
+                worklist.push_back(&arg);
+            }
+        }
+        for (llvm::Instruction &I : llvm::instructions(F)) {
+            if (isCandidate(&I)) {
+                worklist.push_back(&I);
+            }
+        }
+    }
+    uniformValues.insert(worklist.begin(), worklist.end());
+
+    while (!worklist.empty()) {
+        llvm::Value *v = worklist.back();
+        worklist.pop_back();
+        if (uniformValues.count(v) == 0 || checkUniform(v)) {
+            continue;
+        }
+        uniformValues.erase(v);
+
+        // Check again the values that may have been uniform only because
+        // this one was.
+        for (llvm::User *user : v->users()) {
+            if (isCandidate(user)) {
+                worklist.push_back(user);
+            }
+            if (llvm::ReturnInst *ret = llvm::dyn_cast<llvm::ReturnInst>(user)) {
+                if (localFunctions.count(ret->getFunction()) != 0) {
+                    for (llvm::User *call : ret->getFunction()->users()) {
+                        worklist.push_back(call);
+                    }
+                }
+            } else if (llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(user)) {
+                llvm::Function *callee = callInst->getCalledFunction();
+                if (localFunctions.count(callee) != 0) {
+                    for (unsigned i = 0; i < callInst->arg_size(); ++i) {
+                        if (callInst->getArgOperand(i) == v) {
+                            worklist.push_back(callee->getArg(i));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/** Returns a scalar with the value of all of the lanes of the given
+    uniform value, creating an extractelement after its definition if it
+    isn't directly available.
+ */
+llvm::Value *UniformityInferencePass::getScalar(llvm::Value *v,
+                                                std::unordered_map<llvm::Value *, llvm::Value *> &scalars) {
+    if (!v->getType()->isVectorTy()) {
+        return v;
+    }
+    auto iter = scalars.find(v);
+    if (iter != scalars.end()) {
+        return iter->second;
+    }
+
+    llvm::Value *scalar = nullptr;
+    if (llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(v)) {
+        scalar = c->getSplatValue();
+        if (scalar == nullptr) {
+            llvm::Type *elementType = c->getType()->getScalarType();
+            scalar = llvm::isa<llvm::PoisonValue>(c) ? llvm::PoisonValue::get(elementType)
+                                                     : llvm::UndefValue::get(elementType);
+        }
+        return scalar;
+    }
+    if ((scalar = lGetInsertChainScalar(v)) != nullptr) {
+        return scalar;
+    }
+
+    llvm::Value *vector = v;
+    int element = 0;
+    llvm::ShuffleVectorInst *shuffle = llvm::dyn_cast<llvm::ShuffleVectorInst>(v);
+    if (shuffle != nullptr && !lIsBroadcastShuffle(shuffle)) {
+        return getScalar(lGetShuffleSource(shuffle), scalars);
+    }
+    if (shuffle != nullptr) {
+        // All of the elements are this element of one of the operands.
+        int numSrcElements = llvm::cast<llvm::FixedVectorType>(shuffle->getOperand(0)->getType())->getNumElements();
+        element = shuffle->getMaskValue(0);
+        vector = shuffle->getOperand(element < numSrcElements ? 0 : 1);
+        element %= numSrcElements;
+        if ((scalar = llvm::findScalarElement(vector, element)) != nullptr) {
+            scalars[v] = scalar;
+            return scalar;
+        }
+    }
+
+    llvm::BasicBlock::iterator insertPt;
+    if (llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(v)) {
+        insertPt = llvm::isa<llvm::PHINode>(inst) ? inst->getParent()->getFirstInsertionPt()
+                                                  : std::next(inst->getIterator());
+    } else {
+        llvm::BasicBlock &entry = llvm::cast<llvm::Argument>(v)->getParent()->getEntryBlock();
+        insertPt = entry.getFirstInsertionPt();
+    }
+    llvm::IRBuilder<> B(insertPt->getParent(), insertPt);
+    scalar = B.CreateExtractElement(vector, B.getInt32(element), v->getName());
+    scalars[v] = scalar;
+    return scalar;
+}
+
+bool UniformityInferencePass::scalarizeFunction(llvm::Function &F) {
+    // The calls of internal functions stay as they are; their results are
+    // extracted from the returned vector where needed.
+    std::vector<llvm::Instruction *> insts;
+    llvm::ReversePostOrderTraversal<llvm::Function *> RPOT(&F);
+    for (llvm::BasicBlock *BB : RPOT) {
+        for (llvm::Instruction &I : *BB) {
+            if (uniformValues.count(&I) != 0 && (!llvm::isa<llvm::CallInst>(I) || llvm::isa<llvm::IntrinsicInst>(I))) {
+                insts.push_back(&I);
+            }
+        }
+    }
+    if (insts.empty()) {
+        return false;
+    }
+
+    std::unordered_map<llvm::Value *, llvm::Value *> scalars;
+    // Create the scalar phis first, as their incoming values may be
+    // defined after them.
+    for (llvm::Instruction *I : insts) {
+        if (llvm::PHINode *phi = llvm::dyn_cast<llvm::PHINode>(I)) {
+            llvm::IRBuilder<> B(phi);
+            scalars[phi] = B.CreatePHI(phi->getType()->getScalarType(), phi->getNumIncomingValues(), phi->getName());
+        }
+    }
+
+    for (llvm::Instruction *I : insts) {
+        if (llvm::isa<llvm::PHINode>(I)) {
+            continue;
+        }
+        llvm::IRBuilder<> B(I);
+        llvm::Type *scalarType = I->getType()->getScalarType();
+        llvm::Value *scalar = nullptr;
+        if (llvm::BinaryOperator *bop = llvm::dyn_cast<llvm::BinaryOperator>(I)) {
+            scalar = B.CreateBinOp(bop->getOpcode(), getScalar(bop->getOperand(0), scalars),
+                                   getScalar(bop->getOperand(1), scalars), I->getName());
+        } else if (llvm::UnaryOperator *uop = llvm::dyn_cast<llvm::UnaryOperator>(I)) {
+            scalar = B.CreateUnOp(uop->getOpcode(), getScalar(uop->getOperand(0), scalars), I->getName());
+        } else if (llvm::CmpInst *cmp = llvm::dyn_cast<llvm::CmpInst>(I)) {
+            scalar = B.CreateCmp(cmp->getPredicate(), getScalar(cmp->getOperand(0), scalars),
+                                 getScalar(cmp->getOperand(1), scalars), I->getName());
+        } else if (llvm::CastInst *cast = llvm::dyn_cast<llvm::CastInst>(I)) {
+            scalar = B.CreateCast(cast->getOpcode(), getScalar(cast->getOperand(0), scalars), scalarType, I->getName());
+        } else if (llvm::SelectInst *select = llvm::dyn_cast<llvm::SelectInst>(I)) {
+            scalar = B.CreateSelect(getScalar(select->getCondition(), scalars),
+                                    getScalar(select->getTrueValue(), scalars),
+                                    getScalar(select->getFalseValue(), scalars), I->getName());
+        } else if (llvm::FreezeInst *freeze = llvm::dyn_cast<llvm::FreezeInst>(I)) {
+            scalar = B.CreateFreeze(getScalar(freeze->getOperand(0), scalars), I->getName());
+        } else if (llvm::GetElementPtrInst *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(I)) {
+            std::vector<llvm::Value *> indices;
+            for (llvm::Value *index : gep->indices()) {
+                indices.push_back(getScalar(index, scalars));
+            }
+            llvm::Value *ptr = getScalar(gep->getPointerOperand(), scalars);
+            scalar = gep->isInBounds() ? B.CreateInBoundsGEP(gep->getSourceElementType(), ptr, indices, I->getName())
+                                       : B.CreateGEP(gep->getSourceElementType(), ptr, indices, I->getName());
+        } else {
+            llvm::IntrinsicInst *intrinsic = llvm::cast<llvm::IntrinsicInst>(I);
+            std::vector<llvm::Value *> args;
+            for (llvm::Value *arg : intrinsic->args()) {
+                args.push_back(getScalar(arg, scalars));
+            }
+            llvm::Function *func =
+                llvm::Intrinsic::getDeclaration(F.getParent(), intrinsic->getIntrinsicID(), {scalarType});
+            scalar = B.CreateCall(func, args, I->getName());
+        }
+        if (llvm::Instruction *scalarInst = llvm::dyn_cast<llvm::Instruction>(scalar)) {
+            scalarInst->copyIRFlags(I);
+        }
+        scalars[I] = scalar;
+    }
+
+    for (llvm::Instruction *I : insts) {
+        if (llvm::PHINode *phi = llvm::dyn_cast<llvm::PHINode>(I)) {
+            llvm::PHINode *scalarPhi = llvm::cast<llvm::PHINode>(scalars[phi]);
+            for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+                scalarPhi->addIncoming(getScalar(phi->getIncomingValue(i), scalars), phi->getIncomingBlock(i));
+            }
+        }
+    }
+
+    // Broadcast the scalars for the users that still need vectors; the
+    // broadcasts that are only used by the replaced instructions are
+    // removed.
+    std::vector<llvm::Value *> broadcasts;
+    for (llvm::Instruction *I : insts) {
+        llvm::IRBuilder<> B(llvm::isa<llvm::PHINode>(I) ? &*I->getParent()->getFirstInsertionPt() : I);
+        int numElements = llvm::cast<llvm::FixedVectorType>(I->getType())->getNumElements();
+        llvm::Value *broadcast = B.CreateVectorSplat(numElements, scalars[I], I->getName());
+        I->replaceAllUsesWith(broadcast);
+        broadcasts.push_back(broadcast);
+    }
+    for (llvm::Instruction *I : insts) {
+        I->eraseFromParent();
+    }
+    for (llvm::Value *broadcast : broadcasts) {
+        llvm::RecursivelyDeleteTriviallyDeadInstructions(broadcast);
+    }
+    return true;
+}
+
+llvm::PreservedAnalyses UniformityInferencePass::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("UniformityInferencePass::run", M.getName());
+
+    // The parameters and results of the internal functions are only known
+    // if all of their uses are calls of them.
+    localFunctions.clear();
+    for (llvm::Function &F : M) {
+        if (F.isDeclaration() || !F.hasLocalLinkage() || F.isVarArg()) {
+            continue;
+        }
+        bool onlyCalled = true;
+        for (llvm::Use &use : F.uses()) {
+            llvm::CallInst *callInst = llvm::dyn_cast<llvm::CallInst>(use.getUser());
+            onlyCalled &= callInst != nullptr && callInst->isCallee(&use);
+        }
+        if (onlyCalled) {
+            localFunctions.insert(&F);
+        }
+    }
+
+    uniformValues.clear();
+    inferUniformValues(M);
+
+    bool modifiedAny = false;
+    for (llvm::Function &F : M) {
+        if (!F.isDeclaration()) {
+            modifiedAny |= scalarizeFunction(F);
+        }
+    }
+
+    return modifiedAny ? llvm::PreservedAnalyses::none() : llvm::PreservedAnalyses::all();
+}
+
+} // namespace ispc
@@ -0,0 +1,54 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ispc {
+
+/** With --opt=uniformity-inference, this pass finds the varying values
+    that have the same value in all of the program instances, like loop
+    counters that start from and are compared with uniform values, and
+    does their computation with scalars instead of vectors.
+
+    Lanes are proven equal optimistically over the whole module: only
+    elementwise operations, phis and selects of values proven equal are
+    kept, starting from splat constants and broadcasts.  The parameters of
+    internal functions whose calls can all be seen are equal if all of
+    the calls pass equal values, and calls of them return equal values if
+    all of their returns do.
+
+    The scalar values are broadcast where a vector is still needed, so
+    that the later passes see the broadcast pointers and offsets of
+    gathers and scatters and turn them into scalar loads and stores.
+ */
+class UniformityInferencePass : public llvm::PassInfoMixin<UniformityInferencePass> {
+  public:
+    explicit UniformityInferencePass() {}
+
+    static llvm::StringRef getPassName() { return "Uniformity inference"; }
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+
+  private:
+    bool isCandidate(llvm::Value *v) const;
+    bool isUniform(llvm::Value *v) const;
+    bool checkUniform(llvm::Value *v) const;
+    void inferUniformValues(llvm::Module &M);
+    llvm::Value *getScalar(llvm::Value *v, std::unordered_map<llvm::Value *, llvm::Value *> &scalars);
+    bool scalarizeFunction(llvm::Function &F);
+
+    // Internal functions that are only called directly.
+    std::unordered_set<llvm::Function *> localFunctions;
+    // Values that are assumed to be uniform while inferring, and are proven
+    // to be afterwards.
+    std::unordered_set<llvm::Value *> uniformValues;
+};
+
+} // namespace ispc
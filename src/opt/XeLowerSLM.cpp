@@ -0,0 +1,174 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "XeLowerSLM.h"
+
+#ifdef ISPC_XE_ENABLED
+
+namespace ispc {
+
+static bool lIsLocalPointer(llvm::Value *v) {
+    llvm::PointerType *pt = llvm::dyn_cast<llvm::PointerType>(v->getType());
+    return pt != nullptr && pt->getAddressSpace() == (unsigned)AddressSpace::ispc_local;
+}
+
+static bool lRefersToSLM(llvm::Constant *c) {
+    if (llvm::isa<llvm::GlobalVariable>(c)) {
+        return lIsLocalPointer(c);
+    }
+    if (llvm::ConstantExpr *ce = llvm::dyn_cast<llvm::ConstantExpr>(c)) {
+        for (unsigned i = 0; i < ce->getNumOperands(); ++i) {
+            if (lRefersToSLM(ce->getOperand(i))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Constant expressions can't be rewritten one use at a time, so the ones
+// that refer to the SLM variables are turned into instructions first.
+static void lExpandSLMConstantExprs(llvm::Function &F) {
+    std::vector<llvm::Instruction *> worklist;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            worklist.push_back(&I);
+        }
+    }
+    while (!worklist.empty()) {
+        llvm::Instruction *inst = worklist.back();
+        worklist.pop_back();
+        for (unsigned i = 0; i < inst->getNumOperands(); ++i) {
+            llvm::ConstantExpr *ce = llvm::dyn_cast<llvm::ConstantExpr>(inst->getOperand(i));
+            if (ce == nullptr || !lRefersToSLM(ce)) {
+                continue;
+            }
+            llvm::Instruction *insertBefore = inst;
+            if (llvm::PHINode *phi = llvm::dyn_cast<llvm::PHINode>(inst)) {
+                insertBefore = phi->getIncomingBlock(i)->getTerminator();
+            }
+            llvm::Instruction *expanded = ce->getAsInstruction();
+            expanded->insertBefore(insertBefore);
+            inst->setOperand(i, expanded);
+            worklist.push_back(expanded);
+        }
+    }
+}
+
+static bool lIsSLMToGenericCast(llvm::Instruction *inst) {
+    llvm::AddrSpaceCastInst *cast = llvm::dyn_cast<llvm::AddrSpaceCastInst>(inst);
+    return cast != nullptr && lIsLocalPointer(cast->getOperand(0)) && !lIsLocalPointer(cast);
+}
+
+bool XeLowerSLM::lowerSLMAccesses(llvm::Function &F) {
+    DEBUG_START_PASS("XeLowerSLM");
+    lExpandSLMConstantExprs(F);
+
+    std::vector<llvm::AddrSpaceCastInst *> casts;
+    for (llvm::BasicBlock &BB : F) {
+        for (llvm::Instruction &I : BB) {
+            if (lIsSLMToGenericCast(&I)) {
+                casts.push_back(llvm::cast<llvm::AddrSpaceCastInst>(&I));
+            }
+        }
+    }
+
+    bool modifiedAny = false;
+    std::vector<llvm::AddrSpaceCastInst *> remaining;
+    while (!casts.empty()) {
+        llvm::AddrSpaceCastInst *cast = casts.back();
+        casts.pop_back();
+        llvm::Value *local = cast->getOperand(0);
+
+        for (llvm::Use &use : llvm::make_early_inc_range(cast->uses())) {
+            llvm::Instruction *user = llvm::dyn_cast<llvm::Instruction>(use.getUser());
+            if (user == nullptr) {
+                continue;
+            }
+            if (llvm::isa<llvm::LoadInst>(user)) {
+                use.set(local);
+                modifiedAny = true;
+            } else if (llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+                // Storing the address itself needs the generic pointer.
+                if (use.getOperandNo() == store->getPointerOperandIndex()) {
+                    use.set(local);
+                    modifiedAny = true;
+                }
+            } else if (llvm::GetElementPtrInst *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(user)) {
+                if (use.getOperandNo() != gep->getPointerOperandIndex()) {
+                    continue;
+                }
+                std::vector<llvm::Value *> indices(gep->idx_begin(), gep->idx_end());
+                llvm::GetElementPtrInst *localGEP =
+                    llvm::GetElementPtrInst::Create(gep->getSourceElementType(), local, indices, gep->getName(),
+                                                    ISPC_INSERTION_POINT_INSTRUCTION(gep));
+                localGEP->setIsInBounds(gep->isInBounds());
+                llvm::AddrSpaceCastInst *newCast = new llvm::AddrSpaceCastInst(
+                    localGEP, gep->getType(), gep->getName() + "__generic", ISPC_INSERTION_POINT_INSTRUCTION(gep));
+                gep->replaceAllUsesWith(newCast);
+                gep->eraseFromParent();
+                casts.push_back(newCast);
+                modifiedAny = true;
+            }
+#ifndef ISPC_OPAQUE_PTR_MODE
+            else if (llvm::BitCastInst *bc = llvm::dyn_cast<llvm::BitCastInst>(user)) {
+                llvm::PointerType *bcType = llvm::dyn_cast<llvm::PointerType>(bc->getType());
+                if (bcType == nullptr) {
+                    continue;
+                }
+                llvm::BitCastInst *localBC = new llvm::BitCastInst(
+                    local, llvm::PointerType::getWithSamePointeeType(bcType, (unsigned)AddressSpace::ispc_local),
+                    bc->getName(), ISPC_INSERTION_POINT_INSTRUCTION(bc));
+                llvm::AddrSpaceCastInst *newCast = new llvm::AddrSpaceCastInst(
+                    localBC, bcType, bc->getName() + "__generic", ISPC_INSERTION_POINT_INSTRUCTION(bc));
+                bc->replaceAllUsesWith(newCast);
+                bc->eraseFromParent();
+                casts.push_back(newCast);
+                modifiedAny = true;
+            }
+#endif
+        }
+
+        if (cast->use_empty()) {
+            cast->eraseFromParent();
+            modifiedAny = true;
+        } else {
+            remaining.push_back(cast);
+        }
+    }
+
+    // The gathers and scatters take the addresses as integers and access
+    // the global memory with them, which would silently do the wrong thing.
+    for (llvm::AddrSpaceCastInst *cast : remaining) {
+        for (llvm::User *user : cast->users()) {
+            if (llvm::isa<llvm::PtrToIntInst>(user)) {
+                SourcePos pos;
+                LLVMGetSourcePosFromMetadata(llvm::cast<llvm::Instruction>(user), &pos);
+                Error(pos, "Only uniform and contiguous accesses to \"task_shared\" variables are supported on Xe "
+                           "targets; the stores must also be done with all of the program instances active.");
+                break;
+            }
+        }
+    }
+
+    DEBUG_END_PASS("XeLowerSLM");
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses XeLowerSLM::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+    llvm::TimeTraceScope FuncScope("XeLowerSLM::run", F.getName());
+    if (!lowerSLMAccesses(F)) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
+
+#endif
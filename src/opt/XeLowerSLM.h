@@ -0,0 +1,34 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#ifdef ISPC_XE_ENABLED
+
+namespace ispc {
+
+/** "task_shared" variables are allocated in the shared local memory (SLM) on
+    Xe, i.e. they are global variables in the local address space. The front
+    end accesses them through an addrspacecast to the default address space,
+    so that they can be used like any other memory. This pass moves the loads
+    and stores (and the address computations feeding them) back to the local
+    address space, so the back-end emits SLM messages for them. The accesses
+    that need the address as an integer, i.e. gathers and scatters, aren't
+    supported and are reported as errors.
+ */
+struct XeLowerSLM : public llvm::PassInfoMixin<XeLowerSLM> {
+
+    llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+  private:
+    bool lowerSLMAccesses(llvm::Function &F);
+};
+
+} // namespace ispc
+
+#endif
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#include "XeSpecConstants.h"
+
+#ifdef ISPC_XE_ENABLED
+
+namespace ispc {
+
+// Returns the declaration of __spirv_SpecConstant() for the given type.  The
+// overloads for the different types are told apart by a suffix until
+// MangleOpenCLBuiltins mangles their names.
+static llvm::Function *lGetSpecConstantFunc(llvm::Module &M, llvm::Type *type) {
+    std::string typeName;
+    llvm::raw_string_ostream os(typeName);
+    type->print(os);
+    std::string name = "__spirv_SpecConstant." + os.str();
+    llvm::FunctionType *ftype = llvm::FunctionType::get(type, {LLVMTypes::Int32Type, type}, false);
+    llvm::Function *func = llvm::dyn_cast<llvm::Function>(M.getOrInsertFunction(name, ftype).getCallee());
+    Assert(func != nullptr);
+    func->setCallingConv(llvm::CallingConv::SPIR_FUNC);
+    func->setDoesNotAccessMemory();
+    func->setDoesNotThrow();
+    return func;
+}
+
+bool XeSpecConstants::lowerSpecConstants(llvm::Module &M) {
+    bool modifiedAny = false;
+    for (llvm::GlobalVariable &gv : llvm::make_early_inc_range(M.globals())) {
+        llvm::MDNode *md = gv.getMetadata("ispc.specconst");
+        if (md == nullptr) {
+            continue;
+        }
+        llvm::ConstantInt *id = llvm::mdconst::extract<llvm::ConstantInt>(md->getOperand(0));
+        llvm::Type *type = gv.getValueType();
+        llvm::Function *func = lGetSpecConstantFunc(M, type);
+
+        for (llvm::User *user : llvm::make_early_inc_range(gv.users())) {
+            llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(user);
+            if (load != nullptr && load->getType() == type) {
+                llvm::CallInst *call = llvm::CallInst::Create(func, {id, gv.getInitializer()}, gv.getName(),
+                                                              ISPC_INSERTION_POINT_INSTRUCTION(load));
+                call->setCallingConv(llvm::CallingConv::SPIR_FUNC);
+                call->setDebugLoc(load->getDebugLoc());
+                load->replaceAllUsesWith(call);
+                load->eraseFromParent();
+                modifiedAny = true;
+                continue;
+            }
+            SourcePos pos;
+            if (llvm::Instruction *inst = llvm::dyn_cast<llvm::Instruction>(user)) {
+                LLVMGetSourcePosFromMetadata(inst, &pos);
+            }
+            Error(pos, "\"specconst\" variable \"%s\" can only be read on Xe targets.", gv.getName().str().c_str());
+        }
+        if (gv.use_empty()) {
+            gv.eraseFromParent();
+        }
+    }
+    return modifiedAny;
+}
+
+llvm::PreservedAnalyses XeSpecConstants::run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM) {
+    llvm::TimeTraceScope FuncScope("XeSpecConstants::run", M.getName());
+    if (!lowerSpecConstants(M)) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::PreservedAnalyses PA;
+    PA.preserveSet<llvm::CFGAnalyses>();
+    return PA;
+}
+
+} // namespace ispc
+
+#endif
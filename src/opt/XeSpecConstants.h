@@ -0,0 +1,35 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+#pragma once
+
+#include "ISPCPass.h"
+
+#ifdef ISPC_XE_ENABLED
+
+namespace ispc {
+
+/** The "specconst" global variables are SPIR-V specialization constants on
+    Xe, whose values are set when the module is loaded by the runtime, so
+    that the back-end compiles the kernels with them folded in.  The front
+    end emits them as internal globals with their default values, marked
+    with the "ispc.specconst" metadata that holds their IDs.  This pass
+    replaces the loads of the globals with calls to __spirv_SpecConstant(),
+    which the SPIR-V translator turns into OpSpecConstant, and reports the
+    other uses, e.g. taking the address of the variable, as errors.  It runs
+    before any optimization, which would otherwise fold the default values.
+ */
+struct XeSpecConstants : public llvm::PassInfoMixin<XeSpecConstants> {
+
+    llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+
+  private:
+    bool lowerSpecConstants(llvm::Module &M);
+};
+
+} // namespace ispc
+
+#endif
@@ -42,15 +42,28 @@
 struct ForeachDimension;
 
 struct PragmaAttributes {
-    enum class AttributeType { none, pragmaloop, pragmawarning };
+    enum class AttributeType { none, pragmaloop, pragmawarning, pragmacacheblock, pragmavectorizedim, pragmafuse,
+                               pragmaexpect, pragmaspecialize, pragmatargets, pragmanarrow };
     PragmaAttributes() {
         aType = AttributeType::none;
         unrollType =  Globals::pragmaUnrollType::none;
         count = -1;
+        cacheLevel = 0;
+        fuse = false;
+        expectFlags = 0;
     }
     AttributeType aType;
     Globals::pragmaUnrollType unrollType;
     int count;
+    int cacheLevel;
+    std::string vectorizeDim;
+    bool fuse;
+    unsigned int expectFlags;
+    std::string specializeParam;
+    std::vector<int64_t> specializeValues;
+    std::vector<std::string> targetNames;
+    std::string narrowParam;
+    int64_t narrowThreshold = 0;
 };
 
 typedef std::pair<Declarator *, TemplateArgs *> SimpleTemplateIDType;
@@ -90,6 +103,22 @@ void lCleanUpString(std::string *str);
 void lFreeSimpleTemplateID(void *p);
 static int lYYTNameErr(char *yyres, const char *yystr);
 
+// Flags of the '#pragma ispc expect_no_*' directives before the function
+// definition that is being parsed.
+static unsigned int lFunctionExpectFlags = 0;
+
+// Parameters and values of the '#pragma ispc specialize' directives before
+// the function definition that is being parsed.
+static std::vector<FunctionSpecialization> lFunctionSpecializations;
+
+// ISAs of the '#pragma ispc targets' directive before the function
+// definition that is being parsed.
+static FunctionTargets lFunctionTargets;
+
+// Parameter and threshold of the '#pragma ispc narrow' directive before the
+// function definition that is being parsed.
+static FunctionNarrowing lFunctionNarrowing;
+
 static void lSuggestBuiltinAlternates();
 static void lSuggestParamListAlternates();
 
@@ -99,6 +128,9 @@ static void lAddTemplateSpecialization(const TemplateArgs &templArgs, DeclSpecs
 static void lAddFunctionParams(Declarator *decl);
 static void lAddMaskToSymbolTable(SourcePos pos);
 static void lAddThreadIndexCountToSymbolTable(SourcePos pos);
+static Symbol *lLookupTaskGroup(const char *name, SourcePos pos);
+static void lSetLaunchGroup(Expr *launch, const char *name, SourcePos pos);
+static void lSetLaunchReduction(Expr *launch, const char *keyword, SourcePos pos, uint64_t op, Expr *target);
 static std::string lGetAlternates(std::vector<std::string> &alternates);
 static const char *lGetStorageClassString(StorageClass sc);
 static bool lGetConstantInt(Expr *expr, int *value, SourcePos pos, const char *usage);
@@ -113,22 +145,26 @@ static void lFinalizeEnumeratorSymbols(std::vector<Symbol *> &enums,
 
 static const char *lBuiltinTokens[] = {
     "assert", "bool", "break", "case", "cdo",
-    "cfor", "cif", "cwhile", "const", "continue", "default",
+    "cfor", "cif", "cwhile", "const", "constexpr", "continue", "default",
     "do", "delete", "double", "else", "enum", "export", "extern", "false",
-    "float16", "float", "for", "foreach", "foreach_active", "foreach_tiled",
-    "foreach_unique", "goto", "if", "in", "inline",
+    "float16", "float", "for", "foreach", "foreach_active", "foreach_dynamic",
+    "foreach_tiled", "foreach_unique", "goto", "if", "in", "inline",
     "int", "int8", "int16", "int32", "int64", "invoke_sycl", "launch", "new", "NULL",
-    "print", "return", "signed", "sizeof", "static", "struct", "switch",
-    "sync", "task", "true", "typedef", "uniform", "unmasked", "unsigned",
+    "parallel_foreach", "print", "restrict", "return", "signed", "sizeof", "specconst", "static", "struct", "switch",
+    "sync", "task", "task_group", "task_shared", "true", "typedef", "uniform", "unmasked", "unsigned",
     "varying", "void", "while", "__attribute__", NULL
 };
 
 static const char *lParamListTokens[] = {
     "bool", "const", "double", "enum", "false", "float16", "float", "int",
-    "int8", "int16", "int32", "int64", "signed", "struct", "true",
+    "int8", "int16", "int32", "int64", "restrict", "signed", "struct", "true",
     "uniform", "unsigned", "varying", "void", "__attribute__", NULL
 };
 
+// The flag of "scratch new" in the qualifiers of rate_qualified_new, on
+// top of TYPEQUAL_UNIFORM and TYPEQUAL_VARYING.
+#define NEW_SCRATCH (1 << 30)
+
 struct ForeachDimension {
     ForeachDimension(Symbol *s = nullptr, Expr *b = nullptr, Expr *e = nullptr) {
         sym = s;
@@ -139,6 +175,8 @@ struct ForeachDimension {
     Expr *beginExpr, *endExpr;
 };
 
+static Stmt *lCreateParallelForeach(ForeachDimension *dim, Expr *grainExpr, Stmt *body, SourcePos pos);
+
 %}
 
 %union {
@@ -206,18 +244,19 @@ struct ForeachDimension {
 %token <stringVal> TOKEN_INTRINSIC_CALL
 
 %token TOKEN_EXTERN TOKEN_EXPORT TOKEN_STATIC TOKEN_INLINE TOKEN_NOINLINE TOKEN_VECTORCALL TOKEN_REGCALL TOKEN_TASK TOKEN_DECLSPEC
+%token TOKEN_RESTRICT
 %token TOKEN_UNIFORM TOKEN_VARYING TOKEN_TYPEDEF TOKEN_SOA TOKEN_UNMASKED
 %token TOKEN_INT TOKEN_SIGNED TOKEN_UNSIGNED TOKEN_FLOAT16 TOKEN_FLOAT TOKEN_DOUBLE
-%token TOKEN_INT8 TOKEN_INT16 TOKEN_INT64 TOKEN_CONST TOKEN_VOID TOKEN_BOOL
+%token TOKEN_INT8 TOKEN_INT16 TOKEN_INT64 TOKEN_CONST TOKEN_CONSTEXPR TOKEN_VOID TOKEN_BOOL
 %token TOKEN_UINT8 TOKEN_UINT16 TOKEN_UINT TOKEN_UINT64
 %token TOKEN_ENUM TOKEN_STRUCT TOKEN_TRUE TOKEN_FALSE
 
 %token TOKEN_CASE TOKEN_DEFAULT TOKEN_IF TOKEN_ELSE TOKEN_SWITCH
 %token TOKEN_WHILE TOKEN_DO TOKEN_LAUNCH TOKEN_FOREACH TOKEN_FOREACH_TILED
-%token TOKEN_FOREACH_UNIQUE TOKEN_FOREACH_ACTIVE TOKEN_DOTDOTDOT
+%token TOKEN_FOREACH_UNIQUE TOKEN_FOREACH_ACTIVE TOKEN_FOREACH_DYNAMIC TOKEN_PARALLEL_FOREACH TOKEN_DOTDOTDOT
 %token TOKEN_FOR TOKEN_GOTO TOKEN_CONTINUE TOKEN_BREAK TOKEN_RETURN
 %token TOKEN_CIF TOKEN_CDO TOKEN_CFOR TOKEN_CWHILE
-%token TOKEN_SYNC TOKEN_PRINT TOKEN_ASSERT TOKEN_INVOKE_SYCL
+%token TOKEN_SYNC TOKEN_TASK_GROUP TOKEN_TASK_SHARED TOKEN_SPECCONST TOKEN_PRINT TOKEN_ASSERT TOKEN_INVOKE_SYCL
 %token TOKEN_ATTRIBUTE
 
 %type <expr> primary_expression postfix_expression integer_dotdotdot
@@ -226,6 +265,7 @@ struct ForeachDimension {
 %type <expr> relational_expression equality_expression and_expression
 %type <expr> exclusive_or_expression inclusive_or_expression
 %type <expr> invoke_sycl_expression
+%type <intVal> launch_reduce_op
 %type <expr> logical_and_expression logical_or_expression new_expression
 %type <expr> conditional_expression assignment_expression expression
 %type <expr> initializer constant_expression for_test
@@ -234,7 +274,7 @@ struct ForeachDimension {
 %type <stmt> attributed_statement labeled_statement compound_statement for_init_statement statement
 %type <stmt> expression_statement selection_statement iteration_statement
 %type <stmt> jump_statement statement_list declaration_statement print_statement
-%type <stmt> assert_statement sync_statement delete_statement unmasked_statement
+%type <stmt> assert_statement sync_statement task_group_statement delete_statement unmasked_statement
 
 %type <declaration> declaration parameter_declaration
 %type <declarators> init_declarator_list
@@ -318,7 +358,9 @@ primary_expression
         const char *name = $1->c_str();
         Symbol *s = m->symbolTable->LookupVariable(name);
         $$ = nullptr;
-        if (s)
+        if (s && s->GetSymbolKind() == Symbol::SymbolKind::TaskGroup)
+            Error(@1, "Task group \"%s\" can only be used with \"launch\" and \"sync\".", name);
+        else if (s)
             $$ = new SymbolExpr(s, @1);
         else {
             std::vector<Symbol *> funs;
@@ -326,7 +368,7 @@ primary_expression
             if (funs.size() > 0)
                 $$ = new FunctionSymbolExpr(name, funs, @1);
         }
-        if ($$ == nullptr) {
+        if ($$ == nullptr && s == nullptr) {
             std::vector<std::string> alternates =
                 m->symbolTable->ClosestVariableOrFunctionMatch(name);
             std::string alts = lGetAlternates(alternates);
@@ -400,6 +442,24 @@ primary_expression
     | '(' error ')' { $$ = nullptr; }
     ;
 
+launch_reduce_op
+    : '+' { $$ = (uint64_t)TaskReductionOp::Add; }
+    | '*' { $$ = (uint64_t)TaskReductionOp::Mul; }
+    | TOKEN_IDENTIFIER
+      {
+          $$ = (uint64_t)TaskReductionOp::Add;
+          if (*$1 == "min") {
+              $$ = (uint64_t)TaskReductionOp::Min;
+          } else if (*$1 == "max") {
+              $$ = (uint64_t)TaskReductionOp::Max;
+          } else {
+              Error(@1, "Unknown operator \"%s\" of \"reduce\" clause; \"+\", \"*\", \"min\" or \"max\" "
+                    "is expected.", $1->c_str());
+          }
+          lCleanUpString($1);
+      }
+    ;
+
 launch_expression
     : TOKEN_LAUNCH postfix_expression '(' argument_expression_list ')'
       {
@@ -520,6 +580,26 @@ postfix_expression
     | postfix_expression '[' error ']'
       { $$ = nullptr; }
     | launch_expression
+    | launch_expression TOKEN_IN TOKEN_IDENTIFIER
+      {
+          lSetLaunchGroup($1, $3->c_str(), @3);
+          $$ = $1;
+          lCleanUpString($3);
+      }
+    | launch_expression TOKEN_IDENTIFIER '(' launch_reduce_op ':' unary_expression ')'
+      {
+          lSetLaunchReduction($1, $2->c_str(), @2, $4, $6);
+          $$ = $1;
+          lCleanUpString($2);
+      }
+    | launch_expression TOKEN_IN TOKEN_IDENTIFIER TOKEN_IDENTIFIER '(' launch_reduce_op ':' unary_expression ')'
+      {
+          lSetLaunchGroup($1, $3->c_str(), @3);
+          lSetLaunchReduction($1, $4->c_str(), @4, $6, $8);
+          $$ = $1;
+          lCleanUpString($3);
+          lCleanUpString($4);
+      }
     | postfix_expression '.' TOKEN_IDENTIFIER
       {
           $$ = MemberExpr::create($1, yytext, Union(@1,@3), @3, false);
@@ -779,6 +859,22 @@ rate_qualified_new
     : TOKEN_NEW { $$ = 0; }
     | TOKEN_UNIFORM TOKEN_NEW { $$ = TYPEQUAL_UNIFORM; }
     | TOKEN_VARYING TOKEN_NEW { $$ = TYPEQUAL_VARYING; }
+    | TOKEN_IDENTIFIER rate_qualified_new
+    {
+        // "scratch" isn't a keyword, so that it can still be used as a name.
+        if (*$1 != "scratch") {
+            Error(@1, "Expected \"scratch\", \"uniform\" or \"varying\" before \"new\", not \"%s\".",
+                  $1->c_str());
+            $$ = $2;
+        }
+        else if ($2 & NEW_SCRATCH) {
+            Error(@1, "Duplicate \"scratch\" qualifier for \"new\".");
+            $$ = $2;
+        }
+        else
+            $$ = $2 | NEW_SCRATCH;
+        lCleanUpString($1);
+    }
     ;
 
 rate_qualified_type_specifier
@@ -832,15 +928,18 @@ new_expression
     : conditional_expression
     | rate_qualified_new rate_qualified_type_specifier
     {
-        $$ = new NewExpr((int32_t)$1, $2, nullptr, nullptr, @1, Union(@1, @2));
+        $$ = new NewExpr((int32_t)$1 & ~NEW_SCRATCH, $2, nullptr, nullptr, @1, Union(@1, @2),
+                         ($1 & NEW_SCRATCH) != 0);
     }
     | rate_qualified_new rate_qualified_type_specifier '(' initializer_list ')'
     {
-        $$ = new NewExpr((int32_t)$1, $2, $4, nullptr, @1, Union(@1, @2));
+        $$ = new NewExpr((int32_t)$1 & ~NEW_SCRATCH, $2, $4, nullptr, @1, Union(@1, @2),
+                         ($1 & NEW_SCRATCH) != 0);
     }
     | rate_qualified_new rate_qualified_type_specifier '[' expression ']'
     {
-        $$ = new NewExpr((int32_t)$1, $2, nullptr, $4, @1, Union(@1, @4));
+        $$ = new NewExpr((int32_t)$1 & ~NEW_SCRATCH, $2, nullptr, $4, @1, Union(@1, @4),
+                         ($1 & NEW_SCRATCH) != 0);
     }
     ;
 
@@ -1194,6 +1293,8 @@ storage_class_specifier
     | TOKEN_EXTERN TOKEN_STRING_C_LITERAL  { $$ = SC_EXTERN_C; }
     | TOKEN_EXTERN TOKEN_STRING_SYCL_LITERAL  { $$ = SC_EXTERN_SYCL; }
     | TOKEN_STATIC { $$ = SC_STATIC; }
+    | TOKEN_TASK_SHARED { $$ = SC_TASK_SHARED; }
+    | TOKEN_SPECCONST { $$ = SC_SPECCONST; }
     ;
 
 type_specifier
@@ -1417,6 +1518,16 @@ specifier_qualifier_list
             }
             else if ($1 == TYPEQUAL_CONST)
                 $$ = $2->GetAsConstType();
+            else if ($1 == TYPEQUAL_RESTRICT) {
+                const PointerType *pt = CastType<PointerType>($2);
+                if (pt != nullptr)
+                    $$ = pt->GetAsRestrict();
+                else {
+                    Error(@1, "Can't apply \"restrict\" qualifier to non-pointer type \"%s\".",
+                          $2->ResolveUnboundVariability(Variability::Varying)->GetString().c_str());
+                    $$ = $2;
+                }
+            }
             else if ($1 == TYPEQUAL_SIGNED) {
                 if ($2->IsIntType() == false) {
                     Error(@1, "Can't apply \"signed\" qualifier to \"%s\" type.",
@@ -1444,6 +1555,11 @@ specifier_qualifier_list
                       "function declarations.");
                 $$ = $2;
             }
+            else if ($1 == TYPEQUAL_CONSTEXPR) {
+                Error(@1, "\"constexpr\" qualifier is illegal outside of "
+                      "function and global variable declarations.");
+                $$ = $2;
+            }
             else if ($1 == TYPEQUAL_VECTORCALL) {
                 Error(@1, "\"__vectorcall\" qualifier is illegal outside of "
                       "function declarations.");
@@ -1624,6 +1740,7 @@ enumerator
 
 type_qualifier
     : TOKEN_CONST         { $$ = TYPEQUAL_CONST; }
+    | TOKEN_CONSTEXPR     { $$ = TYPEQUAL_CONSTEXPR; }
     | TOKEN_UNIFORM       { $$ = TYPEQUAL_UNIFORM; }
     | TOKEN_VARYING       { $$ = TYPEQUAL_VARYING; }
     | TOKEN_TASK          { $$ = TYPEQUAL_TASK; }
@@ -1633,6 +1750,7 @@ type_qualifier
     | TOKEN_NOINLINE      { $$ = TYPEQUAL_NOINLINE; }
     | TOKEN_VECTORCALL    { $$ = TYPEQUAL_VECTORCALL; }
     | TOKEN_REGCALL       { $$ = TYPEQUAL_REGCALL; }
+    | TOKEN_RESTRICT      { $$ = TYPEQUAL_RESTRICT; }
     | TOKEN_SIGNED        { $$ = TYPEQUAL_SIGNED; }
     | TOKEN_UNSIGNED      { $$ = TYPEQUAL_UNSIGNED; }
     ;
@@ -2044,6 +2162,27 @@ attributed_statement
             std::pair<Globals::pragmaUnrollType, int> unrollVal = std::pair<Globals::pragmaUnrollType, int>($1->unrollType, $1->count);
             $2->SetLoopAttribute(unrollVal);
         }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmacacheblock) && ($2 != nullptr)) {
+            $2->SetCacheBlockAttribute($1->cacheLevel);
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmavectorizedim) && ($2 != nullptr)) {
+            $2->SetVectorizeDimAttribute($1->vectorizeDim);
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmafuse) && ($2 != nullptr)) {
+            $2->SetFuseAttribute($1->fuse);
+        }
+        else if (($1->aType == PragmaAttributes::AttributeType::pragmaexpect) && ($2 != nullptr)) {
+            $2->SetExpectAttribute($1->expectFlags);
+        }
+        else if ($1->aType == PragmaAttributes::AttributeType::pragmaspecialize) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc specialize'.");
+        }
+        else if ($1->aType == PragmaAttributes::AttributeType::pragmatargets) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc targets'.");
+        }
+        else if ($1->aType == PragmaAttributes::AttributeType::pragmanarrow) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc narrow'.");
+        }
         $$ = $2;
         // deallocate yylval.pragmaAttributes returned from pragma and allocated in lPragmaUnroll
         delete $1;
@@ -2062,6 +2201,7 @@ statement
     | print_statement
     | assert_statement
     | sync_statement
+    | task_group_statement
     | delete_statement
     | unmasked_statement
     | error ';'
@@ -2243,6 +2383,14 @@ foreach_unique_scope
     : TOKEN_FOREACH_UNIQUE { m->symbolTable->PushScope(); }
     ;
 
+foreach_dynamic_scope
+    : TOKEN_FOREACH_DYNAMIC { m->symbolTable->PushScope(); }
+    ;
+
+parallel_foreach_scope
+    : TOKEN_PARALLEL_FOREACH { m->symbolTable->PushScope(); }
+    ;
+
 foreach_unique_identifier
     : TOKEN_IDENTIFIER
       {
@@ -2378,6 +2526,51 @@ iteration_statement
          // allocated by strdup in foreach_unique_identifier
          free((char*)$3);
      }
+    | foreach_dynamic_scope '(' foreach_dimension_specifier ')'
+     {
+         if ($3 != nullptr)
+             m->symbolTable->AddVariable($3->sym);
+     }
+     attributed_statement
+     {
+         ForeachDimension *dim = $3;
+         if (dim == nullptr) {
+             AssertPos(@3, m->errorCount > 0);
+             $$ = nullptr;
+         } else {
+             $$ = new ForeachDynamicStmt(dim->sym, dim->beginExpr, dim->endExpr, $6, @1);
+         }
+         m->symbolTable->PopScope();
+
+         // deallocate ForeachDimension allocated in foreach_dimension_specifier
+         delete dim;
+     }
+    | parallel_foreach_scope '(' foreach_dimension_specifier ')'
+     {
+         if ($3 != nullptr)
+             m->symbolTable->AddVariable($3->sym);
+     }
+     attributed_statement
+     {
+         $$ = lCreateParallelForeach($3, nullptr, $6, @1);
+         m->symbolTable->PopScope();
+
+         // deallocate ForeachDimension allocated in foreach_dimension_specifier
+         delete $3;
+     }
+    | parallel_foreach_scope '(' foreach_dimension_specifier ';' assignment_expression ')'
+     {
+         if ($3 != nullptr)
+             m->symbolTable->AddVariable($3->sym);
+     }
+     attributed_statement
+     {
+         $$ = lCreateParallelForeach($3, $5, $8, @1);
+         m->symbolTable->PopScope();
+
+         // deallocate ForeachDimension allocated in foreach_dimension_specifier
+         delete $3;
+     }
     ;
 
 goto_identifier
@@ -2408,6 +2601,26 @@ jump_statement
 sync_statement
     : TOKEN_SYNC ';'
       { $$ = new ExprStmt(new SyncExpr(@1), @1); }
+    | TOKEN_SYNC '(' TOKEN_IDENTIFIER ')' ';'
+      {
+          Symbol *group = lLookupTaskGroup($3->c_str(), @3);
+          $$ = group ? new ExprStmt(new SyncExpr(@1, group), @1) : nullptr;
+          lCleanUpString($3);
+      }
+    ;
+
+task_group_statement
+    : TOKEN_TASK_GROUP TOKEN_IDENTIFIER ';'
+      {
+          // The handle of the group is allocated by DeclStmt::EmitCode().
+          Symbol *sym = new Symbol($2->c_str(), @2, Symbol::SymbolKind::TaskGroup,
+                                   PointerType::Void->GetAsConstType());
+          m->symbolTable->AddVariable(sym);
+          std::vector<VariableDeclaration> vars;
+          vars.push_back(VariableDeclaration(sym, nullptr));
+          $$ = new DeclStmt(vars, @1);
+          lCleanUpString($2);
+      }
     ;
 
 delete_statement
@@ -2455,7 +2668,49 @@ translation_unit
     ;
 
 external_declaration
-    : function_definition
+    : pragma
+    {
+        if ($1->aType == PragmaAttributes::AttributeType::pragmaexpect) {
+            lFunctionExpectFlags |= $1->expectFlags;
+        } else if ($1->aType == PragmaAttributes::AttributeType::pragmaspecialize) {
+            if (!$1->specializeValues.empty())
+                lFunctionSpecializations.push_back({$1->specializeParam, $1->specializeValues, @1});
+        } else if ($1->aType == PragmaAttributes::AttributeType::pragmatargets) {
+            if (!lFunctionTargets.isaNames.empty())
+                Error(@1, "Only one '#pragma ispc targets' is allowed for a function.");
+            else if (!$1->targetNames.empty())
+                lFunctionTargets = {$1->targetNames, @1};
+        } else if ($1->aType == PragmaAttributes::AttributeType::pragmanarrow) {
+            if (!lFunctionNarrowing.paramName.empty())
+                Error(@1, "Only one '#pragma ispc narrow' is allowed for a function.");
+            else if (!$1->narrowParam.empty())
+                lFunctionNarrowing = {$1->narrowParam, $1->narrowThreshold, @1};
+        } else {
+            Error(@1, "Illegal pragma - expected a loop to follow '#pragma unroll/nounroll' or '#pragma cache_block'.");
+        }
+        delete $1;
+    }
+      external_declaration
+    {
+        if (lFunctionExpectFlags != 0) {
+            Error(@1, "Illegal pragma - expected a loop or a function definition to follow "
+                      "'#pragma ispc expect_no_*' or '#pragma ispc coherent_gathers'.");
+            lFunctionExpectFlags = 0;
+        }
+        if (!lFunctionSpecializations.empty()) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc specialize'.");
+            lFunctionSpecializations.clear();
+        }
+        if (!lFunctionTargets.isaNames.empty()) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc targets'.");
+            lFunctionTargets = {};
+        }
+        if (!lFunctionNarrowing.paramName.empty()) {
+            Error(@1, "Illegal pragma - expected a function definition to follow '#pragma ispc narrow'.");
+            lFunctionNarrowing = {};
+        }
+    }
+    | function_definition
     | template_function_declaration_or_definition
     | template_function_specialization
     | template_function_instantiation
@@ -2484,6 +2739,8 @@ function_definition
         lAddMaskToSymbolTable(@2);
         if ($1->typeQualifiers & TYPEQUAL_TASK)
             lAddThreadIndexCountToSymbolTable(@2);
+        // The AST of the body is freed once the function is emitted.
+        BookKeeper::in().beginArena();
     }
     compound_statement
     {
@@ -2498,9 +2755,17 @@ function_definition
             else {
                 Stmt *code = $4;
                 if (code == nullptr) code = new StmtList(@4);
-                m->AddFunctionDefinition($2->name, funcType, code);
+                code->expectAttribute = lFunctionExpectFlags;
+                bool isConstexpr = ($1->typeQualifiers & TYPEQUAL_CONSTEXPR) != 0;
+                m->AddFunctionDefinition($2->name, funcType, code, lFunctionSpecializations, lFunctionTargets,
+                                         lFunctionNarrowing, isConstexpr);
             }
         }
+        BookKeeper::in().endArena();
+        lFunctionExpectFlags = 0;
+        lFunctionSpecializations.clear();
+        lFunctionTargets = {};
+        lFunctionNarrowing = {};
         m->symbolTable->PopScope(); // push in lAddFunctionParams();
     }
 /* function with no declared return type??
@@ -3059,8 +3324,13 @@ lAddDeclaration(DeclSpecs *ds, Declarator *decl) {
                                       isInline, isNoInline, isVectorCall, isRegCall, decl->pos);
         }
         else {
-            bool isConst = (ds->typeQualifiers & TYPEQUAL_CONST) != 0;
-            m->AddGlobalVariable(decl, isConst);
+            bool isConstexpr = (ds->typeQualifiers & TYPEQUAL_CONSTEXPR) != 0;
+            bool isSpecConst = ds->storageClass == SC_SPECCONST;
+            bool isConst = (ds->typeQualifiers & TYPEQUAL_CONST) != 0 || isConstexpr || isSpecConst;
+            // constexpr and specconst variables are implicitly const.
+            if (isConstexpr || isSpecConst)
+                decl->type = decl->type->GetAsConstType();
+            m->AddGlobalVariable(decl, isConst, isConstexpr);
         }
     }
 }
@@ -3089,10 +3359,22 @@ lCheckTemplateDeclSpecs(DeclSpecs *ds, SourcePos pos, TemplateType type, const c
         Error(pos, "'export' not supported for %s.", templateTypeStr.c_str());
         return;
     }
+    if (ds->typeQualifiers & TYPEQUAL_CONSTEXPR) {
+        Error(pos, "'constexpr' not supported for %s.", templateTypeStr.c_str());
+        return;
+    }
     if (ds->storageClass == SC_TYPEDEF) {
         Error(pos, "Illegal \"typedef\" provided with %s.", templateTypeStr.c_str());
         return;
     }
+    if (ds->storageClass == SC_TASK_SHARED) {
+        Error(pos, "Illegal \"task_shared\" provided with %s.", templateTypeStr.c_str());
+        return;
+    }
+    if (ds->storageClass == SC_SPECCONST) {
+        Error(pos, "Illegal \"specconst\" provided with %s.", templateTypeStr.c_str());
+        return;
+    }
     // We can't support extern "C"/extern "SYCL" for templates because
     // we need mangling information.
     if (ds->storageClass == SC_EXTERN_C || ds->storageClass == SC_EXTERN_SYCL) {
@@ -3283,6 +3565,319 @@ static void lAddThreadIndexCountToSymbolTable(SourcePos pos) {
 }
 
 
+/** Returns the symbol of the task group with the given name, or issues an
+    error and returns nullptr if there is no such group. */
+static Symbol *lLookupTaskGroup(const char *name, SourcePos pos) {
+    Symbol *sym = m->symbolTable->LookupVariable(name);
+    if (sym == nullptr || sym->GetSymbolKind() != Symbol::SymbolKind::TaskGroup) {
+        Error(pos, "\"%s\" is not a task group.", name);
+        return nullptr;
+    }
+    return sym;
+}
+
+
+/** Adds the tasks of "launch ... in name" to the task group name. */
+static void lSetLaunchGroup(Expr *launch, const char *name, SourcePos pos) {
+    FunctionCallExpr *fce = llvm::dyn_cast_or_null<FunctionCallExpr>(launch);
+    if (fce != nullptr) {
+        fce->launchGroup = lLookupTaskGroup(name, pos);
+    }
+}
+
+
+/** Sets the reduction of "launch ... reduce(op: target)"; \p keyword is
+    the identifier that precedes the parenthesis, which must be "reduce". */
+static void lSetLaunchReduction(Expr *launch, const char *keyword, SourcePos pos, uint64_t op, Expr *target) {
+    if (strcmp(keyword, "reduce") != 0) {
+        Error(pos, "Expected \"reduce\" clause after \"launch\", not \"%s\".", keyword);
+        return;
+    }
+    FunctionCallExpr *fce = llvm::dyn_cast_or_null<FunctionCallExpr>(launch);
+    if (fce != nullptr && target != nullptr) {
+        fce->reduceTarget = target;
+        fce->reduceOp = (TaskReductionOp)op;
+    }
+}
+
+
+// The number of "parallel_foreach" loops, for the names of their functions.
+static int lParallelForeachCount = 0;
+
+// The default minimum number of iterations of a "parallel_foreach" loop
+// that are run by a task.
+static const int32_t lParallelForeachGrain = 1024;
+
+/** The local variables and parameters of the function that is being parsed
+    that are referred to by the body of a "parallel_foreach". */
+struct ParallelForeachCaptures {
+    Symbol *loopVar;
+    std::vector<Symbol *> symbols;
+    bool valid;
+};
+
+static bool
+lCollectParallelForeachCaptures(ASTNode *node, void *data) {
+    ParallelForeachCaptures *captures = (ParallelForeachCaptures *)data;
+    Symbol *group = nullptr;
+    if (FunctionCallExpr *fce = llvm::dyn_cast<FunctionCallExpr>(node))
+        group = fce->launchGroup;
+    else if (SyncExpr *se = llvm::dyn_cast<SyncExpr>(node))
+        group = se->group;
+    if (group != nullptr && m->symbolTable->IsLocalVariable(group)) {
+        Error(node->pos, "Task group \"%s\" of the enclosing function can't be used in a "
+              "\"parallel_foreach\" loop.", group->name.c_str());
+        captures->valid = false;
+    }
+    if (llvm::isa<ReturnStmt>(node)) {
+        Error(node->pos, "\"return\" statement is illegal inside a \"parallel_foreach\" loop.");
+        captures->valid = false;
+    }
+
+    SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node);
+    Symbol *sym = se ? se->GetBaseSymbol() : nullptr;
+    if (sym == nullptr || sym == captures->loopVar || sym->constValue != nullptr ||
+        !m->symbolTable->IsLocalVariable(sym) ||
+        std::find(captures->symbols.begin(), captures->symbols.end(), sym) != captures->symbols.end())
+        return true;
+    if (sym->type == nullptr || sym->type->IsDependentType()) {
+        Error(se->pos, "\"parallel_foreach\" loops in function templates can't refer to the variable "
+              "\"%s\" of the template.", sym->name.c_str());
+        captures->valid = false;
+        return true;
+    }
+    captures->symbols.push_back(sym);
+    return true;
+}
+
+
+/** Adds the static function "name(captures..., uniform int32 begin,
+    uniform int32 end)" of the given body, with a parameter symbol that
+    replaces each of the captured variables in \p templInst, and returns
+    its symbol. */
+static Symbol *
+lAddParallelForeachFunction(const std::string &name, bool isTask, const llvm::SmallVector<const Type *, 8> &paramTypes,
+                            const std::vector<Symbol *> &captures, TemplateInstantiation *templInst,
+                            std::vector<Symbol *> *params, SourcePos pos) {
+    llvm::SmallVector<std::string, 8> names;
+    llvm::SmallVector<Expr *, 8> defaults;
+    llvm::SmallVector<SourcePos, 8> positions;
+    for (unsigned int i = 0; i < paramTypes.size(); ++i) {
+        // The captures keep their names for the debugger, except in the
+        // task, where they could clash with taskIndex and the others.
+        if (i < captures.size())
+            names.push_back(isTask ? "__parallel_foreach_arg" + std::to_string(i) : captures[i]->name);
+        else
+            names.push_back(i == captures.size() ? "__parallel_foreach_begin" : "__parallel_foreach_end");
+        defaults.push_back(nullptr);
+        positions.push_back(pos);
+    }
+    const FunctionType *type = new FunctionType(AtomicType::Void, paramTypes, names, defaults, positions, isTask,
+                                                false, false, false, false, false, false, false, false, false, pos);
+    m->AddFunctionDeclaration(name, type, SC_STATIC, new Declarator(DK_FUNCTION, pos), false, false, false, false,
+                              pos);
+
+    m->symbolTable->PushScope();
+    for (unsigned int i = 0; i < paramTypes.size(); ++i) {
+        Symbol *param = new Symbol(names[i], pos, Symbol::SymbolKind::FunctionParm, paramTypes[i]);
+        m->symbolTable->AddVariable(param);
+        if (templInst != nullptr && i < captures.size())
+            templInst->MapSymbol(captures[i], param);
+        params->push_back(param);
+    }
+    lAddMaskToSymbolTable(pos);
+    if (isTask)
+        lAddThreadIndexCountToSymbolTable(pos);
+    Symbol *sym = m->symbolTable->LookupFunction(name.c_str(), type);
+    AssertPos(pos, sym != nullptr);
+    return sym;
+}
+
+
+static ExprList *
+lParallelForeachArgs(const std::vector<Symbol *> &symbols, Expr *begin, Expr *end, SourcePos pos) {
+    ExprList *args = new ExprList(pos);
+    for (Symbol *sym : symbols)
+        args->exprs.push_back(new SymbolExpr(sym, pos));
+    args->exprs.push_back(begin);
+    args->exprs.push_back(end);
+    return args;
+}
+
+
+/** Creates the code of "parallel_foreach (i = begin ... end; grain) body".
+    The body is outlined into a static function that runs a "foreach" over
+    the given range, with the variables of the enclosing function that it
+    refers to passed by reference.  A task calls it for each of the chunks
+    of the range, and the loop itself launches a task for every "grain"
+    iterations, but not more than four per core, or calls the function
+    directly if there is a single chunk. */
+static Stmt *
+lCreateParallelForeach(ForeachDimension *dim, Expr *grainExpr, Stmt *body, SourcePos pos) {
+    if (dim == nullptr || dim->sym == nullptr || dim->beginExpr == nullptr || dim->endExpr == nullptr ||
+        body == nullptr) {
+        AssertPos(pos, m->errorCount > 0);
+        return nullptr;
+    }
+    if (g->target->isXeTarget()) {
+        Error(pos, "\"parallel_foreach\" loops are not supported for Xe targets.");
+        return nullptr;
+    }
+
+    ParallelForeachCaptures captures;
+    captures.loopVar = dim->sym;
+    captures.valid = true;
+    WalkAST(body, lCollectParallelForeachCaptures, nullptr, &captures);
+    if (!captures.valid)
+        return nullptr;
+
+    // The captures are passed by reference, arrays as a pointer to their
+    // first element.
+    llvm::SmallVector<const Type *, 8> paramTypes;
+    for (Symbol *sym : captures.symbols) {
+        if (const ArrayType *at = CastType<ArrayType>(sym->type))
+            paramTypes.push_back(PointerType::GetUniform(at->GetElementType()));
+        else if (CastType<ReferenceType>(sym->type) != nullptr)
+            paramTypes.push_back(sym->type);
+        else
+            paramTypes.push_back(new ReferenceType(sym->type));
+    }
+    paramTypes.push_back(AtomicType::UniformInt32);
+    paramTypes.push_back(AtomicType::UniformInt32);
+
+    std::string name = "__parallel_foreach_" + std::to_string(lParallelForeachCount++);
+    std::string taskName = name + "_task";
+
+    // Both functions are defined at the global scope.
+    m->symbolTable->SuspendInnerScopes();
+
+    // static void name(captures..., uniform int begin, uniform int end) {
+    //     foreach (i = begin ... end) body
+    // }
+    TemplateInstantiation templInst(TemplateParms(), TemplateArgs(), false, false);
+    std::vector<Symbol *> params;
+    Symbol *funcSym = lAddParallelForeachFunction(name, false, paramTypes, captures.symbols, &templInst, &params, pos);
+    std::vector<Symbol *> loopVars = {templInst.InstantiateSymbol(dim->sym)};
+    std::vector<Expr *> starts = {new SymbolExpr(params[params.size() - 2], pos)};
+    std::vector<Expr *> ends = {new SymbolExpr(params.back(), pos)};
+    Stmt *loop = new ForeachStmt(loopVars, starts, ends, body->Instantiate(templInst), false, pos);
+    m->AddFunctionDefinition(name, CastType<FunctionType>(funcSym->type), loop);
+    m->symbolTable->PopScope();
+
+    // task void name_task(captures..., uniform int begin, uniform int end) {
+    //     uniform int64 n = end - begin;
+    //     name(captures..., begin + n * taskIndex / taskCount, begin + n * (taskIndex + 1) / taskCount);
+    // }
+    std::vector<Symbol *> taskParams;
+    Symbol *taskSym = lAddParallelForeachFunction(taskName, true, paramTypes, captures.symbols, nullptr, &taskParams,
+                                                  pos);
+    Symbol *taskBegin = taskParams[taskParams.size() - 2];
+    Symbol *taskIndex = m->symbolTable->LookupVariable("taskIndex");
+    Symbol *taskCount = m->symbolTable->LookupVariable("taskCount");
+    auto chunkBound = [&](Expr *index) -> Expr * {
+        Expr *n = new BinaryExpr(BinaryExpr::Sub, new SymbolExpr(taskParams.back(), pos),
+                                 new SymbolExpr(taskBegin, pos), pos);
+        n = new TypeCastExpr(AtomicType::UniformInt64, n, pos);
+        Expr *offset = new BinaryExpr(BinaryExpr::Div, new BinaryExpr(BinaryExpr::Mul, n, index, pos),
+                                      new SymbolExpr(taskCount, pos), pos);
+        return new BinaryExpr(BinaryExpr::Add, new SymbolExpr(taskBegin, pos),
+                              new TypeCastExpr(AtomicType::UniformInt32, offset, pos), pos);
+    };
+    std::vector<Symbol *> taskArgs(taskParams.begin(), taskParams.end() - 2);
+    Expr *nextTaskIndex = new BinaryExpr(BinaryExpr::Add, new SymbolExpr(taskIndex, pos),
+                                         new ConstExpr(AtomicType::UniformUInt32, (uint32_t)1, pos), pos);
+    ExprList *chunkArgs =
+        lParallelForeachArgs(taskArgs, chunkBound(new SymbolExpr(taskIndex, pos)), chunkBound(nextTaskIndex), pos);
+    std::vector<Symbol *> funcs = {funcSym};
+    Expr *chunkCall = new FunctionCallExpr(new FunctionSymbolExpr(name.c_str(), funcs, pos), chunkArgs, pos);
+    m->AddFunctionDefinition(taskName, CastType<FunctionType>(taskSym->type), new ExprStmt(chunkCall, pos));
+    m->symbolTable->PopScope();
+
+    m->symbolTable->ResumeInnerScopes();
+
+    // {
+    //     uniform int begin = ..., end = ..., grain = ...;
+    //     uniform int chunks = (end - begin + max(grain, 1) - 1) / max(grain, 1);
+    //     uniform int tasks = min(chunks, 4 * __num_cores());
+    //     if (tasks <= 1)
+    //         name(captures..., begin, end);
+    //     else {
+    //         task_group group;
+    //         launch[tasks] name_task(captures..., begin, end) in group;
+    //         sync(group);
+    //     }
+    // }
+    const Type *intType = AtomicType::UniformInt32;
+    auto intVar = [&](const char *varName) {
+        return new Symbol(varName, pos, Symbol::SymbolKind::Variable, intType);
+    };
+    auto intConst = [&](int32_t value) { return new ConstExpr(intType, value, pos); };
+    auto use = [&](Symbol *sym) { return new SymbolExpr(sym, pos); };
+    Symbol *beginSym = intVar("__parallel_foreach_begin");
+    Symbol *endSym = intVar("__parallel_foreach_end");
+    Symbol *grainSym = intVar("__parallel_foreach_grain");
+    Symbol *chunkSym = intVar("__parallel_foreach_chunk");
+    Symbol *chunksSym = intVar("__parallel_foreach_chunks");
+    Symbol *tasksSym = intVar("__parallel_foreach_tasks");
+    Symbol *groupSym = new Symbol("__parallel_foreach_group", pos, Symbol::SymbolKind::TaskGroup,
+                                  PointerType::Void->GetAsConstType());
+
+    std::vector<VariableDeclaration> bounds;
+    bounds.push_back(VariableDeclaration(beginSym, dim->beginExpr));
+    bounds.push_back(VariableDeclaration(endSym, dim->endExpr));
+    bounds.push_back(VariableDeclaration(grainSym, grainExpr ? grainExpr : intConst(lParallelForeachGrain)));
+
+    Expr *chunk = new SelectExpr(new BinaryExpr(BinaryExpr::Lt, use(grainSym), intConst(1), pos), intConst(1),
+                                 use(grainSym), pos);
+    std::vector<VariableDeclaration> chunkDecl = {VariableDeclaration(chunkSym, chunk)};
+
+    Expr *chunks = new BinaryExpr(BinaryExpr::Sub, use(endSym), use(beginSym), pos);
+    chunks = new BinaryExpr(BinaryExpr::Add, chunks, new BinaryExpr(BinaryExpr::Sub, use(chunkSym), intConst(1), pos),
+                            pos);
+    chunks = new BinaryExpr(BinaryExpr::Div, chunks, use(chunkSym), pos);
+    std::vector<VariableDeclaration> chunksDecl = {VariableDeclaration(chunksSym, chunks)};
+
+    Expr *tasks = use(chunksSym);
+    std::vector<Symbol *> numCores;
+    if (m->symbolTable->LookupFunction("__num_cores", &numCores)) {
+        auto maxTasks = [&]() -> Expr * {
+            Expr *cores = new FunctionCallExpr(new FunctionSymbolExpr("__num_cores", numCores, pos),
+                                               new ExprList(pos), pos);
+            return new BinaryExpr(BinaryExpr::Mul, intConst(4), cores, pos);
+        };
+        // __num_cores() is called twice, but it's cheap and this avoids
+        // another variable.
+        tasks = new SelectExpr(new BinaryExpr(BinaryExpr::Lt, use(chunksSym), maxTasks(), pos), use(chunksSym),
+                               maxTasks(), pos);
+    }
+    std::vector<VariableDeclaration> tasksDecl = {VariableDeclaration(tasksSym, tasks)};
+    std::vector<VariableDeclaration> groupDecl = {VariableDeclaration(groupSym, nullptr)};
+
+    ExprList *args = lParallelForeachArgs(captures.symbols, use(beginSym), use(endSym), pos);
+    Expr *serialCall = new FunctionCallExpr(new FunctionSymbolExpr(name.c_str(), funcs, pos), args, pos);
+
+    std::vector<Symbol *> taskFuncs = {taskSym};
+    Expr *launchCount[3] = {use(tasksSym), intConst(1), intConst(1)};
+    args = lParallelForeachArgs(captures.symbols, use(beginSym), use(endSym), pos);
+    FunctionCallExpr *launch = new FunctionCallExpr(new FunctionSymbolExpr(taskName.c_str(), taskFuncs, pos), args,
+                                                    pos, true, launchCount);
+    launch->launchGroup = groupSym;
+    StmtList *parallel = new StmtList(pos);
+    parallel->Add(new DeclStmt(groupDecl, pos));
+    parallel->Add(new ExprStmt(launch, pos));
+    parallel->Add(new ExprStmt(new SyncExpr(pos, groupSym), pos));
+
+    StmtList *code = new StmtList(pos);
+    code->Add(new DeclStmt(bounds, pos));
+    code->Add(new DeclStmt(chunkDecl, pos));
+    code->Add(new DeclStmt(chunksDecl, pos));
+    code->Add(new DeclStmt(tasksDecl, pos));
+    Expr *serial = new BinaryExpr(BinaryExpr::Le, use(tasksSym), intConst(1), pos);
+    code->Add(new IfStmt(serial, new ExprStmt(serialCall, pos), parallel, false, pos));
+    return code;
+}
+
+
 /** Small utility routine to construct a string for error messages that
     suggests alternate tokens for possibly-misspelled ones... */
 static std::string lGetAlternates(std::vector<std::string> &alternates) {
@@ -3313,6 +3908,10 @@ lGetStorageClassString(StorageClass sc) {
         return "extern \"C\"";
     case SC_EXTERN_SYCL:
         return "extern \"SYCL\"";
+    case SC_TASK_SHARED:
+        return "task_shared";
+    case SC_SPECCONST:
+        return "specconst";
     default:
         Assert(!"logic error in lGetStorageClassString()");
         return "";
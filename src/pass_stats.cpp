@@ -0,0 +1,179 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file pass_stats.cpp
+    @brief Implementation of PassStatistics.
+*/
+
+#include "pass_stats.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <llvm/Analysis/LazyCallGraph.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/JSON.h>
+
+using namespace ispc;
+
+static bool s_enabled = false;
+
+// Count the instructions of the function; gathers, scatters and masked
+// memory operations are recognized by the names of the functions
+// implementing them: ispc pseudo and target builtins, and LLVM intrinsics.
+static void lCount(const llvm::Function &F, PassStatistics::Counts &counts) {
+    for (const llvm::BasicBlock &BB : F) {
+        for (const llvm::Instruction &I : BB) {
+            counts.instructions++;
+            const llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&I);
+            if (call == nullptr || call->getCalledFunction() == nullptr) {
+                continue;
+            }
+            llvm::StringRef name = call->getCalledFunction()->getName();
+            if (name.contains("gather")) {
+                counts.gathers++;
+            } else if (name.contains("scatter")) {
+                counts.scatters++;
+            } else if (name.contains("masked_load") || name.contains("masked.load") ||
+                       name.contains("masked.expandload")) {
+                counts.maskedLoads++;
+            } else if (name.contains("masked_store") || name.contains("masked.store") ||
+                       name.contains("masked.compressstore")) {
+                counts.maskedStores++;
+            }
+        }
+    }
+}
+
+static PassStatistics::Counts lCount(const llvm::Any &IR) {
+    PassStatistics::Counts counts;
+    if (const llvm::Module *const *M = llvm::any_cast<const llvm::Module *>(&IR)) {
+        for (const llvm::Function &F : **M) {
+            lCount(F, counts);
+        }
+    } else if (const llvm::Function *const *F = llvm::any_cast<const llvm::Function *>(&IR)) {
+        lCount(**F, counts);
+    } else if (const llvm::Loop *const *L = llvm::any_cast<const llvm::Loop *>(&IR)) {
+        lCount(*(*L)->getHeader()->getParent(), counts);
+    } else if (const llvm::LazyCallGraph::SCC *const *C = llvm::any_cast<const llvm::LazyCallGraph::SCC *>(&IR)) {
+        for (const llvm::LazyCallGraph::Node &N : **C) {
+            lCount(N.getFunction(), counts);
+        }
+    }
+    return counts;
+}
+
+PassStatistics &PassStatistics::in() {
+    static PassStatistics instance;
+    return instance;
+}
+
+void PassStatistics::Enable() { s_enabled = true; }
+
+bool PassStatistics::IsEnabled() { return s_enabled; }
+
+void PassStatistics::Begin(llvm::StringRef pass, llvm::Any IR) {
+    if (!m_scopes.empty()) {
+        m_scopes.back().hasChildren = true;
+    }
+    Counts before = lCount(IR);
+    m_scopes.push_back({pass.str(), before, false, std::chrono::steady_clock::now()});
+}
+
+void PassStatistics::End(const llvm::Any *IR) {
+    Assert(!m_scopes.empty());
+    const Scope &scope = m_scopes.back();
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scope.start).count();
+    if (scope.hasChildren) {
+        // A pass manager or an adaptor, its passes are reported.
+        m_scopes.pop_back();
+        return;
+    }
+
+    Counts delta;
+    if (IR != nullptr) {
+        Counts after = lCount(*IR);
+        delta.instructions = after.instructions - scope.before.instructions;
+        delta.gathers = after.gathers - scope.before.gathers;
+        delta.scatters = after.scatters - scope.before.scatters;
+        delta.maskedLoads = after.maskedLoads - scope.before.maskedLoads;
+        delta.maskedStores = after.maskedStores - scope.before.maskedStores;
+    }
+    bool changed = delta.instructions != 0 || delta.gathers != 0 || delta.scatters != 0 || delta.maskedLoads != 0 ||
+                   delta.maskedStores != 0;
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry &e) { return e.pass == scope.pass; });
+    if (it == m_entries.end()) {
+        m_entries.push_back({scope.pass, 0, 0, 0.0, Counts()});
+        it = m_entries.end() - 1;
+    }
+    it->runs++;
+    it->changed += changed ? 1 : 0;
+    it->wallMs += wallMs;
+    it->delta.instructions += delta.instructions;
+    it->delta.gathers += delta.gathers;
+    it->delta.scatters += delta.scatters;
+    it->delta.maskedLoads += delta.maskedLoads;
+    it->delta.maskedStores += delta.maskedStores;
+    m_scopes.pop_back();
+}
+
+void PassStatistics::Print(llvm::raw_ostream &os) const {
+    double totalMs = 0;
+    for (const Entry &entry : m_entries) {
+        totalMs += entry.wallMs;
+    }
+    os << llvm::left_justify("Pass", 40) << llvm::right_justify("Runs", 7) << llvm::right_justify("Changed", 8)
+       << llvm::right_justify("Time, ms", 11) << llvm::right_justify("%", 7);
+    for (const char *name : {"Instrs", "Gathers", "Scatters", "MLoads", "MStores"}) {
+        os << llvm::right_justify(name, 9);
+    }
+    os << "\n";
+    for (const Entry &entry : m_entries) {
+        os << llvm::format("%-40s %6u %7u %10.3f %5.1f%% %+8lld %+8lld %+8lld %+8lld %+8lld\n", entry.pass.c_str(),
+                           entry.runs, entry.changed, entry.wallMs, totalMs > 0 ? entry.wallMs * 100 / totalMs : 0.0,
+                           (long long)entry.delta.instructions, (long long)entry.delta.gathers,
+                           (long long)entry.delta.scatters, (long long)entry.delta.maskedLoads,
+                           (long long)entry.delta.maskedStores);
+    }
+    os << llvm::left_justify("Total", 55) << llvm::format(" %10.3f\n", totalMs);
+}
+
+bool PassStatistics::Write(const std::string &fileName) const {
+    std::error_code EC;
+    llvm::raw_fd_ostream os(fileName, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        Error(SourcePos(), "Cannot open pass statistics file \"%s\": %s", fileName.c_str(), EC.message().c_str());
+        return false;
+    }
+
+    llvm::json::OStream J(os, 2);
+    J.object([&] {
+        J.attribute("version", 1);
+        J.attributeArray("passes", [&] {
+            for (const Entry &entry : m_entries) {
+                J.object([&] {
+                    J.attribute("pass", entry.pass);
+                    J.attribute("runs", static_cast<int64_t>(entry.runs));
+                    J.attribute("changed", static_cast<int64_t>(entry.changed));
+                    J.attribute("wall_ms", entry.wallMs);
+                    J.attribute("instructions", entry.delta.instructions);
+                    J.attribute("gathers", entry.delta.gathers);
+                    J.attribute("scatters", entry.delta.scatters);
+                    J.attribute("masked_loads", entry.delta.maskedLoads);
+                    J.attribute("masked_stores", entry.delta.maskedStores);
+                });
+            }
+        });
+    });
+    os << "\n";
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file pass_stats.h
+    @brief Declaration of PassStatistics, which collects the time and the
+           changes of the IR of every optimization pass.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/Any.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace ispc {
+
+/** @brief Per pass statistics of the optimization pipeline, used by
+    "ispc-opt --stats".
+
+    Every executed pass is timed and the instructions of the IR unit it
+    ran on (module, SCC, function or loop's function) are counted before
+    and after it.  The executions of the same pass are accumulated.  Only
+    the innermost passes are reported, the pass managers and adaptors,
+    which run other passes, are skipped.
+ */
+class PassStatistics {
+  public:
+    static PassStatistics &in();
+
+    static void Enable();
+    static bool IsEnabled();
+
+    /** Instruction counts of an IR unit. */
+    struct Counts {
+        int64_t instructions{0};
+        int64_t gathers{0};
+        int64_t scatters{0};
+        int64_t maskedLoads{0};
+        int64_t maskedStores{0};
+    };
+
+    /** Start the pass on the IR unit. */
+    void Begin(llvm::StringRef pass, llvm::Any IR);
+    /** Finish the innermost pass, IR is empty if the unit was invalidated. */
+    void End(const llvm::Any *IR);
+
+    /** Print the table of the passes in the order of their first execution. */
+    void Print(llvm::raw_ostream &os) const;
+    /** Write the statistics to the file in JSON format. */
+    bool Write(const std::string &fileName) const;
+
+  private:
+    struct Scope {
+        std::string pass;
+        Counts before;
+        bool hasChildren;
+        std::chrono::steady_clock::time_point start;
+    };
+    struct Entry {
+        std::string pass;
+        unsigned runs;
+        unsigned changed;
+        double wallMs;
+        Counts delta;
+    };
+
+    std::vector<Scope> m_scopes;
+    std::vector<Entry> m_entries;
+};
+
+} // namespace ispc
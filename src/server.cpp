@@ -0,0 +1,318 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file server.cpp
+    @brief Implementation of the compilation server (--server) and of its
+           client (ISPC_SERVER environment variable).
+
+    The protocol is trivial.  The client sends its standard streams
+    (stdin, stdout and stderr) as SCM_RIGHTS ancillary data, followed by
+    the size of the request and the request itself: the current working
+    directory and the command line arguments, each terminated with '\0'.
+    The server replies with the exit code of the job as a 32-bit integer.
+*/
+
+#include "server.h"
+#include "ispc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#ifndef ISPC_HOST_IS_WINDOWS
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // !ISPC_HOST_IS_WINDOWS
+
+using namespace ispc;
+
+#ifndef ISPC_HOST_IS_WINDOWS
+
+static const int lNumStreams = 3;
+
+static bool lWriteAll(int fd, const void *data, size_t size) {
+    const char *ptr = (const char *)data;
+    while (size > 0) {
+        ssize_t n = write(fd, ptr, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool lReadAll(int fd, void *data, size_t size) {
+    char *ptr = (char *)data;
+    while (size > 0) {
+        ssize_t n = read(fd, ptr, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool lGetSocketAddress(const char *socketPath, struct sockaddr_un &addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ispc: socket path \"%s\" is too long.\n", socketPath);
+        return false;
+    }
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+static bool lSendStreams(int sock) {
+    int fds[lNumStreams] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    // At least one byte of regular data is needed to carry ancillary data.
+    char dummy = 0;
+    struct iovec iov = {&dummy, 1};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(sock, &msg, 0) == 1;
+}
+
+static bool lReceiveStreams(int sock, int fds[lNumStreams]) {
+    char control[CMSG_SPACE(sizeof(int) * lNumStreams)];
+    memset(control, 0, sizeof(control));
+
+    char dummy = 0;
+    struct iovec iov = {&dummy, 1};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(sock, &msg, 0) != 1) {
+        return false;
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int) * lNumStreams)) {
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * lNumStreams);
+    return true;
+}
+
+// Serve a single client: receive the job, run it in a separate process and
+// send back its exit code.
+static int lHandleConnection(int conn, CompileFunc compile) {
+    int fds[lNumStreams];
+    if (!lReceiveStreams(conn, fds)) {
+        return 1;
+    }
+
+    uint32_t size = 0;
+    std::string request;
+    if (lReadAll(conn, &size, sizeof(size))) {
+        request.resize(size);
+        if (!lReadAll(conn, &request[0], size)) {
+            request.clear();
+        }
+    }
+    if (request.empty() || request.back() != '\0') {
+        return 1;
+    }
+
+    std::vector<std::string> strings;
+    for (size_t pos = 0; pos < request.size();) {
+        strings.push_back(request.c_str() + pos);
+        pos += strings.back().size() + 1;
+    }
+    // The first string is the working directory, the rest is the command line.
+    if (strings.size() < 2) {
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(conn);
+        signal(SIGPIPE, SIG_DFL);
+        for (int i = 0; i < lNumStreams; ++i) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+        if (chdir(strings[0].c_str()) != 0) {
+            perror(strings[0].c_str());
+            _exit(1);
+        }
+        // The arguments are allocated with strdup as the compilation frees
+        // them at the end.
+        std::vector<char *> argv;
+        for (size_t i = 1; i < strings.size(); ++i) {
+            argv.push_back(strdup(strings[i].c_str()));
+        }
+        int ret = compile(argv);
+        exit(ret);
+    }
+
+    for (int i = 0; i < lNumStreams; ++i) {
+        close(fds[i]);
+    }
+
+    int32_t exitCode = 1;
+    if (pid < 0) {
+        perror("fork");
+    } else {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        if (WIFEXITED(status)) {
+            exitCode = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            // Mimic the exit code that the shell reports for the crashed job.
+            exitCode = 128 + WTERMSIG(status);
+        }
+    }
+    lWriteAll(conn, &exitCode, sizeof(exitCode));
+    close(conn);
+    return 0;
+}
+
+int ispc::RunCompileServer(const char *socketPath, CompileFunc compile) {
+    // Warm up the state, which is inherited by the jobs.
+    TargetLibRegistry::getTargetLibRegistry();
+
+    struct sockaddr_un addr;
+    if (!lGetSocketAddress(socketPath, addr)) {
+        return 1;
+    }
+
+    // Remove the socket left by the previous server, but nothing else.
+    struct stat st;
+    if (lstat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socketPath);
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, SOMAXCONN) != 0) {
+        perror(socketPath);
+        close(sock);
+        return 1;
+    }
+
+    // Connection handlers are reaped automatically.
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "ispc: compilation server is listening on %s\n", socketPath);
+
+    for (;;) {
+        int conn = accept(sock, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(sock);
+            // The handler waits for the job itself.
+            signal(SIGCHLD, SIG_DFL);
+            _exit(lHandleConnection(conn, compile));
+        }
+        if (pid < 0) {
+            perror("fork");
+        }
+        close(conn);
+    }
+
+    close(sock);
+    return 1;
+}
+
+bool ispc::CompileOnServer(const char *socketPath, const std::vector<char *> &argv, int &exitCode) {
+    struct sockaddr_un addr;
+    if (!lGetSocketAddress(socketPath, addr)) {
+        return false;
+    }
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+        return false;
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return false;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        // No server, compile locally.
+        close(sock);
+        return false;
+    }
+
+    std::string request(cwd);
+    request.push_back('\0');
+    for (const char *arg : argv) {
+        request.append(arg);
+        request.push_back('\0');
+    }
+    uint32_t size = request.size();
+
+    // Once the request is sent, the job may have started already, so it
+    // is not possible to fall back to the local compilation anymore.
+    int32_t result = 1;
+    signal(SIGPIPE, SIG_IGN);
+    if (!lSendStreams(sock) || !lWriteAll(sock, &size, sizeof(size)) || !lWriteAll(sock, request.data(), size) ||
+        !lReadAll(sock, &result, sizeof(result))) {
+        fprintf(stderr, "ispc: lost connection to compilation server %s\n", socketPath);
+        result = 1;
+    }
+    close(sock);
+    exitCode = result;
+    return true;
+}
+
+#else // ISPC_HOST_IS_WINDOWS
+
+int ispc::RunCompileServer(const char *socketPath, CompileFunc compile) {
+    fprintf(stderr, "ispc: compilation server is not supported on Windows host.\n");
+    return 1;
+}
+
+bool ispc::CompileOnServer(const char *socketPath, const std::vector<char *> &argv, int &exitCode) { return false; }
+
+#endif // ISPC_HOST_IS_WINDOWS
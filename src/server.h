@@ -0,0 +1,36 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file server.h
+    @brief Compilation server: a long-lived ispc process, which runs
+           compilation jobs sent over a local socket.
+*/
+
+#pragma once
+
+#include <vector>
+
+namespace ispc {
+
+/** The function, which runs a single compilation with the given
+    command line and returns the exit code of ispc. */
+typedef int (*CompileFunc)(std::vector<char *> &argv);
+
+/** Run the compilation server listening on the Unix domain socket
+    \p socketPath.  The server is started after LLVM targets and the target
+    library registry are initialized, and every job is run by \p compile in
+    a process forked from the server, so this start-up work is done only
+    once.  The client's working directory and standard streams are used by
+    the job.  The function returns only on error. */
+int RunCompileServer(const char *socketPath, CompileFunc compile);
+
+/** Send the compilation with the command line \p argv to the server
+    listening on \p socketPath.  Returns false if the server is not
+    reachable, otherwise the exit code of the job is stored to
+    \p exitCode. */
+bool CompileOnServer(const char *socketPath, const std::vector<char *> &argv, int &exitCode);
+
+} // namespace ispc
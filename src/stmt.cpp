@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <iterator>
 #include <map>
+#include <set>
 #include <sstream>
 #include <stdio.h>
 
@@ -30,6 +31,7 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
@@ -48,6 +50,36 @@ void Stmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAttr) {
     Error(pos, "Illegal pragma - expected a loop to follow '#pragma unroll/nounroll'.");
 }
 
+void Stmt::SetCacheBlockAttribute(int cacheLevel) {
+    Error(pos, "Illegal pragma - expected a \"foreach_tiled\" loop to follow '#pragma cache_block'.");
+}
+
+void Stmt::SetVectorizeDimAttribute(const std::string &dimName) {
+    Error(pos, "Illegal pragma - expected a \"foreach\" loop to follow '#pragma vectorize_dim'.");
+}
+
+void Stmt::SetFuseAttribute(bool fuse) {
+    Error(pos, "Illegal pragma - expected a \"foreach\" loop to follow '#pragma fuse/nofuse'.");
+}
+
+void Stmt::SetExpectAttribute(unsigned int flags) {
+    Error(pos, "Illegal pragma - expected a loop or a function definition to follow '#pragma ispc expect_no_*' or "
+               "'#pragma ispc coherent_gathers'.");
+}
+
+namespace {
+/** Marks the calls that are emitted while it is in scope with the
+    '#pragma ispc expect_no_*' flags of a loop. */
+class ExpectationsScope {
+  public:
+    ExpectationsScope(FunctionEmitContext *ctx, unsigned int flags) : ctx(ctx) { ctx->PushExpectations(flags); }
+    ~ExpectationsScope() { ctx->PopExpectations(); }
+
+  private:
+    FunctionEmitContext *ctx;
+};
+} // namespace
+
 ///////////////////////////////////////////////////////////////////////////
 // ExprStmt
 
@@ -126,6 +158,13 @@ void DeclStmt::EmitCode(FunctionEmitContext *ctx) const {
 
         ctx->SetDebugPos(sym->pos);
 
+        // Named task groups only need the handle for ISPCLaunch() and
+        // ISPCSync().
+        if (sym->GetSymbolKind() == Symbol::SymbolKind::TaskGroup) {
+            sym->storageInfo = ctx->AddTaskGroup(sym->name.c_str());
+            continue;
+        }
+
         // If it's an array that was declared without a size but has an
         // initializer list, then use the number of elements in the
         // initializer list to finally set the array's size.
@@ -174,6 +213,53 @@ void DeclStmt::EmitCode(FunctionEmitContext *ctx) const {
             return;
         }
 
+        if (sym->storageClass == SC_SPECCONST) {
+            Error(sym->pos, "\"specconst\" variable \"%s\" must be declared at global scope.", sym->name.c_str());
+            continue;
+        }
+
+        if (sym->storageClass == SC_TASK_SHARED) {
+            const Function *func = ctx->GetFunction();
+            if (func == nullptr || func->GetType()->isTask == false) {
+                Error(sym->pos, "\"task_shared\" variable \"%s\" must be declared inside a task function.",
+                      sym->name.c_str());
+                continue;
+            }
+            if (sym->type->IsUniformType() == false) {
+                Error(sym->pos, "\"task_shared\" variable \"%s\" must have a uniform type.", sym->name.c_str());
+                continue;
+            }
+            if (initExpr != nullptr) {
+                Error(initExpr->pos, "\"task_shared\" variable \"%s\" can't have an initializer.",
+                      sym->name.c_str());
+                continue;
+            }
+
+            if (g->target->isXeTarget()) {
+                // On Xe, the variable lives in the shared local memory of
+                // the workgroup. It is accessed through a pointer in the
+                // default address space like the rest of the memory; the
+                // Xe lowering moves the accesses back to the local address
+                // space.
+                llvm::GlobalVariable *gv = new llvm::GlobalVariable(
+                    *m->module, llvmType, false, llvm::GlobalValue::InternalLinkage,
+                    llvm::UndefValue::get(llvmType),
+                    llvm::Twine("task_shared.") + llvm::Twine(sym->pos.first_line) + llvm::Twine(".") +
+                        sym->name.c_str(),
+                    nullptr, llvm::GlobalVariable::NotThreadLocal, (unsigned)AddressSpace::ispc_local);
+                gv->setAlignment(llvm::Align(g->target->getNativeVectorAlignment()));
+                llvm::Constant *ptr = llvm::ConstantExpr::getAddrSpaceCast(
+                    gv, llvm::PointerType::get(llvmType, (unsigned)AddressSpace::ispc_default));
+                sym->storageInfo = new AddressInfo(ptr, llvmType);
+            } else {
+                // On CPU targets, every task runs as a group of its own,
+                // so the storage of the task is all that it shares.
+                sym->storageInfo = ctx->AllocaInst(sym->type, sym->name.c_str());
+            }
+            ctx->EmitVariableDebugInfo(sym);
+            continue;
+        }
+
         if (sym->storageClass == SC_STATIC) {
             // For static variables, we need a compile-time constant value
             // for its initializer; if there's no initializer, we use a
@@ -530,7 +616,7 @@ IfStmt *IfStmt::Instantiate(TemplateInstantiation &templInst) const {
 }
 
 void IfStmt::Print(Indent &indent) const {
-    indent.PrintLn(doAllCheck ? "IfStmt DO ALL CHECK" : "IfStmt", pos);
+    indent.PrintLn((doAllCheck || inferredCoherent) ? "IfStmt DO ALL CHECK" : "IfStmt", pos);
 
     int totalChildren = 1 + (trueStmts ? 1 : 0) + (falseStmts ? 1 : 0);
     indent.pushList(totalChildren);
@@ -549,6 +635,20 @@ void IfStmt::Print(Indent &indent) const {
     indent.Done();
 }
 
+/** With --opt-report or --opt-report-file, record the statement at the
+    given position in the named metadata \p mdName of the module, so that
+    OptReportPass reports it. */
+static void lRecordOptReportStmt(FunctionEmitContext *ctx, const char *mdName, SourcePos pos) {
+    if (!g->optReport && g->optReportFile.empty()) {
+        return;
+    }
+    llvm::Metadata *md[] = {llvm::MDString::get(*g->ctx, pos.name),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.first_line)),
+                            llvm::ConstantAsMetadata::get(LLVMInt32(pos.first_column)),
+                            llvm::MDString::get(*g->ctx, ctx->GetCurrentBasicBlock()->getParent()->getName())};
+    m->module->getOrInsertNamedMetadata(mdName)->addOperand(llvm::MDNode::get(*g->ctx, md));
+}
+
 /** Emit code to run both the true and false statements for the if test,
     with the mask set appropriately before running each one.
 */
@@ -572,7 +672,11 @@ void IfStmt::emitMaskedTrueAndFalse(FunctionEmitContext *ctx, llvm::Value *oldMa
  */
 void IfStmt::emitVaryingIf(FunctionEmitContext *ctx, llvm::Value *ltest) const {
     llvm::Value *oldMask = ctx->GetInternalMask();
-    if (doAllCheck) {
+    if (inferredCoherent && !doAllCheck) {
+        // The "if" statement is emitted like a "cif" statement.
+        lRecordOptReportStmt(ctx, "ispc.coherent_ifs", pos);
+    }
+    if (doAllCheck || inferredCoherent) {
         // We can't tell if the mask going into the if is all on at the
         // compile time.  Emit code to check for this and then either run
         // the code for the 'all on' or the 'mixed' case depending on the
@@ -839,6 +943,7 @@ DoStmt::DoStmt(Expr *t, Stmt *s, bool cc, SourcePos p)
     : Stmt(p, DoStmtID), testExpr(t), bodyStmts(s), doCoherentCheck(cc && !g->opt.disableCoherentControlFlow) {}
 
 void DoStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
     // Check for things that could be nullptr due to earlier errors during
     // compilation.
     if (!ctx->GetCurrentBasicBlock()) {
@@ -1029,10 +1134,14 @@ int DoStmt::EstimateCost() const {
     return lLoopStmtUniformTest(testExpr, bodyStmts) ? COST_UNIFORM_LOOP : COST_VARYING_LOOP;
 }
 
+void DoStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
 DoStmt *DoStmt::Instantiate(TemplateInstantiation &templInst) const {
     Expr *instTestExpr = testExpr ? testExpr->Instantiate(templInst) : nullptr;
     Stmt *instBodyStmts = bodyStmts ? bodyStmts->Instantiate(templInst) : nullptr;
-    return new DoStmt(instTestExpr, instBodyStmts, doCoherentCheck, pos);
+    DoStmt *inst = new DoStmt(instTestExpr, instBodyStmts, doCoherentCheck, pos);
+    inst->expectAttribute = expectAttribute;
+    return inst;
 }
 
 void DoStmt::Print(Indent &indent) const {
@@ -1058,11 +1167,207 @@ ForStmt::ForStmt(Stmt *i, Expr *t, Stmt *s, Stmt *st, bool cc, SourcePos p)
     : Stmt(p, ForStmtID), init(i), test(t), step(s), stmts(st),
       doCoherentCheck(cc && !g->opt.disableCoherentControlFlow) {}
 
+struct FusedLaunchCheckInfo {
+    FusedLaunchCheckInfo(Symbol *c) : counter(c) {}
+    Symbol *counter;
+    bool hasSideEffects = false;
+    bool usesCounter = false;
+};
+
+static bool lFusedLaunchCheckPreFunc(ASTNode *node, void *d) {
+    FusedLaunchCheckInfo *info = (FusedLaunchCheckInfo *)d;
+    UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(node);
+    if (llvm::dyn_cast<AssignExpr>(node) != nullptr || llvm::dyn_cast<FunctionCallExpr>(node) != nullptr ||
+        llvm::dyn_cast<NewExpr>(node) != nullptr ||
+        (ue != nullptr && (ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PreDec ||
+                           ue->op == UnaryExpr::PostInc || ue->op == UnaryExpr::PostDec))) {
+        info->hasSideEffects = true;
+        return false;
+    }
+    SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node);
+    if (se != nullptr && se->GetBaseSymbol() == info->counter) {
+        info->usesCounter = true;
+    }
+    return true;
+}
+
+/** Returns true if evaluating the given expression has no side effects,
+    and, unless \p counterOk is true, it doesn't use the loop counter. */
+static bool lIsFusedLaunchOperand(Expr *expr, Symbol *counter, bool counterOk) {
+    if (expr == nullptr) {
+        return false;
+    }
+    FusedLaunchCheckInfo info(counter);
+    WalkAST(expr, lFusedLaunchCheckPreFunc, nullptr, &info);
+    return !info.hasSideEffects && (counterOk || !info.usesCounter);
+}
+
+static bool lIsConstOne(Expr *expr) {
+    ConstExpr *ce = llvm::dyn_cast_or_null<ConstExpr>(expr);
+    int32_t value;
+    return ce != nullptr && ce->Count() == 1 && ce->GetValues(&value) == 1 && value == 1;
+}
+
+/** Checks whether the "for" loop is of the form
+
+    for (uniform int j = start; j < end; ++j)
+        launch[n] f(args);
+
+    where end, n and the arguments have no side effects, and end and n don't
+    depend on j.  If so, the launches can be fused into a single launch of
+    (end - start) * n tasks, see ForStmt::emitFusedLaunch().  Returns the
+    launch expression and the loop counter and the end expression through
+    the given pointers, or nullptr if the loop isn't of this form. */
+static FunctionCallExpr *lGetFusibleLaunch(const ForStmt *fs, Symbol **counter, Expr **end) {
+    if (g->target->isXeTarget() || g->opt.disableLaunchFusion) {
+        return nullptr;
+    }
+
+    DeclStmt *ds = llvm::dyn_cast_or_null<DeclStmt>(fs->init);
+    if (ds == nullptr || ds->vars.size() != 1 || ds->vars[0].sym == nullptr || ds->vars[0].init == nullptr) {
+        return nullptr;
+    }
+    Symbol *sym = ds->vars[0].sym;
+    if (sym->type == nullptr || !Type::Equal(sym->type, AtomicType::UniformInt32)) {
+        return nullptr;
+    }
+
+    BinaryExpr *test = llvm::dyn_cast_or_null<BinaryExpr>(fs->test);
+    if (test == nullptr || test->op != BinaryExpr::Lt) {
+        return nullptr;
+    }
+    SymbolExpr *testSym = llvm::dyn_cast_or_null<SymbolExpr>(test->arg0);
+    if (testSym == nullptr || testSym->GetBaseSymbol() != sym || test->arg1 == nullptr ||
+        !Type::Equal(test->arg1->GetType(), AtomicType::UniformInt32) ||
+        !lIsFusedLaunchOperand(test->arg1, sym, false)) {
+        return nullptr;
+    }
+
+    ExprStmt *step = llvm::dyn_cast_or_null<ExprStmt>(fs->step);
+    UnaryExpr *inc = step ? llvm::dyn_cast_or_null<UnaryExpr>(step->expr) : nullptr;
+    if (inc == nullptr || (inc->op != UnaryExpr::PreInc && inc->op != UnaryExpr::PostInc)) {
+        return nullptr;
+    }
+    SymbolExpr *incSym = llvm::dyn_cast_or_null<SymbolExpr>(inc->expr);
+    if (incSym == nullptr || incSym->GetBaseSymbol() != sym) {
+        return nullptr;
+    }
+
+    Stmt *body = fs->stmts;
+    StmtList *sl = llvm::dyn_cast_or_null<StmtList>(body);
+    if (sl != nullptr) {
+        body = sl->stmts.size() == 1 ? sl->stmts[0] : nullptr;
+    }
+    ExprStmt *es = llvm::dyn_cast_or_null<ExprStmt>(body);
+    FunctionCallExpr *call = es ? llvm::dyn_cast_or_null<FunctionCallExpr>(es->expr) : nullptr;
+    if (call == nullptr || !call->isLaunch || call->reduceTarget != nullptr || call->args == nullptr ||
+        llvm::dyn_cast_or_null<FunctionSymbolExpr>(call->func) == nullptr) {
+        return nullptr;
+    }
+    const FunctionType *ft = CastType<FunctionType>(call->func->GetType());
+    if (ft == nullptr || !ft->isTask || !ft->GetReturnType()->IsVoidType()) {
+        return nullptr;
+    }
+    if (!lIsFusedLaunchOperand(call->launchCountExpr[0], sym, false) || !lIsConstOne(call->launchCountExpr[1]) ||
+        !lIsConstOne(call->launchCountExpr[2])) {
+        return nullptr;
+    }
+    for (Expr *arg : call->args->exprs) {
+        if (!lIsFusedLaunchOperand(arg, sym, true)) {
+            return nullptr;
+        }
+    }
+
+    *counter = sym;
+    *end = test->arg1;
+    return call;
+}
+
+bool ForStmt::emitFusedLaunch(FunctionEmitContext *ctx) const {
+    Symbol *counter = nullptr;
+    Expr *end = nullptr;
+    FunctionCallExpr *call = lGetFusibleLaunch(this, &counter, &end);
+    if (call == nullptr) {
+        return false;
+    }
+    const FunctionType *ft = CastType<FunctionType>(call->func->GetType());
+
+    ctx->SetDebugPos(pos);
+    ctx->StartScope();
+    init->EmitCode(ctx);
+
+    // The end of the loop and the number of the tasks of each launch are
+    // loop invariant, so they're evaluated once.
+    llvm::Value *start = ctx->LoadInst(counter->storageInfo, counter->type, "launch_start");
+    llvm::Value *endValue = end->GetValue(ctx);
+    llvm::Value *count0 = call->launchCountExpr[0]->GetValue(ctx);
+    ctx->SetDebugPos(call->pos);
+    llvm::Value *callee = call->func->GetValue(ctx);
+    if (endValue == nullptr || count0 == nullptr || callee == nullptr) {
+        AssertPos(pos, m->errorCount > 0);
+        ctx->EndScope();
+        return true;
+    }
+    AssertPos(pos, llvm::isa<llvm::Function>(callee));
+
+    llvm::BasicBlock *balloc = ctx->CreateBasicBlock("fused_launch_alloc", ctx->GetCurrentBasicBlock());
+    llvm::BasicBlock *bargs = ctx->CreateBasicBlock("fused_launch_args", balloc);
+    llvm::BasicBlock *blaunch = ctx->CreateBasicBlock("fused_launch", bargs);
+    llvm::BasicBlock *bexit = ctx->CreateBasicBlock("fused_launch_exit", blaunch);
+
+    llvm::Value *any =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, start, endValue, "fused_launch_any");
+    ctx->BranchInst(balloc, bexit, any);
+
+    // Allocate the argument blocks of all of the launches at once.
+    ctx->SetCurrentBasicBlock(balloc);
+    llvm::Value *count1 =
+        ctx->BinaryOperator(llvm::Instruction::Sub, endValue, start, WrapSemantics::None, "fused_launch_count");
+    AddressInfo *groupHandle = call->launchGroup ? call->launchGroup->storageInfo : nullptr;
+    llvm::Value *voidmem = ctx->LaunchAllocInst(ft, count1, groupHandle);
+    ctx->BranchInst(bargs);
+
+    // What is left of the loop stores the arguments of the launch of each
+    // iteration to its block.
+    ctx->SetCurrentBasicBlock(bargs);
+    llvm::Value *j = ctx->LoadInst(counter->storageInfo, counter->type, "launch_counter");
+    llvm::Value *index =
+        ctx->BinaryOperator(llvm::Instruction::Sub, j, start, WrapSemantics::None, "fused_launch_index");
+    std::vector<llvm::Value *> argVals;
+    if (!call->GetArgValues(ctx, ft, argVals)) {
+        AssertPos(pos, m->errorCount > 0);
+        ctx->EndScope();
+        return true;
+    }
+    ctx->SetDebugPos(call->pos);
+    ctx->LaunchArgsInst(voidmem, index, ft, argVals);
+    llvm::Value *next = ctx->BinaryOperator(llvm::Instruction::Add, j, LLVMInt32(1), WrapSemantics::NSW,
+                                            "launch_counter_next");
+    ctx->StoreInst(next, counter->storageInfo);
+    llvm::Value *more =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, next, endValue, "fused_launch_more");
+    ctx->BranchInst(bargs, blaunch, more);
+
+    ctx->SetCurrentBasicBlock(blaunch);
+    ctx->FusedLaunchInst(llvm::cast<llvm::Function>(callee), ft, voidmem, count0, count1, groupHandle);
+    ctx->BranchInst(bexit);
+
+    ctx->SetCurrentBasicBlock(bexit);
+    ctx->EndScope();
+    return true;
+}
+
 void ForStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
     if (!ctx->GetCurrentBasicBlock()) {
         return;
     }
 
+    // Loops of launches are emitted as a single launch, when possible.
+    if (emitFusedLaunch(ctx)) {
+        return;
+    }
+
     llvm::BasicBlock *btest = ctx->CreateBasicBlock("for_test", ctx->GetCurrentBasicBlock());
     llvm::BasicBlock *bloop = ctx->CreateBasicBlock("for_loop", btest);
     llvm::BasicBlock *bstep = ctx->CreateBasicBlock("for_step", bloop);
@@ -1253,12 +1558,16 @@ void ForStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAttr)
 
 int ForStmt::EstimateCost() const { return lLoopStmtUniformTest(test, stmts) ? COST_UNIFORM_LOOP : COST_VARYING_LOOP; }
 
+void ForStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
 ForStmt *ForStmt::Instantiate(TemplateInstantiation &templInst) const {
     Expr *instTestExpr = test ? test->Instantiate(templInst) : nullptr;
     Stmt *instInitStmts = init ? init->Instantiate(templInst) : nullptr;
     Stmt *instStepStmts = step ? step->Instantiate(templInst) : nullptr;
     Stmt *instBodyStmts = stmts ? stmts->Instantiate(templInst) : nullptr;
-    return new ForStmt(instInitStmts, instTestExpr, instStepStmts, instBodyStmts, doCoherentCheck, pos);
+    ForStmt *inst = new ForStmt(instInitStmts, instTestExpr, instStepStmts, instBodyStmts, doCoherentCheck, pos);
+    inst->expectAttribute = expectAttribute;
+    return inst;
 }
 
 void ForStmt::Print(Indent &indent) const {
@@ -1438,6 +1747,109 @@ static void lGetSpans(int dimsLeft, int nDims, int itemsLeft, bool isTiled, int
     lGetSpans(dimsLeft - 1, nDims, itemsLeft / *a, isTiled, a + 1);
 }
 
+/* Compute the extent of the cache blocks of a foreach_tiled loop blocked
+   for a data cache of the given size.  Each block gets about one point for
+   every 32 bytes of the cache, which leaves room for eight 4-byte values
+   per point (e.g. a few input and output arrays and the halo of a stencil)
+   in half of the cache.  The outer dimensions get the same power of two
+   extent and the innermost one gets the rest, so that the rows that are
+   traversed are as long as possible; all extents are multiples of the
+   vector spans.
+ */
+static void lGetCacheBlockSizes(int nDims, int cacheSize, const std::vector<int> &span,
+                                std::vector<int> *blockSize) {
+    int points = std::max(cacheSize / 32, 1);
+    int side = 1;
+    for (;;) {
+        int64_t volume = 1;
+        for (int i = 0; i < nDims; ++i) {
+            volume *= 2 * side;
+        }
+        if (volume > points) {
+            break;
+        }
+        side *= 2;
+    }
+
+    int outerPoints = 1;
+    for (int i = 0; i < nDims - 1; ++i) {
+        (*blockSize)[i] = std::max(side, span[i]);
+        outerPoints *= (*blockSize)[i];
+    }
+    int inner = 1;
+    while (2 * inner * outerPoints <= points) {
+        inner *= 2;
+    }
+    (*blockSize)[nDims - 1] = std::max(inner, span[nDims - 1]);
+}
+
+/* Emit the uniform loops over the cache blocks of a foreach_tiled loop
+   with '#pragma cache_block'.  On return, the current basic block is the
+   body of the innermost block loop, and startVals and endVals have been
+   updated to the bounds of the current block, so that the regular foreach
+   code can be emitted for it.  The returned basic block steps to the next
+   block; the regular code should branch to it once it's done with the
+   current block.
+ */
+static llvm::BasicBlock *lEmitCacheBlockLoops(FunctionEmitContext *ctx, const std::vector<int> &blockSize,
+                                              std::vector<llvm::Value *> &startVals,
+                                              std::vector<llvm::Value *> &endVals, llvm::BasicBlock *bbExit) {
+    int nDims = (int)startVals.size();
+    std::vector<AddressInfo *> blockCounterPtrs;
+    std::vector<llvm::BasicBlock *> bbBlockTest, bbBlockStep;
+    for (int i = 0; i < nDims; ++i) {
+        blockCounterPtrs.push_back(ctx->AllocaInst(LLVMTypes::Int32Type, "block_counter"));
+        bbBlockTest.push_back(ctx->CreateBasicBlock("cache_block_test"));
+        bbBlockStep.push_back(ctx->CreateBasicBlock("cache_block_step"));
+    }
+    llvm::BasicBlock *bbBlockBody = ctx->CreateBasicBlock("cache_block_body");
+
+    ctx->StoreInst(startVals[0], blockCounterPtrs[0]);
+    ctx->BranchInst(bbBlockTest[0]);
+
+    for (int i = 0; i < nDims; ++i) {
+        // cache_block_test: go on to the next dimension, or to the block
+        // body for the innermost one, while there are blocks left.
+        ctx->SetCurrentBasicBlock(bbBlockTest[i]);
+        llvm::Value *counter = ctx->LoadInst(blockCounterPtrs[i], nullptr, "block_counter");
+        llvm::Value *beforeEnd =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, counter, endVals[i], "before_end");
+        llvm::BasicBlock *bbDone = (i == 0) ? bbExit : bbBlockStep[i - 1];
+        if (i == nDims - 1) {
+            ctx->BranchInst(bbBlockBody, bbDone, beforeEnd);
+        } else {
+            llvm::BasicBlock *bbBlockEnter = ctx->CreateBasicBlock("cache_block_enter");
+            ctx->BranchInst(bbBlockEnter, bbDone, beforeEnd);
+            ctx->SetCurrentBasicBlock(bbBlockEnter);
+            ctx->StoreInst(startVals[i + 1], blockCounterPtrs[i + 1]);
+            ctx->BranchInst(bbBlockTest[i + 1]);
+        }
+
+        // cache_block_step: advance the counter by the block extent.
+        ctx->SetCurrentBasicBlock(bbBlockStep[i]);
+        counter = ctx->LoadInst(blockCounterPtrs[i], nullptr, "block_counter");
+        llvm::Value *newCounter = ctx->BinaryOperator(llvm::Instruction::Add, counter, LLVMInt32(blockSize[i]),
+                                                      WrapSemantics::NSW, "new_block_counter");
+        ctx->StoreInst(newCounter, blockCounterPtrs[i]);
+        ctx->BranchInst(bbBlockTest[i]);
+    }
+
+    // cache_block_body: the bounds of the current block are
+    // [counter, min(counter + extent, end)) in each dimension.
+    ctx->SetCurrentBasicBlock(bbBlockBody);
+    for (int i = 0; i < nDims; ++i) {
+        llvm::Value *counter = ctx->LoadInst(blockCounterPtrs[i], nullptr, "block_start");
+        llvm::Value *blockEnd = ctx->BinaryOperator(llvm::Instruction::Add, counter, LLVMInt32(blockSize[i]),
+                                                    WrapSemantics::NSW, "block_end");
+        llvm::Value *beforeEnd =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, blockEnd, endVals[i], "block_before_end");
+        startVals[i] = counter;
+        endVals[i] = ctx->SelectInst(beforeEnd, blockEnd, endVals[i], "block_end");
+    }
+
+    return bbBlockStep[nDims - 1];
+}
+
 /* Emit code for a foreach statement.  We effectively emit code to run the
    set of n-dimensional nested loops corresponding to the dimensionality of
    the foreach statement along with the extra logic to deal with mismatches
@@ -1445,6 +1857,13 @@ static void lGetSpans(int dimsLeft, int nDims, int itemsLeft, bool isTiled, int
    to process.
  */
 void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
+
+    if (ctx->GetCurrentBasicBlock() != nullptr) {
+        for (const SourcePos &fusedPos : fusedLoops) {
+            lRecordOptReportStmt(ctx, "ispc.fused_foreach_loops", fusedPos);
+        }
+    }
 
 #ifdef ISPC_XE_ENABLED
     if (ctx->emitXeHardwareMask()) {
@@ -1457,7 +1876,13 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
         return;
     }
 
-    llvm::BasicBlock *bbFullBody = ctx->CreateBasicBlock("foreach_full_body");
+    // With --opt=foreach-single-body, only the masked copy of the body is
+    // emitted, and it runs for the full vectors of the innermost dimension
+    // as well, with the mask computed from the counter.  This only pays off
+    // when masked memory operations are as fast as the unmasked ones.
+    bool singleBody = g->opt.foreachSingleBody && g->target->getMaskingIsFree();
+
+    llvm::BasicBlock *bbFullBody = singleBody ? nullptr : ctx->CreateBasicBlock("foreach_full_body");
     llvm::BasicBlock *bbMaskedBody = ctx->CreateBasicBlock("foreach_masked_body");
     llvm::BasicBlock *bbExit = ctx->CreateBasicBlock("foreach_exit");
 
@@ -1485,6 +1910,27 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     std::vector<int> span(nDims, 0);
     lGetSpans(nDims - 1, nDims, g->target->getVectorWidth(), isTiled, &span[0]);
 
+    // Start and end value for each loop dimension
+    for (int i = 0; i < nDims; ++i) {
+        llvm::Value *sv = startExprs[i]->GetValue(ctx);
+        llvm::Value *ev = endExprs[i]->GetValue(ctx);
+        if (sv == nullptr || ev == nullptr) {
+            return;
+        }
+        startVals.push_back(sv);
+        endVals.push_back(ev);
+    }
+
+    // With '#pragma cache_block', the loops below run over each of the
+    // cache-sized blocks of the iteration domain in turn, rather than over
+    // all of it, so that the data touched by a block stays in the cache.
+    llvm::BasicBlock *bbDone = bbExit;
+    if (cacheBlockLevel != 0) {
+        std::vector<int> blockSize(nDims, 0);
+        lGetCacheBlockSizes(nDims, g->target->getDataCacheSize(cacheBlockLevel), span, &blockSize);
+        bbDone = lEmitCacheBlockLoops(ctx, blockSize, startVals, endVals, bbExit);
+    }
+
     for (int i = 0; i < nDims; ++i) {
         // Basic blocks that we'll fill in later with the looping logic for
         // this dimension.
@@ -1495,14 +1941,8 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
         }
         bbTest.push_back(ctx->CreateBasicBlock("foreach_test"));
 
-        // Start and end value for this loop dimension
-        llvm::Value *sv = startExprs[i]->GetValue(ctx);
-        llvm::Value *ev = endExprs[i]->GetValue(ctx);
-        if (sv == nullptr || ev == nullptr) {
-            return;
-        }
-        startVals.push_back(sv);
-        endVals.push_back(ev);
+        llvm::Value *sv = startVals[i];
+        llvm::Value *ev = endVals[i];
 
         // nItems = endVal - startVal
         llvm::Value *nItems = ctx->BinaryOperator(llvm::Instruction::Sub, ev, sv, WrapSemantics::NSW, "nitems");
@@ -1554,7 +1994,7 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     for (int i = 0; i < nDims; ++i) {
         ctx->SetCurrentBasicBlock(bbReset[i]);
         if (i == 0) {
-            ctx->BranchInst(bbExit);
+            ctx->BranchInst(bbDone);
         } else {
             ctx->StoreInst(LLVMMaskAllOn, extrasMaskPtrs[i]);
             ctx->StoreInst(startVals[i], uniformCounterPtrs[i]);
@@ -1775,9 +2215,16 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     //   // set mask to (counter+programCounter < end)
     //   // run loop body with mask
     // }
+    //
+    // For a single body, there's only the second part, which runs for all
+    // of the iterations: the masked body steps the index and comes back
+    // here.
     llvm::BasicBlock *bbPartialInnerAllOuter = ctx->CreateBasicBlock("partial_inner_all_outer");
     ctx->SetCurrentBasicBlock(bbOuterNotInExtras);
-    {
+    if (singleBody) {
+        llvm::Instruction *bbBIOuterNotInExtras = ctx->BranchInst(bbPartialInnerAllOuter);
+        ctx->setLoopUnrollMetadata(bbBIOuterNotInExtras, loopAttribute, pos);
+    } else {
         llvm::Value *counter = ctx->LoadInst(uniformCounterPtrs[nDims - 1], nullptr, "counter");
         llvm::Value *beforeAlignedEnd = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, counter,
                                                      alignedEnd[nDims - 1], "before_aligned_end");
@@ -1791,9 +2238,9 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     // on'.  This ends up being relatively straightforward: just update the
     // value of the varying loop counter and have the statements in the
     // loop body emit their code.
-    llvm::BasicBlock *bbFullBodyContinue = ctx->CreateBasicBlock("foreach_full_continue");
-    ctx->SetCurrentBasicBlock(bbFullBody);
-    {
+    if (!singleBody) {
+        llvm::BasicBlock *bbFullBodyContinue = ctx->CreateBasicBlock("foreach_full_continue");
+        ctx->SetCurrentBasicBlock(bbFullBody);
         ctx->SetInternalMask(LLVMMaskAllOn);
         ctx->SetBlockEntryMask(LLVMMaskAllOn);
         lUpdateVaryingCounter(nDims - 1, nDims, ctx, uniformCounterPtrs[nDims - 1],
@@ -1803,9 +2250,8 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
         stmts->EmitCode(ctx);
         AssertPos(pos, ctx->GetCurrentBasicBlock() != nullptr);
         ctx->BranchInst(bbFullBodyContinue);
-    }
-    ctx->SetCurrentBasicBlock(bbFullBodyContinue);
-    {
+
+        ctx->SetCurrentBasicBlock(bbFullBodyContinue);
         ctx->RestoreContinuedLanes();
         llvm::Value *counter = ctx->LoadInst(uniformCounterPtrs[nDims - 1]);
         llvm::Value *newCounter = ctx->BinaryOperator(llvm::Instruction::Add, counter, LLVMInt32(span[nDims - 1]),
@@ -1840,7 +2286,7 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
         ctx->SetInternalMask(emask);
         ctx->SetBlockEntryMask(emask);
 
-        ctx->StoreInst(LLVMFalse, stepIndexAfterMaskedBodyPtrInfo);
+        ctx->StoreInst(singleBody ? LLVMTrue : LLVMFalse, stepIndexAfterMaskedBodyPtrInfo);
         ctx->BranchInst(bbMaskedBody);
     }
 
@@ -1856,10 +2302,16 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
     {
         ctx->AddInstrumentationPoint("foreach loop body (masked)");
         ctx->SetContinueTarget(bbMaskedBodyContinue);
-        ctx->DisableGatherScatterWarnings();
+        // The warnings are issued for the full body already, unless it's
+        // the only one.
+        if (!singleBody) {
+            ctx->DisableGatherScatterWarnings();
+        }
         ctx->SetBlockEntryMask(ctx->GetFullMask());
         stmts->EmitCode(ctx);
-        ctx->EnableGatherScatterWarnings();
+        if (!singleBody) {
+            ctx->EnableGatherScatterWarnings();
+        }
         ctx->BranchInst(bbMaskedBodyContinue);
     }
     ctx->SetCurrentBasicBlock(bbMaskedBodyContinue);
@@ -1871,14 +2323,17 @@ void ForeachStmt::EmitCode(FunctionEmitContext *ctx) const {
 
     ///////////////////////////////////////////////////////////////////////////
     // step the innermost index, for the case where we're doing the
-    // innermost for loop over full vectors.
+    // innermost for loop over full vectors, or over all of the vectors for
+    // a single body when the outer dimensions aren't in extras.
     ctx->SetCurrentBasicBlock(bbStepInnerIndex);
     {
         llvm::Value *counter = ctx->LoadInst(uniformCounterPtrs[nDims - 1]);
         llvm::Value *newCounter = ctx->BinaryOperator(llvm::Instruction::Add, counter, LLVMInt32(span[nDims - 1]),
                                                       WrapSemantics::NSW, "new_counter");
         ctx->StoreInst(newCounter, uniformCounterPtrs[nDims - 1]);
-        ctx->BranchInst(bbOuterInExtras);
+        // With a single body, both paths step here, so go back to the test
+        // that picks between them.
+        ctx->BranchInst(singleBody ? bbTest[nDims - 1] : bbOuterInExtras);
     }
 
     ///////////////////////////////////////////////////////////////////////////
@@ -2057,6 +2512,251 @@ void ForeachStmt::EmitCodeForXe(FunctionEmitContext *ctx) const {
 }
 #endif
 
+namespace {
+/** How the memory accesses in the body of a multidimensional foreach loop
+    use its loop variables. */
+struct ForeachAccessInfo {
+    ForeachAccessInfo(const std::vector<Symbol *> &dims)
+        : dims(dims), unitStride(dims.size(), 0), otherStride(dims.size(), 0) {}
+    const std::vector<Symbol *> &dims;
+    // The number of accesses that are contiguous/not contiguous along each
+    // of the dimensions.
+    std::vector<int> unitStride, otherStride;
+    // The IndexExprs of multidimensional accesses that have been counted.
+    std::set<const IndexExpr *> seen;
+    // Whether the body may depend on the mapping of the iterations to the
+    // program instances.
+    bool crossLane = false;
+};
+} // namespace
+
+static bool lCountOtherStrideUses(ASTNode *node, void *data) {
+    ForeachAccessInfo *info = (ForeachAccessInfo *)data;
+    if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node)) {
+        for (size_t i = 0; i < info->dims.size(); ++i) {
+            if (se->GetBaseSymbol() == info->dims[i]) {
+                info->otherStride[i]++;
+            }
+        }
+    }
+    return true;
+}
+
+/* Count the uses of the loop variables in an array index.  A loop variable
+   that is a term of a sum or difference in the last index of an access
+   makes it contiguous along its dimension; any other use, e.g. multiplied
+   by the row width or in an outer index, makes it a gather or scatter. */
+static void lCountIndexUses(Expr *expr, bool unit, ForeachAccessInfo *info) {
+    if (expr == nullptr) {
+        return;
+    }
+    if (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        lCountIndexUses(tce->expr, unit, info);
+    } else if (BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        bool additive = (be->op == BinaryExpr::Add || be->op == BinaryExpr::Sub);
+        lCountIndexUses(be->arg0, unit && additive, info);
+        lCountIndexUses(be->arg1, unit && additive, info);
+    } else if (unit && llvm::isa<SymbolExpr>(expr)) {
+        Symbol *sym = llvm::cast<SymbolExpr>(expr)->GetBaseSymbol();
+        for (size_t i = 0; i < info->dims.size(); ++i) {
+            if (sym == info->dims[i]) {
+                info->unitStride[i]++;
+            }
+        }
+    } else {
+        WalkAST(expr, lCountOtherStrideUses, nullptr, info);
+    }
+}
+
+static bool lForeachAccessPreFunc(ASTNode *node, void *data) {
+    ForeachAccessInfo *info = (ForeachAccessInfo *)data;
+    if (IndexExpr *ie = llvm::dyn_cast<IndexExpr>(node)) {
+        if (info->seen.find(ie) == info->seen.end()) {
+            // a[y][x] is IndexExpr(IndexExpr(a, y), x): the outermost
+            // IndexExpr has the last index, the inner ones the others.
+            lCountIndexUses(ie->index, true, info);
+            for (IndexExpr *base = llvm::dyn_cast<IndexExpr>(ie->baseExpr); base != nullptr;
+                 base = llvm::dyn_cast<IndexExpr>(base->baseExpr)) {
+                lCountIndexUses(base->index, false, info);
+                info->seen.insert(base);
+            }
+        }
+    } else if (llvm::isa<FunctionCallExpr>(node)) {
+        // The callee might use cross-program-instance operations.
+        info->crossLane = true;
+    } else if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node)) {
+        if (se->GetBaseSymbol() != nullptr && se->GetBaseSymbol()->name == "programIndex") {
+            info->crossLane = true;
+        }
+    }
+    return true;
+}
+
+/* Return the trip count of a foreach dimension if its bounds are
+   compile-time constants, or -1. */
+static int lConstTripCount(Expr *startExpr, Expr *endExpr) {
+    ConstExpr *start = llvm::dyn_cast<ConstExpr>(startExpr);
+    ConstExpr *end = llvm::dyn_cast<ConstExpr>(endExpr);
+    if (start == nullptr || end == nullptr) {
+        return -1;
+    }
+    int32_t startVal, endVal;
+    start->GetValues(&startVal);
+    end->GetValues(&endVal);
+    return std::max(endVal - startVal, 0);
+}
+
+/* Choose the dimension of a multidimensional foreach loop to vectorize and
+   move it to the end of the loop variables, since the code for the loop
+   vectorizes the innermost dimension.  This is the one named by '#pragma
+   vectorize_dim' if there is one.  Otherwise, it's the last one, unless
+   the accesses in the body are not contiguous along it, or it has a
+   constant trip count that is less than the vector width, while they are
+   contiguous along another dimension.  The iterations of a foreach loop
+   run in no specified order, but a body that calls functions or uses
+   programIndex may depend on which iterations share a vector, so the
+   dimension is not changed automatically for those. */
+void ForeachStmt::chooseVectorizedDim() {
+    int nDims = (int)dimVariables.size();
+    int chosen = nDims - 1;
+    if (!vectorizeDim.empty()) {
+        for (chosen = nDims - 1; chosen >= 0; --chosen) {
+            if (dimVariables[chosen] != nullptr && dimVariables[chosen]->name == vectorizeDim) {
+                break;
+            }
+        }
+        if (chosen < 0) {
+            Error(pos, "\"%s\" in '#pragma vectorize_dim' is not a variable of the \"foreach\" loop.",
+                  vectorizeDim.c_str());
+            return;
+        }
+    } else if (nDims > 1 && stmts != nullptr) {
+        ForeachAccessInfo info(dimVariables);
+        WalkAST(stmts, lForeachAccessPreFunc, nullptr, &info);
+
+        int last = nDims - 1;
+        auto contiguous = [&](int i) { return info.unitStride[i] > 0 && info.otherStride[i] == 0; };
+        int width = g->target->getVectorWidth();
+        int lastTrips = lConstTripCount(startExprs[last], endExprs[last]);
+        bool lastIsStrided = info.otherStride[last] > 0 && info.unitStride[last] == 0;
+        bool lastIsShort = lastTrips >= 0 && lastTrips < width;
+        if (!info.crossLane && (lastIsStrided || lastIsShort)) {
+            for (int i = 0; i < last; ++i) {
+                int trips = lConstTripCount(startExprs[i], endExprs[i]);
+                if (!contiguous(i) || (trips >= 0 && trips < width && !lastIsStrided)) {
+                    continue;
+                }
+                if (chosen == last || info.unitStride[i] >= info.unitStride[chosen]) {
+                    chosen = i;
+                }
+            }
+        }
+        if (chosen == last && lastIsStrided) {
+            PerformanceWarning(pos,
+                               "The memory accesses in the \"foreach\" loop are not contiguous along its last "
+                               "dimension \"%s\", which is vectorized, so they need gathers or scatters. "
+                               "'#pragma vectorize_dim' selects another dimension to vectorize.",
+                               dimVariables[last]->name.c_str());
+        }
+    }
+
+    if (chosen != nDims - 1) {
+        std::rotate(dimVariables.begin() + chosen, dimVariables.begin() + chosen + 1, dimVariables.end());
+        std::rotate(startExprs.begin() + chosen, startExprs.begin() + chosen + 1, startExprs.end());
+        std::rotate(endExprs.begin() + chosen, endExprs.begin() + chosen + 1, endExprs.end());
+    }
+}
+
+/* Returns true if the given expression is a uniform value, a loop variable
+   of the enclosing foreach, or a sum, difference or uniform multiple of
+   those, so that it changes by small steps from one program instance to
+   the next. */
+static bool lIsForeachLinear(Expr *expr, const std::vector<Symbol *> &dims) {
+    const Type *type = expr != nullptr ? expr->GetType() : nullptr;
+    if (type == nullptr) {
+        return false;
+    }
+    if (type->IsUniformType() || llvm::isa<ConstExpr>(expr)) {
+        return true;
+    }
+    if (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        return lIsForeachLinear(tce->expr, dims);
+    }
+    if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr)) {
+        return std::find(dims.begin(), dims.end(), se->GetBaseSymbol()) != dims.end();
+    }
+    if (UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(expr)) {
+        return ue->op == UnaryExpr::Negate && lIsForeachLinear(ue->expr, dims);
+    }
+    if (BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        if (be->op == BinaryExpr::Add || be->op == BinaryExpr::Sub) {
+            return lIsForeachLinear(be->arg0, dims) && lIsForeachLinear(be->arg1, dims);
+        }
+        if (be->op == BinaryExpr::Mul) {
+            const Type *type0 = be->arg0->GetType(), *type1 = be->arg1->GetType();
+            return (type0 != nullptr && type0->IsUniformType() && lIsForeachLinear(be->arg1, dims)) ||
+                   (type1 != nullptr && type1->IsUniformType() && lIsForeachLinear(be->arg0, dims));
+        }
+    }
+    return false;
+}
+
+/* Returns true if the given condition is likely to have the same value for
+   all of the program instances of most of the iterations of a foreach
+   loop: it compares values that are linear in the loop variables, like
+   "x < width - 1" or "y == 0", so that its value only changes at one point
+   of the iteration domain, or combines such comparisons. */
+static bool lIsCoherentCondition(Expr *expr, const std::vector<Symbol *> &dims) {
+    const Type *type = expr != nullptr ? expr->GetType() : nullptr;
+    if (type == nullptr) {
+        return false;
+    }
+    if (type->IsUniformType()) {
+        return true;
+    }
+    if (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        return lIsCoherentCondition(tce->expr, dims);
+    }
+    if (UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(expr)) {
+        return ue->op == UnaryExpr::LogicalNot && lIsCoherentCondition(ue->expr, dims);
+    }
+    if (BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        switch (be->op) {
+        case BinaryExpr::Lt:
+        case BinaryExpr::Gt:
+        case BinaryExpr::Le:
+        case BinaryExpr::Ge:
+        case BinaryExpr::Equal:
+        case BinaryExpr::NotEqual:
+            return lIsForeachLinear(be->arg0, dims) && lIsForeachLinear(be->arg1, dims);
+        case BinaryExpr::LogicalAnd:
+        case BinaryExpr::LogicalOr:
+        case BinaryExpr::BitAnd:
+        case BinaryExpr::BitOr:
+            return lIsCoherentCondition(be->arg0, dims) && lIsCoherentCondition(be->arg1, dims);
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+/* Emit the "if" statements in the body of a foreach loop, whose varying
+   conditions are coherent, like "cif" statements, unless their bodies are
+   cheap enough to run with predication anyway. */
+static bool lInferCoherentIfsPreFunc(ASTNode *node, void *data) {
+    const std::vector<Symbol *> &dims = *(const std::vector<Symbol *> *)data;
+    if (IfStmt *ifStmt = llvm::dyn_cast<IfStmt>(node)) {
+        const Type *testType = ifStmt->test != nullptr ? ifStmt->test->GetType() : nullptr;
+        if (testType != nullptr && testType->IsVaryingType() &&
+            EstimateCost(ifStmt->trueStmts) + EstimateCost(ifStmt->falseStmts) >= PREDICATE_SAFE_IF_STATEMENT_COST &&
+            lIsCoherentCondition(ifStmt->test, dims)) {
+            ifStmt->inferredCoherent = true;
+        }
+    }
+    return true;
+}
+
 Stmt *ForeachStmt::TypeCheck() {
     for (auto expr : startExprs) {
         const Type *t = expr ? expr->GetType() : nullptr;
@@ -2113,6 +2813,13 @@ Stmt *ForeachStmt::TypeCheck() {
         anyErrors = true;
     }
 
+    if (!anyErrors && !isTiled) {
+        chooseVectorizedDim();
+    }
+    if (!anyErrors && stmts != nullptr && !g->opt.disableCoherentControlFlow) {
+        WalkAST(stmts, lInferCoherentIfsPreFunc, nullptr, &dimVariables);
+    }
+
     return anyErrors ? nullptr : this;
 }
 
@@ -2124,7 +2831,45 @@ void ForeachStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAt
     loopAttribute = lAttr;
 }
 
-int ForeachStmt::EstimateCost() const { return dimVariables.size() * (COST_UNIFORM_LOOP + COST_SIMPLE_ARITH_LOGIC_OP); }
+void ForeachStmt::SetCacheBlockAttribute(int cacheLevel) {
+    if (cacheBlockLevel != 0) {
+        Error(pos, "Multiple '#pragma cache_block' directives used.");
+    }
+    if (!isTiled) {
+        Warning(pos, "'#pragma cache_block' only applies to \"foreach_tiled\" loops; ignoring it.");
+        return;
+    }
+    if (dimVariables.size() < 2) {
+        Warning(pos, "'#pragma cache_block' has no effect on one-dimensional \"foreach_tiled\" loops.");
+        return;
+    }
+
+    cacheBlockLevel = cacheLevel;
+}
+
+void ForeachStmt::SetVectorizeDimAttribute(const std::string &dimName) {
+    if (!vectorizeDim.empty()) {
+        Error(pos, "Multiple '#pragma vectorize_dim' directives used.");
+    }
+    if (isTiled) {
+        Warning(pos, "'#pragma vectorize_dim' doesn't apply to \"foreach_tiled\" loops; ignoring it.");
+        return;
+    }
+
+    vectorizeDim = dimName;
+}
+
+int ForeachStmt::EstimateCost() const { return dimVariables.size() * (COST_UNIFORM_LOOP + COST_SIMPLE_ARITH_LOGIC_OP); }
+
+void ForeachStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
+void ForeachStmt::SetFuseAttribute(bool fuse) {
+    if (fuseAttribute != FuseAttribute::Default) {
+        Error(pos, "Multiple '#pragma fuse/nofuse' directives used.");
+    }
+
+    fuseAttribute = fuse ? FuseAttribute::Fuse : FuseAttribute::NoFuse;
+}
 
 ForeachStmt *ForeachStmt::Instantiate(TemplateInstantiation &templInst) const {
     std::vector<Symbol *> instDimVariables;
@@ -2150,6 +2895,10 @@ ForeachStmt *ForeachStmt::Instantiate(TemplateInstantiation &templInst) const {
 
     ForeachStmt *inst = new ForeachStmt(instDimVariables, instStartExprs, instEndExprs, instStmts, isTiled, pos);
     inst->loopAttribute = loopAttribute;
+    inst->expectAttribute = expectAttribute;
+    inst->cacheBlockLevel = cacheBlockLevel;
+    inst->vectorizeDim = vectorizeDim;
+    inst->fuseAttribute = fuseAttribute;
 
     return inst;
 }
@@ -2213,6 +2962,7 @@ ForeachActiveStmt::ForeachActiveStmt(Symbol *s, Stmt *st, SourcePos pos) : Stmt(
 }
 
 void ForeachActiveStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
     if (!ctx->GetCurrentBasicBlock()) {
         return;
     }
@@ -2399,12 +3149,15 @@ void ForeachActiveStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, in
 
 int ForeachActiveStmt::EstimateCost() const { return COST_VARYING_LOOP; }
 
+void ForeachActiveStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
 ForeachActiveStmt *ForeachActiveStmt::Instantiate(TemplateInstantiation &templInst) const {
     Symbol *instSym = templInst.InstantiateSymbol(sym);
     Stmt *instStmts = stmts ? stmts->Instantiate(templInst) : nullptr;
 
     ForeachActiveStmt *inst = new ForeachActiveStmt(instSym, instStmts, pos);
     inst->loopAttribute = loopAttribute;
+    inst->expectAttribute = expectAttribute;
 
     return inst;
 }
@@ -2421,6 +3174,7 @@ ForeachUniqueStmt::ForeachUniqueStmt(Symbol *symbol, Expr *e, Stmt *s, SourcePos
     : Stmt(pos, ForeachUniqueStmtID), sym(symbol), expr(e), stmts(s) {}
 
 void ForeachUniqueStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
     if (!ctx->GetCurrentBasicBlock()) {
         return;
     }
@@ -2673,6 +3427,8 @@ void ForeachUniqueStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, in
 
 int ForeachUniqueStmt::EstimateCost() const { return COST_VARYING_LOOP; }
 
+void ForeachUniqueStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
 ForeachUniqueStmt *ForeachUniqueStmt::Instantiate(TemplateInstantiation &templInst) const {
     Expr *instExpr = expr ? expr->Instantiate(templInst) : nullptr;
     Stmt *instStmts = stmts ? stmts->Instantiate(templInst) : nullptr;
@@ -2680,6 +3436,490 @@ ForeachUniqueStmt *ForeachUniqueStmt::Instantiate(TemplateInstantiation &templIn
 
     ForeachUniqueStmt *inst = new ForeachUniqueStmt(instSym, instExpr, instStmts, pos);
     inst->loopAttribute = loopAttribute;
+    inst->expectAttribute = expectAttribute;
+
+    return inst;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ForeachDynamicStmt
+
+ForeachDynamicStmt::ForeachDynamicStmt(Symbol *s, Expr *se, Expr *ee, Stmt *st, SourcePos pos)
+    : Stmt(pos, ForeachDynamicStmtID), sym(s), startExpr(se), endExpr(ee), stmts(st) {}
+
+/** Splits the body of a foreach_dynamic loop into the statements before
+    its top-level "for"/"while" loop, the loop itself and the statements
+    after it.  Returns nullptr if there isn't exactly one such loop.
+ */
+static ForStmt *lSplitDynamicBody(Stmt *stmts, std::vector<Stmt *> *prefix, std::vector<Stmt *> *suffix) {
+    std::vector<Stmt *> body;
+    if (StmtList *sl = llvm::dyn_cast_or_null<StmtList>(stmts)) {
+        body = sl->stmts;
+    } else if (stmts != nullptr) {
+        body.push_back(stmts);
+    }
+
+    ForStmt *loop = nullptr;
+    for (Stmt *s : body) {
+        ForStmt *fs = llvm::dyn_cast<ForStmt>(s);
+        if (fs != nullptr) {
+            if (loop != nullptr) {
+                return nullptr;
+            }
+            loop = fs;
+        } else if (loop == nullptr) {
+            prefix->push_back(s);
+        } else {
+            suffix->push_back(s);
+        }
+    }
+    return loop;
+}
+
+struct DynamicBodyCheckInfo {
+    DynamicBodyCheckInfo() : loopDepth(0), switchDepth(0), foundErrors(false) {}
+    int loopDepth;
+    int switchDepth;
+    bool foundErrors;
+};
+
+/** Preorder callback function for checking that the statements of a
+    foreach_dynamic loop don't leave it: there may be no "return" at all,
+    and "break" and "continue" only inside the loops (or "switch"
+    statements, for "break") of the body. */
+static bool lDynamicBodyPreFunc(ASTNode *node, void *d) {
+    DynamicBodyCheckInfo *info = (DynamicBodyCheckInfo *)d;
+
+    if (ReturnStmt *rs = llvm::dyn_cast<ReturnStmt>(node)) {
+        Error(rs->pos, "\"return\" statement is illegal inside \"foreach_dynamic\" loops.");
+        info->foundErrors = true;
+        return false;
+    }
+    BreakStmt *bs = llvm::dyn_cast<BreakStmt>(node);
+    ContinueStmt *cs = llvm::dyn_cast<ContinueStmt>(node);
+    if ((bs != nullptr && info->loopDepth == 0 && info->switchDepth == 0) ||
+        (cs != nullptr && info->loopDepth == 0)) {
+        Error(bs != nullptr ? bs->pos : cs->pos,
+              "\"%s\" statement is illegal outside of the loop of \"foreach_dynamic\".",
+              bs != nullptr ? "break" : "continue");
+        info->foundErrors = true;
+        return false;
+    }
+
+    if (llvm::dyn_cast<ForStmt>(node) != nullptr || llvm::dyn_cast<DoStmt>(node) != nullptr ||
+        llvm::dyn_cast<ForeachStmt>(node) != nullptr || llvm::dyn_cast<ForeachActiveStmt>(node) != nullptr ||
+        llvm::dyn_cast<ForeachUniqueStmt>(node) != nullptr || llvm::dyn_cast<ForeachDynamicStmt>(node) != nullptr) {
+        ++info->loopDepth;
+    } else if (llvm::dyn_cast<SwitchStmt>(node) != nullptr) {
+        ++info->switchDepth;
+    }
+    return true;
+}
+
+static ASTNode *lDynamicBodyPostFunc(ASTNode *node, void *d) {
+    DynamicBodyCheckInfo *info = (DynamicBodyCheckInfo *)d;
+    if (llvm::dyn_cast<ForStmt>(node) != nullptr || llvm::dyn_cast<DoStmt>(node) != nullptr ||
+        llvm::dyn_cast<ForeachStmt>(node) != nullptr || llvm::dyn_cast<ForeachActiveStmt>(node) != nullptr ||
+        llvm::dyn_cast<ForeachUniqueStmt>(node) != nullptr || llvm::dyn_cast<ForeachDynamicStmt>(node) != nullptr) {
+        --info->loopDepth;
+    } else if (llvm::dyn_cast<SwitchStmt>(node) != nullptr) {
+        --info->switchDepth;
+    }
+    return node;
+}
+
+/** Emits a statement that starts a work item of a foreach_dynamic loop
+    for the program instances in the current mask.  Declarations store
+    their initial values to all program instances, which would clobber the
+    variables of the items in flight, so the declared variables are moved
+    to new storage that only the program instances in the mask are stored
+    to.
+ */
+static void lEmitDynamicPrefixStmt(FunctionEmitContext *ctx, Stmt *stmt) {
+    stmt->EmitCode(ctx);
+
+    DeclStmt *ds = llvm::dyn_cast<DeclStmt>(stmt);
+    if (ds == nullptr || ctx->GetCurrentBasicBlock() == nullptr) {
+        return;
+    }
+    for (const VariableDeclaration &var : ds->vars) {
+        Symbol *vs = var.sym;
+        if (vs == nullptr || vs->type == nullptr || vs->storageInfo == nullptr) {
+            continue;
+        }
+        AddressInfo *storage = ctx->AllocaInst(vs->type, vs->name.c_str());
+        llvm::Value *value = ctx->LoadInst(vs->storageInfo, vs->type, "new_item_value");
+        const Type *storageType = vs->type->GetAsNonConstType();
+        ctx->StoreInst(value, storage->getPointer(), ctx->GetFullMask(), storageType,
+                       PointerType::GetUniform(storageType));
+        vs->storageInfo = storage;
+    }
+}
+
+void ForeachDynamicStmt::EmitCode(FunctionEmitContext *ctx) const {
+    ExpectationsScope expectations(ctx, expectAttribute);
+    if (!ctx->GetCurrentBasicBlock()) {
+        return;
+    }
+    if (sym == nullptr || sym->type == nullptr || startExpr == nullptr || endExpr == nullptr) {
+        Assert(m->errorCount > 0);
+        return;
+    }
+    if (ctx->emitXeHardwareMask()) {
+        Error(pos, "\"foreach_dynamic\" statement is not supported for Xe targets yet.");
+        return;
+    }
+
+    std::vector<Stmt *> prefix, suffix;
+    ForStmt *loop = lSplitDynamicBody(stmts, &prefix, &suffix);
+    AssertPos(pos, loop != nullptr);
+
+    ctx->SetDebugPos(pos);
+
+    // The various basic blocks that we'll need in the below
+    llvm::BasicBlock *bbRefill = ctx->CreateBasicBlock("foreach_dynamic_refill", ctx->GetCurrentBasicBlock());
+    llvm::BasicBlock *bbAssign = ctx->CreateBasicBlock("foreach_dynamic_assign", bbRefill);
+    llvm::BasicBlock *bbStart = ctx->CreateBasicBlock("foreach_dynamic_start", bbAssign);
+    llvm::BasicBlock *bbTest = ctx->CreateBasicBlock("foreach_dynamic_test", bbStart);
+    llvm::BasicBlock *bbLoop = ctx->CreateBasicBlock("foreach_dynamic_loop", bbTest);
+    llvm::BasicBlock *bbStep = ctx->CreateBasicBlock("foreach_dynamic_step", bbLoop);
+    llvm::BasicBlock *bbBreakAll = ctx->CreateBasicBlock("foreach_dynamic_break_all", bbStep);
+    llvm::BasicBlock *bbRetire = ctx->CreateBasicBlock("foreach_dynamic_retire", bbBreakAll);
+    llvm::BasicBlock *bbFinish = ctx->CreateBasicBlock("foreach_dynamic_finish", bbRetire);
+    llvm::BasicBlock *bbDone = ctx->CreateBasicBlock("foreach_dynamic_done", bbFinish);
+
+    ctx->StartScope();
+
+    // Save the old mask so that we can restore it at the end; the program
+    // instances that are running going into the loop are the ones that
+    // work items are handed out to.
+    llvm::Value *oldMask = ctx->GetInternalMask();
+    llvm::Value *entryMask = ctx->GetFullMask();
+
+    llvm::Value *startValue = startExpr->GetValue(ctx);
+    llvm::Value *endValue = endExpr->GetValue(ctx);
+    if (startValue == nullptr || endValue == nullptr) {
+        Assert(m->errorCount > 0);
+        ctx->EndScope();
+        return;
+    }
+
+    sym->storageInfo = ctx->AllocaInst(sym->type, sym->name.c_str());
+    ctx->EmitVariableDebugInfo(sym);
+
+    // The program instances that have a work item in flight, and the next
+    // work item to hand out.
+    AddressInfo *activePtrInfo = ctx->AllocaInst(LLVMTypes::MaskType, "active_lanes");
+    ctx->StoreInst(LLVMMaskAllOff, activePtrInfo);
+    AddressInfo *nextPtrInfo = ctx->AllocaInst(LLVMTypes::Int32Type, "next_item");
+    ctx->StoreInst(startValue, nextPtrInfo);
+    ctx->BranchInst(bbRefill);
+
+    // bbRefill: see if there are idle program instances and work items
+    // left for them.
+    ctx->SetCurrentBasicBlock(bbRefill);
+    llvm::Value *freeBits = nullptr;
+    {
+        llvm::Value *active = ctx->LoadInst(activePtrInfo, nullptr, "active_lanes");
+        llvm::Value *freeLanes = ctx->BinaryOperator(llvm::Instruction::And, entryMask, ctx->NotOperator(active),
+                                                     WrapSemantics::None, "free_lanes");
+        freeBits = ctx->LaneMask(freeLanes);
+        llvm::Value *next = ctx->LoadInst(nextPtrInfo, nullptr, "next_item");
+        llvm::Value *anyFree =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, freeBits, LLVMInt64(0), "any_free");
+        llvm::Value *itemsLeft =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, next, endValue, "items_left");
+        llvm::Value *doRefill =
+            ctx->BinaryOperator(llvm::Instruction::And, anyFree, itemsLeft, WrapSemantics::None, "do_refill");
+        ctx->BranchInst(bbAssign, bbTest, doRefill);
+    }
+
+    // bbAssign: hand out the next items to the idle program instances in
+    // order, so that the free program instance with the n-th lowest index
+    // gets the item next + n.
+    ctx->SetCurrentBasicBlock(bbAssign);
+    llvm::Value *refillMask = nullptr;
+    {
+        llvm::Value *next = ctx->LoadInst(nextPtrInfo, nullptr, "next_item");
+        llvm::Value *laneBits = ctx->BinaryOperator(
+            llvm::Instruction::Shl, LLVMInt64Vector((int64_t)1),
+            ctx->ZExtInst(ctx->ProgramIndexVector(), LLVMTypes::Int64VectorType), WrapSemantics::None, "lane_bits");
+        llvm::Value *lowerBits = ctx->BinaryOperator(llvm::Instruction::Sub, laneBits, LLVMInt64Vector((int64_t)1),
+                                                     WrapSemantics::None, "lower_lane_bits");
+        llvm::Value *freeSmear = ctx->SmearUniform(freeBits, "free_bits");
+        llvm::Value *freeBelow =
+            ctx->BinaryOperator(llvm::Instruction::And, freeSmear, lowerBits, WrapSemantics::None, "free_below");
+        llvm::Function *ctpopVec =
+            llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::ctpop, {LLVMTypes::Int64VectorType});
+        llvm::Value *rank = ctx->CallInst(ctpopVec, nullptr, freeBelow, "free_rank");
+        rank = ctx->TruncInst(rank, LLVMTypes::Int32VectorType, "free_rank32");
+        llvm::Value *item = ctx->BinaryOperator(llvm::Instruction::Add, ctx->SmearUniform(next, "next_item"), rank,
+                                                WrapSemantics::None, "item");
+
+        llvm::Value *isFree = ctx->BinaryOperator(llvm::Instruction::And, freeSmear, laneBits, WrapSemantics::None,
+                                                  "lane_free_bit");
+        isFree = ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, isFree, LLVMInt64Vector((int64_t)0),
+                              "lane_free");
+        llvm::Value *endSmear = ctx->SmearUniform(endValue, "end_item");
+        llvm::Value *inRange =
+            ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_SLT, item, endSmear, "in_range");
+        llvm::Value *refill =
+            ctx->BinaryOperator(llvm::Instruction::And, isFree, inRange, WrapSemantics::None, "refill_lanes");
+
+        llvm::Value *oldItem = ctx->LoadInst(sym->storageInfo, sym->type, "old_item");
+        ctx->StoreInst(ctx->SelectInst(refill, item, oldItem, "new_item"), sym->storageInfo, sym->type);
+
+        // All of the free program instances got an item, so skip over as
+        // many; the ones past the end are never run.
+        llvm::Function *ctpop =
+            llvm::Intrinsic::getDeclaration(m->module, llvm::Intrinsic::ctpop, {LLVMTypes::Int64Type});
+        llvm::Value *numFree = ctx->CallInst(ctpop, nullptr, freeBits, "num_free");
+        numFree = ctx->TruncInst(numFree, LLVMTypes::Int32Type, "num_free32");
+        ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Add, next, numFree, WrapSemantics::None, "new_next"),
+                       nextPtrInfo);
+
+        refillMask = ctx->I1VecToBoolVec(refill);
+        ctx->BranchInst(bbStart);
+    }
+
+    // bbStart: run the statements before the loop (and the loop
+    // initializer) for the new items.
+    ctx->SetCurrentBasicBlock(bbStart);
+    {
+        ctx->SetInternalMask(refillMask);
+        for (Stmt *s : prefix) {
+            lEmitDynamicPrefixStmt(ctx, s);
+        }
+        if (loop->init != nullptr) {
+            AssertPos(pos, llvm::dyn_cast<StmtList>(loop->init) == nullptr);
+            lEmitDynamicPrefixStmt(ctx, loop->init);
+        }
+        AssertPos(pos, ctx->GetCurrentBasicBlock() != nullptr);
+
+        llvm::Value *active = ctx->LoadInst(activePtrInfo, nullptr, "active_lanes");
+        ctx->StoreInst(ctx->BinaryOperator(llvm::Instruction::Or, active, refillMask, WrapSemantics::None,
+                                           "active|refill"),
+                       activePtrInfo);
+        ctx->BranchInst(bbTest);
+    }
+
+    // bbTest: we're done once no program instance has an item in flight;
+    // otherwise, run one iteration of the loop for the ones whose loop
+    // test is true.
+    ctx->SetCurrentBasicBlock(bbTest);
+    {
+        llvm::Value *active = ctx->LoadInst(activePtrInfo, nullptr, "active_lanes");
+        ctx->SetInternalMask(active);
+        ctx->BranchIfMaskAny(bbLoop, bbDone);
+    }
+
+    ctx->SetCurrentBasicBlock(bbLoop);
+    {
+        // Varying 'break's and the failed test turn the program instances
+        // off; the ones still on after the loop step stay in the loop.
+        ctx->StartLoop(bbBreakAll, bbStep, false);
+        llvm::Value *ltest = LLVMMaskAllOn;
+        if (loop->test != nullptr) {
+            ltest = loop->test->GetValue(ctx);
+        }
+        if (ltest == nullptr) {
+            Assert(m->errorCount > 0);
+            ctx->EndLoop();
+            ctx->EndScope();
+            return;
+        }
+        ctx->SetInternalMaskAnd(ctx->GetInternalMask(), ltest);
+        llvm::BasicBlock *bbBody = ctx->CreateBasicBlock("foreach_dynamic_body", bbLoop);
+        ctx->BranchIfMaskAny(bbBody, bbRetire);
+
+        ctx->SetCurrentBasicBlock(bbBody);
+        ctx->SetBlockEntryMask(ctx->GetFullMask());
+        if (!llvm::dyn_cast_or_null<StmtList>(loop->stmts)) {
+            ctx->StartScope();
+        }
+        if (loop->stmts) {
+            loop->stmts->EmitCode(ctx);
+        }
+        if (ctx->GetCurrentBasicBlock()) {
+            ctx->BranchInst(bbStep);
+        }
+        if (!llvm::dyn_cast_or_null<StmtList>(loop->stmts)) {
+            ctx->EndScope();
+        }
+
+        ctx->SetCurrentBasicBlock(bbStep);
+        ctx->RestoreContinuedLanes();
+        ctx->ClearBreakLanes();
+        if (loop->step) {
+            loop->step->EmitCode(ctx);
+        }
+        ctx->BranchInst(bbRetire);
+
+        // A 'break' under uniform control flow jumps here with all of the
+        // program instances of the iteration leaving the loop.
+        ctx->SetCurrentBasicBlock(bbBreakAll);
+        ctx->SetInternalMask(LLVMMaskAllOff);
+        ctx->BranchInst(bbRetire);
+    }
+
+    // bbRetire: the program instances that left the loop finish their
+    // items, and they are refilled afterwards.
+    ctx->SetCurrentBasicBlock(bbRetire);
+    {
+        llvm::Value *stillRunning = ctx->GetInternalMask();
+        ctx->EndLoop();
+        llvm::Value *active = ctx->LoadInst(activePtrInfo, nullptr, "active_lanes");
+        llvm::Value *retired = ctx->BinaryOperator(llvm::Instruction::And, active, ctx->NotOperator(stillRunning),
+                                                   WrapSemantics::None, "retired_lanes");
+        ctx->StoreInst(stillRunning, activePtrInfo);
+        ctx->SetInternalMask(retired);
+        ctx->BranchIfMaskAny(bbFinish, bbRefill);
+    }
+
+    ctx->SetCurrentBasicBlock(bbFinish);
+    {
+        for (Stmt *s : suffix) {
+            s->EmitCode(ctx);
+        }
+        AssertPos(pos, ctx->GetCurrentBasicBlock() != nullptr);
+        ctx->BranchInst(bbRefill);
+    }
+
+    ctx->SetCurrentBasicBlock(bbDone);
+    ctx->SetInternalMask(oldMask);
+    ctx->EndScope();
+}
+
+void ForeachDynamicStmt::Print(Indent &indent) const {
+    indent.PrintLn("ForeachDynamicStmt", pos);
+
+    indent.pushList(4);
+
+    indent.setNextLabel("iter symbol");
+    indent.Print();
+    if (sym != nullptr) {
+        printf("%s", sym->name.c_str());
+        if (sym->type != nullptr) {
+            printf(" %s", sym->type->GetString().c_str());
+        }
+    } else {
+        printf("NULL");
+    }
+    printf("\n");
+    indent.Done();
+
+    indent.setNextLabel("start");
+    if (startExpr != nullptr) {
+        startExpr->Print(indent);
+    } else {
+        indent.Print("NULL\n");
+        indent.Done();
+    }
+
+    indent.setNextLabel("end");
+    if (endExpr != nullptr) {
+        endExpr->Print(indent);
+    } else {
+        indent.Print("NULL\n");
+        indent.Done();
+    }
+
+    indent.setNextLabel("body");
+    if (stmts != nullptr) {
+        stmts->Print(indent);
+    } else {
+        indent.Print("NULL\n");
+        indent.Done();
+    }
+
+    indent.Done();
+}
+
+Stmt *ForeachDynamicStmt::TypeCheck() {
+    if (sym == nullptr || startExpr == nullptr || endExpr == nullptr) {
+        return nullptr;
+    }
+    const Type *startType = startExpr->GetType();
+    const Type *endType = endExpr->GetType();
+    if (startType == nullptr || endType == nullptr) {
+        return nullptr;
+    }
+    if (startType->IsDependentType() || endType->IsDependentType()) {
+        return this;
+    }
+
+    startExpr = TypeConvertExpr(startExpr, AtomicType::UniformInt32, "foreach_dynamic starting value");
+    endExpr = TypeConvertExpr(endExpr, AtomicType::UniformInt32, "foreach_dynamic ending value");
+    if (startExpr == nullptr || endExpr == nullptr) {
+        return nullptr;
+    }
+
+    std::vector<Stmt *> prefix, suffix;
+    ForStmt *loop = lSplitDynamicBody(stmts, &prefix, &suffix);
+    if (loop == nullptr) {
+        Error(pos, "The body of \"foreach_dynamic\" loop must have exactly one \"for\" or \"while\" loop "
+                   "at the top level.");
+        return nullptr;
+    }
+
+    DynamicBodyCheckInfo info;
+    WalkAST(stmts, lDynamicBodyPreFunc, lDynamicBodyPostFunc, &info);
+    bool anyErrors = info.foundErrors;
+
+    // The variables declared before the loop hold the state of the item of
+    // each program instance, so they have to be varying.
+    if (loop->init != nullptr) {
+        prefix.push_back(loop->init);
+    }
+    for (Stmt *s : prefix) {
+        DeclStmt *ds = llvm::dyn_cast<DeclStmt>(s);
+        if (ds == nullptr) {
+            continue;
+        }
+        for (const VariableDeclaration &var : ds->vars) {
+            const Type *type = var.sym ? var.sym->type : nullptr;
+            if (type == nullptr || type->IsDependentType()) {
+                continue;
+            }
+            if (var.sym->storageClass == SC_STATIC || type->IsVaryingType() == false) {
+                Error(var.sym->pos,
+                      "Only non-static varying variables can be declared before the loop of \"foreach_dynamic\", "
+                      "not \"%s\" of type \"%s\".",
+                      var.sym->name.c_str(), type->GetString().c_str());
+                anyErrors = true;
+            }
+        }
+    }
+
+    // The loop test is evaluated for every program instance separately.
+    if (loop->test != nullptr) {
+        const Type *testType = loop->test->GetType();
+        if (testType != nullptr && !testType->IsDependentType() && testType->IsUniformType()) {
+            loop->test = TypeConvertExpr(loop->test, AtomicType::VaryingBool, "\"foreach_dynamic\" loop test");
+            anyErrors |= (loop->test == nullptr);
+        }
+    }
+
+    return anyErrors ? nullptr : this;
+}
+
+void ForeachDynamicStmt::SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int> lAttr) {
+    Warning(pos, "'#pragma unroll/nounroll' ignored - not supported for foreach_dynamic loop.");
+}
+
+int ForeachDynamicStmt::EstimateCost() const { return COST_VARYING_LOOP; }
+
+void ForeachDynamicStmt::SetExpectAttribute(unsigned int flags) { expectAttribute |= flags; }
+
+ForeachDynamicStmt *ForeachDynamicStmt::Instantiate(TemplateInstantiation &templInst) const {
+    Symbol *instSym = templInst.InstantiateSymbol(sym);
+    Expr *instStart = startExpr ? startExpr->Instantiate(templInst) : nullptr;
+    Expr *instEnd = endExpr ? endExpr->Instantiate(templInst) : nullptr;
+    Stmt *instStmts = stmts ? stmts->Instantiate(templInst) : nullptr;
+
+    ForeachDynamicStmt *inst = new ForeachDynamicStmt(instSym, instStart, instEnd, instStmts, pos);
+    inst->loopAttribute = loopAttribute;
+    inst->expectAttribute = expectAttribute;
 
     return inst;
 }
@@ -2856,6 +4096,102 @@ static bool lSwitchASTPreVisit(ASTNode *node, void *d) {
     return true;
 }
 
+/** Returns true if the "switch" statement with the given condition and
+    labels should be lowered to a loop over the unique values of its
+    varying condition in the active program instances.  Each pass through
+    the loop runs a uniform switch on one of the values with the lanes that
+    have it, so the cost grows with the number of unique values rather
+    than with the number of "case" labels that the masked lowering of a
+    varying switch runs through. */
+static bool lUseSwitchUniqueDispatch(FunctionEmitContext *ctx, const Type *type, const SwitchVisitInfo &svi,
+                                     Stmt *stmts) {
+    if (type->IsUniformType() || ctx->emitXeHardwareMask() || g->opt.disableUniformControlFlow) {
+        return false;
+    }
+    if (g->opt.switchDispatchThreshold == 0 || (int)svi.caseBlocks.size() < g->opt.switchDispatchThreshold) {
+        return false;
+    }
+    // The uniform switch in the loop handles 'break' statements by jumping
+    // to the end of the pass, which is only valid if all the lanes of the
+    // pass execute them.
+    return lHasVaryingBreakOrContinue(stmts) == false;
+}
+
+/** Emit the loop over the unique values of the varying switch condition.
+    The labels of the switch have been collected in \c svi, with \c
+    bbCasesDone as the block after the last one, where each pass ends. */
+static void lEmitSwitchUniqueDispatch(FunctionEmitContext *ctx, llvm::Value *exprValue, const Type *type,
+                                      const SwitchVisitInfo &svi, llvm::BasicBlock *bbCasesDone,
+                                      llvm::BasicBlock *bbDone, Stmt *stmts) {
+    llvm::BasicBlock *bbFindNext = ctx->CreateBasicBlock("switch_find_next", ctx->GetCurrentBasicBlock());
+
+    // The passes run under a varying 'if', so that the 'return' statements
+    // in the cases only turn off the lanes that execute them, and the
+    // mask is restored accounting for them at the end.
+    llvm::Value *oldMask = ctx->GetInternalMask();
+    ctx->StartVaryingIf(oldMask);
+
+    // *maskBitsPtrInfo is the bitmask of the lanes that remain to be
+    // dispatched, and the value of the condition is kept in memory to
+    // extract the value of the first of them in each pass, as is done for
+    // foreach_unique.
+    AssertPos(ctx->GetDebugPos(), llvm::isa<llvm::VectorType>(exprValue->getType()));
+    AddressInfo *maskBitsPtrInfo = ctx->AllocaInst(LLVMTypes::Int64Type, "switch_mask_bits");
+    ctx->StoreInst(ctx->LaneMask(ctx->GetFullMask()), maskBitsPtrInfo);
+    AddressInfo *exprMem = ctx->AllocaInst(type, "switch_expr_mem");
+    ctx->StoreInst(exprValue, exprMem, type);
+    ctx->BranchInst(bbFindNext);
+
+    ctx->SetCurrentBasicBlock(bbFindNext);
+    llvm::Value *remainingBits = ctx->LoadInst(maskBitsPtrInfo, nullptr, "remaining_bits");
+    llvm::Function *cttzFunc = m->module->getFunction(builtin::__count_trailing_zeros_i64);
+    Assert(cttzFunc != nullptr);
+    llvm::Value *firstSet = ctx->CallInst(cttzFunc, nullptr, remainingBits, "first_set");
+    llvm::Value *exprVec = ctx->LoadInst(exprMem, type, "switch_expr_vec");
+    llvm::Value *uniqueValue =
+        llvm::ExtractElementInst::Create(exprVec, firstSet, "unique_value", ctx->GetCurrentBasicBlock());
+
+    // Run the pass with the lanes that were running at the start and
+    // have the selected value: oldMask & (smear(value) == exprValue)
+    llvm::Value *uniqueSmear = ctx->SmearUniform(uniqueValue, "unique_smear");
+    llvm::Value *matchingLanes =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_EQ, uniqueSmear, exprVec, "matching_lanes");
+    matchingLanes = ctx->I1VecToBoolVec(matchingLanes);
+    llvm::Value *passMask = ctx->BinaryOperator(llvm::Instruction::And, oldMask, matchingLanes, WrapSemantics::None,
+                                                "switch_pass_mask");
+    ctx->SetInternalMask(passMask);
+
+    // The switch itself is uniform, and jumps straight to the 'case'
+    // label of the value.
+    ctx->StartSwitch(true, bbCasesDone, false);
+    ctx->SetBlockEntryMask(ctx->GetFullMask());
+    ctx->SwitchInst(uniqueValue, svi.defaultBlock ? svi.defaultBlock : bbCasesDone, svi.caseBlocks, svi.nextBlock);
+
+    if (stmts != nullptr) {
+        stmts->EmitCode(ctx);
+    }
+
+    if (ctx->GetCurrentBasicBlock() != nullptr) {
+        ctx->BranchInst(bbCasesDone);
+    }
+
+    ctx->SetCurrentBasicBlock(bbCasesDone);
+    ctx->EndSwitch();
+
+    // Clear the lanes of this pass and go on with the next value, if any:
+    // remainingBits &= ~movmsk(passMask)
+    llvm::Value *notPassMaskMM = ctx->NotOperator(ctx->LaneMask(passMask));
+    llvm::Value *newRemaining = ctx->BinaryOperator(llvm::Instruction::And, remainingBits, notPassMaskMM,
+                                                    WrapSemantics::None, "new_remaining");
+    ctx->StoreInst(newRemaining, maskBitsPtrInfo);
+    llvm::Value *nonZero =
+        ctx->CmpInst(llvm::Instruction::ICmp, llvm::CmpInst::ICMP_NE, newRemaining, LLVMInt64(0), "remaining_ne_zero");
+    ctx->BranchInst(bbFindNext, bbDone, nonZero);
+
+    ctx->SetCurrentBasicBlock(bbDone);
+    ctx->EndIf();
+}
+
 void SwitchStmt::EmitCode(FunctionEmitContext *ctx) const {
     if (ctx->GetCurrentBasicBlock() == nullptr) {
         return;
@@ -2876,8 +4212,12 @@ void SwitchStmt::EmitCode(FunctionEmitContext *ctx) const {
     SwitchVisitInfo svi(ctx);
     WalkAST(stmts, lSwitchASTPreVisit, nullptr, &svi);
     // Record that the basic block following the last one created for a
-    // case/default is the block after the end of the switch statement.
-    svi.nextBlock[svi.lastBlock] = bbDone;
+    // case/default is the block after the end of the switch statement, or
+    // the end of the pass for the unique-value dispatch.
+    bool uniqueDispatch = lUseSwitchUniqueDispatch(ctx, type, svi, stmts);
+    llvm::BasicBlock *bbCasesDone =
+        uniqueDispatch ? ctx->CreateBasicBlock("switch_dispatch_next", svi.insertAfter) : bbDone;
+    svi.nextBlock[svi.lastBlock] = bbCasesDone;
 
     llvm::Value *exprValue = expr->GetValue(ctx);
     if (exprValue == nullptr) {
@@ -2885,6 +4225,11 @@ void SwitchStmt::EmitCode(FunctionEmitContext *ctx) const {
         return;
     }
 
+    if (uniqueDispatch) {
+        lEmitSwitchUniqueDispatch(ctx, exprValue, type, svi, bbCasesDone, bbDone, stmts);
+        return;
+    }
+
     bool isUniformCF = (type->IsUniformType() && lHasVaryingBreakOrContinue(stmts) == false);
     bool emulateUniform = false;
 #ifdef ISPC_XE_ENABLED
@@ -3244,6 +4589,413 @@ LabeledStmt *LabeledStmt::Instantiate(TemplateInstantiation &templInst) const {
     return new LabeledStmt(name.c_str(), instStmt, pos);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Fusion of adjacent foreach loops
+
+namespace {
+/** An access of an array, or of the memory that a pointer or a reference
+    points to, in the body of a "foreach" loop: the variable it goes
+    through and the indices, outermost first. */
+struct ForeachMemAccess {
+    Symbol *base;
+    std::vector<Expr *> indices;
+    bool isWrite;
+};
+
+/** What the body of a "foreach" loop reads and writes, see
+    lCanFuseForeach(). */
+struct ForeachFusionInfo {
+    std::vector<ForeachMemAccess> memAccesses;
+    std::set<Symbol *> varsRead, varsWritten;
+    // Accesses of memory that isn't indexed through a variable, e.g. "*p"
+    // or "p->x".
+    bool otherMemRead = false, otherMemWrite = false;
+    // The variables declared in the body and the arrays among them that
+    // are used other than with an index, which may be visible outside the
+    // body through a pointer.
+    std::set<Symbol *> declared, escaped;
+    // Why the loop can't be fused, if it can't.
+    const char *obstacle = nullptr;
+};
+} // namespace
+
+static bool lForeachFusionPreFunc(ASTNode *node, void *d);
+
+/** Returns true if the function call may be moved across the memory
+    accesses of another loop: it is a direct call of a function of the
+    standard library that doesn't take pointers or references. */
+static bool lIsFusibleCall(FunctionCallExpr *fce) {
+    FunctionSymbolExpr *fse = llvm::dyn_cast_or_null<FunctionSymbolExpr>(fce->func);
+    Symbol *sym = fse ? fse->GetBaseSymbol() : nullptr;
+    const FunctionType *ftype = sym ? CastType<FunctionType>(sym->type) : nullptr;
+    if (ftype == nullptr || fce->isLaunch || fce->isInvoke || ftype->GetNumParameters() == 0) {
+        return false;
+    }
+    std::string file = sym->pos.name != nullptr ? sym->pos.name : "";
+    const std::string stdlib = "stdlib.isph";
+    if (file.size() < stdlib.size() || file.compare(file.size() - stdlib.size(), stdlib.size(), stdlib) != 0) {
+        return false;
+    }
+    for (int i = 0; i < ftype->GetNumParameters(); ++i) {
+        const Type *paramType = ftype->GetParameterType(i);
+        if (paramType == nullptr || paramType->IsPointerType() || IsReferenceType(paramType)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Records the access of the given lvalue or value in \p info. */
+static void lAddForeachAccess(Expr *expr, bool isWrite, ForeachFusionInfo *info) {
+    std::vector<Expr *> indices;
+    Expr *e = expr;
+    while (e != nullptr) {
+        if (IndexExpr *ie = llvm::dyn_cast<IndexExpr>(e)) {
+            WalkAST(ie->index, lForeachFusionPreFunc, nullptr, info);
+            indices.push_back(ie->index);
+            const Type *baseType = ie->baseExpr ? ie->baseExpr->GetType() : nullptr;
+            if (baseType != nullptr && baseType->IsPointerType() && !llvm::isa<SymbolExpr>(ie->baseExpr)) {
+                // Indexing a pointer that was loaded from memory.
+                WalkAST(ie->baseExpr, lForeachFusionPreFunc, nullptr, info);
+                e = nullptr;
+                break;
+            }
+            e = ie->baseExpr;
+        } else if (MemberExpr *me = llvm::dyn_cast<MemberExpr>(e)) {
+            const Type *structType = me->expr ? me->expr->GetType() : nullptr;
+            if (structType == nullptr || structType->IsPointerType()) {
+                WalkAST(me->expr, lForeachFusionPreFunc, nullptr, info);
+                e = nullptr;
+                break;
+            }
+            // The members of a struct are treated as the struct itself.
+            e = me->expr;
+        } else {
+            break;
+        }
+    }
+    std::reverse(indices.begin(), indices.end());
+
+    RefDerefExpr *rde = llvm::dyn_cast_or_null<RefDerefExpr>(e);
+    SymbolExpr *se = llvm::dyn_cast_or_null<SymbolExpr>(rde ? rde->expr : e);
+    Symbol *sym = se ? se->GetBaseSymbol() : nullptr;
+    if (sym == nullptr || sym->type == nullptr) {
+        if (isWrite) {
+            info->otherMemWrite = true;
+        }
+        info->otherMemRead = true;
+        DerefExpr *de = llvm::dyn_cast_or_null<DerefExpr>(e);
+        WalkAST(de ? de->expr : e, lForeachFusionPreFunc, nullptr, info);
+    } else if (IsReferenceType(sym->type) || sym->type->IsArrayType() ||
+               (sym->type->IsPointerType() && !indices.empty())) {
+        info->memAccesses.push_back({sym, indices, isWrite});
+        if (sym->type->IsPointerType()) {
+            info->varsRead.insert(sym);
+        }
+        if (sym->type->IsArrayType() && indices.empty()) {
+            info->escaped.insert(sym);
+        }
+    } else {
+        (isWrite ? info->varsWritten : info->varsRead).insert(sym);
+    }
+}
+
+static bool lForeachFusionPreFunc(ASTNode *node, void *d) {
+    ForeachFusionInfo *info = (ForeachFusionInfo *)d;
+    if (node == nullptr || info->obstacle != nullptr) {
+        return false;
+    }
+
+    if (llvm::isa<ContinueStmt>(node) || llvm::isa<BreakStmt>(node) || llvm::isa<ReturnStmt>(node) ||
+        llvm::isa<GotoStmt>(node) || llvm::isa<LabeledStmt>(node)) {
+        info->obstacle = "it has a \"continue\", \"break\", \"return\" or \"goto\" statement";
+        return false;
+    }
+    if (llvm::isa<PrintStmt>(node) || llvm::isa<DeleteStmt>(node) || llvm::isa<NewExpr>(node) ||
+        llvm::isa<AllocaExpr>(node) || llvm::isa<SyncExpr>(node)) {
+        info->obstacle = "it prints, allocates or frees memory or waits for tasks";
+        return false;
+    }
+    if (llvm::isa<AddressOfExpr>(node) || llvm::isa<ReferenceExpr>(node)) {
+        info->obstacle = "it takes the address of a variable";
+        return false;
+    }
+    if (FunctionCallExpr *fce = llvm::dyn_cast<FunctionCallExpr>(node)) {
+        if (!lIsFusibleCall(fce)) {
+            info->obstacle = "it calls a function that may access memory";
+            return false;
+        }
+        return true;
+    }
+    if (DeclStmt *ds = llvm::dyn_cast<DeclStmt>(node)) {
+        for (const VariableDeclaration &var : ds->vars) {
+            info->declared.insert(var.sym);
+        }
+        return true;
+    }
+    if (AssignExpr *ae = llvm::dyn_cast<AssignExpr>(node)) {
+        lAddForeachAccess(ae->lvalue, true, info);
+        WalkAST(ae->rvalue, lForeachFusionPreFunc, nullptr, info);
+        return false;
+    }
+    UnaryExpr *ue = llvm::dyn_cast<UnaryExpr>(node);
+    if (ue != nullptr && (ue->op == UnaryExpr::PreInc || ue->op == UnaryExpr::PreDec ||
+                          ue->op == UnaryExpr::PostInc || ue->op == UnaryExpr::PostDec)) {
+        lAddForeachAccess(ue->expr, true, info);
+        return false;
+    }
+    if (llvm::isa<IndexExpr>(node) || llvm::isa<MemberExpr>(node) || llvm::isa<DerefExpr>(node) ||
+        llvm::isa<SymbolExpr>(node)) {
+        lAddForeachAccess(llvm::cast<Expr>(node), false, info);
+        return false;
+    }
+    return true;
+}
+
+/** Returns true if the expression is uniform and only uses constants and
+    variables that aren't in \p written. */
+static bool lIsFusionInvariant(Expr *expr, const std::set<Symbol *> &written) {
+    const Type *type = expr ? expr->GetType() : nullptr;
+    if (type == nullptr || !type->IsUniformType()) {
+        return false;
+    }
+    if (llvm::isa<ConstExpr>(expr)) {
+        return true;
+    }
+    if (SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(expr)) {
+        Symbol *sym = se->GetBaseSymbol();
+        return sym != nullptr && sym->type != nullptr && sym->type->IsAtomicType() && written.count(sym) == 0;
+    }
+    if (TypeCastExpr *tce = llvm::dyn_cast<TypeCastExpr>(expr)) {
+        return lIsFusionInvariant(tce->expr, written);
+    }
+    if (BinaryExpr *be = llvm::dyn_cast<BinaryExpr>(expr)) {
+        return lIsFusionInvariant(be->arg0, written) && lIsFusionInvariant(be->arg1, written);
+    }
+    return false;
+}
+
+/** Returns the index of the loop variable in \p dims if the expression is
+    a loop variable, possibly plus or minus an invariant value, or -1
+    otherwise. */
+static int lGetFusionIndexDim(Expr *expr, const std::vector<Symbol *> &dims, const std::set<Symbol *> &written) {
+    if (TypeCastExpr *tce = llvm::dyn_cast_or_null<TypeCastExpr>(expr)) {
+        // Only conversions that keep the values distinct.
+        const AtomicType *at = CastType<AtomicType>(tce->GetType());
+        if (at == nullptr || (at->basicType != AtomicType::TYPE_INT32 && at->basicType != AtomicType::TYPE_UINT32 &&
+                              at->basicType != AtomicType::TYPE_INT64 && at->basicType != AtomicType::TYPE_UINT64)) {
+            return -1;
+        }
+        return lGetFusionIndexDim(tce->expr, dims, written);
+    }
+    if (SymbolExpr *se = llvm::dyn_cast_or_null<SymbolExpr>(expr)) {
+        auto iter = std::find(dims.begin(), dims.end(), se->GetBaseSymbol());
+        return iter != dims.end() ? (int)(iter - dims.begin()) : -1;
+    }
+    BinaryExpr *be = llvm::dyn_cast_or_null<BinaryExpr>(expr);
+    if (be != nullptr && (be->op == BinaryExpr::Add || be->op == BinaryExpr::Sub)) {
+        if (lIsFusionInvariant(be->arg1, written)) {
+            return lGetFusionIndexDim(be->arg0, dims, written);
+        }
+        if (be->op == BinaryExpr::Add && lIsFusionInvariant(be->arg0, written)) {
+            return lGetFusionIndexDim(be->arg1, dims, written);
+        }
+    }
+    return -1;
+}
+
+/** Returns true if the indices select a different element for each
+    iteration of the loop with the loop variables \p dims. */
+static bool lIsInjectiveIndexing(const std::vector<Expr *> &indices, const std::vector<Symbol *> &dims,
+                                 const std::set<Symbol *> &written) {
+    std::vector<bool> used(dims.size(), false);
+    for (Expr *index : indices) {
+        int dim = lGetFusionIndexDim(index, dims, written);
+        if (dim >= 0) {
+            if (used[dim]) {
+                return false;
+            }
+            used[dim] = true;
+        } else if (!lIsFusionInvariant(index, written)) {
+            return false;
+        }
+    }
+    return std::find(used.begin(), used.end(), false) == used.end();
+}
+
+/** Returns true if the expressions are the same, with the variables of
+    \p b replaced by the ones they are mapped to in \p symbolMap. */
+static bool lIsSameFusionExpr(Expr *a, Expr *b, const std::map<Symbol *, Symbol *> &symbolMap) {
+    if (a == nullptr || b == nullptr || a->getValueID() != b->getValueID()) {
+        return false;
+    }
+    if (SymbolExpr *sa = llvm::dyn_cast<SymbolExpr>(a)) {
+        Symbol *sb = llvm::cast<SymbolExpr>(b)->GetBaseSymbol();
+        auto iter = symbolMap.find(sb);
+        return sa->GetBaseSymbol() == (iter != symbolMap.end() ? iter->second : sb);
+    }
+    if (ConstExpr *ca = llvm::dyn_cast<ConstExpr>(a)) {
+        ConstExpr *cb = llvm::cast<ConstExpr>(b);
+        if (!Type::Equal(ca->GetType(), cb->GetType()) || !ca->GetType()->IsIntType() || ca->Count() != cb->Count()) {
+            return false;
+        }
+        int64_t va[ISPC_MAX_NVEC], vb[ISPC_MAX_NVEC];
+        int count = ca->GetValues(va);
+        cb->GetValues(vb);
+        return std::equal(va, va + count, vb);
+    }
+    if (TypeCastExpr *ta = llvm::dyn_cast<TypeCastExpr>(a)) {
+        TypeCastExpr *tb = llvm::cast<TypeCastExpr>(b);
+        return Type::Equal(ta->GetType(), tb->GetType()) && lIsSameFusionExpr(ta->expr, tb->expr, symbolMap);
+    }
+    if (BinaryExpr *ba = llvm::dyn_cast<BinaryExpr>(a)) {
+        BinaryExpr *bb = llvm::cast<BinaryExpr>(b);
+        return ba->op == bb->op && lIsSameFusionExpr(ba->arg0, bb->arg0, symbolMap) &&
+               lIsSameFusionExpr(ba->arg1, bb->arg1, symbolMap);
+    }
+    return false;
+}
+
+/** Returns nullptr if the "foreach" loop \p second, which immediately
+    follows \p first, can be fused with it, so that each iteration runs
+    the body of \p second right after the one of \p first, or why it can't
+    otherwise.  The loops must have the same domain, and an element of
+    memory that one of them writes may only be accessed by the other in
+    the same iteration. */
+static const char *lCanFuseForeach(ForeachStmt *first, ForeachStmt *second) {
+    if (first->isTiled != second->isTiled || first->dimVariables.size() != second->dimVariables.size() ||
+        first->startExprs.size() != first->dimVariables.size() ||
+        second->startExprs.size() != second->dimVariables.size() ||
+        first->endExprs.size() != first->dimVariables.size() ||
+        second->endExprs.size() != second->dimVariables.size()) {
+        return "the loops have different domains";
+    }
+    if (first->loopAttribute != second->loopAttribute || first->expectAttribute != second->expectAttribute ||
+        first->cacheBlockLevel != second->cacheBlockLevel || !second->vectorizeDim.empty()) {
+        return "the loops have different pragmas";
+    }
+
+    ForeachFusionInfo info[2];
+    WalkAST(first->stmts, lForeachFusionPreFunc, nullptr, &info[0]);
+    WalkAST(second->stmts, lForeachFusionPreFunc, nullptr, &info[1]);
+    for (const ForeachFusionInfo &i : info) {
+        if (i.obstacle != nullptr) {
+            return i.obstacle;
+        }
+    }
+
+    std::set<Symbol *> written = info[0].varsWritten;
+    written.insert(info[1].varsWritten.begin(), info[1].varsWritten.end());
+
+    // The loop variables of the second loop are mapped to the ones of the
+    // first loop in the same position.
+    std::map<Symbol *, Symbol *> symbolMap;
+    for (size_t i = 0; i < first->dimVariables.size(); ++i) {
+        symbolMap[second->dimVariables[i]] = first->dimVariables[i];
+        if (!lIsSameFusionExpr(first->startExprs[i], second->startExprs[i], symbolMap) ||
+            !lIsSameFusionExpr(first->endExprs[i], second->endExprs[i], symbolMap) ||
+            !lIsFusionInvariant(first->startExprs[i], written) || !lIsFusionInvariant(first->endExprs[i], written)) {
+            return "the loops have different domains";
+        }
+    }
+
+    // Variables that one loop assigns can't be used by the other one.
+    for (int l = 0; l < 2; ++l) {
+        for (Symbol *sym : info[l].varsWritten) {
+            if (info[1 - l].varsRead.count(sym) != 0 || info[1 - l].varsWritten.count(sym) != 0) {
+                return "a variable that one of the loops assigns is used by the other one";
+            }
+        }
+    }
+
+    // The arrays that are declared in one of the loop bodies and are only
+    // accessed with an index there can't be accessed by the other one.
+    auto isPrivate = [&info](Symbol *sym) {
+        for (const ForeachFusionInfo &i : info) {
+            if (i.declared.count(sym) != 0 && i.escaped.count(sym) == 0 && sym->type->IsArrayType()) {
+                return true;
+            }
+        }
+        return false;
+    };
+    bool anyMemWrite[2] = {false, false}, anyMemAccess[2] = {false, false};
+    for (int l = 0; l < 2; ++l) {
+        anyMemWrite[l] = info[l].otherMemWrite;
+        anyMemAccess[l] = info[l].otherMemRead || info[l].otherMemWrite;
+        for (const ForeachMemAccess &access : info[l].memAccesses) {
+            if (!isPrivate(access.base)) {
+                anyMemWrite[l] |= access.isWrite;
+                anyMemAccess[l] = true;
+            }
+        }
+    }
+    if ((info[0].otherMemWrite && anyMemAccess[1]) || (info[1].otherMemWrite && anyMemAccess[0]) ||
+        (info[0].otherMemRead && anyMemWrite[1]) || (info[1].otherMemRead && anyMemWrite[0])) {
+        return "one of the loops accesses memory through a pointer that isn't indexed";
+    }
+
+    // With '#pragma fuse', the different arrays and pointers are taken not
+    // to overlap.
+    bool distinctBases = second->fuseAttribute == ForeachStmt::FuseAttribute::Fuse;
+    for (const ForeachMemAccess &a : info[0].memAccesses) {
+        if (isPrivate(a.base)) {
+            continue;
+        }
+        for (const ForeachMemAccess &b : info[1].memAccesses) {
+            if ((!a.isWrite && !b.isWrite) || isPrivate(b.base)) {
+                continue;
+            }
+            if (a.base != b.base) {
+                if (!distinctBases) {
+                    return "different arrays or pointers that one of the loops writes and the other one uses may "
+                           "overlap";
+                }
+                continue;
+            }
+            if (a.indices.size() != b.indices.size() ||
+                !lIsInjectiveIndexing(a.indices, first->dimVariables, written)) {
+                return "an array that one of the loops writes is used by the other one with another index";
+            }
+            for (size_t i = 0; i < a.indices.size(); ++i) {
+                if (!lIsSameFusionExpr(a.indices[i], b.indices[i], symbolMap)) {
+                    return "an array that one of the loops writes is used by the other one with another index";
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+static ASTNode *lReplaceLoopVariablesPostFunc(ASTNode *node, void *d) {
+    const std::map<Symbol *, Symbol *> *symbolMap = (const std::map<Symbol *, Symbol *> *)d;
+    SymbolExpr *se = llvm::dyn_cast<SymbolExpr>(node);
+    if (se != nullptr) {
+        auto iter = symbolMap->find(se->GetBaseSymbol());
+        if (iter != symbolMap->end()) {
+            return new SymbolExpr(iter->second, se->pos);
+        }
+    }
+    return node;
+}
+
+/** Fuses the "foreach" loop \p second into \p first, which it immediately
+    follows: the body of \p first is followed by the one of \p second,
+    with the loop variables of \p first in place of its own. */
+static void lFuseForeach(ForeachStmt *first, ForeachStmt *second) {
+    std::map<Symbol *, Symbol *> symbolMap;
+    for (size_t i = 0; i < second->dimVariables.size(); ++i) {
+        symbolMap[second->dimVariables[i]] = first->dimVariables[i];
+    }
+
+    StmtList *body = new StmtList(first->pos);
+    body->Add(first->stmts);
+    body->Add((Stmt *)WalkAST(second->stmts, nullptr, lReplaceLoopVariablesPostFunc, &symbolMap));
+
+    first->stmts = body;
+    first->fusedLoops.push_back(second->pos);
+    first->fusedLoops.insert(first->fusedLoops.end(), second->fusedLoops.begin(), second->fusedLoops.end());
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // StmtList
 
@@ -3258,6 +5010,36 @@ void StmtList::EmitCode(FunctionEmitContext *ctx) const {
     ctx->EndScope();
 }
 
+Stmt *StmtList::Optimize() {
+    if (g->opt.level == 0 || g->opt.disableForeachFusion) {
+        return this;
+    }
+
+    // Adjacent "foreach" loops over the same domain are fused, so that the
+    // values that one of them stores and the next one loads can stay in
+    // registers rather than going through memory.
+    std::vector<Stmt *> newStmts;
+    for (Stmt *stmt : stmts) {
+        ForeachStmt *fs = llvm::dyn_cast_or_null<ForeachStmt>(stmt);
+        if (fs != nullptr && fs->fuseAttribute != ForeachStmt::FuseAttribute::NoFuse) {
+            ForeachStmt *prev = newStmts.empty() ? nullptr : llvm::dyn_cast_or_null<ForeachStmt>(newStmts.back());
+            const char *obstacle =
+                prev != nullptr ? lCanFuseForeach(prev, fs) : "there is no \"foreach\" loop right before it";
+            if (obstacle == nullptr) {
+                lFuseForeach(prev, fs);
+                continue;
+            }
+            if (fs->fuseAttribute == ForeachStmt::FuseAttribute::Fuse) {
+                Warning(fs->pos, "'#pragma fuse' ignored: the loop can't be fused with the preceding one, since %s.",
+                        obstacle);
+            }
+        }
+        newStmts.push_back(stmt);
+    }
+    stmts = newStmts;
+    return this;
+}
+
 Stmt *StmtList::TypeCheck() { return this; }
 
 int StmtList::EstimateCost() const { return 0; }
@@ -41,6 +41,14 @@ class Stmt : public ASTNode {
     virtual Stmt *Instantiate(TemplateInstantiation &templInst) const = 0;
 
     virtual void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    virtual void SetCacheBlockAttribute(int cacheLevel);
+    virtual void SetVectorizeDimAttribute(const std::string &dimName);
+    virtual void SetFuseAttribute(bool fuse);
+    virtual void SetExpectAttribute(unsigned int flags);
+
+    /** Globals::pragmaExpectType flags of the '#pragma ispc expect_no_*'
+        directives of a loop, or of the function that this is the body of. */
+    unsigned int expectAttribute = 0;
 };
 
 /** @brief Statement representing a single expression */
@@ -114,6 +122,9 @@ class IfStmt : public Stmt {
     Stmt *trueStmts;
     /** Statements to run if the 'if' test returns a false value */
     Stmt *falseStmts;
+    /** Set if the statement is in a foreach loop and its varying test
+        is likely coherent, so that it's emitted like a 'cif' statement. */
+    bool inferredCoherent = false;
 
   private:
     /** This value records if this was a 'coherent' if statement in the
@@ -147,6 +158,7 @@ class DoStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
     int EstimateCost() const;
     DoStmt *Instantiate(TemplateInstantiation &templInst) const;
 
@@ -174,9 +186,16 @@ class ForStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
     int EstimateCost() const;
     ForStmt *Instantiate(TemplateInstantiation &templInst) const;
 
+    /** If the loop only launches the same task function with different
+        arguments in each iteration, emit it as a single two-dimensional
+        launch, where taskIndex1 enumerates the iterations, and return
+        true. */
+    bool emitFusedLaunch(FunctionEmitContext *ctx) const;
+
     /** 'for' statment initializer; may be nullptr, indicating no intitializer */
     Stmt *init;
     /** expression that returns a value indicating whether the loop should
@@ -244,6 +263,25 @@ class ForeachStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
+    /** The data cache level (1 or 2) the loop nest is blocked for with
+        '#pragma cache_block', or 0 if it isn't blocked. */
+    int cacheBlockLevel = 0;
+    void SetCacheBlockAttribute(int cacheLevel);
+    /** The loop variable of the dimension to vectorize, given with
+        '#pragma vectorize_dim', or empty to choose it from the accesses
+        in the loop body. */
+    std::string vectorizeDim;
+    void SetVectorizeDimAttribute(const std::string &dimName);
+    /** Whether the loop is fused with the preceding "foreach" loop when
+        possible (Default), even if different arrays it uses may overlap
+        (Fuse, '#pragma fuse') or never (NoFuse, '#pragma nofuse'). */
+    enum class FuseAttribute { Default, Fuse, NoFuse };
+    FuseAttribute fuseAttribute = FuseAttribute::Default;
+    void SetFuseAttribute(bool fuse);
+    /** The positions of the loops that were fused into this one, for the
+        optimization report. */
+    std::vector<SourcePos> fusedLoops;
     int EstimateCost() const;
     ForeachStmt *Instantiate(TemplateInstantiation &templInst) const;
 
@@ -252,6 +290,9 @@ class ForeachStmt : public Stmt {
     std::vector<Expr *> endExprs;
     bool isTiled;
     Stmt *stmts;
+
+  private:
+    void chooseVectorizedDim();
 };
 
 /** Iteration over each executing program instance.
@@ -270,6 +311,7 @@ class ForeachActiveStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
     int EstimateCost() const;
     ForeachActiveStmt *Instantiate(TemplateInstantiation &templInst) const;
 
@@ -295,6 +337,7 @@ class ForeachUniqueStmt : public Stmt {
     std::pair<Globals::pragmaUnrollType, int> loopAttribute =
         std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
     void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
     int EstimateCost() const;
     ForeachUniqueStmt *Instantiate(TemplateInstantiation &templInst) const;
 
@@ -303,6 +346,35 @@ class ForeachUniqueStmt : public Stmt {
     Stmt *stmts;
 };
 
+/** Parallel iteration over a range of work items, where the program
+    instances that are done with their item are refilled with the next ones.
+    The body has a single top-level "for" or "while" loop: the statements
+    before it start an item, and the statements after it finish one.
+ */
+class ForeachDynamicStmt : public Stmt {
+  public:
+    ForeachDynamicStmt(Symbol *sym, Expr *startExpr, Expr *endExpr, Stmt *stmts, SourcePos pos);
+
+    static inline bool classof(ForeachDynamicStmt const *) { return true; }
+    static inline bool classof(ASTNode const *N) { return N->getValueID() == ForeachDynamicStmtID; }
+
+    void EmitCode(FunctionEmitContext *ctx) const;
+    void Print(Indent &indent) const;
+
+    Stmt *TypeCheck();
+    std::pair<Globals::pragmaUnrollType, int> loopAttribute =
+        std::pair<Globals::pragmaUnrollType, int>(Globals::pragmaUnrollType::none, -1);
+    void SetLoopAttribute(std::pair<Globals::pragmaUnrollType, int>);
+    void SetExpectAttribute(unsigned int flags);
+    int EstimateCost() const;
+    ForeachDynamicStmt *Instantiate(TemplateInstantiation &templInst) const;
+
+    Symbol *sym;
+    Expr *startExpr;
+    Expr *endExpr;
+    Stmt *stmts;
+};
+
 /**
  */
 class UnmaskedStmt : public Stmt {
@@ -459,6 +531,7 @@ class StmtList : public Stmt {
     void EmitCode(FunctionEmitContext *ctx) const;
     void Print(Indent &indent) const;
 
+    Stmt *Optimize();
     Stmt *TypeCheck();
     int EstimateCost() const;
     StmtList *Instantiate(TemplateInstantiation &templInst) const;
@@ -39,6 +39,20 @@ TemplateSymbol::TemplateSymbol(const TemplateParms *parms, const std::string &n,
 ///////////////////////////////////////////////////////////////////////////
 // SymbolTable
 
+/** Returns the names of the entries of a scope in alphabetical order, so
+    that the suggestions for misspelled names and the debug output don't
+    depend on the order of the hash table. */
+template <typename MapType>
+static std::vector<std::string> lSortedNames(const MapType &scope, const std::vector<llvm::StringRef> &names) {
+    std::vector<std::string> result;
+    result.reserve(scope.size());
+    for (const auto &entry : scope) {
+        result.push_back(names[entry.first].str());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
 SymbolTable::SymbolTable() { PushScope(); }
 
 SymbolTable::~SymbolTable() {
@@ -59,12 +73,29 @@ SymbolTable::~SymbolTable() {
     }
 }
 
+SymbolTable::NameID SymbolTable::internName(llvm::StringRef name) {
+    auto result = nameIDs.try_emplace(name, (NameID)names.size());
+    if (result.second) {
+        names.push_back(result.first->getKey());
+    }
+    return result.first->second;
+}
+
+bool SymbolTable::findName(llvm::StringRef name, NameID *id) const {
+    auto iter = nameIDs.find(name);
+    if (iter == nameIDs.end()) {
+        return false;
+    }
+    *id = iter->second;
+    return true;
+}
+
 void SymbolTable::PushScope() {
     SymbolMapType *sm = nullptr;
     if (freeSymbolMaps.size() > 0) {
         sm = freeSymbolMaps.back();
         freeSymbolMaps.pop_back();
-        sm->erase(sm->begin(), sm->end());
+        sm->clear();
     } else {
         sm = new SymbolMapType;
     }
@@ -87,13 +118,44 @@ void SymbolTable::PopInnerScopes() {
     }
 }
 
+void SymbolTable::SuspendInnerScopes() {
+    Assert(suspendedVariables.empty() && suspendedTypes.empty());
+    suspendedVariables.assign(variables.begin() + 1, variables.end());
+    suspendedTypes.assign(types.begin() + 1, types.end());
+    variables.resize(1);
+    types.resize(1);
+}
+
+void SymbolTable::ResumeInnerScopes() {
+    Assert(variables.size() == 1 && types.size() == 1);
+    variables.insert(variables.end(), suspendedVariables.begin(), suspendedVariables.end());
+    types.insert(types.end(), suspendedTypes.begin(), suspendedTypes.end());
+    suspendedVariables.clear();
+    suspendedTypes.clear();
+}
+
+bool SymbolTable::IsLocalVariable(const Symbol *symbol) const {
+    NameID id;
+    if (!findName(symbol->name, &id)) {
+        return false;
+    }
+    for (int i = (int)variables.size() - 1; i > 0; --i) {
+        SymbolMapType::const_iterator iter = variables[i]->find(id);
+        if (iter != variables[i]->end()) {
+            return iter->second == symbol;
+        }
+    }
+    return false;
+}
+
 bool SymbolTable::AddVariable(Symbol *symbol) {
     Assert(symbol != nullptr);
+    NameID id = internName(symbol->name);
 
     // Check to see if a symbol of the same name has already been declared.
     for (int i = (int)variables.size() - 1; i >= 0; --i) {
         SymbolMapType &sm = *(variables[i]);
-        if (sm.find(symbol->name) != sm.end()) {
+        if (sm.find(id) != sm.end()) {
             if (i == (int)variables.size() - 1) {
                 // If a symbol of the same name was declared in the
                 // same scope, it's an error.
@@ -103,14 +165,14 @@ bool SymbolTable::AddVariable(Symbol *symbol) {
                 // Otherwise it's just shadowing something else, which
                 // is legal but dangerous..
                 Warning(symbol->pos, "Symbol \"%s\" shadows symbol declared in outer scope.", symbol->name.c_str());
-                (*variables.back())[symbol->name] = symbol;
+                (*variables.back())[id] = symbol;
                 return true;
             }
         }
     }
 
     // No matches, so go ahead and add it...
-    (*variables.back())[symbol->name] = symbol;
+    (*variables.back())[id] = symbol;
     return true;
 }
 
@@ -119,9 +181,13 @@ Symbol *SymbolTable::LookupVariable(const char *name) {
     // we want to search from the innermost scope to the outermost, so that
     // we get the right symbol if we have multiple variables in different
     // scopes that shadow each other.
+    NameID id;
+    if (!findName(name, &id)) {
+        return nullptr;
+    }
     for (int i = (int)variables.size() - 1; i >= 0; --i) {
         SymbolMapType &sm = *(variables[i]);
-        SymbolMapType::iterator iter = sm.find(name);
+        SymbolMapType::iterator iter = sm.find(id);
         if (iter != sm.end()) {
             return iter->second;
         }
@@ -139,17 +205,27 @@ bool SymbolTable::AddFunction(Symbol *symbol) {
     }
 
     std::vector<Symbol *> &funOverloads = functions[symbol->name];
+    overloads[internName(symbol->name)] = &funOverloads;
     funOverloads.push_back(symbol);
     return true;
 }
 
+std::vector<Symbol *> *SymbolTable::lookupOverloads(const char *name) const {
+    NameID id;
+    if (!findName(name, &id)) {
+        return nullptr;
+    }
+    auto iter = overloads.find(id);
+    return iter != overloads.end() ? iter->second : nullptr;
+}
+
 bool SymbolTable::LookupFunction(const char *name, std::vector<Symbol *> *matches) {
-    FunctionMapType::iterator iter = functions.find(name);
-    if (iter != functions.end()) {
+    const std::vector<Symbol *> *overloadSet = lookupOverloads(name);
+    if (overloadSet != nullptr) {
         if (matches == nullptr) {
             return true;
         } else {
-            const std::vector<Symbol *> &funcs = iter->second;
+            const std::vector<Symbol *> &funcs = *overloadSet;
             for (int j = 0; j < (int)funcs.size(); ++j) {
                 matches->push_back(funcs[j]);
             }
@@ -159,9 +235,9 @@ bool SymbolTable::LookupFunction(const char *name, std::vector<Symbol *> *matche
 }
 
 Symbol *SymbolTable::LookupFunction(const char *name, const FunctionType *type) {
-    FunctionMapType::iterator iter = functions.find(name);
-    if (iter != functions.end()) {
-        std::vector<Symbol *> funcs = iter->second;
+    const std::vector<Symbol *> *overloadSet = lookupOverloads(name);
+    if (overloadSet != nullptr) {
+        const std::vector<Symbol *> &funcs = *overloadSet;
         for (int j = 0; j < (int)funcs.size(); ++j) {
             if (Type::Equal(funcs[j]->type, type)) {
                 return funcs[j];
@@ -198,13 +274,17 @@ bool SymbolTable::AddFunctionTemplate(TemplateSymbol *templ) {
         return false;
     }
 
-    std::vector<TemplateSymbol *> &funTemplOverloads = functionTemplates[templ->name];
+    std::vector<TemplateSymbol *> &funTemplOverloads = functionTemplates[internName(templ->name)];
     funTemplOverloads.push_back(templ);
     return true;
 }
 
 bool SymbolTable::LookupFunctionTemplate(const std::string &name, std::vector<TemplateSymbol *> *matches) {
-    FunctionTemplateMapType::iterator iter = functionTemplates.find(name);
+    NameID id;
+    FunctionTemplateMapType::iterator iter = functionTemplates.end();
+    if (findName(name, &id)) {
+        iter = functionTemplates.find(id);
+    }
     if (iter != functionTemplates.end()) {
         if (matches == nullptr) {
             return true;
@@ -222,9 +302,13 @@ TemplateSymbol *SymbolTable::LookupFunctionTemplate(const TemplateParms *templat
     // The template declaration matches if:
     // - template paramters list matches
     // - function types match
-    FunctionTemplateMapType::iterator iter = functionTemplates.find(name);
+    NameID id;
+    FunctionTemplateMapType::iterator iter = functionTemplates.end();
+    if (findName(name, &id)) {
+        iter = functionTemplates.find(id);
+    }
     if (iter != functionTemplates.end()) {
-        std::vector<TemplateSymbol *> templs = iter->second;
+        const std::vector<TemplateSymbol *> &templs = iter->second;
         for (auto templ : templs) {
             if (templateParmList->IsEqual(templ->templateParms) && Type::Equal(templ->type, type)) {
                 return templ;
@@ -247,14 +331,18 @@ bool SymbolTable::AddType(const char *name, const Type *type, SourcePos pos) {
 
     Assert(types.size() > 0);
 
-    types.back()[name] = type;
+    types.back()[internName(name)] = type;
     return true;
 }
 
 const Type *SymbolTable::LookupType(const char *name) const {
     // Again, search through the type maps backward to get scoping right.
+    NameID id;
+    if (!findName(name, &id)) {
+        return nullptr;
+    }
     for (std::vector<TypeMapType>::const_reverse_iterator it = types.rbegin(); it != types.rend(); it++) {
-        TypeMapType::const_iterator type_it = it->find(name);
+        TypeMapType::const_iterator type_it = it->find(id);
         if (type_it != it->end()) {
             return type_it->second;
         }
@@ -266,7 +354,11 @@ const Type *SymbolTable::LookupLocalType(const char *name) const {
 
     Assert(types.size() > 0);
 
-    auto result = types.back().find(name);
+    NameID id;
+    if (!findName(name, &id)) {
+        return nullptr;
+    }
+    auto result = types.back().find(id);
     if (result == types.back().end()) {
         return nullptr;
     } else {
@@ -276,7 +368,7 @@ const Type *SymbolTable::LookupLocalType(const char *name) const {
 
 bool SymbolTable::ContainsType(const Type *type) const {
     for (const TypeMapType &typeMap : types) {
-        for (const std::pair<const std::string, const Type *> &entry : typeMap) {
+        for (const std::pair<const NameID, const Type *> &entry : typeMap) {
             if (entry.second == type) {
                 return true;
             }
@@ -295,13 +387,10 @@ std::vector<std::string> SymbolTable::ClosestVariableOrFunctionMatch(const char
     std::vector<std::string> matches[maxDelta + 1];
 
     for (int i = 0; i < (int)variables.size(); ++i) {
-        const SymbolMapType &sv = *(variables[i]);
-        SymbolMapType::const_iterator iter;
-        for (iter = sv.begin(); iter != sv.end(); ++iter) {
-            const Symbol *sym = iter->second;
-            int dist = StringEditDistance(str, sym->name, maxDelta + 1);
+        for (const std::string &name : lSortedNames(*variables[i], names)) {
+            int dist = StringEditDistance(str, name, maxDelta + 1);
             if (dist <= maxDelta) {
-                matches[dist].push_back(sym->name);
+                matches[dist].push_back(name);
             }
         }
     }
@@ -334,17 +423,17 @@ std::vector<std::string> SymbolTable::ClosestEnumTypeMatch(const char *str) cons
     std::array<std::vector<std::string>, maxDelta + 1> matches;
 
     for (const TypeMapType &typeMap : types) {
-        for (const std::pair<const std::string, const Type *> &entry : typeMap) {
+        for (const std::string &name : lSortedNames(typeMap, names)) {
             // Skip over either StructTypes or EnumTypes, depending on the
             // value of the structsVsEnums parameter
-            bool isEnum = (CastType<EnumType>(entry.second) != nullptr);
+            bool isEnum = (CastType<EnumType>(typeMap.at(nameIDs.lookup(name))) != nullptr);
             if (!isEnum) {
                 continue;
             }
 
-            int dist = StringEditDistance(str, entry.first, maxDelta + 1);
+            int dist = StringEditDistance(str, name, maxDelta + 1);
             if (dist <= maxDelta) {
-                matches[dist].push_back(entry.first);
+                matches[dist].push_back(name);
             }
         }
     }
@@ -364,10 +453,9 @@ void SymbolTable::Print() {
     fprintf(stderr, "Variables:\n----------------\n");
     for (int i = 0; i < (int)variables.size(); ++i) {
         SymbolMapType &sm = *(variables[i]);
-        SymbolMapType::iterator iter;
-        for (iter = sm.begin(); iter != sm.end(); ++iter) {
+        for (const std::string &name : lSortedNames(sm, names)) {
             fprintf(stderr, "%*c", depth, ' ');
-            Symbol *sym = iter->second;
+            Symbol *sym = sm[nameIDs.lookup(name)];
             fprintf(stderr, "%s [%s]", sym->name.c_str(), sym->type->GetString().c_str());
         }
         fprintf(stderr, "\n");
@@ -388,9 +476,9 @@ void SymbolTable::Print() {
     depth = 0;
     fprintf(stderr, "Named types:\n---------------\n");
     for (const TypeMapType &typeMap : types) {
-        for (const std::pair<const std::string, const Type *> &entry : typeMap) {
+        for (const std::string &name : lSortedNames(typeMap, names)) {
             fprintf(stderr, "%*c", depth, ' ');
-            fprintf(stderr, "%s -> %s\n", entry.first.c_str(), entry.second->GetString().c_str());
+            fprintf(stderr, "%s -> %s\n", name.c_str(), typeMap.at(nameIDs.lookup(name))->GetString().c_str());
         }
         fprintf(stderr, "\n");
         depth += 4;
@@ -17,6 +17,9 @@
 #include "ispc.h"
 
 #include <map>
+#include <unordered_map>
+
+#include <llvm/ADT/StringMap.h>
 
 namespace ispc {
 
@@ -47,6 +50,7 @@ class Symbol : public Traceable {
         TemplateTypeParm,
         TemplateInstantiation,
         TemplateSymbol,
+        TaskGroup,
         Variable
         // ... other symbol types ...
     };
@@ -157,6 +161,18 @@ class SymbolTable {
         parsing to avoid assertion in destructor. */
     void PopInnerScopes();
 
+    /** Moves the scopes other than the outermost one aside, so that a
+        function can be defined at the global scope while another function
+        is being parsed (e.g. the task of a "parallel_foreach"), and
+        restores them. */
+    void SuspendInnerScopes();
+    void ResumeInnerScopes();
+
+    /** Returns true if the variable symbol is visible in a scope other
+        than the outermost one, i.e. it's a local variable or a parameter of
+        the function that is being parsed. */
+    bool IsLocalVariable(const Symbol *symbol) const;
+
     /** Adds the given variable symbol to the symbol table.
         @param symbol The symbol to be added
 
@@ -305,13 +321,33 @@ class SymbolTable {
   private:
     std::vector<std::string> closestTypeMatch(const char *str, bool structsVsEnums) const;
 
+    /** The names of the variables, functions and types are interned: each
+        distinct name gets a small integer ID the first time a symbol or a
+        type with that name is added, and the tables below are keyed by
+        it.  So a lookup hashes the name once, rather than once for every
+        scope, and a name that was never added is rejected right away. */
+    typedef uint32_t NameID;
+    llvm::StringMap<NameID> nameIDs;
+    /** The names by their IDs; the keys of nameIDs, which don't move. */
+    std::vector<llvm::StringRef> names;
+
+    /** Returns the ID of the given name, assigning a new one if needed. */
+    NameID internName(llvm::StringRef name);
+
+    /** Sets *id to the ID of the given name and returns true if the name
+        has been interned. */
+    bool findName(llvm::StringRef name, NameID *id) const;
+
+    /** Returns the overload set of the function name or null. */
+    std::vector<Symbol *> *lookupOverloads(const char *name) const;
+
     /** This member variable holds one SymbolMap for each of the current
         active scopes as the program is being parsed.  New maps are added
         and removed from the end of the main vector, so searches for
         symbols start looking at the end of \c variables and work
         backwards.
      */
-    typedef std::map<std::string, Symbol *> SymbolMapType;
+    typedef std::unordered_map<NameID, Symbol *> SymbolMapType;
     std::vector<SymbolMapType *> variables;
 
     std::vector<SymbolMapType *> freeSymbolMaps;
@@ -320,9 +356,13 @@ class SymbolTable {
         an implementation to maintain function declarations in a single
         namespace.)  A STL \c vector is used to store the function symbols
         for a given name since, due to function overloading, a name can
-        have multiple function symbols associated with it. */
+        have multiple function symbols associated with it.  The map is
+        ordered by name, so that the exported functions are emitted in a
+        stable order; \c overloads caches the overload set of each name
+        for the lookups. */
     typedef std::map<std::string, std::vector<Symbol *>> FunctionMapType;
     FunctionMapType functions;
+    std::unordered_map<NameID, std::vector<Symbol *> *> overloads;
 
     /** This maps ISPC symbols for corresponding LLVM intrinsic functions.
      */
@@ -333,13 +373,17 @@ class SymbolTable {
         *not* scoped.  A STL \c vector is used to store the function templates
         for a given name since, due to function overloading, a name can
         have multiple function templates associated with it. */
-    typedef std::map<std::string, std::vector<TemplateSymbol *>> FunctionTemplateMapType;
+    typedef std::unordered_map<NameID, std::vector<TemplateSymbol *>> FunctionTemplateMapType;
     FunctionTemplateMapType functionTemplates;
 
     /** Scoped types.
      */
-    typedef std::map<std::string, const Type *> TypeMapType;
+    typedef std::unordered_map<NameID, const Type *> TypeMapType;
     std::vector<TypeMapType> types;
+
+    /** The scopes moved aside by SuspendInnerScopes(). */
+    std::vector<SymbolMapType *> suspendedVariables;
+    std::vector<TypeMapType> suspendedTypes;
 };
 
 template <typename Predicate>
@@ -52,7 +52,9 @@ Arch operator++(Arch &arch, int dummy) {
                   "Enum Arch is not sequential");
     static_assert(static_cast<underlying>(Arch::aarch64) == static_cast<underlying>(Arch::arm) + 1,
                   "Enum Arch is not sequential");
-    static_assert(static_cast<underlying>(Arch::wasm32) == static_cast<underlying>(Arch::aarch64) + 1,
+    static_assert(static_cast<underlying>(Arch::riscv64) == static_cast<underlying>(Arch::aarch64) + 1,
+                  "Enum Arch is not sequential");
+    static_assert(static_cast<underlying>(Arch::wasm32) == static_cast<underlying>(Arch::riscv64) + 1,
                   "Enum Arch is not sequential");
     static_assert(static_cast<underlying>(Arch::wasm64) == static_cast<underlying>(Arch::wasm32) + 1,
                   "Enum Arch is not sequential");
@@ -183,9 +185,15 @@ ISPCTarget operator++(ISPCTarget &target, int dummy) {
     static_assert(static_cast<underlying>(ISPCTarget::avx512spr_x64) ==
                       static_cast<underlying>(ISPCTarget::avx512spr_x32) + 1,
                   "Enum ISPCTarget is not sequential");
-    static_assert(static_cast<underlying>(ISPCTarget::neon_i8x16) ==
+    static_assert(static_cast<underlying>(ISPCTarget::avx10_x4) ==
                       static_cast<underlying>(ISPCTarget::avx512spr_x64) + 1,
                   "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::avx10_x8) ==
+                      static_cast<underlying>(ISPCTarget::avx10_x4) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::neon_i8x16) ==
+                      static_cast<underlying>(ISPCTarget::avx10_x8) + 1,
+                  "Enum ISPCTarget is not sequential");
     static_assert(static_cast<underlying>(ISPCTarget::neon_i16x8) ==
                       static_cast<underlying>(ISPCTarget::neon_i8x16) + 1,
                   "Enum ISPCTarget is not sequential");
@@ -195,10 +203,38 @@ ISPCTarget operator++(ISPCTarget &target, int dummy) {
     static_assert(static_cast<underlying>(ISPCTarget::neon_i32x8) ==
                       static_cast<underlying>(ISPCTarget::neon_i32x4) + 1,
                   "Enum ISPCTarget is not sequential");
-    static_assert(static_cast<underlying>(ISPCTarget::wasm_i32x4) ==
+    static_assert(static_cast<underlying>(ISPCTarget::sve_i32x4) ==
                       static_cast<underlying>(ISPCTarget::neon_i32x8) + 1,
                   "Enum ISPCTarget is not sequential");
-    static_assert(static_cast<underlying>(ISPCTarget::gen9_x8) == static_cast<underlying>(ISPCTarget::wasm_i32x4) + 1,
+    static_assert(static_cast<underlying>(ISPCTarget::sve_i32x8) ==
+                      static_cast<underlying>(ISPCTarget::sve_i32x4) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::sve_i32x16) ==
+                      static_cast<underlying>(ISPCTarget::sve_i32x8) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::rvv_i32x4) ==
+                      static_cast<underlying>(ISPCTarget::sve_i32x16) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::rvv_i32x8) ==
+                      static_cast<underlying>(ISPCTarget::rvv_i32x4) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::rvv_i32x16) ==
+                      static_cast<underlying>(ISPCTarget::rvv_i32x8) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::wasm_i32x4) ==
+                      static_cast<underlying>(ISPCTarget::rvv_i32x16) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::wasm_i32x8) ==
+                      static_cast<underlying>(ISPCTarget::wasm_i32x4) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::wasm_relaxed_i32x4) ==
+                      static_cast<underlying>(ISPCTarget::wasm_i32x8) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::wasm_relaxed_i32x8) ==
+                      static_cast<underlying>(ISPCTarget::wasm_relaxed_i32x4) + 1,
+                  "Enum ISPCTarget is not sequential");
+    static_assert(static_cast<underlying>(ISPCTarget::gen9_x8) ==
+                      static_cast<underlying>(ISPCTarget::wasm_relaxed_i32x8) + 1,
                   "Enum ISPCTarget is not sequential");
     static_assert(static_cast<underlying>(ISPCTarget::gen9_x16) == static_cast<underlying>(ISPCTarget::gen9_x8) + 1,
                   "Enum ISPCTarget is not sequential");
@@ -243,6 +279,8 @@ Arch ParseArch(std::string arch) {
         return Arch::arm;
     } else if (arch == "aarch64") {
         return Arch::aarch64;
+    } else if (arch == "riscv64") {
+        return Arch::riscv64;
     } else if (arch == "wasm32") {
         return Arch::wasm32;
     } else if (arch == "wasm64") {
@@ -265,6 +303,8 @@ std::string ArchToString(Arch arch) {
         return "arm";
     case Arch::aarch64:
         return "aarch64";
+    case Arch::riscv64:
+        return "riscv64";
     case Arch::wasm32:
         return "wasm32";
     case Arch::wasm64:
@@ -366,6 +406,10 @@ ISPCTarget ParseISPCTarget(std::string target) {
         return ISPCTarget::avx512spr_x32;
     } else if (target == "avx512spr-x64") {
         return ISPCTarget::avx512spr_x64;
+    } else if (target == "avx10-x4") {
+        return ISPCTarget::avx10_x4;
+    } else if (target == "avx10-x8") {
+        return ISPCTarget::avx10_x8;
     } else if (target == "neon-i8x16") {
         return ISPCTarget::neon_i8x16;
     } else if (target == "neon-i16x8") {
@@ -374,8 +418,26 @@ ISPCTarget ParseISPCTarget(std::string target) {
         return ISPCTarget::neon_i32x4;
     } else if (target == "neon-i32x8") {
         return ISPCTarget::neon_i32x8;
+    } else if (target == "sve-i32x4") {
+        return ISPCTarget::sve_i32x4;
+    } else if (target == "sve-i32x8") {
+        return ISPCTarget::sve_i32x8;
+    } else if (target == "sve-i32x16") {
+        return ISPCTarget::sve_i32x16;
+    } else if (target == "rvv-i32x4") {
+        return ISPCTarget::rvv_i32x4;
+    } else if (target == "rvv-i32x8") {
+        return ISPCTarget::rvv_i32x8;
+    } else if (target == "rvv-i32x16") {
+        return ISPCTarget::rvv_i32x16;
     } else if (target == "wasm-i32x4") {
         return ISPCTarget::wasm_i32x4;
+    } else if (target == "wasm-i32x8") {
+        return ISPCTarget::wasm_i32x8;
+    } else if (target == "wasm-relaxed-i32x4") {
+        return ISPCTarget::wasm_relaxed_i32x4;
+    } else if (target == "wasm-relaxed-i32x8") {
+        return ISPCTarget::wasm_relaxed_i32x8;
     } else if (target == "gen9-x8") {
         return ISPCTarget::gen9_x8;
     } else if (target == "gen9-x16" || target == "gen9") {
@@ -521,6 +583,10 @@ std::string ISPCTargetToString(ISPCTarget target) {
         return "avx512spr-x32";
     case ISPCTarget::avx512spr_x64:
         return "avx512spr-x64";
+    case ISPCTarget::avx10_x4:
+        return "avx10-x4";
+    case ISPCTarget::avx10_x8:
+        return "avx10-x8";
     case ISPCTarget::neon_i8x16:
         return "neon-i8x16";
     case ISPCTarget::neon_i16x8:
@@ -529,8 +595,26 @@ std::string ISPCTargetToString(ISPCTarget target) {
         return "neon-i32x4";
     case ISPCTarget::neon_i32x8:
         return "neon-i32x8";
+    case ISPCTarget::sve_i32x4:
+        return "sve-i32x4";
+    case ISPCTarget::sve_i32x8:
+        return "sve-i32x8";
+    case ISPCTarget::sve_i32x16:
+        return "sve-i32x16";
+    case ISPCTarget::rvv_i32x4:
+        return "rvv-i32x4";
+    case ISPCTarget::rvv_i32x8:
+        return "rvv-i32x8";
+    case ISPCTarget::rvv_i32x16:
+        return "rvv-i32x16";
     case ISPCTarget::wasm_i32x4:
         return "wasm-i32x4";
+    case ISPCTarget::wasm_i32x8:
+        return "wasm-i32x8";
+    case ISPCTarget::wasm_relaxed_i32x4:
+        return "wasm-relaxed-i32x4";
+    case ISPCTarget::wasm_relaxed_i32x8:
+        return "wasm-relaxed-i32x8";
     case ISPCTarget::gen9_x8:
         return "gen9-x8";
     case ISPCTarget::gen9_x16:
@@ -610,6 +694,8 @@ bool ISPCTargetIsX86(ISPCTarget target) {
     case ISPCTarget::avx512spr_x16:
     case ISPCTarget::avx512spr_x32:
     case ISPCTarget::avx512spr_x64:
+    case ISPCTarget::avx10_x4:
+    case ISPCTarget::avx10_x8:
         return true;
     default:
         return false;
@@ -628,9 +714,34 @@ bool ISPCTargetIsNeon(ISPCTarget target) {
     }
 }
 
+bool ISPCTargetIsSve(ISPCTarget target) {
+    switch (target) {
+    case ISPCTarget::sve_i32x4:
+    case ISPCTarget::sve_i32x8:
+    case ISPCTarget::sve_i32x16:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ISPCTargetIsRvv(ISPCTarget target) {
+    switch (target) {
+    case ISPCTarget::rvv_i32x4:
+    case ISPCTarget::rvv_i32x8:
+    case ISPCTarget::rvv_i32x16:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool ISPCTargetIsWasm(ISPCTarget target) {
     switch (target) {
     case ISPCTarget::wasm_i32x4:
+    case ISPCTarget::wasm_i32x8:
+    case ISPCTarget::wasm_relaxed_i32x4:
+    case ISPCTarget::wasm_relaxed_i32x8:
         return true;
     default:
         return false;
@@ -26,7 +26,7 @@ std::string OSToString(TargetOS os);
 std::string OSToLowerString(TargetOS os);
 TargetOS GetHostOS();
 
-enum class Arch { none, x86, x86_64, arm, aarch64, wasm32, wasm64, xe64, error };
+enum class Arch { none, x86, x86_64, arm, aarch64, riscv64, wasm32, wasm64, xe64, error };
 Arch operator++(Arch &, int);
 
 Arch ParseArch(std::string arch);
@@ -74,11 +74,22 @@ enum class ISPCTarget {
     avx512spr_x16,
     avx512spr_x32,
     avx512spr_x64,
+    avx10_x4,
+    avx10_x8,
     neon_i8x16,
     neon_i16x8,
     neon_i32x4,
     neon_i32x8,
+    sve_i32x4,
+    sve_i32x8,
+    sve_i32x16,
+    rvv_i32x4,
+    rvv_i32x8,
+    rvv_i32x16,
     wasm_i32x4,
+    wasm_i32x8,
+    wasm_relaxed_i32x4,
+    wasm_relaxed_i32x8,
     gen9_x8,
     gen9_x16,
     xelp_x8,
@@ -102,6 +113,8 @@ std::pair<std::vector<ISPCTarget>, std::string> ParseISPCTargets(const char *tar
 std::string ISPCTargetToString(ISPCTarget target);
 bool ISPCTargetIsX86(ISPCTarget target);
 bool ISPCTargetIsNeon(ISPCTarget target);
+bool ISPCTargetIsSve(ISPCTarget target);
+bool ISPCTargetIsRvv(ISPCTarget target);
 bool ISPCTargetIsWasm(ISPCTarget target);
 bool ISPCTargetIsGen(ISPCTarget target);
 } // namespace ispc
@@ -167,11 +167,12 @@ static const BitcodeLib *lGetTargetLib(const std::map<uint32_t, const BitcodeLib
         ;
     }
 
-    // There's no Mac that supports SPR, so the decision is not support these targets when targeting macOS.
+    // There's no Mac that supports SPR or AVX10, so the decision is not support these targets when targeting macOS.
     // If these targets are linked in, then we still can use them for cross compilation, for example for Linux.
     if (os == TargetOS::macos && (target == ISPCTarget::avx512spr_x4 || target == ISPCTarget::avx512spr_x8 ||
                                   target == ISPCTarget::avx512spr_x16 || target == ISPCTarget::avx512spr_x32 ||
-                                  target == ISPCTarget::avx512spr_x64)) {
+                                  target == ISPCTarget::avx512spr_x64 || target == ISPCTarget::avx10_x4 ||
+                                  target == ISPCTarget::avx10_x8)) {
         return nullptr;
     }
 
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file time_report.cpp
+    @brief Implementation of TimeReport.
+*/
+
+#include "time_report.h"
+#include "ispc.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+#ifdef ISPC_HOST_IS_WINDOWS
+#include <windows.h>
+// windows.h should be included before psapi.h
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif // ISPC_HOST_IS_WINDOWS
+
+using namespace ispc;
+
+// Peak resident set size of the process in kilobytes.
+static uint64_t lGetPeakRSSKb() {
+#ifdef ISPC_HOST_IS_WINDOWS
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef ISPC_HOST_IS_APPLE
+    // ru_maxrss is in bytes on macOS and in kilobytes elsewhere.
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif // ISPC_HOST_IS_WINDOWS
+}
+
+TimeReport &TimeReport::in() {
+    static TimeReport instance;
+    return instance;
+}
+
+bool TimeReport::IsEnabled() { return g != nullptr && !g->timeReportFile.empty(); }
+
+void TimeReport::Begin(llvm::StringRef phase, llvm::StringRef function) {
+    m_scopes.push_back({phase.str(), function.str(), std::chrono::steady_clock::now()});
+}
+
+void TimeReport::End() {
+    Assert(!m_scopes.empty());
+    const Scope &scope = m_scopes.back();
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scope.start).count();
+    uint64_t peakRSSKb = lGetPeakRSSKb();
+    std::string target = g->target != nullptr ? ISPCTargetToString(g->target->getISPCTarget()) : "";
+
+    // The number of distinct entries is small, so the linear search from
+    // the end, where the recent entries are, is fine.
+    for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it) {
+        if (it->phase == scope.phase && it->function == scope.function && it->target == target) {
+            it->count++;
+            it->wallMs += wallMs;
+            it->peakRSSKb = std::max(it->peakRSSKb, peakRSSKb);
+            m_scopes.pop_back();
+            return;
+        }
+    }
+    m_entries.push_back({target, scope.phase, scope.function, 1, wallMs, peakRSSKb});
+    m_scopes.pop_back();
+}
+
+bool TimeReport::Write(const std::string &fileName, const char *srcFile) const {
+    std::error_code EC;
+    llvm::raw_fd_ostream os(fileName, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        Error(SourcePos(), "Cannot open time report file \"%s\": %s", fileName.c_str(), EC.message().c_str());
+        return false;
+    }
+
+    llvm::json::OStream J(os, 2);
+    J.object([&] {
+        J.attribute("version", 1);
+        J.attribute("source", srcFile != nullptr ? srcFile : "");
+        J.attributeArray("phases", [&] {
+            for (const Entry &entry : m_entries) {
+                J.object([&] {
+                    J.attribute("target", entry.target);
+                    J.attribute("phase", entry.phase);
+                    if (!entry.function.empty()) {
+                        J.attribute("function", entry.function);
+                    }
+                    J.attribute("count", static_cast<int64_t>(entry.count));
+                    J.attribute("wall_ms", entry.wallMs);
+                    J.attribute("peak_rss_kb", static_cast<int64_t>(entry.peakRSSKb));
+                });
+            }
+        });
+    });
+    os << "\n";
+    return true;
+}
+
+TimeReportScope::TimeReportScope(const char *phase, llvm::StringRef function)
+    : m_enabled(phase != nullptr && TimeReport::IsEnabled()) {
+    if (m_enabled) {
+        TimeReport::in().Begin(phase, function);
+    }
+}
+
+TimeReportScope::~TimeReportScope() {
+    if (m_enabled) {
+        TimeReport::in().End();
+    }
+}
@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2024, Intel Corporation
+
+  SPDX-License-Identifier: BSD-3-Clause
+*/
+
+/** @file time_report.h
+    @brief Declaration of TimeReport, which collects wall time and peak
+           memory usage of compilation phases for --time-report.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+
+namespace ispc {
+
+/** @brief Per phase compile time report (--time-report=<file>).
+
+    Every phase is identified by its fixed name (e.g. "parse", "codegen",
+    or the name of an ISPC pass), the target, and optionally the name of
+    the function it processed.  Repeated executions of the same phase are
+    accumulated.  The report is written as JSON at the end of the
+    compilation.
+ */
+class TimeReport {
+  public:
+    static TimeReport &in();
+
+    /** Returns true if --time-report is used. */
+    static bool IsEnabled();
+
+    /** Start the phase.  Phases may nest. */
+    void Begin(llvm::StringRef phase, llvm::StringRef function = "");
+    /** Finish the innermost phase and record it for the current target. */
+    void End();
+
+    /** Write the report to the file. */
+    bool Write(const std::string &fileName, const char *srcFile) const;
+
+  private:
+    struct Scope {
+        std::string phase;
+        std::string function;
+        std::chrono::steady_clock::time_point start;
+    };
+    struct Entry {
+        std::string target;
+        std::string phase;
+        std::string function;
+        unsigned count;
+        double wallMs;
+        uint64_t peakRSSKb;
+    };
+
+    std::vector<Scope> m_scopes;
+    std::vector<Entry> m_entries;
+};
+
+/** RAII helper, which reports the phase to TimeReport if it is enabled.
+    nullptr phase name disables it. */
+class TimeReportScope {
+  public:
+    TimeReportScope(const char *phase, llvm::StringRef function = "");
+    ~TimeReportScope();
+
+  private:
+    bool m_enabled;
+};
+
+} // namespace ispc
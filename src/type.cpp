@@ -1090,9 +1090,11 @@ const Symbol *EnumType::GetEnumerator(int i) const { return enumerators[i]; }
 
 PointerType *PointerType::Void = new PointerType(AtomicType::Void, Variability(Variability::Uniform), false);
 
-PointerType::PointerType(const Type *t, Variability v, bool ic, bool is, bool fr, AddressSpace as)
-    : Type(POINTER_TYPE), variability(v), isConst(ic), isSlice(is), isFrozen(fr), addrSpace(as) {
+PointerType::PointerType(const Type *t, Variability v, bool ic, bool is, bool fr, AddressSpace as, bool ir)
+    : Type(POINTER_TYPE), variability(v), isConst(ic), isSlice(is), isFrozen(fr), addrSpace(as), isRestrict(ir) {
     baseType = t;
+    asOtherConstType = nullptr;
+    asUniformType = asVaryingType = nullptr;
 }
 
 PointerType *PointerType::GetUniform(const Type *t, bool is) {
@@ -1126,24 +1128,39 @@ const Type *PointerType::GetBaseType() const { return baseType; }
 const PointerType *PointerType::GetAsVaryingType() const {
     if (variability == Variability::Varying) {
         return this;
-    } else {
-        return new PointerType(baseType, Variability(Variability::Varying), isConst, isSlice, isFrozen);
     }
+
+    if (asVaryingType == nullptr) {
+        asVaryingType = new PointerType(baseType, Variability(Variability::Varying), isConst, isSlice, isFrozen,
+                                        AddressSpace::ispc_default, isRestrict);
+        if (variability == Variability::Uniform && addrSpace == AddressSpace::ispc_default) {
+            asVaryingType->asUniformType = this;
+        }
+    }
+    return asVaryingType;
 }
 
 const PointerType *PointerType::GetAsUniformType() const {
     if (variability == Variability::Uniform) {
         return this;
-    } else {
-        return new PointerType(baseType, Variability(Variability::Uniform), isConst, isSlice, isFrozen);
     }
+
+    if (asUniformType == nullptr) {
+        asUniformType = new PointerType(baseType, Variability(Variability::Uniform), isConst, isSlice, isFrozen,
+                                        AddressSpace::ispc_default, isRestrict);
+        if (variability == Variability::Varying && addrSpace == AddressSpace::ispc_default) {
+            asUniformType->asVaryingType = this;
+        }
+    }
+    return asUniformType;
 }
 
 const PointerType *PointerType::GetAsUnboundVariabilityType() const {
     if (variability == Variability::Unbound) {
         return this;
     } else {
-        return new PointerType(baseType, Variability(Variability::Unbound), isConst, isSlice, isFrozen);
+        return new PointerType(baseType, Variability(Variability::Unbound), isConst, isSlice, isFrozen,
+                               AddressSpace::ispc_default, isRestrict);
     }
 }
 
@@ -1151,7 +1168,8 @@ const PointerType *PointerType::GetAsSOAType(int width) const {
     if (GetSOAWidth() == width) {
         return this;
     } else {
-        return new PointerType(baseType, Variability(Variability::SOA, width), isConst, isSlice, isFrozen);
+        return new PointerType(baseType, Variability(Variability::SOA, width), isConst, isSlice, isFrozen,
+                               AddressSpace::ispc_default, isRestrict);
     }
 }
 
@@ -1180,7 +1198,14 @@ const PointerType *PointerType::GetWithAddrSpace(AddressSpace as) const {
     if (addrSpace == as) {
         return this;
     }
-    return new PointerType(baseType, variability, isConst, isSlice, isFrozen, as);
+    return new PointerType(baseType, variability, isConst, isSlice, isFrozen, as, isRestrict);
+}
+
+const PointerType *PointerType::GetAsRestrict() const {
+    if (isRestrict) {
+        return this;
+    }
+    return new PointerType(baseType, variability, isConst, isSlice, isFrozen, addrSpace, true);
 }
 
 const PointerType *PointerType::ResolveDependence(TemplateInstantiation &templInst) const {
@@ -1194,7 +1219,8 @@ const PointerType *PointerType::ResolveDependence(TemplateInstantiation &templIn
         return this;
     }
 
-    const PointerType *pType = new PointerType(resType, variability, isConst, isSlice, isFrozen);
+    const PointerType *pType =
+        new PointerType(resType, variability, isConst, isSlice, isFrozen, AddressSpace::ispc_default, isRestrict);
     return pType;
 }
 
@@ -1207,23 +1233,39 @@ const PointerType *PointerType::ResolveUnboundVariability(Variability v) const {
     Assert(v != Variability::Unbound);
     Variability ptrVariability = (variability == Variability::Unbound) ? v : variability;
     const Type *resolvedBaseType = baseType->ResolveUnboundVariability(Variability::Uniform);
-    return new PointerType(resolvedBaseType, ptrVariability, isConst, isSlice, isFrozen, addrSpace);
+    return new PointerType(resolvedBaseType, ptrVariability, isConst, isSlice, isFrozen, addrSpace, isRestrict);
 }
 
 const PointerType *PointerType::GetAsConstType() const {
     if (isConst == true) {
         return this;
-    } else {
-        return new PointerType(baseType, variability, true, isSlice);
     }
+
+    if (asOtherConstType == nullptr) {
+        asOtherConstType =
+            new PointerType(baseType, variability, true, isSlice, false, AddressSpace::ispc_default, isRestrict);
+        // The other way around only gives this type back if the conversion
+        // didn't drop anything.
+        if (isFrozen == false && addrSpace == AddressSpace::ispc_default) {
+            asOtherConstType->asOtherConstType = this;
+        }
+    }
+    return asOtherConstType;
 }
 
 const PointerType *PointerType::GetAsNonConstType() const {
     if (isConst == false) {
         return this;
-    } else {
-        return new PointerType(baseType, variability, false, isSlice);
     }
+
+    if (asOtherConstType == nullptr) {
+        asOtherConstType =
+            new PointerType(baseType, variability, false, isSlice, false, AddressSpace::ispc_default, isRestrict);
+        if (isFrozen == false && addrSpace == AddressSpace::ispc_default) {
+            asOtherConstType->asOtherConstType = this;
+        }
+    }
+    return asOtherConstType;
 }
 
 std::string PointerType::GetString() const {
@@ -1242,6 +1284,9 @@ std::string PointerType::GetString() const {
     if (isConst) {
         ret += "const ";
     }
+    if (isRestrict) {
+        ret += "restrict ";
+    }
     if (isSlice) {
         ret += "slice ";
     }
@@ -1298,6 +1343,9 @@ std::string PointerType::GetDeclaration(const std::string &name, DeclarationSynt
     if (isConst) {
         tempName += " const";
     }
+    if (isRestrict) {
+        tempName += " __restrict";
+    }
     tempName += std::string(" ");
     tempName += name;
     if (baseIsBasicVarying || baseIsFunction) {
@@ -1433,6 +1481,8 @@ ArrayType::ArrayType(const Type *c, int a) : SequentialType(ARRAY_TYPE), child(c
     // 0 -> unsized array.
     Assert(elementCount.fixedCount >= 0);
     Assert(c->IsVoidType() == false);
+    asConstType = asNonConstType = nullptr;
+    asUniformType = asVaryingType = nullptr;
 }
 
 llvm::ArrayType *ArrayType::LLVMType(llvm::LLVMContext *ctx) const {
@@ -1481,7 +1531,10 @@ const ArrayType *ArrayType::GetAsVaryingType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new ArrayType(child->GetAsVaryingType(), elementCount.fixedCount);
+    if (asVaryingType == nullptr) {
+        asVaryingType = new ArrayType(child->GetAsVaryingType(), elementCount.fixedCount);
+    }
+    return asVaryingType;
 }
 
 const ArrayType *ArrayType::GetAsUniformType() const {
@@ -1489,7 +1542,10 @@ const ArrayType *ArrayType::GetAsUniformType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new ArrayType(child->GetAsUniformType(), elementCount.fixedCount);
+    if (asUniformType == nullptr) {
+        asUniformType = new ArrayType(child->GetAsUniformType(), elementCount.fixedCount);
+    }
+    return asUniformType;
 }
 
 const ArrayType *ArrayType::GetAsUnboundVariabilityType() const {
@@ -1550,7 +1606,10 @@ const ArrayType *ArrayType::GetAsConstType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new ArrayType(child->GetAsConstType(), elementCount.fixedCount);
+    if (asConstType == nullptr) {
+        asConstType = new ArrayType(child->GetAsConstType(), elementCount.fixedCount);
+    }
+    return asConstType;
 }
 
 const ArrayType *ArrayType::GetAsNonConstType() const {
@@ -1558,7 +1617,10 @@ const ArrayType *ArrayType::GetAsNonConstType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new ArrayType(child->GetAsNonConstType(), elementCount.fixedCount);
+    if (asNonConstType == nullptr) {
+        asNonConstType = new ArrayType(child->GetAsNonConstType(), elementCount.fixedCount);
+    }
+    return asNonConstType;
 }
 
 int ArrayType::GetElementCount() const { return elementCount.fixedCount; }
@@ -1743,12 +1805,20 @@ int ArrayType::ResolveElementCount(TemplateInstantiation &templInst) const {
 VectorType::VectorType(const Type *b, int a) : SequentialType(VECTOR_TYPE), base(b), elementCount(a) {
     Assert(elementCount.fixedCount > 0);
     Assert(base != nullptr);
+    asConstType = asNonConstType = nullptr;
+    asUniformType = asVaryingType = nullptr;
 }
 
-VectorType::VectorType(const Type *b, Symbol *num) : SequentialType(VECTOR_TYPE), base(b), elementCount(num) {}
+VectorType::VectorType(const Type *b, Symbol *num) : SequentialType(VECTOR_TYPE), base(b), elementCount(num) {
+    asConstType = asNonConstType = nullptr;
+    asUniformType = asVaryingType = nullptr;
+}
 
 VectorType::VectorType(const Type *b, ElementCount elCount)
-    : SequentialType(VECTOR_TYPE), base(b), elementCount(elCount) {}
+    : SequentialType(VECTOR_TYPE), base(b), elementCount(elCount) {
+    asConstType = asNonConstType = nullptr;
+    asUniformType = asVaryingType = nullptr;
+}
 
 Variability VectorType::GetVariability() const { return base->GetVariability(); }
 
@@ -1774,7 +1844,10 @@ const VectorType *VectorType::GetAsVaryingType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new VectorType(base->GetAsVaryingType(), elementCount);
+    if (asVaryingType == nullptr) {
+        asVaryingType = new VectorType(base->GetAsVaryingType(), elementCount);
+    }
+    return asVaryingType;
 }
 
 const VectorType *VectorType::GetAsUniformType() const {
@@ -1785,7 +1858,10 @@ const VectorType *VectorType::GetAsUniformType() const {
         Assert(m->errorCount > 0);
         return nullptr;
     }
-    return new VectorType(base->GetAsUniformType(), elementCount);
+    if (asUniformType == nullptr) {
+        asUniformType = new VectorType(base->GetAsUniformType(), elementCount);
+    }
+    return asUniformType;
 }
 
 const VectorType *VectorType::GetAsUnboundVariabilityType() const {
@@ -1823,10 +1899,18 @@ const VectorType *VectorType::GetAsSignedType() const {
     return new VectorType(base->GetAsSignedType(), elementCount);
 }
 
-const VectorType *VectorType::GetAsConstType() const { return new VectorType(base->GetAsConstType(), elementCount); }
+const VectorType *VectorType::GetAsConstType() const {
+    if (asConstType == nullptr) {
+        asConstType = new VectorType(base->GetAsConstType(), elementCount);
+    }
+    return asConstType;
+}
 
 const VectorType *VectorType::GetAsNonConstType() const {
-    return new VectorType(base->GetAsNonConstType(), elementCount);
+    if (asNonConstType == nullptr) {
+        asNonConstType = new VectorType(base->GetAsNonConstType(), elementCount);
+    }
+    return asNonConstType;
 }
 
 std::string VectorType::GetString() const {
@@ -2027,6 +2111,7 @@ StructType::StructType(const std::string &n, const llvm::SmallVector<const Type
     : CollectionType(STRUCT_TYPE), name(n), elementTypes(elts), elementNames(en), elementPositions(ep), variability(v),
       isConst(ic), isAnonymous(ia), pos(p) {
     oppositeConstStructType = nullptr;
+    asUniformType = asVaryingType = nullptr;
     finalElementTypes.resize(elts.size(), nullptr);
 
     static int count = 0;
@@ -2135,19 +2220,31 @@ const Type *StructType::GetBaseType() const { return this; }
 const StructType *StructType::GetAsVaryingType() const {
     if (IsVaryingType()) {
         return this;
-    } else {
-        return new StructType(name, elementTypes, elementNames, elementPositions, isConst,
-                              Variability(Variability::Varying), isAnonymous, pos);
     }
+
+    if (asVaryingType == nullptr) {
+        asVaryingType = new StructType(name, elementTypes, elementNames, elementPositions, isConst,
+                                       Variability(Variability::Varying), isAnonymous, pos);
+        if (IsUniformType()) {
+            asVaryingType->asUniformType = this;
+        }
+    }
+    return asVaryingType;
 }
 
 const StructType *StructType::GetAsUniformType() const {
     if (IsUniformType()) {
         return this;
-    } else {
-        return new StructType(name, elementTypes, elementNames, elementPositions, isConst,
-                              Variability(Variability::Uniform), isAnonymous, pos);
     }
+
+    if (asUniformType == nullptr) {
+        asUniformType = new StructType(name, elementTypes, elementNames, elementPositions, isConst,
+                                       Variability(Variability::Uniform), isAnonymous, pos);
+        if (IsVaryingType()) {
+            asUniformType->asVaryingType = this;
+        }
+    }
+    return asUniformType;
 }
 
 const StructType *StructType::GetAsUnboundVariabilityType() const {
@@ -2804,6 +2901,7 @@ FunctionType::FunctionType(const Type *r, const llvm::SmallVector<const Type *,
     Assert(returnType != nullptr);
     isSafe = false;
     costOverride = -1;
+    vectorWidth = 0;
     asUnmaskedType = asMaskedType = nullptr;
 }
 
@@ -2819,6 +2917,7 @@ FunctionType::FunctionType(const Type *r, const llvm::SmallVector<const Type *,
     Assert(returnType != nullptr);
     isSafe = false;
     costOverride = -1;
+    vectorWidth = 0;
     asUnmaskedType = asMaskedType = nullptr;
 }
 
@@ -2889,6 +2988,7 @@ const FunctionType *FunctionType::ResolveDependence(TemplateInstantiation &templ
                          isExternC, isExternSYCL, isUnmasked, isUnmangled, isVectorCall, isRegCall, isCdecl, pos);
     ret->isSafe = isSafe;
     ret->costOverride = costOverride;
+    ret->vectorWidth = vectorWidth;
     return ret;
 }
 
@@ -2913,6 +3013,7 @@ const FunctionType *FunctionType::ResolveUnboundVariability(Variability v) const
                          isExternC, isExternSYCL, isUnmasked, isUnmangled, isVectorCall, isRegCall, isCdecl, pos);
     ret->isSafe = isSafe;
     ret->costOverride = costOverride;
+    ret->vectorWidth = vectorWidth;
 
     return ret;
 }
@@ -2931,6 +3032,7 @@ const Type *FunctionType::GetAsUnmaskedType() const {
                                             isVectorCall, isRegCall, isCdecl, pos);
         ft->isSafe = isSafe;
         ft->costOverride = costOverride;
+        ft->vectorWidth = vectorWidth;
         asUnmaskedType = ft;
         if (!isUnmasked) {
             asUnmaskedType->asMaskedType = this;
@@ -2949,6 +3051,7 @@ const Type *FunctionType::GetAsNonUnmaskedType() const {
                                             isVectorCall, isRegCall, isCdecl, pos);
         ft->isSafe = isSafe;
         ft->costOverride = costOverride;
+        ft->vectorWidth = vectorWidth;
         asMaskedType = ft;
         if (isUnmasked) {
             asMaskedType->asUnmaskedType = this;
@@ -2967,6 +3070,7 @@ const Type *FunctionType::GetWithReturnType(const Type *newReturnType) const {
                                         isVectorCall, isRegCall, isCdecl, pos);
     ft->isSafe = isSafe;
     ft->costOverride = costOverride;
+    ft->vectorWidth = vectorWidth;
     return ft;
 }
 
@@ -3227,6 +3331,12 @@ std::vector<llvm::Type *> FunctionType::LLVMFunctionArgTypes(llvm::LLVMContext *
     if (!(removeMask || isUnmasked || IsISPCKernel())) {
         llvmArgTypes.push_back(LLVMTypes::MaskType);
     }
+
+    // CPU tasks store their return value to the array of the results of
+    // the "reduce" clause of their launch.
+    if (isTask && !g->target->isXeTarget() && returnType != nullptr && !returnType->IsVoidType()) {
+        llvmArgTypes.push_back(LLVMTypes::VoidPointerType);
+    }
     return llvmArgTypes;
 }
 
@@ -3269,6 +3379,9 @@ llvm::FunctionType *FunctionType::LLVMFunctionType(llvm::LLVMContext *ctx, bool
     const Type *retType = returnType;
 
     llvm::Type *llvmReturnType = retType->LLVMType(g->ctx);
+    if (isTask && !g->target->isXeTarget()) {
+        llvmReturnType = LLVMTypes::VoidType;
+    }
     // For extern "SYCL" functions on XE targets broadcast uniform return value
     // to varying to match IGC signature by vISA level.
     if (g->target->isXeTarget() && isExternSYCL) {
@@ -3591,6 +3704,12 @@ static bool lCheckTypeEquality(const Type *a, const Type *b, bool ignoreConst) {
         return false;
     }
 
+    // The conversions between the variants of a type are cached, so the
+    // same type is often compared with itself.
+    if (a == b) {
+        return true;
+    }
+
     if (ignoreConst == false && a->IsConstType() != b->IsConstType()) {
         return false;
     }
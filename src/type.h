@@ -469,6 +469,13 @@ class EnumType : public Type {
 
 /** @brief Type implementation for pointers to other types
 
+    Pointers may be declared with the "restrict" qualifier, which states
+    that the memory accessed through the pointer isn't accessed through any
+    other pointer in its scope.  As ispc assumes this for all uniform
+    pointer parameters anyway, the qualifier is mostly documentation; it is
+    ignored by type equality and mangling, like in C, and is passed on to
+    the generated headers.
+
     Pointers can have two additional properties beyond their variability
     and the type of object that they are pointing to.  Both of these
     properties are used for internal bookkeeping and aren't directly
@@ -491,7 +498,7 @@ class EnumType : public Type {
 class PointerType : public Type {
   public:
     PointerType(const Type *t, Variability v, bool isConst, bool isSlice = false, bool frozen = false,
-                AddressSpace as = AddressSpace::ispc_default);
+                AddressSpace as = AddressSpace::ispc_default, bool isRestrict = false);
 
     /** Helper method to return a uniform pointer to the given type. */
     static PointerType *GetUniform(const Type *t, bool isSlice = false);
@@ -512,7 +519,9 @@ class PointerType : public Type {
 
     bool IsSlice() const { return isSlice; }
     bool IsFrozenSlice() const { return isFrozen; }
+    bool IsRestrict() const { return isRestrict; }
     AddressSpace GetAddressSpace() const { return addrSpace; }
+    const PointerType *GetAsRestrict() const;
     const PointerType *GetAsSlice() const;
     const PointerType *GetAsNonSlice() const;
     const PointerType *GetAsFrozenSlice() const;
@@ -545,6 +554,9 @@ class PointerType : public Type {
     const bool isSlice, isFrozen;
     const Type *baseType;
     const AddressSpace addrSpace;
+    const bool isRestrict;
+
+    mutable const PointerType *asOtherConstType, *asUniformType, *asVaryingType;
 };
 
 /** @brief Abstract base class for types that represent collections of
@@ -684,6 +696,8 @@ class ArrayType : public SequentialType {
     ElementCount elementCount;
     /** Resolves the total number of elements in the array in template instantiation. */
     virtual int ResolveElementCount(TemplateInstantiation &templInst) const;
+
+    mutable const ArrayType *asConstType, *asNonConstType, *asUniformType, *asVaryingType;
 };
 
 /** @brief A (short) vector of atomic types.
@@ -748,6 +762,8 @@ class VectorType : public SequentialType {
     /** Resolves the total number of elements in the vector in template instantiation. */
     virtual int ResolveElementCount(TemplateInstantiation &templInst) const;
 
+    mutable const VectorType *asConstType, *asNonConstType, *asUniformType, *asVaryingType;
+
   public:
     /** Returns the number of elements stored in memory for the vector.
         For uniform vectors, this is rounded up so that the number of
@@ -849,6 +865,7 @@ class StructType : public CollectionType {
     mutable llvm::SmallVector<const Type *, 8> finalElementTypes;
 
     mutable const StructType *oppositeConstStructType;
+    mutable const StructType *asUniformType, *asVaryingType;
 };
 
 /** Type implementation representing a struct name that has been declared
@@ -1087,6 +1104,10 @@ class FunctionType : public Type {
         function estimate for the function. */
     int costOverride;
 
+    /** If positive, the vector width of the target that the exported
+        function is compiled for, given with the "width" attribute. */
+    int vectorWidth;
+
   private:
     std::string mangleTemplateArgs(TemplateArgs *templateArgs) const;
 
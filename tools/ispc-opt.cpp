@@ -8,9 +8,12 @@
 #include "llvmutil.h"
 #include "opt.h"
 #include "opt/ISPCPasses.h"
+#include "pass_stats.h"
 #include "target_enums.h"
 #include "util.h"
 
+#include <cstdlib>
+
 #include "llvm/Support/CommandLine.h"
 #include <llvm/Support/Signals.h>
 #if ISPC_LLVM_VERSION >= ISPC_LLVM_14_0
@@ -18,11 +21,6 @@
 #else
 #include <llvm/Support/TargetRegistry.h>
 #endif
-#if ISPC_LLVM_VERSION >= ISPC_LLVM_16_0
-#include <llvm/IRPrinter/IRPrintingPasses.h>
-#else
-#include <llvm/IR/IRPrintingPasses.h>
-#endif
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IRReader/IRReader.h"
 #include <llvm/Support/TargetSelect.h>
@@ -38,6 +36,15 @@ static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input bitco
                                           cl::value_desc("filename"));
 static cl::opt<std::string> OutputFilename("o", cl::desc("Override output filename"), cl::value_desc("filename"));
 static cl::opt<std::string> TargetTarget("target", cl::desc("ISPC target"), cl::init("host"), cl::value_desc("target"));
+static cl::opt<bool> Replay("replay", cl::desc("Run the optimization pipeline of ispc on the module captured by "
+                                                "\"ispc --capture\", with its target, addressing and optimization "
+                                                "level unless they are specified"));
+static cl::opt<int> OptLevel("opt-level", cl::desc("Optimization level of --replay"), cl::init(2),
+                             cl::value_desc("level"));
+static cl::opt<bool> Stats("stats", cl::desc("Print the time and the instruction count changes of every pass, "
+                                             "implied by --replay"));
+static cl::opt<std::string> StatsJSON("stats-json", cl::desc("Write the pass statistics to the file in JSON format"),
+                                      cl::value_desc("filename"));
 // TODO: unused for now.
 static cl::opt<std::string> TargetArch("arch", cl::desc("ISPC target architecture"), cl::value_desc("arch"));
 static cl::opt<std::string> TargetCPU("cpu", cl::desc("ISPC target CPU"), cl::value_desc("cpu"));
@@ -60,6 +67,25 @@ static void lPrintPasses(raw_ostream &OS) {
 #include "opt/ISPCPassRegistry.def"
 }
 
+// Read the target, the optimization level and the addressing written by
+// "ispc --capture" to the "ispc.capture" named metadata, and remove it.
+static bool lReadCapture(Module &M, std::string &target, int &optLevel, int &addressing) {
+    NamedMDNode *capture = M.getNamedMetadata("ispc.capture");
+    if (capture == nullptr || capture->getNumOperands() != 1 || capture->getOperand(0)->getNumOperands() != 3) {
+        return false;
+    }
+    MDNode *node = capture->getOperand(0);
+    auto str = [node](unsigned i) {
+        MDString *s = dyn_cast<MDString>(node->getOperand(i));
+        return s != nullptr ? s->getString().str() : std::string();
+    };
+    target = str(0);
+    optLevel = std::atoi(str(1).c_str());
+    addressing = std::atoi(str(2).c_str());
+    M.eraseNamedMetadata(capture);
+    return true;
+}
+
 static bool lAddPass(ispc::DebugModulePassManager &PM, const std::string &PassName) {
     using namespace ispc;
 #define MODULE_PASS(NAME, CREATE_PASS)                                                                                 \
@@ -108,6 +134,15 @@ int main(int argc, char **argv) {
     LLVMInitializeAArch64TargetMC();
 #endif
 
+#ifdef ISPC_RISCV_ENABLED
+    LLVMInitializeRISCVTargetInfo();
+    LLVMInitializeRISCVTarget();
+    LLVMInitializeRISCVAsmPrinter();
+    LLVMInitializeRISCVAsmParser();
+    LLVMInitializeRISCVDisassembler();
+    LLVMInitializeRISCVTargetMC();
+#endif
+
 #ifdef ISPC_WASM_ENABLED
     LLVMInitializeWebAssemblyAsmParser();
     LLVMInitializeWebAssemblyAsmPrinter();
@@ -127,16 +162,66 @@ int main(int argc, char **argv) {
     ispc::g = new ispc::Globals;
     LLVMContext *ctx = ispc::g->ctx;
 
-    if (Addressing == 64) {
+    // If it is true then LLVM Assembly won't be read.
+    ctx->setDiscardValueNames(false);
+
+    if (Replay && !Passes.empty()) {
+        ispc::Error(ispc::SourcePos(), "--replay and --passes can't be used together");
+        return 1;
+    }
+    if (!Replay && Passes.empty()) {
+        ispc::Error(ispc::SourcePos(), "No pass specified");
+        return 1;
+    }
+
+    SMDiagnostic err;
+    std::error_code EC;
+
+    auto M = getLazyIRFileModule(InputFilename, err, *ctx);
+    if (!M.get()) {
+        err.print(argv[0], errs());
+        return 1;
+    }
+    if (llvm::Error E = M->materializeAll()) {
+        logAllUnhandledErrors(std::move(E), errs(), Twine(argv[0]) + ": ");
+        return 1;
+    }
+
+    // The options of the captured compilation are used unless they are
+    // specified on the command line.
+    std::string targetName = TargetTarget.getValue();
+    int optLevel = OptLevel;
+    int addressing = Addressing;
+    if (Replay) {
+        std::string capturedTarget;
+        int capturedOptLevel = 0, capturedAddressing = 0;
+        if (lReadCapture(*M, capturedTarget, capturedOptLevel, capturedAddressing)) {
+            if (TargetTarget.getNumOccurrences() == 0) {
+                targetName = capturedTarget;
+            }
+            if (OptLevel.getNumOccurrences() == 0) {
+                optLevel = capturedOptLevel;
+            }
+            if (Addressing.getNumOccurrences() == 0) {
+                addressing = capturedAddressing;
+            }
+        } else {
+            ispc::Warning(ispc::SourcePos(), "The module is not captured by \"ispc --capture\", the target, "
+                                             "the addressing and the optimization level of the command line "
+                                             "are used.");
+        }
+    }
+
+    if (addressing == 64) {
         ispc::g->opt.force32BitAddressing = false;
-    } else if (Addressing == 32) {
+    } else if (addressing == 32) {
         ispc::g->opt.force32BitAddressing = true;
     } else {
         ispc::Error(ispc::SourcePos(), "Invalid addressing model");
         return 1;
     }
 
-    ispc::ISPCTarget target = ispc::ParseISPCTarget(TargetTarget.getValue());
+    ispc::ISPCTarget target = ispc::ParseISPCTarget(targetName);
 
     // TODO: here, we rely on arch and cpu autodetection in ispc::Target constructor.
     ispc::g->target =
@@ -145,26 +230,10 @@ int main(int argc, char **argv) {
         ispc::Error(ispc::SourcePos(), "Unsupported target\n");
         return 1;
     }
-
-    // If it is true then LLVM Assembly won't be read.
-    ctx->setDiscardValueNames(false);
+    ispc::g->opt.level = optLevel;
 
     ispc::InitLLVMUtil(ctx, *ispc::g->target);
 
-    if (Passes.empty()) {
-        ispc::Error(ispc::SourcePos(), "No pass specified");
-        return 1;
-    }
-
-    SMDiagnostic err;
-    std::error_code EC;
-
-    auto M = getLazyIRFileModule(InputFilename, err, *ctx);
-    if (!M.get()) {
-        err.print(argv[0], errs());
-        return 1;
-    }
-
     ToolOutputFile Out(OutputFilename, EC, sys::fs::OF_None);
     if (EC) {
         ispc::Error(ispc::SourcePos(), "Error opening output file: %s: %s", OutputFilename.c_str(),
@@ -172,16 +241,30 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    ispc::DebugModulePassManager PM(*M, 0);
-
-    // TODO: support multiple passes separated by comma.
-    if (!lAddPass(PM, Passes)) {
-        return 1;
+    if (Stats || Replay || !StatsJSON.empty()) {
+        ispc::PassStatistics::Enable();
     }
-    PM.addModulePass(PrintModulePass(Out.os(), ""));
 
-    PM.run();
+    if (Replay) {
+        ispc::Optimize(M.get(), optLevel);
+    } else {
+        ispc::DebugModulePassManager PM(*M, 0);
+
+        // TODO: support multiple passes separated by comma.
+        if (!lAddPass(PM, Passes)) {
+            return 1;
+        }
+        PM.run();
+    }
+    M->print(Out.os(), nullptr);
     Out.keep();
 
+    if (Stats || Replay) {
+        ispc::PassStatistics::in().Print(errs());
+    }
+    if (!StatsJSON.empty() && !ispc::PassStatistics::in().Write(StatsJSON)) {
+        return 1;
+    }
+
     return 0;
 }